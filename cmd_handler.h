@@ -94,6 +94,22 @@ static struct command *commands[] = {	\
 #define COMMAND_LIST(args...)
 
 #undef PLUGIN
+#if CONFIG_LAZY_PLUGINS
+/*
+ * Only a pointer to the plugin is placed in the nvme_plugins section, the
+ * linker collects them into the table register_extensions() walks when a
+ * command isn't found among the builtins.
+ */
+#define PLUGIN(name, cmds)				\
+static struct plugin plugin = {				\
+	name						\
+	.commands = commands				\
+}; 							\
+							\
+static struct plugin *const plugin_entry		\
+	__attribute__((used, section("nvme_plugins"),	\
+		       aligned(sizeof(void *)))) = &plugin;
+#else
 #define PLUGIN(name, cmds)				\
 static struct plugin plugin = {				\
 	name						\
@@ -105,5 +121,6 @@ static void init(void)					\
 {							\
 	register_extension(&plugin);			\
 }
+#endif
 
 #include CMD_INCLUDE(CMD_INC_FILE)
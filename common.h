@@ -4,6 +4,8 @@
 
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "ccan/endian/endian.h"
 
@@ -12,6 +14,10 @@
 #define min(x, y) ((x) > (y) ? (y) : (x))
 #define max(x, y) ((x) > (y) ? (x) : (y))
 
+#define NSEC_PER_USEC	1000ULL
+#define NSEC_PER_MSEC	1000000ULL
+#define NSEC_PER_SEC	1000000000ULL
+
 #ifdef __packed
 #else /* __packed */
 #define __packed __attribute__((__packed__))
@@ -19,11 +25,19 @@
 
 static inline uint32_t mmio_read32(void *addr)
 {
-	leint32_t *p = addr;
+	const volatile uint32_t *p = addr;
 
 	return le32_to_cpu(*p);
 }
 
+static inline uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 /* Access 64-bit registers as 2 32-bit; Some devices fail 64-bit MMIO. */
 static inline uint64_t mmio_read64(void *addr)
 {
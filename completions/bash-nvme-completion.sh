@@ -40,19 +40,21 @@ nvme_list_opts () {
 	# Listed here in the same order as in nvme-builtin.h
 	case "$1" in
 		"list")
-		opts+=$NO_OPTS
+		opts+=" --fast -F --jobs= -j --timing -T --watch -w"
 			;;
 		"list-subsys")
-		opts=+=" --output-format= -o --verbose -v"
+		opts=+=" --output-format= -o --verbose -v --watch -w"
 			;;
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -V --output-format= -o"
+			--vendor-specific -V --output-format= -o \
+			--input-file= -i"
 			;;
 		"id-ns")
 		opts+=" --namespace-id= -n --raw-binary -b \
 			--human-readable -H --vendor-specific -V \
-			--force -f --output-format= -o"
+			--force -f --output-format= -o --input-file= -i \
+			--all -a"
 			;;
 		"id-ns-granularity")
 		opts+=" --output-format= -o"
@@ -92,7 +94,8 @@ nvme_list_opts () {
 			--output-format= -o"
 			;;
 		"ns-descs")
-		opts+=" --namespace-id= -n --output-format -o --raw-binary -b"
+		opts+=" --namespace-id= -n --output-format -o --raw-binary -b \
+			--all -a"
 			;;
 		"id-nvmset")
 		opts+=" --nvmeset-id= -i --output-format= -o"
@@ -125,6 +128,11 @@ nvme_list_opts () {
 		"detach-ns")
 		opts+=" --namespace-id= -n --controllers= -c"
 			;;
+		"provision-ns")
+		opts+=" --layout= -L --flbas= -f --block-size= -b --dps= -d \
+			--nmic= -m --controllers= -c --no-attach -N --timeout= -t \
+			--dry-run -D --output-format= -o"
+			;;
 		"get-ns-id")
 		opts+=$NO_OPTS
 			;;
@@ -132,44 +140,76 @@ nvme_list_opts () {
 		opts+=" --log-id= -i --log-len= -l --namespace-id= -n \
 			--aen= -a --lpo= -O --lsp= -s --lsi= -S \
 			--rae -r --uuid-index= -U --csi= -y --ot -O \
-			--raw-binary -b"
+			--raw-binary -b --xfer-len= -x --output-file= -f \
+			--queue-depth= -q"
 			;;
 		"supported-log-pages")
 		opts+=" --output-format= -o --human-readable -H"
 			;;
 		"telemetry-log")
 		opts+=" --output-file= -O --host-generate= -g \
-			--controller-init -c --data-area= -d"
+			--controller-init -c --data-area= -d --rae -r --progress -P \
+			--if-changed -C --rate= -L --rate-iops= --max-latency="
+			;;
+		"collect")
+		opts+=" --logs= -l --output-dir= -d --bundle= -B \
+			--jobs= -j"
+			;;
+		"serve")
+		opts+=" --socket= -S"
+			;;
+		"monitor-events")
+		opts+=" --output-format= -o"
+			;;
+		"exporter")
+		opts+=" --address= -a --port= -p --interval= -i --ocp -O --fdp -F"
+			;;
+		"decode-archive")
+		opts+=" --type= -t --jobs= -j --output-format= -o"
 			;;
 		"fw-log")
-		opts+=" --raw-binary -b --output-format= -o"
+		opts+=" --raw-binary -b --output-format= -o --input-file= -i"
 			;;
 		"changed-ns-list-log")
 		opts+=" --output-format= -o --raw-binary -b"
 			;;
 		"smart-log")
 		opts+=" --namespace-id= -n --raw-binary -b \
+			--output-format= -o --interval= -i --count= -c \
+			--input-file= --all-namespaces -a --jobs= -j"
+			;;
+		"thermal-monitor")
+		opts+=" --interval= -i --count= -c --samples -s --output-format= -o"
+			;;
+		"plm-scheduler")
+		opts+=" --nvmset-ids= -i --ndwin= -w --replicas= -r \
+			--replica-index= -I --guard= -g --poll= -p --count= -c \
+			--enable -e --output-format= -o"
+			;;
+		"latency-histogram")
+		opts+=" --type= -t --source= -s --interval= -i --count= -c \
 			--output-format= -o"
 			;;
 		"ana-log")
-		opts+=" --output-format -o"
+		opts+=" --groups -g --watch -w --interval= -i --output-format -o"
 			;;
 		"fid-support-effects-log")
 		opts+=" --output-format -o"
 			;;
 		"error-log")
 		opts+=" --raw-binary -b --log-entries= -e \
-			--output-format= -o"
+			--since-count= -s --follow -f --interval= -i \
+			--output-format= -o --input-file="
 			;;
 		"effects-log")
 		opts+=" --output-format= -o --human-readable -H \
 			--raw-binary -b"
 			;;
 		"endurance-log")
-		opts+=" --output-format= -o --group-id -g"
+		opts+=" --output-format= -o --group-id -g --all -a"
 			;;
 		"predictable-lat-log")
-		opts+=" --nvmset-id= -i --raw-binary -b \
+		opts+=" --nvmset-id= -i --raw-binary -b --all -a \
 			--output-format= -o"
 			;;
 		"pred-lat-event-agg-log")
@@ -178,7 +218,9 @@ nvme_list_opts () {
 			;;
 		"persistent-event-log")
 		opts+=" --action= -a --log-len= -l \
-			--raw-binary -b --output-format= -o"
+			--raw-binary -b --follow -f --interval= -i \
+			--store= -S --query -q --since= -s --until= -u \
+			--event-type= -t --output-format= -o"
 			;;
 		"endurance-event-agg-log")
 		opts+=" --log-entries= -e  --rae -r \
@@ -191,7 +233,7 @@ nvme_list_opts () {
 		opts+=" --output-format= -o"
 			;;
 		"boot-part-log")
-		opts+=" --lsp -s --output-file= -f \
+		opts+=" --lsp -s --output-file= -f --progress -P \
 			--output-format= -o"
 			;;
 		"media-unit-stat-log")
@@ -207,9 +249,19 @@ nvme_list_opts () {
 			--data-len= -l --cdw11= --c -uuid-index= -U --raw-binary -b \
 			--human-readable -H"
 			;;
+		"config-snapshot")
+		opts+=" --no-namespaces -N --output-format= -o"
+			;;
+		"config-diff")
+		opts+=" --ignore= -i --output-format= -o"
+			;;
 		"device-self-test")
 		opts+=" --namespace-id= -n --self-test-code= -s"
 			;;
+		"self-test-run")
+		opts+=" --namespace-id= -n --self-test-code= -s --interval= -i \
+			--output-format= -o"
+			;;
 		"self-test-log")
 		opts+=" --dst-entries= -e --output-format= -o \
 			--verbose -v"
@@ -229,16 +281,31 @@ nvme_list_opts () {
 		opts+=" --namespace-id= -n --timeout= -t --lbaf= -l \
 			--ses= -s --pil= -p -pi= -i --ms= -m --reset -r"
 			;;
+		"format-run")
+		opts+=" --timeout= -t --lbaf= -l --block-size= -b \
+			--ses= -s --pil= -p --pi= -i --ms= -m --interval= -I \
+			--force --output-format= -o"
+			;;
 		"fw-commit")
 		opts+=" --slot= -s --action= -a --bpid= -b"
 			;;
 		"fw-download")
-		opts+=" --fw= -f --xfer= -x --offset= -O"
+		opts+=" --fw= -f --xfer= -x --offset= -O \
+			--progress -p --ignore-ovr -i --resume= -r"
+			;;
+		"fw-rollout")
+		opts+=" --fw= -f --xfer= -x --slot= -s --action= -a \
+			--revision= -R --jobs= -j --wave= -w"
 			;;
 		"capacity-mgmt")
 		opts+=" --operation= -O --element-id= -i --cap-lower= -l \
 			--cap-upper= -u"
 			;;
+		"capacity-layout")
+		opts+=" --domain-id= -d --config= -c --delete-nvmsets= -S \
+			--delete-endgrps= -G --create-endgrps= -E \
+			--create-nvmsets= -N --output-format= -o"
+			;;
 		"lockdown")
 		opts+=" --ofi= -O --ifc= -f --prhbt= -p --scp= -s --uuid -U"
 			;;
@@ -249,7 +316,9 @@ nvme_list_opts () {
 			--cdw11= -5 --cdw12= -6 --cdw13= -7 --cdw14= -8 \
 			--cdw15= -9 --input-file= -i --raw-binary -b \
 			--show-command -s --dry-run -d --read -r --write -w \
-			--latency -T"
+			--latency -T \
+			--repeat= -N --queue-depth= -q --threads= -j \
+			--namespaces= -L"
 			;;
 		"io-passthru")
 		opts+=" --opcode= -O --flags= -f --prefill= -p --rsvd= -R \
@@ -258,7 +327,13 @@ nvme_list_opts () {
 			--cdw11= -5 --cdw12= -6 --cdw13= -7 --cdw14= -8 \
 			--cdw15= -9 --input-file= -i --raw-binary -b \
 			--show-command -s --dry-run -d --read -r --write -w \
-			--latency -T"
+			--latency -T --cmb \
+			--repeat= -N --queue-depth= -q --threads= -j \
+			--namespaces= -L"
+			;;
+		"passthru-replay")
+		opts+=" --trace= -i --queue-depth= -q --timing -T \
+			--prefill= -p --output-format= -o"
 			;;
 		"security-send")
 		opts+=" --namespace-id= -n --file= -f --nssf= -N --secp= -p \
@@ -271,7 +346,7 @@ nvme_list_opts () {
 		"get-lba-status")
 		opts+=" --namespace-id= -n --start-lba= -s --max-dw= -m \
 			--action= -a --range-len= -l --timeout= -t \
-			--output-format= -o"
+			--range= -R --queue-depth= -q --output-format= -o"
 			;;
 		"resv-acquire")
 		opts+=" --namespace-id= -n --crkey= -c --prkey= -p \
@@ -285,13 +360,21 @@ nvme_list_opts () {
 		opts+=" --namespace-id= -n --crkey -c --rtype= -t \
 			--rrela= -a --iekey -i"
 			;;
+		"resv-batch")
+		opts+=" --action= -A --namespace-ids= -n --all-namespaces -N \
+			--crkey= -c --nrkey= -k --rtype= -t --ract= -a \
+			--cptpl= -p --iekey -i --jobs= -j --output-format= -o"
+			;;
 		"resv-report")
 		opts+=" --namespace-id= -n --numd= -d --eds -e \
-			--raw-binary= -b --output-format= -o"
+			--raw-binary= -b --auto -a --compact -c \
+			--all-namespaces -A --output-format= -o"
 			;;
 		"dsm")
 		opts+=" --namespace-id= -n --ctx-attrs= -a --blocks= -b\
-			--slbs= -s --ad -d --idw -w --idr -r --cdw11= -c"
+			--slbs= -s --ad -d --idw -w --idr -r --cdw11= -c \
+			--range= -R --queue-depth= -q --threads= -j --rate= -L \
+			--rate-iops= --max-latency="
 			;;
 		"copy")
 		opts+=" --namespace-id= -n --sdlba= -d --blocks= -b --slbs= -s \
@@ -300,7 +383,8 @@ nvme_list_opts () {
 			--ref-tag= -r --expected-ref-tag= -R \
 			--app-tag= -a --expected-app-tag= -A \
 			--app-tag-mask= -m --expected-app-tag-mask= -M \
-			--dir-type= -T --dir-spec= -S --format= -F"
+			--dir-type= -T --dir-spec= -S --format= -F \
+			--range-file= -i --queue-depth= -q --threads= -j"
 			;;
 		"flush")
 		opts+=" --namespace-id= -n"
@@ -312,7 +396,16 @@ nvme_list_opts () {
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --storage-tag-check -C \
 			--dir-type= -T --dir-spec= -S --dsm= -D --show-command -V \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --repeat= --stream --host-pi --poll --cmb"
+			;;
+		"compare-write")
+		opts+=" --start-block= -s --block-count= -c --data-size= -z \
+			--metadata-size= -y --ref-tag= -r --data= -d \
+			--write-data= -W --metadata= -M --prinfo= -p \
+			--app-tag-mask= -m --app-tag= -a --limited-retry -l \
+			--force-unit-access -f --storage-tag-check -C \
+			--dir-type= -T --dir-spec= -S --dsm= -D --show-command -V \
+			--dry-run -w --latency -t --repeat= --host-pi"
 			;;
 		"read")
 		opts+=" --start-block= -s --block-count= -c --data-size= -z \
@@ -321,7 +414,7 @@ nvme_list_opts () {
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --storage-tag-check -C \
 			--dir-type= -T --dir-spec= -S --dsm= -D --show-command -V \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --repeat= --stream --host-pi --poll --cmb"
 			;;
 		"write")
 		opts+=" --start-block= -s --block-count= -c --data-size= -z \
@@ -330,7 +423,7 @@ nvme_list_opts () {
 			--app-tag= -a --limited-retry -l \
 			--force-unit-access -f --storage-tag-check -C \
 			--dir-type= -T --dir-spec= -S --dsm= -D --show-command -V \
-			--dry-run -w --latency -t"
+			--dry-run -w --latency -t --repeat= --stream --host-pi --poll --cmb"
 			;;
 		"write-zeroes")
 		opts+=" --namespace-id= -n --start-block= -s \
@@ -338,18 +431,72 @@ nvme_list_opts () {
 			--force-unit-access -f --prinfo= -p --ref-tag= -r \
 			--app-tag-mask= -m --app-tag= -a \
 			--storage-tag= -S --storage-tag-check -C \
-			--dir-type= -T --dir-spec= -S"
+			--dir-type= -T --dir-spec= -S --range= -R \
+			--queue-depth= -q --threads= -j --rate= -L \
+			--rate-iops= --max-latency="
 			;;
 		"write-uncor")
 		opts+=" --namespace-id= -n --start-block= -s \
-			--block-count= -c --dir-type= -T --dir-spec= -S"
+			--block-count= -c --dir-type= -T --dir-spec= -S \
+			--range= -R --queue-depth= -q --threads= -j --rate= -L \
+			--rate-iops= --max-latency="
+			;;
+		"compare-hash")
+		opts+=" --namespace-id= -n --manifest= -m --create -c \
+			--range= -R --chunk-size= -b --queue-depth= -q \
+			--threads= -j --rate= -L --rate-iops= --max-latency= \
+			--output-format= -o"
 			;;
 		"verify")
 		opts+=" --namespace-id= -n --start-block= -s \
 			--block-count= -c --limited-retry -l \
 			--force-unit-access -f --prinfo= -p --ref-tag= -r \
 			--app-tag= -a --app-tag-mask= -m \
-			--storage-tag= -S --storage-tag-check -C"
+			--storage-tag= -S --storage-tag-check -C \
+			--latency -t --repeat= --range= -R --queue-depth= -q \
+			--threads= -j --rate= -L --rate-iops= --max-latency= \
+			--checkpoint= -k"
+			;;
+		"tune-sweep")
+		opts+=" --namespace-id= -n --agg-time= -T --agg-thr= -t \
+			--burst= -b --weights= -w --block-count= -c --io-range= -L \
+			--queue-depth= -q --threads= -j --runtime= -R --random -x \
+			--pick= -p --save -s --output-format= -o"
+			;;
+		"flush-bench")
+		opts+=" --namespace-id= -n --ratios= -r --block-count= -c \
+			--io-range= -L --queue-depth= -q --threads= -j --runtime= -R \
+			--random -x --keep-vwc -k --force --output-format= -o"
+			;;
+		"pmr-bench")
+		opts+=" --offset= -s --size= -z --passes= -p --persist-size= -b \
+			--persist-count= -N --uncached -u --output-format= -o"
+			;;
+		"dsm-bench")
+		opts+=" --namespace-id= -n --ctx-attrs= -a --write-pct= -w \
+			--random-pct= -r --per-command -C --block-count= -c \
+			--io-range= -L --queue-depth= -q --threads= -j --runtime= -R \
+			--idle= -i --force --output-format= -o"
+			;;
+		"compare-write-bench")
+		opts+=" --start-block= -s --block-count= -c --locks= -l \
+			--queue-depth= -q --threads= -j --runtime= -R \
+			--prinfo= -p --force --output-format= -o"
+			;;
+		"io-bench")
+		opts+=" --io-mode= -i --namespace-id= -n --start-block= -s \
+			--block-count= -c --io-range= -L --queue-depth= -q \
+			--threads= -j --io-count= -N --runtime= -R --random -x \
+			--data= -d --prinfo= -p --ref-tag= -r --app-tag-mask= -m \
+			--app-tag= -a --storage-tag= -g --limited-retry -l \
+			--force-unit-access -f --storage-tag-check -C \
+			--dir-type= -T --dir-spec= -S --dsm= -D --force --poll --cmb \
+			--streams= --profile= -P --interval= -I --output-format= -o"
+		case $opt in
+			--io-mode|-i)
+			vals+=" read write compare"
+				;;
+		esac
 			;;
 		"sanitize")
 		opts+=" --no-dealloc -d --oipbp -i --owpass= -n \
@@ -360,6 +507,16 @@ nvme_list_opts () {
 				;;
 		esac
 			;;
+		"sanitize-run")
+		opts+=" --no-dealloc -d --oipbp -i --owpass= -n \
+			--ause -u --sanact= -a --ovrpat= -p --max-interval= -m \
+			--output-format= -o"
+		case $opt in
+			--sanact|-a)
+			vals+=" start-block-erase start-overwrite start-crypto-erase"
+				;;
+		esac
+			;;
 		"sanitize-log")
 		opts+=" --rae -r --output-format= -o --human-readable -H \
 			--raw-binary -b"
@@ -374,7 +531,7 @@ nvme_list_opts () {
 		opts+=$NO_OPTS
 			;;
 		"show-regs")
-		opts+=" --output-format= -o --human-readable -H"
+		opts+=" --output-format= -o --human-readable -H --refresh= -r"
 			;;
 		"discover")
 		opts+=" --transport= -t -traddr= -a -trsvcid= -s \
@@ -385,8 +542,8 @@ nvme_list_opts () {
 			--tos= -T --hdr-digest= -g --data-digest -G \
 			--nr-io-queues= -i --nr-write-queues= -W \
 			--nr-poll-queues= -P --queue-size= -Q \
-			--persistent -p --quiet -S \
-			--output-format= -o"
+			--persistent -p --quiet -S --parallel= \
+			--discovery-timeout= --output-format= -o"
 			;;
 		"connect-all")
 		opts+=" --transport= -t -traddr= -a -trsvcid= -s \
@@ -397,7 +554,8 @@ nvme_list_opts () {
 			--tos= -T --hdr-digest= -g --data-digest -G \
 			--nr-io-queues= -i --nr-write-queues= -W \
 			--nr-poll-queues= -P --queue-size= -Q \
-			--persistent -p --quiet -S \
+			--persistent -p --quiet -S --parallel= \
+			--discovery-timeout= --monitor --coalesce= \
 			--output-format= -o"
 			;;
 		"connect")
@@ -409,14 +567,23 @@ nvme_list_opts () {
 			--tos= -T --duplicate-connect -D --disable-sqflow -d\
 			--hdr-digest -g --data-digest -G --output-format= -o"
 			;;
+		"connect-advise")
+		opts+=" --transport= -t --nqn= -n --traddr= -a --trsvcid -s \
+			--hostnqn= -q --host-id= -I --nr-write-queues= -W \
+			--nr-poll-queues= -P --hdr-digest -g --data-digest -G \
+			--layouts= -L --namespace-id= -N --runtime= -R --write \
+			--save --config= -J --output-format= -o"
+			;;
 		"dim")
 		opts+=" --task -t --nqn -n --device -d"
 			;;
 		"disconnect")
-		opts+=" --nqn -n --device -d"
+		opts+=" --nqn -n --device -d --jobs= -j --timing -T \
+			--reconnect -R"
 			;;
 		"disconnect-all")
-		opts+=$NO_OPTS
+		opts+=" --transport= -r --jobs= -j --timing -T \
+			--reconnect -R"
 			;;
 		"gen-hostnqn")
 		opts+=$NO_OPTS
@@ -434,16 +601,29 @@ nvme_list_opts () {
 			--target-dir= -T --dir-spec= -S --dir-oper= -O \
 			--endir= -e --human-readable -H --raw-binary -b"
 			;;
+		"dir-streams")
+		opts+=" --action= -A --namespace-ids= -n --all-namespaces -N \
+			--count= -c --enable -e --output-format= -o"
+			;;
 		"virt-mgmt")
 		opts+=" --cntlid= -c --rt= -r --act= -a --nr= -n"
 			;;
+		"virt-provision")
+		opts+=" --count= -N --vq= -q --vi= -i --offline -f \
+			--dry-run -D --output-format= -o"
+			;;
 		"rpmb")
 		opts+=" --cmd= -c --msgfile= -f --keyfile= -g \
 			--key= -k --msg= -d --address= -o --blocks= -b \
-			--target= -t"
+			--target= -t --bulk -B"
 			;;
 		"show-topology")
-		opts+=" --output-format= -o --verbose -v --ranking= -r"
+		opts+=" --output-format= -o --verbose -v --ranking= -r --watch -w \
+			--stats -s"
+			;;
+		"path-probe")
+		opts+=" --output-format= -o --mode= -m --io-count= -N \
+			--runtime= -R --queue-depth= -q"
 			;;
 		"nvme-mi-recv")
 		opts+=" --opcode= -O --namespace-id= -n --data-len= -l \
@@ -453,12 +633,21 @@ nvme_list_opts () {
 		opts+=" --opcode= -O --namespace-id= -n --data-len= -l \
 			--nmimt= -m --nmd0= -0 --nmd1= -1 --input-file= -i"
 			;;
+		"nvme-mi-poll")
+		opts+=" --interval= -i --count= -c --smart-log -s --clear -C --changes -x \
+			--output-format= -o"
+			;;
+		"nvme-mi-sweep")
+		opts+=" --smart-log -s --timeout= -t --jobs= -j --output-format= -o"
+			;;
 		"get-reg")
 		opts+=" --offset, -O --human-readable -H --cap --vs --cmbloc \
 			--cmbsz --bpinfo --cmbsts --cmbebs --cmbswtp --crto \
 			--pmrcap --pmrsts --pmrebs --pmrswtp --intms --intmc \
 			--cc --csts --nssr --aqa --asq --acq --bprsel --bpmbl \
 			--cmbmsc --nssd --pmrctl --pmrmscl --pmrmscu \
+			--sample-interval= -i --duration= -d --output-file= -f \
+			--refresh= -r \
 			--output-format -o --verbose -v"
 			;;
 		"set-reg")
@@ -506,12 +695,13 @@ plugin_intel_opts () {
 	case "$1" in
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"internal-log")
 		opts+=" --log= -l --region= -r --nlognum= -m \
 			--namespace-id= -n --output-file= -o \
-			--verbose-nlog -v"
+			--verbose-nlog -v --all -a"
 			;;
 		"lat-stats")
 		opts+=" --write -w --raw-binary -b --json -j"
@@ -562,7 +752,8 @@ plugin_amzn_opts () {
 	case "$1" in
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -616,6 +807,9 @@ plugin_memblaze_opts () {
 		"lat-log-print")
 		opts+=$NO_OPTS
 			;;
+		"lat-log-print-x")
+		opts+=" --raw-binary -b --interval= -i --count= -c"
+			;;
 		"clear-error-log")
 		opts+=$NO_OPTS
 			;;
@@ -661,7 +855,8 @@ plugin_wdc_opts () {
 			;;
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"purge")
 		opts+=$NO_OPTS
@@ -684,7 +879,7 @@ plugin_wdc_opts () {
 		opts+=$NO_OPTS
 			;;
 		"drive-essentials")
-		opts+=" --dir-name= -d"
+		opts+=" --dir-name= -d --stream -s --jobs= -j"
 			;;
 		"get-drive-status")
 		opts+=$NO_OPTS
@@ -764,7 +959,8 @@ plugin_huawei_opts () {
 			;;
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -879,6 +1075,15 @@ plugin_micron_opts () {
 		"vs-smbus-option")
 		opts+=" --option= -o --value= -v --save= -s"
 			;;
+		"latency-tracking")
+		opts+=" --option= -o --command= -c --threshold= -t"
+			;;
+		"latency-stats")
+		opts+=" --command= -c --interval= -i --count= -n --format= -f"
+			;;
+		"latency-logs")
+		opts+=$NO_OPTS
+			;;
 		"help")
 		opts+=$NO_OPTS
 			;;
@@ -929,7 +1134,7 @@ plugin_seagate_opts () {
 		opts+=" --namespace-id= -n --raw-binary -b"
 			;;
 		"vs-internal-log")
-		opts+=" --namespace-id= -n --dump-file= -f"
+		opts+=" --namespace-id= -n --dump-file= -f --resume -r"
 			;;
 		"plugin-version")
 		opts+=$NO_OPTS
@@ -963,7 +1168,11 @@ plugin_virtium_opts () {
 
 	case "$1" in
 		"save-smart-to-vtview-log")
-		opts+=" --run-time= -r --freq= -f --output-file= -o --test-name= -n"
+		opts+=" --run-time= -r --freq= -f --output-file= -o --test-name= -n \
+			--binary -b --batch= -B"
+			;;
+		"convert-vtview-log")
+		opts+=" --input-file= -i --output-file= -o"
 			;;
 		"show-identify")
 		opts+=$NO_OPTS
@@ -997,7 +1206,8 @@ plugin_shannon_opts () {
 
 	case "$1" in
 		"smart-log-add")
-		opts+=" --namespace-id= -n --raw-binary -b"
+		opts+=" --namespace-id= -n --raw-binary -b \
+			--output-format= -o"
 			;;
 		"get-feature-add")
 		opts+=" --namespace-id= -n --feature-id -f --sel= -s \
@@ -1009,7 +1219,8 @@ plugin_shannon_opts () {
 			;;
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -1040,7 +1251,7 @@ plugin_dera_opts () {
 
 	case "$1" in
 		"smart-log-add")
-		opts+=$NO_OPTS
+		opts+=" --output-format= -o"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -1080,7 +1291,8 @@ plugin_sfx_opts () {
 		opts+=$NO_OPTS
 			;;
 		"query-cap")
-		opts+=" --raw-binary --json"
+		opts+=" --raw-binary -b --json -j --interval= -i --count= -c \
+			--min-ratio= -r"
 			;;
 		"change-cap")
 		opts+=" --cap= -c --cap-byte= -z --force -f --raw-binary -b --json -j"
@@ -1122,7 +1334,8 @@ plugin_solidigm_opts () {
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
 			--vendor-specific -v --output-format= -o \
-			--verbose -v "
+			--verbose -v  \
+			--input-file= -i"
 			;;
 		"vs-smart-add-log")
 		opts+="--output-format= -o"
@@ -1130,6 +1343,12 @@ plugin_solidigm_opts () {
 		"garbage-collect-log")
 		opts+="--output-format= -o"
 			;;
+		"gc-latency")
+		opts+=" --namespace-id= -n --io-mode= -i \
+		--block-count= -c --queue-depth= -q --threads= -j \
+		--runtime= -R --random -x --interval= -I \
+		--output-format= -o"
+			;;
 		"vs-internal-log")
 		opts+=" --type= -t --namespace-id= -n \
 		--file-prefix= -p --verbose -v"
@@ -1257,32 +1476,46 @@ plugin_zns_opts () {
 		"report-zones")
 		opts+=" --namespace-id= -n --start-lba= -s \
 			--descs= -d --state= -S --output-format= -o \
-			--human-readable -H --extended -e --partial -p"
+			--human-readable -H --extended -e --partial -p --jobs= -j \
+			--cache= -c --rebuild -r"
+			;;
+		"zone-summary")
+		opts+=" --namespace-id= -n --state= -S --output-format= -o"
 			;;
 		"close-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t \
+			--zones= -z --zone-file= -f --jobs= -j"
 			;;
 		"finish-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t \
+			--zones= -z --zone-file= -f --jobs= -j"
 			;;
 		"open-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t --zrwa -r"
+			--select-all -a --timeout= -t --zrwa -r \
+			--zones= -z --zone-file= -f --jobs= -j"
 			;;
 		"reset-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t \
+			--zones= -z --zone-file= -f --jobs= -j"
 			;;
 		"offline-zone")
 		opts+=" --namespace-id= -n --start-lba= -s \
-			--select-all -a --timeout= -t"
+			--select-all -a --timeout= -t \
+			--zones= -z --zone-file= -f --jobs= -j"
 			;;
 		"set-zone-desc")
 		opts+=" --namespace-id= -n --start-lba= -s \
 			--data= -d --timeout= -t  --zrwa -r"
 			;;
+		"zrwa-write")
+		opts+=" --namespace-id= -n --zslba= -s --data-size= -z \
+			--block-count= -c --flush-granularity= -g \
+			--queue-depth= -q --data= -d --output-format= -o"
+			;;
 		"flush-zone")
 		opts+=" --namespace-id= -n --last-lba= -l --timeout= -t"
 			;;
@@ -1291,7 +1524,8 @@ plugin_zns_opts () {
 			--metadata-size= -y --data= -d --metadata= -M \
 			--limited-retry -l --force-unit-access -f --ref-tag= -r
 			--app-tag-mask= -m --app-tag= -a --prinfo= -p \
-			--piremap -P --latency -t"
+			--piremap -P --latency -t --stream -S --zones= -Z \
+			--queue-depth= -q --lba-log= -L --output-format= -o"
 			;;
 		"changed-zone-list")
 		opts+=" --namespace-id= -n --output-format= -o --rae -r"
@@ -1326,7 +1560,8 @@ plugin_nvidia_opts () {
 	case "$1" in
 		"id-ctrl")
 		opts+=" --raw-binary -b --human-readable -H \
-			--vendor-specific -v --output-format= -o"
+			--vendor-specific -v --output-format= -o \
+			--input-file= -i"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -1357,7 +1592,8 @@ plugin_ymtc_opts () {
 
 	case "$1" in
 		"smart-log-add")
-		opts+=" --namespace-id= -n --raw-binary -b"
+		opts+=" --namespace-id= -n --raw-binary -b \
+			--output-format= -o"
 			;;
 		"help")
 		opts+=$NO_OPTS
@@ -1419,10 +1655,12 @@ plugin_ocp_opts () {
 
 	case "$1" in
 		"smart-add-log")
-		opts+=" --output-format= -o"
+		opts+=" --output-format= -o --interval= -i --count= -c \
+			--snapshot-file= -s --input-file="
 			;;
 		"latency-monitor-log")
-		opts+=" --output-format= -o"
+		opts+=" --output-format= -o --interval= -i --count= -c \
+			--arm -a --input-file="
 			;;
 		"set-latency-monitor-feature")
 		opts+=" --active_bucket_timer_threshold= -t \
@@ -1496,7 +1734,7 @@ _nvme_subcmds () {
 		[amzn]="id-ctrl"
 		[memblaze]="smart-log-add get-pm-status set-pm-status \
 			select-download lat-stats lat-stats-print lat-log \
-			lat-log-print clear-error-log"
+			lat-log-print lat-log-print-x clear-error-log"
 		[wdc]="cap-diag drive-log get-crash-dump get-pfail-dump \
 			id-ctrl purge purge-monitor vs-internal-log \
 			vs-nand-stats vs-smart-add-log clear-pcie-correctable-errors \
@@ -1516,17 +1754,18 @@ _nvme_subcmds () {
 			vs-drive-info plugin-version cloud-SSD-plugin-version \
 			log-page-directory vs-fw-activate-history \
 			vs-error-reason-identifier vs-smart-add-log \
-			clear-fw-activate-history vs-smbus-option"
+			clear-fw-activate-history vs-smbus-option \
+			latency-tracking latency-stats latency-logs"
 		[seagate]="vs-temperature-stats vs-log-page-sup \
 			vs-smart-add-log vs-pcie-stats clear-pcie-correctable-errors \
 			get-host-tele get-ctrl-tele vs-internal-log \
 			plugin-version"
-		[virtium]="save-smart-to-vtview-log show-identify"
+		[virtium]="save-smart-to-vtview-log convert-vtview-log show-identify"
 		[shannon]="smart-log-add get-feature-add set-feature-add id-ctrl"
 		[dera]="smart-log-add"
 		[sfx]="smart-log-add lat-stats get-bad-block query-cap \
 			change-cap set-feature get-feature"
-    		[solidigm]="id-ctrl vs-smart-add-log garbage-collect-log \
+    		[solidigm]="id-ctrl vs-smart-add-log garbage-collect-log gc-latency \
 			vs-internal-log latency-tracking-log \
 			clear-pcie-correctable-errors parse-telemetry-log \
 			clear-fw-activate-history vs-fw-activate-history log-page-directory \
@@ -1536,7 +1775,8 @@ _nvme_subcmds () {
 		[zns]="id-ctrl id-ns zone-mgmt-recv \
 			zone-mgmt-send report-zones close-zone \
 			finish-zone open-zone reset-zone offline-zone \
-			set-zone-desc zone-append changed-zone-list"
+			set-zone-desc zone-append changed-zone-list zone-summary \
+			zrwa-write"
 		[nvidia]="id-ctrl"
 		[ymtc]="smart-log-add"
 		[inspur]="nvme-vendor-log"
@@ -1579,27 +1819,28 @@ _nvme_subcmds () {
 		id-ns-lba-format nvm-id-ns nvm-id-ns-lba-format \
 		nvm-id-ctrl primary-ctrl-caps list-secondary \
 		ns-descs id-nvmset id-uuid id-iocs id-domain create-ns \
-		delete-ns get-ns-id get-log telemetry-log \
-		fw-log changed-ns-list-log smart-log ana-log \
+		delete-ns provision-ns get-ns-id get-log telemetry-log collect serve exporter decode-archive monitor-events \
+		fw-log changed-ns-list-log smart-log thermal-monitor latency-histogram ana-log \
 		error-log effects-log endurance-log \
-		predictable-lat-log pred-lat-event-agg-log \
+		predictable-lat-log pred-lat-event-agg-log plm-scheduler \
 		persistent-event-log endurance-agg-log \
-		lba-status-log resv-notif-log get-feature \
-		device-self-test self-test-log set-feature \
-		set-property get-property format fw-commit \
-		fw-download admin-passthru io-passthru \
+		lba-status-log resv-notif-log get-feature config-snapshot config-diff \
+		device-self-test self-test-run self-test-log set-feature \
+		set-property get-property format format-run fw-commit \
+		fw-download fw-rollout admin-passthru io-passthru passthru-replay \
 		security-send security-recv get-lba-status \
-		resv-acquire resv-register resv-release \
-		resv-report dsm copy flush compare read \
-		write write-zeros write-uncor verify \
-		sanitize sanitize-log reset subsystem-reset \
-		ns-rescan show-regs discover connect-all \
-		connect disconnect disconnect-all gen-hostnqn \
-		show-hostnqn dir-receive dir-send virt-mgmt \
-		rpmb boot-part-log fid-support-effects-log \
+		resv-acquire resv-register resv-release resv-batch \
+		resv-report dsm copy flush compare compare-hash compare-write read \
+		write write-zeros write-uncor verify io-bench power-bench tune-sweep \
+		flush-bench pmr-bench dsm-bench compare-write-bench sanitize sanitize-run sanitize-log reset \
+		subsystem-reset ns-rescan show-regs discover connect-all \
+		connect connect-advise disconnect disconnect-all gen-hostnqn \
+		show-hostnqn dir-receive dir-send dir-streams virt-mgmt \
+		virt-provision rpmb boot-part-log fid-support-effects-log \
 		supported-log-pages lockdown media-unit-stat-log \
-		supported-cap-config-log dim show-topology list-endgrp \
-		nvme-mi-recv nvme-mi-send get-reg set-reg"
+		supported-cap-config-log capacity-layout dim show-topology \
+		path-probe list-endgrp \
+		nvme-mi-recv nvme-mi-send nvme-mi-poll nvme-mi-sweep get-reg set-reg"
 
 	# Add plugins:
 	for plugin in "${!_plugin_subcmds[@]}"; do
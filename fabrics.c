@@ -19,6 +19,7 @@
  * Fabrics specification standard.
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
 #include <fcntl.h>
@@ -30,22 +31,36 @@
 #include <dirent.h>
 #include <inttypes.h>
 #include <libgen.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include <stddef.h>
+#include <signal.h>
 #include <syslog.h>
 #include <time.h>
 
+#include <poll.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <linux/types.h>
 
 #include <libnvme.h>
 
+#include <ccan/ccan/htable/htable_type.h>
+#include <ccan/ccan/htable/htable.h>
+#include <ccan/ccan/hash/hash.h>
+
 #include "common.h"
 #include "nvme.h"
 #include "nbft.h"
 #include "nvme-print.h"
 #include "fabrics.h"
+#include "nvme-io-engine.h"
+#include "nvme-watch.h"
+#include "util/cache.h"
+#include "util/interval.h"
 #include "util/logging.h"
+#include "util/sysfs.h"
+#include "util/thread-pool.h"
 
 #define PATH_NVMF_DISC		SYSCONFDIR "/nvme/discovery.conf"
 #define PATH_NVMF_CONFIG	SYSCONFDIR "/nvme/config.json"
@@ -60,6 +75,8 @@ static char *raw;
 static bool persistent;
 static bool quiet;
 static bool dump_config;
+static unsigned int nr_parallel = 1;
+static unsigned int disc_timeout;
 
 static const char *nvmf_tport		= "transport type";
 static const char *nvmf_traddr		= "transport address";
@@ -90,6 +107,18 @@ static const char *nvmf_tls		= "enable TLS";
 static const char *nvmf_concat		= "enable secure concatenation";
 static const char *nvmf_config_file	= "Use specified JSON configuration file or 'none' to disable";
 static const char *nvmf_context		= "execution context identification string";
+static const char *nvmf_parallel	= "number of discovery controllers queried and log entries connected concurrently";
+static const char *nvmf_jobs		= "number of controllers torn down concurrently";
+static const char *nvmf_timing		= "print the time each disconnect took";
+static const char *nvmf_reconnect	= "connect the controllers again after disconnecting them";
+static const char *nvmf_disc_timeout	= "seconds to wait for each discovery controller with --parallel";
+static const char *nvmf_monitor		= "keep running and connect the new records of changed discovery logs";
+static const char *nvmf_coalesce	= "milliseconds to collect discovery log change events for with --monitor";
+static const char *nvmf_advise_layouts	= "layouts to probe, <nr-io-queues>:<queue-size>[:<nr-write-queues>[:<nr-poll-queues>]][,...]";
+static const char *nvmf_advise_nsid	= "namespace to probe (default the first one)";
+static const char *nvmf_advise_runtime	= "seconds each probe runs (default 5)";
+static const char *nvmf_advise_write	= "also probe writes, this overwrites data on the namespace";
+static const char *nvmf_advise_save	= "write the recommended layout to the JSON configuration file";
 
 #define NVMF_ARGS(n, c, ...)                                                                     \
 	struct argconfig_commandline_options n[] = {                                             \
@@ -131,11 +160,95 @@ static bool is_persistent_discovery_ctrl(nvme_host_t h, nvme_ctrl_t c)
 	return false;
 }
 
+static const char *subsys_nqn_key(const struct nvme_subsystem *s)
+{
+	const char *nqn = nvme_subsystem_get_nqn((nvme_subsystem_t)s);
+
+	return nqn ? nqn : "";
+}
+
+static bool subsys_nqn_cmp(const struct nvme_subsystem *s, const char *nqn)
+{
+	return !strcmp(subsys_nqn_key(s), nqn);
+}
+
+HTABLE_DEFINE_TYPE(struct nvme_subsystem, subsys_nqn_key, hash_string,
+		   subsys_nqn_cmp, htable_subsys_nqn);
+
+/*
+ * connect-all looks up a controller for every discovery log record, so
+ * discover indexes the subsystems of the host by NQN instead of asking
+ * each of them. Subsystems are only ever appended to the host, the ones
+ * added by connecting are indexed on the next lookup.
+ */
+static struct ctrl_index {
+	bool enabled;
+	nvme_host_t h;
+	nvme_subsystem_t last;
+	struct htable_subsys_nqn ht;
+} ctrl_index;
+
+static void ctrl_index_free(void)
+{
+	if (ctrl_index.h)
+		htable_subsys_nqn_clear(&ctrl_index.ht);
+	memset(&ctrl_index, 0, sizeof(ctrl_index));
+}
+
+static void ctrl_index_update(nvme_host_t h)
+{
+	nvme_subsystem_t s;
+
+	if (ctrl_index.h != h) {
+		if (ctrl_index.h)
+			htable_subsys_nqn_clear(&ctrl_index.ht);
+		htable_subsys_nqn_init(&ctrl_index.ht);
+		ctrl_index.h = h;
+		ctrl_index.last = NULL;
+	}
+
+	s = ctrl_index.last ? nvme_next_subsystem(h, ctrl_index.last) :
+		nvme_first_subsystem(h);
+	for (; s; s = nvme_next_subsystem(h, s)) {
+		htable_subsys_nqn_add(&ctrl_index.ht, s);
+		ctrl_index.last = s;
+	}
+}
+
+static nvme_ctrl_t lookup_ctrl_indexed(nvme_host_t h, struct tr_config *trcfg)
+{
+	struct htable_subsys_nqn_iter it;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c;
+
+	ctrl_index_update(h);
+
+	for (s = htable_subsys_nqn_getfirst(&ctrl_index.ht, trcfg->subsysnqn, &it);
+	     s;
+	     s = htable_subsys_nqn_getnext(&ctrl_index.ht, trcfg->subsysnqn, &it)) {
+		c = nvme_ctrl_find(s,
+				   trcfg->transport,
+				   trcfg->traddr,
+				   trcfg->trsvcid,
+				   trcfg->subsysnqn,
+				   trcfg->host_traddr,
+				   trcfg->host_iface);
+		if (c)
+			return c;
+	}
+
+	return NULL;
+}
+
 nvme_ctrl_t lookup_ctrl(nvme_host_t h, struct tr_config *trcfg)
 {
 	nvme_subsystem_t s;
 	nvme_ctrl_t c;
 
+	/* a controller of another subsystem NQN never matches */
+	if (ctrl_index.enabled && trcfg->subsysnqn)
+		return lookup_ctrl_indexed(h, trcfg);
+
 	nvme_for_each_subsystem(h, s) {
 		c = nvme_ctrl_find(s,
 				   trcfg->transport,
@@ -261,466 +374,1885 @@ static void save_discovery_log(char *raw, struct nvmf_discovery_log *log)
 
 static int __discover(nvme_ctrl_t c, struct nvme_fabrics_config *defcfg,
 		      char *raw, bool connect, bool persistent,
-		      enum nvme_print_flags flags)
+		      enum nvme_print_flags flags);
+
+/* Already connected or not reachable with @transport */
+static bool skip_disc_entry(const char *transport, nvme_host_t h,
+			    struct nvmf_disc_log_entry *e,
+			    struct nvme_fabrics_config *defcfg)
 {
-	struct nvmf_discovery_log *log = NULL;
-	nvme_subsystem_t s = nvme_ctrl_get_subsystem(c);
-	nvme_host_t h = nvme_subsystem_get_host(s);
-	uint64_t numrec;
+	nvme_ctrl_t cl;
 
-	struct nvme_get_discovery_args args = {
-		.c = c,
-		.args_size = sizeof(args),
-		.max_retries = MAX_DISC_RETRIES,
-		.result = 0,
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
-		.lsp = 0,
+	struct tr_config trcfg = {
+		.subsysnqn	= e->subnqn,
+		.transport	= nvmf_trtype_str(e->trtype),
+		.traddr		= e->traddr,
+		.host_traddr	= defcfg->host_traddr,
+		.host_iface	= defcfg->host_iface,
+		.trsvcid	= e->trsvcid,
 	};
 
-	log = nvmf_get_discovery_wargs(&args);
-	if (!log) {
-		fprintf(stderr, "failed to get discovery log: %s\n",
-			nvme_strerror(errno));
-		return -errno;
-	}
-
-	numrec = le64_to_cpu(log->numrec);
-	if (raw)
-		save_discovery_log(raw, log);
-	else if (!connect) {
-		nvme_show_discovery_log(log, numrec, flags);
-	} else if (connect) {
-		int i;
+	cl = lookup_ctrl(h, &trcfg);
+	if (cl && nvme_ctrl_get_name(cl))
+		return true;
 
-		for (i = 0; i < numrec; i++) {
-			struct nvmf_disc_log_entry *e = &log->entries[i];
-			nvme_ctrl_t cl;
-			bool discover = false;
-			bool disconnect;
-			nvme_ctrl_t child;
-			int tmo = defcfg->keep_alive_tmo;
+	/* Skip connect if the transport types don't match */
+	if (strcmp(transport, nvmf_trtype_str(e->trtype)))
+		return true;
 
-			struct tr_config trcfg = {
-				.subsysnqn	= e->subnqn,
-				.transport	= nvmf_trtype_str(e->trtype),
-				.traddr		= e->traddr,
-				.host_traddr	= defcfg->host_traddr,
-				.host_iface	= defcfg->host_iface,
-				.trsvcid	= e->trsvcid,
-			};
+	/* Does this discovery controller return the same information? */
+	if ((e->subtype == NVME_NQN_DISC || e->subtype == NVME_NQN_CURR) &&
+	    le16_to_cpu(e->eflags) & NVMF_DISC_EFLAGS_DUPRETINFO)
+		return true;
 
-			/* Already connected ? */
-			cl = lookup_ctrl(h, &trcfg);
-			if (cl && nvme_ctrl_get_name(cl))
-				continue;
+	return false;
+}
 
-			/* Skip connect if the transport types don't match */
-			if (strcmp(nvme_ctrl_get_transport(c),
-				   nvmf_trtype_str(e->trtype)))
-				continue;
+static void connect_disc_entry(nvme_host_t h, struct nvmf_disc_log_entry *e,
+			       struct nvme_fabrics_config *defcfg, char *raw,
+			       bool persistent, enum nvme_print_flags flags)
+{
+	bool discover = false;
+	bool disconnect;
+	nvme_ctrl_t child;
+	int tmo = defcfg->keep_alive_tmo;
 
-			if (e->subtype == NVME_NQN_DISC ||
-			    e->subtype == NVME_NQN_CURR) {
-				__u16 eflags = le16_to_cpu(e->eflags);
-				/*
-				 * Does this discovery controller return the
-				 * same information?
-				 */
-				if (eflags & NVMF_DISC_EFLAGS_DUPRETINFO)
-					continue;
+	if (e->subtype == NVME_NQN_DISC ||
+	    e->subtype == NVME_NQN_CURR) {
+		__u16 eflags = le16_to_cpu(e->eflags);
 
-				/* Are we supposed to keep the discovery controller around? */
-				disconnect = !persistent;
-
-				if (strcmp(e->subnqn, NVME_DISC_SUBSYS_NAME)) {
-					/*
-					 * Does this discovery controller doesn't
-					 * support explicit persistent connection?
-					 */
-					if (!(eflags & NVMF_DISC_EFLAGS_EPCSD))
-						disconnect = true;
-					else
-						disconnect = false;
-				}
+		/* Are we supposed to keep the discovery controller around? */
+		disconnect = !persistent;
 
-				set_discovery_kato(defcfg);
-			} else {
-				/* NVME_NQN_NVME */
+		if (strcmp(e->subnqn, NVME_DISC_SUBSYS_NAME)) {
+			/*
+			 * Does this discovery controller doesn't
+			 * support explicit persistent connection?
+			 */
+			if (!(eflags & NVMF_DISC_EFLAGS_EPCSD))
+				disconnect = true;
+			else
 				disconnect = false;
-			}
+		}
 
-			errno = 0;
-			child = nvmf_connect_disc_entry(h, e, defcfg,
-							&discover);
+		set_discovery_kato(defcfg);
+	} else {
+		/* NVME_NQN_NVME */
+		disconnect = false;
+	}
 
-			defcfg->keep_alive_tmo = tmo;
+	errno = 0;
+	child = nvmf_connect_disc_entry(h, e, defcfg, &discover);
 
-			if (child) {
-				if (discover)
-					__discover(child, defcfg, raw,
-						   true, persistent, flags);
+	defcfg->keep_alive_tmo = tmo;
 
-				if (disconnect) {
-					nvme_disconnect_ctrl(child);
-					nvme_free_ctrl(child);
-				}
-			} else if (errno == ENVME_CONNECT_ALREADY && !quiet) {
-				char *traddr = log->entries[i].traddr;
+	if (child) {
+		if (discover)
+			__discover(child, defcfg, raw, true, persistent, flags);
 
-				fprintf(stderr,
-					"traddr=%s is already connected\n",
-					traddr);
-			}
+		if (disconnect) {
+			nvme_disconnect_ctrl(child);
+			nvme_free_ctrl(child);
 		}
+	} else if (errno == ENVME_CONNECT_ALREADY && !quiet) {
+		fprintf(stderr, "traddr=%s is already connected\n", e->traddr);
 	}
+}
 
-	free(log);
-	return 0;
+/* a child of nvmf_run_forked(), its stdout and stderr read from pipes */
+struct forked_child {
+	pid_t pid;
+	int fd[2];
+	char *buf[2];
+	size_t len[2];
+	size_t size[2];
+	bool done;
+};
+
+static void forked_child_flush(struct forked_child *c)
+{
+	FILE *to[2] = { stdout, stderr };
+	int j;
+
+	for (j = 0; j < 2; j++) {
+		if (c->len[j])
+			fwrite(c->buf[j], 1, c->len[j], to[j]);
+		free(c->buf[j]);
+		c->buf[j] = NULL;
+	}
+	fflush(stdout);
+	fflush(stderr);
 }
 
-static char *get_default_trsvcid(const char *transport,
-				 bool discovery_ctrl)
+/* appends what is in stream @j of @c, closes it at EOF or on errors */
+static void forked_child_read(struct forked_child *c, int j)
 {
-	if (!transport)
-		return NULL;
-	if (!strcmp(transport, "tcp")) {
-		if (discovery_ctrl)
-			/* Default port for NVMe/TCP discovery controllers */
-			return stringify(NVME_DISC_IP_PORT);
-		/* Default port for NVMe/TCP io controllers */
-		return stringify(NVME_RDMA_IP_PORT);
-	} else if (!strcmp(transport, "rdma")) {
-		/* Default port for NVMe/RDMA controllers */
-		return stringify(NVME_RDMA_IP_PORT);
+	char *buf;
+	ssize_t n;
+
+	if (c->size[j] - c->len[j] < 4096) {
+		buf = realloc(c->buf[j], max(2 * c->size[j], c->len[j] + 4096));
+		if (!buf) {
+			close(c->fd[j]);
+			c->fd[j] = -1;
+			return;
+		}
+		c->buf[j] = buf;
+		c->size[j] = max(2 * c->size[j], c->len[j] + 4096);
 	}
 
-	return NULL;
+	n = read(c->fd[j], c->buf[j] + c->len[j], 4096);
+	if (n < 0 && errno == EINTR)
+		return;
+	if (n <= 0) {
+		close(c->fd[j]);
+		c->fd[j] = -1;
+		return;
+	}
+	c->len[j] += n;
 }
 
-static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
-				   const char *desc, bool connect,
-				   const struct nvme_fabrics_config *defcfg)
+/* kills a child still running, returns its wait status */
+static int forked_child_kill(struct forked_child *c)
 {
-	char *transport = NULL, *traddr = NULL, *trsvcid = NULL;
-	char *hostnqn = NULL, *hostid = NULL, *hostkey = NULL;
-	char *subsysnqn = NULL;
-	char *ptr, **argv, *p, line[4096];
-	int argc, ret = 0;
-	unsigned int verbose = 0;
-	FILE *f;
-	enum nvme_print_flags flags;
-	char *format = "normal";
-	struct nvme_fabrics_config cfg;
-	bool force = false;
+	int st, j;
 
-	NVMF_ARGS(opts, cfg,
-		  OPT_FMT("output-format", 'o', &format,     output_format),
-		  OPT_FILE("raw",          'r', &raw,        "save raw output to file"),
-		  OPT_FLAG("persistent",   'p', &persistent, "persistent discovery connection"),
-		  OPT_FLAG("quiet",        'S', &quiet,      "suppress already connected errors"),
-		  OPT_INCR("verbose",      'v', &verbose,    "Increase logging verbosity"),
-		  OPT_FLAG("force",          0, &force,      "Force persistent discovery controller creation"));
+	kill(c->pid, SIGKILL);
+	for (j = 0; j < 2; j++) {
+		if (c->fd[j] >= 0)
+			close(c->fd[j]);
+		c->fd[j] = -1;
+	}
+	while (waitpid(c->pid, &st, 0) < 0 && errno == EINTR)
+		;
+	c->done = true;
 
-	nvmf_default_config(&cfg);
+	return st;
+}
 
-	ret = validate_output_format(format, &flags);
-	if (ret < 0) {
-		nvme_show_error("Invalid output format");
-		return ret;
+/* forks child @i, returns -1 with errno set if it couldn't be */
+static int forked_child_start(struct forked_child *c, unsigned int i,
+			      int (*fn)(void *arg, unsigned int i), void *arg)
+{
+	int out[2], err[2], st;
+
+	if (pipe(out))
+		return -1;
+	if (pipe(err)) {
+		st = errno;
+		close(out[0]);
+		close(out[1]);
+		errno = st;
+		return -1;
 	}
 
-	f = fopen(PATH_NVMF_DISC, "r");
-	if (f == NULL) {
-		fprintf(stderr, "No params given and no %s\n", PATH_NVMF_DISC);
-		errno = ENOENT;
+	fflush(stdout);
+	fflush(stderr);
+	c->pid = fork();
+	if (!c->pid) {
+		close(out[0]);
+		close(err[0]);
+		dup2(out[1], STDOUT_FILENO);
+		dup2(err[1], STDERR_FILENO);
+		st = fn(arg, i);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(st);
+	}
+
+	st = errno;
+	close(out[1]);
+	close(err[1]);
+	if (c->pid < 0) {
+		close(out[0]);
+		close(err[0]);
+		errno = st;
 		return -1;
 	}
+	c->fd[0] = out[0];
+	c->fd[1] = err[0];
 
-	argv = calloc(MAX_DISC_ARGS, sizeof(char *));
-	if (!argv) {
-		ret = -1;
-		goto out;
+	return 0;
+}
+
+int nvmf_run_forked(unsigned int nr, unsigned int nr_parallel,
+		    int (*fn)(void *arg, unsigned int i), void *arg,
+		    int *status)
+{
+	unsigned int i, n, next = 0, flushed = 0, running = 0;
+	struct forked_child *c;
+	struct pollfd *pfd;
+	int st, j, err = 0;
+
+	c = calloc(nr, sizeof(*c));
+	pfd = calloc(2 * max(nr_parallel, 1U), sizeof(*pfd));
+	if (!c || !pfd) {
+		free(c);
+		free(pfd);
+		return -ENOMEM;
 	}
 
-	argv[0] = "discover";
-	memset(line, 0, sizeof(line));
-	while (fgets(line, sizeof(line), f) != NULL) {
-		nvme_ctrl_t c;
+	while (flushed < nr) {
+		while (next < nr && running < nr_parallel) {
+			if (!forked_child_start(&c[next], next, fn, arg)) {
+				running++;
+				next++;
+				continue;
+			}
+			if (running)
+				break;
 
-		if (line[0] == '#' || line[0] == '\n')
-			continue;
+			/*
+			 * Nothing else runs and everything before is printed,
+			 * so doing it here keeps the output in order.
+			 */
+			fprintf(stderr, "failed to fork: %s\n", strerror(errno));
+			st = fn(arg, next);
+			fflush(stdout);
+			fflush(stderr);
+			if (status)
+				status[next] = W_EXITCODE(st & 0xff, 0);
+			c[next++].done = true;
+			flushed++;
+		}
 
-		argc = 1;
-		p = line;
-		while ((ptr = strsep(&p, " =\n")) != NULL)
-			argv[argc++] = ptr;
-		argv[argc] = NULL;
+		for (i = flushed, n = 0; i < next; i++)
+			for (j = 0; j < 2; j++)
+				if (!c[i].done && c[i].fd[j] >= 0) {
+					pfd[n].fd = c[i].fd[j];
+					pfd[n++].events = POLLIN;
+				}
+		if (n && poll(pfd, n, -1) < 0 && errno != EINTR) {
+			err = -errno;
+			break;
+		}
 
-		memcpy(&cfg, defcfg, sizeof(cfg));
-		subsysnqn = NVME_DISC_SUBSYS_NAME;
-		ret = argconfig_parse(argc, argv, desc, opts);
-		if (ret)
-			goto next;
-		if (!transport && !traddr)
-			goto next;
+		for (i = flushed, n = 0; i < next; i++) {
+			if (c[i].done)
+				continue;
+			for (j = 0; j < 2; j++)
+				if (c[i].fd[j] >= 0 && pfd[n++].revents)
+					forked_child_read(&c[i], j);
+			if (c[i].fd[0] >= 0 || c[i].fd[1] >= 0)
+				continue;
 
-		if (!trsvcid)
-			trsvcid = get_default_trsvcid(transport, true);
+			/* both streams hit EOF, it's about to exit */
+			while (waitpid(c[i].pid, &st, 0) < 0 && errno == EINTR)
+				;
+			if (status)
+				status[i] = st;
+			c[i].done = true;
+			running--;
+		}
 
-		struct tr_config trcfg = {
-			.subsysnqn	= subsysnqn,
-			.transport	= transport,
-			.traddr		= traddr,
-			.host_traddr	= cfg.host_traddr,
-			.host_iface	= cfg.host_iface,
-			.trsvcid	= trsvcid,
-		};
+		for (; flushed < next && c[flushed].done; flushed++)
+			forked_child_flush(&c[flushed]);
+	}
 
-		if (!force) {
-			c = lookup_ctrl(h, &trcfg);
-			if (c) {
-				__discover(c, &cfg, raw, connect,
-					   true, flags);
-				goto next;
-			}
+	/* poll() failed, stop the children still running and fail the rest */
+	for (i = flushed; err && i < nr; i++) {
+		if (!c[i].done) {
+			if (i < next)
+				st = forked_child_kill(&c[i]);
+			else
+				st = W_EXITCODE(EXIT_FAILURE, 0);
+			if (status)
+				status[i] = st;
 		}
+		if (i < next)
+			forked_child_flush(&c[i]);
+	}
 
-		c = create_discover_ctrl(r, h, &cfg, &trcfg);
-		if (!c)
-			goto next;
+	free(pfd);
+	free(c);
+	return err;
+}
 
-		__discover(c, &cfg, raw, connect, persistent, flags);
-		if (!(persistent || is_persistent_discovery_ctrl(h, c)))
-			ret = nvme_disconnect_ctrl(c);
-		nvme_free_ctrl(c);
+struct connect_disc_ctx {
+	nvme_host_t h;
+	struct nvmf_disc_log_entry **entries;
+	struct nvme_fabrics_config *defcfg;
+	char *raw;
+	bool persistent;
+	enum nvme_print_flags flags;
+};
 
-next:
-		memset(&cfg, 0, sizeof(cfg));
-	}
-	free(argv);
-out:
-	fclose(f);
-	return ret;
+static int connect_disc_entry_fn(void *arg, unsigned int i)
+{
+	struct connect_disc_ctx *ctx = arg;
+
+	connect_disc_entry(ctx->h, ctx->entries[i], ctx->defcfg, ctx->raw,
+			   ctx->persistent, ctx->flags);
+	return 0;
 }
 
-static int discover_from_json_config_file(nvme_root_t r, nvme_host_t h,
-					  const char *desc, bool connect,
-					  const struct nvme_fabrics_config *defcfg,
-					  enum nvme_print_flags flags,
-					  bool force)
+/* Connects up to nr_parallel entries at once, see nvmf_run_forked() */
+static void connect_disc_entries_parallel(const char *transport,
+					  nvme_host_t h,
+					  struct nvmf_disc_log_entry *entries,
+					  uint64_t numrec,
+					  struct nvme_fabrics_config *defcfg,
+					  char *raw, bool persistent,
+					  enum nvme_print_flags flags)
 {
-	const char *transport, *traddr, *host_traddr, *host_iface, *trsvcid, *subsysnqn;
-	nvme_subsystem_t s;
-	nvme_ctrl_t c, cn;
-	struct nvme_fabrics_config cfg;
-	int ret = 0;
+	struct connect_disc_ctx ctx = {
+		.h		= h,
+		.defcfg		= defcfg,
+		.raw		= raw,
+		.persistent	= persistent,
+		.flags		= flags,
+	};
+	unsigned int nr = 0;
+	uint64_t i;
 
-	nvme_for_each_subsystem(h, s) {
-		nvme_subsystem_for_each_ctrl(s, c) {
-			transport = nvme_ctrl_get_transport(c);
-			traddr = nvme_ctrl_get_traddr(c);
-			host_traddr = nvme_ctrl_get_host_traddr(c);
-			host_iface = nvme_ctrl_get_host_iface(c);
+	ctx.entries = calloc(numrec, sizeof(*ctx.entries));
+	if (!ctx.entries)
+		return;
 
-			if (!transport && !traddr)
-				continue;
+	for (i = 0; i < numrec; i++)
+		if (!skip_disc_entry(transport, h, &entries[i], defcfg))
+			ctx.entries[nr++] = &entries[i];
 
-			/* ignore none fabric transports */
-			if (strcmp(transport, "tcp") &&
-			    strcmp(transport, "rdma") &&
-			    strcmp(transport, "fc"))
-				continue;
+	nvmf_run_forked(nr, nr_parallel, connect_disc_entry_fn, &ctx, NULL);
+	free(ctx.entries);
+}
 
-			/* ignore if no host_traddr for fc */
-			if (!strcmp(transport, "fc")) {
-				if (!host_traddr) {
-					fprintf(stderr, "host_traddr required for fc\n");
-					continue;
-				}
-			}
+static void connect_disc_entries(const char *transport, nvme_host_t h,
+				 struct nvmf_disc_log_entry *entries,
+				 uint64_t numrec,
+				 struct nvme_fabrics_config *defcfg,
+				 char *raw, bool persistent,
+				 enum nvme_print_flags flags)
+{
+	uint64_t i;
 
-			/* ignore if host_iface set for any transport other than tcp */
-			if (!strcmp(transport, "rdma") || !strcmp(transport, "fc")) {
-				if (host_iface) {
-					fprintf(stderr, "host_iface not permitted for rdma or fc\n");
-					continue;
-				}
-			}
+	if (nr_parallel > 1) {
+		connect_disc_entries_parallel(transport, h, entries, numrec,
+					      defcfg, raw, persistent, flags);
+		return;
+	}
 
-			trsvcid = nvme_ctrl_get_trsvcid(c);
-			if (!trsvcid || !strcmp(trsvcid, ""))
-				trsvcid = get_default_trsvcid(transport, true);
+	for (i = 0; i < numrec; i++) {
+		struct nvmf_disc_log_entry *e = &entries[i];
 
-			if (force)
-				subsysnqn = nvme_ctrl_get_subsysnqn(c);
-			else
-				subsysnqn = NVME_DISC_SUBSYS_NAME;
+		if (!skip_disc_entry(transport, h, e, defcfg))
+			connect_disc_entry(h, e, defcfg, raw, persistent,
+					   flags);
+	}
+}
 
-			if (nvme_ctrl_is_persistent(c))
-				persistent = true;
+/*
+ * Opt-in cache of discovery log pages, enabled by setting NVME_DISC_CACHE
+ * to a directory, or to an empty string for the default one. An entry is
+ * keyed by the transport address of the discovery controller and the host,
+ * and is used as long as the generation counter and the number of records
+ * in the log page header are unchanged, so a cache hit only transfers the
+ * 1k header instead of the full log.
+ */
+#define DISC_CACHE_DIR		RUNDIR "/nvme-cli/disc-cache"
+#define DISC_CACHE_KEY_LEN	1024
 
-			memcpy(&cfg, defcfg, sizeof(cfg));
+struct disc_cache {
+	char path[PATH_MAX];
+	char key[DISC_CACHE_KEY_LEN];
+};
 
-			struct tr_config trcfg = {
-				.subsysnqn	= subsysnqn,
-				.transport	= transport,
-				.traddr		= traddr,
-				.host_traddr	= host_traddr,
-				.host_iface	= host_iface,
-				.trsvcid	= trsvcid,
-			};
+static bool disc_cache_init(nvme_ctrl_t c, struct disc_cache *dc)
+{
+	nvme_host_t h = nvme_subsystem_get_host(nvme_ctrl_get_subsystem(c));
+	const char *base = getenv("NVME_DISC_CACHE");
+	char dir[PATH_MAX];
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	if (!base)
+		return false;
+	if (!*base)
+		base = DISC_CACHE_DIR;
+
+	snprintf(dir, sizeof(dir), "%s", base);
+	if (cache_dir_init(dir))
+		return false;
+
+	memset(dc->key, 0, sizeof(dc->key));
+	if (snprintf(dc->key, sizeof(dc->key), "%s\n%s\n%s\n%s\n%s\n%s\n%s\n",
+		     nvme_ctrl_get_transport(c) ?: "",
+		     nvme_ctrl_get_traddr(c) ?: "",
+		     nvme_ctrl_get_trsvcid(c) ?: "",
+		     nvme_ctrl_get_host_traddr(c) ?: "",
+		     nvme_ctrl_get_host_iface(c) ?: "",
+		     nvme_ctrl_get_subsysnqn(c) ?: "",
+		     nvme_host_get_hostnqn(h) ?: "") >= (int)sizeof(dc->key))
+		return false;
+
+	/* FNV-1a of the key names the entry, the key itself is verified */
+	for (i = 0; dc->key[i]; i++)
+		hash = (hash ^ (unsigned char)dc->key[i]) * 0x100000001b3ULL;
+
+	return snprintf(dc->path, sizeof(dc->path), "%s/%016" PRIx64, dir,
+			hash) < (int)sizeof(dc->path);
+}
 
-			if (!force) {
-				cn = lookup_ctrl(h, &trcfg);
-				if (cn) {
-					__discover(cn, &cfg, raw, connect,
-						   true, flags);
-					continue;
-				}
-			}
+static struct nvmf_discovery_log *disc_cache_lookup(nvme_ctrl_t c,
+						    struct disc_cache *dc)
+{
+	_cleanup_free_ struct nvmf_discovery_log *hdr = NULL;
+	struct nvmf_discovery_log *log;
+	size_t len;
 
-			cn = create_discover_ctrl(r, h, &cfg, &trcfg);
-			if (!cn)
-				continue;
+	log = cache_read_alloc(dc->path, dc->key, sizeof(dc->key), &len);
+	if (!log)
+		return NULL;
+	if (len < sizeof(*log) ||
+	    len != sizeof(*log) + le64_to_cpu(log->numrec) * sizeof(log->entries[0]))
+		goto miss;
 
-			__discover(cn, &cfg, raw, connect, persistent, flags);
-			if (!(persistent || is_persistent_discovery_ctrl(h, cn)))
-				ret = nvme_disconnect_ctrl(cn);
-			nvme_free_ctrl(cn);
-		}
+	hdr = nvme_alloc(sizeof(*hdr));
+	if (!hdr ||
+	    nvme_get_log_discovery(nvme_ctrl_get_fd(c), false, 0, sizeof(*hdr), hdr))
+		goto miss;
+
+	if (hdr->genctr == log->genctr && hdr->numrec == log->numrec)
+		return log;
+
+miss:
+	free(log);
+	return NULL;
+}
+
+static void disc_cache_store(struct disc_cache *dc,
+			     struct nvmf_discovery_log *log)
+{
+	cache_write(dc->path, dc->key, sizeof(dc->key), log,
+		    sizeof(*log) + le64_to_cpu(log->numrec) * sizeof(log->entries[0]));
+}
+
+static struct nvmf_discovery_log *get_discovery_log(nvme_ctrl_t c)
+{
+	struct nvmf_discovery_log *log;
+	struct disc_cache dc;
+	bool cache;
+
+	struct nvme_get_discovery_args args = {
+		.c = c,
+		.args_size = sizeof(args),
+		.max_retries = MAX_DISC_RETRIES,
+		.result = 0,
+		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lsp = 0,
+	};
+
+	cache = disc_cache_init(c, &dc);
+	if (cache) {
+		log = disc_cache_lookup(c, &dc);
+		if (log)
+			return log;
 	}
 
-	return ret;
+	log = nvmf_get_discovery_wargs(&args);
+	if (!log)
+		fprintf(stderr, "failed to get discovery log: %s\n",
+			nvme_strerror(errno));
+	else if (cache)
+		disc_cache_store(&dc, log);
+
+	return log;
 }
 
-static int nvme_read_volatile_config(nvme_root_t r)
+static int __discover(nvme_ctrl_t c, struct nvme_fabrics_config *defcfg,
+		      char *raw, bool connect, bool persistent,
+		      enum nvme_print_flags flags)
 {
-	char *filename, *ext;
-	struct dirent *dir;
-	DIR *d;
-	int ret = -ENOENT;
+	struct nvmf_discovery_log *log = NULL;
+	nvme_subsystem_t s = nvme_ctrl_get_subsystem(c);
+	nvme_host_t h = nvme_subsystem_get_host(s);
+	uint64_t numrec;
 
-	d = opendir(PATH_NVMF_RUNDIR);
-	if (!d)
-		return -ENOTDIR;
+	log = get_discovery_log(c);
+	if (!log)
+		return -errno;
 
-	while ((dir = readdir(d))) {
-		if (dir->d_type != DT_REG)
-			continue;
+	numrec = le64_to_cpu(log->numrec);
+	if (raw)
+		save_discovery_log(raw, log);
+	else if (!connect)
+		nvme_show_discovery_log(log, numrec, flags);
+	else
+		connect_disc_entries(nvme_ctrl_get_transport(c), h,
+				     log->entries, numrec, defcfg, raw,
+				     persistent, flags);
 
-		ext = strchr(dir->d_name, '.');
-		if (!ext || strcmp("json", ext + 1))
-			continue;
+	free(log);
+	return 0;
+}
 
-		if (asprintf(&filename, "%s/%s", PATH_NVMF_RUNDIR, dir->d_name) < 0) {
-			ret = -ENOMEM;
-			break;
-		}
+static char *get_default_trsvcid(const char *transport,
+				 bool discovery_ctrl)
+{
+	if (!transport)
+		return NULL;
+	if (!strcmp(transport, "tcp")) {
+		if (discovery_ctrl)
+			/* Default port for NVMe/TCP discovery controllers */
+			return stringify(NVME_DISC_IP_PORT);
+		/* Default port for NVMe/TCP io controllers */
+		return stringify(NVME_RDMA_IP_PORT);
+	} else if (!strcmp(transport, "rdma")) {
+		/* Default port for NVMe/RDMA controllers */
+		return stringify(NVME_RDMA_IP_PORT);
+	}
 
-		if (nvme_read_config(r, filename))
-			ret = 0;
+	return NULL;
+}
 
-		free(filename);
+/*
+ * With --parallel the discovery controllers of the configuration files are
+ * queried concurrently, each from a child process. After
+ * --discovery-timeout seconds an alarm flags the query as timed out: the
+ * child gives up once the command in progress returns, disconnects the
+ * controller it connected and exits with DISC_TIMED_OUT. The returned
+ * records are merged in configuration order with duplicates dropped, so
+ * one unreachable discovery controller does not delay the others.
+ */
+struct disc_target {
+	struct nvme_fabrics_config cfg;
+	struct tr_config trcfg;
+	char *strs[8];
+	nvme_ctrl_t c;		/* existing discovery controller */
+	bool persistent;
+	FILE *log;
+	int status;
+	uint64_t first;		/* merged records of this target */
+	uint64_t nr;
+};
+
+struct disc_targets {
+	struct disc_target *t;
+	unsigned int nr;
+};
+
+static const char *disc_target_strdup(struct disc_target *t, int i,
+				      const char *str, bool *oom)
+{
+	if (!str)
+		return NULL;
+	t->strs[i] = strdup(str);
+	if (!t->strs[i])
+		*oom = true;
+	return t->strs[i];
+}
+
+static int disc_target_add(struct disc_targets *dt, nvme_host_t h,
+			   const struct nvme_fabrics_config *cfg,
+			   struct tr_config *trcfg, bool persistent,
+			   bool force)
+{
+	struct disc_target *t;
+	bool oom = false;
+
+	t = realloc(dt->t, (dt->nr + 1) * sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	dt->t = t;
+	t = &dt->t[dt->nr++];
+	memset(t, 0, sizeof(*t));
+
+	memcpy(&t->cfg, cfg, sizeof(t->cfg));
+	t->cfg.host_traddr = (char *)disc_target_strdup(t, 0, cfg->host_traddr, &oom);
+	t->cfg.host_iface = (char *)disc_target_strdup(t, 1, cfg->host_iface, &oom);
+	t->trcfg.subsysnqn = disc_target_strdup(t, 2, trcfg->subsysnqn, &oom);
+	t->trcfg.transport = disc_target_strdup(t, 3, trcfg->transport, &oom);
+	t->trcfg.traddr = disc_target_strdup(t, 4, trcfg->traddr, &oom);
+	t->trcfg.trsvcid = disc_target_strdup(t, 5, trcfg->trsvcid, &oom);
+	t->trcfg.host_traddr = disc_target_strdup(t, 6, trcfg->host_traddr, &oom);
+	t->trcfg.host_iface = disc_target_strdup(t, 7, trcfg->host_iface, &oom);
+	t->persistent = persistent;
+	if (oom)
+		return -ENOMEM;
+
+	if (!force)
+		t->c = lookup_ctrl(h, &t->trcfg);
+	if (t->c)
+		t->persistent = true;
+
+	return 0;
+}
+
+static void disc_targets_free(struct disc_targets *dt)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < dt->nr; i++) {
+		for (j = 0; j < ARRAY_SIZE(dt->t[i].strs); j++)
+			free(dt->t[i].strs[j]);
+		if (dt->t[i].log)
+			fclose(dt->t[i].log);
 	}
-	closedir(d);
+	free(dt->t);
+}
+
+/* exit status of a discovery query running past --discovery-timeout */
+#define DISC_TIMED_OUT		124
+
+static volatile sig_atomic_t disc_timed_out;
+
+static void disc_timeout_alarm(int sig)
+{
+	disc_timed_out = 1;
+}
+
+/*
+ * Runs in the child, the log is handed back through t->log. The alarm
+ * interrupts what can be interrupted, the query then stops once the
+ * command in progress returns, disconnecting the controller it connected.
+ */
+static int disc_target_query(nvme_root_t r, nvme_host_t h,
+			     struct disc_target *t)
+{
+	struct sigaction sa = { .sa_handler = disc_timeout_alarm };
+	struct nvmf_discovery_log *log = NULL;
+	nvme_ctrl_t c = t->c;
+	size_t len;
+	int ret = 0;
+
+	if (disc_timeout) {
+		disc_timed_out = 0;
+		sigaction(SIGALRM, &sa, NULL);
+		alarm(disc_timeout);
+	}
+
+	if (!c)
+		c = create_discover_ctrl(r, h, &t->cfg, &t->trcfg);
+	if (!c) {
+		ret = 1;
+		goto out;
+	}
+
+	if (!disc_timed_out)
+		log = get_discovery_log(c);
+	if (log && !disc_timed_out) {
+		len = sizeof(*log) +
+			le64_to_cpu(log->numrec) * sizeof(log->entries[0]);
+		if (fwrite(log, 1, len, t->log) != len || fflush(t->log))
+			ret = 1;
+	} else {
+		ret = 1;
+	}
+	free(log);
+
+	if (!t->c && (disc_timed_out ||
+		      !(t->persistent || is_persistent_discovery_ctrl(h, c))))
+		nvme_disconnect_ctrl(c);
+
+out:
+	if (disc_timeout) {
+		alarm(0);
+		signal(SIGALRM, SIG_DFL);
+	}
+	return disc_timed_out ? DISC_TIMED_OUT : ret;
+}
+
+struct disc_targets_ctx {
+	nvme_root_t r;
+	nvme_host_t h;
+	struct disc_targets *dt;
+};
+
+static int disc_target_query_fn(void *arg, unsigned int i)
+{
+	struct disc_targets_ctx *ctx = arg;
+
+	return disc_target_query(ctx->r, ctx->h, &ctx->dt->t[i]);
+}
+
+static int disc_targets_query(nvme_root_t r, nvme_host_t h,
+			      struct disc_targets *dt)
+{
+	struct disc_targets_ctx ctx = { .r = r, .h = h, .dt = dt };
+	_cleanup_free_ int *status = NULL;
+	unsigned int i;
+	int ret;
+
+	status = calloc(dt->nr, sizeof(*status));
+	if (!status)
+		return -ENOMEM;
+
+	for (i = 0; i < dt->nr; i++) {
+		dt->t[i].log = tmpfile();
+		if (!dt->t[i].log)
+			return -errno;
+	}
+
+	ret = nvmf_run_forked(dt->nr, nr_parallel, disc_target_query_fn, &ctx,
+			      status);
+	for (i = 0; i < dt->nr; i++)
+		dt->t[i].status = status[i];
 
 	return ret;
 }
 
-char *nvmf_hostid_from_hostnqn(const char *hostnqn)
+static bool disc_entry_equal(struct nvmf_disc_log_entry *a,
+			     struct nvmf_disc_log_entry *b)
 {
-	const char *uuid;
+	return a->trtype == b->trtype &&
+		!strncmp(a->subnqn, b->subnqn, sizeof(a->subnqn)) &&
+		!strncmp(a->traddr, b->traddr, sizeof(a->traddr)) &&
+		!strncmp(a->trsvcid, b->trsvcid, sizeof(a->trsvcid));
+}
 
-	if (!hostnqn)
-		return NULL;
+/*
+ * Appends the records of @t to @merged, skipping the ones already reported
+ * by an earlier target and, when connecting, the ones with a different
+ * transport than the discovery controller's.
+ */
+static int disc_target_merge(struct disc_target *t, bool connect,
+			     struct nvmf_discovery_log **merged,
+			     uint64_t *nr)
+{
+	struct nvmf_discovery_log hdr, *m = *merged;
+	struct nvmf_disc_log_entry e;
+	uint64_t i, j, numrec;
+
+	t->first = *nr;
+	t->nr = 0;
+	rewind(t->log);
+	if (fread(&hdr, sizeof(hdr), 1, t->log) != 1)
+		return 0;
+
+	numrec = le64_to_cpu(hdr.numrec);
+	for (i = 0; i < numrec; i++) {
+		if (fread(&e, sizeof(e), 1, t->log) != 1)
+			break;
 
-	uuid = strstr(hostnqn, "uuid:");
-	if (!uuid)
-		return NULL;
+		if (connect && strcmp(t->trcfg.transport,
+				      nvmf_trtype_str(e.trtype)))
+			continue;
 
-	return strdup(uuid + strlen("uuid:"));
+		for (j = 0; j < *nr; j++)
+			if (disc_entry_equal(&m->entries[j], &e))
+				break;
+		if (j < *nr)
+			continue;
+
+		m = realloc(m, sizeof(*m) + (*nr + 1) * sizeof(e));
+		if (!m) {
+			t->nr = *nr - t->first;
+			return -ENOMEM;
+		}
+		if (!*merged)
+			memcpy(m, &hdr, sizeof(hdr));
+		*merged = m;
+		m->entries[(*nr)++] = e;
+	}
+	t->nr = *nr - t->first;
+
+	return 0;
 }
 
-void nvmf_check_hostid_and_hostnqn(const char *hostid, const char *hostnqn, unsigned int verbose)
+static int discover_targets(nvme_root_t r, nvme_host_t h,
+			    struct disc_targets *dt, bool connect,
+			    enum nvme_print_flags flags)
 {
-	_cleanup_free_ char *hostid_from_hostnqn = NULL;
+	struct nvmf_discovery_log *merged = NULL;
+	uint64_t nr = 0;
+	unsigned int i;
+	int ret = 0, err;
 
-	if (!hostnqn || !hostid)
-		return;
+	ret = disc_targets_query(r, h, dt);
+	if (ret)
+		return ret;
 
-	hostid_from_hostnqn = nvmf_hostid_from_hostnqn(hostnqn);
-	if (hostid_from_hostnqn && strcmp(hostid_from_hostnqn, hostid)) {
-		if (verbose)
+	/* the records merged before a failure are still used */
+	for (i = 0; i < dt->nr; i++) {
+		struct disc_target *t = &dt->t[i];
+
+		t->first = nr;
+		t->nr = 0;
+		if (WIFEXITED(t->status) &&
+		    WEXITSTATUS(t->status) == DISC_TIMED_OUT) {
+			fprintf(stderr,
+				"discovery from traddr=%s timed out after %u seconds\n",
+				t->trcfg.traddr, disc_timeout);
+			continue;
+		}
+		if (!WIFEXITED(t->status) || WEXITSTATUS(t->status))
+			continue;
+
+		err = disc_target_merge(t, connect, &merged, &nr);
+		if (err && !ret)
+			ret = err;
+	}
+
+	if (!merged)
+		goto out;
+	merged->numrec = cpu_to_le64(nr);
+
+	if (raw)
+		save_discovery_log(raw, merged);
+	else if (!connect)
+		nvme_show_discovery_log(merged, nr, flags);
+	else
+		for (i = 0; i < dt->nr; i++)
+			connect_disc_entries(dt->t[i].trcfg.transport, h,
+					     &merged->entries[dt->t[i].first],
+					     dt->t[i].nr, &dt->t[i].cfg, raw,
+					     dt->t[i].persistent, flags);
+
+out:
+	free(merged);
+	return ret;
+}
+
+static int discover_from_conf_file(nvme_root_t r, nvme_host_t h,
+				   const char *desc, bool connect,
+				   const struct nvme_fabrics_config *defcfg)
+{
+	char *transport = NULL, *traddr = NULL, *trsvcid = NULL;
+	char *hostnqn = NULL, *hostid = NULL, *hostkey = NULL;
+	char *subsysnqn = NULL;
+	char *ptr, **argv, *p, line[4096];
+	int argc, ret = 0;
+	unsigned int verbose = 0;
+	FILE *f;
+	enum nvme_print_flags flags;
+	char *format = "normal";
+	struct nvme_fabrics_config cfg;
+	struct disc_targets dt = { 0 };
+	bool force = false;
+
+	NVMF_ARGS(opts, cfg,
+		  OPT_FMT("output-format", 'o', &format,     output_format),
+		  OPT_FILE("raw",          'r', &raw,        "save raw output to file"),
+		  OPT_FLAG("persistent",   'p', &persistent, "persistent discovery connection"),
+		  OPT_FLAG("quiet",        'S', &quiet,      "suppress already connected errors"),
+		  OPT_INCR("verbose",      'v', &verbose,    "Increase logging verbosity"),
+		  OPT_FLAG("force",          0, &force,      "Force persistent discovery controller creation"));
+
+	nvmf_default_config(&cfg);
+
+	ret = validate_output_format(format, &flags);
+	if (ret < 0) {
+		nvme_show_error("Invalid output format");
+		return ret;
+	}
+	nvme_set_json_output_mode(format);
+
+	f = fopen(PATH_NVMF_DISC, "r");
+	if (f == NULL) {
+		fprintf(stderr, "No params given and no %s\n", PATH_NVMF_DISC);
+		errno = ENOENT;
+		return -1;
+	}
+
+	argv = calloc(MAX_DISC_ARGS, sizeof(char *));
+	if (!argv) {
+		ret = -1;
+		goto out;
+	}
+
+	argv[0] = "discover";
+	memset(line, 0, sizeof(line));
+	while (fgets(line, sizeof(line), f) != NULL) {
+		nvme_ctrl_t c;
+
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		argc = 1;
+		p = line;
+		while ((ptr = strsep(&p, " =\n")) != NULL)
+			argv[argc++] = ptr;
+		argv[argc] = NULL;
+
+		memcpy(&cfg, defcfg, sizeof(cfg));
+		subsysnqn = NVME_DISC_SUBSYS_NAME;
+		ret = argconfig_parse(argc, argv, desc, opts);
+		if (ret)
+			goto next;
+		if (!transport && !traddr)
+			goto next;
+
+		if (!trsvcid)
+			trsvcid = get_default_trsvcid(transport, true);
+
+		struct tr_config trcfg = {
+			.subsysnqn	= subsysnqn,
+			.transport	= transport,
+			.traddr		= traddr,
+			.host_traddr	= cfg.host_traddr,
+			.host_iface	= cfg.host_iface,
+			.trsvcid	= trsvcid,
+		};
+
+		if (nr_parallel > 1) {
+			ret = disc_target_add(&dt, h, &cfg, &trcfg, persistent,
+					      force);
+			if (ret)
+				goto out_free;
+			goto next;
+		}
+
+		if (!force) {
+			c = lookup_ctrl(h, &trcfg);
+			if (c) {
+				__discover(c, &cfg, raw, connect,
+					   true, flags);
+				goto next;
+			}
+		}
+
+		c = create_discover_ctrl(r, h, &cfg, &trcfg);
+		if (!c)
+			goto next;
+
+		__discover(c, &cfg, raw, connect, persistent, flags);
+		if (!(persistent || is_persistent_discovery_ctrl(h, c)))
+			ret = nvme_disconnect_ctrl(c);
+		nvme_free_ctrl(c);
+
+next:
+		memset(&cfg, 0, sizeof(cfg));
+	}
+	if (dt.nr)
+		ret = discover_targets(r, h, &dt, connect, flags);
+out_free:
+	disc_targets_free(&dt);
+	free(argv);
+out:
+	fclose(f);
+	return ret;
+}
+
+static int discover_from_json_config_file(nvme_root_t r, nvme_host_t h,
+					  const char *desc, bool connect,
+					  const struct nvme_fabrics_config *defcfg,
+					  enum nvme_print_flags flags,
+					  bool force)
+{
+	const char *transport, *traddr, *host_traddr, *host_iface, *trsvcid, *subsysnqn;
+	nvme_subsystem_t s;
+	nvme_ctrl_t c, cn;
+	struct nvme_fabrics_config cfg;
+	struct disc_targets dt = { 0 };
+	int ret = 0;
+
+	nvme_for_each_subsystem(h, s) {
+		nvme_subsystem_for_each_ctrl(s, c) {
+			transport = nvme_ctrl_get_transport(c);
+			traddr = nvme_ctrl_get_traddr(c);
+			host_traddr = nvme_ctrl_get_host_traddr(c);
+			host_iface = nvme_ctrl_get_host_iface(c);
+
+			if (!transport && !traddr)
+				continue;
+
+			/* ignore none fabric transports */
+			if (strcmp(transport, "tcp") &&
+			    strcmp(transport, "rdma") &&
+			    strcmp(transport, "fc"))
+				continue;
+
+			/* ignore if no host_traddr for fc */
+			if (!strcmp(transport, "fc")) {
+				if (!host_traddr) {
+					fprintf(stderr, "host_traddr required for fc\n");
+					continue;
+				}
+			}
+
+			/* ignore if host_iface set for any transport other than tcp */
+			if (!strcmp(transport, "rdma") || !strcmp(transport, "fc")) {
+				if (host_iface) {
+					fprintf(stderr, "host_iface not permitted for rdma or fc\n");
+					continue;
+				}
+			}
+
+			trsvcid = nvme_ctrl_get_trsvcid(c);
+			if (!trsvcid || !strcmp(trsvcid, ""))
+				trsvcid = get_default_trsvcid(transport, true);
+
+			if (force)
+				subsysnqn = nvme_ctrl_get_subsysnqn(c);
+			else
+				subsysnqn = NVME_DISC_SUBSYS_NAME;
+
+			if (nvme_ctrl_is_persistent(c))
+				persistent = true;
+
+			memcpy(&cfg, defcfg, sizeof(cfg));
+
+			struct tr_config trcfg = {
+				.subsysnqn	= subsysnqn,
+				.transport	= transport,
+				.traddr		= traddr,
+				.host_traddr	= host_traddr,
+				.host_iface	= host_iface,
+				.trsvcid	= trsvcid,
+			};
+
+			if (nr_parallel > 1) {
+				ret = disc_target_add(&dt, h, &cfg, &trcfg,
+						      persistent, force);
+				if (ret)
+					goto out;
+				continue;
+			}
+
+			if (!force) {
+				cn = lookup_ctrl(h, &trcfg);
+				if (cn) {
+					__discover(cn, &cfg, raw, connect,
+						   true, flags);
+					continue;
+				}
+			}
+
+			cn = create_discover_ctrl(r, h, &cfg, &trcfg);
+			if (!cn)
+				continue;
+
+			__discover(cn, &cfg, raw, connect, persistent, flags);
+			if (!(persistent || is_persistent_discovery_ctrl(h, cn)))
+				ret = nvme_disconnect_ctrl(cn);
+			nvme_free_ctrl(cn);
+		}
+	}
+
+	if (dt.nr)
+		ret = discover_targets(r, h, &dt, connect, flags);
+out:
+	disc_targets_free(&dt);
+	return ret;
+}
+
+static bool volatile_config_name(struct dirent *dir)
+{
+	char *ext;
+
+	if (dir->d_type != DT_REG)
+		return false;
+
+	ext = strchr(dir->d_name, '.');
+	return ext && !strcmp("json", ext + 1);
+}
+
+static int nvme_read_volatile_files(nvme_root_t r)
+{
+	char *filename;
+	struct dirent *dir;
+	DIR *d;
+	int ret = -ENOENT;
+
+	d = opendir(PATH_NVMF_RUNDIR);
+	if (!d)
+		return -ENOTDIR;
+
+	while ((dir = readdir(d))) {
+		if (!volatile_config_name(dir))
+			continue;
+
+		if (asprintf(&filename, "%s/%s", PATH_NVMF_RUNDIR, dir->d_name) < 0) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		if (!nvme_read_config(r, filename))
+			ret = 0;
+
+		free(filename);
+	}
+	closedir(d);
+
+	return ret;
+}
+
+/*
+ * Opt-in cache merging the volatile configuration files into one, enabled
+ * by setting NVME_CONFIG_CACHE to a directory, or to an empty string for
+ * the default one. Every file is a JSON array of hosts, the merged file is
+ * the concatenation of their elements and is named after a hash of the
+ * names, inode numbers, sizes and modification times of the files, so
+ * adding, removing or rewriting any of them is noticed with a stat each
+ * instead of parsing them all.
+ */
+#define CONFIG_CACHE_DIR	RUNDIR "/nvme-cli/config-cache"
+#define CONFIG_CACHE_PREFIX	"volatile-"
+
+struct volatile_files {
+	char **names;
+	int nr;
+	uint64_t hash;
+};
+
+static void volatile_files_free(struct volatile_files *vf)
+{
+	int i;
+
+	for (i = 0; i < vf->nr; i++)
+		free(vf->names[i]);
+	free(vf->names);
+}
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--)
+		hash = (hash ^ *p++) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static int volatile_files_scan(struct volatile_files *vf)
+{
+	struct dirent *dir;
+	struct stat st;
+	uint64_t h;
+	char **names;
+	DIR *d;
+	int ret = 0;
+
+	memset(vf, 0, sizeof(*vf));
+
+	d = opendir(PATH_NVMF_RUNDIR);
+	if (!d)
+		return -ENOTDIR;
+
+	while ((dir = readdir(d))) {
+		if (!volatile_config_name(dir) ||
+		    fstatat(dirfd(d), dir->d_name, &st, 0))
+			continue;
+
+		names = realloc(vf->names, (vf->nr + 1) * sizeof(*names));
+		if (!names) {
+			ret = -ENOMEM;
+			break;
+		}
+		vf->names = names;
+		vf->names[vf->nr] = strdup(dir->d_name);
+		if (!vf->names[vf->nr]) {
+			ret = -ENOMEM;
+			break;
+		}
+		vf->nr++;
+
+		/* summed, so the order of readdir doesn't matter */
+		h = fnv1a(0xcbf29ce484222325ULL, dir->d_name, strlen(dir->d_name) + 1);
+		h = fnv1a(h, &st.st_ino, sizeof(st.st_ino));
+		h = fnv1a(h, &st.st_size, sizeof(st.st_size));
+		h = fnv1a(h, &st.st_mtim, sizeof(st.st_mtim));
+		vf->hash += h;
+	}
+	closedir(d);
+
+	if (ret)
+		volatile_files_free(vf);
+
+	return ret;
+}
+
+/* append the elements of the array in the file @name to @out */
+static void volatile_files_merge_one(const char *name, FILE *out, bool *first)
+{
+	_cleanup_free_ char *path = NULL, *buf = NULL;
+	size_t len = 0, start, end;
+	FILE *f;
+
+	if (asprintf(&path, "%s/%s", PATH_NVMF_RUNDIR, name) < 0)
+		return;
+
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (getdelim(&buf, &len, '\0', f) < 0) {
+		fclose(f);
+		return;
+	}
+	fclose(f);
+
+	len = strlen(buf);
+	for (start = 0; start < len && isspace((unsigned char)buf[start]); start++)
+		;
+	for (end = len; end > start && isspace((unsigned char)buf[end - 1]); end--)
+		;
+	if (end - start < 2 || buf[start] != '[' || buf[end - 1] != ']')
+		return;
+
+	for (start++, end--; start < end && isspace((unsigned char)buf[start]); start++)
+		;
+	if (start == end)
+		return;
+
+	fprintf(out, "%s%.*s", *first ? "" : ",\n", (int)(end - start), buf + start);
+	*first = false;
+}
+
+static int volatile_files_merge(struct volatile_files *vf, const char *dir,
+				const char *path)
+{
+	_cleanup_free_ char *tmp = NULL;
+	const char *name = strrchr(path, '/') + 1;
+	struct dirent *d;
+	bool first = true;
+	DIR *cache;
+	FILE *out;
+	int i, err;
+
+	if (asprintf(&tmp, "%s.%d", path, getpid()) < 0)
+		return -ENOMEM;
+
+	out = fopen(tmp, "w");
+	if (!out)
+		return -errno;
+
+	fputs("[\n", out);
+	for (i = 0; i < vf->nr; i++)
+		volatile_files_merge_one(vf->names[i], out, &first);
+	fputs("\n]\n", out);
+
+	err = ferror(out);
+	if (fclose(out) || err || first || rename(tmp, path)) {
+		unlink(tmp);
+		return first ? -ENOENT : -EIO;
+	}
+
+	/* the merged files of earlier states */
+	cache = opendir(dir);
+	if (!cache)
+		return 0;
+	while ((d = readdir(cache))) {
+		if (strncmp(d->d_name, CONFIG_CACHE_PREFIX, strlen(CONFIG_CACHE_PREFIX)) ||
+		    !strcmp(d->d_name, name))
+			continue;
+		unlinkat(dirfd(cache), d->d_name, 0);
+	}
+	closedir(cache);
+
+	return 0;
+}
+
+static int nvme_read_volatile_config(nvme_root_t r)
+{
+	const char *base = getenv("NVME_CONFIG_CACHE");
+	struct volatile_files vf;
+	char dir[PATH_MAX], path[PATH_MAX];
+	int ret;
+
+	if (!base)
+		return nvme_read_volatile_files(r);
+	if (!*base)
+		base = CONFIG_CACHE_DIR;
+
+	snprintf(dir, sizeof(dir), "%s", base);
+	if (cache_dir_init(dir))
+		return nvme_read_volatile_files(r);
+
+	ret = volatile_files_scan(&vf);
+	if (ret)
+		return ret;
+	if (!vf.nr) {
+		volatile_files_free(&vf);
+		return -ENOENT;
+	}
+
+	if (snprintf(path, sizeof(path), "%s/" CONFIG_CACHE_PREFIX "%016" PRIx64 ".json",
+		     dir, vf.hash) >= (int)sizeof(path)) {
+		volatile_files_free(&vf);
+		return nvme_read_volatile_files(r);
+	}
+
+	ret = 0;
+	if (access(path, R_OK))
+		ret = volatile_files_merge(&vf, dir, path);
+	volatile_files_free(&vf);
+	if (ret == -ENOENT)
+		return ret;
+
+	/* a file libnvme rejects spoils the merged one, read them one by one */
+	if (ret || nvme_read_config(r, path)) {
+		unlink(path);
+		return nvme_read_volatile_files(r);
+	}
+
+	return 0;
+}
+
+char *nvmf_hostid_from_hostnqn(const char *hostnqn)
+{
+	const char *uuid;
+
+	if (!hostnqn)
+		return NULL;
+
+	uuid = strstr(hostnqn, "uuid:");
+	if (!uuid)
+		return NULL;
+
+	return strdup(uuid + strlen("uuid:"));
+}
+
+void nvmf_check_hostid_and_hostnqn(const char *hostid, const char *hostnqn, unsigned int verbose)
+{
+	_cleanup_free_ char *hostid_from_hostnqn = NULL;
+
+	if (!hostnqn || !hostid)
+		return;
+
+	hostid_from_hostnqn = nvmf_hostid_from_hostnqn(hostnqn);
+	if (hostid_from_hostnqn && strcmp(hostid_from_hostnqn, hostid)) {
+		if (verbose)
+			fprintf(stderr,
+				"warning: use hostid which does not match uuid in hostnqn\n");
+	}
+}
+
+void nvmf_set_hostid_and_hostnqn(char **hostid, char **hostnqn)
+{
+	char *hid = *hostid;
+	char *hnqn = *hostnqn;
+
+	if (!hid)
+		hid = nvmf_hostid_from_file();
+	if (!hnqn)
+		hnqn = nvmf_hostnqn_from_file();
+
+	if (!hid) {
+		if (hnqn) {
+			hid = nvmf_hostid_from_hostnqn(hnqn);
+			if (!hid)
+				hid = nvmf_hostid_generate();
+		} else {
+			hid = nvmf_hostid_generate();
+			hnqn = nvmf_hostnqn_generate_from_hostid(hid);
+		}
+	}
+
+	if (!hnqn)
+		hnqn = nvmf_hostnqn_generate_from_hostid(hid);
+
+	*hostid = hid;
+	*hostnqn = hnqn;
+}
+
+/*
+ * connect-all --monitor: stay around after the initial connect and own
+ * the persistent discovery controllers. Change events are coalesced by
+ * nvme_watch_disc(), the discovery log of each marked controller is read
+ * once, and only the records it didn't have the last time are connected.
+ * The connect-all runs the udev rules start for the events of persistent
+ * discovery controllers return right away while a monitor holds the lock.
+ */
+#define PATH_NVMF_AUTOCONNECT	PATH_NVMF_RUNDIR "/autoconnect.pid"
+
+struct autoconnect_pdc {
+	char name[32];
+	struct nvmf_discovery_log *log;	/* as last connected, NULL before */
+};
+
+struct autoconnect {
+	nvme_root_t r;
+	struct nvme_fabrics_config *defcfg;
+	enum nvme_print_flags flags;
+	struct autoconnect_pdc *pdcs;
+	int nr_pdcs;
+};
+
+static nvme_ctrl_t lookup_nvme_ctrl(nvme_root_t r, const char *name);
+
+static struct autoconnect_pdc *autoconnect_pdc_get(struct autoconnect *ac,
+						   const char *name)
+{
+	struct autoconnect_pdc *pdcs;
+	int i;
+
+	for (i = 0; i < ac->nr_pdcs; i++)
+		if (!strcmp(ac->pdcs[i].name, name))
+			return &ac->pdcs[i];
+
+	pdcs = realloc(ac->pdcs, (ac->nr_pdcs + 1) * sizeof(*pdcs));
+	if (!pdcs)
+		return NULL;
+	ac->pdcs = pdcs;
+	memset(&pdcs[ac->nr_pdcs], 0, sizeof(*pdcs));
+	snprintf(pdcs[ac->nr_pdcs].name, sizeof(pdcs->name), "%s", name);
+
+	return &pdcs[ac->nr_pdcs++];
+}
+
+static bool autoconnect_log_has(struct nvmf_discovery_log *log,
+				struct nvmf_disc_log_entry *e)
+{
+	uint64_t i;
+
+	for (i = 0; log && i < le64_to_cpu(log->numrec); i++)
+		if (disc_entry_equal(&log->entries[i], e))
+			return true;
+
+	return false;
+}
+
+/*
+ * A controller of the tree whose device is gone, after ctrl-loss-tmo or a
+ * disconnect by someone else, would make skip_disc_entry() skip the record.
+ */
+static void autoconnect_prune(nvme_host_t h, struct nvmf_disc_log_entry *e,
+			      struct nvme_fabrics_config *cfg)
+{
+	char path[PATH_MAX];
+	nvme_ctrl_t c;
+
+	struct tr_config trcfg = {
+		.subsysnqn	= e->subnqn,
+		.transport	= nvmf_trtype_str(e->trtype),
+		.traddr		= e->traddr,
+		.host_traddr	= cfg->host_traddr,
+		.host_iface	= cfg->host_iface,
+		.trsvcid	= e->trsvcid,
+	};
+
+	c = lookup_ctrl(h, &trcfg);
+	if (!c || !nvme_ctrl_get_name(c))
+		return;
+
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s", nvme_ctrl_get_name(c));
+	if (access(path, F_OK))
+		nvme_free_ctrl(c);
+}
+
+static void autoconnect_refresh(struct autoconnect *ac, const char *name)
+{
+	_cleanup_free_ struct nvmf_disc_log_entry *delta = NULL;
+	struct nvme_fabrics_config cfg = *ac->defcfg;
+	struct nvmf_discovery_log *log;
+	struct autoconnect_pdc *pdc;
+	uint64_t i, numrec, nr = 0;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+
+	c = lookup_nvme_ctrl(ac->r, name);
+	if (!c)
+		c = nvme_scan_ctrl(ac->r, name);
+	if (!c || !nvme_ctrl_is_discovery_ctrl(c))
+		return;
+	h = nvme_subsystem_get_host(nvme_ctrl_get_subsystem(c));
+
+	/* the records are reached the way the discovery controller is */
+	if (!cfg.host_traddr)
+		cfg.host_traddr = (char *)nvme_ctrl_get_host_traddr(c);
+	if (!cfg.host_iface)
+		cfg.host_iface = (char *)nvme_ctrl_get_host_iface(c);
+
+	pdc = autoconnect_pdc_get(ac, name);
+	if (!pdc)
+		return;
+
+	log = get_discovery_log(c);
+	if (!log) {
+		/* gone or failing, start over once it is back */
+		free(pdc->log);
+		pdc->log = NULL;
+		return;
+	}
+
+	numrec = le64_to_cpu(log->numrec);
+	delta = calloc(numrec ? numrec : 1, sizeof(*delta));
+	if (!delta) {
+		free(log);
+		return;
+	}
+	for (i = 0; i < numrec; i++) {
+		if (autoconnect_log_has(pdc->log, &log->entries[i]))
+			continue;
+		autoconnect_prune(h, &log->entries[i], &cfg);
+		delta[nr++] = log->entries[i];
+	}
+
+	if (nr && !quiet)
+		printf("%s: %" PRIu64 " new discovery log record(s)\n", name, nr);
+	connect_disc_entries(nvme_ctrl_get_transport(c), h, delta, nr, &cfg,
+			     NULL, true, ac->flags);
+	fflush(stdout);
+
+	free(pdc->log);
+	pdc->log = log;
+}
+
+static void autoconnect_event(char (*ctrls)[32], int nr, void *data)
+{
+	struct autoconnect *ac = data;
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	int i;
+
+	for (i = 0; ctrls && i < nr; i++)
+		autoconnect_refresh(ac, ctrls[i]);
+	if (ctrls)
+		return;
+
+	/* events were lost, every discovery controller gets a refresh */
+	nvme_for_each_host(ac->r, h)
+		nvme_for_each_subsystem(h, s)
+			nvme_subsystem_for_each_ctrl(s, c)
+				if (nvme_ctrl_get_name(c) &&
+				    nvme_ctrl_is_discovery_ctrl(c))
+					autoconnect_refresh(ac, nvme_ctrl_get_name(c));
+}
+
+/*
+ * Held while monitoring, a second monitor fails with -EBUSY. A record
+ * lock, so that others can test for it without taking it.
+ */
+static int autoconnect_lock(void)
+{
+	struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+	char pid[16];
+	int fd, len;
+
+	mkdir(PATH_NVMF_RUNDIR, 0755);
+	fd = open(PATH_NVMF_AUTOCONNECT, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return -errno;
+	if (fcntl(fd, F_SETLK, &fl)) {
+		close(fd);
+		return errno == EACCES || errno == EAGAIN ? -EBUSY : -errno;
+	}
+
+	len = snprintf(pid, sizeof(pid), "%d\n", getpid());
+	if (ftruncate(fd, 0) || write(fd, pid, len) != len) {
+		close(fd);
+		unlink(PATH_NVMF_AUTOCONNECT);
+		return -EIO;
+	}
+
+	return fd;
+}
+
+/* a lock file left behind by a monitor that died isn't locked */
+static bool autoconnect_monitored(void)
+{
+	struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+	int fd, err;
+
+	fd = open(PATH_NVMF_AUTOCONNECT, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	err = fcntl(fd, F_GETLK, &fl);
+	close(fd);
+
+	return !err && fl.l_type != F_UNLCK;
+}
+
+static int autoconnect_monitor(nvme_root_t r, struct nvme_fabrics_config *defcfg,
+			       unsigned int coalesce_ms, enum nvme_print_flags flags)
+{
+	struct autoconnect ac = {
+		.r		= r,
+		.defcfg		= defcfg,
+		.flags		= flags,
+	};
+	int fd, i, ret;
+
+	fd = autoconnect_lock();
+	if (fd < 0) {
+		fprintf(stderr, "failed to lock %s: %s\n", PATH_NVMF_AUTOCONNECT,
+			nvme_strerror(-fd));
+		return fd;
+	}
+
+	nvme_stop_catch(true, nvme_watch_stop);
+	fflush(stdout);
+
+	ret = nvme_watch_disc(autoconnect_event, coalesce_ms, &ac);
+	if (ret)
+		fprintf(stderr, "failed to watch for discovery log changes: %s\n",
+			nvme_strerror(-ret));
+
+	nvme_stop_release();
+
+	unlink(PATH_NVMF_AUTOCONNECT);
+	close(fd);
+	for (i = 0; i < ac.nr_pdcs; i++)
+		free(ac.pdcs[i].log);
+	free(ac.pdcs);
+
+	return ret;
+}
+
+int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
+{
+	char *subsysnqn = NVME_DISC_SUBSYS_NAME;
+	char *hostnqn = NULL, *hostid = NULL, *hostkey = NULL;
+	char *hostnqn_arg, *hostid_arg;
+	char *transport = NULL, *traddr = NULL, *trsvcid = NULL;
+	char *config_file = PATH_NVMF_CONFIG;
+	char *hnqn = NULL, *hid = NULL;
+	char *context = NULL;
+	enum nvme_print_flags flags;
+	nvme_root_t r;
+	nvme_host_t h = NULL;
+	nvme_ctrl_t c = NULL;
+	unsigned int verbose = 0;
+	int ret;
+	char *format = "normal";
+	struct nvme_fabrics_config cfg;
+	char *device = NULL;
+	bool force = false;
+	bool json_config = false;
+	bool nbft = false, nonbft = false;
+	char *nbft_path = NBFT_SYSFS_PATH;
+	bool monitor = false;
+	unsigned int coalesce = 1000;
+
+	NVMF_ARGS(opts, cfg,
+		  OPT_STRING("device",     'd', "DEV", &device,       "use existing discovery controller device"),
+		  OPT_FMT("output-format", 'o', &format,              output_format),
+		  OPT_FILE("raw",          'r', &raw,                 "save raw output to file"),
+		  OPT_FLAG("persistent",   'p', &persistent,          "persistent discovery connection"),
+		  OPT_FLAG("quiet",        'S', &quiet,               "suppress already connected errors"),
+		  OPT_STRING("config",     'J', "FILE", &config_file, nvmf_config_file),
+		  OPT_INCR("verbose",      'v', &verbose,             "Increase logging verbosity"),
+		  OPT_FLAG("dump-config",  'O', &dump_config,         "Dump configuration file to stdout"),
+		  OPT_FLAG("force",          0, &force,               "Force persistent discovery controller creation"),
+		  OPT_FLAG("nbft",           0, &nbft,                "Only look at NBFT tables"),
+		  OPT_FLAG("no-nbft",        0, &nonbft,              "Do not look at NBFT tables"),
+		  OPT_STRING("nbft-path",    0, "STR", &nbft_path,    "user-defined path for NBFT tables"),
+		  OPT_STRING("context",      0, "STR", &context,       nvmf_context),
+		  OPT_UINT("parallel",       0, &nr_parallel,         nvmf_parallel),
+		  OPT_UINT("discovery-timeout", 0, &disc_timeout,     nvmf_disc_timeout),
+		  OPT_FLAG("monitor",        0, &monitor,             nvmf_monitor),
+		  OPT_UINT("coalesce",       0, &coalesce,            nvmf_coalesce));
+
+	nvmf_default_config(&cfg);
+
+	ret = argconfig_parse(argc, argv, desc, opts);
+	if (ret)
+		return ret;
+
+	if (!nr_parallel) {
+		nvme_show_error("parallel must be at least 1");
+		return -EINVAL;
+	}
+
+	if (monitor && (!connect || raw)) {
+		nvme_show_error("--monitor is for connect-all without --raw");
+		return -EINVAL;
+	}
+	/* the monitor owns the discovery controllers it connected */
+	if (monitor)
+		persistent = true;
+	else if (connect && device && strcmp(device, "none") && context &&
+		 !strcmp(context, "autoconnect") && autoconnect_monitored())
+		return 0;
+
+	ret = validate_output_format(format, &flags);
+	if (ret < 0) {
+		nvme_show_error("Invalid output format");
+		return ret;
+	}
+	nvme_set_json_output_mode(format);
+
+	if (!strcmp(config_file, "none"))
+		config_file = NULL;
+
+	log_level = map_log_level(verbose, quiet);
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		fprintf(stderr, "Failed to create topology root: %s\n",
+			nvme_strerror(errno));
+		return -errno;
+	}
+	if (context)
+		nvme_root_set_application(r, context);
+	ret = nvme_scan_topology(r, NULL, NULL);
+	if (ret < 0) {
+		if (errno != ENOENT)
+			fprintf(stderr, "Failed to scan topology: %s\n",
+				nvme_strerror(errno));
+		nvme_free_tree(r);
+		return ret;
+	}
+
+	if (!nvme_read_config(r, config_file))
+		json_config = true;
+	if (!nvme_read_volatile_config(r))
+		json_config = true;
+
+	hostnqn_arg = hostnqn;
+	hostid_arg = hostid;
+
+	nvmf_set_hostid_and_hostnqn(&hostid, &hostnqn);
+	if (!hostid_arg)
+		hid = hostid;
+	if (!hostnqn_arg)
+		hnqn = hostnqn;
+
+	nvmf_check_hostid_and_hostnqn(hostid, hostnqn, verbose);
+	h = nvme_lookup_host(r, hostnqn, hostid);
+	if (!h) {
+		ret = ENOMEM;
+		goto out_free;
+	}
+	ctrl_index.enabled = true;
+	if (device) {
+		if (!strcmp(device, "none"))
+			device = NULL;
+		else if (!strncmp(device, "/dev/", 5))
+			device += 5;
+	}
+	if (hostkey)
+		nvme_host_set_dhchap_key(h, hostkey);
+
+	if (!device && !transport && !traddr) {
+		if (!nonbft)
+			discover_from_nbft(r, hostnqn_arg, hostid_arg,
+					   hostnqn, hostid, desc, connect,
+					   &cfg, nbft_path, flags, verbose,
+					   nr_parallel);
+
+		if (nbft)
+			goto out_free;
+
+		if (json_config)
+			ret = discover_from_json_config_file(r, h, desc,
+							     connect, &cfg,
+							     flags, force);
+		if (ret || access(PATH_NVMF_DISC, F_OK))
+			goto out_free;
+
+		ret = discover_from_conf_file(r, h, desc, connect, &cfg);
+		goto out_free;
+	}
+
+	if (!trsvcid)
+		trsvcid = get_default_trsvcid(transport, true);
+
+	struct tr_config trcfg = {
+		.subsysnqn	= subsysnqn,
+		.transport	= transport,
+		.traddr		= traddr,
+		.host_traddr	= cfg.host_traddr,
+		.host_iface	= cfg.host_iface,
+		.trsvcid	= trsvcid,
+	};
+
+	if (device && !force) {
+		c = nvme_scan_ctrl(r, device);
+		if (c) {
+			/* Check if device matches command-line options */
+			if (!nvme_ctrl_config_match(c, transport, traddr, trsvcid, subsysnqn,
+						    cfg.host_traddr, cfg.host_iface)) {
+				fprintf(stderr,
+				    "ctrl device %s found, ignoring non matching command-line options\n",
+				    device);
+			}
+
+			if (!nvme_ctrl_is_discovery_ctrl(c)) {
+				fprintf(stderr,
+					"ctrl device %s found, ignoring non discovery controller\n",
+					device);
+
+				nvme_free_ctrl(c);
+				c = NULL;
+				persistent = false;
+			} else {
+				/*
+				 * If the controller device is found it must
+				 * be persistent, and shouldn't be disconnected
+				 * on exit.
+				 */
+				persistent = true;
+				/*
+				 * When --host-traddr/--host-iface are not specified on the
+				 * command line, use the discovery controller's (c) host-
+				 * traddr/host-iface for the connections to controllers
+				 * returned in the Discovery Log Pages. This is essential
+				 * when invoking "connect-all" with --device to reuse an
+				 * existing persistent discovery controller (as is done
+				 * for the udev rules). This ensures that host-traddr/
+				 * host-iface are consistent with the discovery controller (c).
+				 */
+				if (!cfg.host_traddr)
+					cfg.host_traddr = (char *)nvme_ctrl_get_host_traddr(c);
+				if (!cfg.host_iface)
+					cfg.host_iface = (char *)nvme_ctrl_get_host_iface(c);
+			}
+		} else {
+			/*
+			 * No controller found, fall back to create one.
+			 * But that controller cannot be persistent.
+			 */
 			fprintf(stderr,
-				"warning: use hostid which does not match uuid in hostnqn\n");
+				"ctrl device %s not found%s\n", device,
+				persistent ? ", ignoring --persistent" : "");
+			persistent = false;
+		}
 	}
-}
-
-void nvmf_set_hostid_and_hostnqn(char **hostid, char **hostnqn)
-{
-	char *hid = *hostid;
-	char *hnqn = *hostnqn;
-
-	if (!hid)
-		hid = nvmf_hostid_from_file();
-	if (!hnqn)
-		hnqn = nvmf_hostnqn_from_file();
-
-	if (!hid) {
-		if (hnqn) {
-			hid = nvmf_hostid_from_hostnqn(hnqn);
-			if (!hid)
-				hid = nvmf_hostid_generate();
-		} else {
-			hid = nvmf_hostid_generate();
-			hnqn = nvmf_hostnqn_generate_from_hostid(hid);
+	if (!c && !force) {
+		c = lookup_ctrl(h, &trcfg);
+		if (c)
+			persistent = true;
+	}
+	if (!c) {
+		/* No device or non-matching device, create a new controller */
+		c = create_discover_ctrl(r, h, &cfg, &trcfg);
+		if (!c) {
+			if (errno != ENVME_CONNECT_IGNORED)
+				fprintf(stderr,
+					"failed to add controller, error %s\n",
+					nvme_strerror(errno));
+			ret = errno;
+			goto out_free;
 		}
 	}
 
-	if (!hnqn)
-		hnqn = nvmf_hostnqn_generate_from_hostid(hid);
+	ret = __discover(c, &cfg, raw, connect, persistent, flags);
+	if (!(persistent || is_persistent_discovery_ctrl(h, c)))
+		nvme_disconnect_ctrl(c);
+	nvme_free_ctrl(c);
 
-	*hostid = hid;
-	*hostnqn = hnqn;
+out_free:
+	if (monitor && h)
+		ret = autoconnect_monitor(r, &cfg, coalesce, flags);
+	free(hnqn);
+	free(hid);
+	if (dump_config)
+		nvme_dump_config(r);
+	ctrl_index_free();
+	nvme_free_tree(r);
+
+	return ret;
 }
 
-int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
+int nvmf_connect(const char *desc, int argc, char **argv)
 {
-	char *subsysnqn = NVME_DISC_SUBSYS_NAME;
-	char *hostnqn = NULL, *hostid = NULL, *hostkey = NULL;
-	char *hostnqn_arg, *hostid_arg;
-	char *transport = NULL, *traddr = NULL, *trsvcid = NULL;
-	char *config_file = PATH_NVMF_CONFIG;
+	char *subsysnqn = NULL;
+	char *transport = NULL, *traddr = NULL;
+	char *trsvcid = NULL, *hostnqn = NULL, *hostid = NULL;
+	char *hostkey = NULL, *ctrlkey = NULL;
 	char *hnqn = NULL, *hid = NULL;
+	char *config_file = PATH_NVMF_CONFIG;
 	char *context = NULL;
-	enum nvme_print_flags flags;
+	unsigned int verbose = 0;
 	nvme_root_t r;
 	nvme_host_t h;
-	nvme_ctrl_t c = NULL;
-	unsigned int verbose = 0;
+	nvme_ctrl_t c;
 	int ret;
+	enum nvme_print_flags flags;
+	struct nvme_fabrics_config cfg = { 0 };
 	char *format = "normal";
-	struct nvme_fabrics_config cfg;
-	char *device = NULL;
-	bool force = false;
-	bool json_config = false;
-	bool nbft = false, nonbft = false;
-	char *nbft_path = NBFT_SYSFS_PATH;
+	char *hostnqn_arg, *hostid_arg;
+
 
 	NVMF_ARGS(opts, cfg,
-		  OPT_STRING("device",     'd', "DEV", &device,       "use existing discovery controller device"),
-		  OPT_FMT("output-format", 'o', &format,              output_format),
-		  OPT_FILE("raw",          'r', &raw,                 "save raw output to file"),
-		  OPT_FLAG("persistent",   'p', &persistent,          "persistent discovery connection"),
-		  OPT_FLAG("quiet",        'S', &quiet,               "suppress already connected errors"),
-		  OPT_STRING("config",     'J', "FILE", &config_file, nvmf_config_file),
-		  OPT_INCR("verbose",      'v', &verbose,             "Increase logging verbosity"),
-		  OPT_FLAG("dump-config",  'O', &dump_config,         "Dump configuration file to stdout"),
-		  OPT_FLAG("force",          0, &force,               "Force persistent discovery controller creation"),
-		  OPT_FLAG("nbft",           0, &nbft,                "Only look at NBFT tables"),
-		  OPT_FLAG("no-nbft",        0, &nonbft,              "Do not look at NBFT tables"),
-		  OPT_STRING("nbft-path",    0, "STR", &nbft_path,    "user-defined path for NBFT tables"),
-		  OPT_STRING("context",      0, "STR", &context,       nvmf_context));
+		  OPT_STRING("dhchap-ctrl-secret", 'C', "STR", &ctrlkey,      nvmf_ctrlkey),
+		  OPT_STRING("config",             'J', "FILE", &config_file, nvmf_config_file),
+		  OPT_INCR("verbose",              'v', &verbose,             "Increase logging verbosity"),
+		  OPT_FLAG("dump-config",          'O', &dump_config,             "Dump JSON configuration to stdout"),
+		  OPT_FMT("output-format",         'o', &format,       "Output format: normal|json"),
+		  OPT_STRING("context",              0, "STR", &context,  nvmf_context));
 
 	nvmf_default_config(&cfg);
 
@@ -733,6 +2265,28 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		nvme_show_error("Invalid output format");
 		return ret;
 	}
+	nvme_set_json_output_mode(format);
+
+	if (!subsysnqn) {
+		fprintf(stderr,
+			"required argument [--nqn | -n] not specified\n");
+		return -EINVAL;
+	}
+
+	if (!transport) {
+		fprintf(stderr,
+			"required argument [--transport | -t] not specified\n");
+		return -EINVAL;
+	}
+
+	if (strcmp(transport, "loop")) {
+		if (!traddr) {
+			fprintf(stderr,
+				"required argument [--traddr | -a] not specified for transport %s\n",
+				transport);
+			return -EINVAL;
+		}
+	}
 
 	if (!strcmp(config_file, "none"))
 		config_file = NULL;
@@ -755,11 +2309,8 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		nvme_free_tree(r);
 		return ret;
 	}
-
-	if (!nvme_read_config(r, config_file))
-		json_config = true;
-	if (!nvme_read_volatile_config(r))
-		json_config = true;
+	nvme_read_config(r, config_file);
+	nvme_read_volatile_config(r);
 
 	hostnqn_arg = hostnqn;
 	hostid_arg = hostid;
@@ -773,40 +2324,13 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 	nvmf_check_hostid_and_hostnqn(hostid, hostnqn, verbose);
 	h = nvme_lookup_host(r, hostnqn, hostid);
 	if (!h) {
-		ret = ENOMEM;
+		errno = ENOMEM;
 		goto out_free;
 	}
-	if (device) {
-		if (!strcmp(device, "none"))
-			device = NULL;
-		else if (!strncmp(device, "/dev/", 5))
-			device += 5;
-	}
 	if (hostkey)
 		nvme_host_set_dhchap_key(h, hostkey);
-
-	if (!device && !transport && !traddr) {
-		if (!nonbft)
-			discover_from_nbft(r, hostnqn_arg, hostid_arg,
-					   hostnqn, hostid, desc, connect,
-					   &cfg, nbft_path, flags, verbose);
-
-		if (nbft)
-			goto out_free;
-
-		if (json_config)
-			ret = discover_from_json_config_file(r, h, desc,
-							     connect, &cfg,
-							     flags, force);
-		if (ret || access(PATH_NVMF_DISC, F_OK))
-			goto out_free;
-
-		ret = discover_from_conf_file(r, h, desc, connect, &cfg);
-		goto out_free;
-	}
-
 	if (!trsvcid)
-		trsvcid = get_default_trsvcid(transport, true);
+		trsvcid = get_default_trsvcid(transport, false);
 
 	struct tr_config trcfg = {
 		.subsysnqn	= subsysnqn,
@@ -817,118 +2341,375 @@ int nvmf_discover(const char *desc, int argc, char **argv, bool connect)
 		.trsvcid	= trsvcid,
 	};
 
-	if (device && !force) {
-		c = nvme_scan_ctrl(r, device);
-		if (c) {
-			/* Check if device matches command-line options */
-			if (!nvme_ctrl_config_match(c, transport, traddr, trsvcid, subsysnqn,
-						    cfg.host_traddr, cfg.host_iface)) {
-				fprintf(stderr,
-				    "ctrl device %s found, ignoring non matching command-line options\n",
-				    device);
-			}
+	c = lookup_ctrl(h, &trcfg);
+	if (c && nvme_ctrl_get_name(c) && !cfg.duplicate_connect) {
+		fprintf(stderr, "already connected\n");
+		errno = EALREADY;
+		goto out_free;
+	}
+
+	c = nvme_create_ctrl(r, subsysnqn, transport, traddr,
+			     cfg.host_traddr, cfg.host_iface, trsvcid);
+	if (!c) {
+		errno = ENOMEM;
+		goto out_free;
+	}
+	if (ctrlkey)
+		nvme_ctrl_set_dhchap_key(c, ctrlkey);
+
+	errno = 0;
+	ret = nvmf_add_ctrl(h, c, &cfg);
+	if (ret)
+		fprintf(stderr, "could not add new controller: %s\n",
+			nvme_strerror(errno));
+	else {
+		errno = 0;
+		if (flags != -EINVAL)
+			nvme_show_connect_msg(c, flags);
+	}
+
+out_free:
+	free(hnqn);
+	free(hid);
+	if (dump_config)
+		nvme_dump_config(r);
+	nvme_free_tree(r);
+	return -errno;
+}
+
+#define ADVISE_MAX_LAYOUTS	16
+#define ADVISE_NS_WAIT_MS	10000
+#define ADVISE_MAX_QD		128
+#define ADVISE_IO_SIZE		4096
+
+/*
+ * <nr-io-queues>:<queue-size>[:<nr-write-queues>[:<nr-poll-queues>]], the
+ * write and poll queues default to those of @cfg
+ */
+static int advise_parse_layouts(const char *s, struct nvme_queue_layout *layouts,
+				int *nr, const struct nvme_fabrics_config *cfg)
+{
+	struct nvme_queue_layout *l;
+	int n, len;
+
+	for (*nr = 0; *s; (*nr)++) {
+		if (*nr == ADVISE_MAX_LAYOUTS)
+			return -E2BIG;
+		l = &layouts[*nr];
+		memset(l, 0, sizeof(*l));
+		l->nr_write_queues = cfg->nr_write_queues;
+		l->nr_poll_queues = cfg->nr_poll_queues;
+		n = sscanf(s, "%d:%d%n:%d%n:%d%n", &l->nr_io_queues, &l->queue_size,
+			   &len, &l->nr_write_queues, &len, &l->nr_poll_queues, &len);
+		if (n < 2 || l->nr_io_queues <= 0 || l->queue_size <= 1 ||
+		    l->nr_write_queues < 0 || l->nr_poll_queues < 0)
+			return -EINVAL;
+		s += len;
+		if (*s == ',')
+			s++;
+		else if (*s)
+			return -EINVAL;
+	}
+
+	return *nr ? 0 : -EINVAL;
+}
+
+/* one queue per CPU at the default depth and a few around it */
+static void advise_default_layouts(struct nvme_queue_layout *layouts, int *nr,
+				   const struct nvme_fabrics_config *cfg)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int defaults[][2] = {
+		{ cpus, 128 },
+		{ cpus, 32 },
+		{ cpus / 2, 256 },
+		{ cpus / 4, 1024 },
+	};
+	int i, j;
+
+	*nr = 0;
+	for (i = 0; i < ARRAY_SIZE(defaults); i++) {
+		if (defaults[i][0] < 1)
+			defaults[i][0] = 1;
+		for (j = 0; j < *nr; j++)
+			if (layouts[j].nr_io_queues == defaults[i][0] &&
+			    layouts[j].queue_size == defaults[i][1])
+				break;
+		if (j < *nr)
+			continue;
+		memset(&layouts[*nr], 0, sizeof(*layouts));
+		layouts[*nr].nr_io_queues = defaults[i][0];
+		layouts[*nr].queue_size = defaults[i][1];
+		layouts[*nr].nr_write_queues = cfg->nr_write_queues;
+		layouts[*nr].nr_poll_queues = cfg->nr_poll_queues;
+		(*nr)++;
+	}
+}
+
+/*
+ * The namespaces of a new controller show up once its scan work ran, and
+ * their generic char devices once udev created them. Waits for namespace
+ * @nsid, or the first one for 0, and opens /dev/ng<ctrl>n<head>.
+ */
+static int advise_open_ns(const char *ctrl, __u32 *nsid)
+{
+	unsigned int instance, head, n;
+	char dir[PATH_MAX], path[PATH_MAX], buf[32];
+	int waited, len, fd = -1;
+	struct dirent *d;
+	DIR *ctrl_dir;
+
+	if (sscanf(ctrl, "nvme%u", &instance) != 1)
+		return -ENODEV;
+	snprintf(dir, sizeof(dir), "/sys/class/nvme/%s", ctrl);
+
+	for (waited = 0; waited < ADVISE_NS_WAIT_MS; waited += 100) {
+		ctrl_dir = opendir(dir);
+		if (!ctrl_dir)
+			return -errno;
+
+		/* nvme<ctrl>n<head>, or nvme<subsys>c<ctrl>n<head> with multipath */
+		while (fd < 0 && (d = readdir(ctrl_dir))) {
+			if ((sscanf(d->d_name, "nvme%*uc%*un%u%n", &head, &len) != 1 &&
+			     sscanf(d->d_name, "nvme%*un%u%n", &head, &len) != 1) ||
+			    d->d_name[len])
+				continue;
+
+			snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+			if (sysfs_read_attr(path, "nsid", buf, sizeof(buf)) ||
+			    sscanf(buf, "%u", &n) != 1 || (*nsid && n != *nsid))
+				continue;
+
+			snprintf(path, sizeof(path), "/dev/ng%un%u", instance, head);
+			fd = open(path, O_RDONLY);
+			if (fd >= 0)
+				*nsid = n;
+		}
+		closedir(ctrl_dir);
+
+		if (fd >= 0)
+			return fd;
+		if (!nvme_interval_wait(monotonic_ns() + 100 * NSEC_PER_MSEC))
+			break;
+	}
+
+	return nvme_stopped() ? -EINTR : -ENOENT;
+}
+
+struct advise_probe {
+	nvme_root_t r;
+	nvme_host_t h;
+	struct tr_config *trcfg;
+	struct nvme_fabrics_config *cfg;
+	const char *ctrlkey;
+	__u32 nsid;
+	unsigned int runtime;
+};
+
+static int advise_run(struct nvme_io_job *job, __u8 opcode,
+		      struct nvme_io_stats *stats)
+{
+	int err;
+
+	job->opcode = opcode;
+	err = nvme_io_engine_run(job, stats);
+	if (err < 0)
+		return err;
+
+	return nvme_stopped() ? -EINTR : 0;
+}
+
+/* rand 4k reads, and writes if asked to, on a connection with layout @l */
+static int advise_probe_layout(struct advise_probe *p, struct nvme_queue_layout *l)
+{
+	struct nvme_fabrics_config cfg = *p->cfg;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct tr_config *t = p->trcfg;
+	int fd = -1, gfd = -1;
+	char path[PATH_MAX];
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	__u32 nsid = p->nsid;
+	__u8 lba_index, ms;
+	nvme_ctrl_t c;
+	int err;
+
+	cfg.nr_io_queues = l->nr_io_queues;
+	cfg.nr_write_queues = l->nr_write_queues;
+	cfg.nr_poll_queues = l->nr_poll_queues;
+	cfg.queue_size = l->queue_size;
+
+	c = nvme_create_ctrl(p->r, t->subsysnqn, t->transport, t->traddr,
+			     t->host_traddr, t->host_iface, t->trsvcid);
+	if (!c)
+		return -ENOMEM;
+	if (p->ctrlkey)
+		nvme_ctrl_set_dhchap_key(c, p->ctrlkey);
+
+	if (nvmf_add_ctrl(p->h, c, &cfg)) {
+		err = -errno;
+		nvme_free_ctrl(c);
+		return err;
+	}
+	snprintf(l->ctrl, sizeof(l->ctrl), "%s", nvme_ctrl_get_name(c));
+
+	gfd = advise_open_ns(l->ctrl, &nsid);
+	if (gfd < 0) {
+		err = gfd;
+		goto disconnect;
+	}
+	p->nsid = nsid;
+
+	snprintf(path, sizeof(path), "/dev/%s", l->ctrl);
+	fd = open(path, O_RDONLY);
+	ns = nvme_alloc(sizeof(*ns));
+	if (fd < 0 || !ns) {
+		err = fd < 0 ? -errno : -ENOMEM;
+		goto disconnect;
+	}
+	err = nvme_identify_ns(fd, nsid, ns);
+	if (err) {
+		err = err < 0 ? -errno : -EIO;
+		goto disconnect;
+	}
+
+	struct nvme_io_job job = {
+		.fd		= gfd,
+		.nsid		= nsid,
+		.nr_lbas	= le64_to_cpu(ns->nsze),
+		/* a thread per queue, each filling it up to a limit */
+		.threads	= min((long)l->nr_io_queues, cpus),
+		.queue_depth	= min(l->queue_size - 1, ADVISE_MAX_QD),
+		.runtime	= p->runtime,
+		.random		= true,
+	};
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job.lba_size = 1 << ns->lbaf[lba_index].ds;
+	if (job.lba_size < ADVISE_IO_SIZE)
+		job.nlb = ADVISE_IO_SIZE / job.lba_size - 1;
+	ms = ns->lbaf[lba_index].ms;
+	if (ms) {
+		if (NVME_FLBAS_META_EXT(ns->flbas))
+			job.lba_size += ms;
+		else
+			job.ms = ms;
+	}
 
-			if (!nvme_ctrl_is_discovery_ctrl(c)) {
-				fprintf(stderr,
-					"ctrl device %s found, ignoring non discovery controller\n",
-					device);
+	err = advise_run(&job, nvme_cmd_read, l->read);
+	if (!err && l->write)
+		err = advise_run(&job, nvme_cmd_write, l->write);
 
-				nvme_free_ctrl(c);
-				c = NULL;
-				persistent = false;
-			} else {
-				/*
-				 * If the controller device is found it must
-				 * be persistent, and shouldn't be disconnected
-				 * on exit.
-				 */
-				persistent = true;
-				/*
-				 * When --host-traddr/--host-iface are not specified on the
-				 * command line, use the discovery controller's (c) host-
-				 * traddr/host-iface for the connections to controllers
-				 * returned in the Discovery Log Pages. This is essential
-				 * when invoking "connect-all" with --device to reuse an
-				 * existing persistent discovery controller (as is done
-				 * for the udev rules). This ensures that host-traddr/
-				 * host-iface are consistent with the discovery controller (c).
-				 */
-				if (!cfg.host_traddr)
-					cfg.host_traddr = (char *)nvme_ctrl_get_host_traddr(c);
-				if (!cfg.host_iface)
-					cfg.host_iface = (char *)nvme_ctrl_get_host_iface(c);
-			}
-		} else {
-			/*
-			 * No controller found, fall back to create one.
-			 * But that controller cannot be persistent.
-			 */
-			fprintf(stderr,
-				"ctrl device %s not found%s\n", device,
-				persistent ? ", ignoring --persistent" : "");
-			persistent = false;
+disconnect:
+	/* closed first, the disconnect removes the devices */
+	if (gfd >= 0)
+		close(gfd);
+	if (fd >= 0)
+		close(fd);
+	nvme_disconnect_ctrl(c);
+	nvme_free_ctrl(c);
+	return err;
+}
+
+static double advise_iops(struct nvme_io_stats *stats)
+{
+	double secs = stats->elapsed_ns / 1e9;
+
+	return secs > 0 ? (stats->ios - stats->errors) / secs : 0;
+}
+
+/* the most commands per second over the read and write probes */
+static int advise_pick(struct nvme_queue_layout *layouts, int nr)
+{
+	double iops, best_iops = 0;
+	int i, best = -1;
+
+	for (i = 0; i < nr; i++) {
+		if (layouts[i].err)
+			continue;
+		iops = advise_iops(layouts[i].read);
+		if (layouts[i].write)
+			iops += advise_iops(layouts[i].write);
+		if (best < 0 || iops > best_iops) {
+			best = i;
+			best_iops = iops;
 		}
 	}
-	if (!c && !force) {
-		c = lookup_ctrl(h, &trcfg);
-		if (c)
-			persistent = true;
-	}
+
+	return best;
+}
+
+/* record the layout for the controller in the JSON configuration file */
+static int advise_save(const char *config_file, const char *hostnqn,
+		       const char *hostid, struct tr_config *t,
+		       struct nvme_fabrics_config *cfg, struct nvme_queue_layout *l)
+{
+	nvme_subsystem_t s;
+	nvme_root_t r;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	int err = 0;
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r)
+		return -errno;
+	nvme_read_config(r, config_file);
+
+	h = nvme_lookup_host(r, hostnqn, hostid);
+	s = h ? nvme_lookup_subsystem(h, NULL, t->subsysnqn) : NULL;
+	c = s ? nvme_lookup_ctrl(s, t->transport, t->traddr, t->host_traddr,
+				 t->host_iface, t->trsvcid, NULL) : NULL;
 	if (!c) {
-		/* No device or non-matching device, create a new controller */
-		c = create_discover_ctrl(r, h, &cfg, &trcfg);
-		if (!c) {
-			if (errno != ENVME_CONNECT_IGNORED)
-				fprintf(stderr,
-					"failed to add controller, error %s\n",
-					nvme_strerror(errno));
-			ret = errno;
-			goto out_free;
-		}
+		err = -errno ?: -ENOMEM;
+		goto out;
 	}
 
-	ret = __discover(c, &cfg, raw, connect, persistent, flags);
-	if (!(persistent || is_persistent_discovery_ctrl(h, c)))
-		nvme_disconnect_ctrl(c);
-	nvme_free_ctrl(c);
+	cfg->nr_io_queues = l->nr_io_queues;
+	cfg->nr_write_queues = l->nr_write_queues;
+	cfg->nr_poll_queues = l->nr_poll_queues;
+	cfg->queue_size = l->queue_size;
+	nvmf_update_config(c, cfg);
+	if (nvme_update_config(r))
+		err = -errno;
 
-out_free:
-	free(hnqn);
-	free(hid);
-	if (dump_config)
-		nvme_dump_config(r);
+out:
 	nvme_free_tree(r);
-
-	return ret;
+	return err;
 }
 
-int nvmf_connect(const char *desc, int argc, char **argv)
+int nvmf_advise(const char *desc, int argc, char **argv)
 {
 	char *subsysnqn = NULL;
 	char *transport = NULL, *traddr = NULL;
 	char *trsvcid = NULL, *hostnqn = NULL, *hostid = NULL;
 	char *hostkey = NULL, *ctrlkey = NULL;
 	char *hnqn = NULL, *hid = NULL;
+	char *hostnqn_arg, *hostid_arg;
 	char *config_file = PATH_NVMF_CONFIG;
-	char *context = NULL;
-	unsigned int verbose = 0;
+	char *layouts_arg = NULL;
+	char *format = "normal";
+	unsigned int verbose = 0, runtime = 5;
+	__u32 nsid = 0;
+	bool write = false, save = false;
+	struct nvme_queue_layout layouts[ADVISE_MAX_LAYOUTS];
+	_cleanup_free_ struct nvme_io_stats *stats = NULL;
+	struct nvme_queue_advice advice = { 0 };
+	struct nvme_fabrics_config cfg = { 0 };
+	enum nvme_print_flags flags;
 	nvme_root_t r;
 	nvme_host_t h;
 	nvme_ctrl_t c;
-	int ret;
-	enum nvme_print_flags flags;
-	struct nvme_fabrics_config cfg = { 0 };
-	char *format = "normal";
-	char *hostnqn_arg, *hostid_arg;
-
+	int i, nr, ret;
 
 	NVMF_ARGS(opts, cfg,
 		  OPT_STRING("dhchap-ctrl-secret", 'C', "STR", &ctrlkey,      nvmf_ctrlkey),
 		  OPT_STRING("config",             'J', "FILE", &config_file, nvmf_config_file),
+		  OPT_STRING("layouts",            'L', "LIST", &layouts_arg, nvmf_advise_layouts),
+		  OPT_UINT("namespace-id",         'N', &nsid,                nvmf_advise_nsid),
+		  OPT_UINT("runtime",              'R', &runtime,             nvmf_advise_runtime),
+		  OPT_FLAG("write",                  0, &write,               nvmf_advise_write),
+		  OPT_FLAG("save",                   0, &save,                nvmf_advise_save),
 		  OPT_INCR("verbose",              'v', &verbose,             "Increase logging verbosity"),
-		  OPT_FLAG("dump-config",          'O', &dump_config,             "Dump JSON configuration to stdout"),
-		  OPT_FMT("output-format",         'o', &format,       "Output format: normal|json"),
-		  OPT_STRING("context",              0, "STR", &context,  nvmf_context));
+		  OPT_FMT("output-format",         'o', &format,       "Output format: normal|json"));
 
 	nvmf_default_config(&cfg);
 
@@ -941,30 +2722,43 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 		nvme_show_error("Invalid output format");
 		return ret;
 	}
+	nvme_set_json_output_mode(format);
 
-	if (!subsysnqn) {
+	if (!subsysnqn || !transport || (strcmp(transport, "loop") && !traddr)) {
 		fprintf(stderr,
-			"required argument [--nqn | -n] not specified\n");
+			"required arguments [--nqn | -n], [--transport | -t] and [--traddr | -a] not specified\n");
 		return -EINVAL;
 	}
 
-	if (!transport) {
-		fprintf(stderr,
-			"required argument [--transport | -t] not specified\n");
+	if (!runtime) {
+		fprintf(stderr, "runtime must be non-zero\n");
 		return -EINVAL;
 	}
 
-	if (strcmp(transport, "loop")) {
-		if (!traddr) {
-			fprintf(stderr,
-				"required argument [--traddr | -a] not specified for transport %s\n",
-				transport);
-			return -EINVAL;
+	if (!strcmp(config_file, "none"))
+		config_file = NULL;
+	if (save && !config_file) {
+		fprintf(stderr, "--save needs a JSON configuration file\n");
+		return -EINVAL;
+	}
+
+	if (layouts_arg) {
+		ret = advise_parse_layouts(layouts_arg, layouts, &nr, &cfg);
+		if (ret) {
+			fprintf(stderr, "invalid layouts '%s'\n", layouts_arg);
+			return ret;
 		}
+	} else {
+		advise_default_layouts(layouts, &nr, &cfg);
 	}
 
-	if (!strcmp(config_file, "none"))
-		config_file = NULL;
+	stats = calloc(2 * nr, sizeof(*stats));
+	if (!stats)
+		return -ENOMEM;
+	for (i = 0; i < nr; i++) {
+		layouts[i].read = &stats[2 * i];
+		layouts[i].write = write ? &stats[2 * i + 1] : NULL;
+	}
 
 	log_level = map_log_level(verbose, quiet);
 
@@ -974,18 +2768,14 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 			nvme_strerror(errno));
 		return -errno;
 	}
-	if (context)
-		nvme_root_set_application(r, context);
 	ret = nvme_scan_topology(r, NULL, NULL);
-	if (ret < 0) {
-		if (errno != ENOENT)
-			fprintf(stderr, "Failed to scan topology: %s\n",
-				nvme_strerror(errno));
+	if (ret < 0 && errno != ENOENT) {
+		fprintf(stderr, "Failed to scan topology: %s\n",
+			nvme_strerror(errno));
 		nvme_free_tree(r);
 		return ret;
 	}
 	nvme_read_config(r, config_file);
-	nvme_read_volatile_config(r);
 
 	hostnqn_arg = hostnqn;
 	hostid_arg = hostid;
@@ -995,11 +2785,10 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 		hid = hostid;
 	if (!hostnqn_arg)
 		hnqn = hostnqn;
-
 	nvmf_check_hostid_and_hostnqn(hostid, hostnqn, verbose);
 	h = nvme_lookup_host(r, hostnqn, hostid);
 	if (!h) {
-		errno = ENOMEM;
+		ret = -ENOMEM;
 		goto out_free;
 	}
 	if (hostkey)
@@ -1016,40 +2805,56 @@ int nvmf_connect(const char *desc, int argc, char **argv)
 		.trsvcid	= trsvcid,
 	};
 
+	/* the probes would share the target's queues with the live connection */
 	c = lookup_ctrl(h, &trcfg);
 	if (c && nvme_ctrl_get_name(c) && !cfg.duplicate_connect) {
-		fprintf(stderr, "already connected\n");
-		errno = EALREADY;
+		fprintf(stderr, "already connected, disconnect first\n");
+		ret = -EALREADY;
 		goto out_free;
 	}
 
-	c = nvme_create_ctrl(r, subsysnqn, transport, traddr,
-			     cfg.host_traddr, cfg.host_iface, trsvcid);
-	if (!c) {
-		errno = ENOMEM;
-		goto out_free;
-	}
-	if (ctrlkey)
-		nvme_ctrl_set_dhchap_key(c, ctrlkey);
+	struct advise_probe probe = {
+		.r		= r,
+		.h		= h,
+		.trcfg		= &trcfg,
+		.cfg		= &cfg,
+		.ctrlkey	= ctrlkey,
+		.nsid		= nsid,
+		.runtime	= runtime,
+	};
 
-	errno = 0;
-	ret = nvmf_add_ctrl(h, c, &cfg);
-	if (ret)
-		fprintf(stderr, "could not add new controller: %s\n",
-			nvme_strerror(errno));
-	else {
-		errno = 0;
-		if (flags != -EINVAL)
-			nvme_show_connect_msg(c, flags);
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	for (i = 0; i < nr; i++)
+		layouts[i].err = nvme_stopped() ? -EINTR :
+			advise_probe_layout(&probe, &layouts[i]);
+	nvme_stop_release();
+
+	advice.subsysnqn = subsysnqn;
+	advice.transport = transport;
+	advice.traddr = traddr ? traddr : "";
+	advice.nsid = probe.nsid;
+	advice.runtime = runtime;
+	advice.layouts = layouts;
+	advice.nr_layouts = nr;
+	advice.best = advise_pick(layouts, nr);
+
+	ret = advice.best < 0 ? layouts[0].err : 0;
+	if (!ret && save) {
+		ret = advise_save(config_file, hostnqn, hostid, &trcfg, &cfg,
+				  &layouts[advice.best]);
+		if (ret)
+			fprintf(stderr, "failed to update %s: %s\n", config_file,
+				nvme_strerror(-ret));
+		advice.saved = !ret;
 	}
 
+	nvme_show_queue_advice(&advice, flags);
+
 out_free:
 	free(hnqn);
 	free(hid);
-	if (dump_config)
-		nvme_dump_config(r);
 	nvme_free_tree(r);
-	return -errno;
+	return ret;
 }
 
 static nvme_ctrl_t lookup_nvme_ctrl(nvme_root_t r, const char *name)
@@ -1069,7 +2874,268 @@ static nvme_ctrl_t lookup_nvme_ctrl(nvme_root_t r, const char *name)
 	return NULL;
 }
 
-static void nvmf_disconnect_nqn(nvme_root_t r, char *nqn)
+/*
+ * Batched controller teardown. With more than one job the delete_controller
+ * attributes are written from a thread pool, the kernel tears down every
+ * controller synchronously within the write, and the libnvme tree is not
+ * touched outside of the main thread. Reconnects go through
+ * nvmf_run_forked() with the addresses and connect options saved before
+ * the disconnect.
+ */
+struct teardown {
+	nvme_host_t h;
+	char name[32];
+	char *strs[6];	/* subsysnqn, transport, traddr, trsvcid, host_traddr, host_iface */
+	struct nvme_fabrics_config cfg;
+	char *hostkey;
+	char *ctrlkey;
+	uint64_t ns;
+	int err;
+};
+
+struct teardown_batch {
+	nvme_root_t r;
+	struct teardown *t;
+	unsigned int nr;
+	unsigned int jobs;
+	bool timing;
+	bool reconnect;
+};
+
+/* integer attribute @attr of @c, -1 for "off" */
+static int ctrl_attr_int(nvme_ctrl_t c, const char *attr, int *val)
+{
+	_cleanup_free_ char *v = nvme_get_attr(nvme_ctrl_get_sysfs_dir(c), attr);
+	char *end;
+
+	if (!v || !*v)
+		return -ENOENT;
+	if (!strcmp(v, "off")) {
+		*val = -1;
+		return 0;
+	}
+	*val = strtol(v, &end, 0);
+
+	return *end ? -EINVAL : 0;
+}
+
+/* attribute @attr of @c, NULL if unset */
+static char *ctrl_attr_str(nvme_ctrl_t c, const char *attr)
+{
+	char *v = nvme_get_attr(nvme_ctrl_get_sysfs_dir(c), attr);
+
+	if (v && (!*v || !strcmp(v, "none"))) {
+		free(v);
+		v = NULL;
+	}
+	return v;
+}
+
+/*
+ * The connect options of @c the kernel shows in sysfs, for connecting it
+ * again as it was. The split of the I/O queues into read, write and poll
+ * queues, the digests and the TOS aren't shown: the queues all become
+ * read queues, the others take their defaults.
+ */
+static int teardown_config(struct teardown *t, nvme_ctrl_t c)
+{
+	struct nvme_fabrics_config *cfg = &t->cfg;
+	_cleanup_free_ char *tls_key = NULL;
+	_cleanup_free_ char *keyring = NULL;
+	int queues, sqsize, err;
+
+	nvmf_default_config(cfg);
+	err = ctrl_attr_int(c, "queue_count", &queues);
+	if (!err)
+		err = ctrl_attr_int(c, "sqsize", &sqsize);
+	if (!err)
+		err = ctrl_attr_int(c, "kato", &cfg->keep_alive_tmo);
+	if (!err)
+		err = ctrl_attr_int(c, "ctrl_loss_tmo", &cfg->ctrl_loss_tmo);
+	if (!err)
+		err = ctrl_attr_int(c, "reconnect_delay", &cfg->reconnect_delay);
+	if (!err)
+		err = ctrl_attr_int(c, "fast_io_fail_tmo", &cfg->fast_io_fail_tmo);
+	if (err)
+		return err;
+
+	/* the admin queue is counted too, sqsize is zeroes based */
+	cfg->nr_io_queues = queues - 1;
+	cfg->queue_size = sqsize + 1;
+
+	t->hostkey = ctrl_attr_str(c, "dhchap_secret");
+	t->ctrlkey = ctrl_attr_str(c, "dhchap_ctrl_secret");
+
+	tls_key = ctrl_attr_str(c, "tls_key");
+	if (tls_key) {
+		cfg->tls = true;
+		free(tls_key);
+		tls_key = ctrl_attr_str(c, "tls_configured_key");
+		if (tls_key)
+			cfg->tls_key = strtol(tls_key, NULL, 16);
+		keyring = ctrl_attr_str(c, "tls_keyring");
+		if (keyring) {
+			cfg->keyring = nvme_lookup_keyring(keyring);
+			if (!cfg->keyring)
+				return -ENOKEY;
+		}
+	}
+
+	return 0;
+}
+
+static int teardown_add(struct teardown_batch *b, nvme_ctrl_t c)
+{
+	const char *strs[] = {
+		nvme_ctrl_get_subsysnqn(c),
+		nvme_ctrl_get_transport(c),
+		nvme_ctrl_get_traddr(c),
+		nvme_ctrl_get_trsvcid(c),
+		nvme_ctrl_get_host_traddr(c),
+		nvme_ctrl_get_host_iface(c),
+	};
+	const char *name = nvme_ctrl_get_name(c);
+	struct teardown *t;
+	unsigned int i;
+	int err;
+
+	if (!name || strlen(name) >= sizeof(t->name))
+		return 0;
+
+	t = realloc(b->t, (b->nr + 1) * sizeof(*t));
+	if (!t)
+		return -ENOMEM;
+	b->t = t;
+	t = &b->t[b->nr];
+	memset(t, 0, sizeof(*t));
+
+	/* a controller which couldn't be connected again as it was stays */
+	if (b->reconnect) {
+		err = teardown_config(t, c);
+		if (err) {
+			fprintf(stderr, "%s: can't recover the connect options, not disconnecting: %s\n",
+				name, nvme_strerror(-err));
+			free(t->hostkey);
+			free(t->ctrlkey);
+			return 0;
+		}
+	}
+	b->nr++;
+
+	t->h = nvme_subsystem_get_host(nvme_ctrl_get_subsystem(c));
+	strcpy(t->name, name);
+	for (i = 0; i < ARRAY_SIZE(strs); i++) {
+		if (strs[i] && !(t->strs[i] = strdup(strs[i])))
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void teardown_free(struct teardown_batch *b)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < b->nr; i++) {
+		for (j = 0; j < ARRAY_SIZE(b->t[i].strs); j++)
+			free(b->t[i].strs[j]);
+		free(b->t[i].hostkey);
+		free(b->t[i].ctrlkey);
+	}
+	free(b->t);
+}
+
+static void teardown_ctrl(void *arg)
+{
+	struct teardown *t = arg;
+	char path[PATH_MAX];
+	uint64_t start = monotonic_ns();
+	int fd;
+
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s/delete_controller",
+		 t->name);
+	fd = open(path, O_WRONLY);
+	if (fd < 0 || write(fd, "1", 1) != 1)
+		t->err = errno;
+	if (fd >= 0)
+		close(fd);
+	t->ns = monotonic_ns() - start;
+}
+
+static int reconnect_ctrl_fn(void *arg, unsigned int i)
+{
+	struct teardown_batch *b = arg;
+	struct teardown *t = &b->t[i];
+	uint64_t start = monotonic_ns();
+	nvme_ctrl_t c;
+
+	if (t->err)
+		return 0;
+
+	c = nvme_create_ctrl(b->r, t->strs[0], t->strs[1], t->strs[2],
+			     t->strs[4], t->strs[5], t->strs[3]);
+	if (c) {
+		/* a child of its own, the host may be changed */
+		if (t->hostkey)
+			nvme_host_set_dhchap_key(t->h, t->hostkey);
+		if (t->ctrlkey)
+			nvme_ctrl_set_dhchap_key(c, t->ctrlkey);
+	}
+	if (!c || nvmf_add_ctrl(t->h, c, &t->cfg)) {
+		fprintf(stderr, "%s: failed to reconnect: %s\n", t->name,
+			nvme_strerror(errno));
+		return 1;
+	}
+
+	if (b->timing)
+		printf("%s: reconnected as %s in %.3f ms\n", t->name,
+		       nvme_ctrl_get_name(c), (monotonic_ns() - start) / 1e6);
+	else
+		printf("%s: reconnected as %s\n", t->name,
+		       nvme_ctrl_get_name(c));
+
+	return 0;
+}
+
+/* returns the number of disconnected controllers */
+static int teardown_run(struct teardown_batch *b)
+{
+	struct nvme_thread_pool *pool = NULL;
+	uint64_t start = monotonic_ns();
+	unsigned int i;
+	int nr = 0;
+
+	if (b->jobs > 1 && b->nr > 1)
+		pool = nvme_thread_pool_create(min(b->jobs, b->nr));
+	for (i = 0; i < b->nr; i++)
+		if (!pool || nvme_thread_pool_queue(pool, teardown_ctrl, &b->t[i]))
+			teardown_ctrl(&b->t[i]);
+	nvme_thread_pool_destroy(pool);
+
+	for (i = 0; i < b->nr; i++) {
+		struct teardown *t = &b->t[i];
+
+		if (t->err)
+			fprintf(stderr, "failed to disconnect %s: %s\n",
+				t->name, strerror(t->err));
+		else
+			nr++;
+		if (b->timing && !t->err)
+			printf("%s: disconnected in %.3f ms\n", t->name,
+			       t->ns / 1e6);
+	}
+	if (b->timing && b->nr)
+		printf("disconnected %d controller(s) in %.3f ms\n", nr,
+		       (monotonic_ns() - start) / 1e6);
+
+	if (b->reconnect)
+		nvmf_run_forked(b->nr, max(b->jobs, 1U), reconnect_ctrl_fn, b,
+				NULL);
+
+	return nr;
+}
+
+static void nvmf_disconnect_nqn(struct teardown_batch *b, char *nqn)
 {
 	int i = 0;
 	char *n = nqn;
@@ -1081,17 +3147,19 @@ static void nvmf_disconnect_nqn(nvme_root_t r, char *nqn)
 	while ((p = strsep(&n, ",")) != NULL) {
 		if (!strlen(p))
 			continue;
-		nvme_for_each_host(r, h) {
+		nvme_for_each_host(b->r, h) {
 			nvme_for_each_subsystem(h, s) {
 				if (strcmp(nvme_subsystem_get_nqn(s), p))
 					continue;
 				nvme_subsystem_for_each_ctrl(s, c) {
-					if (!nvme_disconnect_ctrl(c))
-						i++;
+					if (teardown_add(b, c))
+						goto out;
 				}
 			}
 		}
 	}
+out:
+	i = teardown_run(b);
 	printf("NQN:%s disconnected %d controller(s)\n", nqn, i);
 }
 
@@ -1107,14 +3175,20 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 		char *nqn;
 		char *device;
 		unsigned int verbose;
+		unsigned int jobs;
+		bool timing;
+		bool reconnect;
 	};
 
-	struct config cfg = { 0 };
+	struct config cfg = { .jobs = 1 };
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("nqn",        'n', "NAME", &cfg.nqn,    nvmf_nqn),
 		OPT_STRING("device",     'd', "DEV",  &cfg.device, device),
 		OPT_INCR("verbose",      'v', &cfg.verbose, "Increase logging verbosity"),
+		OPT_UINT("jobs",         'j', &cfg.jobs,      nvmf_jobs),
+		OPT_FLAG("timing",       'T', &cfg.timing,    nvmf_timing),
+		OPT_FLAG("reconnect",    'R', &cfg.reconnect, nvmf_reconnect),
 		OPT_END()
 	};
 
@@ -1145,10 +3219,25 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 		return ret;
 	}
 
-	if (cfg.nqn)
-		nvmf_disconnect_nqn(r, cfg.nqn);
+	if (cfg.nqn) {
+		struct teardown_batch b = {
+			.r		= r,
+			.jobs		= cfg.jobs,
+			.timing		= cfg.timing,
+			.reconnect	= cfg.reconnect,
+		};
+
+		nvmf_disconnect_nqn(&b, cfg.nqn);
+		teardown_free(&b);
+	}
 
 	if (cfg.device) {
+		struct teardown_batch b = {
+			.r		= r,
+			.jobs		= cfg.jobs,
+			.timing		= cfg.timing,
+			.reconnect	= cfg.reconnect,
+		};
 		char *d;
 
 		d = cfg.device;
@@ -1157,25 +3246,31 @@ int nvmf_disconnect(const char *desc, int argc, char **argv)
 				p += 5;
 			c = lookup_nvme_ctrl(r, p);
 			if (!c) {
+				ret = -errno;
 				fprintf(stderr,
 					"Did not find device %s\n", p);
-				nvme_free_tree(r);
-				return -errno;
+				goto free;
 			}
-			ret = nvme_disconnect_ctrl(c);
-			if (ret)
+			ret = teardown_add(&b, c);
+			if (ret) {
 				fprintf(stderr,
 					"Failed to disconnect %s: %s\n",
-					p, nvme_strerror(errno));
+					p, nvme_strerror(-ret));
+				goto free;
+			}
 		}
+		teardown_run(&b);
+free:
+		teardown_free(&b);
 	}
 	nvme_free_tree(r);
 
-	return 0;
+	return ret < 0 ? ret : 0;
 }
 
 int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 {
+	struct teardown_batch b = { 0 };
 	nvme_host_t h;
 	nvme_subsystem_t s;
 	nvme_root_t r;
@@ -1185,13 +3280,19 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 	struct config {
 		char *transport;
 		unsigned int verbose;
+		unsigned int jobs;
+		bool timing;
+		bool reconnect;
 	};
 
-	struct config cfg = { 0 };
+	struct config cfg = { .jobs = 1 };
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("transport", 'r', "STR", (char *)&cfg.transport, nvmf_tport),
 		OPT_INCR("verbose",  'v', &cfg.verbose, "Increase logging verbosity"),
+		OPT_UINT("jobs",      'j', &cfg.jobs,      nvmf_jobs),
+		OPT_FLAG("timing",    'T', &cfg.timing,    nvmf_timing),
+		OPT_FLAG("reconnect", 'R', &cfg.reconnect, nvmf_reconnect),
 		OPT_END()
 	};
 
@@ -1216,6 +3317,11 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 		return ret;
 	}
 
+	b.r = r;
+	b.jobs = cfg.jobs;
+	b.timing = cfg.timing;
+	b.reconnect = cfg.reconnect;
+
 	nvme_for_each_host(r, h) {
 		nvme_for_each_subsystem(h, s) {
 			nvme_subsystem_for_each_ctrl(s, c) {
@@ -1226,13 +3332,18 @@ int nvmf_disconnect_all(const char *desc, int argc, char **argv)
 				else if (!strcmp(nvme_ctrl_get_transport(c),
 						 "pcie"))
 					continue;
-				if (nvme_disconnect_ctrl(c))
-					fprintf(stderr,
-						"failed to disconnect %s\n",
-						nvme_ctrl_get_name(c));
+				if (teardown_add(&b, c)) {
+					fprintf(stderr, "failed to disconnect %s: %s\n",
+						nvme_ctrl_get_name(c),
+						strerror(ENOMEM));
+					goto out;
+				}
 			}
 		}
 	}
+	teardown_run(&b);
+out:
+	teardown_free(&b);
 	nvme_free_tree(r);
 
 	return 0;
@@ -14,9 +14,25 @@ struct tr_config {
 extern nvme_ctrl_t lookup_ctrl(nvme_host_t h, struct tr_config *trcfg);
 extern int nvmf_discover(const char *desc, int argc, char **argv, bool connect);
 extern int nvmf_connect(const char *desc, int argc, char **argv);
+extern int nvmf_advise(const char *desc, int argc, char **argv);
 extern int nvmf_disconnect(const char *desc, int argc, char **argv);
 extern int nvmf_disconnect_all(const char *desc, int argc, char **argv);
 extern int nvmf_config(const char *desc, int argc, char **argv);
 extern int nvmf_dim(const char *desc, int argc, char **argv);
 
+/*
+ * Runs @fn(@arg, i) for every i below @nr in a child process, up to
+ * @nr_parallel at a time. The libnvme tree is not thread safe, so this is
+ * how fabrics setup work is done concurrently. The stdout and stderr output
+ * of every child is read from a pipe and printed in order of i, each once
+ * it and the ones before finished. A @fn which can't be forked while
+ * nothing else runs is run by the caller, after the output of the ones
+ * before. If @status is set, it receives the wait status of every child.
+ * Returns 0, or a negative errno if waiting for the children failed, in
+ * which case the ones still running are killed and all not done failed.
+ */
+extern int nvmf_run_forked(unsigned int nr, unsigned int nr_parallel,
+			   int (*fn)(void *arg, unsigned int i), void *arg,
+			   int *status);
+
 #endif
@@ -4,9 +4,11 @@
 #include <stdio.h>
 #include <fnmatch.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <libnvme.h>
 
+#include "common.h"
 #include "nvme.h"
 #include "nbft.h"
 #include "fabrics.h"
@@ -31,7 +33,7 @@ static void json_connect_msg(nvme_ctrl_t c)
 	json_object_add_value_string(root, "device", nvme_ctrl_get_name(c));
 
 	json_print_object(root, NULL);
-	printf("\n");
+	util_json_print_newline();
 	json_free_object(root);
 #endif
 }
@@ -145,19 +147,106 @@ static int do_connect(nvme_root_t r,
 	return 0;
 }
 
+struct nbft_connect {
+	nvme_host_t h;
+	struct nbft_info_subsystem_ns *ss;
+	struct nbft_info_hfi *hfi;
+};
+
+struct nbft_connect_ctx {
+	nvme_root_t r;
+	struct nbft_connect *conns;
+	const struct nvme_fabrics_config *cfg;
+	enum nvme_print_flags flags;
+	unsigned int verbose;
+};
+
+/* returns 0 for success or negative errno otherwise */
+static int nbft_connect_hfi(struct nbft_connect_ctx *ctx,
+			    struct nbft_connect *conn)
+{
+	struct nbft_info_subsystem_ns *ss = conn->ss;
+	struct nbft_info_hfi *hfi = conn->hfi;
+	char *host_traddr = NULL;
+	uint64_t start = monotonic_ns();
+	int ret;
+
+	if (!ctx->cfg->host_traddr && !strncmp(ss->transport, "tcp", 3))
+		host_traddr = hfi->tcp_info.ipaddr;
+
+	struct tr_config trcfg = {
+		.subsysnqn	= ss->subsys_nqn,
+		.transport	= ss->transport,
+		.traddr		= ss->traddr,
+		.host_traddr	= host_traddr,
+		.host_iface	= NULL,
+		.trsvcid	= ss->trsvcid,
+	};
+
+	ret = do_connect(ctx->r, conn->h, ss, &trcfg, ctx->cfg, ctx->flags,
+			 ctx->verbose);
+
+	/*
+	 * With TCP/DHCP, it can happen that the OS
+	 * obtains a different local IP address than the
+	 * firmware had. Retry without host_traddr.
+	 */
+	if (ret == -ENVME_CONNECT_ADDRNOTAVAIL &&
+	    !strcmp(ss->transport, "tcp") &&
+	    strlen(hfi->tcp_info.dhcp_server_ipaddr) > 0) {
+		trcfg.host_traddr = NULL;
+
+		ret = do_connect(ctx->r, conn->h, ss, &trcfg, ctx->cfg,
+				 ctx->flags, ctx->verbose);
+
+		if (ret == 0 && ctx->verbose >= 1)
+			fprintf(stderr,
+				"SSNS %d: connect with host_traddr=\"%s\" failed, success after omitting host_traddr\n",
+				ss->index,
+				host_traddr);
+	}
+
+	if (ret)
+		fprintf(stderr, "SSNS %d: no controller found\n", ss->index);
+
+	if (ctx->verbose >= 1)
+		fprintf(stderr, "SSNS %d: %s in %.3f ms\n", ss->index,
+			ret ? "failed" : "done",
+			(monotonic_ns() - start) / 1e6);
+
+	return ret;
+}
+
+static int nbft_connect_fn(void *arg, unsigned int i)
+{
+	struct nbft_connect_ctx *ctx = arg;
+
+	return nbft_connect_hfi(ctx, &ctx->conns[i]) ? 1 : 0;
+}
+
 int discover_from_nbft(nvme_root_t r, char *hostnqn_arg, char *hostid_arg,
 		       char *hostnqn_sys, char *hostid_sys,
 		       const char *desc, bool connect,
 		       const struct nvme_fabrics_config *cfg, char *nbft_path,
-		       enum nvme_print_flags flags, unsigned int verbose)
+		       enum nvme_print_flags flags, unsigned int verbose,
+		       unsigned int nr_parallel)
 {
-	char *hostnqn = NULL, *hostid = NULL, *host_traddr = NULL;
+	char *hostnqn = NULL, *hostid = NULL;
 	nvme_host_t h;
 	int ret, i;
 	struct list_head nbft_list;
 	struct nbft_file_entry *entry = NULL;
 	struct nbft_info_subsystem_ns **ss;
-	struct nbft_info_hfi *hfi;
+	struct nbft_connect *conns = NULL, *conn;
+	unsigned int n, nr_conns = 0;
+	uint64_t start = monotonic_ns();
+
+	struct nbft_connect_ctx ctx = {
+		.r		= r,
+		.cfg		= cfg,
+		.flags		= flags,
+		.verbose	= verbose,
+	};
 
 	if (!connect)
 		/* to do: print discovery-type info from NBFT tables */
@@ -194,55 +283,36 @@ int discover_from_nbft(nvme_root_t r, char *hostnqn_arg, char *hostid_arg,
 
 		for (ss = entry->nbft->subsystem_ns_list; ss && *ss; ss++)
 			for (i = 0; i < (*ss)->num_hfis; i++) {
-				hfi = (*ss)->hfis[i];
-
-				if (!cfg->host_traddr) {
-					host_traddr = NULL;
-					if (!strncmp((*ss)->transport, "tcp", 3))
-						host_traddr = hfi->tcp_info.ipaddr;
+				conn = realloc(conns, (nr_conns + 1) * sizeof(*conn));
+				if (!conn) {
+					errno = ENOMEM;
+					goto out_free;
 				}
-
-				struct tr_config trcfg = {
-					.subsysnqn	= (*ss)->subsys_nqn,
-					.transport	= (*ss)->transport,
-					.traddr		= (*ss)->traddr,
-					.host_traddr	= host_traddr,
-					.host_iface	= NULL,
-					.trsvcid	= (*ss)->trsvcid,
+				conns = conn;
+				conns[nr_conns++] = (struct nbft_connect) {
+					.h	= h,
+					.ss	= *ss,
+					.hfi	= (*ss)->hfis[i],
 				};
+			}
+	}
 
-				ret = do_connect(r, h, *ss, &trcfg,
-						 cfg, flags, verbose);
-
-				/*
-				 * With TCP/DHCP, it can happen that the OS
-				 * obtains a different local IP address than the
-				 * firmware had. Retry without host_traddr.
-				 */
-				if (ret == -ENVME_CONNECT_ADDRNOTAVAIL &&
-				    !strcmp((*ss)->transport, "tcp") &&
-				    strlen(hfi->tcp_info.dhcp_server_ipaddr) > 0) {
-					trcfg.host_traddr = NULL;
-
-					ret = do_connect(r, h, *ss, &trcfg,
-							 cfg, flags, verbose);
-
-					if (ret == 0 && verbose >= 1)
-						fprintf(stderr,
-							"SSNS %d: connect with host_traddr=\"%s\" failed, success after omitting host_traddr\n",
-							(*ss)->index,
-							host_traddr);
-				}
+	ctx.conns = conns;
+	if (nr_parallel > 1) {
+		nvmf_run_forked(nr_conns, nr_parallel, nbft_connect_fn, &ctx,
+				NULL);
+	} else {
+		for (n = 0; n < nr_conns; n++)
+			if (nbft_connect_hfi(&ctx, &conns[n]) == -ENOMEM)
+				goto out_free;
+	}
 
-				if (ret)
-					fprintf(stderr, "SSNS %d: no controller found\n",
-						(*ss)->index);
+	if (verbose >= 1)
+		fprintf(stderr, "NBFT: %u connection(s) in %.3f ms\n", nr_conns,
+			(monotonic_ns() - start) / 1e6);
 
-				if (ret == -ENOMEM)
-					goto out_free;
-			}
-	}
 out_free:
+	free(conns);
 	free_nbfts(&nbft_list);
 	return errno;
 }
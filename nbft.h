@@ -16,4 +16,5 @@ extern int discover_from_nbft(nvme_root_t r, char *hostnqn_arg, char *hostid_arg
 			      char *hostnqn_sys, char *hostid_sys,
 			      const char *desc, bool connect,
 			      const struct nvme_fabrics_config *cfg, char *nbft_path,
-			      enum nvme_print_flags flags, unsigned int verbose);
+			      enum nvme_print_flags flags, unsigned int verbose,
+			      unsigned int nr_parallel);
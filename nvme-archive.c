@@ -0,0 +1,530 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * decode-archive: bulk decoding of saved captures on a pool of workers.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "nvme-archive.h"
+#include "nvme-print.h"
+#include "util/capture.h"
+#include "util/json.h"
+#include "util/bundle.h"
+#include "util/tar.h"
+#include "util/thread-pool.h"
+
+/* captures decoded before their records are printed and freed */
+#define ARCHIVE_BATCH		4096
+#define ARCHIVE_NFTW_FDS	16
+
+struct archive_entry {
+	char *name;
+	void *data;		/* in the mapped archive or capture */
+	size_t len;
+	const struct nvme_capture_decoder *d;
+	char *out;		/* the serialized records */
+	size_t out_len;
+	int err;
+	struct archive *a;
+};
+
+struct archive {
+	struct archive_entry *e;
+	size_t nr;
+	size_t size;
+	const struct nvme_capture_decoder *type;
+	struct nvme_thread_pool *pool;
+	int err;		/* the first error emitting the entries */
+};
+
+static struct nvme_capture_decoder *capture_decoders;
+
+void register_capture_decoder(struct nvme_capture_decoder *d)
+{
+	struct nvme_capture_decoder **p;
+
+	for (p = &capture_decoders; *p; p = &(*p)->next)
+		;
+	*p = d;
+}
+
+#if CONFIG_LAZY_PLUGINS
+/* bounds of the table of decoders, see NVME_CAPTURE_DECODER() */
+extern struct nvme_capture_decoder *const __start_nvme_capture_decoders[]
+	__attribute__((weak));
+extern struct nvme_capture_decoder *const __stop_nvme_capture_decoders[]
+	__attribute__((weak));
+
+static void register_capture_decoders(void)
+{
+	static bool registered;
+	struct nvme_capture_decoder *const *p;
+
+	if (registered)
+		return;
+	registered = true;
+	for (p = __start_nvme_capture_decoders; p < __stop_nvme_capture_decoders; p++)
+		register_capture_decoder(*p);
+}
+#else
+static void register_capture_decoders(void)
+{
+}
+#endif
+
+/*
+ * The decoders of the logs nvme-cli prints itself take the object of the
+ * json print op, json_show_capture() is per thread.
+ */
+static struct json_object *smart_log_json(void *data, size_t len)
+{
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_smart_log(data, NVME_NSID_ALL, "", JSON);
+	json_show_capture(NULL);
+	return o;
+}
+
+static struct json_object *error_log_json(void *data, size_t len)
+{
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_error_log(data, len / sizeof(struct nvme_error_log_page), "", JSON);
+	json_show_capture(NULL);
+	return o;
+}
+
+static struct json_object *fw_log_json(void *data, size_t len)
+{
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_fw_log(data, "", JSON);
+	json_show_capture(NULL);
+	return o;
+}
+
+static struct json_object *id_ctrl_json(void *data, size_t len)
+{
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_id_ctrl(data, JSON, NULL);
+	json_show_capture(NULL);
+	return o;
+}
+
+static struct json_object *id_ns_json(void *data, size_t len)
+{
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_id_ns(data, 0, 0, false, JSON);
+	json_show_capture(NULL);
+	return o;
+}
+
+/* the header of a telemetry-log capture, the data areas are vendor specific */
+static struct json_object *telemetry_log_json(void *data, size_t len)
+{
+	struct nvme_telemetry_log *log = data;
+	struct json_object *o = json_create_object();
+	size_t blocks = len / NVME_LOG_TELEM_BLOCK_SIZE;
+	char ieee[16];
+
+	snprintf(ieee, sizeof(ieee), "%02x%02x%02x",
+		 log->ieee[2], log->ieee[1], log->ieee[0]);
+	json_object_add_value_uint(o, "log_identifier", log->lpi);
+	json_object_add_value_string(o, "ieee_oui", ieee);
+	json_object_add_value_uint(o, "data_area_1_last_block", le16_to_cpu(log->dalb1));
+	json_object_add_value_uint(o, "data_area_2_last_block", le16_to_cpu(log->dalb2));
+	json_object_add_value_uint(o, "data_area_3_last_block", le16_to_cpu(log->dalb3));
+	json_object_add_value_uint(o, "data_area_4_last_block", le32_to_cpu(log->dalb4));
+	json_object_add_value_uint(o, "host_generation", log->hostdgn);
+	json_object_add_value_uint(o, "ctrl_data_available", log->ctrlavail);
+	json_object_add_value_uint(o, "ctrl_generation", log->ctrldgn);
+	json_object_add_value_uint64(o, "blocks", blocks);
+	/* whether the capture holds the data areas up to area 3 */
+	json_object_object_add(o, "complete",
+			       json_object_new_boolean(blocks > le16_to_cpu(log->dalb3)));
+	return o;
+}
+
+static struct nvme_capture_decoder smart_log_decoder = {
+	.name	= "smart-log",
+	.keys	= NVME_CAPTURE_KEYS("smart-log", "smart"),
+	.size	= sizeof(struct nvme_smart_log),
+	.json	= smart_log_json,
+};
+NVME_CAPTURE_DECODER(smart_log_decoder)
+
+static struct nvme_capture_decoder error_log_decoder = {
+	.name	= "error-log",
+	.keys	= NVME_CAPTURE_KEYS("error-log", "error"),
+	.size	= sizeof(struct nvme_error_log_page),
+	.whole	= true,
+	.json	= error_log_json,
+};
+NVME_CAPTURE_DECODER(error_log_decoder)
+
+static struct nvme_capture_decoder fw_log_decoder = {
+	.name	= "fw-log",
+	.keys	= NVME_CAPTURE_KEYS("fw-log", "fw"),
+	.size	= sizeof(struct nvme_firmware_slot),
+	.json	= fw_log_json,
+};
+NVME_CAPTURE_DECODER(fw_log_decoder)
+
+static struct nvme_capture_decoder id_ctrl_decoder = {
+	.name	= "id-ctrl",
+	.keys	= NVME_CAPTURE_KEYS("id-ctrl"),
+	.size	= sizeof(struct nvme_id_ctrl),
+	.json	= id_ctrl_json,
+};
+NVME_CAPTURE_DECODER(id_ctrl_decoder)
+
+static struct nvme_capture_decoder id_ns_decoder = {
+	.name	= "id-ns",
+	.keys	= NVME_CAPTURE_KEYS("id-ns"),
+	.size	= sizeof(struct nvme_id_ns),
+	.json	= id_ns_json,
+};
+NVME_CAPTURE_DECODER(id_ns_decoder)
+
+static struct nvme_capture_decoder telemetry_log_decoder = {
+	.name	= "telemetry-log",
+	.keys	= NVME_CAPTURE_KEYS("telemetry-log", "telemetry"),
+	.size	= NVME_LOG_TELEM_BLOCK_SIZE,
+	.whole	= true,
+	.json	= telemetry_log_json,
+};
+NVME_CAPTURE_DECODER(telemetry_log_decoder)
+
+static bool name_sep(char c)
+{
+	return c == '-' || c == '_' || c == '.' || c == '/';
+}
+
+static bool name_char_eq(char a, char b)
+{
+	if ((a == '-' || a == '_') && (b == '-' || b == '_'))
+		return true;
+	return tolower((unsigned char)a) == tolower((unsigned char)b);
+}
+
+/* whether @key is made of whole words of @name, '-' matching '_' */
+static bool name_match(const char *name, const char *key)
+{
+	size_t n = strlen(key), i;
+	const char *p;
+
+	for (p = name; *p; p++) {
+		if (p != name && !name_sep(p[-1]))
+			continue;
+		for (i = 0; i < n && p[i] && name_char_eq(p[i], key[i]); i++)
+			;
+		if (i == n && (!p[n] || name_sep(p[n])))
+			return true;
+	}
+
+	return false;
+}
+
+/* the decoder of the longest key found in the file name, "smart-add-log" over "smart" */
+static const struct nvme_capture_decoder *decoder_by_name(const char *name)
+{
+	const struct nvme_capture_decoder *d, *best = NULL;
+	const char *base = strrchr(name, '/');
+	const char *const *k;
+	size_t len = 0;
+
+	base = base ? base + 1 : name;
+	for (d = capture_decoders; d; d = d->next) {
+		for (k = d->keys; *k; k++) {
+			if (strlen(*k) > len && name_match(base, *k)) {
+				best = d;
+				len = strlen(*k);
+			}
+		}
+	}
+
+	return best;
+}
+
+static const struct nvme_capture_decoder *decoder_by_type(const char *type)
+{
+	const struct nvme_capture_decoder *d;
+
+	for (d = capture_decoders; d; d = d->next)
+		if (!strcmp(d->name, type))
+			return d;
+
+	return NULL;
+}
+
+static int archive_add(struct archive *a, const char *name, void *data, size_t len)
+{
+	const struct nvme_capture_decoder *d = a->type ?: decoder_by_name(name);
+	struct archive_entry *e;
+
+	if (!d) {
+		fprintf(stderr, "%s: unknown capture, skipped\n", name);
+		return 0;
+	}
+
+	if (a->nr == a->size) {
+		size_t size = a->size ? 2 * a->size : 1024;
+
+		e = realloc(a->e, size * sizeof(*e));
+		if (!e)
+			return -ENOMEM;
+		a->e = e;
+		a->size = size;
+	}
+
+	e = &a->e[a->nr];
+	memset(e, 0, sizeof(*e));
+	e->name = strdup(name);
+	if (!e->name)
+		return -ENOMEM;
+	e->data = data;
+	e->len = len;
+	e->d = d;
+	a->nr++;
+
+	return 0;
+}
+
+static int archive_add_member(const char *name, const void *data, size_t len, void *arg)
+{
+	/* the archive is mapped privately, decoders may write to it */
+	return archive_add(arg, name, (void *)data, len);
+}
+
+/* nftw() has no argument for its callback */
+static struct archive *archive_scan;
+
+static int archive_add_file(const char *path, const struct stat *st, int flag,
+			    struct FTW *ftw)
+{
+	if (flag != FTW_F || !S_ISREG(st->st_mode))
+		return 0;
+	return archive_add(archive_scan, path, NULL, st->st_size);
+}
+
+static int archive_entry_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct archive_entry *)a)->name,
+		      ((const struct archive_entry *)b)->name);
+}
+
+static int archive_scan_dir(struct archive *a, const char *path)
+{
+	int err;
+
+	archive_scan = a;
+	err = nftw(path, archive_add_file, ARCHIVE_NFTW_FDS, FTW_PHYS);
+	archive_scan = NULL;
+	if (err)
+		return err < 0 ? -errno : err;
+
+	/* the order of readdir() isn't stable across file systems */
+	if (a->nr)
+		qsort(a->e, a->nr, sizeof(*a->e), archive_entry_cmp);
+
+	return 0;
+}
+
+static struct json_object *archive_record(const struct archive_entry *e, long index)
+{
+	struct json_object *r = json_create_object();
+
+	json_object_add_value_string(r, "file", e->name);
+	json_object_add_value_string(r, "type", e->d->name);
+	if (index >= 0)
+		json_object_add_value_uint64(r, "record", index);
+
+	return r;
+}
+
+static int archive_decode_record(FILE *f, const struct archive_entry *e, long index,
+				 void *data, size_t len)
+{
+	struct json_object *r = archive_record(e, index), *o;
+
+	o = e->d->json(data, len);
+	if (o)
+		json_object_add_value_object(r, "data", o);
+	else
+		json_object_add_value_string(r, "error", "not a valid capture");
+	util_json_write_record(f, r, false);
+
+	return o ? 0 : -EINVAL;
+}
+
+static void archive_decode(void *arg)
+{
+	struct archive_entry *e = arg;
+	struct nvme_capture c = { 0 };
+	struct json_object *r;
+	size_t size = e->d->size, off;
+	void *data = e->data;
+	size_t len = e->len;
+	int err = 0, ret;
+	FILE *f;
+
+	f = open_memstream(&e->out, &e->out_len);
+	if (!f) {
+		e->err = -ENOMEM;
+		return;
+	}
+
+	if (!data) {
+		err = nvme_capture_map(e->name, &c);
+		data = c.data;
+		len = c.len;
+	}
+	if (!err && (!len || len % size))
+		err = -EINVAL;
+
+	if (err) {
+		r = archive_record(e, -1);
+		json_object_add_value_string(r, "error", err == -EINVAL ?
+					     "not a whole number of records" :
+					     nvme_strerror(-err));
+		util_json_write_record(f, r, false);
+	} else if (e->d->whole || len == size) {
+		err = archive_decode_record(f, e, -1, data, len);
+	} else {
+		for (off = 0; off < len; off += size) {
+			ret = archive_decode_record(f, e, off / size,
+						    (__u8 *)data + off, size);
+			if (ret && !err)
+				err = ret;
+		}
+	}
+
+	nvme_capture_unmap(&c);
+	if (fclose(f) && !err)
+		err = -ENOMEM;
+	e->err = err;
+}
+
+/* write out the records of an entry, in archive order */
+static void archive_emit(void *arg, int err)
+{
+	struct archive_entry *e = arg;
+	struct archive *a = e->a;
+
+	if (!err && e->out_len && fwrite(e->out, e->out_len, 1, stdout) != 1) {
+		/* the other entries can't be written either */
+		err = -EIO;
+		if (a->pool)
+			nvme_thread_pool_cancel(a->pool, err);
+	}
+	free(e->out);
+	e->out = NULL;
+
+	if (!err)
+		err = e->err;
+	if (err && err != -ECANCELED && !a->err)
+		a->err = err;
+}
+
+static int archive_run(struct archive *a, unsigned int jobs)
+{
+	struct archive_entry *e;
+	size_t i, n;
+	int err;
+
+	a->pool = nvme_thread_pool_create(nvme_thread_pool_jobs(jobs, a->nr));
+
+	/* the records stream out as decoded, the batches bound the buffered ones */
+	for (i = 0; i < a->nr && a->err != -EIO; i = n) {
+		n = min(i + ARCHIVE_BATCH, a->nr);
+		for (; i < n; i++) {
+			e = &a->e[i];
+			e->a = a;
+			err = a->pool ? nvme_thread_pool_queue_ordered(a->pool,
+					archive_decode, archive_emit, e) : -ENOMEM;
+			if (err == -ECANCELED)
+				break;
+			if (err) {
+				/* run it here, behind the queued ones */
+				if (a->pool)
+					nvme_thread_pool_wait(a->pool);
+				archive_decode(e);
+				archive_emit(e, 0);
+			}
+		}
+		if (a->pool)
+			nvme_thread_pool_wait(a->pool);
+	}
+
+	nvme_thread_pool_destroy(a->pool);
+	a->pool = NULL;
+	if (fflush(stdout) && !a->err)
+		a->err = -EIO;
+
+	return a->err;
+}
+
+int nvme_decode_archive(const struct nvme_archive_cfg *cfg)
+{
+	const struct nvme_capture_decoder *d;
+	struct nvme_capture map = { 0 };
+	struct archive a = { 0 };
+	struct stat st;
+	size_t i;
+	int err;
+
+	register_capture_decoders();
+
+	if (cfg->type) {
+		a.type = decoder_by_type(cfg->type);
+		if (!a.type) {
+			fprintf(stderr, "unknown capture type %s, one of:", cfg->type);
+			for (d = capture_decoders; d; d = d->next)
+				fprintf(stderr, " %s", d->name);
+			fprintf(stderr, "\n");
+			return -EINVAL;
+		}
+	}
+
+	if (stat(cfg->path, &st))
+		return -errno;
+
+	if (S_ISDIR(st.st_mode)) {
+		err = archive_scan_dir(&a, cfg->path);
+	} else {
+		/* a tar archive, a capture bundle, or a single capture */
+		err = nvme_capture_map(cfg->path, &map);
+		if (!err && nvme_tar_is_archive(map.data, map.len))
+			err = nvme_tar_walk(map.data, map.len, archive_add_member, &a);
+		else if (!err && nvme_bundle_is_bundle(map.data, map.len))
+			err = nvme_bundle_walk(map.data, map.len, archive_add_member, &a);
+		else if (!err)
+			err = archive_add(&a, cfg->path, map.data, map.len);
+	}
+
+	if (!err)
+		err = archive_run(&a, cfg->jobs);
+
+	for (i = 0; i < a.nr; i++)
+		free(a.e[i].name);
+	free(a.e);
+	nvme_capture_unmap(&map);
+
+	return err;
+}
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_ARCHIVE_H
+#define NVME_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Bulk decoding of saved captures for decode-archive. The captures of a
+ * directory tree, of an uncompressed tar archive or of a capture bundle
+ * are decoded by a pool of workers and printed as one JSON record each,
+ * in the order they were found. The decoder of a file is picked by the words of its name, e.g.
+ * "nvme0-smart-log.bin" as written by collect, or forced for all of them.
+ */
+
+struct json_object;
+
+/*
+ * A kind of capture decode-archive knows, registered by the plugin
+ * decoding it with NVME_CAPTURE_DECODER().
+ */
+struct nvme_capture_decoder {
+	const char *name;		/* the "type" of the records, for --type */
+	const char *const *keys;	/* words of the file names it decodes */
+	size_t size;			/* of a record, a file holds one or more */
+	bool whole;			/* a file is one record of size byte entries */
+	/*
+	 * Decode @len bytes at @data, returns NULL if it isn't valid. Called
+	 * from several threads at once.
+	 */
+	struct json_object *(*json)(void *data, size_t len);
+	struct nvme_capture_decoder *next;
+};
+
+/* the NULL terminated .keys of a decoder */
+#define NVME_CAPTURE_KEYS(...)	((const char *const []){ __VA_ARGS__, NULL })
+
+void register_capture_decoder(struct nvme_capture_decoder *d);
+
+#if CONFIG_LAZY_PLUGINS
+/* collected by the linker like the plugins, see PLUGIN() in cmd_handler.h */
+#define NVME_CAPTURE_DECODER(d)						\
+static struct nvme_capture_decoder *const d##_entry			\
+	__attribute__((used, section("nvme_capture_decoders"),		\
+		       aligned(sizeof(void *)))) = &d;
+#else
+#define NVME_CAPTURE_DECODER(d)						\
+static void d##_register(void) __attribute__((constructor));		\
+static void d##_register(void)						\
+{									\
+	register_capture_decoder(&d);					\
+}
+#endif
+
+struct nvme_archive_cfg {
+	const char *path;		/* directory, tar archive, bundle or a capture */
+	const char *type;		/* decoder of every file, NULL by name */
+	unsigned int jobs;		/* workers decoding concurrently */
+};
+
+/*
+ * nvme_decode_archive - print the records of the captures of @cfg->path
+ *
+ * The records go to stdout in the output mode selected with -o. Returns 0,
+ * or a negative errno if the archive couldn't be read or a capture wasn't
+ * valid.
+ */
+int nvme_decode_archive(const struct nvme_archive_cfg *cfg);
+
+#endif /* NVME_ARCHIVE_H */
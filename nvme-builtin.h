@@ -32,18 +32,27 @@ COMMAND_LIST(
 	ENTRY("delete-ns", "Deletes a namespace from the controller", delete_ns)
 	ENTRY("attach-ns", "Attaches a namespace to requested controller(s)", attach_ns)
 	ENTRY("detach-ns", "Detaches a namespace from requested controller(s)", detach_ns)
+	ENTRY("provision-ns", "Creates and attaches the namespaces of a layout in one pass", provision_ns)
 	ENTRY("get-ns-id", "Retrieve the namespace ID of opened block device", get_ns_id)
 	ENTRY("get-log", "Generic NVMe get log, returns log in raw format", get_log)
 	ENTRY("telemetry-log", "Retrieve FW Telemetry log write to file", get_telemetry_log)
+	ENTRY("collect", "Retrieve logs from several devices concurrently", collect)
+	ENTRY("serve", "Serve requests on a Unix socket with cached devices", serve)
+	ENTRY("exporter", "Serve controller logs as Prometheus metrics over HTTP", exporter)
+	ENTRY("decode-archive", "Decode the log captures of a directory or tar archive in parallel", decode_archive)
 	ENTRY("fw-log", "Retrieve FW Log, show it", get_fw_log)
 	ENTRY("changed-ns-list-log", "Retrieve Changed Namespace List, show it", get_changed_ns_list_log)
 	ENTRY("smart-log", "Retrieve SMART Log, show it", get_smart_log)
+	ENTRY("thermal-monitor", "Sample the temperatures and thermal throttling of a controller", thermal_monitor)
+	ENTRY("latency-histogram", "Show the percentiles of a vendor latency log, or sample it", latency_histogram)
 	ENTRY("ana-log", "Retrieve ANA Log, show it", get_ana_log)
 	ENTRY("error-log", "Retrieve Error Log, show it", get_error_log)
+	ENTRY("monitor-events", "Read the log pages named by asynchronous events", monitor_events)
 	ENTRY("effects-log", "Retrieve Command Effects Log, show it", get_effects_log)
 	ENTRY("endurance-log", "Retrieve Endurance Group Log, show it", get_endurance_log)
 	ENTRY("predictable-lat-log", "Retrieve Predictable Latency per Nvmset Log, show it", get_pred_lat_per_nvmset_log)
 	ENTRY("pred-lat-event-agg-log", "Retrieve Predictable Latency Event Aggregate Log, show it", get_pred_lat_event_agg_log)
+	ENTRY("plm-scheduler", "Rotate replica drives between the Predictable Latency Mode windows", plm_scheduler)
 	ENTRY("persistent-event-log", "Retrieve Persistent Event Log, show it", get_persistent_event_log)
 	ENTRY("endurance-event-agg-log", "Retrieve Endurance Group Event Aggregate Log, show it", get_endurance_event_agg_log)
 	ENTRY("lba-status-log", "Retrieve LBA Status Information Log, show it", get_lba_status_log)
@@ -52,6 +61,7 @@ COMMAND_LIST(
 	ENTRY("phy-rx-eom-log", "Retrieve Physical Interface Receiver Eye Opening Measurement, show it", get_phy_rx_eom_log)
 	ENTRY("get-feature", "Get feature and show the resulting value", get_feature)
 	ENTRY("device-self-test", "Perform the necessary tests to observe the performance", device_self_test)
+	ENTRY("self-test-run", "Run a device self-test on several devices in parallel", self_test_run)
 	ENTRY("self-test-log", "Retrieve the SELF-TEST Log, show it", self_test_log)
 	ENTRY("supported-log-pages", "Retrieve the Supported Log pages details, show it", get_supported_log_pages)
 	ENTRY("fid-support-effects-log", "Retrieve FID Support and Effects log and show it", get_fid_support_effects_log)
@@ -59,31 +69,48 @@ COMMAND_LIST(
 	ENTRY("media-unit-stat-log", "Retrieve the configuration and wear of media units, show it", get_media_unit_stat_log)
 	ENTRY("supported-cap-config-log", "Retrieve the list of Supported Capacity Configuration Descriptors", get_supp_cap_config_log)
 	ENTRY("set-feature", "Set a feature and show the resulting value", set_feature)
+	ENTRY("config-snapshot", "Capture the features, power states and namespaces of a controller", config_snapshot)
+	ENTRY("config-diff", "Compare two snapshots of config-snapshot", config_diff)
 	ENTRY("set-property", "Set a property and show the resulting value", set_property)
 	ENTRY("get-property", "Get a property and show the resulting value", get_property)
 	ENTRY("format", "Format namespace with new block format", format_cmd)
+	ENTRY("format-run", "Format several namespaces in parallel", format_run)
 	ENTRY("fw-commit", "Verify and commit firmware to a specific slot (fw-activate in old version < 1.2)", fw_commit, "fw-activate")
 	ENTRY("fw-download", "Download new firmware", fw_download)
+	ENTRY("fw-rollout", "Download and commit firmware on several devices in parallel", fw_rollout)
 	ENTRY("admin-passthru", "Submit an arbitrary admin command, return results", admin_passthru)
 	ENTRY("io-passthru", "Submit an arbitrary IO command, return results", io_passthru)
+	ENTRY("passthru-replay", "Replay a trace of passthru commands, report the latency per opcode", passthru_replay)
 	ENTRY("security-send", "Submit a Security Send command, return results", sec_send)
 	ENTRY("security-recv", "Submit a Security Receive command, return results", sec_recv)
 	ENTRY("get-lba-status", "Submit a Get LBA Status command, return results", get_lba_status)
 	ENTRY("capacity-mgmt", "Submit Capacity Management Command, return results", capacity_mgmt)
+	ENTRY("capacity-layout", "Delete, select and create Endurance Groups and NVM Sets in one go", capacity_layout)
 	ENTRY("resv-acquire", "Submit a Reservation Acquire, return results", resv_acquire)
 	ENTRY("resv-register", "Submit a Reservation Register, return results", resv_register)
 	ENTRY("resv-release", "Submit a Reservation Release, return results", resv_release)
+	ENTRY("resv-batch", "Register, acquire or release the reservations of many namespaces at once", resv_batch)
 	ENTRY("resv-report", "Submit a Reservation Report, return results", resv_report)
 	ENTRY("dsm", "Submit a Data Set Management command, return results", dsm)
 	ENTRY("copy", "Submit a Simple Copy command, return results", copy_cmd)
 	ENTRY("flush", "Submit a Flush command, return results", flush_cmd)
 	ENTRY("compare", "Submit a Compare command, return results", compare)
+	ENTRY("compare-write", "Submit a Compare and, if it matched, a Write, return results", compare_write)
+	ENTRY("compare-hash", "Compare logical blocks against a CRC-32C manifest at queue depth", compare_hash)
 	ENTRY("read", "Submit a read command, return results", read_cmd)
 	ENTRY("write", "Submit a write command, return results", write_cmd)
 	ENTRY("write-zeroes", "Submit a write zeroes command, return results", write_zeroes)
 	ENTRY("write-uncor", "Submit a write uncorrectable command, return results", write_uncor)
 	ENTRY("verify", "Submit a verify command, return results", verify_cmd)
+	ENTRY("io-bench", "Run read, write or compare commands at queue depth, report throughput and latency", io_bench)
+	ENTRY("power-bench", "Run a read workload in every power state, report performance per watt", power_bench)
+	ENTRY("tune-sweep", "Benchmark a grid of interrupt coalescing and arbitration settings", tune_sweep)
+	ENTRY("flush-bench", "Benchmark Flush and FUA writes with the volatile write cache on and off", flush_bench)
+	ENTRY("pmr-bench", "Benchmark the bandwidth and persist latency of the Persistent Memory Region", pmr_bench)
+	ENTRY("dsm-bench", "Compare the latency and media writes of regions with different DSM context attributes", dsm_bench)
+	ENTRY("compare-write-bench", "Take and release block locks with Compare and Write pairs", compare_write_bench)
 	ENTRY("sanitize", "Submit a sanitize command", sanitize_cmd)
+	ENTRY("sanitize-run", "Sanitize several devices in parallel and monitor the progress", sanitize_run)
 	ENTRY("sanitize-log", "Retrieve sanitize log, show it", sanitize_log)
 	ENTRY("reset", "Resets the controller", reset)
 	ENTRY("subsystem-reset", "Resets the subsystem", subsystem_reset)
@@ -94,6 +121,7 @@ COMMAND_LIST(
 	ENTRY("discover", "Discover NVMeoF subsystems", discover_cmd)
 	ENTRY("connect-all", "Discover and Connect to NVMeoF subsystems", connect_all_cmd)
 	ENTRY("connect", "Connect to NVMeoF subsystem", connect_cmd)
+	ENTRY("connect-advise", "Recommend an I/O queue layout for an NVMeoF subsystem", connect_advise_cmd)
 	ENTRY("disconnect", "Disconnect from NVMeoF subsystem", disconnect_cmd)
 	ENTRY("disconnect-all", "Disconnect from all connected NVMeoF subsystems", disconnect_all_cmd)
 	ENTRY("config", "Configuration of NVMeoF subsystems", config_cmd)
@@ -106,15 +134,20 @@ COMMAND_LIST(
 	ENTRY("tls-key", "Manipulate NVMeoF TLS PSK", tls_key)
 	ENTRY("dir-receive", "Submit a Directive Receive command, return results", dir_receive)
 	ENTRY("dir-send", "Submit a Directive Send command, return results", dir_send)
+	ENTRY("dir-streams", "Allocate, release or report the Streams resources of namespaces", dir_streams)
 	ENTRY("virt-mgmt", "Manage Flexible Resources between Primary and Secondary Controller", virtual_mgmt)
+	ENTRY("virt-provision", "Split the Flexible Resources between many Secondary Controllers and bring them online", virt_provision)
 	ENTRY("rpmb", "Replay Protection Memory Block commands", rpmb_cmd)
 	ENTRY("lockdown", "Submit a Lockdown command,return result", lockdown_cmd)
 	ENTRY("dim", "Send Discovery Information Management command to a Discovery Controller", dim_cmd) \
 	ENTRY("show-topology", "Show the topology", show_topology_cmd) \
+	ENTRY("path-probe", "Measure the I/O latency of every multipath path", path_probe) \
 	ENTRY("io-mgmt-recv", "I/O Management Receive", io_mgmt_recv)
 	ENTRY("io-mgmt-send", "I/O Management Send", io_mgmt_send)
 	ENTRY("nvme-mi-recv", "Submit a NVMe-MI Receive command, return results", nmi_recv)
 	ENTRY("nvme-mi-send", "Submit a NVMe-MI Send command, return results", nmi_send)
+	ENTRY("nvme-mi-poll", "Poll the health of an NVMe-MI endpoint, report the command latencies", nmi_poll)
+	ENTRY("nvme-mi-sweep", "Poll the health of several NVMe-MI endpoints concurrently", nmi_sweep)
 );
 
 #endif
@@ -0,0 +1,779 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Prometheus exporter serving the decoded log fields of the json print ops.
+ */
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "nvme-print.h"
+#include "nvme-exporter.h"
+#include "nvme-fanout.h"
+#include "util/json.h"
+#include "plugins/ocp/ocp-smart-extended-log.h"
+
+#define EXPORTER_MAX_CLIENTS	16
+#define EXPORTER_REQ_MAX	4096
+#define EXPORTER_NAME_MAX	128
+#define EXPORTER_LABELS_MAX	64
+#define EXPORTER_CLIENT_MS	5000	/* for a request and its response */
+
+struct metric {
+	char name[EXPORTER_NAME_MAX];
+	char labels[EXPORTER_LABELS_MAX];
+	double value;
+	size_t seq;		/* keeps the fetch order within a name */
+};
+
+struct metrics {
+	struct metric *m;
+	size_t nr;
+	size_t size;
+};
+
+/*
+ * The client sockets are non-blocking: a response is sent as the client
+ * takes it, in the poll loop, and a client that didn't get it within
+ * EXPORTER_CLIENT_MS of connecting is dropped.
+ */
+struct exporter_client {
+	int fd;
+	__u64 deadline;
+	size_t len;
+	char buf[EXPORTER_REQ_MAX];
+	char *out;		/* the response, with the headers */
+	size_t out_len;
+	size_t out_off;		/* bytes of it sent */
+};
+
+static volatile sig_atomic_t exporter_stop;
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/* wakes the fetch thread on stop */
+	char *page;		/* last rendered page, owned by the lock */
+	size_t len;
+} exporter = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void nvme_exporter_stop(void)
+{
+	exporter_stop = 1;
+}
+
+static void metrics_add(struct metrics *ms, const char *name,
+			const char *labels, double value)
+{
+	struct metric *m;
+
+	if (ms->nr == ms->size) {
+		size_t size = ms->size ? 2 * ms->size : 256;
+
+		m = realloc(ms->m, size * sizeof(*m));
+		if (!m)
+			return;
+		ms->m = m;
+		ms->size = size;
+	}
+
+	m = &ms->m[ms->nr];
+	snprintf(m->name, sizeof(m->name), "%s", name);
+	snprintf(m->labels, sizeof(m->labels), "%s", labels);
+	m->value = value;
+	m->seq = ms->nr++;
+}
+
+/* "Bad user nand blocks - Raw" becomes <prefix>_bad_user_nand_blocks_raw */
+static void metric_name(char *buf, size_t len, const char *prefix,
+			const char *key)
+{
+	size_t n = snprintf(buf, len, "%s", prefix);
+	bool sep = true;
+
+	for (; *key && n + 2 < len; key++) {
+		char c = *key;
+
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) {
+			if (sep)
+				buf[n++] = '_';
+			buf[n++] = c;
+			sep = false;
+		} else {
+			sep = true;
+		}
+	}
+	buf[n] = '\0';
+}
+
+/*
+ * Every number of a print op object is a sample. Nested objects extend the
+ * name, 128 bit counters are decimal strings and other strings and arrays
+ * are skipped.
+ */
+static void metrics_add_json(struct metrics *ms, const char *prefix,
+			     const char *labels, struct json_object *o)
+{
+	char name[EXPORTER_NAME_MAX], *end;
+	const char *str;
+	double v;
+
+	json_object_object_foreach(o, key, val) {
+		metric_name(name, sizeof(name), prefix, key);
+
+		switch (json_object_get_type(val)) {
+		case json_type_int:
+		case json_type_double:
+			v = json_object_get_double(val);
+			break;
+		case json_type_boolean:
+			v = json_object_get_boolean(val);
+			break;
+		case json_type_string:
+			str = json_object_get_string(val);
+			if (*str < '0' || *str > '9')
+				continue;
+			v = strtod(str, &end);
+			if (*end)
+				continue;
+			break;
+		case json_type_object:
+			metrics_add_json(ms, name, labels, val);
+			continue;
+		default:
+			continue;
+		}
+
+		metrics_add(ms, name, labels, v);
+	}
+}
+
+/* hand the object of the last json print op to metrics_add_json() */
+static void metrics_add_capture(struct metrics *ms, const char *prefix,
+				const char *labels, struct json_object **o)
+{
+	json_show_capture(NULL);
+	if (*o)
+		metrics_add_json(ms, prefix, labels, *o);
+	json_free_object(*o);
+	*o = NULL;
+}
+
+/* the logs of an endurance group, read in the fetch of its controller */
+struct exporter_endgrp {
+	__u16 endgid;
+	struct nvme_fanout_log endurance;
+	struct nvme_fanout_log stats;
+	int endurance_err;
+	int stats_err;
+	struct nvme_buf endurance_buf;
+	struct nvme_buf stats_buf;
+};
+
+/*
+ * The commands of a controller are chained from their callbacks; the
+ * metrics are added once all controllers are done, in the scan order.
+ */
+struct exporter_ctrl {
+	const char *name;
+	bool fdp;
+	int fd;
+	__u64 start;
+	__u64 end;
+
+	struct nvme_fanout *f;
+	struct nvme_fanout_log smart;
+	struct nvme_fanout_cmd id;
+	struct nvme_fanout_cmd endgrps;
+	struct nvme_fanout_log c0;
+	int smart_err;
+	int id_err;
+	int endgrps_err;
+	int c0_err;
+	/* fetched every interval, the buffers come from the pool */
+	struct nvme_buf smart_buf, ctrl_buf, endgrps_buf, c0_buf;
+
+	struct exporter_endgrp *eg;
+	int nr_eg;
+};
+
+static void exporter_log_setup(struct nvme_fanout_log *log, __u8 lid,
+			       __u16 lsi, struct nvme_buf *b, __u32 len)
+{
+	log->nsid = NVME_NSID_ALL;
+	log->lid = lid;
+	log->lsi = lsi;
+	log->rae = false;
+	log->len = len;
+	log->buf = nvme_buf_get(b, len);
+}
+
+static void exporter_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct exporter_ctrl *ec = fc->priv;
+	int *err = NULL;
+	int i;
+
+	if (fc == &ec->smart.fc)
+		err = &ec->smart_err;
+	else if (fc == &ec->c0.fc)
+		err = &ec->c0_err;
+	for (i = 0; !err && i < ec->nr_eg; i++) {
+		if (fc == &ec->eg[i].endurance.fc)
+			err = &ec->eg[i].endurance_err;
+		else if (fc == &ec->eg[i].stats.fc)
+			err = &ec->eg[i].stats_err;
+	}
+
+	*err = status;
+	ec->end = monotonic_ns();
+}
+
+/* @err stays -ECANCELED until the command completes, the ring may fail */
+static void exporter_queue_log(struct exporter_ctrl *ec,
+			       struct nvme_fanout_log *log, int *err)
+{
+	*err = log->buf ? nvme_fanout_queue_log(ec->f, log, ec->fd,
+						exporter_done, ec) : -ENOMEM;
+	if (!*err)
+		*err = -ECANCELED;
+}
+
+static void exporter_endgrps_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct exporter_ctrl *ec = fc->priv;
+	struct nvme_id_endurance_group_list *endgrps =
+		(void *)(uintptr_t)fc->cmd.addr;
+	struct exporter_endgrp *eg;
+	int i, nr;
+
+	ec->endgrps_err = status;
+	ec->end = monotonic_ns();
+	if (status)
+		return;
+
+	nr = le16_to_cpu(endgrps->num);
+	if (nr > NVME_ID_ENDURANCE_GROUP_LIST_MAX)
+		nr = NVME_ID_ENDURANCE_GROUP_LIST_MAX;
+	ec->eg = calloc(nr, sizeof(*ec->eg));
+	if (!ec->eg)
+		return;
+	ec->nr_eg = nr;
+
+	for (i = 0; i < nr; i++) {
+		eg = &ec->eg[i];
+		eg->endgid = le16_to_cpu(endgrps->identifier[i]);
+		eg->stats_err = -ENOENT;
+
+		exporter_log_setup(&eg->endurance, NVME_LOG_LID_ENDURANCE_GROUP,
+				   eg->endgid, &eg->endurance_buf,
+				   sizeof(struct nvme_endurance_group_log));
+		exporter_queue_log(ec, &eg->endurance, &eg->endurance_err);
+
+		if (!ec->fdp)
+			continue;
+		exporter_log_setup(&eg->stats, NVME_LOG_LID_FDP_STATS, eg->endgid,
+				   &eg->stats_buf, sizeof(struct nvme_fdp_stats_log));
+		exporter_queue_log(ec, &eg->stats, &eg->stats_err);
+	}
+}
+
+static void exporter_id_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct exporter_ctrl *ec = fc->priv;
+	struct nvme_id_ctrl *ctrl = (void *)(uintptr_t)fc->cmd.addr;
+	void *endgrps;
+	__u32 ctratt;
+
+	ec->id_err = status;
+	ec->end = monotonic_ns();
+	if (status)
+		return;
+
+	ctratt = le32_to_cpu(ctrl->ctratt);
+	if (!(ctratt & NVME_CTRL_CTRATT_ENDURANCE_GROUPS))
+		return;
+	ec->fdp = ec->fdp && (ctratt & NVME_CTRL_CTRATT_FDPS);
+
+	endgrps = nvme_buf_get(&ec->endgrps_buf,
+			       sizeof(struct nvme_id_endurance_group_list));
+	if (!endgrps) {
+		ec->endgrps_err = -ENOMEM;
+		return;
+	}
+	nvme_fanout_identify_cmd(&ec->endgrps.cmd,
+				 NVME_IDENTIFY_CNS_ENDURANCE_GROUP_ID, 0, 0, endgrps);
+	ec->endgrps_err = nvme_fanout_queue(ec->f, &ec->endgrps, ec->fd,
+					    exporter_endgrps_done, ec) ?: -ECANCELED;
+}
+
+static void exporter_queue_ctrl(struct nvme_fanout *f, struct exporter_ctrl *ec,
+				const struct nvme_exporter_cfg *cfg)
+{
+	char path[PATH_MAX];
+	void *ctrl;
+
+	ec->smart_err = ec->id_err = -ENODEV;
+	ec->endgrps_err = ec->c0_err = -ENOENT;
+	ec->f = f;
+	ec->fdp = cfg->fdp;
+	ec->start = ec->end = monotonic_ns();
+
+	snprintf(path, sizeof(path), "/dev/%s", ec->name);
+	ec->fd = open(path, O_RDONLY);
+	if (ec->fd < 0)
+		return;
+
+	exporter_log_setup(&ec->smart, NVME_LOG_LID_SMART, 0, &ec->smart_buf,
+			   sizeof(struct nvme_smart_log));
+	exporter_queue_log(ec, &ec->smart, &ec->smart_err);
+
+	ctrl = nvme_buf_get(&ec->ctrl_buf, sizeof(struct nvme_id_ctrl));
+	if (ctrl) {
+		nvme_fanout_identify_cmd(&ec->id.cmd, NVME_IDENTIFY_CNS_CTRL, 0, 0,
+					 ctrl);
+		ec->id_err = nvme_fanout_queue(f, &ec->id, ec->fd,
+					       exporter_id_done, ec) ?: -ECANCELED;
+	}
+
+	if (!cfg->ocp)
+		return;
+	exporter_log_setup(&ec->c0, C0_SMART_CLOUD_ATTR_OPCODE, 0, &ec->c0_buf,
+			   C0_SMART_CLOUD_ATTR_LEN);
+	exporter_queue_log(ec, &ec->c0, &ec->c0_err);
+}
+
+static void exporter_add_endgrp(struct metrics *ms, struct exporter_ctrl *ec,
+				struct exporter_endgrp *eg)
+{
+	struct json_object *o = NULL;
+	char labels[EXPORTER_LABELS_MAX];
+
+	snprintf(labels, sizeof(labels), "device=\"%s\",endgid=\"%u\"", ec->name,
+		 eg->endgid);
+
+	if (!eg->endurance_err) {
+		json_show_capture(&o);
+		nvme_show_endurance_log(eg->endurance.buf, eg->endgid, ec->name,
+					JSON);
+		metrics_add_capture(ms, "nvme_endurance", labels, &o);
+	}
+
+	if (!eg->stats_err) {
+		json_show_capture(&o);
+		nvme_show_fdp_stats(eg->stats.buf, JSON);
+		metrics_add_capture(ms, "nvme_fdp", labels, &o);
+	}
+
+	nvme_buf_put(&eg->stats_buf);
+	nvme_buf_put(&eg->endurance_buf);
+}
+
+static void exporter_add_ctrl(struct metrics *ms, struct exporter_ctrl *ec)
+{
+	struct json_object *o = NULL;
+	char labels[EXPORTER_LABELS_MAX];
+	int i;
+
+	snprintf(labels, sizeof(labels), "device=\"%s\"", ec->name);
+
+	if (!ec->smart_err) {
+		json_show_capture(&o);
+		nvme_show_smart_log(ec->smart.buf, NVME_NSID_ALL, ec->name, JSON);
+		metrics_add_capture(ms, "nvme_smart", labels, &o);
+	}
+
+	for (i = 0; i < ec->nr_eg; i++)
+		exporter_add_endgrp(ms, ec, &ec->eg[i]);
+
+	if (!ec->c0_err && ocp_smart_c0_guid_valid(ec->c0.buf)) {
+		o = ocp_smart_c0_json_obj(ec->c0.buf);
+		metrics_add_json(ms, "nvme_ocp_smart", labels, o);
+		json_free_object(o);
+	}
+
+	metrics_add(ms, "nvme_up", labels, !ec->smart_err);
+	metrics_add(ms, "nvme_exporter_fetch_seconds", labels,
+		    (ec->end - ec->start) / 1e9);
+
+	nvme_buf_put(&ec->c0_buf);
+	nvme_buf_put(&ec->endgrps_buf);
+	nvme_buf_put(&ec->ctrl_buf);
+	nvme_buf_put(&ec->smart_buf);
+	free(ec->eg);
+	if (ec->fd >= 0)
+		close(ec->fd);
+}
+
+static int metric_cmp(const void *a, const void *b)
+{
+	const struct metric *ma = a, *mb = b;
+	int r = strcmp(ma->name, mb->name);
+
+	if (r)
+		return r;
+	return ma->seq < mb->seq ? -1 : ma->seq > mb->seq;
+}
+
+/* the samples of a metric have to be in one group after its TYPE line */
+static char *metrics_render(struct metrics *ms, size_t *len)
+{
+	char *page = NULL;
+	size_t i;
+	FILE *f;
+
+	f = open_memstream(&page, len);
+	if (!f)
+		return NULL;
+
+	qsort(ms->m, ms->nr, sizeof(*ms->m), metric_cmp);
+	for (i = 0; i < ms->nr; i++) {
+		if (!i || strcmp(ms->m[i - 1].name, ms->m[i].name))
+			fprintf(f, "# TYPE %s gauge\n", ms->m[i].name);
+		if (*ms->m[i].labels)
+			fprintf(f, "%s{%s} %.17g\n", ms->m[i].name,
+				ms->m[i].labels, ms->m[i].value);
+		else
+			fprintf(f, "%s %.17g\n", ms->m[i].name, ms->m[i].value);
+	}
+
+	if (fclose(f)) {
+		free(page);
+		return NULL;
+	}
+
+	return page;
+}
+
+static void exporter_fetch(const struct nvme_exporter_cfg *cfg)
+{
+	struct exporter_ctrl *ctrls = NULL, *ec;
+	struct metrics ms = { 0 };
+	struct nvme_fanout f;
+	nvme_subsystem_t s;
+	nvme_root_t r;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	int i, nr = 0;
+	size_t len;
+	char *page;
+
+	/* scan every time to pick up controllers coming and going */
+	r = nvme_scan(NULL);
+	if (r) {
+		nvme_for_each_host(r, h)
+			nvme_for_each_subsystem(h, s)
+				nvme_subsystem_for_each_ctrl(s, c) {
+					ec = realloc(ctrls, (nr + 1) * sizeof(*ctrls));
+					if (!ec)
+						break;
+					ctrls = ec;
+					memset(&ctrls[nr], 0, sizeof(*ctrls));
+					ctrls[nr++].name = nvme_ctrl_get_name(c);
+				}
+	}
+
+	/* the logs of all controllers are read at once, from one ring */
+	nvme_fanout_init(&f, 64, 0);
+	for (i = 0; i < nr; i++)
+		exporter_queue_ctrl(&f, &ctrls[i], cfg);
+	nvme_fanout_run(&f);
+	nvme_fanout_exit(&f);
+
+	for (i = 0; i < nr; i++)
+		exporter_add_ctrl(&ms, &ctrls[i]);
+	free(ctrls);
+	if (r)
+		nvme_free_tree(r);
+
+	metrics_add(&ms, "nvme_exporter_last_fetch_timestamp_seconds", "",
+		    time(NULL));
+	page = metrics_render(&ms, &len);
+	free(ms.m);
+	if (!page)
+		return;
+
+	pthread_mutex_lock(&exporter.lock);
+	free(exporter.page);
+	exporter.page = page;
+	exporter.len = len;
+	pthread_mutex_unlock(&exporter.lock);
+}
+
+static void *exporter_fetch_thread(void *arg)
+{
+	const struct nvme_exporter_cfg *cfg = arg;
+	struct timespec deadline;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	while (!exporter_stop) {
+		exporter_fetch(cfg);
+
+		deadline.tv_sec += cfg->interval;
+		pthread_mutex_lock(&exporter.lock);
+		while (!exporter_stop &&
+		       pthread_cond_timedwait(&exporter.cond, &exporter.lock,
+					      &deadline) != ETIMEDOUT)
+			;
+		pthread_mutex_unlock(&exporter.lock);
+	}
+
+	return NULL;
+}
+
+static void exporter_client_close(struct exporter_client *c)
+{
+	close(c->fd);
+	c->fd = -1;
+	free(c->out);
+	c->out = NULL;
+}
+
+/* Returns false once the response is sent or the client went away */
+static bool exporter_client_write(struct exporter_client *c)
+{
+	while (c->out_off < c->out_len) {
+		ssize_t w = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+
+		if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		if (w <= 0)
+			return false;
+		c->out_off += w;
+	}
+
+	return false;
+}
+
+/* queue the response, with a copy of the last page as the body for @page */
+static bool exporter_respond(struct exporter_client *c, const char *status,
+			     const char *type, bool page)
+{
+	char hdr[256];
+	size_t len = 0;
+	int n;
+
+	if (page) {
+		pthread_mutex_lock(&exporter.lock);
+		if (exporter.page) {
+			len = exporter.len;
+		} else {
+			status = "503 Service Unavailable";
+			type = "text/plain";
+		}
+	}
+
+	n = snprintf(hdr, sizeof(hdr),
+		     "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+		     "Connection: close\r\n\r\n", status, type, len);
+	c->out = malloc(n + len);
+	if (c->out) {
+		memcpy(c->out, hdr, n);
+		if (len)
+			memcpy(c->out + n, exporter.page, len);
+		c->out_len = n + len;
+		c->out_off = 0;
+	}
+	if (page)
+		pthread_mutex_unlock(&exporter.lock);
+
+	return c->out && exporter_client_write(c);
+}
+
+/* Returns false once the client should be disconnected */
+static bool exporter_client_read(struct exporter_client *c)
+{
+	char method[8], target[64];
+	ssize_t n;
+
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len);
+	if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return true;
+	if (n <= 0)
+		return false;
+	c->len += n;
+	c->buf[c->len] = '\0';
+
+	if (!strstr(c->buf, "\r\n\r\n") && !strstr(c->buf, "\n\n"))
+		return c->len < sizeof(c->buf) - 1;
+
+	if (sscanf(c->buf, "%7s %63s", method, target) != 2 ||
+	    strcmp(method, "GET"))
+		return exporter_respond(c, "405 Method Not Allowed", "text/plain", false);
+
+	if (strcmp(target, "/metrics") && strncmp(target, "/metrics?", 9))
+		return exporter_respond(c, "404 Not Found", "text/plain", false);
+
+	/* a copy of the page, a slow client must not hold up the next fetch */
+	return exporter_respond(c, "200 OK", "text/plain; version=0.0.4; charset=utf-8",
+				true);
+}
+
+static int exporter_listen(const char *address, unsigned int port)
+{
+	struct sockaddr_storage ss = { 0 };
+	struct sockaddr_in6 *in6 = (struct sockaddr_in6 *)&ss;
+	struct sockaddr_in *in = (struct sockaddr_in *)&ss;
+	int fd, one = 1;
+	socklen_t len;
+
+	if (inet_pton(AF_INET, address, &in->sin_addr) == 1) {
+		in->sin_family = AF_INET;
+		in->sin_port = htons(port);
+		len = sizeof(*in);
+	} else if (inet_pton(AF_INET6, address, &in6->sin6_addr) == 1) {
+		in6->sin6_family = AF_INET6;
+		in6->sin6_port = htons(port);
+		len = sizeof(*in6);
+	} else {
+		errno = EINVAL;
+		return -1;
+	}
+
+	fd = socket(ss.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+	    bind(fd, (struct sockaddr *)&ss, len) < 0 ||
+	    listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+int nvme_exporter_run(const struct nvme_exporter_cfg *cfg)
+{
+	struct exporter_client clients[EXPORTER_MAX_CLIENTS];
+	struct pollfd pfd[EXPORTER_MAX_CLIENTS + 1];
+	pthread_condattr_t attr;
+	__u64 now, next;
+	int timeout;
+	sigset_t mask, old;
+	pthread_t fetcher;
+	int lfd, i, n, err = 0;
+
+	if (!cfg->interval)
+		return -EINVAL;
+
+	lfd = exporter_listen(cfg->address, cfg->port);
+	if (lfd < 0)
+		return -errno;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&exporter.cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	/* signals have to interrupt the poll below, not the fetch thread */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &mask, &old);
+
+	exporter_stop = 0;
+	err = pthread_create(&fetcher, NULL, exporter_fetch_thread, (void *)cfg);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err) {
+		pthread_cond_destroy(&exporter.cond);
+		close(lfd);
+		return -err;
+	}
+
+	for (i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+		clients[i].fd = -1;
+		clients[i].out = NULL;
+	}
+
+	while (!exporter_stop) {
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		next = UINT64_MAX;
+		for (i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+			pfd[i + 1].fd = clients[i].fd;
+			pfd[i + 1].events = clients[i].out ? POLLOUT : POLLIN;
+			if (clients[i].fd >= 0)
+				next = min(next, clients[i].deadline);
+		}
+
+		timeout = -1;
+		if (next != UINT64_MAX) {
+			now = monotonic_ns();
+			timeout = next > now ? (next - now + 999999) / 1000000 : 0;
+		}
+
+		n = poll(pfd, EXPORTER_MAX_CLIENTS + 1, timeout);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		now = monotonic_ns();
+		for (i = 0; i < EXPORTER_MAX_CLIENTS; i++) {
+			struct exporter_client *c = &clients[i];
+			bool keep = true;
+
+			if (c->fd < 0)
+				continue;
+			if (pfd[i + 1].revents)
+				keep = c->out ? exporter_client_write(c) :
+					exporter_client_read(c);
+			if (!keep || now >= c->deadline)
+				exporter_client_close(c);
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+			for (i = 0; fd >= 0 && i < EXPORTER_MAX_CLIENTS; i++) {
+				if (clients[i].fd < 0) {
+					clients[i].fd = fd;
+					clients[i].deadline = now +
+						EXPORTER_CLIENT_MS * 1000000ULL;
+					clients[i].len = 0;
+					fd = -1;
+				}
+			}
+			if (fd >= 0)
+				close(fd);
+		}
+	}
+
+	for (i = 0; i < EXPORTER_MAX_CLIENTS; i++)
+		if (clients[i].fd >= 0)
+			exporter_client_close(&clients[i]);
+	close(lfd);
+
+	exporter_stop = 1;
+	pthread_mutex_lock(&exporter.lock);
+	pthread_cond_broadcast(&exporter.cond);
+	pthread_mutex_unlock(&exporter.lock);
+	pthread_join(fetcher, NULL);
+	pthread_cond_destroy(&exporter.cond);
+
+	free(exporter.page);
+	exporter.page = NULL;
+	nvme_buf_pool_drain();
+
+	return err;
+}
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_EXPORTER_H
+#define NVME_EXPORTER_H
+
+#include <stdbool.h>
+
+/*
+ * Prometheus exporter. A fetch thread reads the logs of every controller
+ * in the topology each interval and renders them into the text exposition
+ * format; the HTTP server only ever hands out the last rendered page, so a
+ * scrape never waits for an admin command.
+ */
+
+struct nvme_exporter_cfg {
+	const char *address;		/* IPv4 or IPv6 address to listen on */
+	unsigned int port;
+	unsigned int interval;		/* seconds between fetches */
+	bool ocp;			/* also read the OCP SMART / Health log */
+	bool fdp;			/* also read the FDP statistics log */
+};
+
+/*
+ * nvme_exporter_run - serve /metrics until nvme_exporter_stop()
+ *
+ * Returns 0 or a negative errno.
+ */
+int nvme_exporter_run(const struct nvme_exporter_cfg *cfg);
+void nvme_exporter_stop(void);
+
+#endif /* NVME_EXPORTER_H */
@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <libnvme.h>
+
+#include <ccan/ccan/container_of/container_of.h>
+
+#include "nvme-fanout.h"
+#include "nvme-trace.h"
+#include "common.h"
+#include "util/logging.h"
+
+#define FANOUT_REAP	32
+#define FANOUT_LOG_CHUNK	4096
+
+enum {
+	FANOUT_FD_UNKNOWN,
+	FANOUT_FD_URING,
+	FANOUT_FD_IOCTL,
+};
+
+struct nvme_fanout_fd {
+	int mode;
+	unsigned int inflight;
+};
+
+int nvme_fanout_init(struct nvme_fanout *f, unsigned int entries,
+		     unsigned int per_fd)
+{
+	memset(f, 0, sizeof(*f));
+	f->ring.fd = -1;
+	f->per_fd = per_fd ? per_fd : NVME_FANOUT_PER_FD;
+
+	f->uring = nvme_uring_supported() &&
+		!nvme_uring_init(&f->ring, entries, 0);
+	if (f->uring)
+		f->entries = f->ring.entries;
+
+	return 0;
+}
+
+void nvme_fanout_exit(struct nvme_fanout *f)
+{
+	nvme_uring_exit(&f->ring);
+	free(f->fds);
+	memset(f, 0, sizeof(*f));
+	f->ring.fd = -1;
+}
+
+static void fanout_append(struct nvme_fanout *f, struct nvme_fanout_cmd *fc)
+{
+	fc->next = NULL;
+	if (f->tail)
+		f->tail->next = fc;
+	else
+		f->head = fc;
+	f->tail = fc;
+}
+
+int nvme_fanout_queue(struct nvme_fanout *f, struct nvme_fanout_cmd *fc, int fd,
+		      nvme_fanout_done_fn done, void *priv)
+{
+	struct nvme_fanout_fd *fds;
+
+	if (fd < 0)
+		return -EBADF;
+
+	/* grown here, so that running never fails on memory */
+	if (fd >= f->nr_fds) {
+		fds = realloc(f->fds, (fd + 1) * sizeof(*fds));
+		if (!fds)
+			return -ENOMEM;
+		memset(fds + f->nr_fds, 0, (fd + 1 - f->nr_fds) * sizeof(*fds));
+		f->fds = fds;
+		f->nr_fds = fd + 1;
+	}
+
+	fc->fd = fd;
+	fc->done = done;
+	fc->priv = priv;
+	fanout_append(f, fc);
+
+	return 0;
+}
+
+static int fanout_fd_mode(struct nvme_fanout *f, int fd)
+{
+	struct nvme_fanout_fd *d = &f->fds[fd];
+	struct stat st;
+
+	if (d->mode != FANOUT_FD_UNKNOWN)
+		return d->mode;
+
+	/* uring commands are for the char devices only */
+	if (f->uring && !fstat(fd, &st) && S_ISCHR(st.st_mode))
+		d->mode = FANOUT_FD_URING;
+	else
+		d->mode = FANOUT_FD_IOCTL;
+
+	return d->mode;
+}
+
+static void fanout_ioctl(struct nvme_fanout_cmd *fc)
+{
+	__u64 result = 0;
+	int err;
+
+	/* recorded for --stats and --trace-file by the ioctl wrapper */
+	err = nvme_submit_admin_passthru64(fc->fd, &fc->cmd, &result);
+	if (err < 0)
+		err = -errno;
+	fc->cmd.result = result;
+	fc->done(fc, err);
+}
+
+/* submit what the ring and the per fd limit take, run the ioctl ones */
+static void fanout_submit(struct nvme_fanout *f)
+{
+	struct nvme_fanout_cmd *fc, *next;
+	struct nvme_fanout_fd *d;
+
+	fc = f->head;
+	f->head = f->tail = NULL;
+
+	for (; fc; fc = next) {
+		next = fc->next;
+		d = &f->fds[fc->fd];
+
+		if (fanout_fd_mode(f, fc->fd) == FANOUT_FD_IOCTL) {
+			fanout_ioctl(fc);
+			continue;
+		}
+
+		if (d->inflight >= f->per_fd || f->inflight >= f->entries) {
+			fanout_append(f, fc);
+			continue;
+		}
+
+		fc->start_ns = monotonic_ns();
+		if (nvme_uring_queue_cmd(&f->ring, fc->fd, true, &fc->cmd,
+					 (uintptr_t)fc)) {
+			fanout_append(f, fc);
+			continue;
+		}
+		d->inflight++;
+		f->inflight++;
+	}
+}
+
+static void fanout_complete(struct nvme_fanout *f, struct nvme_uring_cqe *cqe)
+{
+	struct nvme_fanout_cmd *fc = (void *)(uintptr_t)cqe->user_data;
+	__u64 lat = monotonic_ns() - fc->start_ns;
+
+	f->fds[fc->fd].inflight--;
+	f->inflight--;
+
+	/* a kernel without admin uring commands on this device, retry */
+	if (cqe->res == -EOPNOTSUPP) {
+		f->fds[fc->fd].mode = FANOUT_FD_IOCTL;
+		fanout_append(f, fc);
+		return;
+	}
+
+	fc->cmd.result = cqe->result;
+	nvme_trace_cmd(true, &fc->cmd, cqe->res, fc->start_ns, lat);
+	nvme_cmd_stats_add(true, fc->cmd.opcode, cqe->res, lat);
+	fc->done(fc, cqe->res);
+}
+
+int nvme_fanout_run(struct nvme_fanout *f)
+{
+	struct nvme_uring_cqe cqes[FANOUT_REAP];
+	unsigned int i, n;
+	int err;
+
+	while (f->head || f->inflight) {
+		fanout_submit(f);
+		if (!f->inflight)
+			continue;
+
+		err = nvme_uring_submit(&f->ring, 1);
+		if (err < 0)
+			return err;
+
+		n = nvme_uring_reap(&f->ring, cqes, FANOUT_REAP);
+		for (i = 0; i < n; i++)
+			fanout_complete(f, &cqes[i]);
+	}
+
+	return 0;
+}
+
+void nvme_fanout_identify_cmd(struct nvme_passthru_cmd64 *cmd, __u8 cns,
+			      __u32 nsid, __u16 cnssid, void *buf)
+{
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_admin_identify;
+	cmd->nsid = nsid;
+	cmd->addr = (__u64)(uintptr_t)buf;
+	cmd->data_len = NVME_IDENTIFY_DATA_SIZE;
+	cmd->cdw10 = cns;
+	cmd->cdw11 = cnssid;
+	cmd->timeout_ms = NVME_DEFAULT_IOCTL_TIMEOUT;
+}
+
+void nvme_fanout_property_get_cmd(struct nvme_passthru_cmd64 *cmd, int offset)
+{
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_admin_fabrics;
+	cmd->nsid = nvme_fabrics_type_property_get;
+	cmd->cdw10 = !!nvme_is_64bit_reg(offset);
+	cmd->cdw11 = offset;
+	cmd->timeout_ms = NVME_DEFAULT_IOCTL_TIMEOUT;
+}
+
+void nvme_fanout_get_log_cmd(struct nvme_passthru_cmd64 *cmd,
+			     struct nvme_get_log_args *args)
+{
+	__u32 numd = (args->len >> 2) - 1;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_admin_get_log_page;
+	cmd->nsid = args->nsid;
+	cmd->addr = (__u64)(uintptr_t)args->log;
+	cmd->data_len = args->len;
+	cmd->cdw10 = args->lid | (__u32)(args->lsp & 0x7f) << 8 |
+		(__u32)!!args->rae << 15 | (numd & 0xffff) << 16;
+	cmd->cdw11 = numd >> 16 | (__u32)args->lsi << 16;
+	cmd->cdw12 = args->lpo & 0xffffffff;
+	cmd->cdw13 = args->lpo >> 32;
+	cmd->cdw14 = (args->uuidx & 0x7f) | (__u32)!!args->ot << 23 |
+		(__u32)args->csi << 24;
+	cmd->timeout_ms = args->timeout ? args->timeout : NVME_DEFAULT_IOCTL_TIMEOUT;
+}
+
+static void fanout_log_cmd(struct nvme_fanout_log *log)
+{
+	struct nvme_passthru_cmd64 *cmd = &log->fc.cmd;
+	__u32 xfer = log->len - log->off;
+	__u32 numd;
+	bool rae;
+
+	if (xfer > FANOUT_LOG_CHUNK)
+		xfer = FANOUT_LOG_CHUNK;
+	numd = (xfer >> 2) - 1;
+	rae = log->rae || log->off + xfer < log->len;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_admin_get_log_page;
+	cmd->nsid = log->nsid;
+	cmd->addr = (__u64)(uintptr_t)log->buf + log->off;
+	cmd->data_len = xfer;
+	cmd->cdw10 = log->lid | rae << 15 | (numd & 0xffff) << 16;
+	cmd->cdw11 = numd >> 16 | (__u32)log->lsi << 16;
+	cmd->cdw12 = log->off;
+	cmd->timeout_ms = NVME_DEFAULT_IOCTL_TIMEOUT;
+}
+
+static void fanout_log_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct nvme_fanout_log *log = container_of(fc, struct nvme_fanout_log, fc);
+	struct nvme_fanout *f = log->f;
+
+	log->off += fc->cmd.data_len;
+	if (!status && log->off < log->len) {
+		fanout_log_cmd(log);
+		/* the fd has its entry already, this can't fail */
+		nvme_fanout_queue(f, fc, fc->fd, fanout_log_done, fc->priv);
+		return;
+	}
+
+	log->done(fc, status);
+}
+
+int nvme_fanout_queue_log(struct nvme_fanout *f, struct nvme_fanout_log *log,
+			  int fd, nvme_fanout_done_fn done, void *priv)
+{
+	log->f = f;
+	log->off = 0;
+	log->done = done;
+	fanout_log_cmd(log);
+
+	return nvme_fanout_queue(f, &log->fc, fd, fanout_log_done, priv);
+}
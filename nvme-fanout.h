@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_FANOUT_H
+#define NVME_FANOUT_H
+
+#include <stdbool.h>
+
+#include <libnvme.h>
+
+#include "util/uring.h"
+
+/*
+ * Single threaded executor for the admin commands of commands fanning out
+ * over many controllers. The commands of all the controllers go through
+ * one io_uring with IORING_OP_URING_CMD on their char devices and complete
+ * in any order, calling back per command; callbacks queue the commands
+ * depending on a result. Without io_uring passthrough, and for the fds of
+ * block devices or of kernels refusing admin uring commands on them, the
+ * commands are sent with the passthrough ioctl from nvme_fanout_run(), one
+ * at a time.
+ */
+
+struct nvme_fanout_cmd;
+
+/*
+ * @status is the NVMe status, 0, or a negative errno if the command was
+ * not executed; cmd.result holds the completion's dword 0 and 1.
+ */
+typedef void (*nvme_fanout_done_fn)(struct nvme_fanout_cmd *fc, int status);
+
+struct nvme_fanout_cmd {
+	struct nvme_passthru_cmd64 cmd;
+	int fd;
+	nvme_fanout_done_fn done;
+	void *priv;
+
+	/* owned by the executor while queued */
+	struct nvme_fanout_cmd *next;
+	__u64 start_ns;
+};
+
+/* admin commands in flight per controller, out of the ~32 its queue has */
+#define NVME_FANOUT_PER_FD	4
+
+struct nvme_fanout {
+	struct nvme_uring ring;
+	bool uring;
+	unsigned int entries;
+	unsigned int inflight;
+	unsigned int per_fd;
+	struct nvme_fanout_cmd *head;	/* queued, not yet submitted */
+	struct nvme_fanout_cmd *tail;
+	struct nvme_fanout_fd *fds;	/* indexed by fd */
+	int nr_fds;
+};
+
+/*
+ * nvme_fanout_init - set up a ring of @entries for at most @per_fd
+ * commands in flight per fd, 0 for NVME_FANOUT_PER_FD
+ *
+ * Returns 0 or a negative errno. Falls back to the ioctls if a ring can't
+ * be created.
+ */
+int nvme_fanout_init(struct nvme_fanout *f, unsigned int entries,
+		     unsigned int per_fd);
+
+/*
+ * nvme_fanout_queue - queue @fc, set up with its cmd, for @fd
+ *
+ * Nothing is sent before nvme_fanout_run(), which @done can queue more
+ * from. @fc must stay valid until @done is called. Returns 0 or a
+ * negative errno, @done is not called then.
+ */
+int nvme_fanout_queue(struct nvme_fanout *f, struct nvme_fanout_cmd *fc, int fd,
+		      nvme_fanout_done_fn done, void *priv);
+
+/* nvme_fanout_identify_cmd - set up an Identify of @cns into the 4k @buf */
+void nvme_fanout_identify_cmd(struct nvme_passthru_cmd64 *cmd, __u8 cns,
+			      __u32 nsid, __u16 cnssid, void *buf);
+
+/*
+ * nvme_fanout_property_get_cmd - set up a Property Get of the register at
+ * @offset, its value is returned in cmd.result
+ */
+void nvme_fanout_property_get_cmd(struct nvme_passthru_cmd64 *cmd, int offset);
+
+/*
+ * nvme_fanout_get_log_cmd - set up a Get Log Page of @args, as
+ * nvme_get_log() sends it in one command of args->len bytes
+ */
+void nvme_fanout_get_log_cmd(struct nvme_passthru_cmd64 *cmd,
+			     struct nvme_get_log_args *args);
+
+/*
+ * A log page read in 4k Get Log Page commands one after the other, as
+ * libnvme does to stay within the MDTS, with RAE set on all but the last
+ * one. Set the fields up to @len before queueing.
+ */
+struct nvme_fanout_log {
+	__u32 nsid;
+	__u8 lid;
+	__u16 lsi;
+	bool rae;
+	void *buf;
+	__u32 len;
+
+	struct nvme_fanout_cmd fc;
+	struct nvme_fanout *f;
+	__u32 off;
+	nvme_fanout_done_fn done;
+};
+
+/*
+ * nvme_fanout_queue_log - queue the first command of @log
+ *
+ * @done is called once for the whole log, with &log->fc whose priv is
+ * @priv, and the status of the failing command if one did.
+ */
+int nvme_fanout_queue_log(struct nvme_fanout *f, struct nvme_fanout_log *log,
+			  int fd, nvme_fanout_done_fn done, void *priv);
+
+/*
+ * nvme_fanout_run - send the queued commands and wait for them, and for
+ * the ones their callbacks queue
+ *
+ * Returns 0, or the negative errno of a failing ring submission; the
+ * commands queued or in flight are not called back then.
+ */
+int nvme_fanout_run(struct nvme_fanout *f);
+
+void nvme_fanout_exit(struct nvme_fanout *f);
+
+#endif /* NVME_FANOUT_H */
@@ -0,0 +1,625 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Multi-queue, high queue depth I/O engine for nvme-cli.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <libnvme.h>
+
+#include "nvme-io-engine.h"
+#include "nvme-trace.h"
+#include "common.h"
+#include "util/logging.h"
+#include "util/mem.h"
+#include "util/mock.h"
+#include "util/queue-map.h"
+#include "util/ratelimit.h"
+#include "util/uring.h"
+
+struct io_slot {
+	void *buf;
+	void *mbuf;
+	__u64 seq;
+	__u64 start_ns;
+	bool fixed;			/* issued with the registered buffer */
+	struct nvme_passthru_cmd64 cmd;	/* as issued */
+};
+
+struct io_engine;
+
+struct io_worker {
+	struct io_engine *eng;
+	unsigned int id;
+	int cpu;		/* the thread is pinned to, -1 for none */
+	pthread_t thread;
+	struct nvme_uring ring;
+	unsigned int qd;
+	struct nvme_mem_huge data;	/* data buffers of all slots */
+	bool fixed;		/* data registered as fixed buffer 0 */
+	bool supported;		/* a command completed, see io_unsupported() */
+	struct io_slot *slots;
+	unsigned int *free_slots;
+	unsigned int nr_free;
+	bool deferred;		/* deferred_seq was claimed but not issued */
+	__u64 deferred_seq;
+	__u64 rand_state;
+	struct nvme_io_stats stats;
+	int err;
+};
+
+struct io_engine {
+	struct nvme_io_job *job;
+	bool uring;
+	__u64 next_seq;
+	__u64 start_ns;
+	__u64 deadline_ns;
+	struct nvme_ratelimit rl;
+	struct io_worker *workers;
+};
+
+static volatile sig_atomic_t engine_stop;
+
+void nvme_io_engine_stop(void)
+{
+	engine_stop = 1;
+}
+
+static __u64 xorshift64(__u64 *state)
+{
+	__u64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+
+	return x;
+}
+
+static inline __u64 shl64(__u64 v, int n)
+{
+	if (n <= -64 || n >= 64)
+		return 0;
+	return n >= 0 ? v << n : v >> -n;
+}
+
+/*
+ * Place the reference and storage tags for the 16b, 32b and 64b guard
+ * protection information formats, see NVM Command Set 5.2.1.
+ */
+static void io_set_tags(struct nvme_io_job *job, __u64 reftag,
+			struct nvme_passthru_cmd64 *cmd)
+{
+	__u64 st = job->storage_tag;
+	int sts = job->sts;
+
+	cmd->cdw14 = reftag & 0xffffffff;
+
+	switch (job->pif) {
+	case NVME_NVM_PIF_16B_GUARD:
+		cmd->cdw14 |= shl64(st, 32 - sts) & 0xffffffff;
+		break;
+	case NVME_NVM_PIF_32B_GUARD:
+		cmd->cdw14 |= shl64(st, 80 - sts) & 0xffff0000;
+		cmd->cdw3 = (reftag >> 32) | (shl64(st, 48 - sts) & 0xffffffff);
+		cmd->cdw2 = shl64(st, 16 - sts) & 0xffff;
+		break;
+	case NVME_NVM_PIF_64B_GUARD:
+		cmd->cdw14 |= shl64(st, 48 - sts) & 0xffffffff;
+		cmd->cdw3 = ((reftag >> 32) & 0xffff) |
+			(shl64(st, 16 - sts) & 0xffff);
+		break;
+	}
+}
+
+void nvme_io_job_init_cmd(struct nvme_io_job *job, __u64 slba,
+			  struct nvme_passthru_cmd64 *cmd)
+{
+	__u64 reftag = job->reftag;
+
+	if (job->control & NVME_IO_PRINFO_PRCHK_REF)
+		reftag += slba - job->slba;
+
+	cmd->opcode = job->opcode;
+	cmd->nsid = job->nsid;
+	cmd->cdw10 = slba & 0xffffffff;
+	cmd->cdw11 = slba >> 32;
+	cmd->cdw12 = job->nlb | (job->control << 16);
+	cmd->cdw13 = job->dsmgmt;
+	cmd->cdw15 = job->apptag | (job->appmask << 16);
+	io_set_tags(job, reftag, cmd);
+}
+
+/* the bytes a command is charged against rate_bps */
+static __u64 io_cost(struct nvme_io_job *job)
+{
+	return job->io_cost ? job->io_cost : nvme_io_job_data_len(job);
+}
+
+static bool io_claim(struct io_engine *eng, __u64 *seq)
+{
+	struct nvme_io_job *job = eng->job;
+
+	if (engine_stop)
+		return false;
+	if (eng->deadline_ns && monotonic_ns() >= eng->deadline_ns)
+		return false;
+
+	*seq = __atomic_fetch_add(&eng->next_seq, 1, __ATOMIC_RELAXED);
+	if (job->nr_ios && *seq >= job->nr_ios)
+		return false;
+
+	/* the wait is cut short by the SIGINT handler */
+	if (nvme_ratelimit_enabled(&eng->rl) &&
+	    !nvme_ratelimit_wait(&eng->rl, io_cost(job), &engine_stop))
+		return false;
+
+	return true;
+}
+
+static int io_prep(struct io_worker *w, struct io_slot *slot, __u64 seq,
+		   struct nvme_passthru_cmd64 *cmd)
+{
+	struct nvme_io_job *job = w->eng->job;
+	__u64 blocks = job->nlb + 1;
+	__u64 nr = job->nr_lbas / blocks;
+	__u64 idx;
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->addr = (__u64)(uintptr_t)slot->buf;
+	cmd->data_len = nvme_io_job_data_len(job);
+	if (slot->mbuf) {
+		cmd->metadata = (__u64)(uintptr_t)slot->mbuf;
+		cmd->metadata_len = nvme_io_job_meta_len(job);
+	}
+
+	if (!nr)
+		nr = 1;
+	idx = job->random ? xorshift64(&w->rand_state) % nr : seq % nr;
+	nvme_io_job_init_cmd(job, job->slba + idx * blocks, cmd);
+
+	if (job->ops && job->ops->prep)
+		return job->ops->prep(job, w->id, seq, cmd);
+
+	return 0;
+}
+
+static void io_complete(struct io_worker *w, struct io_slot *slot,
+			int status, __u64 result)
+{
+	struct nvme_io_job *job = w->eng->job;
+	struct nvme_io_stats *s = &w->stats;
+	__u64 lat = monotonic_ns() - slot->start_ns;
+
+	s->ios++;
+	if (status) {
+		if (!s->errors)
+			s->first_err = status;
+		s->errors++;
+	} else {
+		s->bytes += nvme_io_job_data_len(job);
+	}
+	if (job->progress) {
+		__atomic_fetch_add(&job->progress->ios, 1, __ATOMIC_RELAXED);
+		if (status)
+			__atomic_fetch_add(&job->progress->errors, 1, __ATOMIC_RELAXED);
+		else
+			__atomic_fetch_add(&job->progress->bytes, nvme_io_job_data_len(job),
+					   __ATOMIC_RELAXED);
+	}
+
+	nvme_hist_add(&s->lat, lat);
+	if (job->target_lat_ns)
+		nvme_ratelimit_complete(&w->eng->rl, lat, slot->start_ns + lat);
+
+	/* the synchronous passthru commands are traced and counted by nvme_submit_passthru64() */
+	if (w->eng->uring) {
+		nvme_trace_cmd(job->admin, &slot->cmd, status, slot->start_ns, lat);
+		nvme_cmd_stats_add(job->admin, slot->cmd.opcode, status, lat);
+	}
+
+	if (job->ops && job->ops->complete)
+		job->ops->complete(job, w->id, slot->seq, slot->buf, status,
+				   result, lat);
+}
+
+static bool io_fixed_buf(struct io_worker *w, struct nvme_passthru_cmd64 *cmd)
+{
+	__u64 start = (__u64)(uintptr_t)w->data.p;
+
+	return cmd->addr >= start &&
+		cmd->addr + cmd->data_len <= start + w->data.len;
+}
+
+static int io_queue(struct io_worker *w, struct nvme_passthru_cmd64 *cmd,
+		    unsigned int idx)
+{
+	struct nvme_io_job *job = w->eng->job;
+
+	/* prep() may point a command at a buffer of its own */
+	w->slots[idx].fixed = w->fixed && io_fixed_buf(w, cmd);
+	if (w->slots[idx].fixed)
+		return nvme_uring_queue_cmd_fixed(&w->ring, job->fd, job->admin,
+						  cmd, 0, idx);
+
+	return nvme_uring_queue_cmd(&w->ring, job->fd, job->admin, cmd, idx);
+}
+
+/*
+ * Kernels before 6.1 reject fixed buffer and polled passthrough with
+ * -EINVAL or -EOPNOTSUPP as the command is submitted. Until a command of
+ * the worker completed otherwise, a command using the registered buffer
+ * failing so is sent again without it, and a polled one stops the
+ * worker with -ENOTSUP. Returns true if the command was sent again.
+ */
+static bool io_unsupported(struct io_worker *w, unsigned int idx, int res)
+{
+	struct io_slot *slot = &w->slots[idx];
+
+	if (w->supported)
+		return false;
+	if (res != -EINVAL && res != -EOPNOTSUPP) {
+		w->supported = true;
+		return false;
+	}
+
+	if (slot->fixed) {
+		w->fixed = false;
+		slot->start_ns = monotonic_ns();
+		return !io_queue(w, &slot->cmd, idx);
+	}
+	if (w->eng->job->poll)
+		w->err = -ENOTSUP;
+
+	return false;
+}
+
+static void io_worker_uring(struct io_worker *w)
+{
+	struct nvme_io_job *job = w->eng->job;
+	struct nvme_uring_cqe cqes[64];
+	struct nvme_passthru_cmd64 cmd;
+	unsigned int inflight = 0, n, i;
+	bool issuing = true;
+	__u64 seq;
+	int ret;
+
+	while (true) {
+		while (issuing && !w->err && w->nr_free) {
+			unsigned int idx = w->free_slots[w->nr_free - 1];
+			struct io_slot *slot = &w->slots[idx];
+
+			if (w->deferred) {
+				seq = w->deferred_seq;
+				w->deferred = false;
+			} else if (!io_claim(w->eng, &seq)) {
+				issuing = false;
+				break;
+			}
+
+			ret = io_prep(w, slot, seq, &cmd);
+			if (ret == NVME_IO_PREP_DEFER && inflight) {
+				w->deferred = true;
+				w->deferred_seq = seq;
+				break;
+			}
+			if (ret) {
+				if (ret < 0)
+					w->err = ret;
+				issuing = false;
+				break;
+			}
+
+			slot->seq = seq;
+			slot->start_ns = monotonic_ns();
+			slot->cmd = cmd;
+			if (io_queue(w, &cmd, idx))
+				break;
+			w->nr_free--;
+			inflight++;
+		}
+
+		if (!inflight)
+			break;
+
+		ret = nvme_uring_submit(&w->ring, 1);
+		if (ret < 0) {
+			w->err = ret;
+			break;
+		}
+
+		do {
+			n = nvme_uring_reap(&w->ring, cqes, ARRAY_SIZE(cqes));
+			for (i = 0; i < n; i++) {
+				unsigned int idx = cqes[i].user_data;
+
+				if (io_unsupported(w, idx, cqes[i].res))
+					continue;
+				io_complete(w, &w->slots[idx], cqes[i].res,
+					    cqes[i].result);
+				w->free_slots[w->nr_free++] = idx;
+				inflight--;
+			}
+		} while (n == ARRAY_SIZE(cqes));
+	}
+}
+
+static void io_worker_sync(struct io_worker *w)
+{
+	struct nvme_io_job *job = w->eng->job;
+	struct io_slot *slot = &w->slots[0];
+	struct nvme_passthru_cmd64 cmd;
+	__u64 seq, result;
+	int ret;
+
+	while (io_claim(w->eng, &seq)) {
+		ret = io_prep(w, slot, seq, &cmd);
+		if (ret) {
+			if (ret < 0)
+				w->err = ret;
+			break;
+		}
+
+		slot->seq = seq;
+		slot->start_ns = monotonic_ns();
+		result = 0;
+		if (job->admin)
+			ret = nvme_submit_admin_passthru64(job->fd, &cmd, &result);
+		else
+			ret = nvme_submit_io_passthru64(job->fd, &cmd, &result);
+		if (ret < 0)
+			ret = -errno;
+		io_complete(w, slot, ret, result);
+	}
+}
+
+static void *io_worker_fn(void *arg)
+{
+	struct io_worker *w = arg;
+
+	if (w->eng->uring)
+		io_worker_uring(w);
+	else
+		io_worker_sync(w);
+
+	return NULL;
+}
+
+static void io_fill_pattern(struct nvme_io_job *job, void *buf, __u32 len)
+{
+	__u32 off, n;
+
+	if (!job->pattern || !job->pattern_len)
+		return;
+
+	for (off = 0; off < len; off += n) {
+		n = min(job->pattern_len, len - off);
+		memcpy((char *)buf + off, job->pattern, n);
+	}
+}
+
+static void io_worker_free(struct io_worker *w)
+{
+	unsigned int i;
+
+	if (w->slots) {
+		for (i = 0; i < w->qd; i++)
+			free(w->slots[i].mbuf);
+	}
+	free(w->slots);
+	free(w->free_slots);
+	if (w->eng->uring)
+		nvme_uring_exit(&w->ring);
+	nvme_free_huge(&w->data);
+}
+
+static int io_worker_init(struct io_engine *eng, struct io_worker *w,
+			  unsigned int id)
+{
+	struct nvme_io_job *job = eng->job;
+	size_t page = getpagesize();
+	size_t stride = (nvme_io_job_data_len(job) + page - 1) / page * page;
+	unsigned int i;
+	int err;
+
+	w->eng = eng;
+	w->id = id;
+	w->cpu = -1;
+	w->ring.fd = -1;
+	w->qd = eng->uring ? job->queue_depth : 1;
+	w->rand_state = (monotonic_ns() ^ ((__u64)id << 32)) | 1;
+
+	w->slots = calloc(w->qd, sizeof(*w->slots));
+	w->free_slots = calloc(w->qd, sizeof(*w->free_slots));
+	if (!w->slots || !w->free_slots)
+		return -ENOMEM;
+
+	if (job->cmb) {
+		if (!nvme_alloc_cmb(job->cmb, stride * w->qd, &w->data))
+			return -errno;
+	} else if (!nvme_alloc_huge(stride * w->qd, &w->data)) {
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < w->qd; i++) {
+		w->slots[i].buf = (char *)w->data.p + i * stride;
+		io_fill_pattern(job, w->slots[i].buf, nvme_io_job_data_len(job));
+		if (job->ms) {
+			w->slots[i].mbuf = nvme_alloc(nvme_io_job_meta_len(job));
+			if (!w->slots[i].mbuf)
+				return -ENOMEM;
+		}
+		w->free_slots[i] = i;
+	}
+	w->nr_free = w->qd;
+
+	if (eng->uring) {
+		struct iovec iov = {
+			.iov_base = w->data.p,
+			.iov_len = w->data.len,
+		};
+
+		err = nvme_uring_init(&w->ring, w->qd,
+				      job->poll ? NVME_URING_SETUP_IOPOLL : 0);
+		if (err)
+			return err;
+
+		/*
+		 * Registered pages aren't pinned and unpinned again for every
+		 * command, RLIMIT_MEMLOCK may still refuse them. Peer-to-peer
+		 * memory can't be registered at all. Whether the kernel takes
+		 * them for passthrough shows with the first commands.
+		 */
+		w->fixed = !w->data.cmb &&
+			!nvme_uring_register_buffers(&w->ring, &iov, 1);
+	}
+
+	return 0;
+}
+
+static void io_stats_merge(struct nvme_io_stats *dst, struct nvme_io_stats *src)
+{
+	if (!dst->errors && src->errors)
+		dst->first_err = src->first_err;
+	dst->ios += src->ios;
+	dst->bytes += src->bytes;
+	dst->errors += src->errors;
+	nvme_hist_merge(&dst->lat, &src->lat);
+}
+
+/*
+ * Pin the threads of a namespace job to CPUs of distinct blk-mq hardware
+ * queues, within the CPUs the process may run on, so they don't share a
+ * submission queue. Returns the number of queues used, 0 if the threads
+ * are left to the scheduler.
+ */
+static unsigned int io_place_workers(struct io_engine *eng)
+{
+	struct nvme_io_job *job = eng->job;
+	struct nvme_queue_map m;
+	cpu_set_t allowed;
+	unsigned int i;
+	int *cpus, n = -1;
+
+	if (job->threads < 2 || job->admin || nvme_queue_map_read_fd(job->fd, &m))
+		return 0;
+
+	cpus = calloc(job->threads, sizeof(*cpus));
+	if (cpus && !sched_getaffinity(0, sizeof(allowed), &allowed))
+		n = nvme_queue_map_place(&m, &allowed, job->threads, cpus);
+	for (i = 0; n > 0 && i < job->threads; i++)
+		eng->workers[i].cpu = cpus[i];
+
+	free(cpus);
+	nvme_queue_map_free(&m);
+
+	return n > 0 ? n : 0;
+}
+
+static int io_worker_start(struct io_worker *w)
+{
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int err;
+
+	if (w->cpu < 0)
+		return pthread_create(&w->thread, NULL, io_worker_fn, w);
+
+	CPU_ZERO(&cpus);
+	CPU_SET(w->cpu, &cpus);
+	pthread_attr_init(&attr);
+	err = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	if (!err)
+		err = pthread_create(&w->thread, &attr, io_worker_fn, w);
+	pthread_attr_destroy(&attr);
+
+	return err;
+}
+
+int nvme_io_engine_run(struct nvme_io_job *job, struct nvme_io_stats *stats)
+{
+	struct io_engine eng = { .job = job };
+	unsigned int i, started = 0;
+	__u64 start;
+	int err = 0;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!job->queue_depth)
+		job->queue_depth = 1;
+	if (!job->threads)
+		job->threads = 1;
+	if (!job->nr_ios && !job->runtime)
+		job->nr_ios = 1;
+
+	/* a mock device answers the passthru ioctls only */
+	eng.uring = nvme_uring_supported() && !nvme_mock_find(job->fd);
+	if (job->poll && !eng.uring)
+		return -ENOTSUP;
+
+	eng.workers = calloc(job->threads, sizeof(*eng.workers));
+	if (!eng.workers)
+		return -ENOMEM;
+
+	for (i = 0; i < job->threads; i++) {
+		err = io_worker_init(&eng, &eng.workers[i], i);
+		if (err)
+			goto out;
+	}
+
+	stats->hw_queues = io_place_workers(&eng);
+
+	engine_stop = 0;
+	start = monotonic_ns();
+	eng.start_ns = start;
+	if (job->runtime)
+		eng.deadline_ns = start + job->runtime * NSEC_PER_SEC;
+	nvme_ratelimit_init(&eng.rl, job->rate_iops, job->rate_bps,
+			    job->target_lat_ns, start);
+
+	for (i = 0; i < job->threads; i++) {
+		err = io_worker_start(&eng.workers[i]);
+		if (err) {
+			err = -err;
+			nvme_io_engine_stop();
+			break;
+		}
+		started++;
+	}
+
+	stats->fixed_bufs = eng.uring;
+	for (i = 0; i < started; i++) {
+		pthread_join(eng.workers[i].thread, NULL);
+		io_stats_merge(stats, &eng.workers[i].stats);
+		stats->fixed_bufs &= eng.workers[i].fixed;
+		if (!err && eng.workers[i].err)
+			err = eng.workers[i].err;
+	}
+
+	stats->elapsed_ns = monotonic_ns() - start;
+	stats->queue_depth = eng.uring ? job->queue_depth : 1;
+	stats->threads = job->threads;
+	stats->uring = eng.uring;
+	stats->poll = job->poll;
+	stats->cmb = !!job->cmb;
+	stats->rate_limited = nvme_ratelimit_enabled(&eng.rl);
+	stats->rate_backoffs = eng.rl.backoffs;
+	stats->rate_scale = nvme_ratelimit_scale(&eng.rl);
+	nvme_ratelimit_destroy(&eng.rl);
+
+out:
+	for (i = 0; i < job->threads; i++) {
+		if (eng.workers[i].eng)
+			io_worker_free(&eng.workers[i]);
+	}
+	free(eng.workers);
+
+	return err;
+}
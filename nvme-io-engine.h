@@ -0,0 +1,154 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_IO_ENGINE_H
+#define NVME_IO_ENGINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <libnvme.h>
+
+#include "util/histogram.h"
+
+/*
+ * Multi-queue I/O engine. Every worker thread owns an io_uring passthrough
+ * ring on the NVMe generic char device, or the controller char device for
+ * admin jobs, and keeps queue_depth commands in flight. Kernels without
+ * IORING_OP_URING_CMD support fall back to synchronous passthrough ioctls,
+ * one outstanding command per thread.
+ * The data buffers of a thread are registered with its ring where the
+ * kernel supports fixed buffer passthrough (6.1). With poll set the rings
+ * are created with IORING_SETUP_IOPOLL and the threads busy poll for
+ * completions on the driver's poll queues instead of sleeping on an
+ * interrupt; that needs the io_uring path and fails with -ENOTSUP
+ * otherwise.
+ * The threads of a namespace job are pinned to CPUs of distinct blk-mq
+ * hardware queues of the namespace where its queue map can be read, see
+ * util/queue-map.h.
+ */
+
+struct nvme_io_job;
+
+/* completions of a running job as they happen, for another thread to sample */
+struct nvme_io_progress {
+	__u64 ios;
+	__u64 bytes;
+	__u64 errors;
+};
+
+/* prep() has nothing to issue until another command of the thread completed */
+#define NVME_IO_PREP_DEFER	2
+
+struct nvme_io_job_ops {
+	/*
+	 * prep - fill in @cmd for command number @seq. The data buffer
+	 * belonging to the submission slot is already set in cmd->addr.
+	 * Return 0 to submit, 1 to stop issuing new commands,
+	 * NVME_IO_PREP_DEFER to be called again with the same @seq after
+	 * the next completion, or a negative errno to abort the job.
+	 * Deferring with no command in flight stops the thread.
+	 */
+	int (*prep)(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+		    struct nvme_passthru_cmd64 *cmd);
+	/*
+	 * complete - called for every completed command. @buf is the data
+	 * buffer prep() filled in. @status is the NVMe status, or a negative
+	 * errno if the command was not executed.
+	 */
+	void (*complete)(struct nvme_io_job *job, unsigned int thread,
+			 __u64 seq, void *buf, int status, __u64 result,
+			 __u64 lat_ns);
+};
+
+struct nvme_io_job {
+	int fd;			/* generic char device for io_uring */
+	bool admin;		/* admin commands, fd is the controller char device */
+	__u32 nsid;
+	__u8 opcode;
+
+	__u64 slba;		/* first LBA of the exercised region */
+	__u64 nr_lbas;		/* size of the region in LBAs */
+	__u16 nlb;		/* zeroes based LBAs per command */
+	__u32 lba_size;		/* bytes per LBA including extended metadata */
+	__u32 ms;		/* separate metadata bytes per LBA */
+
+	__u16 control;
+	__u32 dsmgmt;
+	__u64 reftag;
+	__u16 apptag;
+	__u16 appmask;
+	__u64 storage_tag;
+	__u8 sts;
+	__u8 pif;
+
+	unsigned int queue_depth;
+	unsigned int threads;
+	__u64 nr_ios;		/* total commands, 0 runs until runtime expires */
+	unsigned int runtime;	/* seconds, 0 runs until nr_ios are done */
+	/* maintenance I/O limits of all threads together, see util/ratelimit.h */
+	__u64 rate_iops;	/* commands per second, 0 is unlimited */
+	__u64 rate_bps;		/* bytes per second, 0 is unlimited */
+	__u64 io_cost;		/* bytes a command counts for, 0 is its data length */
+	__u64 target_lat_ns;	/* adapt the limits to this command latency */
+	bool random;
+	bool poll;		/* poll for completions instead of interrupts */
+	const char *cmb;	/* p2pmem directory to take the data buffers from */
+
+	void *pattern;		/* data copied into write/compare buffers */
+	__u32 pattern_len;
+
+	const struct nvme_io_job_ops *ops;
+	void *priv;
+	struct nvme_io_progress *progress;	/* if set, updated atomically */
+};
+
+struct nvme_io_stats {
+	__u64 ios;
+	__u64 bytes;
+	__u64 errors;
+	int first_err;		/* first failing status or negative errno */
+	__u64 elapsed_ns;
+	struct nvme_hist lat;	/* per command latency in ns */
+	unsigned int queue_depth;
+	unsigned int threads;
+	unsigned int hw_queues;	/* distinct hardware queues the threads were pinned to */
+	bool uring;		/* io_uring passthrough was used */
+	bool fixed_bufs;	/* with registered data buffers on all threads */
+	bool poll;		/* completions were polled */
+	bool cmb;		/* the data buffers were in the CMB */
+	bool rate_limited;
+	__u64 rate_backoffs;	/* times the latency target halved the limits */
+	double rate_scale;	/* of the limits allowed at the end */
+};
+
+static inline __u32 nvme_io_job_data_len(struct nvme_io_job *job)
+{
+	return (job->nlb + 1) * job->lba_size;
+}
+
+static inline __u32 nvme_io_job_meta_len(struct nvme_io_job *job)
+{
+	return (job->nlb + 1) * job->ms;
+}
+
+/*
+ * nvme_io_job_init_cmd - fill in a read/write/compare style command for
+ * @slba using the opcode, control and protection fields of @job.
+ */
+void nvme_io_job_init_cmd(struct nvme_io_job *job, __u64 slba,
+			  struct nvme_passthru_cmd64 *cmd);
+
+/*
+ * nvme_io_engine_run - run @job to completion
+ *
+ * Returns 0 if the job ran (individual command failures are accounted in
+ * @stats), or a negative errno if the engine could not be set up.
+ */
+int nvme_io_engine_run(struct nvme_io_job *job, struct nvme_io_stats *stats);
+
+/*
+ * nvme_io_engine_stop - ask all running jobs to stop issuing commands.
+ * Async signal safe.
+ */
+void nvme_io_engine_stop(void);
+
+#endif /* NVME_IO_ENGINE_H */
@@ -1,4 +1,5 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -22,220 +23,32 @@ static char fmt3[78];
 static char fmt4[78];
 static char fmt5[78];
 
-static char *device_top;
-static char *device_mid;
-static char *device_final;
-static char *class_top;
-static char *class_mid;
-static char *class_final;
-
-
-
-static void free_all(void)
-{
-	free(device_top);
-	device_top = NULL;
-	free(device_mid);
-	device_mid = NULL;
-	free(device_final);
-	device_final = NULL;
-	free(class_top);
-	class_top = NULL;
-	free(class_mid);
-	class_mid = NULL;
-	free(class_final);
-	class_final = NULL;
-}
-
-static char *find_data(char *data)
-{
-	while (*data != '\0') {
-		if (*data >= '0' && *data <= '9')
-			return data;
-		data++;
-	}
-	return NULL;
-}
-
-static char *locate_info(char *data, bool is_inner, bool is_class)
-{
-	char *orig = data;
-	char *locate;
-	if (!data)
-		return orig;
-
-	locate = find_data(data);
-	if (!locate)
-		return orig;
-	if (is_class)
-		return locate + 4;
-	if (!is_inner)
-		/* 4 to get over the number, 2 for spaces */
-		return locate + 4 + 2;
-
-	/* Inner data, has "sub_ven(space)sub_dev(space)(space)string */
-	return locate + 4 + 1 + 4 + 2;
-}
-
-static void format_and_print(char *save)
-{
-
-	if (!class_mid) {
-		if (device_final)
-			snprintf(save, 1024, "%s %s %s",
-				 locate_info(device_top, false, false),
-				 locate_info(device_mid, false, false),
-				 locate_info(device_final, true, false));
-		else
-			snprintf(save, 1024, "%s %s",
-				 locate_info(device_top, false, false),
-				 locate_info(device_mid, false, false));
-	} else {
-		if (device_final)
-			snprintf(save, 1024, "%s: %s %s %s",
-				 locate_info(class_mid, false, true),
-				 locate_info(device_top, false, false),
-				 locate_info(device_mid, false, false),
-				 locate_info(device_final, true, false));
-		else
-			snprintf(save, 1024, "%s: %s %s",
-				 locate_info(class_mid, false, true),
-				 locate_info(device_top, false, false),
-				 locate_info(device_mid, false, false));
-	}
-}
-
-static void format_all(char *save, char *vendor, char *device)
-{
-	if (device_top && device_mid)
-		format_and_print(save);
-
-	else if (device_top && !device_mid && class_mid)
-		snprintf(save, 1024, "%s: %s Device %s",
-			 locate_info(class_mid, false, true),
-			 locate_info(device_top, false, false),
-			 device);
-
-	else if (!device_top && class_mid)
-		snprintf(save, 1024, "%s: Vendor %s Device %s",
-			 locate_info(class_mid, false, true),
-			 vendor,
-			 device);
-	else
-		snprintf(save, 1024, "Unknown device");
-}
-
-static int is_final_match(char *line, char *search)
-{
-	return !memcmp(&line[2], search, 2);
-}
-
-static int is_inner_sub_vendev(char *line, char *search, char *search2)
-{
-	char combine[10];
-	snprintf(combine, sizeof(combine), "%s %s", &search[2], &search2[2]);
-       	if (line[0] != '\t' && line[1] != '\t')
-		return 0;
-
-	return !memcmp(combine, &line[2], 9);
-}
-
-static int is_mid_level_match(char *line, char *device, bool class)
-{
-	if (!class)
-		return !memcmp(&line[1], &device[2], 4);
-
-	return !memcmp(&line[1], device, 2);
-}
-
-static inline bool is_comment(char *line)
-{
-	return line[0] == '#';
-}
-
-static int is_top_level_match(char *line, const char* device, bool class)
-{
-	if (line[0] == '\t')
-		return false;
-	if (line[0] == '#')
-		return false;
-	if (!class)
-		return !memcmp(line, &device[2], 4);
-	if (line[0] != 'C')
-		return false;
-	/* Skipping    C(SPACE)  0x */
-	return !memcmp(&line[2], &device[2], 2);
-}
-
-static inline int is_tab(char *line)
-{
-	return line[0] == '\t';
-}
-
-static inline int is_class_info(char *line)
-{
-	return !memcmp(line, "# C class", 9);
-}
-
-static void parse_vendor_device(char **line, FILE *file,
-			       char *device, char *subdev,
-			       char *subven)
-{
-	bool device_single_found = false;
-	size_t amnt = 1024;
-	size_t found = 0;
-	char *newline;
-
-	while ((found = getline(line, &amnt, file)) != -1) {
-		newline = *line;
-		if (is_comment(newline))
-			continue;
-		if (!is_tab(newline))
-			return;
-
-		newline[found - 1] = '\0';
-		if (!device_single_found && is_mid_level_match(newline, device, false)) {
-			device_single_found = true;
-			device_mid = strdup(newline);
-			continue;
-		}
-
-		if (device_single_found && is_inner_sub_vendev(newline, subven, subdev)) {
-			device_final = strdup(newline);
-			break;
-		}
-	}
-}
-
-static void pull_class_info(char **_newline, FILE *file, char *class)
-{
-	size_t amnt;
-	size_t size = 1024;
-	bool top_found = false;
-	bool mid_found = false;
-	char *newline;
-
-	while ((amnt = getline(_newline, &size, file)) != -1) {
-		newline = *_newline;
-		newline[amnt - 1] = '\0';
-		if (!top_found && is_top_level_match(newline, class, true)) {
-			class_top = strdup(newline);
-			top_found = true;
-			continue;
-		}
-		if (!mid_found && top_found &&
-		    is_mid_level_match(newline,  &class[4], true)) {
-			class_mid = strdup(newline);
-			mid_found = true;
-			continue;
-		}
-		if (top_found && mid_found &&
-		    is_final_match(newline, &class[6])) {
-			class_final = strdup(newline);
-			break;
-		}
-	}
-}
+/*
+ * pci.ids is parsed once into a sorted index of its vendors, devices,
+ * subsystems and subclasses, and every controller is then looked up by
+ * binary search instead of scanning the text again. The names point into
+ * the file contents, which are kept for that.
+ */
+enum pci_id_level {
+	PCI_ID_VENDOR,
+	PCI_ID_DEVICE,
+	PCI_ID_SUBSYS,
+	PCI_ID_SUBCLASS,
+};
+
+struct pci_id {
+	uint64_t key;		/* vendor:device:subvendor:subdevice, or class:subclass */
+	enum pci_id_level level;
+	const char *name;
+};
+
+static struct {
+	bool loaded;
+	char *data;
+	struct pci_id *ids;
+	size_t nr;
+	size_t size;
+} pci_ids;
 
 static int read_sys_node(char *where, char *save, size_t savesz)
 {
@@ -295,21 +108,143 @@ static FILE *open_pci_ids(void)
 	return NULL;
 }
 
+static int pci_id_cmp(const void *a, const void *b)
+{
+	const struct pci_id *x = a, *y = b;
+
+	if (x->level != y->level)
+		return x->level < y->level ? -1 : 1;
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return 0;
+}
+
+static int pci_id_add(enum pci_id_level level, uint64_t key, char *name)
+{
+	struct pci_id *ids;
+
+	if (pci_ids.nr == pci_ids.size) {
+		pci_ids.size = pci_ids.size ? pci_ids.size * 2 : 4096;
+		ids = realloc(pci_ids.ids, pci_ids.size * sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+		pci_ids.ids = ids;
+	}
+
+	while (*name == ' ' || *name == '\t')
+		name++;
+	pci_ids.ids[pci_ids.nr].key = key;
+	pci_ids.ids[pci_ids.nr].level = level;
+	pci_ids.ids[pci_ids.nr].name = name;
+	pci_ids.nr++;
+
+	return 0;
+}
+
+/*
+ * The lines of pci.ids are "vendor  name", "\tdevice  name" and
+ * "\t\tsubvendor subdevice  name", followed by the classes as
+ * "C class  name", "\tsubclass  name" and "\t\tprog-if  name".
+ */
+static int pci_ids_parse(char *data)
+{
+	uint64_t vendor = 0, device = 0, class = 0, sv, sd;
+	bool classes = false;
+	char *line, *next, *end;
+	int err = 0;
+
+	for (line = data; line && !err; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		if (line[0] == '#' || line[0] == '\0')
+			continue;
+
+		if (line[0] == 'C' && line[1] == ' ') {
+			classes = true;
+			class = strtoul(line + 2, &end, 16);
+		} else if (line[0] != '\t') {
+			classes = false;
+			vendor = (uint64_t)strtoul(line, &end, 16) << 48;
+			err = pci_id_add(PCI_ID_VENDOR, vendor, end);
+		} else if (line[1] != '\t') {
+			sv = strtoul(line + 1, &end, 16);
+			if (classes) {
+				err = pci_id_add(PCI_ID_SUBCLASS, class << 8 | sv, end);
+			} else {
+				device = vendor | sv << 32;
+				err = pci_id_add(PCI_ID_DEVICE, device, end);
+			}
+		} else if (!classes) {
+			sv = strtoul(line + 2, &end, 16);
+			sd = strtoul(end, &end, 16);
+			err = pci_id_add(PCI_ID_SUBSYS, device | sv << 16 | sd, end);
+		}
+	}
+
+	return err;
+}
+
+static void pci_ids_load(void)
+{
+	struct stat st;
+	size_t len;
+	FILE *file;
+
+	pci_ids.loaded = true;
+
+	file = open_pci_ids();
+	if (!file)
+		return;
+
+	if (fstat(fileno(file), &st) < 0)
+		goto close;
+
+	pci_ids.data = malloc(st.st_size + 1);
+	if (!pci_ids.data)
+		goto close;
+	len = fread(pci_ids.data, 1, st.st_size, file);
+	pci_ids.data[len] = '\0';
+
+	if (pci_ids_parse(pci_ids.data)) {
+		fprintf(stderr, "pci.ids: %s\n", strerror(ENOMEM));
+		free(pci_ids.ids);
+		pci_ids.ids = NULL;
+		pci_ids.nr = 0;
+		goto close;
+	}
+	qsort(pci_ids.ids, pci_ids.nr, sizeof(*pci_ids.ids), pci_id_cmp);
+close:
+	fclose(file);
+}
+
+static const char *pci_id_find(enum pci_id_level level, uint64_t key)
+{
+	struct pci_id k = { .key = key, .level = level }, *id;
+
+	if (!pci_ids.nr)
+		return NULL;
+
+	id = bsearch(&k, pci_ids.ids, pci_ids.nr, sizeof(*pci_ids.ids), pci_id_cmp);
+	return id ? id->name : NULL;
+}
+
 char *nvme_product_name(int id)
 {
-	char *line = NULL;
-	ssize_t amnt;
+	const char *vendor_name, *device_name, *subsys_name, *class_name;
 	char vendor[7] = { 0 };
 	char device[7] = { 0 };
 	char sub_device[7] = { 0 };
 	char sub_vendor[7] = { 0 };
 	char class[13] = { 0 };
-	size_t size = 1024;
+	uint64_t ven, dev;
+	char *line;
 	char ret;
-	FILE *file = open_pci_ids();
 
-	if (!file)
-		goto error1;
+	if (!pci_ids.loaded)
+		pci_ids_load();
+	if (!pci_ids.data)
+		return strdup("NULL");
 
 	snprintf(fmt1, 78, _fmt1, id);
 	snprintf(fmt2, 78, _fmt2, id);
@@ -323,35 +258,39 @@ char *nvme_product_name(int id)
 	ret |= read_sys_node(fmt4, device, 7);
 	ret |= read_sys_node(fmt5, class, 13);
 	if (ret)
-		goto error0;
+		return strdup("NULL");
 
 	line = malloc(1024);
 	if (!line) {
 		fprintf(stderr, "malloc: %s\n", strerror(errno));
-		goto error0;
+		return strdup("NULL");
 	}
 
-	while ((amnt = getline(&line, &size, file)) != -1) {
-		if (is_comment(line) && !is_class_info(line))
-			continue;
-		if (is_top_level_match(line, vendor, false)) {
-			line[amnt - 1] = '\0';
-			free(device_top);
-			device_top = strdup(line);
-			parse_vendor_device(&line, file,
-						device,
-						sub_device,
-						sub_vendor);
-		}
-		if (is_class_info(line))
-			pull_class_info(&line, file, class);
-	}
-	fclose(file);
-	format_all(line, vendor, device);
-	free_all();
+	ven = (uint64_t)strtoul(vendor, NULL, 16) << 48;
+	dev = ven | (uint64_t)strtoul(device, NULL, 16) << 32;
+	vendor_name = pci_id_find(PCI_ID_VENDOR, ven);
+	device_name = vendor_name ? pci_id_find(PCI_ID_DEVICE, dev) : NULL;
+	subsys_name = device_name ?
+		pci_id_find(PCI_ID_SUBSYS, dev | strtoul(sub_vendor, NULL, 16) << 16 |
+			    strtoul(sub_device, NULL, 16)) : NULL;
+	/* class:subclass:prog-if, e.g. 0x010802 */
+	class_name = pci_id_find(PCI_ID_SUBCLASS, strtoul(class, NULL, 16) >> 8);
+
+	if (vendor_name && device_name && class_name && subsys_name)
+		snprintf(line, 1024, "%s: %s %s %s", class_name, vendor_name,
+			 device_name, subsys_name);
+	else if (vendor_name && device_name && class_name)
+		snprintf(line, 1024, "%s: %s %s", class_name, vendor_name, device_name);
+	else if (vendor_name && device_name && subsys_name)
+		snprintf(line, 1024, "%s %s %s", vendor_name, device_name, subsys_name);
+	else if (vendor_name && device_name)
+		snprintf(line, 1024, "%s %s", vendor_name, device_name);
+	else if (vendor_name && class_name)
+		snprintf(line, 1024, "%s: %s Device %s", class_name, vendor_name, device);
+	else if (class_name)
+		snprintf(line, 1024, "%s: Vendor %s Device %s", class_name, vendor, device);
+	else
+		snprintf(line, 1024, "Unknown device");
+
 	return line;
-error0:
-	fclose(file);
-error1:
-	return strdup("NULL");
 }
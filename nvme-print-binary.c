@@ -11,6 +11,16 @@ static void binary_predictable_latency_per_nvmset(
 	d_raw((unsigned char *)plpns_log, sizeof(*plpns_log));
 }
 
+static void binary_predictable_latency_nvmset_batch(struct nvme_log_batch_entry *e,
+						   int nr, const char *devname)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (!e[i].err)
+			d_raw(e[i].log, sizeof(struct nvme_nvmset_predictable_lat_log));
+}
+
 static void binary_predictable_latency_event_agg_log(
 	struct nvme_aggregate_predictable_lat_event *pea_log,
 	__u64 log_entries, __u32 size, const char *devname)
@@ -137,6 +147,16 @@ static void binary_id_ns_descs(void *data, unsigned nsid)
 	d_raw((unsigned char *)data, 0x1000);
 }
 
+/* the data of the namespaces identified, back to back */
+static void binary_id_ns_all(struct nvme_id_ns_entry *list, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (!list[i].err)
+			d_raw((unsigned char *)list[i].data, NVME_IDENTIFY_DATA_SIZE);
+}
+
 static void binary_id_ctrl(struct nvme_id_ctrl *ctrl,
 	void (*vendor_show)(__u8 *vs, struct json_object *root))
 {
@@ -252,6 +272,16 @@ static void binary_endurance_log(struct nvme_endurance_group_log *endurance_log,
 	return d_raw((unsigned char *)endurance_log, sizeof(*endurance_log));
 }
 
+static void binary_endurance_log_batch(struct nvme_log_batch_entry *e, int nr,
+				       const char *devname)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (!e[i].err)
+			d_raw(e[i].log, sizeof(struct nvme_endurance_group_log));
+}
+
 static void binary_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 	 const char *devname)
 {
@@ -310,6 +340,7 @@ static struct print_ops binary_print_ops = {
 	.endurance_group_event_agg_log	= binary_endurance_group_event_agg_log,
 	.endurance_group_list		= NULL,
 	.endurance_log			= binary_endurance_log,
+	.endurance_log_batch		= binary_endurance_log_batch,
 	.error_log			= binary_error_log,
 	.fdp_config_log			= binary_fdp_configs,
 	.fdp_event_log			= binary_fdp_events,
@@ -325,6 +356,8 @@ static struct print_ops binary_print_ops = {
 	.id_iocs			= NULL,
 	.id_ns				= binary_id_ns,
 	.id_ns_descs			= binary_id_ns_descs,
+	.id_ns_all			= binary_id_ns_all,
+	.id_ns_descs_all		= binary_id_ns_all,
 	.id_ns_granularity_list		= binary_id_ns_granularity_list,
 	.id_nvmset_list			= binary_id_nvmset,
 	.id_uuid_list			= binary_id_uuid_list,
@@ -338,6 +371,7 @@ static struct print_ops binary_print_ops = {
 	.persistent_event_log		= binary_persistent_event_log,
 	.predictable_latency_event_agg_log = binary_predictable_latency_event_agg_log,
 	.predictable_latency_per_nvmset	= binary_predictable_latency_per_nvmset,
+	.predictable_latency_nvmset_batch = binary_predictable_latency_nvmset_batch,
 	.primary_ctrl_cap		= binary_primary_ctrl_cap,
 	.resv_notification_log		= binary_resv_notif_log,
 	.resv_report			= binary_resv_report,
@@ -7,6 +7,7 @@
 #include "nvme-print.h"
 
 #include "util/json.h"
+#include "util/sysfs.h"
 #include "nvme.h"
 #include "common.h"
 
@@ -23,17 +24,31 @@
 #define array_add_obj json_array_add_value_object
 #define array_add_str json_array_add_value_string
 
-#define obj_add_array json_object_add_value_array
-#define obj_add_int json_object_add_value_int
-#define obj_add_obj json_object_add_value_object
-#define obj_add_str json_object_add_value_string
-#define obj_add_uint json_object_add_value_uint
-#define obj_add_uint128 json_object_add_value_uint128
-#define obj_add_uint64 json_object_add_value_uint64
+#define obj_add_array obj_add_member
+#define obj_add_int(o, k, v) obj_add_member(o, k, json_object_new_int(v))
+#define obj_add_obj obj_add_member
+#define obj_add_uint(o, k, v) obj_add_member(o, k, json_object_new_uint64(v))
+#define obj_add_uint128(o, k, v) obj_add_member(o, k, util_json_object_new_uint128(v))
+#define obj_add_uint64(o, k, v) obj_add_member(o, k, json_object_new_uint64(v))
 
 static const uint8_t zero_uuid[16] = { 0 };
 static struct print_ops json_print_ops;
 static struct json_object *json_r;
+static __thread struct json_object **json_capture;
+
+static int obj_add_member(struct json_object *o, const char *k, struct json_object *v)
+{
+	/* the trees handed out or collected into json_r outlive the print op */
+	if (json_capture || json_r)
+		return json_object_object_add(o, k, v);
+
+	return json_object_add_arena(o, k, v);
+}
+
+static int obj_add_str(struct json_object *o, const char *k, const char *v)
+{
+	return obj_add_member(o, k, v ? json_object_new_string(v) : NULL);
+}
 
 static void json_feature_show_fields(enum nvme_features_id fid, unsigned int result,
 				     unsigned char *buf);
@@ -129,6 +144,13 @@ static void obj_add_int_secs(struct json_object *o, const char *k, int v)
 	obj_add_str(o, k, str);
 }
 
+/* the samples and events of a following command, one JSON line or CBOR item each */
+static void json_stream_record(struct json_object *r)
+{
+	util_json_write_record(stdout, r, true);
+	fflush(stdout);
+}
+
 static void obj_add_result(struct json_object *o, const char *v, ...)
 {
 	va_list ap;
@@ -192,8 +214,14 @@ static struct json_object *obj_create(const char *k)
 
 static void json_print(struct json_object *r)
 {
+	if (json_capture) {
+		json_free_object(*json_capture);
+		*json_capture = r;
+		return;
+	}
+
 	json_print_object(r, NULL);
-	printf("\n");
+	util_json_print_newline();
 	json_free_object(r);
 }
 
@@ -203,6 +231,30 @@ static void obj_print(struct json_object *o)
 		json_print(o);
 }
 
+/*
+ * The streamed printers write to stdout, unless their objects are
+ * captured or collected into json_r: then the stream builds the tree and
+ * json_stream_end() hands it to json_print().
+ */
+static void json_stream_begin(struct json_stream *s)
+{
+	json_stream_init(s, json_capture || json_r ? NULL : stdout);
+}
+
+static void json_stream_end(struct json_stream *s)
+{
+	if (!s->f && s->root)
+		json_print(s->root);
+}
+
+static void json_stream_out(struct json_object *r)
+{
+	if (json_capture || json_r)
+		json_print(r);
+	else
+		json_stream_print(r);
+}
+
 static bool human(void)
 {
 	return json_print_ops.flags & VERBOSE;
@@ -224,13 +276,12 @@ static void json_id_iocs(struct nvme_id_iocs *iocs)
 	json_print(r);
 }
 
-static void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
-			    unsigned int lba_index, bool cap_only)
+static void json_id_ns_members(struct json_object *r, struct nvme_id_ns *ns,
+			       bool cap_only)
 {
 	char nguid_buf[2 * sizeof(ns->nguid) + 1],
 		eui64_buf[2 * sizeof(ns->eui64) + 1];
 	char *nguid = nguid_buf, *eui64 = eui64_buf;
-	struct json_object *r = json_create_object();
 	struct json_object *lbafs = json_create_array();
 	struct json_object *vs = json_create_array();
 	int i;
@@ -315,6 +366,44 @@ static void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
 
 	d_json(ns->vs, strnlen((const char *)ns->vs, sizeof(ns->vs)), 16, 1, vs);
 	obj_add_array(r, "vs", vs);
+}
+
+static void json_nvme_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
+			    unsigned int lba_index, bool cap_only)
+{
+	struct json_object *r = json_create_object();
+
+	json_id_ns_members(r, ns, cap_only);
+	json_print(r);
+}
+
+/* the namespace of @e with its NSID, or the error identifying it */
+static struct json_object *json_id_ns_entry_obj(struct nvme_id_ns_entry *e)
+{
+	struct json_object *ns = json_create_object();
+
+	obj_add_uint(ns, "nsid", e->nsid);
+	if (e->err)
+		obj_add_str(ns, "error", e->err < 0 ? nvme_strerror(-e->err) :
+			    nvme_status_to_string(e->err, false));
+
+	return ns;
+}
+
+static void json_id_ns_all(struct nvme_id_ns_entry *list, int nr)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nss = json_create_array();
+	struct json_object *ns;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		ns = json_id_ns_entry_obj(&list[i]);
+		if (!list[i].err)
+			json_id_ns_members(ns, list[i].data, false);
+		array_add_obj(nss, ns);
+	}
+	obj_add_array(r, "namespaces", nss);
 
 	json_print(r);
 }
@@ -457,8 +546,8 @@ void json_nvme_id_ctrl(struct nvme_id_ctrl *ctrl,
 	json_print(r);
 }
 
-static void json_error_log(struct nvme_error_log_page *err_log, int entries,
-			   const char *devname)
+static struct json_object *json_error_log_obj(struct nvme_error_log_page *err_log,
+					      int entries)
 {
 	struct json_object *r = json_create_object();
 	struct json_object *errors = json_create_array();
@@ -486,6 +575,218 @@ static void json_error_log(struct nvme_error_log_page *err_log, int entries,
 		array_add_obj(errors, error);
 	}
 
+	return r;
+}
+
+static void json_error_log(struct nvme_error_log_page *err_log, int entries,
+			   const char *devname)
+{
+	json_stream_out(json_error_log_obj(err_log, entries));
+}
+
+static void json_resv_batch(struct nvme_resv_batch *b)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nss = json_create_array();
+	struct nvme_resv_batch_ns *ns;
+	struct json_object *o;
+	int i, failed = 0;
+
+	for (i = 0; i < b->nr_ns; i++) {
+		ns = &b->ns[i];
+		o = json_create_object();
+		obj_add_uint(o, "nsid", ns->nsid);
+		obj_add_int(o, "status", ns->err);
+		if (ns->err < 0)
+			obj_add_str(o, "error", nvme_strerror(-ns->err));
+		else if (ns->err)
+			obj_add_str(o, "error", nvme_status_to_string(ns->err, false));
+		obj_add_uint64(o, "elapsed_ns", ns->elapsed_ns);
+		array_add_obj(nss, o);
+		failed += !!ns->err;
+	}
+
+	obj_add_str(r, "device", b->name);
+	obj_add_str(r, "action", b->action);
+	obj_add_uint(r, "jobs", b->jobs);
+	obj_add_int(r, "total", b->nr_ns);
+	obj_add_int(r, "failed", failed);
+	obj_add_uint64(r, "elapsed_ns", b->elapsed_ns);
+	obj_add_array(r, "namespaces", nss);
+
+	json_print(r);
+}
+
+static void json_streams(struct nvme_streams *s)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nss = json_create_array();
+	struct nvme_streams_ns *ns;
+	struct json_object *o;
+	int i, failed = 0;
+
+	for (i = 0; i < s->nr_ns; i++) {
+		ns = &s->ns[i];
+		o = json_create_object();
+		obj_add_uint(o, "nsid", ns->nsid);
+		obj_add_int(o, "status", ns->err);
+		if (ns->err < 0)
+			obj_add_str(o, "error", nvme_strerror(-ns->err));
+		else if (ns->err)
+			obj_add_str(o, "error", nvme_status_to_string(ns->err, false));
+		if (!strcmp(s->action, "allocate"))
+			obj_add_uint(o, "requested", ns->requested);
+		if (!ns->err && strcmp(s->action, "release"))
+			obj_add_uint(o, "nsa", ns->nsa);
+		if (!ns->err && !strcmp(s->action, "status"))
+			obj_add_uint(o, "nso", ns->nso);
+		array_add_obj(nss, o);
+		failed += !!ns->err;
+	}
+
+	obj_add_str(r, "device", s->name);
+	obj_add_str(r, "action", s->action);
+	obj_add_uint(r, "msl", s->msl);
+	obj_add_uint(r, "nssa", s->nssa);
+	obj_add_uint(r, "nsso", s->nsso);
+	obj_add_uint(r, "sws", s->sws);
+	obj_add_uint(r, "sgs", s->sgs);
+	obj_add_int(r, "total", s->nr_ns);
+	obj_add_int(r, "failed", failed);
+	obj_add_uint64(r, "elapsed_ns", s->elapsed_ns);
+	obj_add_array(r, "namespaces", nss);
+
+	json_print(r);
+}
+
+static void json_cap_layout(struct nvme_cap_layout *l)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ops = json_create_array();
+	struct json_object *phases = json_create_array();
+	struct nvme_cap_layout_phase *ph;
+	struct nvme_cap_layout_op *o;
+	struct json_object *obj;
+	int i;
+
+	for (i = 0; i < l->nr_ops; i++) {
+		o = &l->ops[i];
+		obj = json_create_object();
+		obj_add_str(obj, "operation", nvme_cap_layout_op_to_string(o->op));
+		obj_add_uint(obj, "element_id", o->element_id);
+		if (o->op == NVME_CAP_LAYOUT_CREATE_ENDGRP || o->op == NVME_CAP_LAYOUT_CREATE_NVMSET)
+			obj_add_uint64(obj, "capacity", o->capacity);
+		obj_add_obj(obj, "run", json_object_new_boolean(o->run));
+		if (o->run) {
+			obj_add_int(obj, "status", o->err);
+			if (o->err < 0)
+				obj_add_str(obj, "error", nvme_strerror(-o->err));
+			else if (o->err)
+				obj_add_str(obj, "error", nvme_status_to_string(o->err, false));
+			else if (o->op == NVME_CAP_LAYOUT_CREATE_ENDGRP ||
+				 o->op == NVME_CAP_LAYOUT_CREATE_NVMSET)
+				obj_add_uint(obj, "created", o->result);
+			obj_add_uint64(obj, "elapsed_ns", o->elapsed_ns);
+		}
+		array_add_obj(ops, obj);
+	}
+
+	for (i = 0; i < l->nr_phases; i++) {
+		ph = &l->phases[i];
+		if (!ph->nr)
+			continue;
+		obj = json_create_object();
+		obj_add_str(obj, "phase", ph->name);
+		obj_add_int(obj, "operations", ph->nr);
+		obj_add_uint64(obj, "elapsed_ns", ph->elapsed_ns);
+		array_add_obj(phases, obj);
+	}
+
+	obj_add_str(r, "device", l->name);
+	if (l->list_ns)
+		obj_add_uint64(r, "list_ns", l->list_ns);
+	obj_add_array(r, "phases", phases);
+	obj_add_array(r, "operations", ops);
+	obj_add_uint64(r, "elapsed_ns", l->elapsed_ns);
+
+	json_print(r);
+}
+
+/* a JSON line per namespace, busiest writer first, to be filtered as a stream */
+static void json_smart_ns_table(struct nvme_smart_ns *list, int nr, const char *devname)
+{
+	struct json_object *r;
+	struct nvme_smart_log *l;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		r = json_create_object();
+		obj_add_str(r, "device", devname);
+		obj_add_uint(r, "nsid", list[i].nsid);
+		if (list[i].err) {
+			obj_add_str(r, "error", list[i].err < 0 ?
+				    nvme_strerror(-list[i].err) :
+				    nvme_status_to_string(list[i].err, false));
+		} else {
+			l = &list[i].log;
+			obj_add_uint128(r, "data_units_written",
+					le128_to_cpu(l->data_units_written));
+			obj_add_uint128(r, "data_units_read", le128_to_cpu(l->data_units_read));
+			obj_add_uint128(r, "host_write_commands", le128_to_cpu(l->host_writes));
+			obj_add_uint128(r, "host_read_commands", le128_to_cpu(l->host_reads));
+		}
+
+		util_json_write_record(stdout, r, true);
+	}
+	fflush(stdout);
+}
+
+static void json_resv_table(struct nvme_resv_ns *list, int nr)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nss = json_create_array();
+	struct json_object *ns, *regs, *reg;
+	struct nvme_resv_status *s;
+	char hostid[33];
+	__u16 cntlid;
+	__u8 rcsts;
+	__u64 rkey;
+	int i, j, regctl;
+
+	for (i = 0; i < nr; i++) {
+		ns = json_create_object();
+		obj_add_uint(ns, "nsid", list[i].nsid);
+		if (list[i].err) {
+			obj_add_str(ns, "error", list[i].err < 0 ?
+				    nvme_strerror(-list[i].err) :
+				    nvme_status_to_string(list[i].err, false));
+			array_add_obj(nss, ns);
+			continue;
+		}
+
+		s = list[i].status;
+		obj_add_uint(ns, "gen", le32_to_cpu(s->gen));
+		obj_add_int(ns, "rtype", s->rtype);
+		obj_add_str(ns, "type", nvme_resv_type_to_string(s->rtype));
+		obj_add_int(ns, "ptpls", s->ptpls);
+
+		regs = json_create_array();
+		regctl = nvme_resv_registrant(&list[i], -1, NULL, NULL, NULL, NULL, 0);
+		for (j = 0; j < regctl; j++) {
+			nvme_resv_registrant(&list[i], j, &cntlid, &rcsts, &rkey,
+					     hostid, sizeof(hostid));
+			reg = json_create_object();
+			obj_add_int(reg, "cntlid", cntlid);
+			obj_add_int(reg, "holder", rcsts & 1);
+			obj_add_uint64(reg, "rkey", rkey);
+			obj_add_str(reg, "hostid", hostid);
+			array_add_obj(regs, reg);
+		}
+		obj_add_array(ns, "registrants", regs);
+		array_add_obj(nss, ns);
+	}
+	obj_add_array(r, "namespaces", nss);
+
 	json_print(r);
 }
 
@@ -611,8 +912,7 @@ void json_changed_ns_list_log(struct nvme_ns_list *log,
 	json_print(r);
 }
 
-static void json_endurance_log(struct nvme_endurance_group_log *endurance_group, __u16 group_id,
-			       const char *devname)
+static struct json_object *json_endurance_log_obj(struct nvme_endurance_group_log *endurance_group)
 {
 	struct json_object *r = json_create_object();
 	nvme_uint128_t endurance_estimate = le128_to_cpu(endurance_group->endurance_estimate);
@@ -645,11 +945,47 @@ static void json_endurance_log(struct nvme_endurance_group_log *endurance_group,
 	obj_add_uint128(r, "total_end_grp_cap", total_end_grp_cap);
 	obj_add_uint128(r, "unalloc_end_grp_cap", unalloc_end_grp_cap);
 
+	return r;
+}
+
+static void json_endurance_log(struct nvme_endurance_group_log *endurance_group, __u16 group_id,
+			       const char *devname)
+{
+	json_print(json_endurance_log_obj(endurance_group));
+}
+
+static void json_log_batch_err(struct json_object *o, struct nvme_log_batch_entry *e)
+{
+	obj_add_str(o, "error", e->err < 0 ? nvme_strerror(-e->err) :
+		    nvme_status_to_string(e->err, false));
+}
+
+static void json_endurance_log_batch(struct nvme_log_batch_entry *e, int nr,
+				     const char *devname)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *groups = json_create_array();
+	struct json_object *g;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (e[i].err) {
+			g = json_create_object();
+			json_log_batch_err(g, &e[i]);
+		} else {
+			g = json_endurance_log_obj(e[i].log);
+		}
+		obj_add_uint(g, "endgid", e[i].id);
+		array_add_obj(groups, g);
+	}
+
+	obj_add_str(r, "device", devname);
+	obj_add_array(r, "endurance_groups", groups);
+
 	json_print(r);
 }
 
-static void json_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
-			   const char *devname)
+static struct json_object *json_smart_log_obj(struct nvme_smart_log *smart)
 {
 	struct json_object *r = json_create_object();
 	int c;
@@ -716,7 +1052,13 @@ static void json_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 	obj_add_uint(r, "thm_temp1_total_time", le32_to_cpu(smart->thm_temp1_total_time));
 	obj_add_uint(r, "thm_temp2_total_time", le32_to_cpu(smart->thm_temp2_total_time));
 
-	json_print(r);
+	return r;
+}
+
+static void json_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
+			   const char *devname)
+{
+	json_print(json_smart_log_obj(smart));
 }
 
 static void json_ana_log(struct nvme_ana_log *ana_log, const char *devname,
@@ -767,6 +1109,25 @@ static void json_ana_log(struct nvme_ana_log *ana_log, const char *devname,
 	json_print(r);
 }
 
+static void json_ana_transition(const struct nvme_ana_transition *t, const char *devname)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nsids = json_create_array();
+	__u32 i;
+
+	obj_add_str(r, "device", devname);
+	obj_add_uint(r, "grpid", t->grpid);
+	if (t->old_state)
+		obj_add_str(r, "old_state", nvme_ana_state_to_string(t->old_state));
+	obj_add_str(r, "state", nvme_ana_state_to_string(t->new_state));
+	obj_add_uint64(r, "chgcnt", t->chgcnt);
+	for (i = 0; i < t->nr_nsids; i++)
+		array_add_obj(nsids, json_object_new_uint64(t->nsids[i]));
+	obj_add_array(r, "nsids", nsids);
+
+	json_stream_record(r);
+}
+
 static void json_select_result(enum nvme_features_id fid, __u32 result)
 {
 	struct json_object *r = json_r ? json_r : json_create_object();
@@ -837,7 +1198,7 @@ add:
 
 	obj_add_array(r, "List of Valid Reports", valid);
 
-	json_print(r);
+	json_stream_out(r);
 }
 
 static void json_registers_cap(struct nvme_bar_cap *cap, struct json_object *r)
@@ -1401,9 +1762,8 @@ static void json_sanitize_log(struct nvme_sanitize_log_page *sanitize_log,
 	json_print(r);
 }
 
-static void json_predictable_latency_per_nvmset(
-		struct nvme_nvmset_predictable_lat_log *plpns_log,
-		__u16 nvmset_id, const char *devname)
+static struct json_object *json_predictable_latency_per_nvmset_obj(
+		struct nvme_nvmset_predictable_lat_log *plpns_log, __u16 nvmset_id)
 {
 	struct json_object *r = json_create_object();
 
@@ -1419,6 +1779,38 @@ static void json_predictable_latency_per_nvmset(
 	obj_add_uint64(r, "dtwin_writes_estimate", le64_to_cpu(plpns_log->dtwin_we));
 	obj_add_uint64(r, "dtwin_time_estimate", le64_to_cpu(plpns_log->dtwin_te));
 
+	return r;
+}
+
+static void json_predictable_latency_per_nvmset(
+		struct nvme_nvmset_predictable_lat_log *plpns_log,
+		__u16 nvmset_id, const char *devname)
+{
+	json_print(json_predictable_latency_per_nvmset_obj(plpns_log, nvmset_id));
+}
+
+static void json_predictable_latency_nvmset_batch(struct nvme_log_batch_entry *e,
+						  int nr, const char *devname)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *sets = json_create_array();
+	struct json_object *set;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (e[i].err) {
+			set = json_create_object();
+			obj_add_uint(set, "nvmset_id", e[i].id);
+			json_log_batch_err(set, &e[i]);
+		} else {
+			set = json_predictable_latency_per_nvmset_obj(e[i].log, e[i].id);
+		}
+		array_add_obj(sets, set);
+	}
+
+	obj_add_str(r, "device", devname);
+	obj_add_array(r, "nvm_sets", sets);
+
 	json_print(r);
 }
 
@@ -1712,13 +2104,82 @@ static void json_pel_thermal_excursion(void *pevent_log_info, __u32 offset,
 	obj_add_uint(valid_attrs, "threshold", thermal_exc_event->threshold);
 }
 
+/* decode the event whose header is at @offset in @pevent_log_info */
+static struct json_object *json_pevent_event_obj(void *pevent_log_info, __u32 offset,
+						 __u32 event_number)
+{
+	struct nvme_persistent_event_entry *pevent_entry_head = pevent_log_info + offset;
+	struct json_object *valid_attrs = json_create_object();
+
+	obj_add_uint(valid_attrs, "event_number", event_number);
+	obj_add_str(valid_attrs, "event_type",
+		    nvme_pel_event_to_string(pevent_entry_head->etype));
+	obj_add_uint(valid_attrs, "event_type_rev", pevent_entry_head->etype_rev);
+	obj_add_uint(valid_attrs, "event_header_len", pevent_entry_head->ehl);
+	obj_add_uint(valid_attrs, "event_header_additional_info", pevent_entry_head->ehai);
+	obj_add_uint(valid_attrs, "ctrl_id", le16_to_cpu(pevent_entry_head->cntlid));
+	obj_add_uint64(valid_attrs, "event_time_stamp",
+		       le64_to_cpu(pevent_entry_head->ets));
+	obj_add_uint(valid_attrs, "port_id", le16_to_cpu(pevent_entry_head->pelpid));
+	obj_add_uint(valid_attrs, "vu_info_len", le16_to_cpu(pevent_entry_head->vsil));
+	obj_add_uint(valid_attrs, "event_len", le16_to_cpu(pevent_entry_head->el));
+
+	offset += pevent_entry_head->ehl + 3;
+
+	switch (pevent_entry_head->etype) {
+	case NVME_PEL_SMART_HEALTH_EVENT:
+		json_pel_smart_health(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_FW_COMMIT_EVENT:
+		json_pel_fw_commit(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_TIMESTAMP_EVENT:
+		json_pel_timestamp(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_POWER_ON_RESET_EVENT:
+		json_pel_power_on_reset(pevent_log_info, offset, valid_attrs,
+					pevent_entry_head->el, pevent_entry_head->vsil);
+		break;
+	case NVME_PEL_NSS_HW_ERROR_EVENT:
+		json_pel_nss_hw_error(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_CHANGE_NS_EVENT:
+		json_pel_change_ns(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_FORMAT_START_EVENT:
+		json_pel_format_start(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_FORMAT_COMPLETION_EVENT:
+		json_pel_format_completion(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_SANITIZE_START_EVENT:
+		json_pel_sanitize_start(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_SANITIZE_COMPLETION_EVENT:
+		json_pel_sanitize_completion(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_SET_FEATURE_EVENT:
+		json_pel_set_feature(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_TELEMETRY_CRT:
+		json_pel_telemetry_crt(pevent_log_info, offset, valid_attrs);
+		break;
+	case NVME_PEL_THERMAL_EXCURSION_EVENT:
+		json_pel_thermal_excursion(pevent_log_info, offset, valid_attrs);
+		break;
+	default:
+		break;
+	}
+
+	return valid_attrs;
+}
+
 static void json_pevent_entry(void *pevent_log_info, __u8 action, __u32 size, const char *devname,
-			      __u32 offset, struct json_object *valid)
+			      __u32 offset, struct json_stream *valid)
 {
 	int i;
 	struct nvme_persistent_event_log *pevent_log_head = pevent_log_info;
 	struct nvme_persistent_event_entry *pevent_entry_head;
-	struct json_object *valid_attrs;
 
 	for (i = 0; i < le32_to_cpu(pevent_log_head->tnev); i++) {
 		if (offset + sizeof(*pevent_entry_head) >= size)
@@ -1730,70 +2191,8 @@ static void json_pevent_entry(void *pevent_log_info, __u8 action, __u32 size, co
 		    size)
 			break;
 
-		valid_attrs = json_create_object();
-
-		obj_add_uint(valid_attrs, "event_number", i);
-		obj_add_str(valid_attrs, "event_type",
-			    nvme_pel_event_to_string(pevent_entry_head->etype));
-		obj_add_uint(valid_attrs, "event_type_rev", pevent_entry_head->etype_rev);
-		obj_add_uint(valid_attrs, "event_header_len", pevent_entry_head->ehl);
-		obj_add_uint(valid_attrs, "event_header_additional_info", pevent_entry_head->ehai);
-		obj_add_uint(valid_attrs, "ctrl_id", le16_to_cpu(pevent_entry_head->cntlid));
-		obj_add_uint64(valid_attrs, "event_time_stamp",
-			       le64_to_cpu(pevent_entry_head->ets));
-		obj_add_uint(valid_attrs, "port_id", le16_to_cpu(pevent_entry_head->pelpid));
-		obj_add_uint(valid_attrs, "vu_info_len", le16_to_cpu(pevent_entry_head->vsil));
-		obj_add_uint(valid_attrs, "event_len", le16_to_cpu(pevent_entry_head->el));
-
-		offset += pevent_entry_head->ehl + 3;
-
-		switch (pevent_entry_head->etype) {
-		case NVME_PEL_SMART_HEALTH_EVENT:
-			json_pel_smart_health(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_FW_COMMIT_EVENT:
-			json_pel_fw_commit(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_TIMESTAMP_EVENT:
-			json_pel_timestamp(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_POWER_ON_RESET_EVENT:
-			json_pel_power_on_reset(pevent_log_info, offset, valid_attrs,
-						pevent_entry_head->el, pevent_entry_head->vsil);
-			break;
-		case NVME_PEL_NSS_HW_ERROR_EVENT:
-			json_pel_nss_hw_error(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_CHANGE_NS_EVENT:
-			json_pel_change_ns(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_FORMAT_START_EVENT:
-			json_pel_format_start(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_FORMAT_COMPLETION_EVENT:
-			json_pel_format_completion(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_SANITIZE_START_EVENT:
-			json_pel_sanitize_start(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_SANITIZE_COMPLETION_EVENT:
-			json_pel_sanitize_completion(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_SET_FEATURE_EVENT:
-			json_pel_set_feature(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_TELEMETRY_CRT:
-			json_pel_telemetry_crt(pevent_log_info, offset, valid_attrs);
-			break;
-		case NVME_PEL_THERMAL_EXCURSION_EVENT:
-			json_pel_thermal_excursion(pevent_log_info, offset, valid_attrs);
-			break;
-		default:
-			break;
-		}
-
-		array_add_obj(valid, valid_attrs);
-		offset += le16_to_cpu(pevent_entry_head->el);
+		json_stream_add(valid, NULL, json_pevent_event_obj(pevent_log_info, offset, i));
+		offset += pevent_entry_head->ehl + 3 + le16_to_cpu(pevent_entry_head->el);
 	}
 }
 
@@ -1801,20 +2200,38 @@ static void json_persistent_event_log(void *pevent_log_info, __u8 action,
 				      __u32 size, const char *devname)
 {
 	struct json_object *r = json_create_object();
-	struct json_object *valid = json_create_array();
 	__u32 offset = sizeof(struct nvme_persistent_event_log);
+	struct json_stream s;
 
-	if (size >= offset) {
-		json_pevent_log_head(pevent_log_info, r);
-		json_pevent_entry(pevent_log_info, action, size, devname, offset, valid);
-		obj_add_array(r, "list_of_event_entries", valid);
-	} else {
+	if (size < offset) {
 		obj_add_result(r, "No log data can be shown with this log len at least " \
 				"512 bytes is required or can be 0 to read the complete "\
 				"log page after context established");
+		json_print(r);
+		return;
 	}
 
-	json_print(r);
+	/* the event list can be large, stream it instead of building a tree */
+	json_stream_begin(&s);
+	json_stream_open_object(&s, NULL);
+	json_pevent_log_head(pevent_log_info, r);
+	json_stream_add_members(&s, r);
+	json_stream_open_array(&s, "list_of_event_entries");
+	json_pevent_entry(pevent_log_info, action, size, devname, offset, &s);
+	json_stream_close(&s);
+	json_stream_close(&s);
+	json_stream_end(&s);
+}
+
+static void json_persistent_event(void *pevent_log_info, __u32 offset,
+				  __u32 event_number, const char *devname)
+{
+	struct json_object *r = json_pevent_event_obj(pevent_log_info, offset,
+						      event_number);
+
+	obj_add_str(r, "device", devname);
+
+	json_stream_record(r);
 }
 
 static void json_endurance_group_event_agg_log(
@@ -2318,6 +2735,30 @@ static void json_nvme_fdp_stats(struct nvme_fdp_stats_log *log)
 	json_print(r);
 }
 
+static struct json_object *json_fdp_event_obj(struct nvme_fdp_event *event)
+{
+	struct json_object *obj_event = json_create_object();
+
+	obj_add_uint(obj_event, "type", event->type);
+	obj_add_uint(obj_event, "fdpef", event->flags);
+	obj_add_uint(obj_event, "pid", le16_to_cpu(event->pid));
+	obj_add_uint64(obj_event, "timestamp", le64_to_cpu(*(uint64_t *)&event->ts));
+	obj_add_uint(obj_event, "nsid", le32_to_cpu(event->nsid));
+
+	if (event->type == NVME_FDP_EVENT_REALLOC) {
+		struct nvme_fdp_event_realloc *mr;
+
+		mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+
+		obj_add_uint(obj_event, "nlbam", le16_to_cpu(mr->nlbam));
+
+		if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
+			obj_add_uint64(obj_event, "lba", le64_to_cpu(mr->lba));
+	}
+
+	return obj_event;
+}
+
 static void json_nvme_fdp_events(struct nvme_fdp_events_log *log)
 {
 	struct json_object *r, *obj_events;
@@ -2330,34 +2771,21 @@ static void json_nvme_fdp_events(struct nvme_fdp_events_log *log)
 
 	obj_add_uint(r, "n", n);
 
-	for (unsigned int i = 0; i < n; i++) {
-		struct nvme_fdp_event *event = &log->events[i];
-
-		struct json_object *obj_event = json_create_object();
+	for (unsigned int i = 0; i < n; i++)
+		array_add_obj(obj_events, json_fdp_event_obj(&log->events[i]));
 
-		obj_add_uint(obj_event, "type", event->type);
-		obj_add_uint(obj_event, "fdpef", event->flags);
-		obj_add_uint(obj_event, "pid", le16_to_cpu(event->pid));
-		obj_add_uint64(obj_event, "timestamp", le64_to_cpu(*(uint64_t *)&event->ts));
-		obj_add_uint(obj_event, "nsid", le32_to_cpu(event->nsid));
-
-		if (event->type == NVME_FDP_EVENT_REALLOC) {
-			struct nvme_fdp_event_realloc *mr;
-
-			mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
-
-			obj_add_uint(obj_event, "nlbam", le16_to_cpu(mr->nlbam));
+	obj_add_array(r, "events", obj_events);
 
-			if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
-				obj_add_uint64(obj_event, "lba", le64_to_cpu(mr->lba));
-		}
+	json_print(r);
+}
 
-		array_add_obj(obj_events, obj_event);
-	}
+static void json_fdp_event(struct nvme_fdp_event *event, bool host)
+{
+	struct json_object *r = json_fdp_event_obj(event);
 
-	obj_add_array(r, "events", obj_events);
+	obj_add_str(r, "source", host ? "host" : "controller");
 
-	json_print(r);
+	json_stream_record(r);
 }
 
 static void json_nvme_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len)
@@ -2937,7 +3365,7 @@ static void json_nvme_cmd_set_independent_id_ns(struct nvme_id_independent_id_ns
 	json_print(r);
 }
 
-static void json_nvme_id_ns_descs(void *data, unsigned int nsid)
+static void json_id_ns_descs_members(struct json_object *r, void *data)
 {
 	/* large enough to hold uuid str (37) or nguid str (32) + zero byte */
 	char json_str[STR_LEN];
@@ -2948,7 +3376,6 @@ static void json_nvme_id_ns_descs(void *data, unsigned int nsid)
 		__u8 uuid[NVME_UUID_LEN];
 		__u8 csi;
 	} desc;
-	struct json_object *r = json_create_object();
 	struct json_object *json_array = NULL;
 	off_t off;
 	int pos, len = 0;
@@ -3017,6 +3444,30 @@ static void json_nvme_id_ns_descs(void *data, unsigned int nsid)
 
 	if (json_array)
 		obj_add_array(r, "ns-descs", json_array);
+}
+
+static void json_nvme_id_ns_descs(void *data, unsigned int nsid)
+{
+	struct json_object *r = json_create_object();
+
+	json_id_ns_descs_members(r, data);
+	json_print(r);
+}
+
+static void json_id_ns_descs_all(struct nvme_id_ns_entry *list, int nr)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *nss = json_create_array();
+	struct json_object *ns;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		ns = json_id_ns_entry_obj(&list[i]);
+		if (!list[i].err)
+			json_id_ns_descs_members(ns, list[i].data);
+		array_add_obj(nss, ns);
+	}
+	obj_add_array(r, "namespaces", nss);
 
 	json_print(r);
 }
@@ -3128,12 +3579,23 @@ static void json_nvme_list_ns(struct nvme_ns_list *ns_list)
 
 	obj_add_array(r, "nsid_list", valid);
 
-	json_print(r);
+	json_stream_out(r);
 }
 
+/*
+ * A zone report can hold millions of zones and is printed chunk by chunk,
+ * so the zones are streamed instead of being collected in zone_list.
+ */
+static struct json_stream zone_stream;
+
 static void json_zns_start_zone_list(__u64 nr_zones, struct json_object **zone_list)
 {
-	*zone_list = json_create_array();
+	*zone_list = NULL;
+
+	json_stream_begin(&zone_stream);
+	json_stream_open_object(&zone_stream, NULL);
+	json_stream_add(&zone_stream, "nr_zones", json_object_new_uint64(nr_zones));
+	json_stream_open_array(&zone_stream, "zone_list");
 }
 
 static void json_zns_changed(struct nvme_zns_changed_zone_log *log)
@@ -3159,12 +3621,9 @@ static void json_zns_changed(struct nvme_zns_changed_zone_log *log)
 static void json_zns_finish_zone_list(__u64 nr_zones,
 				      struct json_object *zone_list)
 {
-	struct json_object *r = json_create_object();
-
-	obj_add_uint(r, "nr_zones", nr_zones);
-	obj_add_array(r, "zone_list", zone_list);
-
-	json_print(r);
+	json_stream_close(&zone_stream);
+	json_stream_close(&zone_stream);
+	json_stream_end(&zone_stream);
 }
 
 static void json_nvme_zns_report_zones(void *report, __u32 descs,
@@ -3201,10 +3660,29 @@ static void json_nvme_zns_report_zones(void *report, __u32 descs,
 			}
 		}
 
-		array_add_obj(zone_list, zone);
+		json_stream_add(&zone_stream, NULL, zone);
 	}
 }
 
+static void json_zns_zone_summary(struct nvme_zone_summary *s)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *states = json_create_object();
+	int i;
+
+	obj_add_uint(r, "nsid", s->nsid);
+	obj_add_uint64(r, "nr_zones", s->nr_zones);
+	obj_add_uint64(r, "zone_size", s->zsze);
+	obj_add_uint64(r, "capacity_lbas", s->zcap);
+	for (i = 0; i < s->nr_states; i++)
+		obj_add_uint64(states, nvme_zone_state_to_string(s->states[i].state),
+			       s->states[i].zones);
+	obj_add_obj(r, "states", states);
+	obj_add_uint64(r, "written_lbas", s->written);
+
+	json_print(r);
+}
+
 static void json_feature_show_fields_arbitration(struct json_object *r, unsigned int result)
 {
 	char json_str[STR_LEN];
@@ -3857,7 +4335,7 @@ static void json_nvme_list_ctrl(struct nvme_ctrl_list *ctrl_list)
 
 	obj_add_array(r, "ctrl_list", valid);
 
-	json_print(r);
+	json_stream_out(r);
 }
 
 static void json_nvme_id_nvmset(struct nvme_id_nvmset_list *nvmset,
@@ -3993,6 +4471,621 @@ static void json_nvme_id_uuid_list(const struct nvme_id_uuid_list *uuid_list)
 	json_print(r);
 }
 
+static const double lat_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+static struct json_object *json_latency_percentiles(struct nvme_hist *hist)
+{
+	struct json_object *lat = json_create_object();
+	char key[16];
+	int i;
+
+	obj_add_uint64(lat, "samples", hist->count);
+	obj_add_uint64(lat, "min", hist->min);
+	obj_add_uint64(lat, "avg", nvme_hist_mean(hist));
+	for (i = 0; i < ARRAY_SIZE(lat_percentiles); i++) {
+		sprintf(key, "p%g", lat_percentiles[i]);
+		obj_add_uint64(lat, key, nvme_hist_percentile(hist, lat_percentiles[i]));
+	}
+	obj_add_uint64(lat, "max", hist->max);
+
+	return lat;
+}
+
+static void json_latency_hist(const char *name, struct nvme_hist *lat)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "name", name);
+	obj_add_obj(r, "latency_ns", json_latency_percentiles(lat));
+
+	json_print(r);
+}
+
+/*
+ * The keys of the vendor latency samplers: the commands counted, the
+ * percentiles in us and the non-empty buckets as [index, count, low, high].
+ */
+static void json_lat_sample(struct nvme_lat_sample *s)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *buckets = json_create_array();
+	struct nvme_lat_hist *h = s->hist;
+	char key[16];
+	unsigned int i;
+
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	if (s->interval_ns)
+		obj_add_uint64(r, "interval_ms", s->interval_ns / 1000000);
+	obj_add_str(r, "source", s->source);
+	obj_add_str(r, "type", s->type);
+	obj_add_uint64(r, "ios", nvme_lat_hist_count(h));
+	for (i = 0; i < ARRAY_SIZE(lat_percentiles); i++) {
+		sprintf(key, "p%g_us", lat_percentiles[i]);
+		obj_add_uint(r, key, nvme_lat_hist_percentile(h, lat_percentiles[i]));
+	}
+	obj_add_uint(r, "max_us", nvme_lat_hist_max(h));
+
+	for (i = 0; i < h->nr_buckets; i++) {
+		struct nvme_lat_bucket *b = &h->buckets[i];
+		struct json_object *bucket;
+
+		if (!b->count)
+			continue;
+		bucket = json_create_array();
+		json_object_array_add(bucket, json_object_new_int(i));
+		json_object_array_add(bucket, json_object_new_uint64(b->count));
+		json_object_array_add(bucket, json_object_new_uint64(b->low_us));
+		json_object_array_add(bucket, b->high_us == NVME_LAT_HIST_INF ? NULL :
+				      json_object_new_uint64(b->high_us));
+		json_object_array_add(buckets, bucket);
+	}
+	obj_add_array(r, "buckets", buckets);
+
+	if (!s->interval_ns) {
+		json_print(r);
+		return;
+	}
+
+	json_stream_record(r);
+}
+
+static void json_replay(struct nvme_replay *replay)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ops = json_create_array();
+	double secs = replay->elapsed_ns / 1e9;
+	struct json_object *o;
+	int i;
+
+	obj_add_str(r, "trace", replay->trace);
+	obj_add_uint(r, "queue_depth", replay->queue_depth);
+	obj_add_int(r, "timed", replay->timed);
+	obj_add_uint64(r, "commands", replay->cmds);
+	if (replay->timed)
+		obj_add_uint64(r, "late", replay->late);
+	obj_add_uint64(r, "runtime_ns", replay->elapsed_ns);
+	if (secs > 0)
+		obj_add_uint64(r, "iops", (uint64_t)(replay->cmds / secs));
+
+	for (i = 0; i < replay->nr_ops; i++) {
+		struct nvme_replay_op *op = &replay->ops[i];
+
+		o = json_create_object();
+		obj_add_str(o, "type", op->admin ? "admin" : "io");
+		obj_add_uint_02x(o, "opcode", op->opcode);
+		obj_add_str(o, "name", nvme_cmd_to_string(op->admin, op->opcode));
+		obj_add_uint64(o, "commands", op->cmds);
+		obj_add_uint64(o, "bytes", op->bytes);
+		obj_add_uint64(o, "errors", op->errors);
+		if (op->errors)
+			obj_add_int(o, "first_error", op->first_err);
+		obj_add_obj(o, "latency_ns", json_latency_percentiles(&op->lat));
+		array_add_obj(ops, o);
+	}
+	obj_add_array(r, "opcodes", ops);
+
+	json_print(r);
+}
+
+static struct json_object *json_io_stats_obj(const char *name, struct nvme_io_stats *stats)
+{
+	struct json_object *r = json_create_object();
+	double secs = stats->elapsed_ns / 1e9;
+
+	obj_add_str(r, "name", name);
+	obj_add_uint(r, "queue_depth", stats->queue_depth);
+	obj_add_uint(r, "threads", stats->threads);
+	if (stats->hw_queues)
+		obj_add_uint(r, "hw_queues", stats->hw_queues);
+	obj_add_str(r, "engine", stats->uring ? "io_uring" : "ioctl");
+	if (stats->uring) {
+		obj_add_int(r, "fixed_buffers", stats->fixed_bufs);
+		obj_add_int(r, "polled", stats->poll);
+	}
+	obj_add_int(r, "cmb_buffers", stats->cmb);
+	obj_add_uint64(r, "ios", stats->ios);
+	obj_add_uint64(r, "bytes", stats->bytes);
+	obj_add_uint64(r, "errors", stats->errors);
+	if (stats->errors)
+		obj_add_int(r, "first_error", stats->first_err);
+	obj_add_uint64(r, "runtime_ns", stats->elapsed_ns);
+	if (secs > 0) {
+		obj_add_uint64(r, "iops", (uint64_t)(stats->ios / secs));
+		obj_add_uint64(r, "bytes_per_sec", (uint64_t)(stats->bytes / secs));
+	}
+	if (stats->rate_limited) {
+		obj_add_uint64(r, "rate_backoffs", stats->rate_backoffs);
+		json_object_add_value_double(r, "rate_scale", stats->rate_scale);
+	}
+
+	obj_add_obj(r, "latency_ns", json_latency_percentiles(&stats->lat));
+
+	return r;
+}
+
+static void json_io_stats(const char *name, struct nvme_io_stats *stats)
+{
+	json_print(json_io_stats_obj(name, stats));
+}
+
+static void json_hash_compare(struct nvme_hash_compare *hc)
+{
+	struct json_object *r = json_io_stats_obj("compare-hash", hc->stats);
+	struct json_object *bad = json_create_array();
+	struct json_object *m;
+	int i;
+
+	obj_add_str(r, "manifest", hc->manifest);
+	obj_add_int(r, "created", hc->create);
+	obj_add_uint64(r, "chunks", hc->chunks);
+
+	for (i = 0; i < hc->nr_bad; i++) {
+		m = json_create_object();
+		obj_add_uint64(m, "slba", hc->bad[i].slba);
+		obj_add_uint(m, "nlb", hc->bad[i].nlb);
+		if (hc->bad[i].status < 0) {
+			obj_add_str(m, "error", nvme_strerror(-hc->bad[i].status));
+		} else if (hc->bad[i].status) {
+			obj_add_int(m, "status", hc->bad[i].status);
+		} else {
+			obj_add_uint_0x(m, "expected", hc->bad[i].expected);
+			obj_add_uint_0x(m, "actual", hc->bad[i].actual);
+		}
+		array_add_obj(bad, m);
+	}
+	obj_add_array(r, "mismatches", bad);
+
+	json_print(r);
+}
+
+static void json_io_sweep(struct nvme_io_sweep *sweep)
+{
+	struct json_object *r = json_io_stats_obj(sweep->name, sweep->stats);
+	struct json_object *errs = json_create_array();
+	struct json_object *e;
+	int i;
+
+	obj_add_uint64(r, "slba", sweep->slba);
+	obj_add_uint64(r, "end", sweep->end);
+	obj_add_uint64(r, "next_lba", sweep->next_lba);
+
+	for (i = 0; i < sweep->nr_errs; i++) {
+		e = json_create_object();
+		obj_add_uint64(e, "slba", sweep->errs[i].slba);
+		obj_add_uint64(e, "nlb", sweep->errs[i].nlb);
+		if (sweep->errs[i].status < 0)
+			obj_add_str(e, "error", nvme_strerror(-sweep->errs[i].status));
+		else
+			obj_add_int(e, "status", sweep->errs[i].status);
+		array_add_obj(errs, e);
+	}
+	obj_add_array(r, "failed_ranges", errs);
+
+	json_print(r);
+}
+
+static void json_path_probe(struct nvme_path_probe *probe)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *paths = json_create_array();
+	struct nvme_path_probe_path *p;
+	struct json_object *o;
+	int i;
+
+	obj_add_str(r, "mode", probe->mode);
+	obj_add_uint(r, "queue_depth", probe->queue_depth);
+
+	for (i = 0; i < probe->nr_paths; i++) {
+		p = &probe->paths[i];
+		o = json_create_object();
+		obj_add_str(o, "path", p->name);
+		obj_add_uint(o, "nsid", p->nsid);
+		obj_add_str(o, "controller", p->ctrl);
+		obj_add_str(o, "transport", p->transport);
+		obj_add_str(o, "address", p->address);
+		obj_add_str(o, "state", p->state);
+		obj_add_str(o, "ana_state", p->ana_state);
+		if (p->err) {
+			obj_add_str(o, "error", nvme_strerror(-p->err));
+			array_add_obj(paths, o);
+			continue;
+		}
+		obj_add_uint64(o, "ios", p->ios);
+		obj_add_uint64(o, "errors", p->errors);
+		if (p->errors)
+			obj_add_int(o, "first_error", p->first_err);
+		obj_add_uint64(o, "runtime_ns", p->elapsed_ns);
+		obj_add_obj(o, "latency_ns", json_latency_percentiles(&p->lat));
+		array_add_obj(paths, o);
+	}
+	obj_add_array(r, "paths", paths);
+
+	json_print(r);
+}
+
+static void json_queue_advice(struct nvme_queue_advice *advice)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *layouts = json_create_array();
+	struct nvme_queue_layout *l;
+	struct json_object *o;
+	int i;
+
+	obj_add_str(r, "subsysnqn", advice->subsysnqn);
+	obj_add_str(r, "transport", advice->transport);
+	obj_add_str(r, "traddr", advice->traddr);
+	obj_add_uint(r, "nsid", advice->nsid);
+	obj_add_uint(r, "runtime", advice->runtime);
+
+	for (i = 0; i < advice->nr_layouts; i++) {
+		l = &advice->layouts[i];
+		o = json_create_object();
+		obj_add_int(o, "nr_io_queues", l->nr_io_queues);
+		obj_add_int(o, "nr_write_queues", l->nr_write_queues);
+		obj_add_int(o, "nr_poll_queues", l->nr_poll_queues);
+		obj_add_int(o, "queue_size", l->queue_size);
+		if (l->err) {
+			obj_add_str(o, "error", nvme_strerror(-l->err));
+			array_add_obj(layouts, o);
+			continue;
+		}
+		obj_add_str(o, "controller", l->ctrl);
+		obj_add_obj(o, "read", json_io_stats_obj("read", l->read));
+		if (l->write)
+			obj_add_obj(o, "write", json_io_stats_obj("write", l->write));
+		array_add_obj(layouts, o);
+	}
+	obj_add_array(r, "layouts", layouts);
+
+	if (advice->best >= 0)
+		obj_add_int(r, "recommended", advice->best);
+	obj_add_int(r, "saved", advice->saved);
+
+	json_print(r);
+}
+
+static void json_fdp_write(struct nvme_fdp_write *fw)
+{
+	struct json_object *r = json_io_stats_obj("fdp-write", fw->stats);
+	struct json_object *ruhs = json_create_array();
+	struct json_object *ruh;
+	int i;
+
+	for (i = 0; i < fw->nr_ruhs; i++) {
+		ruh = json_create_object();
+		obj_add_uint(ruh, "pid", fw->ruhs[i].pid);
+		obj_add_uint64(ruh, "bytes", fw->ruhs[i].bytes);
+		array_add_obj(ruhs, ruh);
+	}
+	obj_add_array(r, "placement_ids", ruhs);
+
+	obj_add_uint(r, "endgid", fw->egid);
+	obj_add_uint64(r, "hbmw", fw->hbmw);
+	obj_add_uint64(r, "mbmw", fw->mbmw);
+	obj_add_uint64(r, "mbe", fw->mbe);
+	if (fw->hbmw)
+		json_object_add_value_double(r, "waf", (double)fw->mbmw / fw->hbmw);
+
+	json_print(r);
+}
+
+static void json_collect(struct nvme_collect_dev *devs, int nr_devs)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devices = json_create_array();
+	struct json_object *dev, *logs, *l;
+	struct nvme_collect_log *log;
+	int i, j;
+
+	for (i = 0; i < nr_devs; i++) {
+		dev = json_create_object();
+		obj_add_str(dev, "device", devs[i].path);
+		if (devs[i].err) {
+			obj_add_str(dev, "error", nvme_strerror(-devs[i].err));
+			array_add_obj(devices, dev);
+			continue;
+		}
+
+		obj_add_uint64(dev, "elapsed_us", devs[i].elapsed_ns / NSEC_PER_USEC);
+		logs = json_create_object();
+		for (j = 0; j < devs[i].nr_logs; j++) {
+			log = &devs[i].logs[j];
+			if (log->err < 0) {
+				l = json_create_object();
+				obj_add_str(l, "error", nvme_strerror(-log->err));
+			} else if (log->err) {
+				l = json_create_object();
+				obj_add_str(l, "error", nvme_status_to_string(log->err, false));
+			} else if (log->data && !strcmp(log->name, "smart-log")) {
+				l = json_smart_log_obj(log->data);
+			} else if (log->data && !strcmp(log->name, "error-log")) {
+				l = json_error_log_obj(log->data,
+						       log->len / sizeof(struct nvme_error_log_page));
+			} else {
+				l = json_create_object();
+			}
+			obj_add_uint64(l, "size", log->len);
+			if (log->file)
+				obj_add_str(l, "file", log->file);
+			obj_add_obj(logs, log->name, l);
+		}
+		obj_add_obj(dev, "logs", logs);
+		array_add_obj(devices, dev);
+	}
+
+	obj_add_array(r, "devices", devices);
+
+	json_print(r);
+}
+
+static void json_fw_rollout(struct nvme_fw_rollout_dev *devs, int nr_devs)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devices = json_create_array();
+	struct nvme_fw_rollout_dev *d;
+	struct json_object *dev;
+	int i;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		dev = json_create_object();
+		obj_add_str(dev, "device", d->path);
+		obj_add_str(dev, "stage", nvme_fw_rollout_stage_to_string(d->stage));
+		obj_add_str(dev, "old_revision", d->old_rev);
+		if (d->skipped)
+			obj_add_int(dev, "skipped", 1);
+		if (d->download_ns)
+			obj_add_uint64(dev, "download_us", d->download_ns / NSEC_PER_USEC);
+		if (d->wave) {
+			obj_add_int(dev, "wave", d->wave);
+			obj_add_uint64(dev, "commit_us", d->commit_ns / NSEC_PER_USEC);
+		}
+		if (d->stage >= NVME_FW_ROLLOUT_VERIFY && !d->skipped)
+			obj_add_str(dev, "new_revision", d->new_rev);
+		if (d->reset)
+			obj_add_int(dev, "reset_required", 1);
+		if (d->mismatch)
+			obj_add_str(dev, "error", "revision mismatch");
+		else if (d->err < 0)
+			obj_add_str(dev, "error", nvme_strerror(-d->err));
+		else if (d->err)
+			obj_add_str(dev, "error", nvme_status_to_string(d->err, false));
+		array_add_obj(devices, dev);
+	}
+
+	obj_add_array(r, "devices", devices);
+
+	json_stream_out(r);
+}
+
+static void json_self_test_run(struct nvme_self_test_dev *devs, int nr_devs)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devices = json_create_array();
+	struct nvme_self_test_dev *d;
+	struct json_object *dev;
+	int i, passed = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		dev = json_create_object();
+		obj_add_str(dev, "device", d->path);
+		if (d->err < 0) {
+			obj_add_str(dev, "error", nvme_strerror(-d->err));
+		} else if (d->err) {
+			obj_add_str(dev, "error", nvme_status_to_string(d->err, false));
+		} else if (d->done) {
+			obj_add_str(dev, "result", nvme_self_test_result_to_string(d->result));
+			obj_add_uint(dev, "result_code", d->result);
+			obj_add_uint(dev, "self_test_code", d->stc);
+			if (d->result == NVME_ST_RESULT_KNOWN_SEG_FAIL)
+				obj_add_uint(dev, "segment", d->segment);
+			obj_add_uint64(dev, "power_on_hours", d->poh);
+			if (d->result == NVME_ST_RESULT_NO_ERR)
+				passed++;
+		} else {
+			obj_add_str(dev, "result", "no result");
+		}
+		obj_add_uint(dev, "progress", d->progress);
+		obj_add_uint64(dev, "elapsed_ms", d->elapsed_ns / 1000000);
+		array_add_obj(devices, dev);
+	}
+
+	obj_add_int(r, "total", nr_devs);
+	obj_add_int(r, "passed", passed);
+	obj_add_array(r, "devices", devices);
+
+	json_stream_out(r);
+}
+
+static void json_sanitize_run(struct nvme_sanitize_dev *devs, int nr_devs)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devices = json_create_array();
+	struct nvme_sanitize_dev *d;
+	struct json_object *dev;
+	int i, passed = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		dev = json_create_object();
+		obj_add_str(dev, "device", d->path);
+		if (d->err < 0) {
+			obj_add_str(dev, "error", nvme_strerror(-d->err));
+		} else if (d->err) {
+			obj_add_str(dev, "error", nvme_status_to_string(d->err, false));
+		} else if (d->done) {
+			obj_add_str(dev, "result", nvme_sanitize_result_to_string(d->sstat));
+			obj_add_uint(dev, "sstat", d->sstat);
+		} else {
+			obj_add_str(dev, "result", "running");
+			obj_add_uint(dev, "eta_s", d->eta);
+		}
+		if (d->passed)
+			passed++;
+		json_object_add_value_double(dev, "progress", d->sprog * 100.0 / 0x10000);
+		if (d->estimate)
+			obj_add_uint(dev, "estimated_s", d->estimate);
+		obj_add_uint64(dev, "elapsed_ms", d->elapsed_ns / 1000000);
+		obj_add_uint(dev, "polls", d->polls);
+		array_add_obj(devices, dev);
+	}
+
+	obj_add_int(r, "total", nr_devs);
+	obj_add_int(r, "passed", passed);
+	obj_add_array(r, "devices", devices);
+
+	json_stream_out(r);
+}
+
+static void json_format_run(struct nvme_format_dev *devs, int nr_devs, __u64 wall_ns)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devices = json_create_array();
+	struct nvme_format_dev *d;
+	struct json_object *dev;
+	__u64 sum_ns = 0;
+	int i, done = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		dev = json_create_object();
+		obj_add_str(dev, "device", d->path);
+		obj_add_str(dev, "subsystem", d->subsys);
+		if (d->err < 0) {
+			obj_add_str(dev, "error", nvme_strerror(-d->err));
+		} else if (d->err) {
+			obj_add_str(dev, "error", nvme_status_to_string(d->err, false));
+		} else {
+			obj_add_uint(dev, "nsid", d->nsid);
+			obj_add_uint(dev, "previous_lbaf", d->prev_lbaf);
+			obj_add_uint(dev, "lbaf", d->lbaf);
+			obj_add_int(dev, "all_namespaces", d->shared || d->nsid == NVME_NSID_ALL);
+			done++;
+			if (!d->shared)
+				sum_ns += d->elapsed_ns;
+		}
+		obj_add_uint64(dev, "wait_ms", d->wait_ns / 1000000);
+		obj_add_uint64(dev, "elapsed_ms", d->elapsed_ns / 1000000);
+		array_add_obj(devices, dev);
+	}
+
+	obj_add_int(r, "total", nr_devs);
+	obj_add_int(r, "formatted", done);
+	obj_add_uint64(r, "wall_ms", wall_ns / 1000000);
+	obj_add_uint64(r, "sequential_ms", sum_ns / 1000000);
+	obj_add_array(r, "devices", devices);
+
+	json_stream_out(r);
+}
+
+static void json_provision_ns(struct nvme_provision *p)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ctrls = json_create_array();
+	struct json_object *namespaces = json_create_array();
+	struct nvme_provision_ns *n;
+	struct json_object *ns;
+	int i, created = 0;
+
+	obj_add_str(r, "device", p->name);
+	obj_add_uint(r, "flbas", p->flbas);
+	obj_add_uint(r, "lba_size", p->lba_size);
+	for (i = 0; i < p->nr_ctrls; i++)
+		array_add_obj(ctrls, json_object_new_uint64(p->ctrls[i]));
+	obj_add_array(r, "controllers", ctrls);
+	if (p->dry_run)
+		obj_add_int(r, "dry_run", 1);
+
+	for (i = 0; i < p->nr_ns; i++) {
+		n = &p->ns[i];
+		ns = json_create_object();
+		if (n->nsid)
+			obj_add_uint(ns, "nsid", n->nsid);
+		obj_add_uint64(ns, "nsze", n->nsze);
+		obj_add_int(ns, "attached", n->attached);
+		if (n->err < 0)
+			obj_add_str(ns, "error", nvme_strerror(-n->err));
+		else if (n->err)
+			obj_add_str(ns, "error", nvme_status_to_string(n->err, false));
+		array_add_obj(namespaces, ns);
+		created += !!n->nsid;
+	}
+
+	obj_add_int(r, "total", p->nr_ns);
+	obj_add_int(r, "created", created);
+	if (p->rescan_err)
+		obj_add_str(r, "rescan_error", nvme_strerror(-p->rescan_err));
+	obj_add_uint64(r, "elapsed_ms", p->elapsed_ns / 1000000);
+	obj_add_array(r, "namespaces", namespaces);
+
+	json_stream_out(r);
+}
+
+static void json_virt_provision(struct nvme_virt_provision *p)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *ctrls = json_create_array();
+	struct nvme_virt_provision_ctrl *c;
+	struct json_object *o;
+	int i, failed = 0;
+
+	obj_add_str(r, "device", p->name);
+	obj_add_uint(r, "vq_flexible", p->vq_pool);
+	obj_add_uint(r, "vi_flexible", p->vi_pool);
+	if (p->dry_run)
+		obj_add_int(r, "dry_run", 1);
+
+	for (i = 0; i < p->nr_ctrls; i++) {
+		c = &p->ctrls[i];
+		o = json_create_object();
+		obj_add_uint(o, "scid", c->scid);
+		obj_add_uint(o, "vfn", c->vfn);
+		obj_add_uint(o, "nvq", c->nvq);
+		obj_add_uint(o, "nvi", c->nvi);
+		obj_add_uint(o, "prev_nvq", c->old_nvq);
+		obj_add_uint(o, "prev_nvi", c->old_nvi);
+		obj_add_int(o, "online", c->online);
+		if (c->err) {
+			obj_add_str(o, "failed_step", c->step);
+			if (c->err < 0)
+				obj_add_str(o, "error", nvme_strerror(-c->err));
+			else
+				obj_add_str(o, "error", nvme_status_to_string(c->err, false));
+		}
+		array_add_obj(ctrls, o);
+		failed += !!c->err;
+	}
+
+	obj_add_int(r, "total", p->nr_ctrls);
+	obj_add_int(r, "failed", failed);
+	obj_add_int(r, "commands", p->nr_cmds);
+	obj_add_uint64(r, "elapsed_ms", p->elapsed_ns / 1000000);
+	obj_add_array(r, "secondary_controllers", ctrls);
+
+	json_stream_out(r);
+}
+
 static void json_id_domain_list(struct nvme_id_domain_list *id_dom)
 {
 	struct json_object *r = json_create_object();
@@ -4199,33 +5292,597 @@ static struct json_object *json_list_item_obj(nvme_ns_t n)
 	return r;
 }
 
+/* Fabrics hosts can see thousands of namespaces, the lists are streamed */
 static void json_simple_list(nvme_root_t t)
 {
-	struct json_object *r = json_create_object();
-	struct json_object *jdevices = json_create_array();
+	struct json_stream js;
 
 	nvme_host_t h;
 	nvme_subsystem_t s;
 	nvme_ctrl_t c;
 	nvme_ns_t n;
 
+	json_stream_begin(&js);
+	json_stream_open_object(&js, NULL);
+	json_stream_open_array(&js, "Devices");
+
 	nvme_for_each_host(t, h) {
 		nvme_for_each_subsystem(h, s) {
 			nvme_subsystem_for_each_ns(s, n)
-				array_add_obj(jdevices, json_list_item_obj(n));
+				json_stream_add(&js, NULL, json_list_item_obj(n));
 
 			nvme_subsystem_for_each_ctrl(s, c) {
 				nvme_ctrl_for_each_ns(c, n)
-					array_add_obj(jdevices, json_list_item_obj(n));
+					json_stream_add(&js, NULL, json_list_item_obj(n));
+			}
+		}
+	}
+
+	json_stream_close(&js);
+	json_stream_close(&js);
+	json_stream_end(&js);
+}
+
+static void json_list_fast(struct nvme_list_fast_ns *ns, int nr_ns)
+{
+	char devname[NAME_LEN];
+	struct json_stream js;
+	int i;
+
+	json_stream_begin(&js);
+	json_stream_open_object(&js, NULL);
+	json_stream_open_array(&js, "Devices");
+
+	for (i = 0; i < nr_ns; i++) {
+		struct json_object *jns;
+
+		if (ns[i].err)
+			continue;
+
+		jns = json_create_object();
+		snprintf(devname, sizeof(devname), "/dev/%s", ns[i].name);
+		obj_add_int(jns, "NameSpace", ns[i].nsid);
+		obj_add_str(jns, "DevicePath", devname);
+		obj_add_str(jns, "GenericPath", ns[i].generic);
+		obj_add_str(jns, "Firmware", ns[i].firmware);
+		obj_add_str(jns, "ModelNumber", ns[i].model);
+		obj_add_str(jns, "SerialNumber", ns[i].serial);
+		obj_add_uint64(jns, "PhysicalSize", ns[i].size);
+		obj_add_int(jns, "SectorSize", ns[i].lba_size);
+		json_stream_add(&js, NULL, jns);
+	}
+
+	json_stream_close(&js);
+	json_stream_close(&js);
+	json_stream_end(&js);
+}
+
+/* One compact object per line, so the events can be consumed as a stream */
+static void json_watch_event(enum nvme_watch_action action,
+			     struct nvme_watch_obj *obj)
+{
+	struct json_object *r = json_create_object();
+	int i;
+
+	obj_add_str(r, "action", nvme_watch_action_to_string(action));
+	obj_add_str(r, "type", nvme_watch_type_to_string(obj->type));
+	obj_add_str(r, "name", obj->name);
+	for (i = 0; action != NVME_WATCH_REMOVE && i < obj->nr_attrs; i++)
+		obj_add_str(r, obj->keys[i], obj->vals[i]);
+
+	json_stream_record(r);
+}
+
+static void json_aen_event(const struct nvme_watch_aen *aen)
+{
+	struct json_object *r = json_create_object();
+	char result[16];
+
+	sprintf(result, "%#010x", aen->result);
+	obj_add_str(r, "event", "aen");
+	obj_add_str(r, "name", aen->ctrl);
+	obj_add_str(r, "type", nvme_watch_aen_type_to_string(aen->type));
+	obj_add_uint(r, "info", aen->info);
+	obj_add_str(r, "description", nvme_watch_aen_info_to_string(aen->type, aen->info));
+	obj_add_uint(r, "log_page", aen->lid);
+	obj_add_str(r, "result", result);
+
+	json_stream_record(r);
+}
+
+static void json_smart_sample(struct nvme_smart_sample *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	obj_add_uint(r, "nsid", s->nsid);
+	obj_add_uint64(r, "interval_ns", s->interval_ns);
+	json_object_add_value_double(r, "read_gbps", s->read_rate / 1e9);
+	json_object_add_value_double(r, "write_gbps", s->write_rate / 1e9);
+	json_object_add_value_double(r, "read_cmds_per_sec", s->read_cmds);
+	json_object_add_value_double(r, "write_cmds_per_sec", s->write_cmds);
+	json_object_add_value_double(r, "busy_ratio", s->busy);
+	obj_add_int(r, "temperature", s->temperature);
+	obj_add_int(r, "temperature_delta", s->temperature_delta);
+	obj_add_uint64(r, "media_errors", s->media_errors);
+	obj_add_uint64(r, "num_err_log_entries", s->err_log_entries);
+	obj_add_uint(r, "critical_warning", s->critical_warning);
+	obj_add_uint(r, "avail_spare", s->avail_spare);
+	obj_add_uint(r, "percent_used", s->percent_used);
+
+	json_stream_record(r);
+}
+
+static void json_thermal_sample(struct nvme_thermal_sample *s)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *sensors = json_create_array();
+	int i;
+
+	obj_add_str(r, "device", s->name);
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	obj_add_uint64(r, "interval_ns", s->interval_ns);
+	obj_add_int(r, "temperature", s->temperature);
+	for (i = 0; i < ARRAY_SIZE(s->sensors); i++)
+		array_add_obj(sensors, json_object_new_int(s->sensors[i]));
+	obj_add_array(r, "sensors", sensors);
+	obj_add_uint(r, "tmt1_transitions", s->tmt1_trans);
+	obj_add_uint(r, "tmt2_transitions", s->tmt2_trans);
+	obj_add_uint(r, "tmt1_time", s->tmt1_time);
+	obj_add_uint(r, "tmt2_time", s->tmt2_time);
+	obj_add_uint(r, "critical_warning", s->critical_warning);
+	obj_add_int(r, "throttled", s->throttled);
+
+	json_stream_record(r);
+}
+
+static void json_thermal_episode(struct nvme_thermal_episode *e)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", e->name);
+	obj_add_str(r, "event", "throttling");
+	obj_add_uint64(r, "start_ms", e->start_ms);
+	obj_add_uint64(r, "duration_ns", e->duration_ns);
+	obj_add_uint(r, "samples", e->samples);
+	obj_add_int(r, "max_temperature", e->max_temperature);
+	obj_add_uint(r, "tmt1_transitions", e->tmt1_trans);
+	obj_add_uint(r, "tmt2_transitions", e->tmt2_trans);
+	obj_add_uint(r, "tmt1_time", e->tmt1_time);
+	obj_add_uint(r, "tmt2_time", e->tmt2_time);
+	obj_add_int(r, "ongoing", e->ongoing);
+
+	json_stream_record(r);
+}
+
+static void json_thermal_summary(struct nvme_thermal_summary *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", s->name);
+	obj_add_uint64(r, "samples", s->samples);
+	obj_add_uint64(r, "elapsed_ns", s->elapsed_ns);
+	obj_add_uint64(r, "max_gap_ns", s->max_gap_ns);
+	obj_add_int(r, "min_temperature", s->min_temperature);
+	obj_add_int(r, "max_temperature", s->max_temperature);
+	obj_add_uint(r, "episodes", s->episodes);
+	obj_add_uint(r, "tmt1_transitions", s->tmt1_trans);
+	obj_add_uint(r, "tmt2_transitions", s->tmt2_trans);
+	obj_add_uint(r, "tmt1_time", s->tmt1_time);
+	obj_add_uint(r, "tmt2_time", s->tmt2_time);
+
+	json_print(r);
+}
+
+static void json_power_bench(struct nvme_power_bench *pb)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *runs = json_create_array();
+	struct nvme_power_bench_run *p;
+	struct json_object *run;
+	int i;
+
+	obj_add_str(r, "device", pb->name);
+	obj_add_uint(r, "runtime", pb->runtime);
+	obj_add_uint(r, "queue_depth", pb->queue_depth);
+
+	for (i = 0; i < pb->nr; i++) {
+		p = &pb->runs[i];
+		run = json_create_object();
+		if (p->ps < 0) {
+			obj_add_str(run, "power_state", "apst");
+		} else {
+			obj_add_int(run, "power_state", p->ps);
+			obj_add_uint(run, "max_power_uw", p->max_power_uw);
+			obj_add_uint(run, "entry_lat", p->enlat);
+			obj_add_uint(run, "exit_lat", p->exlat);
+		}
+		if (p->nops) {
+			obj_add_int(run, "non-operational_state", 1);
+		} else if (p->err < 0) {
+			obj_add_str(run, "error", nvme_strerror(-p->err));
+		} else if (p->err) {
+			obj_add_int(run, "status", p->err);
+		} else {
+			obj_add_uint64(run, "iops", p->iops);
+			obj_add_uint64(run, "bytes_per_sec", p->bytes_per_sec);
+			obj_add_uint64(run, "p50_ns", p->p50_ns);
+			obj_add_uint64(run, "p99_ns", p->p99_ns);
+			if (p->ps >= 0 && p->max_power_uw)
+				json_object_add_value_double(run, "iops_per_watt",
+							     p->iops * 1e6 / p->max_power_uw);
+		}
+		array_add_obj(runs, run);
+	}
+	obj_add_array(r, "runs", runs);
+
+	json_print(r);
+}
+
+static void json_tune_sweep(struct nvme_tune_sweep *ts)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *points = json_create_array();
+	struct nvme_tune_point *p;
+	struct json_object *pt;
+	int i;
+
+	obj_add_str(r, "device", ts->name);
+	obj_add_uint(r, "runtime", ts->runtime);
+	obj_add_uint(r, "queue_depth", ts->queue_depth);
+
+	for (i = 0; i < ts->nr; i++) {
+		p = &ts->points[i];
+		pt = json_create_object();
+		obj_add_uint(pt, "aggregation_time_us", p->agg_time * 100);
+		obj_add_uint(pt, "aggregation_threshold", p->agg_thr + 1);
+		obj_add_uint(pt, "arbitration_burst", p->burst);
+		obj_add_uint(pt, "low_priority_weight", p->lpw);
+		obj_add_uint(pt, "medium_priority_weight", p->mpw);
+		obj_add_uint(pt, "high_priority_weight", p->hpw);
+		if (p->err < 0) {
+			obj_add_str(pt, "error", nvme_strerror(-p->err));
+		} else if (p->err) {
+			obj_add_int(pt, "status", p->err);
+		} else {
+			obj_add_uint64(pt, "iops", p->iops);
+			obj_add_uint64(pt, "cpu_ns_per_io", p->cpu_ns);
+			obj_add_uint64(pt, "p99_ns", p->p99_ns);
+			obj_add_int(pt, "pareto", p->pareto);
+			obj_add_int(pt, "chosen", i == ts->chosen);
+		}
+		array_add_obj(points, pt);
+	}
+	obj_add_array(r, "points", points);
+	obj_add_int(r, "saved", ts->saved);
+
+	json_print(r);
+}
+
+static void json_flush_bench(struct nvme_flush_bench *fb)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *runs = json_create_array();
+	struct nvme_flush_bench_run *p;
+	struct json_object *run;
+	int i;
+
+	obj_add_str(r, "device", fb->name);
+	obj_add_uint(r, "runtime", fb->runtime);
+	obj_add_uint(r, "queue_depth", fb->queue_depth);
+	obj_add_int(r, "vwc_present", fb->vwc_present);
+	obj_add_int(r, "vwc_toggled", fb->toggled);
+
+	for (i = 0; i < fb->nr; i++) {
+		p = &fb->runs[i];
+		run = json_create_object();
+		obj_add_int(run, "vwc", p->vwc);
+		obj_add_str(run, "mode", p->fua ? "fua" : p->ratio ? "flush" : "write");
+		if (p->ratio)
+			obj_add_uint(run, "writes_per_flush", p->ratio);
+		if (p->err < 0) {
+			obj_add_str(run, "error", nvme_strerror(-p->err));
+		} else if (p->err) {
+			obj_add_int(run, "status", p->err);
+		} else {
+			obj_add_uint64(run, "iops", p->iops);
+			obj_add_uint64(run, "bytes_per_sec", p->bytes_per_sec);
+			obj_add_uint64(run, "p50_ns", p->p50_ns);
+			obj_add_uint64(run, "p99_ns", p->p99_ns);
+			json_object_add_value_double(run, "throughput_cost", p->cost);
+			if (p->flushes) {
+				obj_add_uint64(run, "flushes", p->flushes);
+				obj_add_uint64(run, "flush_p50_ns", p->flush_p50_ns);
+				obj_add_uint64(run, "flush_p99_ns", p->flush_p99_ns);
+				obj_add_uint64(run, "flush_p999_ns", p->flush_p999_ns);
+			}
+		}
+		array_add_obj(runs, run);
+	}
+	obj_add_array(r, "runs", runs);
+
+	json_print(r);
+}
+
+static void json_pmr_bench(struct nvme_pmr_bench *pb)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", pb->name);
+	obj_add_uint(r, "bir", pb->bir);
+	obj_add_uint64(r, "pmr_size", pb->bar_size);
+	obj_add_uint64(r, "offset", pb->offset);
+	obj_add_uint64(r, "size", pb->size);
+	obj_add_uint(r, "passes", pb->passes);
+	obj_add_str(r, "mapping", pb->wc ? "write_combining" : "uncached");
+	obj_add_int(r, "enabled", pb->enabled);
+	obj_add_uint64(r, "load_bytes_per_sec", pb->load_bps);
+	obj_add_uint64(r, "store_bytes_per_sec", pb->store_bps);
+	obj_add_uint64(r, "store_nt_bytes_per_sec", pb->nt_bps);
+	obj_add_int(r, "non_temporal", pb->nt_native);
+	if (pb->barrier) {
+		obj_add_str(r, "write_barrier", pb->barrier);
+		obj_add_uint(r, "persist_size", pb->persist_size);
+		obj_add_uint64(r, "persists", pb->persists);
+		obj_add_uint64(r, "persist_p50_ns", pb->persist_p50_ns);
+		obj_add_uint64(r, "persist_p99_ns", pb->persist_p99_ns);
+		obj_add_uint64(r, "persist_p999_ns", pb->persist_p999_ns);
+		obj_add_uint64(r, "persist_max_ns", pb->persist_max_ns);
+	}
+
+	json_print(r);
+}
+
+static void json_io_bench_sample(struct nvme_io_bench_sample *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", s->name);
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	obj_add_uint64(r, "interval_ns", s->interval_ns);
+	obj_add_uint64(r, "iops", (uint64_t)s->iops);
+	obj_add_uint64(r, "bytes_per_sec", (uint64_t)s->bytes_per_sec);
+	obj_add_uint64(r, "errors", s->errors);
+
+	json_stream_record(r);
+}
+
+static void json_io_bench_multi(struct nvme_io_bench_multi *m)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devs = json_create_array();
+	int i;
+
+	for (i = 0; i < m->nr_devs; i++)
+		array_add_obj(devs, json_io_stats_obj(m->names[i], &m->stats[i]));
+	obj_add_array(r, "devices", devs);
+	obj_add_obj(r, "total", json_io_stats_obj("all", m->total));
+
+	json_print(r);
+}
+
+static void json_dsm_bench(struct nvme_dsm_bench *b)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *regions = json_create_array();
+	struct nvme_dsm_bench_region *p;
+	struct json_object *region;
+	int i;
+
+	obj_add_str(r, "device", b->name);
+	obj_add_uint(r, "nsid", b->nsid);
+	obj_add_uint(r, "runtime", b->runtime);
+	obj_add_uint(r, "queue_depth", b->queue_depth);
+	obj_add_int(r, "per_command", b->per_command);
+	if (b->media)
+		obj_add_str(r, "media_writes", b->media);
+
+	for (i = 0; i < b->nr; i++) {
+		p = &b->regions[i];
+		region = json_create_object();
+		obj_add_uint(region, "cattr", p->cattr);
+		obj_add_uint(region, "write_pct", p->write_pct);
+		obj_add_uint(region, "random_pct", p->random_pct);
+		obj_add_uint64(region, "slba", p->slba);
+		obj_add_uint64(region, "nlb", p->nr_lbas);
+		if (p->tag_err < 0)
+			obj_add_str(region, "tag_error", nvme_strerror(-p->tag_err));
+		else if (p->tag_err)
+			obj_add_int(region, "tag_status", p->tag_err);
+		obj_add_int(region, "done", p->done);
+		if (p->err < 0) {
+			obj_add_str(region, "error", nvme_strerror(-p->err));
+		} else if (p->err) {
+			obj_add_int(region, "status", p->err);
+		} else if (p->done) {
+			obj_add_uint64(region, "iops", p->iops);
+			obj_add_uint64(region, "bytes_per_sec", p->bytes_per_sec);
+			obj_add_uint64(region, "reads", p->reads);
+			obj_add_uint64(region, "writes", p->writes);
+			obj_add_uint64(region, "read_p50_ns", p->read_p50_ns);
+			obj_add_uint64(region, "read_p99_ns", p->read_p99_ns);
+			obj_add_uint64(region, "read_p999_ns", p->read_p999_ns);
+			obj_add_uint64(region, "write_p50_ns", p->write_p50_ns);
+			obj_add_uint64(region, "write_p99_ns", p->write_p99_ns);
+			obj_add_uint64(region, "write_p999_ns", p->write_p999_ns);
+			if (b->media && !p->media_err) {
+				obj_add_uint64(region, "host_bytes", p->host_bytes);
+				obj_add_uint64(region, "media_bytes", p->media_bytes);
+				json_object_add_value_double(region, "waf", p->waf);
 			}
 		}
+		array_add_obj(regions, region);
 	}
+	obj_add_array(r, "regions", regions);
+
+	json_print(r);
+}
+
+static struct json_object *json_cw_bench_dev(struct nvme_cw_bench_dev *d)
+{
+	struct json_object *r = json_create_object();
 
-	obj_add_array(r, "Devices", jdevices);
+	obj_add_str(r, "device", d->name);
+	if (d->err) {
+		obj_add_str(r, "error", nvme_strerror(-d->err));
+		return r;
+	}
+	obj_add_uint64(r, "pairs", d->pairs);
+	obj_add_uint64(r, "pairs_per_sec", d->pairs_per_sec);
+	obj_add_uint64(r, "acquired", d->acquired);
+	obj_add_uint64(r, "contended", d->contended);
+	obj_add_uint64(r, "released", d->released);
+	obj_add_uint64(r, "lost", d->lost);
+	obj_add_uint64(r, "errors", d->errors);
+	obj_add_uint64(r, "held", d->held);
+	obj_add_uint64(r, "p50_ns", d->p50_ns);
+	obj_add_uint64(r, "p99_ns", d->p99_ns);
+	obj_add_uint64(r, "p999_ns", d->p999_ns);
+
+	return r;
+}
+
+static void json_cw_bench(struct nvme_cw_bench *b)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *devs = json_create_array();
+	int i;
+
+	obj_add_uint(r, "runtime", b->runtime);
+	obj_add_uint(r, "queue_depth", b->queue_depth);
+	obj_add_uint(r, "threads", b->threads);
+	obj_add_uint64(r, "locks", b->locks);
+
+	for (i = 0; i < b->nr_devs; i++)
+		array_add_obj(devs, json_cw_bench_dev(&b->devs[i]));
+	obj_add_array(r, "devices", devs);
+	obj_add_obj(r, "total", json_cw_bench_dev(b->total));
 
 	json_print(r);
 }
 
+static void json_plm_event(struct nvme_plm_event *e)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", e->name);
+	obj_add_uint64(r, "timestamp_ms", e->timestamp_ms);
+	obj_add_uint(r, "replica", e->replica);
+	obj_add_uint(r, "nvmset_id", e->nvmset_id);
+	obj_add_str(r, "window", e->window == 2 ? "ndwin" : "dtwin");
+	obj_add_int(r, "forced", e->forced);
+	if (e->forced) {
+		obj_add_uint(r, "event_type", e->event_type);
+		obj_add_int(r, "overlap", e->overlap);
+	}
+	if (e->err)
+		obj_add_int(r, "error", e->err);
+
+	json_stream_record(r);
+}
+
+static void json_plm_summary(struct nvme_plm_summary *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_str(r, "device", s->name);
+	obj_add_uint(r, "replica", s->replica);
+	obj_add_uint(r, "nvmsets", s->nvmsets);
+	obj_add_uint64(r, "elapsed_ns", s->elapsed_ns);
+	obj_add_uint64(r, "ndwin_ns", s->ndwin_ns);
+	obj_add_uint(r, "ndwins", s->ndwins);
+	obj_add_uint(r, "forced", s->forced);
+	obj_add_uint(r, "overlaps", s->overlaps);
+	obj_add_uint(r, "errors", s->errors);
+
+	json_print(r);
+}
+
+static void json_mi_poll_sample(struct nvme_mi_poll_sample *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	obj_add_str(r, "device", s->name);
+	obj_add_uint(r, "nss", s->nss);
+	obj_add_uint(r, "sw", s->sw);
+	obj_add_int(r, "ctemp", s->ctemp);
+	obj_add_uint(r, "pdlu", s->pdlu);
+	obj_add_uint(r, "ccs", s->ccs);
+	obj_add_uint64(r, "hsp_ns", s->hsp_ns);
+	if (s->smart) {
+		obj_add_uint(r, "critical_warning", s->critical_warning);
+		obj_add_int(r, "temperature", s->temperature);
+		obj_add_uint(r, "avail_spare", s->avail_spare);
+		obj_add_uint(r, "percent_used", s->percent_used);
+		obj_add_uint64(r, "smart_log_ns", s->smart_ns);
+	}
+
+	json_stream_record(r);
+}
+
+static void json_reg_sample(struct nvme_reg_sample *s)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *regs = json_create_array();
+	struct json_object *reg, *values, *value;
+	struct nvme_reg_sample_reg *g;
+	int i, j;
+
+	obj_add_str(r, "device", s->name);
+	obj_add_uint64(r, "samples", s->samples);
+	obj_add_uint64(r, "elapsed_ns", s->elapsed_ns);
+	obj_add_uint64(r, "max_gap_ns", s->max_gap_ns);
+
+	for (i = 0; i < s->nr_regs; i++) {
+		g = &s->regs[i];
+		reg = json_create_object();
+		values = json_create_array();
+		obj_add_str(reg, "name", nvme_register_symbol_to_string(g->offset));
+		obj_add_uint(reg, "offset", g->offset);
+		obj_add_uint(reg, "first", g->first);
+		obj_add_uint(reg, "last", g->last);
+		obj_add_uint64(reg, "transitions", g->transitions);
+		if (g->transitions)
+			obj_add_uint64(reg, "first_change_ns", g->first_change_ns);
+		for (j = 0; j < g->nr_values; j++) {
+			value = json_create_object();
+			obj_add_uint(value, "value", g->values[j].value);
+			obj_add_uint64(value, "entered", g->values[j].entered);
+			obj_add_uint64(value, "dwell_ns", g->values[j].dwell_ns);
+			array_add_obj(values, value);
+		}
+		obj_add_array(reg, "values", values);
+		if (g->overflow)
+			obj_add_int(reg, "values_overflow", 1);
+		array_add_obj(regs, reg);
+	}
+	obj_add_array(r, "registers", regs);
+
+	json_print(r);
+}
+
+static void json_fdp_sample(struct nvme_fdp_sample *s)
+{
+	struct json_object *r = json_create_object();
+
+	obj_add_uint64(r, "timestamp_ms", s->timestamp_ms);
+	obj_add_uint(r, "endgid", s->egid);
+	obj_add_uint64(r, "interval_ns", s->interval_ns);
+	obj_add_uint64(r, "hbmw", s->hbmw);
+	obj_add_uint64(r, "mbmw", s->mbmw);
+	obj_add_uint64(r, "mbe", s->mbe);
+	obj_add_uint64(r, "host_bytes_per_sec", (uint64_t)s->host_rate);
+	obj_add_uint64(r, "media_bytes_per_sec", (uint64_t)s->media_rate);
+	obj_add_uint64(r, "erased_bytes_per_sec", (uint64_t)s->erase_rate);
+	json_object_add_value_double(r, "waf", s->waf);
+	obj_add_int(r, "ruh_unused", s->ruh_unused);
+	obj_add_int(r, "ruh_host", s->ruh_host);
+	obj_add_int(r, "ruh_ctrl", s->ruh_ctrl);
+
+	json_stream_record(r);
+}
+
 static void json_list_item(nvme_ns_t n)
 {
 	struct json_object *r = json_list_item_obj(n);
@@ -4241,6 +5898,32 @@ static void json_print_list_items(nvme_root_t t)
 		json_simple_list(t);
 }
 
+/* the counters of the namespace or path block device at @dir, show-topology --stats */
+static void json_topology_stats(struct json_object *o, const char *dir, bool path)
+{
+	struct json_object *stats;
+	struct sysfs_blk_stat st;
+	unsigned long long qd;
+
+	if (!(json_print_ops.flags & STATS) || !dir || sysfs_read_blk_stat(dir, &st))
+		return;
+
+	stats = json_create_object();
+	obj_add_uint64(stats, "read_ios", st.read_ios);
+	obj_add_uint64(stats, "read_sectors", st.read_sectors);
+	obj_add_uint64(stats, "read_ticks_ms", st.read_ticks);
+	obj_add_uint64(stats, "write_ios", st.write_ios);
+	obj_add_uint64(stats, "write_sectors", st.write_sectors);
+	obj_add_uint64(stats, "write_ticks_ms", st.write_ticks);
+	obj_add_uint64(stats, "in_flight", st.in_flight);
+	obj_add_uint64(stats, "io_ticks_ms", st.io_ticks);
+	obj_add_uint64(stats, "time_in_queue_ms", st.time_in_queue);
+	/* the outstanding commands the queue-depth iopolicy balances on */
+	if (path && !sysfs_read_u64(dir, "queue_depth", &qd))
+		obj_add_uint64(stats, "queue_depth", qd);
+	obj_add_obj(o, "Stats", stats);
+}
+
 static unsigned int json_subsystem_topology_multipath(nvme_subsystem_t s,
 						      json_object *namespaces)
 {
@@ -4254,6 +5937,7 @@ static unsigned int json_subsystem_topology_multipath(nvme_subsystem_t s,
 
 		ns_attrs = json_create_object();
 		obj_add_int(ns_attrs, "NSID", nvme_ns_get_nsid(n));
+		json_topology_stats(ns_attrs, nvme_ns_get_sysfs_dir(n), false);
 
 		paths = json_create_array();
 		nvme_namespace_for_each_path(n, p) {
@@ -4267,6 +5951,7 @@ static unsigned int json_subsystem_topology_multipath(nvme_subsystem_t s,
 			obj_add_str(path_attrs, "Address", nvme_ctrl_get_address(c));
 			obj_add_str(path_attrs, "State", nvme_ctrl_get_state(c));
 			obj_add_str(path_attrs, "ANAState", nvme_path_get_ana_state(p));
+			json_topology_stats(path_attrs, nvme_path_get_sysfs_dir(p), true);
 			array_add_obj(paths, path_attrs);
 		}
 		obj_add_array(ns_attrs, "Paths", paths);
@@ -4291,6 +5976,7 @@ static void json_print_nvme_subsystem_topology(nvme_subsystem_t s,
 
 			ns_attrs = json_create_object();
 			obj_add_int(ns_attrs, "NSID", nvme_ns_get_nsid(n));
+			json_topology_stats(ns_attrs, nvme_ns_get_sysfs_dir(n), false);
 
 			ctrl = json_create_array();
 			ctrl_attrs = json_create_object();
@@ -4510,7 +6196,7 @@ static void json_discovery_log(struct nvmf_discovery_log *log, int numrec)
 		array_add_obj(entries, entry);
 	}
 
-	json_print(r);
+	json_stream_out(r);
 }
 
 static void json_connect_msg(nvme_ctrl_t c)
@@ -4640,6 +6326,11 @@ static void json_output_perror(const char *msg)
 	free(error);
 }
 
+void json_show_capture(struct json_object **o)
+{
+	json_capture = o;
+}
+
 void json_show_init(void)
 {
 	json_r = json_create_object();
@@ -4656,8 +6347,16 @@ void json_show_finish(void)
 static struct print_ops json_print_ops = {
 	/* libnvme types.h print functions */
 	.ana_log			= json_ana_log,
+	.ana_transition			= json_ana_transition,
 	.boot_part_log			= json_boot_part_log,
 	.phy_rx_eom_log			= json_phy_rx_eom_log,
+	.collect			= json_collect,
+	.fw_rollout			= json_fw_rollout,
+	.self_test_run			= json_self_test_run,
+	.sanitize_run			= json_sanitize_run,
+	.format_run			= json_format_run,
+	.provision_ns			= json_provision_ns,
+	.virt_provision			= json_virt_provision,
 	.ctrl_list			= json_nvme_list_ctrl,
 	.ctrl_registers			= json_ctrl_registers,
 	.ctrl_register			= json_ctrl_register,
@@ -4667,9 +6366,11 @@ static struct print_ops json_print_ops = {
 	.endurance_group_event_agg_log	= json_endurance_group_event_agg_log,
 	.endurance_group_list		= json_nvme_endurance_group_list,
 	.endurance_log			= json_endurance_log,
+	.endurance_log_batch		= json_endurance_log_batch,
 	.error_log			= json_error_log,
 	.fdp_config_log			= json_nvme_fdp_configs,
 	.fdp_event_log			= json_nvme_fdp_events,
+	.fdp_event			= json_fdp_event,
 	.fdp_ruh_status			= json_nvme_fdp_ruh_status,
 	.fdp_stats_log			= json_nvme_fdp_stats,
 	.fdp_usage_log			= json_nvme_fdp_usage,
@@ -4682,9 +6383,37 @@ static struct print_ops json_print_ops = {
 	.id_iocs			= json_id_iocs,
 	.id_ns				= json_nvme_id_ns,
 	.id_ns_descs			= json_nvme_id_ns_descs,
+	.id_ns_all			= json_id_ns_all,
+	.id_ns_descs_all		= json_id_ns_descs_all,
 	.id_ns_granularity_list		= json_nvme_id_ns_granularity_list,
 	.id_nvmset_list			= json_nvme_id_nvmset,
 	.id_uuid_list			= json_nvme_id_uuid_list,
+	.io_stats			= json_io_stats,
+	.hash_compare			= json_hash_compare,
+	.io_sweep			= json_io_sweep,
+	.path_probe			= json_path_probe,
+	.queue_advice			= json_queue_advice,
+	.fdp_write			= json_fdp_write,
+	.fdp_sample			= json_fdp_sample,
+	.smart_sample			= json_smart_sample,
+	.thermal_sample			= json_thermal_sample,
+	.thermal_episode		= json_thermal_episode,
+	.thermal_summary		= json_thermal_summary,
+	.plm_event			= json_plm_event,
+	.plm_summary			= json_plm_summary,
+	.power_bench			= json_power_bench,
+	.tune_sweep			= json_tune_sweep,
+	.flush_bench			= json_flush_bench,
+	.pmr_bench			= json_pmr_bench,
+	.io_bench_sample		= json_io_bench_sample,
+	.io_bench_multi			= json_io_bench_multi,
+	.dsm_bench			= json_dsm_bench,
+	.cw_bench			= json_cw_bench,
+	.mi_poll_sample			= json_mi_poll_sample,
+	.reg_sample			= json_reg_sample,
+	.latency_hist			= json_latency_hist,
+	.lat_sample			= json_lat_sample,
+	.replay				= json_replay,
 	.lba_status			= json_lba_status,
 	.lba_status_log			= json_lba_status_log,
 	.media_unit_stat_log		= json_media_unit_stat_log,
@@ -4693,17 +6422,24 @@ static struct print_ops json_print_ops = {
 	.ns_list_log			= json_changed_ns_list_log,
 	.nvm_id_ns			= json_nvme_nvm_id_ns,
 	.persistent_event_log		= json_persistent_event_log,
+	.persistent_event		= json_persistent_event,
 	.predictable_latency_event_agg_log = json_predictable_latency_event_agg_log,
 	.predictable_latency_per_nvmset	= json_predictable_latency_per_nvmset,
+	.predictable_latency_nvmset_batch = json_predictable_latency_nvmset_batch,
 	.primary_ctrl_cap		= json_nvme_primary_ctrl_cap,
 	.resv_notification_log		= json_resv_notif_log,
 	.resv_report			= json_nvme_resv_report,
+	.resv_table			= json_resv_table,
+	.smart_ns_table			= json_smart_ns_table,
+	.resv_batch			= json_resv_batch,
 	.sanitize_log_page		= json_sanitize_log,
 	.secondary_ctrl_list		= json_nvme_list_secondary_ctrl,
 	.select_result			= json_select_result,
 	.self_test_log			= json_self_test_log,
 	.single_property		= json_single_property,
 	.smart_log			= json_smart_log,
+	.streams			= json_streams,
+	.cap_layout			= json_cap_layout,
 	.supported_cap_config_list_log	= json_supported_cap_config_log,
 	.supported_log_pages		= json_support_log,
 	.zns_start_zone_list		= json_zns_start_zone_list,
@@ -4712,6 +6448,7 @@ static struct print_ops json_print_ops = {
 	.zns_id_ctrl			= json_nvme_zns_id_ctrl,
 	.zns_id_ns			= json_nvme_zns_id_ns,
 	.zns_report_zones		= json_nvme_zns_report_zones,
+	.zns_zone_summary		= json_zns_zone_summary,
 	.show_feature			= json_feature_show,
 	.show_feature_fields		= json_feature_show_fields,
 	.id_ctrl_rpmbs			= json_id_ctrl_rpmbs,
@@ -4724,6 +6461,9 @@ static struct print_ops json_print_ops = {
 	/* libnvme tree print functions */
 	.list_item			= json_list_item,
 	.list_items			= json_print_list_items,
+	.list_fast			= json_list_fast,
+	.watch_event			= json_watch_event,
+	.aen_event			= json_aen_event,
 	.print_nvme_subsystem_list	= json_print_nvme_subsystem_list,
 	.topology_ctrl			= json_simple_topology,
 	.topology_namespace		= json_simple_topology,
@@ -4734,6 +6474,8 @@ static struct print_ops json_print_ops = {
 	.show_perror			= json_output_perror,
 	.show_status			= json_output_status,
 	.show_error_status		= json_output_error_status,
+
+	.arena				= true,
 };
 
 struct print_ops *nvme_get_json_print_ops(enum nvme_print_flags flags)
@@ -17,6 +17,8 @@
 #include "nvme-print.h"
 #include "nvme-models.h"
 #include "util/suffix.h"
+#include "util/sysfs.h"
+#include "util/table.h"
 #include "util/types.h"
 #include "common.h"
 
@@ -165,6 +167,8 @@ static void stdout_feature_show_fields(enum nvme_features_id fid,
 static void stdout_smart_log(struct nvme_smart_log *smart,
 			     unsigned int nsid,
 			     const char *devname);
+static void stdout_error_log(struct nvme_error_log_page *err_log, int entries,
+			     const char *devname);
 
 static void stdout_predictable_latency_per_nvmset(
 		struct nvme_nvmset_predictable_lat_log *plpns_log,
@@ -195,6 +199,26 @@ static void stdout_predictable_latency_per_nvmset(
 		le64_to_cpu(plpns_log->dtwin_te));
 }
 
+static void stdout_log_batch_err(const char *what, struct nvme_log_batch_entry *e,
+				 const char *devname)
+{
+	printf("%s %u of %s: %s\n", what, e->id, devname, e->err < 0 ?
+	       nvme_strerror(-e->err) : nvme_status_to_string(e->err, false));
+}
+
+static void stdout_predictable_latency_nvmset_batch(struct nvme_log_batch_entry *e,
+						    int nr, const char *devname)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (e[i].err)
+			stdout_log_batch_err("NVM Set", &e[i], devname);
+		else
+			stdout_predictable_latency_per_nvmset(e[i].log, e[i].id, devname);
+	}
+}
+
 static void stdout_predictable_latency_event_agg_log(
 		struct nvme_aggregate_predictable_lat_event *pea_log,
 		__u64 log_entries, __u32 size, const char *devname)
@@ -248,11 +272,11 @@ static void stdout_add_bitmap(int i, __u8 seb)
 	}
 }
 
-static void stdout_persistent_event_log(void *pevent_log_info,
-					__u8 action, __u32 size,
-					const char *devname)
+/* the event at @offset of @pevent_log_info, numbered @i */
+static void stdout_pevent_entry(void *pevent_log_info, __u32 offset, __u32 i,
+				const char *devname, int human)
 {
-	__u32 offset, por_info_len, por_info_list;
+	__u32 por_info_len, por_info_list;
 	__u64 *fw_rev;
 	int fid, cdw11, dword_cnt;
 	unsigned char *mem_buf = NULL;
@@ -268,8 +292,193 @@ static void stdout_persistent_event_log(void *pevent_log_info,
 	struct nvme_sanitize_compln_event *sanitize_cmpln_event;
 	struct nvme_set_feature_event *set_feat_event;
 	struct nvme_thermal_exc_event *thermal_exc_event;
+	struct nvme_persistent_event_entry *pevent_entry_head = pevent_log_info + offset;
+
+	printf("Event Number: %u\n", i);
+	printf("Event Type: %s\n", nvme_pel_event_to_string(pevent_entry_head->etype));
+	printf("Event Type Revision: %u\n", pevent_entry_head->etype_rev);
+	printf("Event Header Length: %u\n", pevent_entry_head->ehl);
+	printf("Event Header Additional Info: %u\n", pevent_entry_head->ehai);
+	if (human)
+		stdout_persistent_event_entry_ehai(pevent_entry_head->ehai);
+	printf("Controller Identifier: %u\n",
+		le16_to_cpu(pevent_entry_head->cntlid));
+	printf("Event Timestamp: %"PRIu64"\n",
+		le64_to_cpu(pevent_entry_head->ets));
+	printf("Port Identifier: %u\n",
+		le16_to_cpu(pevent_entry_head->pelpid));
+	printf("Vendor Specific Information Length: %u\n",
+		le16_to_cpu(pevent_entry_head->vsil));
+	printf("Event Length: %u\n", le16_to_cpu(pevent_entry_head->el));
+
+	offset += pevent_entry_head->ehl + 3;
+
+	switch (pevent_entry_head->etype) {
+	case NVME_PEL_SMART_HEALTH_EVENT:
+		smart_event = pevent_log_info + offset;
+		printf("Smart Health Event Entry:\n");
+		stdout_smart_log(smart_event, NVME_NSID_ALL, devname);
+		break;
+	case NVME_PEL_FW_COMMIT_EVENT:
+		fw_commit_event = pevent_log_info + offset;
+		printf("FW Commit Event Entry:\n");
+		printf("Old Firmware Revision: %"PRIu64" (%s)\n",
+			le64_to_cpu(fw_commit_event->old_fw_rev),
+			util_fw_to_string((char *)&fw_commit_event->old_fw_rev));
+		printf("New Firmware Revision: %"PRIu64" (%s)\n",
+			le64_to_cpu(fw_commit_event->new_fw_rev),
+			util_fw_to_string((char *)&fw_commit_event->new_fw_rev));
+		printf("FW Commit Action: %u\n",
+			fw_commit_event->fw_commit_action);
+		printf("FW Slot: %u\n", fw_commit_event->fw_slot);
+		printf("Status Code Type for Firmware Commit Command: %u\n",
+			fw_commit_event->sct_fw);
+		printf("Status Returned for Firmware Commit Command: %u\n",
+			fw_commit_event->sc_fw);
+		printf("Vendor Assigned Firmware Commit Result Code: %u\n",
+			le16_to_cpu(fw_commit_event->vndr_assign_fw_commit_rc));
+		break;
+	case NVME_PEL_TIMESTAMP_EVENT:
+		ts_change_event = pevent_log_info + offset;
+		printf("Time Stamp Change Event Entry:\n");
+		printf("Previous Timestamp: %"PRIu64"\n",
+			le64_to_cpu(ts_change_event->previous_timestamp));
+		printf("Milliseconds Since Reset: %"PRIu64"\n",
+			le64_to_cpu(ts_change_event->ml_secs_since_reset));
+		break;
+	case NVME_PEL_POWER_ON_RESET_EVENT:
+		por_info_len = (le16_to_cpu(pevent_entry_head->el) -
+			le16_to_cpu(pevent_entry_head->vsil) - sizeof(*fw_rev));
+
+		por_info_list = por_info_len / sizeof(*por_event);
+
+		printf("Power On Reset Event Entry:\n");
+		fw_rev = pevent_log_info + offset;
+		printf("Firmware Revision: %"PRIu64" (%s)\n", le64_to_cpu(*fw_rev),
+			util_fw_to_string((char *)fw_rev));
+		printf("Reset Information List:\n");
+
+		for (int i = 0; i < por_info_list; i++) {
+			por_event = pevent_log_info + offset +
+				sizeof(*fw_rev) + i * sizeof(*por_event);
+			printf("Controller ID: %u\n", le16_to_cpu(por_event->cid));
+			printf("Firmware Activation: %u\n",
+				por_event->fw_act);
+			printf("Operation in Progress: %u\n",
+				por_event->op_in_prog);
+			printf("Controller Power Cycle: %u\n",
+				le32_to_cpu(por_event->ctrl_power_cycle));
+			printf("Power on milliseconds: %"PRIu64"\n",
+				le64_to_cpu(por_event->power_on_ml_seconds));
+			printf("Controller Timestamp: %"PRIu64"\n",
+				le64_to_cpu(por_event->ctrl_time_stamp));
+		}
+		break;
+	case NVME_PEL_NSS_HW_ERROR_EVENT:
+		nss_hw_err_event = pevent_log_info + offset;
+		printf("NVM Subsystem Hardware Error Event Code Entry: %u, %s\n",
+			le16_to_cpu(nss_hw_err_event->nss_hw_err_event_code),
+			nvme_nss_hw_error_to_string(nss_hw_err_event->nss_hw_err_event_code));
+		break;
+	case NVME_PEL_CHANGE_NS_EVENT:
+		ns_event = pevent_log_info + offset;
+		printf("Change Namespace Event Entry:\n");
+		printf("Namespace Management CDW10: %u\n",
+			le32_to_cpu(ns_event->nsmgt_cdw10));
+		printf("Namespace Size: %"PRIu64"\n",
+			le64_to_cpu(ns_event->nsze));
+		printf("Namespace Capacity: %"PRIu64"\n",
+			le64_to_cpu(ns_event->nscap));
+		printf("Formatted LBA Size: %u\n", ns_event->flbas);
+		printf("End-to-end Data Protection Type Settings: %u\n",
+			ns_event->dps);
+		printf("Namespace Multi-path I/O and Namespace Sharing" \
+			" Capabilities: %u\n", ns_event->nmic);
+		printf("ANA Group Identifier: %u\n",
+			le32_to_cpu(ns_event->ana_grp_id));
+		printf("NVM Set Identifier: %u\n", le16_to_cpu(ns_event->nvmset_id));
+		printf("Namespace ID: %u\n", le32_to_cpu(ns_event->nsid));
+		break;
+	case NVME_PEL_FORMAT_START_EVENT:
+		format_start_event = pevent_log_info + offset;
+		printf("Format NVM Start Event Entry:\n");
+		printf("Namespace Identifier: %u\n",
+			le32_to_cpu(format_start_event->nsid));
+		printf("Format NVM Attributes: %u\n",
+			format_start_event->fna);
+		printf("Format NVM CDW10: %u\n",
+			le32_to_cpu(format_start_event->format_nvm_cdw10));
+		break;
+	case NVME_PEL_FORMAT_COMPLETION_EVENT:
+		format_cmpln_event = pevent_log_info + offset;
+		printf("Format NVM Completion Event Entry:\n");
+		printf("Namespace Identifier: %u\n",
+			le32_to_cpu(format_cmpln_event->nsid));
+		printf("Smallest Format Progress Indicator: %u\n",
+			format_cmpln_event->smallest_fpi);
+		printf("Format NVM Status: %u\n",
+			format_cmpln_event->format_nvm_status);
+		printf("Completion Information: %u\n",
+			le16_to_cpu(format_cmpln_event->compln_info));
+		printf("Status Field: %u\n",
+			le32_to_cpu(format_cmpln_event->status_field));
+		break;
+	case NVME_PEL_SANITIZE_START_EVENT:
+		sanitize_start_event = pevent_log_info + offset;
+		printf("Sanitize Start Event Entry:\n");
+		printf("SANICAP: %u\n", sanitize_start_event->sani_cap);
+		printf("Sanitize CDW10: %u\n",
+			le32_to_cpu(sanitize_start_event->sani_cdw10));
+		printf("Sanitize CDW11: %u\n",
+			le32_to_cpu(sanitize_start_event->sani_cdw11));
+		break;
+	case NVME_PEL_SANITIZE_COMPLETION_EVENT:
+		sanitize_cmpln_event = pevent_log_info + offset;
+		printf("Sanitize Completion Event Entry:\n");
+		printf("Sanitize Progress: %u\n",
+			le16_to_cpu(sanitize_cmpln_event->sani_prog));
+		printf("Sanitize Status: %u\n",
+			le16_to_cpu(sanitize_cmpln_event->sani_status));
+		printf("Completion Information: %u\n",
+			le16_to_cpu(sanitize_cmpln_event->cmpln_info));
+		break;
+	case NVME_PEL_SET_FEATURE_EVENT:
+		set_feat_event = pevent_log_info + offset;
+		printf("Set Feature Event Entry:\n");
+		dword_cnt = NVME_SET_FEAT_EVENT_DW_COUNT(set_feat_event->layout);
+		fid = NVME_GET(le32_to_cpu(set_feat_event->cdw_mem[0]), FEATURES_CDW10_FID);
+		cdw11 = le32_to_cpu(set_feat_event->cdw_mem[1]);
+
+		printf("Set Feature ID  :%#02x (%s),  value:%#08x\n", fid,
+			nvme_feature_to_string(fid), cdw11);
+		if (NVME_SET_FEAT_EVENT_MB_COUNT(set_feat_event->layout)) {
+			mem_buf = (unsigned char *)(set_feat_event + 4 + dword_cnt * 4);
+			stdout_feature_show_fields(fid, cdw11, mem_buf);
+		}
+		break;
+	case NVME_PEL_TELEMETRY_CRT:
+		d(pevent_log_info + offset, 512, 16, 1);
+		break;
+	case NVME_PEL_THERMAL_EXCURSION_EVENT:
+		thermal_exc_event = pevent_log_info + offset;
+		printf("Thermal Excursion Event Entry:\n");
+		printf("Over Temperature: %u\n", thermal_exc_event->over_temp);
+		printf("Threshold: %u\n", thermal_exc_event->threshold);
+		break;
+	default:
+		printf("Reserved Event\n\n");
+		break;
+	}
+}
+
+static void stdout_persistent_event_log(void *pevent_log_info,
+					__u8 action, __u32 size,
+					const char *devname)
+{
 	struct nvme_persistent_event_log *pevent_log_head;
 	struct nvme_persistent_event_entry *pevent_entry_head;
+	char num[NVME_UINT128_STR_LEN];
+	__u32 offset;
 
 	int human = stdout_print_ops.flags & VERBOSE;
 
@@ -289,7 +498,7 @@ static void stdout_persistent_event_log(void *pevent_log_info,
 		printf("Timestamp: %"PRIu64"\n",
 			le64_to_cpu(pevent_log_head->ts));
 		printf("Power On Hours (POH): %s",
-			uint128_t_to_l10n_string(le128_to_cpu(pevent_log_head->poh)));
+			uint128_t_to_l10n_str(le128_to_cpu(pevent_log_head->poh), num));
 		printf("Power Cycle Count: %"PRIu64"\n",
 			le64_to_cpu(pevent_log_head->pcc));
 		printf("PCI Vendor ID (VID): %u\n",
@@ -332,186 +541,20 @@ static void stdout_persistent_event_log(void *pevent_log_info,
 		if ((offset + pevent_entry_head->ehl + 3 +
 			le16_to_cpu(pevent_entry_head->el)) >= size)
 			break;
-		printf("Event Number: %u\n", i);
-		printf("Event Type: %s\n", nvme_pel_event_to_string(pevent_entry_head->etype));
-		printf("Event Type Revision: %u\n", pevent_entry_head->etype_rev);
-		printf("Event Header Length: %u\n", pevent_entry_head->ehl);
-		printf("Event Header Additional Info: %u\n", pevent_entry_head->ehai);
-		if (human)
-			stdout_persistent_event_entry_ehai(pevent_entry_head->ehai);
-		printf("Controller Identifier: %u\n",
-			le16_to_cpu(pevent_entry_head->cntlid));
-		printf("Event Timestamp: %"PRIu64"\n",
-			le64_to_cpu(pevent_entry_head->ets));
-		printf("Port Identifier: %u\n",
-			le16_to_cpu(pevent_entry_head->pelpid));
-		printf("Vendor Specific Information Length: %u\n",
-			le16_to_cpu(pevent_entry_head->vsil));
-		printf("Event Length: %u\n", le16_to_cpu(pevent_entry_head->el));
-
-		offset += pevent_entry_head->ehl + 3;
-
-		switch (pevent_entry_head->etype) {
-		case NVME_PEL_SMART_HEALTH_EVENT:
-			smart_event = pevent_log_info + offset;
-			printf("Smart Health Event Entry:\n");
-			stdout_smart_log(smart_event, NVME_NSID_ALL, devname);
-			break;
-		case NVME_PEL_FW_COMMIT_EVENT:
-			fw_commit_event = pevent_log_info + offset;
-			printf("FW Commit Event Entry:\n");
-			printf("Old Firmware Revision: %"PRIu64" (%s)\n",
-				le64_to_cpu(fw_commit_event->old_fw_rev),
-				util_fw_to_string((char *)&fw_commit_event->old_fw_rev));
-			printf("New Firmware Revision: %"PRIu64" (%s)\n",
-				le64_to_cpu(fw_commit_event->new_fw_rev),
-				util_fw_to_string((char *)&fw_commit_event->new_fw_rev));
-			printf("FW Commit Action: %u\n",
-				fw_commit_event->fw_commit_action);
-			printf("FW Slot: %u\n", fw_commit_event->fw_slot);
-			printf("Status Code Type for Firmware Commit Command: %u\n",
-				fw_commit_event->sct_fw);
-			printf("Status Returned for Firmware Commit Command: %u\n",
-				fw_commit_event->sc_fw);
-			printf("Vendor Assigned Firmware Commit Result Code: %u\n",
-				le16_to_cpu(fw_commit_event->vndr_assign_fw_commit_rc));
-			break;
-		case NVME_PEL_TIMESTAMP_EVENT:
-			ts_change_event = pevent_log_info + offset;
-			printf("Time Stamp Change Event Entry:\n");
-			printf("Previous Timestamp: %"PRIu64"\n",
-				le64_to_cpu(ts_change_event->previous_timestamp));
-			printf("Milliseconds Since Reset: %"PRIu64"\n",
-				le64_to_cpu(ts_change_event->ml_secs_since_reset));
-			break;
-		case NVME_PEL_POWER_ON_RESET_EVENT:
-			por_info_len = (le16_to_cpu(pevent_entry_head->el) -
-				le16_to_cpu(pevent_entry_head->vsil) - sizeof(*fw_rev));
-
-			por_info_list = por_info_len / sizeof(*por_event);
-
-			printf("Power On Reset Event Entry:\n");
-			fw_rev = pevent_log_info + offset;
-			printf("Firmware Revision: %"PRIu64" (%s)\n", le64_to_cpu(*fw_rev),
-				util_fw_to_string((char *)fw_rev));
-			printf("Reset Information List:\n");
-
-			for (int i = 0; i < por_info_list; i++) {
-				por_event = pevent_log_info + offset +
-					sizeof(*fw_rev) + i * sizeof(*por_event);
-				printf("Controller ID: %u\n", le16_to_cpu(por_event->cid));
-				printf("Firmware Activation: %u\n",
-					por_event->fw_act);
-				printf("Operation in Progress: %u\n",
-					por_event->op_in_prog);
-				printf("Controller Power Cycle: %u\n",
-					le32_to_cpu(por_event->ctrl_power_cycle));
-				printf("Power on milliseconds: %"PRIu64"\n",
-					le64_to_cpu(por_event->power_on_ml_seconds));
-				printf("Controller Timestamp: %"PRIu64"\n",
-					le64_to_cpu(por_event->ctrl_time_stamp));
-			}
-			break;
-		case NVME_PEL_NSS_HW_ERROR_EVENT:
-			nss_hw_err_event = pevent_log_info + offset;
-			printf("NVM Subsystem Hardware Error Event Code Entry: %u, %s\n",
-				le16_to_cpu(nss_hw_err_event->nss_hw_err_event_code),
-				nvme_nss_hw_error_to_string(nss_hw_err_event->nss_hw_err_event_code));
-			break;
-		case NVME_PEL_CHANGE_NS_EVENT:
-			ns_event = pevent_log_info + offset;
-			printf("Change Namespace Event Entry:\n");
-			printf("Namespace Management CDW10: %u\n",
-				le32_to_cpu(ns_event->nsmgt_cdw10));
-			printf("Namespace Size: %"PRIu64"\n",
-				le64_to_cpu(ns_event->nsze));
-			printf("Namespace Capacity: %"PRIu64"\n",
-				le64_to_cpu(ns_event->nscap));
-			printf("Formatted LBA Size: %u\n", ns_event->flbas);
-			printf("End-to-end Data Protection Type Settings: %u\n",
-				ns_event->dps);
-			printf("Namespace Multi-path I/O and Namespace Sharing" \
-				" Capabilities: %u\n", ns_event->nmic);
-			printf("ANA Group Identifier: %u\n",
-				le32_to_cpu(ns_event->ana_grp_id));
-			printf("NVM Set Identifier: %u\n", le16_to_cpu(ns_event->nvmset_id));
-			printf("Namespace ID: %u\n", le32_to_cpu(ns_event->nsid));
-			break;
-		case NVME_PEL_FORMAT_START_EVENT:
-			format_start_event = pevent_log_info + offset;
-			printf("Format NVM Start Event Entry:\n");
-			printf("Namespace Identifier: %u\n",
-				le32_to_cpu(format_start_event->nsid));
-			printf("Format NVM Attributes: %u\n",
-				format_start_event->fna);
-			printf("Format NVM CDW10: %u\n",
-				le32_to_cpu(format_start_event->format_nvm_cdw10));
-			break;
-		case NVME_PEL_FORMAT_COMPLETION_EVENT:
-			format_cmpln_event = pevent_log_info + offset;
-			printf("Format NVM Completion Event Entry:\n");
-			printf("Namespace Identifier: %u\n",
-				le32_to_cpu(format_cmpln_event->nsid));
-			printf("Smallest Format Progress Indicator: %u\n",
-				format_cmpln_event->smallest_fpi);
-			printf("Format NVM Status: %u\n",
-				format_cmpln_event->format_nvm_status);
-			printf("Completion Information: %u\n",
-				le16_to_cpu(format_cmpln_event->compln_info));
-			printf("Status Field: %u\n",
-				le32_to_cpu(format_cmpln_event->status_field));
-			break;
-		case NVME_PEL_SANITIZE_START_EVENT:
-			sanitize_start_event = pevent_log_info + offset;
-			printf("Sanitize Start Event Entry:\n");
-			printf("SANICAP: %u\n", sanitize_start_event->sani_cap);
-			printf("Sanitize CDW10: %u\n",
-				le32_to_cpu(sanitize_start_event->sani_cdw10));
-			printf("Sanitize CDW11: %u\n",
-				le32_to_cpu(sanitize_start_event->sani_cdw11));
-			break;
-		case NVME_PEL_SANITIZE_COMPLETION_EVENT:
-			sanitize_cmpln_event = pevent_log_info + offset;
-			printf("Sanitize Completion Event Entry:\n");
-			printf("Sanitize Progress: %u\n",
-				le16_to_cpu(sanitize_cmpln_event->sani_prog));
-			printf("Sanitize Status: %u\n",
-				le16_to_cpu(sanitize_cmpln_event->sani_status));
-			printf("Completion Information: %u\n",
-				le16_to_cpu(sanitize_cmpln_event->cmpln_info));
-			break;
-		case NVME_PEL_SET_FEATURE_EVENT:
-			set_feat_event = pevent_log_info + offset;
-			printf("Set Feature Event Entry:\n");
-			dword_cnt = NVME_SET_FEAT_EVENT_DW_COUNT(set_feat_event->layout);
-			fid = NVME_GET(le32_to_cpu(set_feat_event->cdw_mem[0]), FEATURES_CDW10_FID);
-			cdw11 = le32_to_cpu(set_feat_event->cdw_mem[1]);
-
-			printf("Set Feature ID  :%#02x (%s),  value:%#08x\n", fid,
-				nvme_feature_to_string(fid), cdw11);
-			if (NVME_SET_FEAT_EVENT_MB_COUNT(set_feat_event->layout)) {
-				mem_buf = (unsigned char *)(set_feat_event + 4 + dword_cnt * 4);
-				stdout_feature_show_fields(fid, cdw11, mem_buf);
-			}
-			break;
-		case NVME_PEL_TELEMETRY_CRT:
-			d(pevent_log_info + offset, 512, 16, 1);
-			break;
-		case NVME_PEL_THERMAL_EXCURSION_EVENT:
-			thermal_exc_event = pevent_log_info + offset;
-			printf("Thermal Excursion Event Entry:\n");
-			printf("Over Temperature: %u\n", thermal_exc_event->over_temp);
-			printf("Threshold: %u\n", thermal_exc_event->threshold);
-			break;
-		default:
-			printf("Reserved Event\n\n");
-			break;
-		}
-		offset += le16_to_cpu(pevent_entry_head->el);
+		stdout_pevent_entry(pevent_log_info, offset, i, devname, human);
+		offset += pevent_entry_head->ehl + 3 + le16_to_cpu(pevent_entry_head->el);
 		printf("\n");
 	}
 }
 
+static void stdout_persistent_event(void *pevent_log_info, __u32 offset,
+				    __u32 event_number, const char *devname)
+{
+	stdout_pevent_entry(pevent_log_info, offset, event_number, devname,
+			    stdout_print_ops.flags & VERBOSE);
+	printf("\n");
+}
+
 static void stdout_endurance_group_event_agg_log(
 		struct nvme_aggregate_predictable_lat_event *endurance_log,
 		__u64 log_entries, __u32 size, const char *devname)
@@ -881,61 +924,74 @@ static void stdout_fdp_usage(struct nvme_fdp_ruhu_log *log, size_t len)
 
 static void stdout_fdp_stats(struct nvme_fdp_stats_log *log)
 {
+	char num[NVME_UINT128_STR_LEN];
+
 	printf("Host Bytes with Metadata Written (HBMW): %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(log->hbmw)));
+		uint128_t_to_l10n_str(le128_to_cpu(log->hbmw), num));
 	printf("Media Bytes with Metadata Written (MBMW): %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(log->mbmw)));
+		uint128_t_to_l10n_str(le128_to_cpu(log->mbmw), num));
 	printf("Media Bytes Erased (MBE): %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(log->mbe)));
+		uint128_t_to_l10n_str(le128_to_cpu(log->mbe), num));
 }
 
-static void stdout_fdp_events(struct nvme_fdp_events_log *log)
+static void stdout_fdp_event_fields(struct nvme_fdp_event *event)
 {
 	struct tm *tm;
 	char buffer[320];
 	time_t ts;
-	uint32_t n = le32_to_cpu(log->n);
 
-	for (unsigned int i = 0; i < n; i++) {
-		struct nvme_fdp_event *event = &log->events[i];
+	ts = int48_to_long(event->ts.timestamp) / 1000;
+	tm = localtime(&ts);
 
-		ts = int48_to_long(event->ts.timestamp) / 1000;
-		tm = localtime(&ts);
+	printf("  Event Type: %#"PRIx8" (%s)\n", event->type,
+	       nvme_fdp_event_to_string(event->type));
+	printf("  Event Timestamp: %"PRIu64" (%s)\n", int48_to_long(event->ts.timestamp),
+		strftime(buffer, sizeof(buffer), "%c %Z", tm) ? buffer : "-");
 
-		printf("Event[%u]\n", i);
-		printf("  Event Type: %#"PRIx8" (%s)\n", event->type,
-		       nvme_fdp_event_to_string(event->type));
-		printf("  Event Timestamp: %"PRIu64" (%s)\n", int48_to_long(event->ts.timestamp),
-			strftime(buffer, sizeof(buffer), "%c %Z", tm) ? buffer : "-");
+	if (event->flags & NVME_FDP_EVENT_F_PIV)
+		printf("  Placement Identifier (PID): %#"PRIx16"\n",
+		       le16_to_cpu(event->pid));
 
-		if (event->flags & NVME_FDP_EVENT_F_PIV)
-			printf("  Placement Identifier (PID): %#"PRIx16"\n",
-			       le16_to_cpu(event->pid));
+	if (event->flags & NVME_FDP_EVENT_F_NSIDV)
+		printf("  Namespace Identifier (NSID): %"PRIu32"\n", le32_to_cpu(event->nsid));
 
-		if (event->flags & NVME_FDP_EVENT_F_NSIDV)
-			printf("  Namespace Identifier (NSID): %"PRIu32"\n", le32_to_cpu(event->nsid));
+	if (event->type == NVME_FDP_EVENT_REALLOC) {
+		struct nvme_fdp_event_realloc *mr;
 
-		if (event->type == NVME_FDP_EVENT_REALLOC) {
-			struct nvme_fdp_event_realloc *mr;
+		mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
 
-			mr = (struct nvme_fdp_event_realloc *)&event->type_specific;
+		printf("  Number of LBAs Moved (NLBAM): %"PRIu16"\n", le16_to_cpu(mr->nlbam));
 
-			printf("  Number of LBAs Moved (NLBAM): %"PRIu16"\n", le16_to_cpu(mr->nlbam));
+		if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
+			printf("  Logical Block Address (LBA): %#"PRIx64"\n",
+			       le64_to_cpu(mr->lba));
+	}
 
-			if (mr->flags & NVME_FDP_EVENT_REALLOC_F_LBAV)
-				printf("  Logical Block Address (LBA): %#"PRIx64"\n",
-				       le64_to_cpu(mr->lba));
-		}
+	if (event->flags & NVME_FDP_EVENT_F_LV) {
+		printf("  Reclaim Group Identifier: %"PRIu16"\n", le16_to_cpu(event->rgid));
+		printf("  Reclaim Unit Handle Identifier %"PRIu8"\n", event->ruhid);
+	}
 
-		if (event->flags & NVME_FDP_EVENT_F_LV) {
-			printf("  Reclaim Group Identifier: %"PRIu16"\n", le16_to_cpu(event->rgid));
-			printf("  Reclaim Unit Handle Identifier %"PRIu8"\n", event->ruhid);
-		}
+	printf("\n");
+}
 
-		printf("\n");
+static void stdout_fdp_events(struct nvme_fdp_events_log *log)
+{
+	uint32_t n = le32_to_cpu(log->n);
+
+	for (unsigned int i = 0; i < n; i++) {
+		printf("Event[%u]\n", i);
+		stdout_fdp_event_fields(&log->events[i]);
 	}
 }
 
+static void stdout_fdp_event(struct nvme_fdp_event *event, bool host)
+{
+	printf("%s Event\n", host ? "Host" : "Controller");
+	stdout_fdp_event_fields(event);
+	fflush(stdout);
+}
+
 static void stdout_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len)
 {
 	uint16_t nruhsd = le16_to_cpu(status->nruhsd);
@@ -958,6 +1014,7 @@ static void stdout_supported_cap_config_log(struct nvme_supported_cap_config_lis
 {
 	struct nvme_end_grp_chan_desc *chan_desc;
 	int i, j, k, l, m, sccn, egcn, egsets, egchans, chmus;
+	char num[NVME_UINT128_STR_LEN];
 
 	sccn = cap->sccn;
 	printf("Number of Supported Capacity Configurations: %u\n", sccn);
@@ -975,14 +1032,14 @@ static void stdout_supported_cap_config_log(struct nvme_supported_cap_config_lis
 			printf("Capacity Adjustment Factor: %u\n",
 				le16_to_cpu(cap->cap_config_desc[i].egcd[j].cap_adj_factor));
 			printf("Total Endurance Group Capacity: %s\n",
-				uint128_t_to_l10n_string(le128_to_cpu(
-					cap->cap_config_desc[i].egcd[j].tegcap)));
+				uint128_t_to_l10n_str(le128_to_cpu(
+					cap->cap_config_desc[i].egcd[j].tegcap), num));
 			printf("Spare Endurance Group Capacity: %s\n",
-				uint128_t_to_l10n_string(le128_to_cpu(
-					cap->cap_config_desc[i].egcd[j].segcap)));
+				uint128_t_to_l10n_str(le128_to_cpu(
+					cap->cap_config_desc[i].egcd[j].segcap), num));
 			printf("Endurance Estimate: %s\n",
-				uint128_t_to_l10n_string(le128_to_cpu(
-					cap->cap_config_desc[i].egcd[j].end_est)));
+				uint128_t_to_l10n_str(le128_to_cpu(
+					cap->cap_config_desc[i].egcd[j].end_est), num));
 			egsets = le16_to_cpu(cap->cap_config_desc[i].egcd[j].egsets);
 			printf("Number of NVM Sets: %u\n", egsets);
 			for (k = 0; k < egsets; k++)
@@ -1979,13 +2036,17 @@ static void stdout_id_ctrl_cctemp(__le16 cctemp)
 
 static void stdout_id_ctrl_tnvmcap(__u8 *tnvmcap)
 {
-	printf("[127:0] : %s\n", uint128_t_to_l10n_string(le128_to_cpu(tnvmcap)));
+	char num[NVME_UINT128_STR_LEN];
+
+	printf("[127:0] : %s\n", uint128_t_to_l10n_str(le128_to_cpu(tnvmcap), num));
 	printf("\tTotal NVM Capacity (TNVMCAP)\n\n");
 }
 
 static void stdout_id_ctrl_unvmcap(__u8 *unvmcap)
 {
-	printf("[127:0] : %s\n", uint128_t_to_l10n_string(le128_to_cpu(unvmcap)));
+	char num[NVME_UINT128_STR_LEN];
+
+	printf("[127:0] : %s\n", uint128_t_to_l10n_str(le128_to_cpu(unvmcap), num));
 	printf("\tUnallocated NVM Capacity (UNVMCAP)\n\n");
 }
 
@@ -2534,6 +2595,7 @@ static void stdout_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
 	int i;
 	__u8 flbas;
 	char *in_use = "(in use)";
+	char num[NVME_UINT128_STR_LEN];
 
 	if (!cap_only) {
 		printf("NVME Identify Namespace %d:\n", nsid);
@@ -2584,7 +2646,7 @@ static void stdout_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
 		printf("nabspf  : %d\n", le16_to_cpu(ns->nabspf));
 		printf("noiob   : %d\n", le16_to_cpu(ns->noiob));
 		printf("nvmcap  : %s\n",
-			uint128_t_to_l10n_string(le128_to_cpu(ns->nvmcap)));
+			uint128_t_to_l10n_str(le128_to_cpu(ns->nvmcap), num));
 		if (ns->nsfeat & 0x10) {
 			printf("npwg    : %u\n", le16_to_cpu(ns->npwg));
 			printf("npwa    : %u\n", le16_to_cpu(ns->npwa));
@@ -2769,6 +2831,40 @@ static void stdout_id_ns_descs(void *data, unsigned int nsid)
 	}
 }
 
+static bool stdout_id_ns_entry_err(struct nvme_id_ns_entry *e, const char *what)
+{
+	if (!e->err)
+		return false;
+
+	printf("NVME %s %u: %s\n", what, e->nsid, e->err < 0 ?
+	       nvme_strerror(-e->err) : nvme_status_to_string(e->err, false));
+	return true;
+}
+
+static void stdout_id_ns_all(struct nvme_id_ns_entry *list, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (i)
+			printf("\n");
+		if (!stdout_id_ns_entry_err(&list[i], "Identify Namespace"))
+			stdout_id_ns(list[i].data, list[i].nsid, 0, false);
+	}
+}
+
+static void stdout_id_ns_descs_all(struct nvme_id_ns_entry *list, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (i)
+			printf("\n");
+		if (!stdout_id_ns_entry_err(&list[i], "Namespace Identification Descriptors NS"))
+			stdout_id_ns_descs(list[i].data, list[i].nsid);
+	}
+}
+
 static void print_psd_workload(__u8 apw)
 {
 	switch (apw & 0x7) {
@@ -2852,6 +2948,7 @@ static void stdout_id_ctrl(struct nvme_id_ctrl *ctrl,
 			   void (*vendor_show)(__u8 *vs, struct json_object *root))
 {
 	bool human = stdout_print_ops.flags & VERBOSE, vs = stdout_print_ops.flags & VS;
+	char num[NVME_UINT128_STR_LEN];
 
 	printf("NVME Identify Controller:\n");
 	printf("vid       : %#x\n", le16_to_cpu(ctrl->vid));
@@ -2927,11 +3024,11 @@ static void stdout_id_ctrl(struct nvme_id_ctrl *ctrl,
 	printf("hmpre     : %u\n", le32_to_cpu(ctrl->hmpre));
 	printf("hmmin     : %u\n", le32_to_cpu(ctrl->hmmin));
 	printf("tnvmcap   : %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(ctrl->tnvmcap)));
+		uint128_t_to_l10n_str(le128_to_cpu(ctrl->tnvmcap), num));
 	if (human)
 		stdout_id_ctrl_tnvmcap(ctrl->tnvmcap);
 	printf("unvmcap   : %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(ctrl->unvmcap)));
+		uint128_t_to_l10n_str(le128_to_cpu(ctrl->unvmcap), num));
 	if (human)
 		stdout_id_ctrl_unvmcap(ctrl->unvmcap);
 	printf("rpmbs     : %#x\n", le32_to_cpu(ctrl->rpmbs));
@@ -2966,7 +3063,7 @@ static void stdout_id_ctrl(struct nvme_id_ctrl *ctrl,
 	printf("pels      : %u\n", le32_to_cpu(ctrl->pels));
 	printf("domainid  : %d\n", le16_to_cpu(ctrl->domainid));
 	printf("megcap    : %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(ctrl->megcap)));
+		uint128_t_to_l10n_str(le128_to_cpu(ctrl->megcap), num));
 	printf("sqes      : %#x\n", ctrl->sqes);
 	if (human)
 		stdout_id_ctrl_sqes(ctrl->sqes);
@@ -3004,7 +3101,7 @@ static void stdout_id_ctrl(struct nvme_id_ctrl *ctrl,
 		stdout_id_ctrl_sgls(ctrl->sgls);
 	printf("mnan      : %u\n", le32_to_cpu(ctrl->mnan));
 	printf("maxdna    : %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(ctrl->maxdna)));
+		uint128_t_to_l10n_str(le128_to_cpu(ctrl->maxdna), num));
 	printf("maxcna    : %u\n", le32_to_cpu(ctrl->maxcna));
 	printf("oaqd      : %u\n", le32_to_cpu(ctrl->oaqd));
 	printf("subnqn    : %-.*s\n", (int)sizeof(ctrl->subnqn), ctrl->subnqn);
@@ -3320,6 +3417,27 @@ static void stdout_zns_report_zones(void *report, __u32 descs,
 	}
 }
 
+static void stdout_zns_zone_summary(struct nvme_zone_summary *s)
+{
+	double pct;
+	int i;
+
+	printf("zone summary for namespace %u: %"PRIu64" zones, size %#"PRIx64"\n",
+	       s->nsid, (uint64_t)s->nr_zones, (uint64_t)s->zsze);
+
+	for (i = 0; i < s->nr_states; i++) {
+		pct = s->nr_zones ? 100.0 * s->states[i].zones / s->nr_zones : 0;
+		printf("  %-12s: %10"PRIu64" %5.1f%% %.*s\n",
+		       nvme_zone_state_to_string(s->states[i].state),
+		       (uint64_t)s->states[i].zones, pct, (int)(pct * 40 / 100),
+		       "########################################");
+	}
+
+	pct = s->zcap ? 100.0 * s->written / s->zcap : 0;
+	printf("  %-12s: %10"PRIu64" of %"PRIu64" LBAs, %.1f%%\n", "written",
+	       (uint64_t)s->written, (uint64_t)s->zcap, pct);
+}
+
 static void stdout_list_ctrl(struct nvme_ctrl_list *ctrl_list)
 {
 	__u16 num = le16_to_cpu(ctrl_list->num);
@@ -3334,6 +3452,7 @@ static void stdout_id_nvmset(struct nvme_id_nvmset_list *nvmset,
 			     unsigned int nvmset_id)
 {
 	int i;
+	char num[NVME_UINT128_STR_LEN];
 
 	printf("NVME Identify NVM Set List %d:\n", nvmset_id);
 	printf("nid     : %d\n", nvmset->nid);
@@ -3350,11 +3469,11 @@ static void stdout_id_nvmset(struct nvme_id_nvmset_list *nvmset,
 		printf("optimal_write_size      : %u\n",
 			le32_to_cpu(nvmset->ent[i].ows));
 		printf("total_nvmset_cap        : %s\n",
-			uint128_t_to_l10n_string(
-				le128_to_cpu(nvmset->ent[i].tnvmsetcap)));
+			uint128_t_to_l10n_str(
+				le128_to_cpu(nvmset->ent[i].tnvmsetcap), num));
 		printf("unalloc_nvmset_cap      : %s\n",
-			uint128_t_to_l10n_string(
-				le128_to_cpu(nvmset->ent[i].unvmsetcap)));
+			uint128_t_to_l10n_str(
+				le128_to_cpu(nvmset->ent[i].unvmsetcap), num));
 		printf(".................\n");
 	}
 }
@@ -3490,23 +3609,828 @@ static void stdout_id_uuid_list(const struct nvme_id_uuid_list *uuid_list)
 	}
 }
 
+static const double lat_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+static void stdout_latency_percentiles(struct nvme_hist *lat)
+{
+	int i;
+
+	printf("  latency (us): min %.1f, avg %.1f", lat->min / 1e3,
+	       nvme_hist_mean(lat) / 1e3);
+	for (i = 0; i < ARRAY_SIZE(lat_percentiles); i++)
+		printf(", p%g %.1f", lat_percentiles[i],
+		       nvme_hist_percentile(lat, lat_percentiles[i]) / 1e3);
+	printf(", max %.1f\n", lat->max / 1e3);
+}
+
+static void stdout_latency_hist(const char *name, struct nvme_hist *lat)
+{
+	printf("%s: %"PRIu64" command(s)\n", name, (uint64_t)lat->count);
+	stdout_latency_percentiles(lat);
+}
+
+static void stdout_lat_sample(struct nvme_lat_sample *s)
+{
+	struct nvme_lat_hist *h = s->hist;
+	unsigned int i;
+
+	if (s->interval_ns)
+		printf("%"PRIu64" ", (uint64_t)s->timestamp_ms);
+	printf("%s %s ios %"PRIu64, s->source, s->type, (uint64_t)nvme_lat_hist_count(h));
+	for (i = 0; i < ARRAY_SIZE(lat_percentiles); i++)
+		printf(" p%g %uus", lat_percentiles[i],
+		       nvme_lat_hist_percentile(h, lat_percentiles[i]));
+	printf(" max %uus\n", nvme_lat_hist_max(h));
+
+	/* the log as read gets its buckets listed */
+	for (i = 0; !s->interval_ns && i < h->nr_buckets; i++) {
+		struct nvme_lat_bucket *b = &h->buckets[i];
+
+		if (!b->count)
+			continue;
+		if (b->high_us == NVME_LAT_HIST_INF)
+			printf("  %4u  %10u us -        +INF  %"PRIu64"\n", i, b->low_us,
+			       (uint64_t)b->count);
+		else
+			printf("  %4u  %10u us - %10u us  %"PRIu64"\n", i, b->low_us,
+			       b->high_us, (uint64_t)b->count);
+	}
+	fflush(stdout);
+}
+
+static void stdout_replay(struct nvme_replay *replay)
+{
+	double secs = replay->elapsed_ns / 1e9;
+	int i;
+
+	printf("%s: qd %u, %s\n", replay->trace, replay->queue_depth,
+	       replay->timed ? "trace timing" : "flat out");
+	printf("  commands   : %"PRIu64"\n", (uint64_t)replay->cmds);
+	if (replay->timed)
+		printf("  late       : %"PRIu64"\n", (uint64_t)replay->late);
+	printf("  runtime    : %.3f s\n", secs);
+	if (secs > 0)
+		printf("  iops       : %.0f\n", replay->cmds / secs);
+
+	for (i = 0; i < replay->nr_ops; i++) {
+		struct nvme_replay_op *op = &replay->ops[i];
+
+		printf("%s %02x %s: %"PRIu64" command(s), %"PRIu64" bytes, %"PRIu64" error(s)",
+		       op->admin ? "admin" : "io", op->opcode,
+		       nvme_cmd_to_string(op->admin, op->opcode), (uint64_t)op->cmds,
+		       (uint64_t)op->bytes, (uint64_t)op->errors);
+		if (op->errors)
+			printf(", first %#x", op->first_err);
+		printf("\n");
+		stdout_latency_percentiles(&op->lat);
+	}
+}
+
+static void stdout_io_stats(const char *name, struct nvme_io_stats *stats)
+{
+	double secs = stats->elapsed_ns / 1e9;
+
+	printf("%s: qd %u, %u thread(s), ", name, stats->queue_depth, stats->threads);
+	if (stats->hw_queues)
+		printf("%u hw queue(s), ", stats->hw_queues);
+	printf("%s%s%s%s\n", stats->uring ? "io_uring" : "ioctl",
+	       stats->fixed_bufs ? ", fixed buffers" : "",
+	       stats->poll ? ", polled" : "",
+	       stats->cmb ? ", cmb buffers" : "");
+	printf("  ios        : %"PRIu64"\n", (uint64_t)stats->ios);
+	printf("  errors     : %"PRIu64"\n", (uint64_t)stats->errors);
+	if (stats->errors)
+		printf("  first error: %#x\n", stats->first_err);
+	printf("  runtime    : %.3f s\n", secs);
+	if (secs > 0) {
+		printf("  iops       : %.0f\n", stats->ios / secs);
+		printf("  bandwidth  : %.2f MiB/s\n", stats->bytes / secs / (1 << 20));
+	}
+	if (stats->rate_limited && stats->rate_backoffs)
+		printf("  rate limit : %"PRIu64" back-off(s), at %.0f%%\n",
+		       (uint64_t)stats->rate_backoffs, stats->rate_scale * 100);
+	stdout_latency_percentiles(&stats->lat);
+}
+
+static void stdout_hash_compare(struct nvme_hash_compare *hc)
+{
+	int i;
+
+	stdout_io_stats("compare-hash", hc->stats);
+	printf("  manifest   : %s%s\n", hc->manifest, hc->create ? " (written)" : "");
+	printf("  chunks     : %"PRIu64"\n", (uint64_t)hc->chunks);
+	if (!hc->create)
+		printf("  mismatches : %d\n", hc->nr_bad);
+
+	for (i = 0; i < hc->nr_bad; i++) {
+		struct nvme_crc_mismatch *m = &hc->bad[i];
+
+		printf("  %-11s: %"PRIu64"-%"PRIu64": ", m->status ? "failed" : "mismatch",
+		       (uint64_t)m->slba, (uint64_t)(m->slba + m->nlb - 1));
+		if (m->status < 0)
+			printf("%s\n", nvme_strerror(-m->status));
+		else if (m->status)
+			printf("%s\n", nvme_status_to_string(m->status, false));
+		else
+			printf("crc32c %08x, expected %08x\n", m->actual, m->expected);
+	}
+}
+
+static void stdout_io_sweep(struct nvme_io_sweep *sweep)
+{
+	int i;
+
+	stdout_io_stats(sweep->name, sweep->stats);
+	printf("  range      : %"PRIu64"-%"PRIu64"\n", (uint64_t)sweep->slba,
+	       (uint64_t)sweep->end - 1);
+	if (sweep->next_lba < sweep->end)
+		printf("  stopped at : %"PRIu64"\n", (uint64_t)sweep->next_lba);
+
+	for (i = 0; i < sweep->nr_errs; i++) {
+		struct nvme_lba_range_err *e = &sweep->errs[i];
+
+		printf("  failed     : %"PRIu64"-%"PRIu64": %s\n", (uint64_t)e->slba,
+		       (uint64_t)(e->slba + e->nlb - 1),
+		       e->status < 0 ? nvme_strerror(-e->status) :
+				       nvme_status_to_string(e->status, false));
+	}
+}
+
+static void stdout_path_probe(struct nvme_path_probe *probe)
+{
+	struct nvme_path_probe_path *p;
+	double secs;
+	int i;
+
+	for (i = 0; i < probe->nr_paths; i++) {
+		p = &probe->paths[i];
+		printf("%s: ns %u, %s %s %s %s %s\n", p->name, p->nsid, p->ctrl,
+		       p->transport, p->address, p->state, p->ana_state);
+		if (p->err) {
+			printf("  not probed : %s\n", nvme_strerror(-p->err));
+			continue;
+		}
+
+		secs = p->elapsed_ns / 1e9;
+		printf("  %s qd %u : %"PRIu64" command(s), %"PRIu64" error(s)", probe->mode,
+		       probe->queue_depth, (uint64_t)p->ios, (uint64_t)p->errors);
+		if (p->errors)
+			printf(", first %#x", p->first_err);
+		if (secs > 0)
+			printf(", %.0f iops", p->ios / secs);
+		printf("\n");
+		stdout_latency_percentiles(&p->lat);
+	}
+}
+
+static void stdout_queue_layout(struct nvme_queue_layout *l)
+{
+	printf("--nr-io-queues=%d --queue-size=%d", l->nr_io_queues, l->queue_size);
+	if (l->nr_write_queues)
+		printf(" --nr-write-queues=%d", l->nr_write_queues);
+	if (l->nr_poll_queues)
+		printf(" --nr-poll-queues=%d", l->nr_poll_queues);
+}
+
+static void stdout_queue_advice(struct nvme_queue_advice *advice)
+{
+	struct nvme_queue_layout *l;
+	int i;
+
+	printf("%s %s %s, ns %u, %u s per probe\n", advice->subsysnqn,
+	       advice->transport, advice->traddr, advice->nsid, advice->runtime);
+	for (i = 0; i < advice->nr_layouts; i++) {
+		l = &advice->layouts[i];
+		stdout_queue_layout(l);
+		if (l->err) {
+			printf(": not probed : %s\n", nvme_strerror(-l->err));
+			continue;
+		}
+		printf(": %s\n", l->ctrl);
+		stdout_io_stats("  read", l->read);
+		if (l->write)
+			stdout_io_stats("  write", l->write);
+	}
+
+	if (advice->best < 0) {
+		printf("no layout could be probed\n");
+		return;
+	}
+	printf("recommended: ");
+	stdout_queue_layout(&advice->layouts[advice->best]);
+	printf("%s\n", advice->saved ? " (saved)" : "");
+}
+
+static void stdout_fdp_write(struct nvme_fdp_write *fw)
+{
+	int i;
+
+	stdout_io_stats("fdp-write", fw->stats);
+	for (i = 0; i < fw->nr_ruhs; i++)
+		printf("  pid %-6u : %"PRIu64" bytes\n", fw->ruhs[i].pid,
+		       (uint64_t)fw->ruhs[i].bytes);
+	printf("  endurance group %u during the run:\n", fw->egid);
+	printf("  host written : %"PRIu64" bytes\n", (uint64_t)fw->hbmw);
+	printf("  media written: %"PRIu64" bytes\n", (uint64_t)fw->mbmw);
+	printf("  media erased : %"PRIu64" bytes\n", (uint64_t)fw->mbe);
+	if (fw->hbmw)
+		printf("  waf          : %.3f\n", (double)fw->mbmw / fw->hbmw);
+}
+
+static void stdout_fdp_sample(struct nvme_fdp_sample *s)
+{
+	printf("endgid %u: host %.2f MiB/s, media %.2f MiB/s, erased %.2f MiB/s, waf %.3f, ruhs unused %d host %d ctrl %d\n",
+	       s->egid, s->host_rate / (1 << 20), s->media_rate / (1 << 20),
+	       s->erase_rate / (1 << 20), s->waf, s->ruh_unused, s->ruh_host,
+	       s->ruh_ctrl);
+	fflush(stdout);
+}
+
+static void stdout_smart_sample(struct nvme_smart_sample *s)
+{
+	printf("nsid %#x: read %.3f GB/s %.0f cmd/s, write %.3f GB/s %.0f cmd/s, busy %.1f%%, temp %ld C (%+d), media errors %"PRIu64", warning %#x\n",
+	       s->nsid, s->read_rate / 1e9, s->read_cmds, s->write_rate / 1e9,
+	       s->write_cmds, s->busy * 100, kelvin_to_celsius(s->temperature),
+	       s->temperature_delta, (uint64_t)s->media_errors,
+	       s->critical_warning);
+	fflush(stdout);
+}
+
+static void stdout_thermal_sample(struct nvme_thermal_sample *s)
+{
+	int i;
+
+	printf("%s: temp %ld C", s->name, kelvin_to_celsius(s->temperature));
+	for (i = 0; i < ARRAY_SIZE(s->sensors); i++)
+		if (s->sensors[i])
+			printf(", sensor %d %ld C", i + 1, kelvin_to_celsius(s->sensors[i]));
+	printf(", tmt1 +%u (%u s), tmt2 +%u (%u s)%s\n",
+	       s->tmt1_trans, s->tmt1_time, s->tmt2_trans, s->tmt2_time,
+	       s->throttled ? ", throttled" : "");
+	fflush(stdout);
+}
+
+static void stdout_thermal_episode(struct nvme_thermal_episode *e)
+{
+	printf("%s: throttling %s %.3f s in %u samples, peak %ld C, tmt1 %u transitions %u s, tmt2 %u transitions %u s\n",
+	       e->name, e->ongoing ? "ongoing after" : "for", e->duration_ns / 1e9,
+	       e->samples, kelvin_to_celsius(e->max_temperature), e->tmt1_trans,
+	       e->tmt1_time, e->tmt2_trans, e->tmt2_time);
+	fflush(stdout);
+}
+
+static void stdout_thermal_summary(struct nvme_thermal_summary *s)
+{
+	printf("%s: %"PRIu64" samples in %.3f s, longest gap %.1f ms, temp %ld to %ld C\n",
+	       s->name, (uint64_t)s->samples, s->elapsed_ns / 1e9, s->max_gap_ns / 1e6,
+	       kelvin_to_celsius(s->min_temperature), kelvin_to_celsius(s->max_temperature));
+	printf("%s: %u throttling episodes, tmt1 %u transitions %u s, tmt2 %u transitions %u s\n",
+	       s->name, s->episodes, s->tmt1_trans, s->tmt1_time, s->tmt2_trans,
+	       s->tmt2_time);
+}
+
+static void stdout_power_bench(struct nvme_power_bench *pb)
+{
+	struct nvme_power_bench_run *r;
+	char ps[8];
+	int i;
+
+	printf("%s: %u s per power state at queue depth %u\n", pb->name, pb->runtime,
+	       pb->queue_depth);
+	printf("%-5s %9s %9s %9s %10s %12s %10s %10s %12s\n", "ps", "max W", "enlat us",
+	       "exlat us", "iops", "MB/s", "p50 us", "p99 us", "iops/W");
+
+	for (i = 0; i < pb->nr; i++) {
+		r = &pb->runs[i];
+		if (r->ps < 0)
+			snprintf(ps, sizeof(ps), "apst");
+		else
+			snprintf(ps, sizeof(ps), "%d", r->ps);
+
+		if (r->ps < 0)
+			printf("%-5s %9s %9s %9s", ps, "-", "-", "-");
+		else
+			printf("%-5s %9.4f %9u %9u", ps, r->max_power_uw / 1e6, r->enlat,
+			       r->exlat);
+
+		if (r->nops)
+			printf(" %10s\n", "non-operational");
+		else if (r->err > 0)
+			printf(" %s\n", nvme_status_to_string(r->err, false));
+		else if (r->err < 0)
+			printf(" %s\n", nvme_strerror(-r->err));
+		else if (r->ps < 0 || !r->max_power_uw)
+			printf(" %10"PRIu64" %12.1f %10.1f %10.1f %12s\n", (uint64_t)r->iops,
+			       r->bytes_per_sec / 1e6, r->p50_ns / 1e3, r->p99_ns / 1e3, "-");
+		else
+			printf(" %10"PRIu64" %12.1f %10.1f %10.1f %12.0f\n", (uint64_t)r->iops,
+			       r->bytes_per_sec / 1e6, r->p50_ns / 1e3, r->p99_ns / 1e3,
+			       r->iops * 1e6 / r->max_power_uw);
+	}
+}
+
+static void stdout_tune_sweep(struct nvme_tune_sweep *ts)
+{
+	struct nvme_tune_point *p;
+	int i;
+
+	printf("%s: %u s per setting at queue depth %u\n", ts->name, ts->runtime,
+	       ts->queue_depth);
+	printf("%-3s %8s %7s %5s %11s %10s %12s %10s\n", "", "time us", "thr", "burst",
+	       "weights", "iops", "cpu ns/io", "p99 us");
+
+	for (i = 0; i < ts->nr; i++) {
+		p = &ts->points[i];
+		printf("%-3s %8u %7u %5u %3u:%3u:%3u", i == ts->chosen ? "*" :
+		       p->pareto ? "+" : "", p->agg_time * 100, p->agg_thr + 1, p->burst,
+		       p->lpw, p->mpw, p->hpw);
+		if (p->err > 0)
+			printf(" %s\n", nvme_status_to_string(p->err, false));
+		else if (p->err < 0)
+			printf(" %s\n", nvme_strerror(-p->err));
+		else
+			printf(" %10"PRIu64" %12"PRIu64" %10.1f\n", (uint64_t)p->iops,
+			       (uint64_t)p->cpu_ns, p->p99_ns / 1e3);
+	}
+
+	printf("+ Pareto optimal, * chosen%s\n", ts->saved ? " and saved" : "");
+}
+
+static void stdout_flush_bench(struct nvme_flush_bench *fb)
+{
+	struct nvme_flush_bench_run *r;
+	char mode[16];
+	int i;
+
+	printf("%s: %u s per run at queue depth %u, volatile write cache %s\n", fb->name,
+	       fb->runtime, fb->queue_depth, !fb->vwc_present ? "absent" :
+	       fb->toggled ? "enabled and disabled" : "as found");
+	printf("%-4s %-10s %10s %10s %10s %7s %10s %10s %10s %11s\n", "vwc", "mode", "iops",
+	       "MB/s", "p99 us", "cost", "flushes", "fl p50 us", "fl p99 us",
+	       "fl p99.9 us");
+
+	for (i = 0; i < fb->nr; i++) {
+		r = &fb->runs[i];
+		if (r->fua)
+			snprintf(mode, sizeof(mode), "fua");
+		else if (r->ratio)
+			snprintf(mode, sizeof(mode), "flush/%u", r->ratio);
+		else
+			snprintf(mode, sizeof(mode), "write");
+
+		printf("%-4s %-10s", r->vwc ? "on" : "off", mode);
+		if (r->err > 0)
+			printf(" %s\n", nvme_status_to_string(r->err, false));
+		else if (r->err < 0)
+			printf(" %s\n", nvme_strerror(-r->err));
+		else if (!r->flushes)
+			printf(" %10"PRIu64" %10.1f %10.1f %6.1f%% %10s %10s %10s %11s\n",
+			       (uint64_t)r->iops, r->bytes_per_sec / 1e6, r->p99_ns / 1e3,
+			       r->cost * 100, "-", "-", "-", "-");
+		else
+			printf(" %10"PRIu64" %10.1f %10.1f %6.1f%% %10"PRIu64" %10.1f %10.1f %11.1f\n",
+			       (uint64_t)r->iops, r->bytes_per_sec / 1e6, r->p99_ns / 1e3,
+			       r->cost * 100, (uint64_t)r->flushes, r->flush_p50_ns / 1e3,
+			       r->flush_p99_ns / 1e3, r->flush_p999_ns / 1e3);
+	}
+}
+
+static void stdout_pmr_bench(struct nvme_pmr_bench *pb)
+{
+	printf("%s: PMR in BAR %u, %"PRIu64" bytes, %s mapping%s\n", pb->name, pb->bir,
+	       (uint64_t)pb->bar_size, pb->wc ? "write combining" : "uncached",
+	       pb->enabled ? ", enabled for the benchmark" : "");
+	printf("range %#"PRIx64" to %#"PRIx64", %u passes\n", (uint64_t)pb->offset,
+	       (uint64_t)(pb->offset + pb->size), pb->passes);
+	printf("load:     %10.1f MB/s\n", pb->load_bps / 1e6);
+	printf("store:    %10.1f MB/s\n", pb->store_bps / 1e6);
+	printf("store nt: %10.1f MB/s%s\n", pb->nt_bps / 1e6,
+	       pb->nt_native ? "" : " (no non-temporal stores, plain ones)");
+	if (!pb->barrier) {
+		printf("persist:  no write barrier mechanism advertised\n");
+		return;
+	}
+	printf("persist:  %u bytes and %s, %"PRIu64" times: p50 %.2f us, p99 %.2f us, p99.9 %.2f us, max %.2f us\n",
+	       pb->persist_size, pb->barrier, (uint64_t)pb->persists,
+	       pb->persist_p50_ns / 1e3, pb->persist_p99_ns / 1e3,
+	       pb->persist_p999_ns / 1e3, pb->persist_max_ns / 1e3);
+}
+
+static void stdout_io_bench_sample(struct nvme_io_bench_sample *s)
+{
+	printf("%s: %.0f iops, %.2f MiB/s", s->name, s->iops, s->bytes_per_sec / (1 << 20));
+	if (s->errors)
+		printf(", %"PRIu64" error(s)", (uint64_t)s->errors);
+	printf("\n");
+	fflush(stdout);
+}
+
+static void stdout_io_bench_multi(struct nvme_io_bench_multi *m)
+{
+	int i;
+
+	for (i = 0; i < m->nr_devs; i++)
+		stdout_io_stats(m->names[i], &m->stats[i]);
+	stdout_io_stats("all", m->total);
+}
+
+static void stdout_dsm_bench(struct nvme_dsm_bench *b)
+{
+	struct nvme_dsm_bench_region *r;
+	int i;
+
+	printf("%s: nsid %u, %u s per region at queue depth %u, attributes in %s, media writes %s\n",
+	       b->name, b->nsid, b->runtime, b->queue_depth,
+	       b->per_command ? "DSM ranges and commands" : "DSM ranges",
+	       b->media ? b->media : "not reported");
+	printf("%-6s %-6s %4s %4s %10s %10s %9s %9s %9s %9s %10s %6s\n", "region", "cattr",
+	       "wr%", "rnd%", "iops", "MB/s", "rd p50 us", "rd p99 us", "wr p50 us",
+	       "wr p99 us", "media MB", "waf");
+
+	for (i = 0; i < b->nr; i++) {
+		r = &b->regions[i];
+		printf("%-6d %#-6x %4u %4u", i, r->cattr, r->write_pct, r->random_pct);
+		if (!r->done)
+			printf(" not run\n");
+		else if (r->err > 0)
+			printf(" %s\n", nvme_status_to_string(r->err, false));
+		else if (r->err < 0)
+			printf(" %s\n", nvme_strerror(-r->err));
+		else if (!b->media || r->media_err)
+			printf(" %10"PRIu64" %10.1f %9.1f %9.1f %9.1f %9.1f %10s %6s\n",
+			       (uint64_t)r->iops, r->bytes_per_sec / 1e6, r->read_p50_ns / 1e3,
+			       r->read_p99_ns / 1e3, r->write_p50_ns / 1e3,
+			       r->write_p99_ns / 1e3, "-", "-");
+		else
+			printf(" %10"PRIu64" %10.1f %9.1f %9.1f %9.1f %9.1f %10.1f %6.2f\n",
+			       (uint64_t)r->iops, r->bytes_per_sec / 1e6, r->read_p50_ns / 1e3,
+			       r->read_p99_ns / 1e3, r->write_p50_ns / 1e3,
+			       r->write_p99_ns / 1e3, r->media_bytes / 1e6, r->waf);
+	}
+
+	for (i = 0; i < b->nr; i++) {
+		r = &b->regions[i];
+		if (r->tag_err)
+			printf("region %d: DSM tagging failed: %s\n", i, r->tag_err > 0 ?
+			       nvme_status_to_string(r->tag_err, false) :
+			       nvme_strerror(-r->tag_err));
+	}
+}
+
+/* @part out of @all as a percentage, 0 of nothing */
+static double stdout_pct(__u64 part, __u64 all)
+{
+	return all ? 100.0 * part / all : 0;
+}
+
+static void stdout_cw_bench_dev(struct nvme_cw_bench_dev *d)
+{
+	__u64 acquires = d->acquired + d->contended;
+
+	printf("%-12s", d->name);
+	if (d->err) {
+		printf(" %s\n", nvme_strerror(-d->err));
+		return;
+	}
+	printf(" %10"PRIu64" %11"PRIu64" %6.1f%% %6.1f%% %8"PRIu64" %8"PRIu64" %7"PRIu64" %8.1f %8.1f %10.1f\n",
+	       (uint64_t)d->pairs, (uint64_t)d->pairs_per_sec,
+	       stdout_pct(d->acquired, acquires), stdout_pct(d->contended, acquires),
+	       (uint64_t)d->lost, (uint64_t)d->errors, (uint64_t)d->held,
+	       d->p50_ns / 1e3, d->p99_ns / 1e3, d->p999_ns / 1e3);
+}
+
+static void stdout_cw_bench(struct nvme_cw_bench *b)
+{
+	int i;
+
+	printf("compare-write-bench: %"PRIu64" locks per namespace, %u s at queue depth %u, %u thread(s)\n",
+	       (uint64_t)b->locks, b->runtime, b->queue_depth, b->threads);
+	printf("%-12s %10s %11s %7s %7s %8s %8s %7s %8s %8s %10s\n", "device", "pairs",
+	       "pairs/s", "acq%", "busy%", "lost", "errors", "held", "p50 us", "p99 us",
+	       "p99.9 us");
+
+	for (i = 0; i < b->nr_devs; i++)
+		stdout_cw_bench_dev(&b->devs[i]);
+	if (b->nr_devs > 1)
+		stdout_cw_bench_dev(b->total);
+}
+
+static void stdout_plm_event(struct nvme_plm_event *e)
+{
+	const char *win = e->window == 2 ? "NDWIN" : "DTWIN";
+
+	if (e->forced)
+		printf("%s: replica %u nvmset %u: forced to %s, event type %#x%s\n",
+		       e->name, e->replica, e->nvmset_id, win, e->event_type,
+		       e->overlap ? ", overlapping another replica's NDWIN" : "");
+	else if (e->err)
+		printf("%s: replica %u nvmset %u: %s: %s\n", e->name, e->replica,
+		       e->nvmset_id, win, e->err < 0 ? nvme_strerror(-e->err) :
+		       nvme_status_to_string(e->err, false));
+	else
+		printf("%s: replica %u nvmset %u: %s\n", e->name, e->replica, e->nvmset_id,
+		       win);
+	fflush(stdout);
+}
+
+static void stdout_plm_summary(struct nvme_plm_summary *s)
+{
+	printf("%s: replica %u, %u NVM sets, %u NDWINs for %.3f of %.3f s, %u forced (%u overlapping), %u errors\n",
+	       s->name, s->replica, s->nvmsets, s->ndwins, s->ndwin_ns / 1e9,
+	       s->elapsed_ns / 1e9, s->forced, s->overlaps, s->errors);
+}
+
+static void stdout_mi_poll_sample(struct nvme_mi_poll_sample *s)
+{
+	printf("%s: nss %#x, sw %#x, ctemp %d C, pdlu %u%%, ccs %#x, hsp %.1f us",
+	       s->name, s->nss, s->sw, s->ctemp, s->pdlu, s->ccs, s->hsp_ns / 1e3);
+	if (s->smart)
+		printf("; smart: warning %#x, temp %ld C, spare %u%%, used %u%%, %.1f us",
+		       s->critical_warning, kelvin_to_celsius(s->temperature),
+		       s->avail_spare, s->percent_used, s->smart_ns / 1e3);
+	printf("\n");
+	fflush(stdout);
+}
+
+static void stdout_reg_sample(struct nvme_reg_sample *s)
+{
+	struct nvme_reg_sample_value *v;
+	struct nvme_reg_sample_reg *r;
+	int i, j;
+
+	printf("%s: %"PRIu64" samples in %.3f s, %.0f samples/s, longest gap %.1f us\n",
+	       s->name, (uint64_t)s->samples, s->elapsed_ns / 1e9,
+	       s->elapsed_ns ? s->samples * 1e9 / s->elapsed_ns : 0.0,
+	       s->max_gap_ns / 1e3);
+
+	for (i = 0; i < s->nr_regs; i++) {
+		r = &s->regs[i];
+		printf("%-8s: %#010x -> %#010x, %"PRIu64" transition(s)",
+		       nvme_register_symbol_to_string(r->offset), r->first, r->last,
+		       (uint64_t)r->transitions);
+		if (r->transitions)
+			printf(", first after %.3f ms", r->first_change_ns / 1e6);
+		printf("\n");
+		if (!r->transitions)
+			continue;
+		for (j = 0; j < r->nr_values; j++) {
+			v = &r->values[j];
+			printf("  %#010x: entered %"PRIu64" time(s), %.3f%% of the time\n",
+			       v->value, (uint64_t)v->entered,
+			       s->elapsed_ns ? v->dwell_ns * 100.0 / s->elapsed_ns : 0.0);
+		}
+		if (r->overflow)
+			printf("  more values not tracked\n");
+	}
+}
+
+static void stdout_collect(struct nvme_collect_dev *devs, int nr_devs)
+{
+	struct nvme_collect_log *log;
+	int i, j;
+
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err) {
+			printf("%s: %s\n", devs[i].path, nvme_strerror(-devs[i].err));
+			continue;
+		}
+
+		printf("%s: %d log(s) in %.1f ms\n", devs[i].name, devs[i].nr_logs,
+		       devs[i].elapsed_ns / 1e6);
+		for (j = 0; j < devs[i].nr_logs; j++) {
+			log = &devs[i].logs[j];
+			if (log->err < 0)
+				printf("  %-14s: %s\n", log->name, nvme_strerror(-log->err));
+			else if (log->err)
+				printf("  %-14s: %s\n", log->name,
+				       nvme_status_to_string(log->err, false));
+			else if (log->file)
+				printf("  %-14s: %zu bytes, %s\n", log->name, log->len, log->file);
+			else
+				printf("  %-14s: %zu bytes\n", log->name, log->len);
+		}
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		for (j = 0; j < devs[i].nr_logs; j++) {
+			log = &devs[i].logs[j];
+			if (log->err || !log->data)
+				continue;
+			if (!strcmp(log->name, "smart-log"))
+				stdout_smart_log(log->data, NVME_NSID_ALL, devs[i].name);
+			else if (!strcmp(log->name, "error-log"))
+				stdout_error_log(log->data,
+						 log->len / sizeof(struct nvme_error_log_page),
+						 devs[i].name);
+		}
+	}
+}
+
+static void stdout_fw_rollout(struct nvme_fw_rollout_dev *devs, int nr_devs)
+{
+	struct nvme_fw_rollout_dev *d;
+	int i, done = 0, skipped = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->skipped) {
+			printf("%s: skipped, revision %s is active\n", d->name, d->old_rev);
+			skipped++;
+		} else if (d->stage == NVME_FW_ROLLOUT_DONE) {
+			printf("%s: %s -> %s, download %.1f ms, commit %.1f ms (wave %d)%s\n",
+			       d->name, d->old_rev, d->new_rev, d->download_ns / 1e6,
+			       d->commit_ns / 1e6, d->wave,
+			       d->reset ? ", reset required" : "");
+			done++;
+		} else if (d->mismatch) {
+			printf("%s: verify failed, the slot holds revision '%s'\n",
+			       d->name, d->new_rev);
+		} else if (d->err < 0) {
+			printf("%s: %s failed: %s\n", d->name,
+			       nvme_fw_rollout_stage_to_string(d->stage),
+			       nvme_strerror(-d->err));
+		} else if (d->err) {
+			printf("%s: %s failed: %s\n", d->name,
+			       nvme_fw_rollout_stage_to_string(d->stage),
+			       nvme_status_to_string(d->err, false));
+		} else {
+			printf("%s: downloaded in %.1f ms, not committed\n", d->name,
+			       d->download_ns / 1e6);
+		}
+	}
+
+	printf("%d of %d device(s) updated, %d skipped\n", done, nr_devs, skipped);
+}
+
+static void stdout_self_test_run(struct nvme_self_test_dev *devs, int nr_devs)
+{
+	struct nvme_self_test_dev *d;
+	int i, passed = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->err < 0)
+			printf("%s: %s\n", d->name, nvme_strerror(-d->err));
+		else if (d->err)
+			printf("%s: %s\n", d->name, nvme_status_to_string(d->err, false));
+		else if (!d->done)
+			printf("%s: no result at %u%%\n", d->name, d->progress);
+		else if (d->result == NVME_ST_RESULT_KNOWN_SEG_FAIL)
+			printf("%s: %s in segment %u after %.0f s\n", d->name,
+			       nvme_self_test_result_to_string(d->result), d->segment,
+			       d->elapsed_ns / 1e9);
+		else
+			printf("%s: %s after %.0f s\n", d->name,
+			       nvme_self_test_result_to_string(d->result),
+			       d->elapsed_ns / 1e9);
+		if (!d->err && d->done && d->result == NVME_ST_RESULT_NO_ERR)
+			passed++;
+	}
+
+	printf("%d of %d device(s) passed\n", passed, nr_devs);
+}
+
+static void stdout_sanitize_run(struct nvme_sanitize_dev *devs, int nr_devs)
+{
+	struct nvme_sanitize_dev *d;
+	int i, passed = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->err < 0) {
+			printf("%s: %s\n", d->name, nvme_strerror(-d->err));
+		} else if (d->err) {
+			printf("%s: %s\n", d->name, nvme_status_to_string(d->err, false));
+		} else if (!d->done) {
+			printf("%s: still running at %.2f%%, eta %u s\n", d->name,
+			       d->sprog * 100.0 / 0x10000, d->eta);
+		} else {
+			printf("%s: %s after %.0f s, %u polls\n", d->name,
+			       nvme_sstat_status_to_string(d->sstat),
+			       d->elapsed_ns / 1e9, d->polls);
+			if (d->passed)
+				passed++;
+		}
+	}
+
+	printf("%d of %d device(s) sanitized\n", passed, nr_devs);
+}
+
+static void stdout_format_run(struct nvme_format_dev *devs, int nr_devs, __u64 wall_ns)
+{
+	struct nvme_format_dev *d;
+	__u64 sum_ns = 0;
+	int i, done = 0;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->err < 0) {
+			printf("%s: %s\n", d->name, nvme_strerror(-d->err));
+		} else if (d->err) {
+			printf("%s: %s\n", d->name, nvme_status_to_string(d->err, false));
+		} else {
+			printf("%s: LBA format %u -> %u in %.1f s, waited %.1f s%s\n",
+			       d->name, d->prev_lbaf, d->lbaf, d->elapsed_ns / 1e9,
+			       d->wait_ns / 1e9, d->shared ? " (all namespaces)" : "");
+			done++;
+			if (!d->shared)
+				sum_ns += d->elapsed_ns;
+		}
+	}
+
+	printf("%d of %d namespace(s) formatted in %.1f s, %.1f s one at a time\n",
+	       done, nr_devs, wall_ns / 1e9, sum_ns / 1e9);
+}
+
+static const char *status_to_string(int err)
+{
+	return err < 0 ? nvme_strerror(-err) : nvme_status_to_string(err, false);
+}
+
+static void stdout_provision_ns(struct nvme_provision *p)
+{
+	struct nvme_provision_ns *n;
+	int i, created = 0, attached = 0;
+
+	for (i = 0; i < p->nr_ns; i++) {
+		n = &p->ns[i];
+		if (p->dry_run)
+			printf("%s: namespace %d: %"PRIu64" blocks, %.2f GB\n", p->name,
+			       i + 1, (uint64_t)n->nsze,
+			       (double)n->nsze * p->lba_size / 1e9);
+		else if (!n->nsid && n->err)
+			printf("%s: namespace %d: create failed: %s\n", p->name, i + 1,
+			       status_to_string(n->err));
+		else if (n->nsid && n->err)
+			printf("%s: nsid %u: %"PRIu64" blocks, attach failed: %s\n",
+			       p->name, n->nsid, (uint64_t)n->nsze,
+			       status_to_string(n->err));
+		else if (n->nsid)
+			printf("%s: nsid %u: %"PRIu64" blocks%s\n", p->name, n->nsid,
+			       (uint64_t)n->nsze, n->attached ? ", attached" : "");
+		created += !!n->nsid;
+		attached += n->attached;
+	}
+
+	if (p->dry_run) {
+		printf("%d namespace(s) of LBA format %u, %u byte blocks, not created\n",
+		       p->nr_ns, p->flbas, p->lba_size);
+		return;
+	}
+
+	printf("%d of %d namespace(s) created, %d attached to %d controller(s) in %.1f ms\n",
+	       created, p->nr_ns, attached, p->nr_ctrls, p->elapsed_ns / 1e6);
+	if (p->rescan_err)
+		printf("%s: namespace rescan failed: %s\n", p->name,
+		       nvme_strerror(-p->rescan_err));
+}
+
+static void stdout_virt_provision(struct nvme_virt_provision *p)
+{
+	struct nvme_virt_provision_ctrl *c;
+	int i, done = 0;
+
+	for (i = 0; i < p->nr_ctrls; i++) {
+		c = &p->ctrls[i];
+		printf("%s: scid %#06x vfn %u: VQ %u -> %u, VI %u -> %u", p->name,
+		       c->scid, c->vfn, c->old_nvq, c->nvq, c->old_nvi, c->nvi);
+		if (c->err)
+			printf(", %s failed: %s\n", c->step, status_to_string(c->err));
+		else if (p->dry_run)
+			printf("\n");
+		else
+			printf(", %s\n", c->online ? "online" : "offline");
+		done += !c->err;
+	}
+
+	if (p->dry_run) {
+		printf("%d secondary controller(s) from %u VQ and %u VI flexible resources, not provisioned\n",
+		       p->nr_ctrls, p->vq_pool, p->vi_pool);
+		return;
+	}
+
+	printf("%d of %d secondary controller(s) provisioned with %d command(s) in %.1f ms\n",
+	       done, p->nr_ctrls, p->nr_cmds, p->elapsed_ns / 1e6);
+}
+
 static void stdout_id_domain_list(struct nvme_id_domain_list *id_dom)
 {
 	int i;
+	char num[NVME_UINT128_STR_LEN];
 
 	printf("Number of Domain Entries: %u\n", id_dom->num);
 	for (i = 0; i < id_dom->num; i++) {
 		printf("Domain Id for Attr Entry[%u]: %u\n", i,
 			le16_to_cpu(id_dom->domain_attr[i].dom_id));
 		printf("Domain Capacity for Attr Entry[%u]: %s\n", i,
-			uint128_t_to_l10n_string(
-				le128_to_cpu(id_dom->domain_attr[i].dom_cap)));
+			uint128_t_to_l10n_str(
+				le128_to_cpu(id_dom->domain_attr[i].dom_cap), num));
 		printf("Unallocated Domain Capacity for Attr Entry[%u]: %s\n", i,
-			uint128_t_to_l10n_string(
-				le128_to_cpu(id_dom->domain_attr[i].unalloc_dom_cap)));
+			uint128_t_to_l10n_str(
+				le128_to_cpu(id_dom->domain_attr[i].unalloc_dom_cap), num));
 		printf("Max Endurance Group Domain Capacity for Attr Entry[%u]: %s\n", i,
-			uint128_t_to_l10n_string(
-				le128_to_cpu(id_dom->domain_attr[i].max_egrp_dom_cap)));
+			uint128_t_to_l10n_str(
+				le128_to_cpu(id_dom->domain_attr[i].max_egrp_dom_cap), num));
 	}
 }
 
@@ -3627,6 +4551,156 @@ static void stdout_resv_report(struct nvme_resv_status *status, int bytes,
 	printf("\n");
 }
 
+static void stdout_resv_table(struct nvme_resv_ns *list, int nr)
+{
+	struct nvme_resv_status *s;
+	char hostid[33];
+	__u16 cntlid;
+	__u8 rcsts;
+	__u64 rkey;
+	int i, j, regctl;
+
+	printf("%-10s %-10s %-6s %-5s %-6s %-6s %-18s %s\n", "NSID", "Gen",
+	       "Type", "PTPLS", "Cntlid", "Holder", "Rkey", "Host ID");
+	for (i = 0; i < nr; i++) {
+		if (list[i].err) {
+			printf("%-10u %s\n", list[i].nsid, list[i].err < 0 ?
+			       nvme_strerror(-list[i].err) :
+			       nvme_status_to_string(list[i].err, false));
+			continue;
+		}
+
+		s = list[i].status;
+		regctl = nvme_resv_registrant(&list[i], -1, NULL, NULL, NULL, NULL, 0);
+		if (!regctl)
+			printf("%-10u %-10u %-6s %-5u %-6s\n", list[i].nsid,
+			       le32_to_cpu(s->gen), nvme_resv_type_to_string(s->rtype),
+			       s->ptpls, "-");
+		for (j = 0; j < regctl; j++) {
+			nvme_resv_registrant(&list[i], j, &cntlid, &rcsts, &rkey,
+					     hostid, sizeof(hostid));
+			printf("%-10u %-10u %-6s %-5u %#-6x %-6s %#018"PRIx64" %s\n",
+			       list[i].nsid, le32_to_cpu(s->gen),
+			       nvme_resv_type_to_string(s->rtype), s->ptpls, cntlid,
+			       rcsts & 1 ? "yes" : "no", (uint64_t)rkey, hostid);
+		}
+	}
+}
+
+static void stdout_smart_ns_table(struct nvme_smart_ns *list, int nr, const char *devname)
+{
+	char num[NVME_UINT128_STR_LEN];
+	struct nvme_smart_log *l;
+	int i;
+
+	printf("%-10s %-12s %-12s %-20s %-20s\n", "NSID", "Written", "Read",
+	       "Host Writes", "Host Reads");
+	for (i = 0; i < nr; i++) {
+		if (list[i].err) {
+			printf("%-10u %s\n", list[i].nsid, list[i].err < 0 ?
+			       nvme_strerror(-list[i].err) :
+			       nvme_status_to_string(list[i].err, false));
+			continue;
+		}
+
+		l = &list[i].log;
+		printf("%-10u %-12s ", list[i].nsid,
+		       uint128_t_to_si_string(le128_to_cpu(l->data_units_written), 1000 * 512));
+		printf("%-12s ", uint128_t_to_si_string(le128_to_cpu(l->data_units_read),
+							 1000 * 512));
+		printf("%-20s ", uint128_t_to_l10n_str(le128_to_cpu(l->host_writes), num));
+		printf("%-20s\n", uint128_t_to_l10n_str(le128_to_cpu(l->host_reads), num));
+	}
+}
+
+static void stdout_resv_batch(struct nvme_resv_batch *b)
+{
+	struct nvme_resv_batch_ns *ns;
+	int i, failed = 0;
+
+	for (i = 0; i < b->nr_ns; i++) {
+		ns = &b->ns[i];
+		if (ns->err < 0)
+			printf("nsid %u: %s\n", ns->nsid, nvme_strerror(-ns->err));
+		else if (ns->err)
+			printf("nsid %u: %s\n", ns->nsid,
+			       nvme_status_to_string(ns->err, false));
+		else
+			printf("nsid %u: %s in %.3f ms\n", ns->nsid, b->action,
+			       ns->elapsed_ns / 1e6);
+		failed += !!ns->err;
+	}
+
+	printf("%s: %s %d of %d namespace(s) in %.3f ms, %u job(s)\n", b->name,
+	       b->action, b->nr_ns - failed, b->nr_ns, b->elapsed_ns / 1e6, b->jobs);
+}
+
+static void stdout_streams(struct nvme_streams *s)
+{
+	struct nvme_streams_ns *ns;
+	int i, failed = 0;
+
+	printf("%s: MSL %u, NSSA %u, NSSO %u, SWS %u, SGS %u\n", s->name, s->msl,
+	       s->nssa, s->nsso, s->sws, s->sgs);
+
+	for (i = 0; i < s->nr_ns; i++) {
+		ns = &s->ns[i];
+		if (ns->err < 0)
+			printf("nsid %u: %s\n", ns->nsid, nvme_strerror(-ns->err));
+		else if (ns->err)
+			printf("nsid %u: %s\n", ns->nsid,
+			       nvme_status_to_string(ns->err, false));
+		else if (!strcmp(s->action, "allocate"))
+			printf("nsid %u: %u of %u stream(s) allocated\n", ns->nsid,
+			       ns->nsa, ns->requested);
+		else if (!strcmp(s->action, "release"))
+			printf("nsid %u: released\n", ns->nsid);
+		else
+			printf("nsid %u: %u stream(s) allocated, %u open\n", ns->nsid,
+			       ns->nsa, ns->nso);
+		failed += !!ns->err;
+	}
+
+	printf("%s: %s %d of %d namespace(s) in %.3f ms\n", s->name, s->action,
+	       s->nr_ns - failed, s->nr_ns, s->elapsed_ns / 1e6);
+}
+
+static void stdout_cap_layout(struct nvme_cap_layout *l)
+{
+	struct nvme_cap_layout_phase *ph;
+	struct nvme_cap_layout_op *o;
+	int i;
+
+	if (l->list_ns)
+		printf("supported configurations read in %.3f ms\n", l->list_ns / 1e6);
+
+	for (i = 0; i < l->nr_ops; i++) {
+		o = &l->ops[i];
+		if (!o->run)
+			continue;
+		printf("%s %u", nvme_cap_layout_op_to_string(o->op), o->element_id);
+		if (o->op == NVME_CAP_LAYOUT_CREATE_ENDGRP || o->op == NVME_CAP_LAYOUT_CREATE_NVMSET)
+			printf(" (%"PRIu64" bytes)", (uint64_t)o->capacity);
+		if (o->err < 0)
+			printf(": %s\n", nvme_strerror(-o->err));
+		else if (o->err)
+			printf(": %s\n", nvme_status_to_string(o->err, false));
+		else if (o->op == NVME_CAP_LAYOUT_CREATE_ENDGRP || o->op == NVME_CAP_LAYOUT_CREATE_NVMSET)
+			printf(": created %u in %.3f ms\n", o->result, o->elapsed_ns / 1e6);
+		else
+			printf(": done in %.3f ms\n", o->elapsed_ns / 1e6);
+	}
+
+	for (i = 0; i < l->nr_phases; i++) {
+		ph = &l->phases[i];
+		if (ph->nr)
+			printf("%s: %d operation(s) in %.3f ms\n", ph->name, ph->nr,
+			       ph->elapsed_ns / 1e6);
+	}
+
+	printf("%s: capacity layout in %.3f ms\n", l->name, l->elapsed_ns / 1e6);
+}
+
 static void stdout_fw_log(struct nvme_firmware_slot *fw_log,
 			  const char *devname)
 {
@@ -3805,6 +4879,8 @@ static void stdout_supported_log(struct nvme_supported_log_pages *support_log,
 static void stdout_endurance_log(struct nvme_endurance_group_log *endurance_log, __u16 group_id,
 				 const char *devname)
 {
+	char num[NVME_UINT128_STR_LEN];
+
 	printf("Endurance Group Log for NVME device:%s Group ID:%x\n", devname, group_id);
 	printf("critical_warning	: %u\n", endurance_log->critical_warning);
 	printf("endurance_group_features: %u\n", endurance_log->endurance_group_features);
@@ -3813,25 +4889,38 @@ static void stdout_endurance_log(struct nvme_endurance_group_log *endurance_log,
 	printf("percent_used		: %u%%\n", endurance_log->percent_used);
 	printf("domain_identifier	: %u\n", endurance_log->domain_identifier);
 	printf("endurance_estimate	: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->endurance_estimate)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->endurance_estimate), num));
 	printf("data_units_read		: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->data_units_read)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->data_units_read), num));
 	printf("data_units_written	: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->data_units_written)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->data_units_written), num));
 	printf("media_units_written	: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->media_units_written)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->media_units_written), num));
 	printf("host_read_cmds		: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->host_read_cmds)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->host_read_cmds), num));
 	printf("host_write_cmds		: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->host_write_cmds)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->host_write_cmds), num));
 	printf("media_data_integrity_err: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->media_data_integrity_err)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->media_data_integrity_err), num));
 	printf("num_err_info_log_entries: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->num_err_info_log_entries)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->num_err_info_log_entries), num));
 	printf("total_end_grp_cap	: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->total_end_grp_cap)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->total_end_grp_cap), num));
 	printf("unalloc_end_grp_cap	: %s\n",
-	       uint128_t_to_l10n_string(le128_to_cpu(endurance_log->unalloc_end_grp_cap)));
+	       uint128_t_to_l10n_str(le128_to_cpu(endurance_log->unalloc_end_grp_cap), num));
+}
+
+static void stdout_endurance_log_batch(struct nvme_log_batch_entry *e, int nr,
+				       const char *devname)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (e[i].err)
+			stdout_log_batch_err("Endurance Group", &e[i], devname);
+		else
+			stdout_endurance_log(e[i].log, e[i].id, devname);
+	}
 }
 
 static void stdout_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
@@ -3840,6 +4929,7 @@ static void stdout_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 	__u16 temperature = smart->temperature[1] << 8 | smart->temperature[0];
 	int i;
 	bool human = stdout_print_ops.flags & VERBOSE;
+	char num[NVME_UINT128_STR_LEN];
 
 	printf("Smart Log for NVME device:%s namespace-id:%x\n", devname, nsid);
 	printf("critical_warning			: %#x\n",
@@ -3865,29 +4955,29 @@ static void stdout_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 	printf("endurance group critical warning summary: %#x\n",
 		smart->endu_grp_crit_warn_sumry);
 	printf("Data Units Read				: %s (%s)\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->data_units_read)),
+		uint128_t_to_l10n_str(le128_to_cpu(smart->data_units_read), num),
 		uint128_t_to_si_string(le128_to_cpu(smart->data_units_read),
 				       1000 * 512));
 	printf("Data Units Written			: %s (%s)\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->data_units_written)),
+		uint128_t_to_l10n_str(le128_to_cpu(smart->data_units_written), num),
 		uint128_t_to_si_string(le128_to_cpu(smart->data_units_written),
 				       1000 * 512));
 	printf("host_read_commands			: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->host_reads)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->host_reads), num));
 	printf("host_write_commands			: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->host_writes)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->host_writes), num));
 	printf("controller_busy_time			: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->ctrl_busy_time)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->ctrl_busy_time), num));
 	printf("power_cycles				: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->power_cycles)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->power_cycles), num));
 	printf("power_on_hours				: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->power_on_hours)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->power_on_hours), num));
 	printf("unsafe_shutdowns			: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->unsafe_shutdowns)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->unsafe_shutdowns), num));
 	printf("media_errors				: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->media_errors)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->media_errors), num));
 	printf("num_err_log_entries			: %s\n",
-		uint128_t_to_l10n_string(le128_to_cpu(smart->num_err_log_entries)));
+		uint128_t_to_l10n_str(le128_to_cpu(smart->num_err_log_entries), num));
 	printf("Warning Temperature Time		: %u\n",
 		le32_to_cpu(smart->warning_temp_time));
 	printf("Critical Composite Temperature Time	: %u\n",
@@ -3949,6 +5039,21 @@ static void stdout_ana_log(struct nvme_ana_log *ana_log, const char *devname,
 	}
 }
 
+static void stdout_ana_transition(const struct nvme_ana_transition *t, const char *devname)
+{
+	__u32 i;
+
+	printf("%s: ANA group %u %s -> %s, chgcnt %"PRIu64", %u namespace(s)", devname,
+	       t->grpid, t->old_state ? nvme_ana_state_to_string(t->old_state) : "new",
+	       nvme_ana_state_to_string(t->new_state), (uint64_t)t->chgcnt, t->nr_nsids);
+	if (stdout_print_ops.flags & VERBOSE) {
+		for (i = 0; i < t->nr_nsids; i++)
+			printf("%s%u", i ? "," : ": ", t->nsids[i]);
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
 static void stdout_self_test_result(struct nvme_st_result *res)
 {
 	static const char * const test_res[] = {
@@ -4299,40 +5404,90 @@ static void stdout_lba_status_info(__u32 result)
 	printf("\tLBA Status Information Report Interval (LSIRI): %u\n", result & 0xffff);
 }
 
+#define D_BUF_SIZE	(16 * 1024)
+#define D_LINE_MAX	256	/* offset, 32 bytes as hex and ASCII, padding */
+
+static const char hex_digits[] = "0123456789abcdef";
+
+/* "%04x" of @val, wider once it exceeds 16 bits */
+static size_t d_offset(char *p, unsigned int val)
+{
+	size_t n, digits = 4;
+
+	while (digits < 2 * sizeof(val) && val >> (4 * digits))
+		digits++;
+
+	for (n = digits; n--; val >>= 4)
+		p[n] = hex_digits[val & 0xf];
+
+	return digits;
+}
+
+/*
+ * Big logs are dumped with this, so the lines are formatted into a local
+ * buffer with table lookups and written in large chunks instead of going
+ * through printf() for every byte.
+ */
 void stdout_d(unsigned char *buf, int len, int width, int group)
 {
-	int i, offset = 0;
+	static const char header[] = "     "
+		"  0  1  2  3  4  5  6  7  8  9  a  b  c  d  e  f";
+	char out[D_BUF_SIZE];
 	char ascii[32 + 1] = { 0 };
+	size_t n = sizeof(header) - 1;
+	int i, col = 0;
 
 	assert(width < sizeof(ascii));
 
-	printf("     ");
-
-	for (i = 0; i <= 15; i++)
-		printf("%3x", i);
+	memcpy(out, header, n);
 
 	for (i = 0; i < len; i++) {
-		if (!(i % width))
-			printf("\n%04x:", offset);
-		if (i % group)
-			printf("%02x", buf[i]);
-		else
-			printf(" %02x", buf[i]);
-		ascii[i % width] = (buf[i] >= '!' && buf[i] <= '~') ? buf[i] : '.';
-		if (!((i + 1) % width)) {
-			printf(" \"%.*s\"", width, ascii);
-			offset += width;
-			memset(ascii, 0, sizeof(ascii));
+		col = i % width;
+		if (!col) {
+			if (n > sizeof(out) - D_LINE_MAX) {
+				fwrite(out, 1, n, stdout);
+				n = 0;
+			}
+			out[n++] = '\n';
+			n += d_offset(out + n, i);
+			out[n++] = ':';
+		}
+		if (!(i % group))
+			out[n++] = ' ';
+		out[n++] = hex_digits[buf[i] >> 4];
+		out[n++] = hex_digits[buf[i] & 0xf];
+		ascii[col] = (buf[i] >= '!' && buf[i] <= '~') ? buf[i] : '.';
+		if (++col == width) {
+			out[n++] = ' ';
+			out[n++] = '"';
+			memcpy(out + n, ascii, width);
+			n += width;
+			out[n++] = '"';
+			col = 0;
 		}
 	}
 
-	if (strlen(ascii)) {
-		unsigned int b = width - (i % width);
+	if (n > sizeof(out) - D_LINE_MAX) {
+		fwrite(out, 1, n, stdout);
+		n = 0;
+	}
 
-		printf(" %*s \"%.*s\"", 2 * b + b / group + (b % group ? 1 : 0), "", width, ascii);
+	if (col) {
+		unsigned int b = width - col;
+		size_t pad = 2 * b + b / group + (b % group ? 1 : 0);
+
+		out[n++] = ' ';
+		memset(out + n, ' ', pad);
+		n += pad;
+		out[n++] = ' ';
+		out[n++] = '"';
+		memcpy(out + n, ascii, col);
+		n += col;
+		out[n++] = '"';
 	}
 
-	printf("\n");
+	out[n++] = '\n';
+	fwrite(out, 1, n, stdout);
 }
 
 static void stdout_plm_config(struct nvme_plm_config *plmcfg)
@@ -4660,11 +5815,9 @@ static void stdout_generic_full_path(nvme_ns_t n, char *path, size_t len)
 	snprintf(path, len, "ng%dn%d", instance, head_instance);
 }
 
-static void stdout_list_item(nvme_ns_t n)
+static void stdout_ns_usage(nvme_ns_t n, char *usage, size_t usage_len,
+			    char *format, size_t format_len)
 {
-	char usage[128] = { 0 }, format[128] = { 0 };
-	char devname[128] = { 0 }; char genname[128] = { 0 };
-
 	long long lba = nvme_ns_get_lba_size(n);
 	double nsze = nvme_ns_get_lba_count(n) * lba;
 	double nuse = nvme_ns_get_lba_util(n) * lba;
@@ -4673,11 +5826,18 @@ static void stdout_list_item(nvme_ns_t n)
 	const char *u_suffix = suffix_si_get(&nuse);
 	const char *l_suffix = suffix_binary_get(&lba);
 
-	snprintf(usage, sizeof(usage), "%6.2f %2sB / %6.2f %2sB", nuse,
+	snprintf(usage, usage_len, "%6.2f %2sB / %6.2f %2sB", nuse,
 		u_suffix, nsze, s_suffix);
-	snprintf(format, sizeof(format), "%3.0f %2sB + %2d B", (double)lba,
+	snprintf(format, format_len, "%3.0f %2sB + %2d B", (double)lba,
 		l_suffix, nvme_ns_get_meta_size(n));
+}
+
+static void stdout_list_item(nvme_ns_t n)
+{
+	char usage[128] = { 0 }, format[128] = { 0 };
+	char devname[128] = { 0 }; char genname[128] = { 0 };
 
+	stdout_ns_usage(n, usage, sizeof(usage), format, sizeof(format));
 	stdout_dev_full_path(n, devname, sizeof(devname));
 	stdout_generic_full_path(n, genname, sizeof(genname));
 
@@ -4687,69 +5847,191 @@ static void stdout_list_item(nvme_ns_t n)
 		nvme_ns_get_firmware(n));
 }
 
+static const struct nvme_table_column stdout_list_cols[] = {
+	{ "Node", 21 },
+	{ "Generic", 21 },
+	{ "SN", 20 },
+	{ "Model", 40 },
+	{ "Namespace", 10 },
+	{ "Usage", 26 },
+	{ "Format", 16 },
+	{ "FW Rev", 8 },
+};
+
+struct stdout_list {
+	struct nvme_resources res;
+	struct nvme_table t;
+};
+
 static bool stdout_simple_ns(const char *name, void *arg)
 {
-	struct nvme_resources *res = arg;
+	char usage[128], format[128], path[128];
+	struct stdout_list *l = arg;
 	nvme_ns_t n;
 
-	n = htable_ns_get(&res->ht_n, name);
-	stdout_list_item(n);
+	n = htable_ns_get(&l->res.ht_n, name);
+	stdout_ns_usage(n, usage, sizeof(usage), format, sizeof(format));
+
+	stdout_dev_full_path(n, path, sizeof(path));
+	nvme_table_add(&l->t, path);
+	stdout_generic_full_path(n, path, sizeof(path));
+	nvme_table_add(&l->t, path);
+	nvme_table_add(&l->t, nvme_ns_get_serial(n));
+	nvme_table_add(&l->t, nvme_ns_get_model(n));
+	nvme_table_addf(&l->t, "%#x", nvme_ns_get_nsid(n));
+	nvme_table_add(&l->t, usage);
+	nvme_table_add(&l->t, format);
+	nvme_table_add(&l->t, nvme_ns_get_firmware(n));
 
 	return true;
 }
 
+static void stdout_table_print(struct nvme_table *t)
+{
+	int err = nvme_table_print(t, stdout);
+
+	if (err)
+		nvme_show_error("table: %s", nvme_strerror(-err));
+}
+
 static void stdout_simple_list(nvme_root_t r)
 {
-	struct nvme_resources res;
+	struct stdout_list l;
 
-	nvme_resources_init(r, &res);
+	if (nvme_table_init(&l.t, stdout_list_cols, ARRAY_SIZE(stdout_list_cols))) {
+		nvme_show_error("table: %s", nvme_strerror(ENOMEM));
+		return;
+	}
 
-	printf("%-21s %-21s %-20s %-40s %-10s %-26s %-16s %-8s\n",
-	       "Node", "Generic", "SN", "Model", "Namespace", "Usage", "Format", "FW Rev");
-	printf("%-.21s %-.21s %-.20s %-.40s %-.10s %-.26s %-.16s %-.8s\n",
-	       dash, dash, dash, dash, dash, dash, dash, dash);
-	strset_iterate(&res.namespaces, stdout_simple_ns, &res);
+	nvme_resources_init(r, &l.res);
+	strset_iterate(&l.res.namespaces, stdout_simple_ns, &l);
+	stdout_table_print(&l.t);
 
-	nvme_resources_free(&res);
+	nvme_resources_free(&l.res);
+	nvme_table_free(&l.t);
 }
 
-static void stdout_ns_details(nvme_ns_t n)
+static const struct nvme_table_column stdout_list_fast_cols[] = {
+	{ "Node", 21 },
+	{ "Generic", 21 },
+	{ "SN", 20 },
+	{ "Model", 40 },
+	{ "Namespace", 10 },
+	{ "Size", 12 },
+	{ "Format", 16 },
+	{ "FW Rev", 8 },
+};
+
+static void stdout_list_fast(struct nvme_list_fast_ns *ns, int nr_ns)
 {
-	char usage[128] = { 0 }, format[128] = { 0 };
-	char devname[128] = { 0 }, genname[128] = { 0 };
+	struct nvme_table t;
+	double nsze;
+	long long lba;
+	int i;
 
-	long long lba = nvme_ns_get_lba_size(n);
-	double nsze = nvme_ns_get_lba_count(n) * lba;
-	double nuse = nvme_ns_get_lba_util(n) * lba;
+	if (nvme_table_init(&t, stdout_list_fast_cols, ARRAY_SIZE(stdout_list_fast_cols))) {
+		nvme_show_error("table: %s", nvme_strerror(ENOMEM));
+		return;
+	}
 
-	const char *s_suffix = suffix_si_get(&nsze);
-	const char *u_suffix = suffix_si_get(&nuse);
-	const char *l_suffix = suffix_binary_get(&lba);
+	for (i = 0; i < nr_ns; i++) {
+		if (ns[i].err)
+			continue;
+
+		nsze = ns[i].size;
+		lba = ns[i].lba_size;
+
+		nvme_table_addf(&t, "/dev/%s", ns[i].name);
+		nvme_table_add(&t, ns[i].generic);
+		nvme_table_add(&t, ns[i].serial);
+		nvme_table_add(&t, ns[i].model);
+		nvme_table_addf(&t, "%#x", ns[i].nsid);
+		nvme_table_addf(&t, "%6.2f %2sB", nsze, suffix_si_get(&nsze));
+		nvme_table_addf(&t, "%3.0f %2sB + %2d B", (double)lba,
+				suffix_binary_get(&lba), ns[i].meta_size);
+		nvme_table_add(&t, ns[i].firmware);
+	}
+
+	stdout_table_print(&t);
+	nvme_table_free(&t);
+}
 
-	sprintf(usage, "%6.2f %2sB / %6.2f %2sB", nuse, u_suffix, nsze, s_suffix);
-	sprintf(format, "%3.0f %2sB + %2d B", (double)lba, l_suffix,
-		nvme_ns_get_meta_size(n));
+static void stdout_watch_event(enum nvme_watch_action action,
+			       struct nvme_watch_obj *obj)
+{
+	int i;
 
-	nvme_dev_full_path(n, devname, sizeof(devname));
-	nvme_generic_full_path(n, genname, sizeof(genname));
+	printf("%s %s %s", nvme_watch_action_to_string(action),
+	       nvme_watch_type_to_string(obj->type), obj->name);
+	for (i = 0; action != NVME_WATCH_REMOVE && i < obj->nr_attrs; i++)
+		printf(" %s=%s", obj->keys[i], obj->vals[i]);
+	printf("\n");
+	fflush(stdout);
+}
 
-	printf("%-12s %-12s %#-10x %-26s %-16s ", devname,
-		genname, nvme_ns_get_nsid(n), usage, format);
+static void stdout_aen_event(const struct nvme_watch_aen *aen)
+{
+	printf("aen %s type=%s info=\"%s\" log=%#04x result=%#010x\n",
+	       aen->ctrl, nvme_watch_aen_type_to_string(aen->type),
+	       nvme_watch_aen_info_to_string(aen->type, aen->info), aen->lid,
+	       aen->result);
+	fflush(stdout);
 }
 
-static bool stdout_detailed_name(const char *name, void *arg)
+static const struct nvme_table_column stdout_subsys_cols[] = {
+	{ "Subsystem", 16 },
+	{ "Subsystem-NQN", 96 },
+	{ "Controllers" },
+};
+
+static const struct nvme_table_column stdout_ctrl_cols[] = {
+	{ "Device", 16 },
+	{ "Cntlid", 6 },
+	{ "SN", 20 },
+	{ "MN", 40 },
+	{ "FR", 8 },
+	{ "TxPort", 6 },
+	{ "Address", 14 },
+	{ "Slot", 6 },
+	{ "Subsystem", 12 },
+	{ "Namespaces", 16 },
+};
+
+static const struct nvme_table_column stdout_ns_cols[] = {
+	{ "Device", 17 },
+	{ "Generic", 17 },
+	{ "NSID", 10 },
+	{ "Usage", 26 },
+	{ "Format", 16 },
+	{ "Controllers", 16 },
+};
+
+static void stdout_ns_details(struct nvme_table *t, nvme_ns_t n)
 {
-	bool *first = arg;
+	char usage[128], format[128], path[128];
+
+	stdout_ns_usage(n, usage, sizeof(usage), format, sizeof(format));
+
+	nvme_dev_full_path(n, path, sizeof(path));
+	nvme_table_add(t, path);
+	nvme_generic_full_path(n, path, sizeof(path));
+	nvme_table_add(t, path);
+	nvme_table_addf(t, "%#x", nvme_ns_get_nsid(n));
+	nvme_table_add(t, usage);
+	nvme_table_add(t, format);
+}
 
-	printf("%s%s", *first ? "" : ", ", name);
-	*first = false;
+/* join the names into the last cell of the table */
+static bool stdout_detailed_name(const char *name, void *arg)
+{
+	nvme_table_append(arg, ", ", name);
 
 	return true;
 }
 
 static bool stdout_detailed_subsys(const char *name, void *arg)
 {
-	struct nvme_resources *res = arg;
+	struct stdout_list *l = arg;
 	struct htable_subsys_iter it;
 	struct strset ctrls;
 	nvme_subsystem_t s;
@@ -4758,11 +6040,12 @@ static bool stdout_detailed_subsys(const char *name, void *arg)
 
 	strset_init(&ctrls);
 	first = true;
-	for (s = htable_subsys_getfirst(&res->ht_s, name, &it);
+	for (s = htable_subsys_getfirst(&l->res.ht_s, name, &it);
 	     s;
-	     s = htable_subsys_getnext(&res->ht_s, name, &it)) {
+	     s = htable_subsys_getnext(&l->res.ht_s, name, &it)) {
 		if (first) {
-			printf("%-16s %-96s ", name, nvme_subsystem_get_nqn(s));
+			nvme_table_add(&l->t, name);
+			nvme_table_add(&l->t, nvme_subsystem_get_nqn(s));
 			first = false;
 		}
 
@@ -4770,36 +6053,33 @@ static bool stdout_detailed_subsys(const char *name, void *arg)
 			strset_add(&ctrls, nvme_ctrl_get_name(c));
 	}
 
-	first = true;
-	strset_iterate(&ctrls, stdout_detailed_name, &first);
+	nvme_table_add(&l->t, "");
+	strset_iterate(&ctrls, stdout_detailed_name, &l->t);
 	strset_clear(&ctrls);
-	printf("\n");
 
 	return true;
 }
 
 static bool stdout_detailed_ctrl(const char *name, void *arg)
 {
-	struct nvme_resources *res = arg;
+	struct stdout_list *l = arg;
 	struct strset namespaces;
 	nvme_ctrl_t c;
 	nvme_path_t p;
 	nvme_ns_t n;
-	bool first;
 
-	c = htable_ctrl_get(&res->ht_c, name);
+	c = htable_ctrl_get(&l->res.ht_c, name);
 	assert(c);
 
-	printf("%-8s %-6s %-20s %-40s %-8s %-6s %-14s %-6s %-12s ",
-	       nvme_ctrl_get_name(c),
-	       nvme_ctrl_get_cntlid(c),
-	       nvme_ctrl_get_serial(c),
-	       nvme_ctrl_get_model(c),
-	       nvme_ctrl_get_firmware(c),
-	       nvme_ctrl_get_transport(c),
-	       nvme_ctrl_get_address(c),
-	       nvme_ctrl_get_phy_slot(c),
-	       nvme_subsystem_get_name(nvme_ctrl_get_subsystem(c)));
+	nvme_table_add(&l->t, nvme_ctrl_get_name(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_cntlid(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_serial(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_model(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_firmware(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_transport(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_address(c));
+	nvme_table_add(&l->t, nvme_ctrl_get_phy_slot(c));
+	nvme_table_add(&l->t, nvme_subsystem_get_name(nvme_ctrl_get_subsystem(c)));
 
 	strset_init(&namespaces);
 
@@ -4812,18 +6092,16 @@ static bool stdout_detailed_ctrl(const char *name, void *arg)
 		strset_add(&namespaces, nvme_ns_get_name(n));
 	}
 
-	first = true;
-	strset_iterate(&namespaces, stdout_detailed_name, &first);
+	nvme_table_add(&l->t, "");
+	strset_iterate(&namespaces, stdout_detailed_name, &l->t);
 	strset_clear(&namespaces);
 
-	printf("\n");
-
 	return true;
 }
 
 static bool stdout_detailed_ns(const char *name, void *arg)
 {
-	struct nvme_resources *res = arg;
+	struct stdout_list *l = arg;
 	struct htable_ns_iter it;
 	struct strset ctrls;
 	nvme_ctrl_t c;
@@ -4833,16 +6111,17 @@ static bool stdout_detailed_ns(const char *name, void *arg)
 
 	strset_init(&ctrls);
 	first = true;
-	for (n = htable_ns_getfirst(&res->ht_n, name, &it);
+	for (n = htable_ns_getfirst(&l->res.ht_n, name, &it);
 	     n;
-	     n = htable_ns_getnext(&res->ht_n, name, &it)) {
+	     n = htable_ns_getnext(&l->res.ht_n, name, &it)) {
 		if (first) {
-			stdout_ns_details(n);
+			stdout_ns_details(&l->t, n);
+			nvme_table_add(&l->t, "");
 			first = false;
 		}
 
 		if (nvme_ns_get_ctrl(n)) {
-			printf("%s\n", nvme_ctrl_get_name(nvme_ns_get_ctrl(n)));
+			nvme_table_append(&l->t, "", nvme_ctrl_get_name(nvme_ns_get_ctrl(n)));
 			return true;
 		}
 
@@ -4852,40 +6131,45 @@ static bool stdout_detailed_ns(const char *name, void *arg)
 		}
 	}
 
-	first = true;
-	strset_iterate(&ctrls, stdout_detailed_name, &first);
+	strset_iterate(&ctrls, stdout_detailed_name, &l->t);
 	strset_clear(&ctrls);
 
-	printf("\n");
 	return true;
 }
 
+static void stdout_detailed_table(struct stdout_list *l,
+				  const struct nvme_table_column *cols,
+				  unsigned int nr_cols, struct strset *set,
+				  bool (*fn)(const char *name, void *arg))
+{
+	if (nvme_table_init(&l->t, cols, nr_cols)) {
+		nvme_show_error("table: %s", nvme_strerror(ENOMEM));
+		return;
+	}
+
+	strset_iterate(set, fn, l);
+	stdout_table_print(&l->t);
+	nvme_table_free(&l->t);
+}
+
 static void stdout_detailed_list(nvme_root_t r)
 {
-	struct nvme_resources res;
+	struct stdout_list l;
 
-	nvme_resources_init(r, &res);
+	nvme_resources_init(r, &l.res);
 
-	printf("%-16s %-96s %-.16s\n", "Subsystem", "Subsystem-NQN", "Controllers");
-	printf("%-.16s %-.96s %-.16s\n", dash, dash, dash);
-	strset_iterate(&res.subsystems, stdout_detailed_subsys, &res);
+	stdout_detailed_table(&l, stdout_subsys_cols, ARRAY_SIZE(stdout_subsys_cols),
+			      &l.res.subsystems, stdout_detailed_subsys);
 	printf("\n");
 
-	printf("%-16s %-5s %-20s %-40s %-8s %-6s %-14s %-6s %-12s %-16s\n", "Device",
-		"Cntlid", "SN", "MN", "FR", "TxPort", "Address", "Slot", "Subsystem",
-		"Namespaces");
-	printf("%-.16s %-.6s %-.20s %-.40s %-.8s %-.6s %-.14s %-.6s %-.12s %-.16s\n",
-			dash, dash, dash, dash, dash, dash, dash, dash, dash, dash);
-	strset_iterate(&res.ctrls, stdout_detailed_ctrl, &res);
+	stdout_detailed_table(&l, stdout_ctrl_cols, ARRAY_SIZE(stdout_ctrl_cols),
+			      &l.res.ctrls, stdout_detailed_ctrl);
 	printf("\n");
 
-	printf("%-17s %-17s %-10s %-26s %-16s %-16s\n", "Device", "Generic",
-		"NSID", "Usage", "Format", "Controllers");
-	printf("%-.17s %-.17s %-.10s %-.26s %-.16s %-.16s\n", dash, dash, dash,
-		dash, dash, dash);
-	strset_iterate(&res.namespaces, stdout_detailed_ns, &res);
+	stdout_detailed_table(&l, stdout_ns_cols, ARRAY_SIZE(stdout_ns_cols),
+			      &l.res.namespaces, stdout_detailed_ns);
 
-	nvme_resources_free(&res);
+	nvme_resources_free(&l.res);
 }
 
 static void stdout_list_items(nvme_root_t r)
@@ -4908,6 +6192,22 @@ static bool nvme_is_multipath(nvme_subsystem_t s)
 	return false;
 }
 
+/* a line of the counters of the block device at @dir, show-topology --stats */
+static void stdout_topology_stats(const char *indent, const char *dir, bool path)
+{
+	struct sysfs_blk_stat st;
+	unsigned long long qd;
+
+	if (!(stdout_print_ops.flags & STATS) || !dir || sysfs_read_blk_stat(dir, &st))
+		return;
+
+	printf("%s  reads=%llu writes=%llu in_flight=%llu io_ticks=%llums", indent,
+	       st.read_ios, st.write_ios, st.in_flight, st.io_ticks);
+	if (path && !sysfs_read_u64(dir, "queue_depth", &qd))
+		printf(" queue_depth=%llu", qd);
+	printf("\n");
+}
+
 static void stdout_subsystem_topology_multipath(nvme_subsystem_t s,
 						     enum nvme_cli_topo_ranking ranking)
 {
@@ -4921,6 +6221,7 @@ static void stdout_subsystem_topology_multipath(nvme_subsystem_t s,
 				continue;
 
 			printf(" +- ns %d\n", nvme_ns_get_nsid(n));
+			stdout_topology_stats(" ", nvme_ns_get_sysfs_dir(n), false);
 			printf(" \\\n");
 
 			nvme_namespace_for_each_path(n, p) {
@@ -4932,6 +6233,7 @@ static void stdout_subsystem_topology_multipath(nvme_subsystem_t s,
 				       nvme_ctrl_get_address(c),
 				       nvme_ctrl_get_state(c),
 				       nvme_path_get_ana_state(p));
+				stdout_topology_stats("  ", nvme_path_get_sysfs_dir(p), true);
 			}
 		}
 	} else {
@@ -4952,6 +6254,8 @@ static void stdout_subsystem_topology_multipath(nvme_subsystem_t s,
 					       nvme_ns_get_nsid(n),
 					       nvme_ctrl_get_state(c),
 					       nvme_path_get_ana_state(p));
+					stdout_topology_stats("  ", nvme_path_get_sysfs_dir(p),
+							      true);
 				}
 			}
 		}
@@ -4974,6 +6278,7 @@ static void stdout_subsystem_topology(nvme_subsystem_t s,
 				       nvme_ctrl_get_transport(c),
 				       nvme_ctrl_get_address(c),
 				       nvme_ctrl_get_state(c));
+				stdout_topology_stats("  ", nvme_ns_get_sysfs_dir(n), false);
 			}
 		}
 	} else {
@@ -4988,6 +6293,7 @@ static void stdout_subsystem_topology(nvme_subsystem_t s,
 				printf("  +- ns %d %s\n",
 				       nvme_ns_get_nsid(n),
 				       nvme_ctrl_get_state(c));
+				stdout_topology_stats("  ", nvme_ns_get_sysfs_dir(n), false);
 			}
 		}
 	}
@@ -5097,8 +6403,16 @@ static void stdout_connect_msg(nvme_ctrl_t c)
 static struct print_ops stdout_print_ops = {
 	/* libnvme types.h print functions */
 	.ana_log			= stdout_ana_log,
+	.ana_transition			= stdout_ana_transition,
 	.boot_part_log			= stdout_boot_part_log,
 	.phy_rx_eom_log			= stdout_phy_rx_eom_log,
+	.collect			= stdout_collect,
+	.fw_rollout			= stdout_fw_rollout,
+	.self_test_run			= stdout_self_test_run,
+	.sanitize_run			= stdout_sanitize_run,
+	.format_run			= stdout_format_run,
+	.provision_ns			= stdout_provision_ns,
+	.virt_provision			= stdout_virt_provision,
 	.ctrl_list			= stdout_list_ctrl,
 	.ctrl_registers			= stdout_ctrl_registers,
 	.ctrl_register			= stdout_ctrl_register,
@@ -5108,9 +6422,11 @@ static struct print_ops stdout_print_ops = {
 	.endurance_group_event_agg_log	= stdout_endurance_group_event_agg_log,
 	.endurance_group_list		= stdout_endurance_group_list,
 	.endurance_log			= stdout_endurance_log,
+	.endurance_log_batch		= stdout_endurance_log_batch,
 	.error_log			= stdout_error_log,
 	.fdp_config_log			= stdout_fdp_configs,
 	.fdp_event_log			= stdout_fdp_events,
+	.fdp_event			= stdout_fdp_event,
 	.fdp_ruh_status			= stdout_fdp_ruh_status,
 	.fdp_stats_log			= stdout_fdp_stats,
 	.fdp_usage_log			= stdout_fdp_usage,
@@ -5123,9 +6439,37 @@ static struct print_ops stdout_print_ops = {
 	.id_iocs			= stdout_id_iocs,
 	.id_ns				= stdout_id_ns,
 	.id_ns_descs			= stdout_id_ns_descs,
+	.id_ns_all			= stdout_id_ns_all,
+	.id_ns_descs_all		= stdout_id_ns_descs_all,
 	.id_ns_granularity_list		= stdout_id_ns_granularity_list,
 	.id_nvmset_list			= stdout_id_nvmset,
 	.id_uuid_list			= stdout_id_uuid_list,
+	.io_stats			= stdout_io_stats,
+	.hash_compare			= stdout_hash_compare,
+	.io_sweep			= stdout_io_sweep,
+	.path_probe			= stdout_path_probe,
+	.queue_advice			= stdout_queue_advice,
+	.fdp_write			= stdout_fdp_write,
+	.fdp_sample			= stdout_fdp_sample,
+	.smart_sample			= stdout_smart_sample,
+	.thermal_sample			= stdout_thermal_sample,
+	.thermal_episode		= stdout_thermal_episode,
+	.thermal_summary		= stdout_thermal_summary,
+	.plm_event			= stdout_plm_event,
+	.plm_summary			= stdout_plm_summary,
+	.power_bench			= stdout_power_bench,
+	.tune_sweep			= stdout_tune_sweep,
+	.flush_bench			= stdout_flush_bench,
+	.pmr_bench			= stdout_pmr_bench,
+	.io_bench_sample		= stdout_io_bench_sample,
+	.io_bench_multi			= stdout_io_bench_multi,
+	.dsm_bench			= stdout_dsm_bench,
+	.cw_bench			= stdout_cw_bench,
+	.mi_poll_sample			= stdout_mi_poll_sample,
+	.reg_sample			= stdout_reg_sample,
+	.latency_hist			= stdout_latency_hist,
+	.lat_sample			= stdout_lat_sample,
+	.replay				= stdout_replay,
 	.lba_status			= stdout_lba_status,
 	.lba_status_log			= stdout_lba_status_log,
 	.media_unit_stat_log		= stdout_media_unit_stat_log,
@@ -5134,17 +6478,24 @@ static struct print_ops stdout_print_ops = {
 	.ns_list_log			= stdout_changed_ns_list_log,
 	.nvm_id_ns			= stdout_nvm_id_ns,
 	.persistent_event_log		= stdout_persistent_event_log,
+	.persistent_event		= stdout_persistent_event,
 	.predictable_latency_event_agg_log = stdout_predictable_latency_event_agg_log,
 	.predictable_latency_per_nvmset	= stdout_predictable_latency_per_nvmset,
+	.predictable_latency_nvmset_batch = stdout_predictable_latency_nvmset_batch,
 	.primary_ctrl_cap		= stdout_primary_ctrl_cap,
 	.resv_notification_log		= stdout_resv_notif_log,
 	.resv_report			= stdout_resv_report,
+	.resv_table			= stdout_resv_table,
+	.smart_ns_table			= stdout_smart_ns_table,
+	.resv_batch			= stdout_resv_batch,
 	.sanitize_log_page		= stdout_sanitize_log,
 	.secondary_ctrl_list		= stdout_list_secondary_ctrl,
 	.select_result			= stdout_select_result,
 	.self_test_log			= stdout_self_test_log,
 	.single_property		= stdout_single_property,
 	.smart_log			= stdout_smart_log,
+	.streams			= stdout_streams,
+	.cap_layout			= stdout_cap_layout,
 	.supported_cap_config_list_log	= stdout_supported_cap_config_log,
 	.supported_log_pages		= stdout_supported_log,
 	.zns_start_zone_list		= stdout_zns_start_zone_list,
@@ -5153,6 +6504,7 @@ static struct print_ops stdout_print_ops = {
 	.zns_id_ctrl			= stdout_zns_id_ctrl,
 	.zns_id_ns			= stdout_zns_id_ns,
 	.zns_report_zones		= stdout_zns_report_zones,
+	.zns_zone_summary		= stdout_zns_zone_summary,
 	.show_feature			= stdout_feature_show,
 	.show_feature_fields		= stdout_feature_show_fields,
 	.id_ctrl_rpmbs			= stdout_id_ctrl_rpmbs,
@@ -5165,6 +6517,9 @@ static struct print_ops stdout_print_ops = {
 	/* libnvme tree print functions */
 	.list_item			= stdout_list_item,
 	.list_items			= stdout_list_items,
+	.list_fast			= stdout_list_fast,
+	.watch_event			= stdout_watch_event,
+	.aen_event			= stdout_aen_event,
 	.print_nvme_subsystem_list	= stdout_subsystem_list,
 	.topology_ctrl			= stdout_topology_ctrl,
 	.topology_namespace		= stdout_topology_namespace,
@@ -12,14 +12,23 @@
 #include "nvme-print.h"
 #include "nvme-models.h"
 #include "util/suffix.h"
+#include "util/timing.h"
 #include "util/types.h"
 #include "common.h"
 
 #define nvme_print(name, flags, ...)				\
 	do {							\
 		struct print_ops *ops = nvme_print_ops(flags);	\
-		if (ops && ops->name)				\
+		enum nvme_timing_phase __phase;			\
+		if (ops && ops->name) {				\
+			__phase = nvme_timing_switch(NVME_TIMING_PRINT); \
+			if (ops->arena)				\
+				json_arena_begin();		\
 			ops->name(__VA_ARGS__);			\
+			if (ops->arena)				\
+				json_arena_end();		\
+			nvme_timing_switch(__phase);		\
+		}						\
 	} while (false)
 
 #define nvme_print_output_format(name, ...)			\
@@ -56,6 +65,45 @@ const char *nvme_ana_state_to_string(enum nvme_ana_state state)
 	return "invalid state";
 }
 
+const char *nvme_self_test_result_to_string(__u8 result)
+{
+	static const char * const res[] = {
+		"passed",
+		"aborted by self-test command",
+		"aborted by controller reset",
+		"aborted by namespace removal",
+		"aborted by format",
+		"fatal error",
+		"failed, unknown segment",
+		"failed",
+		"aborted",
+		"aborted by sanitize",
+	};
+
+	if (result < ARRAY_SIZE(res))
+		return res[result];
+	if (result == NVME_ST_RESULT_NOT_USED)
+		return "no result";
+	return "reserved";
+}
+
+const char *nvme_fw_rollout_stage_to_string(enum nvme_fw_rollout_stage stage)
+{
+	switch (stage) {
+	case NVME_FW_ROLLOUT_OPEN:
+		return "open";
+	case NVME_FW_ROLLOUT_DOWNLOAD:
+		return "download";
+	case NVME_FW_ROLLOUT_COMMIT:
+		return "commit";
+	case NVME_FW_ROLLOUT_VERIFY:
+		return "verify";
+	case NVME_FW_ROLLOUT_DONE:
+		return "done";
+	}
+	return "unknown";
+}
+
 const char *nvme_cmd_to_string(int admin, __u8 opcode)
 {
 	if (admin) {
@@ -130,6 +178,25 @@ const char *nvme_sstat_status_to_string(__u16 status)
 	}
 }
 
+/* short form of the Sanitize Status for tables */
+const char *nvme_sanitize_result_to_string(__u16 status)
+{
+	switch (status & NVME_SANITIZE_SSTAT_STATUS_MASK) {
+	case NVME_SANITIZE_SSTAT_STATUS_NEVER_SANITIZED:
+		return "never";
+	case NVME_SANITIZE_SSTAT_STATUS_COMPLETE_SUCCESS:
+		return "passed";
+	case NVME_SANITIZE_SSTAT_STATUS_IN_PROGESS:
+		return "running";
+	case NVME_SANITIZE_SSTAT_STATUS_COMPLETED_FAILED:
+		return "failed";
+	case NVME_SANITIZE_SSTAT_STATUS_ND_COMPLETE_SUCCESS:
+		return "passed-nd";
+	default:
+		return "unknown";
+	}
+}
+
 void nvme_show_predictable_latency_per_nvmset(
 	struct nvme_nvmset_predictable_lat_log *plpns_log,
 	__u16 nvmset_id, const char *devname,
@@ -139,6 +206,12 @@ void nvme_show_predictable_latency_per_nvmset(
 		   plpns_log, nvmset_id, devname);
 }
 
+void nvme_show_predictable_latency_nvmset_batch(struct nvme_log_batch_entry *e, int nr,
+						const char *devname, enum nvme_print_flags flags)
+{
+	nvme_print(predictable_latency_nvmset_batch, flags, e, nr, devname);
+}
+
 void nvme_show_predictable_latency_event_agg_log(
 	struct nvme_aggregate_predictable_lat_event *pea_log,
 	__u64 log_entries, __u32 size, const char *devname,
@@ -206,6 +279,14 @@ void nvme_show_persistent_event_log(void *pevent_log_info,
 		   pevent_log_info, action, size, devname);
 }
 
+void nvme_show_persistent_event(void *pevent_log_info, __u32 offset,
+	__u32 event_number, const char *devname,
+	enum nvme_print_flags flags)
+{
+	nvme_print(persistent_event, flags,
+		   pevent_log_info, offset, event_number, devname);
+}
+
 void nvme_show_endurance_group_event_agg_log(
 	struct nvme_aggregate_predictable_lat_event *endurance_log,
 	__u64 log_entries, __u32 size, const char *devname,
@@ -307,6 +388,12 @@ void nvme_show_fdp_events(struct nvme_fdp_events_log *log,
 	nvme_print(fdp_event_log, flags, log);
 }
 
+void nvme_show_fdp_event(struct nvme_fdp_event *event, bool host,
+		enum nvme_print_flags flags)
+{
+	nvme_print(fdp_event, flags, event, host);
+}
+
 void nvme_show_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len,
 		enum nvme_print_flags flags)
 {
@@ -436,9 +523,7 @@ void d(unsigned char *buf, int len, int width, int group)
 
 void d_raw(unsigned char *buf, unsigned len)
 {
-	unsigned i;
-	for (i = 0; i < len; i++)
-		putchar(*(buf+i));
+	fwrite(buf, 1, len, stdout);
 }
 
 void nvme_show_status(int status)
@@ -492,6 +577,17 @@ void nvme_show_id_ns_descs(void *data, unsigned nsid, enum nvme_print_flags flag
 	nvme_print(id_ns_descs, flags, data, nsid);
 }
 
+void nvme_show_id_ns_all(struct nvme_id_ns_entry *list, int nr, enum nvme_print_flags flags)
+{
+	nvme_print(id_ns_all, flags, list, nr);
+}
+
+void nvme_show_id_ns_descs_all(struct nvme_id_ns_entry *list, int nr,
+			       enum nvme_print_flags flags)
+{
+	nvme_print(id_ns_descs_all, flags, list, nr);
+}
+
 void nvme_show_id_ctrl(struct nvme_id_ctrl *ctrl, enum nvme_print_flags flags,
 			void (*vendor_show)(__u8 *vs, struct json_object *root))
 {
@@ -588,6 +684,12 @@ void nvme_show_zns_report_zones(void *report, __u32 descs,
 		   report, descs, ext_size, report_size, zone_list);
 }
 
+void nvme_show_zns_zone_summary(struct nvme_zone_summary *summary,
+				enum nvme_print_flags flags)
+{
+	nvme_print(zns_zone_summary, flags, summary);
+}
+
 void nvme_show_list_ctrl(struct nvme_ctrl_list *ctrl_list,
 	enum nvme_print_flags flags)
 {
@@ -628,6 +730,181 @@ void nvme_show_id_uuid_list(const struct nvme_id_uuid_list *uuid_list,
 	nvme_print(id_uuid_list, flags, uuid_list);
 }
 
+void nvme_show_io_stats(const char *name, struct nvme_io_stats *stats,
+			enum nvme_print_flags flags)
+{
+	nvme_print(io_stats, flags, name, stats);
+}
+
+void nvme_show_io_sweep(struct nvme_io_sweep *sweep, enum nvme_print_flags flags)
+{
+	nvme_print(io_sweep, flags, sweep);
+}
+
+void nvme_show_path_probe(struct nvme_path_probe *probe, enum nvme_print_flags flags)
+{
+	nvme_print(path_probe, flags, probe);
+}
+
+void nvme_show_queue_advice(struct nvme_queue_advice *advice, enum nvme_print_flags flags)
+{
+	nvme_print(queue_advice, flags, advice);
+}
+
+void nvme_show_hash_compare(struct nvme_hash_compare *hc, enum nvme_print_flags flags)
+{
+	nvme_print(hash_compare, flags, hc);
+}
+
+void nvme_show_fdp_write(struct nvme_fdp_write *fw, enum nvme_print_flags flags)
+{
+	nvme_print(fdp_write, flags, fw);
+}
+
+void nvme_show_fdp_sample(struct nvme_fdp_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(fdp_sample, flags, sample);
+}
+
+void nvme_show_smart_sample(struct nvme_smart_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(smart_sample, flags, sample);
+}
+
+void nvme_show_thermal_sample(struct nvme_thermal_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(thermal_sample, flags, sample);
+}
+
+void nvme_show_thermal_episode(struct nvme_thermal_episode *episode,
+			       enum nvme_print_flags flags)
+{
+	nvme_print(thermal_episode, flags, episode);
+}
+
+void nvme_show_thermal_summary(struct nvme_thermal_summary *summary,
+			       enum nvme_print_flags flags)
+{
+	nvme_print(thermal_summary, flags, summary);
+}
+
+void nvme_show_plm_event(struct nvme_plm_event *event, enum nvme_print_flags flags)
+{
+	nvme_print(plm_event, flags, event);
+}
+
+void nvme_show_plm_summary(struct nvme_plm_summary *summary, enum nvme_print_flags flags)
+{
+	nvme_print(plm_summary, flags, summary);
+}
+
+void nvme_show_power_bench(struct nvme_power_bench *pb, enum nvme_print_flags flags)
+{
+	nvme_print(power_bench, flags, pb);
+}
+
+void nvme_show_tune_sweep(struct nvme_tune_sweep *ts, enum nvme_print_flags flags)
+{
+	nvme_print(tune_sweep, flags, ts);
+}
+
+void nvme_show_flush_bench(struct nvme_flush_bench *fb, enum nvme_print_flags flags)
+{
+	nvme_print(flush_bench, flags, fb);
+}
+
+void nvme_show_pmr_bench(struct nvme_pmr_bench *pb, enum nvme_print_flags flags)
+{
+	nvme_print(pmr_bench, flags, pb);
+}
+
+void nvme_show_io_bench_sample(struct nvme_io_bench_sample *sample,
+			       enum nvme_print_flags flags)
+{
+	nvme_print(io_bench_sample, flags, sample);
+}
+
+void nvme_show_io_bench_multi(struct nvme_io_bench_multi *m, enum nvme_print_flags flags)
+{
+	nvme_print(io_bench_multi, flags, m);
+}
+
+void nvme_show_dsm_bench(struct nvme_dsm_bench *b, enum nvme_print_flags flags)
+{
+	nvme_print(dsm_bench, flags, b);
+}
+
+void nvme_show_cw_bench(struct nvme_cw_bench *b, enum nvme_print_flags flags)
+{
+	nvme_print(cw_bench, flags, b);
+}
+
+void nvme_show_mi_poll_sample(struct nvme_mi_poll_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(mi_poll_sample, flags, sample);
+}
+
+void nvme_show_reg_sample(struct nvme_reg_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(reg_sample, flags, sample);
+}
+
+void nvme_show_latency_hist(const char *name, struct nvme_hist *lat,
+			    enum nvme_print_flags flags)
+{
+	nvme_print(latency_hist, flags, name, lat);
+}
+
+void nvme_show_lat_sample(struct nvme_lat_sample *sample, enum nvme_print_flags flags)
+{
+	nvme_print(lat_sample, flags, sample);
+}
+
+void nvme_show_replay(struct nvme_replay *replay, enum nvme_print_flags flags)
+{
+	nvme_print(replay, flags, replay);
+}
+
+void nvme_show_collect(struct nvme_collect_dev *devs, int nr_devs,
+		       enum nvme_print_flags flags)
+{
+	nvme_print(collect, flags, devs, nr_devs);
+}
+
+void nvme_show_fw_rollout(struct nvme_fw_rollout_dev *devs, int nr_devs,
+			  enum nvme_print_flags flags)
+{
+	nvme_print(fw_rollout, flags, devs, nr_devs);
+}
+
+void nvme_show_self_test_run(struct nvme_self_test_dev *devs, int nr_devs,
+			     enum nvme_print_flags flags)
+{
+	nvme_print(self_test_run, flags, devs, nr_devs);
+}
+
+void nvme_show_sanitize_run(struct nvme_sanitize_dev *devs, int nr_devs,
+			    enum nvme_print_flags flags)
+{
+	nvme_print(sanitize_run, flags, devs, nr_devs);
+}
+
+void nvme_show_format_run(struct nvme_format_dev *devs, int nr_devs, __u64 wall_ns,
+			  enum nvme_print_flags flags)
+{
+	nvme_print(format_run, flags, devs, nr_devs, wall_ns);
+}
+
+void nvme_show_provision_ns(struct nvme_provision *p, enum nvme_print_flags flags)
+{
+	nvme_print(provision_ns, flags, p);
+}
+
+void nvme_show_virt_provision(struct nvme_virt_provision *p, enum nvme_print_flags flags)
+{
+	nvme_print(virt_provision, flags, p);
+}
+
 void nvme_show_id_domain_list(struct nvme_id_domain_list *id_dom,
 	enum nvme_print_flags flags)
 {
@@ -658,12 +935,99 @@ const char *nvme_trtype_to_string(__u8 trtype)
 	};
 }
 
+/* short names, for the compact reservation table */
+const char *nvme_resv_type_to_string(__u8 rtype)
+{
+	switch (rtype) {
+	case 0: return "none";
+	case 1: return "WE";		/* write exclusive */
+	case 2: return "EA";		/* exclusive access */
+	case 3: return "WE-RO";		/* ... registrants only */
+	case 4: return "EA-RO";
+	case 5: return "WE-AR";		/* ... all registrants */
+	case 6: return "EA-AR";
+	default: return "reserved";
+	}
+}
+
+const char *nvme_cap_layout_op_to_string(__u8 op)
+{
+	switch (op) {
+	case NVME_CAP_LAYOUT_SELECT:		return "select-config";
+	case NVME_CAP_LAYOUT_CREATE_ENDGRP:	return "create-endgrp";
+	case NVME_CAP_LAYOUT_DELETE_ENDGRP:	return "delete-endgrp";
+	case NVME_CAP_LAYOUT_CREATE_NVMSET:	return "create-nvmset";
+	case NVME_CAP_LAYOUT_DELETE_NVMSET:	return "delete-nvmset";
+	default:				return "reserved";
+	}
+}
+
+/*
+ * The number of registrants in @ns, clamped to its buffer, or with @i
+ * below that number the fields of one of them, whichever data structure
+ * was requested. The host identifier is printed in hex into @hostid.
+ */
+int nvme_resv_registrant(struct nvme_resv_ns *ns, int i, __u16 *cntlid, __u8 *rcsts,
+			 __u64 *rkey, char *hostid, size_t len)
+{
+	struct nvme_resv_status *s = ns->status;
+	int regctl = s->regctl[0] | (s->regctl[1] << 8);
+	int size = ns->eds ? 64 : 24;
+	int j;
+
+	if ((ns->bytes - size) / size < regctl)
+		regctl = (ns->bytes - size) / size;
+	if (i < 0 || i >= regctl)
+		return regctl;
+
+	if (!ns->eds) {
+		*cntlid = le16_to_cpu(s->regctl_ds[i].cntlid);
+		*rcsts = s->regctl_ds[i].rcsts;
+		*rkey = le64_to_cpu(s->regctl_ds[i].rkey);
+		snprintf(hostid, len, "%016"PRIx64, le64_to_cpu(s->regctl_ds[i].hostid));
+	} else {
+		*cntlid = le16_to_cpu(s->regctl_eds[i].cntlid);
+		*rcsts = s->regctl_eds[i].rcsts;
+		*rkey = le64_to_cpu(s->regctl_eds[i].rkey);
+		for (j = 0; j < 16 && (j + 1) * 2 < len; j++)
+			sprintf(hostid + j * 2, "%02x", s->regctl_eds[i].hostid[j]);
+	}
+
+	return regctl;
+}
+
 void nvme_show_error_log(struct nvme_error_log_page *err_log, int entries,
 			 const char *devname, enum nvme_print_flags flags)
 {
 	nvme_print(error_log, flags, err_log, entries, devname);
 }
 
+void nvme_show_resv_batch(struct nvme_resv_batch *batch, enum nvme_print_flags flags)
+{
+	nvme_print(resv_batch, flags, batch);
+}
+
+void nvme_show_streams(struct nvme_streams *s, enum nvme_print_flags flags)
+{
+	nvme_print(streams, flags, s);
+}
+
+void nvme_show_cap_layout(struct nvme_cap_layout *l, enum nvme_print_flags flags)
+{
+	nvme_print(cap_layout, flags, l);
+}
+
+void nvme_show_resv_table(struct nvme_resv_ns *list, int nr, enum nvme_print_flags flags)
+{
+	nvme_print(resv_table, flags, list, nr);
+}
+
+void nvme_show_smart_ns_table(struct nvme_smart_ns *list, int nr, const char *devname,
+			      enum nvme_print_flags flags)
+{
+	nvme_print(smart_ns_table, flags, list, nr, devname);
+}
+
 void nvme_show_resv_report(struct nvme_resv_status *status, int bytes,
 			   bool eds, enum nvme_print_flags flags)
 {
@@ -739,6 +1103,12 @@ void nvme_show_endurance_log(struct nvme_endurance_group_log *endurance_log,
 	nvme_print(endurance_log, flags, endurance_log, group_id, devname);
 }
 
+void nvme_show_endurance_log_batch(struct nvme_log_batch_entry *e, int nr,
+				   const char *devname, enum nvme_print_flags flags)
+{
+	nvme_print(endurance_log_batch, flags, e, nr, devname);
+}
+
 void nvme_show_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 			 const char *devname, enum nvme_print_flags flags)
 {
@@ -751,6 +1121,12 @@ void nvme_show_ana_log(struct nvme_ana_log *ana_log, const char *devname,
 	nvme_print(ana_log, flags, ana_log, devname, len);
 }
 
+void nvme_show_ana_transition(const struct nvme_ana_transition *t, const char *devname,
+			      enum nvme_print_flags flags)
+{
+	nvme_print(ana_transition, flags, t, devname);
+}
+
 void nvme_show_self_test_log(struct nvme_self_test_log *self_test, __u8 dst_entries,
 				__u32 size, const char *devname, enum nvme_print_flags flags)
 {
@@ -1217,6 +1593,24 @@ void nvme_show_list_items(nvme_root_t r, enum nvme_print_flags flags)
 	nvme_print(list_items, flags, r);
 }
 
+void nvme_show_list_fast(struct nvme_list_fast_ns *ns, int nr_ns,
+			 enum nvme_print_flags flags)
+{
+	nvme_print(list_fast, flags, ns, nr_ns);
+}
+
+void nvme_show_watch_event(enum nvme_watch_action action,
+			   struct nvme_watch_obj *obj, enum nvme_print_flags flags)
+{
+	nvme_print(watch_event, flags, action, obj);
+}
+
+void nvme_show_aen_event(const struct nvme_watch_aen *aen,
+			 enum nvme_print_flags flags)
+{
+	nvme_print(aen_event, flags, aen);
+}
+
 void nvme_show_topology(nvme_root_t r,
 			enum nvme_cli_topo_ranking ranking,
 			enum nvme_print_flags flags)
@@ -3,6 +3,8 @@
 #define NVME_PRINT_H
 
 #include "nvme.h"
+#include "nvme-io-engine.h"
+#include "nvme-watch.h"
 #include <inttypes.h>
 
 #include <ccan/list/list.h>
@@ -24,8 +26,16 @@ void d_raw(unsigned char *buf, unsigned len);
 struct print_ops {
 	/* libnvme types.h print functions */
 	void (*ana_log)(struct nvme_ana_log *ana_log, const char *devname, size_t len);
+	void (*ana_transition)(const struct nvme_ana_transition *t, const char *devname);
 	void (*boot_part_log)(void *bp_log, const char *devname, __u32 size);
 	void (*phy_rx_eom_log)(struct nvme_phy_rx_eom_log *log, __u16 controller);
+	void (*collect)(struct nvme_collect_dev *devs, int nr_devs);
+	void (*fw_rollout)(struct nvme_fw_rollout_dev *devs, int nr_devs);
+	void (*self_test_run)(struct nvme_self_test_dev *devs, int nr_devs);
+	void (*sanitize_run)(struct nvme_sanitize_dev *devs, int nr_devs);
+	void (*format_run)(struct nvme_format_dev *devs, int nr_devs, __u64 wall_ns);
+	void (*provision_ns)(struct nvme_provision *p);
+	void (*virt_provision)(struct nvme_virt_provision *p);
 	void (*ctrl_list)(struct nvme_ctrl_list *ctrl_list);
 	void (*ctrl_registers)(void *bar, bool fabrics);
 	void (*ctrl_register)(int offset, uint64_t value);
@@ -35,9 +45,11 @@ struct print_ops {
 	void (*endurance_group_event_agg_log)(struct nvme_aggregate_predictable_lat_event *endurance_log, __u64 log_entries, __u32 size, const char *devname);
 	void (*endurance_group_list)(struct nvme_id_endurance_group_list *endgrp_list);
 	void (*endurance_log)(struct nvme_endurance_group_log *endurance_group, __u16 group_id, const char *devname);
+	void (*endurance_log_batch)(struct nvme_log_batch_entry *e, int nr, const char *devname);
 	void (*error_log)(struct nvme_error_log_page *err_log, int entries, const char *devname);
 	void (*fdp_config_log)(struct nvme_fdp_config_log *log, size_t len);
 	void (*fdp_event_log)(struct nvme_fdp_events_log *log);
+	void (*fdp_event)(struct nvme_fdp_event *event, bool host);
 	void (*fdp_ruh_status)(struct nvme_fdp_ruh_status *status, size_t len);
 	void (*fdp_stats_log)(struct nvme_fdp_stats_log *log);
 	void (*fdp_usage_log)(struct nvme_fdp_ruhu_log *log, size_t len);
@@ -50,9 +62,37 @@ struct print_ops {
 	void (*id_iocs)(struct nvme_id_iocs *ioscs);
 	void (*id_ns)(struct nvme_id_ns *ns, unsigned int nsid, unsigned int lba_index, bool cap_only);
 	void (*id_ns_descs)(void *data, unsigned int nsid);
+	void (*id_ns_all)(struct nvme_id_ns_entry *list, int nr);
+	void (*id_ns_descs_all)(struct nvme_id_ns_entry *list, int nr);
 	void (*id_ns_granularity_list)(const struct nvme_id_ns_granularity_list *list);
 	void (*id_nvmset_list)(struct nvme_id_nvmset_list *nvmset, unsigned int nvmeset_id);
 	void (*id_uuid_list)(const struct nvme_id_uuid_list  *uuid_list);
+	void (*io_stats)(const char *name, struct nvme_io_stats *stats);
+	void (*hash_compare)(struct nvme_hash_compare *hc);
+	void (*io_sweep)(struct nvme_io_sweep *sweep);
+	void (*path_probe)(struct nvme_path_probe *probe);
+	void (*queue_advice)(struct nvme_queue_advice *advice);
+	void (*fdp_write)(struct nvme_fdp_write *fw);
+	void (*fdp_sample)(struct nvme_fdp_sample *sample);
+	void (*smart_sample)(struct nvme_smart_sample *sample);
+	void (*thermal_sample)(struct nvme_thermal_sample *sample);
+	void (*thermal_episode)(struct nvme_thermal_episode *episode);
+	void (*thermal_summary)(struct nvme_thermal_summary *summary);
+	void (*plm_event)(struct nvme_plm_event *event);
+	void (*plm_summary)(struct nvme_plm_summary *summary);
+	void (*power_bench)(struct nvme_power_bench *pb);
+	void (*tune_sweep)(struct nvme_tune_sweep *ts);
+	void (*flush_bench)(struct nvme_flush_bench *fb);
+	void (*pmr_bench)(struct nvme_pmr_bench *pb);
+	void (*io_bench_sample)(struct nvme_io_bench_sample *sample);
+	void (*io_bench_multi)(struct nvme_io_bench_multi *m);
+	void (*dsm_bench)(struct nvme_dsm_bench *b);
+	void (*cw_bench)(struct nvme_cw_bench *b);
+	void (*mi_poll_sample)(struct nvme_mi_poll_sample *sample);
+	void (*reg_sample)(struct nvme_reg_sample *sample);
+	void (*latency_hist)(const char *name, struct nvme_hist *lat);
+	void (*lat_sample)(struct nvme_lat_sample *sample);
+	void (*replay)(struct nvme_replay *replay);
 	void (*lba_status)(struct nvme_lba_status *list, unsigned long len);
 	void (*lba_status_log)(void *lba_status, __u32 size, const char *devname);
 	void (*media_unit_stat_log)(struct nvme_media_unit_stat_log *mus);
@@ -61,17 +101,24 @@ struct print_ops {
 	void (*ns_list_log)(struct nvme_ns_list *log, const char *devname);
 	void (*nvm_id_ns)(struct nvme_nvm_id_ns *nvm_ns, unsigned int nsid, struct nvme_id_ns *ns, unsigned int lba_index, bool cap_only);
 	void (*persistent_event_log)(void *pevent_log_info, __u8 action, __u32 size, const char *devname);
+	void (*persistent_event)(void *pevent_log_info, __u32 offset, __u32 event_number, const char *devname);
 	void (*predictable_latency_event_agg_log)(struct nvme_aggregate_predictable_lat_event *pea_log, __u64 log_entries, __u32 size, const char *devname);
 	void (*predictable_latency_per_nvmset)(struct nvme_nvmset_predictable_lat_log *plpns_log, __u16 nvmset_id, const char *devname);
+	void (*predictable_latency_nvmset_batch)(struct nvme_log_batch_entry *e, int nr, const char *devname);
 	void (*primary_ctrl_cap)(const struct nvme_primary_ctrl_cap *caps);
 	void (*resv_notification_log)(struct nvme_resv_notification_log *resv, const char *devname);
 	void (*resv_report)(struct nvme_resv_status *status, int bytes, bool eds);
+	void (*resv_table)(struct nvme_resv_ns *list, int nr);
+	void (*smart_ns_table)(struct nvme_smart_ns *list, int nr, const char *devname);
+	void (*resv_batch)(struct nvme_resv_batch *batch);
 	void (*sanitize_log_page)(struct nvme_sanitize_log_page *sanitize_log, const char *devname);
 	void (*secondary_ctrl_list)(const struct nvme_secondary_ctrl_list *sc_list, __u32 count);
 	void (*select_result)(enum nvme_features_id fid, __u32 result);
 	void (*self_test_log)(struct nvme_self_test_log *self_test, __u8 dst_entries, __u32 size, const char *devname);
 	void (*single_property)(int offset, uint64_t value64);
 	void (*smart_log)(struct nvme_smart_log *smart, unsigned int nsid, const char *devname);
+	void (*streams)(struct nvme_streams *s);
+	void (*cap_layout)(struct nvme_cap_layout *l);
 	void (*supported_cap_config_list_log)(struct nvme_supported_cap_config_list_log *cap_log);
 	void (*supported_log_pages)(struct nvme_supported_log_pages *support_log, const char *devname);
 	void (*zns_start_zone_list)(__u64 nr_zones, struct json_object **zone_list);
@@ -80,6 +127,7 @@ struct print_ops {
 	void (*zns_id_ctrl)(struct nvme_zns_id_ctrl *ctrl);
 	void (*zns_id_ns)(struct nvme_zns_id_ns *ns, struct nvme_id_ns *id_ns);
 	void (*zns_report_zones)(void *report, __u32 descs, __u8 ext_size, __u32 report_size, struct json_object *zone_list);
+	void (*zns_zone_summary)(struct nvme_zone_summary *summary);
 	void (*show_feature)(enum nvme_features_id fid, int sel, unsigned int result);
 	void (*show_feature_fields)(enum nvme_features_id fid, unsigned int result, unsigned char *buf);
 	void (*id_ctrl_rpmbs)(__le32 ctrl_rpmbs);
@@ -92,6 +140,9 @@ struct print_ops {
 	/* libnvme tree print functions */
 	void (*list_item)(nvme_ns_t n);
 	void (*list_items)(nvme_root_t t);
+	void (*list_fast)(struct nvme_list_fast_ns *ns, int nr_ns);
+	void (*watch_event)(enum nvme_watch_action action, struct nvme_watch_obj *obj);
+	void (*aen_event)(const struct nvme_watch_aen *aen);
 	void (*print_nvme_subsystem_list)(nvme_root_t r, bool show_ana);
 	void (*topology_ctrl)(nvme_root_t r);
 	void (*topology_namespace)(nvme_root_t r);
@@ -104,6 +155,7 @@ struct print_ops {
 	void (*show_error_status)(int status, const char *msg, va_list ap);
 
 	enum nvme_print_flags flags;
+	bool arena;		/* the ops name the members with json_arena keys */
 };
 
 struct nvme_bar_cap {
@@ -131,6 +183,16 @@ struct nvme_bar_cap {
 
 struct print_ops *nvme_get_json_print_ops(enum nvme_print_flags flags);
 
+/*
+ * json_show_capture - hand the objects of the json print ops to the caller
+ *
+ * While set, a json print op of the calling thread stores its object in
+ * *@o, freeing the one stored before, instead of printing it. NULL prints
+ * again. The print ops building a single object may be used by several
+ * threads this way, the ones collecting into a shared root may not.
+ */
+void json_show_capture(struct json_object **o);
+
 #else /* !CONFIG_JSONC */
 
 static inline struct print_ops *nvme_get_json_print_ops(enum nvme_print_flags flags) { return NULL; }
@@ -153,6 +215,15 @@ void nvme_show_id_ns(struct nvme_id_ns *ns, unsigned int nsid,
 void nvme_show_cmd_set_independent_id_ns(
 	struct nvme_id_independent_id_ns *ns, unsigned int nsid,
 	enum nvme_print_flags flags);
+void nvme_show_resv_batch(struct nvme_resv_batch *batch, enum nvme_print_flags flags);
+void nvme_show_streams(struct nvme_streams *s, enum nvme_print_flags flags);
+void nvme_show_cap_layout(struct nvme_cap_layout *l, enum nvme_print_flags flags);
+void nvme_show_resv_table(struct nvme_resv_ns *list, int nr, enum nvme_print_flags flags);
+void nvme_show_smart_ns_table(struct nvme_smart_ns *list, int nr, const char *devname,
+			      enum nvme_print_flags flags);
+void nvme_show_id_ns_all(struct nvme_id_ns_entry *list, int nr, enum nvme_print_flags flags);
+void nvme_show_id_ns_descs_all(struct nvme_id_ns_entry *list, int nr,
+			       enum nvme_print_flags flags);
 void nvme_show_resv_report(struct nvme_resv_status *status, int bytes, bool eds,
 	enum nvme_print_flags flags);
 void nvme_show_lba_range(struct nvme_lba_range_type *lbrt, int nr_ranges,
@@ -165,6 +236,8 @@ void nvme_show_smart_log(struct nvme_smart_log *smart, unsigned int nsid,
 	const char *devname, enum nvme_print_flags flags);
 void nvme_show_ana_log(struct nvme_ana_log *ana_log, const char *devname,
 		       size_t len, enum nvme_print_flags flags);
+void nvme_show_ana_transition(const struct nvme_ana_transition *t, const char *devname,
+			      enum nvme_print_flags flags);
 void nvme_show_self_test_log(struct nvme_self_test_log *self_test, __u8 dst_entries,
 	__u32 size, const char *devname, enum nvme_print_flags flags);
 void nvme_show_fw_log(struct nvme_firmware_slot *fw_log, const char *devname,
@@ -175,11 +248,15 @@ void nvme_show_changed_ns_list_log(struct nvme_ns_list *log,
 	const char *devname, enum nvme_print_flags flags);
 void nvme_show_endurance_log(struct nvme_endurance_group_log *endurance_log,
 	__u16 group_id, const char *devname, enum nvme_print_flags flags);
+void nvme_show_endurance_log_batch(struct nvme_log_batch_entry *e, int nr,
+				   const char *devname, enum nvme_print_flags flags);
 void nvme_show_sanitize_log(struct nvme_sanitize_log_page *sanitize,
 	const char *devname, enum nvme_print_flags flags);
 void nvme_show_predictable_latency_per_nvmset(
 	struct nvme_nvmset_predictable_lat_log *plpns_log,
 	__u16 nvmset_id, const char *devname, enum nvme_print_flags flags);
+void nvme_show_predictable_latency_nvmset_batch(struct nvme_log_batch_entry *e, int nr,
+						const char *devname, enum nvme_print_flags flags);
 void nvme_show_predictable_latency_event_agg_log(
 	struct nvme_aggregate_predictable_lat_event *pea_log,
 	__u64 log_entries, __u32 size, const char *devname,
@@ -187,6 +264,9 @@ void nvme_show_predictable_latency_event_agg_log(
 void nvme_show_persistent_event_log(void *pevent_log_info,
 	__u8 action, __u32 size, const char *devname,
 	enum nvme_print_flags flags);
+void nvme_show_persistent_event(void *pevent_log_info, __u32 offset,
+	__u32 event_number, const char *devname,
+	enum nvme_print_flags flags);
 void nvme_show_endurance_group_event_agg_log(
 	struct nvme_aggregate_predictable_lat_event *endurance_log,
 	__u64 log_entries, __u32 size, const char *devname,
@@ -214,6 +294,12 @@ void nvme_show_id_ns_descs(void *data, unsigned nsid, enum nvme_print_flags flag
 void nvme_show_lba_status(struct nvme_lba_status *list, unsigned long len,
 	enum nvme_print_flags flags);
 void nvme_show_list_items(nvme_root_t t, enum nvme_print_flags flags);
+void nvme_show_list_fast(struct nvme_list_fast_ns *ns, int nr_ns,
+	enum nvme_print_flags flags);
+void nvme_show_watch_event(enum nvme_watch_action action,
+	struct nvme_watch_obj *obj, enum nvme_print_flags flags);
+void nvme_show_aen_event(const struct nvme_watch_aen *aen,
+	enum nvme_print_flags flags);
 void nvme_show_subsystem_list(nvme_root_t t, bool show_ana,
 			      enum nvme_print_flags flags);
 void nvme_show_id_nvmset(struct nvme_id_nvmset_list *nvmset, unsigned nvmset_id,
@@ -226,6 +312,49 @@ void nvme_show_id_ns_granularity_list(const struct nvme_id_ns_granularity_list *
 	enum nvme_print_flags flags);
 void nvme_show_id_uuid_list(const struct nvme_id_uuid_list *uuid_list,
 	enum nvme_print_flags flags);
+void nvme_show_io_stats(const char *name, struct nvme_io_stats *stats,
+	enum nvme_print_flags flags);
+void nvme_show_io_sweep(struct nvme_io_sweep *sweep, enum nvme_print_flags flags);
+void nvme_show_path_probe(struct nvme_path_probe *probe, enum nvme_print_flags flags);
+void nvme_show_queue_advice(struct nvme_queue_advice *advice, enum nvme_print_flags flags);
+void nvme_show_hash_compare(struct nvme_hash_compare *hc, enum nvme_print_flags flags);
+void nvme_show_fdp_write(struct nvme_fdp_write *fw, enum nvme_print_flags flags);
+void nvme_show_fdp_sample(struct nvme_fdp_sample *sample, enum nvme_print_flags flags);
+void nvme_show_smart_sample(struct nvme_smart_sample *sample, enum nvme_print_flags flags);
+void nvme_show_thermal_sample(struct nvme_thermal_sample *sample, enum nvme_print_flags flags);
+void nvme_show_thermal_episode(struct nvme_thermal_episode *episode,
+			       enum nvme_print_flags flags);
+void nvme_show_thermal_summary(struct nvme_thermal_summary *summary,
+			       enum nvme_print_flags flags);
+void nvme_show_plm_event(struct nvme_plm_event *event, enum nvme_print_flags flags);
+void nvme_show_plm_summary(struct nvme_plm_summary *summary, enum nvme_print_flags flags);
+void nvme_show_power_bench(struct nvme_power_bench *pb, enum nvme_print_flags flags);
+void nvme_show_tune_sweep(struct nvme_tune_sweep *ts, enum nvme_print_flags flags);
+void nvme_show_flush_bench(struct nvme_flush_bench *fb, enum nvme_print_flags flags);
+void nvme_show_pmr_bench(struct nvme_pmr_bench *pb, enum nvme_print_flags flags);
+void nvme_show_io_bench_sample(struct nvme_io_bench_sample *sample,
+			       enum nvme_print_flags flags);
+void nvme_show_io_bench_multi(struct nvme_io_bench_multi *m, enum nvme_print_flags flags);
+void nvme_show_dsm_bench(struct nvme_dsm_bench *b, enum nvme_print_flags flags);
+void nvme_show_cw_bench(struct nvme_cw_bench *b, enum nvme_print_flags flags);
+void nvme_show_mi_poll_sample(struct nvme_mi_poll_sample *sample, enum nvme_print_flags flags);
+void nvme_show_reg_sample(struct nvme_reg_sample *sample, enum nvme_print_flags flags);
+void nvme_show_latency_hist(const char *name, struct nvme_hist *lat,
+	enum nvme_print_flags flags);
+void nvme_show_lat_sample(struct nvme_lat_sample *sample, enum nvme_print_flags flags);
+void nvme_show_replay(struct nvme_replay *replay, enum nvme_print_flags flags);
+void nvme_show_collect(struct nvme_collect_dev *devs, int nr_devs,
+	enum nvme_print_flags flags);
+void nvme_show_fw_rollout(struct nvme_fw_rollout_dev *devs, int nr_devs,
+	enum nvme_print_flags flags);
+void nvme_show_self_test_run(struct nvme_self_test_dev *devs, int nr_devs,
+	enum nvme_print_flags flags);
+void nvme_show_sanitize_run(struct nvme_sanitize_dev *devs, int nr_devs,
+	enum nvme_print_flags flags);
+void nvme_show_format_run(struct nvme_format_dev *devs, int nr_devs, __u64 wall_ns,
+			  enum nvme_print_flags flags);
+void nvme_show_provision_ns(struct nvme_provision *p, enum nvme_print_flags flags);
+void nvme_show_virt_provision(struct nvme_virt_provision *p, enum nvme_print_flags flags);
 void nvme_show_list_ctrl(struct nvme_ctrl_list *ctrl_list,
 	 enum nvme_print_flags flags);
 void nvme_show_id_domain_list(struct nvme_id_domain_list *id_dom,
@@ -263,6 +392,8 @@ void nvme_show_zns_report_zones(void *report, __u32 descs,
 				__u8 ext_size, __u32 report_size,
 				struct json_object *zone_list,
 				enum nvme_print_flags flags);
+void nvme_show_zns_zone_summary(struct nvme_zone_summary *summary,
+				enum nvme_print_flags flags);
 void json_nvme_finish_zone_list(__u64 nr_zones, 
 	struct json_object *zone_list);
 void nvme_show_list_item(nvme_ns_t n);
@@ -273,6 +404,8 @@ void nvme_show_fdp_stats(struct nvme_fdp_stats_log *log,
 		enum nvme_print_flags flags);
 void nvme_show_fdp_events(struct nvme_fdp_events_log *log,
 		enum nvme_print_flags flags);
+void nvme_show_fdp_event(struct nvme_fdp_event *event, bool host,
+		enum nvme_print_flags flags);
 void nvme_show_fdp_usage(struct nvme_fdp_ruhu_log *log, size_t len,
 		enum nvme_print_flags flags);
 void nvme_show_fdp_ruh_status(struct nvme_fdp_ruh_status *status, size_t len,
@@ -284,6 +417,8 @@ void nvme_show_connect_msg(nvme_ctrl_t c, enum nvme_print_flags flags);
 
 const char *nvme_ana_state_to_string(enum nvme_ana_state state);
 const char *nvme_cmd_to_string(int admin, __u8 opcode);
+const char *nvme_fw_rollout_stage_to_string(enum nvme_fw_rollout_stage stage);
+const char *nvme_self_test_result_to_string(__u8 result);
 const char *nvme_fdp_event_to_string(enum nvme_fdp_event_type event);
 const char *nvme_feature_lba_type_to_string(__u8 type);
 const char *nvme_feature_temp_sel_to_string(__u8 sel);
@@ -302,7 +437,12 @@ const char *nvme_register_symbol_to_string(int offset);
 const char *nvme_resv_notif_to_string(__u8 type);
 const char *nvme_select_to_string(int sel);
 const char *nvme_sstat_status_to_string(__u16 status);
+const char *nvme_sanitize_result_to_string(__u16 status);
 const char *nvme_trtype_to_string(__u8 trtype);
+const char *nvme_resv_type_to_string(__u8 rtype);
+const char *nvme_cap_layout_op_to_string(__u8 op);
+int nvme_resv_registrant(struct nvme_resv_ns *ns, int i, __u16 *cntlid, __u8 *rcsts,
+			 __u64 *rkey, char *hostid, size_t len);
 const char *nvme_zone_state_to_string(__u8 state);
 const char *nvme_zone_type_to_string(__u8 cond);
 const char *nvme_plm_window_to_string(__u32 plm);
@@ -33,6 +33,7 @@
 #include "nvme.h"
 #include "libnvme.h"
 #include "nvme-print.h"
+#include "util/sha256.h"
 
 #define CREATE_CMD
 
@@ -44,9 +45,7 @@
 #define SOL_ALG 279
 #endif
 
-#define HMAC_SHA256_ALGO_NAME		"hmac(sha256)"
 #define MD5_HASH_ALGO_NAME		"md5"
-#define HMAC_SHA256_HASH_SIZE		32
 #define MD5_HASH_HASH_SIZE		16
 
 /*
@@ -129,20 +128,6 @@ out_close_infd:
 	return hash;
 }
 
-/* Function that computes hmac-sha256 hash of given data and key pair. Returns
- * byte stream (non-null terminated) upon success, NULL otherwise.
- */
-unsigned char *
-hmac_sha256(unsigned char *data, int datalen, unsigned char *key, int keylen)
-{
-	return create_hash(HMAC_SHA256_ALGO_NAME,
-			   HMAC_SHA256_HASH_SIZE,
-			   data,
-			   datalen,
-			   key,
-			   keylen);
-}
-
 /* Function that computes md5 of given buffer - md5 hash is used as nonce
  * Returns byte stream (non-null terminated) upon success, NULL otherwise.
  */
@@ -638,7 +623,6 @@ static int auth_data_write_chunk(int fd, unsigned char tgt, unsigned int addr,
 	struct rpmb_data_frame_t *rsp = NULL;
 	
 	unsigned int write_cntr = 0;
-	unsigned char *mac = NULL;
 	int error  = -ENOMEM;
 
 	/* get current write counter and copy to the request  */
@@ -659,15 +643,8 @@ static int auth_data_write_chunk(int fd, unsigned char tgt, unsigned int addr,
 	req->write_counter = write_cntr;
 
 	/* compute HMAC hash */
-	mac = hmac_sha256(((unsigned char *)req + 223), req_size - 223,
-			   keybuf, keysize);
-	if (mac == NULL) {
-		fprintf(stderr, "failed to compute HMAC-SHA256\n");
-		error = -1;
-		goto out;
-	}
-
-	memcpy(req->mac, mac, 32);
+	hmac_sha256(keybuf, keysize, (unsigned char *)req + 223, req_size - 223,
+		    req->mac);
 	
 	/* send the request and get response */
 	error = send_rpmb_req(fd, tgt, req_size, req);
@@ -698,7 +675,6 @@ static int auth_data_write_chunk(int fd, unsigned char tgt, unsigned int addr,
 out:
 	free(req);
 	free(rsp);
-	free(mac);
 
 	return error;
 }
@@ -732,6 +708,113 @@ static int rpmb_auth_data_write(int fd, unsigned char target,
 	return offset;
 }
 
+/* Implementation of bulk RPMB authenticated data write: the write counter
+ * is read once and then tracked locally, the frames of all chunks go out
+ * back to back with one Security Send each, and the result is read once
+ * at the end. Once a frame fails the controller refuses all later ones
+ * with a counter failure, so the written chunks are always a prefix and
+ * the final write counter tells how many made it. Returns the number of
+ * bytes written, a negative error code if nothing could be sent.
+ */
+static int rpmb_auth_data_write_bulk(int fd, unsigned char target,
+				     unsigned int addr, int acc_size,
+				     unsigned char *msg_buf, int msg_size,
+				     unsigned char *keybuf, int keysize,
+				     int *frames)
+{
+	int hdr_size = sizeof(struct rpmb_data_frame_t);
+	int chunk_size = acc_size < msg_size ? acc_size : msg_size;
+	struct rpmb_data_frame_t *req = NULL;
+	struct rpmb_data_frame_t *rsp = NULL;
+	unsigned int start_cntr, write_cntr;
+	struct hmac_sha256_key hmac;
+	int offset = 0, xfer;
+	int sent = 0;
+	int error;
+
+	*frames = 0;
+
+	error = rpmb_read_write_counter(fd, target, &start_cntr);
+	if (error != 0) {
+		fprintf(stderr, "Failed to read write counter for write-data\n");
+		return -EIO;
+	}
+
+	hmac_sha256_setkey(&hmac, keybuf, keysize);
+
+	req = (struct rpmb_data_frame_t *)calloc(hdr_size + chunk_size, 1);
+	rsp = (struct rpmb_data_frame_t *)calloc(hdr_size, 1);
+	if (req == NULL || rsp == NULL) {
+		fprintf(stderr, "Memory alloc failed for write-data command\n");
+		error = -ENOMEM;
+		goto out;
+	}
+
+	write_cntr = start_cntr;
+	while (offset < msg_size) {
+		xfer = msg_size - offset < chunk_size ? msg_size - offset : chunk_size;
+
+		memset(req, 0, hdr_size);
+		req->type = RPMB_REQ_AUTH_DATA_WRITE;
+		req->target = target;
+		req->address = addr + offset / 512;
+		req->sectors = xfer / 512;
+		req->write_counter = write_cntr;
+		memcpy(req->data, msg_buf + offset, xfer);
+
+		hmac_sha256_mac(&hmac, (unsigned char *)req + 223,
+				hdr_size + xfer - 223, req->mac);
+
+		error = send_rpmb_req(fd, target, hdr_size + xfer, req);
+		if (error != 0) {
+			fprintf(stderr, "RPMB request 0x%04x for 0x%x, error: %d\n",
+				req->type, target, error);
+			break;
+		}
+
+		write_cntr++;
+		offset += xfer;
+		sent++;
+	}
+
+	if (!sent) {
+		error = error ? error : -EIO;
+		goto out;
+	}
+
+	/* the result of the last frame also reports an earlier failure */
+	rsp->target = target;
+	rsp->type = RPMB_REQ_READ_RESULT;
+	error = send_rpmb_req(fd, target, hdr_size, rsp);
+	if (error == 0) {
+		memset(rsp, 0, hdr_size);
+		error = recv_rpmb_rsp(fd, target, hdr_size, rsp);
+	}
+	if (error != 0)
+		fprintf(stderr, "Write-data read result error = 0x%x\n", error);
+	else if (rsp->result)
+		check_rpmb_response(req, rsp, "Failed to write-data");
+
+	if (error == 0 && rsp->result == 0) {
+		write_cntr = start_cntr + sent;
+	} else if (rpmb_read_write_counter(fd, target, &write_cntr) != 0) {
+		fprintf(stderr, "Failed to read back the write counter\n");
+		write_cntr = start_cntr;
+	}
+
+	*frames = write_cntr - start_cntr;
+	if (*frames > sent)
+		*frames = sent;
+	offset = *frames * chunk_size;
+	error = offset < msg_size ? offset : msg_size;
+out:
+	memset(&hmac, 0, sizeof(hmac));
+	free(req);
+	free(rsp);
+
+	return error;
+}
+
 /* writes given config_block buffer to the drive target 0 */
 static int rpmb_write_config_block(int fd, unsigned char *cfg_buf,
 				   unsigned char *keybuf, int keysize)
@@ -742,7 +825,7 @@ static int rpmb_write_config_block(int fd, unsigned char *cfg_buf,
 	
 	struct rpmb_data_frame_t *req = NULL;
 	struct rpmb_data_frame_t *rsp = NULL;
-	unsigned char *cfg_buf_read = NULL, *mac = NULL;
+	unsigned char *cfg_buf_read = NULL;
 	unsigned int write_cntr = 0;
 	int   error = -ENOMEM;
 	
@@ -765,15 +848,8 @@ static int rpmb_write_config_block(int fd, unsigned char *cfg_buf,
 
 	free(cfg_buf_read);
 	req->write_counter = write_cntr;
-	mac = hmac_sha256(((unsigned char *)req + 223), req_size - 223,
-			   keybuf, keysize);
-	if (mac == NULL) {
-		fprintf(stderr, "failed to compute hmac-sha256 hash\n");
-		error = -EINVAL;
-	    	goto out;
-	}
-	
-	memcpy(req->mac, mac, sizeof(req->mac)); 
+	hmac_sha256(keybuf, keysize, (unsigned char *)req + 223, req_size - 223,
+		    req->mac);
 	
 	error = send_rpmb_req(fd, 0, req_size, req);
 	if (error != 0) {
@@ -806,7 +882,6 @@ static int rpmb_write_config_block(int fd, unsigned char *cfg_buf,
 out:
 	free(req);
 	free(rsp);
-	free(mac);
 	
 	return error;
 }
@@ -828,6 +903,8 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 	const char *address = "Sector offset to read from or write to for an RPMB target, default 0";
 	const char *blocks  = "Number of 512 blocks to read or write";
 	const char *key     = "key to be used for authentication";
+	const char *bulk    = "write-data: send all frames back to back, tracking the\n" \
+			      "write counter locally, and report the throughput";
 	const char *opt     = "RPMB action - info, program-key, read-counter, write-data, " \
 			      "read-data, write-config and read-config";
 	
@@ -841,6 +918,7 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 		int  address;
 		int  blocks; 
 		char target;
+		bool bulk;
 	};
 	
 	struct config cfg = {
@@ -853,6 +931,7 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 		.address = 0,
 		.blocks  = 0,
 		.target  = 0,
+		.bulk    = false,
 	};
 	
 	OPT_ARGS(opts) = {
@@ -864,6 +943,7 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 		OPT_UINT("address",   'o', &cfg.address,  address),
 		OPT_UINT("blocks",    'b', &cfg.blocks,   blocks),
 		OPT_UINT("target",    't', &cfg.target,   target),
+		OPT_FLAG("bulk",      'B', &cfg.bulk,     bulk),
 		OPT_END()
 	};
 	
@@ -872,6 +952,8 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 	unsigned char *msg_buf = NULL;
 	unsigned int msg_size = 0;
 	unsigned int key_size = 0;
+	__u64 start_ns, elapsed_ns;
+	int frames = 0;
 	struct nvme_id_ctrl ctrl;
 	struct nvme_dev *dev;
 	int err = -1;
@@ -1021,6 +1103,25 @@ int rpmb_cmd_option(int argc, char **argv, struct command *cmd, struct plugin *p
 			} else if ((cfg.blocks * 512) < msg_size) {
 				msg_size = cfg.blocks * 512;
 			}
+			if (cfg.bulk) {
+				start_ns = monotonic_ns();
+				err = rpmb_auth_data_write_bulk(dev_fd(dev), cfg.target,
+								cfg.address,
+								((regs.access_size + 1) * 512),
+								msg_buf, msg_size,
+								key_buf, key_size, &frames);
+				elapsed_ns = monotonic_ns() - start_ns;
+				if (err < 0)
+					break;
+
+				printf("Written %d sectors out of %d @target(%d):0x%x\n",
+					err/512, msg_size/512, cfg.target, cfg.address);
+				printf("%d frames in %.3f ms, %.1f KiB/s\n", frames,
+				       elapsed_ns / 1e6,
+				       elapsed_ns ? err / 1024.0 / (elapsed_ns / 1e9) : 0);
+				err = err == msg_size ? 0 : -EIO;
+				break;
+			}
 			err = rpmb_auth_data_write(dev_fd(dev), cfg.target,
 						   cfg.address,
 						  ((regs.access_size + 1) * 512),
@@ -0,0 +1,504 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * config-snapshot and config-diff: a canonical document of the settings
+ * of a controller and a structural comparison of two of them.
+ */
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "nvme-print.h"
+#include "nvme-snapshot.h"
+#include "util/capture.h"
+#include "util/json.h"
+
+#define snap_add(o, k, v) \
+	json_object_object_add(o, k, json_object_new_int64(v))
+
+static void snap_add_str(struct json_object *o, const char *k, const char *v,
+			 size_t len)
+{
+	char s[512];
+
+	/* the identify strings are space padded, not NUL terminated */
+	while (len && (v[len - 1] == ' ' || !v[len - 1]))
+		len--;
+	snprintf(s, sizeof(s), "%.*s", (int)len, v);
+	json_object_add_value_string(o, k, s);
+}
+
+static void snap_add_hex(struct json_object *o, const char *k, const void *data,
+			 __u32 len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const __u8 *p = data;
+	char *s;
+	__u32 i;
+
+	s = malloc(2 * len + 1);
+	if (!s)
+		return;
+	for (i = 0; i < len; i++) {
+		s[2 * i] = hex[p[i] >> 4];
+		s[2 * i + 1] = hex[p[i] & 0xf];
+	}
+	s[2 * len] = '\0';
+	json_object_add_value_string(o, k, s);
+	free(s);
+}
+
+static struct json_object *snap_identity(const struct nvme_id_ctrl *ctrl)
+{
+	struct json_object *r = json_create_object();
+
+	snap_add_str(r, "sn", ctrl->sn, sizeof(ctrl->sn));
+	snap_add(r, "cntlid", le16_to_cpu(ctrl->cntlid));
+	snap_add_str(r, "subnqn", ctrl->subnqn, sizeof(ctrl->subnqn));
+
+	return r;
+}
+
+static struct json_object *snap_controller(const struct nvme_id_ctrl *ctrl)
+{
+	struct json_object *r = json_create_object();
+
+	snap_add(r, "vid", le16_to_cpu(ctrl->vid));
+	snap_add(r, "ssvid", le16_to_cpu(ctrl->ssvid));
+	snap_add_str(r, "mn", ctrl->mn, sizeof(ctrl->mn));
+	snap_add_str(r, "fr", ctrl->fr, sizeof(ctrl->fr));
+	snap_add(r, "ieee", ctrl->ieee[2] << 16 | ctrl->ieee[1] << 8 | ctrl->ieee[0]);
+	snap_add(r, "cmic", ctrl->cmic);
+	snap_add(r, "mdts", ctrl->mdts);
+	snap_add(r, "ver", le32_to_cpu(ctrl->ver));
+	snap_add(r, "oaes", le32_to_cpu(ctrl->oaes));
+	snap_add(r, "ctratt", le32_to_cpu(ctrl->ctratt));
+	snap_add(r, "oacs", le16_to_cpu(ctrl->oacs));
+	snap_add(r, "acl", ctrl->acl);
+	snap_add(r, "aerl", ctrl->aerl);
+	snap_add(r, "frmw", ctrl->frmw);
+	snap_add(r, "lpa", ctrl->lpa);
+	snap_add(r, "elpe", ctrl->elpe);
+	snap_add(r, "npss", ctrl->npss);
+	snap_add(r, "apsta", ctrl->apsta);
+	snap_add(r, "wctemp", le16_to_cpu(ctrl->wctemp));
+	snap_add(r, "cctemp", le16_to_cpu(ctrl->cctemp));
+	snap_add(r, "hmpre", le32_to_cpu(ctrl->hmpre));
+	snap_add(r, "hmmin", le32_to_cpu(ctrl->hmmin));
+	snap_add(r, "kas", le16_to_cpu(ctrl->kas));
+	snap_add(r, "hctma", le16_to_cpu(ctrl->hctma));
+	snap_add(r, "mntmt", le16_to_cpu(ctrl->mntmt));
+	snap_add(r, "mxtmt", le16_to_cpu(ctrl->mxtmt));
+	snap_add(r, "sanicap", le32_to_cpu(ctrl->sanicap));
+	snap_add(r, "anacap", ctrl->anacap);
+	snap_add(r, "sqes", ctrl->sqes);
+	snap_add(r, "cqes", ctrl->cqes);
+	snap_add(r, "maxcmd", le16_to_cpu(ctrl->maxcmd));
+	snap_add(r, "nn", le32_to_cpu(ctrl->nn));
+	snap_add(r, "oncs", le16_to_cpu(ctrl->oncs));
+	snap_add(r, "fuses", le16_to_cpu(ctrl->fuses));
+	snap_add(r, "fna", ctrl->fna);
+	snap_add(r, "vwc", ctrl->vwc);
+	snap_add(r, "awun", le16_to_cpu(ctrl->awun));
+	snap_add(r, "awupf", le16_to_cpu(ctrl->awupf));
+	snap_add(r, "sgls", le32_to_cpu(ctrl->sgls));
+	snap_add(r, "mnan", le32_to_cpu(ctrl->mnan));
+
+	return r;
+}
+
+static struct json_object *snap_power_states(const struct nvme_id_ctrl *ctrl)
+{
+	struct json_object *r = json_create_array(), *psd;
+	const struct nvme_id_psd *p;
+	int i;
+
+	for (i = 0; i <= ctrl->npss; i++) {
+		p = &ctrl->psd[i];
+		psd = json_create_object();
+		/* the first member is the key of the power states, see diff_array_key() */
+		snap_add(psd, "ps", i);
+		snap_add(psd, "mp", le16_to_cpu(p->mp));
+		snap_add(psd, "flags", p->flags);
+		snap_add(psd, "enlat", le32_to_cpu(p->enlat));
+		snap_add(psd, "exlat", le32_to_cpu(p->exlat));
+		snap_add(psd, "rrt", p->rrt);
+		snap_add(psd, "rrl", p->rrl);
+		snap_add(psd, "rwt", p->rwt);
+		snap_add(psd, "rwl", p->rwl);
+		snap_add(psd, "idlp", le16_to_cpu(p->idlp));
+		snap_add(psd, "ips", p->ips);
+		snap_add(psd, "actp", le16_to_cpu(p->actp));
+		snap_add(psd, "apws", p->apws);
+		json_array_add_value_object(r, psd);
+	}
+
+	return r;
+}
+
+struct json_object *nvme_snapshot_new(const struct nvme_id_ctrl *ctrl)
+{
+	struct json_object *r = json_create_object();
+
+	snap_add(r, "version", NVME_SNAPSHOT_VERSION);
+	json_object_add_value_object(r, "identity", snap_identity(ctrl));
+	json_object_add_value_object(r, "controller", snap_controller(ctrl));
+	json_object_add_value_array(r, "power_states", snap_power_states(ctrl));
+	json_object_add_value_object(r, "features", json_create_object());
+	json_object_add_value_array(r, "namespaces", json_create_array());
+
+	return r;
+}
+
+bool nvme_snapshot_volatile_feature(__u8 fid)
+{
+	return fid == NVME_FEAT_FID_TIMESTAMP;
+}
+
+void nvme_snapshot_add_feature(struct json_object *snap,
+			       const struct nvme_snapshot_feature *f)
+{
+	struct json_object *features, *feat = json_create_object();
+	char fid[8];
+
+	json_object_add_value_string(feat, "name", nvme_feature_to_string(f->fid));
+	snap_add(feat, "current", f->current);
+	if (f->data)
+		snap_add_hex(feat, "data", f->data, f->data_len);
+	if (f->saved_valid) {
+		snap_add(feat, "saved", f->saved);
+		if (f->saved_data)
+			snap_add_hex(feat, "saved_data", f->saved_data, f->data_len);
+	}
+
+	snprintf(fid, sizeof(fid), "0x%02x", f->fid);
+	json_object_object_get_ex(snap, "features", &features);
+	json_object_add_value_object(features, fid, feat);
+}
+
+void nvme_snapshot_add_ns(struct json_object *snap, __u32 nsid,
+			  const struct nvme_id_ns *ns)
+{
+	struct json_object *namespaces, *r = json_create_object();
+	__u8 lbaf;
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lbaf);
+
+	/* the first member is the key of the namespaces, see diff_array_key() */
+	snap_add(r, "nsid", nsid);
+	snap_add(r, "nsze", le64_to_cpu(ns->nsze));
+	snap_add(r, "ncap", le64_to_cpu(ns->ncap));
+	snap_add(r, "nsfeat", ns->nsfeat);
+	snap_add(r, "flbas", ns->flbas);
+	snap_add(r, "lbads", ns->lbaf[lbaf].ds);
+	snap_add(r, "ms", le16_to_cpu(ns->lbaf[lbaf].ms));
+	snap_add(r, "dpc", ns->dpc);
+	snap_add(r, "dps", ns->dps);
+	snap_add(r, "nmic", ns->nmic);
+	snap_add(r, "rescap", ns->rescap);
+	snap_add(r, "nsattr", ns->nsattr);
+	snap_add(r, "anagrpid", le32_to_cpu(ns->anagrpid));
+	snap_add(r, "nvmsetid", le16_to_cpu(ns->nvmsetid));
+	snap_add(r, "endgid", le16_to_cpu(ns->endgid));
+
+	json_object_object_get_ex(snap, "namespaces", &namespaces);
+	json_array_add_value_object(namespaces, r);
+}
+
+int nvme_snapshot_load(const char *file, struct json_object **snap)
+{
+	struct json_object *version = NULL;
+	struct json_tokener *tok;
+	struct nvme_capture c;
+	const char *p;
+	int err;
+
+	err = nvme_capture_map(file, &c);
+	if (err)
+		return err;
+
+	p = c.data;
+	if (*p == '{') {
+		if (c.len > INT_MAX) {
+			nvme_capture_unmap(&c);
+			return -EFBIG;
+		}
+		tok = json_tokener_new();
+		*snap = tok ? json_tokener_parse_ex(tok, p, c.len) : NULL;
+		if (tok && json_tokener_get_error(tok) != json_tokener_success) {
+			json_free_object(*snap);
+			*snap = NULL;
+		}
+		if (tok)
+			json_tokener_free(tok);
+	} else {
+		*snap = util_json_read_cbor(c.data, c.len);
+	}
+	nvme_capture_unmap(&c);
+
+	if (!*snap || !json_object_is_type(*snap, json_type_object) ||
+	    !json_object_object_get_ex(*snap, "version", &version) ||
+	    json_object_get_int64(version) != NVME_SNAPSHOT_VERSION) {
+		json_free_object(*snap);
+		*snap = NULL;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+struct snapshot_diff {
+	char **ignore;
+	int nr_ignore;
+	struct json_object *list;	/* of the differences, for JSON */
+	int nr;
+};
+
+/* @path or one of its parents is ignored */
+static bool diff_ignored(struct snapshot_diff *d, const char *path)
+{
+	size_t len;
+	int i;
+
+	for (i = 0; i < d->nr_ignore; i++) {
+		len = strlen(d->ignore[i]);
+		if (!strncmp(path, d->ignore[i], len) &&
+		    (!path[len] || path[len] == '.' || path[len] == '['))
+			return true;
+	}
+
+	return false;
+}
+
+static const char *diff_str(struct json_object *o)
+{
+	return o ? json_object_to_json_string_ext(o, JSON_C_TO_STRING_PLAIN) : "(none)";
+}
+
+static void diff_report(struct snapshot_diff *d, const char *path,
+			struct json_object *old, struct json_object *new)
+{
+	struct json_object *r;
+
+	d->nr++;
+
+	if (!d->list) {
+		printf("%s: %s", path, diff_str(old));
+		printf(" -> %s\n", diff_str(new));
+		return;
+	}
+
+	r = json_create_object();
+	json_object_add_value_string(r, "path", path);
+	json_object_object_add(r, "old", json_object_get(old));
+	json_object_object_add(r, "new", json_object_get(new));
+	json_array_add_value_object(d->list, r);
+}
+
+static void diff_value(struct snapshot_diff *d, const char *path,
+		       struct json_object *old, struct json_object *new);
+
+static char *diff_path(const char *path, const char *key)
+{
+	char *s;
+
+	if (asprintf(&s, "%s%s%s", path, *path ? "." : "", key) < 0)
+		return NULL;
+	return s;
+}
+
+static void diff_object(struct snapshot_diff *d, const char *path,
+			struct json_object *old, struct json_object *new)
+{
+	struct json_object *v;
+	char *sub;
+
+	json_object_object_foreach(old, key, val) {
+		sub = diff_path(path, key);
+		if (!sub)
+			continue;
+		if (json_object_object_get_ex(new, key, &v))
+			diff_value(d, sub, val, v);
+		else if (!diff_ignored(d, sub))
+			diff_report(d, sub, val, NULL);
+		free(sub);
+	}
+
+	json_object_object_foreach(new, new_key, new_val) {
+		if (json_object_object_get_ex(old, new_key, NULL))
+			continue;
+		sub = diff_path(path, new_key);
+		if (sub && !diff_ignored(d, sub))
+			diff_report(d, sub, NULL, new_val);
+		free(sub);
+	}
+}
+
+/*
+ * The name of the member the objects of @a are identified by, the first
+ * one, if all of them start with the same integer member; NULL to compare
+ * the items by index.
+ */
+static const char *diff_array_key(struct json_object *a)
+{
+	const char *name = NULL;
+	struct json_object *item;
+	size_t i;
+
+	for (i = 0; i < json_object_array_length(a); i++) {
+		item = json_object_array_get_idx(a, i);
+		if (!json_object_is_type(item, json_type_object))
+			return NULL;
+		json_object_object_foreach(item, key, val) {
+			if (!json_object_is_type(val, json_type_int) ||
+			    (name && strcmp(name, key)))
+				return NULL;
+			name = key;
+			break;
+		}
+		if (!name)
+			return NULL;
+	}
+
+	return name;
+}
+
+static struct json_object *diff_array_find(struct json_object *a, const char *key,
+					   int64_t id)
+{
+	struct json_object *item, *v;
+	size_t i;
+
+	for (i = 0; i < json_object_array_length(a); i++) {
+		item = json_object_array_get_idx(a, i);
+		if (json_object_object_get_ex(item, key, &v) &&
+		    json_object_get_int64(v) == id)
+			return item;
+	}
+
+	return NULL;
+}
+
+static void diff_array_keyed(struct snapshot_diff *d, const char *path, const char *key,
+			     struct json_object *old, struct json_object *new)
+{
+	struct json_object *item, *other, *v;
+	size_t i, pass;
+	int64_t id;
+	char *sub;
+
+	/* the items of @old, then the ones only in @new */
+	for (pass = 0; pass < 2; pass++) {
+		struct json_object *a = pass ? new : old, *b = pass ? old : new;
+
+		for (i = 0; i < json_object_array_length(a); i++) {
+			item = json_object_array_get_idx(a, i);
+			v = NULL;
+			json_object_object_get_ex(item, key, &v);
+			id = json_object_get_int64(v);
+			other = diff_array_find(b, key, id);
+			if (pass && other)
+				continue;
+			if (asprintf(&sub, "%s[%s=%"PRId64"]", path, key, id) < 0)
+				continue;
+			if (other)
+				diff_value(d, sub, item, other);
+			else if (!diff_ignored(d, sub))
+				diff_report(d, sub, pass ? NULL : item, pass ? item : NULL);
+			free(sub);
+		}
+	}
+}
+
+static void diff_array(struct snapshot_diff *d, const char *path,
+		       struct json_object *old, struct json_object *new)
+{
+	size_t i, nr_old = json_object_array_length(old),
+		nr_new = json_object_array_length(new);
+	const char *key = diff_array_key(old), *new_key = diff_array_key(new);
+	char *sub;
+
+	/* an empty array goes with the key of the other one */
+	if (!nr_old)
+		key = new_key;
+	else if (nr_new && (!key || !new_key || strcmp(key, new_key)))
+		key = NULL;
+
+	if (key) {
+		diff_array_keyed(d, path, key, old, new);
+		return;
+	}
+
+	for (i = 0; i < max(nr_old, nr_new); i++) {
+		if (asprintf(&sub, "%s[%zu]", path, i) < 0)
+			continue;
+		if (i < nr_old && i < nr_new)
+			diff_value(d, sub, json_object_array_get_idx(old, i),
+				   json_object_array_get_idx(new, i));
+		else if (!diff_ignored(d, sub))
+			diff_report(d, sub, json_object_array_get_idx(old, i),
+				    json_object_array_get_idx(new, i));
+		free(sub);
+	}
+}
+
+static void diff_value(struct snapshot_diff *d, const char *path,
+		       struct json_object *old, struct json_object *new)
+{
+	if (diff_ignored(d, path))
+		return;
+
+	if (old && new && json_object_get_type(old) == json_object_get_type(new)) {
+		if (json_object_is_type(old, json_type_object)) {
+			diff_object(d, path, old, new);
+			return;
+		}
+		if (json_object_is_type(old, json_type_array)) {
+			diff_array(d, path, old, new);
+			return;
+		}
+	}
+
+	if (!json_object_equal(old, new))
+		diff_report(d, path, old, new);
+}
+
+int nvme_snapshot_diff(struct json_object *old, struct json_object *new,
+		       const char *ignore, bool json)
+{
+	struct snapshot_diff d = { 0 };
+	char *list = NULL, *tok, *save;
+	struct json_object *r;
+
+	if (ignore && *ignore) {
+		list = strdup(ignore);
+		d.ignore = calloc(strlen(ignore) / 2 + 1, sizeof(*d.ignore));
+		for (tok = list ? strtok_r(list, ",", &save) : NULL; tok && d.ignore;
+		     tok = strtok_r(NULL, ",", &save))
+			d.ignore[d.nr_ignore++] = tok;
+	}
+
+	if (json)
+		d.list = json_create_array();
+
+	diff_value(&d, "", old, new);
+
+	if (json) {
+		r = json_create_object();
+		json_object_add_value_int(r, "differences", d.nr);
+		json_object_add_value_array(r, "changes", d.list);
+		json_print_object(r, NULL);
+		util_json_print_newline();
+		json_free_object(r);
+	}
+
+	free(d.ignore);
+	free(list);
+
+	return d.nr;
+}
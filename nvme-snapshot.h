@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_SNAPSHOT_H
+#define NVME_SNAPSHOT_H
+
+#include <stdbool.h>
+
+#include <libnvme.h>
+
+/*
+ * Configuration snapshots of config-snapshot and config-diff. A snapshot
+ * is a JSON document of a fixed layout:
+ *
+ *   { "version", "identity", "controller", "power_states", "features",
+ *     "namespaces" }
+ *
+ * with the members always in this order, the features in FID order and
+ * the namespaces in NSID order. Nothing changing on its own, a timestamp
+ * or the namespace utilization, is kept, so two drives configured alike
+ * give the same snapshot but for the members of "identity".
+ */
+
+#define NVME_SNAPSHOT_VERSION	1
+
+struct json_object;
+
+struct nvme_snapshot_feature {
+	__u8 fid;
+	__u32 current;
+	void *data;		/* of the current value, NULL if none */
+	__u32 data_len;
+	bool saved_valid;	/* the saved value was retrieved */
+	__u32 saved;
+	void *saved_data;	/* data_len bytes, NULL if none */
+};
+
+/* a new snapshot with the identify data of @ctrl, and no features or namespaces */
+struct json_object *nvme_snapshot_new(const struct nvme_id_ctrl *ctrl);
+
+/* add the features in FID order, the namespaces in NSID order */
+void nvme_snapshot_add_feature(struct json_object *snap,
+			       const struct nvme_snapshot_feature *f);
+void nvme_snapshot_add_ns(struct json_object *snap, __u32 nsid,
+			  const struct nvme_id_ns *ns);
+
+/* whether the value of @fid changes on its own and is left out */
+bool nvme_snapshot_volatile_feature(__u8 fid);
+
+/*
+ * nvme_snapshot_load - read a snapshot written as JSON or as CBOR
+ *
+ * Returns 0, or a negative errno if @file can't be read or isn't a
+ * snapshot of this version.
+ */
+int nvme_snapshot_load(const char *file, struct json_object **snap);
+
+/*
+ * nvme_snapshot_diff - print the differences between @old and @new
+ * @ignore: comma separated paths of members to skip, e.g. "identity" or
+ * "features.0x06", NULL for none
+ * @json: print them as a JSON document instead of a line each
+ *
+ * The members are compared structurally, the namespaces by NSID and the
+ * power states by number. Returns how many differences there are.
+ */
+int nvme_snapshot_diff(struct json_object *old, struct json_object *new,
+		       const char *ignore, bool json);
+
+#endif /* NVME_SNAPSHOT_H */
@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Recorder of the passthru commands nvme-cli sends, for --trace-file.
+ */
+#include <endian.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libnvme.h>
+
+#include "common.h"
+#include "nvme-trace.h"
+#include "util/replay.h"
+
+#define TRACE_BUF_SIZE		(1024 * 1024)
+
+bool nvme_trace_enabled;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_f;
+static char *trace_buf;
+static __u64 trace_last_ns;	/* start of the latest command recorded */
+static int trace_err;
+
+static __u32 trace_us(__u64 ns)
+{
+	return htole32(min(ns / NSEC_PER_USEC, (__u64)UINT32_MAX));
+}
+
+void __nvme_trace_cmd(bool admin, const struct nvme_passthru_cmd64 *cmd,
+		      int status, __u64 start_ns, __u64 lat_ns)
+{
+	struct nvme_replay_cmd r = {
+		.opcode		= cmd->opcode,
+		.flags		= cmd->flags,
+		.admin		= admin,
+		.nsid		= htole32(cmd->nsid),
+		.cdw2		= htole32(cmd->cdw2),
+		.cdw3		= htole32(cmd->cdw3),
+		.cdw10		= htole32(cmd->cdw10),
+		.cdw11		= htole32(cmd->cdw11),
+		.cdw12		= htole32(cmd->cdw12),
+		.cdw13		= htole32(cmd->cdw13),
+		.cdw14		= htole32(cmd->cdw14),
+		.cdw15		= htole32(cmd->cdw15),
+		.data_len	= htole32(cmd->data_len),
+		.timeout_ms	= htole32(cmd->timeout_ms),
+		.status		= htole32((__u32)status),
+		.latency_us	= trace_us(lat_ns),
+	};
+
+	pthread_mutex_lock(&trace_lock);
+	if (trace_f) {
+		/* concurrent commands may complete out of order */
+		if (trace_last_ns && start_ns > trace_last_ns)
+			r.think_us = trace_us(start_ns - trace_last_ns);
+		if (start_ns > trace_last_ns)
+			trace_last_ns = start_ns;
+		if (fwrite(&r, sizeof(r), 1, trace_f) != 1 && !trace_err)
+			trace_err = errno ? -errno : -EIO;
+	}
+	pthread_mutex_unlock(&trace_lock);
+}
+
+int nvme_trace_open(const char *file)
+{
+	int err;
+
+	trace_f = fopen(file, "w");
+	if (!trace_f)
+		return -errno;
+
+	/* the records are small, write them out in large chunks */
+	trace_buf = malloc(TRACE_BUF_SIZE);
+	if (trace_buf)
+		setvbuf(trace_f, trace_buf, _IOFBF, TRACE_BUF_SIZE);
+
+	if (fwrite(NVME_REPLAY_MAGIC, strlen(NVME_REPLAY_MAGIC), 1, trace_f) != 1) {
+		err = -errno;
+		nvme_trace_close();
+		return err;
+	}
+
+	nvme_trace_enabled = true;
+
+	return 0;
+}
+
+int nvme_trace_close(void)
+{
+	int err;
+
+	nvme_trace_enabled = false;
+	if (!trace_f)
+		return 0;
+
+	pthread_mutex_lock(&trace_lock);
+	err = trace_err;
+	if (fclose(trace_f) && !err)
+		err = -errno;
+	trace_f = NULL;
+	pthread_mutex_unlock(&trace_lock);
+
+	free(trace_buf);
+	trace_buf = NULL;
+
+	return err;
+}
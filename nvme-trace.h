@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_TRACE_H
+#define NVME_TRACE_H
+
+#include <stdbool.h>
+
+#include <libnvme.h>
+
+/*
+ * Command recorder for the global --trace-file option. Every admin and
+ * I/O passthru command sent to a direct device is appended to the trace
+ * as a binary passthru-replay record (util/replay.h) with its status and
+ * latency, the think time being the time since the previous command was
+ * issued. The passthru commands of nvme-cli, the plugins and libnvme all
+ * go through nvme_submit_passthru() of util/logging.c, mock devices
+ * included; the io_uring commands of the I/O engine and the fan-out
+ * don't and are recorded by them. Commands are recorded as they
+ * complete. MI devices are not traced.
+ */
+
+extern bool nvme_trace_enabled;
+
+/*
+ * nvme_trace_open - start recording into @file, replacing it
+ *
+ * Returns 0 or a negative errno.
+ */
+int nvme_trace_open(const char *file);
+
+/* nvme_trace_close - stop recording, returns 0 or the first write error */
+int nvme_trace_close(void);
+
+void __nvme_trace_cmd(bool admin, const struct nvme_passthru_cmd64 *cmd,
+		      int status, __u64 start_ns, __u64 lat_ns);
+
+/*
+ * nvme_trace_cmd - record @cmd, issued at @start_ns of monotonic_ns(),
+ * which completed with @status, an NVMe status or a negative errno
+ */
+static inline void nvme_trace_cmd(bool admin, const struct nvme_passthru_cmd64 *cmd,
+				  int status, __u64 start_ns, __u64 lat_ns)
+{
+	if (nvme_trace_enabled)
+		__nvme_trace_cmd(admin, cmd, status, start_ns, lat_ns);
+}
+
+#endif /* NVME_TRACE_H */
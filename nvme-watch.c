@@ -0,0 +1,601 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Incremental NVMe topology watcher and asynchronous event listener
+ * driven by kernel uevents.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+#include <sys/socket.h>
+
+#include "common.h"
+#include "nvme-print.h"
+#include "nvme-watch.h"
+#include "util/sysfs.h"
+
+#define UEVENT_BUF_SIZE		8192
+#define UEVENT_RCVBUF		(1024 * 1024)
+
+static const char * const ctrl_keys[] = {
+	"state", "transport", "address", "cntlid", "subsysnqn", "model",
+	"serial", "firmware_rev",
+};
+
+static const char * const ns_keys[] = {
+	"nsid", "size", "wwid", "ro",
+};
+
+static const char * const path_keys[] = {
+	"nsid", "ana_state", "ana_grpid",
+};
+
+static volatile sig_atomic_t watch_stop;
+
+void nvme_watch_stop(void)
+{
+	watch_stop = 1;
+}
+
+const char *nvme_watch_type_to_string(enum nvme_watch_type type)
+{
+	switch (type) {
+	case NVME_WATCH_CTRL:
+		return "controller";
+	case NVME_WATCH_NS:
+		return "namespace";
+	case NVME_WATCH_PATH:
+		return "path";
+	}
+
+	return "unknown";
+}
+
+const char *nvme_watch_action_to_string(enum nvme_watch_action action)
+{
+	switch (action) {
+	case NVME_WATCH_ADD:
+		return "add";
+	case NVME_WATCH_CHANGE:
+		return "change";
+	case NVME_WATCH_REMOVE:
+		return "remove";
+	}
+
+	return "unknown";
+}
+
+const char *nvme_watch_aen_type_to_string(__u8 type)
+{
+	switch (type) {
+	case NVME_WATCH_AEN_ERROR:
+		return "error";
+	case NVME_WATCH_AEN_SMART:
+		return "smart";
+	case NVME_WATCH_AEN_NOTICE:
+		return "notice";
+	case NVME_WATCH_AEN_IMMEDIATE:
+		return "immediate";
+	case NVME_WATCH_AEN_ONE_SHOT:
+		return "one-shot";
+	case NVME_WATCH_AEN_CSS:
+		return "io-command-set";
+	case NVME_WATCH_AEN_VS:
+		return "vendor";
+	}
+
+	return "reserved";
+}
+
+const char *nvme_watch_aen_info_to_string(__u8 type, __u8 info)
+{
+	static const char * const error[] = {
+		"Write to Invalid Doorbell Register",
+		"Invalid Doorbell Write Value",
+		"Diagnostic Failure",
+		"Persistent Internal Error",
+		"Transient Internal Error",
+		"Firmware Image Load Error",
+	};
+	static const char * const smart[] = {
+		"NVM subsystem Reliability",
+		"Temperature Threshold",
+		"Spare Below Threshold",
+	};
+	static const char * const notice[] = {
+		"Namespace Attribute Changed",
+		"Firmware Activation Starting",
+		"Telemetry Log Changed",
+		"Asymmetric Namespace Access Change",
+		"Predictable Latency Event Aggregate Log Change",
+		"LBA Status Information Alert",
+		"Endurance Group Event Aggregate Log Page Change",
+		"Normal NVM Subsystem Shutdown",
+	};
+
+	switch (type) {
+	case NVME_WATCH_AEN_ERROR:
+		if (info < ARRAY_SIZE(error))
+			return error[info];
+		break;
+	case NVME_WATCH_AEN_SMART:
+		if (info < ARRAY_SIZE(smart))
+			return smart[info];
+		break;
+	case NVME_WATCH_AEN_NOTICE:
+		if (info < ARRAY_SIZE(notice))
+			return notice[info];
+		if (info == 0xf0)
+			return "Discovery Log Page Change";
+		break;
+	}
+
+	return "Unknown";
+}
+
+/* nvmeX controllers, nvmeXnY namespaces and nvmeXcYnZ paths */
+static bool watch_classify(const char *name, enum nvme_watch_type *type)
+{
+	int a, b, c, pos = 0;
+
+	if (sscanf(name, "nvme%dc%dn%d%n", &a, &b, &c, &pos) == 3 && !name[pos])
+		*type = NVME_WATCH_PATH;
+	else if (pos = 0, sscanf(name, "nvme%dn%d%n", &a, &b, &pos) == 2 && !name[pos])
+		*type = NVME_WATCH_NS;
+	else if (pos = 0, sscanf(name, "nvme%d%n", &a, &pos) == 1 && !name[pos])
+		*type = NVME_WATCH_CTRL;
+	else
+		return false;
+
+	return strlen(name) < sizeof(((struct nvme_watch_obj *)0)->name);
+}
+
+/* Returns -1 if the object is gone */
+static int watch_read(struct nvme_watch_obj *obj, enum nvme_watch_type type,
+		      const char *name)
+{
+	char dir[PATH_MAX];
+	int i;
+
+	memset(obj, 0, sizeof(*obj));
+	obj->type = type;
+	strcpy(obj->name, name);
+
+	switch (type) {
+	case NVME_WATCH_CTRL:
+		obj->keys = ctrl_keys;
+		obj->nr_attrs = ARRAY_SIZE(ctrl_keys);
+		snprintf(dir, sizeof(dir), "/sys/class/nvme/%s", name);
+		break;
+	case NVME_WATCH_NS:
+		obj->keys = ns_keys;
+		obj->nr_attrs = ARRAY_SIZE(ns_keys);
+		snprintf(dir, sizeof(dir), "/sys/class/block/%s", name);
+		break;
+	case NVME_WATCH_PATH:
+		obj->keys = path_keys;
+		obj->nr_attrs = ARRAY_SIZE(path_keys);
+		snprintf(dir, sizeof(dir), "/sys/class/block/%s", name);
+		break;
+	}
+
+	if (access(dir, F_OK))
+		return -1;
+
+	/* attributes a kernel doesn't provide stay empty */
+	for (i = 0; i < obj->nr_attrs; i++)
+		sysfs_read_attr(dir, obj->keys[i], obj->vals[i], sizeof(obj->vals[i]));
+
+	return 0;
+}
+
+static struct nvme_watch_obj *watch_find(struct list_head *snap,
+					 enum nvme_watch_type type,
+					 const char *name)
+{
+	struct nvme_watch_obj *obj;
+
+	list_for_each(snap, obj, entry)
+		if (obj->type == type && !strcmp(obj->name, name))
+			return obj;
+
+	return NULL;
+}
+
+/* Re-reads one object and reports how it differs from the snapshot */
+static void watch_update(struct list_head *snap, enum nvme_watch_type type,
+			 const char *name, bool report, enum nvme_print_flags flags)
+{
+	struct nvme_watch_obj *old = watch_find(snap, type, name);
+	struct nvme_watch_obj cur;
+
+	if (watch_read(&cur, type, name)) {
+		if (old) {
+			if (report)
+				nvme_show_watch_event(NVME_WATCH_REMOVE, old, flags);
+			list_del(&old->entry);
+			free(old);
+		}
+		return;
+	}
+
+	if (!old) {
+		old = malloc(sizeof(*old));
+		if (!old)
+			return;
+		*old = cur;
+		old->seen = true;
+		list_add_tail(snap, &old->entry);
+		if (report)
+			nvme_show_watch_event(NVME_WATCH_ADD, old, flags);
+		return;
+	}
+
+	old->seen = true;
+	if (!memcmp(old->vals, cur.vals, sizeof(cur.vals)))
+		return;
+
+	memcpy(old->vals, cur.vals, sizeof(cur.vals));
+	if (report)
+		nvme_show_watch_event(NVME_WATCH_CHANGE, old, flags);
+}
+
+static void watch_scan_dir(struct list_head *snap, const char *path,
+			   bool report, enum nvme_print_flags flags)
+{
+	enum nvme_watch_type type;
+	struct dirent *e;
+	DIR *d;
+
+	d = opendir(path);
+	if (!d)
+		return;
+
+	while ((e = readdir(d)))
+		if (watch_classify(e->d_name, &type))
+			watch_update(snap, type, e->d_name, report, flags);
+	closedir(d);
+}
+
+/*
+ * Full rescan, used for the initial snapshot and to resynchronize after
+ * the socket overflowed and events were lost.
+ */
+static void watch_resync(struct list_head *snap, bool report,
+			 enum nvme_print_flags flags)
+{
+	struct nvme_watch_obj *obj, *next;
+
+	list_for_each(snap, obj, entry)
+		obj->seen = false;
+
+	watch_scan_dir(snap, "/sys/class/nvme", report, flags);
+	watch_scan_dir(snap, "/sys/class/block", report, flags);
+
+	list_for_each_safe(snap, obj, next, entry) {
+		if (obj->seen)
+			continue;
+		if (report)
+			nvme_show_watch_event(NVME_WATCH_REMOVE, obj, flags);
+		list_del(&obj->entry);
+		free(obj);
+	}
+}
+
+/*
+ * The hidden per path block devices don't generate uevents, refresh the
+ * paths of a controller whenever the controller itself changes.
+ */
+static void watch_ctrl_paths(struct list_head *snap, const char *ctrl,
+			     enum nvme_print_flags flags)
+{
+	struct nvme_watch_obj *obj, *next;
+	char dir[PATH_MAX];
+	int instance, a, b, c;
+
+	if (sscanf(ctrl, "nvme%d", &instance) != 1)
+		return;
+
+	list_for_each_safe(snap, obj, next, entry) {
+		if (obj->type == NVME_WATCH_PATH &&
+		    sscanf(obj->name, "nvme%dc%dn%d", &a, &b, &c) == 3 && b == instance)
+			watch_update(snap, obj->type, obj->name, true, flags);
+	}
+
+	snprintf(dir, sizeof(dir), "/sys/class/nvme/%s", ctrl);
+	watch_scan_dir(snap, dir, true, flags);
+}
+
+static void watch_uevent(struct list_head *snap, char *buf, size_t len,
+			 enum nvme_print_flags flags)
+{
+	const char *action = NULL, *devpath = NULL, *subsystem = NULL, *name;
+	enum nvme_watch_type type;
+	char *p;
+
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		if (!strncmp(p, "ACTION=", 7))
+			action = p + 7;
+		else if (!strncmp(p, "DEVPATH=", 8))
+			devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+	}
+
+	if (!action || !devpath || !subsystem ||
+	    (strcmp(subsystem, "nvme") && strcmp(subsystem, "block")))
+		return;
+
+	name = strrchr(devpath, '/');
+	name = name ? name + 1 : devpath;
+	if (!watch_classify(name, &type))
+		return;
+
+	/* the current sysfs state tells whether it was added or removed */
+	watch_update(snap, type, name, true, flags);
+	if (type == NVME_WATCH_CTRL)
+		watch_ctrl_paths(snap, name, flags);
+}
+
+/* Returns a netlink socket receiving kernel uevents or a negative errno */
+static int watch_socket(void)
+{
+	struct sockaddr_nl addr = {
+		.nl_family = AF_NETLINK,
+		.nl_groups = 1,		/* kernel uevents */
+	};
+	int fd, err, rcvbuf = UEVENT_RCVBUF;
+
+	fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+	if (fd < 0)
+		return -errno;
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		err = -errno;
+		close(fd);
+		return err;
+	}
+	/* best effort, a too small buffer is caught by the ENOBUFS handling */
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	return fd;
+}
+
+int nvme_watch_topology(enum nvme_print_flags flags)
+{
+	struct nvme_watch_obj *obj, *next;
+	char buf[UEVENT_BUF_SIZE];
+	LIST_HEAD(snap);
+	ssize_t len;
+	int fd, err = 0;
+
+	fd = watch_socket();
+	if (fd < 0)
+		return fd;
+
+	/* events racing with the snapshot are queued and filtered as no-ops */
+	watch_resync(&snap, false, flags);
+
+	while (!watch_stop) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == ENOBUFS)
+				watch_resync(&snap, true, flags);
+			else if (errno != EAGAIN && errno != EINTR) {
+				err = -errno;
+				break;
+			}
+			continue;
+		}
+		buf[len] = '\0';
+		watch_uevent(&snap, buf, len, flags);
+	}
+
+	list_for_each_safe(&snap, obj, next, entry) {
+		list_del(&obj->entry);
+		free(obj);
+	}
+	close(fd);
+
+	return err;
+}
+
+/* NVME_AEN=0x00020101 on the change uevent of a controller */
+static bool watch_aen_parse(char *buf, size_t len, struct nvme_watch_aen *aen)
+{
+	const char *devpath = NULL, *subsystem = NULL, *result = NULL, *name;
+	enum nvme_watch_type type;
+	char *p;
+
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		if (!strncmp(p, "DEVPATH=", 8))
+			devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+		else if (!strncmp(p, "NVME_AEN=", 9))
+			result = p + 9;
+	}
+
+	if (!devpath || !subsystem || !result || strcmp(subsystem, "nvme"))
+		return false;
+
+	name = strrchr(devpath, '/');
+	name = name ? name + 1 : devpath;
+	if (!watch_classify(name, &type) || type != NVME_WATCH_CTRL)
+		return false;
+
+	memset(aen, 0, sizeof(*aen));
+	strcpy(aen->ctrl, name);
+	aen->result = strtoul(result, NULL, 16);
+	aen->type = aen->result & 0x7;
+	aen->info = (aen->result >> 8) & 0xff;
+	aen->lid = (aen->result >> 16) & 0xff;
+
+	return true;
+}
+
+/* the uevent of a discovery log change AEN or of a reconnected discovery controller */
+static bool watch_disc_parse(char *buf, size_t len, char *ctrl)
+{
+	const char *devpath = NULL, *subsystem = NULL, *event = NULL, *name;
+	struct nvme_watch_aen aen;
+	enum nvme_watch_type type;
+	char *p;
+
+	if (watch_aen_parse(buf, len, &aen)) {
+		if (aen.type != NVME_WATCH_AEN_NOTICE || aen.info != 0xf0 ||
+		    aen.lid != NVME_LOG_LID_DISCOVER)
+			return false;
+		strcpy(ctrl, aen.ctrl);
+		return true;
+	}
+
+	for (p = buf; p < buf + len; p += strlen(p) + 1) {
+		if (!strncmp(p, "DEVPATH=", 8))
+			devpath = p + 8;
+		else if (!strncmp(p, "SUBSYSTEM=", 10))
+			subsystem = p + 10;
+		else if (!strncmp(p, "NVME_EVENT=", 11))
+			event = p + 11;
+	}
+
+	if (!devpath || !subsystem || !event || strcmp(subsystem, "nvme") ||
+	    strcmp(event, "rediscover"))
+		return false;
+
+	name = strrchr(devpath, '/');
+	name = name ? name + 1 : devpath;
+	if (!watch_classify(name, &type) || type != NVME_WATCH_CTRL)
+		return false;
+
+	strcpy(ctrl, name);
+	return true;
+}
+
+int nvme_watch_disc(void (*fn)(char (*ctrls)[32], int nr, void *data),
+		    unsigned int coalesce_ms, void *data)
+{
+	char ctrls[NVME_WATCH_DISC_MAX][32], ctrl[32];
+	char buf[UEVENT_BUF_SIZE];
+	bool pending = false, all = false;
+	__u64 due = 0, now;
+	int fd, i, nr = 0, timeout, err = 0;
+	ssize_t len;
+
+	fd = watch_socket();
+	if (fd < 0)
+		return fd;
+
+	while (!watch_stop) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+		timeout = -1;
+		if (pending) {
+			now = monotonic_ns();
+			timeout = due > now ? (due - now + 999999) / 1000000 : 0;
+		}
+
+		i = poll(&pfd, 1, timeout);
+		if (i < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+		if (!i) {
+			fn(all ? NULL : ctrls, all ? 0 : nr, data);
+			pending = all = false;
+			nr = 0;
+			continue;
+		}
+
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == ENOBUFS) {
+				all = true;
+			} else if (errno != EAGAIN && errno != EINTR) {
+				err = -errno;
+				break;
+			} else {
+				continue;
+			}
+		} else {
+			buf[len] = '\0';
+			if (!watch_disc_parse(buf, len, ctrl))
+				continue;
+
+			for (i = 0; i < nr; i++)
+				if (!strcmp(ctrls[i], ctrl))
+					break;
+			if (i == nr && nr < NVME_WATCH_DISC_MAX)
+				strcpy(ctrls[nr++], ctrl);
+			else if (i == nr)
+				all = true;
+		}
+
+		/* the window starts with the first event of a burst */
+		if (!pending)
+			due = monotonic_ns() + coalesce_ms * 1000000ULL;
+		pending = true;
+	}
+	close(fd);
+
+	return err;
+}
+
+int nvme_watch_aen(void (*fn)(const struct nvme_watch_aen *aen, void *data),
+		   void *data)
+{
+	struct nvme_watch_aen aen;
+	char buf[UEVENT_BUF_SIZE];
+	ssize_t len;
+	int fd, err = 0;
+
+	fd = watch_socket();
+	if (fd < 0)
+		return fd;
+
+	while (!watch_stop) {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+		if (poll(&pfd, 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			break;
+		}
+
+		len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == ENOBUFS)
+				fn(NULL, data);
+			else if (errno != EAGAIN && errno != EINTR) {
+				err = -errno;
+				break;
+			}
+			continue;
+		}
+		buf[len] = '\0';
+		if (watch_aen_parse(buf, len, &aen))
+			fn(&aen, data);
+	}
+	close(fd);
+
+	return err;
+}
@@ -0,0 +1,103 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef NVME_WATCH_H
+#define NVME_WATCH_H
+
+#include <stdbool.h>
+
+#include <ccan/list/list.h>
+
+#include "nvme.h"
+
+/*
+ * Topology watcher. Takes a snapshot of the NVMe controllers, namespaces
+ * and multipath paths in sysfs and then follows kernel uevents, re-reading
+ * only the object an event refers to. Every difference to the snapshot is
+ * reported as one event.
+ */
+
+#define NVME_WATCH_MAX_ATTRS	8
+
+enum nvme_watch_type {
+	NVME_WATCH_CTRL,
+	NVME_WATCH_NS,
+	NVME_WATCH_PATH,
+};
+
+enum nvme_watch_action {
+	NVME_WATCH_ADD,
+	NVME_WATCH_CHANGE,
+	NVME_WATCH_REMOVE,
+};
+
+struct nvme_watch_obj {
+	struct list_node entry;
+	enum nvme_watch_type type;
+	char name[32];
+	int nr_attrs;
+	const char * const *keys;
+	char vals[NVME_WATCH_MAX_ATTRS][256];
+	bool seen;		/* found by the last full scan */
+};
+
+/* Asynchronous Event Type, bits 2:0 of the AER completion dword 0 */
+enum nvme_watch_aen_type {
+	NVME_WATCH_AEN_ERROR	= 0,
+	NVME_WATCH_AEN_SMART	= 1,
+	NVME_WATCH_AEN_NOTICE	= 2,
+	NVME_WATCH_AEN_IMMEDIATE = 3,
+	NVME_WATCH_AEN_ONE_SHOT	= 4,
+	NVME_WATCH_AEN_CSS	= 6,
+	NVME_WATCH_AEN_VS	= 7,
+};
+
+/* An asynchronous event passed on by the driver in a NVME_AEN uevent */
+struct nvme_watch_aen {
+	char ctrl[32];
+	__u32 result;		/* AER completion dword 0 */
+	__u8 type;		/* enum nvme_watch_aen_type */
+	__u8 info;		/* Asynchronous Event Information */
+	__u8 lid;		/* log page to read to clear the event */
+};
+
+const char *nvme_watch_type_to_string(enum nvme_watch_type type);
+const char *nvme_watch_action_to_string(enum nvme_watch_action action);
+const char *nvme_watch_aen_type_to_string(__u8 type);
+const char *nvme_watch_aen_info_to_string(__u8 type, __u8 info);
+
+/*
+ * nvme_watch_topology - report topology changes until nvme_watch_stop()
+ *
+ * Returns 0 or a negative errno.
+ */
+int nvme_watch_topology(enum nvme_print_flags flags);
+
+/*
+ * nvme_watch_aen - call @fn for every asynchronous event until
+ * nvme_watch_stop()
+ *
+ * @fn is called with a NULL event if uevents were lost because the
+ * socket overflowed. Returns 0 or a negative errno.
+ */
+int nvme_watch_aen(void (*fn)(const struct nvme_watch_aen *aen, void *data),
+		   void *data);
+
+/* discovery controllers collected in one burst of events by nvme_watch_disc() */
+#define NVME_WATCH_DISC_MAX	64
+
+/*
+ * nvme_watch_disc - call @fn for the discovery controllers whose log
+ * changed until nvme_watch_stop()
+ *
+ * A Discovery Log Page Change event, or the rediscover event of a
+ * discovery controller that reconnected, marks the controller. @fn is
+ * called @coalesce_ms after the first event of a burst, with the @nr
+ * controllers marked since, each one once. @ctrls is NULL if uevents
+ * were lost, or the burst marked more than NVME_WATCH_DISC_MAX, and all
+ * discovery controllers need to be refreshed. Returns 0 or a negative
+ * errno.
+ */
+int nvme_watch_disc(void (*fn)(char (*ctrls)[32], int nr, void *data),
+		    unsigned int coalesce_ms, void *data);
+void nvme_watch_stop(void);
+
+#endif /* NVME_WATCH_H */
@@ -4,13 +4,27 @@
  * wrappers.
  */
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
 
 #include <libnvme.h>
 #include <libnvme-mi.h>
 
+#include "config.h"
+#include "common.h"
 #include "nvme.h"
 #include "nvme-wrap.h"
+#include "util/cache.h"
+#include "util/sysfs.h"
 
 /*
  * Helper for libnvme functions that pass the fd/ep separately. These just
@@ -47,6 +61,366 @@
 		__rc = -ENODEV;						\
 	__rc; })
 
+/*
+ * Opt-in cache of Identify Controller data, enabled by setting
+ * NVME_ID_CACHE to a directory, or to an empty string for the default one.
+ * The entries of a subsystem live in a directory named after its NQN and are
+ * tagged with the NQN, serial number, controller ID and firmware revision of
+ * the controller. All of them are read from sysfs, so a cache hit doesn't
+ * issue any command. Commands changing namespaces, formats or firmware drop
+ * the entries of the subsystem, see nvme_cli_id_cache_invalidate().
+ * Identify Namespace is never cached: NUSE, NVMCAP and the Format
+ * Progress Indicator change with every write and format.
+ */
+#define ID_CACHE_DIR		RUNDIR "/nvme-cli/id-cache"
+#define ID_CACHE_KEY_LEN	512
+
+struct id_cache {
+	char dir[PATH_MAX];
+	char cntlid[16];
+	char key[ID_CACHE_KEY_LEN];
+};
+
+static bool id_cache_init(struct nvme_dev *dev, struct id_cache *c)
+{
+	static const char * const ctrl_dirs[] = {
+		"/sys/class/nvme/%s",
+		"/sys/class/block/%s/device",
+		"/sys/class/nvme-generic/%s/device",
+	};
+	char sysfs[PATH_MAX], nqn[256], serial[32], fw[16];
+	const char *base = getenv("NVME_ID_CACHE");
+	size_t i, len;
+	char *p;
+
+	if (!base || dev->type != NVME_DEV_DIRECT)
+		return false;
+	if (!*base)
+		base = ID_CACHE_DIR;
+
+	/*
+	 * A multipath namespace head resolves to the subsystem, which has no
+	 * controller ID, and is not cached.
+	 */
+	for (i = 0; i < ARRAY_SIZE(ctrl_dirs); i++) {
+		snprintf(sysfs, sizeof(sysfs), ctrl_dirs[i], dev->name);
+		if (!sysfs_read_attr(sysfs, "cntlid", c->cntlid, sizeof(c->cntlid)))
+			break;
+	}
+	if (i == ARRAY_SIZE(ctrl_dirs) ||
+	    sysfs_read_attr(sysfs, "subsysnqn", nqn, sizeof(nqn)) ||
+	    sysfs_read_attr(sysfs, "serial", serial, sizeof(serial)) ||
+	    sysfs_read_attr(sysfs, "firmware_rev", fw, sizeof(fw)))
+		return false;
+
+	snprintf(c->dir, sizeof(c->dir), "%s", base);
+	if (cache_dir_init(c->dir))
+		return false;
+
+	len = strlen(c->dir);
+	if (snprintf(c->dir + len, sizeof(c->dir) - len, "/%s", nqn) >=
+	    (int)(sizeof(c->dir) - len))
+		return false;
+	for (p = c->dir + len + 1; *p; p++)
+		if (*p == '/' || (*p == '.' && p == c->dir + len + 1))
+			*p = '_';
+	if (mkdir(c->dir, 0755) && errno != EEXIST)
+		return false;
+
+	memset(c->key, 0, sizeof(c->key));
+	snprintf(c->key, sizeof(c->key), "%s\n%s\n%s\n%s\n", nqn, serial,
+		 c->cntlid, fw);
+
+	return true;
+}
+
+static bool id_cache_lookup(struct id_cache *c, const char *name, void *data,
+			    size_t len)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", c->dir, name) >= (int)sizeof(path))
+		return false;
+
+	return cache_read(path, c->key, sizeof(c->key), data, len);
+}
+
+static void id_cache_store(struct id_cache *c, const char *name, const void *data,
+			   size_t len)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", c->dir, name) >= (int)sizeof(path))
+		return;
+
+	cache_write(path, c->key, sizeof(c->key), data, len);
+}
+
+static unsigned int id_cache_gen;
+
+unsigned int nvme_cli_id_cache_gen(void)
+{
+	return id_cache_gen;
+}
+
+void nvme_cli_id_cache_invalidate(struct nvme_dev *dev)
+{
+	struct id_cache c;
+	struct dirent *d;
+	DIR *dir;
+
+	id_cache_gen++;
+	if (!dev || !id_cache_init(dev, &c))
+		return;
+
+	dir = opendir(c.dir);
+	if (!dir)
+		return;
+
+	while ((d = readdir(dir)))
+		if (d->d_name[0] != '.')
+			unlinkat(dirfd(dir), d->d_name, 0);
+	closedir(dir);
+	rmdir(c.dir);
+}
+
+bool nvme_cli_id_cache_lookup(struct nvme_dev *dev, const char *name,
+			      void *data, size_t len)
+{
+	struct id_cache c;
+	char entry[64];
+
+	if (!id_cache_init(dev, &c) ||
+	    snprintf(entry, sizeof(entry), "%s-%s", name, c.cntlid) >= (int)sizeof(entry))
+		return false;
+
+	return id_cache_lookup(&c, entry, data, len);
+}
+
+void nvme_cli_id_cache_store(struct nvme_dev *dev, const char *name,
+			     const void *data, size_t len)
+{
+	struct id_cache c;
+	char entry[64];
+
+	if (!id_cache_init(dev, &c) ||
+	    snprintf(entry, sizeof(entry), "%s-%s", name, c.cntlid) >= (int)sizeof(entry))
+		return;
+
+	id_cache_store(&c, entry, data, len);
+}
+
+/*
+ * Opt-in cache of what log pages a model supports, enabled by setting
+ * NVME_LOG_CACHE to a directory, or to an empty string for the default one.
+ * The entries are shared by all controllers with the same model number and
+ * firmware revision, read from sysfs, and hold the UUID list, the Supported
+ * Log Pages log of each UUID index and the vendor log directories plugins
+ * store, so the next runs know without trying a log page first.
+ */
+#define LOG_CACHE_DIR		RUNDIR "/nvme-cli/log-cache"
+#define LOG_CACHE_KEY_LEN	128
+
+struct log_cache {
+	char dir[PATH_MAX];
+	char key[LOG_CACHE_KEY_LEN];
+};
+
+static bool log_cache_init(struct nvme_dev *dev, struct log_cache *c)
+{
+	static const char * const ctrl_dirs[] = {
+		"/sys/class/nvme/%s",
+		"/sys/class/block/%s/device",
+		"/sys/class/nvme-generic/%s/device",
+	};
+	const char *base = getenv("NVME_LOG_CACHE");
+	char sysfs[PATH_MAX], model[64], fw[16];
+	size_t i, len;
+	char *p;
+
+	if (!base || dev->type != NVME_DEV_DIRECT)
+		return false;
+	if (!*base)
+		base = LOG_CACHE_DIR;
+
+	/* a multipath namespace head resolves to the subsystem, which is fine */
+	for (i = 0; i < ARRAY_SIZE(ctrl_dirs); i++) {
+		snprintf(sysfs, sizeof(sysfs), ctrl_dirs[i], dev->name);
+		if (!sysfs_read_attr(sysfs, "model", model, sizeof(model)))
+			break;
+	}
+	if (i == ARRAY_SIZE(ctrl_dirs) ||
+	    sysfs_read_attr(sysfs, "firmware_rev", fw, sizeof(fw)))
+		return false;
+
+	snprintf(c->dir, sizeof(c->dir), "%s", base);
+	if (cache_dir_init(c->dir))
+		return false;
+
+	len = strlen(c->dir);
+	if (snprintf(c->dir + len, sizeof(c->dir) - len, "/%s-%s", model, fw) >=
+	    (int)(sizeof(c->dir) - len))
+		return false;
+	for (p = c->dir + len + 1; *p; p++)
+		if (*p == '/' || *p == ' ' || (*p == '.' && p == c->dir + len + 1))
+			*p = '_';
+	if (mkdir(c->dir, 0755) && errno != EEXIST)
+		return false;
+
+	memset(c->key, 0, sizeof(c->key));
+	snprintf(c->key, sizeof(c->key), "%s\n%s\n", model, fw);
+
+	return true;
+}
+
+void *nvme_cli_log_cache_lookup(struct nvme_dev *dev, const char *name,
+				size_t *len)
+{
+	char path[PATH_MAX];
+	struct log_cache c;
+
+	if (!log_cache_init(dev, &c) ||
+	    snprintf(path, sizeof(path), "%s/%s", c.dir, name) >= (int)sizeof(path))
+		return NULL;
+
+	return cache_read_alloc(path, c.key, sizeof(c.key), len);
+}
+
+void nvme_cli_log_cache_store(struct nvme_dev *dev, const char *name,
+			      const void *data, size_t len)
+{
+	char path[PATH_MAX];
+	struct log_cache c;
+
+	if (!log_cache_init(dev, &c) ||
+	    snprintf(path, sizeof(path), "%s/%s", c.dir, name) >= (int)sizeof(path))
+		return;
+
+	cache_write(path, c.key, sizeof(c.key), data, len);
+}
+
+/*
+ * A fixed size entry, or the status of the command as a 4 byte entry if
+ * the model doesn't have the data: Invalid Log Page or Invalid Field in
+ * Command with DNR, which it answers the same way every time.
+ */
+static bool log_cache_status(int err)
+{
+	if (err <= 0 || nvme_status_get_type(err) != NVME_STATUS_TYPE_NVME ||
+	    !(err & NVME_SC_DNR))
+		return false;
+
+	if (NVME_GET(err, SCT) == NVME_SCT_GENERIC)
+		return NVME_GET(err, SC) == NVME_SC_INVALID_FIELD;
+
+	return NVME_GET(err, SCT) == NVME_SCT_CMD_SPECIFIC &&
+		NVME_GET(err, SC) == NVME_SC_INVALID_LOG_PAGE;
+}
+
+static int log_cache_get(struct nvme_dev *dev, const char *name, void *data,
+			 size_t len)
+{
+	__le32 status;
+	size_t clen;
+	void *p;
+	int err = -1;
+
+	p = nvme_cli_log_cache_lookup(dev, name, &clen);
+	if (!p)
+		return -1;
+
+	if (clen == len) {
+		memcpy(data, p, len);
+		err = 0;
+	} else if (clen == sizeof(status)) {
+		memcpy(&status, p, sizeof(status));
+		err = le32_to_cpu(status);
+		if (!log_cache_status(err))
+			err = -1;
+	}
+	free(p);
+
+	return err;
+}
+
+static void log_cache_put(struct nvme_dev *dev, const char *name, int err,
+			  const void *data, size_t len)
+{
+	__le32 status = cpu_to_le32(err);
+
+	if (!err)
+		nvme_cli_log_cache_store(dev, name, data, len);
+	else if (log_cache_status(err))
+		nvme_cli_log_cache_store(dev, name, &status, sizeof(status));
+}
+
+int nvme_cli_identify_uuid(struct nvme_dev *dev, struct nvme_id_uuid_list *list)
+{
+	struct nvme_identify_args args = {
+		.args_size	= sizeof(args),
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.data		= list,
+		.cns		= NVME_IDENTIFY_CNS_UUID_LIST,
+		.nsid		= NVME_NSID_NONE,
+		.cntid		= NVME_CNTLID_NONE,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+	};
+	int err;
+
+	err = log_cache_get(dev, "uuid-list", list, sizeof(*list));
+	if (err >= 0)
+		return err;
+
+	err = do_admin_args_op(identify, dev, (&args));
+	log_cache_put(dev, "uuid-list", err, list, sizeof(*list));
+
+	return err;
+}
+
+int nvme_cli_get_log_supported_uuid(struct nvme_dev *dev, __u8 uuidx,
+				    struct nvme_supported_log_pages *log)
+{
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lid		= NVME_LOG_LID_SUPPORTED_LOG_PAGES,
+		.nsid		= NVME_NSID_ALL,
+		.csi		= NVME_CSI_NVM,
+		.lsi		= NVME_LOG_LSI_NONE,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.uuidx		= uuidx,
+		.log		= log,
+		.len		= sizeof(*log),
+	};
+	char name[32];
+	int err;
+
+	snprintf(name, sizeof(name), "supported-%u", uuidx);
+	err = log_cache_get(dev, name, log, sizeof(*log));
+	if (err >= 0)
+		return err;
+
+	err = do_admin_args_op(get_log, dev, (&args));
+	log_cache_put(dev, name, err, log, sizeof(*log));
+
+	return err;
+}
+
+int nvme_cli_log_supported(struct nvme_dev *dev, __u8 lid, __u8 uuidx)
+{
+	struct nvme_supported_log_pages log;
+	struct log_cache c;
+
+	/* only worth a command if the answer can be kept */
+	if (!log_cache_init(dev, &c) ||
+	    nvme_cli_get_log_supported_uuid(dev, uuidx, &log))
+		return -1;
+
+	/* LSUPP */
+	return le32_to_cpu(log.lid_support[lid]) & 0x1;
+}
+
 int nvme_cli_identify(struct nvme_dev *dev, struct nvme_identify_args *args)
 {
 	return do_admin_args_op(identify, dev, args);
@@ -54,7 +428,22 @@ int nvme_cli_identify(struct nvme_dev *dev, struct nvme_identify_args *args)
 
 int nvme_cli_identify_ctrl(struct nvme_dev *dev, struct nvme_id_ctrl *ctrl)
 {
-	return do_admin_op(identify_ctrl, dev, ctrl);
+	struct id_cache c;
+	char name[32];
+	int err;
+
+	if (!id_cache_init(dev, &c))
+		return do_admin_op(identify_ctrl, dev, ctrl);
+
+	snprintf(name, sizeof(name), "ctrl-%s", c.cntlid);
+	if (id_cache_lookup(&c, name, ctrl, sizeof(*ctrl)))
+		return 0;
+
+	err = do_admin_op(identify_ctrl, dev, ctrl);
+	if (!err)
+		id_cache_store(&c, name, ctrl, sizeof(*ctrl));
+
+	return err;
 }
 
 int nvme_cli_identify_ctrl_list(struct nvme_dev *dev, __u16 ctrl_id,
@@ -119,36 +508,43 @@ int nvme_cli_get_features(struct nvme_dev *dev,
 	return do_admin_args_op(get_features, dev, args);
 }
 
+/* The identify data of the subsystem changes with the commands below */
+#define id_cache_drop(d, rc) ({						\
+	int __err = rc;							\
+	if (__err != -1)						\
+		nvme_cli_id_cache_invalidate(d);			\
+	__err; })
+
 int nvme_cli_ns_mgmt_delete(struct nvme_dev *dev, __u32 nsid)
 {
-	return do_admin_op(ns_mgmt_delete, dev, nsid);
+	return id_cache_drop(dev, do_admin_op(ns_mgmt_delete, dev, nsid));
 }
 
 int nvme_cli_ns_attach(struct nvme_dev *dev, struct nvme_ns_attach_args *args)
 {
-	return do_admin_args_op(ns_attach, dev, args);
+	return id_cache_drop(dev, do_admin_args_op(ns_attach, dev, args));
 }
 
 int nvme_cli_ns_attach_ctrls(struct nvme_dev *dev, __u32 nsid,
 			     struct nvme_ctrl_list *ctrlist)
 {
-	return do_admin_op(ns_attach_ctrls, dev, nsid, ctrlist);
+	return id_cache_drop(dev, do_admin_op(ns_attach_ctrls, dev, nsid, ctrlist));
 }
 
 int nvme_cli_ns_detach_ctrls(struct nvme_dev *dev, __u32 nsid,
 			     struct nvme_ctrl_list *ctrlist)
 {
-	return do_admin_op(ns_detach_ctrls, dev, nsid, ctrlist);
+	return id_cache_drop(dev, do_admin_op(ns_detach_ctrls, dev, nsid, ctrlist));
 }
 
 int nvme_cli_format_nvm(struct nvme_dev *dev, struct nvme_format_nvm_args *args)
 {
-	return do_admin_args_op(format_nvm, dev, args);
+	return id_cache_drop(dev, do_admin_args_op(format_nvm, dev, args));
 }
 
 int nvme_cli_sanitize_nvm(struct nvme_dev *dev, struct nvme_sanitize_nvm_args *args)
 {
-	return do_admin_args_op(sanitize_nvm, dev, args);
+	return id_cache_drop(dev, do_admin_args_op(sanitize_nvm, dev, args));
 }
 
 int nvme_cli_get_log(struct nvme_dev *dev, struct nvme_get_log_args *args)
@@ -356,7 +752,7 @@ int nvme_cli_fw_download(struct nvme_dev *dev,
 int nvme_cli_fw_commit(struct nvme_dev *dev,
 			 struct nvme_fw_commit_args *args)
 {
-	return do_admin_args_op(fw_commit, dev, args);
+	return id_cache_drop(dev, do_admin_args_op(fw_commit, dev, args));
 }
 
 int nvme_cli_admin_passthru(struct nvme_dev *dev, __u8 opcode, __u8 flags,
@@ -380,8 +776,8 @@ int nvme_cli_ns_mgmt_create(struct nvme_dev *dev,
 			__u32 *nsid, __u32 timeout, __u8 csi)
 {
 	if (dev->type == NVME_DEV_DIRECT)
-		return nvme_ns_mgmt_create(dev_fd(dev), NULL, nsid, timeout,
-							csi, data);
+		return id_cache_drop(dev, nvme_ns_mgmt_create(dev_fd(dev), NULL,
+					nsid, timeout, csi, data));
 	if (dev->type == NVME_DEV_MI)
 		return nvme_mi_admin_ns_mgmt_create(dev->mi.ctrl, NULL,
 						    csi, nsid, data);
@@ -9,6 +9,55 @@
 
 #include "nvme.h"
 
+/*
+ * nvme_cli_id_cache_invalidate - drop the cached identify data of the
+ * subsystem @dev belongs to, see NVME_ID_CACHE in nvme(1). With a NULL
+ * @dev only the data derived from it in memory is dropped.
+ */
+void nvme_cli_id_cache_invalidate(struct nvme_dev *dev);
+
+/*
+ * nvme_cli_id_cache_gen - bumped by every nvme_cli_id_cache_invalidate(),
+ * for callers keeping data derived from the identify data in memory
+ */
+unsigned int nvme_cli_id_cache_gen(void);
+
+/*
+ * nvme_cli_id_cache_lookup/store - entry @name of data derived from the
+ * identify data of the controller of @dev, e.g. by a plugin, kept and
+ * invalidated along with it. Lookups fail unless NVME_ID_CACHE is set.
+ */
+bool nvme_cli_id_cache_lookup(struct nvme_dev *dev, const char *name,
+			      void *data, size_t len);
+void nvme_cli_id_cache_store(struct nvme_dev *dev, const char *name,
+			     const void *data, size_t len);
+
+/*
+ * nvme_cli_log_cache_lookup/store - entry @name of the log page cache of
+ * the model and firmware revision of @dev, e.g. the vendor log directory
+ * a plugin read, see NVME_LOG_CACHE in nvme(1). Lookups return the
+ * malloc'ed data and its size in @len, NULL unless NVME_LOG_CACHE is set.
+ */
+void *nvme_cli_log_cache_lookup(struct nvme_dev *dev, const char *name,
+				size_t *len);
+void nvme_cli_log_cache_store(struct nvme_dev *dev, const char *name,
+			      const void *data, size_t len);
+
+/*
+ * nvme_cli_log_supported - whether the controller of @dev supports log
+ * page @lid with UUID index @uuidx according to its Supported Log Pages
+ * log, cached per model and firmware revision
+ *
+ * Returns 1 or 0, or -1 if unknown, always without NVME_LOG_CACHE and if
+ * the controller doesn't have the log. Plugins ask before trying a page.
+ */
+int nvme_cli_log_supported(struct nvme_dev *dev, __u8 lid, __u8 uuidx);
+
+/* the Identify UUID List and Supported Log Pages, kept in the log page cache */
+int nvme_cli_identify_uuid(struct nvme_dev *dev, struct nvme_id_uuid_list *list);
+int nvme_cli_get_log_supported_uuid(struct nvme_dev *dev, __u8 uuidx,
+				    struct nvme_supported_log_pages *log);
+
 int nvme_cli_identify(struct nvme_dev *dev, struct nvme_identify_args *args);
 int nvme_cli_identify_ctrl(struct nvme_dev *dev, struct nvme_id_ctrl *ctrl);
 int nvme_cli_identify_ctrl_list(struct nvme_dev *dev, __u16 ctrl_id,
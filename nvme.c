@@ -42,12 +42,16 @@
 #include <dirent.h>
 #include <libgen.h>
 #include <signal.h>
+#include <poll.h>
+#include <pthread.h>
 
 #include <linux/fs.h>
 
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/un.h>
 
 #if HAVE_SYS_RANDOM
 	#include <sys/random.h>
@@ -58,13 +62,38 @@
 #include "common.h"
 #include "nvme.h"
 #include "nvme-print.h"
+#include "nvme-fanout.h"
+#include "nvme-io-engine.h"
+#include "nvme-trace.h"
+#include "nvme-watch.h"
+#include "nvme-archive.h"
+#include "nvme-exporter.h"
+#include "nvme-snapshot.h"
 #include "plugin.h"
+#include "plugins/ocp/ocp-smart-extended-log.h"
 #include "util/base64.h"
+#include "util/batch.h"
+#include "util/bundle.h"
+#include "util/cache.h"
+#include "util/capture.h"
 #include "util/crc32.h"
+#include "util/interval.h"
+#include "util/mock.h"
+#include "util/pevent-store.h"
+#include "util/pi.h"
+#include "util/pmr.h"
+#include "util/ratelimit.h"
+#include "util/replay.h"
 #include "nvme-wrap.h"
 #include "util/argconfig.h"
 #include "util/suffix.h"
 #include "util/logging.h"
+#include "util/stream.h"
+#include "util/sysfs.h"
+#include "util/thread-pool.h"
+#include "util/timing.h"
+#include "util/workload.h"
+#include "util/alloc-stats.h"
 #include "fabrics.h"
 #define CREATE_CMD
 #include "nvme-builtin.h"
@@ -107,6 +136,11 @@ struct passthru_config {
 	bool	write;
 	__u8	prefill;
 	bool	latency;
+	bool	cmb;
+	__u32	repeat;
+	__u32	queue_depth;
+	__u32	threads;
+	char	*namespaces;
 };
 
 struct get_reg_config {
@@ -188,12 +222,14 @@ static struct program nvme = {
 	.usage = "<command> [<device>] [<args>]",
 	.desc = "The '<device>' may be either an NVMe character "
 		"device (ex: /dev/nvme0), an nvme block device "
-		"(ex: /dev/nvme0n1), or a mctp address in the form "
-		"mctp:<net>,<eid>[:ctrl-id]",
+		"(ex: /dev/nvme0n1), a mctp address in the form "
+		"mctp:<net>,<eid>[:ctrl-id], or a capture bundle "
+		"replayed as a device in the form "
+		"mock:<bundle>[,latency=<us>]",
 	.extensions = &builtin,
 };
 
-const char *output_format = "Output format: normal|json|binary";
+const char *output_format = "Output format: normal|json|json-compact|ndjson|cbor|binary";
 static const char *app_tag = "app tag for end-to-end PI";
 static const char *app_tag_mask = "app tag mask for end-to-end PI";
 static const char *block_count = "number of blocks (zeroes based) on device to access";
@@ -231,11 +267,21 @@ static const char *raw_log = "show log in binary format";
 static const char *raw_output = "output in binary format";
 static const char *ref_tag = "reference tag for end-to-end PI";
 static const char *raw_use = "use binary output";
+static const char *repeat = "issue the command N times, with --latency report percentiles";
+static const char *watch_desc = "keep running and report topology changes from uevents";
 static const char *rtype = "reservation type";
 static const char *secp = "security protocol (cf. SPC-4)";
 static const char *spsp = "security-protocol-specific (cf. SPC-4)";
 static const char *start_block = "64-bit LBA of first block to access";
 static const char *storage_tag = "storage tag for end-to-end PI";
+static const char *sweep_queue_depth = "commands in flight per thread for --range";
+static const char *sweep_range = "LBA extent <start>:<end> (end exclusive, empty or 'all' for the\n"
+	"end of the namespace) covered with the largest commands the controller allows";
+static const char *sweep_rate = "limit the bulk I/O to this many bytes per second";
+static const char *sweep_rate_iops = "limit the bulk I/O to this many commands per second";
+static const char *sweep_max_latency = "back the rate limits off while commands take longer than\n"
+	"this many microseconds, halving them down to 1/64 and recovering gradually";
+static const char *sweep_threads = "number of submission threads for --range";
 static const char *timeout = "timeout value, in milliseconds";
 static const char *uuid_index = "UUID index";
 static const char *uuid_index_specify = "specify uuid index";
@@ -260,9 +306,81 @@ static const char *pmrmscl = "PMRMSCL=0xe14 register offset";
 static const char *pmrmscu = "PMRMSCU=0xe18 register offset";
 
 static char *output_format_val = "normal";
+static bool output_format_json;
 int verbose_level;
 
+/*
+ * The rate limits of the bulk modes, the sweeps of --range, compare-hash
+ * and the telemetry transfer, all taking the same options.
+ */
+struct io_rate_cfg {
+	__u64	rate;
+	__u64	rate_iops;
+	__u32	max_latency;
+};
+
+#define OPT_IO_RATE(r)								\
+	OPT_SUFFIX("rate",        'L', &(r)->rate,        sweep_rate),		\
+	OPT_SUFFIX("rate-iops",   0,   &(r)->rate_iops,   sweep_rate_iops),	\
+	OPT_UINT("max-latency",   0,   &(r)->max_latency, sweep_max_latency)
+
+static int io_rate_check(const struct io_rate_cfg *r)
+{
+	if (r->max_latency && !r->rate && !r->rate_iops) {
+		nvme_show_error("--max-latency needs --rate or --rate-iops to back off from");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* limit @job, commands count for @cost bytes of --rate */
+static int io_rate_apply(const struct io_rate_cfg *r, struct nvme_io_job *job, __u64 cost)
+{
+	int err = io_rate_check(r);
+
+	if (err)
+		return err;
+
+	job->rate_bps = r->rate;
+	job->rate_iops = r->rate_iops;
+	job->io_cost = cost;
+	job->target_lat_ns = (__u64)r->max_latency * NSEC_PER_USEC;
+
+	return 0;
+}
+
+/*
+ * nvme -b runs the commands of a script in one process. The devices the
+ * commands open and the scanned topology are kept for the rest of the
+ * batch instead of being released after every command, and so are the
+ * getopt tables of the commands run. The Commands Supported and Effects
+ * log of a device is read once, when the effects of a command are first
+ * asked for.
+ */
+static bool batch_mode;
+static struct batch_dev {
+	char *path;
+	int flags;
+	struct nvme_dev *dev;
+	bool effects_read;
+	struct nvme_cmd_effects_log *effects;	/* NULL if it couldn't be read */
+} *batch_devs;
+static int nr_batch_devs;
+static nvme_root_t batch_root;
+/* by the description of the command, which every call passes the same */
+static struct batch_parser {
+	const char *desc;
+	struct argconfig_parser p;
+} *batch_parsers;
+static int nr_batch_parsers;
+/* the device the current command of the batch opened, and the raw opcode it sent */
+static struct nvme_dev *batch_cmd_dev;
+static int batch_cmd_opcode = -1;
+static bool batch_cmd_admin;
+
 static void *mmap_registers(struct nvme_dev *dev, bool writable);
+static int active_nsids(struct nvme_dev *dev, __u32 **nsidsp, int *nrp);
 
 const char *nvme_strerror(int errnum)
 {
@@ -301,11 +419,176 @@ static bool is_blkdev(struct nvme_dev *dev)
 	return S_ISBLK(dev->direct.stat.st_mode);
 }
 
+static struct nvme_dev *batch_dev_find(const char *path, int flags)
+{
+	int i;
+
+	for (i = 0; i < nr_batch_devs; i++)
+		if (batch_devs[i].flags == flags && !strcmp(batch_devs[i].path, path))
+			return batch_cmd_dev = batch_devs[i].dev;
+
+	return NULL;
+}
+
+/* keep @dev open for the rest of the batch, it is closed as usual on failure */
+static void batch_dev_add(struct nvme_dev *dev, const char *path, int flags)
+{
+	struct batch_dev *tmp;
+	char *copy;
+
+	copy = strdup(path);
+	if (!copy)
+		return;
+
+	tmp = realloc(batch_devs, (nr_batch_devs + 1) * sizeof(*tmp));
+	if (!tmp) {
+		free(copy);
+		return;
+	}
+	batch_devs = tmp;
+	batch_devs[nr_batch_devs++] = (struct batch_dev) {
+		.path = copy,
+		.flags = flags,
+		.dev = dev,
+	};
+	/* the command line the device was named on is gone after the command */
+	dev->name = basename(copy);
+	batch_cmd_dev = dev;
+}
+
+static struct batch_dev *batch_dev_entry(struct nvme_dev *dev)
+{
+	int i;
+
+	for (i = 0; i < nr_batch_devs; i++)
+		if (batch_devs[i].dev == dev)
+			return &batch_devs[i];
+
+	return NULL;
+}
+
+static bool batch_dev_cached(struct nvme_dev *dev)
+{
+	return batch_dev_entry(dev) != NULL;
+}
+
+/*
+ * The Commands Supported and Effects entry of @opcode on @dev, from the
+ * log kept for the batch. Returns false outside a batch, or if the log
+ * isn't supported or doesn't list the command.
+ */
+static bool batch_effects(struct nvme_dev *dev, bool admin, __u8 opcode, __u32 *effects)
+{
+	struct batch_dev *b = dev ? batch_dev_entry(dev) : NULL;
+
+	if (!b)
+		return false;
+
+	if (!b->effects_read) {
+		b->effects_read = true;
+		b->effects = nvme_alloc(sizeof(*b->effects));
+		if (b->effects && nvme_cli_get_log_cmd_effects(dev, NVME_CSI_NVM, b->effects)) {
+			free(b->effects);
+			b->effects = NULL;
+		}
+	}
+	if (!b->effects)
+		return false;
+
+	*effects = le32_to_cpu(admin ? b->effects->acs[opcode] : b->effects->iocs[opcode]);
+
+	return *effects & NVME_CMD_EFFECTS_CSUPP;
+}
+
+/*
+ * Whether commands of @opcode may be sent to @dev from several threads at once,
+ * false if the controller restricts their submission and execution (CSE).
+ */
+static bool cmd_concurrent(struct nvme_dev *dev, bool admin, __u8 opcode)
+{
+	__u32 effects;
+
+	if (dev->type != NVME_DEV_DIRECT)
+		return false;
+
+	return !batch_effects(dev, admin, opcode, &effects) ||
+		!(effects & NVME_CMD_EFFECTS_CSE_MASK);
+}
+
+static void batch_devs_close(void)
+{
+	struct batch_dev *devs = batch_devs;
+	int i, nr = nr_batch_devs;
+
+	batch_devs = NULL;
+	nr_batch_devs = 0;
+	for (i = 0; i < nr; i++) {
+		dev_close(devs[i].dev);
+		free(devs[i].path);
+		free(devs[i].effects);
+	}
+	free(devs);
+}
+
+/*
+ * The namespaces may have changed, drop the topology and the block
+ * devices; the controller character devices stay usable.
+ */
+static void batch_invalidate(void)
+{
+	struct nvme_dev *dev;
+	int i = 0;
+
+	nvme_cli_id_cache_invalidate(NULL);
+	if (batch_root) {
+		nvme_free_tree(batch_root);
+		batch_root = NULL;
+	}
+
+	while (i < nr_batch_devs) {
+		dev = batch_devs[i].dev;
+		if (dev->type != NVME_DEV_DIRECT || !is_blkdev(dev)) {
+			i++;
+			continue;
+		}
+		free(batch_devs[i].path);
+		free(batch_devs[i].effects);
+		batch_devs[i] = batch_devs[--nr_batch_devs];
+		dev_close(dev);
+	}
+}
+
+/*
+ * Place the large buffers of the commands on the NUMA node of the device,
+ * and with --numa-pin the process on the CPUs local to it, so its DMA
+ * doesn't cross the sockets. The threads started later inherit the CPUs.
+ */
+static bool numa_pin;
+
+static void dev_numa_setup(struct nvme_dev *dev)
+{
+	cpu_set_t cpus;
+
+	nvme_mem_set_node(sysfs_numa_node(dev->name));
+	if (numa_pin && !sysfs_local_cpus(dev->name, &cpus) &&
+	    sched_setaffinity(0, sizeof(cpus), &cpus))
+		nvme_show_perror("sched_setaffinity");
+}
+
 static int open_dev_direct(struct nvme_dev **devp, char *devstr, int flags)
 {
 	struct nvme_dev *dev;
 	int err;
 
+	if (batch_mode) {
+		dev = batch_dev_find(devstr, flags);
+		if (dev) {
+			dev_numa_setup(dev);
+			*devp = dev;
+			return 0;
+		}
+	}
+
 	dev = calloc(1, sizeof(*dev));
 	if (!dev)
 		return -1;
@@ -330,6 +613,9 @@ static int open_dev_direct(struct nvme_dev **devp, char *devstr, int flags)
 		err = -1;
 		goto err_close;
 	}
+	dev_numa_setup(dev);
+	if (batch_mode)
+		batch_dev_add(dev, devstr, flags);
 	*devp = dev;
 	return 0;
 
@@ -372,6 +658,15 @@ static int open_dev_mi_mctp(struct nvme_dev **devp, char *devstr)
 		return rc;
 	}
 
+	/* the endpoint stays open, the MCTP setup runs once per batch */
+	if (batch_mode) {
+		dev = batch_dev_find(devstr, 0);
+		if (dev) {
+			*devp = dev;
+			return 0;
+		}
+	}
+
 	dev = calloc(1, sizeof(*dev));
 	if (!dev)
 		return -1;
@@ -392,6 +687,8 @@ static int open_dev_mi_mctp(struct nvme_dev **devp, char *devstr)
 	if (!dev->mi.ctrl)
 		goto err_close_ep;
 
+	if (batch_mode)
+		batch_dev_add(dev, devstr, 0);
 	*devp = dev;
 	return 0;
 
@@ -404,6 +701,51 @@ err_free:
 	return -1;
 }
 
+/*
+ * A direct device answered from the bundle of "mock:<bundle>[,latency=<us>]",
+ * see util/mock.h. It passes for a controller character device, its fd is
+ * the one of the bundle file.
+ */
+static int open_dev_mock(struct nvme_dev **devp, char *devstr)
+{
+	char *file = devstr + strlen("mock:"), *opt, *end;
+	unsigned long latency = 0;
+	struct nvme_dev *dev;
+	int err;
+
+	opt = strstr(file, ",latency=");
+	if (opt) {
+		latency = strtoul(opt + strlen(",latency="), &end, 0);
+		if (*end || latency > UINT32_MAX) {
+			nvme_show_error("invalid mock device %s", devstr);
+			errno = EINVAL;
+			return -1;
+		}
+		*opt = '\0';
+	}
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return -1;
+
+	err = nvme_mock_open(file, latency, &dev->mock);
+	if (err) {
+		errno = -err;
+		nvme_show_perror(file);
+		free(dev);
+		return -1;
+	}
+
+	dev->type = NVME_DEV_DIRECT;
+	dev->name = basename(file);
+	dev->direct.fd = nvme_mock_fd(dev->mock);
+	fstat(dev->direct.fd, &dev->direct.stat);
+	dev->direct.stat.st_mode = S_IFCHR | 0600;
+
+	*devp = dev;
+	return 0;
+}
+
 static int check_arg_dev(int argc, char **argv)
 {
 	if (optind >= argc) {
@@ -416,6 +758,7 @@ static int check_arg_dev(int argc, char **argv)
 
 static int get_dev(struct nvme_dev **dev, int argc, char **argv, int flags)
 {
+	enum nvme_timing_phase phase;
 	char *devname;
 	int ret;
 
@@ -425,25 +768,97 @@ static int get_dev(struct nvme_dev **dev, int argc, char **argv, int flags)
 
 	devname = argv[optind];
 
+	phase = nvme_timing_switch(NVME_TIMING_OPEN);
 	if (!strncmp(devname, "mctp:", strlen("mctp:")))
 		ret = open_dev_mi_mctp(dev, devname);
+	else if (!strncmp(devname, "mock:", strlen("mock:")))
+		ret = open_dev_mock(dev, devname);
 	else
 		ret = open_dev_direct(dev, devname, flags);
+	nvme_timing_switch(phase);
 
 	return ret != 0 ? -errno : 0;
 }
 
+/* the options of a command seen before parse with the tables of its first line */
+static int batch_parse(int argc, char *argv[], const char *desc,
+		       struct argconfig_commandline_options *opts)
+{
+	struct batch_parser *tmp, *bp;
+	int i;
+
+	for (i = 0; i < nr_batch_parsers; i++) {
+		bp = &batch_parsers[i];
+		if (bp->desc == desc && argconfig_parser_rebind(&bp->p, opts))
+			return argconfig_parser_parse(&bp->p, argc, argv, desc);
+	}
+
+	tmp = realloc(batch_parsers, (nr_batch_parsers + 1) * sizeof(*tmp));
+	if (!tmp)
+		return argconfig_parse(argc, argv, desc, opts);
+	batch_parsers = tmp;
+	bp = &batch_parsers[nr_batch_parsers];
+	if (argconfig_parser_init(&bp->p, opts))
+		return argconfig_parse(argc, argv, desc, opts);
+	bp->desc = desc;
+	nr_batch_parsers++;
+
+	return argconfig_parser_parse(&bp->p, argc, argv, desc);
+}
+
+static void batch_parsers_free(void)
+{
+	int i;
+
+	for (i = 0; i < nr_batch_parsers; i++)
+		argconfig_parser_free(&batch_parsers[i].p);
+	free(batch_parsers);
+	batch_parsers = NULL;
+	nr_batch_parsers = 0;
+}
+
+/*
+ * Parses output_format_val once on the main thread, after the options or
+ * a command changed it. The printers ask for every record, from the
+ * decode workers and the exporter thread too, and only read the result.
+ */
+static void output_format_resolve(void)
+{
+	enum nvme_print_flags flags;
+
+	output_format_json = !validate_output_format(output_format_val, &flags) &&
+		flags == JSON;
+}
+
+/* the --output-format of the command, a plugin may keep its own */
+static const char *opts_output_format(struct argconfig_commandline_options *opts)
+{
+	struct argconfig_commandline_options *o;
+
+	for (o = opts; o->option; o++)
+		if (!strcmp(o->option, "output-format") &&
+		    o->config_type == CFG_STRING)
+			return *(char **)o->default_value;
+
+	return output_format_val;
+}
+
 static int parse_args(int argc, char *argv[], const char *desc,
 		      struct argconfig_commandline_options *opts)
 {
 	int ret;
 
-	ret = argconfig_parse(argc, argv, desc, opts);
+	if (batch_mode)
+		ret = batch_parse(argc, argv, desc, opts);
+	else
+		ret = argconfig_parse(argc, argv, desc, opts);
 	if (ret)
 		return ret;
 
 	log_level = map_log_level(verbose_level, false);
 	nvme_init_default_logging(stderr, log_level, false, false);
+	nvme_set_json_output_mode(opts_output_format(opts));
+	output_format_resolve();
 
 	return 0;
 }
@@ -465,6 +880,68 @@ int parse_and_open(struct nvme_dev **dev, int argc, char **argv,
 	return ret;
 }
 
+int parse_and_open_input(struct nvme_dev **dev, int argc, char **argv,
+			 const char *desc,
+			 struct argconfig_commandline_options *opts,
+			 char **input)
+{
+	int ret;
+
+	ret = parse_args(argc, argv, desc, opts);
+	if (ret || (*input && **input))
+		return ret;
+
+	ret = get_dev(dev, argc, argv, O_RDONLY);
+	if (ret < 0)
+		argconfig_print_help(desc, opts);
+
+	return ret;
+}
+
+/* what the callbacks of nvme_decode_captures() need of the command line */
+struct capture_args {
+	__u32 nsid;
+	enum nvme_print_flags flags;
+	void (*vs)(__u8 *vs, struct json_object *root);
+};
+
+int nvme_decode_captures(char *files, size_t size, bool whole, const char *what,
+			 nvme_capture_show_t show, void *arg)
+{
+	struct nvme_capture c;
+	char *file, *save;
+	size_t off;
+	int err = 0, ret;
+
+	for (file = strtok_r(files, ",", &save); file; file = strtok_r(NULL, ",", &save)) {
+		ret = nvme_capture_map(file, &c);
+		if (!ret && c.len % size) {
+			nvme_capture_unmap(&c);
+			ret = -EINVAL;
+		}
+		if (ret) {
+			if (ret == -EINVAL)
+				nvme_show_error("%s: not a capture of %s", file, what);
+			else
+				nvme_show_error("%s: %s", file, nvme_strerror(-ret));
+			if (!err)
+				err = ret;
+			continue;
+		}
+
+		if (whole)
+			ret = show(c.data, c.len, file, arg);
+		else
+			for (off = 0, ret = 0; off < c.len && !ret; off += size)
+				ret = show((__u8 *)c.data + off, size, file, arg);
+		nvme_capture_unmap(&c);
+		if (ret && !err)
+			err = ret;
+	}
+
+	return err;
+}
+
 int open_exclusive(struct nvme_dev **dev, int argc, char **argv,
 		   int ignore_exclusive)
 {
@@ -487,6 +964,12 @@ int validate_output_format(const char *format, enum nvme_print_flags *flags)
 		f = NORMAL;
 	else if (!strcmp(format, "json"))
 		f = JSON;
+	else if (!strcmp(format, "json-compact"))
+		f = JSON;
+	else if (!strcmp(format, "ndjson"))
+		f = JSON;
+	else if (!strcmp(format, "cbor"))
+		f = JSON;
 	else if (!strcmp(format, "binary"))
 		f = BINARY;
 	else
@@ -497,21 +980,39 @@ int validate_output_format(const char *format, enum nvme_print_flags *flags)
 	return 0;
 }
 
-bool nvme_is_output_format_json(void)
+void nvme_set_json_output_mode(const char *format)
 {
-	enum nvme_print_flags flags;
+#ifdef CONFIG_JSONC
+	if (!format)
+		return;
 
-	if (validate_output_format(output_format_val, &flags))
-		return false;
+	if (!strcmp(format, "json-compact"))
+		json_set_output_mode(JSON_OUTPUT_COMPACT);
+	else if (!strcmp(format, "ndjson"))
+		json_set_output_mode(JSON_OUTPUT_NDJSON);
+	else if (!strcmp(format, "cbor"))
+		json_set_output_mode(JSON_OUTPUT_CBOR);
+	else
+		json_set_output_mode(JSON_OUTPUT_PRETTY);
+#endif
+}
 
-	return flags == JSON;
+bool nvme_is_output_format_json(void)
+{
+	return output_format_json;
 }
 
 void dev_close(struct nvme_dev *dev)
 {
+	if (batch_dev_cached(dev))
+		return;
+
 	switch (dev->type) {
 	case NVME_DEV_DIRECT:
-		close(dev_fd(dev));
+		if (dev->mock)
+			nvme_mock_close(dev->mock);
+		else
+			close(dev_fd(dev));
 		break;
 	case NVME_DEV_MI:
 		nvme_mi_close(dev->mi.ep);
@@ -521,95 +1022,232 @@ void dev_close(struct nvme_dev *dev)
 	free(dev);
 }
 
-static int get_smart_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static double smart_delta(__u8 *cur, __u8 *prev)
 {
-	const char *desc = "Retrieve SMART log for the given device "
-		"(or optionally a namespace) in either decoded format "
-		"(default) or binary.";
-
-	_cleanup_free_ struct nvme_smart_log *smart_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	const char *namespace = "(optional) desired namespace";
-	enum nvme_print_flags flags;
-	int err = -1;
-
-	struct config {
-		__u32	namespace_id;
-		bool	raw_binary;
-		bool	human_readable;
-	};
+	return int128_to_double(cur) - int128_to_double(prev);
+}
 
-	struct config cfg = {
-		.namespace_id	= NVME_NSID_ALL,
-		.raw_binary	= false,
-		.human_readable	= false,
-	};
+/*
+ * smart-log --interval: read the log on a fixed schedule into one of two
+ * buffers and print the rates between consecutive samples.
+ */
+static int smart_log_sampler(struct nvme_dev *dev, __u32 nsid, __u32 interval,
+			     __u32 count, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_smart_log *logs = NULL;
+	struct nvme_smart_log *cur, *prev, *tmp;
+	struct nvme_smart_sample s;
+	__u64 next, now, last;
+	struct timespec ts;
+	double secs;
+	__u32 n;
+	int err;
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_output),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info));
+	logs = nvme_alloc(2 * sizeof(*logs));
+	if (!logs)
+		return -ENOMEM;
+	prev = &logs[0];
+	cur = &logs[1];
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = nvme_cli_get_log_smart(dev, nsid, false, prev);
 	if (err)
-		return err;
+		goto err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
-
-	if (cfg.raw_binary)
-		flags = BINARY;
+	nvme_stop_catch(true, NULL);
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	next = last = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
 
-	smart_log = nvme_alloc(sizeof(*smart_log));
-	if (!smart_log)
-		return -ENOMEM;
+		err = nvme_cli_get_log_smart(dev, nsid, false, cur);
+		if (err)
+			break;
 
-	err = nvme_cli_get_log_smart(dev, cfg.namespace_id, false,
-				     smart_log);
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		secs = (now - last) / 1e9;
+
+		memset(&s, 0, sizeof(s));
+		s.nsid = nsid;
+		s.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+		s.interval_ns = now - last;
+		/* a data unit is 1000 512 byte units */
+		s.read_rate = smart_delta(cur->data_units_read,
+					  prev->data_units_read) * 512000 / secs;
+		s.write_rate = smart_delta(cur->data_units_written,
+					   prev->data_units_written) * 512000 / secs;
+		s.read_cmds = smart_delta(cur->host_reads, prev->host_reads) / secs;
+		s.write_cmds = smart_delta(cur->host_writes, prev->host_writes) / secs;
+		/* the busy time is reported in minutes */
+		s.busy = smart_delta(cur->ctrl_busy_time, prev->ctrl_busy_time) *
+			60 / secs;
+		s.media_errors = smart_delta(cur->media_errors, prev->media_errors);
+		s.err_log_entries = smart_delta(cur->num_err_log_entries,
+						prev->num_err_log_entries);
+		s.temperature = cur->temperature[1] << 8 | cur->temperature[0];
+		s.temperature_delta = s.temperature -
+			(prev->temperature[1] << 8 | prev->temperature[0]);
+		s.critical_warning = cur->critical_warning;
+		s.avail_spare = cur->avail_spare;
+		s.percent_used = cur->percent_used;
+		nvme_show_smart_sample(&s, flags);
+
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
+	}
+
+	nvme_stop_release();
 	if (!err)
-		nvme_show_smart_log(smart_log, cfg.namespace_id,
-				    dev->name, flags);
-	else if (err > 0)
+		return 0;
+err:
+	if (err > 0)
 		nvme_show_status(err);
 	else
 		nvme_show_error("smart log: %s", nvme_strerror(errno));
-
 	return err;
 }
 
-static int get_ana_log(int argc, char **argv, struct command *cmd,
-		struct plugin *plugin)
+static int smart_log_show_capture(void *data, size_t len, const char *file, void *arg)
 {
-	const char *desc = "Retrieve ANA log for the given device in "
-		"decoded format (default), json or binary.";
-	const char *groups = "Return ANA groups only.";
+	struct capture_args *c = arg;
+
+	nvme_show_smart_log(data, c->nsid, file, c->flags);
+	return 0;
+}
+
+struct smart_ns_work {
+	struct nvme_dev *dev;
+	struct nvme_smart_ns *ns;
+};
+
+static void smart_ns_work_fn(void *arg)
+{
+	struct smart_ns_work *w = arg;
+	int err;
+
+	err = nvme_cli_get_log_smart(w->dev, w->ns->nsid, false, &w->ns->log);
+	w->ns->err = err < 0 ? -errno : err;
+}
+
+/* the busiest writers first, the namespaces without a log last */
+static int smart_ns_cmp(const void *a, const void *b)
+{
+	const struct nvme_smart_ns *na = a, *nb = b;
+	nvme_uint128_t wa, wb;
+	int i;
+
+	if (!na->err != !nb->err)
+		return na->err ? 1 : -1;
+
+	if (!na->err) {
+		wa = le128_to_cpu((__u8 *)na->log.data_units_written);
+		wb = le128_to_cpu((__u8 *)nb->log.data_units_written);
+		for (i = 0; i < 4; i++)
+			if (wa.words[i] != wb.words[i])
+				return wa.words[i] > wb.words[i] ? -1 : 1;
+	}
+
+	return na->nsid < nb->nsid ? -1 : na->nsid > nb->nsid;
+}
+
+/*
+ * smart-log --all-namespaces: the SMART log of every active namespace,
+ * @jobs of them in flight on the admin queue at a time.
+ */
+static int smart_log_all(struct nvme_dev *dev, __u32 jobs, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_smart_ns *list = NULL;
+	_cleanup_free_ struct smart_ns_work *works = NULL;
+	_cleanup_free_ __u32 *nsids = NULL;
+	struct nvme_thread_pool *pool = NULL;
+	int i, nr, err;
+
+	err = active_nsids(dev, &nsids, &nr);
+	if (err)
+		return err;
+
+	list = nvme_alloc((nr ? nr : 1) * sizeof(*list));
+	works = calloc(nr ? nr : 1, sizeof(*works));
+	if (!list || !works)
+		return -ENOMEM;
 
+	if (!jobs || jobs > (__u32)nr)
+		jobs = max(nr, 1);
+
+	if (nr > 1 && jobs > 1 && cmd_concurrent(dev, true, nvme_admin_get_log_page))
+		pool = nvme_thread_pool_create(jobs);
+	for (i = 0; i < nr; i++) {
+		list[i].nsid = nsids[i];
+		works[i] = (struct smart_ns_work) { .dev = dev, .ns = &list[i] };
+		if (!pool || nvme_thread_pool_queue(pool, smart_ns_work_fn, &works[i]))
+			smart_ns_work_fn(&works[i]);
+	}
+	nvme_thread_pool_destroy(pool);
+
+	qsort(list, nr, sizeof(*list), smart_ns_cmp);
+	nvme_show_smart_ns_table(list, nr, dev->name, flags);
+
+	for (i = 0; i < nr; i++)
+		if (list[i].err)
+			return list[i].err;
+
+	return 0;
+}
+
+static int get_smart_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve SMART log for the given device "
+		"(or optionally a namespace) in either decoded format "
+		"(default) or binary.";
+
+	_cleanup_free_ struct nvme_smart_log *smart_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_free_ void *ana_log = NULL;
-	size_t ana_log_len;
+	const char *namespace = "(optional) desired namespace";
+	const char *interval = "seconds between samples, report rates instead of the log";
+	const char *count = "number of samples with --interval (default: until interrupted)";
+	const char *input = "comma separated SMART log captures to decode";
+	const char *all = "the log of every active namespace, by data units written";
+	const char *jobs = "number of logs in flight with --all-namespaces";
 	enum nvme_print_flags flags;
-	enum nvme_log_ana_lsp lsp;
 	int err = -1;
 
 	struct config {
-		bool	groups;
+		__u32	namespace_id;
+		bool	raw_binary;
+		bool	human_readable;
+		__u32	interval;
+		__u32	count;
+		char	*input_file;
+		bool	all;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
-		.groups = false,
+		.namespace_id	= NVME_NSID_ALL,
+		.raw_binary	= false,
+		.human_readable	= false,
+		.interval	= 0,
+		.count		= 0,
+		.input_file	= NULL,
+		.all		= false,
+		.jobs		= 16,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("groups", 'g', &cfg.groups, groups));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_output),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info),
+		  OPT_UINT("interval",       'i', &cfg.interval,       interval),
+		  OPT_UINT("count",          'c', &cfg.count,          count),
+		  OPT_LIST("input-file",       0, &cfg.input_file,     input),
+		  OPT_FLAG("all-namespaces", 'a', &cfg.all,            all),
+		  OPT_UINT("jobs",           'j', &cfg.jobs,           jobs));
+
+	err = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
 	if (err)
 		return err;
 
@@ -619,568 +1257,702 @@ static int get_ana_log(int argc, char **argv, struct command *cmd,
 		return err;
 	}
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err) {
-		nvme_show_error("ERROR : nvme_identify_ctrl() failed: %s",
-			nvme_strerror(errno));
-		return err;
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	if (cfg.all) {
+		if (flags == BINARY || cfg.interval || cfg.input_file ||
+		    cfg.namespace_id != NVME_NSID_ALL) {
+			nvme_show_error("--all-namespaces conflicts with --namespace-id, --interval,\n"
+					"--input-file and binary output");
+			return -EINVAL;
+		}
+		return smart_log_all(dev, cfg.jobs, flags);
 	}
 
-	ana_log_len = sizeof(struct nvme_ana_log) +
-		le32_to_cpu(ctrl->nanagrpid) * sizeof(struct nvme_ana_group_desc);
-	if (!(ctrl->anacap & (1 << 6)))
-		ana_log_len += le32_to_cpu(ctrl->mnan) * sizeof(__le32);
+	if (cfg.input_file) {
+		struct capture_args c = { .nsid = cfg.namespace_id, .flags = flags };
 
-	ana_log = nvme_alloc(ana_log_len);
-	if (!ana_log)
-		return -ENOMEM;
+		return nvme_decode_captures(cfg.input_file, sizeof(*smart_log), false,
+					    "a SMART log", smart_log_show_capture, &c);
+	}
 
-	lsp = cfg.groups ? NVME_LOG_ANA_LSP_RGO_GROUPS_ONLY :
-		NVME_LOG_ANA_LSP_RGO_NAMESPACES;
+	if (cfg.interval) {
+		if (flags == BINARY) {
+			nvme_show_error("--interval needs a text or json output format");
+			return -EINVAL;
+		}
+		return smart_log_sampler(dev, cfg.namespace_id, cfg.interval,
+					 cfg.count, flags);
+	}
 
-	err = nvme_cli_get_log_ana(dev, lsp, true, 0, ana_log_len, ana_log);
+	smart_log = nvme_alloc(sizeof(*smart_log));
+	if (!smart_log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_smart(dev, cfg.namespace_id, false,
+				     smart_log);
 	if (!err)
-		nvme_show_ana_log(ana_log, dev->name, ana_log_len, flags);
+		nvme_show_smart_log(smart_log, cfg.namespace_id,
+				    dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("ana-log: %s", nvme_strerror(errno));
+		nvme_show_error("smart log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int parse_telemetry_da(struct nvme_dev *dev,
-			      enum nvme_telemetry_da da,
-			      struct nvme_telemetry_log *telem,
-			      size_t *size)
-
+static int smart_temp(struct nvme_smart_log *log)
 {
-	_cleanup_free_ struct nvme_id_ctrl *id_ctrl = NULL;
-	size_t dalb = 0;
-
-	id_ctrl = nvme_alloc(sizeof(*id_ctrl));
-	if (!id_ctrl)
-		return -ENOMEM;
+	return log->temperature[1] << 8 | log->temperature[0];
+}
 
-	switch (da) {
-	case NVME_TELEMETRY_DA_1:
-		dalb = le16_to_cpu(telem->dalb1);
-		break;
-	case NVME_TELEMETRY_DA_2:
-		dalb = le16_to_cpu(telem->dalb2);
-		break;
-	case NVME_TELEMETRY_DA_3:
-		/* dalb3 >= dalb2 >= dalb1 */
-		dalb = le16_to_cpu(telem->dalb3);
-		break;
-	case NVME_TELEMETRY_DA_4:
-		if (nvme_cli_identify_ctrl(dev, id_ctrl)) {
-			perror("identify-ctrl");
-			return -errno;
-		}
+/* the thermal management counters saturate instead of wrapping */
+static __u32 thm_delta(__le32 cur, __le32 prev)
+{
+	__u32 c = le32_to_cpu(cur), p = le32_to_cpu(prev);
 
-		if (id_ctrl->lpa & 0x40) {
-			dalb = le32_to_cpu(telem->dalb4);
-		} else {
-			nvme_show_error(
-			    "Data area 4 unsupported, bit 6 of Log Page Attributes not set");
-			return -EINVAL;
-		}
-		break;
-	default:
-		nvme_show_error("Invalid data area parameter - %d", da);
-		return -EINVAL;
-	}
+	return c > p ? c - p : 0;
+}
 
-	if (dalb == 0) {
-		nvme_show_error("ERROR: No telemetry data block");
-		return -ENOENT;
-	}
-	*size = (dalb + 1) * NVME_LOG_TELEM_BLOCK_SIZE;
-	return 0;
+static void thermal_episode_add(struct nvme_thermal_episode *e,
+				struct nvme_thermal_sample *s)
+{
+	e->samples++;
+	e->tmt1_trans += s->tmt1_trans;
+	e->tmt2_trans += s->tmt2_trans;
+	e->tmt1_time += s->tmt1_time;
+	e->tmt2_time += s->tmt2_time;
+	e->max_temperature = max(e->max_temperature, s->temperature);
 }
 
-static int get_log_telemetry_ctrl(struct nvme_dev *dev, bool rae, size_t size,
-				  struct nvme_telemetry_log **buf)
+/*
+ * thermal-monitor: the SMART log read on a fixed schedule into one of two
+ * buffers, as smart-log --interval does. A sample in which the thermal
+ * management counters moved, or with the temperature critical warning,
+ * is throttled; a run of those is an episode, reported when it ends.
+ */
+static int thermal_monitor(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	struct nvme_telemetry_log *log;
-	int err;
+	const char *desc = "Sample the temperatures and the thermal management activity\n"
+		"of a controller from its SMART log, report the throttling episodes.";
+	const char *interval = "milliseconds between the samples";
+	const char *count = "number of samples (default: until interrupted)";
+	const char *samples = "print every sample, not only the throttling episodes";
 
-	log = nvme_alloc(size);
-	if (!log)
-		return -errno;
+	_cleanup_free_ struct nvme_smart_log *logs = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_smart_log *cur, *prev, *tmp;
+	struct nvme_thermal_summary sum;
+	struct nvme_thermal_episode ep = { 0 };
+	struct nvme_thermal_sample s;
+	enum nvme_print_flags flags;
+	__u64 next, now, last, start, ep_start = 0;
+	struct timespec ts;
+	bool in_episode = false;
+	__u32 n;
+	int i, err;
 
-	err = nvme_cli_get_log_telemetry_ctrl(dev, rae, 0, size, log);
-	if (err) {
-		free(log);
-		return -errno;
-	}
+	struct config {
+		__u32	interval;
+		__u32	count;
+		bool	samples;
+	};
 
-	*buf = log;
-	return 0;
-}
+	struct config cfg = {
+		.interval	= 100,
+		.count		= 0,
+		.samples	= false,
+	};
 
-static int get_log_telemetry_host(struct nvme_dev *dev, size_t size,
-				  struct nvme_telemetry_log **buf)
-{
-	struct nvme_telemetry_log *log;
-	int err;
+	NVME_ARGS(opts,
+		  OPT_UINT("interval", 'i', &cfg.interval, interval),
+		  OPT_UINT("count",    'c', &cfg.count,    count),
+		  OPT_FLAG("samples",  's', &cfg.samples,  samples));
 
-	log = nvme_alloc(size);
-	if (!log)
-		return -errno;
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
 
-	err = nvme_cli_get_log_telemetry_host(dev, 0, size, log);
-	if (err) {
-		free(log);
-		return -errno;
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
 	}
 
-	*buf = log;
-	return 0;
-}
-
-static int __create_telemetry_log_host(struct nvme_dev *dev,
-				       enum nvme_telemetry_da da,
-				       size_t *size,
-				       struct nvme_telemetry_log **buf)
-{
-	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
-	int err;
-
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
+	logs = nvme_alloc(2 * sizeof(*logs));
+	if (!logs)
 		return -ENOMEM;
+	prev = &logs[0];
+	cur = &logs[1];
 
-	err = nvme_cli_get_log_create_telemetry_host(dev, log);
-	if (err)
-		return -errno;
-
-	err = parse_telemetry_da(dev, da, log, size);
+	err = nvme_cli_get_log_smart(dev, NVME_NSID_ALL, false, prev);
 	if (err)
-		return err;
+		goto err;
 
-	return get_log_telemetry_host(dev, *size, buf);
-}
+	memset(&sum, 0, sizeof(sum));
+	sum.name = dev->name;
+	sum.min_temperature = sum.max_temperature = smart_temp(prev);
 
-static int __get_telemetry_log_ctrl(struct nvme_dev *dev,
-				    bool rae,
-				    enum nvme_telemetry_da da,
-				    size_t *size,
-				    struct nvme_telemetry_log **buf)
-{
-	struct nvme_telemetry_log *log;
-	int err;
+	nvme_stop_catch(true, NULL);
 
-	log = nvme_alloc(NVME_LOG_TELEM_BLOCK_SIZE);
-	if (!log)
-		return -errno;
+	next = last = start = monotonic_ns();
+	for (n = 0; !cfg.count || n < cfg.count; n++) {
+		next += cfg.interval * 1000000ULL;
+		if (!nvme_interval_wait(next))
+			break;
 
-	/*
-	 * set rae = true so it won't clear the current telemetry log in
-	 * controller
-	 */
-	err = nvme_cli_get_log_telemetry_ctrl(dev, true, 0,
-					      NVME_LOG_TELEM_BLOCK_SIZE,
-					      log);
-	if (err)
-		goto free;
+		err = nvme_cli_get_log_smart(dev, NVME_NSID_ALL, false, cur);
+		if (err)
+			break;
 
-	if (!log->ctrlavail) {
-		if (!rae) {
-			err = nvme_cli_get_log_telemetry_ctrl(dev, rae, 0,
-							      NVME_LOG_TELEM_BLOCK_SIZE,
-							      log);
-			goto free;
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+
+		memset(&s, 0, sizeof(s));
+		s.name = dev->name;
+		s.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+		s.interval_ns = now - last;
+		s.temperature = smart_temp(cur);
+		for (i = 0; i < ARRAY_SIZE(s.sensors); i++)
+			s.sensors[i] = le16_to_cpu(cur->temp_sensor[i]);
+		s.tmt1_trans = thm_delta(cur->thm_temp1_trans_count, prev->thm_temp1_trans_count);
+		s.tmt2_trans = thm_delta(cur->thm_temp2_trans_count, prev->thm_temp2_trans_count);
+		s.tmt1_time = thm_delta(cur->thm_temp1_total_time, prev->thm_temp1_total_time);
+		s.tmt2_time = thm_delta(cur->thm_temp2_total_time, prev->thm_temp2_total_time);
+		s.critical_warning = cur->critical_warning;
+		s.throttled = s.tmt1_trans || s.tmt2_trans || s.tmt1_time || s.tmt2_time ||
+			(s.critical_warning & NVME_SMART_CRIT_TEMPERATURE);
+
+		sum.samples++;
+		sum.max_gap_ns = max(sum.max_gap_ns, s.interval_ns);
+		sum.min_temperature = min(sum.min_temperature, s.temperature);
+		sum.max_temperature = max(sum.max_temperature, s.temperature);
+		sum.tmt1_trans += s.tmt1_trans;
+		sum.tmt2_trans += s.tmt2_trans;
+		sum.tmt1_time += s.tmt1_time;
+		sum.tmt2_time += s.tmt2_time;
+
+		if (cfg.samples)
+			nvme_show_thermal_sample(&s, flags);
+
+		/* the throttling started after the previous sample */
+		if (s.throttled && !in_episode) {
+			memset(&ep, 0, sizeof(ep));
+			ep.name = dev->name;
+			ep.start_ms = s.timestamp_ms - s.interval_ns / 1000000;
+			ep.max_temperature = s.temperature;
+			ep_start = last;
+			in_episode = true;
+			sum.episodes++;
+		}
+		if (in_episode && s.throttled) {
+			thermal_episode_add(&ep, &s);
+		} else if (in_episode) {
+			ep.duration_ns = now - ep_start;
+			nvme_show_thermal_episode(&ep, flags);
+			in_episode = false;
 		}
 
-		*size = NVME_LOG_TELEM_BLOCK_SIZE;
-		*buf = log;
-
-		printf("Warning: Telemetry Controller-Initiated Data Not Available.\n");
-		return 0;
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
 	}
 
-	err = parse_telemetry_da(dev, da, log, size);
-	if (err)
-		goto free;
+	nvme_stop_release();
 
-	return get_log_telemetry_ctrl(dev, rae, *size, buf);
+	if (in_episode) {
+		ep.duration_ns = last - ep_start;
+		ep.ongoing = true;
+		nvme_show_thermal_episode(&ep, flags);
+	}
+	sum.elapsed_ns = last - start;
+	nvme_show_thermal_summary(&sum, flags);
 
-free:
-	free(log);
+	if (!err)
+		return 0;
+err:
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("smart log: %s", nvme_strerror(errno));
 	return err;
 }
 
-static int __get_telemetry_log_host(struct nvme_dev *dev,
-				    enum nvme_telemetry_da da,
-				    size_t *size,
-				    struct nvme_telemetry_log **buf)
+static const char *const lat_type_names[] = {
+	[NVME_LAT_READ]		= "read",
+	[NVME_LAT_WRITE]	= "write",
+	[NVME_LAT_TRIM]		= "trim",
+	[NVME_LAT_ALL]		= "all",
+};
+
+static struct nvme_lat_source *lat_sources;
+
+void register_lat_source(struct nvme_lat_source *s)
 {
-	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
-	int err;
+	struct nvme_lat_source **p;
 
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
-		return -errno;
+	for (p = &lat_sources; *p; p = &(*p)->next)
+		;
+	*p = s;
+}
 
-	err = nvme_cli_get_log_telemetry_host(dev, 0,
-					      NVME_LOG_TELEM_BLOCK_SIZE,
-					      log);
-	if (err)
-		return  err;
+#if CONFIG_LAZY_PLUGINS
+/* bounds of the table of latency sources, see NVME_LAT_SOURCE() in nvme.h */
+extern struct nvme_lat_source *const __start_nvme_lat_sources[] __attribute__((weak));
+extern struct nvme_lat_source *const __stop_nvme_lat_sources[] __attribute__((weak));
 
-	err = parse_telemetry_da(dev, da, log, size);
-	if (err)
-		return err;
+static void register_lat_sources(void)
+{
+	static bool registered;
+	struct nvme_lat_source *const *p;
 
-	return get_log_telemetry_host(dev, *size, buf);
+	if (registered)
+		return;
+	registered = true;
+	for (p = __start_nvme_lat_sources; p < __stop_nvme_lat_sources; p++)
+		register_lat_source(*p);
 }
-
-static int get_telemetry_log(int argc, char **argv, struct command *cmd,
-			     struct plugin *plugin)
+#else
+static void register_lat_sources(void)
 {
-	const char *desc = "Retrieve telemetry log and write to binary file";
-	const char *fname = "File name to save raw binary, includes header";
-	const char *hgen = "Have the host tell the controller to generate the report";
-	const char *cgen = "Gather report generated by the controller.";
-	const char *dgen = "Pick which telemetry data area to report. Default is 3 to fetch areas 1-3. Valid options are 1, 2, 3, 4.";
-
-	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_file_ int output = -1;
-	int err = 0;
-	size_t total_size;
-	__u8 *data_ptr = NULL;
-	int data_written = 0, data_remaining = 0;
-
-	struct config {
-		char	*file_name;
-		__u32	host_gen;
-		bool	ctrl_init;
-		int	data_area;
-		bool	rae;
-	};
-	struct config cfg = {
-		.file_name	= NULL,
-		.host_gen	= 1,
-		.ctrl_init	= false,
-		.data_area	= 3,
-		.rae		= true,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_FILE("output-file",     'O', &cfg.file_name, fname),
-		  OPT_UINT("host-generate",   'g', &cfg.host_gen,  hgen),
-		  OPT_FLAG("controller-init", 'c', &cfg.ctrl_init, cgen),
-		  OPT_UINT("data-area",       'd', &cfg.data_area, dgen),
-		  OPT_FLAG("rae",             'r', &cfg.rae,       rae));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+}
+#endif
 
-	if (!cfg.file_name) {
-		nvme_show_error("Please provide an output file!");
-		return -EINVAL;
-	}
+/*
+ * Read the histogram from the source @name, or from the first source
+ * covering the device, the vendor specific ones before the generic ones.
+ */
+static int lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+			   const char *name, enum nvme_lat_type type,
+			   struct nvme_lat_hist *h, struct nvme_lat_source **src)
+{
+	struct nvme_lat_source *s;
+	int generic, err;
 
-	cfg.host_gen = !!cfg.host_gen;
-	output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-	if (output < 0) {
-		nvme_show_error("Failed to open output file %s: %s!",
-				cfg.file_name, strerror(errno));
-		return output;
+	register_lat_sources();
+	for (generic = 0; generic < 2; generic++) {
+		for (s = lat_sources; s; s = s->next) {
+			if (s->generic != generic || (name && strcmp(name, s->name)))
+				continue;
+			err = s->read(dev, ctrl, type, h);
+			if (err != -ENOTSUP) {
+				*src = s;
+				return err;
+			}
+		}
 	}
 
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
-		return -ENOMEM;
+	return -ENOTSUP;
+}
 
-	if (cfg.ctrl_init)
-		err = __get_telemetry_log_ctrl(dev, cfg.rae, cfg.data_area,
-					       &total_size, &log);
-	else if (cfg.host_gen)
-		err = __create_telemetry_log_host(dev, cfg.data_area,
-						  &total_size, &log);
-	else
-		err = __get_telemetry_log_host(dev, cfg.data_area,
-					       &total_size, &log);
+/*
+ * latency-histogram --interval: read the log of @src on a fixed schedule
+ * and print the commands counted between consecutive samples.
+ */
+static int lat_hist_sampler(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+			    struct nvme_lat_source *src, enum nvme_lat_type type,
+			    struct nvme_lat_hist *prev,
+			    __u32 interval, __u32 count, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_lat_hist *hists = NULL;
+	struct nvme_lat_hist *cur, *delta, *tmp;
+	struct nvme_lat_sample s;
+	__u64 next, now, last;
+	struct timespec ts;
+	__u32 n;
+	int err = 0;
 
-	if (err < 0) {
-		nvme_show_error("get-telemetry-log: %s", nvme_strerror(errno));
-		return err;
-	} else if (err > 0) {
-		nvme_show_status(err);
-		fprintf(stderr, "Failed to acquire telemetry log %d!\n", err);
-		return err;
-	}
+	hists = malloc(2 * sizeof(*hists));
+	if (!hists)
+		return -ENOMEM;
+	cur = &hists[0];
+	delta = &hists[1];
 
-	data_written = 0;
-	data_remaining = total_size;
-	data_ptr = (__u8 *)log;
+	nvme_stop_catch(true, NULL);
 
-	while (data_remaining) {
-		data_written = write(output, data_ptr, data_remaining);
-		if (data_written < 0) {
-			err = -errno;
-			nvme_show_error("ERROR: %s: : write failed with error : %s",
-					__func__, strerror(errno));
+	next = last = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
 			break;
-		} else if (data_written <= data_remaining) {
-			data_remaining -= data_written;
-			data_ptr += data_written;
-		} else {
-			/* Unexpected overwrite */
-			fprintf(stderr, "Failure: Unexpected telemetry log overwrite - data_remaining = 0x%x, data_written = 0x%x\n",
-					data_remaining, data_written);
-			err = -1;
+
+		err = src->read(dev, ctrl, type, cur);
+		if (!err)
+			err = nvme_lat_hist_delta(delta, cur, prev);
+		if (err)
 			break;
-		}
-	}
 
-	if (fsync(output) < 0) {
-		nvme_show_error("ERROR : %s: : fsync : %s", __func__, strerror(errno));
-		return -1;
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		s.source = src->name;
+		s.type = lat_type_names[type];
+		s.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+		s.interval_ns = now - last;
+		s.hist = delta;
+		nvme_show_lat_sample(&s, flags);
+
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
 	}
 
+	nvme_stop_release();
 	return err;
 }
 
-static int get_endurance_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int latency_histogram(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Retrieves endurance groups log page and prints the log.";
-	const char *group_id = "The endurance group identifier";
-
-	_cleanup_free_ struct nvme_endurance_group_log *endurance_log = NULL;
+	const char *desc = "Read the latency histogram of a vendor latency log "
+		"and show its percentiles, or sample it on a fixed schedule.";
+	const char *type = "commands: read (default), write, trim or all";
+	const char *source = "latency log to read, by default the first one the device has";
+	const char *interval = "seconds between samples, report the commands of each interval";
+	const char *count = "number of samples with --interval (default: until interrupted)";
+
+	_cleanup_free_ struct nvme_lat_hist *hist = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_lat_source *src = NULL;
+	struct nvme_lat_sample s = { 0 };
 	enum nvme_print_flags flags;
+	enum nvme_lat_type t;
 	int err;
 
 	struct config {
-		__u16	group_id;
+		char	*type;
+		char	*source;
+		__u32	interval;
+		__u32	count;
 	};
 
 	struct config cfg = {
-		.group_id	= 0,
+		.type		= "read",
+		.source		= NULL,
+		.interval	= 0,
+		.count		= 0,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("group-id",     'g', &cfg.group_id,      group_id));
+		  OPT_STRING("type",     't', "TYPE",   &cfg.type,     type),
+		  OPT_STRING("source",   's', "SOURCE", &cfg.source,   source),
+		  OPT_UINT("interval",   'i', &cfg.interval, interval),
+		  OPT_UINT("count",      'c', &cfg.count,    count));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
 	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
+	if (err < 0 || flags == BINARY) {
 		nvme_show_error("Invalid output format");
-		return err;
+		return -EINVAL;
 	}
 
-	endurance_log = nvme_alloc(sizeof(*endurance_log));
-	if (!endurance_log)
+	for (t = NVME_LAT_READ; t <= NVME_LAT_ALL; t++)
+		if (!strcmp(cfg.type, lat_type_names[t]))
+			break;
+	if (t > NVME_LAT_ALL) {
+		nvme_show_error("Invalid command type %s", cfg.type);
+		return -EINVAL;
+	}
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	hist = malloc(sizeof(*hist));
+	if (!ctrl || !hist)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_endurance_group(dev, cfg.group_id,
-					       endurance_log);
-	if (!err)
-		nvme_show_endurance_log(endurance_log, cfg.group_id,
-					dev->name, flags);
-	else if (err > 0)
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		nvme_show_error("ERROR : nvme_identify_ctrl() failed: %s",
+			nvme_strerror(errno));
+		return err;
+	}
+
+	err = lat_source_read(dev, ctrl, cfg.source, t, hist, &src);
+	if (err == -ENOTSUP) {
+		nvme_show_error("%s: no latency log of the %s commands%s%s", dev->name,
+				cfg.type, cfg.source ? " from " : "", cfg.source ?: "");
+		return err;
+	}
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("%s latency log: %s", src->name, nvme_strerror(-err));
+		return err;
+	}
+
+	if (!cfg.interval) {
+		s.source = src->name;
+		s.type = cfg.type;
+		s.hist = hist;
+		nvme_show_lat_sample(&s, flags);
+		return 0;
+	}
+
+	err = lat_hist_sampler(dev, ctrl, src, t, hist, cfg.interval, cfg.count, flags);
+	if (err > 0)
 		nvme_show_status(err);
-	else
-		nvme_show_error("endurance log: %s", nvme_strerror(errno));
+	else if (err < 0)
+		nvme_show_error("%s latency log: %s", src->name, nvme_strerror(-err));
 
 	return err;
 }
 
-static int collect_effects_log(struct nvme_dev *dev, enum nvme_csi csi,
-			       struct list_head *list, int flags)
-{
-	nvme_effects_log_node_t *node;
-	int err;
+struct ana_group {
+	__u8 state;		/* 0 if the group isn't in the log */
+	__u64 chgcnt;
+	__u32 nr_nsids;
+	__u32 *nsids;
+};
 
-	node = nvme_alloc(sizeof(*node));
-	if (!node)
-		return -ENOMEM;
+/*
+ * ANA group identifiers are within 1..NANAGRPID, so the groups are
+ * indexed by identifier and a state change is found without a search.
+ */
+struct ana_index {
+	__u32 nr_groups;	/* NANAGRPID */
+	struct ana_group *groups;
+	__u64 chgcnt;		/* of the log */
+};
 
-	node->csi = csi;
+static void ana_index_free(struct ana_index *idx)
+{
+	__u32 i;
 
-	err = nvme_cli_get_log_cmd_effects(dev, csi, &node->effects);
-	if (err) {
-		free(node);
-		return err;
-	}
-	list_add(list, &node->node);
-	return 0;
+	for (i = 0; idx->groups && i < idx->nr_groups; i++)
+		free(idx->groups[i].nsids);
+	free(idx->groups);
+	idx->groups = NULL;
 }
 
-static int get_effects_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static struct ana_group *ana_index_group(struct ana_index *idx, __u32 grpid)
 {
-	const char *desc = "Retrieve command effects log page and print the table.";
+	if (!grpid || grpid > idx->nr_groups)
+		return NULL;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	struct list_head log_pages;
-	nvme_effects_log_node_t *node;
+	return &idx->groups[grpid - 1];
+}
 
-	void *bar = NULL;
+/* Build @idx from a log read with namespaces */
+static int ana_index_build(struct ana_index *idx, struct nvme_ana_log *log, size_t len)
+{
+	struct nvme_ana_group_desc *desc;
+	struct ana_group *g;
+	size_t offset = sizeof(*log);
+	__u32 nr_nsids, j;
+	int i;
 
-	int err = -1;
-	enum nvme_print_flags flags;
+	idx->groups = calloc(idx->nr_groups, sizeof(*idx->groups));
+	if (!idx->groups)
+		return -ENOMEM;
+	idx->chgcnt = le64_to_cpu(log->chgcnt);
+
+	for (i = 0; i < le16_to_cpu(log->ngrps); i++) {
+		if (offset + sizeof(*desc) > len)
+			return -EPROTO;
+		desc = (void *)log + offset;
+		nr_nsids = le32_to_cpu(desc->nnsids);
+		offset += sizeof(*desc) + nr_nsids * sizeof(__le32);
+		if (offset > len)
+			return -EPROTO;
+
+		g = ana_index_group(idx, le32_to_cpu(desc->grpid));
+		if (!g)
+			continue;
+		g->state = desc->state;
+		g->chgcnt = le64_to_cpu(desc->chgcnt);
+		g->nsids = calloc(nr_nsids ? : 1, sizeof(*g->nsids));
+		if (!g->nsids)
+			return -ENOMEM;
+		g->nr_nsids = nr_nsids;
+		for (j = 0; j < nr_nsids; j++)
+			g->nsids[j] = le32_to_cpu(desc->nsids[j]);
+	}
 
-	struct config {
-		bool	human_readable;
-		bool	raw_binary;
-		int	csi;
-	};
+	return 0;
+}
 
-	struct config cfg = {
-		.human_readable	= false,
-		.raw_binary	= false,
-		.csi		= -1,
+static void ana_transition(struct ana_group *g, __u32 grpid, __u8 old_state,
+			   const char *devname, enum nvme_print_flags flags)
+{
+	struct nvme_ana_transition t = {
+		.grpid		= grpid,
+		.old_state	= old_state,
+		.new_state	= g->state,
+		.chgcnt		= g->chgcnt,
+		.nr_nsids	= g->nr_nsids,
+		.nsids		= g->nsids,
 	};
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_log),
-		  OPT_INT("csi",             'c', &cfg.csi,            csi));
+	nvme_show_ana_transition(&t, devname, flags);
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+/*
+ * Replace @idx by a full read of the log and report the groups whose
+ * state differs, every group the first time.
+ */
+static int ana_index_refresh(struct nvme_dev *dev, struct ana_index *idx,
+			     void *buf, size_t len, enum nvme_print_flags flags)
+{
+	struct ana_index old = *idx;
+	struct ana_group *g, *o;
+	__u32 i;
+	int err;
+
+	err = nvme_cli_get_log_ana(dev, NVME_LOG_ANA_LSP_RGO_NAMESPACES, true, 0,
+				   len, buf);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
+	err = ana_index_build(idx, buf, len);
+	if (err) {
+		ana_index_free(idx);
+		*idx = old;
 		return err;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	for (i = 0; i < idx->nr_groups; i++) {
+		g = &idx->groups[i];
+		o = old.groups ? &old.groups[i] : NULL;
+		if (g->state && (!o || o->state != g->state))
+			ana_transition(g, i + 1, o ? o->state : 0, dev->name, flags);
+	}
+	ana_index_free(&old);
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	return 0;
+}
 
-	list_head_init(&log_pages);
+/*
+ * The namespaces of each group are read once into the index, the polls
+ * read the groups only log which is a fixed 32 bytes per group. Only a
+ * change of the log without a change of any group state, or an unknown
+ * group, means namespaces moved and the full log is read again.
+ */
+static int ana_watch_poll(struct nvme_dev *dev, struct ana_index *idx,
+			  struct nvme_ana_log *log, size_t len, void *full,
+			  size_t full_len, enum nvme_print_flags flags)
+{
+	struct nvme_ana_group_desc *desc;
+	struct ana_group *g;
+	bool changed = false, reindex = false;
+	__u8 old_state;
+	int i, err;
+
+	err = nvme_cli_get_log_ana(dev, NVME_LOG_ANA_LSP_RGO_GROUPS_ONLY, true, 0,
+				   len, log);
+	if (err)
+		return err;
 
-	if (cfg.csi < 0) {
-		__u64 cap;
+	for (i = 0; i < le16_to_cpu(log->ngrps) && !reindex; i++) {
+		if (sizeof(*log) + (i + 1) * sizeof(*desc) > len)
+			return -EPROTO;
+		desc = &((struct nvme_ana_group_desc *)(log + 1))[i];
+		g = ana_index_group(idx, le32_to_cpu(desc->grpid));
+		if (!g || !g->state)
+			reindex = true;
+		else if (g->state != desc->state)
+			changed = true;
+	}
+	if (!changed && le64_to_cpu(log->chgcnt) != idx->chgcnt)
+		reindex = true;
+	if (reindex)
+		return ana_index_refresh(dev, idx, full, full_len, flags);
+
+	for (i = 0; i < le16_to_cpu(log->ngrps); i++) {
+		desc = &((struct nvme_ana_group_desc *)(log + 1))[i];
+		g = ana_index_group(idx, le32_to_cpu(desc->grpid));
+		if (g->state == desc->state)
+			continue;
+		old_state = g->state;
+		g->state = desc->state;
+		g->chgcnt = le64_to_cpu(desc->chgcnt);
+		ana_transition(g, le32_to_cpu(desc->grpid), old_state, dev->name, flags);
+	}
+	idx->chgcnt = le64_to_cpu(log->chgcnt);
 
-		bar = mmap_registers(dev, false);
-
-		if (bar) {
-			cap = mmio_read64(bar + NVME_REG_CAP);
-			munmap(bar, getpagesize());
-		} else {
-			struct nvme_get_property_args args = {
-				.args_size	= sizeof(args),
-				.fd		= dev_fd(dev),
-				.offset		= NVME_REG_CAP,
-				.value		= &cap,
-				.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-			};
-			err = nvme_get_property(&args);
-			if (err)
-				goto cleanup_list;
-		}
-
-		if (NVME_CAP_CSS(cap) & NVME_CAP_CSS_NVM)
-			err = collect_effects_log(dev, NVME_CSI_NVM,
-						  &log_pages, flags);
-
-		if (!err && (NVME_CAP_CSS(cap) & NVME_CAP_CSS_CSI))
-			err = collect_effects_log(dev, NVME_CSI_ZNS,
-						  &log_pages, flags);
-	} else {
-		err = collect_effects_log(dev, cfg.csi, &log_pages, flags);
-	}
-
-	if (!err)
-		nvme_print_effects_log_pages(&log_pages, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror("effects log page");
-
-cleanup_list:
-	while ((node = list_pop(&log_pages, nvme_effects_log_node_t, node)))
-		free(node);
-
-	return err;
+	return 0;
 }
 
-static int get_supported_log_pages(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static int ana_watch(struct nvme_dev *dev, struct nvme_id_ctrl *ctrl, size_t full_len,
+		     __u32 interval, enum nvme_print_flags flags)
 {
-	const char *desc = "Retrieve supported logs and print the table.";
-
-	_cleanup_free_ struct nvme_supported_log_pages *supports = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err = -1;
+	struct ana_index idx = { .nr_groups = le32_to_cpu(ctrl->nanagrpid) };
+	_cleanup_free_ struct nvme_ana_log *log = NULL;
+	_cleanup_free_ void *full = NULL;
+	__u64 next;
+	size_t len;
+	int err;
 
-	NVME_ARGS(opts);
+	len = sizeof(*log) + idx.nr_groups * sizeof(struct nvme_ana_group_desc);
+	log = nvme_alloc(len);
+	full = nvme_alloc(full_len);
+	if (!log || !full)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = ana_index_refresh(dev, &idx, full, full_len, flags);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
+	nvme_stop_catch(true, NULL);
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	next = monotonic_ns();
+	while (true) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
 
-	supports = nvme_alloc(sizeof(*supports));
-	if (!supports)
-		return -ENOMEM;
+		err = ana_watch_poll(dev, &idx, log, len, full, full_len, flags);
+		if (err)
+			break;
+	}
 
-	err = nvme_cli_get_log_supported_log_pages(dev, false, supports);
-	if (!err)
-		nvme_show_supported_log(supports, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("supported log pages: %s", nvme_strerror(errno));
+	nvme_stop_release();
+	ana_index_free(&idx);
 
 	return err;
 }
 
-static int get_error_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_ana_log(int argc, char **argv, struct command *cmd,
+		struct plugin *plugin)
 {
-	const char *desc = "Retrieve specified number of "
-		"error log entries from a given device "
-		"in either decoded format (default) or binary.";
-	const char *log_entries = "number of entries to retrieve";
-	const char *raw = "dump in binary format";
+	const char *desc = "Retrieve ANA log for the given device in "
+		"decoded format (default), json or binary.";
+	const char *groups = "Return ANA groups only.";
+	const char *watch = "keep polling and report only group state changes";
+	const char *interval = "seconds between polls in watch mode";
 
-	_cleanup_free_ struct nvme_error_log_page *err_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	struct nvme_id_ctrl ctrl;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ void *ana_log = NULL;
+	size_t ana_log_len;
 	enum nvme_print_flags flags;
+	enum nvme_log_ana_lsp lsp;
 	int err = -1;
 
 	struct config {
-		__u32	log_entries;
-		bool	raw_binary;
+		bool	groups;
+		bool	watch;
+		__u32	interval;
 	};
 
 	struct config cfg = {
-		.log_entries	= 64,
-		.raw_binary	= false,
+		.groups		= false,
+		.watch		= false,
+		.interval	= 1,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw));
+		  OPT_FLAG("groups",   'g', &cfg.groups,   groups),
+		  OPT_FLAG("watch",    'w', &cfg.watch,    watch),
+		  OPT_UINT("interval", 'i', &cfg.interval, interval));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -1192,1256 +1964,1908 @@ static int get_error_log(int argc, char **argv, struct command *cmd, struct plug
 		return err;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
-
-	if (!cfg.log_entries) {
-		nvme_show_error("non-zero log-entries is required param");
-		return -1;
+	if (cfg.watch && (flags == BINARY || !cfg.interval)) {
+		nvme_show_error("watch needs an interval of at least 1 and no binary output");
+		return -EINVAL;
 	}
 
-	err = nvme_cli_identify_ctrl(dev, &ctrl);
-	if (err < 0) {
-		nvme_show_perror("identify controller");
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		nvme_show_error("ERROR : nvme_identify_ctrl() failed: %s",
+			nvme_strerror(errno));
 		return err;
-	} else if (err) {
-		nvme_show_error("could not identify controller");
+	}
+
+	ana_log_len = sizeof(struct nvme_ana_log) +
+		le32_to_cpu(ctrl->nanagrpid) * sizeof(struct nvme_ana_group_desc);
+	if (!(ctrl->anacap & (1 << 6)))
+		ana_log_len += le32_to_cpu(ctrl->mnan) * sizeof(__le32);
+
+	if (cfg.watch) {
+		err = ana_watch(dev, ctrl, ana_log_len, cfg.interval, flags);
+		if (err > 0)
+			nvme_show_status(err);
+		else if (err == -1)
+			nvme_show_error("ana-log: %s", nvme_strerror(errno));
+		else if (err < 0)
+			nvme_show_error("ana-log: %s", nvme_strerror(-err));
 		return err;
 	}
 
-	cfg.log_entries = min(cfg.log_entries, ctrl.elpe + 1);
-	err_log = nvme_alloc(cfg.log_entries * sizeof(struct nvme_error_log_page));
-	if (!err_log)
+	ana_log = nvme_alloc(ana_log_len);
+	if (!ana_log)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_error(dev, cfg.log_entries, false, err_log);
+	lsp = cfg.groups ? NVME_LOG_ANA_LSP_RGO_GROUPS_ONLY :
+		NVME_LOG_ANA_LSP_RGO_NAMESPACES;
+
+	err = nvme_cli_get_log_ana(dev, lsp, true, 0, ana_log_len, ana_log);
 	if (!err)
-		nvme_show_error_log(err_log, cfg.log_entries,
-				    dev->name, flags);
+		nvme_show_ana_log(ana_log, dev->name, ana_log_len, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_perror("error log");
+		nvme_show_error("ana-log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int get_fw_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Retrieve the firmware log for the "
-		"specified device in either decoded format (default) or binary.";
+/*
+ * Upper bound for a single passthrough transfer. The PCIe driver limits
+ * requests to 127 segments, which page sized, physically scattered user
+ * buffers hit just below 512k regardless of the controller's MDTS.
+ */
+#define MAX_XFER_LEN	(256 * 1024)
 
-	_cleanup_free_ struct nvme_firmware_slot *fw_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
+/*
+ * Largest data transfer of a single command, derived from MDTS in units of
+ * the minimum memory page size (assumed to be 4k). MDTS 0 means no limit.
+ */
+static __u32 ctrl_max_xfer_len(struct nvme_id_ctrl *ctrl)
+{
+	if (!ctrl->mdts || ctrl->mdts >= 20)
+		return MAX_XFER_LEN;
 
-	struct config {
-		bool	raw_binary;
-	};
+	return min(NVME_LOG_PAGE_PDU_SIZE << ctrl->mdts, MAX_XFER_LEN);
+}
 
-	struct config cfg = {
-		.raw_binary	= false,
-	};
+int get_max_xfer_len(struct nvme_dev *dev, __u32 *len)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	int err;
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = nvme_cli_identify_ctrl(dev, ctrl);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
+	*len = ctrl_max_xfer_len(ctrl);
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	return 0;
+}
 
-	fw_log = nvme_alloc(sizeof(*fw_log));
-	if (!fw_log)
-		return -ENOMEM;
+static bool log_offset_supported(struct nvme_dev *dev)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
 
-	err = nvme_cli_get_log_fw_slot(dev, false, fw_log);
-	if (!err)
-		nvme_show_fw_log(fw_log, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("fw log: %s", nvme_strerror(errno));
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return false;
 
-	return err;
+	return !nvme_cli_identify_ctrl(dev, ctrl) &&
+		(ctrl->lpa & NVME_CTRL_LPA_EXTENDED);
 }
 
-static int get_changed_ns_list_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int parse_telemetry_da(struct nvme_dev *dev,
+			      enum nvme_telemetry_da da,
+			      struct nvme_telemetry_log *telem,
+			      size_t *size)
+
 {
-	const char *desc = "Retrieve Changed Namespaces log for the given device "
-		"in either decoded format (default) or binary.";
+	_cleanup_free_ struct nvme_id_ctrl *id_ctrl = NULL;
+	size_t dalb = 0;
 
-	_cleanup_free_ struct nvme_ns_list *changed_ns_list_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
+	id_ctrl = nvme_alloc(sizeof(*id_ctrl));
+	if (!id_ctrl)
+		return -ENOMEM;
 
-	struct config {
-		bool	raw_binary;
-	};
+	switch (da) {
+	case NVME_TELEMETRY_DA_1:
+		dalb = le16_to_cpu(telem->dalb1);
+		break;
+	case NVME_TELEMETRY_DA_2:
+		dalb = le16_to_cpu(telem->dalb2);
+		break;
+	case NVME_TELEMETRY_DA_3:
+		/* dalb3 >= dalb2 >= dalb1 */
+		dalb = le16_to_cpu(telem->dalb3);
+		break;
+	case NVME_TELEMETRY_DA_4:
+		if (nvme_cli_identify_ctrl(dev, id_ctrl)) {
+			perror("identify-ctrl");
+			return -errno;
+		}
 
-	struct config cfg = {
-		.raw_binary	= false,
-	};
+		if (id_ctrl->lpa & 0x40) {
+			dalb = le32_to_cpu(telem->dalb4);
+		} else {
+			nvme_show_error(
+			    "Data area 4 unsupported, bit 6 of Log Page Attributes not set");
+			return -EINVAL;
+		}
+		break;
+	default:
+		nvme_show_error("Invalid data area parameter - %d", da);
+		return -EINVAL;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_output));
+	if (dalb == 0) {
+		nvme_show_error("ERROR: No telemetry data block");
+		return -ENOENT;
+	}
+	*size = (dalb + 1) * NVME_LOG_TELEM_BLOCK_SIZE;
+	return 0;
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+/*
+ * Fetch the telemetry log in MDTS sized chunks into a ring of page aligned
+ * buffers, a helper thread writes each chunk to @output while the next one
+ * is in flight.
+ */
+static int get_log_telemetry_to_file(struct nvme_dev *dev, bool host, bool rae,
+				     size_t size, int output, bool progress,
+				     const struct io_rate_cfg *rate)
+{
+	struct nvme_ratelimit rl = { 0 };
+	struct nvme_stream s;
+	__u64 offset = 0, start_ns, cmd_ns;
+	__u32 xfer_len;
+	size_t len;
+	void *buf;
+	int err, serr;
+
+	err = get_max_xfer_len(dev, &xfer_len);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
+	err = nvme_stream_init(&s, output, NVME_STREAM_TO_FILE, size, xfer_len, 4);
+	if (err)
 		return err;
+	s.fsync = true;
+
+	start_ns = monotonic_ns();
+	if (rate)
+		nvme_ratelimit_init(&rl, rate->rate_iops, rate->rate,
+				    (__u64)rate->max_latency * NSEC_PER_USEC, start_ns);
+	while ((buf = nvme_stream_get(&s, &len))) {
+		struct nvme_get_log_args args = {
+			.args_size	= sizeof(args),
+			.lid		= host ? NVME_LOG_LID_TELEMETRY_HOST : NVME_LOG_LID_TELEMETRY_CTRL,
+			.nsid		= NVME_NSID_NONE,
+			.lsp		= host ? NVME_LOG_TELEM_HOST_LSP_RETAIN : NVME_LOG_LSP_NONE,
+			.lpo		= offset,
+			.csi		= NVME_CSI_NVM,
+			.uuidx		= NVME_UUID_NONE,
+			/* only the last chunk may clear the asynchronous event */
+			.rae		= host ? false : (offset + len < size || rae),
+			.ot		= false,
+			.len		= len,
+			.log		= buf,
+			.result		= NULL,
+		};
+
+		if (nvme_ratelimit_enabled(&rl))
+			nvme_ratelimit_wait(&rl, len, NULL);
+		cmd_ns = monotonic_ns();
+		err = nvme_cli_get_log_page(dev, len, &args);
+		if (err)
+			break;
+		if (nvme_ratelimit_enabled(&rl)) {
+			__u64 now_ns = monotonic_ns();
+
+			nvme_ratelimit_complete(&rl, now_ns - cmd_ns, now_ns);
+		}
+
+		nvme_stream_put(&s, len);
+		offset += len;
+		if (progress)
+			util_spinner("telemetry-log", (float)offset / size);
 	}
+	if (rate)
+		nvme_ratelimit_destroy(&rl);
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	serr = nvme_stream_finish(&s, err != 0);
+	if (!err && serr) {
+		nvme_show_error("write: %s", nvme_strerror(-serr));
+		err = serr;
+	}
 
-	changed_ns_list_log = nvme_alloc(sizeof(*changed_ns_list_log));
-	if (!changed_ns_list_log)
-		return -ENOMEM;
+	if (!err && progress) {
+		__u64 us = (monotonic_ns() - start_ns) / NSEC_PER_USEC;
 
-	err = nvme_cli_get_log_changed_ns_list(dev, true,
-					       changed_ns_list_log);
-	if (!err)
-		nvme_show_changed_ns_list_log(changed_ns_list_log,
-					      dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("changed ns list log: %s", nvme_strerror(errno));
+		printf("%zu bytes in %llu.%03llu ms (%.1f MiB/s)\n", size,
+		       (unsigned long long)(us / 1000), (unsigned long long)(us % 1000),
+		       us ? (double)size / us * 1000000 / (1024 * 1024) : 0.0);
+	}
 
 	return err;
 }
 
-static int get_pred_lat_per_nvmset_log(int argc, char **argv,
-	struct command *cmd, struct plugin *plugin)
+static int __create_telemetry_log_host(struct nvme_dev *dev,
+				       enum nvme_telemetry_da da,
+				       size_t *size)
 {
-	const char *desc = "Retrieve Predictable latency per nvm set log "
-		"page and prints it for the given device in either decoded "
-		"format(default),json or binary.";
-	const char *nvmset_id = "NVM Set Identifier";
-
-	_cleanup_free_ struct nvme_nvmset_predictable_lat_log *plpns_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
+	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
 	int err;
 
-	struct config {
-		__u16	nvmset_id;
-		bool	raw_binary;
-	};
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
 
-	struct config cfg = {
-		.nvmset_id	= 1,
-		.raw_binary	= false,
-	};
+	err = nvme_cli_get_log_create_telemetry_host(dev, log);
+	if (err)
+		return -errno;
 
-	NVME_ARGS(opts,
-		  OPT_SHRT("nvmset-id",	   'i', &cfg.nvmset_id,     nvmset_id),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+	return parse_telemetry_da(dev, da, log, size);
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+static int __get_telemetry_log_ctrl(struct nvme_dev *dev,
+				    bool rae,
+				    enum nvme_telemetry_da da,
+				    size_t *size,
+				    struct nvme_telemetry_log **buf)
+{
+	struct nvme_telemetry_log *log;
+	int err;
+
+	log = nvme_alloc(NVME_LOG_TELEM_BLOCK_SIZE);
+	if (!log)
+		return -errno;
+
+	/*
+	 * set rae = true so it won't clear the current telemetry log in
+	 * controller
+	 */
+	err = nvme_cli_get_log_telemetry_ctrl(dev, true, 0,
+					      NVME_LOG_TELEM_BLOCK_SIZE,
+					      log);
 	if (err)
-		return err;
+		goto free;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (!log->ctrlavail) {
+		if (!rae) {
+			err = nvme_cli_get_log_telemetry_ctrl(dev, rae, 0,
+							      NVME_LOG_TELEM_BLOCK_SIZE,
+							      log);
+			if (err)
+				goto free;
+		}
+
+		*size = NVME_LOG_TELEM_BLOCK_SIZE;
+		*buf = log;
+
+		printf("Warning: Telemetry Controller-Initiated Data Not Available.\n");
+		return 0;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	/* the data is fetched by get_log_telemetry_to_file() */
+	err = parse_telemetry_da(dev, da, log, size);
 
-	plpns_log = nvme_alloc(sizeof(*plpns_log));
-	if (!plpns_log)
-		return -ENOMEM;
+free:
+	free(log);
+	return err;
+}
 
-	err = nvme_cli_get_log_predictable_lat_nvmset(dev, cfg.nvmset_id,
-						      plpns_log);
-	if (!err)
-		nvme_show_predictable_latency_per_nvmset(plpns_log, cfg.nvmset_id, dev->name,
-							 flags);
-	else if (err > 0)
-		nvme_show_status(err);
+static int __get_telemetry_log_host(struct nvme_dev *dev,
+				    enum nvme_telemetry_da da,
+				    size_t *size)
+{
+	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
+	int err;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -errno;
+
+	err = nvme_cli_get_log_telemetry_host(dev, 0,
+					      NVME_LOG_TELEM_BLOCK_SIZE,
+					      log);
+	if (err)
+		return  err;
+
+	return parse_telemetry_da(dev, da, log, size);
+}
+
+/* the header of an earlier capture in @file, false if there is none */
+static bool telemetry_prev_header(const char *file, struct nvme_telemetry_log *hdr)
+{
+	_cleanup_file_ int fd = open(file, O_RDONLY);
+
+	return fd >= 0 && read(fd, hdr, sizeof(*hdr)) == sizeof(*hdr);
+}
+
+/*
+ * The data of a capture is the same as long as its generation number and
+ * the data area sizes are, and for the controller-initiated data as long
+ * as it remains available.
+ */
+static bool telemetry_unchanged(const struct nvme_telemetry_log *prev,
+				const struct nvme_telemetry_log *cur, bool ctrl)
+{
+	if (prev->lpi != cur->lpi || memcmp(prev->ieee, cur->ieee, sizeof(cur->ieee)))
+		return false;
+	if (ctrl && (!cur->ctrlavail || prev->ctrlavail != cur->ctrlavail ||
+		     prev->ctrldgn != cur->ctrldgn))
+		return false;
+	if (!ctrl && prev->hostdgn != cur->hostdgn)
+		return false;
+
+	return prev->dalb1 == cur->dalb1 && prev->dalb2 == cur->dalb2 &&
+	       prev->dalb3 == cur->dalb3 && prev->dalb4 == cur->dalb4;
+}
+
+/*
+ * Read only the header of the controller-initiated or the existing
+ * host-initiated data and compare it with the capture in @file
+ */
+static int telemetry_check_changed(struct nvme_dev *dev, bool ctrl, const char *file,
+				   bool *unchanged)
+{
+	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
+	struct nvme_telemetry_log prev;
+	int err;
+
+	*unchanged = false;
+	if (!telemetry_prev_header(file, &prev))
+		return 0;
+
+	log = nvme_alloc(NVME_LOG_TELEM_BLOCK_SIZE);
+	if (!log)
+		return -errno;
+
+	/* with rae set, reading the header leaves the event outstanding */
+	if (ctrl)
+		err = nvme_cli_get_log_telemetry_ctrl(dev, true, 0,
+						      NVME_LOG_TELEM_BLOCK_SIZE, log);
 	else
-		nvme_show_error("predictable latency per nvm set: %s", nvme_strerror(errno));
+		err = nvme_cli_get_log_telemetry_host(dev, 0,
+						      NVME_LOG_TELEM_BLOCK_SIZE, log);
+	if (err)
+		return err;
 
-	return err;
+	*unchanged = telemetry_unchanged(&prev, log, ctrl);
+	return 0;
 }
 
-static int get_pred_lat_event_agg_log(int argc, char **argv,
-		struct command *cmd, struct plugin *plugin)
+static int get_telemetry_log(int argc, char **argv, struct command *cmd,
+			     struct plugin *plugin)
 {
-	const char *desc = "Retrieve Predictable Latency Event "
-		"Aggregate Log page and prints it, for the given "
-		"device in either decoded format(default), json or binary.";
-	const char *log_entries = "Number of pending NVM Set log Entries list";
+	const char *desc = "Retrieve telemetry log and write to binary file";
+	const char *fname = "File name to save raw binary, includes header";
+	const char *hgen = "Have the host tell the controller to generate the report";
+	const char *cgen = "Gather report generated by the controller.";
+	const char *dgen = "Pick which telemetry data area to report. Default is 3 to fetch areas 1-3. Valid options are 1, 2, 3, 4.";
+	const char *progress = "show a progress bar and the achieved throughput";
+	const char *if_changed = "skip the capture if the output file holds the same data";
 
+	_cleanup_free_ struct nvme_telemetry_log *log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_free_ void *pea_log = NULL;
-	enum nvme_print_flags flags;
-	__u32 log_size;
-	int err;
+	_cleanup_file_ int output = -1;
+	bool unchanged;
+	int err = 0;
+	size_t total_size;
+	__u8 *data_ptr = NULL;
+	int data_written = 0, data_remaining = 0;
 
 	struct config {
-		__u64	log_entries;
+		char	*file_name;
+		__u32	host_gen;
+		bool	ctrl_init;
+		int	data_area;
 		bool	rae;
-		bool	raw_binary;
+		bool	progress;
+		bool	if_changed;
+		struct io_rate_cfg	rate;
 	};
-
 	struct config cfg = {
-		.log_entries	= 2044,
-		.rae		= false,
-		.raw_binary	= false,
+		.file_name	= NULL,
+		.host_gen	= 1,
+		.ctrl_init	= false,
+		.data_area	= 3,
+		.rae		= true,
+		.progress	= false,
+		.if_changed	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
-		  OPT_FLAG("rae",          'r', &cfg.rae,           rae),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+		  OPT_FILE("output-file",     'O', &cfg.file_name, fname),
+		  OPT_UINT("host-generate",   'g', &cfg.host_gen,  hgen),
+		  OPT_FLAG("controller-init", 'c', &cfg.ctrl_init, cgen),
+		  OPT_UINT("data-area",       'd', &cfg.data_area, dgen),
+		  OPT_FLAG("rae",             'r', &cfg.rae,       rae),
+		  OPT_FLAG("progress",        'P', &cfg.progress,  progress),
+		  OPT_FLAG("if-changed",      'C', &cfg.if_changed, if_changed),
+		  OPT_IO_RATE(&cfg.rate));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (!cfg.file_name) {
+		nvme_show_error("Please provide an output file!");
+		return -EINVAL;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	err = io_rate_check(&cfg.rate);
+	if (err)
+		return err;
 
-	if (!cfg.log_entries) {
-		nvme_show_error("non-zero log-entries is required param");
-		return -EINVAL;
+	cfg.host_gen = !!cfg.host_gen;
+	if (cfg.if_changed) {
+		/* a new host-initiated capture always has a new generation number */
+		if (!cfg.ctrl_init && cfg.host_gen) {
+			nvme_show_error("--if-changed needs --controller-init or --host-generate=0");
+			return -EINVAL;
+		}
+
+		err = telemetry_check_changed(dev, cfg.ctrl_init, cfg.file_name, &unchanged);
+		if (err < 0) {
+			nvme_show_error("get-telemetry-log: %s", nvme_strerror(errno));
+			return err;
+		} else if (err > 0) {
+			nvme_show_status(err);
+			return err;
+		} else if (unchanged) {
+			printf("Telemetry data unchanged, %s is up to date\n", cfg.file_name);
+			return 0;
+		}
 	}
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+	/* bypass the page cache, not every file system supports that */
+	output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+	if (output < 0 && errno == EINVAL)
+		output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (output < 0) {
+		nvme_show_error("Failed to open output file %s: %s!",
+				cfg.file_name, strerror(errno));
+		return output;
+	}
+
+	if (cfg.ctrl_init)
+		err = __get_telemetry_log_ctrl(dev, cfg.rae, cfg.data_area,
+					       &total_size, &log);
+	else if (cfg.host_gen)
+		err = __create_telemetry_log_host(dev, cfg.data_area,
+						  &total_size);
+	else
+		err = __get_telemetry_log_host(dev, cfg.data_area,
+					       &total_size);
+
+	if (!err && !log)
+		err = get_log_telemetry_to_file(dev, !cfg.ctrl_init, cfg.rae,
+						total_size, output, cfg.progress, &cfg.rate);
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
 	if (err < 0) {
-		nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		nvme_show_error("get-telemetry-log: %s", nvme_strerror(errno));
 		return err;
-	} else if (err) {
+	} else if (err > 0) {
 		nvme_show_status(err);
+		fprintf(stderr, "Failed to acquire telemetry log %d!\n", err);
 		return err;
 	}
 
-	cfg.log_entries = min(cfg.log_entries, le32_to_cpu(ctrl->nsetidmax));
-	log_size = sizeof(__u64) + cfg.log_entries * sizeof(__u16);
+	if (!log)
+		return 0;
 
-	pea_log = nvme_alloc(log_size);
-	if (!pea_log)
-		return -ENOMEM;
+	/* only the header is available, too short for O_DIRECT */
+	fcntl(output, F_SETFL, fcntl(output, F_GETFL) & ~O_DIRECT);
+	data_written = 0;
+	data_remaining = total_size;
+	data_ptr = (__u8 *)log;
 
-	err = nvme_cli_get_log_predictable_lat_event(dev, cfg.rae, 0,
-						     log_size, pea_log);
-	if (!err)
-		nvme_show_predictable_latency_event_agg_log(pea_log, cfg.log_entries, log_size,
-							    dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("predictable latency event aggregate log page: %s",
-				nvme_strerror(errno));
+	while (data_remaining) {
+		data_written = write(output, data_ptr, data_remaining);
+		if (data_written < 0) {
+			err = -errno;
+			nvme_show_error("ERROR: %s: : write failed with error : %s",
+					__func__, strerror(errno));
+			break;
+		} else if (data_written <= data_remaining) {
+			data_remaining -= data_written;
+			data_ptr += data_written;
+		} else {
+			/* Unexpected overwrite */
+			fprintf(stderr, "Failure: Unexpected telemetry log overwrite - data_remaining = 0x%x, data_written = 0x%x\n",
+					data_remaining, data_written);
+			err = -1;
+			break;
+		}
+	}
+
+	if (fsync(output) < 0) {
+		nvme_show_error("ERROR : %s: : fsync : %s", __func__, strerror(errno));
+		return -1;
+	}
 
 	return err;
 }
 
-static int get_persistent_event_log(int argc, char **argv,
-		struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Retrieve Persistent Event log info for "
-		"the given device in either decoded format(default), json or binary.";
-	const char *action = "action the controller shall take during "
-		"processing this persistent log page command.";
-	const char *log_len = "number of bytes to retrieve";
+enum collect_kind {
+	COLLECT_SMART,
+	COLLECT_ERROR,
+	COLLECT_TELEMETRY,
+	COLLECT_RAW,
+};
 
-	_cleanup_free_ struct nvme_persistent_event_log *pevent = NULL;
-	struct nvme_persistent_event_log *pevent_collected = NULL;
-	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	void *pevent_log_info;
-	int err;
+struct collect_spec {
+	enum collect_kind kind;
+	char name[16];
+	__u8 lid;
+	__u32 len;
+};
 
-	struct config {
-		__u8	action;
-		__u32	log_len;
-		bool	raw_binary;
-	};
+/* a log of a device collected from the event loop */
+struct collect_cmd {
+	struct collect_job *job;
+	int i;
+	struct nvme_fanout_cmd id;	/* the Identify the error log size comes from */
+	struct nvme_fanout_log log;
+	struct nvme_buf raw;
+};
 
-	struct config cfg = {
-		.action		= 0xff,
-		.log_len	= 0,
-		.raw_binary	= false,
-	};
+struct collect_job {
+	struct nvme_collect_dev *dev;
+	struct collect_spec *specs;
+	int nr_specs;
+	const char *dir;
+	struct nvme_bundle_writer *bundle;
+	char sn[21];
+
+	struct nvme_fanout *f;
+	struct nvme_dev *ndev;
+	__u64 start;
+	int left;
+	struct collect_cmd cmds[NVME_COLLECT_MAX_LOGS];
+};
 
-	NVME_ARGS(opts,
-		  OPT_BYTE("action",       'a', &cfg.action,        action),
-		  OPT_UINT("log_len",	 'l', &cfg.log_len,	  log_len),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+static int collect_parse_logs(char *logs, struct collect_spec *specs, int *nr_specs)
+{
+	char *tok, *end;
+	int n = 0;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	for (tok = strtok(logs, ","); tok; tok = strtok(NULL, ",")) {
+		struct collect_spec *spec = &specs[n];
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+		if (n == NVME_COLLECT_MAX_LOGS) {
+			nvme_show_error("too many logs, at most %d", NVME_COLLECT_MAX_LOGS);
+			return -EINVAL;
+		}
+
+		memset(spec, 0, sizeof(*spec));
+		if (!strcmp(tok, "smart-log")) {
+			spec->kind = COLLECT_SMART;
+			spec->lid = NVME_LOG_LID_SMART;
+		} else if (!strcmp(tok, "error-log")) {
+			spec->kind = COLLECT_ERROR;
+			spec->lid = NVME_LOG_LID_ERROR;
+		} else if (!strcmp(tok, "telemetry-log")) {
+			spec->kind = COLLECT_TELEMETRY;
+			spec->lid = NVME_LOG_LID_TELEMETRY_HOST;
+		} else {
+			/* <lid>:<len>, e.g. vendor specific logs */
+			unsigned long lid = strtoul(tok, &end, 0);
+
+			if (end == tok || *end != ':' || lid > 0xff) {
+				nvme_show_error("invalid log '%s'", tok);
+				return -EINVAL;
+			}
+			spec->kind = COLLECT_RAW;
+			spec->lid = lid;
+			spec->len = strtoul(end + 1, &end, 0);
+			if (*end || !spec->len) {
+				nvme_show_error("invalid log length in '%s'", tok);
+				return -EINVAL;
+			}
+			snprintf(spec->name, sizeof(spec->name), "log-0x%02x", spec->lid);
+			n++;
+			continue;
+		}
+		snprintf(spec->name, sizeof(spec->name), "%s", tok);
+		n++;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	*nr_specs = n;
+	return 0;
+}
 
-	pevent = nvme_alloc(sizeof(*pevent));
-	if (!pevent)
-		return -ENOMEM;
+static int collect_open_file(struct collect_job *job, struct nvme_collect_log *log, int flags)
+{
+	int fd;
 
-	err = nvme_cli_get_log_persistent_event(dev, cfg.action,
-						sizeof(*pevent), pevent);
-	if (err < 0) {
-		nvme_show_error("persistent event log: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_status(err);
-		return err;
+	if (asprintf(&log->file, "%s/%s-%s.bin", job->dir, job->dev->name, log->name) < 0) {
+		log->file = NULL;
+		return -ENOMEM;
 	}
 
-	if (cfg.action == NVME_PEVENT_LOG_RELEASE_CTX) {
-		printf("Releasing Persistent Event Log Context\n");
-		return 0;
-	}
+	fd = open(log->file, O_WRONLY | O_CREAT | O_TRUNC | flags, 0644);
+	if (fd < 0 && (flags & O_DIRECT) && errno == EINVAL)
+		fd = open(log->file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 
-	if (!cfg.log_len && cfg.action != NVME_PEVENT_LOG_EST_CTX_AND_READ) {
-		cfg.log_len = le64_to_cpu(pevent->tll);
-	} else if (!cfg.log_len && cfg.action == NVME_PEVENT_LOG_EST_CTX_AND_READ) {
-		printf("Establishing Persistent Event Log Context\n");
+	return fd < 0 ? -errno : fd;
+}
+
+static int collect_bundle_add(struct collect_job *job, struct collect_spec *spec,
+			      struct nvme_collect_log *log, const void *buf, size_t len)
+{
+	struct nvme_bundle_entry e = { 0 };
+
+	snprintf(e.name, sizeof(e.name), "%s", log->name);
+	snprintf(e.dev, sizeof(e.dev), "%s", job->dev->name);
+	snprintf(e.sn, sizeof(e.sn), "%s", job->sn);
+	e.lid = spec->lid;
+	if (spec->kind == COLLECT_TELEMETRY)
+		e.lsp = NVME_LOG_TELEM_HOST_LSP_RETAIN;
+
+	return nvme_bundle_add(job->bundle, &e, buf, len);
+}
+
+static int collect_save(struct collect_job *job, struct collect_spec *spec,
+			struct nvme_collect_log *log, void *buf, size_t len)
+{
+	_cleanup_file_ int fd = -1;
+	ssize_t n;
+
+	if (job->bundle)
+		return collect_bundle_add(job, spec, log, buf, len);
+	if (!job->dir)
 		return 0;
-	}
 
-	/*
-	 * if header already read with context establish action 0x1,
-	 * action shall not be 0x1 again in the subsequent request,
-	 * until the current context is released by issuing action
-	 * with 0x2, otherwise throws command sequence error, make
-	 * it as zero to read the log page
-	 */
-	if (cfg.action == NVME_PEVENT_LOG_EST_CTX_AND_READ)
-		cfg.action = NVME_PEVENT_LOG_READ;
+	fd = collect_open_file(job, log, 0);
+	if (fd < 0)
+		return fd;
 
-	pevent_log_info = nvme_alloc_huge(cfg.log_len, &mh);
-	if (!pevent_log_info)
-		return -ENOMEM;
+	n = write(fd, buf, len);
+	if (n < 0)
+		return -errno;
 
-	err = nvme_cli_get_log_persistent_event(dev, cfg.action,
-						cfg.log_len, pevent_log_info);
+	return (size_t)n == len ? 0 : -EIO;
+}
+
+/* the telemetry log is streamed to a temporary file, then added from its map */
+static int collect_telemetry_bundle(struct collect_job *job, struct nvme_dev *dev,
+				    struct collect_spec *spec,
+				    struct nvme_collect_log *log, size_t size)
+{
+	FILE *tmp = tmpfile();
+	void *map;
+	int err;
+
+	if (!tmp)
+		return -errno;
+
+	err = get_log_telemetry_to_file(dev, true, true, size, fileno(tmp), false, NULL);
 	if (!err) {
-		err = nvme_cli_get_log_persistent_event(dev, cfg.action,
-							sizeof(*pevent),
-							pevent);
-		if (err < 0) {
-			nvme_show_error("persistent event log: %s", nvme_strerror(errno));
-			return err;
-		} else if (err) {
-			nvme_show_status(err);
-			return err;
-		}
-		pevent_collected = pevent_log_info;
-		if (pevent_collected->gen_number != pevent->gen_number) {
-			printf("Collected Persistent Event Log may be invalid,\n"
-			       "Re-read the log is required\n");
-			return -EINVAL;
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(tmp), 0);
+		if (map != MAP_FAILED) {
+			log->len = size;
+			err = collect_bundle_add(job, spec, log, map, size);
+			munmap(map, size);
+		} else {
+			err = -errno;
 		}
-
-		nvme_show_persistent_event_log(pevent_log_info, cfg.action,
-			cfg.log_len, dev->name, flags);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_error("persistent event log: %s", nvme_strerror(errno));
 	}
+	fclose(tmp);
 
 	return err;
 }
 
-static int get_endurance_event_agg_log(int argc, char **argv,
-		struct command *cmd, struct plugin *plugin)
+static int collect_log(struct collect_job *job, struct nvme_dev *dev,
+		       struct collect_spec *spec, struct nvme_collect_log *log)
 {
-	const char *desc = "Retrieve Retrieve Predictable Latency "
-		"Event Aggregate page and prints it, for the given "
-		"device in either decoded format(default), json or binary.";
-	const char *log_entries = "Number of pending Endurance Group Event log Entries list";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_free_ void *endurance_log = NULL;
-	enum nvme_print_flags flags;
-	__u32 log_size;
+	_cleanup_buf_ struct nvme_buf raw = { 0 };
+	_cleanup_file_ int fd = -1;
+	void *buf;
+	size_t size;
 	int err;
 
-	struct config {
-		__u64	log_entries;
-		bool	rae;
-		bool	raw_binary;
-	};
-
-	struct config cfg = {
-		.log_entries	= 2044,
-		.rae		= false,
-		.raw_binary	= false,
-	};
+	switch (spec->kind) {
+	case COLLECT_SMART:
+		buf = nvme_alloc(sizeof(struct nvme_smart_log));
+		if (!buf)
+			return -ENOMEM;
+		log->data = buf;
+		err = nvme_cli_get_log_smart(dev, NVME_NSID_ALL, true, buf);
+		if (err)
+			return err;
+		log->len = sizeof(struct nvme_smart_log);
+		return collect_save(job, spec, log, buf, log->len);
+	case COLLECT_ERROR:
+		ctrl = nvme_alloc(sizeof(*ctrl));
+		if (!ctrl)
+			return -ENOMEM;
+		err = nvme_cli_identify_ctrl(dev, ctrl);
+		if (err)
+			return err;
+		size = (ctrl->elpe + 1) * sizeof(struct nvme_error_log_page);
+		buf = nvme_alloc(size);
+		if (!buf)
+			return -ENOMEM;
+		log->data = buf;
+		err = nvme_cli_get_log_error(dev, ctrl->elpe + 1, true, buf);
+		if (err)
+			return err;
+		log->len = size;
+		return collect_save(job, spec, log, buf, size);
+	case COLLECT_TELEMETRY:
+		err = __get_telemetry_log_host(dev, NVME_TELEMETRY_DA_3, &size);
+		if (err)
+			return err;
+		if (job->bundle)
+			return collect_telemetry_bundle(job, dev, spec, log, size);
+		fd = collect_open_file(job, log, O_DIRECT);
+		if (fd < 0)
+			return fd;
+		err = get_log_telemetry_to_file(dev, true, true, size, fd, false, NULL);
+		if (err)
+			return err;
+		log->len = size;
+		return 0;
+	case COLLECT_RAW:
+		buf = nvme_buf_get(&raw, spec->len);
+		if (!buf)
+			return -ENOMEM;
+		err = nvme_cli_get_nsid_log(dev, true, spec->lid, NVME_NSID_ALL, spec->len, buf);
+		if (!err) {
+			log->len = spec->len;
+			err = collect_save(job, spec, log, buf, spec->len);
+		}
+		return err;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
-		  OPT_FLAG("rae",          'r', &cfg.rae,           rae),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+	return -EINVAL;
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+static void collect_dev(void *arg)
+{
+	struct collect_job *job = arg;
+	struct nvme_collect_dev *cdev = job->dev;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u64 start = monotonic_ns();
+	int i, err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (open_dev_direct(&dev, cdev->path, O_RDONLY)) {
+		cdev->err = -errno;
+		return;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	for (i = 0; i < job->nr_specs; i++) {
+		struct nvme_collect_log *log = &cdev->logs[i];
 
-	if (!cfg.log_entries) {
-		nvme_show_error("non-zero log-entries is required param");
-		return -EINVAL;
+		log->name = job->specs[i].name;
+		err = collect_log(job, dev, &job->specs[i], log);
+		/* libnvme reports transport failures as -1 with errno set */
+		log->err = err == -1 ? -errno : err;
 	}
+	cdev->nr_logs = job->nr_specs;
+	cdev->elapsed_ns = monotonic_ns() - start;
+}
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+static void collect_cmd_done(struct collect_cmd *cc, int err)
+{
+	struct collect_job *job = cc->job;
+	struct nvme_collect_log *log = &job->dev->logs[cc->i];
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err < 0) {
-		nvme_show_error("identify controller: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_error("could not identify controller");
-		return -ENODEV;
+	log->err = err;
+	if (!--job->left)
+		job->dev->elapsed_ns = monotonic_ns() - job->start;
+}
+
+static void collect_log_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct collect_cmd *cc = fc->priv;
+	struct nvme_collect_log *log = &cc->job->dev->logs[cc->i];
+
+	if (!status) {
+		log->len = cc->log.len;
+		status = collect_save(cc->job, &cc->job->specs[cc->i], log, cc->log.buf,
+				      cc->log.len);
 	}
+	nvme_buf_put(&cc->raw);
+	collect_cmd_done(cc, status);
+}
 
-	cfg.log_entries = min(cfg.log_entries, le16_to_cpu(ctrl->endgidmax));
-	log_size = sizeof(__u64) + cfg.log_entries * sizeof(__u16);
+static void collect_id_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct collect_cmd *cc = fc->priv;
+	struct nvme_id_ctrl *ctrl = (void *)(uintptr_t)fc->cmd.addr;
+	struct nvme_collect_log *log = &cc->job->dev->logs[cc->i];
+
+	if (!status) {
+		cc->log.len = (ctrl->elpe + 1) * sizeof(struct nvme_error_log_page);
+		cc->log.buf = log->data = nvme_alloc(cc->log.len);
+		status = log->data ? nvme_fanout_queue_log(cc->job->f, &cc->log, fc->fd,
+							   collect_log_done, cc) : -ENOMEM;
+	}
+	free(ctrl);
+	if (status)
+		collect_cmd_done(cc, status);
+}
 
-	endurance_log = nvme_alloc(log_size);
-	if (!endurance_log)
-		return -ENOMEM;
+static int collect_queue(struct collect_job *job, struct collect_cmd *cc)
+{
+	struct collect_spec *spec = &job->specs[cc->i];
+	struct nvme_collect_log *log = &job->dev->logs[cc->i];
+	int fd = dev_fd(job->ndev);
+	void *id;
+	int err;
 
-	err = nvme_cli_get_log_endurance_grp_evt(dev, cfg.rae, 0, log_size,
-						 endurance_log);
-	if (!err)
-		nvme_show_endurance_group_event_agg_log(endurance_log, cfg.log_entries, log_size,
-							dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("endurance group event aggregate log page: %s",
-				nvme_strerror(errno));
+	cc->log.nsid = NVME_NSID_ALL;
+	cc->log.rae = true;
 
-	return err;
+	switch (spec->kind) {
+	case COLLECT_SMART:
+		cc->log.lid = NVME_LOG_LID_SMART;
+		cc->log.len = sizeof(struct nvme_smart_log);
+		cc->log.buf = log->data = nvme_alloc(cc->log.len);
+		break;
+	case COLLECT_ERROR:
+		id = nvme_alloc(sizeof(struct nvme_id_ctrl));
+		if (!id)
+			return -ENOMEM;
+		cc->log.lid = NVME_LOG_LID_ERROR;
+		nvme_fanout_identify_cmd(&cc->id.cmd, NVME_IDENTIFY_CNS_CTRL, 0, 0, id);
+		err = nvme_fanout_queue(job->f, &cc->id, fd, collect_id_done, cc);
+		if (err)
+			free(id);
+		return err;
+	case COLLECT_RAW:
+		cc->log.lid = spec->lid;
+		cc->log.len = spec->len;
+		cc->log.buf = nvme_buf_get(&cc->raw, spec->len);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!cc->log.buf)
+		return -ENOMEM;
+
+	return nvme_fanout_queue_log(job->f, &cc->log, fd, collect_log_done, cc);
 }
 
-static int get_lba_status_log(int argc, char **argv,
-		struct command *cmd, struct plugin *plugin)
+/*
+ * Collect the logs of all the devices from a single thread, their commands
+ * going through one io_uring. Telemetry logs take the thread pool instead.
+ */
+static void collect_fanout(struct collect_job *job, int nr_devs)
 {
-	const char *desc = "Retrieve Get LBA Status Info Log and prints it, "
-		"for the given device in either decoded format(default),json or binary.";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *lba_status = NULL;
-	enum nvme_print_flags flags;
-	__u32 lslplen;
-	int err;
+	struct nvme_fanout f;
+	struct collect_cmd *cc;
+	int i, j, err;
 
-	struct config {
-		bool	rae;
-	};
+	nvme_fanout_init(&f, 64, 0);
 
-	struct config cfg = {
-		.rae		= false,
-	};
+	for (i = 0; i < nr_devs; i++) {
+		job[i].f = &f;
+		if (open_dev_direct(&job[i].ndev, job[i].dev->path, O_RDONLY)) {
+			job[i].dev->err = -errno;
+			continue;
+		}
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("rae",          'r', &cfg.rae,           rae));
+		job[i].start = monotonic_ns();
+		job[i].dev->nr_logs = job[i].nr_specs;
+		for (j = 0; j < job[i].nr_specs; j++) {
+			cc = &job[i].cmds[j];
+			cc->job = &job[i];
+			cc->i = j;
+			job[i].dev->logs[j].name = job[i].specs[j].name;
+			/* until it completes, the ring may fail */
+			job[i].dev->logs[j].err = -ECANCELED;
+
+			job[i].left++;
+			err = collect_queue(&job[i], cc);
+			if (err) {
+				nvme_buf_put(&cc->raw);
+				collect_cmd_done(cc, err);
+			}
+		}
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = nvme_fanout_run(&f);
 	if (err)
-		return err;
+		nvme_show_error("collect: %s", nvme_strerror(-err));
+	nvme_fanout_exit(&f);
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	for (i = 0; i < nr_devs; i++) {
+		if (job[i].left)
+			job[i].dev->elapsed_ns = monotonic_ns() - job[i].start;
+		if (job[i].ndev)
+			dev_close(job[i].ndev);
 	}
+}
 
-	err = nvme_cli_get_log_lba_status(dev, true, 0, sizeof(__u32),
-					  &lslplen);
-	if (err < 0) {
-		nvme_show_error("lba status log page: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_status(err);
-		return err;
+/*
+ * scan_topology - create the topology root and scan it
+ *
+ * In batch mode the scanned root is handed out again to the following
+ * commands; release it with put_topology(), through _cleanup_topology_.
+ *
+ * Returns 0, or a negative value with errno set.
+ */
+static int scan_topology(nvme_root_t *r)
+{
+	int err;
+
+	if (batch_root) {
+		*r = batch_root;
+		return 0;
 	}
 
-	lba_status = nvme_alloc(lslplen);
-	if (!lba_status)
-		return -ENOMEM;
+	*r = nvme_create_root(stderr, log_level);
+	if (!*r)
+		return -1;
 
-	err = nvme_cli_get_log_lba_status(dev, cfg.rae, 0, lslplen, lba_status);
-	if (!err)
-		nvme_show_lba_status_log(lba_status, lslplen, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("lba status log page: %s", nvme_strerror(errno));
+	err = nvme_scan_topology(*r, NULL, NULL);
+	if (err < 0)
+		return err;
 
-	return err;
+	if (batch_mode)
+		batch_root = *r;
+
+	return 0;
 }
 
-static int get_resv_notif_log(int argc, char **argv,
-	struct command *cmd, struct plugin *plugin)
+static void put_topology(nvme_root_t *r)
 {
+	if (*r && *r != batch_root)
+		nvme_free_tree(*r);
+}
+#define _cleanup_topology_ __cleanup__(put_topology)
 
-	const char *desc = "Retrieve Reservation Notification "
-		"log page and prints it, for the given "
-		"device in either decoded format(default), json or binary.";
-
-	_cleanup_free_ struct nvme_resv_notification_log *resv = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
+static int ctrl_paths_scan(char ***paths, int *nr)
+{
+	_cleanup_topology_ nvme_root_t r = NULL;
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_ctrl_t c;
 	int err;
 
-	NVME_ARGS(opts);
+	err = scan_topology(&r);
+	if (err < 0)
+		return -errno;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	nvme_for_each_host(r, h)
+		nvme_for_each_subsystem(h, s)
+			nvme_subsystem_for_each_ctrl(s, c) {
+				char **tmp;
+
+				tmp = realloc(*paths, (*nr + 1) * sizeof(*tmp));
+				if (!tmp)
+					return -ENOMEM;
+				*paths = tmp;
+				if (asprintf(&tmp[*nr], "/dev/%s", nvme_ctrl_get_name(c)) < 0)
+					return -ENOMEM;
+				(*nr)++;
+			}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
+	return 0;
+}
+
+/*
+ * Controllers named by the remaining arguments, or every controller found
+ * in the topology for no arguments or 'all'. Free with ctrl_paths_free().
+ */
+static int ctrl_paths_get(int argc, char **argv, char ***paths, int *nr)
+{
+	int i, err;
+
+	*paths = NULL;
+	*nr = 0;
+
+	if (optind >= argc || (optind == argc - 1 && !strcmp(argv[optind], "all"))) {
+		err = ctrl_paths_scan(paths, nr);
+		if (err)
+			nvme_show_error("Failed to scan topology: %s", nvme_strerror(-err));
 		return err;
 	}
 
-	resv = nvme_alloc(sizeof(*resv));
-	if (!resv)
+	*paths = calloc(argc - optind, sizeof(**paths));
+	if (!*paths)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_reservation(dev, false, resv);
-	if (!err)
-		nvme_show_resv_notif_log(resv, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("resv notifi log: %s", nvme_strerror(errno));
-
-	return err;
+	for (i = optind; i < argc; i++) {
+		(*paths)[*nr] = strdup(argv[i]);
+		if (!(*paths)[*nr])
+			return -ENOMEM;
+		(*nr)++;
+	}
 
+	return 0;
 }
 
-static int get_boot_part_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static void ctrl_paths_free(char **paths, int nr)
 {
-	const char *desc = "Retrieve Boot Partition "
-		"log page and prints it, for the given "
-		"device in either decoded format(default), json or binary.";
-	const char *fname = "boot partition data output file name";
+	int i;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_boot_partition *boot = NULL;
-	_cleanup_free_ __u8 *bp_log = NULL;
+	for (i = 0; i < nr; i++)
+		free(paths[i]);
+	free(paths);
+}
+
+static int collect(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve logs from several devices concurrently.\n"
+		"Devices are given as arguments, by default or with 'all' every\n"
+		"controller found in the topology is used.";
+	const char *logs = "comma separated list of logs: smart-log, error-log,\n"
+		"telemetry-log or <lid>:<length> for other (e.g. vendor specific) logs";
+	const char *output_dir = "directory for raw log files <device>-<log>.bin";
+	const char *bundle = "file the raw logs of all the devices are bundled in";
+	const char *jobs = "number of devices processed in parallel, 0 for one per CPU";
+
+	struct nvme_thread_pool *pool = NULL;
+	_cleanup_free_ struct nvme_collect_dev *devs = NULL;
+	_cleanup_free_ struct collect_job *job = NULL;
+	struct collect_spec specs[NVME_COLLECT_MAX_LOGS];
+	_cleanup_free_ char *log_list = NULL;
+	struct nvme_bundle_writer *bw = NULL;
+	_cleanup_file_ int bundle_fd = -1;
 	enum nvme_print_flags flags;
-	int err = -1;
-	_cleanup_file_ int output = -1;
-	__u32 bpsz = 0;
+	char **paths = NULL;
+	char sysdir[PATH_MAX];
+	int nr_devs = 0, nr_specs = 0, i, j, err, bundle_err;
+	bool fanout;
 
 	struct config {
-		__u8	lsp;
-		char	*file_name;
+		char		*logs;
+		char		*output_dir;
+		char		*bundle;
+		__u32		jobs;
 	};
 
 	struct config cfg = {
-		.lsp		= 0,
-		.file_name	= NULL,
+		.logs		= "smart-log,error-log",
+		.output_dir	= NULL,
+		.bundle		= NULL,
+		.jobs		= 8,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_BYTE("lsp",          's', &cfg.lsp,           lsp),
-		  OPT_FILE("output-file",  'f', &cfg.file_name,     fname));
+		  OPT_LIST("logs",       'l', &cfg.logs,       logs),
+		  OPT_FILE("output-dir", 'd', &cfg.output_dir, output_dir),
+		  OPT_FILE("bundle",     'B', &cfg.bundle,     bundle),
+		  OPT_UINT("jobs",       'j', &cfg.jobs,       jobs));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
 	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
 		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	log_list = strdup(cfg.logs);
+	if (!log_list)
+		return -ENOMEM;
+
+	err = collect_parse_logs(log_list, specs, &nr_specs);
+	if (err)
 		return err;
+
+	if (cfg.output_dir && cfg.bundle) {
+		nvme_show_error("--output-dir and --bundle are exclusive");
+		return -EINVAL;
 	}
 
-	if (!cfg.file_name) {
-		nvme_show_error("Please provide an output file!");
-		return -1;
+	for (i = 0; i < nr_specs && !cfg.output_dir && !cfg.bundle; i++) {
+		if (specs[i].kind == COLLECT_TELEMETRY || specs[i].kind == COLLECT_RAW) {
+			nvme_show_error("%s requires --output-dir or --bundle", specs[i].name);
+			return -EINVAL;
+		}
 	}
 
-	if (cfg.lsp > 127) {
-		nvme_show_error("invalid lsp param: %u", cfg.lsp);
-		return -1;
+	/* the telemetry logs are read with libnvme, from the thread pool */
+	fanout = nvme_uring_supported();
+	for (i = 0; i < nr_specs; i++)
+		if (specs[i].kind == COLLECT_TELEMETRY)
+			fanout = false;
+
+	err = ctrl_paths_get(argc, argv, &paths, &nr_devs);
+	if (err)
+		goto free;
+
+	if (!nr_devs) {
+		nvme_show_error("no devices found");
+		err = -ENODEV;
+		goto free;
 	}
 
-	output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-	if (output < 0) {
-		nvme_show_error("Failed to open output file %s: %s!",
-				cfg.file_name, strerror(errno));
-		return output;
+	devs = calloc(nr_devs, sizeof(*devs));
+	if (!devs) {
+		err = -ENOMEM;
+		goto free;
 	}
 
-	boot = nvme_alloc(sizeof(*boot));
-	if (!boot)
-		return -ENOMEM;
+	job = calloc(nr_devs, sizeof(*job));
+	if (!job) {
+		err = -ENOMEM;
+		goto free;
+	}
 
-	err = nvme_cli_get_log_boot_partition(dev, false, cfg.lsp,
-					      sizeof(*boot), boot);
-	if (err < 0) {
-		nvme_show_error("boot partition log: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_status(err);
-		return err;
+	if (cfg.bundle) {
+		bundle_fd = open(cfg.bundle, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		bw = bundle_fd < 0 ? NULL : nvme_bundle_create(bundle_fd);
+		if (!bw) {
+			err = -errno;
+			nvme_show_error("%s: %s", cfg.bundle, nvme_strerror(errno));
+			goto free;
+		}
 	}
 
-	bpsz = (boot->bpinfo & 0x7fff) * 128 * 1024;
-	bp_log = nvme_alloc(sizeof(*boot) + bpsz);
-	if (!bp_log)
-		return -ENOMEM;
+	for (i = 0; i < nr_devs; i++) {
+		devs[i].path = paths[i];
+		devs[i].name = basename(devs[i].path);
+		job[i].dev = &devs[i];
+		job[i].specs = specs;
+		job[i].nr_specs = nr_specs;
+		job[i].dir = cfg.output_dir;
+		job[i].bundle = bw;
+		/* the identity of the controller in the table of contents */
+		snprintf(sysdir, sizeof(sysdir), "/sys/class/nvme/%s", devs[i].name);
+		if (bw && sysfs_read_attr(sysdir, "serial", job[i].sn, sizeof(job[i].sn)))
+			job[i].sn[0] = '\0';
+	}
 
-	err = nvme_cli_get_log_boot_partition(dev, false, cfg.lsp,
-					      sizeof(*boot) + bpsz,
-					      (struct nvme_boot_partition *)bp_log);
-	if (!err)
-		nvme_show_boot_part_log(&bp_log, dev->name, sizeof(*boot) + bpsz, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("boot partition log: %s", nvme_strerror(errno));
+	if (fanout) {
+		collect_fanout(job, nr_devs);
+		goto show;
+	}
 
-	err = write(output, (void *) bp_log + sizeof(*boot), bpsz);
-	if (err != bpsz)
-		fprintf(stderr, "Failed to flush all data to file!\n");
-	else
-		printf("Data flushed into file %s\n", cfg.file_name);
-	err = 0;
+	pool = nvme_thread_pool_create(nvme_thread_pool_jobs(cfg.jobs, nr_devs));
+	if (!pool) {
+		err = -errno;
+		nvme_show_error("thread pool: %s", nvme_strerror(errno));
+		goto free;
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		err = nvme_thread_pool_queue(pool, collect_dev, &job[i]);
+		if (err) {
+			devs[i].err = err;
+			err = 0;
+		}
+	}
+	nvme_thread_pool_destroy(pool);
+
+show:
+	nvme_show_collect(devs, nr_devs, flags);
+
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err)
+			err = devs[i].err;
+		for (j = 0; j < devs[i].nr_logs; j++)
+			if (devs[i].logs[j].err)
+				err = devs[i].logs[j].err;
+	}
+
+	if (bw) {
+		bundle_err = nvme_bundle_close(bw);
+		bw = NULL;
+		if (bundle_err) {
+			nvme_show_error("%s: %s", cfg.bundle, nvme_strerror(-bundle_err));
+			err = bundle_err;
+		}
+	}
+
+free:
+	if (bw)
+		nvme_bundle_close(bw);
+	for (i = 0; devs && i < nr_devs; i++) {
+		for (j = 0; j < devs[i].nr_logs; j++) {
+			free(devs[i].logs[j].data);
+			free(devs[i].logs[j].file);
+		}
+	}
+	ctrl_paths_free(paths, nr_devs);
 
 	return err;
 }
 
-static int get_phy_rx_eom_log(int argc, char **argv, struct command *cmd,
-		struct plugin *plugin)
-{
-	const char *desc = "Retrieve Physical Interface Receiver Eye Opening "
-		"Measurement log for the given device in decoded format "
-		"(default), json or binary.";
-	const char *controller = "Target Controller ID.";
-	_cleanup_free_ struct nvme_phy_rx_eom_log *phy_rx_eom_log = NULL;
-	size_t phy_rx_eom_log_len;
-	enum nvme_print_flags flags;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err = -1;
-	__u8 lsp_tmp;
+#define SERVE_MAX_CLIENTS	64
+#define SERVE_LINE_MAX		256
 
-	struct config {
-		__u8	lsp;
-		__u16	controller;
-	};
+/*
+ * Identify Controller data is cached per controller until a flush request,
+ * the namespace data changes with its utilization and is read every time.
+ */
+struct serve_dev {
+	struct serve_dev *next;
+	char *path;
+	struct nvme_dev *dev;
+	struct nvme_id_ctrl *ctrl;
+};
 
-	struct config cfg = {
-		.lsp		= 0,
-		.controller	= NVME_LOG_LSI_NONE,
-	};
+struct serve_client {
+	int fd;
+	size_t len;
+	char buf[SERVE_LINE_MAX];
+};
 
-	NVME_ARGS(opts,
-		  OPT_BYTE("lsp",        's', &cfg.lsp,        lsp),
-		  OPT_SHRT("controller", 'c', &cfg.controller, controller));
+static void serve_free_dev(struct serve_dev *sdev)
+{
+	free(sdev->ctrl);
+	if (sdev->dev)
+		dev_close(sdev->dev);
+	free(sdev->path);
+	free(sdev);
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+static void serve_drop_dev(struct serve_dev **cache, struct serve_dev *sdev)
+{
+	struct serve_dev **p;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	for (p = cache; *p; p = &(*p)->next) {
+		if (*p == sdev) {
+			*p = sdev->next;
+			serve_free_dev(sdev);
+			return;
+		}
 	}
+}
 
-	if (cfg.lsp > 127) {
-		nvme_show_error("invalid lsp param: %u", cfg.lsp);
-		return -1;
-	} else if ((cfg.lsp & 3) == 3) {
-		nvme_show_error("invalid measurement quality: %u", cfg.lsp & 3);
-		return -1;
-	} else if ((cfg.lsp & 12) == 12) {
-		nvme_show_error("invalid action: %u", cfg.lsp & 12);
-		return -1;
-	}
+static int serve_get_dev(struct serve_dev **cache, const char *name, struct serve_dev **sdevp)
+{
+	struct serve_dev *sdev;
+	int err;
 
-	/* Fetching header to calculate total log length */
-	phy_rx_eom_log_len = sizeof(struct nvme_phy_rx_eom_log);
-	phy_rx_eom_log = nvme_alloc(phy_rx_eom_log_len);
-	if (!phy_rx_eom_log)
-		return -ENOMEM;
+	/* only device nodes, the socket must not give access to other files */
+	if (!name || strchr(name, '/') || !strcmp(name, "..")) {
+		nvme_show_error("invalid device '%s'", name ? name : "");
+		return -EINVAL;
+	}
 
-	/* Just read measurement, take given action when fetching full log */
-	lsp_tmp = cfg.lsp & 0xf3;
+	for (sdev = *cache; sdev; sdev = sdev->next) {
+		if (!strcmp(sdev->dev->name, name)) {
+			*sdevp = sdev;
+			return 0;
+		}
+	}
 
-	err = nvme_cli_get_log_phy_rx_eom(dev, lsp_tmp, cfg.controller, phy_rx_eom_log_len,
-					  phy_rx_eom_log);
-	if (err) {
-		if (err > 0)
-			nvme_show_status(err);
-		else
-			nvme_show_error("phy-rx-eom-log: %s", nvme_strerror(errno));
+	sdev = calloc(1, sizeof(*sdev));
+	if (!sdev || asprintf(&sdev->path, "/dev/%s", name) < 0) {
+		free(sdev);
+		nvme_show_error("%s: %s", name, nvme_strerror(ENOMEM));
+		return -ENOMEM;
+	}
 
+	/* reports the error itself */
+	if (open_dev_direct(&sdev->dev, sdev->path, O_RDONLY)) {
+		err = -errno;
+		serve_free_dev(sdev);
 		return err;
 	}
 
-	if (phy_rx_eom_log->eomip == NVME_PHY_RX_EOM_COMPLETED)
-		phy_rx_eom_log_len = le16_to_cpu(phy_rx_eom_log->hsize) +
-				     le32_to_cpu(phy_rx_eom_log->dsize) *
-				     le16_to_cpu(phy_rx_eom_log->nd);
-	else
-		phy_rx_eom_log_len = le16_to_cpu(phy_rx_eom_log->hsize);
+	sdev->next = *cache;
+	*cache = sdev;
+	*sdevp = sdev;
 
-	phy_rx_eom_log = nvme_realloc(phy_rx_eom_log, phy_rx_eom_log_len);
-	if (!phy_rx_eom_log)
-		return -ENOMEM;
+	return 0;
+}
 
-	err = nvme_cli_get_log_phy_rx_eom(dev, cfg.lsp, cfg.controller, phy_rx_eom_log_len,
-					  phy_rx_eom_log);
-	if (!err)
-		nvme_show_phy_rx_eom_log(phy_rx_eom_log, cfg.controller, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("phy-rx-eom-log: %s", nvme_strerror(errno));
+static int serve_id_ctrl(struct serve_dev *sdev, struct nvme_id_ctrl **ctrl)
+{
+	int err;
 
-	return err;
+	if (!sdev->ctrl) {
+		sdev->ctrl = nvme_alloc(sizeof(*sdev->ctrl));
+		if (!sdev->ctrl)
+			return -1;
+
+		err = nvme_cli_identify_ctrl(sdev->dev, sdev->ctrl);
+		if (err) {
+			free(sdev->ctrl);
+			sdev->ctrl = NULL;
+			return err;
+		}
+	}
+
+	*ctrl = sdev->ctrl;
+	return 0;
 }
 
-static int get_media_unit_stat_log(int argc, char **argv, struct command *cmd,
-				   struct plugin *plugin)
+static int serve_nsid(struct serve_dev *sdev, const char *arg, __u32 *nsid)
 {
-	const char *desc = "Retrieve the configuration and wear of media units and print it";
+	char *end;
 
-	_cleanup_free_ struct nvme_media_unit_stat_log *mus = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err = -1;
+	if (!arg)
+		return nvme_get_nsid(dev_fd(sdev->dev), nsid);
 
-	struct config {
-		__u16	domainid;
-		bool	raw_binary;
-	};
+	*nsid = strtoul(arg, &end, 0);
+	if (*end) {
+		errno = EINVAL;
+		return -1;
+	}
 
-	struct config cfg = {
-		.domainid	= 0,
-		.raw_binary	= false,
-	};
+	return 0;
+}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("domain-id",     'd', &cfg.domainid, domainid),
-		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary, raw_use));
+/*
+ * One request per line, '<command> [<device> [<nsid>]]'. The response is
+ * printed as JSON to stdout, which points to the client socket.
+ */
+static int serve_request(struct serve_dev **cache, char *line)
+{
+	_cleanup_free_ struct nvme_error_log_page *err_log = NULL;
+	_cleanup_free_ struct nvme_smart_log *smart = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct serve_dev *sdev = NULL;
+	struct nvme_id_ctrl *ctrl;
+	char *cmd, *name, *arg, *save;
+	__u32 nsid = NVME_NSID_ALL;
+	int entries = 0, err;
+
+	cmd = strtok_r(line, " \t\r", &save);
+	name = strtok_r(NULL, " \t\r", &save);
+	arg = strtok_r(NULL, " \t\r", &save);
+	if (!cmd) {
+		nvme_show_error("empty request");
+		return -EINVAL;
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (!strcmp(cmd, "flush")) {
+		struct serve_dev *next;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+		for (sdev = *cache; sdev; sdev = next) {
+			next = sdev->next;
+			if (!name || !strcmp(sdev->dev->name, name))
+				serve_drop_dev(cache, sdev);
+		}
+		nvme_show_message(false, "flushed %s", name ? name : "all");
+		return 0;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	if (strcmp(cmd, "id-ctrl") && strcmp(cmd, "id-ns") &&
+	    strcmp(cmd, "smart-log") && strcmp(cmd, "error-log")) {
+		nvme_show_error("unknown request '%s'", cmd);
+		return -EINVAL;
+	}
 
-	mus = nvme_alloc(sizeof(*mus));
-	if (!mus)
-		return -ENOMEM;
+	err = serve_get_dev(cache, name, &sdev);
+	if (err)
+		return err;
 
-	err = nvme_cli_get_log_media_unit_stat(dev, cfg.domainid, mus);
-	if (!err)
-		nvme_show_media_unit_stat_log(mus, flags);
-	else if (err > 0)
+	if (!strcmp(cmd, "id-ctrl")) {
+		err = serve_id_ctrl(sdev, &ctrl);
+		if (!err)
+			nvme_show_id_ctrl(ctrl, JSON, NULL);
+	} else if (!strcmp(cmd, "id-ns")) {
+		err = serve_nsid(sdev, arg, &nsid);
+		if (!err) {
+			ns = nvme_alloc(sizeof(*ns));
+			if (!ns) {
+				errno = ENOMEM;
+				err = -1;
+			}
+		}
+		if (!err)
+			err = nvme_cli_identify_ns(sdev->dev, nsid, ns);
+		if (!err)
+			nvme_show_id_ns(ns, nsid, 0, false, JSON);
+	} else if (!strcmp(cmd, "smart-log")) {
+		if (arg)
+			err = serve_nsid(sdev, arg, &nsid);
+		smart = nvme_alloc(sizeof(*smart));
+		if (!smart) {
+			errno = ENOMEM;
+			err = -1;
+		}
+		if (!err)
+			err = nvme_cli_get_log_smart(sdev->dev, nsid, true, smart);
+		if (!err)
+			nvme_show_smart_log(smart, nsid, sdev->dev->name, JSON);
+	} else {
+		err = serve_id_ctrl(sdev, &ctrl);
+		if (!err) {
+			entries = ctrl->elpe + 1;
+			err_log = nvme_alloc(entries * sizeof(*err_log));
+			if (!err_log) {
+				errno = ENOMEM;
+				err = -1;
+			}
+		}
+		if (!err)
+			err = nvme_cli_get_log_error(sdev->dev, entries, true, err_log);
+		if (!err)
+			nvme_show_error_log(err_log, entries, sdev->dev->name, JSON);
+	}
+
+	if (err > 0) {
 		nvme_show_status(err);
-	else
-		nvme_show_error("media unit status log: %s", nvme_strerror(errno));
+	} else if (err < 0) {
+		int errnum = errno;
+
+		nvme_show_error("%s: %s", cmd, nvme_strerror(errnum));
+		/* the device may be gone, reopen it on the next request */
+		if (errnum != EINVAL && errnum != ENOTTY && errnum != ENOMEM)
+			serve_drop_dev(cache, sdev);
+	}
 
 	return err;
 }
 
-static int get_supp_cap_config_log(int argc, char **argv, struct command *cmd,
-				   struct plugin *plugin)
+/* Returns false once the client should be disconnected */
+static bool serve_client_read(struct serve_dev **cache, struct serve_client *c, int out)
 {
-	const char *desc = "Retrieve the list of Supported Capacity Configuration Descriptors";
+	ssize_t n;
+	char *nl;
 
-	_cleanup_free_ struct nvme_supported_cap_config_list_log *cap_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err = -1;
+	n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+	if (n <= 0)
+		return false;
+	c->len += n;
 
-	struct config {
-		__u16	domainid;
-		bool	raw_binary;
-	};
+	while ((nl = memchr(c->buf, '\n', c->len))) {
+		*nl = '\0';
 
-	struct config cfg = {
-		.domainid	= 0,
-		.raw_binary	= false,
-	};
+		fflush(stdout);
+		if (dup2(c->fd, STDOUT_FILENO) < 0)
+			return false;
+		serve_request(cache, c->buf);
+		/* an empty line terminates the response */
+		printf("\n");
+		fflush(stdout);
+		dup2(out, STDOUT_FILENO);
 
-	NVME_ARGS(opts,
-		  OPT_UINT("domain-id",     'd', &cfg.domainid,       domainid),
-		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,     raw_use));
+		c->len -= nl + 1 - c->buf;
+		memmove(c->buf, nl + 1, c->len);
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	return c->len < sizeof(c->buf);
+}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+static int serve_listen(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat st;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
 	}
+	strcpy(addr.sun_path, path);
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	/* remove a stale socket of a previous instance */
+	if (!stat(path, &st) && S_ISSOCK(st.st_mode))
+		unlink(path);
 
-	cap_log = nvme_alloc(sizeof(*cap_log));
-	if (!cap_log)
-		return -ENOMEM;
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return -1;
 
-	err = nvme_cli_get_log_support_cap_config_list(dev, cfg.domainid,
-						       cap_log);
-	if (!err)
-		nvme_show_supported_cap_config_log(cap_log, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror("supported capacity configuration list log");
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    chmod(path, 0600) < 0 || listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
 
-	return err;
+	return fd;
 }
 
-static int io_mgmt_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int serve(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "I/O Management Send";
-	const char *data = "optional file for data (default stdin)";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *buf = NULL;
-	int err = -1;
-	int dfd = STDIN_FILENO;
+	const char *desc = "Serve requests on a Unix socket, keeping devices open and\n"
+		"caching identify data between requests. Each request is a line\n"
+		"'<command> [<device> [<nsid>]]' with the commands id-ctrl, id-ns,\n"
+		"smart-log, error-log and flush, answered with JSON followed by\n"
+		"an empty line.";
+	const char *socket_path = "path of the Unix socket";
+
+	struct serve_client clients[SERVE_MAX_CLIENTS];
+	struct pollfd pfd[SERVE_MAX_CLIENTS + 1];
+	struct timeval timeout = { .tv_sec = 5 };
+	struct serve_dev *cache = NULL, *sdev;
+	_cleanup_file_ int lfd = -1;
+	_cleanup_file_ int out = -1;
+	int i, n, err = 0;
 
 	struct config {
-		__u16 mos;
-		__u8  mo;
-		__u32 namespace_id;
-		char  *file;
-		__u32 data_len;
+		char	*socket;
 	};
 
 	struct config cfg = {
-		.mos = 0,
+		.socket		= "/run/nvme.sock",
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_SHRT("mos",           's', &cfg.mos,            mos),
-		  OPT_BYTE("mo",            'm', &cfg.mo,             mo),
-		  OPT_FILE("data",          'd', &cfg.file,           data),
-		  OPT_UINT("data-len",      'l', &cfg.data_len,       buf_len));
+		  OPT_FILE("socket", 'S', &cfg.socket, socket_path));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
+	/* responses are always JSON, including errors */
+	output_format_val = "json";
+	output_format_resolve();
+
+	lfd = serve_listen(cfg.socket);
+	if (lfd < 0) {
+		nvme_show_perror(cfg.socket);
+		return -errno;
 	}
 
-	if (cfg.data_len) {
-		buf = nvme_alloc(cfg.data_len);
-		if (!buf)
-			return -ENOMEM;
+	out = dup(STDOUT_FILENO);
+	if (out < 0) {
+		err = -errno;
+		goto unlink;
 	}
 
-	if (cfg.file) {
-		dfd = open(cfg.file, O_RDONLY);
-		if (dfd < 0) {
-			nvme_show_perror(cfg.file);
-			return -errno;
+	for (i = 0; i < SERVE_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	signal(SIGPIPE, SIG_IGN);
+	nvme_stop_catch(true, NULL);
+
+	while (!nvme_stopped()) {
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < SERVE_MAX_CLIENTS; i++) {
+			pfd[i + 1].fd = clients[i].fd;
+			pfd[i + 1].events = POLLIN;
 		}
-	}
 
-	err = read(dfd, buf, cfg.data_len);
-	if (err < 0) {
-		nvme_show_perror("read");
-		goto close_fd;
+		n = poll(pfd, SERVE_MAX_CLIENTS + 1, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			err = -errno;
+			nvme_show_perror("poll");
+			break;
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			int fd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+
+			for (i = 0; fd >= 0 && i < SERVE_MAX_CLIENTS; i++) {
+				if (clients[i].fd < 0) {
+					/* don't let a stuck client block everybody else */
+					setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout,
+						   sizeof(timeout));
+					clients[i].fd = fd;
+					clients[i].len = 0;
+					fd = -1;
+				}
+			}
+			if (fd >= 0)
+				close(fd);
+		}
+
+		for (i = 0; i < SERVE_MAX_CLIENTS; i++) {
+			if (clients[i].fd < 0 || !pfd[i + 1].revents)
+				continue;
+			if (!serve_client_read(&cache, &clients[i], out)) {
+				close(clients[i].fd);
+				clients[i].fd = -1;
+			}
+		}
 	}
 
-	struct nvme_io_mgmt_send_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.mos		= cfg.mos,
-		.mo		= cfg.mo,
-		.data_len	= cfg.data_len,
-		.data		= buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-	};
+	nvme_stop_release();
+	signal(SIGPIPE, SIG_DFL);
 
-	err = nvme_io_mgmt_send(&args);
-	if (!err)
-		printf("io-mgmt-send: Success, mos:%u mo:%u nsid:%d\n",
-			cfg.mos, cfg.mo, cfg.namespace_id);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror("io-mgmt-send");
+	for (i = 0; i < SERVE_MAX_CLIENTS; i++)
+		if (clients[i].fd >= 0)
+			close(clients[i].fd);
+
+	while ((sdev = cache)) {
+		cache = sdev->next;
+		serve_free_dev(sdev);
+	}
+
+unlink:
+	unlink(cfg.socket);
 
-close_fd:
-	if (cfg.file)
-		close(dfd);
 	return err;
 }
 
-static int io_mgmt_recv(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int exporter(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "I/O Management Receive";
-	const char *data = "optional file for data (default stdout)";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *buf = NULL;
-	int err = -1;
-	_cleanup_file_ int dfd = -1;
-
-	struct config {
-		__u16 mos;
-		__u8  mo;
-		__u32 namespace_id;
-		char  *file;
-		__u32 data_len;
-	};
-
-	struct config cfg = {
-		.mos = 0,
+	const char *desc = "Serve the SMART and endurance group logs of every controller\n"
+		"as Prometheus metrics on http://<address>:<port>/metrics. The logs\n"
+		"are read by a background thread every interval and a scrape returns\n"
+		"the last result, so it never waits for an admin command.";
+	const char *address = "IPv4 or IPv6 address to listen on";
+	const char *port = "TCP port to listen on";
+	const char *interval = "seconds between reading the logs";
+	const char *ocp = "also export the OCP SMART / Health Information Extended log";
+	const char *fdp = "also export the FDP statistics log of FDP endurance groups";
+
+	struct nvme_exporter_cfg cfg = {
+		.address	= "0.0.0.0",
+		.port		= 9998,
+		.interval	= 15,
+		.ocp		= false,
+		.fdp		= false,
 	};
+	int err;
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_SHRT("mos",           's', &cfg.mos,            mos),
-		  OPT_BYTE("mo",            'm', &cfg.mo,             mo),
-		  OPT_FILE("data",          'd', &cfg.file,           data),
-		  OPT_UINT("data-len",      'l', &cfg.data_len,       buf_len));
+		  OPT_STRING("address", 'a', "ADDR", &cfg.address,  address),
+		  OPT_UINT("port",      'p', &cfg.port,             port),
+		  OPT_UINT("interval",  'i', &cfg.interval,         interval),
+		  OPT_FLAG("ocp",       'O', &cfg.ocp,              ocp),
+		  OPT_FLAG("fdp",       'F', &cfg.fdp,              fdp));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
-	}
-
-	if (cfg.data_len) {
-		buf = nvme_alloc(cfg.data_len);
-		if (!buf)
-			return -ENOMEM;
+	if (!cfg.port || cfg.port > 65535 || !cfg.interval) {
+		nvme_show_error("invalid port or interval");
+		return -EINVAL;
 	}
 
-	struct nvme_io_mgmt_recv_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.mos		= cfg.mos,
-		.mo		= cfg.mo,
-		.data_len	= cfg.data_len,
-		.data		= buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-	};
-
-	err = nvme_io_mgmt_recv(&args);
-	if (!err) {
-		printf("io-mgmt-recv: Success, mos:%u mo:%u nsid:%d\n",
-			cfg.mos, cfg.mo, cfg.namespace_id);
+#ifdef CONFIG_JSONC
+	signal(SIGPIPE, SIG_IGN);
+	nvme_stop_catch(true, nvme_exporter_stop);
 
-		if (cfg.file) {
-			dfd = open(cfg.file, O_WRONLY | O_CREAT, 0644);
-			if (dfd < 0) {
-				nvme_show_perror(cfg.file);
-				return -errno;
-			}
+	err = nvme_exporter_run(&cfg);
+	if (err)
+		nvme_show_error("exporter: %s", nvme_strerror(-err));
 
-			err = write(dfd, buf, cfg.data_len);
-			if (err < 0) {
-				nvme_show_perror("write");
-				return -errno;
-			}
-		} else {
-			d((unsigned char *)buf, cfg.data_len, 16, 1);
-		}
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_perror("io-mgmt-recv");
-	}
+	nvme_stop_release();
+	signal(SIGPIPE, SIG_DFL);
 
 	return err;
+#else
+	nvme_show_error("exporter: built without json-c support");
+	return -ENOTSUP;
+#endif
 }
 
-static int get_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int decode_archive(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Retrieve desired number of bytes "
-		"from a given log on a specified device in either "
-		"hex-dump (default) or binary format";
-	const char *log_id = "identifier of log to retrieve";
-	const char *log_len = "how many bytes to retrieve";
-	const char *aen = "result of the aen, use to override log id";
-	const char *lpo = "log page offset specifies the location within a log page from where to start returning data";
-	const char *lsi = "log specific identifier specifies an identifier that is required for a particular log page";
-	const char *raw = "output in raw format";
-	const char *offset_type = "offset type";
-	const char *xfer_len = "read chunk size (default 4k)";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ unsigned char *log = NULL;
-	int err;
-
-	struct config {
-		__u32	namespace_id;
-		__u8	log_id;
-		__u32	log_len;
-		__u32	aen;
-		__u64	lpo;
-		__u8	lsp;
-		__u16	lsi;
-		bool	rae;
-		__u8	uuid_index;
-		bool	raw_binary;
-		__u8	csi;
-		bool	ot;
-		__u32	xfer_len;
-	};
-
-	struct config cfg = {
-		.namespace_id	= NVME_NSID_ALL,
-		.log_id		= 0xff,
-		.log_len	= 0,
-		.aen		= 0,
-		.lpo		= NVME_LOG_LPO_NONE,
-		.lsp		= NVME_LOG_LSP_NONE,
-		.lsi		= NVME_LOG_LSI_NONE,
-		.rae		= false,
-		.uuid_index	= NVME_UUID_NONE,
-		.raw_binary	= false,
-		.csi		= NVME_CSI_NVM,
-		.ot		= false,
-		.xfer_len	= 4096,
+	const char *desc = "Decode the log and identify captures of a directory tree, of an\n"
+		"uncompressed tar archive, of a capture bundle written by collect --bundle\n"
+		"or a single capture on several threads,\n"
+		"printing one JSON record for each, one a line unless -o json.\n"
+		"The type of a capture is told by the name of its file, e.g.\n"
+		"nvme0-smart-log.bin as written by collect, unless --type is given.";
+	const char *type = "type of all the captures, e.g. smart-log or id-ctrl";
+	const char *jobs = "number of captures decoded in parallel, 0 for one per CPU";
+
+	struct nvme_archive_cfg cfg = {
+		.path	= NULL,
+		.type	= NULL,
+		.jobs	= 0,
 	};
+	enum nvme_print_flags flags;
+	int err;
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
-		  OPT_BYTE("log-id",       'i', &cfg.log_id,       log_id),
-		  OPT_UINT("log-len",      'l', &cfg.log_len,      log_len),
-		  OPT_UINT("aen",          'a', &cfg.aen,          aen),
-		  OPT_SUFFIX("lpo",        'L', &cfg.lpo,          lpo),
-		  OPT_BYTE("lsp",          's', &cfg.lsp,          lsp),
-		  OPT_SHRT("lsi",          'S', &cfg.lsi,          lsi),
-		  OPT_FLAG("rae",          'r', &cfg.rae,          rae),
-		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,   uuid_index),
-		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
-		  OPT_BYTE("csi",          'y', &cfg.csi,          csi),
-		  OPT_FLAG("ot",           'O', &cfg.ot,           offset_type),
-		  OPT_UINT("xfer-len",     'x', &cfg.xfer_len,     xfer_len));
+		  OPT_STRING("type", 't', "TYPE", &cfg.type, type),
+		  OPT_UINT("jobs",   'j', &cfg.jobs,         jobs));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.aen) {
-		cfg.log_len = 4096;
-		cfg.log_id = (cfg.aen >> 16) & 0xff;
-	}
-
-	if (!cfg.log_len || cfg.log_len & 0x3) {
-		nvme_show_error("non-zero or non-dw alignment log-len is required param");
-		return -EINVAL;
-	}
-
-	if (cfg.lsp > 127) {
-		nvme_show_error("invalid lsp param");
-		return -EINVAL;
-	}
-
-	if (cfg.uuid_index > 127) {
-		nvme_show_error("invalid uuid index param");
+	if (optind >= argc) {
+		nvme_show_error("a directory or an archive is required");
+		argconfig_print_help(desc, opts);
 		return -EINVAL;
 	}
+	cfg.path = argv[optind];
 
-	if (cfg.xfer_len == 0 || cfg.xfer_len % 4096) {
-		nvme_show_error("xfer-len argument invalid. It needs to be multiple of 4k");
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
 		return -EINVAL;
 	}
 
-	log = nvme_alloc(cfg.log_len);
-	if (!log)
-		return -ENOMEM;
+#ifdef CONFIG_JSONC
+	/* the records are always JSON, one a line for the text formats */
+	if (flags == NORMAL || json_get_output_mode() == JSON_OUTPUT_NDJSON)
+		json_set_output_mode(JSON_OUTPUT_COMPACT);
 
-	struct nvme_get_log_args args = {
-		.args_size	= sizeof(args),
-		.lid		= cfg.log_id,
-		.nsid		= cfg.namespace_id,
-		.lpo		= cfg.lpo,
-		.lsp		= cfg.lsp,
-		.lsi		= cfg.lsi,
-		.rae		= cfg.rae,
-		.uuidx		= cfg.uuid_index,
-		.csi		= cfg.csi,
-		.ot		= cfg.ot,
-		.len		= cfg.log_len,
-		.log		= log,
-		.result		= NULL,
-	};
-	err = nvme_cli_get_log_page(dev, cfg.xfer_len, &args);
-	if (!err) {
-		if (!cfg.raw_binary) {
-			printf("Device:%s log-id:%d namespace-id:%#x\n", dev->name, cfg.log_id,
-			       cfg.namespace_id);
-			d(log, cfg.log_len, 16, 1);
-		} else {
-			d_raw((unsigned char *)log, cfg.log_len);
-		}
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_error("log page: %s", nvme_strerror(errno));
-	}
+	err = nvme_decode_archive(&cfg);
+	if (err)
+		nvme_show_error("decode-archive: %s", nvme_strerror(-err));
 
 	return err;
+#else
+	nvme_show_error("decode-archive: built without json-c support");
+	return -ENOTSUP;
+#endif
 }
 
-static int sanitize_log(int argc, char **argv, struct command *command, struct plugin *plugin)
-{
-	const char *desc = "Retrieve sanitize log and show it.";
+/* Upper bound for the logs of one batch fetched concurrently */
+#define LOG_BATCH_JOBS	8
 
-	_cleanup_free_ struct nvme_sanitize_log_page *sanitize_log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
+struct log_batch_job {
+	struct nvme_dev *dev;
+	struct nvme_log_batch_entry *e;
+	int (*fetch)(struct nvme_dev *dev, __u16 id, void *log);
+};
+
+static void log_batch_fetch(void *arg)
+{
+	struct log_batch_job *job = arg;
 	int err;
 
-	struct config {
-		bool	rae;
-		bool	human_readable;
-		bool	raw_binary;
-	};
+	err = job->fetch(job->dev, job->e->id, job->e->log);
+	/* libnvme reports transport failures as -1 with errno set */
+	job->e->err = err == -1 ? -errno : err;
+}
 
-	struct config cfg = {
-		.rae		= false,
-		.human_readable	= false,
-		.raw_binary	= false,
-	};
+/*
+ * Fetch the log of every entry, @size bytes each. The ioctls of a direct
+ * device may run concurrently, other transports are used one command
+ * at a time.
+ */
+static int log_batch(struct nvme_dev *dev, struct nvme_log_batch_entry *e, int nr,
+		     size_t size, int (*fetch)(struct nvme_dev *dev, __u16 id, void *log))
+{
+	_cleanup_free_ struct log_batch_job *job = NULL;
+	struct nvme_thread_pool *pool = NULL;
+	int i;
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("rae",            'r', &cfg.rae,            rae),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_log));
+	job = calloc(nr, sizeof(*job));
+	if (!job)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	for (i = 0; i < nr; i++) {
+		e[i].log = nvme_alloc(size);
+		if (!e[i].log)
+			return -ENOMEM;
+		job[i].dev = dev;
+		job[i].e = &e[i];
+		job[i].fetch = fetch;
+	}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (nr > 1 && cmd_concurrent(dev, true, nvme_admin_get_log_page))
+		pool = nvme_thread_pool_create(min(nr, LOG_BATCH_JOBS));
+
+	for (i = 0; i < nr; i++) {
+		if (!pool || nvme_thread_pool_queue(pool, log_batch_fetch, &job[i]))
+			log_batch_fetch(&job[i]);
 	}
+	if (pool)
+		nvme_thread_pool_destroy(pool);
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	return 0;
+}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+static void log_batch_free(struct nvme_log_batch_entry *e, int nr)
+{
+	int i;
 
-	sanitize_log = nvme_alloc(sizeof(*sanitize_log));
-	if (!sanitize_log)
+	for (i = 0; e && i < nr; i++)
+		free(e[i].log);
+	free(e);
+}
+
+/* The Identify lists return the identifiers from @start on, page by page */
+static int endgrp_ids(struct nvme_dev *dev, struct nvme_log_batch_entry **e, int *nr)
+{
+	_cleanup_free_ struct nvme_id_endurance_group_list *list = NULL;
+	struct nvme_log_batch_entry *tmp;
+	__u16 start = 0, num;
+	int i, err;
+
+	list = nvme_alloc(sizeof(*list));
+	if (!list)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_sanitize(dev, cfg.rae, sanitize_log);
-	if (!err)
-		nvme_show_sanitize_log(sanitize_log, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("sanitize status log: %s", nvme_strerror(errno));
+	do {
+		err = nvme_identify_endurance_group_list(dev_fd(dev), start, list);
+		if (err)
+			return err;
 
-	return err;
+		num = min(le16_to_cpu(list->num), NVME_ID_ENDURANCE_GROUP_LIST_MAX);
+		tmp = realloc(*e, (*nr + num) * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		*e = tmp;
+		for (i = 0; i < num; i++, (*nr)++) {
+			memset(&tmp[*nr], 0, sizeof(tmp[*nr]));
+			tmp[*nr].id = le16_to_cpu(list->identifier[i]);
+		}
+		start = num ? tmp[*nr - 1].id + 1 : 0;
+	} while (num == NVME_ID_ENDURANCE_GROUP_LIST_MAX && start);
+
+	return 0;
 }
 
-static int get_fid_support_effects_log(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static int nvmset_ids(struct nvme_dev *dev, struct nvme_log_batch_entry **e, int *nr)
 {
-	const char *desc = "Retrieve FID Support and Effects log and show it.";
+	_cleanup_free_ struct nvme_id_nvmset_list *list = NULL;
+	struct nvme_log_batch_entry *tmp;
+	__u16 start = 0;
+	__u8 num;
+	int i, err;
+
+	list = nvme_alloc(sizeof(*list));
+	if (!list)
+		return -ENOMEM;
 
-	_cleanup_free_ struct nvme_fid_supported_effects_log *fid_support_log = NULL;
+	do {
+		err = nvme_identify_nvmset_list(dev_fd(dev), start, list);
+		if (err)
+			return err;
+
+		num = min(list->nid, NVME_ID_NVMSET_LIST_MAX);
+		tmp = realloc(*e, (*nr + num) * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		*e = tmp;
+		for (i = 0; i < num; i++, (*nr)++) {
+			memset(&tmp[*nr], 0, sizeof(tmp[*nr]));
+			tmp[*nr].id = le16_to_cpu(list->ent[i].nvmsetid);
+		}
+		start = num ? tmp[*nr - 1].id + 1 : 0;
+	} while (num == NVME_ID_NVMSET_LIST_MAX && start);
+
+	return 0;
+}
+
+static int endurance_log_fetch(struct nvme_dev *dev, __u16 id, void *log)
+{
+	return nvme_cli_get_log_endurance_group(dev, id, log);
+}
+
+static int pred_lat_nvmset_fetch(struct nvme_dev *dev, __u16 id, void *log)
+{
+	return nvme_cli_get_log_predictable_lat_nvmset(dev, id, log);
+}
+
+/* Returns the first error of the batch */
+static int log_batch_err(struct nvme_log_batch_entry *e, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		if (e[i].err)
+			return e[i].err;
+
+	return 0;
+}
+
+static int get_endurance_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieves endurance groups log page and prints the log.";
+	const char *group_id = "The endurance group identifier";
+	const char *all = "retrieve the log of every endurance group";
+
+	_cleanup_free_ struct nvme_endurance_group_log *endurance_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_log_batch_entry *e = NULL;
 	enum nvme_print_flags flags;
-	int err = -1;
+	int nr = 0, err;
 
 	struct config {
-		bool	human_readable;
+		__u16	group_id;
+		bool	all;
 	};
 
 	struct config cfg = {
-		.human_readable	= false,
+		.group_id	= 0,
+		.all		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log));
+		  OPT_SHRT("group-id",     'g', &cfg.group_id,      group_id),
+		  OPT_FLAG("all",          'a', &cfg.all,           all));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -2453,44 +3877,91 @@ static int get_fid_support_effects_log(int argc, char **argv, struct command *cm
 		return err;
 	}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	if (cfg.all) {
+		err = endgrp_ids(dev, &e, &nr);
+		if (!err)
+			err = log_batch(dev, e, nr, sizeof(*endurance_log),
+					endurance_log_fetch);
+		if (!err) {
+			nvme_show_endurance_log_batch(e, nr, dev->name, flags);
+			err = log_batch_err(e, nr);
+		} else if (err > 0) {
+			nvme_show_status(err);
+		} else {
+			nvme_show_error("endurance group list: %s",
+					nvme_strerror(err == -1 ? errno : -err));
+		}
+		log_batch_free(e, nr);
+		return err;
+	}
 
-	fid_support_log = nvme_alloc(sizeof(*fid_support_log));
-	if (!fid_support_log)
+	endurance_log = nvme_alloc(sizeof(*endurance_log));
+	if (!endurance_log)
 		return -ENOMEM;
 
-	err = nvme_cli_get_log_fid_supported_effects(dev, false, fid_support_log);
+	err = nvme_cli_get_log_endurance_group(dev, cfg.group_id,
+					       endurance_log);
 	if (!err)
-		nvme_show_fid_support_effects_log(fid_support_log, dev->name, flags);
+		nvme_show_endurance_log(endurance_log, cfg.group_id,
+					dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("fid support effects log: %s", nvme_strerror(errno));
+		nvme_show_error("endurance log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int get_mi_cmd_support_effects_log(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static int collect_effects_log(struct nvme_dev *dev, enum nvme_csi csi,
+			       struct list_head *list, int flags)
 {
-	const char *desc = "Retrieve NVMe-MI Command Support and Effects log and show it.";
+	nvme_effects_log_node_t *node;
+	int err;
+
+	node = nvme_alloc(sizeof(*node));
+	if (!node)
+		return -ENOMEM;
+
+	node->csi = csi;
+
+	err = nvme_cli_get_log_cmd_effects(dev, csi, &node->effects);
+	if (err) {
+		free(node);
+		return err;
+	}
+	list_add(list, &node->node);
+	return 0;
+}
+
+static int get_effects_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve command effects log page and print the table.";
 
-	_cleanup_free_ struct nvme_mi_cmd_supported_effects_log *mi_cmd_support_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
+	struct list_head log_pages;
+	nvme_effects_log_node_t *node;
+
+	void *bar = NULL;
+
 	int err = -1;
+	enum nvme_print_flags flags;
 
 	struct config {
 		bool	human_readable;
+		bool	raw_binary;
+		int	csi;
 	};
 
 	struct config cfg = {
 		.human_readable	= false,
+		.raw_binary	= false,
+		.csi		= -1,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log));
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_log),
+		  OPT_INT("csi",             'c', &cfg.csi,            csi));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -2502,48 +3973,71 @@ static int get_mi_cmd_support_effects_log(int argc, char **argv, struct command
 		return err;
 	}
 
+	if (cfg.raw_binary)
+		flags = BINARY;
+
 	if (cfg.human_readable)
 		flags |= VERBOSE;
 
-	mi_cmd_support_log = nvme_alloc(sizeof(*mi_cmd_support_log));
-	if (!mi_cmd_support_log)
-		return -ENOMEM;
+	list_head_init(&log_pages);
+
+	if (cfg.csi < 0) {
+		__u64 cap;
+
+		bar = mmap_registers(dev, false);
+
+		if (bar) {
+			cap = mmio_read64(bar + NVME_REG_CAP);
+			munmap(bar, getpagesize());
+		} else {
+			struct nvme_get_property_args args = {
+				.args_size	= sizeof(args),
+				.fd		= dev_fd(dev),
+				.offset		= NVME_REG_CAP,
+				.value		= &cap,
+				.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			};
+			err = nvme_get_property(&args);
+			if (err)
+				goto cleanup_list;
+		}
+
+		if (NVME_CAP_CSS(cap) & NVME_CAP_CSS_NVM)
+			err = collect_effects_log(dev, NVME_CSI_NVM,
+						  &log_pages, flags);
+
+		if (!err && (NVME_CAP_CSS(cap) & NVME_CAP_CSS_CSI))
+			err = collect_effects_log(dev, NVME_CSI_ZNS,
+						  &log_pages, flags);
+	} else {
+		err = collect_effects_log(dev, cfg.csi, &log_pages, flags);
+	}
 
-	err = nvme_cli_get_log_mi_cmd_supported_effects(dev, false, mi_cmd_support_log);
 	if (!err)
-		nvme_show_mi_cmd_support_effects_log(mi_cmd_support_log, dev->name, flags);
+		nvme_print_effects_log_pages(&log_pages, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("mi command support effects log: %s", nvme_strerror(errno));
+		nvme_show_perror("effects log page");
+
+cleanup_list:
+	while ((node = list_pop(&log_pages, nvme_effects_log_node_t, node)))
+		free(node);
 
 	return err;
 }
 
-static int list_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_supported_log_pages(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
 {
-	const char *desc = "Show controller list information for the subsystem the "
-		"given device is part of, or optionally controllers attached to a specific namespace.";
-	const char *controller = "controller to display";
+	const char *desc = "Retrieve supported logs and print the table.";
 
-	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
+	_cleanup_free_ struct nvme_supported_log_pages *supports = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	enum nvme_print_flags flags;
-	int err;
-
-	struct config {
-		__u16	cntid;
-		__u32	namespace_id;
-	};
-
-	struct config cfg = {
-		.cntid		= 0,
-		.namespace_id	= NVME_NSID_NONE,
-	};
+	int err = -1;
 
-	NVME_ARGS(opts,
-		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id_optional));
+	NVME_ARGS(opts);
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -2555,126 +4049,168 @@ static int list_ctrl(int argc, char **argv, struct command *cmd, struct plugin *
 		return err;
 	}
 
-	cntlist = nvme_alloc(sizeof(*cntlist));
-	if (!cntlist)
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	supports = nvme_alloc(sizeof(*supports));
+	if (!supports)
 		return -ENOMEM;
 
-	if (cfg.namespace_id == NVME_NSID_NONE)
-		err = nvme_cli_identify_ctrl_list(dev, cfg.cntid, cntlist);
-	else
-		err = nvme_cli_identify_nsid_ctrl_list(dev, cfg.namespace_id,
-							cfg.cntid, cntlist);
+	err = nvme_cli_get_log_supported_log_pages(dev, false, supports);
 	if (!err)
-		nvme_show_list_ctrl(cntlist, flags);
+		nvme_show_supported_log(supports, dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("id controller list: %s", nvme_strerror(errno));
+		nvme_show_error("supported log pages: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int list_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * Read the error log entries with an error count above @since. Entry 0
+ * holds the newest error, so its count tells how many entries are new and
+ * only those are read, the rest of the log is left alone. @max bounds the
+ * entries read; @nr is set to the number of new entries, which is larger
+ * than @max if some were already overwritten.
+ */
+static int error_log_read_new(struct nvme_dev *dev, __u64 since, __u32 max,
+			      struct nvme_error_log_page *err_log, __u64 *nr)
 {
-	const char *desc = "For the specified controller handle, show the "
-		"namespace list in the associated NVMe subsystem, optionally starting with a given nsid.";
-	const char *namespace_id = "first nsid returned list should start from";
-	const char *csi = "I/O command set identifier";
-	const char *all = "show all namespaces in the subsystem, whether attached or inactive";
-
-	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
-
-	struct config {
-		__u32	namespace_id;
-		int	csi;
-		bool	all;
-	};
-
-	struct config cfg = {
-		.namespace_id	= 1,
-		.csi		= -1,
-		.all		= false,
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_ERROR,
+		.nsid		= NVME_NSID_ALL,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.lpo		= 0,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= sizeof(*err_log),
+		.log		= err_log,
+		.result		= NULL,
 	};
+	__u64 count, n;
+	int err;
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
-		  OPT_INT("csi",           'y', &cfg.csi,           csi),
-		  OPT_FLAG("all",          'a', &cfg.all,           all));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = nvme_cli_get_log_page(dev, args.len, &args);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("Invalid output format");
-		return -EINVAL;
+	count = le64_to_cpu(err_log[0].error_count);
+	if (count == since) {
+		*nr = 0;
+		return 0;
 	}
+	/* a smaller count means the counter wrapped or was reset */
+	*nr = count > since ? count - since : count;
 
-	if (!cfg.namespace_id) {
-		nvme_show_error("invalid nsid parameter");
-		return -EINVAL;
-	}
+	n = min(*nr, (__u64)max);
+	if (n <= 1)
+		return 0;
 
-	ns_list = nvme_alloc(sizeof(*ns_list));
-	if (!ns_list)
+	args.lpo = sizeof(*err_log);
+	args.len = (n - 1) * sizeof(*err_log);
+	args.log = &err_log[1];
+	return nvme_cli_get_log_page(dev, args.len, &args);
+}
+
+static int error_log_follow(struct nvme_dev *dev, __u64 since, __u32 max,
+			    __u32 interval, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_error_log_page *err_log = NULL;
+	__u64 next, nr;
+	int err;
+
+	err_log = nvme_alloc(max * sizeof(*err_log));
+	if (!err_log)
 		return -ENOMEM;
 
-	struct nvme_identify_args args = {
-		.args_size	= sizeof(args),
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.data		= ns_list,
-		.nsid		= cfg.namespace_id - 1.
-	};
-	if (cfg.csi < 0) {
-		args.cns = cfg.all ? NVME_IDENTIFY_CNS_ALLOCATED_NS_LIST :
-			NVME_IDENTIFY_CNS_NS_ACTIVE_LIST;
-	} else {
-		args.cns = cfg.all ? NVME_IDENTIFY_CNS_CSI_ALLOCATED_NS_LIST :
-			NVME_IDENTIFY_CNS_CSI_NS_ACTIVE_LIST;
-		args.csi = cfg.csi;
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	while (true) {
+		err = error_log_read_new(dev, since, max, err_log, &nr);
+		if (err)
+			break;
+
+		if (nr) {
+			if (nr > max)
+				fprintf(stderr, "%"PRIu64" error log entries lost\n",
+					(uint64_t)(nr - max));
+			nvme_show_error_log(err_log, min(nr, (__u64)max),
+					    dev->name, flags);
+			fflush(stdout);
+			since = le64_to_cpu(err_log[0].error_count);
+		}
+
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
 	}
 
-	err = nvme_cli_identify(dev, &args);
-	if (!err)
-		nvme_show_list_ns(ns_list, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("id namespace list: %s", nvme_strerror(errno));
+	nvme_stop_release();
 
 	return err;
 }
 
-static int id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* all the entries of a capture, however many the controller had */
+static int error_log_show_capture(void *data, size_t len, const char *file, void *arg)
 {
-	const char *desc = "Send an Identify Namespace command to the given "
-		"device, returns capability field properties of the specified "
-		"LBA Format index in  various formats.";
+	struct capture_args *c = arg;
+
+	nvme_show_error_log(data, len / sizeof(struct nvme_error_log_page), file, c->flags);
+	return 0;
+}
+
+static int get_error_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve specified number of "
+		"error log entries from a given device "
+		"in either decoded format (default) or binary.";
+	const char *log_entries = "number of entries to retrieve";
+	const char *raw = "dump in binary format";
+	const char *since_count = "only retrieve entries with an error count above this";
+	const char *follow = "keep polling the log and print only new entries";
+	const char *interval = "seconds between polls in follow mode";
+	const char *input = "comma separated error log captures to decode";
 
+	_cleanup_free_ struct nvme_error_log_page *err_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct nvme_id_ctrl ctrl;
 	enum nvme_print_flags flags;
+	bool since;
+	__u64 nr;
 	int err = -1;
 
 	struct config {
-		__u16	lba_format_index;
-		__u8	uuid_index;
+		__u32	log_entries;
+		bool	raw_binary;
+		__u64	since_count;
+		bool	follow;
+		__u32	interval;
+		char	*input_file;
 	};
 
 	struct config cfg = {
-		.lba_format_index	= 0,
-		.uuid_index		= NVME_UUID_NONE,
+		.log_entries	= 64,
+		.raw_binary	= false,
+		.since_count	= 0,
+		.follow		= false,
+		.interval	= 1,
+		.input_file	= NULL,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
-		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
+		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw),
+		  OPT_LONG("since-count",  's', &cfg.since_count,   since_count),
+		  OPT_FLAG("follow",       'f', &cfg.follow,        follow),
+		  OPT_UINT("interval",     'i', &cfg.interval,      interval),
+		  OPT_LIST("input-file",     0, &cfg.input_file,    input));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
 	if (err)
 		return err;
 
@@ -2684,913 +4220,1485 @@ static int id_ns_lba_format(int argc, char **argv, struct command *cmd, struct p
 		return err;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	if (cfg.input_file) {
+		struct capture_args c = { .flags = flags };
+
+		return nvme_decode_captures(cfg.input_file, sizeof(*err_log), true,
+					    "an error log", error_log_show_capture, &c);
+	}
+
+	if (!cfg.log_entries) {
+		nvme_show_error("non-zero log-entries is required param");
+		return -1;
+	}
+
+	err = nvme_cli_identify_ctrl(dev, &ctrl);
+	if (err < 0) {
+		nvme_show_perror("identify controller");
+		return err;
+	} else if (err) {
+		nvme_show_error("could not identify controller");
+		return err;
+	}
+
+	cfg.log_entries = min(cfg.log_entries, ctrl.elpe + 1);
+
+	if (cfg.follow) {
+		if (!cfg.interval || flags == BINARY) {
+			nvme_show_error("follow mode needs an interval and a text or json format");
+			return -EINVAL;
+		}
+		err = error_log_follow(dev, cfg.since_count, cfg.log_entries,
+				       cfg.interval, flags);
+		goto err;
+	}
+
+	err_log = nvme_alloc(cfg.log_entries * sizeof(struct nvme_error_log_page));
+	if (!err_log)
 		return -ENOMEM;
 
-	err = nvme_identify_ns_csi_user_data_format(dev_fd(dev),
-						    cfg.lba_format_index,
-						    cfg.uuid_index, NVME_CSI_NVM, ns);
-	if (!err)
-		nvme_show_id_ns(ns, 0, cfg.lba_format_index, true, flags);
-	else if (err > 0)
-		nvme_show_status(err);
+	since = argconfig_parse_seen(opts, "since-count");
+	if (since)
+		err = error_log_read_new(dev, cfg.since_count, cfg.log_entries,
+					 err_log, &nr);
 	else
-		nvme_show_perror("identify namespace for specific LBA format");
+		err = nvme_cli_get_log_error(dev, cfg.log_entries, false, err_log);
+	if (!err && since && nr < cfg.log_entries)
+		cfg.log_entries = nr;
+	if (!err) {
+		nvme_show_error_log(err_log, cfg.log_entries,
+				    dev->name, flags);
+		return 0;
+	}
+err:
+	if (err > 0)
+		nvme_show_status(err);
+	else if (err < 0)
+		nvme_show_perror("error log");
 
 	return err;
 }
 
-static int id_endurance_grp_list(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
-{
-	const char *desc = "Show endurance group list information for the given endurance group id";
-	const char *endurance_grp_id = "Endurance Group ID";
+/* per controller state of monitor-events */
+struct monitor_ctrl {
+	struct monitor_ctrl *next;
+	char path[PATH_MAX];
+	struct nvme_dev *dev;
+	struct nvme_id_ctrl *id;
+	__u64 err_count;	/* error count of the newest entry printed */
+	bool err_seen;
+};
 
-	_cleanup_free_ struct nvme_id_endurance_group_list *endgrp_list = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+struct monitor_events {
+	struct monitor_ctrl *ctrls;
 	enum nvme_print_flags flags;
-	int err = -1;
+};
 
-	struct config {
-		__u16	endgrp_id;
-	};
+static struct monitor_ctrl *monitor_ctrl_get(struct monitor_events *m,
+					     const char *name)
+{
+	struct monitor_ctrl *mc;
 
-	struct config cfg = {
-		.endgrp_id	= 0,
-	};
+	for (mc = m->ctrls; mc; mc = mc->next)
+		if (!strcmp(basename(mc->path), name))
+			break;
+	if (!mc) {
+		mc = calloc(1, sizeof(*mc));
+		if (!mc)
+			return NULL;
+		snprintf(mc->path, sizeof(mc->path), "/dev/%s", name);
+		mc->next = m->ctrls;
+		m->ctrls = mc;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_SHRT("endgrp-id",    'i', &cfg.endgrp_id,     endurance_grp_id));
+	/* reopen after a reset or reconnect made the old fd fail */
+	if (!mc->dev && open_dev_direct(&mc->dev, mc->path, O_RDONLY))
+		return NULL;
+	if (!mc->id) {
+		mc->id = nvme_alloc(sizeof(*mc->id));
+		if (!mc->id)
+			return NULL;
+		if (nvme_cli_identify_ctrl(mc->dev, mc->id)) {
+			free(mc->id);
+			mc->id = NULL;
+			return NULL;
+		}
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	return mc;
+}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("invalid output format");
-		return -EINVAL;
-	}
+static int monitor_error_log(struct monitor_ctrl *mc, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_error_log_page *err_log = NULL;
+	__u32 max = mc->id->elpe + 1;
+	__u64 nr;
+	int err;
 
-	endgrp_list = nvme_alloc(sizeof(*endgrp_list));
-	if (!endgrp_list)
+	err_log = nvme_alloc(max * sizeof(*err_log));
+	if (!err_log)
 		return -ENOMEM;
 
-	err = nvme_identify_endurance_group_list(dev_fd(dev), cfg.endgrp_id, endgrp_list);
-	if (!err)
-		nvme_show_endurance_group_list(endgrp_list, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("Id endurance group list: %s", nvme_strerror(errno));
+	/* only the newest entry the first time, the earlier ones are history */
+	err = error_log_read_new(mc->dev, mc->err_count, mc->err_seen ? max : 1,
+				 err_log, &nr);
+	if (err || !nr)
+		return err;
 
-	return err;
+	nvme_show_error_log(err_log, min(nr, mc->err_seen ? (__u64)max : 1),
+			    mc->dev->name, flags);
+	mc->err_count = le64_to_cpu(err_log[0].error_count);
+	mc->err_seen = true;
+
+	return 0;
 }
 
-static int delete_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int monitor_ana_log(struct monitor_ctrl *mc, enum nvme_print_flags flags)
 {
-	const char *desc = "Delete the given namespace by "
-		"sending a namespace management command to "
-		"the provided device. All controllers should be detached from "
-		"the namespace prior to namespace deletion. A namespace ID "
-		"becomes inactive when that namespace is detached or, if "
-		"the namespace is not already inactive, once deleted.";
-	const char *namespace_id = "namespace to delete";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *ana_log = NULL;
+	size_t len;
 	int err;
 
-	struct config {
-		__u32	namespace_id;
-		__u32	timeout;
-	};
-
-	struct config cfg = {
-		.namespace_id	= 0,
-		.timeout	= 120000,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
-		  OPT_UINT("timeout",      't', &cfg.timeout,      timeout));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	len = sizeof(struct nvme_ana_log) +
+		le32_to_cpu(mc->id->nanagrpid) * sizeof(struct nvme_ana_group_desc);
+	if (!(mc->id->anacap & (1 << 6)))
+		len += le32_to_cpu(mc->id->mnan) * sizeof(__le32);
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
-	}
+	ana_log = nvme_alloc(len);
+	if (!ana_log)
+		return -ENOMEM;
 
-	err = nvme_cli_ns_mgmt_delete(dev, cfg.namespace_id);
+	err = nvme_cli_get_log_ana(mc->dev, NVME_LOG_ANA_LSP_RGO_NAMESPACES, false,
+				   0, len, ana_log);
 	if (!err)
-		printf("%s: Success, deleted nsid:%d\n", cmd->name, cfg.namespace_id);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("delete namespace: %s", nvme_strerror(errno));
+		nvme_show_ana_log(ana_log, mc->dev->name, len, flags);
 
 	return err;
 }
 
-static int nvme_attach_ns(int argc, char **argv, int attach, const char *desc, struct command *cmd)
+/*
+ * Read the log page the event names. The read is done with RAE cleared,
+ * which lets the controller report further events of the same type.
+ */
+static int monitor_fetch(struct monitor_ctrl *mc, __u8 lid,
+			 enum nvme_print_flags flags)
 {
-	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
-	_cleanup_free_ __u16 *ctrlist = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err, num, i, list[2048];
+	/* events come in bursts, the buffers are reused from the pool */
+	_cleanup_buf_ struct nvme_buf buf = { 0 };
+	void *log;
+	int err;
 
-	const char *namespace_id = "namespace to attach";
-	const char *cont = "optional comma-sep controller id list";
+	switch (lid) {
+	case NVME_LOG_LID_ERROR:
+		return monitor_error_log(mc, flags);
+	case NVME_LOG_LID_ANA:
+		return monitor_ana_log(mc, flags);
+	case NVME_LOG_LID_SMART:
+		log = nvme_buf_get(&buf, sizeof(struct nvme_smart_log));
+		if (!log)
+			return -ENOMEM;
+		err = nvme_cli_get_log_smart(mc->dev, NVME_NSID_ALL, false, log);
+		if (!err)
+			nvme_show_smart_log(log, NVME_NSID_ALL, mc->dev->name, flags);
+		return err;
+	case NVME_LOG_LID_FW_SLOT:
+		log = nvme_buf_get(&buf, sizeof(struct nvme_firmware_slot));
+		if (!log)
+			return -ENOMEM;
+		err = nvme_cli_get_log_fw_slot(mc->dev, false, log);
+		if (!err)
+			nvme_show_fw_log(log, mc->dev->name, flags);
+		return err;
+	case NVME_LOG_LID_CHANGED_NS:
+		log = nvme_buf_get(&buf, sizeof(struct nvme_ns_list));
+		if (!log)
+			return -ENOMEM;
+		err = nvme_cli_get_log_changed_ns_list(mc->dev, false, log);
+		if (!err)
+			nvme_show_changed_ns_list_log(log, mc->dev->name, flags);
+		return err;
+	case NVME_LOG_LID_SANITIZE:
+		log = nvme_buf_get(&buf, sizeof(struct nvme_sanitize_log_page));
+		if (!log)
+			return -ENOMEM;
+		err = nvme_cli_get_log_sanitize(mc->dev, false, log);
+		if (!err)
+			nvme_show_sanitize_log(log, mc->dev->name, flags);
+		return err;
+	default:
+		/* reported, but not worth a possibly large transfer */
+		return 0;
+	}
+}
 
-	struct config {
-		__u32	namespace_id;
-		char	*cntlist;
-	};
+static void monitor_report(struct monitor_ctrl *mc, __u8 lid,
+			   enum nvme_print_flags flags)
+{
+	int err = monitor_fetch(mc, lid, flags);
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.cntlist	= "",
-	};
+	/* the commands fail with -1 and errno, the allocations with -ENOMEM */
+	if (err == -1)
+		err = -errno;
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
-		  OPT_LIST("controllers",  'c', &cfg.cntlist,      cont));
+	if (err > 0) {
+		nvme_show_status(err);
+	} else if (err < 0) {
+		nvme_show_error("%s: log page %#04x: %s", mc->dev->name, lid,
+				nvme_strerror(-err));
+		dev_close(mc->dev);
+		mc->dev = NULL;
+	}
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+static void monitor_event(const struct nvme_watch_aen *aen, void *data)
+{
+	struct monitor_events *m = data;
+	struct monitor_ctrl *mc;
 
-	if (!cfg.namespace_id) {
-		nvme_show_error("%s: namespace-id parameter required", cmd->name);
-		return -EINVAL;
+	/*
+	 * Events got lost: the logs of the events that are usually enabled
+	 * are read, so the controller reports them again.
+	 */
+	if (!aen) {
+		nvme_show_error("monitor-events: uevents lost");
+		for (mc = m->ctrls; mc; mc = mc->next) {
+			if (!monitor_ctrl_get(m, basename(mc->path)))
+				continue;
+			monitor_report(mc, NVME_LOG_LID_SMART, m->flags);
+			monitor_report(mc, NVME_LOG_LID_ERROR, m->flags);
+		}
+		return;
 	}
 
-	num = argconfig_parse_comma_sep_array(cfg.cntlist, list, 2047);
-	if (!num)
-		fprintf(stderr, "warning: empty controller-id list will result in no actual change in namespace attachment\n");
+	nvme_show_aen_event(aen, m->flags);
 
-	if (num == -1) {
-		nvme_show_error("%s: controller id list is malformed", cmd->name);
-		return -EINVAL;
+	mc = monitor_ctrl_get(m, aen->ctrl);
+	if (!mc) {
+		nvme_show_perror(aen->ctrl);
+		return;
 	}
+	monitor_report(mc, aen->lid, m->flags);
+}
 
-	cntlist = nvme_alloc(sizeof(*cntlist));
-	if (!cntlist)
-		return -ENOMEM;
+static int monitor_events(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Wait for asynchronous events the driver reports with\n"
+		"uevents and read only the log page an event refers to, which\n"
+		"also re-enables the event on the controller.";
 
-	ctrlist = nvme_alloc(sizeof(*ctrlist) * 2048);
-	if (!ctrlist)
-		return -ENOMEM;
+	struct monitor_events m = { .ctrls = NULL };
+	struct monitor_ctrl *mc;
+	int err;
 
-	for (i = 0; i < num; i++)
-		ctrlist[i] = (__u16)list[i];
+	NVME_ARGS(opts);
 
-	nvme_init_ctrl_list(cntlist, num, ctrlist);
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
 
-	if (attach)
-		err = nvme_cli_ns_attach_ctrls(dev, cfg.namespace_id,
-					       cntlist);
-	else
-		err = nvme_cli_ns_detach_ctrls(dev, cfg.namespace_id,
-					       cntlist);
+	err = validate_output_format(output_format_val, &m.flags);
+	if (err < 0 || m.flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
 
-	if (!err)
-		printf("%s: Success, nsid:%d\n", cmd->name, cfg.namespace_id);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_perror(attach ? "attach namespace" : "detach namespace");
+	nvme_stop_catch(true, nvme_watch_stop);
+
+	err = nvme_watch_aen(monitor_event, &m);
+	if (err)
+		nvme_show_error("monitor-events: %s", nvme_strerror(-err));
+
+	nvme_stop_release();
+
+	while ((mc = m.ctrls)) {
+		m.ctrls = mc->next;
+		if (mc->dev)
+			dev_close(mc->dev);
+		free(mc->id);
+		free(mc);
+	}
 
 	return err;
 }
 
-static int attach_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int fw_log_show_capture(void *data, size_t len, const char *file, void *arg)
 {
-	const char *desc = "Attach the given namespace to the "
-		"given controller or comma-sep list of controllers. ID of the "
-		"given namespace becomes active upon attachment to a "
-		"controller. A namespace must be attached to a controller "
-		"before IO commands may be directed to that namespace.";
+	struct capture_args *c = arg;
 
-	return nvme_attach_ns(argc, argv, 1, desc, cmd);
+	nvme_show_fw_log(data, file, c->flags);
+	return 0;
 }
 
-static int detach_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_fw_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Detach the given namespace from the "
-		"given controller; de-activates the given namespace's ID. A "
-		"namespace must be attached to a controller before IO "
-		"commands may be directed to that namespace.";
+	const char *desc = "Retrieve the firmware log for the "
+		"specified device in either decoded format (default) or binary.";
+	const char *input = "comma separated firmware log captures to decode";
 
-	return nvme_attach_ns(argc, argv, 0, desc, cmd);
-}
+	_cleanup_free_ struct nvme_firmware_slot *fw_log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
 
-static int parse_lba_num_si(struct nvme_dev *dev, const char *opt,
-			    const char *val, __u8 flbas, __u64 *num, __u32 align)
-{
-	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
-	__u32 nsid = 1;
-	unsigned int remainder;
-	char *endptr;
-	int err = -EINVAL;
-	int i;
-	int lbas;
+	struct config {
+		bool	raw_binary;
+		char	*input_file;
+	};
 
-	struct nvme_identify_args args = {
-		.args_size	= sizeof(args),
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.cns		= NVME_IDENTIFY_CNS_NS_ACTIVE_LIST,
-		.nsid		= nsid - 1.
+	struct config cfg = {
+		.raw_binary	= false,
+		.input_file	= NULL,
 	};
 
-	if (!val)
-		return 0;
+	NVME_ARGS(opts,
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use),
+		  OPT_LIST("input-file",   'i', &cfg.input_file,    input));
 
-	if (*num) {
-		nvme_show_error(
-		    "Invalid specification of both %s and its SI argument, please specify only one",
-		    opt);
+	err = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
+	if (err)
 		return err;
-	}
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
-
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err) {
-		if (err < 0)
-			nvme_show_error("identify controller: %s", nvme_strerror(errno));
-		else
-			nvme_show_status(err);
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
 		return err;
 	}
 
-	ns_list = nvme_alloc(sizeof(*ns_list));
-	if (!ns_list)
-		return -ENOMEM;
-	args.data = ns_list;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	if ((ctrl->oacs & 0x8) >> 3)
-		nsid = NVME_NSID_ALL;
-	else {
-		err = nvme_cli_identify(dev, &args);
-		if (err) {
-			if (err < 0)
-				nvme_show_error("identify namespace list: %s",
-						nvme_strerror(errno));
-			else
-				nvme_show_status(err);
-			return err;
-		}
-		nsid = le32_to_cpu(ns_list->ns[0]);
+	if (cfg.input_file) {
+		struct capture_args c = { .flags = flags };
+
+		return nvme_decode_captures(cfg.input_file, sizeof(*fw_log), false,
+					    "a firmware slot log", fw_log_show_capture, &c);
 	}
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	fw_log = nvme_alloc(sizeof(*fw_log));
+	if (!fw_log)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_ns(dev, nsid, ns);
-	if (err) {
-		if (err < 0)
-			nvme_show_error("identify namespace: %s", nvme_strerror(errno));
-		else
-			nvme_show_status(err);
-		return err;
-	}
+	err = nvme_cli_get_log_fw_slot(dev, false, fw_log);
+	if (!err)
+		nvme_show_fw_log(fw_log, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("fw log: %s", nvme_strerror(errno));
 
-	i = flbas & NVME_NS_FLBAS_LOWER_MASK;
-	lbas = (1 << ns->lbaf[i].ds) + ns->lbaf[i].ms;
+	return err;
+}
 
-	if (suffix_si_parse(val, &endptr, (uint64_t *)num)) {
-		nvme_show_error("Expected long suffixed integer argument for '%s-si' but got '%s'!",
-				opt, val);
-		return -errno;
-	}
+static int get_changed_ns_list_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve Changed Namespaces log for the given device "
+		"in either decoded format (default) or binary.";
 
-	if (endptr[0]) {
-		remainder = *num % align;
-		if (remainder)
-			*num += align - remainder;
+	_cleanup_free_ struct nvme_ns_list *changed_ns_list_log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		bool	raw_binary;
+	};
+
+	struct config cfg = {
+		.raw_binary	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_output));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	if (endptr[0] != '\0')
-		*num /= lbas;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	return 0;
-}
+	changed_ns_list_log = nvme_alloc(sizeof(*changed_ns_list_log));
+	if (!changed_ns_list_log)
+		return -ENOMEM;
 
-static int create_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send a namespace management command "
-		"to the specified device to create a namespace with the given "
-		"parameters. The next available namespace ID is used for the "
-		"create operation. Note that create-ns does not attach the "
-		"namespace to a controller, the attach-ns command is needed.";
-	const char *nsze = "size of ns (NSZE)";
-	const char *ncap = "capacity of ns (NCAP)";
-	const char *flbas =
-	    "Formatted LBA size (FLBAS), if entering this value ignore \'block-size\' field";
-	const char *dps = "data protection settings (DPS)";
-	const char *nmic = "multipath and sharing capabilities (NMIC)";
-	const char *anagrpid = "ANA Group Identifier (ANAGRPID)";
-	const char *nvmsetid = "NVM Set Identifier (NVMSETID)";
-	const char *endgid = "Endurance Group Identifier (ENDGID)";
-	const char *csi = "command set identifier (CSI)";
-	const char *lbstm = "logical block storage tag mask (LBSTM)";
-	const char *nphndls = "Number of Placement Handles (NPHNDLS)";
-	const char *bs = "target block size, specify only if \'FLBAS\' value not entered";
-	const char *nsze_si = "size of ns (NSZE) in standard SI units";
-	const char *ncap_si = "capacity of ns (NCAP) in standard SI units";
-	const char *azr = "Allocate ZRWA Resources (AZR) for Zoned Namespace Command Set";
-	const char *rar = "Requested Active Resources (RAR) for Zoned Namespace Command Set";
-	const char *ror = "Requested Open Resources (ROR) for Zoned Namespace Command Set";
-	const char *rnumzrwa =
-	    "Requested Number of ZRWA Resources (RNUMZRWA) for Zoned Namespace Command Set";
-	const char *phndls = "Comma separated list of Placement Handle Associated RUH";
+	err = nvme_cli_get_log_changed_ns_list(dev, true,
+					       changed_ns_list_log);
+	if (!err)
+		nvme_show_changed_ns_list_log(changed_ns_list_log,
+					      dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("changed ns list log: %s", nvme_strerror(errno));
 
-	_cleanup_free_ struct nvme_ns_mgmt_host_sw_specified *data = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	return err;
+}
+
+static int get_pred_lat_per_nvmset_log(int argc, char **argv,
+	struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve Predictable latency per nvm set log "
+		"page and prints it for the given device in either decoded "
+		"format(default),json or binary.";
+	const char *nvmset_id = "NVM Set Identifier";
+	const char *all = "retrieve the log of every NVM set";
+
+	_cleanup_free_ struct nvme_nvmset_predictable_lat_log *plpns_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err = 0, i;
-	__u32 nsid;
-	uint16_t num_phandle;
-	uint16_t phndl[128] = { 0, };
-	_cleanup_free_ struct nvme_id_ctrl *id = NULL;
-	_cleanup_free_ struct nvme_id_ns_granularity_list *gr_list = NULL;
-	__u32 align_nsze = 1 << 20; /* Default 1 MiB */
-	__u32 align_ncap = align_nsze;
+	struct nvme_log_batch_entry *e = NULL;
+	enum nvme_print_flags flags;
+	int nr = 0, err;
 
 	struct config {
-		__u64	nsze;
-		__u64	ncap;
-		__u8	flbas;
-		__u8	dps;
-		__u8	nmic;
-		__u32	anagrpid;
-		__u16	nvmsetid;
-		__u16	endgid;
-		__u64	bs;
-		__u32	timeout;
-		__u8	csi;
-		__u64	lbstm;
-		__u16	nphndls;
-		char	*nsze_si;
-		char	*ncap_si;
-		bool	azr;
-		__u32	rar;
-		__u32	ror;
-		__u32	rnumzrwa;
-		char	*phndls;
+		__u16	nvmset_id;
+		bool	raw_binary;
+		bool	all;
 	};
 
 	struct config cfg = {
-		.nsze		= 0,
-		.ncap		= 0,
-		.flbas		= 0xff,
-		.dps		= 0,
-		.nmic		= 0,
-		.anagrpid	= 0,
-		.nvmsetid	= 0,
-		.endgid		= 0,
-		.bs		= 0x00,
-		.timeout	= 120000,
-		.csi		= 0,
-		.lbstm		= 0,
-		.nphndls	= 0,
-		.nsze_si	= NULL,
-		.ncap_si	= NULL,
-		.azr		= false,
-		.rar		= 0,
-		.ror		= 0,
-		.rnumzrwa	= 0,
-		.phndls		= "",
+		.nvmset_id	= 1,
+		.raw_binary	= false,
+		.all		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SUFFIX("nsze",       's', &cfg.nsze,     nsze),
-		  OPT_SUFFIX("ncap",       'c', &cfg.ncap,     ncap),
-		  OPT_BYTE("flbas",        'f', &cfg.flbas,    flbas),
-		  OPT_BYTE("dps",          'd', &cfg.dps,      dps),
-		  OPT_BYTE("nmic",         'm', &cfg.nmic,     nmic),
-		  OPT_UINT("anagrp-id",    'a', &cfg.anagrpid, anagrpid),
-		  OPT_UINT("nvmset-id",    'i', &cfg.nvmsetid, nvmsetid),
-		  OPT_UINT("endg-id",      'e', &cfg.endgid,   endgid),
-		  OPT_SUFFIX("block-size", 'b', &cfg.bs,       bs),
-		  OPT_UINT("timeout",      't', &cfg.timeout,  timeout),
-		  OPT_BYTE("csi",          'y', &cfg.csi,      csi),
-		  OPT_SUFFIX("lbstm",      'l', &cfg.lbstm,    lbstm),
-		  OPT_SHRT("nphndls",      'n', &cfg.nphndls,  nphndls),
-		  OPT_STR("nsze-si",       'S', &cfg.nsze_si,  nsze_si),
-		  OPT_STR("ncap-si",       'C', &cfg.ncap_si,  ncap_si),
-		  OPT_FLAG("azr",          'z', &cfg.azr,      azr),
-		  OPT_UINT("rar",          'r', &cfg.rar,      rar),
-		  OPT_UINT("ror",          'O', &cfg.ror,      ror),
-		  OPT_UINT("rnumzrwa",     'u', &cfg.rnumzrwa, rnumzrwa),
-		  OPT_LIST("phndls",       'p', &cfg.phndls,   phndls));
+		  OPT_SHRT("nvmset-id",	   'i', &cfg.nvmset_id,     nvmset_id),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use),
+		  OPT_FLAG("all",          'a', &cfg.all,           all));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.flbas != 0xff && cfg.bs != 0x00) {
-		nvme_show_error(
-		    "Invalid specification of both FLBAS and Block Size, please specify only one");
-		return -EINVAL;
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
-	if (cfg.bs) {
-		if ((cfg.bs & (~cfg.bs + 1)) != cfg.bs) {
-			nvme_show_error(
-			    "Invalid value for block size (%"PRIu64"). Block size must be a power of two",
-			    (uint64_t)cfg.bs);
-			return -EINVAL;
-		}
-
 
-		ns = nvme_alloc(sizeof(*ns));
-		if (!ns)
-			return -ENOMEM;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-		err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
-		if (err) {
-			if (err < 0) {
-				nvme_show_error("identify-namespace: %s", nvme_strerror(errno));
-			} else {
-				fprintf(stderr, "identify failed\n");
-				nvme_show_status(err);
-			}
-			return err;
-		}
-		for (i = 0; i <= ns->nlbaf; ++i) {
-			if ((1 << ns->lbaf[i].ds) == cfg.bs && ns->lbaf[i].ms == 0) {
-				cfg.flbas = i;
-				break;
-			}
+	if (cfg.all) {
+		err = nvmset_ids(dev, &e, &nr);
+		if (!err)
+			err = log_batch(dev, e, nr, sizeof(*plpns_log),
+					pred_lat_nvmset_fetch);
+		if (!err) {
+			nvme_show_predictable_latency_nvmset_batch(e, nr, dev->name, flags);
+			err = log_batch_err(e, nr);
+		} else if (err > 0) {
+			nvme_show_status(err);
+		} else {
+			nvme_show_error("nvm set list: %s",
+					nvme_strerror(err == -1 ? errno : -err));
 		}
-
-	}
-	if (cfg.flbas == 0xff) {
-		fprintf(stderr, "FLBAS corresponding to block size %"PRIu64" not found\n",
-			(uint64_t)cfg.bs);
-		fprintf(stderr, "Please correct block size, or specify FLBAS directly\n");
-
-		return -EINVAL;
+		log_batch_free(e, nr);
+		return err;
 	}
 
-	id = nvme_alloc(sizeof(*id));
-	if (!id)
+	plpns_log = nvme_alloc(sizeof(*plpns_log));
+	if (!plpns_log)
 		return -ENOMEM;
 
-	err = nvme_identify_ctrl(dev_fd(dev), id);
-	if (err) {
-		if (err < 0) {
-			nvme_show_error("identify-controller: %s", nvme_strerror(errno));
-		} else {
-			fprintf(stderr, "identify controller failed\n");
-			nvme_show_status(err);
-		}
-		return err;
-	}
+	err = nvme_cli_get_log_predictable_lat_nvmset(dev, cfg.nvmset_id,
+						      plpns_log);
+	if (!err)
+		nvme_show_predictable_latency_per_nvmset(plpns_log, cfg.nvmset_id, dev->name,
+							 flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("predictable latency per nvm set: %s", nvme_strerror(errno));
 
-	if (id->ctratt & NVME_CTRL_CTRATT_NAMESPACE_GRANULARITY) {
-		gr_list = nvme_alloc(sizeof(*gr_list));
-		if (!gr_list)
-			return -ENOMEM;
+	return err;
+}
 
-		if (!nvme_identify_ns_granularity(dev_fd(dev), gr_list)) {
-			struct nvme_id_ns_granularity_desc *desc;
-			int index = cfg.flbas;
+static int get_pred_lat_event_agg_log(int argc, char **argv,
+		struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve Predictable Latency Event "
+		"Aggregate Log page and prints it, for the given "
+		"device in either decoded format(default), json or binary.";
+	const char *log_entries = "Number of pending NVM Set log Entries list";
 
-			/* FIXME: add a proper bitmask to libnvme */
-			if (!(gr_list->attributes & 1)) {
-				/* Only the first descriptor is valid */
-				index = 0;
-			} else if (index > gr_list->num_descriptors) {
-				/*
-				 * The descriptor will contain only zeroes
-				 * so we don't need to read it.
-				 */
-				goto parse_lba;
-			}
-			desc = &gr_list->entry[index];
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ void *pea_log = NULL;
+	enum nvme_print_flags flags;
+	__u32 log_size;
+	int err;
 
-			if (desc->nszegran && desc->nszegran < align_nsze)
-				align_nsze = desc->nszegran;
-			if (desc->ncapgran && desc->ncapgran < align_ncap)
-				align_ncap = desc->ncapgran;
-		}
-	}
+	struct config {
+		__u64	log_entries;
+		bool	rae;
+		bool	raw_binary;
+	};
 
-parse_lba:
-	err = parse_lba_num_si(dev, "nsze", cfg.nsze_si, cfg.flbas, &cfg.nsze, align_nsze);
+	struct config cfg = {
+		.log_entries	= 2044,
+		.rae		= false,
+		.raw_binary	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
+		  OPT_FLAG("rae",          'r', &cfg.rae,           rae),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = parse_lba_num_si(dev, "ncap", cfg.ncap_si, cfg.flbas, &cfg.ncap, align_ncap);
-	if (err)
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
 		return err;
+	}
 
-	if (cfg.csi != NVME_CSI_ZNS && (cfg.azr || cfg.rar || cfg.ror || cfg.rnumzrwa)) {
-		nvme_show_error("Invalid ZNS argument is given (CSI:%#x)", cfg.csi);
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (!cfg.log_entries) {
+		nvme_show_error("non-zero log-entries is required param");
 		return -EINVAL;
 	}
 
-	data = nvme_alloc(sizeof(*data));
-	if (!data)
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
 		return -ENOMEM;
 
-	data->nsze = cpu_to_le64(cfg.nsze);
-	data->ncap = cpu_to_le64(cfg.ncap);
-	data->flbas = cfg.flbas;
-	data->dps = cfg.dps;
-	data->nmic = cfg.nmic;
-	data->anagrpid = cpu_to_le32(cfg.anagrpid);
-	data->nvmsetid = cpu_to_le16(cfg.nvmsetid);
-	data->endgid = cpu_to_le16(cfg.endgid);
-	data->lbstm = cpu_to_le64(cfg.lbstm);
-	data->zns.znsco = cfg.azr;
-	data->zns.rar = cpu_to_le32(cfg.rar);
-	data->zns.ror = cpu_to_le32(cfg.ror);
-	data->zns.rnumzrwa = cpu_to_le32(cfg.rnumzrwa);
-	data->nphndls = cpu_to_le16(cfg.nphndls);
-
-	num_phandle = argconfig_parse_comma_sep_array_short(cfg.phndls, phndl, ARRAY_SIZE(phndl));
-	if (cfg.nphndls != num_phandle) {
-		nvme_show_error("Invalid Placement handle list");
-		return -EINVAL;
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err < 0) {
+		nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
+		nvme_show_status(err);
+		return err;
 	}
 
-	for (i = 0; i < num_phandle; i++)
-		data->phndl[i] = cpu_to_le16(phndl[i]);
+	cfg.log_entries = min(cfg.log_entries, le32_to_cpu(ctrl->nsetidmax));
+	log_size = sizeof(__u64) + cfg.log_entries * sizeof(__u16);
 
-	err = nvme_cli_ns_mgmt_create(dev, data, &nsid, cfg.timeout, cfg.csi);
+	pea_log = nvme_alloc(log_size);
+	if (!pea_log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_predictable_lat_event(dev, cfg.rae, 0,
+						     log_size, pea_log);
 	if (!err)
-		printf("%s: Success, created nsid:%d\n", cmd->name, nsid);
+		nvme_show_predictable_latency_event_agg_log(pea_log, cfg.log_entries, log_size,
+							    dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("create namespace: %s", nvme_strerror(errno));
+		nvme_show_error("predictable latency event aggregate log page: %s",
+				nvme_strerror(errno));
 
 	return err;
 }
 
-static bool nvme_match_device_filter(nvme_subsystem_t s,
-		nvme_ctrl_t c, nvme_ns_t ns, void *f_args)
-{
-	int ret, instance, nsid, s_num;
-	char *devname = f_args;
+/* Window Select of the PLM Window feature, Status of the per NVM set log */
+#define PLM_WIN_DTWIN		1
+#define PLM_WIN_NDWIN		2
 
-	if (!devname || !strlen(devname))
-		return true;
+/* Event Types of the autonomous DTWIN to NDWIN transitions */
+#define PLM_EVENT_FORCED	0xc000
 
-	ret = sscanf(devname, "nvme%dn%d", &instance, &nsid);
-	if (ret != 2)
-		return true;
+/* A replica drive of plm-scheduler */
+struct plm_replica {
+	struct nvme_dev *dev;
+	__u16 *sets;
+	int nr_sets;
+	struct nvme_plm_config *saved;	/* the configuration of each set */
+	bool *lpe;			/* PLM was enabled on the set before */
+	int nr_saved;			/* of the sets, in order */
+	void *agg;			/* event aggregate log */
+	__u32 agg_size;
+	bool ndwin;			/* in its scheduled NDWIN */
+	__u64 ndwin_start_ns;
+	__u64 forced_until_ms;		/* of an unscheduled NDWIN, 0 if none */
+	struct nvme_plm_summary sum;
+};
 
-	if (s) {
-		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
-			     &s_num);
-		if (ret == 1 && s_num == instance)
-			return true;
-	}
-	if (c) {
-		s = nvme_ctrl_get_subsystem(c);
+/* the schedule is on the wall clock, shared by the hosts of the replicas */
+static __u64 plm_clock_ms(void)
+{
+	struct timespec ts;
 
-		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
-			     &s_num);
-		if (ret == 1 && s_num == instance)
-			return true;
-	}
-	if (ns) {
-		if (!strcmp(devname, nvme_ns_get_name(ns)))
-			return true;
-	}
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
 
-	return false;
+static int plm_feature_get(struct nvme_dev *dev, __u16 nvmset_id,
+			   struct nvme_plm_config *cfg, __u32 *result)
+{
+	struct nvme_get_features_args args = {
+		.args_size	= sizeof(args),
+		.fid		= NVME_FEAT_FID_PLM_CONFIG,
+		.sel		= NVME_GET_FEATURES_SEL_CURRENT,
+		.cdw11		= nvmset_id,
+		.data_len	= sizeof(*cfg),
+		.data		= cfg,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= result,
+	};
+
+	return nvme_cli_get_features(dev, &args);
 }
 
-static int list_subsys(int argc, char **argv, struct command *cmd,
-		struct plugin *plugin)
+static int plm_feature_set(struct nvme_dev *dev, __u8 fid, __u16 nvmset_id, __u32 cdw12,
+			   struct nvme_plm_config *cfg)
 {
-	_cleanup_nvme_root_ nvme_root_t r = NULL;
-	enum nvme_print_flags flags;
-	const char *desc = "Retrieve information for subsystems";
-	nvme_scan_filter_t filter = NULL;
-	char *devname;
-	int err;
-	int nsid = NVME_NSID_ALL;
+	struct nvme_set_features_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.fid		= fid,
+		.cdw11		= nvmset_id,
+		.cdw12		= cdw12,
+		.data_len	= cfg ? sizeof(*cfg) : 0,
+		.data		= cfg,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
 
-	NVME_ARGS(opts);
+	return nvme_set_features(&args);
+}
 
-	err = parse_args(argc, argv, desc, opts);
-	if (err < 0)
-		return err;
+static void plm_event(struct plm_replica *r, int i, __u8 window, __u16 event_type,
+		      bool forced, bool overlap, int err, enum nvme_print_flags flags)
+{
+	struct nvme_plm_event e = {
+		.name		= r->dev->name,
+		.timestamp_ms	= plm_clock_ms(),
+		.replica	= r->sum.replica,
+		.nvmset_id	= r->sets[i],
+		.window		= window,
+		.event_type	= event_type,
+		.forced		= forced,
+		.overlap	= overlap,
+		.err		= err,
+	};
 
-	devname = NULL;
-	if (optind < argc)
-		devname = basename(argv[optind++]);
+	nvme_show_plm_event(&e, flags);
+}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("Invalid output format");
-		return -EINVAL;
+/* request @window on every NVM set of @r */
+static void plm_switch(struct plm_replica *r, __u8 window, enum nvme_print_flags flags)
+{
+	int i, err;
+
+	for (i = 0; i < r->nr_sets; i++) {
+		err = plm_feature_set(r->dev, NVME_FEAT_FID_PLM_WINDOW, r->sets[i], window,
+				      NULL);
+		if (err) {
+			err = err < 0 ? -errno : err;
+			r->sum.errors++;
+		}
+		plm_event(r, i, window, 0, false, false, err, flags);
 	}
+}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+/* the controller leaves DTWIN on its own after its DTWIN Time Maximum */
+static void plm_check_windows(struct plm_replica *r, __u16 id,
+			      struct nvme_nvmset_predictable_lat_log *log,
+			      __u64 dtwin_ms, __u64 ndwin_ms)
+{
+	if (le64_to_cpu(log->dtwin_tmax) && dtwin_ms > le64_to_cpu(log->dtwin_tmax))
+		fprintf(stderr, "warning: %s: NVM set %u: DTWIN of %"PRIu64" ms exceeds its maximum of %"PRIu64" ms\n",
+			r->dev->name, id, (uint64_t)dtwin_ms,
+			(uint64_t)le64_to_cpu(log->dtwin_tmax));
+	if (ndwin_ms < le64_to_cpu(log->ndwin_tmin_lo))
+		fprintf(stderr, "warning: %s: NVM set %u: NDWIN of %"PRIu64" ms is below its minimum of %"PRIu64" ms\n",
+			r->dev->name, id, (uint64_t)ndwin_ms,
+			(uint64_t)le64_to_cpu(log->ndwin_tmin_lo));
+}
 
+/*
+ * Fetch the NVM sets of @r, the @nr_ids of @ids if given, and check, or
+ * enable, PLM on them. The replica is in DTWIN for @dtwin_ms and NDWIN for
+ * @ndwin_ms in turn. The errors are reported.
+ */
+static int plm_replica_setup(struct plm_replica *r, const __u16 *ids, int nr_ids,
+			     bool enable, __u64 dtwin_ms, __u64 ndwin_ms)
+{
+	_cleanup_free_ struct nvme_nvmset_predictable_lat_log *log = NULL;
+	_cleanup_free_ struct nvme_plm_config *cfg = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	struct nvme_log_batch_entry *e = NULL;
+	const char *what = "identify controller";
+	__u32 result;
+	int i, err;
 
-	r = nvme_create_root(stderr, log_level);
-	if (!r) {
-		if (devname)
-			nvme_show_error("Failed to scan nvme subsystem for %s", devname);
-		else
-			nvme_show_error("Failed to scan nvme subsystem");
-		return -errno;
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	log = nvme_alloc(sizeof(*log));
+	cfg = nvme_alloc(sizeof(*cfg));
+	if (!ctrl || !log || !cfg)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(r->dev, ctrl);
+	if (err)
+		goto err;
+	if (!(le32_to_cpu(ctrl->ctratt) & NVME_CTRL_CTRATT_PREDICTABLE_LAT)) {
+		nvme_show_error("%s: Predictable Latency Mode is not supported", r->dev->name);
+		return -ENOTSUP;
 	}
 
-	if (devname) {
-		int subsys_num;
+	if (nr_ids) {
+		r->nr_sets = nr_ids;
+		r->sets = calloc(nr_ids, sizeof(*r->sets));
+		if (!r->sets)
+			return -ENOMEM;
+		memcpy(r->sets, ids, nr_ids * sizeof(*ids));
+	} else {
+		what = "nvm set list";
+		err = nvmset_ids(r->dev, &e, &r->nr_sets);
+		if (err) {
+			log_batch_free(e, r->nr_sets);
+			goto err;
+		}
+		r->sets = calloc(r->nr_sets ? r->nr_sets : 1, sizeof(*r->sets));
+		if (r->sets)
+			for (i = 0; i < r->nr_sets; i++)
+				r->sets[i] = e[i].id;
+		log_batch_free(e, r->nr_sets);
+		if (!r->sets)
+			return -ENOMEM;
+		if (!r->nr_sets) {
+			nvme_show_error("%s: no NVM sets", r->dev->name);
+			return -ENOENT;
+		}
+	}
 
-		if (sscanf(devname, "nvme%dn%d", &subsys_num, &nsid) != 2) {
-			nvme_show_error("Invalid device name %s", devname);
+	r->saved = nvme_alloc(r->nr_sets * sizeof(*r->saved));
+	r->lpe = calloc(r->nr_sets, sizeof(*r->lpe));
+	r->agg_size = sizeof(__u64) + le32_to_cpu(ctrl->nsetidmax) * sizeof(__u16);
+	r->agg = nvme_alloc(r->agg_size);
+	if (!r->saved || !r->lpe || !r->agg)
+		return -ENOMEM;
+	r->sum.nvmsets = r->nr_sets;
+
+	for (i = 0; i < r->nr_sets; i++) {
+		what = "predictable latency mode config";
+		err = plm_feature_get(r->dev, r->sets[i], &r->saved[i], &result);
+		if (err)
+			goto err;
+		r->lpe[i] = result & 0x1;
+		r->nr_saved++;
+
+		what = "predictable latency per nvm set";
+		err = nvme_cli_get_log_predictable_lat_nvmset(r->dev, r->sets[i], log);
+		if (err)
+			goto err;
+		plm_check_windows(r, r->sets[i], log, dtwin_ms, ndwin_ms);
+
+		if (r->lpe[i] && !enable)
+			continue;
+		if (!enable) {
+			nvme_show_error("%s: PLM is not enabled on NVM set %u, see --enable",
+					r->dev->name, r->sets[i]);
 			return -EINVAL;
 		}
-		filter = nvme_match_device_filter;
-	}
 
-	err = nvme_scan_topology(r, filter, (void *)devname);
-	if (err) {
-		if (errno != ENOENT)
-			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
-		return -errno;
+		/* the autonomous transitions must show in the event aggregate log */
+		memcpy(cfg, &r->saved[i], sizeof(*cfg));
+		cfg->ee = cpu_to_le16(le16_to_cpu(cfg->ee) | PLM_EVENT_FORCED);
+		what = "enable predictable latency mode";
+		err = plm_feature_set(r->dev, NVME_FEAT_FID_PLM_CONFIG, r->sets[i], 1, cfg);
+		if (err)
+			goto err;
 	}
 
-	nvme_show_subsystem_list(r, nsid != NVME_NSID_ALL, flags);
-
 	return 0;
+err:
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	}
+	if (err != -1)
+		errno = -err;
+	nvme_show_error("%s: %s: %s", r->dev->name, what, nvme_strerror(errno));
+	return -errno;
 }
 
-static int list(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* leave every set in DTWIN and its PLM configuration as it was found */
+static void plm_replica_restore(struct plm_replica *r, bool enable)
 {
-	const char *desc = "Retrieve basic information for all NVMe namespaces";
-	enum nvme_print_flags flags;
-	_cleanup_nvme_root_ nvme_root_t r = NULL;
-	int err = 0;
+	int i;
 
-	NVME_ARGS(opts);
+	for (i = 0; i < r->nr_saved; i++) {
+		plm_feature_set(r->dev, NVME_FEAT_FID_PLM_WINDOW, r->sets[i], PLM_WIN_DTWIN,
+				NULL);
+		if (enable)
+			plm_feature_set(r->dev, NVME_FEAT_FID_PLM_CONFIG, r->sets[i],
+					r->lpe[i], &r->saved[i]);
+	}
+}
 
-	err = parse_args(argc, argv, desc, opts);
-	if (err < 0)
-		return err;
+/*
+ * Report the NVM sets of the event aggregate log that the controller moved
+ * to NDWIN on its own, @overlap if another replica has its window now.
+ */
+static void plm_poll(struct plm_replica *r, __u32 ndwin_ms, bool overlap,
+		     enum nvme_print_flags flags)
+{
+	struct nvme_aggregate_predictable_lat_event *agg = r->agg;
+	_cleanup_free_ struct nvme_nvmset_predictable_lat_log *log = NULL;
+	__u64 nr, n;
+	__u16 id, et;
+	int i, err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0 || (flags != JSON && flags != NORMAL)) {
-		nvme_show_error("Invalid output format");
-		return -EINVAL;
+	err = nvme_cli_get_log_predictable_lat_event(r->dev, false, 0, r->agg_size, agg);
+	if (err) {
+		r->sum.errors++;
+		return;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	nr = min(le64_to_cpu(agg->num_entries), (__u64)(r->agg_size - sizeof(__u64)) / 2);
+	if (!nr)
+		return;
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return;
 
-	r = nvme_create_root(stderr, log_level);
-	if (!r) {
-		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
-		return -errno;
-	}
-	err = nvme_scan_topology(r, NULL, NULL);
-	if (err < 0) {
-		if (errno != ENOENT)
-			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
-		return err;
-	}
+	for (n = 0; n < nr; n++) {
+		id = le16_to_cpu(agg->entries[n]);
+		for (i = 0; i < r->nr_sets && r->sets[i] != id; i++)
+			;
+		if (i == r->nr_sets)
+			continue;
 
-	nvme_show_list_items(r, flags);
+		/* reading the log of the set clears its events */
+		err = nvme_cli_get_log_predictable_lat_nvmset(r->dev, id, log);
+		if (err) {
+			r->sum.errors++;
+			continue;
+		}
+		et = le16_to_cpu(log->event_type);
+		if (!(et & PLM_EVENT_FORCED) || (log->status & 0x7) != PLM_WIN_NDWIN ||
+		    r->ndwin)
+			continue;
 
-	return err;
+		r->sum.forced++;
+		if (overlap)
+			r->sum.overlaps++;
+		/* give it a window's worth of time, then take it back */
+		r->forced_until_ms = plm_clock_ms() + ndwin_ms;
+		plm_event(r, i, PLM_WIN_NDWIN, et, true, overlap, 0, flags);
+	}
 }
 
-int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin,
-		void (*vs)(__u8 *vs, struct json_object *root))
+/*
+ * plm-scheduler: the time is cut in slots of --ndwin on the wall clock,
+ * slot s belongs to replica s % --replicas, which has its NVM sets in
+ * NDWIN while the other replicas are in DTWIN. The replica of a slot
+ * enters NDWIN --guard after the slot starts, the one before leaves it at
+ * the start, so that clocks --guard apart never have two replicas in NDWIN.
+ * The drives given are the replicas from --replica-index on, those of
+ * other hosts run their own scheduler with the same schedule.
+ */
+static int plm_scheduler(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify Controller command to "
-		"the given device and report information about the specified "
-		"controller in human-readable or "
-		"binary format. May also return vendor-specific "
-		"controller attributes in hex-dump if requested.";
-	const char *vendor_specific = "dump binary vendor field";
-
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	const char *desc = "Rotate the NVM sets of replica drives between the deterministic\n"
+		"and non-deterministic windows of Predictable Latency Mode, at most one\n"
+		"replica in NDWIN at a time.";
+	const char *nvmsets = "comma separated NVM sets to schedule (default: all)";
+	const char *ndwin = "milliseconds of each replica's NDWIN";
+	const char *replicas = "replicas in the group, on all hosts (default: the drives given)";
+	const char *replica_index = "index in the group of the first drive given";
+	const char *guard = "milliseconds between two replicas' NDWIN, above the clock skew";
+	const char *poll_ms = "milliseconds between the reads of the event aggregate log";
+	const char *count = "number of slots to run (default: until interrupted)";
+	const char *enable = "enable PLM on the NVM sets for the run, restored at the end";
+
+	_cleanup_free_ struct plm_replica *reps = NULL;
 	enum nvme_print_flags flags;
-	int err;
+	__u16 ids[NVME_ID_NVMSET_LIST_MAX];
+	struct plm_replica *r;
+	__u64 now, slot, first, start_ns, wake, next_poll, end;
+	struct timespec ts;
+	int nr = 0, nr_ids = 0, i, active, err;
+	bool overlap;
 
 	struct config {
-		bool	vendor_specific;
-		bool	raw_binary;
-		bool	human_readable;
+		char	*nvmset_ids;
+		__u32	ndwin;
+		__u32	replicas;
+		__u32	replica_index;
+		__u32	guard;
+		__u32	poll;
+		__u32	count;
+		bool	enable;
 	};
 
 	struct config cfg = {
-		.vendor_specific	= false,
-		.raw_binary		= false,
-		.human_readable		= false,
+		.nvmset_ids	= NULL,
+		.ndwin		= 5000,
+		.replicas	= 0,
+		.replica_index	= 0,
+		.guard		= 100,
+		.poll		= 100,
+		.count		= 0,
+		.enable		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
-		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
-		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+		  OPT_LIST("nvmset-ids",    'i', &cfg.nvmset_ids,    nvmsets),
+		  OPT_UINT("ndwin",         'w', &cfg.ndwin,         ndwin),
+		  OPT_UINT("replicas",      'r', &cfg.replicas,      replicas),
+		  OPT_UINT("replica-index", 'I', &cfg.replica_index, replica_index),
+		  OPT_UINT("guard",         'g', &cfg.guard,         guard),
+		  OPT_UINT("poll",          'p', &cfg.poll,          poll_ms),
+		  OPT_UINT("count",         'c', &cfg.count,         count),
+		  OPT_FLAG("enable",        'e', &cfg.enable,        enable));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
 	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
 		nvme_show_error("Invalid output format");
-		return err;
+		return -EINVAL;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	if (optind >= argc) {
+		nvme_show_error("no replica drives given");
+		return -EINVAL;
+	}
+	nr = argc - optind;
+	if (!cfg.replicas)
+		cfg.replicas = cfg.replica_index + nr;
+	if (cfg.replicas < 2 || cfg.replica_index + nr > cfg.replicas) {
+		nvme_show_error("the drives must be replicas %u to %u of at least 2",
+				cfg.replica_index, cfg.replica_index + nr - 1);
+		return -EINVAL;
+	}
+	if (!cfg.poll || cfg.guard >= cfg.ndwin) {
+		nvme_show_error("--poll must be set and --guard below --ndwin");
+		return -EINVAL;
+	}
+	if (cfg.nvmset_ids) {
+		nr_ids = argconfig_parse_comma_sep_array_u16(cfg.nvmset_ids, ids,
+							     ARRAY_SIZE(ids));
+		if (nr_ids <= 0) {
+			nvme_show_error("invalid --nvmset-ids");
+			return -EINVAL;
+		}
+	}
 
-	if (cfg.vendor_specific)
-		flags |= VS;
+	reps = calloc(nr, sizeof(*reps));
+	if (!reps)
+		return -ENOMEM;
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	for (i = 0; i < nr; i++) {
+		r = &reps[i];
+		if (open_dev_direct(&r->dev, argv[optind + i], O_RDONLY)) {
+			err = -errno;
+			goto close;
+		}
+		r->sum.name = r->dev->name;
+		r->sum.replica = cfg.replica_index + i;
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+		err = plm_replica_setup(r, ids, nr_ids, cfg.enable,
+					(__u64)(cfg.replicas - 1) * cfg.ndwin, cfg.ndwin);
+		if (err)
+			goto close;
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (!err)
-		nvme_show_id_ctrl(ctrl, flags, vs);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		/* start deterministic, the first slot of each replica is its NDWIN */
+		plm_switch(r, PLM_WIN_DTWIN, flags);
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	start_ns = monotonic_ns();
+	first = plm_clock_ms() / cfg.ndwin;
+	next_poll = 0;
+	while (!nvme_stopped()) {
+		now = plm_clock_ms();
+		slot = now / cfg.ndwin;
+		if (cfg.count && slot - first >= cfg.count)
+			break;
+		active = slot % cfg.replicas;
+		/* no replica's window during the guard at the start of a slot */
+		if (now - slot * cfg.ndwin < cfg.guard)
+			active = -1;
+
+		for (i = 0; i < nr; i++) {
+			r = &reps[i];
+			if (r->ndwin && r->sum.replica != active) {
+				r->ndwin = false;
+				r->sum.ndwin_ns += monotonic_ns() - r->ndwin_start_ns;
+				plm_switch(r, PLM_WIN_DTWIN, flags);
+			}
+		}
+		for (i = 0; i < nr; i++) {
+			r = &reps[i];
+			if (!r->ndwin && r->sum.replica == active) {
+				r->ndwin = true;
+				r->forced_until_ms = 0;
+				r->ndwin_start_ns = monotonic_ns();
+				r->sum.ndwins++;
+				plm_switch(r, PLM_WIN_NDWIN, flags);
+			}
+		}
+
+		if (now >= next_poll) {
+			for (i = 0; i < nr; i++) {
+				r = &reps[i];
+				overlap = active >= 0 && r->sum.replica != active;
+				plm_poll(r, cfg.ndwin, overlap, flags);
+				if (r->forced_until_ms && now >= r->forced_until_ms) {
+					r->forced_until_ms = 0;
+					if (!r->ndwin)
+						plm_switch(r, PLM_WIN_DTWIN, flags);
+				}
+			}
+			next_poll = now + cfg.poll;
+		}
+
+		/* until the next poll, slot or end of the guard */
+		end = (slot + 1) * cfg.ndwin;
+		wake = min(next_poll, end);
+		if (now < slot * cfg.ndwin + cfg.guard)
+			wake = min(wake, slot * cfg.ndwin + cfg.guard);
+		now = plm_clock_ms();
+		if (wake > now) {
+			ts.tv_sec = (wake - now) / 1000;
+			ts.tv_nsec = (wake - now) % 1000 * 1000000;
+			nanosleep(&ts, NULL);
+		}
+	}
+
+	nvme_stop_release();
+	err = 0;
+
+	for (i = 0; i < nr; i++) {
+		r = &reps[i];
+		if (r->ndwin)
+			r->sum.ndwin_ns += monotonic_ns() - r->ndwin_start_ns;
+		r->sum.elapsed_ns = monotonic_ns() - start_ns;
+		nvme_show_plm_summary(&r->sum, flags);
+	}
+
+close:
+	for (i = 0; i < nr; i++) {
+		r = &reps[i];
+		if (!r->dev)
+			continue;
+		plm_replica_restore(r, cfg.enable);
+		free(r->sets);
+		free(r->saved);
+		free(r->lpe);
+		free(r->agg);
+		dev_close(r->dev);
+	}
 
 	return err;
 }
 
-static int id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* the last event printed by persistent-event-log --follow */
+struct pevent_cursor {
+	bool	valid;
+	__u64	ts;	/* its event timestamp */
+	__u32	off;	/* its offset in the log */
+	__u32	end;	/* offset of the event following it */
+	__u32	idx;	/* its event number */
+};
+
+static int pevent_read(struct nvme_dev *dev, __u32 xfer_len, __u32 offset,
+		       __u32 len, void *buf)
 {
-	return __id_ctrl(argc, argv, cmd, plugin, NULL);
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_PERSISTENT_EVENT,
+		.nsid		= NVME_NSID_ALL,
+		.lsp		= NVME_PEVENT_LOG_READ,
+		.lpo		= offset,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= len,
+		.log		= buf,
+		.result		= NULL,
+	};
+
+	return nvme_cli_get_log_page(dev, xfer_len, &args);
 }
 
-static int nvm_id_ctrl(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+/* length of the event at @off in @buf, 0 if it is not complete */
+static __u32 pevent_len(void *buf, __u32 off, __u32 len)
 {
-	const char *desc = "Send an Identify Controller NVM Command Set "
-		"command to the given device and report information about "
-		"the specified controller in various formats.";
+	struct nvme_persistent_event_entry *e = buf + off;
+	__u32 elen;
 
-	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err = -1;
+	if (off + sizeof(*e) > len)
+		return 0;
+	elen = e->ehl + 3 + le16_to_cpu(e->el);
+	return off + elen > len ? 0 : elen;
+}
 
-	NVME_ARGS(opts);
+/*
+ * Print the events of @buf, which holds @len bytes of the log read from
+ * offset @base on, starting with the event at @off numbered @idx.
+ */
+static void pevent_emit(struct pevent_cursor *c, void *buf, __u32 base,
+			__u32 off, __u32 len, __u32 idx, const char *devname)
+{
+	struct nvme_persistent_event_entry *e;
+	__u32 elen;
+
+	while ((elen = pevent_len(buf, off, len))) {
+		e = buf + off;
+		nvme_show_persistent_event(buf, off, idx, devname, JSON);
+		c->valid = true;
+		c->ts = le64_to_cpu(e->ets);
+		c->off = base + off;
+		c->end = base + off + elen;
+		c->idx = idx++;
+		off += elen;
+	}
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+/*
+ * One poll of --follow. A reporting context is established with the
+ * header read and released again at the end, so every poll sees the
+ * events logged up to then. If the last printed event is still found at
+ * its offset only the log past it is read, otherwise events were dropped
+ * from the front of the log and the whole log is read and scanned for
+ * the last printed event.
+ */
+static int pevent_poll(struct nvme_dev *dev, __u32 xfer_len,
+		       struct pevent_cursor *c, struct nvme_pevent_store *store)
+{
+	_cleanup_free_ struct nvme_persistent_event_log *head = NULL;
+	_cleanup_free_ struct nvme_persistent_event_entry *last = NULL;
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	__u32 base = sizeof(*head), off, skip, idx, i, elen, tll;
+	bool resume = false;
+	void *buf;
+	int err, rerr;
+
+	head = nvme_alloc(sizeof(*head));
+	last = nvme_alloc(sizeof(*last));
+	if (!head || !last)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_persistent_event(dev, NVME_PEVENT_LOG_EST_CTX_AND_READ,
+						sizeof(*head), head);
 	if (err)
 		return err;
+	tll = le64_to_cpu(head->tll);
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (c->valid && c->end <= tll) {
+		err = pevent_read(dev, xfer_len, c->off, sizeof(*last), last);
+		if (err)
+			goto release;
+		resume = le64_to_cpu(last->ets) == c->ts &&
+			c->off + last->ehl + 3 + le16_to_cpu(last->el) == c->end;
 	}
+	if (resume)
+		base = c->end;
+	if (tll <= base)
+		goto release;
 
-	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
-	if (!ctrl_nvm)
+	buf = nvme_alloc_huge(tll - base, &mh);
+	if (!buf) {
+		err = -ENOMEM;
+		goto release;
+	}
+	err = pevent_read(dev, xfer_len, base, tll - base, buf);
+	if (err)
+		goto release;
+
+	if (store) {
+		err = nvme_pevent_store_append(store, buf, tll - base);
+		if (err < 0) {
+			errno = -err;
+			goto release;
+		}
+		err = 0;
+	}
+
+	if (resume) {
+		pevent_emit(c, buf, base, 0, tll - base, c->idx + 1, dev->name);
+		goto release;
+	}
+
+	/* resynchronize after the last event with the printed timestamp */
+	off = skip = idx = 0;
+	for (i = 0; (elen = pevent_len(buf, off, tll - base)); i++) {
+		struct nvme_persistent_event_entry *e = buf + off;
+
+		off += elen;
+		if (c->valid && le64_to_cpu(e->ets) == c->ts) {
+			skip = off;
+			idx = i + 1;
+		}
+	}
+	pevent_emit(c, buf, base, skip, tll - base, idx, dev->name);
+
+release:
+	rerr = nvme_cli_get_log_persistent_event(dev, NVME_PEVENT_LOG_RELEASE_CTX,
+						 sizeof(*head), head);
+	return err ? err : rerr;
+}
+
+static int pevent_follow(struct nvme_dev *dev, __u32 interval,
+			 struct nvme_pevent_store *store)
+{
+	struct pevent_cursor c = { .valid = false };
+	_cleanup_free_ struct nvme_persistent_event_log *head = NULL;
+	__u64 next;
+	__u32 xfer_len;
+	int err;
+
+	err = get_max_xfer_len(dev, &xfer_len);
+	if (err)
+		return err;
+
+	/* a context left behind by an earlier run would fail the first poll */
+	head = nvme_alloc(sizeof(*head));
+	if (!head)
 		return -ENOMEM;
+	nvme_cli_get_log_persistent_event(dev, NVME_PEVENT_LOG_RELEASE_CTX,
+					  sizeof(*head), head);
 
-	err = nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm);
-	if (!err)
-		nvme_show_id_ctrl_nvm(ctrl_nvm, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("nvm identify controller: %s", nvme_strerror(errno));
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	while (true) {
+		err = pevent_poll(dev, xfer_len, &c, store);
+		if (err)
+			break;
+
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
+	}
+
+	nvme_stop_release();
 
 	return err;
 }
 
-static int nvm_id_ns(int argc, char **argv, struct command *cmd,
-	struct plugin *plugin)
+static const char *const pevent_type_names[] = {
+	[NVME_PEL_SMART_HEALTH_EVENT]		= "smart",
+	[NVME_PEL_FW_COMMIT_EVENT]		= "fw-commit",
+	[NVME_PEL_TIMESTAMP_EVENT]		= "timestamp",
+	[NVME_PEL_POWER_ON_RESET_EVENT]		= "power-on-reset",
+	[NVME_PEL_NSS_HW_ERROR_EVENT]		= "hw-error",
+	[NVME_PEL_CHANGE_NS_EVENT]		= "change-ns",
+	[NVME_PEL_FORMAT_START_EVENT]		= "format-start",
+	[NVME_PEL_FORMAT_COMPLETION_EVENT]	= "format-complete",
+	[NVME_PEL_SANITIZE_START_EVENT]		= "sanitize-start",
+	[NVME_PEL_SANITIZE_COMPLETION_EVENT]	= "sanitize-complete",
+	[NVME_PEL_SET_FEATURE_EVENT]		= "set-feature",
+	[NVME_PEL_TELEMETRY_CRT]		= "telemetry",
+	[NVME_PEL_THERMAL_EXCURSION_EVENT]	= "thermal",
+};
+
+/* a comma separated list of event type names or numbers into @types */
+static int pevent_parse_types(const char *list, __u8 *types)
 {
-	const char *desc = "Send an Identify Namespace NVM Command Set "
-		"command to the given device and report information about "
-		"the specified namespace in various formats.";
+	_cleanup_free_ char *str = strdup(list);
+	char *tok, *save, *end;
+	unsigned long type;
+	size_t i;
 
-	_cleanup_free_ struct nvme_nvm_id_ns *id_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err = -1;
+	if (!str)
+		return -ENOMEM;
 
-	struct config {
-		__u32	namespace_id;
-		__u8	uuid_index;
-	};
+	for (tok = strtok_r(str, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		for (i = 0; i < ARRAY_SIZE(pevent_type_names); i++)
+			if (pevent_type_names[i] && !strcmp(tok, pevent_type_names[i]))
+				break;
+		type = i;
+		if (i == ARRAY_SIZE(pevent_type_names)) {
+			errno = 0;
+			type = strtoul(tok, &end, 0);
+			if (errno || end == tok || *end || type > 0xff) {
+				nvme_show_error("invalid event type %s", tok);
+				return -EINVAL;
+			}
+		}
+		types[type / 8] |= 1 << (type % 8);
+	}
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.uuid_index	= NVME_UUID_NONE,
-	};
+	return 0;
+}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,    namespace_id_desired),
-		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,      uuid_index));
+/*
+ * A timestamp in milliseconds, as the controller keeps them, or a time
+ * ago with an s, m, h or d suffix.
+ */
+static int pevent_parse_time(const char *str, __u64 *ms)
+{
+	static const struct {
+		char suffix;
+		__u64 ms;
+	} units[] = {
+		{ 's', 1000 },
+		{ 'm', 60 * 1000 },
+		{ 'h', 60 * 60 * 1000 },
+		{ 'd', 24 * 60 * 60 * 1000 },
+	};
+	struct timespec now;
+	unsigned long long v;
+	char *end;
+	size_t i;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	errno = 0;
+	v = strtoull(str, &end, 0);
+	if (errno || end == str)
+		goto invalid;
+	if (!*end) {
+		*ms = v;
+		return 0;
+	}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	for (i = 0; i < ARRAY_SIZE(units); i++) {
+		if (end[0] != units[i].suffix || end[1])
+			continue;
+		clock_gettime(CLOCK_REALTIME, &now);
+		v *= units[i].ms;
+		*ms = now.tv_sec * 1000ULL + now.tv_nsec / 1000000;
+		*ms = *ms > v ? *ms - v : 1;
+		return 0;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+invalid:
+	nvme_show_error("invalid time %s", str);
+	return -EINVAL;
+}
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
-	}
+/* the store of the subsystem of @dev below @base */
+static int pevent_store_dir(struct nvme_dev *dev, const char *base, char *dir,
+			    size_t len)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	size_t n;
+	char *p;
+	int err;
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
-	if (err) {
-		nvme_show_status(err);
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err)
 		return err;
-	}
 
-	id_ns = nvme_alloc(sizeof(*id_ns));
-	if (!id_ns)
-		return -ENOMEM;
+	/* the serial number if there's no subsystem NQN */
+	n = snprintf(dir, len, "%s/", base);
+	if (ctrl->subnqn[0])
+		snprintf(dir + n, len - n, "%-.*s", (int)sizeof(ctrl->subnqn),
+			 ctrl->subnqn);
+	else
+		snprintf(dir + n, len - n, "%-.*s", (int)sizeof(ctrl->sn), ctrl->sn);
 
-	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id,
-				   cfg.uuid_index,
-				   NVME_CSI_NVM, id_ns);
-	if (!err)
-		nvme_show_nvm_id_ns(id_ns, cfg.namespace_id, ns, 0, false, flags);
-	else if (err > 0)
-		nvme_show_status(err);
+	for (p = dir + strlen(dir); p > dir + n && p[-1] == ' '; p--)
+		p[-1] = '\0';
+	for (p = dir + n; *p; p++)
+		if (*p == '/' || (*p == '.' && p == dir + n))
+			*p = '_';
+
+	return 0;
+}
+
+struct pevent_query_out {
+	const char *devname;
+	enum nvme_print_flags flags;
+};
+
+static int pevent_query_show(const void *entry, __u32 len, __u64 nr, void *data)
+{
+	struct pevent_query_out *out = data;
+
+	if (out->flags == BINARY)
+		d_raw((unsigned char *)entry, len);
 	else
-		nvme_show_perror("nvm identify namespace");
+		nvme_show_persistent_event((void *)entry, 0, nr, out->devname,
+					   out->flags);
 
-	return err;
+	return 0;
 }
 
-static int nvm_id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_persistent_event_log(int argc, char **argv,
+		struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an NVM Command Set specific Identify Namespace "
-		"command to the given device, returns capability field properties of "
-		"the specified LBA Format index in the specified namespace in various formats.";
+	const char *desc = "Retrieve Persistent Event log info for "
+		"the given device in either decoded format(default), json or binary.";
+	const char *action = "action the controller shall take during "
+		"processing this persistent log page command.";
+	const char *log_len = "number of bytes to retrieve";
+	const char *follow = "keep polling the log and print new events as JSON lines";
+	const char *interval = "seconds between polls in follow mode";
+	const char *store = "directory to append the fetched events to, one store per subsystem";
+	const char *query = "print the events of the store matching --since, --until and --event-type instead of reading the log";
+	const char *since = "oldest event timestamp, in ms or as a time ago like 1h";
+	const char *until = "newest event timestamp, in ms or as a time ago like 10m";
+	const char *event_type = "comma separated event types, by name or number";
 
-	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_free_ struct nvme_persistent_event_log *pevent = NULL;
+	struct nvme_persistent_event_log *pevent_collected = NULL;
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_pevent_store ps = { .events_fd = -1, .index_fd = -1 };
+	struct nvme_pevent_query q = { 0 };
+	struct pevent_query_out out;
 	enum nvme_print_flags flags;
-	int err = -1;
+	char store_dir[PATH_MAX];
+	void *pevent_log_info;
+	int err, serr;
 
 	struct config {
-		__u16	lba_format_index;
-		__u8	uuid_index;
+		__u8	action;
+		__u32	log_len;
+		bool	raw_binary;
+		bool	follow;
+		__u32	interval;
+		char	*store;
+		bool	query;
+		char	*since;
+		char	*until;
+		char	*event_type;
 	};
 
 	struct config cfg = {
-		.lba_format_index	= 0,
-		.uuid_index		= NVME_UUID_NONE,
+		.action		= 0xff,
+		.log_len	= 0,
+		.raw_binary	= false,
+		.follow		= false,
+		.interval	= 10,
+		.store		= NULL,
+		.query		= false,
+		.since		= NULL,
+		.until		= NULL,
+		.event_type	= NULL,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
-		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
+		  OPT_BYTE("action",       'a', &cfg.action,        action),
+		  OPT_UINT("log_len",	 'l', &cfg.log_len,	  log_len),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use),
+		  OPT_FLAG("follow",       'f', &cfg.follow,        follow),
+		  OPT_UINT("interval",     'i', &cfg.interval,      interval),
+		  OPT_FILE("store",        'S', &cfg.store,         store),
+		  OPT_FLAG("query",        'q', &cfg.query,         query),
+		  OPT_STR("since",         's', &cfg.since,         since),
+		  OPT_STR("until",         'u', &cfg.until,         until),
+		  OPT_LIST("event-type",   't', &cfg.event_type,    event_type));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -3602,60 +5710,187 @@ static int nvm_id_ns_lba_format(int argc, char **argv, struct command *cmd, stru
 		return err;
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
-		return -ENOMEM;
+	if (!cfg.query && (cfg.since || cfg.until || cfg.event_type)) {
+		nvme_show_error("--since, --until and --event-type are for --query");
+		return -EINVAL;
+	}
 
-	err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
-	if (err) {
-		ns->nlbaf = NVME_FEAT_LBA_RANGE_MAX - 1;
-		ns->nulbaf = 0;
+	if (cfg.query && (!cfg.store || cfg.follow)) {
+		nvme_show_error("--query needs a --store and no follow mode");
+		return -EINVAL;
 	}
 
-	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
-	if (!nvm_ns)
+	if (cfg.store) {
+		err = pevent_store_dir(dev, cfg.store, store_dir, sizeof(store_dir));
+		if (err > 0) {
+			nvme_show_status(err);
+			return err;
+		} else if (err < 0) {
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	if (cfg.query) {
+		if ((cfg.since && pevent_parse_time(cfg.since, &q.since)) ||
+		    (cfg.until && pevent_parse_time(cfg.until, &q.until)) ||
+		    (cfg.event_type && pevent_parse_types(cfg.event_type, q.types)))
+			return -EINVAL;
+
+		err = nvme_pevent_store_open(&ps, store_dir, false);
+		if (err) {
+			nvme_show_error("%s: %s", store_dir, nvme_strerror(-err));
+			return err;
+		}
+		out.devname = dev->name;
+		out.flags = flags;
+		err = nvme_pevent_store_query(&ps, &q, pevent_query_show, &out);
+		nvme_pevent_store_close(&ps);
+		if (err < 0) {
+			nvme_show_error("%s: %s", store_dir, nvme_strerror(-err));
+			return err;
+		}
+		return 0;
+	}
+
+	if (cfg.follow) {
+		if (!cfg.interval || flags == BINARY || cfg.action != 0xff) {
+			nvme_show_error("follow mode needs an interval and no action or binary output");
+			return -EINVAL;
+		}
+		if (cfg.store) {
+			err = nvme_pevent_store_open(&ps, store_dir, true);
+			if (err) {
+				nvme_show_error("%s: %s", store_dir, nvme_strerror(-err));
+				return err;
+			}
+		}
+		err = pevent_follow(dev, cfg.interval, cfg.store ? &ps : NULL);
+		nvme_pevent_store_close(&ps);
+		if (err > 0)
+			nvme_show_status(err);
+		else if (err < 0)
+			nvme_show_error("persistent event log: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	pevent = nvme_alloc(sizeof(*pevent));
+	if (!pevent)
 		return -ENOMEM;
 
-	err = nvme_identify_iocs_ns_csi_user_data_format(dev_fd(dev), cfg.lba_format_index,
-							 cfg.uuid_index, NVME_CSI_NVM, nvm_ns);
-	if (!err)
-		nvme_show_nvm_id_ns(nvm_ns, 0, ns, cfg.lba_format_index, true, flags);
-	else if (err > 0)
+	err = nvme_cli_get_log_persistent_event(dev, cfg.action,
+						sizeof(*pevent), pevent);
+	if (err < 0) {
+		nvme_show_error("persistent event log: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
 		nvme_show_status(err);
-	else
-		nvme_show_perror("NVM identify namespace for specific LBA format");
+		return err;
+	}
+
+	if (cfg.action == NVME_PEVENT_LOG_RELEASE_CTX) {
+		printf("Releasing Persistent Event Log Context\n");
+		return 0;
+	}
+
+	if (!cfg.log_len && cfg.action != NVME_PEVENT_LOG_EST_CTX_AND_READ) {
+		cfg.log_len = le64_to_cpu(pevent->tll);
+	} else if (!cfg.log_len && cfg.action == NVME_PEVENT_LOG_EST_CTX_AND_READ) {
+		printf("Establishing Persistent Event Log Context\n");
+		return 0;
+	}
+
+	/*
+	 * if header already read with context establish action 0x1,
+	 * action shall not be 0x1 again in the subsequent request,
+	 * until the current context is released by issuing action
+	 * with 0x2, otherwise throws command sequence error, make
+	 * it as zero to read the log page
+	 */
+	if (cfg.action == NVME_PEVENT_LOG_EST_CTX_AND_READ)
+		cfg.action = NVME_PEVENT_LOG_READ;
+
+	pevent_log_info = nvme_alloc_huge(cfg.log_len, &mh);
+	if (!pevent_log_info)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_persistent_event(dev, cfg.action,
+						cfg.log_len, pevent_log_info);
+	if (!err) {
+		err = nvme_cli_get_log_persistent_event(dev, cfg.action,
+							sizeof(*pevent),
+							pevent);
+		if (err < 0) {
+			nvme_show_error("persistent event log: %s", nvme_strerror(errno));
+			return err;
+		} else if (err) {
+			nvme_show_status(err);
+			return err;
+		}
+		pevent_collected = pevent_log_info;
+		if (pevent_collected->gen_number != pevent->gen_number) {
+			printf("Collected Persistent Event Log may be invalid,\n"
+			       "Re-read the log is required\n");
+			return -EINVAL;
+		}
+
+		nvme_show_persistent_event_log(pevent_log_info, cfg.action,
+			cfg.log_len, dev->name, flags);
+
+		if (cfg.store && cfg.log_len > sizeof(*pevent)) {
+			serr = nvme_pevent_store_open(&ps, store_dir, true);
+			if (!serr)
+				serr = nvme_pevent_store_append(&ps, pevent_log_info + sizeof(*pevent),
+								cfg.log_len - sizeof(*pevent));
+			nvme_pevent_store_close(&ps);
+			if (serr < 0) {
+				nvme_show_error("%s: %s", store_dir, nvme_strerror(-serr));
+				return serr;
+			}
+		}
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("persistent event log: %s", nvme_strerror(errno));
+	}
 
 	return err;
 }
 
-static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_endurance_event_agg_log(int argc, char **argv,
+		struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send Namespace Identification Descriptors command to the "
-		"given device, returns the namespace identification descriptors "
-		"of the specific namespace in either human-readable or binary format.";
-	const char *raw = "show descriptors in binary format";
+	const char *desc = "Retrieve Retrieve Predictable Latency "
+		"Event Aggregate page and prints it, for the given "
+		"device in either decoded format(default), json or binary.";
+	const char *log_entries = "Number of pending Endurance Group Event log Entries list";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *nsdescs = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ void *endurance_log = NULL;
 	enum nvme_print_flags flags;
+	__u32 log_size;
 	int err;
 
 	struct config {
-		__u32	namespace_id;
+		__u64	log_entries;
+		bool	rae;
 		bool	raw_binary;
 	};
 
 	struct config cfg = {
-		.namespace_id	= 0,
+		.log_entries	= 2044,
+		.rae		= false,
 		.raw_binary	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id_desired),
-		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,    raw));
+		  OPT_UINT("log-entries",  'e', &cfg.log_entries,   log_entries),
+		  OPT_FLAG("rae",          'r', &cfg.rae,           rae),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw_use));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -3670,68 +5905,67 @@ static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *p
 	if (cfg.raw_binary)
 		flags = BINARY;
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
+	if (!cfg.log_entries) {
+		nvme_show_error("non-zero log-entries is required param");
+		return -EINVAL;
+	}
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err < 0) {
+		nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
+		nvme_show_error("could not identify controller");
+		return -ENODEV;
 	}
 
-	nsdescs = nvme_alloc(sizeof(*nsdescs));
-	if (!nsdescs)
+	cfg.log_entries = min(cfg.log_entries, le16_to_cpu(ctrl->endgidmax));
+	log_size = sizeof(__u64) + cfg.log_entries * sizeof(__u16);
+
+	endurance_log = nvme_alloc(log_size);
+	if (!endurance_log)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_ns_descs(dev, cfg.namespace_id, nsdescs);
+	err = nvme_cli_get_log_endurance_grp_evt(dev, cfg.rae, 0, log_size,
+						 endurance_log);
 	if (!err)
-		nvme_show_id_ns_descs(nsdescs, cfg.namespace_id, flags);
+		nvme_show_endurance_group_event_agg_log(endurance_log, cfg.log_entries, log_size,
+							dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		nvme_show_error("endurance group event aggregate log page: %s",
+				nvme_strerror(errno));
 
 	return err;
 }
 
-static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_lba_status_log(int argc, char **argv,
+		struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify Namespace command to the "
-		"given device, returns properties of the specified namespace "
-		"in either human-readable or binary format. Can also return "
-		"binary vendor-specific namespace attributes.";
-	const char *force = "Return this namespace, even if not attached (1.2 devices only)";
-	const char *vendor_specific = "dump binary vendor fields";
+	const char *desc = "Retrieve Get LBA Status Info Log and prints it, "
+		"for the given device in either decoded format(default),json or binary.";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_free_ void *lba_status = NULL;
 	enum nvme_print_flags flags;
+	__u32 lslplen;
 	int err;
 
 	struct config {
-		__u32	namespace_id;
-		bool	force;
-		bool	vendor_specific;
-		bool	raw_binary;
-		bool	human_readable;
+		bool	rae;
 	};
 
 	struct config cfg = {
-		.namespace_id		= 0,
-		.force			= false,
-		.vendor_specific	= false,
-		.raw_binary		= false,
-		.human_readable		= false,
+		.rae		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
-		  OPT_FLAG("force",             0, &cfg.force,           force),
-		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
-		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
-		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+		  OPT_FLAG("rae",          'r', &cfg.rae,           rae));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -3743,70 +5977,45 @@ static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plug
 		return err;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
-
-	if (cfg.vendor_specific)
-		flags |= VS;
-
-	if (cfg.human_readable)
-		flags |= VERBOSE;
-
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+	err = nvme_cli_get_log_lba_status(dev, true, 0, sizeof(__u32),
+					  &lslplen);
+	if (err < 0) {
+		nvme_show_error("lba status log page: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
+		nvme_show_status(err);
+		return err;
 	}
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	lba_status = nvme_alloc(lslplen);
+	if (!lba_status)
 		return -ENOMEM;
 
-	if (cfg.force)
-		err = nvme_cli_identify_allocated_ns(dev, cfg.namespace_id, ns);
-	else
-		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
-
+	err = nvme_cli_get_log_lba_status(dev, cfg.rae, 0, lslplen, lba_status);
 	if (!err)
-		nvme_show_id_ns(ns, cfg.namespace_id, 0, false, flags);
+		nvme_show_lba_status_log(lba_status, lslplen, dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		nvme_show_error("lba status log page: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
-				     struct plugin *plugin)
+static int get_resv_notif_log(int argc, char **argv,
+	struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an I/O Command Set Independent Identify "
-		"Namespace command to the given device, returns properties of the "
-		"specified namespace in human-readable or binary or json format.";
 
-	_cleanup_free_ struct nvme_id_independent_id_ns *ns = NULL;
+	const char *desc = "Retrieve Reservation Notification "
+		"log page and prints it, for the given "
+		"device in either decoded format(default), json or binary.";
+
+	_cleanup_free_ struct nvme_resv_notification_log *resv = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	enum nvme_print_flags flags;
-	int err = -1;
+	int err;
 
-	struct config {
-		__u32	namespace_id;
-		bool	raw_binary;
-		bool	human_readable;
-	};
-
-	struct config cfg = {
-		.namespace_id	= 0,
-		.raw_binary	= false,
-		.human_readable	= false,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
-		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
-		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+	NVME_ARGS(opts);
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -3818,97 +6027,91 @@ static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
 		return err;
 	}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
-
-	if (cfg.human_readable)
-		flags |= VERBOSE;
-
-	if (!cfg.namespace_id) {
-		err = cfg.namespace_id = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_perror("get-namespace-id");
-			return err;
-		}
-	}
-
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	resv = nvme_alloc(sizeof(*resv));
+	if (!resv)
 		return -ENOMEM;
 
-	err = nvme_identify_independent_identify_ns(dev_fd(dev), cfg.namespace_id, ns);
+	err = nvme_cli_get_log_reservation(dev, false, resv);
 	if (!err)
-		nvme_show_cmd_set_independent_id_ns(ns, cfg.namespace_id, flags);
+		nvme_show_resv_notif_log(resv, dev->name, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("I/O command set independent identify namespace: %s",
-				nvme_strerror(errno));
+		nvme_show_error("resv notifi log: %s", nvme_strerror(errno));
 
 	return err;
+
 }
 
-static int id_ns_granularity(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * The boot partition data with its header in a single read, for
+ * controllers without log page offsets.
+ */
+static int get_boot_part_log_whole(struct nvme_dev *dev, __u8 lsp,
+				   struct nvme_boot_partition *boot, __u32 bpsz,
+				   int output, const char *file_name,
+				   enum nvme_print_flags flags)
 {
-	const char *desc = "Send an Identify Namespace Granularity List command to the "
-		"given device, returns namespace granularity list "
-		"in either human-readable or binary format.";
-
-	_cleanup_free_ struct nvme_id_ns_granularity_list *granularity_list = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
+	_cleanup_free_ __u8 *bp_log = NULL;
 	int err;
 
-	NVME_ARGS(opts);
+	bp_log = nvme_alloc(sizeof(*boot) + bpsz);
+	if (!bp_log)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
+	err = nvme_cli_get_log_boot_partition(dev, false, lsp,
+					      sizeof(*boot) + bpsz,
+					      (struct nvme_boot_partition *)bp_log);
+	if (err > 0) {
+		nvme_show_status(err);
 		return err;
-
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
+	} else if (err < 0) {
+		nvme_show_error("boot partition log: %s", nvme_strerror(errno));
 		return err;
 	}
 
-	granularity_list = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
-	if (!granularity_list)
-		return -ENOMEM;
+	nvme_show_boot_part_log(bp_log, dev->name, sizeof(*boot), flags);
 
-	err = nvme_identify_ns_granularity(dev_fd(dev), granularity_list);
-	if (!err)
-		nvme_show_id_ns_granularity_list(granularity_list, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify namespace granularity: %s", nvme_strerror(errno));
+	if (write(output, bp_log + sizeof(*boot), bpsz) != (ssize_t)bpsz) {
+		fprintf(stderr, "Failed to flush all data to file!\n");
+		return -EIO;
+	}
+	printf("Data flushed into file %s\n", file_name);
 
-	return err;
+	return 0;
 }
 
-static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_boot_part_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send an Identify NVM Set List command to the "
-		"given device, returns entries for NVM Set identifiers greater "
-		"than or equal to the value specified CDW11.NVMSETID "
-		"in either binary format or json format";
-	const char *nvmset_id = "NVM Set Identify value";
+	const char *desc = "Retrieve Boot Partition "
+		"log page and prints it, for the given "
+		"device in either decoded format(default), json or binary.";
+	const char *fname = "boot partition data output file name";
+	const char *progress = "show a progress bar and the achieved throughput";
 
-	_cleanup_free_ struct nvme_id_nvmset_list *nvmset = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_boot_partition *boot = NULL;
 	enum nvme_print_flags flags;
-	int err;
+	int err = -1;
+	_cleanup_file_ int output = -1;
+	__u32 bpsz = 0, xfer_len;
 
 	struct config {
-		__u16	nvmset_id;
+		__u8	lsp;
+		char	*file_name;
+		bool	progress;
 	};
 
 	struct config cfg = {
-		.nvmset_id	= 0,
+		.lsp		= 0,
+		.file_name	= NULL,
+		.progress	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("nvmset_id",    'i', &cfg.nvmset_id,     nvmset_id));
+		  OPT_BYTE("lsp",          's', &cfg.lsp,           lsp),
+		  OPT_FILE("output-file",  'f', &cfg.file_name,     fname),
+		  OPT_FLAG("progress",     'P', &cfg.progress,      progress));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -3920,144 +6123,163 @@ static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *
 		return err;
 	}
 
-	nvmset = nvme_alloc(sizeof(*nvmset));
-	if (!nvmset)
+	if (!cfg.file_name) {
+		nvme_show_error("Please provide an output file!");
+		return -1;
+	}
+
+	if (cfg.lsp > 127) {
+		nvme_show_error("invalid lsp param: %u", cfg.lsp);
+		return -1;
+	}
+
+	output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (output < 0) {
+		nvme_show_error("Failed to open output file %s: %s!",
+				cfg.file_name, strerror(errno));
+		return output;
+	}
+
+	boot = nvme_alloc(sizeof(*boot));
+	if (!boot)
 		return -ENOMEM;
 
-	err = nvme_identify_nvmset_list(dev_fd(dev), cfg.nvmset_id, nvmset);
-	if (!err)
-		nvme_show_id_nvmset(nvmset, cfg.nvmset_id, flags);
-	else if (err > 0)
+	err = nvme_cli_get_log_boot_partition(dev, false, cfg.lsp,
+					      sizeof(*boot), boot);
+	if (err < 0) {
+		nvme_show_error("boot partition log: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
 		nvme_show_status(err);
-	else
-		nvme_show_error("identify nvm set list: %s", nvme_strerror(errno));
+		return err;
+	}
 
-	return err;
-}
+	bpsz = (boot->bpinfo & 0x7fff) * 128 * 1024;
 
-static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send an Identify UUID List command to the "
-		"given device, returns list of supported Vendor Specific UUIDs "
-		"in either human-readable or binary format.";
-	const char *raw = "show uuid in binary format";
-	const char *human_readable = "show uuid in readable format";
+	/* without byte offsets the data can only follow the header in one read */
+	if (bpsz && !log_offset_supported(dev))
+		return get_boot_part_log_whole(dev, cfg.lsp, boot, bpsz, output,
+					       cfg.file_name, flags);
 
-	_cleanup_free_ struct nvme_id_uuid_list *uuid_list = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
+	err = get_max_xfer_len(dev, &xfer_len);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		return err;
+	}
 
-	struct config {
-		bool	raw_binary;
-		bool	human_readable;
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_BOOT_PARTITION,
+		.nsid		= NVME_NSID_NONE,
+		.lsp		= cfg.lsp,
+		.lpo		= sizeof(*boot),
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= bpsz,
+		.log		= NULL,
+		.result		= NULL,
 	};
 
-	struct config cfg = {
-		.raw_binary	= false,
-		.human_readable	= false,
-	};
+	if (bpsz) {
+		err = get_log_to_file(dev, &args, xfer_len, output,
+				      cfg.progress && flags == NORMAL ? "boot-part-log" : NULL);
+		if (err > 0) {
+			nvme_show_status(err);
+			return err;
+		} else if (err < 0) {
+			nvme_show_error("boot partition log: %s", nvme_strerror(-err));
+			return err;
+		}
+	}
 
-	NVME_ARGS(opts,
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+	nvme_show_boot_part_log(boot, dev->name, sizeof(*boot), flags);
+	printf("Data flushed into file %s\n", cfg.file_name);
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	return 0;
+}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
-	}
+/*
+ * Read the @len bytes of the log in MDTS sized chunks. Every chunk but the
+ * last only reads the measurement, the action of @lsp is taken with the
+ * last one, once the rest of the log was returned.
+ */
+static int get_phy_rx_eom_log_chunked(struct nvme_dev *dev, __u8 lsp, __u16 controller,
+				      __u32 len, struct nvme_phy_rx_eom_log *log)
+{
+	__u32 xfer_len = 0, split = 0;
+	int err;
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+	if (log_offset_supported(dev)) {
+		err = get_max_xfer_len(dev, &xfer_len);
+		if (err)
+			return err;
+		if (len > xfer_len)
+			split = (len - 1) / xfer_len * xfer_len;
+	}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_PHY_RX_EOM,
+		.nsid		= NVME_NSID_NONE,
+		.lsp		= lsp & 0xf3,
+		.lsi		= controller,
+		.lpo		= 0,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= split,
+		.log		= log,
+		.result		= NULL,
+	};
 
-	uuid_list = nvme_alloc(sizeof(*uuid_list));
-	if (!uuid_list)
-		return -ENOMEM;
+	if (split) {
+		err = nvme_cli_get_log_page(dev, xfer_len, &args);
+		if (err)
+			return err;
+	}
 
-	err = nvme_identify_uuid(dev_fd(dev), uuid_list);
-	if (!err)
-		nvme_show_id_uuid_list(uuid_list, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("identify UUID list: %s", nvme_strerror(errno));
+	args.lsp = lsp;
+	args.lpo = split;
+	args.len = len - split;
+	args.log = (__u8 *)log + split;
 
-	return err;
+	return nvme_cli_get_log_page(dev, len - split, &args);
 }
 
-static int id_iocs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_phy_rx_eom_log(int argc, char **argv, struct command *cmd,
+		struct plugin *plugin)
 {
-	const char *desc = "Send an Identify Command Set Data command to "
-		"the given device, returns properties of the specified controller "
-		"in either human-readable or binary format.";
-	const char *controller_id = "identifier of desired controller";
-
-	_cleanup_free_ struct nvme_id_iocs *iocs = NULL;
+	const char *desc = "Retrieve Physical Interface Receiver Eye Opening "
+		"Measurement log for the given device in decoded format "
+		"(default), json or binary.";
+	const char *controller = "Target Controller ID.";
+	_cleanup_buf_ struct nvme_buf buf = { 0 };
+	struct nvme_phy_rx_eom_log *phy_rx_eom_log;
+	size_t phy_rx_eom_log_len;
+	enum nvme_print_flags flags;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	int err = -1;
+	__u8 lsp_tmp;
 
 	struct config {
-		__u16	cntid;
+		__u8	lsp;
+		__u16	controller;
 	};
 
 	struct config cfg = {
-		.cntid	= 0xffff,
+		.lsp		= 0,
+		.controller	= NVME_LOG_LSI_NONE,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("controller-id", 'c', &cfg.cntid, controller_id));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
-
-	iocs = nvme_alloc(sizeof(*iocs));
-	if (!iocs)
-		return -ENOMEM;
-
-	err = nvme_identify_iocs(dev_fd(dev), cfg.cntid, iocs);
-	if (!err) {
-		printf("NVMe Identify I/O Command Set:\n");
-		nvme_show_id_iocs(iocs, 0);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_error("NVMe Identify I/O Command Set: %s", nvme_strerror(errno));
-	}
-
-	return err;
-}
-
-static int id_domain(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Send an Identify Domain List command to the "
-		"given device, returns properties of the specified domain "
-		"in either normal|json|binary format.";
-	const char *domain_id = "identifier of desired domain";
-
-	_cleanup_free_ struct nvme_id_domain_list *id_domain = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
-
-	struct config {
-		__u16	dom_id;
-	};
-
-	struct config cfg = {
-		.dom_id		= 0xffff,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_SHRT("dom-id",         'd', &cfg.dom_id,         domain_id));
+		  OPT_BYTE("lsp",        's', &cfg.lsp,        lsp),
+		  OPT_SHRT("controller", 'c', &cfg.controller, controller));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4069,141 +6291,83 @@ static int id_domain(int argc, char **argv, struct command *cmd, struct plugin *
 		return err;
 	}
 
-	id_domain = nvme_alloc(sizeof(*id_domain));
-	if (!id_domain)
-		return -ENOMEM;
-
-	err = nvme_identify_domain_list(dev_fd(dev), cfg.dom_id, id_domain);
-	if (!err) {
-		printf("NVMe Identify command for Domain List is successful:\n");
-		printf("NVMe Identify Domain List:\n");
-		nvme_show_id_domain_list(id_domain, flags);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		nvme_show_error("NVMe Identify Domain List: %s", nvme_strerror(errno));
+	if (cfg.lsp > 127) {
+		nvme_show_error("invalid lsp param: %u", cfg.lsp);
+		return -1;
+	} else if ((cfg.lsp & 3) == 3) {
+		nvme_show_error("invalid measurement quality: %u", cfg.lsp & 3);
+		return -1;
+	} else if ((cfg.lsp & 12) == 12) {
+		nvme_show_error("invalid action: %u", cfg.lsp & 12);
+		return -1;
 	}
 
-	return err;
-}
-
-static int get_ns_id(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Get namespace ID of a the block device.";
+	/* Fetching header to calculate total log length */
+	phy_rx_eom_log_len = sizeof(struct nvme_phy_rx_eom_log);
+	phy_rx_eom_log = nvme_buf_get(&buf, phy_rx_eom_log_len);
+	if (!phy_rx_eom_log)
+		return -ENOMEM;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	unsigned int nsid;
-	int err;
+	/* Just read measurement, take given action when fetching full log */
+	lsp_tmp = cfg.lsp & 0xf3;
 
-	NVME_ARGS(opts);
+	err = nvme_cli_get_log_phy_rx_eom(dev, lsp_tmp, cfg.controller, phy_rx_eom_log_len,
+					  phy_rx_eom_log);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("phy-rx-eom-log: %s", nvme_strerror(errno));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
 		return err;
-
-	err = nvme_get_nsid(dev_fd(dev), &nsid);
-	if (err < 0) {
-		nvme_show_error("get namespace ID: %s", nvme_strerror(errno));
-		return -errno;
 	}
 
-	printf("%s: namespace-id:%d\n", dev->name, nsid);
-
-	return 0;
-}
-
-static int virtual_mgmt(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "The Virtualization Management command is supported by primary controllers "
-		"that support the Virtualization Enhancements capability. This command is used for:\n"
-		"  1. Modifying Flexible Resource allocation for the primary controller\n"
-		"  2. Assigning Flexible Resources for secondary controllers\n"
-		"  3. Setting the Online and Offline state for secondary controllers";
-	const char *cntlid = "Controller Identifier(CNTLID)";
-	const char *rt = "Resource Type(RT): [0,1]\n"
-		"0h: VQ Resources\n"
-		"1h: VI Resources";
-	const char *act = "Action(ACT): [1,7,8,9]\n"
-		"1h: Primary Flexible\n"
-		"7h: Secondary Offline\n"
-		"8h: Secondary Assign\n"
-		"9h: Secondary Online";
-	const char *nr = "Number of Controller Resources(NR)";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u32 result;
-	int err;
-
-	struct config {
-		__u16	cntlid;
-		__u8	rt;
-		__u8	act;
-		__u16	nr;
-	};
-
-	struct config cfg = {
-		.cntlid	= 0,
-		.rt	= 0,
-		.act	= 0,
-		.nr	= 0,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_UINT("cntlid", 'c', &cfg.cntlid, cntlid),
-		  OPT_BYTE("rt",     'r', &cfg.rt,     rt),
-		  OPT_BYTE("act",    'a', &cfg.act,    act),
-		  OPT_SHRT("nr",     'n', &cfg.nr,     nr));
+	if (phy_rx_eom_log->eomip == NVME_PHY_RX_EOM_COMPLETED)
+		phy_rx_eom_log_len = le16_to_cpu(phy_rx_eom_log->hsize) +
+				     le32_to_cpu(phy_rx_eom_log->dsize) *
+				     le16_to_cpu(phy_rx_eom_log->nd);
+	else
+		phy_rx_eom_log_len = le16_to_cpu(phy_rx_eom_log->hsize);
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	phy_rx_eom_log = nvme_buf_resize(&buf, phy_rx_eom_log_len);
+	if (!phy_rx_eom_log)
+		return -ENOMEM;
 
-	struct nvme_virtual_mgmt_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.act		= cfg.act,
-		.rt		= cfg.rt,
-		.cntlid		= cfg.cntlid,
-		.nr		= cfg.nr,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= &result,
-	};
-	err = nvme_virtual_mgmt(&args);
+	err = get_phy_rx_eom_log_chunked(dev, cfg.lsp, cfg.controller,
+					 phy_rx_eom_log_len, phy_rx_eom_log);
 	if (!err)
-		printf("success, Number of Controller Resources Modified (NRM):%#x\n", result);
+		nvme_show_phy_rx_eom_log(phy_rx_eom_log, cfg.controller, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("virt-mgmt: %s", nvme_strerror(errno));
+		nvme_show_error("phy-rx-eom-log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_media_unit_stat_log(int argc, char **argv, struct command *cmd,
+				   struct plugin *plugin)
 {
-	const char *cntlid = "Controller ID";
-	const char *desc = "Send an Identify Primary Controller Capabilities "
-		"command to the given device and report the information in a "
-		"decoded format (default), json or binary.";
+	const char *desc = "Retrieve the configuration and wear of media units and print it";
 
-	_cleanup_free_ struct nvme_primary_ctrl_cap *caps = NULL;
+	_cleanup_free_ struct nvme_media_unit_stat_log *mus = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	enum nvme_print_flags flags;
-	int err;
+	int err = -1;
 
 	struct config {
-		__u16	cntlid;
-		bool	human_readable;
+		__u16	domainid;
+		bool	raw_binary;
 	};
 
 	struct config cfg = {
-		.cntlid		= 0,
-		.human_readable	= false,
+		.domainid	= 0,
+		.raw_binary	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("cntlid",         'c', &cfg.cntlid, cntlid),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info));
+		  OPT_UINT("domain-id",     'd', &cfg.domainid, domainid),
+		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary, raw_use));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4215,50 +6379,47 @@ static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct
 		return err;
 	}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	caps = nvme_alloc(sizeof(*caps));
-	if (!caps)
+	mus = nvme_alloc(sizeof(*mus));
+	if (!mus)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_primary_ctrl(dev, cfg.cntlid, caps);
+	err = nvme_cli_get_log_media_unit_stat(dev, cfg.domainid, mus);
 	if (!err)
-		nvme_show_primary_ctrl_cap(caps, flags);
+		nvme_show_media_unit_stat_log(mus, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("identify primary controller capabilities: %s",
-				nvme_strerror(errno));
+		nvme_show_error("media unit status log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_supp_cap_config_log(int argc, char **argv, struct command *cmd,
+				   struct plugin *plugin)
 {
-	const char *desc =
-	    "Show secondary controller list associated with the primary controller of the given device.";
-	const char *controller = "lowest controller identifier to display";
-	const char *num_entries = "number of entries to retrieve";
+	const char *desc = "Retrieve the list of Supported Capacity Configuration Descriptors";
 
-	_cleanup_free_ struct nvme_secondary_ctrl_list *sc_list = NULL;
+	_cleanup_free_ struct nvme_supported_cap_config_list_log *cap_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	enum nvme_print_flags flags;
-	int err;
+	int err = -1;
 
 	struct config {
-		__u16	cntid;
-		__u32	num_entries;
+		__u16	domainid;
+		bool	raw_binary;
 	};
 
 	struct config cfg = {
-		.cntid		= 0,
-		.num_entries	= ARRAY_SIZE(sc_list->sc_entry),
+		.domainid	= 0,
+		.raw_binary	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
-		  OPT_UINT("num-entries",  'e', &cfg.num_entries,   num_entries));
+		  OPT_UINT("domain-id",     'd', &cfg.domainid,       domainid),
+		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,     raw_use));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -4270,1419 +6431,11307 @@ static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struc
 		return err;
 	}
 
-	if (!cfg.num_entries) {
-		nvme_show_error("non-zero num-entries is required param");
-		return -EINVAL;
-	}
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	sc_list = nvme_alloc(sizeof(*sc_list));
-	if (!sc_list)
+	cap_log = nvme_alloc(sizeof(*cap_log));
+	if (!cap_log)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_secondary_ctrl_list(dev, cfg.cntid, sc_list);
+	err = nvme_cli_get_log_support_cap_config_list(dev, cfg.domainid,
+						       cap_log);
 	if (!err)
-		nvme_show_list_secondary_ctrl(sc_list, cfg.num_entries, flags);
+		nvme_show_supported_cap_config_log(cap_log, flags);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("id secondary controller list: %s", nvme_strerror(errno));
+		nvme_show_perror("supported capacity configuration list log");
 
 	return err;
 }
 
-static void intr_self_test(int signum)
+static int io_mgmt_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	printf("\nInterrupted device self-test operation by %s\n", strsignal(signum));
-
-	errno = EINTR;
-}
+	const char *desc = "I/O Management Send";
+	const char *data = "optional file for data (default stdin)";
 
-static int sleep_self_test(unsigned int seconds)
-{
-	errno = 0;
-
-	sleep(seconds);
-
-	if (errno)
-		return -errno;
-
-	return 0;
-}
-
-static int wait_self_test(struct nvme_dev *dev)
-{
-	static const char spin[] = {'-', '\\', '|', '/' };
-	_cleanup_free_ struct nvme_self_test_log *log = NULL;
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	int err, i = 0, p = 0, cnt = 0;
-	int wthr;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *buf = NULL;
+	int err = -1;
+	int dfd = STDIN_FILENO;
 
-	signal(SIGINT, intr_self_test);
+	struct config {
+		__u16 mos;
+		__u8  mo;
+		__u32 namespace_id;
+		char  *file;
+		__u32 data_len;
+	};
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+	struct config cfg = {
+		.mos = 0,
+	};
 
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
-		return -ENOMEM;
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_SHRT("mos",           's', &cfg.mos,            mos),
+		  OPT_BYTE("mo",            'm', &cfg.mo,             mo),
+		  OPT_FILE("data",          'd', &cfg.file,           data),
+		  OPT_UINT("data-len",      'l', &cfg.data_len,       buf_len));
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err) {
-		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
 		return err;
-	}
-
-	wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
-
-	printf("Waiting for self test completion...\n");
-	while (true) {
-		printf("\r[%.*s%c%.*s] %3d%%", p / 2, dash, spin[i % 4], 49 - p / 2, space, p);
-		fflush(stdout);
-		err = sleep_self_test(1);
-		if (err)
-			return err;
 
-		err = nvme_cli_get_log_device_self_test(dev, log);
-		if (err) {
-			printf("\n");
-			if (err < 0)
-				perror("self test log\n");
-			else
-				nvme_show_status(err);
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
 			return err;
 		}
+	}
 
-		if (++cnt > wthr) {
-			nvme_show_error("no progress for %d seconds, stop waiting", wthr);
-			return -EIO;
-		}
-
-		if (log->completion == 0 && p > 0) {
-			printf("\r[%.*s] %3d%%\n", 50, dash, 100);
-			break;
-		}
+	if (cfg.data_len) {
+		buf = nvme_alloc(cfg.data_len);
+		if (!buf)
+			return -ENOMEM;
+	}
 
-		if (log->completion < p) {
-			printf("\n");
-				nvme_show_error("progress broken");
-				return -EIO;
-		} else if (log->completion != p) {
-			p = log->completion;
-			cnt = 0;
+	if (cfg.file) {
+		dfd = open(cfg.file, O_RDONLY);
+		if (dfd < 0) {
+			nvme_show_perror(cfg.file);
+			return -errno;
 		}
-
-		i++;
 	}
 
-	return 0;
-}
-
-static void abort_self_test(struct nvme_dev_self_test_args *args)
-{
-	int err;
+	err = read(dfd, buf, cfg.data_len);
+	if (err < 0) {
+		nvme_show_perror("read");
+		goto close_fd;
+	}
 
-	args->stc = NVME_DST_STC_ABORT;
+	struct nvme_io_mgmt_send_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.mos		= cfg.mos,
+		.mo		= cfg.mo,
+		.data_len	= cfg.data_len,
+		.data		= buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	};
 
-	err = nvme_dev_self_test(args);
+	err = nvme_io_mgmt_send(&args);
 	if (!err)
-		printf("Aborting device self-test operation\n");
+		printf("io-mgmt-send: Success, mos:%u mo:%u nsid:%d\n",
+			cfg.mos, cfg.mo, cfg.namespace_id);
 	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+		nvme_show_perror("io-mgmt-send");
+
+close_fd:
+	if (cfg.file)
+		close(dfd);
+	return err;
 }
 
-static int device_self_test(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int io_mgmt_recv(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Implementing the device self-test feature "
-		"which provides the necessary log to determine the state of the device";
-	const char *namespace_id =
-	    "Indicate the namespace in which the device self-test has to be carried out";
-	const char *self_test_code =
-		"This field specifies the action taken by the device self-test command :\n"
-		"0h Show current state of device self-test operation\n"
-		"1h Start a short device self-test operation\n"
-		"2h Start a extended device self-test operation\n"
-		"eh Start a vendor specific device self-test operation\n"
-		"fh Abort the device self-test operation";
-	const char *wait = "Wait for the test to finish";
+	const char *desc = "I/O Management Receive";
+	const char *data = "optional file for data (default stdout)";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	_cleanup_free_ void *buf = NULL;
+	int err = -1;
+	_cleanup_file_ int dfd = -1;
 
 	struct config {
-		__u32	namespace_id;
-		__u8	stc;
-		bool	wait;
+		__u16 mos;
+		__u8  mo;
+		__u32 namespace_id;
+		char  *file;
+		__u32 data_len;
 	};
 
 	struct config cfg = {
-		.namespace_id	= NVME_NSID_ALL,
-		.stc		= NVME_ST_CODE_RESERVED,
-		.wait		= false,
+		.mos = 0,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
-		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code),
-		  OPT_FLAG("wait",           'w', &cfg.wait,         wait));
+		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_SHRT("mos",           's', &cfg.mos,            mos),
+		  OPT_BYTE("mo",            'm', &cfg.mo,             mo),
+		  OPT_FILE("data",          'd', &cfg.file,           data),
+		  OPT_UINT("data-len",      'l', &cfg.data_len,       buf_len));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.stc == NVME_ST_CODE_RESERVED) {
-		_cleanup_free_ struct nvme_self_test_log *log = NULL;
-
-		log = nvme_alloc(sizeof(*log));
-		if (!log)
-			return -ENOMEM;
-
-		err = nvme_cli_get_log_device_self_test(dev, log);
-		if (err) {
-			printf("\n");
-			if (err < 0)
-				perror("self test log\n");
-			else
-				nvme_show_status(err);
-		}
-
-		if (log->completion == 0) {
-			printf("no self test running\n");
-		} else {
-			if (cfg.wait)
-				err = wait_self_test(dev);
-			else
-				printf("progress %d%%\n", log->completion);
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
+			return err;
 		}
+	}
 
-		goto check_abort;
+	if (cfg.data_len) {
+		buf = nvme_alloc(cfg.data_len);
+		if (!buf)
+			return -ENOMEM;
 	}
 
-	struct nvme_dev_self_test_args args = {
+	struct nvme_io_mgmt_recv_args args = {
 		.args_size	= sizeof(args),
 		.fd		= dev_fd(dev),
 		.nsid		= cfg.namespace_id,
-		.stc		= cfg.stc,
+		.mos		= cfg.mos,
+		.mo		= cfg.mo,
+		.data_len	= cfg.data_len,
+		.data		= buf,
 		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
 	};
-	err = nvme_dev_self_test(&args);
+
+	err = nvme_io_mgmt_recv(&args);
 	if (!err) {
-		if (cfg.stc == NVME_ST_CODE_ABORT)
-			printf("Aborting device self-test operation\n");
-		else if (cfg.stc == NVME_ST_CODE_EXTENDED)
-			printf("Extended Device self-test started\n");
-		else if (cfg.stc == NVME_ST_CODE_SHORT)
-			printf("Short Device self-test started\n");
+		printf("io-mgmt-recv: Success, mos:%u mo:%u nsid:%d\n",
+			cfg.mos, cfg.mo, cfg.namespace_id);
 
-		if (cfg.wait && cfg.stc != NVME_ST_CODE_ABORT)
-			err = wait_self_test(dev);
+		if (cfg.file) {
+			dfd = open(cfg.file, O_WRONLY | O_CREAT, 0644);
+			if (dfd < 0) {
+				nvme_show_perror(cfg.file);
+				return -errno;
+			}
+
+			err = write(dfd, buf, cfg.data_len);
+			if (err < 0) {
+				nvme_show_perror("write");
+				return -errno;
+			}
+		} else {
+			d((unsigned char *)buf, cfg.data_len, 16, 1);
+		}
 	} else if (err > 0) {
 		nvme_show_status(err);
 	} else {
-		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+		nvme_show_perror("io-mgmt-recv");
 	}
 
-check_abort:
-	if (err == -EINTR)
-		abort_self_test(&args);
-
 	return err;
 }
 
-static int self_test_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * Stream the log in @xfer_len chunks into @output, a ring of small buffers
+ * replaces a buffer of the full log size and O_DIRECT output bypasses the
+ * page cache. A @progress name shows a progress bar and the throughput.
+ *
+ * Returns 0, a positive NVMe status or a negative errno.
+ */
+int get_log_to_file(struct nvme_dev *dev, struct nvme_get_log_args *args,
+		    __u32 xfer_len, int output, const char *progress)
 {
-	const char *desc = "Retrieve the self-test log for the given device and given test "
-		"(or optionally a namespace) in either decoded format (default) or binary.";
-	const char *dst_entries = "Indicate how many DST log entries to be retrieved, "
-		"by default all the 20 entries will be retrieved";
-
-	_cleanup_free_ struct nvme_self_test_log *log = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err;
-
-	struct config {
-		__u8	dst_entries;
-	};
-
-	struct config cfg = {
-		.dst_entries	= NVME_LOG_ST_MAX_RESULTS,
-	};
-
-	NVME_ARGS(opts,
-		  OPT_BYTE("dst-entries",  'e', &cfg.dst_entries,   dst_entries));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	struct nvme_get_log_args chunk;
+	__u64 offset = 0, size = args->len, start_ns;
+	struct nvme_stream s;
+	size_t len;
+	void *buf;
+	int err, serr;
+
+	err = nvme_stream_init(&s, output, NVME_STREAM_TO_FILE, size, xfer_len, 4);
 	if (err)
 		return err;
+	s.fsync = true;
+
+	start_ns = monotonic_ns();
+	while ((buf = nvme_stream_get(&s, &len))) {
+		chunk = *args;
+		chunk.lpo = args->lpo + offset;
+		/* only the last chunk may clear the asynchronous event */
+		chunk.rae = offset + len < size || args->rae;
+		chunk.len = len;
+		chunk.log = buf;
+
+		err = nvme_cli_get_log_page(dev, len, &chunk);
+		if (err) {
+			if (err < 0)
+				err = -errno;
+			break;
+		}
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+		nvme_stream_put(&s, len);
+		offset += len;
+		if (progress)
+			util_spinner(progress, (float)offset / size);
 	}
 
-	if (argconfig_parse_seen(opts, "verbose"))
-		flags |= VERBOSE;
-
-	log = nvme_alloc(sizeof(*log));
-	if (!log)
-		return -ENOMEM;
-
-	err = nvme_cli_get_log_device_self_test(dev, log);
-	if (!err)
-		nvme_show_self_test_log(log, cfg.dst_entries, 0, dev->name, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("self test log: %s", nvme_strerror(errno));
-
-	return err;
-}
-
-static int get_feature_id(struct nvme_dev *dev, struct feat_cfg *cfg,
-			  void **buf, __u32 *result)
-{
-	if (!cfg->data_len)
-		nvme_get_feature_length(cfg->feature_id, cfg->cdw11,
-					&cfg->data_len);
-
-	/* check for Extended Host Identifier */
-	if (cfg->feature_id == NVME_FEAT_FID_HOST_ID && (cfg->cdw11 & 0x1))
-		cfg->data_len = 16;
-
-	if (cfg->feature_id == NVME_FEAT_FID_FDP_EVENTS) {
-		cfg->data_len = 0xff * sizeof(__u16);
-		cfg->cdw11 |= 0xff << 16;
-	}
+	serr = nvme_stream_finish(&s, err != 0);
+	if (err)
+		return err;
 
-	if (cfg->sel == 3)
-		cfg->data_len = 0;
+	if (!serr && progress) {
+		__u64 us = (monotonic_ns() - start_ns) / NSEC_PER_USEC;
 
-	if (cfg->data_len) {
-		*buf = nvme_alloc(cfg->data_len - 1);
-		if (!*buf)
-			return -1;
+		printf("%llu bytes in %llu.%03llu ms (%.1f MiB/s)\n",
+		       (unsigned long long)size,
+		       (unsigned long long)(us / 1000), (unsigned long long)(us % 1000),
+		       us ? (double)size / us * 1000000 / (1024 * 1024) : 0.0);
 	}
 
-	struct nvme_get_features_args args = {
-		.args_size	= sizeof(args),
-		.fid		= cfg->feature_id,
-		.nsid		= cfg->namespace_id,
-		.sel		= cfg->sel,
-		.cdw11		= cfg->cdw11,
-		.uuidx		= cfg->uuid_index,
-		.data_len	= cfg->data_len,
-		.data		= *buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= result,
-	};
-	return nvme_cli_get_features(dev, &args);
+	return serr;
 }
 
-static int filter_out_flags(int status)
-{
-	return status & (NVME_GET(NVME_SCT_MASK, SCT) |
-			 NVME_GET(NVME_SC_MASK, SC));
-}
+struct get_log_ranges {
+	struct nvme_fanout *f;
+	struct nvme_fanout_cmd *last;	/* held back until the others are done */
+	unsigned int pending;
+	int err;
+};
 
-static void get_feature_id_print(struct feat_cfg cfg, int err, __u32 result,
-				 void *buf)
+static void get_log_range_done(struct nvme_fanout_cmd *fc, int status)
 {
-	int status = filter_out_flags(err);
-	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+	struct get_log_ranges *r = fc->priv;
 
-	if (!err) {
-		if (!cfg.raw_binary || !buf) {
-			nvme_feature_show(cfg.feature_id, cfg.sel, result);
-			if (cfg.sel == 3)
-				nvme_show_select_result(cfg.feature_id, result);
-			else if (cfg.human_readable)
-				nvme_feature_show_fields(cfg.feature_id, result,
-							 buf);
-			else if (buf)
-				d(buf, cfg.data_len, 16, 1);
-		} else if (buf) {
-			d_raw(buf, cfg.data_len);
-		}
-	} else if (err > 0) {
-		if (!nvme_status_equals(status, type, NVME_SC_INVALID_FIELD) &&
-		    !nvme_status_equals(status,  type, NVME_SC_INVALID_NS))
-			nvme_show_status(err);
-	} else {
-		nvme_show_error("get-feature: %s", nvme_strerror(errno));
+	if (status && !r->err)
+		r->err = status;
+
+	/* after a failure the event stays, the last one isn't sent */
+	if (--r->pending == 1 && r->last) {
+		if (!r->err)
+			r->err = nvme_fanout_queue(r->f, r->last, r->last->fd,
+						   get_log_range_done, r);
+		r->last = NULL;
 	}
 }
 
-static int get_feature_id_changed(struct nvme_dev *dev, struct feat_cfg cfg,
-				  bool changed)
+/*
+ * Fetch the log in @xfer_len chunks, @depth of them in flight at a time,
+ * each into its own offset range of args->log. Without RAE the last chunk
+ * clears the asynchronous event, it's only sent once all the others have
+ * completed.
+ *
+ * Returns 0, a positive NVMe status or -1 with errno set, like
+ * nvme_cli_get_log_page().
+ */
+static int get_log_concurrent(struct nvme_dev *dev, struct nvme_get_log_args *args,
+			      __u32 xfer_len, unsigned int depth)
 {
+	_cleanup_free_ struct nvme_fanout_cmd *fcs = NULL;
+	struct get_log_ranges r = { 0 };
+	struct nvme_get_log_args chunk;
+	unsigned int i, nr;
+	struct nvme_fanout f;
+	__u64 off;
 	int err;
-	int err_def = 0;
-	__u32 result;
-	__u32 result_def;
-	void *buf = NULL;
-	void *buf_def = NULL;
-
-	if (changed)
-		cfg.sel = 0;
 
-	err = get_feature_id(dev, &cfg, &buf, &result);
-
-	if (!err && changed) {
-		cfg.sel = 1;
-		err_def = get_feature_id(dev, &cfg, &buf_def, &result_def);
+	nr = (args->len + xfer_len - 1) / xfer_len;
+	fcs = calloc(nr, sizeof(*fcs));
+	if (!fcs) {
+		errno = ENOMEM;
+		return -1;
 	}
 
-	if (changed)
-		cfg.sel = 8;
-
-	if (err || !changed || err_def || result != result_def ||
-	    (buf && buf_def && !strcmp(buf, buf_def)))
-		get_feature_id_print(cfg, err, result, buf);
-
-	free(buf);
-	free(buf_def);
-
-	return err;
-}
-
-static int get_feature_ids(struct nvme_dev *dev, struct feat_cfg cfg)
-{
-	int err = 0;
-	int i;
-	int feat_max = 0x100;
-	int feat_num = 0;
-	bool changed = false;
-	int status = 0;
-	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
-
-	if (cfg.sel == 8)
-		changed = true;
+	err = nvme_fanout_init(&f, depth, depth);
+	if (err) {
+		errno = -err;
+		return -1;
+	}
+	r.f = &f;
+	r.pending = nr;
 
-	if (cfg.feature_id)
-		feat_max = cfg.feature_id + 1;
+	for (i = 0, off = 0; i < nr; i++, off += xfer_len) {
+		chunk = *args;
+		chunk.lpo = args->lpo + off;
+		chunk.rae = i < nr - 1 || args->rae;
+		chunk.len = min(xfer_len, args->len - off);
+		chunk.log = (unsigned char *)args->log + off;
+		nvme_fanout_get_log_cmd(&fcs[i].cmd, &chunk);
+		fcs[i].fd = dev_fd(dev);
 
-	for (i = cfg.feature_id; i < feat_max; i++, feat_num++) {
-		cfg.feature_id = i;
-		err = get_feature_id_changed(dev, cfg, changed);
-		if (!err)
-			continue;
-		status = filter_out_flags(err);
-		if (nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
-			continue;
-		if (!nvme_status_equals(status, type, NVME_SC_INVALID_NS))
+		if (!chunk.rae && nr > 1) {
+			r.last = &fcs[i];
 			break;
-		nvme_show_error_status(err, "get-feature:%#0*x (%s)", cfg.feature_id ? 4 : 2,
-				       cfg.feature_id, nvme_feature_to_string(cfg.feature_id));
+		}
+
+		err = nvme_fanout_queue(&f, &fcs[i], dev_fd(dev),
+					get_log_range_done, &r);
+		if (err)
+			goto out;
 	}
 
-	if (feat_num == 1 && nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
-		nvme_show_status(err);
+	err = nvme_fanout_run(&f);
+out:
+	nvme_fanout_exit(&f);
+	err = err ?: r.err;
+	if (err < 0) {
+		errno = -err;
+		return -1;
+	}
 
 	return err;
 }
 
-static int get_feature(int argc, char **argv, struct command *cmd,
-		       struct plugin *plugin)
+static int get_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Read operating parameters of the "
-		"specified controller. Operating parameters are grouped "
-		"and identified by Feature Identifiers; each Feature "
-		"Identifier contains one or more attributes that may affect "
-		"behavior of the feature. Each Feature has three possible "
-		"settings: default, saveable, and current. If a Feature is "
-		"saveable, it may be modified by set-feature. Default values "
-		"are vendor-specific and not changeable. Use set-feature to "
-		"change saveable Features.";
-	const char *raw = "show feature in binary format";
-	const char *feature_id = "feature identifier";
-	const char *sel = "[0-3,8]: current/default/saved/supported/changed";
-	const char *cdw11 = "feature specific dword 11";
-	const char *human_readable = "show feature in readable format";
+	const char *desc = "Retrieve desired number of bytes "
+		"from a given log on a specified device in either "
+		"hex-dump (default) or binary format";
+	const char *log_id = "identifier of log to retrieve";
+	const char *log_len = "how many bytes to retrieve";
+	const char *aen = "result of the aen, use to override log id";
+	const char *lpo = "log page offset specifies the location within a log page from where to start returning data";
+	const char *lsi = "log specific identifier specifies an identifier that is required for a particular log page";
+	const char *raw = "output in raw format";
+	const char *offset_type = "offset type";
+	const char *xfer_len = "read chunk size (default 4k, 'auto' derives it from MDTS)";
+	const char *fname = "stream the raw log to this file instead of stdout";
+	const char *depth = "chunks in flight at a time, each at its own offset (default 1)";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ unsigned char *log = NULL;
+	_cleanup_file_ int output = -1;
+	bool xfer_auto, ranges;
 	int err;
 
-	struct feat_cfg cfg = {
-		.feature_id	= 0,
-		.namespace_id	= 0,
-		.sel		= 0,
-		.data_len	= 0,
+	struct config {
+		__u32	namespace_id;
+		__u8	log_id;
+		__u32	log_len;
+		__u32	aen;
+		__u64	lpo;
+		__u8	lsp;
+		__u16	lsi;
+		bool	rae;
+		__u8	uuid_index;
+		bool	raw_binary;
+		__u8	csi;
+		bool	ot;
+		__u32	xfer_len;
+		char	*file_name;
+		__u32	queue_depth;
+	};
+
+	struct config cfg = {
+		.namespace_id	= NVME_NSID_ALL,
+		.log_id		= 0xff,
+		.log_len	= 0,
+		.aen		= 0,
+		.lpo		= NVME_LOG_LPO_NONE,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.lsi		= NVME_LOG_LSI_NONE,
+		.rae		= false,
+		.uuid_index	= NVME_UUID_NONE,
 		.raw_binary	= false,
-		.cdw11		= 0,
-		.uuid_index	= 0,
-		.human_readable	= false,
+		.csi		= NVME_CSI_NVM,
+		.ot		= false,
+		.xfer_len	= 4096,
+		.file_name	= NULL,
+		.queue_depth	= 1,
+	};
+
+	OPT_VALS(xfer_vals) = {
+		VAL_UINT("auto", 0),
+		VAL_END()
 	};
 
 	NVME_ARGS(opts,
-		  OPT_BYTE("feature-id",     'f', &cfg.feature_id,     feature_id),
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_BYTE("sel",            's', &cfg.sel,            sel),
-		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
-		  OPT_UINT("cdw11",          'c', &cfg.cdw11,          cdw11),
-		  OPT_BYTE("uuid-index",     'U', &cfg.uuid_index,     uuid_index_specify),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
+		  OPT_BYTE("log-id",       'i', &cfg.log_id,       log_id),
+		  OPT_UINT("log-len",      'l', &cfg.log_len,      log_len),
+		  OPT_UINT("aen",          'a', &cfg.aen,          aen),
+		  OPT_SUFFIX("lpo",        'L', &cfg.lpo,          lpo),
+		  OPT_BYTE("lsp",          's', &cfg.lsp,          lsp),
+		  OPT_SHRT("lsi",          'S', &cfg.lsi,          lsi),
+		  OPT_FLAG("rae",          'r', &cfg.rae,          rae),
+		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,   uuid_index),
+		  OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
+		  OPT_BYTE("csi",          'y', &cfg.csi,          csi),
+		  OPT_FLAG("ot",           'O', &cfg.ot,           offset_type),
+		  OPT_UINT("xfer-len",     'x', &cfg.xfer_len,     xfer_len, xfer_vals),
+		  OPT_FILE("output-file",  'f', &cfg.file_name,    fname),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  depth));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (!argconfig_parse_seen(opts, "namespace-id")) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			if (errno != ENOTTY) {
-				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-				return err;
-			}
-			cfg.namespace_id = NVME_NSID_ALL;
-		}
+	if (cfg.aen) {
+		cfg.log_len = 4096;
+		cfg.log_id = (cfg.aen >> 16) & 0xff;
 	}
 
-	if (cfg.sel > 8) {
-		nvme_show_error("invalid 'select' param:%d", cfg.sel);
+	if (!cfg.log_len || cfg.log_len & 0x3) {
+		nvme_show_error("non-zero or non-dw alignment log-len is required param");
+		return -EINVAL;
+	}
+
+	if (cfg.lsp > 127) {
+		nvme_show_error("invalid lsp param");
 		return -EINVAL;
 	}
 
 	if (cfg.uuid_index > 127) {
-		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
-		return -1;
+		nvme_show_error("invalid uuid index param");
+		return -EINVAL;
 	}
 
-	nvme_show_init();
+	if (cfg.xfer_len % 4096) {
+		nvme_show_error("xfer-len argument invalid. It needs to be multiple of 4k");
+		return -EINVAL;
+	}
 
-	err = get_feature_ids(dev, cfg);
+	/*
+	 * With 'auto' start with the largest transfer the controller accepts,
+	 * but no larger than the log itself, and halve it if the driver or the
+	 * controller rejects the size.
+	 */
+	xfer_auto = !cfg.xfer_len;
+	if (xfer_auto) {
+		if (dev->type == NVME_DEV_MI || get_max_xfer_len(dev, &cfg.xfer_len))
+			cfg.xfer_len = 4096;
+		cfg.xfer_len = min(cfg.xfer_len, (cfg.log_len + 4095) & ~4095);
+		if (argconfig_parse_seen(opts, "verbose"))
+			printf("xfer-len: %u\n", cfg.xfer_len);
+	}
 
-	nvme_show_finish();
+	if (!cfg.queue_depth) {
+		nvme_show_error("queue-depth argument invalid. It needs to be at least 1");
+		return -EINVAL;
+	}
 
-	return err;
-}
+	ranges = cfg.queue_depth > 1 && cfg.log_len > cfg.xfer_len;
+	if (ranges && cfg.file_name) {
+		nvme_show_error("queue-depth and output-file can't be combined");
+		return -EINVAL;
+	}
 
-/*
- * Transfers one chunk of firmware to the device, and decodes & reports any
- * errors. Returns -1 on (fatal) error; signifying that the transfer should
- * be aborted.
- */
-static int fw_download_single(struct nvme_dev *dev, void *fw_buf,
-			      unsigned int fw_len, uint32_t offset,
-			      uint32_t len, bool progress, bool ignore_ovr)
-{
-	const unsigned int max_retries = 3;
-	bool retryable, ovr;
-	int err, try;
+	/* offsets in bytes, and only if the controller takes them */
+	if (ranges && (dev->type != NVME_DEV_DIRECT || cfg.ot ||
+		       !log_offset_supported(dev))) {
+		if (argconfig_parse_seen(opts, "verbose"))
+			printf("queue-depth: no byte offsets for this log, fetching serially\n");
+		ranges = false;
+	}
 
-	if (progress) {
-		printf("Firmware download: transferring 0x%08x/0x%08x bytes: %03d%%\r",
-		       offset, fw_len, (int)(100 * offset / fw_len));
+	if (cfg.file_name) {
+		/* bypass the page cache, not every file system supports that */
+		output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+		if (output < 0 && errno == EINVAL)
+			output = open(cfg.file_name, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (output < 0) {
+			err = -errno;
+			nvme_show_error("Failed to open output file %s: %s!",
+					cfg.file_name, strerror(-err));
+			return err;
+		}
+	} else {
+		log = nvme_alloc(cfg.log_len);
+		if (!log)
+			return -ENOMEM;
 	}
 
-	struct nvme_fw_download_args args = {
+	struct nvme_get_log_args args = {
 		.args_size	= sizeof(args),
-		.offset		= offset,
-		.data_len	= len,
-		.data		= fw_buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lid		= cfg.log_id,
+		.nsid		= cfg.namespace_id,
+		.lpo		= cfg.lpo,
+		.lsp		= cfg.lsp,
+		.lsi		= cfg.lsi,
+		.rae		= cfg.rae,
+		.uuidx		= cfg.uuid_index,
+		.csi		= cfg.csi,
+		.ot		= cfg.ot,
+		.len		= cfg.log_len,
+		.log		= log,
 		.result		= NULL,
 	};
 
-	for (try = 0; try < max_retries; try++) {
-		if (try > 0) {
-			fprintf(stderr, "retrying offset %x (%u/%u)\n",
-				offset, try, max_retries);
-		}
-
-		err = nvme_cli_fw_download(dev, &args);
-		if (!err)
-			return 0;
-
-		/*
-		 * don't retry if the NVMe-type error indicates Do Not Resend.
-		 */
-		retryable = !((err > 0) &&
-			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
-			(nvme_status_get_value(err) & NVME_SC_DNR));
-
-		/*
-		 * detect overwrite errors, which are handled differently
-		 * depending on ignore_ovr
-		 */
-		ovr = (err > 0) &&
-			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
-			(NVME_GET(err, SCT) == NVME_SCT_CMD_SPECIFIC) &&
-			(NVME_GET(err, SC) == NVME_SC_OVERLAPPING_RANGE);
-
-		if (ovr && ignore_ovr)
-			return 0;
-
-		/*
-		 * if we're printing progress, we'll need a newline to separate
-		 * error output from the progress data (which doesn't have a
-		 * \n), and flush before we write to stderr.
-		 */
-		if (progress) {
-			printf("\n");
-			fflush(stdout);
-		}
-
-		fprintf(stderr, "fw-download: error on offset 0x%08x/0x%08x\n",
-			offset, fw_len);
-
-		if (err < 0) {
-			fprintf(stderr, "fw-download: %s\n", nvme_strerror(errno));
-		} else {
+	if (cfg.file_name) {
+		err = get_log_to_file(dev, &args, cfg.xfer_len, output, NULL);
+		if (err > 0)
 			nvme_show_status(err);
-			if (ovr) {
-				/*
-				 * non-ignored ovr error: print a little extra info
-				 * about recovering
-				 */
-				fprintf(stderr,
-					"Use --ignore-ovr to ignore overwrite errors\n");
-
-				/*
-				 * We'll just be attempting more overwrites if
-				 * we retry. DNR will likely be set, but force
-				 * an exit anyway.
-				 */
-				retryable = false;
-			}
-		}
+		else if (err < 0)
+			nvme_show_error("log page: %s", nvme_strerror(-err));
+		return err;
+	}
 
-		if (!retryable)
+	while (true) {
+		if (ranges)
+			err = get_log_concurrent(dev, &args, cfg.xfer_len, cfg.queue_depth);
+		else
+			err = nvme_cli_get_log_page(dev, cfg.xfer_len, &args);
+		if (!xfer_auto || cfg.xfer_len <= 4096)
 			break;
+		if (err < 0 ? errno != EINVAL && errno != ENOMEM :
+		    !nvme_status_equals(err, NVME_STATUS_TYPE_NVME, NVME_SC_INVALID_FIELD))
+			break;
+		cfg.xfer_len = (cfg.xfer_len / 2) & ~4095;
+		if (argconfig_parse_seen(opts, "verbose"))
+			printf("xfer-len: retrying with %u\n", cfg.xfer_len);
+	}
+	if (!err) {
+		if (!cfg.raw_binary) {
+			printf("Device:%s log-id:%d namespace-id:%#x\n", dev->name, cfg.log_id,
+			       cfg.namespace_id);
+			d(log, cfg.log_len, 16, 1);
+		} else {
+			d_raw((unsigned char *)log, cfg.log_len);
+		}
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("log page: %s", nvme_strerror(errno));
 	}
 
-	return -1;
+	return err;
 }
 
-static int fw_download(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int sanitize_log(int argc, char **argv, struct command *command, struct plugin *plugin)
 {
-	const char *desc = "Copy all or part of a firmware image to "
-		"a controller for future update. Optionally, specify how "
-		"many KiB of the firmware to transfer at once. The offset will "
-		"start at 0 and automatically adjust based on xfer size "
-		"unless fw is split across multiple files. May be submitted "
-		"while outstanding commands exist on the Admin and IO "
-		"Submission Queues. Activate downloaded firmware with "
-		"fw-activate, and then reset the device to apply the downloaded firmware.";
-	const char *fw = "firmware file (required)";
-	const char *xfer = "transfer chunksize limit";
-	const char *offset = "starting dword offset, default 0";
-	const char *progress = "display firmware transfer progress";
-	const char *ignore_ovr = "ignore overwrite errors";
+	const char *desc = "Retrieve sanitize log and show it.";
 
+	_cleanup_free_ struct nvme_sanitize_log_page *sanitize_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
-	_cleanup_file_ int fw_fd = -1;
-	unsigned int fw_size, pos;
+	enum nvme_print_flags flags;
 	int err;
-	struct stat sb;
-	void *fw_buf;
-	struct nvme_id_ctrl ctrl = { 0 };
 
 	struct config {
-		char	*fw;
-		__u32	xfer;
-		__u32	offset;
-		bool	progress;
-		bool	ignore_ovr;
+		bool	rae;
+		bool	human_readable;
+		bool	raw_binary;
 	};
 
 	struct config cfg = {
-		.fw         = "",
-		.xfer       = 0,
-		.offset     = 0,
-		.progress   = false,
-		.ignore_ovr = false,
+		.rae		= false,
+		.human_readable	= false,
+		.raw_binary	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FILE("fw",         'f', &cfg.fw,         fw),
-		  OPT_UINT("xfer",       'x', &cfg.xfer,       xfer),
-		  OPT_UINT("offset",     'O', &cfg.offset,     offset),
-		  OPT_FLAG("progress",   'p', &cfg.progress,   progress),
-		  OPT_FLAG("ignore-ovr", 'i', &cfg.ignore_ovr, ignore_ovr));
+		  OPT_FLAG("rae",            'r', &cfg.rae,            rae),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_log));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	fw_fd = open(cfg.fw, O_RDONLY);
-	cfg.offset <<= 2;
-	if (fw_fd < 0) {
-		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw, strerror(errno));
-		return -EINVAL;
-	}
-
-	err = fstat(fw_fd, &sb);
+	err = validate_output_format(output_format_val, &flags);
 	if (err < 0) {
-		nvme_show_perror("fstat");
+		nvme_show_error("Invalid output format");
 		return err;
 	}
 
-	fw_size = sb.st_size;
-	if ((fw_size & 0x3) || (fw_size == 0)) {
-		nvme_show_error("Invalid size:%d for f/w image", fw_size);
-		return -EINVAL;
-	}
-
-	if (cfg.xfer == 0) {
-		err = nvme_cli_identify_ctrl(dev, &ctrl);
-		if (err) {
-			nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-			return err;
-		}
-		if (ctrl.fwug == 0 || ctrl.fwug == 0xff)
-			cfg.xfer = 4096;
-		else
-			cfg.xfer = ctrl.fwug * 4096;
-	} else if (cfg.xfer % 4096)
-		cfg.xfer = 4096;
+	if (cfg.raw_binary)
+		flags = BINARY;
 
-	if (ctrl.fwug && ctrl.fwug != 0xff && fw_size % cfg.xfer)
-		nvme_show_error("WARNING: firmware file size %u not conform to FWUG alignment %lu",
-				fw_size, cfg.xfer);
+	if (cfg.human_readable)
+		flags |= VERBOSE;
 
-	fw_buf = nvme_alloc_huge(fw_size, &mh);
-	if (!fw_buf)
+	sanitize_log = nvme_alloc(sizeof(*sanitize_log));
+	if (!sanitize_log)
 		return -ENOMEM;
 
-	if (read(fw_fd, fw_buf, fw_size) != ((ssize_t)(fw_size))) {
-		err = -errno;
-		nvme_show_error("read :%s :%s", cfg.fw, strerror(errno));
-		return err;
-	}
-
-	for (pos = 0; pos < fw_size; pos += cfg.xfer) {
-		cfg.xfer = min(cfg.xfer, fw_size - pos);
+	err = nvme_cli_get_log_sanitize(dev, cfg.rae, sanitize_log);
+	if (!err)
+		nvme_show_sanitize_log(sanitize_log, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("sanitize status log: %s", nvme_strerror(errno));
 
-		err = fw_download_single(dev, fw_buf + pos, fw_size,
-					 cfg.offset + pos, cfg.xfer,
-					 cfg.progress, cfg.ignore_ovr);
-		if (err)
-			break;
-	}
+	return err;
+}
 
-	if (!err) {
-		/* end the progress output */
-		if (cfg.progress)
-			printf("\n");
-		printf("Firmware download success\n");
-	}
-
-	return err;
-}
-
-static char *nvme_fw_status_reset_type(__u16 status)
+static int get_fid_support_effects_log(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
 {
-	switch (status & 0x7ff) {
-	case NVME_SC_FW_NEEDS_CONV_RESET:
-		return "conventional";
-	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
-		return "subsystem";
-	case NVME_SC_FW_NEEDS_RESET:
-		return "any controller";
-	default:
-		return "unknown";
-	}
-}
+	const char *desc = "Retrieve FID Support and Effects log and show it.";
 
-static bool fw_commit_support_mud(struct nvme_dev *dev)
-{
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
-	int err;
+	_cleanup_free_ struct nvme_fid_supported_effects_log *fid_support_log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return false;
+	struct config {
+		bool	human_readable;
+	};
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
+	struct config cfg = {
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log));
 
+	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
-		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-	else if (ctrl->frmw >> 5 & 0x1)
-		return true;
+		return err;
 
-	return false;
-}
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
 
-static void fw_commit_print_mud(struct nvme_dev *dev, __u32 result)
-{
-	if (!fw_commit_support_mud(dev))
-		return;
+	if (cfg.human_readable)
+		flags |= VERBOSE;
 
-	printf("Multiple Update Detected (MUD) Value: %u\n", result);
+	fid_support_log = nvme_alloc(sizeof(*fid_support_log));
+	if (!fid_support_log)
+		return -ENOMEM;
 
-	if (result & 0x1)
-		printf("Detected an overlapping firmware/boot partition image update command\n"
-		       "sequence due to processing a command from an Admin SQ on a controller\n");
+	err = nvme_cli_get_log_fid_supported_effects(dev, false, fid_support_log);
+	if (!err)
+		nvme_show_fid_support_effects_log(fid_support_log, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("fid support effects log: %s", nvme_strerror(errno));
 
-	if (result >> 1 & 0x1)
-		printf("Detected an overlapping firmware/boot partition image update command\n"
-		       "sequence due to processing a command from a Management Endpoint\n");
+	return err;
 }
 
-static int fw_commit(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_mi_cmd_support_effects_log(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
 {
-	const char *desc = "Verify downloaded firmware image and "
-		"commit to specific firmware slot. Device is not automatically "
-		"reset following firmware activation. A reset may be issued "
-		"with an 'echo 1 > /sys/class/nvme/nvmeX/reset_controller'. "
-		"Ensure nvmeX is the device you just activated before reset.";
-	const char *slot = "[0-7]: firmware slot for commit action";
-	const char *action = "[0-7]: commit action";
-	const char *bpid = "[0,1]: boot partition identifier, if applicable (default: 0)";
+	const char *desc = "Retrieve NVMe-MI Command Support and Effects log and show it.";
 
+	_cleanup_free_ struct nvme_mi_cmd_supported_effects_log *mi_cmd_support_log = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u32 result;
-	int err;
+	enum nvme_print_flags flags;
+	int err = -1;
 
 	struct config {
-		__u8	slot;
-		__u8	action;
-		__u8	bpid;
+		bool	human_readable;
 	};
 
 	struct config cfg = {
-		.slot	= 0,
-		.action	= 0,
-		.bpid	= 0,
+		.human_readable	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_BYTE("slot",   's', &cfg.slot,   slot),
-		  OPT_BYTE("action", 'a', &cfg.action, action),
-		  OPT_BYTE("bpid",   'b', &cfg.bpid,   bpid));
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_log));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.slot > 7) {
-		nvme_show_error("invalid slot:%d", cfg.slot);
-		return -EINVAL;
-	}
-	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
-		nvme_show_error("invalid action:%d", cfg.action);
-		return -EINVAL;
-	}
-	if (cfg.bpid > 1) {
-		nvme_show_error("invalid boot partition id:%d", cfg.bpid);
-		return -EINVAL;
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	struct nvme_fw_commit_args args = {
-		.args_size	= sizeof(args),
-		.slot		= cfg.slot,
-		.action		= cfg.action,
-		.bpid		= cfg.bpid,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= &result,
-	};
-	err = nvme_cli_fw_commit(dev, &args);
+	if (cfg.human_readable)
+		flags |= VERBOSE;
 
-	if (err < 0) {
-		nvme_show_error("fw-commit: %s", nvme_strerror(errno));
-	} else if (err != 0) {
-		__u32 val = nvme_status_get_value(err);
-		int type = nvme_status_get_type(err);
+	mi_cmd_support_log = nvme_alloc(sizeof(*mi_cmd_support_log));
+	if (!mi_cmd_support_log)
+		return -ENOMEM;
 
-		if (type == NVME_STATUS_TYPE_NVME) {
-			switch (val & 0x7ff) {
-			case NVME_SC_FW_NEEDS_CONV_RESET:
-			case NVME_SC_FW_NEEDS_SUBSYS_RESET:
-			case NVME_SC_FW_NEEDS_RESET:
-				printf("Success activating firmware action:%d slot:%d",
-				       cfg.action, cfg.slot);
-				if (cfg.action == 6 || cfg.action == 7)
-					printf(" bpid:%d", cfg.bpid);
-				printf(", but firmware requires %s reset\n",
-				       nvme_fw_status_reset_type(val));
-				break;
-			default:
-				nvme_show_status(err);
-				break;
-			}
-		} else {
-			nvme_show_status(err);
-		}
-	} else {
-		printf("Success committing firmware action:%d slot:%d",
-		       cfg.action, cfg.slot);
-		if (cfg.action == 6 || cfg.action == 7)
-			printf(" bpid:%d", cfg.bpid);
-		printf("\n");
-		fw_commit_print_mud(dev, result);
-	}
+	err = nvme_cli_get_log_mi_cmd_supported_effects(dev, false, mi_cmd_support_log);
+	if (!err)
+		nvme_show_mi_cmd_support_effects_log(mi_cmd_support_log, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("mi command support effects log: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int subsystem_reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int list_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Resets the NVMe subsystem";
+	const char *desc = "Show controller list information for the subsystem the "
+		"given device is part of, or optionally controllers attached to a specific namespace.";
+	const char *controller = "controller to display";
 
+	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
 	int err;
 
-	NVME_ARGS(opts);
+	struct config {
+		__u16	cntid;
+		__u32	namespace_id;
+	};
+
+	struct config cfg = {
+		.cntid		= 0,
+		.namespace_id	= NVME_NSID_NONE,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id_optional));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = nvme_subsystem_reset(dev_fd(dev));
+	err = validate_output_format(output_format_val, &flags);
 	if (err < 0) {
-		if (errno == ENOTTY)
-			nvme_show_error("Subsystem-reset: NVM Subsystem Reset not supported.");
-		else
-			nvme_show_error("Subsystem-reset: %s", nvme_strerror(errno));
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
+	cntlist = nvme_alloc(sizeof(*cntlist));
+	if (!cntlist)
+		return -ENOMEM;
+
+	if (cfg.namespace_id == NVME_NSID_NONE)
+		err = nvme_cli_identify_ctrl_list(dev, cfg.cntid, cntlist);
+	else
+		err = nvme_cli_identify_nsid_ctrl_list(dev, cfg.namespace_id,
+							cfg.cntid, cntlist);
+	if (!err)
+		nvme_show_list_ctrl(cntlist, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("id controller list: %s", nvme_strerror(errno));
+
 	return err;
 }
 
-static int reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int list_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Resets the NVMe controller\n";
+	const char *desc = "For the specified controller handle, show the "
+		"namespace list in the associated NVMe subsystem, optionally starting with a given nsid.";
+	const char *namespace_id = "first nsid returned list should start from";
+	const char *csi = "I/O command set identifier";
+	const char *all = "show all namespaces in the subsystem, whether attached or inactive";
 
+	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
 	int err;
 
-	NVME_ARGS(opts);
+	struct config {
+		__u32	namespace_id;
+		int	csi;
+		bool	all;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 1,
+		.csi		= -1,
+		.all		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
+		  OPT_INT("csi",           'y', &cfg.csi,           csi),
+		  OPT_FLAG("all",          'a', &cfg.all,           all));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = nvme_ctrl_reset(dev_fd(dev));
-	if (err < 0)
-		nvme_show_error("Reset: %s", nvme_strerror(errno));
-
-	return err;
-}
-
-static int ns_rescan(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Rescans the NVMe namespaces\n";
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	if (!cfg.namespace_id) {
+		nvme_show_error("invalid nsid parameter");
+		return -EINVAL;
+	}
 
-	NVME_ARGS(opts);
+	ns_list = nvme_alloc(sizeof(*ns_list));
+	if (!ns_list)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	struct nvme_identify_args args = {
+		.args_size	= sizeof(args),
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.data		= ns_list,
+		.nsid		= cfg.namespace_id - 1.
+	};
+	if (cfg.csi < 0) {
+		args.cns = cfg.all ? NVME_IDENTIFY_CNS_ALLOCATED_NS_LIST :
+			NVME_IDENTIFY_CNS_NS_ACTIVE_LIST;
+	} else {
+		args.cns = cfg.all ? NVME_IDENTIFY_CNS_CSI_ALLOCATED_NS_LIST :
+			NVME_IDENTIFY_CNS_CSI_NS_ACTIVE_LIST;
+		args.csi = cfg.csi;
+	}
 
-	err = nvme_ns_rescan(dev_fd(dev));
-	if (err < 0)
-		nvme_show_error("Namespace Rescan: %s\n", nvme_strerror(errno));
+	err = nvme_cli_identify(dev, &args);
+	if (!err)
+		nvme_show_list_ns(ns_list, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("id namespace list: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int sanitize_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Send a sanitize command.";
-	const char *no_dealloc_desc = "No deallocate after sanitize.";
-	const char *oipbp_desc = "Overwrite invert pattern between passes.";
-	const char *owpass_desc = "Overwrite pass count.";
-	const char *ause_desc = "Allow unrestricted sanitize exit.";
-	const char *sanact_desc = "Sanitize action: 1 = Exit failure mode, 2 = Start block erase, 3 = Start overwrite, 4 = Start crypto erase";
-	const char *ovrpat_desc = "Overwrite pattern.";
+	const char *desc = "Send an Identify Namespace command to the given "
+		"device, returns capability field properties of the specified "
+		"LBA Format index in  various formats.";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
 
 	struct config {
-		bool	no_dealloc;
-		bool	oipbp;
-		__u8	owpass;
-		bool	ause;
-		__u8	sanact;
-		__u32	ovrpat;
+		__u16	lba_format_index;
+		__u8	uuid_index;
 	};
 
 	struct config cfg = {
-		.no_dealloc	= false,
-		.oipbp		= false,
-		.owpass		= 0,
-		.ause		= false,
-		.sanact		= 0,
-		.ovrpat		= 0,
-	};
-
-	OPT_VALS(sanact) = {
-		VAL_BYTE("exit-failure", NVME_SANITIZE_SANACT_EXIT_FAILURE),
-		VAL_BYTE("start-block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
-		VAL_BYTE("start-overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
-		VAL_BYTE("start-crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
-		VAL_END()
+		.lba_format_index	= 0,
+		.uuid_index		= NVME_UUID_NONE,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("no-dealloc", 'd', &cfg.no_dealloc, no_dealloc_desc),
-		  OPT_FLAG("oipbp",      'i', &cfg.oipbp,      oipbp_desc),
-		  OPT_BYTE("owpass",     'n', &cfg.owpass,     owpass_desc),
-		  OPT_FLAG("ause",       'u', &cfg.ause,       ause_desc),
-		  OPT_BYTE("sanact",     'a', &cfg.sanact,     sanact_desc, sanact),
-		  OPT_UINT("ovrpat",     'p', &cfg.ovrpat,     ovrpat_desc));
+		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
+		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	switch (cfg.sanact) {
-	case NVME_SANITIZE_SANACT_EXIT_FAILURE:
-	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
-	case NVME_SANITIZE_SANACT_START_OVERWRITE:
-	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
-		break;
-	default:
-		nvme_show_error("Invalid Sanitize Action");
-		return -EINVAL;
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
 	}
 
-	if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_FAILURE) {
-		if (cfg.ause || cfg.no_dealloc) {
-			nvme_show_error("SANACT is Exit Failure Mode");
-			return -EINVAL;
-		}
-	}
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
 
-	if (cfg.sanact == NVME_SANITIZE_SANACT_START_OVERWRITE) {
-		if (cfg.owpass > 15) {
-			nvme_show_error("OWPASS out of range [0-15]");
-			return -EINVAL;
-		}
-	} else {
-		if (cfg.owpass || cfg.oipbp || cfg.ovrpat) {
-			nvme_show_error("SANACT is not Overwrite");
-			return -EINVAL;
-		}
-	}
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
 
-	struct nvme_sanitize_nvm_args args = {
-		.args_size	= sizeof(args),
-		.sanact		= cfg.sanact,
-		.ause		= cfg.ause,
-		.owpass		= cfg.owpass,
-		.oipbp		= cfg.oipbp,
-		.nodas		= cfg.no_dealloc,
-		.ovrpat		= cfg.ovrpat,
-		.result		= NULL,
-	};
-	err = nvme_cli_sanitize_nvm(dev, &args);
-	if (err < 0)
-		nvme_show_error("sanitize: %s", nvme_strerror(errno));
+	err = nvme_identify_ns_csi_user_data_format(dev_fd(dev),
+						    cfg.lba_format_index,
+						    cfg.uuid_index, NVME_CSI_NVM, ns);
+	if (!err)
+		nvme_show_id_ns(ns, 0, cfg.lba_format_index, true, flags);
 	else if (err > 0)
 		nvme_show_status(err);
+	else
+		nvme_show_perror("identify namespace for specific LBA format");
 
 	return err;
 }
 
-static int nvme_get_single_property(int fd, struct get_reg_config *cfg, __u64 *value)
+static int id_endurance_grp_list(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
 {
-	int err;
-	struct nvme_get_property_args args = {
-		.args_size	= sizeof(args),
-		.fd		= fd,
-		.offset		= cfg->offset,
-		.value		= value,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	const char *desc = "Show endurance group list information for the given endurance group id";
+	const char *endurance_grp_id = "Endurance Group ID";
+
+	_cleanup_free_ struct nvme_id_endurance_group_list *endgrp_list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
+
+	struct config {
+		__u16	endgrp_id;
 	};
 
-	err = nvme_get_property(&args);
-	if (!err)
-		return 0;
+	struct config cfg = {
+		.endgrp_id	= 0,
+	};
 
-	if (!cfg->fabrics &&
-	    nvme_status_equals(err, NVME_STATUS_TYPE_NVME, NVME_SC_INVALID_FIELD)) {
-		*value = -1;
-		return 0;
+	NVME_ARGS(opts,
+		  OPT_SHRT("endgrp-id",    'i', &cfg.endgrp_id,     endurance_grp_id));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("invalid output format");
+		return -EINVAL;
 	}
 
-	if (cfg->fabrics && err > 0)
+	endgrp_list = nvme_alloc(sizeof(*endgrp_list));
+	if (!endgrp_list)
+		return -ENOMEM;
+
+	err = nvme_identify_endurance_group_list(dev_fd(dev), cfg.endgrp_id, endgrp_list);
+	if (!err)
+		nvme_show_endurance_group_list(endgrp_list, flags);
+	else if (err > 0)
 		nvme_show_status(err);
 	else
-		nvme_show_error("get-property: %s", nvme_strerror(errno));
+		nvme_show_error("Id endurance group list: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static int nvme_get_properties(int fd, void **pbar, struct get_reg_config *cfg)
+static int delete_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	int err, size = getpagesize();
-	bool is_64bit = false;
-	__u64 value;
-	void *bar;
-	int offset;
+	const char *desc = "Delete the given namespace by "
+		"sending a namespace management command to "
+		"the provided device. All controllers should be detached from "
+		"the namespace prior to namespace deletion. A namespace ID "
+		"becomes inactive when that namespace is detached or, if "
+		"the namespace is not already inactive, once deleted.";
+	const char *namespace_id = "namespace to delete";
 
-	bar = malloc(size);
-	if (!bar) {
-		nvme_show_error("malloc: %s", strerror(errno));
-		return -errno;
-	}
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
 
-	memset(bar, 0xff, size);
-	for (offset = NVME_REG_CAP; offset <= NVME_REG_CMBSZ;
-	     offset += is_64bit ? sizeof(uint64_t) : sizeof(uint32_t)) {
-		cfg->offset = offset;
-		err = nvme_get_single_property(fd, cfg, &value);
-		if (err)
-			break;
+	struct config {
+		__u32	namespace_id;
+		__u32	timeout;
+	};
 
-		is_64bit = nvme_is_64bit_reg(cfg->offset);
-		if (is_64bit)
-			*(uint64_t *)(bar + cfg->offset) = value;
-		else
-			*(uint32_t *)(bar + cfg->offset) = value;
-	}
+	struct config cfg = {
+		.namespace_id	= 0,
+		.timeout	= 120000,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
+		  OPT_UINT("timeout",      't', &cfg.timeout,      timeout));
 
+	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
-		free(bar);
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	err = nvme_cli_ns_mgmt_delete(dev, cfg.namespace_id);
+	if (!err)
+		printf("%s: Success, deleted nsid:%d\n", cmd->name, cfg.namespace_id);
+	else if (err > 0)
+		nvme_show_status(err);
 	else
-		*pbar = bar;
+		nvme_show_error("delete namespace: %s", nvme_strerror(errno));
 
 	return err;
 }
 
-static void *mmap_registers(struct nvme_dev *dev, bool writable)
+static int nvme_attach_ns(int argc, char **argv, int attach, const char *desc, struct command *cmd)
 {
-	char path[512];
-	void *membase;
-	int fd;
-	int prot = PROT_READ;
-
-	if (writable)
-		prot |= PROT_WRITE;
-
-	sprintf(path, "/sys/class/nvme/%s/device/resource0", dev->name);
-	fd = open(path, writable ? O_RDWR : O_RDONLY);
-	if (fd < 0) {
-		if (log_level >= LOG_DEBUG)
-			nvme_show_error("%s did not find a pci resource, open failed %s",
-					dev->name, strerror(errno));
-		return NULL;
-	}
-
-	membase = mmap(NULL, getpagesize(), prot, MAP_SHARED, fd, 0);
-	if (membase == MAP_FAILED) {
-		if (log_level >= LOG_DEBUG) {
-			fprintf(stderr, "%s failed to map. ", dev->name);
-			fprintf(stderr, "Did your kernel enable CONFIG_IO_STRICT_DEVMEM?\n");
-		}
-		membase = NULL;
-	}
-
-	close(fd);
-	return membase;
-}
+	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
+	_cleanup_free_ __u16 *ctrlist = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err, num, i, list[2048];
 
-static int show_registers(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Reads and shows the defined NVMe controller registers\n"
-		"in binary or human-readable format";
-	const char *human_readable =
-	    "show info in readable format in case of output_format == normal";
+	const char *namespace_id = "namespace to attach";
+	const char *cont = "optional comma-sep controller id list";
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	bool fabrics = false;
-	void *bar;
-	int err;
+	struct config {
+		__u32	namespace_id;
+		char	*cntlist;
+	};
 
-	struct get_reg_config cfg = {
-		.human_readable	= false,
+	struct config cfg = {
+		.namespace_id	= 0,
+		.cntlist	= "",
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
+		  OPT_LIST("controllers",  'c', &cfg.cntlist,      cont));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	if (!cfg.namespace_id) {
+		nvme_show_error("%s: namespace-id parameter required", cmd->name);
+		return -EINVAL;
 	}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
+	num = argconfig_parse_comma_sep_array(cfg.cntlist, list, 2047);
+	if (!num)
+		fprintf(stderr, "warning: empty controller-id list will result in no actual change in namespace attachment\n");
 
-	bar = mmap_registers(dev, false);
-	if (!bar) {
-		err = nvme_get_properties(dev_fd(dev), &bar, &cfg);
-		if (err)
-			return err;
-		fabrics = true;
+	if (num == -1) {
+		nvme_show_error("%s: controller id list is malformed", cmd->name);
+		return -EINVAL;
 	}
 
-	nvme_show_ctrl_registers(bar, fabrics, flags);
-	if (fabrics)
-		free(bar);
+	cntlist = nvme_alloc(sizeof(*cntlist));
+	if (!cntlist)
+		return -ENOMEM;
+
+	ctrlist = nvme_alloc(sizeof(*ctrlist) * 2048);
+	if (!ctrlist)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++)
+		ctrlist[i] = (__u16)list[i];
+
+	nvme_init_ctrl_list(cntlist, num, ctrlist);
+
+	if (attach)
+		err = nvme_cli_ns_attach_ctrls(dev, cfg.namespace_id,
+					       cntlist);
 	else
-		munmap(bar, getpagesize());
+		err = nvme_cli_ns_detach_ctrls(dev, cfg.namespace_id,
+					       cntlist);
 
-	return 0;
+	if (!err)
+		printf("%s: Success, nsid:%d\n", cmd->name, cfg.namespace_id);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_perror(attach ? "attach namespace" : "detach namespace");
+
+	return err;
 }
 
-int get_reg_size(int offset)
+static int attach_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	return nvme_is_64bit_reg(offset) ? sizeof(uint64_t) : sizeof(uint32_t);
+	const char *desc = "Attach the given namespace to the "
+		"given controller or comma-sep list of controllers. ID of the "
+		"given namespace becomes active upon attachment to a "
+		"controller. A namespace must be attached to a controller "
+		"before IO commands may be directed to that namespace.";
+
+	return nvme_attach_ns(argc, argv, 1, desc, cmd);
 }
 
-static bool is_reg_selected(struct get_reg_config *cfg, int offset)
+static int detach_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	switch (offset) {
-	case NVME_REG_CAP:
-		return cfg->cap;
-	case NVME_REG_VS:
-		return cfg->vs;
-	case NVME_REG_INTMS:
-		return cfg->intms;
-	case NVME_REG_INTMC:
-		return cfg->intmc;
-	case NVME_REG_CC:
-		return cfg->cc;
-	case NVME_REG_CSTS:
-		return cfg->csts;
-	case NVME_REG_NSSR:
-		return cfg->nssr;
-	case NVME_REG_AQA:
-		return cfg->aqa;
-	case NVME_REG_ASQ:
-		return cfg->asq;
-	case NVME_REG_ACQ:
-		return cfg->acq;
-	case NVME_REG_CMBLOC:
-		return cfg->cmbloc;
-	case NVME_REG_CMBSZ:
-		return cfg->cmbsz;
-	case NVME_REG_BPINFO:
-		return cfg->bpinfo;
-	case NVME_REG_BPRSEL:
-		return cfg->bprsel;
-	case NVME_REG_BPMBL:
-		return cfg->bpmbl;
-	case NVME_REG_CMBMSC:
-		return cfg->cmbmsc;
-	case NVME_REG_CMBSTS:
-		return cfg->cmbsts;
-	case NVME_REG_CMBEBS:
-		return cfg->cmbebs;
-	case NVME_REG_CMBSWTP:
-		return cfg->cmbswtp;
-	case NVME_REG_NSSD:
-		return cfg->nssd;
-	case NVME_REG_CRTO:
-		return cfg->crto;
-	case NVME_REG_PMRCAP:
-		return cfg->pmrcap;
-	case NVME_REG_PMRCTL:
-		return cfg->pmrctl;
-	case NVME_REG_PMRSTS:
-		return cfg->pmrsts;
-	case NVME_REG_PMREBS:
-		return cfg->pmrebs;
-	case NVME_REG_PMRSWTP:
-		return cfg->pmrswtp;
-	case NVME_REG_PMRMSCL:
-		return cfg->pmrmscl;
-	case NVME_REG_PMRMSCU:
-		return cfg->pmrmscu;
-	default:
-		break;
-	}
+	const char *desc = "Detach the given namespace from the "
+		"given controller; de-activates the given namespace's ID. A "
+		"namespace must be attached to a controller before IO "
+		"commands may be directed to that namespace.";
 
-	return false;
+	return nvme_attach_ns(argc, argv, 0, desc, cmd);
 }
 
-static int get_register_properties(int fd, void **pbar, struct get_reg_config *cfg)
+static int parse_lba_num_si(struct nvme_dev *dev, const char *opt,
+			    const char *val, __u8 flbas, __u64 *num, __u32 align)
 {
-	int offset = NVME_REG_CRTO;
-	__u64 value;
-	int size;
-	int err;
-	void *bar;
-	struct nvme_get_property_args args = {
-		.args_size = sizeof(args),
-		.fd = fd,
-		.value = &value,
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
+	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	__u32 nsid = 1;
+	unsigned int remainder;
+	char *endptr;
+	int err = -EINVAL;
+	int i;
+	int lbas;
+
+	struct nvme_identify_args args = {
+		.args_size	= sizeof(args),
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.cns		= NVME_IDENTIFY_CNS_NS_ACTIVE_LIST,
+		.nsid		= nsid - 1.
 	};
 
-	size = offset + get_reg_size(offset);
-	bar = malloc(size);
-	if (!bar) {
-		nvme_show_error("malloc: %s", strerror(errno));
-		return -1;
-	}
+	if (!val)
+		return 0;
 
-	for (offset = NVME_REG_CAP; offset <= NVME_REG_CRTO; offset += get_reg_size(offset)) {
-		if ((cfg->offset != offset && !is_reg_selected(cfg, offset)) ||
-		    !nvme_is_fabrics_reg(offset))
-			continue;
+	if (*num) {
+		nvme_show_error(
+		    "Invalid specification of both %s and its SI argument, please specify only one",
+		    opt);
+		return err;
+	}
 
-		args.offset = offset;
-		err = nvme_get_property(&args);
-		if (nvme_status_equals(err, NVME_STATUS_TYPE_NVME, NVME_SC_INVALID_FIELD)) {
-			value = -1;
-		} else if (err) {
-			nvme_show_error("get-property: %s", nvme_strerror(errno));
-			free(bar);
-			return err;
-		}
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
 
-		if (nvme_is_64bit_reg(offset))
-			*(uint64_t *)(bar + offset) = value;
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		if (err < 0)
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
 		else
-			*(uint32_t *)(bar + offset) = value;
+			nvme_show_status(err);
+		return err;
 	}
 
-	*pbar = bar;
+	ns_list = nvme_alloc(sizeof(*ns_list));
+	if (!ns_list)
+		return -ENOMEM;
+	args.data = ns_list;
 
-	return 0;
-}
+	if ((ctrl->oacs & 0x8) >> 3)
+		nsid = NVME_NSID_ALL;
+	else {
+		err = nvme_cli_identify(dev, &args);
+		if (err) {
+			if (err < 0)
+				nvme_show_error("identify namespace list: %s",
+						nvme_strerror(errno));
+			else
+				nvme_show_status(err);
+			return err;
+		}
+		nsid = le32_to_cpu(ns_list->ns[0]);
+	}
 
-bool nvme_is_ctrl_reg(int offset)
-{
-	switch (offset) {
-	case NVME_REG_CAP:
-	case NVME_REG_VS:
-	case NVME_REG_INTMS:
-	case NVME_REG_INTMC:
-	case NVME_REG_CC:
-	case NVME_REG_CSTS:
-	case NVME_REG_NSSR:
-	case NVME_REG_AQA:
-	case NVME_REG_ASQ:
-	case NVME_REG_ACQ:
-	case NVME_REG_CMBLOC:
-	case NVME_REG_CMBSZ:
-	case NVME_REG_BPINFO:
-	case NVME_REG_BPRSEL:
-	case NVME_REG_BPMBL:
-	case NVME_REG_CMBMSC:
-	case NVME_REG_CMBSTS:
-	case NVME_REG_CMBEBS:
-	case NVME_REG_CMBSWTP:
-	case NVME_REG_NSSD:
-	case NVME_REG_CRTO:
-	case NVME_REG_PMRCAP:
-	case NVME_REG_PMRCTL:
-	case NVME_REG_PMRSTS:
-	case NVME_REG_PMREBS:
-	case NVME_REG_PMRSWTP:
-	case NVME_REG_PMRMSCL:
-	case NVME_REG_PMRMSCU:
-		return true;
-	default:
-		break;
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, nsid, ns);
+	if (err) {
+		if (err < 0)
+			nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		else
+			nvme_show_status(err);
+		return err;
 	}
 
-	return false;
+	i = flbas & NVME_NS_FLBAS_LOWER_MASK;
+	lbas = (1 << ns->lbaf[i].ds) + ns->lbaf[i].ms;
+
+	if (suffix_si_parse(val, &endptr, (uint64_t *)num)) {
+		nvme_show_error("Expected long suffixed integer argument for '%s-si' but got '%s'!",
+				opt, val);
+		return -errno;
+	}
+
+	if (endptr[0]) {
+		remainder = *num % align;
+		if (remainder)
+			*num += align - remainder;
+	}
+
+	if (endptr[0] != '\0')
+		*num /= lbas;
+
+	return 0;
 }
 
-static bool get_register_offset(void *bar, bool fabrics, struct get_reg_config *cfg,
-				enum nvme_print_flags flags)
+/*
+ * The namespace size and capacity granularity for LBA format @flbas, only
+ * lowered from the defaults in @align_nsze and @align_ncap.
+ */
+static int ns_granularity(struct nvme_dev *dev, struct nvme_id_ctrl *id, __u8 flbas,
+			  __u32 *align_nsze, __u32 *align_ncap)
 {
-	bool offset_matched = cfg->offset >= 0;
-	int offset;
+	_cleanup_free_ struct nvme_id_ns_granularity_list *gr_list = NULL;
+	struct nvme_id_ns_granularity_desc *desc;
+	int index = flbas;
 
-	if (offset_matched)
-		nvme_show_ctrl_register(bar, fabrics, cfg->offset, flags);
+	if (!(id->ctratt & NVME_CTRL_CTRATT_NAMESPACE_GRANULARITY))
+		return 0;
 
-	for (offset = NVME_REG_CAP; offset <= NVME_REG_PMRMSCU; offset += get_reg_size(offset)) {
-		if (!nvme_is_ctrl_reg(offset) || offset == cfg->offset || !is_reg_selected(cfg, offset))
-			continue;
-		nvme_show_ctrl_register(bar, fabrics, offset, flags);
-		if (!offset_matched)
-			offset_matched = true;
+	gr_list = nvme_alloc(sizeof(*gr_list));
+	if (!gr_list)
+		return -ENOMEM;
+
+	if (nvme_identify_ns_granularity(dev_fd(dev), gr_list))
+		return 0;
+
+	/* FIXME: add a proper bitmask to libnvme */
+	if (!(gr_list->attributes & 1)) {
+		/* Only the first descriptor is valid */
+		index = 0;
+	} else if (index > gr_list->num_descriptors) {
+		/*
+		 * The descriptor will contain only zeroes
+		 * so we don't need to read it.
+		 */
+		return 0;
 	}
+	desc = &gr_list->entry[index];
 
-	return offset_matched;
+	if (desc->nszegran && desc->nszegran < *align_nsze)
+		*align_nsze = desc->nszegran;
+	if (desc->ncapgran && desc->ncapgran < *align_ncap)
+		*align_ncap = desc->ncapgran;
+
+	return 0;
 }
 
-static int get_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int create_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Reads and shows the defined NVMe controller register.\n"
-		"Register offset must be one of:\n"
-		"CAP=0x0, VS=0x8, INTMS=0xc, INTMC=0x10, CC=0x14, CSTS=0x1c,\n"
-		"NSSR=0x20, AQA=0x24, ASQ=0x28, ACQ=0x30, CMBLOC=0x38,\n"
-		"CMBSZ=0x3c, BPINFO=0x40, BPRSEL=0x44, BPMBL=0x48, CMBMSC=0x50,\n"
-		"CMBSTS=0x58, CRTO=0x68, PMRCAP=0xe00, PMRCTL=0xe04,\n"
-		"PMRSTS=0xe08, PMREBS=0xe0c, PMRSWTP=0xe10, PMRMSCL=0xe14, PMRMSCU=0xe18";
-	const char *human_readable = "show register in readable format";
-	const char *cap = "CAP=0x0 register offset";
-	const char *vs = "VS=0x8 register offset";
-	const char *cmbloc = "CMBLOC=0x38 register offset";
-	const char *cmbsz = "CMBSZ=0x3c register offset";
-	const char *bpinfo = "BPINFO=0x40 register offset";
-	const char *cmbsts = "CMBSTS=0x58 register offset";
-	const char *cmbebs = "CMBEBS=0x5c register offset";
-	const char *cmbswtp = "CMBSWTP=0x60 register offset";
-	const char *crto = "CRTO=0x68 register offset";
-	const char *pmrcap = "PMRCAP=0xe00 register offset";
-	const char *pmrsts = "PMRSTS=0xe08 register offset";
-	const char *pmrebs = "PMREBS=0xe0c register offset";
-	const char *pmrswtp = "PMRSWTP=0xe10 register offset";
-	const char *pmrmscl = "PMRMSCL=0xe14 register offset";
-	const char *pmrmscu = "PMRMSCU=0xe18 register offset";
+	const char *desc = "Send a namespace management command "
+		"to the specified device to create a namespace with the given "
+		"parameters. The next available namespace ID is used for the "
+		"create operation. Note that create-ns does not attach the "
+		"namespace to a controller, the attach-ns command is needed.";
+	const char *nsze = "size of ns (NSZE)";
+	const char *ncap = "capacity of ns (NCAP)";
+	const char *flbas =
+	    "Formatted LBA size (FLBAS), if entering this value ignore \'block-size\' field";
+	const char *dps = "data protection settings (DPS)";
+	const char *nmic = "multipath and sharing capabilities (NMIC)";
+	const char *anagrpid = "ANA Group Identifier (ANAGRPID)";
+	const char *nvmsetid = "NVM Set Identifier (NVMSETID)";
+	const char *endgid = "Endurance Group Identifier (ENDGID)";
+	const char *csi = "command set identifier (CSI)";
+	const char *lbstm = "logical block storage tag mask (LBSTM)";
+	const char *nphndls = "Number of Placement Handles (NPHNDLS)";
+	const char *bs = "target block size, specify only if \'FLBAS\' value not entered";
+	const char *nsze_si = "size of ns (NSZE) in standard SI units";
+	const char *ncap_si = "capacity of ns (NCAP) in standard SI units";
+	const char *azr = "Allocate ZRWA Resources (AZR) for Zoned Namespace Command Set";
+	const char *rar = "Requested Active Resources (RAR) for Zoned Namespace Command Set";
+	const char *ror = "Requested Open Resources (ROR) for Zoned Namespace Command Set";
+	const char *rnumzrwa =
+	    "Requested Number of ZRWA Resources (RNUMZRWA) for Zoned Namespace Command Set";
+	const char *phndls = "Comma separated list of Placement Handle Associated RUH";
 
+	_cleanup_free_ struct nvme_ns_mgmt_host_sw_specified *data = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
-	enum nvme_print_flags flags;
-	bool fabrics = false;
+	int err = 0, i;
+	__u32 nsid;
+	uint16_t num_phandle;
+	uint16_t phndl[128] = { 0, };
+	_cleanup_free_ struct nvme_id_ctrl *id = NULL;
+	__u32 align_nsze = 1 << 20; /* Default 1 MiB */
+	__u32 align_ncap = align_nsze;
 
-	void *bar;
+	struct config {
+		__u64	nsze;
+		__u64	ncap;
+		__u8	flbas;
+		__u8	dps;
+		__u8	nmic;
+		__u32	anagrpid;
+		__u16	nvmsetid;
+		__u16	endgid;
+		__u64	bs;
+		__u32	timeout;
+		__u8	csi;
+		__u64	lbstm;
+		__u16	nphndls;
+		char	*nsze_si;
+		char	*ncap_si;
+		bool	azr;
+		__u32	rar;
+		__u32	ror;
+		__u32	rnumzrwa;
+		char	*phndls;
+	};
 
-	struct get_reg_config cfg = {
-		.offset = -1,
+	struct config cfg = {
+		.nsze		= 0,
+		.ncap		= 0,
+		.flbas		= 0xff,
+		.dps		= 0,
+		.nmic		= 0,
+		.anagrpid	= 0,
+		.nvmsetid	= 0,
+		.endgid		= 0,
+		.bs		= 0x00,
+		.timeout	= 120000,
+		.csi		= 0,
+		.lbstm		= 0,
+		.nphndls	= 0,
+		.nsze_si	= NULL,
+		.ncap_si	= NULL,
+		.azr		= false,
+		.rar		= 0,
+		.ror		= 0,
+		.rnumzrwa	= 0,
+		.phndls		= "",
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("offset",         'O', &cfg.offset,         offset),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable),
-		  OPT_FLAG("cap",              0, &cfg.cap,            cap),
-		  OPT_FLAG("vs",               0, &cfg.vs,             vs),
-		  OPT_FLAG("cmbloc",           0, &cfg.cmbloc,         cmbloc),
-		  OPT_FLAG("cmbsz",            0, &cfg.cmbsz,          cmbsz),
-		  OPT_FLAG("bpinfo",           0, &cfg.bpinfo,         bpinfo),
-		  OPT_FLAG("cmbsts",           0, &cfg.cmbsts,         cmbsts),
-		  OPT_FLAG("cmbebs",           0, &cfg.cmbebs,         cmbebs),
-		  OPT_FLAG("cmbswtp",          0, &cfg.cmbswtp,        cmbswtp),
-		  OPT_FLAG("crto",             0, &cfg.crto,           crto),
-		  OPT_FLAG("pmrcap",           0, &cfg.pmrcap,         pmrcap),
-		  OPT_FLAG("pmrsts",           0, &cfg.pmrsts,         pmrsts),
-		  OPT_FLAG("pmrebs",           0, &cfg.pmrebs,         pmrebs),
-		  OPT_FLAG("pmrswtp",          0, &cfg.pmrswtp,        pmrswtp),
-		  OPT_FLAG("intms",            0, &cfg.intms,          intms),
-		  OPT_FLAG("intmc",            0, &cfg.intmc,          intmc),
-		  OPT_FLAG("cc",               0, &cfg.cc,             cc),
-		  OPT_FLAG("csts",             0, &cfg.csts,           csts),
-		  OPT_FLAG("nssr",             0, &cfg.nssr,           nssr),
-		  OPT_FLAG("aqa",              0, &cfg.aqa,            aqa),
-		  OPT_FLAG("asq",              0, &cfg.asq,            asq),
-		  OPT_FLAG("acq",              0, &cfg.acq,            acq),
-		  OPT_FLAG("bprsel",           0, &cfg.bprsel,         bprsel),
-		  OPT_FLAG("bpmbl",            0, &cfg.bpmbl,          bpmbl),
-		  OPT_FLAG("cmbmsc",           0, &cfg.cmbmsc,         cmbmsc),
-		  OPT_FLAG("nssd",             0, &cfg.nssd,           nssd),
-		  OPT_FLAG("pmrctl",           0, &cfg.pmrctl,         pmrctl),
-		  OPT_FLAG("pmrmscl",          0, &cfg.pmrmscl,        pmrmscl),
-		  OPT_FLAG("pmrmscu",          0, &cfg.pmrmscu,        pmrmscu));
+		  OPT_SUFFIX("nsze",       's', &cfg.nsze,     nsze),
+		  OPT_SUFFIX("ncap",       'c', &cfg.ncap,     ncap),
+		  OPT_BYTE("flbas",        'f', &cfg.flbas,    flbas),
+		  OPT_BYTE("dps",          'd', &cfg.dps,      dps),
+		  OPT_BYTE("nmic",         'm', &cfg.nmic,     nmic),
+		  OPT_UINT("anagrp-id",    'a', &cfg.anagrpid, anagrpid),
+		  OPT_UINT("nvmset-id",    'i', &cfg.nvmsetid, nvmsetid),
+		  OPT_UINT("endg-id",      'e', &cfg.endgid,   endgid),
+		  OPT_SUFFIX("block-size", 'b', &cfg.bs,       bs),
+		  OPT_UINT("timeout",      't', &cfg.timeout,  timeout),
+		  OPT_BYTE("csi",          'y', &cfg.csi,      csi),
+		  OPT_SUFFIX("lbstm",      'l', &cfg.lbstm,    lbstm),
+		  OPT_SHRT("nphndls",      'n', &cfg.nphndls,  nphndls),
+		  OPT_STR("nsze-si",       'S', &cfg.nsze_si,  nsze_si),
+		  OPT_STR("ncap-si",       'C', &cfg.ncap_si,  ncap_si),
+		  OPT_FLAG("azr",          'z', &cfg.azr,      azr),
+		  OPT_UINT("rar",          'r', &cfg.rar,      rar),
+		  OPT_UINT("ror",          'O', &cfg.ror,      ror),
+		  OPT_UINT("rnumzrwa",     'u', &cfg.rnumzrwa, rnumzrwa),
+		  OPT_LIST("phndls",       'p', &cfg.phndls,   phndls));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.flbas != 0xff && cfg.bs != 0x00) {
+		nvme_show_error(
+		    "Invalid specification of both FLBAS and Block Size, please specify only one");
+		return -EINVAL;
+	}
+	if (cfg.bs) {
+		if ((cfg.bs & (~cfg.bs + 1)) != cfg.bs) {
+			nvme_show_error(
+			    "Invalid value for block size (%"PRIu64"). Block size must be a power of two",
+			    (uint64_t)cfg.bs);
+			return -EINVAL;
+		}
+
+
+		ns = nvme_alloc(sizeof(*ns));
+		if (!ns)
+			return -ENOMEM;
+
+		err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
+		if (err) {
+			if (err < 0) {
+				nvme_show_error("identify-namespace: %s", nvme_strerror(errno));
+			} else {
+				fprintf(stderr, "identify failed\n");
+				nvme_show_status(err);
+			}
+			return err;
+		}
+		for (i = 0; i <= ns->nlbaf; ++i) {
+			if ((1 << ns->lbaf[i].ds) == cfg.bs && ns->lbaf[i].ms == 0) {
+				cfg.flbas = i;
+				break;
+			}
+		}
+
+	}
+	if (cfg.flbas == 0xff) {
+		fprintf(stderr, "FLBAS corresponding to block size %"PRIu64" not found\n",
+			(uint64_t)cfg.bs);
+		fprintf(stderr, "Please correct block size, or specify FLBAS directly\n");
+
+		return -EINVAL;
+	}
+
+	id = nvme_alloc(sizeof(*id));
+	if (!id)
+		return -ENOMEM;
+
+	err = nvme_identify_ctrl(dev_fd(dev), id);
+	if (err) {
+		if (err < 0) {
+			nvme_show_error("identify-controller: %s", nvme_strerror(errno));
+		} else {
+			fprintf(stderr, "identify controller failed\n");
+			nvme_show_status(err);
+		}
+		return err;
+	}
+
+	err = ns_granularity(dev, id, cfg.flbas, &align_nsze, &align_ncap);
+	if (err)
+		return err;
+
+	err = parse_lba_num_si(dev, "nsze", cfg.nsze_si, cfg.flbas, &cfg.nsze, align_nsze);
+	if (err)
+		return err;
+
+	err = parse_lba_num_si(dev, "ncap", cfg.ncap_si, cfg.flbas, &cfg.ncap, align_ncap);
+	if (err)
+		return err;
+
+	if (cfg.csi != NVME_CSI_ZNS && (cfg.azr || cfg.rar || cfg.ror || cfg.rnumzrwa)) {
+		nvme_show_error("Invalid ZNS argument is given (CSI:%#x)", cfg.csi);
+		return -EINVAL;
+	}
+
+	data = nvme_alloc(sizeof(*data));
+	if (!data)
+		return -ENOMEM;
+
+	data->nsze = cpu_to_le64(cfg.nsze);
+	data->ncap = cpu_to_le64(cfg.ncap);
+	data->flbas = cfg.flbas;
+	data->dps = cfg.dps;
+	data->nmic = cfg.nmic;
+	data->anagrpid = cpu_to_le32(cfg.anagrpid);
+	data->nvmsetid = cpu_to_le16(cfg.nvmsetid);
+	data->endgid = cpu_to_le16(cfg.endgid);
+	data->lbstm = cpu_to_le64(cfg.lbstm);
+	data->zns.znsco = cfg.azr;
+	data->zns.rar = cpu_to_le32(cfg.rar);
+	data->zns.ror = cpu_to_le32(cfg.ror);
+	data->zns.rnumzrwa = cpu_to_le32(cfg.rnumzrwa);
+	data->nphndls = cpu_to_le16(cfg.nphndls);
+
+	num_phandle = argconfig_parse_comma_sep_array_short(cfg.phndls, phndl, ARRAY_SIZE(phndl));
+	if (cfg.nphndls != num_phandle) {
+		nvme_show_error("Invalid Placement handle list");
+		return -EINVAL;
+	}
+
+	for (i = 0; i < num_phandle; i++)
+		data->phndl[i] = cpu_to_le16(phndl[i]);
+
+	err = nvme_cli_ns_mgmt_create(dev, data, &nsid, cfg.timeout, cfg.csi);
+	if (!err)
+		printf("%s: Success, created nsid:%d\n", cmd->name, nsid);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("create namespace: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+/* one element of the provision-ns layout */
+struct provision_entry {
+	__u64 size;		/* logical blocks, or bytes if @bytes */
+	bool bytes;
+	bool rest;		/* a share of the capacity the others leave */
+	__u32 count;
+};
+
+/* <size>[:<count>][,<size>[:<count>]...], a suffixed size is in bytes */
+static int provision_parse_layout(const char *layout,
+				  struct provision_entry **entries, int *nr)
+{
+	_cleanup_free_ char *copy = NULL;
+	struct provision_entry *e, *tmp;
+	char *tok, *save, *count, *end;
+	bool rest = false;
+
+	copy = strdup(layout);
+	if (!copy)
+		return -ENOMEM;
+
+	*entries = NULL;
+	*nr = 0;
+	for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		tmp = realloc(*entries, (*nr + 1) * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		*entries = tmp;
+		e = &tmp[(*nr)++];
+		memset(e, 0, sizeof(*e));
+		e->count = 1;
+
+		count = strchr(tok, ':');
+		if (count) {
+			*count++ = '\0';
+			errno = 0;
+			e->count = strtoul(count, &end, 0);
+			if (errno || *end || !e->count)
+				goto invalid;
+		}
+
+		if (!strcmp(tok, "rest")) {
+			if (rest)
+				goto invalid;
+			e->rest = rest = true;
+		} else {
+			if (suffix_si_parse(tok, &end, (uint64_t *)&e->size) || !e->size)
+				goto invalid;
+			/* the parser stops at the suffix */
+			e->bytes = *end != '\0';
+		}
+	}
+
+	if (*nr)
+		return 0;
+invalid:
+	nvme_show_error("invalid layout '%s'", layout);
+	return -EINVAL;
+}
+
+/*
+ * Size every namespace of the layout in blocks of @lba_size bytes, byte
+ * sizes rounded up to the @align granularity. The "rest" entry splits the
+ * unallocated capacity @unvmcap the others leave, rounded down.
+ */
+static int provision_size(struct provision_entry *entries, int nr_entries,
+			  __u32 lba_size, __u32 align, long double unvmcap,
+			  struct nvme_provision *p)
+{
+	struct provision_entry *e, *rest = NULL;
+	long double total = 0;
+	__u64 nsze, bytes;
+	__u32 j;
+	int i, n = 0;
+
+	for (i = 0; i < nr_entries; i++)
+		p->nr_ns += entries[i].count;
+	p->ns = calloc(p->nr_ns, sizeof(*p->ns));
+	if (!p->ns)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_entries; i++) {
+		e = &entries[i];
+		if (e->rest) {
+			rest = e;
+			continue;
+		}
+		nsze = e->size;
+		if (e->bytes)
+			nsze = (e->size + align - 1) / align * align / lba_size;
+		total += (long double)nsze * lba_size * e->count;
+		e->size = nsze;
+		e->bytes = false;
+	}
+
+	if (rest) {
+		if (!unvmcap || unvmcap <= total) {
+			nvme_show_error("no unallocated capacity left for 'rest'");
+			return -ENOSPC;
+		}
+		bytes = (unvmcap - total) / rest->count;
+		bytes -= bytes % align;
+		rest->size = bytes / lba_size;
+		if (!rest->size) {
+			nvme_show_error("no unallocated capacity left for 'rest'");
+			return -ENOSPC;
+		}
+		total += (long double)rest->size * lba_size * rest->count;
+	}
+
+	if (unvmcap && total > unvmcap) {
+		nvme_show_error("the layout needs %.0Lf bytes, %.0Lf are unallocated",
+				total, unvmcap);
+		return -ENOSPC;
+	}
+
+	for (i = 0; i < nr_entries; i++)
+		for (j = 0; j < entries[i].count; j++)
+			p->ns[n++].nsze = entries[i].size;
+
+	return 0;
+}
+
+static int provision_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Create the namespaces of a layout back to back, attach them "
+		"to the given controllers and rescan the namespaces once at the end. "
+		"Identify Controller and the controller list are read only once.";
+	const char *layout = "comma-sep list of <size>[:<count>], a size is in logical "
+		"blocks, or in bytes with an SI suffix, 'rest' splits the unallocated capacity";
+	const char *flbas = "Formatted LBA size (FLBAS) of every namespace";
+	const char *bs = "target block size, specify only if \'FLBAS\' value not entered";
+	const char *dps = "data protection settings (DPS)";
+	const char *nmic = "multipath and sharing capabilities (NMIC)";
+	const char *cont = "comma-sep controller id list, defaults to the opened controller";
+	const char *no_attach = "only create the namespaces";
+	const char *dry_run = "print the sizes of the namespaces, send nothing";
+
+	_cleanup_free_ struct nvme_ns_mgmt_host_sw_specified *data = NULL;
+	_cleanup_free_ struct nvme_ctrl_list *cntlist = NULL;
+	_cleanup_free_ struct provision_entry *entries = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *id = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_free_ __u16 *ctrlist = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_provision p = { 0 };
+	__u32 align_nsze = 1 << 20; /* Default 1 MiB */
+	__u32 align_ncap = align_nsze;
+	enum nvme_print_flags flags;
+	int err, i, nr_entries, num, list[2048];
+	bool attached = false;
+	__u64 start;
+
+	struct config {
+		char	*layout;
+		__u8	flbas;
+		__u64	bs;
+		__u8	dps;
+		__u8	nmic;
+		char	*cntlist;
+		bool	no_attach;
+		__u32	timeout;
+		bool	dry_run;
+	};
+
+	struct config cfg = {
+		.layout		= "",
+		.flbas		= 0xff,
+		.bs		= 0,
+		.dps		= 0,
+		.nmic		= 0,
+		.cntlist	= "",
+		.no_attach	= false,
+		.timeout	= 120000,
+		.dry_run	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_LIST("layout",       'L', &cfg.layout,    layout),
+		  OPT_BYTE("flbas",        'f', &cfg.flbas,     flbas),
+		  OPT_SUFFIX("block-size", 'b', &cfg.bs,        bs),
+		  OPT_BYTE("dps",          'd', &cfg.dps,       dps),
+		  OPT_BYTE("nmic",         'm', &cfg.nmic,      nmic),
+		  OPT_LIST("controllers",  'c', &cfg.cntlist,   cont),
+		  OPT_FLAG("no-attach",    'N', &cfg.no_attach, no_attach),
+		  OPT_UINT("timeout",      't', &cfg.timeout,   timeout),
+		  OPT_FLAG("dry-run",      'D', &cfg.dry_run,   dry_run));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if ((cfg.flbas == 0xff) == !cfg.bs) {
+		nvme_show_error("Specify exactly one of FLBAS and Block Size");
+		return -EINVAL;
+	}
+	if (!strlen(cfg.layout)) {
+		nvme_show_error("layout parameter required");
+		return -EINVAL;
+	}
+
+	err = provision_parse_layout(cfg.layout, &entries, &nr_entries);
+	if (err)
+		return err;
+
+	id = nvme_alloc(sizeof(*id));
+	ns = nvme_alloc(sizeof(*ns));
+	if (!id || !ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, id);
+	if (err) {
+		if (err < 0)
+			nvme_show_error("identify-controller: %s", nvme_strerror(errno));
+		else
+			nvme_show_status(err);
+		return err;
+	}
+	if (!(le16_to_cpu(id->oacs) & NVME_CTRL_OACS_NS_MGMT)) {
+		nvme_show_error("%s: namespace management is not supported", dev->name);
+		return -ENOTSUP;
+	}
+
+	err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
+	if (err) {
+		if (err < 0)
+			nvme_show_error("identify-namespace: %s", nvme_strerror(errno));
+		else
+			nvme_show_status(err);
+		return err;
+	}
+	if (cfg.bs) {
+		for (i = 0; i <= ns->nlbaf; i++) {
+			if ((1ULL << ns->lbaf[i].ds) == cfg.bs && !ns->lbaf[i].ms) {
+				cfg.flbas = i;
+				break;
+			}
+		}
+		if (cfg.flbas == 0xff) {
+			nvme_show_error("FLBAS corresponding to block size %"PRIu64" not found",
+					(uint64_t)cfg.bs);
+			return -EINVAL;
+		}
+	}
+	i = cfg.flbas & NVME_NS_FLBAS_LOWER_MASK;
+	if (i > ns->nlbaf) {
+		nvme_show_error("LBA format %d is not supported", i);
+		return -EINVAL;
+	}
+	p.name = dev->name;
+	p.flbas = cfg.flbas;
+	p.lba_size = 1 << ns->lbaf[i].ds;
+
+	err = ns_granularity(dev, id, cfg.flbas, &align_nsze, &align_ncap);
+	if (err)
+		return err;
+
+	/* NSZE and NCAP are the same, so both granularities apply */
+	err = provision_size(entries, nr_entries, p.lba_size,
+			     max(align_nsze, align_ncap),
+			     int128_to_double(id->unvmcap), &p);
+	if (err)
+		goto free;
+
+	if (strlen(cfg.cntlist)) {
+		num = argconfig_parse_comma_sep_array(cfg.cntlist, list, 2047);
+		if (num <= 0) {
+			nvme_show_error("%s: controller id list is malformed", cmd->name);
+			err = -EINVAL;
+			goto free;
+		}
+	} else {
+		list[0] = le16_to_cpu(id->cntlid);
+		num = 1;
+	}
+
+	cntlist = nvme_alloc(sizeof(*cntlist));
+	ctrlist = nvme_alloc(sizeof(*ctrlist) * 2048);
+	data = nvme_alloc(sizeof(*data));
+	if (!cntlist || !ctrlist || !data) {
+		err = -ENOMEM;
+		goto free;
+	}
+	for (i = 0; i < num; i++)
+		ctrlist[i] = (__u16)list[i];
+	nvme_init_ctrl_list(cntlist, num, ctrlist);
+	p.ctrls = ctrlist;
+	p.nr_ctrls = cfg.no_attach ? 0 : num;
+
+	if (cfg.dry_run) {
+		p.dry_run = true;
+		nvme_show_provision_ns(&p, flags);
+		goto free;
+	}
+
+	data->flbas = cfg.flbas;
+	data->dps = cfg.dps;
+	data->nmic = cfg.nmic;
+
+	start = monotonic_ns();
+	for (i = 0; i < p.nr_ns; i++) {
+		struct nvme_provision_ns *n = &p.ns[i];
+
+		data->nsze = cpu_to_le64(n->nsze);
+		data->ncap = cpu_to_le64(n->nsze);
+		err = nvme_cli_ns_mgmt_create(dev, data, &n->nsid, cfg.timeout, NVME_CSI_NVM);
+		if (err) {
+			/* libnvme reports transport failures as -1 with errno set */
+			n->err = err = err < 0 ? -errno : err;
+			n->nsid = 0;
+			break;
+		}
+		if (cfg.no_attach)
+			continue;
+
+		err = nvme_cli_ns_attach_ctrls(dev, n->nsid, cntlist);
+		if (err) {
+			n->err = err = err < 0 ? -errno : err;
+			break;
+		}
+		n->attached = attached = true;
+	}
+
+	/* one rescan for every namespace attached above */
+	if (attached && dev->type == NVME_DEV_DIRECT && nvme_ns_rescan(dev_fd(dev)) < 0)
+		p.rescan_err = -errno;
+	p.elapsed_ns = monotonic_ns() - start;
+
+	nvme_show_provision_ns(&p, flags);
+free:
+	free(p.ns);
+
+	return err;
+}
+
+static bool nvme_match_device_filter(nvme_subsystem_t s,
+		nvme_ctrl_t c, nvme_ns_t ns, void *f_args)
+{
+	int ret, instance, nsid, s_num;
+	char *devname = f_args;
+
+	if (!devname || !strlen(devname))
+		return true;
+
+	ret = sscanf(devname, "nvme%dn%d", &instance, &nsid);
+	if (ret != 2)
+		return true;
+
+	if (s) {
+		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
+			     &s_num);
+		if (ret == 1 && s_num == instance)
+			return true;
+	}
+	if (c) {
+		s = nvme_ctrl_get_subsystem(c);
+
+		ret = sscanf(nvme_subsystem_get_name(s), "nvme-subsys%d",
+			     &s_num);
+		if (ret == 1 && s_num == instance)
+			return true;
+	}
+	if (ns) {
+		if (!strcmp(devname, nvme_ns_get_name(ns)))
+			return true;
+	}
+
+	return false;
+}
+
+/* Reports topology changes after the initial listing until interrupted */
+static int watch_topology(enum nvme_print_flags flags)
+{
+	int err;
+
+	fflush(stdout);
+	nvme_stop_catch(true, nvme_watch_stop);
+	err = nvme_watch_topology(flags);
+	nvme_stop_release();
+	if (err < 0)
+		nvme_show_error("watch: %s", nvme_strerror(-err));
+
+	return err;
+}
+
+static int list_subsys(int argc, char **argv, struct command *cmd,
+		struct plugin *plugin)
+{
+	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	enum nvme_print_flags flags;
+	const char *desc = "Retrieve information for subsystems";
+	nvme_scan_filter_t filter = NULL;
+	char *devname;
+	int err;
+	int nsid = NVME_NSID_ALL;
+	bool watch = false;
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("watch",  'w', &watch, watch_desc));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err < 0)
+		return err;
+
+	devname = NULL;
+	if (optind < argc)
+		devname = basename(argv[optind++]);
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+
+	r = nvme_create_root(stderr, log_level);
+	if (!r) {
+		if (devname)
+			nvme_show_error("Failed to scan nvme subsystem for %s", devname);
+		else
+			nvme_show_error("Failed to scan nvme subsystem");
+		return -errno;
+	}
+
+	if (devname) {
+		int subsys_num;
+
+		if (sscanf(devname, "nvme%dn%d", &subsys_num, &nsid) != 2) {
+			nvme_show_error("Invalid device name %s", devname);
+			return -EINVAL;
+		}
+		filter = nvme_match_device_filter;
+	}
+
+	err = nvme_scan_topology(r, filter, (void *)devname);
+	if (err) {
+		if (errno != ENOENT)
+			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	nvme_show_subsystem_list(r, nsid != NVME_NSID_ALL, flags);
+
+	if (watch)
+		return watch_topology(flags);
+
+	return 0;
+}
+
+static void list_fast_ns(void *arg)
+{
+	struct nvme_list_fast_ns *ns = arg;
+	char dir[PATH_MAX], ctrl[PATH_MAX], path[sizeof(ns->generic)];
+	unsigned long long nsid, size, lba, ms;
+	int instance, head;
+
+	snprintf(dir, sizeof(dir), "/sys/class/block/%s", ns->name);
+	if (sysfs_read_u64(dir, "nsid", &nsid) || sysfs_read_u64(dir, "size", &size) ||
+	    sysfs_read_u64(dir, "queue/logical_block_size", &lba)) {
+		ns->err = -errno;
+		return;
+	}
+	ns->nsid = nsid;
+	/* the block layer reports the size in 512 byte sectors */
+	ns->size = size * 512;
+	ns->lba_size = lba;
+	/* only reported by newer kernels */
+	if (!sysfs_read_u64(dir, "metadata_bytes", &ms))
+		ns->meta_size = ms;
+
+	/* the controller, or the subsystem of a multipath namespace */
+	snprintf(ctrl, sizeof(ctrl), "/sys/class/block/%s/device", ns->name);
+	sysfs_read_attr(ctrl, "serial", ns->serial, sizeof(ns->serial));
+	sysfs_read_attr(ctrl, "model", ns->model, sizeof(ns->model));
+	sysfs_read_attr(ctrl, "firmware_rev", ns->firmware, sizeof(ns->firmware));
+
+	if (sscanf(ns->name, "nvme%dn%d", &instance, &head) == 2) {
+		snprintf(path, sizeof(path), "/dev/ng%dn%d", instance, head);
+		if (!access(path, F_OK))
+			strcpy(ns->generic, path);
+	}
+}
+
+static bool list_fast_name(const char *name, int *instance, int *head)
+{
+	int pos = 0;
+
+	/* skips partitions and the hidden per path devices (nvmeXcYnZ) */
+	return sscanf(name, "nvme%dn%d%n", instance, head, &pos) == 2 && !name[pos];
+}
+
+static int list_fast_cmp(const void *a, const void *b)
+{
+	const struct nvme_list_fast_ns *na = a, *nb = b;
+	int ia, ha, ib, hb;
+
+	list_fast_name(na->name, &ia, &ha);
+	list_fast_name(nb->name, &ib, &hb);
+
+	return ia != ib ? ia - ib : ha - hb;
+}
+
+/*
+ * Lists the namespace block devices from sysfs only, without building the
+ * libnvme tree which opens every device and may issue Identify commands.
+ * The attributes are read by a pool of worker threads.
+ */
+static int list_fast(struct nvme_list_fast_ns **nsp, int *nr_ns, unsigned int jobs)
+{
+	struct nvme_thread_pool *pool;
+	struct nvme_list_fast_ns *ns = NULL, *tmp;
+	struct dirent *e;
+	DIR *d;
+	int n = 0, i, instance, head;
+
+	d = opendir("/sys/class/block");
+	if (!d)
+		return -errno;
+
+	while ((e = readdir(d))) {
+		size_t len = strlen(e->d_name);
+
+		if (len >= sizeof(ns->name) || !list_fast_name(e->d_name, &instance, &head))
+			continue;
+		tmp = realloc(ns, (n + 1) * sizeof(*ns));
+		if (!tmp) {
+			closedir(d);
+			free(ns);
+			return -ENOMEM;
+		}
+		ns = tmp;
+		memset(&ns[n], 0, sizeof(ns[n]));
+		memcpy(ns[n].name, e->d_name, len + 1);
+		n++;
+	}
+
+	closedir(d);
+
+	qsort(ns, n, sizeof(*ns), list_fast_cmp);
+
+	pool = n ? nvme_thread_pool_create(nvme_thread_pool_jobs(jobs, n)) : NULL;
+	for (i = 0; i < n; i++) {
+		if (!pool || nvme_thread_pool_queue(pool, list_fast_ns, &ns[i]))
+			list_fast_ns(&ns[i]);
+	}
+	nvme_thread_pool_destroy(pool);
+
+	*nsp = ns;
+	*nr_ns = n;
+
+	return 0;
+}
+
+static int list_count_ns(nvme_root_t r)
+{
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	nvme_ns_t n;
+	int nr = 0;
+
+	nvme_for_each_host(r, h) {
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ns(s, n)
+				nr++;
+			nvme_subsystem_for_each_ctrl(s, c)
+				nvme_ctrl_for_each_ns(c, n)
+					nr++;
+		}
+	}
+
+	return nr;
+}
+
+static int list(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve basic information for all NVMe namespaces";
+	const char *fast = "only read the sysfs attributes shown, in parallel";
+	const char *jobs = "number of threads reading sysfs with --fast, 0 for one per CPU";
+	const char *timing = "report the scan time per namespace on stderr";
+	_cleanup_free_ struct nvme_list_fast_ns *ns = NULL;
+	enum nvme_print_flags flags;
+	_cleanup_topology_ nvme_root_t r = NULL;
+	__u64 start, elapsed;
+	int nr_ns, err = 0;
+
+	struct config {
+		bool	fast;
+		__u32	jobs;
+		bool	timing;
+		bool	watch;
+	};
+
+	struct config cfg = {
+		.fast		= false,
+		.jobs		= 8,
+		.timing		= false,
+		.watch		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("fast",   'F', &cfg.fast,   fast),
+		  OPT_UINT("jobs",   'j', &cfg.jobs,   jobs),
+		  OPT_FLAG("timing", 'T', &cfg.timing, timing),
+		  OPT_FLAG("watch",  'w', &cfg.watch,  watch_desc));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err < 0)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	start = monotonic_ns();
+	if (cfg.fast) {
+		err = list_fast(&ns, &nr_ns, cfg.jobs);
+		if (err < 0) {
+			nvme_show_error("Failed to scan sysfs: %s", nvme_strerror(-err));
+			return err;
+		}
+	} else {
+		err = scan_topology(&r);
+		if (err < 0) {
+			if (errno != ENOENT)
+				nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+			return err;
+		}
+		nr_ns = list_count_ns(r);
+	}
+	elapsed = monotonic_ns() - start;
+
+	if (cfg.fast)
+		nvme_show_list_fast(ns, nr_ns, flags);
+	else
+		nvme_show_list_items(r, flags);
+
+	if (cfg.timing)
+		fprintf(stderr, "scanned %d namespaces in %.3f ms, %.1f us per namespace\n",
+			nr_ns, (double)elapsed / NSEC_PER_SEC * 1000,
+			nr_ns ? (double)elapsed / NSEC_PER_USEC / nr_ns : 0.0);
+
+	if (cfg.watch)
+		return watch_topology(flags);
+
+	return err;
+}
+
+static int id_ctrl_show_capture(void *data, size_t len, const char *file, void *arg)
+{
+	struct capture_args *c = arg;
+
+	nvme_show_id_ctrl(data, c->flags, c->vs);
+	return 0;
+}
+
+int __id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin,
+		void (*vs)(__u8 *vs, struct json_object *root))
+{
+	const char *desc = "Send an Identify Controller command to "
+		"the given device and report information about the specified "
+		"controller in human-readable or "
+		"binary format. May also return vendor-specific "
+		"controller attributes in hex-dump if requested. With "
+		"--input-file the data is decoded from captures of "
+		"--raw-binary instead, and no device is needed.";
+	const char *vendor_specific = "dump binary vendor field";
+	const char *input = "comma separated Identify Controller captures to decode";
+
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		bool	vendor_specific;
+		bool	raw_binary;
+		bool	human_readable;
+		char	*input_file;
+	};
+
+	struct config cfg = {
+		.vendor_specific	= false,
+		.raw_binary		= false,
+		.human_readable		= false,
+		.input_file		= NULL,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
+		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
+		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify),
+		  OPT_LIST("input-file",      'i', &cfg.input_file,      input));
+
+	err = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.vendor_specific)
+		flags |= VS;
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	if (cfg.input_file) {
+		struct capture_args c = { .flags = flags, .vs = vs };
+
+		return nvme_decode_captures(cfg.input_file, sizeof(*ctrl), false,
+					    "an Identify Controller data structure", id_ctrl_show_capture, &c);
+	}
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		nvme_show_id_ctrl(ctrl, flags, vs);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify controller: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	return __id_ctrl(argc, argv, cmd, plugin, NULL);
+}
+
+static int nvm_id_ctrl(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Controller NVM Command Set "
+		"command to the given device and report information about "
+		"the specified controller in various formats.";
+
+	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
+	if (!ctrl_nvm)
+		return -ENOMEM;
+
+	err = nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm);
+	if (!err)
+		nvme_show_id_ctrl_nvm(ctrl_nvm, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("nvm identify controller: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int nvm_id_ns(int argc, char **argv, struct command *cmd,
+	struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Namespace NVM Command Set "
+		"command to the given device and report information about "
+		"the specified namespace in various formats.";
+
+	_cleanup_free_ struct nvme_nvm_id_ns *id_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
+
+	struct config {
+		__u32	namespace_id;
+		__u8	uuid_index;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.uuid_index	= NVME_UUID_NONE,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,      uuid_index));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err) {
+		nvme_show_status(err);
+		return err;
+	}
+
+	id_ns = nvme_alloc(sizeof(*id_ns));
+	if (!id_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id,
+				   cfg.uuid_index,
+				   NVME_CSI_NVM, id_ns);
+	if (!err)
+		nvme_show_nvm_id_ns(id_ns, cfg.namespace_id, ns, 0, false, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_perror("nvm identify namespace");
+
+	return err;
+}
+
+static int nvm_id_ns_lba_format(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an NVM Command Set specific Identify Namespace "
+		"command to the given device, returns capability field properties of "
+		"the specified LBA Format index in the specified namespace in various formats.";
+
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
+
+	struct config {
+		__u16	lba_format_index;
+		__u8	uuid_index;
+	};
+
+	struct config cfg = {
+		.lba_format_index	= 0,
+		.uuid_index		= NVME_UUID_NONE,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("lba-format-index", 'i', &cfg.lba_format_index, lba_format_index),
+		  OPT_BYTE("uuid-index",       'U', &cfg.uuid_index,       uuid_index));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, NVME_NSID_ALL, ns);
+	if (err) {
+		ns->nlbaf = NVME_FEAT_LBA_RANGE_MAX - 1;
+		ns->nulbaf = 0;
+	}
+
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_iocs_ns_csi_user_data_format(dev_fd(dev), cfg.lba_format_index,
+							 cfg.uuid_index, NVME_CSI_NVM, nvm_ns);
+	if (!err)
+		nvme_show_nvm_id_ns(nvm_ns, 0, ns, cfg.lba_format_index, true, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_perror("NVM identify namespace for specific LBA format");
+
+	return err;
+}
+
+/* Identify commands of id-ns --all and ns-descs --all in flight */
+#define ID_NS_ALL_DEPTH		16
+
+static void id_ns_all_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct nvme_id_ns_entry *e = fc->priv;
+
+	e->err = status;
+}
+
+static void id_ns_all_free(struct nvme_id_ns_entry *list, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++)
+		free(list[i].data);
+	free(list);
+}
+
+/*
+ * The Identify data of @cns, NVME_IDENTIFY_CNS_NS or
+ * NVME_IDENTIFY_CNS_NS_DESC_LIST, for each active namespace. The commands
+ * go through the fanout executor, ID_NS_ALL_DEPTH of them in flight, or
+ * one after the other through a non direct device.
+ */
+static int id_ns_all(struct nvme_dev *dev, __u8 cns,
+		     struct nvme_id_ns_entry **listp, int *nrp)
+{
+	_cleanup_free_ struct nvme_fanout_cmd *fcs = NULL;
+	_cleanup_free_ __u32 *nsids = NULL;
+	struct nvme_id_ns_entry *list;
+	struct nvme_fanout f;
+	int i, nr, err;
+
+	err = active_nsids(dev, &nsids, &nr);
+	if (err)
+		return err;
+
+	list = calloc(nr ? nr : 1, sizeof(*list));
+	fcs = calloc(nr ? nr : 1, sizeof(*fcs));
+	if (!list || !fcs) {
+		free(list);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < nr; i++) {
+		list[i].nsid = nsids[i];
+		/* until it completes, the ring may fail */
+		list[i].err = -ECANCELED;
+		list[i].data = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
+		if (!list[i].data) {
+			id_ns_all_free(list, nr);
+			return -ENOMEM;
+		}
+	}
+
+	if (dev->type != NVME_DEV_DIRECT) {
+		for (i = 0; i < nr; i++) {
+			if (cns == NVME_IDENTIFY_CNS_NS)
+				err = nvme_cli_identify_ns(dev, list[i].nsid, list[i].data);
+			else
+				err = nvme_cli_identify_ns_descs(dev, list[i].nsid,
+								 list[i].data);
+			list[i].err = err < 0 ? -errno : err;
+		}
+		goto out;
+	}
+
+	nvme_fanout_init(&f, ID_NS_ALL_DEPTH, ID_NS_ALL_DEPTH);
+	for (i = 0; i < nr; i++) {
+		nvme_fanout_identify_cmd(&fcs[i].cmd, cns, list[i].nsid, 0,
+					 list[i].data);
+		err = nvme_fanout_queue(&f, &fcs[i], dev_fd(dev), id_ns_all_done,
+					&list[i]);
+		if (err)
+			list[i].err = err;
+	}
+	err = nvme_fanout_run(&f);
+	nvme_fanout_exit(&f);
+	if (err) {
+		nvme_show_error("identify namespaces: %s", nvme_strerror(-err));
+		id_ns_all_free(list, nr);
+		return err;
+	}
+
+out:
+	*listp = list;
+	*nrp = nr;
+	return 0;
+}
+
+static int ns_descs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send Namespace Identification Descriptors command to the "
+		"given device, returns the namespace identification descriptors "
+		"of the specific namespace in either human-readable or binary format.";
+	const char *raw = "show descriptors in binary format";
+	const char *all = "the descriptors of every namespace attached to the controller";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *nsdescs = NULL;
+	struct nvme_id_ns_entry *list;
+	enum nvme_print_flags flags;
+	int nr, err;
+
+	struct config {
+		__u32	namespace_id;
+		bool	raw_binary;
+		bool	all;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.raw_binary	= false,
+		.all		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id_desired),
+		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,    raw),
+		  OPT_FLAG("all",           'a', &cfg.all,           all));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	if (cfg.all) {
+		if (cfg.namespace_id) {
+			nvme_show_error("--all and --namespace-id are exclusive");
+			return -EINVAL;
+		}
+
+		err = id_ns_all(dev, NVME_IDENTIFY_CNS_NS_DESC_LIST, &list, &nr);
+		if (err)
+			return err;
+
+		nvme_show_id_ns_descs_all(list, nr, flags);
+		id_ns_all_free(list, nr);
+		return 0;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	nsdescs = nvme_alloc(sizeof(*nsdescs));
+	if (!nsdescs)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns_descs(dev, cfg.namespace_id, nsdescs);
+	if (!err)
+		nvme_show_id_ns_descs(nsdescs, cfg.namespace_id, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_ns_show_capture(void *data, size_t len, const char *file, void *arg)
+{
+	struct capture_args *c = arg;
+
+	nvme_show_id_ns(data, c->nsid, 0, false, c->flags);
+	return 0;
+}
+
+static int id_ns(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Namespace command to the "
+		"given device, returns properties of the specified namespace "
+		"in either human-readable or binary format. Can also return "
+		"binary vendor-specific namespace attributes.";
+	const char *force = "Return this namespace, even if not attached (1.2 devices only)";
+	const char *vendor_specific = "dump binary vendor fields";
+	const char *input = "comma separated Identify Namespace captures to decode";
+	const char *all = "identify every namespace attached to the controller";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct nvme_id_ns_entry *list;
+	enum nvme_print_flags flags;
+	int nr, err;
+
+	struct config {
+		__u32	namespace_id;
+		bool	force;
+		bool	vendor_specific;
+		bool	raw_binary;
+		bool	human_readable;
+		char	*input_file;
+		bool	all;
+	};
+
+	struct config cfg = {
+		.namespace_id		= 0,
+		.force			= false,
+		.vendor_specific	= false,
+		.raw_binary		= false,
+		.human_readable		= false,
+		.input_file		= NULL,
+		.all			= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_FLAG("force",             0, &cfg.force,           force),
+		  OPT_FLAG("vendor-specific", 'V', &cfg.vendor_specific, vendor_specific),
+		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
+		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify),
+		  OPT_LIST("input-file",      'i', &cfg.input_file,      input),
+		  OPT_FLAG("all",             'a', &cfg.all,             all));
+
+	err = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.vendor_specific)
+		flags |= VS;
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	if (cfg.input_file) {
+		struct capture_args c = { .nsid = cfg.namespace_id, .flags = flags };
+
+		return nvme_decode_captures(cfg.input_file, sizeof(*ns), false,
+					    "an Identify Namespace data structure",
+					    id_ns_show_capture, &c);
+	}
+
+	if (cfg.all) {
+		if (cfg.namespace_id || cfg.force) {
+			nvme_show_error("--all is exclusive with --namespace-id and --force");
+			return -EINVAL;
+		}
+
+		err = id_ns_all(dev, NVME_IDENTIFY_CNS_NS, &list, &nr);
+		if (err)
+			return err;
+
+		nvme_show_id_ns_all(list, nr, flags);
+		id_ns_all_free(list, nr);
+		return 0;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	if (cfg.force)
+		err = nvme_cli_identify_allocated_ns(dev, cfg.namespace_id, ns);
+	else
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+
+	if (!err)
+		nvme_show_id_ns(ns, cfg.namespace_id, 0, false, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int cmd_set_independent_id_ns(int argc, char **argv, struct command *cmd,
+				     struct plugin *plugin)
+{
+	const char *desc = "Send an I/O Command Set Independent Identify "
+		"Namespace command to the given device, returns properties of the "
+		"specified namespace in human-readable or binary or json format.";
+
+	_cleanup_free_ struct nvme_id_independent_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err = -1;
+
+	struct config {
+		__u32	namespace_id;
+		bool	raw_binary;
+		bool	human_readable;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.raw_binary	= false,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",    'n', &cfg.namespace_id,    namespace_id_desired),
+		  OPT_FLAG("raw-binary",      'b', &cfg.raw_binary,      raw_identify),
+		  OPT_FLAG("human-readable",  'H', &cfg.human_readable,  human_readable_identify));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	if (!cfg.namespace_id) {
+		err = cfg.namespace_id = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_perror("get-namespace-id");
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_identify_independent_identify_ns(dev_fd(dev), cfg.namespace_id, ns);
+	if (!err)
+		nvme_show_cmd_set_independent_id_ns(ns, cfg.namespace_id, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("I/O command set independent identify namespace: %s",
+				nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_ns_granularity(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Namespace Granularity List command to the "
+		"given device, returns namespace granularity list "
+		"in either human-readable or binary format.";
+
+	_cleanup_free_ struct nvme_id_ns_granularity_list *granularity_list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	granularity_list = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
+	if (!granularity_list)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_granularity(dev_fd(dev), granularity_list);
+	if (!err)
+		nvme_show_id_ns_granularity_list(granularity_list, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify namespace granularity: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_nvmset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify NVM Set List command to the "
+		"given device, returns entries for NVM Set identifiers greater "
+		"than or equal to the value specified CDW11.NVMSETID "
+		"in either binary format or json format";
+	const char *nvmset_id = "NVM Set Identify value";
+
+	_cleanup_free_ struct nvme_id_nvmset_list *nvmset = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u16	nvmset_id;
+	};
+
+	struct config cfg = {
+		.nvmset_id	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("nvmset_id",    'i', &cfg.nvmset_id,     nvmset_id));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	nvmset = nvme_alloc(sizeof(*nvmset));
+	if (!nvmset)
+		return -ENOMEM;
+
+	err = nvme_identify_nvmset_list(dev_fd(dev), cfg.nvmset_id, nvmset);
+	if (!err)
+		nvme_show_id_nvmset(nvmset, cfg.nvmset_id, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify nvm set list: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_uuid(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify UUID List command to the "
+		"given device, returns list of supported Vendor Specific UUIDs "
+		"in either human-readable or binary format.";
+	const char *raw = "show uuid in binary format";
+	const char *human_readable = "show uuid in readable format";
+
+	_cleanup_free_ struct nvme_id_uuid_list *uuid_list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		bool	raw_binary;
+		bool	human_readable;
+	};
+
+	struct config cfg = {
+		.raw_binary	= false,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	uuid_list = nvme_alloc(sizeof(*uuid_list));
+	if (!uuid_list)
+		return -ENOMEM;
+
+	err = nvme_identify_uuid(dev_fd(dev), uuid_list);
+	if (!err)
+		nvme_show_id_uuid_list(uuid_list, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify UUID list: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int id_iocs(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Command Set Data command to "
+		"the given device, returns properties of the specified controller "
+		"in either human-readable or binary format.";
+	const char *controller_id = "identifier of desired controller";
+
+	_cleanup_free_ struct nvme_id_iocs *iocs = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u16	cntid;
+	};
+
+	struct config cfg = {
+		.cntid	= 0xffff,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("controller-id", 'c', &cfg.cntid, controller_id));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	iocs = nvme_alloc(sizeof(*iocs));
+	if (!iocs)
+		return -ENOMEM;
+
+	err = nvme_identify_iocs(dev_fd(dev), cfg.cntid, iocs);
+	if (!err) {
+		printf("NVMe Identify I/O Command Set:\n");
+		nvme_show_id_iocs(iocs, 0);
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("NVMe Identify I/O Command Set: %s", nvme_strerror(errno));
+	}
+
+	return err;
+}
+
+static int id_domain(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send an Identify Domain List command to the "
+		"given device, returns properties of the specified domain "
+		"in either normal|json|binary format.";
+	const char *domain_id = "identifier of desired domain";
+
+	_cleanup_free_ struct nvme_id_domain_list *id_domain = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u16	dom_id;
+	};
+
+	struct config cfg = {
+		.dom_id		= 0xffff,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("dom-id",         'd', &cfg.dom_id,         domain_id));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	id_domain = nvme_alloc(sizeof(*id_domain));
+	if (!id_domain)
+		return -ENOMEM;
+
+	err = nvme_identify_domain_list(dev_fd(dev), cfg.dom_id, id_domain);
+	if (!err) {
+		printf("NVMe Identify command for Domain List is successful:\n");
+		printf("NVMe Identify Domain List:\n");
+		nvme_show_id_domain_list(id_domain, flags);
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("NVMe Identify Domain List: %s", nvme_strerror(errno));
+	}
+
+	return err;
+}
+
+static int get_ns_id(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Get namespace ID of a the block device.";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	unsigned int nsid;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = nvme_get_nsid(dev_fd(dev), &nsid);
+	if (err < 0) {
+		nvme_show_error("get namespace ID: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	printf("%s: namespace-id:%d\n", dev->name, nsid);
+
+	return 0;
+}
+
+static int virtual_mgmt(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "The Virtualization Management command is supported by primary controllers "
+		"that support the Virtualization Enhancements capability. This command is used for:\n"
+		"  1. Modifying Flexible Resource allocation for the primary controller\n"
+		"  2. Assigning Flexible Resources for secondary controllers\n"
+		"  3. Setting the Online and Offline state for secondary controllers";
+	const char *cntlid = "Controller Identifier(CNTLID)";
+	const char *rt = "Resource Type(RT): [0,1]\n"
+		"0h: VQ Resources\n"
+		"1h: VI Resources";
+	const char *act = "Action(ACT): [1,7,8,9]\n"
+		"1h: Primary Flexible\n"
+		"7h: Secondary Offline\n"
+		"8h: Secondary Assign\n"
+		"9h: Secondary Online";
+	const char *nr = "Number of Controller Resources(NR)";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u32 result;
+	int err;
+
+	struct config {
+		__u16	cntlid;
+		__u8	rt;
+		__u8	act;
+		__u16	nr;
+	};
+
+	struct config cfg = {
+		.cntlid	= 0,
+		.rt	= 0,
+		.act	= 0,
+		.nr	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("cntlid", 'c', &cfg.cntlid, cntlid),
+		  OPT_BYTE("rt",     'r', &cfg.rt,     rt),
+		  OPT_BYTE("act",    'a', &cfg.act,    act),
+		  OPT_SHRT("nr",     'n', &cfg.nr,     nr));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	struct nvme_virtual_mgmt_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.act		= cfg.act,
+		.rt		= cfg.rt,
+		.cntlid		= cfg.cntlid,
+		.nr		= cfg.nr,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_virtual_mgmt(&args);
+	if (!err)
+		printf("success, Number of Controller Resources Modified (NRM):%#x\n", result);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("virt-mgmt: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int primary_ctrl_caps(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *cntlid = "Controller ID";
+	const char *desc = "Send an Identify Primary Controller Capabilities "
+		"command to the given device and report the information in a "
+		"decoded format (default), json or binary.";
+
+	_cleanup_free_ struct nvme_primary_ctrl_cap *caps = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u16	cntlid;
+		bool	human_readable;
+	};
+
+	struct config cfg = {
+		.cntlid		= 0,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("cntlid",         'c', &cfg.cntlid, cntlid),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_info));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	caps = nvme_alloc(sizeof(*caps));
+	if (!caps)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_primary_ctrl(dev, cfg.cntlid, caps);
+	if (!err)
+		nvme_show_primary_ctrl_cap(caps, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("identify primary controller capabilities: %s",
+				nvme_strerror(errno));
+
+	return err;
+}
+
+static int list_secondary_ctrl(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "Show secondary controller list associated with the primary controller of the given device.";
+	const char *controller = "lowest controller identifier to display";
+	const char *num_entries = "number of entries to retrieve";
+
+	_cleanup_free_ struct nvme_secondary_ctrl_list *sc_list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u16	cntid;
+		__u32	num_entries;
+	};
+
+	struct config cfg = {
+		.cntid		= 0,
+		.num_entries	= ARRAY_SIZE(sc_list->sc_entry),
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("cntid",        'c', &cfg.cntid,         controller),
+		  OPT_UINT("num-entries",  'e', &cfg.num_entries,   num_entries));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (!cfg.num_entries) {
+		nvme_show_error("non-zero num-entries is required param");
+		return -EINVAL;
+	}
+
+	sc_list = nvme_alloc(sizeof(*sc_list));
+	if (!sc_list)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_secondary_ctrl_list(dev, cfg.cntid, sc_list);
+	if (!err)
+		nvme_show_list_secondary_ctrl(sc_list, cfg.num_entries, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("id secondary controller list: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+/* the whole secondary controller list, read 127 entries at a time */
+static int virt_secondary_list(struct nvme_dev *dev, struct nvme_secondary_ctrl **listp,
+			       int *nrp)
+{
+	_cleanup_free_ struct nvme_secondary_ctrl_list *sc_list = NULL;
+	struct nvme_secondary_ctrl *list = NULL, *tmp;
+	int n, max_n, nr = 0, err;
+	__u16 cntid = 0;
+
+	sc_list = nvme_alloc(sizeof(*sc_list));
+	if (!sc_list)
+		return -ENOMEM;
+	max_n = ARRAY_SIZE(sc_list->sc_entry);
+
+	do {
+		err = nvme_cli_identify_secondary_ctrl_list(dev, cntid, sc_list);
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				nvme_show_error("id secondary controller list: %s",
+						nvme_strerror(errno));
+			free(list);
+			return err;
+		}
+
+		n = min(sc_list->num, max_n);
+		if (!n)
+			break;
+		tmp = realloc(list, (nr + n) * sizeof(*list));
+		if (!tmp) {
+			free(list);
+			return -ENOMEM;
+		}
+		list = tmp;
+		memcpy(list + nr, sc_list->sc_entry, n * sizeof(*list));
+		nr += n;
+		cntid = le16_to_cpu(list[nr - 1].scid) + 1;
+	} while (n == max_n && cntid);
+
+	*listp = list;
+	*nrp = nr;
+	return 0;
+}
+
+/*
+ * The flexible resources each of @nr secondary controllers gets out of
+ * @pool: @per if given, or an even split rounded down to the granularity
+ * and capped at the largest assignment the controller takes.
+ */
+static int virt_split(const char *rt, __u32 pool, __u16 per, __u16 max, __u16 gran,
+		      __u16 least, int nr, __u16 *res)
+{
+	__u32 v = per;
+
+	if (!nr)
+		return 0;
+
+	if (!v) {
+		v = pool / nr;
+		if (max && v > max)
+			v = max;
+		if (gran > 1)
+			v -= v % gran;
+	}
+
+	if (v < least || (__u64)v * nr > pool || (max && v > max) ||
+	    (gran > 1 && v % gran)) {
+		nvme_show_error("%u %s resource(s) for each of %d secondary controller(s) don't fit: %u flexible, at most %u per controller, granularity %u",
+				v, rt, nr, pool, max, gran);
+		return -EINVAL;
+	}
+
+	*res = v;
+	return 0;
+}
+
+static void virt_provision_cmd(struct nvme_dev *dev, struct nvme_virt_provision *p,
+			       struct nvme_virt_provision_ctrl *c, const char *step,
+			       __u8 act, __u8 rt, __u16 nr)
+{
+	__u32 result;
+	int err;
+
+	struct nvme_virtual_mgmt_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.act		= act,
+		.rt		= rt,
+		.cntlid		= c->scid,
+		.nr		= nr,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+
+	p->nr_cmds++;
+	err = nvme_virtual_mgmt(&args);
+	if (err) {
+		c->err = err < 0 ? -errno : err;
+		c->step = step;
+	}
+}
+
+/*
+ * Assign the resources of @rt, to the controllers losing some first so
+ * that the others can take them.
+ */
+static void virt_provision_assign(struct nvme_dev *dev, struct nvme_virt_provision *p,
+				  __u8 rt)
+{
+	struct nvme_virt_provision_ctrl *c;
+	bool vq = rt == NVME_VIRT_MGMT_RT_VQ_RESOURCE;
+	__u16 nr, old;
+	int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < p->nr_ctrls; i++) {
+			c = &p->ctrls[i];
+			nr = vq ? c->nvq : c->nvi;
+			old = vq ? c->old_nvq : c->old_nvi;
+			if (c->err || (pass == 0) != (nr < old) || nr == old)
+				continue;
+			virt_provision_cmd(dev, p, c, vq ? "assign VQ" : "assign VI",
+					   NVME_VIRT_MGMT_ACT_ASSIGN_SEC_CTRL, rt, nr);
+		}
+	}
+}
+
+static int virt_provision(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Provision the flexible resources of many secondary controllers "
+		"at once: read the primary controller capabilities and the secondary "
+		"controller list once, split the flexible VQ and VI resources between "
+		"the secondary controllers and send all the Virtualization Management "
+		"commands taking them offline, assigning the resources and bringing "
+		"them online.";
+	const char *count = "number of secondary controllers, lowest SCIDs first (default: all)";
+	const char *vq = "VQ resources of each secondary controller (default: even split)";
+	const char *vi = "VI resources of each secondary controller (default: even split)";
+	const char *offline = "leave the secondary controllers offline";
+	const char *dry_run = "print the resources of the controllers, send nothing";
+
+	_cleanup_free_ struct nvme_virt_provision_ctrl *ctrls = NULL;
+	_cleanup_free_ struct nvme_primary_ctrl_cap *caps = NULL;
+	_cleanup_free_ struct nvme_secondary_ctrl *list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_virt_provision p = { 0 };
+	struct nvme_virt_provision_ctrl *c;
+	__u64 vq_used, vi_used, start;
+	enum nvme_print_flags flags;
+	__u16 nvq = 0, nvi = 0;
+	int i, nr, total, err;
+
+	struct config {
+		__u32	count;
+		__u16	vq;
+		__u16	vi;
+		bool	offline;
+		bool	dry_run;
+	};
+
+	struct config cfg = {
+		.count		= 0,
+		.vq		= 0,
+		.vi		= 0,
+		.offline	= false,
+		.dry_run	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("count",    'N', &cfg.count,   count),
+		  OPT_SHRT("vq",       'q', &cfg.vq,      vq),
+		  OPT_SHRT("vi",       'i', &cfg.vi,      vi),
+		  OPT_FLAG("offline",  'f', &cfg.offline, offline),
+		  OPT_FLAG("dry-run",  'D', &cfg.dry_run, dry_run));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	caps = nvme_alloc(sizeof(*caps));
+	if (!caps)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_primary_ctrl(dev, 0, caps);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("identify primary controller capabilities: %s",
+					nvme_strerror(errno));
+		return err;
+	}
+	if (!(caps->crt & 0x3)) {
+		nvme_show_error("%s: no flexible resources to assign", dev->name);
+		return -ENOTSUP;
+	}
+
+	err = virt_secondary_list(dev, &list, &total);
+	if (err)
+		return err;
+	if (cfg.count > (__u32)total) {
+		nvme_show_error("%s: %u secondary controller(s) asked for, %d found",
+				dev->name, cfg.count, total);
+		return -EINVAL;
+	}
+	nr = cfg.count ? (int)cfg.count : total;
+	if (!nr) {
+		nvme_show_error("%s: no secondary controllers", dev->name);
+		return -ENODEV;
+	}
+
+	/* the primary and the secondary controllers left alone keep theirs */
+	vq_used = le16_to_cpu(caps->vqrfap);
+	vi_used = le16_to_cpu(caps->virfap);
+	for (i = nr; i < total; i++) {
+		vq_used += le16_to_cpu(list[i].nvq);
+		vi_used += le16_to_cpu(list[i].nvi);
+	}
+	p.vq_pool = le32_to_cpu(caps->vqfrt) - min(vq_used, (__u64)le32_to_cpu(caps->vqfrt));
+	p.vi_pool = le32_to_cpu(caps->vifrt) - min(vi_used, (__u64)le32_to_cpu(caps->vifrt));
+
+	/* an online secondary controller needs an admin and an I/O queue */
+	if (caps->crt & 0x1) {
+		err = virt_split("VQ", p.vq_pool, cfg.vq, le16_to_cpu(caps->vqfrsm),
+				 le16_to_cpu(caps->vqgran), cfg.offline ? 0 : 2, nr, &nvq);
+		if (err)
+			return err;
+	}
+	if (caps->crt & 0x2) {
+		err = virt_split("VI", p.vi_pool, cfg.vi, le16_to_cpu(caps->vifrsm),
+				 le16_to_cpu(caps->vigran), cfg.offline ? 0 : 1, nr, &nvi);
+		if (err)
+			return err;
+	}
+
+	ctrls = calloc(nr, sizeof(*ctrls));
+	if (!ctrls)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		c = &ctrls[i];
+		c->scid = le16_to_cpu(list[i].scid);
+		c->vfn = le16_to_cpu(list[i].vfn);
+		c->old_nvq = le16_to_cpu(list[i].nvq);
+		c->old_nvi = le16_to_cpu(list[i].nvi);
+		c->nvq = caps->crt & 0x1 ? nvq : c->old_nvq;
+		c->nvi = caps->crt & 0x2 ? nvi : c->old_nvi;
+		c->online = list[i].scs & 0x1;
+	}
+	p.name = dev->name;
+	p.ctrls = ctrls;
+	p.nr_ctrls = nr;
+
+	if (cfg.dry_run) {
+		p.dry_run = true;
+		nvme_show_virt_provision(&p, flags);
+		return 0;
+	}
+
+	/* resources are only assigned to offline secondary controllers */
+	start = monotonic_ns();
+	for (i = 0; i < nr; i++) {
+		c = &ctrls[i];
+		if (!c->online)
+			continue;
+		virt_provision_cmd(dev, &p, c, "offline",
+				   NVME_VIRT_MGMT_ACT_OFFLINE_SEC_CTRL, 0, 0);
+		c->online = !!c->err;
+	}
+
+	virt_provision_assign(dev, &p, NVME_VIRT_MGMT_RT_VQ_RESOURCE);
+	virt_provision_assign(dev, &p, NVME_VIRT_MGMT_RT_VI_RESOURCE);
+
+	for (i = 0; i < nr && !cfg.offline; i++) {
+		c = &ctrls[i];
+		if (c->err)
+			continue;
+		virt_provision_cmd(dev, &p, c, "online",
+				   NVME_VIRT_MGMT_ACT_ONLINE_SEC_CTRL, 0, 0);
+		c->online = !c->err;
+	}
+	p.elapsed_ns = monotonic_ns() - start;
+
+	nvme_show_virt_provision(&p, flags);
+
+	for (i = 0; i < nr; i++)
+		if (ctrls[i].err)
+			return ctrls[i].err;
+
+	return 0;
+}
+
+static void intr_self_test(int signum)
+{
+	printf("\nInterrupted device self-test operation by %s\n", strsignal(signum));
+
+	errno = EINTR;
+}
+
+static int sleep_self_test(unsigned int seconds)
+{
+	errno = 0;
+
+	sleep(seconds);
+
+	if (errno)
+		return -errno;
+
+	return 0;
+}
+
+static int wait_self_test(struct nvme_dev *dev)
+{
+	static const char spin[] = {'-', '\\', '|', '/' };
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	int err, i = 0, p = 0, cnt = 0;
+	int wthr;
+
+	signal(SIGINT, intr_self_test);
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
+
+	printf("Waiting for self test completion...\n");
+	while (true) {
+		printf("\r[%.*s%c%.*s] %3d%%", p / 2, dash, spin[i % 4], 49 - p / 2, space, p);
+		fflush(stdout);
+		err = sleep_self_test(1);
+		if (err)
+			return err;
+
+		err = nvme_cli_get_log_device_self_test(dev, log);
+		if (err) {
+			printf("\n");
+			if (err < 0)
+				perror("self test log\n");
+			else
+				nvme_show_status(err);
+			return err;
+		}
+
+		if (++cnt > wthr) {
+			nvme_show_error("no progress for %d seconds, stop waiting", wthr);
+			return -EIO;
+		}
+
+		if (log->completion == 0 && p > 0) {
+			printf("\r[%.*s] %3d%%\n", 50, dash, 100);
+			break;
+		}
+
+		if (log->completion < p) {
+			printf("\n");
+				nvme_show_error("progress broken");
+				return -EIO;
+		} else if (log->completion != p) {
+			p = log->completion;
+			cnt = 0;
+		}
+
+		i++;
+	}
+
+	return 0;
+}
+
+static void abort_self_test(struct nvme_dev_self_test_args *args)
+{
+	int err;
+
+	args->stc = NVME_DST_STC_ABORT;
+
+	err = nvme_dev_self_test(args);
+	if (!err)
+		printf("Aborting device self-test operation\n");
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+}
+
+static int device_self_test(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Implementing the device self-test feature "
+		"which provides the necessary log to determine the state of the device";
+	const char *namespace_id =
+	    "Indicate the namespace in which the device self-test has to be carried out";
+	const char *self_test_code =
+		"This field specifies the action taken by the device self-test command :\n"
+		"0h Show current state of device self-test operation\n"
+		"1h Start a short device self-test operation\n"
+		"2h Start a extended device self-test operation\n"
+		"eh Start a vendor specific device self-test operation\n"
+		"fh Abort the device self-test operation";
+	const char *wait = "Wait for the test to finish";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u8	stc;
+		bool	wait;
+	};
+
+	struct config cfg = {
+		.namespace_id	= NVME_NSID_ALL,
+		.stc		= NVME_ST_CODE_RESERVED,
+		.wait		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
+		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code),
+		  OPT_FLAG("wait",           'w', &cfg.wait,         wait));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.stc == NVME_ST_CODE_RESERVED) {
+		_cleanup_free_ struct nvme_self_test_log *log = NULL;
+
+		log = nvme_alloc(sizeof(*log));
+		if (!log)
+			return -ENOMEM;
+
+		err = nvme_cli_get_log_device_self_test(dev, log);
+		if (err) {
+			printf("\n");
+			if (err < 0)
+				perror("self test log\n");
+			else
+				nvme_show_status(err);
+		}
+
+		if (log->completion == 0) {
+			printf("no self test running\n");
+		} else {
+			if (cfg.wait)
+				err = wait_self_test(dev);
+			else
+				printf("progress %d%%\n", log->completion);
+		}
+
+		goto check_abort;
+	}
+
+	struct nvme_dev_self_test_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.stc		= cfg.stc,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_dev_self_test(&args);
+	if (!err) {
+		if (cfg.stc == NVME_ST_CODE_ABORT)
+			printf("Aborting device self-test operation\n");
+		else if (cfg.stc == NVME_ST_CODE_EXTENDED)
+			printf("Extended Device self-test started\n");
+		else if (cfg.stc == NVME_ST_CODE_SHORT)
+			printf("Short Device self-test started\n");
+
+		if (cfg.wait && cfg.stc != NVME_ST_CODE_ABORT)
+			err = wait_self_test(dev);
+	} else if (err > 0) {
+		nvme_show_status(err);
+	} else {
+		nvme_show_error("Device self-test: %s", nvme_strerror(errno));
+	}
+
+check_abort:
+	if (err == -EINTR)
+		abort_self_test(&args);
+
+	return err;
+}
+
+/*
+ * Only the Current Device Self-Test Operation and Completion bytes at the
+ * start of the log are read while a test is running.
+ */
+static int self_test_progress(struct nvme_dev *dev, __u8 *op, __u8 *completion)
+{
+	__u8 buf[4];
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_DEVICE_SELF_TEST,
+		.nsid		= NVME_NSID_ALL,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.lpo		= 0,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= sizeof(buf),
+		.log		= buf,
+		.result		= NULL,
+	};
+	int err;
+
+	err = nvme_cli_get_log_page(dev, sizeof(buf), &args);
+	if (err)
+		return err;
+
+	*op = buf[0] & 0xf;
+	*completion = buf[1] & 0x7f;
+	return 0;
+}
+
+static int self_test_result(struct nvme_dev *dev, struct nvme_self_test_dev *d)
+{
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	int err;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_device_self_test(dev, log);
+	if (err)
+		return err;
+
+	d->done = true;
+	d->result = log->result[0].dsts & NVME_ST_RESULT_MASK;
+	d->stc = log->result[0].dsts >> NVME_ST_CODE_SHIFT;
+	d->segment = log->result[0].seg;
+	d->poh = le64_to_cpu(log->result[0].poh);
+	return 0;
+}
+
+/* redrawn in place on a terminal, appended otherwise */
+static void self_test_run_table(struct nvme_self_test_dev *devs, int nr_devs,
+				bool redraw)
+{
+	struct nvme_self_test_dev *d;
+	int i, running = 0, sum = 0;
+
+	if (redraw)
+		fprintf(stderr, "\033[%dA", nr_devs + 1);
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->running) {
+			running++;
+			sum += d->progress;
+		}
+		fprintf(stderr, "%-16s %-30s %3u%% %6.0fs\033[K\n", d->name,
+			d->err ? "error" : d->running ? "running" :
+			d->done ? nvme_self_test_result_to_string(d->result) : "-",
+			d->done && !d->err ? 100 : d->progress, d->elapsed_ns / 1e9);
+	}
+	fprintf(stderr, "%d of %d running, %d%% average\033[K\n", running, nr_devs,
+		running ? sum / running : 100);
+}
+
+struct self_test_job {
+	struct nvme_dev *dev;
+	int wthr;		/* seconds without progress before giving up */
+	int stall;		/* seconds without progress */
+	bool aborted;
+};
+
+static int self_test_abort(struct self_test_job *job, __u32 nsid)
+{
+	struct nvme_dev_self_test_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(job->dev),
+		.nsid		= nsid,
+		.stc		= NVME_ST_CODE_ABORT,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+
+	job->aborted = true;
+	return nvme_dev_self_test(&args);
+}
+
+static int self_test_run(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Start a device self-test on several controllers at once and\n"
+		"poll their progress until every test finished. Devices are given\n"
+		"as arguments, by default or with 'all' every controller found in\n"
+		"the topology is used.";
+	const char *namespace_id = "namespace to test";
+	const char *self_test_code = "1h short or 2h extended device self-test";
+	const char *interval = "seconds between progress polls";
+
+	_cleanup_free_ struct nvme_self_test_dev *devs = NULL;
+	_cleanup_free_ struct self_test_job *job = NULL;
+	struct nvme_id_ctrl *ctrl = NULL;
+	enum nvme_print_flags flags;
+	char **paths = NULL;
+	int nr_devs = 0, running = 0, i, err;
+	__u8 op, completion;
+	__u64 start, next;
+	bool redraw, drawn = false, aborting = false;
+
+	struct config {
+		__u32	namespace_id;
+		__u8	stc;
+		__u32	interval;
+	};
+
+	struct config cfg = {
+		.namespace_id	= NVME_NSID_ALL,
+		.stc		= NVME_ST_CODE_SHORT,
+		.interval	= 5,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id, namespace_id),
+		  OPT_BYTE("self-test-code", 's', &cfg.stc,          self_test_code),
+		  OPT_UINT("interval",       'i', &cfg.interval,     interval));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if ((cfg.stc != NVME_ST_CODE_SHORT && cfg.stc != NVME_ST_CODE_EXTENDED) ||
+	    !cfg.interval) {
+		nvme_show_error("self-test-code must be 1 or 2 and interval at least 1");
+		return -EINVAL;
+	}
+
+	err = ctrl_paths_get(argc, argv, &paths, &nr_devs);
+	if (err)
+		goto free;
+
+	if (!nr_devs) {
+		nvme_show_error("no devices found");
+		err = -ENODEV;
+		goto free;
+	}
+
+	devs = calloc(nr_devs, sizeof(*devs));
+	job = calloc(nr_devs, sizeof(*job));
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!devs || !job || !ctrl) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	/* start all tests first, they run concurrently on the controllers */
+	start = monotonic_ns();
+	for (i = 0; i < nr_devs; i++) {
+		struct nvme_dev_self_test_args args = {
+			.args_size	= sizeof(args),
+			.nsid		= cfg.namespace_id,
+			.stc		= cfg.stc,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+
+		devs[i].path = paths[i];
+		devs[i].name = basename(devs[i].path);
+		if (open_dev_direct(&job[i].dev, devs[i].path, O_RDONLY)) {
+			devs[i].err = -errno;
+			continue;
+		}
+
+		err = nvme_cli_identify_ctrl(job[i].dev, ctrl);
+		if (!err)
+			err = self_test_progress(job[i].dev, &op, &completion);
+		if (!err && op) {
+			/* someone else's test, leave it alone */
+			err = -EBUSY;
+		} else if (!err) {
+			args.fd = dev_fd(job[i].dev);
+			err = nvme_dev_self_test(&args);
+		}
+		if (err) {
+			devs[i].err = err == -1 ? -errno : err;
+			continue;
+		}
+
+		/* same no progress limit as device-self-test --wait */
+		job[i].wthr = le16_to_cpu(ctrl->edstt) * 60 / 100 + 60;
+		devs[i].running = true;
+		running++;
+	}
+
+	redraw = isatty(STDERR_FILENO);
+	next = monotonic_ns();
+	while (running) {
+		/*
+		 * On an interrupt the tests are aborted right away, then the
+		 * flag is cleared to poll the aborts at the interval again.
+		 */
+		next += cfg.interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next)) {
+			aborting = true;
+			nvme_stop_flag = 0;
+		}
+
+		for (i = 0; i < nr_devs; i++) {
+			struct nvme_self_test_dev *d = &devs[i];
+
+			if (!d->running)
+				continue;
+
+			/* aborted tests are polled until the abort took effect */
+			if (job[i].stall > job[i].wthr) {
+				err = self_test_abort(&job[i], cfg.namespace_id);
+				if (!err)
+					err = -ETIMEDOUT;
+			} else if (aborting && !job[i].aborted) {
+				err = self_test_abort(&job[i], cfg.namespace_id);
+			} else {
+				err = self_test_progress(job[i].dev, &op, &completion);
+				if (!err && op) {
+					job[i].stall = completion == d->progress ?
+						job[i].stall + cfg.interval : 0;
+					d->progress = completion;
+				} else if (!err) {
+					err = self_test_result(job[i].dev, d);
+				}
+			}
+
+			d->elapsed_ns = monotonic_ns() - start;
+			if (err || d->done) {
+				if (err)
+					d->err = err == -1 ? -errno : err;
+				d->running = false;
+				running--;
+			}
+		}
+
+		self_test_run_table(devs, nr_devs, redraw && drawn);
+		drawn = true;
+	}
+
+	nvme_stop_release();
+
+	nvme_show_self_test_run(devs, nr_devs, flags);
+
+	err = 0;
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err)
+			err = devs[i].err;
+		else if (devs[i].result != NVME_ST_RESULT_NO_ERR)
+			err = -EIO;
+	}
+
+free:
+	for (i = 0; job && i < nr_devs; i++)
+		if (job[i].dev)
+			dev_close(job[i].dev);
+	free(ctrl);
+	ctrl_paths_free(paths, nr_devs);
+
+	return err;
+}
+
+static int self_test_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve the self-test log for the given device and given test "
+		"(or optionally a namespace) in either decoded format (default) or binary.";
+	const char *dst_entries = "Indicate how many DST log entries to be retrieved, "
+		"by default all the 20 entries will be retrieved";
+
+	_cleanup_free_ struct nvme_self_test_log *log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u8	dst_entries;
+	};
+
+	struct config cfg = {
+		.dst_entries	= NVME_LOG_ST_MAX_RESULTS,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("dst-entries",  'e', &cfg.dst_entries,   dst_entries));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (argconfig_parse_seen(opts, "verbose"))
+		flags |= VERBOSE;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_cli_get_log_device_self_test(dev, log);
+	if (!err)
+		nvme_show_self_test_log(log, cfg.dst_entries, 0, dev->name, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("self test log: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+/* the data length of the feature and its buffer, -1 if it can't be allocated */
+static int get_feature_id_prep(struct feat_cfg *cfg, void **buf)
+{
+	if (!cfg->data_len)
+		nvme_get_feature_length(cfg->feature_id, cfg->cdw11,
+					&cfg->data_len);
+
+	/* check for Extended Host Identifier */
+	if (cfg->feature_id == NVME_FEAT_FID_HOST_ID && (cfg->cdw11 & 0x1))
+		cfg->data_len = 16;
+
+	if (cfg->feature_id == NVME_FEAT_FID_FDP_EVENTS) {
+		cfg->data_len = 0xff * sizeof(__u16);
+		cfg->cdw11 |= 0xff << 16;
+	}
+
+	if (cfg->sel == 3)
+		cfg->data_len = 0;
+
+	if (cfg->data_len) {
+		*buf = nvme_alloc(cfg->data_len - 1);
+		if (!*buf)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int get_feature_id(struct nvme_dev *dev, struct feat_cfg *cfg,
+			  void **buf, __u32 *result)
+{
+	if (get_feature_id_prep(cfg, buf))
+		return -1;
+
+	struct nvme_get_features_args args = {
+		.args_size	= sizeof(args),
+		.fid		= cfg->feature_id,
+		.nsid		= cfg->namespace_id,
+		.sel		= cfg->sel,
+		.cdw11		= cfg->cdw11,
+		.uuidx		= cfg->uuid_index,
+		.data_len	= cfg->data_len,
+		.data		= *buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= result,
+	};
+	return nvme_cli_get_features(dev, &args);
+}
+
+static int filter_out_flags(int status)
+{
+	return status & (NVME_GET(NVME_SCT_MASK, SCT) |
+			 NVME_GET(NVME_SC_MASK, SC));
+}
+
+static void get_feature_id_print(struct feat_cfg cfg, int err, __u32 result,
+				 void *buf)
+{
+	int status = filter_out_flags(err);
+	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+
+	if (!err) {
+		if (!cfg.raw_binary || !buf) {
+			nvme_feature_show(cfg.feature_id, cfg.sel, result);
+			if (cfg.sel == 3)
+				nvme_show_select_result(cfg.feature_id, result);
+			else if (cfg.human_readable)
+				nvme_feature_show_fields(cfg.feature_id, result,
+							 buf);
+			else if (buf)
+				d(buf, cfg.data_len, 16, 1);
+		} else if (buf) {
+			d_raw(buf, cfg.data_len);
+		}
+	} else if (err > 0) {
+		if (!nvme_status_equals(status, type, NVME_SC_INVALID_FIELD) &&
+		    !nvme_status_equals(status,  type, NVME_SC_INVALID_NS))
+			nvme_show_status(err);
+	} else {
+		nvme_show_error("get-feature: %s", nvme_strerror(errno));
+	}
+}
+
+struct feat_entry {
+	struct feat_cfg cfg;
+	void *buf;
+	__u32 result;
+	int err;
+	int errnum;	/* errno of a failure, printed after the fact */
+	bool show;	/* not a changed-only query, or differs from the default */
+};
+
+static void get_feature_id_fetch(struct nvme_dev *dev, struct feat_entry *e,
+				 bool changed)
+{
+	void *buf_def = NULL;
+	__u32 result_def;
+	int err_def;
+
+	e->show = true;
+	if (changed)
+		e->cfg.sel = 0;
+
+	e->err = get_feature_id(dev, &e->cfg, &e->buf, &e->result);
+	e->errnum = errno;
+
+	if (!e->err && changed) {
+		e->cfg.sel = 1;
+		err_def = get_feature_id(dev, &e->cfg, &buf_def, &result_def);
+		e->show = err_def || e->result != result_def ||
+			(e->buf && buf_def && memcmp(e->buf, buf_def, e->cfg.data_len));
+		free(buf_def);
+	}
+
+	if (changed)
+		e->cfg.sel = 8;
+}
+
+static void get_feature_id_show(struct feat_entry *e)
+{
+	if (!e->err && !e->show)
+		return;
+
+	errno = e->errnum;
+	get_feature_id_print(e->cfg, e->err, e->result, e->buf);
+}
+
+static int get_feature_id_changed(struct nvme_dev *dev, struct feat_cfg cfg,
+				  bool changed)
+{
+	struct feat_entry e = { .cfg = cfg };
+
+	get_feature_id_fetch(dev, &e, changed);
+	get_feature_id_show(&e);
+	free(e.buf);
+
+	return e.err;
+}
+
+/* Upper bound for the Get Features of a sweep in flight */
+#define FEAT_SWEEP_JOBS	8
+
+/* the current value and, for a changed-only query, the default one */
+struct feat_sweep_job {
+	struct feat_entry *e;
+	struct nvme_fanout_cmd cur;
+	struct nvme_fanout_cmd def;
+	void *buf_def;
+	int err_def;
+	int left;
+	bool changed;
+};
+
+static void get_feature_id_cmd(struct nvme_passthru_cmd64 *cmd,
+			       const struct feat_cfg *cfg, void *buf)
+{
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_admin_get_features;
+	cmd->nsid = cfg->namespace_id;
+	cmd->addr = (__u64)(uintptr_t)buf;
+	cmd->data_len = buf ? cfg->data_len : 0;
+	/* FID in bits 7:0 and SEL in bits 10:8, the UUID index in CDW14 */
+	cmd->cdw10 = cfg->feature_id | (cfg->sel & 0x7) << 8;
+	cmd->cdw11 = cfg->cdw11;
+	cmd->cdw14 = cfg->uuid_index & 0x7f;
+	cmd->timeout_ms = NVME_DEFAULT_IOCTL_TIMEOUT;
+}
+
+/* errors in the libnvme convention, -1 with the errno kept apart */
+static void feat_sweep_status(int status, int *err, int *errnum)
+{
+	*err = status < 0 ? -1 : status;
+	*errnum = status < 0 ? -status : 0;
+}
+
+static void feat_sweep_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct feat_sweep_job *job = fc->priv;
+	struct feat_entry *e = job->e;
+	int errnum;
+
+	if (fc == &job->cur) {
+		feat_sweep_status(status, &e->err, &e->errnum);
+		e->result = fc->cmd.result;
+	} else {
+		feat_sweep_status(status, &job->err_def, &errnum);
+	}
+	if (--job->left)
+		return;
+
+	if (job->changed) {
+		if (!e->err)
+			e->show = job->err_def || e->result != (__u32)job->def.cmd.result ||
+				(e->buf && job->buf_def &&
+				 memcmp(e->buf, job->buf_def, e->cfg.data_len));
+		e->cfg.sel = 8;
+	}
+	free(job->buf_def);
+	job->buf_def = NULL;
+}
+
+static int feat_sweep_queue(struct nvme_fanout *f, int fd, struct feat_sweep_job *job)
+{
+	struct feat_entry *e = job->e;
+	struct feat_cfg def;
+	int err;
+
+	e->show = true;
+	if (job->changed)
+		e->cfg.sel = 0;
+	if (get_feature_id_prep(&e->cfg, &e->buf))
+		return -ENOMEM;
+
+	get_feature_id_cmd(&job->cur.cmd, &e->cfg, e->buf);
+	job->left = 1;
+
+	if (job->changed) {
+		def = e->cfg;
+		def.sel = 1;
+		if (get_feature_id_prep(&def, &job->buf_def))
+			return -ENOMEM;
+		get_feature_id_cmd(&job->def.cmd, &def, job->buf_def);
+		job->left++;
+	}
+
+	err = nvme_fanout_queue(f, &job->cur, fd, feat_sweep_done, job);
+	if (!err && job->changed)
+		err = nvme_fanout_queue(f, &job->def, fd, feat_sweep_done, job);
+
+	return err;
+}
+
+/*
+ * The FIDs to sweep, the ones the FID Supported and Effects log reports
+ * supported or, if the controller has no such log, all of them.
+ */
+static int feat_sweep_ids(struct nvme_dev *dev, struct feat_cfg cfg,
+			  struct feat_entry *e)
+{
+	_cleanup_free_ struct nvme_fid_supported_effects_log *log = NULL;
+	int fid, nr = 0;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	if (!nvme_cli_get_log_fid_supported_effects(dev, false, log)) {
+		for (fid = 0; fid < NVME_LOG_FID_SUPPORTED_EFFECTS_MAX; fid++) {
+			if (!(le32_to_cpu(log->fid_support[fid]) &
+			      NVME_FID_SUPPORTED_EFFECTS_FSUPP))
+				continue;
+			e[nr].cfg = cfg;
+			e[nr++].cfg.feature_id = fid;
+		}
+	}
+	if (nr)
+		return nr;
+
+	for (fid = 0; fid < NVME_LOG_FID_SUPPORTED_EFFECTS_MAX; fid++) {
+		e[fid].cfg = cfg;
+		e[fid].cfg.feature_id = fid;
+	}
+
+	return NVME_LOG_FID_SUPPORTED_EFFECTS_MAX;
+}
+
+/*
+ * Get the features of all the entries at once: the commands to a direct
+ * device are sent concurrently from one io_uring, the results are left in
+ * the entries.
+ */
+static int feat_sweep(struct nvme_dev *dev, struct feat_entry *e, int nr, bool changed)
+{
+	_cleanup_free_ struct feat_sweep_job *job = NULL;
+	struct nvme_fanout f;
+	int i, ret, err = 0;
+
+	if (nr < 2 || !cmd_concurrent(dev, true, nvme_admin_get_features)) {
+		for (i = 0; i < nr; i++)
+			get_feature_id_fetch(dev, &e[i], changed);
+		return 0;
+	}
+
+	job = calloc(nr, sizeof(*job));
+	if (!job)
+		return -ENOMEM;
+
+	nvme_fanout_init(&f, 2 * FEAT_SWEEP_JOBS, FEAT_SWEEP_JOBS);
+	for (i = 0; i < nr && !err; i++) {
+		job[i].e = &e[i];
+		job[i].changed = changed;
+		err = feat_sweep_queue(&f, dev_fd(dev), &job[i]);
+	}
+	/* the ones queued before a failure complete all the same */
+	ret = nvme_fanout_run(&f);
+	nvme_fanout_exit(&f);
+	if (!err)
+		err = ret;
+
+	for (i = 0; i < nr; i++)
+		free(job[i].buf_def);
+
+	return err;
+}
+
+/* all the features, printed in FID order once they are all retrieved */
+static int get_feature_sweep(struct nvme_dev *dev, struct feat_cfg cfg)
+{
+	_cleanup_free_ struct feat_entry *e = NULL;
+	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+	int i, nr, status, err = 0;
+
+	e = calloc(NVME_LOG_FID_SUPPORTED_EFFECTS_MAX, sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+
+	nr = feat_sweep_ids(dev, cfg, e);
+	if (nr < 0)
+		return nr;
+
+	err = feat_sweep(dev, e, nr, cfg.sel == 8);
+	if (err)
+		goto free;
+
+	for (i = 0; i < nr; i++) {
+		get_feature_id_show(&e[i]);
+		err = e[i].err;
+		if (!err)
+			continue;
+		status = filter_out_flags(err);
+		if (nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
+			continue;
+		if (!nvme_status_equals(status, type, NVME_SC_INVALID_NS))
+			break;
+		nvme_show_error_status(err, "get-feature:%#0*x (%s)", e[i].cfg.feature_id ? 4 : 2,
+				       e[i].cfg.feature_id,
+				       nvme_feature_to_string(e[i].cfg.feature_id));
+	}
+
+free:
+	for (i = 0; i < nr; i++)
+		free(e[i].buf);
+
+	return err;
+}
+
+static int get_feature_ids(struct nvme_dev *dev, struct feat_cfg cfg)
+{
+	int err = 0;
+	int status = 0;
+	enum nvme_status_type type = NVME_STATUS_TYPE_NVME;
+
+	if (!cfg.feature_id)
+		return get_feature_sweep(dev, cfg);
+
+	err = get_feature_id_changed(dev, cfg, cfg.sel == 8);
+	if (!err)
+		return 0;
+
+	status = filter_out_flags(err);
+	if (nvme_status_equals(status, type, NVME_SC_INVALID_FIELD))
+		nvme_show_status(err);
+	else if (nvme_status_equals(status, type, NVME_SC_INVALID_NS))
+		nvme_show_error_status(err, "get-feature:%#0*x (%s)", 4,
+				       cfg.feature_id, nvme_feature_to_string(cfg.feature_id));
+
+	return err;
+}
+
+static int get_feature(int argc, char **argv, struct command *cmd,
+		       struct plugin *plugin)
+{
+	const char *desc = "Read operating parameters of the "
+		"specified controller. Operating parameters are grouped "
+		"and identified by Feature Identifiers; each Feature "
+		"Identifier contains one or more attributes that may affect "
+		"behavior of the feature. Each Feature has three possible "
+		"settings: default, saveable, and current. If a Feature is "
+		"saveable, it may be modified by set-feature. Default values "
+		"are vendor-specific and not changeable. Use set-feature to "
+		"change saveable Features.";
+	const char *raw = "show feature in binary format";
+	const char *feature_id = "feature identifier";
+	const char *sel = "[0-3,8]: current/default/saved/supported/changed";
+	const char *cdw11 = "feature specific dword 11";
+	const char *human_readable = "show feature in readable format";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct feat_cfg cfg = {
+		.feature_id	= 0,
+		.namespace_id	= 0,
+		.sel		= 0,
+		.data_len	= 0,
+		.raw_binary	= false,
+		.cdw11		= 0,
+		.uuid_index	= 0,
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("feature-id",     'f', &cfg.feature_id,     feature_id),
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_BYTE("sel",            's', &cfg.sel,            sel),
+		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw),
+		  OPT_UINT("cdw11",          'c', &cfg.cdw11,          cdw11),
+		  OPT_BYTE("uuid-index",     'U', &cfg.uuid_index,     uuid_index_specify),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!argconfig_parse_seen(opts, "namespace-id")) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			if (errno != ENOTTY) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return err;
+			}
+			cfg.namespace_id = NVME_NSID_ALL;
+		}
+	}
+
+	if (cfg.sel > 8) {
+		nvme_show_error("invalid 'select' param:%d", cfg.sel);
+		return -EINVAL;
+	}
+
+	if (cfg.uuid_index > 127) {
+		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
+		return -1;
+	}
+
+	nvme_show_init();
+
+	err = get_feature_ids(dev, cfg);
+
+	nvme_show_finish();
+
+	return err;
+}
+
+/*
+ * Transfers one chunk of firmware to the device, and decodes & reports any
+ * errors. Returns -1 on (fatal) error; signifying that the transfer should
+ * be aborted.
+ */
+static int fw_download_single(struct nvme_dev *dev, void *fw_buf,
+			      unsigned int fw_len, uint32_t offset,
+			      uint32_t len, bool progress, bool ignore_ovr)
+{
+	const unsigned int max_retries = 3;
+	bool retryable, ovr;
+	int err, try;
+
+	if (progress) {
+		printf("Firmware download: transferring 0x%08x/0x%08x bytes: %03d%%\r",
+		       offset, fw_len, (int)(100 * offset / fw_len));
+	}
+
+	struct nvme_fw_download_args args = {
+		.args_size	= sizeof(args),
+		.offset		= offset,
+		.data_len	= len,
+		.data		= fw_buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+
+	for (try = 0; try < max_retries; try++) {
+		if (try > 0) {
+			fprintf(stderr, "retrying offset %x (%u/%u)\n",
+				offset, try, max_retries);
+		}
+
+		err = nvme_cli_fw_download(dev, &args);
+		if (!err)
+			return 0;
+
+		/*
+		 * don't retry if the NVMe-type error indicates Do Not Resend.
+		 */
+		retryable = !((err > 0) &&
+			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
+			(nvme_status_get_value(err) & NVME_SC_DNR));
+
+		/*
+		 * detect overwrite errors, which are handled differently
+		 * depending on ignore_ovr
+		 */
+		ovr = (err > 0) &&
+			(nvme_status_get_type(err) == NVME_STATUS_TYPE_NVME) &&
+			(NVME_GET(err, SCT) == NVME_SCT_CMD_SPECIFIC) &&
+			(NVME_GET(err, SC) == NVME_SC_OVERLAPPING_RANGE);
+
+		if (ovr && ignore_ovr)
+			return 0;
+
+		/*
+		 * if we're printing progress, we'll need a newline to separate
+		 * error output from the progress data (which doesn't have a
+		 * \n), and flush before we write to stderr.
+		 */
+		if (progress) {
+			printf("\n");
+			fflush(stdout);
+		}
+
+		fprintf(stderr, "fw-download: error on offset 0x%08x/0x%08x\n",
+			offset, fw_len);
+
+		if (err < 0) {
+			fprintf(stderr, "fw-download: %s\n", nvme_strerror(errno));
+		} else {
+			nvme_show_status(err);
+			if (ovr) {
+				/*
+				 * non-ignored ovr error: print a little extra info
+				 * about recovering
+				 */
+				fprintf(stderr,
+					"Use --ignore-ovr to ignore overwrite errors\n");
+
+				/*
+				 * We'll just be attempting more overwrites if
+				 * we retry. DNR will likely be set, but force
+				 * an exit anyway.
+				 */
+				retryable = false;
+			}
+		}
+
+		if (!retryable)
+			break;
+	}
+
+	return -1;
+}
+
+/*
+ * The largest chunk the controller takes: the biggest multiple of the
+ * firmware update granularity that fits into MDTS. Stay at 4k if the
+ * controller doesn't report a granularity.
+ */
+static __u32 fw_download_xfer_len(struct nvme_id_ctrl *ctrl)
+{
+	__u32 max_xfer = ctrl_max_xfer_len(ctrl);
+	__u32 fwug;
+
+	if (ctrl->fwug == 0)
+		return 4096;
+	if (ctrl->fwug == 0xff)
+		return max_xfer;
+
+	fwug = ctrl->fwug * 4096;
+
+	return max(fwug, max_xfer / fwug * fwug);
+}
+
+/*
+ * Send the image in @fw_fd from byte @resume on in @xfer sized chunks, the
+ * next chunk is read from the file while the current one is transferred.
+ * @pos is set to the image offset reached.
+ */
+static int fw_download_image(struct nvme_dev *dev, int fw_fd, const char *fw,
+			     unsigned int fw_size, __u32 xfer, __u32 offset,
+			     __u32 resume, bool progress, bool ignore_ovr,
+			     unsigned int *pos)
+{
+	struct nvme_stream s;
+	void *fw_buf;
+	size_t len;
+	int err, serr;
+
+	*pos = resume;
+	if (resume && lseek(fw_fd, resume, SEEK_SET) < 0) {
+		err = -errno;
+		nvme_show_perror("lseek");
+		return err;
+	}
+
+	err = nvme_stream_init(&s, fw_fd, NVME_STREAM_FROM_FILE,
+			       fw_size - resume, xfer, 4);
+	if (err) {
+		nvme_show_error("read :%s :%s", fw, nvme_strerror(-err));
+		return err;
+	}
+
+	while ((fw_buf = nvme_stream_get(&s, &len))) {
+		err = fw_download_single(dev, fw_buf, fw_size, offset + *pos,
+					 len, progress, ignore_ovr);
+		nvme_stream_put(&s, len);
+		if (err)
+			break;
+		*pos += len;
+	}
+
+	serr = nvme_stream_finish(&s, err != 0);
+	if (!err && serr) {
+		nvme_show_error("read :%s :%s", fw, nvme_strerror(-serr));
+		err = serr;
+	}
+
+	return err;
+}
+
+static int fw_download(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Copy all or part of a firmware image to "
+		"a controller for future update. Optionally, specify how "
+		"many KiB of the firmware to transfer at once. The offset will "
+		"start at 0 and automatically adjust based on xfer size "
+		"unless fw is split across multiple files. May be submitted "
+		"while outstanding commands exist on the Admin and IO "
+		"Submission Queues. Activate downloaded firmware with "
+		"fw-activate, and then reset the device to apply the downloaded firmware.";
+	const char *fw = "firmware file (required)";
+	const char *xfer = "transfer chunksize limit";
+	const char *offset = "starting dword offset, default 0";
+	const char *progress = "display firmware transfer progress";
+	const char *ignore_ovr = "ignore overwrite errors";
+	const char *resume = "byte offset into the image to resume an interrupted download at";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_file_ int fw_fd = -1;
+	unsigned int fw_size, pos;
+	int err;
+	struct stat sb;
+	struct nvme_id_ctrl ctrl = { 0 };
+
+	struct config {
+		char	*fw;
+		__u32	xfer;
+		__u32	offset;
+		bool	progress;
+		bool	ignore_ovr;
+		__u32	resume;
+	};
+
+	struct config cfg = {
+		.fw         = "",
+		.xfer       = 0,
+		.offset     = 0,
+		.progress   = false,
+		.ignore_ovr = false,
+		.resume     = 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FILE("fw",         'f', &cfg.fw,         fw),
+		  OPT_UINT("xfer",       'x', &cfg.xfer,       xfer),
+		  OPT_UINT("offset",     'O', &cfg.offset,     offset),
+		  OPT_FLAG("progress",   'p', &cfg.progress,   progress),
+		  OPT_FLAG("ignore-ovr", 'i', &cfg.ignore_ovr, ignore_ovr),
+		  OPT_UINT("resume",     'r', &cfg.resume,     resume));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	fw_fd = open(cfg.fw, O_RDONLY);
+	cfg.offset <<= 2;
+	if (fw_fd < 0) {
+		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw, strerror(errno));
+		return -EINVAL;
+	}
+
+	err = fstat(fw_fd, &sb);
+	if (err < 0) {
+		nvme_show_perror("fstat");
+		return err;
+	}
+
+	fw_size = sb.st_size;
+	if ((fw_size & 0x3) || (fw_size == 0)) {
+		nvme_show_error("Invalid size:%d for f/w image", fw_size);
+		return -EINVAL;
+	}
+
+	if ((cfg.resume & 0x3) || cfg.resume >= fw_size) {
+		nvme_show_error("Invalid resume offset:%u for f/w image of size %u",
+				cfg.resume, fw_size);
+		return -EINVAL;
+	}
+
+	if (cfg.xfer == 0) {
+		err = nvme_cli_identify_ctrl(dev, &ctrl);
+		if (err) {
+			nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+			return err;
+		}
+		cfg.xfer = fw_download_xfer_len(&ctrl);
+		if (argconfig_parse_seen(opts, "verbose"))
+			printf("xfer: %u\n", cfg.xfer);
+	} else if (cfg.xfer % 4096)
+		cfg.xfer = 4096;
+
+	if (ctrl.fwug && ctrl.fwug != 0xff && fw_size % cfg.xfer)
+		nvme_show_error("WARNING: firmware file size %u not conform to FWUG alignment %lu",
+				fw_size, cfg.xfer);
+
+	err = fw_download_image(dev, fw_fd, cfg.fw, fw_size, cfg.xfer, cfg.offset,
+				cfg.resume, cfg.progress, cfg.ignore_ovr, &pos);
+	if (err && pos > cfg.resume)
+		fprintf(stderr, "fw-download: %u bytes transferred, continue with --resume=%u\n",
+			pos, pos);
+
+	if (!err) {
+		/* end the progress output */
+		if (cfg.progress)
+			printf("\n");
+		printf("Firmware download success\n");
+	}
+
+	return err;
+}
+
+static char *nvme_fw_status_reset_type(__u16 status)
+{
+	switch (status & 0x7ff) {
+	case NVME_SC_FW_NEEDS_CONV_RESET:
+		return "conventional";
+	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+		return "subsystem";
+	case NVME_SC_FW_NEEDS_RESET:
+		return "any controller";
+	default:
+		return "unknown";
+	}
+}
+
+static bool fw_commit_support_mud(struct nvme_dev *dev)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	int err;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return false;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+
+	if (err)
+		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+	else if (ctrl->frmw >> 5 & 0x1)
+		return true;
+
+	return false;
+}
+
+static void fw_commit_print_mud(struct nvme_dev *dev, __u32 result)
+{
+	if (!fw_commit_support_mud(dev))
+		return;
+
+	printf("Multiple Update Detected (MUD) Value: %u\n", result);
+
+	if (result & 0x1)
+		printf("Detected an overlapping firmware/boot partition image update command\n"
+		       "sequence due to processing a command from an Admin SQ on a controller\n");
+
+	if (result >> 1 & 0x1)
+		printf("Detected an overlapping firmware/boot partition image update command\n"
+		       "sequence due to processing a command from a Management Endpoint\n");
+}
+
+static int fw_commit(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Verify downloaded firmware image and "
+		"commit to specific firmware slot. Device is not automatically "
+		"reset following firmware activation. A reset may be issued "
+		"with an 'echo 1 > /sys/class/nvme/nvmeX/reset_controller'. "
+		"Ensure nvmeX is the device you just activated before reset.";
+	const char *slot = "[0-7]: firmware slot for commit action";
+	const char *action = "[0-7]: commit action";
+	const char *bpid = "[0,1]: boot partition identifier, if applicable (default: 0)";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u32 result;
+	int err;
+
+	struct config {
+		__u8	slot;
+		__u8	action;
+		__u8	bpid;
+	};
+
+	struct config cfg = {
+		.slot	= 0,
+		.action	= 0,
+		.bpid	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_BYTE("slot",   's', &cfg.slot,   slot),
+		  OPT_BYTE("action", 'a', &cfg.action, action),
+		  OPT_BYTE("bpid",   'b', &cfg.bpid,   bpid));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.slot > 7) {
+		nvme_show_error("invalid slot:%d", cfg.slot);
+		return -EINVAL;
+	}
+	if (cfg.action > 7 || cfg.action == 4 || cfg.action == 5) {
+		nvme_show_error("invalid action:%d", cfg.action);
+		return -EINVAL;
+	}
+	if (cfg.bpid > 1) {
+		nvme_show_error("invalid boot partition id:%d", cfg.bpid);
+		return -EINVAL;
+	}
+
+	struct nvme_fw_commit_args args = {
+		.args_size	= sizeof(args),
+		.slot		= cfg.slot,
+		.action		= cfg.action,
+		.bpid		= cfg.bpid,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_cli_fw_commit(dev, &args);
+
+	if (err < 0) {
+		nvme_show_error("fw-commit: %s", nvme_strerror(errno));
+	} else if (err != 0) {
+		__u32 val = nvme_status_get_value(err);
+		int type = nvme_status_get_type(err);
+
+		if (type == NVME_STATUS_TYPE_NVME) {
+			switch (val & 0x7ff) {
+			case NVME_SC_FW_NEEDS_CONV_RESET:
+			case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+			case NVME_SC_FW_NEEDS_RESET:
+				printf("Success activating firmware action:%d slot:%d",
+				       cfg.action, cfg.slot);
+				if (cfg.action == 6 || cfg.action == 7)
+					printf(" bpid:%d", cfg.bpid);
+				printf(", but firmware requires %s reset\n",
+				       nvme_fw_status_reset_type(val));
+				break;
+			default:
+				nvme_show_status(err);
+				break;
+			}
+		} else {
+			nvme_show_status(err);
+		}
+	} else {
+		printf("Success committing firmware action:%d slot:%d",
+		       cfg.action, cfg.slot);
+		if (cfg.action == 6 || cfg.action == 7)
+			printf(" bpid:%d", cfg.bpid);
+		printf("\n");
+		fw_commit_print_mud(dev, result);
+	}
+
+	return err;
+}
+
+struct fw_rollout_job {
+	struct nvme_fw_rollout_dev *dev;
+	const char *fw;
+	unsigned int fw_size;
+	__u32 xfer;
+	__u8 slot;
+	__u8 action;
+	const char *revision;
+};
+
+/* revisions are ASCII, padded with spaces */
+static void fw_slot_rev(struct nvme_firmware_slot *log, int slot, char *rev)
+{
+	int i;
+
+	rev[0] = '\0';
+	if (slot < 1 || slot > 7)
+		return;
+
+	memcpy(rev, log->frs[slot - 1], 8);
+	rev[8] = '\0';
+	for (i = 7; i >= 0 && (rev[i] == ' ' || !rev[i]); i--)
+		rev[i] = '\0';
+}
+
+static bool fw_commit_needs_reset(int err)
+{
+	if (err <= 0 || nvme_status_get_type(err) != NVME_STATUS_TYPE_NVME)
+		return false;
+
+	switch (nvme_status_get_value(err) & 0x7ff) {
+	case NVME_SC_FW_NEEDS_CONV_RESET:
+	case NVME_SC_FW_NEEDS_SUBSYS_RESET:
+	case NVME_SC_FW_NEEDS_RESET:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void fw_rollout_download(void *arg)
+{
+	struct fw_rollout_job *job = arg;
+	struct nvme_fw_rollout_dev *rdev = job->dev;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_firmware_slot *log = NULL;
+	_cleanup_file_ int fw_fd = -1;
+	__u64 start = monotonic_ns();
+	__u32 xfer = job->xfer;
+	unsigned int pos;
+	int err;
+
+	if (open_dev_direct(&dev, rdev->path, O_RDONLY)) {
+		rdev->err = -errno;
+		return;
+	}
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	log = nvme_alloc(sizeof(*log));
+	if (!ctrl || !log) {
+		rdev->err = -ENOMEM;
+		return;
+	}
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_get_log_fw_slot(dev, false, log);
+	if (err) {
+		/* libnvme reports transport failures as -1 with errno set */
+		rdev->err = err == -1 ? -errno : err;
+		return;
+	}
+
+	fw_slot_rev(log, log->afi & 0x7, rdev->old_rev);
+	if (job->revision && !strcmp(rdev->old_rev, job->revision)) {
+		rdev->skipped = true;
+		rdev->stage = NVME_FW_ROLLOUT_DONE;
+		return;
+	}
+
+	if (!xfer)
+		xfer = fw_download_xfer_len(ctrl);
+
+	rdev->stage = NVME_FW_ROLLOUT_DOWNLOAD;
+	fw_fd = open(job->fw, O_RDONLY);
+	if (fw_fd < 0) {
+		rdev->err = -errno;
+		return;
+	}
+
+	err = fw_download_image(dev, fw_fd, job->fw, job->fw_size, xfer, 0, 0,
+				false, false, &pos);
+	rdev->download_ns = monotonic_ns() - start;
+	if (err) {
+		/* fw_download_single() already reported the details */
+		rdev->err = err == -1 ? -EIO : err;
+		return;
+	}
+
+	rdev->stage = NVME_FW_ROLLOUT_COMMIT;
+}
+
+static void fw_rollout_commit(void *arg)
+{
+	struct fw_rollout_job *job = arg;
+	struct nvme_fw_rollout_dev *rdev = job->dev;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_firmware_slot *log = NULL;
+	__u64 start = monotonic_ns();
+	int err, slot, i;
+	__u32 result;
+
+	if (open_dev_direct(&dev, rdev->path, O_RDONLY)) {
+		rdev->err = -errno;
+		return;
+	}
+
+	struct nvme_fw_commit_args args = {
+		.args_size	= sizeof(args),
+		.slot		= job->slot,
+		.action		= job->action,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_cli_fw_commit(dev, &args);
+	rdev->commit_ns = monotonic_ns() - start;
+	if (fw_commit_needs_reset(err)) {
+		rdev->reset = true;
+		err = 0;
+	}
+	if (err) {
+		rdev->err = err == -1 ? -errno : err;
+		return;
+	}
+
+	rdev->stage = NVME_FW_ROLLOUT_VERIFY;
+	log = nvme_alloc(sizeof(*log));
+	if (!log) {
+		rdev->err = -ENOMEM;
+		return;
+	}
+
+	err = nvme_cli_get_log_fw_slot(dev, false, log);
+	if (err) {
+		rdev->err = err == -1 ? -errno : err;
+		return;
+	}
+
+	/* the slot the image went to, the controller picks one for slot 0 */
+	if (job->action == NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE_IMMEDIATE)
+		slot = log->afi & 0x7;
+	else if (job->action == NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE)
+		slot = (log->afi >> 4) & 0x7;
+	else
+		slot = job->slot;
+
+	fw_slot_rev(log, slot, rdev->new_rev);
+	for (i = 1; job->revision && !slot && i <= 7; i++) {
+		fw_slot_rev(log, i, rdev->new_rev);
+		if (!strcmp(rdev->new_rev, job->revision))
+			break;
+	}
+
+	if (job->revision && strcmp(rdev->new_rev, job->revision)) {
+		rdev->mismatch = true;
+		return;
+	}
+
+	rdev->stage = NVME_FW_ROLLOUT_DONE;
+}
+
+static int fw_rollout(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Download a firmware image to several controllers in\n"
+		"parallel, then commit it in waves and verify the firmware slot log.\n"
+		"Devices are given as arguments, by default or with 'all' every\n"
+		"controller found in the topology is used. A wave is only started\n"
+		"when every device of the previous wave was committed successfully.";
+	const char *fw = "firmware file (required)";
+	const char *xfer = "transfer chunksize limit, default derived from MDTS and FWUG";
+	const char *slot = "[0-7]: firmware slot for commit action";
+	const char *action = "[0,1,3]: commit action (default: 1, activate at next reset)";
+	const char *revision = "firmware revision of the image, skip devices running it and verify the slot";
+	const char *jobs = "number of devices downloading in parallel";
+	const char *wave = "number of devices committed per wave";
+
+	_cleanup_free_ struct nvme_fw_rollout_dev *devs = NULL;
+	_cleanup_free_ struct fw_rollout_job *job = NULL;
+	struct nvme_thread_pool *pool = NULL;
+	enum nvme_print_flags flags;
+	char **paths = NULL;
+	int nr_devs = 0, nr_waves = 0, i, n, err;
+	struct stat sb;
+
+	struct config {
+		char	*fw;
+		__u32	xfer;
+		__u8	slot;
+		__u8	action;
+		char	*revision;
+		__u32	jobs;
+		__u32	wave;
+	};
+
+	struct config cfg = {
+		.fw		= NULL,
+		.xfer		= 0,
+		.slot		= 0,
+		.action		= NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE,
+		.revision	= NULL,
+		.jobs		= 8,
+		.wave		= 8,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FILE("fw",       'f', &cfg.fw,       fw),
+		  OPT_UINT("xfer",     'x', &cfg.xfer,     xfer),
+		  OPT_BYTE("slot",     's', &cfg.slot,     slot),
+		  OPT_BYTE("action",   'a', &cfg.action,   action),
+		  OPT_STR("revision",  'R', &cfg.revision, revision),
+		  OPT_UINT("jobs",     'j', &cfg.jobs,     jobs),
+		  OPT_UINT("wave",     'w', &cfg.wave,     wave));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (!cfg.fw) {
+		nvme_show_error("Please provide a firmware file with --fw");
+		return -EINVAL;
+	}
+	if (cfg.slot > 7) {
+		nvme_show_error("invalid slot:%d", cfg.slot);
+		return -EINVAL;
+	}
+	if (cfg.action != NVME_FW_COMMIT_CA_REPLACE &&
+	    cfg.action != NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE &&
+	    cfg.action != NVME_FW_COMMIT_CA_REPLACE_AND_ACTIVATE_IMMEDIATE) {
+		nvme_show_error("invalid action:%d, the image must be committed with 0, 1 or 3",
+				cfg.action);
+		return -EINVAL;
+	}
+	if (cfg.xfer % 4096) {
+		nvme_show_error("xfer must be a multiple of 4096");
+		return -EINVAL;
+	}
+	if (!cfg.jobs || !cfg.wave) {
+		nvme_show_error("jobs and wave must be at least 1");
+		return -EINVAL;
+	}
+
+	if (stat(cfg.fw, &sb) < 0) {
+		err = -errno;
+		nvme_show_error("Failed to open firmware file %s: %s", cfg.fw,
+				strerror(-err));
+		return err;
+	}
+	if ((sb.st_size & 0x3) || !sb.st_size || sb.st_size > UINT32_MAX) {
+		nvme_show_error("Invalid size:%lld for f/w image", (long long)sb.st_size);
+		return -EINVAL;
+	}
+
+	err = ctrl_paths_get(argc, argv, &paths, &nr_devs);
+	if (err)
+		goto free;
+
+	if (!nr_devs) {
+		nvme_show_error("no devices found");
+		err = -ENODEV;
+		goto free;
+	}
+
+	devs = calloc(nr_devs, sizeof(*devs));
+	job = calloc(nr_devs, sizeof(*job));
+	if (!devs || !job) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	pool = nvme_thread_pool_create(min(max(cfg.jobs, cfg.wave), (__u32)nr_devs));
+	if (!pool) {
+		err = -errno;
+		nvme_show_error("thread pool: %s", nvme_strerror(errno));
+		goto free;
+	}
+
+	for (i = 0; i < nr_devs; i++) {
+		devs[i].path = paths[i];
+		devs[i].name = basename(devs[i].path);
+		job[i] = (struct fw_rollout_job) {
+			.dev		= &devs[i],
+			.fw		= cfg.fw,
+			.fw_size	= sb.st_size,
+			.xfer		= cfg.xfer,
+			.slot		= cfg.slot,
+			.action		= cfg.action,
+			.revision	= cfg.revision,
+		};
+	}
+
+	/*
+	 * The pool has enough threads for a full wave, so limit the number of
+	 * concurrent downloads to --jobs by queueing them in batches.
+	 */
+	for (i = 0; i < nr_devs; i += cfg.jobs) {
+		for (n = i; n < nr_devs && n < i + cfg.jobs; n++) {
+			err = nvme_thread_pool_queue(pool, fw_rollout_download, &job[n]);
+			if (err) {
+				devs[n].err = err;
+				err = 0;
+			}
+		}
+		nvme_thread_pool_wait(pool);
+	}
+
+	for (i = 0; i < nr_devs; ) {
+		for (n = 0; i < nr_devs && n < cfg.wave; i++) {
+			if (devs[i].stage != NVME_FW_ROLLOUT_COMMIT || devs[i].err)
+				continue;
+			devs[i].wave = nr_waves + 1;
+			err = nvme_thread_pool_queue(pool, fw_rollout_commit, &job[i]);
+			if (err) {
+				devs[i].err = err;
+				err = 0;
+			}
+			n++;
+		}
+		if (!n)
+			break;
+		nr_waves++;
+		nvme_thread_pool_wait(pool);
+
+		for (n = 0; n < i; n++)
+			if (devs[n].wave == nr_waves && devs[n].stage != NVME_FW_ROLLOUT_DONE)
+				break;
+		if (n < i) {
+			nvme_show_error("wave %d failed, not committing the remaining devices",
+					nr_waves);
+			break;
+		}
+	}
+	nvme_thread_pool_destroy(pool);
+
+	nvme_show_fw_rollout(devs, nr_devs, flags);
+
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err)
+			err = devs[i].err;
+		else if (devs[i].mismatch || devs[i].stage != NVME_FW_ROLLOUT_DONE)
+			err = -ECANCELED;
+	}
+
+free:
+	ctrl_paths_free(paths, nr_devs);
+
+	return err;
+}
+
+static int subsystem_reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Resets the NVMe subsystem";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	nvme_cli_id_cache_invalidate(dev);
+	err = nvme_subsystem_reset(dev_fd(dev));
+	if (err < 0) {
+		if (errno == ENOTTY)
+			nvme_show_error("Subsystem-reset: NVM Subsystem Reset not supported.");
+		else
+			nvme_show_error("Subsystem-reset: %s", nvme_strerror(errno));
+	}
+
+	return err;
+}
+
+static int reset(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Resets the NVMe controller\n";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	nvme_cli_id_cache_invalidate(dev);
+	err = nvme_ctrl_reset(dev_fd(dev));
+	if (err < 0)
+		nvme_show_error("Reset: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+static int ns_rescan(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Rescans the NVMe namespaces\n";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	NVME_ARGS(opts);
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	nvme_cli_id_cache_invalidate(dev);
+	err = nvme_ns_rescan(dev_fd(dev));
+	if (err < 0)
+		nvme_show_error("Namespace Rescan: %s\n", nvme_strerror(errno));
+
+	return err;
+}
+
+static int sanitize_check(__u8 sanact, bool ause, bool no_dealloc, __u8 owpass,
+			  bool oipbp, __u32 ovrpat)
+{
+	switch (sanact) {
+	case NVME_SANITIZE_SANACT_EXIT_FAILURE:
+	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
+	case NVME_SANITIZE_SANACT_START_OVERWRITE:
+	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
+		break;
+	default:
+		nvme_show_error("Invalid Sanitize Action");
+		return -EINVAL;
+	}
+
+	if (sanact == NVME_SANITIZE_SANACT_EXIT_FAILURE) {
+		if (ause || no_dealloc) {
+			nvme_show_error("SANACT is Exit Failure Mode");
+			return -EINVAL;
+		}
+	}
+
+	if (sanact == NVME_SANITIZE_SANACT_START_OVERWRITE) {
+		if (owpass > 15) {
+			nvme_show_error("OWPASS out of range [0-15]");
+			return -EINVAL;
+		}
+	} else {
+		if (owpass || oipbp || ovrpat) {
+			nvme_show_error("SANACT is not Overwrite");
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int sanitize_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Send a sanitize command.";
+	const char *no_dealloc_desc = "No deallocate after sanitize.";
+	const char *oipbp_desc = "Overwrite invert pattern between passes.";
+	const char *owpass_desc = "Overwrite pass count.";
+	const char *ause_desc = "Allow unrestricted sanitize exit.";
+	const char *sanact_desc = "Sanitize action: 1 = Exit failure mode, 2 = Start block erase, 3 = Start overwrite, 4 = Start crypto erase";
+	const char *ovrpat_desc = "Overwrite pattern.";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		bool	no_dealloc;
+		bool	oipbp;
+		__u8	owpass;
+		bool	ause;
+		__u8	sanact;
+		__u32	ovrpat;
+	};
+
+	struct config cfg = {
+		.no_dealloc	= false,
+		.oipbp		= false,
+		.owpass		= 0,
+		.ause		= false,
+		.sanact		= 0,
+		.ovrpat		= 0,
+	};
+
+	OPT_VALS(sanact) = {
+		VAL_BYTE("exit-failure", NVME_SANITIZE_SANACT_EXIT_FAILURE),
+		VAL_BYTE("start-block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
+		VAL_BYTE("start-overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
+		VAL_BYTE("start-crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
+		VAL_END()
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("no-dealloc", 'd', &cfg.no_dealloc, no_dealloc_desc),
+		  OPT_FLAG("oipbp",      'i', &cfg.oipbp,      oipbp_desc),
+		  OPT_BYTE("owpass",     'n', &cfg.owpass,     owpass_desc),
+		  OPT_FLAG("ause",       'u', &cfg.ause,       ause_desc),
+		  OPT_BYTE("sanact",     'a', &cfg.sanact,     sanact_desc, sanact),
+		  OPT_UINT("ovrpat",     'p', &cfg.ovrpat,     ovrpat_desc));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = sanitize_check(cfg.sanact, cfg.ause, cfg.no_dealloc, cfg.owpass,
+			     cfg.oipbp, cfg.ovrpat);
+	if (err)
+		return err;
+
+	struct nvme_sanitize_nvm_args args = {
+		.args_size	= sizeof(args),
+		.sanact		= cfg.sanact,
+		.ause		= cfg.ause,
+		.owpass		= cfg.owpass,
+		.oipbp		= cfg.oipbp,
+		.nodas		= cfg.no_dealloc,
+		.ovrpat		= cfg.ovrpat,
+		.result		= NULL,
+	};
+	err = nvme_cli_sanitize_nvm(dev, &args);
+	if (err < 0)
+		nvme_show_error("sanitize: %s", nvme_strerror(errno));
+	else if (err > 0)
+		nvme_show_status(err);
+
+	return err;
+}
+
+/* SPROG and SSTAT, the first 4 bytes of the Sanitize Status log */
+static int sanitize_progress(struct nvme_dev *dev, __u16 *sprog, __u16 *sstat)
+{
+	__le16 buf[2];
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.lid		= NVME_LOG_LID_SANITIZE,
+		.nsid		= NVME_NSID_ALL,
+		.lsp		= NVME_LOG_LSP_NONE,
+		.lpo		= 0,
+		.csi		= NVME_CSI_NVM,
+		.uuidx		= NVME_UUID_NONE,
+		.rae		= false,
+		.ot		= false,
+		.len		= sizeof(buf),
+		.log		= buf,
+		.result		= NULL,
+	};
+	int err;
+
+	err = nvme_cli_get_log_page(dev, sizeof(buf), &args);
+	if (err)
+		return err;
+
+	*sprog = le16_to_cpu(buf[0]);
+	*sstat = le16_to_cpu(buf[1]);
+	return 0;
+}
+
+/* the estimated time of the action in seconds, 0 if it isn't reported */
+static __u32 sanitize_estimate(struct nvme_sanitize_log_page *log, __u8 sanact,
+			       bool no_dealloc)
+{
+	__u32 t;
+
+	switch (sanact) {
+	case NVME_SANITIZE_SANACT_START_OVERWRITE:
+		t = le32_to_cpu(no_dealloc ? log->etond : log->eto);
+		break;
+	case NVME_SANITIZE_SANACT_START_BLOCK_ERASE:
+		t = le32_to_cpu(no_dealloc ? log->etbend : log->etbe);
+		break;
+	case NVME_SANITIZE_SANACT_START_CRYPTO_ERASE:
+		t = le32_to_cpu(no_dealloc ? log->etcend : log->etce);
+		break;
+	default:
+		t = 0;
+		break;
+	}
+
+	return t == 0xffffffff ? 0 : t;
+}
+
+static bool sanitize_run_passed(__u16 sstat)
+{
+	switch (sstat & NVME_SANITIZE_SSTAT_STATUS_MASK) {
+	case NVME_SANITIZE_SSTAT_STATUS_COMPLETE_SUCCESS:
+	case NVME_SANITIZE_SSTAT_STATUS_ND_COMPLETE_SUCCESS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+struct sanitize_job {
+	struct nvme_dev *dev;
+	__u32 interval;		/* seconds until the next poll */
+	__u64 next;		/* monotonic time of the next poll */
+};
+
+/*
+ * The remaining time is extrapolated from the progress made so far, or
+ * taken from the estimate of the controller until there is progress. The
+ * device is polled about four times over the remaining time, without
+ * either the interval doubles with every poll.
+ */
+static void sanitize_schedule(struct nvme_sanitize_dev *d, struct sanitize_job *job,
+			      __u32 max_interval, __u64 now)
+{
+	double elapsed = d->elapsed_ns / 1e9;
+	__u32 interval;
+
+	d->eta = 0;
+	if (d->sprog)
+		d->eta = elapsed * (0x10000 - d->sprog) / d->sprog;
+	else if (d->estimate > elapsed)
+		d->eta = d->estimate - elapsed;
+
+	interval = d->eta ? d->eta / 4 : job->interval * 2;
+	job->interval = min(max(interval, 1U), max_interval);
+	job->next = now + job->interval * NSEC_PER_SEC;
+}
+
+/* redrawn in place on a terminal, appended otherwise */
+static void sanitize_run_table(struct nvme_sanitize_dev *devs, int nr_devs,
+			       bool redraw)
+{
+	struct nvme_sanitize_dev *d;
+	int i, running = 0;
+	__u32 eta = 0;
+
+	if (redraw)
+		fprintf(stderr, "\033[%dA", nr_devs + 1);
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->running) {
+			running++;
+			eta = max(eta, d->eta);
+		}
+		fprintf(stderr, "%-16s %-8s %6.2f%% eta %6us %4u polls\033[K\n", d->name,
+			d->err ? "error" : d->running ? "running" : d->done ?
+			nvme_sanitize_result_to_string(d->sstat) : "-",
+			d->sprog * 100.0 / 0x10000, d->running ? d->eta : 0, d->polls);
+	}
+	fprintf(stderr, "%d of %d running, eta %us\033[K\n", running, nr_devs, eta);
+}
+
+static int sanitize_run(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Start a sanitize operation on several controllers at once and\n"
+		"monitor the progress until every operation finished. Devices are\n"
+		"given as arguments, 'all' selects every controller found in the\n"
+		"topology.";
+	const char *no_dealloc_desc = "No deallocate after sanitize.";
+	const char *oipbp_desc = "Overwrite invert pattern between passes.";
+	const char *owpass_desc = "Overwrite pass count.";
+	const char *ause_desc = "Allow unrestricted sanitize exit.";
+	const char *sanact_desc = "Sanitize action: 2 = Start block erase, 3 = Start overwrite, 4 = Start crypto erase";
+	const char *ovrpat_desc = "Overwrite pattern.";
+	const char *max_interval = "longest interval between two polls of a device in seconds";
+
+	_cleanup_free_ struct nvme_sanitize_log_page *log = NULL;
+	_cleanup_free_ struct nvme_sanitize_dev *devs = NULL;
+	_cleanup_free_ struct sanitize_job *job = NULL;
+	enum nvme_print_flags flags;
+	bool redraw, drawn = false, polled;
+	int nr_devs = 0, running = 0, i, err;
+	__u64 start, now, next;
+	char **paths = NULL;
+	__u16 sprog, sstat;
+
+	struct config {
+		bool	no_dealloc;
+		bool	oipbp;
+		__u8	owpass;
+		bool	ause;
+		__u8	sanact;
+		__u32	ovrpat;
+		__u32	max_interval;
+	};
+
+	struct config cfg = {
+		.no_dealloc	= false,
+		.oipbp		= false,
+		.owpass		= 0,
+		.ause		= false,
+		.sanact		= 0,
+		.ovrpat		= 0,
+		.max_interval	= 60,
+	};
+
+	OPT_VALS(sanact) = {
+		VAL_BYTE("start-block-erase", NVME_SANITIZE_SANACT_START_BLOCK_ERASE),
+		VAL_BYTE("start-overwrite", NVME_SANITIZE_SANACT_START_OVERWRITE),
+		VAL_BYTE("start-crypto-erase", NVME_SANITIZE_SANACT_START_CRYPTO_ERASE),
+		VAL_END()
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("no-dealloc",   'd', &cfg.no_dealloc,   no_dealloc_desc),
+		  OPT_FLAG("oipbp",        'i', &cfg.oipbp,        oipbp_desc),
+		  OPT_BYTE("owpass",       'n', &cfg.owpass,       owpass_desc),
+		  OPT_FLAG("ause",         'u', &cfg.ause,         ause_desc),
+		  OPT_BYTE("sanact",       'a', &cfg.sanact,       sanact_desc, sanact),
+		  OPT_UINT("ovrpat",       'p', &cfg.ovrpat,       ovrpat_desc),
+		  OPT_UINT("max-interval", 'm', &cfg.max_interval, max_interval));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (cfg.sanact == NVME_SANITIZE_SANACT_EXIT_FAILURE) {
+		nvme_show_error("Exit Failure Mode has no operation to monitor");
+		return -EINVAL;
+	}
+	err = sanitize_check(cfg.sanact, cfg.ause, cfg.no_dealloc, cfg.owpass,
+			     cfg.oipbp, cfg.ovrpat);
+	if (err)
+		return err;
+
+	if (!cfg.max_interval) {
+		nvme_show_error("max-interval must be at least 1");
+		return -EINVAL;
+	}
+
+	/* never erase every drive in the box by accident */
+	if (optind >= argc) {
+		nvme_show_error("devices are required, use 'all' for every controller");
+		return -EINVAL;
+	}
+
+	err = ctrl_paths_get(argc, argv, &paths, &nr_devs);
+	if (err)
+		goto free;
+
+	if (!nr_devs) {
+		nvme_show_error("no devices found");
+		err = -ENODEV;
+		goto free;
+	}
+
+	devs = calloc(nr_devs, sizeof(*devs));
+	job = calloc(nr_devs, sizeof(*job));
+	log = nvme_alloc(sizeof(*log));
+	if (!devs || !job || !log) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	start = monotonic_ns();
+	for (i = 0; i < nr_devs; i++) {
+		struct nvme_sanitize_nvm_args args = {
+			.args_size	= sizeof(args),
+			.sanact		= cfg.sanact,
+			.ause		= cfg.ause,
+			.owpass		= cfg.owpass,
+			.oipbp		= cfg.oipbp,
+			.nodas		= cfg.no_dealloc,
+			.ovrpat		= cfg.ovrpat,
+			.result		= NULL,
+		};
+
+		devs[i].path = paths[i];
+		devs[i].name = basename(devs[i].path);
+		if (open_dev_direct(&job[i].dev, devs[i].path, O_RDONLY)) {
+			devs[i].err = -errno;
+			continue;
+		}
+
+		/* the estimates don't change, they are read once */
+		err = nvme_cli_get_log_sanitize(job[i].dev, false, log);
+		if (!err && (le16_to_cpu(log->sstat) & NVME_SANITIZE_SSTAT_STATUS_MASK) ==
+		    NVME_SANITIZE_SSTAT_STATUS_IN_PROGESS)
+			err = -EBUSY;
+		if (!err)
+			err = nvme_cli_sanitize_nvm(job[i].dev, &args);
+		if (err) {
+			devs[i].err = err == -1 ? -errno : err;
+			continue;
+		}
+
+		devs[i].estimate = sanitize_estimate(log, cfg.sanact, cfg.no_dealloc);
+		devs[i].running = true;
+		job[i].interval = 1;
+		sanitize_schedule(&devs[i], &job[i], cfg.max_interval, monotonic_ns());
+		running++;
+	}
+
+	redraw = isatty(STDERR_FILENO);
+	while (running && !nvme_stopped()) {
+		next = UINT64_MAX;
+		for (i = 0; i < nr_devs; i++)
+			if (devs[i].running)
+				next = min(next, job[i].next);
+		if (!nvme_interval_wait(next))
+			break;
+
+		polled = false;
+		for (i = 0; i < nr_devs; i++) {
+			struct nvme_sanitize_dev *d = &devs[i];
+
+			now = monotonic_ns();
+			if (!d->running || job[i].next > now)
+				continue;
+
+			err = sanitize_progress(job[i].dev, &sprog, &sstat);
+			d->elapsed_ns = now - start;
+			d->polls++;
+			polled = true;
+			if (err) {
+				d->err = err == -1 ? -errno : err;
+			} else if ((sstat & NVME_SANITIZE_SSTAT_STATUS_MASK) ==
+				   NVME_SANITIZE_SSTAT_STATUS_IN_PROGESS) {
+				d->sprog = sprog;
+				sanitize_schedule(d, &job[i], cfg.max_interval, now);
+				continue;
+			} else {
+				d->done = true;
+				d->sstat = sstat;
+				d->passed = sanitize_run_passed(sstat);
+				if (d->passed)
+					d->sprog = 0xffff;
+			}
+			d->running = false;
+			running--;
+		}
+
+		if (polled) {
+			sanitize_run_table(devs, nr_devs, redraw && drawn);
+			drawn = true;
+		}
+	}
+
+	nvme_stop_release();
+
+	nvme_show_sanitize_run(devs, nr_devs, flags);
+
+	err = 0;
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err)
+			err = devs[i].err;
+		else if (!devs[i].passed)
+			err = -EIO;
+	}
+
+free:
+	for (i = 0; job && i < nr_devs; i++)
+		if (job[i].dev)
+			dev_close(job[i].dev);
+	ctrl_paths_free(paths, nr_devs);
+
+	return err;
+}
+
+static int nvme_get_single_property(int fd, struct get_reg_config *cfg, __u64 *value)
+{
+	int err;
+	struct nvme_get_property_args args = {
+		.args_size	= sizeof(args),
+		.fd		= fd,
+		.offset		= cfg->offset,
+		.value		= value,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	};
+
+	err = nvme_get_property(&args);
+	if (!err)
+		return 0;
+
+	if (!cfg->fabrics &&
+	    nvme_status_equals(err, NVME_STATUS_TYPE_NVME, NVME_SC_INVALID_FIELD)) {
+		*value = -1;
+		return 0;
+	}
+
+	if (cfg->fabrics && err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("get-property: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+/*
+ * The registers read with Property Get when the BAR isn't mapped: the
+ * fabrics ones and the others show-regs reports, which controllers that
+ * don't have them fail with Invalid Field.
+ */
+static const int fabrics_regs[] = {
+	NVME_REG_CAP, NVME_REG_VS, NVME_REG_INTMS, NVME_REG_INTMC, NVME_REG_CC,
+	NVME_REG_CSTS, NVME_REG_NSSR, NVME_REG_AQA, NVME_REG_ASQ, NVME_REG_ACQ,
+	NVME_REG_CMBLOC, NVME_REG_CMBSZ, NVME_REG_CRTO,
+};
+
+/* out of the 32 entries of a fabrics admin queue */
+#define PROPERTY_GET_DEPTH	8
+
+struct property_get {
+	struct nvme_fanout_cmd fc;
+	void *bar;
+	int offset;
+	int err;
+};
+
+static void property_get_done(struct nvme_fanout_cmd *fc, int status)
+{
+	struct property_get *p = fc->priv;
+	__u64 value = fc->cmd.result;
+
+	if (nvme_status_equals(status, NVME_STATUS_TYPE_NVME, NVME_SC_INVALID_FIELD)) {
+		value = -1;
+	} else if (status) {
+		p->err = status;
+		return;
+	}
+
+	if (nvme_is_64bit_reg(p->offset))
+		*(uint64_t *)(p->bar + p->offset) = value;
+	else
+		*(uint32_t *)(p->bar + p->offset) = value;
+}
+
+/*
+ * Every Property Get is a round trip to the target, they are all sent at
+ * once instead of one after the other.
+ */
+static int read_fabrics_regs(struct nvme_dev *dev, void *bar)
+{
+	struct property_get p[ARRAY_SIZE(fabrics_regs)];
+	struct nvme_fanout f;
+	size_t i;
+	int err;
+
+	nvme_fanout_init(&f, PROPERTY_GET_DEPTH, PROPERTY_GET_DEPTH);
+	for (i = 0; i < ARRAY_SIZE(p); i++) {
+		p[i] = (struct property_get) {
+			.bar	= bar,
+			.offset	= fabrics_regs[i],
+		};
+		nvme_fanout_property_get_cmd(&p[i].fc.cmd, p[i].offset);
+		p[i].err = nvme_fanout_queue(&f, &p[i].fc, dev_fd(dev),
+					     property_get_done, &p[i]);
+	}
+	err = nvme_fanout_run(&f);
+	nvme_fanout_exit(&f);
+
+	for (i = 0; !err && i < ARRAY_SIZE(p); i++)
+		err = p[i].err;
+
+	if (err > 0)
+		nvme_show_status(err);
+	else if (err < 0)
+		nvme_show_error("get-property: %s", nvme_strerror(-err));
+
+	return err;
+}
+
+/*
+ * Opt-in cache of the registers read with Property Get, for monitoring
+ * that polls them more often than it needs fresh values. The snapshot of a
+ * controller is tagged with its subsystem NQN, controller ID and address
+ * and reused while it is younger than the refresh interval asked for.
+ */
+#define REG_CACHE_DIR		RUNDIR "/nvme-cli/reg-cache"
+#define REG_CACHE_KEY_LEN	512
+
+struct reg_snapshot {
+	__u64	time_ms;		/* CLOCK_REALTIME when it was read */
+	__u8	regs[NVME_REG_CRTO + sizeof(uint32_t)];
+};
+
+static bool reg_cache_init(struct nvme_dev *dev, char *path, size_t size, char *key)
+{
+	const char *base = getenv("NVME_REG_CACHE");
+	char sysfs[PATH_MAX], dir[PATH_MAX], nqn[256], cntlid[16], addr[256];
+
+	if (!base || !*base)
+		base = REG_CACHE_DIR;
+
+	snprintf(sysfs, sizeof(sysfs), "/sys/class/nvme/%s", dev->name);
+	if (sysfs_read_attr(sysfs, "subsysnqn", nqn, sizeof(nqn)) ||
+	    sysfs_read_attr(sysfs, "cntlid", cntlid, sizeof(cntlid)) ||
+	    sysfs_read_attr(sysfs, "address", addr, sizeof(addr)))
+		return false;
+
+	snprintf(dir, sizeof(dir), "%s", base);
+	if (cache_dir_init(dir))
+		return false;
+
+	memset(key, 0, REG_CACHE_KEY_LEN);
+	snprintf(key, REG_CACHE_KEY_LEN, "%s\n%s\n%s\n", nqn, cntlid, addr);
+
+	return snprintf(path, size, "%s/%s", dir, dev->name) < (int)size;
+}
+
+/*
+ * The registers of a controller without a mapped BAR in a page sized
+ * buffer, from a snapshot of at most @refresh_ms if not 0.
+ */
+static int get_fabrics_registers(struct nvme_dev *dev, __u32 refresh_ms, void **pbar)
+{
+	char path[PATH_MAX], key[REG_CACHE_KEY_LEN];
+	struct reg_snapshot snap;
+	struct timespec ts;
+	bool cache = false;
+	int err, size = getpagesize();
+	void *bar;
+	__u64 now;
+
+	bar = malloc(size);
+	if (!bar) {
+		nvme_show_error("malloc: %s", strerror(errno));
+		return -ENOMEM;
+	}
+	memset(bar, 0xff, size);
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+
+	if (refresh_ms) {
+		cache = reg_cache_init(dev, path, sizeof(path), key);
+		if (cache && cache_read(path, key, sizeof(key), &snap, sizeof(snap)) &&
+		    snap.time_ms <= now && now - snap.time_ms <= refresh_ms) {
+			memcpy(bar, snap.regs, sizeof(snap.regs));
+			*pbar = bar;
+			return 0;
+		}
+	}
+
+	err = read_fabrics_regs(dev, bar);
+	if (err) {
+		free(bar);
+		return err;
+	}
+
+	if (cache) {
+		snap.time_ms = now;
+		memcpy(snap.regs, bar, sizeof(snap.regs));
+		cache_write(path, key, sizeof(key), &snap, sizeof(snap));
+	}
+
+	*pbar = bar;
+
+	return 0;
+}
+
+static void *mmap_registers(struct nvme_dev *dev, bool writable)
+{
+	char path[512];
+	void *membase;
+	int fd;
+	int prot = PROT_READ;
+
+	if (writable)
+		prot |= PROT_WRITE;
+
+	sprintf(path, "/sys/class/nvme/%s/device/resource0", dev->name);
+	fd = open(path, writable ? O_RDWR : O_RDONLY);
+	if (fd < 0) {
+		if (log_level >= LOG_DEBUG)
+			nvme_show_error("%s did not find a pci resource, open failed %s",
+					dev->name, strerror(errno));
+		return NULL;
+	}
+
+	membase = mmap(NULL, getpagesize(), prot, MAP_SHARED, fd, 0);
+	if (membase == MAP_FAILED) {
+		if (log_level >= LOG_DEBUG) {
+			fprintf(stderr, "%s failed to map. ", dev->name);
+			fprintf(stderr, "Did your kernel enable CONFIG_IO_STRICT_DEVMEM?\n");
+		}
+		membase = NULL;
+	}
+
+	close(fd);
+	return membase;
+}
+
+static int show_registers(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Reads and shows the defined NVMe controller registers\n"
+		"in binary or human-readable format";
+	const char *human_readable =
+	    "show info in readable format in case of output_format == normal";
+	const char *refresh = "reuse the cached properties of a controller read at most N ms ago";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	bool fabrics = false;
+	__u32 refresh_ms = 0;
+	void *bar;
+	int err;
+
+	struct get_reg_config cfg = {
+		.human_readable	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable),
+		  OPT_UINT("refresh",        'r', &refresh_ms,         refresh));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	bar = mmap_registers(dev, false);
+	if (!bar) {
+		err = get_fabrics_registers(dev, refresh_ms, &bar);
+		if (err)
+			return err;
+		fabrics = true;
+	}
+
+	nvme_show_ctrl_registers(bar, fabrics, flags);
+	if (fabrics)
+		free(bar);
+	else
+		munmap(bar, getpagesize());
+
+	return 0;
+}
+
+int get_reg_size(int offset)
+{
+	return nvme_is_64bit_reg(offset) ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+static bool is_reg_selected(struct get_reg_config *cfg, int offset)
+{
+	switch (offset) {
+	case NVME_REG_CAP:
+		return cfg->cap;
+	case NVME_REG_VS:
+		return cfg->vs;
+	case NVME_REG_INTMS:
+		return cfg->intms;
+	case NVME_REG_INTMC:
+		return cfg->intmc;
+	case NVME_REG_CC:
+		return cfg->cc;
+	case NVME_REG_CSTS:
+		return cfg->csts;
+	case NVME_REG_NSSR:
+		return cfg->nssr;
+	case NVME_REG_AQA:
+		return cfg->aqa;
+	case NVME_REG_ASQ:
+		return cfg->asq;
+	case NVME_REG_ACQ:
+		return cfg->acq;
+	case NVME_REG_CMBLOC:
+		return cfg->cmbloc;
+	case NVME_REG_CMBSZ:
+		return cfg->cmbsz;
+	case NVME_REG_BPINFO:
+		return cfg->bpinfo;
+	case NVME_REG_BPRSEL:
+		return cfg->bprsel;
+	case NVME_REG_BPMBL:
+		return cfg->bpmbl;
+	case NVME_REG_CMBMSC:
+		return cfg->cmbmsc;
+	case NVME_REG_CMBSTS:
+		return cfg->cmbsts;
+	case NVME_REG_CMBEBS:
+		return cfg->cmbebs;
+	case NVME_REG_CMBSWTP:
+		return cfg->cmbswtp;
+	case NVME_REG_NSSD:
+		return cfg->nssd;
+	case NVME_REG_CRTO:
+		return cfg->crto;
+	case NVME_REG_PMRCAP:
+		return cfg->pmrcap;
+	case NVME_REG_PMRCTL:
+		return cfg->pmrctl;
+	case NVME_REG_PMRSTS:
+		return cfg->pmrsts;
+	case NVME_REG_PMREBS:
+		return cfg->pmrebs;
+	case NVME_REG_PMRSWTP:
+		return cfg->pmrswtp;
+	case NVME_REG_PMRMSCL:
+		return cfg->pmrmscl;
+	case NVME_REG_PMRMSCU:
+		return cfg->pmrmscu;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+bool nvme_is_ctrl_reg(int offset)
+{
+	switch (offset) {
+	case NVME_REG_CAP:
+	case NVME_REG_VS:
+	case NVME_REG_INTMS:
+	case NVME_REG_INTMC:
+	case NVME_REG_CC:
+	case NVME_REG_CSTS:
+	case NVME_REG_NSSR:
+	case NVME_REG_AQA:
+	case NVME_REG_ASQ:
+	case NVME_REG_ACQ:
+	case NVME_REG_CMBLOC:
+	case NVME_REG_CMBSZ:
+	case NVME_REG_BPINFO:
+	case NVME_REG_BPRSEL:
+	case NVME_REG_BPMBL:
+	case NVME_REG_CMBMSC:
+	case NVME_REG_CMBSTS:
+	case NVME_REG_CMBEBS:
+	case NVME_REG_CMBSWTP:
+	case NVME_REG_NSSD:
+	case NVME_REG_CRTO:
+	case NVME_REG_PMRCAP:
+	case NVME_REG_PMRCTL:
+	case NVME_REG_PMRSTS:
+	case NVME_REG_PMREBS:
+	case NVME_REG_PMRSWTP:
+	case NVME_REG_PMRMSCL:
+	case NVME_REG_PMRMSCU:
+		return true;
+	default:
+		break;
+	}
+
+	return false;
+}
+
+static bool get_register_offset(void *bar, bool fabrics, struct get_reg_config *cfg,
+				enum nvme_print_flags flags)
+{
+	bool offset_matched = cfg->offset >= 0;
+	int offset;
+
+	if (offset_matched)
+		nvme_show_ctrl_register(bar, fabrics, cfg->offset, flags);
+
+	for (offset = NVME_REG_CAP; offset <= NVME_REG_PMRMSCU; offset += get_reg_size(offset)) {
+		if (!nvme_is_ctrl_reg(offset) || offset == cfg->offset || !is_reg_selected(cfg, offset))
+			continue;
+		nvme_show_ctrl_register(bar, fabrics, offset, flags);
+		if (!offset_matched)
+			offset_matched = true;
+	}
+
+	return offset_matched;
+}
+
+/* The get-reg --sample-interval trace file, all fields little endian */
+#define NVME_REG_TRACE_MAGIC	"NVMEREGT"
+
+struct nvme_reg_trace_hdr {
+	char	magic[8];
+	__le32	version;	/* 1 */
+	__le32	nr_regs;
+	__le64	start_ns;	/* CLOCK_REALTIME of the first sample */
+	__le64	interval_ns;
+	__le32	offsets[NVME_REG_SAMPLE_MAX_REGS];
+};
+
+/* A register changing its value, the first sample records every register */
+struct nvme_reg_trace_rec {
+	__le64	ns;		/* since the first sample */
+	__le32	reg;		/* index into the offsets of the header */
+	__le32	value;
+};
+
+/*
+ * The registers selected like for a single read, only 32 bit ones. Without
+ * a selection CSTS, and CMBSTS and PMRSTS if the controller has a CMB or
+ * PMR, are sampled.
+ */
+static int reg_sample_select(void *bar, struct get_reg_config *cfg,
+			     struct nvme_reg_sample *s)
+{
+	__u64 cap = mmio_read64(bar + NVME_REG_CAP);
+	int offset;
+
+	for (offset = NVME_REG_CAP; offset <= NVME_REG_PMRMSCU; offset += get_reg_size(offset)) {
+		if (!nvme_is_ctrl_reg(offset) ||
+		    (offset != cfg->offset && !is_reg_selected(cfg, offset)))
+			continue;
+		if (nvme_is_64bit_reg(offset)) {
+			nvme_show_error("%s is a 64 bit register, only 32 bit registers can be sampled",
+					nvme_register_symbol_to_string(offset));
+			return -EINVAL;
+		}
+		if (s->nr_regs == NVME_REG_SAMPLE_MAX_REGS) {
+			nvme_show_error("at most %d registers can be sampled",
+					NVME_REG_SAMPLE_MAX_REGS);
+			return -EINVAL;
+		}
+		s->regs[s->nr_regs++].offset = offset;
+	}
+
+	if (cfg->offset >= 0 && !nvme_is_ctrl_reg(cfg->offset)) {
+		nvme_show_error("invalid register offset %#x", cfg->offset);
+		return -EINVAL;
+	}
+	if (s->nr_regs)
+		return 0;
+
+	s->regs[s->nr_regs++].offset = NVME_REG_CSTS;
+	if (NVME_CAP_CMBS(cap))
+		s->regs[s->nr_regs++].offset = NVME_REG_CMBSTS;
+	if (NVME_CAP_PMRS(cap))
+		s->regs[s->nr_regs++].offset = NVME_REG_PMRSTS;
+
+	return 0;
+}
+
+static struct nvme_reg_sample_value *reg_sample_value(struct nvme_reg_sample_reg *r,
+						       __u32 value)
+{
+	int i;
+
+	for (i = 0; i < r->nr_values; i++)
+		if (r->values[i].value == value)
+			return &r->values[i];
+
+	if (r->nr_values == NVME_REG_SAMPLE_MAX_VALUES) {
+		r->overflow = true;
+		return NULL;
+	}
+	r->values[r->nr_values].value = value;
+
+	return &r->values[r->nr_values++];
+}
+
+static void reg_trace(FILE *trace, __u64 ns, int reg, __u32 value)
+{
+	struct nvme_reg_trace_rec rec = {
+		.ns	= cpu_to_le64(ns),
+		.reg	= cpu_to_le32(reg),
+		.value	= cpu_to_le32(value),
+	};
+
+	if (trace)
+		fwrite(&rec, sizeof(rec), 1, trace);
+}
+
+/*
+ * Read the registers of @s from the mapped BAR every @interval_ns until
+ * @duration_ns passed or SIGINT. The clock is read through the vDSO and
+ * the loop spins between samples, so sampling makes no system calls; the
+ * trace is written through a large stdio buffer.
+ */
+static void reg_sample_run(void *bar, struct nvme_reg_sample *s, __u64 interval_ns,
+			   __u64 duration_ns, FILE *trace)
+{
+	struct nvme_reg_sample_value *cur[NVME_REG_SAMPLE_MAX_REGS];
+	__u64 since[NVME_REG_SAMPLE_MAX_REGS];
+	__u32 val[NVME_REG_SAMPLE_MAX_REGS];
+	struct nvme_reg_trace_hdr hdr = { 0 };
+	struct nvme_reg_sample_reg *r;
+	__u64 start, now, prev, next;
+	struct timespec ts;
+	__u32 v;
+	int i;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memcpy(hdr.magic, NVME_REG_TRACE_MAGIC, sizeof(hdr.magic));
+	hdr.version = cpu_to_le32(1);
+	hdr.nr_regs = cpu_to_le32(s->nr_regs);
+	hdr.start_ns = cpu_to_le64((__u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+	hdr.interval_ns = cpu_to_le64(interval_ns);
+	for (i = 0; i < s->nr_regs; i++)
+		hdr.offsets[i] = cpu_to_le32(s->regs[i].offset);
+	if (trace)
+		fwrite(&hdr, sizeof(hdr), 1, trace);
+
+	nvme_stop_catch(true, NULL);
+
+	start = prev = next = now = monotonic_ns();
+	for (i = 0; i < s->nr_regs; i++) {
+		r = &s->regs[i];
+		val[i] = r->first = mmio_read32(bar + r->offset);
+		cur[i] = reg_sample_value(r, val[i]);
+		cur[i]->entered++;
+		since[i] = start;
+		reg_trace(trace, 0, i, val[i]);
+	}
+	s->samples = 1;
+
+	while (!nvme_stopped()) {
+		next += interval_ns;
+		while ((now = monotonic_ns()) < next && !nvme_stopped())
+			;
+		if (nvme_stopped() || (duration_ns && now - start >= duration_ns))
+			break;
+
+		for (i = 0; i < s->nr_regs; i++) {
+			r = &s->regs[i];
+			v = mmio_read32(bar + r->offset);
+			if (v == val[i])
+				continue;
+
+			if (cur[i])
+				cur[i]->dwell_ns += now - since[i];
+			if (!r->transitions)
+				r->first_change_ns = now - start;
+			r->transitions++;
+			cur[i] = reg_sample_value(r, v);
+			if (cur[i])
+				cur[i]->entered++;
+			since[i] = now;
+			val[i] = v;
+			reg_trace(trace, now - start, i, v);
+		}
+
+		if (now - prev > s->max_gap_ns)
+			s->max_gap_ns = now - prev;
+		prev = now;
+		s->samples++;
+
+		/* after a stall sample on from now instead of catching up */
+		if (now - next > interval_ns)
+			next = now;
+	}
+
+	nvme_stop_release();
+
+	for (i = 0; i < s->nr_regs; i++) {
+		if (cur[i])
+			cur[i]->dwell_ns += now - since[i];
+		s->regs[i].last = val[i];
+	}
+	s->elapsed_ns = now - start;
+}
+
+static int get_register_sample(struct nvme_dev *dev, void *bar, struct get_reg_config *cfg,
+			       __u32 interval_us, __u32 duration_ms, const char *file,
+			       enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_reg_sample *s = NULL;
+	_cleanup_free_ char *buf = NULL;
+	FILE *trace = NULL;
+	int err;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return -ENOMEM;
+	s->name = dev->name;
+
+	err = reg_sample_select(bar, cfg, s);
+	if (err)
+		return err;
+
+	if (file) {
+		trace = fopen(file, "w");
+		if (!trace) {
+			nvme_show_perror(file);
+			return -errno;
+		}
+		buf = malloc(1 << 20);
+		if (buf)
+			setvbuf(trace, buf, _IOFBF, 1 << 20);
+	}
+
+	reg_sample_run(bar, s, (__u64)interval_us * NSEC_PER_USEC,
+		       (__u64)duration_ms * 1000000, trace);
+
+	if (trace) {
+		err = ferror(trace);
+		if (fclose(trace) || err) {
+			nvme_show_error("%s: write failed", file);
+			err = -EIO;
+		}
+	}
+
+	nvme_show_reg_sample(s, flags);
+
+	return err;
+}
+
+static int get_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Reads and shows the defined NVMe controller register.\n"
+		"Register offset must be one of:\n"
+		"CAP=0x0, VS=0x8, INTMS=0xc, INTMC=0x10, CC=0x14, CSTS=0x1c,\n"
+		"NSSR=0x20, AQA=0x24, ASQ=0x28, ACQ=0x30, CMBLOC=0x38,\n"
+		"CMBSZ=0x3c, BPINFO=0x40, BPRSEL=0x44, BPMBL=0x48, CMBMSC=0x50,\n"
+		"CMBSTS=0x58, CRTO=0x68, PMRCAP=0xe00, PMRCTL=0xe04,\n"
+		"PMRSTS=0xe08, PMREBS=0xe0c, PMRSWTP=0xe10, PMRMSCL=0xe14, PMRMSCU=0xe18";
+	const char *human_readable = "show register in readable format";
+	const char *cap = "CAP=0x0 register offset";
+	const char *vs = "VS=0x8 register offset";
+	const char *cmbloc = "CMBLOC=0x38 register offset";
+	const char *cmbsz = "CMBSZ=0x3c register offset";
+	const char *bpinfo = "BPINFO=0x40 register offset";
+	const char *cmbsts = "CMBSTS=0x58 register offset";
+	const char *cmbebs = "CMBEBS=0x5c register offset";
+	const char *cmbswtp = "CMBSWTP=0x60 register offset";
+	const char *crto = "CRTO=0x68 register offset";
+	const char *pmrcap = "PMRCAP=0xe00 register offset";
+	const char *pmrsts = "PMRSTS=0xe08 register offset";
+	const char *pmrebs = "PMREBS=0xe0c register offset";
+	const char *pmrswtp = "PMRSWTP=0xe10 register offset";
+	const char *pmrmscl = "PMRMSCL=0xe14 register offset";
+	const char *pmrmscu = "PMRMSCU=0xe18 register offset";
+	const char *sample_interval = "sample the registers every N microseconds, 0 back to back";
+	const char *duration = "milliseconds to sample for, until SIGINT by default";
+	const char *trace = "write the register transitions to this binary trace file";
+	const char *refresh = "reuse the cached properties of a controller read at most N ms ago";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+	enum nvme_print_flags flags;
+	bool fabrics = false;
+	__u32 interval_us = 0, duration_ms = 0, refresh_ms = 0;
+	char *trace_file = NULL;
+
+	void *bar;
+
+	struct get_reg_config cfg = {
+		.offset = -1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("offset",         'O', &cfg.offset,         offset),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable),
+		  OPT_FLAG("cap",              0, &cfg.cap,            cap),
+		  OPT_FLAG("vs",               0, &cfg.vs,             vs),
+		  OPT_FLAG("cmbloc",           0, &cfg.cmbloc,         cmbloc),
+		  OPT_FLAG("cmbsz",            0, &cfg.cmbsz,          cmbsz),
+		  OPT_FLAG("bpinfo",           0, &cfg.bpinfo,         bpinfo),
+		  OPT_FLAG("cmbsts",           0, &cfg.cmbsts,         cmbsts),
+		  OPT_FLAG("cmbebs",           0, &cfg.cmbebs,         cmbebs),
+		  OPT_FLAG("cmbswtp",          0, &cfg.cmbswtp,        cmbswtp),
+		  OPT_FLAG("crto",             0, &cfg.crto,           crto),
+		  OPT_FLAG("pmrcap",           0, &cfg.pmrcap,         pmrcap),
+		  OPT_FLAG("pmrsts",           0, &cfg.pmrsts,         pmrsts),
+		  OPT_FLAG("pmrebs",           0, &cfg.pmrebs,         pmrebs),
+		  OPT_FLAG("pmrswtp",          0, &cfg.pmrswtp,        pmrswtp),
+		  OPT_FLAG("intms",            0, &cfg.intms,          intms),
+		  OPT_FLAG("intmc",            0, &cfg.intmc,          intmc),
+		  OPT_FLAG("cc",               0, &cfg.cc,             cc),
+		  OPT_FLAG("csts",             0, &cfg.csts,           csts),
+		  OPT_FLAG("nssr",             0, &cfg.nssr,           nssr),
+		  OPT_FLAG("aqa",              0, &cfg.aqa,            aqa),
+		  OPT_FLAG("asq",              0, &cfg.asq,            asq),
+		  OPT_FLAG("acq",              0, &cfg.acq,            acq),
+		  OPT_FLAG("bprsel",           0, &cfg.bprsel,         bprsel),
+		  OPT_FLAG("bpmbl",            0, &cfg.bpmbl,          bpmbl),
+		  OPT_FLAG("cmbmsc",           0, &cfg.cmbmsc,         cmbmsc),
+		  OPT_FLAG("nssd",             0, &cfg.nssd,           nssd),
+		  OPT_FLAG("pmrctl",           0, &cfg.pmrctl,         pmrctl),
+		  OPT_FLAG("pmrmscl",          0, &cfg.pmrmscl,        pmrmscl),
+		  OPT_FLAG("pmrmscu",          0, &cfg.pmrmscu,        pmrmscu),
+		  OPT_UINT("sample-interval", 'i', &interval_us,        sample_interval),
+		  OPT_UINT("duration",        'd', &duration_ms,        duration),
+		  OPT_FILE("output-file",     'f', &trace_file,         trace),
+		  OPT_UINT("refresh",         'r', &refresh_ms,         refresh));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.human_readable)
+		flags |= VERBOSE;
+
+	if (argconfig_parse_seen(opts, "sample-interval") && flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	bar = mmap_registers(dev, false);
+
+	if (argconfig_parse_seen(opts, "sample-interval")) {
+		if (!bar) {
+			nvme_show_error("%s: sampling needs the PCI BAR mapped", dev->name);
+			return -ENOTSUP;
+		}
+		err = get_register_sample(dev, bar, &cfg, interval_us, duration_ms,
+					  trace_file, flags);
+		munmap(bar, getpagesize());
+		return err;
+	}
+
+	if (!bar) {
+		err = get_fabrics_registers(dev, refresh_ms, &bar);
+		if (err)
+			return err;
+		fabrics = true;
+	}
+
+	nvme_show_init();
+
+	if (!get_register_offset(bar, fabrics, &cfg, flags)) {
+		nvme_show_error("offset required param");
+		err = -EINVAL;
+	}
+
+	nvme_show_finish();
+
+	if (fabrics)
+		free(bar);
+	else
+		munmap(bar, getpagesize());
+
+	return err;
+}
+
+static int nvme_set_single_property(int fd, int offset, uint64_t value)
+{
+	struct nvme_set_property_args args = {
+		.args_size	= sizeof(args),
+		.fd		= fd,
+		.offset		= offset,
+		.value		= value,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	int err = nvme_set_property(&args);
+
+	if (err < 0)
+		nvme_show_error("set-property: %s", nvme_strerror(errno));
+	else if (!err)
+		printf("set-property: %#02x (%s), value: %#"PRIx64"\n", offset,
+		       nvme_register_to_string(offset), value);
+	else if (err > 0)
+		nvme_show_status(err);
+
+	return err;
+}
+
+static int set_register_property(int fd, int offset, uint64_t value)
+{
+	if (!nvme_is_fabrics_reg(offset)) {
+		printf("register: %#04x (%s) not fabrics\n", offset,
+		       nvme_register_to_string(offset));
+		return -EINVAL;
+	}
+
+	return nvme_set_single_property(fd, offset, value);
+}
+
+static int nvme_set_register(int fd, void *bar, int offset, uint64_t value, bool mmio32)
+{
+	if (!bar)
+		return set_register_property(fd, offset, value);
+
+	if (nvme_is_64bit_reg(offset))
+		mmio_write64(bar + offset, value, mmio32);
+	else
+		mmio_write32(bar + offset, value);
+
+	printf("set-register: %#02x (%s), value: %#"PRIx64"\n", offset,
+	       nvme_register_to_string(offset), value);
+
+	return 0;
+}
+
+static inline int set_register_names_check(struct argconfig_commandline_options *opts, int offset)
+{
+	switch (offset) {
+	case NVME_REG_INTMS:
+		if (argconfig_parse_seen(opts, "intms"))
+			return -EINVAL;
+		break;
+	case NVME_REG_INTMC:
+		if (argconfig_parse_seen(opts, "intmc"))
+			return -EINVAL;
+		break;
+	case NVME_REG_CC:
+		if (argconfig_parse_seen(opts, "cc"))
+			return -EINVAL;
+		break;
+	case NVME_REG_CSTS:
+		if (argconfig_parse_seen(opts, "csts"))
+			return -EINVAL;
+		break;
+	case NVME_REG_NSSR:
+		if (argconfig_parse_seen(opts, "nssr"))
+			return -EINVAL;
+		break;
+	case NVME_REG_AQA:
+		if (argconfig_parse_seen(opts, "aqa"))
+			return -EINVAL;
+		break;
+	case NVME_REG_ASQ:
+		if (argconfig_parse_seen(opts, "asq"))
+			return -EINVAL;
+		break;
+	case NVME_REG_ACQ:
+		if (argconfig_parse_seen(opts, "acq"))
+			return -EINVAL;
+		break;
+	case NVME_REG_BPRSEL:
+		if (argconfig_parse_seen(opts, "bprsel"))
+			return -EINVAL;
+		break;
+	case NVME_REG_CMBMSC:
+		if (argconfig_parse_seen(opts, "cmbmsc"))
+			return -EINVAL;
+		break;
+	case NVME_REG_NSSD:
+		if (argconfig_parse_seen(opts, "nssd"))
+			return -EINVAL;
+		break;
+	case NVME_REG_PMRCTL:
+		if (argconfig_parse_seen(opts, "pmrctl"))
+			return -EINVAL;
+		break;
+	case NVME_REG_PMRMSCL:
+		if (argconfig_parse_seen(opts, "pmrmscl"))
+			return -EINVAL;
+		break;
+	case NVME_REG_PMRMSCU:
+		if (argconfig_parse_seen(opts, "pmrmscu"))
+			return -EINVAL;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+static int set_register_offset(int fd, void *bar, struct argconfig_commandline_options *opts,
+			       struct set_reg_config *cfg)
+{
+	int err;
+
+	if (!argconfig_parse_seen(opts, "value")) {
+		nvme_show_error("value required param");
+		return -EINVAL;
+	}
+
+	err = set_register_names_check(opts, cfg->offset);
+	if (err) {
+		nvme_show_error("offset duplicated param");
+		return err;
+	}
+
+	err = nvme_set_register(fd, bar, cfg->offset, cfg->value, cfg->mmio32);
+	if (err)
+		return err;
+
+	return 0;
+}
+
+static int set_register_names(int fd, void *bar, struct argconfig_commandline_options *opts,
+			      struct set_reg_config *cfg)
+{
+	int err;
+
+	if (argconfig_parse_seen(opts, "intms")) {
+		err = nvme_set_register(fd, bar, NVME_REG_INTMS, cfg->intms, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "intmc")) {
+		err = nvme_set_register(fd, bar, NVME_REG_INTMC, cfg->intmc, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "cc")) {
+		err = nvme_set_register(fd, bar, NVME_REG_CC, cfg->cc, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "csts")) {
+		err = nvme_set_register(fd, bar, NVME_REG_CSTS, cfg->csts, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "nssr")) {
+		err = nvme_set_register(fd, bar, NVME_REG_NSSR, cfg->nssr, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "aqa")) {
+		err = nvme_set_register(fd, bar, NVME_REG_AQA, cfg->aqa, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "asq")) {
+		err = nvme_set_register(fd, bar, NVME_REG_ASQ, cfg->asq, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "acq")) {
+		err = nvme_set_register(fd, bar, NVME_REG_ACQ, cfg->acq, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "bprsel")) {
+		err = nvme_set_register(fd, bar, NVME_REG_BPRSEL, cfg->bprsel, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "cmbmsc")) {
+		err = nvme_set_register(fd, bar, NVME_REG_CMBMSC, cfg->cmbmsc, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "nssd")) {
+		err = nvme_set_register(fd, bar, NVME_REG_NSSD, cfg->nssd, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "pmrctl")) {
+		err = nvme_set_register(fd, bar, NVME_REG_PMRCTL, cfg->pmrctl, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "pmrmscl")) {
+		err = nvme_set_register(fd, bar, NVME_REG_PMRMSCL, cfg->pmrmscl, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	if (argconfig_parse_seen(opts, "pmrmscu")) {
+		err = nvme_set_register(fd, bar, NVME_REG_PMRMSCU, cfg->pmrmscu, cfg->mmio32);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int set_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Writes and shows the defined NVMe controller register";
+	const char *value = "the value of the register to be set";
+	const char *mmio32 = "Access 64-bit registers as 2 32-bit";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	void *bar;
+
+	struct set_reg_config cfg = {
+		.offset = -1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("offset",  'O', &cfg.offset,  offset),
+		  OPT_SUFFIX("value", 'V', &cfg.value,   value),
+		  OPT_FLAG("mmio32",  'm', &cfg.mmio32,  mmio32),
+		  OPT_UINT("intms",     0, &cfg.intms,   intms),
+		  OPT_UINT("intmc",     0, &cfg.intmc,   intmc),
+		  OPT_UINT("cc",        0, &cfg.cc,      cc),
+		  OPT_UINT("csts",      0, &cfg.csts,    csts),
+		  OPT_UINT("nssr",      0, &cfg.nssr,    nssr),
+		  OPT_UINT("aqa",       0, &cfg.aqa,     aqa),
+		  OPT_SUFFIX("asq",     0, &cfg.asq,     asq),
+		  OPT_SUFFIX("acq",     0, &cfg.acq,     acq),
+		  OPT_UINT("bprsel",    0, &cfg.bprsel,  bprsel),
+		  OPT_SUFFIX("bpmbl",   0, &cfg.bpmbl,   bpmbl),
+		  OPT_SUFFIX("cmbmsc",  0, &cfg.cmbmsc,  cmbmsc),
+		  OPT_UINT("nssd",      0, &cfg.nssd,    nssd),
+		  OPT_UINT("pmrctl",    0, &cfg.pmrctl,  pmrctl),
+		  OPT_UINT("pmrmscl",   0, &cfg.pmrmscl, pmrmscl),
+		  OPT_UINT("pmrmscu",   0, &cfg.pmrmscu, pmrmscu));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	bar = mmap_registers(dev, true);
+
+	if (argconfig_parse_seen(opts, "offset"))
+		err = set_register_offset(dev_fd(dev), bar, opts, &cfg);
+
+	if (!err)
+		err = set_register_names(dev_fd(dev), bar, opts, &cfg);
+
+	if (bar)
+		munmap(bar, getpagesize());
+
+	return err;
+}
+
+static int get_property(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Reads and shows the defined NVMe controller property\n"
+		"for NVMe over Fabric. Property offset must be one of:\n"
+		"CAP=0x0, VS=0x8, CC=0x14, CSTS=0x1c, NSSR=0x20, NSSD=0x64, CRTO=0x68";
+	const char *offset = "offset of the requested property";
+	const char *human_readable = "show property in readable format";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u64 value;
+	int err;
+
+	struct get_reg_config cfg = {
+		.offset		= -1,
+		.human_readable	= false,
+		.fabrics	= true,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("offset",         'O', &cfg.offset,         offset),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.offset == -1) {
+		nvme_show_error("offset required param");
+		return -EINVAL;
+	}
+
+	err = nvme_get_single_property(dev_fd(dev), &cfg, &value);
+	if (!err)
+		nvme_show_single_property(cfg.offset, value, cfg.human_readable);
+
+	return err;
+}
+
+static int set_property(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "Writes and shows the defined NVMe controller property for NVMe over Fabric";
+	const char *offset = "the offset of the property";
+	const char *value = "the value of the property to be set";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct set_reg_config cfg = {
+		.offset	= -1,
+		.value	= -1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("offset", 'O', &cfg.offset, offset),
+		  OPT_UINT("value",  'V', &cfg.value,  value));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.offset == -1) {
+		nvme_show_error("offset required param");
+		return -EINVAL;
+	}
+	if (cfg.value == -1) {
+		nvme_show_error("value required param");
+		return -EINVAL;
+	}
+
+	return nvme_set_single_property(dev_fd(dev), cfg.offset, cfg.value);
+}
+
+/* Returns the index of the LBA format without metadata matching @bs */
+static int format_bs_to_lbaf(struct nvme_id_ns *ns, __u64 bs)
+{
+	int i;
+
+	for (i = 0; i <= ns->nlbaf; ++i)
+		if ((1ULL << ns->lbaf[i].ds) == bs && ns->lbaf[i].ms == 0)
+			return i;
+
+	fprintf(stderr, "LBAF corresponding to given block size %"PRIu64" not found\n",
+		(uint64_t)bs);
+	fprintf(stderr, "Please correct block size, or specify LBAF directly\n");
+	return -EINVAL;
+}
+
+/*
+ * If block size has been changed by the format command, we should notify
+ * it to kernel blkdev to update its own block size to the given one
+ * because blkdev will not update by itself without re-opening fd.
+ */
+static int format_update_blkdev(struct nvme_dev *dev, int block_size)
+{
+	if (ioctl(dev_fd(dev), BLKBSZSET, &block_size) < 0) {
+		nvme_show_error("failed to set block size to %d", block_size);
+		return -errno;
+	}
+
+	if (ioctl(dev_fd(dev), BLKRRPART) < 0) {
+		nvme_show_error("failed to re-read partition table");
+		return -errno;
+	}
+
+	return 0;
+}
+
+static int format_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Re-format a specified namespace on the\n"
+		"given device. Can erase all data in namespace (user\n"
+		"data erase) or delete data encryption key if specified.\n"
+		"Can also be used to change LBAF to change the namespaces reported physical block format.";
+	const char *lbaf = "LBA format to apply (required)";
+	const char *ses = "[0-2]: secure erase";
+	const char *pil = "[0-1]: protection info location last/first 8 bytes of metadata";
+	const char *pi = "[0-3]: protection info off/Type 1/Type 2/Type 3";
+	const char *ms = "[0-1]: extended format off/on";
+	const char *reset = "Automatically reset the controller after successful format";
+	const char *bs = "target block size";
+	const char *force = "The \"I know what I'm doing\" flag, skip confirmation before sending command";
+
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u8 prev_lbaf = 0;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u32	timeout;
+		__u8	lbaf;
+		__u8	ses;
+		__u8	pi;
+		__u8	pil;
+		__u8	ms;
+		bool	reset;
+		bool	force;
+		__u64	bs;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.timeout	= 600000,
+		.lbaf		= 0xff,
+		.ses		= 0,
+		.pi		= 0,
+		.pil		= 0,
+		.ms		= 0,
+		.reset		= false,
+		.force		= false,
+		.bs		= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_UINT("timeout",      't', &cfg.timeout,      timeout),
+		  OPT_BYTE("lbaf",         'l', &cfg.lbaf,         lbaf),
+		  OPT_BYTE("ses",          's', &cfg.ses,          ses),
+		  OPT_BYTE("pi",           'i', &cfg.pi,           pi),
+		  OPT_BYTE("pil",          'p', &cfg.pil,          pil),
+		  OPT_BYTE("ms",           'm', &cfg.ms,           ms),
+		  OPT_FLAG("reset",        'r', &cfg.reset,        reset),
+		  OPT_FLAG("force",          0, &cfg.force,        force),
+		  OPT_SUFFIX("block-size", 'b', &cfg.bs,           bs));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = open_exclusive(&dev, argc, argv, cfg.force);
+	if (err) {
+		if (errno == EBUSY) {
+			fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
+			fprintf(stderr, "Namespace is currently busy.\n");
+			if (!cfg.force)
+				fprintf(stderr, "Use the force [--force] option to ignore that.\n");
+		} else {
+			argconfig_print_help(desc, opts);
+		}
+		return err;
+	}
+
+	if (cfg.lbaf != 0xff && cfg.bs != 0) {
+		nvme_show_error(
+		    "Invalid specification of both LBAF and Block Size, please specify only one");
+		return -EINVAL;
+	}
+	if (cfg.bs) {
+		if ((cfg.bs & (~cfg.bs + 1)) != cfg.bs) {
+			nvme_show_error(
+			    "Invalid value for block size (%"PRIu64"), must be a power of two",
+			    (uint64_t) cfg.bs);
+			return -EINVAL;
+		}
+	}
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	if ((ctrl->fna & 1) == 1) {
+		/*
+		 * FNA bit 0 set to 1: all namespaces ... shall be configured with the same
+		 * attributes and a format (excluding secure erase) of any namespace results in a
+		 * format of all namespaces.
+		 */
+		cfg.namespace_id = NVME_NSID_ALL;
+	} else if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return -errno;
+		}
+	}
+
+	if (cfg.namespace_id == 0) {
+		nvme_show_error(
+		    "Invalid namespace ID, specify a namespace to format or use\n"
+		    "'-n 0xffffffff' to format all namespaces on this controller.");
+		return -EINVAL;
+	}
+
+	if (cfg.namespace_id != NVME_NSID_ALL) {
+		ns = nvme_alloc(sizeof(*ns));
+		if (!ns)
+			return -ENOMEM;
+
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+		if (err) {
+			if (err < 0) {
+				nvme_show_error("identify-namespace: %s", nvme_strerror(errno));
+			} else {
+				fprintf(stderr, "identify failed\n");
+				nvme_show_status(err);
+			}
+			return err;
+		}
+		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &prev_lbaf);
+
+		if (cfg.bs) {
+			err = format_bs_to_lbaf(ns, cfg.bs);
+			if (err < 0)
+				return err;
+			cfg.lbaf = err;
+		} else  if (cfg.lbaf == 0xff) {
+			cfg.lbaf = prev_lbaf;
+		}
+	} else {
+		if (cfg.lbaf == 0xff)
+			cfg.lbaf = 0;
+	}
+
+	/* ses & pi checks set to 7 for forward-compatibility */
+	if (cfg.ses > 7) {
+		nvme_show_error("invalid secure erase settings:%d", cfg.ses);
+		return -EINVAL;
+	}
+	if (cfg.lbaf > 63) {
+		nvme_show_error("invalid lbaf:%d", cfg.lbaf);
+		return -EINVAL;
+	}
+	if (cfg.pi > 7) {
+		nvme_show_error("invalid pi:%d", cfg.pi);
+		return -EINVAL;
+	}
+	if (cfg.pil > 1) {
+		nvme_show_error("invalid pil:%d", cfg.pil);
+		return -EINVAL;
+	}
+	if (cfg.ms > 1) {
+		nvme_show_error("invalid ms:%d", cfg.ms);
+		return -EINVAL;
+	}
+
+	if (!cfg.force) {
+		fprintf(stderr, "You are about to format %s, namespace %#x%s.\n",
+			dev->name, cfg.namespace_id,
+			cfg.namespace_id == NVME_NSID_ALL ? "(ALL namespaces)" : "");
+		nvme_show_relatives(dev->name);
+		fprintf(stderr,
+			"WARNING: Format may irrevocably delete this device's data.\n"
+			"You have 10 seconds to press Ctrl-C to cancel this operation.\n\n"
+			"Use the force [--force] option to suppress this warning.\n");
+		sleep(10);
+		fprintf(stderr, "Sending format operation ...\n");
+	}
+
+	struct nvme_format_nvm_args args = {
+		.args_size	= sizeof(args),
+		.nsid		= cfg.namespace_id,
+		.lbafu		= (cfg.lbaf & NVME_NS_FLBAS_HIGHER_MASK) >> 4,
+		.lbaf		= cfg.lbaf & NVME_NS_FLBAS_LOWER_MASK,
+		.mset		= cfg.ms,
+		.pi		= cfg.pi,
+		.pil		= cfg.pil,
+		.ses		= cfg.ses,
+		.timeout	= cfg.timeout,
+		.result		= NULL,
+	};
+	err = nvme_cli_format_nvm(dev, &args);
+	if (err < 0) {
+		nvme_show_error("format: %s", nvme_strerror(errno));
+	} else if (err != 0) {
+		nvme_show_status(err);
+	} else {
+		printf("Success formatting namespace:%x\n", cfg.namespace_id);
+		if (dev->type == NVME_DEV_DIRECT && cfg.lbaf != prev_lbaf) {
+			if (is_chardev(dev)) {
+				if (ioctl(dev_fd(dev), NVME_IOCTL_RESCAN) < 0) {
+					nvme_show_error("failed to rescan namespaces");
+					return -errno;
+				}
+			} else if (cfg.namespace_id != NVME_NSID_ALL) {
+				err = format_update_blkdev(dev, 1 << ns->lbaf[cfg.lbaf].ds);
+				if (err)
+					return err;
+			}
+		}
+		if (dev->type == NVME_DEV_DIRECT && cfg.reset && is_chardev(dev))
+			nvme_ctrl_reset(dev_fd(dev));
+	}
+
+	return err;
+}
+
+struct format_run {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;	/* a subsystem finished */
+	int remaining;		/* subsystems with formats left */
+	__u64 start;
+
+	__u32 timeout;
+	__u8 ses;
+	__u8 pi;
+	__u8 pil;
+	__u8 ms;
+};
+
+struct format_job {
+	struct format_run *run;
+	struct format_job *next;	/* next device of the same subsystem */
+	struct nvme_format_dev *d;
+	struct nvme_dev *dev;
+	__u32 nsid;		/* of the device, @d->nsid may be NVME_NSID_ALL */
+	int block_size;		/* of the new LBA format */
+	__u64 start;		/* of the format */
+};
+
+/*
+ * Devices are grouped by subsystem, namespaces of one subsystem share the
+ * Format NVM Attributes of the controller and are formatted one at a time.
+ */
+static char *format_subsys_name(nvme_root_t r, const char *name)
+{
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	nvme_ns_t n;
+	char blk[64];
+
+	/* the generic char devices are numbered like the block devices */
+	if (!strncmp(name, "ng", 2))
+		snprintf(blk, sizeof(blk), "nvme%s", name + 2);
+	else
+		snprintf(blk, sizeof(blk), "%s", name);
+
+	nvme_for_each_host(r, h)
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ns(s, n)
+				if (!strcmp(nvme_ns_get_name(n), blk))
+					return strdup(nvme_subsystem_get_name(s));
+			nvme_subsystem_for_each_ctrl(s, c)
+				nvme_ctrl_for_each_ns(c, n)
+					if (!strcmp(nvme_ns_get_name(n), blk))
+						return strdup(nvme_subsystem_get_name(s));
+		}
+
+	/* not in the topology, treat it as a subsystem of its own */
+	return strdup(name);
+}
+
+static void format_run_finish(struct format_job *job, int err, __u64 now)
+{
+	struct nvme_format_dev *d = job->d;
+	int ret = 0;
+
+	if (!err && d->lbaf != d->prev_lbaf && is_blkdev(job->dev))
+		ret = format_update_blkdev(job->dev, job->block_size);
+
+	pthread_mutex_lock(&job->run->lock);
+	d->err = err ? : ret;
+	d->done = !err;
+	d->running = false;
+	d->progress = 100;
+	d->eta = 0;
+	d->elapsed_ns = now - job->start;
+	pthread_mutex_unlock(&job->run->lock);
+}
+
+/* worker, formats the devices of one subsystem in order */
+static void format_subsys(void *arg)
+{
+	struct format_job *first = arg, *job, *j;
+	struct format_run *run = first->run;
+	struct nvme_format_dev *d;
+	__u64 now;
+	int err;
+
+	for (job = first; job; job = job->next) {
+		d = job->d;
+		if (d->err || d->shared)
+			continue;
+
+		pthread_mutex_lock(&run->lock);
+		if (nvme_stopped()) {
+			d->err = -ECANCELED;
+			pthread_mutex_unlock(&run->lock);
+			continue;
+		}
+		job->start = monotonic_ns();
+		d->wait_ns = job->start - run->start;
+		d->running = true;
+		pthread_mutex_unlock(&run->lock);
+
+		struct nvme_format_nvm_args args = {
+			.args_size	= sizeof(args),
+			.nsid		= d->nsid,
+			.lbafu		= (d->lbaf & NVME_NS_FLBAS_HIGHER_MASK) >> 4,
+			.lbaf		= d->lbaf & NVME_NS_FLBAS_LOWER_MASK,
+			.mset		= run->ms,
+			.pi		= run->pi,
+			.pil		= run->pil,
+			.ses		= run->ses,
+			.timeout	= run->timeout,
+			.result		= NULL,
+		};
+
+		err = nvme_cli_format_nvm(job->dev, &args);
+		if (err == -1)
+			err = -errno;
+		now = monotonic_ns();
+
+		/* a format of all namespaces covers the rest of the subsystem */
+		for (j = job; j; j = j->next) {
+			if (j == job || (j->d->shared && d->nsid == NVME_NSID_ALL)) {
+				j->start = job->start;
+				j->d->wait_ns = d->wait_ns;
+				format_run_finish(j, err, now);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&run->lock);
+	run->remaining--;
+	pthread_cond_signal(&run->cond);
+	pthread_mutex_unlock(&run->lock);
+}
+
+/* the Format Progress Indicator of the namespaces being formatted */
+static void format_run_poll(struct format_job *job, int nr_devs, struct nvme_id_ns *ns)
+{
+	struct format_run *run = job->run;
+	struct nvme_format_dev *d;
+	__u64 now, elapsed;
+	__u8 remaining;
+	bool running;
+	int i;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = job[i].d;
+
+		pthread_mutex_lock(&run->lock);
+		running = d->running && !d->shared;
+		pthread_mutex_unlock(&run->lock);
+		if (!running)
+			continue;
+
+		if (d->fpi && !nvme_cli_identify_ns(job[i].dev, job[i].nsid, ns))
+			remaining = ns->fpi & 0x7f;
+		else
+			remaining = 0xff;
+
+		now = monotonic_ns();
+		pthread_mutex_lock(&run->lock);
+		if (d->running) {
+			elapsed = now - job[i].start;
+			d->elapsed_ns = elapsed;
+			if (remaining <= 100) {
+				d->progress = 100 - remaining;
+				d->eta = d->progress ?
+					elapsed / NSEC_PER_SEC * remaining / d->progress : 0;
+			}
+		}
+		pthread_mutex_unlock(&run->lock);
+	}
+}
+
+/* redrawn in place on a terminal, appended otherwise */
+static void format_run_table(struct format_run *run, struct nvme_format_dev *devs,
+			     int nr_devs, bool redraw)
+{
+	struct nvme_format_dev *d;
+	int i, done = 0;
+
+	if (redraw)
+		fprintf(stderr, "\033[%dA", nr_devs + 1);
+
+	pthread_mutex_lock(&run->lock);
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		if (d->done)
+			done++;
+		fprintf(stderr, "%-16s %-24s %-9s", d->name, d->subsys,
+			d->err ? "error" : d->done ? "done" :
+			d->running ? "running" : "queued");
+		if (d->running && d->fpi)
+			fprintf(stderr, " %3u%% eta %5us", d->progress, d->eta);
+		else
+			fprintf(stderr, "%14s", "");
+		fprintf(stderr, " %6.0fs\033[K\n", d->elapsed_ns / 1e9);
+	}
+	fprintf(stderr, "%d of %d formatted, %.0fs\033[K\n", done, nr_devs,
+		(monotonic_ns() - run->start) / 1e9);
+	pthread_mutex_unlock(&run->lock);
+}
+
+static int format_run(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Format several namespaces at once. Namespaces of different\n"
+		"subsystems are formatted concurrently, namespaces of one subsystem\n"
+		"one after the other. If the controller formats all namespaces\n"
+		"together (FNA bit 0) a subsystem gets a single format of all\n"
+		"namespaces. The namespace devices must be given as arguments.";
+	const char *lbaf = "LBA format to apply, defaults to the current one";
+	const char *ses = "[0-2]: secure erase";
+	const char *pil = "[0-1]: protection info location last/first 8 bytes of metadata";
+	const char *pi = "[0-3]: protection info off/Type 1/Type 2/Type 3";
+	const char *ms = "[0-1]: extended format off/on";
+	const char *bs = "target block size";
+	const char *interval = "seconds between progress updates";
+	const char *force = "The \"I know what I'm doing\" flag, skip confirmation before sending command";
+
+	_cleanup_topology_ nvme_root_t r = NULL;
+	_cleanup_free_ struct nvme_format_dev *devs = NULL;
+	_cleanup_free_ struct format_job *job = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct nvme_thread_pool *pool = NULL;
+	struct format_run run = { 0 };
+	pthread_condattr_t attr;
+	enum nvme_print_flags flags;
+	struct format_job *j;
+	struct nvme_format_dev *d;
+	int nr_devs = 0, nr_subsys = 0, i, k, err;
+	bool redraw, drawn = false;
+	struct timespec ts;
+	__u64 next;
+
+	struct config {
+		__u32	timeout;
+		__u8	lbaf;
+		__u8	ses;
+		__u8	pi;
+		__u8	pil;
+		__u8	ms;
+		__u64	bs;
+		__u32	interval;
+		bool	force;
+	};
+
+	struct config cfg = {
+		.timeout	= 600000,
+		.lbaf		= 0xff,
+		.ses		= 0,
+		.pi		= 0,
+		.pil		= 0,
+		.ms		= 0,
+		.bs		= 0,
+		.interval	= 5,
+		.force		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("timeout",      't', &cfg.timeout,  timeout),
+		  OPT_BYTE("lbaf",         'l', &cfg.lbaf,     lbaf),
+		  OPT_BYTE("ses",          's', &cfg.ses,      ses),
+		  OPT_BYTE("pi",           'i', &cfg.pi,       pi),
+		  OPT_BYTE("pil",          'p', &cfg.pil,      pil),
+		  OPT_BYTE("ms",           'm', &cfg.ms,       ms),
+		  OPT_SUFFIX("block-size", 'b', &cfg.bs,       bs),
+		  OPT_UINT("interval",     'I', &cfg.interval, interval),
+		  OPT_FLAG("force",          0, &cfg.force,    force));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || (flags != JSON && flags != NORMAL)) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (optind >= argc) {
+		nvme_show_error("no namespaces given");
+		return -EINVAL;
+	}
+
+	if (cfg.lbaf != 0xff && cfg.bs != 0) {
+		nvme_show_error(
+		    "Invalid specification of both LBAF and Block Size, please specify only one");
+		return -EINVAL;
+	}
+	if (cfg.bs && (cfg.bs & (~cfg.bs + 1)) != cfg.bs) {
+		nvme_show_error("Invalid value for block size (%"PRIu64"), must be a power of two",
+				(uint64_t)cfg.bs);
+		return -EINVAL;
+	}
+	/* ses & pi checks set to 7 for forward-compatibility */
+	if (cfg.ses > 7 || (cfg.lbaf != 0xff && cfg.lbaf > 63) || cfg.pi > 7 ||
+	    cfg.pil > 1 || cfg.ms > 1 || !cfg.interval) {
+		nvme_show_error("invalid ses, lbaf, pi, pil, ms or interval");
+		return -EINVAL;
+	}
+
+	if (scan_topology(&r) < 0) {
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return -errno;
+	}
+
+	nr_devs = argc - optind;
+	devs = calloc(nr_devs, sizeof(*devs));
+	job = calloc(nr_devs, sizeof(*job));
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	ns = nvme_alloc(sizeof(*ns));
+	if (!devs || !job || !ctrl || !ns)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_devs; i++) {
+		d = &devs[i];
+		job[i].run = &run;
+		job[i].d = d;
+		d->path = argv[optind + i];
+		d->name = basename(d->path);
+		d->subsys = format_subsys_name(r, d->name);
+		if (!d->subsys) {
+			err = -ENOMEM;
+			goto close;
+		}
+
+		/* link to the last device of the same subsystem */
+		for (k = i - 1; k >= 0; k--) {
+			if (!strcmp(devs[k].subsys, d->subsys) && !job[k].next) {
+				job[k].next = &job[i];
+				break;
+			}
+		}
+		if (k < 0)
+			nr_subsys++;
+
+		if (open_dev_direct(&job[i].dev, d->path,
+				    cfg.force ? O_RDONLY : O_RDONLY | O_EXCL)) {
+			d->err = -errno;
+			continue;
+		}
+
+		err = nvme_get_nsid(dev_fd(job[i].dev), &job[i].nsid);
+		if (err < 0) {
+			d->err = -errno;
+			continue;
+		}
+		d->nsid = job[i].nsid;
+
+		err = nvme_cli_identify_ns(job[i].dev, d->nsid, ns);
+		if (err) {
+			d->err = err < 0 ? -errno : err;
+			continue;
+		}
+		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &d->prev_lbaf);
+		d->fpi = ns->fpi & 0x80;
+
+		if (cfg.bs) {
+			err = format_bs_to_lbaf(ns, cfg.bs);
+			if (err < 0) {
+				d->err = err;
+				continue;
+			}
+			d->lbaf = err;
+		} else {
+			d->lbaf = cfg.lbaf == 0xff ? d->prev_lbaf : cfg.lbaf;
+		}
+		if (d->lbaf > ns->nlbaf) {
+			d->err = -EINVAL;
+			continue;
+		}
+		job[i].block_size = 1 << ns->lbaf[d->lbaf].ds;
+	}
+
+	/*
+	 * FNA bit 0: a format of any namespace formats all namespaces, the
+	 * first usable device of the subsystem formats them all with its LBA
+	 * format, and that is the block size each of them ends up with.
+	 */
+	for (i = 0; i < nr_devs; i++) {
+		if (devs[i].err)
+			continue;
+		for (k = 0; k < i; k++)
+			if (!devs[k].err && !strcmp(devs[k].subsys, devs[i].subsys))
+				break;
+		if (k < i)
+			continue;
+
+		err = nvme_cli_identify_ctrl(job[i].dev, ctrl);
+		if (err) {
+			devs[i].err = err < 0 ? -errno : err;
+			continue;
+		}
+		if (!(ctrl->fna & 1))
+			continue;
+
+		devs[i].nsid = NVME_NSID_ALL;
+		for (j = job[i].next; j; j = j->next) {
+			if (j->d->err)
+				continue;
+			j->d->shared = true;
+			j->d->lbaf = devs[i].lbaf;
+			j->block_size = job[i].block_size;
+		}
+	}
+
+	if (!cfg.force) {
+		fprintf(stderr, "You are about to format:\n");
+		for (i = 0; i < nr_devs; i++) {
+			if (devs[i].err || devs[i].shared)
+				continue;
+			fprintf(stderr, "  %s, namespace %#x%s, LBA format %u\n",
+				devs[i].name, devs[i].nsid,
+				devs[i].nsid == NVME_NSID_ALL ? " (ALL namespaces)" : "",
+				devs[i].lbaf);
+			nvme_show_relatives(devs[i].name);
+		}
+		fprintf(stderr,
+			"WARNING: Format may irrevocably delete the data of these devices.\n"
+			"You have 10 seconds to press Ctrl-C to cancel this operation.\n\n"
+			"Use the force [--force] option to suppress this warning.\n");
+		sleep(10);
+		fprintf(stderr, "Sending format operations ...\n");
+	}
+
+	run.timeout = cfg.timeout;
+	run.ses = cfg.ses;
+	run.pi = cfg.pi;
+	run.pil = cfg.pil;
+	run.ms = cfg.ms;
+	pthread_mutex_init(&run.lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&run.cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	pool = nvme_thread_pool_create(nr_subsys);
+	if (!pool) {
+		err = -errno;
+		nvme_show_error("thread pool: %s", nvme_strerror(errno));
+		goto destroy;
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	/* one worker per subsystem, started from its first device */
+	run.start = monotonic_ns();
+	for (i = 0; i < nr_devs; i++) {
+		for (k = 0; k < i && strcmp(devs[k].subsys, devs[i].subsys); k++)
+			;
+		if (k < i)
+			continue;
+		pthread_mutex_lock(&run.lock);
+		run.remaining++;
+		pthread_mutex_unlock(&run.lock);
+		err = nvme_thread_pool_queue(pool, format_subsys, &job[i]);
+		if (err) {
+			pthread_mutex_lock(&run.lock);
+			run.remaining--;
+			for (j = &job[i]; j; j = j->next)
+				if (!j->d->err)
+					j->d->err = err;
+			pthread_mutex_unlock(&run.lock);
+		}
+	}
+
+	redraw = isatty(STDERR_FILENO);
+	next = run.start;
+	pthread_mutex_lock(&run.lock);
+	while (run.remaining) {
+		next += cfg.interval * NSEC_PER_SEC;
+		ts.tv_sec = next / NSEC_PER_SEC;
+		ts.tv_nsec = next % NSEC_PER_SEC;
+		while (run.remaining &&
+		       pthread_cond_timedwait(&run.cond, &run.lock, &ts) != ETIMEDOUT)
+			;
+		if (!run.remaining)
+			break;
+		pthread_mutex_unlock(&run.lock);
+
+		format_run_poll(job, nr_devs, ns);
+		format_run_table(&run, devs, nr_devs, redraw && drawn);
+		drawn = true;
+
+		pthread_mutex_lock(&run.lock);
+	}
+	pthread_mutex_unlock(&run.lock);
+	nvme_thread_pool_destroy(pool);
+
+	nvme_stop_release();
+
+	nvme_show_format_run(devs, nr_devs, monotonic_ns() - run.start, flags);
+
+	err = 0;
+	for (i = 0; i < nr_devs; i++)
+		if (devs[i].err)
+			err = devs[i].err;
+
+destroy:
+	pthread_cond_destroy(&run.cond);
+	pthread_mutex_destroy(&run.lock);
+close:
+	for (i = 0; i < nr_devs; i++) {
+		if (job[i].dev)
+			dev_close(job[i].dev);
+		free(devs[i].subsys);
+	}
+
+	return err;
+}
+
+#define STRTOUL_AUTO_BASE              (0)
+#define NVME_FEAT_TIMESTAMP_DATA_SIZE  (6)
+
+static int set_feature(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Modify the saveable or changeable "
+		"current operating parameters of the controller. "
+		"Operating parameters are grouped and identified by Feature"
+		"Identifiers. Feature settings can be applied to the entire"
+		"controller and all associated namespaces, or to only a few"
+		"namespace(s) associated with the controller. Default values"
+		"for each Feature are vendor-specific and may not be modified."
+		"Use get-feature to determine which Features are supported by"
+		"the controller and are saveable/changeable.";
+	const char *feature_id = "feature identifier (required)";
+	const char *data = "optional file for feature data (default stdin)";
+	const char *value = "new value of feature (required)";
+	const char *cdw12 = "feature cdw12, if used";
+	const char *save = "specifies that the controller shall save the attribute";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *buf = NULL;
+	_cleanup_file_ int ffd = STDIN_FILENO;
+	int err;
+	__u32 result;
+
+	struct config {
+		__u32	namespace_id;
+		__u8	feature_id;
+		__u64	value;
+		__u32	cdw12;
+		__u8	uuid_index;
+		__u32	data_len;
+		char	*file;
+		bool	save;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.feature_id	= 0,
+		.value		= 0,
+		.uuid_index	= 0,
+		.data_len	= 0,
+		.file		= "",
+		.save		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
+		  OPT_BYTE("feature-id",   'f', &cfg.feature_id,   feature_id),
+		  OPT_SUFFIX("value",      'V', &cfg.value,        value),
+		  OPT_UINT("cdw12",        'c', &cfg.cdw12,        cdw12),
+		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,   uuid_index_specify),
+		  OPT_UINT("data-len",     'l', &cfg.data_len,     buf_len),
+		  OPT_FILE("data",         'd', &cfg.file,         data),
+		  OPT_FLAG("save",         's', &cfg.save,         save));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!argconfig_parse_seen(opts, "namespace-id")) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			if (errno != ENOTTY) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return -errno;
+			}
+			cfg.namespace_id = NVME_NSID_ALL;
+		}
+	}
+
+	if (!cfg.feature_id) {
+		nvme_show_error("feature-id required param");
+		return -EINVAL;
+	}
+
+	if (cfg.uuid_index > 127) {
+		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
+		return -1;
+	}
+
+	if (!cfg.data_len)
+		nvme_cli_get_feature_length2(cfg.feature_id, cfg.value,
+					     NVME_DATA_TFR_HOST_TO_CTRL,
+					     &cfg.data_len);
+
+	if (cfg.data_len) {
+		buf = nvme_alloc(cfg.data_len);
+		if (!buf)
+			return -ENOMEM;
+	}
+
+	if (buf) {
+		/*
+		 * Use the '-v' value for the timestamp feature if provided as
+		 * a convenience since it can often fit in 4-bytes. The user
+		 * should use the buffer method if the value exceeds this
+		 * length.
+		 */
+		if (cfg.feature_id == NVME_FEAT_FID_TIMESTAMP && cfg.value) {
+			memcpy(buf, &cfg.value, NVME_FEAT_TIMESTAMP_DATA_SIZE);
+		} else {
+			if (strlen(cfg.file))
+				ffd = open(cfg.file, O_RDONLY);
+
+			if (ffd < 0) {
+				nvme_show_error("Failed to open file %s: %s",
+						cfg.file, strerror(errno));
+				return -EINVAL;
+			}
+
+			err = read(ffd, buf, cfg.data_len);
+			if (err < 0) {
+				nvme_show_error("failed to read data buffer from input file: %s",
+						strerror(errno));
+				return -errno;
+			}
+		}
+	}
+
+	struct nvme_set_features_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.fid		= cfg.feature_id,
+		.nsid		= cfg.namespace_id,
+		.cdw11		= cfg.value,
+		.cdw12		= cfg.cdw12,
+		.save		= cfg.save,
+		.uuidx		= cfg.uuid_index,
+		.cdw15		= 0,
+		.data_len	= cfg.data_len,
+		.data		= buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_set_features(&args);
+	if (err < 0) {
+		nvme_show_error("set-feature: %s", nvme_strerror(errno));
+	} else if (!err) {
+		printf("set-feature:%#0*x (%s), value:%#0*"PRIx64", cdw12:%#0*x, save:%#x\n",
+		       cfg.feature_id ? 4 : 2, cfg.feature_id,
+		       nvme_feature_to_string(cfg.feature_id),
+		       cfg.value ? 10 : 8, (uint64_t)cfg.value,
+		       cfg.cdw12 ? 10 : 8, cfg.cdw12, cfg.save);
+		if (cfg.feature_id == NVME_FEAT_FID_LBA_STS_INTERVAL)
+			nvme_show_lba_status_info(result);
+		if (buf) {
+			if (cfg.feature_id == NVME_FEAT_FID_LBA_RANGE)
+				nvme_show_lba_range((struct nvme_lba_range_type *)buf, result, 0);
+			else
+				d(buf, cfg.data_len, 16, 1);
+		}
+	} else if (err > 0) {
+		nvme_show_status(err);
+	}
+
+	return err;
+}
+
+static int sec_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	struct stat sb;
+	const char *desc = "Transfer security protocol data to\n"
+		"a controller. Security Receives for the same protocol should be\n"
+		"performed after Security Sends. The security protocol field\n"
+		"associates Security Sends (security-send) and Security Receives (security-recv).";
+	const char *file = "transfer payload";
+	const char *tl = "transfer length (cf. SPC-4)";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *sec_buf = NULL;
+	_cleanup_file_ int sec_fd = -1;
+	unsigned int sec_size;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		char	*file;
+		__u8	nssf;
+		__u8	secp;
+		__u16	spsp;
+		__u32	tl;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.file		= "",
+		.nssf		= 0,
+		.secp		= 0,
+		.spsp		= 0,
+		.tl		= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
+		  OPT_FILE("file",         'f', &cfg.file,         file),
+		  OPT_BYTE("nssf",         'N', &cfg.nssf,         nssf),
+		  OPT_BYTE("secp",         'p', &cfg.secp,         secp),
+		  OPT_SHRT("spsp",         's', &cfg.spsp,         spsp),
+		  OPT_UINT("tl",           't', &cfg.tl,           tl));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.tl == 0) {
+		nvme_show_error("--tl unspecified or zero");
+		return -EINVAL;
+	}
+	if ((cfg.tl & 3) != 0)
+		nvme_show_error(
+		    "WARNING: --tl not dword aligned; unaligned bytes may be truncated");
+
+	if (strlen(cfg.file) == 0) {
+		sec_fd = STDIN_FILENO;
+		sec_size = cfg.tl;
+	} else {
+		sec_fd = open(cfg.file, O_RDONLY);
+		if (sec_fd < 0) {
+			nvme_show_error("Failed to open %s: %s", cfg.file, strerror(errno));
+			return -EINVAL;
+		}
+
+		err = fstat(sec_fd, &sb);
+		if (err < 0) {
+			nvme_show_perror("fstat");
+			return err;
+		}
+
+		sec_size = cfg.tl > sb.st_size ? cfg.tl : sb.st_size;
+	}
+
+	sec_buf = nvme_alloc(cfg.tl);
+	if (!sec_buf)
+		return -ENOMEM;
+
+	err = read(sec_fd, sec_buf, sec_size);
+	if (err < 0) {
+		nvme_show_error("Failed to read data from security file %s with %s", cfg.file,
+				strerror(errno));
+		return -errno;
+	}
+
+	struct nvme_security_send_args args = {
+		.args_size	= sizeof(args),
+		.nsid		= cfg.namespace_id,
+		.nssf		= cfg.nssf,
+		.spsp0		= cfg.spsp & 0xff,
+		.spsp1		= cfg.spsp >> 8,
+		.secp		= cfg.secp,
+		.tl		= cfg.tl,
+		.data_len	= cfg.tl,
+		.data		= sec_buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+
+	err = nvme_cli_security_send(dev, &args);
+
+	if (err < 0)
+		nvme_show_error("security-send: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Security Send Command Success\n");
+
+	return err;
+}
+
+static int dir_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Set directive parameters of the specified directive type.";
+	const char *endir = "directive enable";
+	const char *ttype = "target directive type to be enabled/disabled";
+	const char *input = "write/send file (default stdin)";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ void *buf = NULL;
+	__u32 result;
+	__u32 dw12 = 0;
+	_cleanup_file_ int ffd = STDIN_FILENO;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u32	data_len;
+		__u8	dtype;
+		__u8	ttype;
+		__u16	dspec;
+		__u8	doper;
+		__u16	endir;
+		bool	human_readable;
+		bool	raw_binary;
+		char	*file;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 1,
+		.data_len	= 0,
+		.dtype		= 0,
+		.ttype		= 0,
+		.dspec		= 0,
+		.doper		= 0,
+		.endir		= 1,
+		.human_readable	= false,
+		.raw_binary	= false,
+		.file		= "",
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
+		  OPT_BYTE("dir-type",       'D', &cfg.dtype,          dtype),
+		  OPT_BYTE("target-dir",     'T', &cfg.ttype,          ttype),
+		  OPT_SHRT("dir-spec",       'S', &cfg.dspec,          dspec_w_dtype),
+		  OPT_BYTE("dir-oper",       'O', &cfg.doper,          doper),
+		  OPT_SHRT("endir",          'e', &cfg.endir,          endir),
+		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_directive),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_directive),
+		  OPT_FILE("input-file",     'i', &cfg.file,           input));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	switch (cfg.dtype) {
+	case NVME_DIRECTIVE_DTYPE_IDENTIFY:
+		switch (cfg.doper) {
+		case NVME_DIRECTIVE_SEND_IDENTIFY_DOPER_ENDIR:
+			if (!cfg.ttype) {
+				nvme_show_error("target-dir required param\n");
+				return -EINVAL;
+			}
+			dw12 = cfg.ttype << 8 | cfg.endir;
+			break;
+		default:
+			nvme_show_error("invalid directive operations for Identify Directives");
+			return -EINVAL;
+		}
+		break;
+	case NVME_DIRECTIVE_DTYPE_STREAMS:
+		switch (cfg.doper) {
+		case NVME_DIRECTIVE_SEND_STREAMS_DOPER_RELEASE_IDENTIFIER:
+		case NVME_DIRECTIVE_SEND_STREAMS_DOPER_RELEASE_RESOURCE:
+			break;
+		default:
+			nvme_show_error("invalid directive operations for Streams Directives");
+			return -EINVAL;
+		}
+		break;
+	default:
+		nvme_show_error("invalid directive type");
+		return -EINVAL;
+	}
+
+	if (cfg.data_len) {
+		buf = nvme_alloc(cfg.data_len);
+		if (!buf)
+			return -ENOMEM;
+	}
+
+	if (buf) {
+		if (strlen(cfg.file)) {
+			ffd = open(cfg.file, O_RDONLY);
+			if (ffd <= 0) {
+				nvme_show_error("Failed to open file %s: %s",
+						cfg.file, strerror(errno));
+				return -EINVAL;
+			}
+		}
+		err = read(ffd, (void *)buf, cfg.data_len);
+		if (err < 0) {
+			nvme_show_error("failed to read data buffer from input file %s",
+					strerror(errno));
+			return -errno;
+		}
+	}
+
+	struct nvme_directive_send_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.dspec		= cfg.dspec,
+		.doper		= cfg.doper,
+		.dtype		= cfg.dtype,
+		.cdw12		= dw12,
+		.data_len	= cfg.data_len,
+		.data		= buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_directive_send(&args);
+	if (err < 0) {
+		nvme_show_error("dir-send: %s", nvme_strerror(errno));
+		return err;
+	}
+	if (!err) {
+		printf("dir-send: type %#x, operation %#x, spec_val %#x, nsid %#x, result %#x\n",
+		       cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id, result);
+		if (buf) {
+			if (!cfg.raw_binary)
+				d(buf, cfg.data_len, 16, 1);
+			else
+				d_raw(buf, cfg.data_len);
+		}
+	} else if (err > 0) {
+		nvme_show_status(err);
+	}
+
+	return err;
+}
+
+/*
+ * io_uring passthrough is only available on the generic char device
+ * (/dev/ngXnY), map a namespace block device to its generic device.
+ */
+int open_generic_dev(struct nvme_dev *dev)
+{
+	char path[512];
+	unsigned int ctrl, ns;
+	int fd;
+
+	if (is_chardev(dev))
+		return dup(dev_fd(dev));
+
+	if (sscanf(dev->name, "nvme%un%u", &ctrl, &ns) != 2) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	snprintf(path, sizeof(path), "/dev/ng%un%u", ctrl, ns);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		nvme_show_perror(path);
+
+	return fd;
+}
+
+/*
+ * Polled passthrough only skips the completion interrupt if the driver was
+ * loaded with poll queues (nvme.poll_queues=N), otherwise the commands end
+ * up on the interrupt driven queues and are merely reaped by polling.
+ */
+static void io_poll_check(struct nvme_dev *dev)
+{
+	char path[PATH_MAX];
+	unsigned int ctrl, ns;
+	int poll = -1;
+	FILE *f;
+
+	if (sscanf(dev->name, "nvme%un%u", &ctrl, &ns) != 2 &&
+	    sscanf(dev->name, "ng%un%u", &ctrl, &ns) != 2)
+		return;
+
+	snprintf(path, sizeof(path), "/sys/class/block/nvme%un%u/queue/io_poll",
+		 ctrl, ns);
+	f = fopen(path, "r");
+	if (!f)
+		return;
+	if (fscanf(f, "%d", &poll) != 1)
+		poll = -1;
+	fclose(f);
+
+	if (!poll)
+		fprintf(stderr,
+			"%s has no poll queues, load nvme with poll_queues=N to poll the device\n",
+			dev->name);
+}
+
+/*
+ * Find the peer-to-peer memory of the controller behind @dev for --cmb.
+ * The kernel only publishes a CMB the controller accepts both read and
+ * write data in (CMBSZ.WDS and RDS).
+ */
+static int cmb_p2pmem(struct nvme_dev *dev, char *dir, size_t len)
+{
+	unsigned long long published = 0;
+
+	if (dev->type != NVME_DEV_DIRECT ||
+	    sysfs_p2pmem_dir(dev->name, dir, len) ||
+	    sysfs_read_u64(dir, "published", &published) || !published) {
+		nvme_show_error("%s: no controller memory buffer for data transfers",
+				dev->name);
+		errno = ENODEV;
+		return -1;
+	}
+
+	return 0;
+}
+
+static void *cmb_alloc(struct nvme_dev *dev, size_t len, struct nvme_mem_huge *mh)
+{
+	char dir[PATH_MAX];
+	void *p;
+
+	if (cmb_p2pmem(dev, dir, sizeof(dir)))
+		return NULL;
+
+	p = nvme_alloc_cmb(dir, len, mh);
+	if (!p)
+		nvme_show_error("%s: controller memory buffer: %s", dev->name,
+				nvme_strerror(errno));
+
+	return p;
+}
+
+/*
+ * Parse "<start>:<end>" with an exclusive end. An empty end or "all"
+ * extends the range to the end of the namespace.
+ */
+static int parse_lba_range(const char *str, __u64 nsze, __u64 *slba, __u64 *nr_lbas)
+{
+	const char *sep = strchr(str, ':');
+	__u64 start, end = nsze;
+	char *p;
+
+	if (!strcmp(str, "all")) {
+		*slba = 0;
+		*nr_lbas = nsze;
+		return 0;
+	}
+
+	if (!sep)
+		return -EINVAL;
+
+	errno = 0;
+	start = strtoull(str, &p, 0);
+	if (errno || p != sep)
+		return -EINVAL;
+
+	if (sep[1] && strcmp(sep + 1, "all")) {
+		end = strtoull(sep + 1, &p, 0);
+		if (errno || *p)
+			return -EINVAL;
+	}
+
+	if (start >= end || end > nsze)
+		return -ERANGE;
+
+	*slba = start;
+	*nr_lbas = end - start;
+
+	return 0;
+}
+
+struct io_sweep_job {
+	__u64 cmd_lbas;		/* LBAs per command, the last one may be shorter */
+	__u64 done;		/* LBAs of successful commands */
+
+	pthread_mutex_t lock;
+	__u8 *completed;	/* bitmap of completed commands */
+	__u64 next;		/* all commands below have completed */
+	struct nvme_lba_range_err *errs;
+	int nr_errs;
+
+	const char *checkpoint;
+	__u64 checkpoint_ns;	/* time of the next checkpoint update */
+};
+
+static __u64 io_sweep_cmd_lbas(struct nvme_io_job *job, __u64 seq)
+{
+	struct io_sweep_job *sw = job->priv;
+
+	return min(sw->cmd_lbas, job->nr_lbas - seq * sw->cmd_lbas);
+}
+
+static __u64 io_sweep_next_lba(struct nvme_io_job *job)
+{
+	struct io_sweep_job *sw = job->priv;
+
+	return job->slba + min(sw->next * sw->cmd_lbas, job->nr_lbas);
+}
+
+/*
+ * The checkpoint holds the remaining range as "<next>:<end>" and is
+ * replaced atomically, a crash leaves either the old or the new one.
+ */
+static int io_sweep_checkpoint(struct nvme_io_job *job)
+{
+	struct io_sweep_job *sw = job->priv;
+	char tmp[PATH_MAX];
+	FILE *f;
+	int err = 0;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", sw->checkpoint) >= (int)sizeof(tmp))
+		return -ENAMETOOLONG;
+
+	f = fopen(tmp, "w");
+	if (!f)
+		return -errno;
+
+	fprintf(f, "%"PRIu64":%"PRIu64"\n", (uint64_t)io_sweep_next_lba(job),
+		(uint64_t)(job->slba + job->nr_lbas));
+	if (fflush(f) || fsync(fileno(f)))
+		err = -errno;
+	if (fclose(f) && !err)
+		err = -errno;
+	if (!err && rename(tmp, sw->checkpoint))
+		err = -errno;
+	if (err)
+		unlink(tmp);
+
+	return err;
+}
+
+/* Returns 1 and the remaining range if @file holds a checkpoint */
+static int io_sweep_resume(const char *file, char *range, size_t len)
+{
+	_cleanup_file_ int fd = open(file, O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return errno == ENOENT ? 0 : -errno;
+
+	n = read(fd, range, len - 1);
+	if (n < 0)
+		return -errno;
+
+	range[n] = '\0';
+	range[strcspn(range, "\n")] = '\0';
+
+	return 1;
+}
+
+static int io_sweep_prep(struct nvme_io_job *job, unsigned int thread,
+			 __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct io_sweep_job *sw = job->priv;
+
+	/* Write Zeroes, Write Uncorrectable and Verify transfer no data */
+	memset(cmd, 0, sizeof(*cmd));
+	nvme_io_job_init_cmd(job, job->slba + seq * sw->cmd_lbas, cmd);
+	cmd->cdw12 = (io_sweep_cmd_lbas(job, seq) - 1) | (job->control << 16);
+
+	return 0;
+}
+
+static void io_sweep_complete(struct nvme_io_job *job, unsigned int thread,
+			      __u64 seq, void *buf, int status, __u64 result,
+			      __u64 lat_ns)
+{
+	struct io_sweep_job *sw = job->priv;
+	struct nvme_lba_range_err *errs;
+	__u64 now;
+
+	pthread_mutex_lock(&sw->lock);
+	if (!status) {
+		sw->done += io_sweep_cmd_lbas(job, seq);
+	} else {
+		errs = realloc(sw->errs, (sw->nr_errs + 1) * sizeof(*errs));
+		if (errs) {
+			errs[sw->nr_errs].slba = job->slba + seq * sw->cmd_lbas;
+			errs[sw->nr_errs].nlb = io_sweep_cmd_lbas(job, seq);
+			errs[sw->nr_errs].status = status;
+			sw->errs = errs;
+			sw->nr_errs++;
+		}
+	}
+
+	sw->completed[seq / 8] |= 1 << (seq % 8);
+	while (sw->next < job->nr_ios &&
+	       sw->completed[sw->next / 8] & (1 << (sw->next % 8)))
+		sw->next++;
+
+	if (sw->checkpoint) {
+		now = monotonic_ns();
+		if (now >= sw->checkpoint_ns) {
+			sw->checkpoint_ns = now + NSEC_PER_SEC;
+			io_sweep_checkpoint(job);
+		}
+	}
+	pthread_mutex_unlock(&sw->lock);
+}
+
+static const struct nvme_io_job_ops io_sweep_ops = {
+	.prep		= io_sweep_prep,
+	.complete	= io_sweep_complete,
+};
+
+static int io_sweep_err_cmp(const void *a, const void *b)
+{
+	const struct nvme_lba_range_err *ea = a, *eb = b;
+
+	return ea->slba < eb->slba ? -1 : ea->slba > eb->slba;
+}
+
+/* Sort the failed commands and merge neighbours failing the same way */
+static void io_sweep_merge_errs(struct io_sweep_job *sw)
+{
+	int i, n = 0;
+
+	qsort(sw->errs, sw->nr_errs, sizeof(*sw->errs), io_sweep_err_cmp);
+	for (i = 0; i < sw->nr_errs; i++) {
+		if (n && sw->errs[n - 1].status == sw->errs[i].status &&
+		    sw->errs[n - 1].slba + sw->errs[n - 1].nlb == sw->errs[i].slba) {
+			sw->errs[n - 1].nlb += sw->errs[i].nlb;
+			continue;
+		}
+		sw->errs[n++] = sw->errs[i];
+	}
+	sw->nr_errs = n;
+}
+
+/*
+ * WZSL, WUSL and VSL are a power of two in units of the minimum memory
+ * page size, like MDTS assume 4k pages. 0 means no limit beyond the 16
+ * bit NLB field.
+ */
+static __u64 nvm_size_limit_lbas(__u8 limit, __u32 lba_size)
+{
+	__u64 lbas;
+
+	if (!limit || limit >= 32)
+		return 1 << 16;
+
+	lbas = ((__u64)NVME_LOG_PAGE_PDU_SIZE << limit) / lba_size;
+
+	return max(min(lbas, 1ULL << 16), 1ULL);
+}
+
+static __u8 io_sweep_size_limit(struct nvme_id_ctrl_nvm *ctrl_nvm, __u8 opcode)
+{
+	switch (opcode) {
+	case nvme_cmd_write_zeroes:
+		return ctrl_nvm->wzsl;
+	case nvme_cmd_write_uncor:
+		return ctrl_nvm->wusl;
+	case nvme_cmd_verify:
+		return ctrl_nvm->vsl;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Sweep a Write Zeroes, Write Uncorrectable or Verify over @range in
+ * commands of the largest size the controller accepts, queue_depth of
+ * them in flight on every thread, within the limits of @rate, each command
+ * counting for the bytes it covers. With a @checkpoint file an interrupted
+ * sweep resumes where it stopped.
+ */
+static int io_sweep(struct nvme_dev *dev, const char *name, struct nvme_io_job *job,
+		    const char *range, const struct io_rate_cfg *rate, const char *checkpoint,
+		    enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct io_sweep_job sw = { .checkpoint = checkpoint };
+	_cleanup_file_ int gfd = -1;
+	struct nvme_io_stats stats;
+	__u8 lba_index, limit = 0;
+	char resume[128];
+	__u32 lba_size;
+	int err;
+
+	if (!job->queue_depth || !job->threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
+	}
+
+	if (checkpoint) {
+		err = io_sweep_resume(checkpoint, resume, sizeof(resume));
+		if (err < 0) {
+			nvme_show_error("%s: %s", checkpoint, nvme_strerror(-err));
+			return err;
+		}
+		if (err) {
+			fprintf(stderr, "resuming %s from %s\n", resume, checkpoint);
+			range = resume;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, job->nsid, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	lba_size = 1 << ns->lbaf[lba_index].ds;
+
+	err = parse_lba_range(range, le64_to_cpu(ns->nsze), &job->slba, &job->nr_lbas);
+	if (err) {
+		nvme_show_error("Invalid range %s (namespace size %"PRIu64")",
+				range, (uint64_t)le64_to_cpu(ns->nsze));
+		return err;
+	}
+
+	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
+	if (!ctrl_nvm)
+		return -ENOMEM;
+
+	if (!nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm))
+		limit = io_sweep_size_limit(ctrl_nvm, job->opcode);
+
+	sw.cmd_lbas = nvm_size_limit_lbas(limit, lba_size);
+	job->nlb = 0;
+	/* the slot buffers are unused, keep them small */
+	job->lba_size = lba_size;
+	job->ms = 0;
+	job->nr_ios = (job->nr_lbas + sw.cmd_lbas - 1) / sw.cmd_lbas;
+	err = io_rate_apply(rate, job, sw.cmd_lbas * lba_size);
+	if (err)
+		return err;
+	job->ops = &io_sweep_ops;
+	job->priv = &sw;
+
+	sw.completed = calloc((job->nr_ios + 7) / 8, 1);
+	if (!sw.completed)
+		return -ENOMEM;
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		nvme_show_error("%s --range requires an NVMe namespace: %s", name,
+				nvme_strerror(errno));
+		goto free;
+	}
+	job->fd = gfd;
+
+	pthread_mutex_init(&sw.lock, NULL);
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(job, &stats);
+	nvme_stop_release();
+	pthread_mutex_destroy(&sw.lock);
+	if (err < 0) {
+		nvme_show_error("%s: %s", name, nvme_strerror(-err));
+		goto free;
+	}
+
+	if (checkpoint) {
+		if (sw.next < job->nr_ios)
+			err = io_sweep_checkpoint(job);
+		else if (unlink(checkpoint) && errno != ENOENT)
+			err = -errno;
+		if (err)
+			nvme_show_error("%s: %s", checkpoint, nvme_strerror(-err));
+	}
+
+	io_sweep_merge_errs(&sw);
+	stats.bytes = sw.done * lba_size;
+
+	struct nvme_io_sweep sweep = {
+		.name		= name,
+		.slba		= job->slba,
+		.end		= job->slba + job->nr_lbas,
+		.next_lba	= io_sweep_next_lba(job),
+		.stats		= &stats,
+		.errs		= sw.errs,
+		.nr_errs	= sw.nr_errs,
+	};
+	nvme_show_io_sweep(&sweep, flags);
+
+	err = stats.errors ? -EIO : err;
+free:
+	free(sw.completed);
+	free(sw.errs);
+
+	return err;
+}
+
+static int write_uncor(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "The Write Uncorrectable command is used to set a range of logical blocks to invalid.";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u64	start_block;
+		__u16	block_count;
+		__u8	dtype;
+		__u16	dspec;
+		char	*range;
+		__u32	queue_depth;
+		__u32	threads;
+		struct io_rate_cfg	rate;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.start_block	= 0,
+		.block_count	= 0,
+		.dtype			= 0,
+		.dspec			= 0,
+		.range			= NULL,
+		.queue_depth		= 32,
+		.threads		= 1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id, namespace_desired),
+		  OPT_SUFFIX("start-block", 's', &cfg.start_block,  start_block),
+		  OPT_SHRT("block-count",   'c', &cfg.block_count,  block_count),
+		  OPT_BYTE("dir-type",      'T', &cfg.dtype,        dtype),
+		  OPT_SHRT("dir-spec",      'S', &cfg.dspec,        dspec_w_dtype),
+		  OPT_STR("range",          'R', &cfg.range,        sweep_range),
+		  OPT_UINT("queue-depth",   'q', &cfg.queue_depth,  sweep_queue_depth),
+		  OPT_UINT("threads",       'j', &cfg.threads,      sweep_threads),
+		  OPT_IO_RATE(&cfg.rate));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	if (cfg.dtype > 0xf) {
+		nvme_show_error("Invalid directive type, %x",	cfg.dtype);
+		return -EINVAL;
+	}
+
+	if (cfg.range) {
+		struct nvme_io_job job = {
+			.nsid		= cfg.namespace_id,
+			.opcode		= nvme_cmd_write_uncor,
+			.control	= cfg.dtype << 4,
+			.dsmgmt		= cfg.dspec << 16,
+			.queue_depth	= cfg.queue_depth,
+			.threads	= cfg.threads,
+		};
+
+		err = validate_output_format(output_format_val, &flags);
+		if (err < 0) {
+			nvme_show_error("Invalid output format");
+			return err;
+		}
+
+		if (cfg.start_block || cfg.block_count) {
+			nvme_show_error("--range cannot be combined with --start-block or --block-count");
+			return -EINVAL;
+		}
+
+		return io_sweep(dev, "write-uncor", &job, cfg.range, &cfg.rate, NULL, flags);
+	}
+
+	struct nvme_io_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.slba		= cfg.start_block,
+		.nlb		= cfg.block_count,
+		.control	= cfg.dtype << 4,
+		.dspec		= cfg.dspec,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_write_uncorrectable(&args);
+	if (err < 0)
+		nvme_show_error("write uncorrectable: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Write Uncorrectable Success\n");
+
+	return err;
+}
+
+static int invalid_tags(__u64 storage_tag, __u64 ref_tag, __u8 sts, __u8 pif)
+{
+	int result = 0;
+
+	if (sts < 64 && storage_tag >= (1LL << sts)) {
+		nvme_show_error("Storage tag larger than storage tag size");
+		return 1;
+	}
+
+	switch (pif) {
+	case 0:
+		if (ref_tag >= (1LL << (32 - sts)))
+			result = 1;
+		break;
+	case 1:
+		if (sts > 16 && ref_tag >= (1LL << (80 - sts)))
+			result = 1;
+		break;
+	case 2:
+		if (sts > 0 && ref_tag >= (1LL << (48 - sts)))
+			result = 1;
+		break;
+	default:
+		nvme_show_error("Invalid PIF");
+		result = 1;
+		break;
+	}
+
+	if (result)
+		nvme_show_error("Reference tag larger than allowed by PIF");
+
+	return result;
+}
+
+static int write_zeroes(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u8 lba_index, sts = 0, pif = 0;
+	enum nvme_print_flags flags;
+	__u16 control = 0;
+	int err;
+
+	const char *desc =
+	    "The Write Zeroes command is used to set a range of logical blocks to zero.";
+	const char *deac =
+	    "Set DEAC bit, requesting controller to deallocate specified logical blocks";
+	const char *storage_tag_check =
+	    "This bit specifies the Storage Tag field shall be checked as\n"
+	    "part of end-to-end data protection processing";
+
+	struct config {
+		__u32	namespace_id;
+		__u64	start_block;
+		__u16	block_count;
+		__u8	dtype;
+		bool	deac;
+		bool	limited_retry;
+		bool	force_unit_access;
+		__u8	prinfo;
+		__u64	ref_tag;
+		__u16	app_tag_mask;
+		__u16	app_tag;
+		__u64	storage_tag;
+		bool	storage_tag_check;
+		__u16	dspec;
+		char	*range;
+		__u32	queue_depth;
+		__u32	threads;
+		struct io_rate_cfg	rate;
+	};
+
+	struct config cfg = {
+		.namespace_id		= 0,
+		.start_block		= 0,
+		.block_count		= 0,
+		.dtype				= 0,
+		.deac				= false,
+		.limited_retry		= false,
+		.force_unit_access	= false,
+		.prinfo				= 0,
+		.ref_tag			= 0,
+		.app_tag_mask		= 0,
+		.app_tag			= 0,
+		.storage_tag		= 0,
+		.storage_tag_check	= false,
+		.dspec				= 0,
+		.range				= NULL,
+		.queue_depth			= 32,
+		.threads			= 1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_desired),
+		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block),
+		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
+		  OPT_BYTE("dir-type",          'T', &cfg.dtype,             dtype),
+		  OPT_FLAG("deac",              'd', &cfg.deac,              deac),
+		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry),
+		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access),
+		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
+		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
+		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
+		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
+		  OPT_SUFFIX("storage-tag",     'S', &cfg.storage_tag,       storage_tag),
+		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check),
+		  OPT_SHRT("dir-spec",          'D', &cfg.dspec,             dspec_w_dtype),
+		  OPT_STR("range",              'R', &cfg.range,             sweep_range),
+		  OPT_UINT("queue-depth",       'q', &cfg.queue_depth,       sweep_queue_depth),
+		  OPT_UINT("threads",           'j', &cfg.threads,           sweep_threads),
+		  OPT_IO_RATE(&cfg.rate));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.prinfo > 0xf)
+		return -EINVAL;
+
+	if (cfg.dtype > 0xf) {
+		nvme_show_error("Invalid directive type, %x", cfg.dtype);
+		return -EINVAL;
+	}
+
+	control |= (cfg.prinfo << 10);
+	if (cfg.limited_retry)
+		control |= NVME_IO_LR;
+	if (cfg.force_unit_access)
+		control |= NVME_IO_FUA;
+	if (cfg.deac)
+		control |= NVME_IO_DEAC;
+	if (cfg.storage_tag_check)
+		control |= NVME_IO_STC;
+	control |= (cfg.dtype << 4);
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
+		nvme_show_status(err);
+		return err;
+	}
+
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id, 0, NVME_CSI_NVM, nvm_ns);
+	if (!err) {
+		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+		sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
+		pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
+	}
+
+	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
+		return -EINVAL;
+
+	if (cfg.range) {
+		struct nvme_io_job job = {
+			.nsid		= cfg.namespace_id,
+			.opcode		= nvme_cmd_write_zeroes,
+			.control	= control,
+			.dsmgmt		= cfg.dspec << 16,
+			.reftag		= cfg.ref_tag,
+			.apptag		= cfg.app_tag,
+			.appmask	= cfg.app_tag_mask,
+			.storage_tag	= cfg.storage_tag,
+			.sts		= sts,
+			.pif		= pif,
+			.queue_depth	= cfg.queue_depth,
+			.threads	= cfg.threads,
+		};
+
+		err = validate_output_format(output_format_val, &flags);
+		if (err < 0) {
+			nvme_show_error("Invalid output format");
+			return err;
+		}
+
+		if (cfg.start_block || cfg.block_count) {
+			nvme_show_error("--range cannot be combined with --start-block or --block-count");
+			return -EINVAL;
+		}
+
+		return io_sweep(dev, "write-zeroes", &job, cfg.range, &cfg.rate, NULL,
+				flags);
+	}
+
+	struct nvme_io_args args = {
+		.args_size	= sizeof(args),
+		.fd			= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.slba		= cfg.start_block,
+		.nlb		= cfg.block_count,
+		.control	= control,
+		.reftag_u64	= cfg.ref_tag,
+		.apptag		= cfg.app_tag,
+		.appmask	= cfg.app_tag_mask,
+		.sts		= sts,
+		.pif		= pif,
+		.storage_tag	= cfg.storage_tag,
+		.dspec		= cfg.dspec,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_write_zeros(&args);
+	if (err < 0)
+		nvme_show_error("write-zeroes: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Write Zeroes Success\n");
+
+	return err;
+}
+
+struct dsm_range_job {
+	__u64 slba;		/* first LBA of the extent */
+	__u64 nr_lbas;		/* LBAs in the extent */
+	__u64 cmd_lbas;		/* LBAs covered by one DSM command */
+	__u32 range_lbas;	/* LBAs per range */
+	__u32 attrs;		/* command dword 11 */
+	__u64 done;		/* LBAs of successful commands */
+};
+
+static __u64 dsm_range_cmd_lbas(struct dsm_range_job *r, __u64 seq)
+{
+	return min(r->cmd_lbas, r->nr_lbas - seq * r->cmd_lbas);
+}
+
+static int dsm_range_prep(struct nvme_io_job *job, unsigned int thread,
+			  __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct dsm_range_job *r = job->priv;
+	struct nvme_dsm_range *dsm = (struct nvme_dsm_range *)(uintptr_t)cmd->addr;
+	__u64 slba = r->slba + seq * r->cmd_lbas;
+	__u64 left = dsm_range_cmd_lbas(r, seq);
+	__u64 addr = cmd->addr;
+	__u32 nr = 0, len;
+
+	for (; left; left -= len, slba += len, nr++) {
+		len = min(left, (__u64)r->range_lbas);
+		dsm[nr].cattr = 0;
+		dsm[nr].nlb = cpu_to_le32(len);
+		dsm[nr].slba = cpu_to_le64(slba);
+	}
+
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_cmd_dsm;
+	cmd->nsid = job->nsid;
+	cmd->addr = addr;
+	cmd->data_len = nr * sizeof(*dsm);
+	cmd->cdw10 = nr - 1;
+	cmd->cdw11 = r->attrs;
+
+	return 0;
+}
+
+static void dsm_range_complete(struct nvme_io_job *job, unsigned int thread,
+			       __u64 seq, void *buf, int status, __u64 result,
+			       __u64 lat_ns)
+{
+	struct dsm_range_job *r = job->priv;
+
+	if (!status)
+		__atomic_fetch_add(&r->done, dsm_range_cmd_lbas(r, seq),
+				   __ATOMIC_RELAXED);
+}
+
+static const struct nvme_io_job_ops dsm_range_ops = {
+	.prep		= dsm_range_prep,
+	.complete	= dsm_range_complete,
+};
+
+/*
+ * Cover an LBA extent with as few DSM commands as the controller limits
+ * allow and keep queue_depth of them in flight on every thread.
+ */
+static int dsm_range(struct nvme_dev *dev, __u32 nsid, const char *range,
+		     __u32 attrs, unsigned int queue_depth, unsigned int threads,
+		     const struct io_rate_cfg *rate, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_id_ctrl_nvm *ctrl_nvm = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct dsm_range_job r = { .attrs = attrs };
+	struct nvme_io_stats stats;
+	__u32 nr_ranges = 256, lba_size;
+	__u64 dmsl = 0;
+	_cleanup_file_ int gfd = -1;
+	__u8 lba_index;
+	int err;
+
+	if (!queue_depth || !threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, nsid, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	lba_size = 1 << ns->lbaf[lba_index].ds;
+
+	err = parse_lba_range(range, le64_to_cpu(ns->nsze), &r.slba, &r.nr_lbas);
+	if (err) {
+		nvme_show_error("Invalid range %s (namespace size %"PRIu64")",
+				range, (uint64_t)le64_to_cpu(ns->nsze));
+		return err;
+	}
+
+	r.range_lbas = UINT32_MAX;
+	ctrl_nvm = nvme_alloc(sizeof(*ctrl_nvm));
+	if (!ctrl_nvm)
+		return -ENOMEM;
+
+	/* the limits are optional, the command set defaults apply without them */
+	if (!nvme_nvm_identify_ctrl(dev_fd(dev), ctrl_nvm)) {
+		if (ctrl_nvm->dmrl)
+			nr_ranges = min(nr_ranges, (__u32)ctrl_nvm->dmrl);
+		if (le32_to_cpu(ctrl_nvm->dmrsl))
+			r.range_lbas = le32_to_cpu(ctrl_nvm->dmrsl);
+		dmsl = le64_to_cpu(ctrl_nvm->dmsl);
+	}
+
+	r.cmd_lbas = (__u64)nr_ranges * r.range_lbas;
+	if (dmsl && dmsl < r.cmd_lbas)
+		r.cmd_lbas = dmsl;
+
+	struct nvme_io_job job = {
+		.nsid		= nsid,
+		.opcode		= nvme_cmd_dsm,
+		.slba		= r.slba,
+		.nr_lbas	= r.nr_lbas,
+		.nlb		= 0,
+		/* one slot buffer holds the 256 ranges DSM allows */
+		.lba_size	= 256 * sizeof(struct nvme_dsm_range),
+		.queue_depth	= queue_depth,
+		.threads	= threads,
+		.nr_ios		= (r.nr_lbas + r.cmd_lbas - 1) / r.cmd_lbas,
+		.ops		= &dsm_range_ops,
+		.priv		= &r,
+	};
+
+	/* a command counts for the bytes it deallocates */
+	err = io_rate_apply(rate, &job, r.cmd_lbas * lba_size);
+	if (err)
+		return err;
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		nvme_show_error("dsm --range requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
+	}
+	job.fd = gfd;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	if (err < 0) {
+		nvme_show_error("data-set management: %s", nvme_strerror(-err));
+		return err;
+	}
+
+	/* report the throughput in deallocated bytes, not range list bytes */
+	stats.bytes = r.done * lba_size;
+	nvme_show_io_stats("dsm", &stats, flags);
+
+	return stats.errors ? -EIO : 0;
+}
+
+static int dsm(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "The Dataset Management command is used by the host to\n"
+		"indicate attributes for ranges of logical blocks. This includes attributes\n"
+		"for discarding unused blocks, data read and write frequency, access size, and other\n"
+		"information that may be used to optimize performance and reliability.";
+	const char *blocks = "Comma separated list of the number of blocks in each range";
+	const char *starting_blocks = "Comma separated list of the starting block in each range";
+	const char *context_attrs = "Comma separated list of the context attributes in each range";
+	const char *ad = "Attribute Deallocate";
+	const char *idw = "Attribute Integral Dataset for Write";
+	const char *idr = "Attribute Integral Dataset for Read";
+	const char *cdw11 = "All the command DWORD 11 attributes. Use instead of specifying individual attributes";
+	const char *range = "LBA extent <start>:<end> (end exclusive, empty or 'all' for the\n"
+		"end of the namespace) split into as few DSM commands as the controller allows";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_dsm_range *dsm = NULL;
+	enum nvme_print_flags flags;
+	uint16_t nr, nc, nb, ns;
+	__u32 ctx_attrs[256] = {0,};
+	__u32 nlbs[256] = {0,};
+	__u64 slbas[256] = {0,};
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		char	*ctx_attrs;
+		char	*blocks;
+		char	*slbas;
+		bool	ad;
+		bool	idw;
+		bool	idr;
+		__u32	cdw11;
+		char	*range;
+		__u32	queue_depth;
+		__u32	threads;
+		struct io_rate_cfg	rate;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.ctx_attrs	= "",
+		.blocks		= "",
+		.slbas		= "",
+		.ad		= false,
+		.idw		= false,
+		.idr		= false,
+		.cdw11		= 0,
+		.range		= NULL,
+		.queue_depth	= 32,
+		.threads	= 1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_LIST("ctx-attrs",    'a', &cfg.ctx_attrs,    context_attrs),
+		  OPT_LIST("blocks",       'b', &cfg.blocks,       blocks),
+		  OPT_LIST("slbs",         's', &cfg.slbas,        starting_blocks),
+		  OPT_FLAG("ad",           'd', &cfg.ad,           ad),
+		  OPT_FLAG("idw",          'w', &cfg.idw,          idw),
+		  OPT_FLAG("idr",          'r', &cfg.idr,          idr),
+		  OPT_UINT("cdw11",        'c', &cfg.cdw11,        cdw11),
+		  OPT_STR("range",         'R', &cfg.range,        range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  sweep_queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      sweep_threads),
+		  OPT_IO_RATE(&cfg.rate));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.range) {
+		err = validate_output_format(output_format_val, &flags);
+		if (err < 0) {
+			nvme_show_error("Invalid output format");
+			return err;
+		}
+
+		if (strlen(cfg.slbas) || strlen(cfg.blocks) || strlen(cfg.ctx_attrs)) {
+			nvme_show_error("--range cannot be combined with range lists");
+			return -EINVAL;
+		}
+
+		if (!cfg.namespace_id) {
+			err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+			if (err < 0) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return err;
+			}
+		}
+
+		if (!cfg.cdw11)
+			cfg.cdw11 = (cfg.ad << 2) | (cfg.idw << 1) | (cfg.idr << 0);
+		if (!cfg.cdw11) {
+			nvme_show_error("--range needs an attribute, e.g. --ad");
+			return -EINVAL;
+		}
+
+		return dsm_range(dev, cfg.namespace_id, cfg.range, cfg.cdw11,
+				 cfg.queue_depth, cfg.threads, &cfg.rate, flags);
+	}
+
+	nc = argconfig_parse_comma_sep_array_u32(cfg.ctx_attrs, ctx_attrs, ARRAY_SIZE(ctx_attrs));
+	nb = argconfig_parse_comma_sep_array_u32(cfg.blocks, nlbs, ARRAY_SIZE(nlbs));
+	ns = argconfig_parse_comma_sep_array_u64(cfg.slbas, slbas, ARRAY_SIZE(slbas));
+	nr = max(nc, max(nb, ns));
+	if (!nr || nr > 256) {
+		nvme_show_error("No range definition provided");
+		return -EINVAL;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+	if (!cfg.cdw11)
+		cfg.cdw11 = (cfg.ad << 2) | (cfg.idw << 1) | (cfg.idr << 0);
+
+	dsm = nvme_alloc(sizeof(*dsm) * 256);
+	if (!dsm)
+		return -ENOMEM;
+
+	nvme_init_dsm_range(dsm, ctx_attrs, nlbs, slbas, nr);
+	struct nvme_dsm_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.attrs		= cfg.cdw11,
+		.nr_ranges	= nr,
+		.dsm		= dsm,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_dsm(&args);
+	if (err < 0)
+		nvme_show_error("data-set management: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVMe DSM: success\n");
+
+	return err;
+}
+
+/* trailer behind the range descriptors of a batched copy command */
+struct copy_batch_cmd {
+	__u64 sdlba;
+	__u64 nr_lbas;
+};
+
+#define COPY_BATCH_DESC_LEN						\
+	(256 * max(sizeof(struct nvme_copy_range),			\
+		   sizeof(struct nvme_copy_range_f1)))
+
+static struct copy_batch_cmd *copy_batch_trailer(void *buf)
+{
+	return (struct copy_batch_cmd *)((char *)buf + COPY_BATCH_DESC_LEN);
+}
+
+struct copy_batch_job {
+	pthread_mutex_t lock;
+	FILE *f;
+	const char *name;
+	unsigned long line;
+	int err;
+
+	/* remainder of the current descriptor line */
+	__u64 slba;
+	__u64 dlba;
+	__u64 left;
+
+	/* limits from Identify Namespace */
+	unsigned int max_ranges;
+	__u32 max_range_lbas;
+	__u64 max_cmd_lbas;
+
+	__u8 format;
+	__u32 cdw12;
+	__u32 cdw13;
+	__u32 cdw15;
+
+	__u32 lba_size;
+	__u64 start_ns;
+	__u64 next_report_ns;
+	__u64 done;		/* LBAs of successful commands */
+};
+
+/*
+ * Read the next "<slba> <nlb> <dlba>" descriptor, skipping blank lines and
+ * '#' comments. Returns 1 on a descriptor, 0 at the end of the file or a
+ * negative errno.
+ */
+static int copy_batch_read(struct copy_batch_job *b)
+{
+	_cleanup_free_ char *line = NULL;
+	unsigned long long slba, nlb, dlba;
+	size_t size = 0;
+	char *p;
+
+	while (getline(&line, &size, b->f) >= 0) {
+		b->line++;
+		p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || !*p)
+			continue;
+
+		if (sscanf(p, "%lli%*[ \t,]%lli%*[ \t,]%lli", &slba, &nlb, &dlba) != 3 ||
+		    !nlb) {
+			nvme_show_error("%s:%lu: expected <slba> <nlb> <dlba>",
+					b->name, b->line);
+			return -EINVAL;
+		}
+
+		b->slba = slba;
+		b->left = nlb;
+		b->dlba = dlba;
+		return 1;
+	}
+
+	if (ferror(b->f))
+		return -EIO;
+
+	return 0;
+}
+
+/*
+ * Pack descriptors into one Copy command. Consecutive descriptors share a
+ * command as long as their destinations are contiguous and the range
+ * count and length limits of the namespace are not exceeded.
+ */
+static int copy_batch_fill(struct copy_batch_job *b, void *buf, __u32 *nr)
+{
+	struct nvme_copy_range *f0 = buf;
+	struct nvme_copy_range_f1 *f1 = buf;
+	struct copy_batch_cmd *c = copy_batch_trailer(buf);
+	__u64 len;
+	int err;
+
+	*nr = 0;
+	c->nr_lbas = 0;
+	while (*nr < b->max_ranges && c->nr_lbas < b->max_cmd_lbas) {
+		if (!b->left) {
+			err = copy_batch_read(b);
+			if (err <= 0) {
+				if (err < 0)
+					return err;
+				break;
+			}
+		}
+
+		if (!*nr)
+			c->sdlba = b->dlba;
+		else if (b->dlba != c->sdlba + c->nr_lbas)
+			break;
+
+		len = min(b->left, (__u64)b->max_range_lbas);
+		len = min(len, b->max_cmd_lbas - c->nr_lbas);
+		if (b->format == 1) {
+			memset(&f1[*nr], 0, sizeof(*f1));
+			f1[*nr].slba = cpu_to_le64(b->slba);
+			f1[*nr].nlb = cpu_to_le16(len - 1);
+		} else {
+			memset(&f0[*nr], 0, sizeof(*f0));
+			f0[*nr].slba = cpu_to_le64(b->slba);
+			f0[*nr].nlb = cpu_to_le16(len - 1);
+		}
+
+		(*nr)++;
+		c->nr_lbas += len;
+		b->slba += len;
+		b->dlba += len;
+		b->left -= len;
+	}
+
+	return 0;
+}
+
+static int copy_batch_prep(struct nvme_io_job *job, unsigned int thread,
+			   __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct copy_batch_job *b = job->priv;
+	void *buf = (void *)(uintptr_t)cmd->addr;
+	struct copy_batch_cmd *c;
+	__u32 nr;
+	int err;
+
+	pthread_mutex_lock(&b->lock);
+	err = b->err;
+	if (!err)
+		err = b->err = copy_batch_fill(b, buf, &nr);
+	pthread_mutex_unlock(&b->lock);
+	if (err)
+		return err;
+	if (!nr)
+		return 1;
+
+	c = copy_batch_trailer(buf);
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opcode = nvme_cmd_copy;
+	cmd->nsid = job->nsid;
+	cmd->addr = (__u64)(uintptr_t)buf;
+	cmd->data_len = nr * (b->format == 1 ? sizeof(struct nvme_copy_range_f1) :
+					       sizeof(struct nvme_copy_range));
+	cmd->cdw10 = c->sdlba & 0xffffffff;
+	cmd->cdw11 = c->sdlba >> 32;
+	cmd->cdw12 = (nr - 1) | b->cdw12;
+	cmd->cdw13 = b->cdw13;
+	cmd->cdw15 = b->cdw15;
+
+	return 0;
+}
+
+static void copy_batch_complete(struct nvme_io_job *job, unsigned int thread,
+				__u64 seq, void *buf, int status, __u64 result,
+				__u64 lat_ns)
+{
+	struct copy_batch_job *b = job->priv;
+	struct copy_batch_cmd *c;
+	__u64 done, now;
+	double secs;
+
+	c = copy_batch_trailer(buf);
+	if (status) {
+		nvme_show_error("copy to %"PRIu64" (%"PRIu64" blocks) failed: %s",
+				(uint64_t)c->sdlba, (uint64_t)c->nr_lbas,
+				status < 0 ? nvme_strerror(-status) :
+					     nvme_status_to_string(status, false));
+		return;
+	}
+
+	done = __atomic_add_fetch(&b->done, c->nr_lbas, __ATOMIC_RELAXED);
+
+	/* only the first worker reports, there is no lock around the timer */
+	if (thread || !b->next_report_ns)
+		return;
+
+	now = monotonic_ns();
+	if (now < b->next_report_ns)
+		return;
+
+	b->next_report_ns = now + NSEC_PER_SEC;
+	secs = (now - b->start_ns) / 1e9;
+	fprintf(stderr, "\rcopied %"PRIu64" MiB, %.2f GB/s",
+		(uint64_t)(done * b->lba_size >> 20),
+		done * b->lba_size / secs / 1e9);
+}
+
+static const struct nvme_io_job_ops copy_batch_ops = {
+	.prep		= copy_batch_prep,
+	.complete	= copy_batch_complete,
+};
+
+/*
+ * Copy the extents listed in @file ("-" for stdin) with as few Copy
+ * commands as MSRC/MSSRL/MCL allow, queue_depth of them in flight on
+ * every thread.
+ */
+static int copy_batch(struct nvme_dev *dev, __u32 nsid, const char *file,
+		      struct copy_batch_job *b, unsigned int queue_depth,
+		      unsigned int threads, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_file_ int gfd = -1;
+	struct nvme_io_stats stats;
+	__u8 lba_index;
+	int err;
+
+	if (!queue_depth || !threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, nsid, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	b->lba_size = 1 << ns->lbaf[lba_index].ds;
+	b->max_ranges = ns->msrc + 1;
+	/* a range descriptor holds a 16 bit zeroes based length */
+	b->max_range_lbas = le16_to_cpu(ns->mssrl) ? le16_to_cpu(ns->mssrl) : 1 << 16;
+	b->max_cmd_lbas = le32_to_cpu(ns->mcl) ? le32_to_cpu(ns->mcl) : UINT32_MAX;
+
+	if (!strcmp(file, "-")) {
+		b->f = stdin;
+		b->name = "stdin";
+	} else {
+		b->f = fopen(file, "r");
+		if (!b->f) {
+			err = -errno;
+			nvme_show_perror(file);
+			return err;
+		}
+		b->name = file;
+	}
+
+	struct nvme_io_job job = {
+		.nsid		= nsid,
+		.opcode		= nvme_cmd_copy,
+		.nlb		= 0,
+		/* 256 descriptors followed by struct copy_batch_cmd */
+		.lba_size	= COPY_BATCH_DESC_LEN + sizeof(struct copy_batch_cmd),
+		.queue_depth	= queue_depth,
+		.threads	= threads,
+		/* the end of the descriptor stream stops the job */
+		.nr_ios		= UINT64_MAX,
+		.ops		= &copy_batch_ops,
+		.priv		= b,
+	};
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		nvme_show_error("copy --range-file requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		goto close;
+	}
+	job.fd = gfd;
+
+	pthread_mutex_init(&b->lock, NULL);
+	b->start_ns = monotonic_ns();
+	if (isatty(STDERR_FILENO))
+		b->next_report_ns = b->start_ns + NSEC_PER_SEC;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	pthread_mutex_destroy(&b->lock);
+	if (b->next_report_ns)
+		fprintf(stderr, "\n");
+	if (err < 0) {
+		nvme_show_error("NVMe Copy: %s", nvme_strerror(-err));
+		goto close;
+	}
+
+	/* report the throughput in copied bytes, not descriptor bytes */
+	stats.bytes = b->done * b->lba_size;
+	nvme_show_io_stats("copy", &stats, flags);
+	err = stats.errors ? -EIO : 0;
+
+close:
+	if (b->f != stdin)
+		fclose(b->f);
+
+	return err;
+}
+
+static int copy_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "The Copy command is used by the host to copy data\n"
+		"from one or more source logical block ranges to a\n"
+		"single consecutive destination logical block range.";
+	const char *d_sdlba = "64-bit addr of first destination logical block";
+	const char *d_slbas = "64-bit addr of first block per range (comma-separated list)";
+	const char *d_nlbs = "number of blocks per range (comma-separated list, zeroes-based values)";
+	const char *d_snsids = "source namespace identifier per range (comma-separated list)";
+	const char *d_sopts = "source options per range (comma-separated list)";
+	const char *d_lr = "limited retry";
+	const char *d_fua = "force unit access";
+	const char *d_prinfor = "protection information and check field (read part)";
+	const char *d_prinfow = "protection information and check field (write part)";
+	const char *d_ilbrt = "initial lba reference tag (write part)";
+	const char *d_eilbrts = "expected lba reference tags (read part, comma-separated list)";
+	const char *d_lbat = "lba application tag (write part)";
+	const char *d_elbats = "expected lba application tags (read part, comma-separated list)";
+	const char *d_lbatm = "lba application tag mask (write part)";
+	const char *d_elbatms = "expected lba application tag masks (read part, comma-separated list)";
+	const char *d_dtype = "directive type (write part)";
+	const char *d_dspec = "directive specific (write part)";
+	const char *d_format = "source range entry format";
+	const char *d_range_file = "file with one \"<slba> <nlb> <dlba>\" extent per line, '-' for stdin";
+	const char *d_queue_depth = "copy commands in flight per thread for --range-file";
+	const char *d_threads = "number of submission threads for --range-file";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	__u16 nr, nb, ns, nrts, natms, nats, nids;
+	__u16 nlbs[256] = { 0 };
+	__u64 slbas[256] = { 0 };
+	__u32 snsids[256] = { 0 };
+	__u16 sopts[256] = { 0 };
+	int err;
+
+	union {
+		__u32 short_pi[256];
+		__u64 long_pi[256];
+	} eilbrts;
+
+	__u32 elbatms[256] = { 0 };
+	__u32 elbats[256] = { 0 };
+
+	union {
+		struct nvme_copy_range f0[256];
+		struct nvme_copy_range_f1 f1[256];
+		struct nvme_copy_range_f2 f2[256];
+		struct nvme_copy_range_f3 f3[256];
+	} *copy;
+
+	struct config {
+		__u32	namespace_id;
+		__u64	sdlba;
+		char	*slbas;
+		char	*nlbs;
+		char	*snsids;
+		char	*sopts;
+		bool	lr;
+		bool	fua;
+		__u8	prinfow;
+		__u8	prinfor;
+		__u64	ilbrt;
+		char	*eilbrts;
+		__u16	lbat;
+		char	*elbats;
+		__u16	lbatm;
+		char	*elbatms;
+		__u8	dtype;
+		__u16	dspec;
+		__u8	format;
+		char	*range_file;
+		__u32	queue_depth;
+		__u32	threads;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.sdlba		= 0,
+		.slbas		= "",
+		.nlbs		= "",
+		.snsids		= "",
+		.sopts		= "",
+		.lr		= false,
+		.fua		= false,
+		.prinfow	= 0,
+		.prinfor	= 0,
+		.ilbrt		= 0,
+		.eilbrts	= "",
+		.lbat		= 0,
+		.elbats		= "",
+		.lbatm		= 0,
+		.elbatms	= "",
+		.dtype		= 0,
+		.dspec		= 0,
+		.format		= 0,
+		.range_file	= NULL,
+		.queue_depth	= 8,
+		.threads	= 1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",           'n', &cfg.namespace_id,	namespace_id_desired),
+		  OPT_SUFFIX("sdlba",                'd', &cfg.sdlba,		d_sdlba),
+		  OPT_LIST("slbs",                   's', &cfg.slbas,		d_slbas),
+		  OPT_LIST("blocks",                 'b', &cfg.nlbs,		d_nlbs),
+		  OPT_LIST("snsids",                 'N', &cfg.snsids,		d_snsids),
+		  OPT_LIST("sopts",                  'O', &cfg.sopts,		d_sopts),
+		  OPT_FLAG("limited-retry",          'l', &cfg.lr,		d_lr),
+		  OPT_FLAG("force-unit-access",      'f', &cfg.fua,		d_fua),
+		  OPT_BYTE("prinfow",                'p', &cfg.prinfow,		d_prinfow),
+		  OPT_BYTE("prinfor",                'P', &cfg.prinfor,		d_prinfor),
+		  OPT_SUFFIX("ref-tag",              'r', &cfg.ilbrt,		d_ilbrt),
+		  OPT_LIST("expected-ref-tags",      'R', &cfg.eilbrts,		d_eilbrts),
+		  OPT_SHRT("app-tag",                'a', &cfg.lbat,		d_lbat),
+		  OPT_LIST("expected-app-tags",      'A', &cfg.elbats,		d_elbats),
+		  OPT_SHRT("app-tag-mask",           'm', &cfg.lbatm,		d_lbatm),
+		  OPT_LIST("expected-app-tag-masks", 'M', &cfg.elbatms,		d_elbatms),
+		  OPT_BYTE("dir-type",               'T', &cfg.dtype,		d_dtype),
+		  OPT_SHRT("dir-spec",               'S', &cfg.dspec,		d_dspec),
+		  OPT_BYTE("format",                 'F', &cfg.format,		d_format),
+		  OPT_FILE("range-file",             'i', &cfg.range_file,	d_range_file),
+		  OPT_UINT("queue-depth",            'q', &cfg.queue_depth,	d_queue_depth),
+		  OPT_UINT("threads",                'j', &cfg.threads,		d_threads));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (cfg.range_file) {
+		enum nvme_print_flags flags;
+		struct copy_batch_job batch = {
+			.format	= cfg.format,
+			.cdw12	= (cfg.format << 8) | ((cfg.prinfor & 0xf) << 12) |
+				  ((cfg.dtype & 0xf) << 20) | ((cfg.prinfow & 0xf) << 26) |
+				  (cfg.fua << 30) | ((__u32)cfg.lr << 31),
+			.cdw13	= cfg.dspec << 16,
+			.cdw15	= (cfg.lbatm << 16) | cfg.lbat,
+		};
+
+		err = validate_output_format(output_format_val, &flags);
+		if (err < 0) {
+			nvme_show_error("Invalid output format");
+			return err;
+		}
+
+		if (cfg.format > 1) {
+			nvme_show_error("--range-file supports formats 0 and 1");
+			return -EINVAL;
+		}
+
+		if (strlen(cfg.slbas) || strlen(cfg.nlbs) || strlen(cfg.snsids) ||
+		    strlen(cfg.sopts) || strlen(cfg.eilbrts) || strlen(cfg.elbats) ||
+		    strlen(cfg.elbatms) || cfg.ilbrt) {
+			nvme_show_error("--range-file cannot be combined with range lists or reference tags");
+			return -EINVAL;
+		}
+
+		if (!cfg.namespace_id) {
+			err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+			if (err < 0) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return err;
+			}
+		}
+
+		return copy_batch(dev, cfg.namespace_id, cfg.range_file, &batch,
+				  cfg.queue_depth, cfg.threads, flags);
+	}
+
+	nb = argconfig_parse_comma_sep_array_u16(cfg.nlbs, nlbs, ARRAY_SIZE(nlbs));
+	ns = argconfig_parse_comma_sep_array_u64(cfg.slbas, slbas, ARRAY_SIZE(slbas));
+	nids = argconfig_parse_comma_sep_array_u32(cfg.snsids, snsids, ARRAY_SIZE(snsids));
+	argconfig_parse_comma_sep_array_u16(cfg.sopts, sopts, ARRAY_SIZE(sopts));
+
+	if (cfg.format == 0 || cfg.format == 2) {
+		nrts = argconfig_parse_comma_sep_array_u32(cfg.eilbrts, eilbrts.short_pi,
+							   ARRAY_SIZE(eilbrts.short_pi));
+	} else if (cfg.format == 1 || cfg.format == 3) {
+		nrts = argconfig_parse_comma_sep_array_u64(cfg.eilbrts, eilbrts.long_pi,
+							   ARRAY_SIZE(eilbrts.long_pi));
+	} else {
+		nvme_show_error("invalid format");
+		return -EINVAL;
+	}
+
+	natms = argconfig_parse_comma_sep_array_u32(cfg.elbatms, elbatms, ARRAY_SIZE(elbatms));
+	nats = argconfig_parse_comma_sep_array_u32(cfg.elbats, elbats, ARRAY_SIZE(elbats));
+
+	nr = max(nb, max(ns, max(nrts, max(natms, nats))));
+	if (cfg.format == 2 || cfg.format == 3) {
+		if (nr != nids) {
+			nvme_show_error("formats 2 and 3 require source namespace ids for each source range");
+			return -EINVAL;
+		}
+	} else if (nids) {
+		nvme_show_error("formats 0 and 1 do not support cross-namespace copy");
+		return -EINVAL;
+	}
+	if (!nr || nr > 256) {
+		nvme_show_error("invalid range");
+		return -EINVAL;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	copy = nvme_alloc(sizeof(*copy));
+	if (!copy)
+		return -ENOMEM;
+
+	if (cfg.format == 0)
+		nvme_init_copy_range(copy->f0, nlbs, slbas, eilbrts.short_pi, elbatms, elbats, nr);
+	else if (cfg.format == 1)
+		nvme_init_copy_range_f1(copy->f1, nlbs, slbas, eilbrts.long_pi, elbatms, elbats, nr);
+	else if (cfg.format == 2)
+		nvme_init_copy_range_f2(copy->f2, snsids, nlbs, slbas, sopts, eilbrts.short_pi, elbatms,
+					elbats, nr);
+	else if (cfg.format == 3)
+		nvme_init_copy_range_f3(copy->f3, snsids, nlbs, slbas, sopts, eilbrts.long_pi, elbatms,
+					elbats, nr);
+
+	struct nvme_copy_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.copy		= copy->f0,
+		.sdlba		= cfg.sdlba,
+		.nr		= nr,
+		.prinfor	= cfg.prinfor,
+		.prinfow	= cfg.prinfow,
+		.dtype		= cfg.dtype,
+		.dspec		= cfg.dspec,
+		.format		= cfg.format,
+		.lr		= cfg.lr,
+		.fua		= cfg.fua,
+		.ilbrt_u64	= cfg.ilbrt,
+		.lbatm		= cfg.lbatm,
+		.lbat		= cfg.lbat,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_copy(&args);
+	if (err < 0)
+		nvme_show_error("NVMe Copy: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVMe Copy: success\n");
+
+	return err;
+}
+
+static int flush_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Commit data and metadata associated with\n"
+		"given namespaces to nonvolatile media. Applies to all commands\n"
+		"finished before the flush was submitted. Additional data may also be\n"
+		"flushed by the controller, from any namespace, depending on controller and\n"
+		"associated namespace status.";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	err = nvme_flush(dev_fd(dev), cfg.namespace_id);
+	if (err < 0)
+		nvme_show_error("flush: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVMe Flush: success\n");
+
+	return err;
+}
+
+static int resv_acquire(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Obtain a reservation on a given\n"
+		"namespace. Only one reservation is allowed at a time on a\n"
+		"given namespace, though multiple controllers may register\n"
+		"with that namespace. Namespace reservation will abort with\n"
+		"status Reservation Conflict if the given namespace is already reserved.";
+	const char *prkey = "pre-empt reservation key";
+	const char *racqa = "reservation acquire action";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u64	crkey;
+		__u64	prkey;
+		__u8	rtype;
+		__u8	racqa;
+		bool	iekey;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.crkey		= 0,
+		.prkey		= 0,
+		.rtype		= 0,
+		.racqa		= 0,
+		.iekey		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
+		  OPT_SUFFIX("prkey",      'p', &cfg.prkey,        prkey),
+		  OPT_BYTE("rtype",        't', &cfg.rtype,        rtype),
+		  OPT_BYTE("racqa",        'a', &cfg.racqa,        racqa),
+		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+	if (cfg.racqa > 7) {
+		nvme_show_error("invalid racqa:%d", cfg.racqa);
+		return -EINVAL;
+	}
+
+	struct nvme_resv_acquire_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.rtype		= cfg.rtype,
+		.racqa		= cfg.racqa,
+		.iekey		= !!cfg.iekey,
+		.crkey		= cfg.crkey,
+		.nrkey		= cfg.prkey,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_resv_acquire(&args);
+	if (err < 0)
+		nvme_show_error("reservation acquire: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Reservation Acquire success\n");
+
+	return err;
+}
+
+static int resv_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Register, de-register, or\n"
+		"replace a controller's reservation on a given namespace.\n"
+		"Only one reservation at a time is allowed on any namespace.";
+	const char *nrkey = "new reservation key";
+	const char *rrega = "reservation registration action";
+	const char *cptpl = "change persistence through power loss setting";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u64	crkey;
+		__u64	nrkey;
+		__u8	rrega;
+		__u8	cptpl;
+		bool	iekey;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.crkey		= 0,
+		.nrkey		= 0,
+		.rrega		= 0,
+		.cptpl		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
+		  OPT_SUFFIX("nrkey",      'k', &cfg.nrkey,        nrkey),
+		  OPT_BYTE("rrega",        'r', &cfg.rrega,        rrega),
+		  OPT_BYTE("cptpl",        'p', &cfg.cptpl,        cptpl),
+		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+	if (cfg.cptpl > 3) {
+		nvme_show_error("invalid cptpl:%d", cfg.cptpl);
+		return -EINVAL;
+	}
+
+	if (cfg.rrega > 7) {
+		nvme_show_error("invalid rrega:%d", cfg.rrega);
+		return -EINVAL;
+	}
+
+	struct nvme_resv_register_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.rrega		= cfg.rrega,
+		.cptpl		= cfg.cptpl,
+		.iekey		= !!cfg.iekey,
+		.crkey		= cfg.crkey,
+		.nrkey		= cfg.nrkey,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_resv_register(&args);
+	if (err < 0)
+		nvme_show_error("reservation register: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Reservation  success\n");
+
+	return err;
+}
+
+static int resv_release(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Releases reservation held on a\n"
+		"namespace by the given controller. If rtype != current reservation\n"
+		"type, release will fails. If the given controller holds no\n"
+		"reservation on the namespace or is not the namespace's current\n"
+		"reservation holder, the release command completes with no\n"
+		"effect. If the reservation type is not Write Exclusive or\n"
+		"Exclusive Access, all registrants on the namespace except\n"
+		"the issuing controller are notified.";
+	const char *rrela = "reservation release action";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
+
+	struct config {
+		__u32	namespace_id;
+		__u64	crkey;
+		__u8	rtype;
+		__u8	rrela;
+		__u8	iekey;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.crkey		= 0,
+		.rtype		= 0,
+		.rrela		= 0,
+		.iekey		= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
+		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
+		  OPT_BYTE("rtype",        't', &cfg.rtype,        rtype),
+		  OPT_BYTE("rrela",        'a', &cfg.rrela,        rrela),
+		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+	if (cfg.rrela > 7) {
+		nvme_show_error("invalid rrela:%d", cfg.rrela);
+		return -EINVAL;
+	}
+
+	struct nvme_resv_release_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.rtype		= cfg.rtype,
+		.rrela		= cfg.rrela,
+		.iekey		= !!cfg.iekey,
+		.crkey		= cfg.crkey,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
+	};
+	err = nvme_resv_release(&args);
+	if (err < 0)
+		nvme_show_error("reservation release: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Reservation Release success\n");
+
+	return err;
+}
+
+/*
+ * Read the header first and then exactly as many registrants as it
+ * reports, again if more registered in the meantime.
+ */
+static int resv_report_auto(struct nvme_dev *dev, __u32 nsid, bool eds,
+			    struct nvme_resv_status **statusp, int *sizep)
+{
+	/* the header and a registrant have the same size in each format */
+	int entry = eds ? 64 : 24;
+	struct nvme_resv_status *status;
+	int size = entry, need, tries, err;
+
+	for (tries = 0; ; tries++) {
+		status = nvme_alloc(size);
+		if (!status) {
+			errno = ENOMEM;
+			return -ENOMEM;
+		}
+
+		struct nvme_resv_report_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(dev),
+			.nsid		= nsid,
+			.eds		= eds,
+			.len		= size,
+			.report		= status,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_resv_report(&args);
+		if (err) {
+			free(status);
+			return err;
+		}
+
+		need = ((status->regctl[0] | (status->regctl[1] << 8)) + 1) * entry;
+		if (need <= size || tries == 2)
+			break;
+		free(status);
+		size = need;
+	}
+
+	*statusp = status;
+	*sizep = size;
+	return 0;
+}
+
+enum resv_batch_action {
+	RESV_BATCH_REGISTER,
+	RESV_BATCH_ACQUIRE,
+	RESV_BATCH_RELEASE,
+};
+
+static const char *const resv_batch_actions[] = {
+	[RESV_BATCH_REGISTER]	= "register",
+	[RESV_BATCH_ACQUIRE]	= "acquire",
+	[RESV_BATCH_RELEASE]	= "release",
+};
+
+/* the command every namespace of a resv-batch gets */
+struct resv_batch_params {
+	int fd;
+	enum resv_batch_action action;
+	__u64 crkey;
+	__u64 nrkey;		/* new key to register or key to preempt */
+	__u8 rtype;
+	__u8 ract;		/* rrega, racqa or rrela */
+	__u8 cptpl;
+	bool iekey;
+};
+
+struct resv_batch_work {
+	const struct resv_batch_params *p;
+	struct nvme_resv_batch_ns *ns;
+};
+
+static void resv_batch_work_fn(void *arg)
+{
+	struct resv_batch_work *w = arg;
+	const struct resv_batch_params *p = w->p;
+	__u64 start_ns = monotonic_ns();
+	int err = -1;
+
+	switch (p->action) {
+	case RESV_BATCH_REGISTER: {
+		struct nvme_resv_register_args args = {
+			.args_size	= sizeof(args),
+			.fd		= p->fd,
+			.nsid		= w->ns->nsid,
+			.rrega		= p->ract,
+			.cptpl		= p->cptpl,
+			.iekey		= p->iekey,
+			.crkey		= p->crkey,
+			.nrkey		= p->nrkey,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_resv_register(&args);
+		break;
+	}
+	case RESV_BATCH_ACQUIRE: {
+		struct nvme_resv_acquire_args args = {
+			.args_size	= sizeof(args),
+			.fd		= p->fd,
+			.nsid		= w->ns->nsid,
+			.rtype		= p->rtype,
+			.racqa		= p->ract,
+			.iekey		= p->iekey,
+			.crkey		= p->crkey,
+			.nrkey		= p->nrkey,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_resv_acquire(&args);
+		break;
+	}
+	case RESV_BATCH_RELEASE: {
+		struct nvme_resv_release_args args = {
+			.args_size	= sizeof(args),
+			.fd		= p->fd,
+			.nsid		= w->ns->nsid,
+			.rtype		= p->rtype,
+			.rrela		= p->ract,
+			.iekey		= p->iekey,
+			.crkey		= p->crkey,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_resv_release(&args);
+		break;
+	}
+	}
+
+	w->ns->err = err < 0 ? -errno : err;
+	w->ns->elapsed_ns = monotonic_ns() - start_ns;
+}
+
+/* the IDs of the namespaces attached to the controller, in ascending order */
+static int active_nsids(struct nvme_dev *dev, __u32 **nsidsp, int *nrp)
+{
+	_cleanup_free_ struct nvme_ns_list *ns_list = NULL;
+	__u32 *nsids = NULL, *tmp, nsid = 0;
+	int i, nr = 0, err;
+
+	ns_list = nvme_alloc(sizeof(*ns_list));
+	if (!ns_list)
+		return -ENOMEM;
+
+	/* the list holds the first 1024 namespaces above @nsid */
+	do {
+		err = nvme_cli_identify_active_ns_list(dev, nsid, ns_list);
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				nvme_show_error("identify namespace list: %s",
+						nvme_strerror(errno));
+			free(nsids);
+			return err;
+		}
+
+		for (i = 0; i < 1024 && ns_list->ns[i]; i++) {
+			tmp = realloc(nsids, (nr + 1) * sizeof(*nsids));
+			if (!tmp) {
+				free(nsids);
+				return -ENOMEM;
+			}
+			nsids = tmp;
+			nsid = le32_to_cpu(ns_list->ns[i]);
+			nsids[nr++] = nsid;
+		}
+	} while (i == 1024);
+
+	*nsidsp = nsids;
+	*nrp = nr;
+	return 0;
+}
+
+/* resv-report --all-namespaces: the attached namespaces of the controller */
+static int resv_report_all(struct nvme_dev *dev, bool eds, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct nvme_resv_ns *list = NULL;
+	_cleanup_free_ __u32 *nsids = NULL;
+	int i, nr, err;
+
+	err = active_nsids(dev, &nsids, &nr);
+	if (err)
+		return err;
+
+	list = calloc(nr ? nr : 1, sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		list[i].nsid = nsids[i];
+		list[i].eds = eds;
+		err = resv_report_auto(dev, nsids[i], eds, &list[i].status,
+				       &list[i].bytes);
+		list[i].err = err < 0 ? -errno : err;
+	}
+
+	nvme_show_resv_table(list, nr, flags);
+
+	for (i = 0; i < nr; i++)
+		free(list[i].status);
+	return 0;
+}
+
+/*
+ * resv-batch: one reservation command for each of a list of namespaces,
+ * sent concurrently through the same controller, for cluster failover.
+ */
+static int resv_batch(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Register, acquire or release the reservations of many\n"
+		"namespaces at once, the commands running concurrently.";
+	const char *action = "register, acquire or release";
+	const char *nsids = "comma separated list of namespace IDs";
+	const char *all = "every namespace attached to the controller";
+	const char *nrkey = "new reservation key (register) or pre-empt key (acquire)";
+	const char *ract = "the rrega, racqa or rrela of the action";
+	const char *cptpl = "change persistence through power loss setting (register)";
+	const char *jobs = "number of commands in flight (default: 64)";
+
+	_cleanup_free_ struct nvme_resv_batch_ns *list = NULL;
+	_cleanup_free_ struct resv_batch_work *works = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ __u32 *ids = NULL;
+	struct resv_batch_params p = { 0 };
+	struct nvme_thread_pool *pool;
+	struct nvme_resv_batch b = { 0 };
+	enum nvme_print_flags flags;
+	int i, nr = 0, err;
+	__u64 start_ns;
+	size_t a;
+
+	struct config {
+		char	*action;
+		char	*nsids;
+		bool	all;
+		__u64	crkey;
+		__u64	nrkey;
+		__u8	rtype;
+		__u8	ract;
+		__u8	cptpl;
+		bool	iekey;
+		__u32	jobs;
+	};
+
+	struct config cfg = {
+		.action		= NULL,
+		.nsids		= "",
+		.all		= false,
+		.crkey		= 0,
+		.nrkey		= 0,
+		.rtype		= 0,
+		.ract		= 0,
+		.cptpl		= 0,
+		.iekey		= false,
+		.jobs		= 64,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_STRING("action",       'A', "ACTION", &cfg.action, action),
+		  OPT_LIST("namespace-ids",  'n', &cfg.nsids,  nsids),
+		  OPT_FLAG("all-namespaces", 'N', &cfg.all,    all),
+		  OPT_SUFFIX("crkey",        'c', &cfg.crkey,  crkey),
+		  OPT_SUFFIX("nrkey",        'k', &cfg.nrkey,  nrkey),
+		  OPT_BYTE("rtype",          't', &cfg.rtype,  rtype),
+		  OPT_BYTE("ract",           'a', &cfg.ract,   ract),
+		  OPT_BYTE("cptpl",          'p', &cfg.cptpl,  cptpl),
+		  OPT_FLAG("iekey",          'i', &cfg.iekey,  iekey),
+		  OPT_UINT("jobs",           'j', &cfg.jobs,   jobs));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	for (a = 0; a < ARRAY_SIZE(resv_batch_actions); a++)
+		if (cfg.action && !strcmp(cfg.action, resv_batch_actions[a]))
+			break;
+	if (a == ARRAY_SIZE(resv_batch_actions)) {
+		nvme_show_error("--action must be register, acquire or release");
+		return -EINVAL;
+	}
+	p.action = a;
+
+	if (cfg.ract > 7) {
+		nvme_show_error("invalid ract:%d", cfg.ract);
+		return -EINVAL;
+	}
+	if (cfg.cptpl > 3) {
+		nvme_show_error("invalid cptpl:%d", cfg.cptpl);
+		return -EINVAL;
+	}
+
+	if (cfg.all == !!strlen(cfg.nsids)) {
+		nvme_show_error("give either --namespace-ids or --all-namespaces");
+		return -EINVAL;
+	}
+
+	if (cfg.all) {
+		err = active_nsids(dev, &ids, &nr);
+		if (err)
+			return err;
+	} else {
+		ids = calloc(1024, sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+		nr = argconfig_parse_comma_sep_array_u32(cfg.nsids, ids, 1024);
+		if (nr <= 0) {
+			nvme_show_error("invalid namespace list: %s", cfg.nsids);
+			return -EINVAL;
+		}
+	}
+
+	list = calloc(nr ? nr : 1, sizeof(*list));
+	works = calloc(nr ? nr : 1, sizeof(*works));
+	if (!list || !works)
+		return -ENOMEM;
+
+	p.fd = dev_fd(dev);
+	p.crkey = cfg.crkey;
+	p.nrkey = cfg.nrkey;
+	p.rtype = cfg.rtype;
+	p.ract = cfg.ract;
+	p.cptpl = cfg.cptpl;
+	p.iekey = cfg.iekey;
+
+	if (!cfg.jobs || cfg.jobs > (__u32)nr)
+		cfg.jobs = max(nr, 1);
+
+	start_ns = monotonic_ns();
+	pool = nr > 1 ? nvme_thread_pool_create(cfg.jobs) : NULL;
+	for (i = 0; i < nr; i++) {
+		list[i].nsid = ids[i];
+		works[i] = (struct resv_batch_work) { .p = &p, .ns = &list[i] };
+		if (!pool || nvme_thread_pool_queue(pool, resv_batch_work_fn, &works[i]))
+			resv_batch_work_fn(&works[i]);
+	}
+	nvme_thread_pool_destroy(pool);
+
+	b.name = dev->name;
+	b.action = resv_batch_actions[p.action];
+	b.jobs = pool ? cfg.jobs : 1;
+	b.ns = list;
+	b.nr_ns = nr;
+	b.elapsed_ns = monotonic_ns() - start_ns;
+	nvme_show_resv_batch(&b, flags);
+
+	for (i = 0; i < nr; i++)
+		if (list[i].err)
+			return list[i].err;
+
+	return 0;
+}
+
+static int resv_report(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Returns Reservation Status data\n"
+		"structure describing any existing reservations on and the\n"
+		"status of a given namespace. Namespace Reservation Status\n"
+		"depends on the number of controllers registered for that namespace.";
+	const char *numd = "number of dwords to transfer";
+	const char *eds = "request extended data structure";
+	const char *autosize = "size the buffer for all registrants, instead of --numd";
+	const char *compact = "show one line per registrant";
+	const char *all = "report every namespace attached to the controller, implies --auto and --compact";
+
+	_cleanup_free_ struct nvme_resv_status *status = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err, size;
+
+	struct config {
+		__u32	namespace_id;
+		__u32	numd;
+		__u8	eds;
+		bool	raw_binary;
+		bool	autosize;
+		bool	compact;
+		bool	all;
+	};
+
+	struct config cfg = {
+		.namespace_id	= 0,
+		.numd		= 0,
+		.eds		= false,
+		.raw_binary	= false,
+		.autosize	= false,
+		.compact	= false,
+		.all		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
+		  OPT_UINT("numd",           'd', &cfg.numd,           numd),
+		  OPT_FLAG("eds",            'e', &cfg.eds,            eds),
+		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_dump),
+		  OPT_FLAG("auto",           'a', &cfg.autosize,       autosize),
+		  OPT_FLAG("compact",        'c', &cfg.compact,        compact),
+		  OPT_FLAG("all-namespaces", 'A', &cfg.all,            all));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (cfg.all) {
+		if (cfg.namespace_id) {
+			nvme_show_error("--all-namespaces conflicts with --namespace-id");
+			return -EINVAL;
+		}
+		cfg.autosize = cfg.compact = true;
+	}
+	if (cfg.autosize && cfg.numd) {
+		nvme_show_error("--auto conflicts with --numd");
+		return -EINVAL;
+	}
+
+	if (cfg.raw_binary)
+		flags = BINARY;
+
+	if (cfg.compact && flags == BINARY) {
+		nvme_show_error("--compact needs a text or json output format");
+		return -EINVAL;
+	}
+
+	if (cfg.all)
+		return resv_report_all(dev, cfg.eds, flags);
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	if (cfg.autosize) {
+		err = resv_report_auto(dev, cfg.namespace_id, cfg.eds, &status, &size);
+	} else {
+		if (!cfg.numd || cfg.numd >= (0x1000 >> 2))
+			cfg.numd = (0x1000 >> 2) - 1;
+		if (cfg.numd < 3)
+			cfg.numd = 3;
+
+		size = (cfg.numd + 1) << 2;
+
+		status = nvme_alloc(size);
+		if (!status)
+			return -ENOMEM;
+
+		struct nvme_resv_report_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(dev),
+			.nsid		= cfg.namespace_id,
+			.eds		= cfg.eds,
+			.len		= size,
+			.report		= status,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_resv_report(&args);
+	}
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err) {
+		nvme_show_error("reservation report: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	if (cfg.compact) {
+		struct nvme_resv_ns ns = {
+			.nsid	= cfg.namespace_id,
+			.bytes	= size,
+			.eds	= cfg.eds,
+			.status	= status,
+		};
+
+		nvme_show_resv_table(&ns, 1, flags);
+	} else {
+		nvme_show_resv_report(status, size, cfg.eds, flags);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_JSONC
+/* the supported features, current and saved, in FID order */
+static int config_snapshot_features(struct nvme_dev *dev, struct json_object *snap,
+				    bool save)
+{
+	_cleanup_free_ struct feat_entry *e = NULL;
+	struct nvme_snapshot_feature f;
+	struct feat_entry *saved;
+	struct feat_cfg cfg = {
+		.namespace_id	= NVME_NSID_ALL,
+	};
+	int i, nr, err;
+
+	if (nvme_get_nsid(dev_fd(dev), &cfg.namespace_id) < 0)
+		cfg.namespace_id = NVME_NSID_ALL;
+
+	/* the current values, followed by the saved ones */
+	e = calloc(2 * NVME_LOG_FID_SUPPORTED_EFFECTS_MAX, sizeof(*e));
+	if (!e)
+		return -ENOMEM;
+
+	nr = feat_sweep_ids(dev, cfg, e);
+	if (nr < 0)
+		return nr;
+
+	saved = &e[nr];
+	for (i = 0; save && i < nr; i++) {
+		saved[i].cfg = e[i].cfg;
+		saved[i].cfg.sel = NVME_GET_FEATURES_SEL_SAVED;
+	}
+
+	err = feat_sweep(dev, e, save ? 2 * nr : nr, false);
+
+	for (i = 0; !err && i < nr; i++) {
+		if (e[i].err < 0) {
+			nvme_show_error("get-feature:%#04x: %s", e[i].cfg.feature_id,
+					nvme_strerror(e[i].errnum));
+			err = e[i].err;
+			break;
+		}
+		/* the unsupported ones fail */
+		if (e[i].err || nvme_snapshot_volatile_feature(e[i].cfg.feature_id))
+			continue;
+
+		f = (struct nvme_snapshot_feature) {
+			.fid		= e[i].cfg.feature_id,
+			.current	= e[i].result,
+			.data		= e[i].buf,
+			.data_len	= e[i].cfg.data_len,
+			.saved_valid	= save && !saved[i].err,
+			.saved		= saved[i].result,
+			.saved_data	= saved[i].buf,
+		};
+		nvme_snapshot_add_feature(snap, &f);
+	}
+
+	for (i = 0; i < (save ? 2 * nr : nr); i++)
+		free(e[i].buf);
+
+	return err;
+}
+
+static int config_snapshot_ns(struct nvme_dev *dev, struct json_object *snap)
+{
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_free_ __u32 *nsids = NULL;
+	int i, nr, err;
+
+	err = active_nsids(dev, &nsids, &nr);
+	if (err)
+		return err;
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		err = nvme_cli_identify_ns(dev, nsids[i], ns);
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+			return err;
+		}
+		nvme_snapshot_add_ns(snap, nsids[i], ns);
+	}
+
+	return 0;
+}
+
+static int config_snapshot_json(struct nvme_dev *dev, bool no_namespaces)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	struct json_object *snap;
+	int err;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	snap = nvme_snapshot_new(ctrl);
+
+	err = config_snapshot_features(dev, snap,
+				       le16_to_cpu(ctrl->oncs) & NVME_CTRL_ONCS_SAVE_FEATURES);
+	if (!err && !no_namespaces)
+		err = config_snapshot_ns(dev, snap);
+	if (!err) {
+		util_json_print_object(snap);
+		util_json_print_newline();
+	}
+	json_free_object(snap);
+
+	return err;
+}
+
+static int config_diff_files(char **files, const char *ignore, bool json)
+{
+	struct json_object *snap[2] = { NULL, NULL };
+	int i, err = 0;
+
+	for (i = 0; i < 2 && !err; i++) {
+		err = nvme_snapshot_load(files[i], &snap[i]);
+		if (err)
+			nvme_show_error("%s: %s", files[i],
+					err == -EINVAL ? "not a configuration snapshot" :
+					nvme_strerror(-err));
+	}
+
+	/* like diff(1), the exit status tells whether they differ */
+	if (!err)
+		err = nvme_snapshot_diff(snap[0], snap[1], ignore, json) ? 1 : 0;
+
+	json_free_object(snap[0]);
+	json_free_object(snap[1]);
+
+	return err;
+}
+#endif
+
+static int config_snapshot(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Capture the configuration of a controller: its supported\n"
+		"features, current and saved, the power state table, the namespace\n"
+		"layouts and the key identify fields, as one canonical document.\n"
+		"Written as compact JSON, pretty with -o json and as CBOR with\n"
+		"-o cbor or -o binary. Compare two of them with config-diff.";
+	const char *no_ns = "leave out the namespaces";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		bool	no_namespaces;
+	};
+
+	struct config cfg = {
+		.no_namespaces	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("no-namespaces", 'N', &cfg.no_namespaces, no_ns));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+#ifdef CONFIG_JSONC
+	if (flags == BINARY)
+		json_set_output_mode(JSON_OUTPUT_CBOR);
+	else if (flags == NORMAL || json_get_output_mode() == JSON_OUTPUT_NDJSON)
+		json_set_output_mode(JSON_OUTPUT_COMPACT);
+
+	return config_snapshot_json(dev, cfg.no_namespaces);
+#else
+	nvme_show_error("config-snapshot: built without json-c support");
+	return -ENOTSUP;
+#endif
+}
+
+static int config_diff(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Compare two snapshots of config-snapshot member by member and\n"
+		"print every value that differs as \"path: old -> new\". The\n"
+		"namespaces are matched by NSID and the power states by number.\n"
+		"Exits with 1 if the snapshots differ.";
+	const char *ignore = "comma separated members to skip, e.g. identity,features.0x06";
+
+	enum nvme_print_flags flags;
+	int err;
+
+	struct config {
+		char	*ignore;
+	};
+
+	struct config cfg = {
+		.ignore	= NULL,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_LIST("ignore", 'i', &cfg.ignore, ignore));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (argc - optind != 2) {
+		nvme_show_error("two snapshots are required");
+		argconfig_print_help(desc, opts);
+		return -EINVAL;
+	}
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_JSONC
+	return config_diff_files(&argv[optind], cfg.ignore, flags == JSON);
+#else
+	nvme_show_error("config-diff: built without json-c support");
+	return -ENOTSUP;
+#endif
+}
+
+static int io_build_control(__u8 prinfo, bool limited_retry, bool fua, bool stc,
+			    __u8 dtype, __u16 dspec, __u8 dsm_attr, __u16 *control,
+			    __u32 *dsmgmt)
+{
+	*dsmgmt = dsm_attr;
+	*control = prinfo << 10;
+	if (limited_retry)
+		*control |= NVME_IO_LR;
+	if (fua)
+		*control |= NVME_IO_FUA;
+	if (stc)
+		*control |= NVME_IO_STC;
+	if (dtype) {
+		if (dtype > 0xf) {
+			nvme_show_error("Invalid directive type, %x", dtype);
+			return -EINVAL;
+		}
+		*control |= dtype << 4;
+		*dsmgmt |= ((__u32)dspec) << 16;
+	}
+
+	return 0;
+}
+
+unsigned long long elapsed_utime(struct timeval start_time,
+					struct timeval end_time)
+{
+	unsigned long long err = (end_time.tv_sec - start_time.tv_sec) * 1000000 +
+		(end_time.tv_usec - start_time.tv_usec);
+	return err;
+}
+
+/*
+ * Describe the protection information format of the namespace for
+ * generating and checking it on the host.
+ */
+static int io_host_pi_init(struct nvme_id_ns *ns, __u8 lba_index, __u8 pif,
+			   __u8 sts, __u8 prinfo, struct nvme_pi *pi)
+{
+	if (!(ns->dps & 0x7)) {
+		nvme_show_error("namespace is not formatted with protection information");
+		return -EINVAL;
+	}
+
+	if (prinfo & 0x8) {
+		nvme_show_error("--host-pi can't be combined with PRACT");
+		return -EINVAL;
+	}
+
+	memset(pi, 0, sizeof(*pi));
+	pi->pif = pif;
+	pi->type = ns->dps & 0x7;
+	pi->sts = sts;
+	pi->pi_first = ns->dps & 0x8;
+	pi->extended = NVME_FLBAS_META_EXT(ns->flbas);
+	pi->lba_size = 1 << ns->lbaf[lba_index].ds;
+	pi->ms = ns->lbaf[lba_index].ms;
+	pi->check_guard = true;
+	pi->check_reftag = true;
+
+	if (nvme_pi_check(pi)) {
+		nvme_show_error("unsupported protection information format (pif %u, %u bytes metadata)",
+				pif, pi->ms);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int io_host_pi_verify(const struct nvme_pi *pi, const char *command,
+			     __u64 slba, const void *data, const void *meta,
+			     __u64 first, __u64 nr)
+{
+	struct nvme_pi_err e;
+
+	if (!nvme_pi_verify(pi, data, meta, first, nr, &e))
+		return 0;
+
+	nvme_show_error("%s: lba %"PRIu64": %s mismatch, expected %#"PRIx64", got %#"PRIx64,
+			command, (uint64_t)(slba + first + e.block), e.field,
+			(uint64_t)e.expected, (uint64_t)e.actual);
+	return -EILSEQ;
+}
+
+/*
+ * Split the transfer into commands of at most the controller's MDTS and
+ * overlap reading or writing the data and metadata files with the device
+ * commands, so memory use is bounded by a few command sized buffers.
+ */
+static int submit_io_stream(int opcode, char *command, struct nvme_dev *dev,
+			    struct nvme_io_args *tmpl, int dfd, int mfd,
+			    __u64 nr_blocks, unsigned int lba_size, unsigned int ms,
+			    const struct nvme_pi *pi, bool latency,
+			    enum nvme_print_flags flags)
+{
+	_cleanup_free_ void *pi_meta = NULL;
+	enum nvme_stream_dir dir = (opcode & 1) ? NVME_STREAM_FROM_FILE : NVME_STREAM_TO_FILE;
+	struct nvme_stream data_stream, meta_stream;
+	_cleanup_free_ struct nvme_hist *lat = NULL;
+	struct nvme_io_args args = *tmpl;
+	__u64 done = 0, start_ns, cmd_ns, elapsed_ns;
+	__u32 max_xfer, chunk_blocks;
+	size_t len, mlen = 0;
+	void *data, *meta = NULL;
+	int err, serr, pierr = 0;
+
+	err = get_max_xfer_len(dev, &max_xfer);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("identify controller: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	chunk_blocks = min(max_xfer / lba_size, 0x10000U);
+	if (!chunk_blocks) {
+		nvme_show_error("logical block size %u exceeds the maximum transfer size %u",
+				lba_size, max_xfer);
+		return -EINVAL;
+	}
+
+	lat = malloc(sizeof(*lat));
+	if (!lat)
+		return -ENOMEM;
+	nvme_hist_init(lat);
+
+	/* separate metadata that isn't streamed still needs room for the PI */
+	if (pi && !pi->extended && !ms) {
+		pi_meta = calloc(chunk_blocks, pi->ms);
+		if (!pi_meta)
+			return -ENOMEM;
+	}
+
+	err = nvme_stream_init(&data_stream, dfd, dir, nr_blocks * lba_size,
+			       (size_t)chunk_blocks * lba_size, 2);
+	if (err) {
+		nvme_show_error("stream: %s", nvme_strerror(-err));
+		return err;
+	}
+
+	if (ms) {
+		err = nvme_stream_init(&meta_stream, mfd, dir, nr_blocks * ms,
+				       (size_t)chunk_blocks * ms, 2);
+		if (err) {
+			nvme_stream_finish(&data_stream, true);
+			nvme_show_error("stream: %s", nvme_strerror(-err));
+			return err;
+		}
+	}
+
+	start_ns = monotonic_ns();
+	while ((data = nvme_stream_get(&data_stream, &len))) {
+		if (ms) {
+			meta = nvme_stream_get(&meta_stream, &mlen);
+			if (!meta)
+				break;
+		}
+
+		if (pi_meta) {
+			meta = pi_meta;
+			mlen = len / lba_size * pi->ms;
+		}
+
+		args.slba = tmpl->slba + done;
+		args.nlb = len / lba_size - 1;
+		args.data = data;
+		args.data_len = len;
+		args.metadata = meta;
+		args.metadata_len = mlen;
+		if (tmpl->control & NVME_IO_PRINFO_PRCHK_REF)
+			args.reftag_u64 = tmpl->reftag_u64 + done;
+
+		if (pi && (opcode & 1))
+			nvme_pi_generate(pi, data, meta, done, len / lba_size);
+
+		cmd_ns = monotonic_ns();
+		err = nvme_io(&args, opcode);
+		nvme_hist_add(lat, monotonic_ns() - cmd_ns);
+
+		if (!err && pi && !(opcode & 1))
+			pierr = io_host_pi_verify(pi, command, tmpl->slba, data,
+						  meta, done, len / lba_size);
+
+		/* a failed read must not reach the writer of the output file */
+		if (err || pierr)
+			break;
+		nvme_stream_put(&data_stream, len);
+		if (ms)
+			nvme_stream_put(&meta_stream, mlen);
+		done += len / lba_size;
+	}
+	elapsed_ns = monotonic_ns() - start_ns;
+
+	serr = nvme_stream_finish(&data_stream, err || pierr);
+	if (ms) {
+		int merr = nvme_stream_finish(&meta_stream, err || pierr);
+
+		if (!serr)
+			serr = merr;
+	}
+
+	if (latency) {
+		nvme_show_latency_hist(command, lat, flags);
+		printf(" %s: %llu blocks in %llu commands, %llu us\n", command,
+		       (unsigned long long)done, (unsigned long long)lat->count,
+		       (unsigned long long)(elapsed_ns / NSEC_PER_USEC));
+	}
+
+	if (err < 0) {
+		nvme_show_error("submit-io: %s", nvme_strerror(errno));
+	} else if (err) {
+		nvme_show_status(err);
+	} else if (serr) {
+		nvme_show_error("%s: %s", (opcode & 1) ? "read" : "write",
+				nvme_strerror(-serr));
+		err = serr;
+	} else if (pierr) {
+		err = pierr;
+	} else {
+		fprintf(stderr, "%s: Success\n", command);
+	}
+
+	return err;
+}
+
+struct io_polled {
+	void *data;
+	__u32 data_len;
+	void *meta;
+	__u32 meta_len;
+	bool read;
+};
+
+static int io_polled_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+			  struct nvme_passthru_cmd64 *cmd)
+{
+	struct io_polled *p = job->priv;
+
+	cmd->metadata = (__u64)(uintptr_t)p->meta;
+	cmd->metadata_len = p->meta_len;
+
+	return 0;
+}
+
+static void io_polled_complete(struct nvme_io_job *job, unsigned int thread,
+			       __u64 seq, void *buf, int status, __u64 result,
+			       __u64 lat_ns)
+{
+	struct io_polled *p = job->priv;
+
+	if (p->read && !status)
+		memcpy(p->data, buf, min(p->data_len, nvme_io_job_data_len(job)));
+}
+
+static const struct nvme_io_job_ops io_polled_ops = {
+	.prep		= io_polled_prep,
+	.complete	= io_polled_complete,
+};
+
+/*
+ * Issue the command @repeat times one after the other through a polled
+ * io_uring on the generic char device, so the latency doesn't include the
+ * completion interrupt and waking up the thread sleeping in the ioctl.
+ * The data goes through the engine's registered buffer, or its buffer in
+ * the CMB with @cmb, the metadata is used in place.
+ */
+static int submit_io_polled(struct nvme_dev *dev, int opcode, struct nvme_io_args *args,
+			    __u32 dsmgmt, unsigned int lba_size, __u32 repeat,
+			    const char *cmb, struct nvme_hist *lat, __u64 *lat_ns)
+{
+	struct io_polled p = {
+		.data		= args->data,
+		.data_len	= args->data_len,
+		.meta		= args->metadata,
+		.meta_len	= args->metadata_len,
+		.read		= !(opcode & 1),
+	};
+	struct nvme_io_job job = {
+		.nsid		= args->nsid,
+		.opcode		= opcode,
+		.slba		= args->slba,
+		.nr_lbas	= args->nlb + 1,
+		.nlb		= args->nlb,
+		.lba_size	= lba_size,
+		.control	= args->control,
+		.dsmgmt		= dsmgmt,
+		.reftag		= args->reftag_u64,
+		.apptag		= args->apptag,
+		.appmask	= args->appmask,
+		.storage_tag	= args->storage_tag,
+		.sts		= args->sts,
+		.pif		= args->pif,
+		.queue_depth	= 1,
+		.threads	= 1,
+		.nr_ios		= repeat,
+		.poll		= true,
+		.cmb		= cmb,
+		.ops		= &io_polled_ops,
+		.priv		= &p,
+	};
+	_cleanup_file_ int gfd = -1;
+	struct nvme_io_stats stats;
+	int err;
+
+	if (opcode & 1) {
+		job.pattern = args->data;
+		job.pattern_len = min(args->data_len, nvme_io_job_data_len(&job));
+	}
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0)
+		return -1;
+	job.fd = gfd;
+
+	io_poll_check(dev);
+
+	err = nvme_io_engine_run(&job, &stats);
+	if (err == -ENOTSUP) {
+		nvme_show_error("polled passthrough needs Linux 6.1 or later");
+		errno = ENOTSUP;
+		return -1;
+	} else if (err < 0) {
+		if (cmb)
+			nvme_show_error("%s: controller memory buffer: %s",
+					dev->name, nvme_strerror(-err));
+		errno = -err;
+		return -1;
+	}
+
+	if (lat)
+		*lat = stats.lat;
+	*lat_ns = stats.lat.max;
+
+	if (stats.first_err < 0) {
+		errno = -stats.first_err;
+		return -1;
+	}
+
+	return stats.first_err;
+}
+
+/*
+ * The Compare of @args and, if the blocks matched, a Write of @wdata to
+ * them, with the metadata of the Compare unless @wmeta is given. The two
+ * are separate commands, not a fused pair: another host may write the
+ * blocks in between.
+ */
+static int io_compare_write(struct nvme_io_args *args, void *wdata, void *wmeta)
+{
+	struct nvme_io_args w = *args;
+	int err;
+
+	err = nvme_io(args, nvme_cmd_compare);
+	if (err)
+		return err;
+
+	w.data = wdata;
+	if (wmeta)
+		w.metadata = wmeta;
+	return nvme_io(&w, nvme_cmd_write);
+}
+
+static int submit_io(int opcode, char *command, const char *desc, int argc, char **argv,
+		     bool cmp_write)
+{
+	__u64 start_ns = 0, end_ns = 0;
+	void *buffer, *wbuffer = NULL;
+	_cleanup_free_ void *mbuffer = NULL;
+	_cleanup_free_ void *wmbuffer = NULL;
+	_cleanup_free_ struct nvme_hist *lat = NULL;
+	enum nvme_print_flags flags;
+	__u32 i;
+	int err = 0;
+	_cleanup_file_ int dfd = -1, mfd = -1, wfd = -1;
+	int oflags;
+	int mode = 0644;
+	__u16 control = 0, nblocks = 0;
+	__u32 dsmgmt = 0;
+	unsigned int logical_block_size = 0;
+	unsigned long long buffer_size = 0, mbuffer_size = 0;
+	__u64 stream_blocks = 0;
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	_cleanup_huge_ struct nvme_mem_huge wmh = { 0, };
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	__u8 lba_index, ms = 0, sts = 0, pif = 0;
+	struct nvme_pi pi = { 0 };
+
+	const char *start_block_addr = "64-bit addr of first block to access";
+	const char *data_size = "size of data in bytes";
+	const char *metadata_size = "size of metadata in bytes";
+	const char *data = "data file";
+	const char *metadata = "metadata file";
+	const char *limited_retry_num = "limit num. media access attempts";
+	const char *show = "show command before sending";
+	const char *dtype_for_write = "directive type (for write-only)";
+	const char *dspec = "directive specific (for write-only)";
+	const char *dsm = "dataset management attributes (lower 8 bits)";
+	const char *storage_tag_check = "This bit specifies the Storage Tag field shall be\n"
+		"checked as part of end-to-end data protection processing";
+	const char *force = "The \"I know what I'm doing\" flag, do not enforce exclusive access for write";
+	const char *stream = "split the transfer into MDTS sized commands, overlapping file and device I/O";
+	const char *host_pi = "generate the protection information on the host for write and\n"
+		"compare, check it after read";
+	const char *poll = "submit through a polled io_uring on the generic char device\n"
+		"instead of the ioctl, excluding the interrupt from --latency";
+	const char *cmb = "transfer the data through the controller memory buffer";
+	const char *write_data = "data file to write if the Compare matched (compare-write only)";
+	char p2pmem[PATH_MAX];
+
+	struct config {
+		__u32	namespace_id;
+		__u64	start_block;
+		__u16	block_count;
+		__u64	data_size;
+		__u64	metadata_size;
+		__u64	ref_tag;
+		char	*data;
+		char	*metadata;
+		__u8	prinfo;
+		__u16	app_tag_mask;
+		__u16	app_tag;
+		__u64	storage_tag;
+		bool	limited_retry;
+		bool	force_unit_access;
+		bool	storage_tag_check;
+		__u8	dtype;
+		__u16	dspec;
+		__u8	dsmgmt;
+		bool	show;
+		bool	dry_run;
+		bool	latency;
+		bool	force;
+		__u32	repeat;
+		bool	stream;
+		bool	host_pi;
+		bool	poll;
+		bool	cmb;
+		char	*write_data;
+	};
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	struct config cfg = {
+		.namespace_id		= 0,
+		.start_block		= 0,
+		.block_count		= 0,
+		.data_size		= 0,
+		.metadata_size		= 0,
+		.ref_tag		= 0,
+		.data			= "",
+		.metadata		= "",
+		.prinfo			= 0,
+		.app_tag_mask		= 0,
+		.app_tag		= 0,
+		.storage_tag		= 0,
+		.limited_retry		= false,
+		.force_unit_access	= false,
+		.storage_tag_check	= false,
+		.dtype			= 0,
+		.dspec			= 0,
+		.dsmgmt			= 0,
+		.show			= false,
+		.dry_run		= false,
+		.latency		= false,
+		.force			= false,
+		.repeat			= 1,
+		.stream			= false,
+		.host_pi		= false,
+		.poll			= false,
+		.cmb			= false,
+		.write_data		= "",
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_id_desired),
+		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block_addr),
+		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
+		  OPT_SUFFIX("data-size",       'z', &cfg.data_size,         data_size),
+		  OPT_SUFFIX("metadata-size",   'y', &cfg.metadata_size,     metadata_size),
+		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
+		  OPT_FILE("data",              'd', &cfg.data,              data),
+		  OPT_FILE("metadata",          'M', &cfg.metadata,          metadata),
+		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
+		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
+		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
+		  OPT_SUFFIX("storage-tag",     'g', &cfg.storage_tag,       storage_tag),
+		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry_num),
+		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access),
+		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check),
+		  OPT_BYTE("dir-type",          'T', &cfg.dtype,             dtype_for_write),
+		  OPT_SHRT("dir-spec",          'S', &cfg.dspec,             dspec),
+		  OPT_BYTE("dsm",               'D', &cfg.dsmgmt,            dsm),
+		  OPT_FLAG("show-command",      'V', &cfg.show,              show),
+		  OPT_FLAG("dry-run",           'w', &cfg.dry_run,           dry),
+		  OPT_FLAG("latency",           't', &cfg.latency,           latency),
+		  OPT_FLAG("force",               0, &cfg.force,             force),
+		  OPT_UINT("repeat",              0, &cfg.repeat,            repeat),
+		  OPT_FLAG("stream",              0, &cfg.stream,            stream),
+		  OPT_FLAG("host-pi",             0, &cfg.host_pi,           host_pi),
+		  OPT_FLAG("poll",                0, &cfg.poll,              poll),
+		  OPT_FLAG("cmb",                 0, &cfg.cmb,               cmb),
+		  OPT_FILE("write-data",        'W', &cfg.write_data,        write_data));
+
+	if (opcode != nvme_cmd_write && !cmp_write) {
+		err = parse_and_open(&dev, argc, argv, desc, opts);
+		if (err)
+			return err;
+	} else {
+		err = parse_args(argc, argv, desc, opts);
+		if (err)
+			return err;
+		err = open_exclusive(&dev, argc, argv, cfg.force);
+		if (err) {
+			if (errno == EBUSY) {
+				fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
+				fprintf(stderr, "Namespace is currently busy.\n");
+				if (!cfg.force)
+					fprintf(stderr,
+						"Use the force [--force] option to ignore that.\n");
+			} else {
+				argconfig_print_help(desc, opts);
+			}
+			return err;
+		}
+	}
 
 	err = validate_output_format(output_format_val, &flags);
 	if (err < 0) {
@@ -5690,1562 +17739,2036 @@ static int get_register(int argc, char **argv, struct command *cmd, struct plugi
 		return err;
 	}
 
-	if (cfg.human_readable)
-		flags |= VERBOSE;
-
-	bar = mmap_registers(dev, false);
-	if (!bar) {
-		err = get_register_properties(dev_fd(dev), &bar, &cfg);
-		if (err)
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
 			return err;
-		fabrics = true;
-	}
-
-	nvme_show_init();
-
-	if (!get_register_offset(bar, fabrics, &cfg, flags)) {
-		nvme_show_error("offset required param");
-		err = -EINVAL;
+		}
 	}
 
-	nvme_show_finish();
-
-	if (fabrics)
-		free(bar);
-	else
-		munmap(bar, getpagesize());
-
-	return err;
-}
-
-static int nvme_set_single_property(int fd, int offset, uint64_t value)
-{
-	struct nvme_set_property_args args = {
-		.args_size	= sizeof(args),
-		.fd		= fd,
-		.offset		= offset,
-		.value		= value,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
-	};
-	int err = nvme_set_property(&args);
-
-	if (err < 0)
-		nvme_show_error("set-property: %s", nvme_strerror(errno));
-	else if (!err)
-		printf("set-property: %#02x (%s), value: %#"PRIx64"\n", offset,
-		       nvme_register_to_string(offset), value);
-	else if (err > 0)
-		nvme_show_status(err);
+	if (cfg.prinfo > 0xf)
+		return err;
 
-	return err;
-}
+	if (!cfg.repeat)
+		cfg.repeat = 1;
 
-static int set_register_property(int fd, int offset, uint64_t value)
-{
-	if (!nvme_is_fabrics_reg(offset)) {
-		printf("register: %#04x (%s) not fabrics\n", offset,
-		       nvme_register_to_string(offset));
+	if (cfg.stream && cfg.repeat > 1) {
+		nvme_show_error("--repeat can't be combined with --stream");
 		return -EINVAL;
 	}
 
-	return nvme_set_single_property(fd, offset, value);
-}
-
-static int nvme_set_register(int fd, void *bar, int offset, uint64_t value, bool mmio32)
-{
-	if (!bar)
-		return set_register_property(fd, offset, value);
-
-	if (nvme_is_64bit_reg(offset))
-		mmio_write64(bar + offset, value, mmio32);
-	else
-		mmio_write32(bar + offset, value);
-
-	printf("set-register: %#02x (%s), value: %#"PRIx64"\n", offset,
-	       nvme_register_to_string(offset), value);
-
-	return 0;
-}
-
-static inline int set_register_names_check(struct argconfig_commandline_options *opts, int offset)
-{
-	switch (offset) {
-	case NVME_REG_INTMS:
-		if (argconfig_parse_seen(opts, "intms"))
-			return -EINVAL;
-		break;
-	case NVME_REG_INTMC:
-		if (argconfig_parse_seen(opts, "intmc"))
-			return -EINVAL;
-		break;
-	case NVME_REG_CC:
-		if (argconfig_parse_seen(opts, "cc"))
-			return -EINVAL;
-		break;
-	case NVME_REG_CSTS:
-		if (argconfig_parse_seen(opts, "csts"))
-			return -EINVAL;
-		break;
-	case NVME_REG_NSSR:
-		if (argconfig_parse_seen(opts, "nssr"))
-			return -EINVAL;
-		break;
-	case NVME_REG_AQA:
-		if (argconfig_parse_seen(opts, "aqa"))
-			return -EINVAL;
-		break;
-	case NVME_REG_ASQ:
-		if (argconfig_parse_seen(opts, "asq"))
-			return -EINVAL;
-		break;
-	case NVME_REG_ACQ:
-		if (argconfig_parse_seen(opts, "acq"))
-			return -EINVAL;
-		break;
-	case NVME_REG_BPRSEL:
-		if (argconfig_parse_seen(opts, "bprsel"))
-			return -EINVAL;
-		break;
-	case NVME_REG_CMBMSC:
-		if (argconfig_parse_seen(opts, "cmbmsc"))
-			return -EINVAL;
-		break;
-	case NVME_REG_NSSD:
-		if (argconfig_parse_seen(opts, "nssd"))
-			return -EINVAL;
-		break;
-	case NVME_REG_PMRCTL:
-		if (argconfig_parse_seen(opts, "pmrctl"))
-			return -EINVAL;
-		break;
-	case NVME_REG_PMRMSCL:
-		if (argconfig_parse_seen(opts, "pmrmscl"))
-			return -EINVAL;
-		break;
-	case NVME_REG_PMRMSCU:
-		if (argconfig_parse_seen(opts, "pmrmscu"))
-			return -EINVAL;
-		break;
-	default:
-		break;
+	if (cfg.stream && cfg.poll) {
+		nvme_show_error("--poll can't be combined with --stream");
+		return -EINVAL;
 	}
 
-	return 0;
-}
-
-static int set_register_offset(int fd, void *bar, struct argconfig_commandline_options *opts,
-			       struct set_reg_config *cfg)
-{
-	int err;
+	if (cfg.stream && cfg.cmb) {
+		nvme_show_error("--cmb can't be combined with --stream");
+		return -EINVAL;
+	}
 
-	if (!argconfig_parse_seen(opts, "value")) {
-		nvme_show_error("value required param");
+	if (cmp_write && (cfg.stream || cfg.poll || cfg.cmb)) {
+		nvme_show_error("%s can't be combined with --stream, --poll or --cmb", command);
 		return -EINVAL;
 	}
 
-	err = set_register_names_check(opts, cfg->offset);
-	if (err) {
-		nvme_show_error("offset duplicated param");
-		return err;
+	if (cmp_write != !!strlen(cfg.write_data)) {
+		nvme_show_error(cmp_write ? "write data not provided" :
+				"--write-data is for compare-write only");
+		return -EINVAL;
 	}
 
-	err = nvme_set_register(fd, bar, cfg->offset, cfg->value, cfg->mmio32);
+	if (cfg.cmb && cmb_p2pmem(dev, p2pmem, sizeof(p2pmem)))
+		return -errno;
+
+	err = io_build_control(cfg.prinfo, cfg.limited_retry, cfg.force_unit_access,
+			       cfg.storage_tag_check, cfg.dtype, cfg.dspec, cfg.dsmgmt,
+			       &control, &dsmgmt);
 	if (err)
 		return err;
 
-	return 0;
-}
-
-static int set_register_names(int fd, void *bar, struct argconfig_commandline_options *opts,
-			      struct set_reg_config *cfg)
-{
-	int err;
-
-	if (argconfig_parse_seen(opts, "intms")) {
-		err = nvme_set_register(fd, bar, NVME_REG_INTMS, cfg->intms, cfg->mmio32);
-		if (err)
-			return err;
-	}
-
-	if (argconfig_parse_seen(opts, "intmc")) {
-		err = nvme_set_register(fd, bar, NVME_REG_INTMC, cfg->intmc, cfg->mmio32);
-		if (err)
-			return err;
-	}
-
-	if (argconfig_parse_seen(opts, "cc")) {
-		err = nvme_set_register(fd, bar, NVME_REG_CC, cfg->cc, cfg->mmio32);
-		if (err)
-			return err;
+	if (opcode & 1) {
+		dfd = mfd = STDIN_FILENO;
+		oflags = O_RDONLY;
+	} else {
+		dfd = mfd = STDOUT_FILENO;
+		oflags = O_WRONLY | O_CREAT;
 	}
 
-	if (argconfig_parse_seen(opts, "csts")) {
-		err = nvme_set_register(fd, bar, NVME_REG_CSTS, cfg->csts, cfg->mmio32);
-		if (err)
-			return err;
+	if (strlen(cfg.data)) {
+		dfd = open(cfg.data, oflags, mode);
+		if (dfd < 0) {
+			nvme_show_perror(cfg.data);
+			return -EINVAL;
+		}
 	}
 
-	if (argconfig_parse_seen(opts, "nssr")) {
-		err = nvme_set_register(fd, bar, NVME_REG_NSSR, cfg->nssr, cfg->mmio32);
-		if (err)
-			return err;
+	if (strlen(cfg.metadata)) {
+		mfd = open(cfg.metadata, oflags, mode);
+		if (mfd < 0) {
+			nvme_show_perror(cfg.metadata);
+			return -EINVAL;
+		}
 	}
 
-	if (argconfig_parse_seen(opts, "aqa")) {
-		err = nvme_set_register(fd, bar, NVME_REG_AQA, cfg->aqa, cfg->mmio32);
-		if (err)
-			return err;
+	if (cmp_write) {
+		wfd = open(cfg.write_data, O_RDONLY);
+		if (wfd < 0) {
+			nvme_show_perror(cfg.write_data);
+			return -EINVAL;
+		}
 	}
 
-	if (argconfig_parse_seen(opts, "asq")) {
-		err = nvme_set_register(fd, bar, NVME_REG_ASQ, cfg->asq, cfg->mmio32);
-		if (err)
-			return err;
+	if (!cfg.data_size) {
+		nvme_show_error("data size not provided");
+		return -EINVAL;
 	}
 
-	if (argconfig_parse_seen(opts, "acq")) {
-		err = nvme_set_register(fd, bar, NVME_REG_ACQ, cfg->acq, cfg->mmio32);
-		if (err)
-			return err;
-	}
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
 
-	if (argconfig_parse_seen(opts, "bprsel")) {
-		err = nvme_set_register(fd, bar, NVME_REG_BPRSEL, cfg->bprsel, cfg->mmio32);
-		if (err)
-			return err;
+	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
 	}
 
-	if (argconfig_parse_seen(opts, "cmbmsc")) {
-		err = nvme_set_register(fd, bar, NVME_REG_CMBMSC, cfg->cmbmsc, cfg->mmio32);
-		if (err)
-			return err;
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	logical_block_size = 1 << ns->lbaf[lba_index].ds;
+	ms = ns->lbaf[lba_index].ms;
+	if (NVME_FLBAS_META_EXT(ns->flbas)) {
+		/*
+		 * No meta data is transferred for PRACT=1 and MD=8:
+		 *   5.2.2.1 Protection Information and Write Commands
+		 *   5.2.2.2 Protection Information and Read Commands
+		 */
+		if (!((cfg.prinfo & 0x8) != 0 && ms == 8))
+			logical_block_size += ms;
 	}
 
-	if (argconfig_parse_seen(opts, "nssd")) {
-		err = nvme_set_register(fd, bar, NVME_REG_NSSD, cfg->nssd, cfg->mmio32);
-		if (err)
-			return err;
-	}
+	buffer_size = ((long long)cfg.block_count + 1) * logical_block_size;
+	if (cfg.data_size < buffer_size)
+		nvme_show_error("Rounding data size to fit block count (%lld bytes)", buffer_size);
+	else
+		buffer_size = cfg.data_size;
 
-	if (argconfig_parse_seen(opts, "pmrctl")) {
-		err = nvme_set_register(fd, bar, NVME_REG_PMRCTL, cfg->pmrctl, cfg->mmio32);
-		if (err)
-			return err;
-	}
+	if (argconfig_parse_seen(opts, "block-count")) {
+		/* Use the value provided */
+		nblocks = cfg.block_count;
+	} else {
+		/* Get the required block count. Note this is a zeroes based value. */
+		nblocks = ((buffer_size + (logical_block_size - 1)) / logical_block_size) - 1;
 
-	if (argconfig_parse_seen(opts, "pmrmscl")) {
-		err = nvme_set_register(fd, bar, NVME_REG_PMRMSCL, cfg->pmrmscl, cfg->mmio32);
-		if (err)
-			return err;
+		/* Update the data size based on the required block count */
+		buffer_size = ((unsigned long long)nblocks + 1) * logical_block_size;
 	}
 
-	if (argconfig_parse_seen(opts, "pmrmscu")) {
-		err = nvme_set_register(fd, bar, NVME_REG_PMRMSCU, cfg->pmrmscu, cfg->mmio32);
-		if (err)
+	if (cfg.stream) {
+		/* the whole transfer is never buffered, so it isn't limited to 64k blocks */
+		if (argconfig_parse_seen(opts, "block-count"))
+			stream_blocks = (__u64)cfg.block_count + 1;
+		else
+			stream_blocks = (cfg.data_size + logical_block_size - 1) /
+				logical_block_size;
+		buffer = NULL;
+	} else if (cfg.cmb && !cfg.poll) {
+		/* the polled engine has its own buffer in the CMB */
+		buffer = nvme_alloc_cmb(p2pmem, buffer_size, &mh);
+		if (!buffer) {
+			err = -errno;
+			nvme_show_error("%s: controller memory buffer: %s", dev->name,
+					nvme_strerror(errno));
 			return err;
+		}
+	} else {
+		buffer = nvme_alloc_huge(buffer_size, &mh);
+		if (!buffer)
+			return -ENOMEM;
 	}
 
-	return 0;
-}
-
-static int set_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Writes and shows the defined NVMe controller register";
-	const char *value = "the value of the register to be set";
-	const char *mmio32 = "Access 64-bit registers as 2 32-bit";
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	if (cfg.metadata_size || cfg.host_pi) {
+		err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id, 0, NVME_CSI_NVM,
+					   nvm_ns);
+		if (!err) {
+			sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
+			pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
+		}
+	}
 
-	void *bar;
+	if (cfg.metadata_size) {
+		mbuffer_size = ((unsigned long long)cfg.block_count + 1) * ms;
+		if (ms && cfg.metadata_size < mbuffer_size)
+			nvme_show_error("Rounding metadata size to fit block count (%lld bytes)",
+					mbuffer_size);
+		else
+			mbuffer_size = cfg.metadata_size;
 
-	struct set_reg_config cfg = {
-		.offset = -1,
-	};
+		if (!cfg.stream) {
+			mbuffer = malloc(mbuffer_size);
+			if (!mbuffer)
+				return -ENOMEM;
+			memset(mbuffer, 0, mbuffer_size);
+		}
+	} else if (cfg.host_pi && !NVME_FLBAS_META_EXT(ns->flbas) && !cfg.stream) {
+		mbuffer_size = ((unsigned long long)nblocks + 1) * ms;
+		mbuffer = calloc(1, mbuffer_size);
+		if (!mbuffer)
+			return -ENOMEM;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("offset",  'O', &cfg.offset,  offset),
-		  OPT_SUFFIX("value", 'V', &cfg.value,   value),
-		  OPT_FLAG("mmio32",  'm', &cfg.mmio32,  mmio32),
-		  OPT_UINT("intms",     0, &cfg.intms,   intms),
-		  OPT_UINT("intmc",     0, &cfg.intmc,   intmc),
-		  OPT_UINT("cc",        0, &cfg.cc,      cc),
-		  OPT_UINT("csts",      0, &cfg.csts,    csts),
-		  OPT_UINT("nssr",      0, &cfg.nssr,    nssr),
-		  OPT_UINT("aqa",       0, &cfg.aqa,     aqa),
-		  OPT_SUFFIX("asq",     0, &cfg.asq,     asq),
-		  OPT_SUFFIX("acq",     0, &cfg.acq,     acq),
-		  OPT_UINT("bprsel",    0, &cfg.bprsel,  bprsel),
-		  OPT_SUFFIX("bpmbl",   0, &cfg.bpmbl,   bpmbl),
-		  OPT_SUFFIX("cmbmsc",  0, &cfg.cmbmsc,  cmbmsc),
-		  OPT_UINT("nssd",      0, &cfg.nssd,    nssd),
-		  OPT_UINT("pmrctl",    0, &cfg.pmrctl,  pmrctl),
-		  OPT_UINT("pmrmscl",   0, &cfg.pmrmscl, pmrmscl),
-		  OPT_UINT("pmrmscu",   0, &cfg.pmrmscu, pmrmscu));
+	if (cfg.host_pi) {
+		err = io_host_pi_init(ns, lba_index, pif, sts, cfg.prinfo, &pi);
+		if (err)
+			return err;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+		/* the type 1 reference tag is the LBA */
+		if (pi.type == 1 && !argconfig_parse_seen(opts, "ref-tag"))
+			cfg.ref_tag = cfg.start_block & nvme_pi_ref_mask(&pi);
 
-	bar = mmap_registers(dev, true);
+		pi.apptag = cfg.app_tag;
+		pi.appmask = cfg.app_tag_mask;
+		pi.reftag = cfg.ref_tag;
+		pi.storage_tag = cfg.storage_tag;
+		pi.check_storage_tag = cfg.storage_tag_check;
+	}
 
-	if (argconfig_parse_seen(opts, "offset"))
-		err = set_register_offset(dev_fd(dev), bar, opts, &cfg);
+	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
+		return -EINVAL;
 
-	if (!err)
-		err = set_register_names(dev_fd(dev), bar, opts, &cfg);
+	if ((opcode & 1) && !cfg.stream) {
+		err = read(dfd, (void *)buffer, cfg.data_size);
+		if (err < 0) {
+			err = -errno;
+			nvme_show_error("failed to read data buffer from input file %s", strerror(errno));
+			return err;
+		}
+	}
 
-	if (bar)
-		munmap(bar, getpagesize());
+	if ((opcode & 1) && cfg.metadata_size && !cfg.stream) {
+		err = read(mfd, (void *)mbuffer, mbuffer_size);
+		if (err < 0) {
+			err = -errno;
+			nvme_show_error("failed to read meta-data buffer from input file %s", strerror(errno));
+			return err;
+		}
+	}
 
-	return err;
-}
+	if ((opcode & 1) && cfg.host_pi && !cfg.stream)
+		nvme_pi_generate(&pi, buffer, mbuffer, 0, (__u64)nblocks + 1);
 
-static int get_property(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Reads and shows the defined NVMe controller property\n"
-		"for NVMe over Fabric. Property offset must be one of:\n"
-		"CAP=0x0, VS=0x8, CC=0x14, CSTS=0x1c, NSSR=0x20, NSSD=0x64, CRTO=0x68";
-	const char *offset = "offset of the requested property";
-	const char *human_readable = "show property in readable format";
+	/* the Write gets the metadata of the Compare, or PI of its own */
+	if (cmp_write) {
+		wbuffer = nvme_alloc_huge(buffer_size, &wmh);
+		if (!wbuffer)
+			return -ENOMEM;
+		if (read(wfd, wbuffer, buffer_size) < 0) {
+			err = -errno;
+			nvme_show_error("failed to read write data from %s: %s",
+					cfg.write_data, strerror(errno));
+			return err;
+		}
+		if (cfg.host_pi && mbuffer) {
+			wmbuffer = calloc(1, mbuffer_size);
+			if (!wmbuffer)
+				return -ENOMEM;
+		}
+		if (cfg.host_pi)
+			nvme_pi_generate(&pi, wbuffer, wmbuffer, 0, (__u64)nblocks + 1);
+	}
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u64 value;
-	int err;
+	if (cfg.show || cfg.dry_run) {
+		printf("opcode       : %02x\n", opcode);
+		printf("nsid         : %02x\n", cfg.namespace_id);
+		printf("flags        : %02x\n", 0);
+		printf("control      : %04x\n", control);
+		printf("nblocks      : %04x\n", nblocks);
+		printf("metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)mbuffer);
+		printf("addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)buffer);
+		printf("slba         : %"PRIx64"\n", (uint64_t)cfg.start_block);
+		printf("dsmgmt       : %08x\n", dsmgmt);
+		printf("reftag       : %"PRIx64"\n", (uint64_t)cfg.ref_tag);
+		printf("apptag       : %04x\n", cfg.app_tag);
+		printf("appmask      : %04x\n", cfg.app_tag_mask);
+		printf("storagetagcheck : %04x\n", cfg.storage_tag_check);
+		printf("storagetag      : %"PRIx64"\n", (uint64_t)cfg.storage_tag);
+		printf("pif             : %02x\n", pif);
+		printf("sts             : %02x\n", sts);
+	}
+	if (cfg.dry_run)
+		return 0;
 
-	struct get_reg_config cfg = {
-		.offset		= -1,
-		.human_readable	= false,
-		.fabrics	= true,
+	struct nvme_io_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.slba		= cfg.start_block,
+		.nlb		= nblocks,
+		.control	= control,
+		.dsm		= cfg.dsmgmt,
+		.sts		= sts,
+		.pif		= pif,
+		.dspec		= cfg.dspec,
+		.reftag_u64	= cfg.ref_tag,
+		.apptag		= cfg.app_tag,
+		.appmask	= cfg.app_tag_mask,
+		.storage_tag	= cfg.storage_tag,
+		.data_len	= buffer_size,
+		.data		= buffer,
+		.metadata_len	= mbuffer_size,
+		.metadata	= mbuffer,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= NULL,
 	};
 
-	NVME_ARGS(opts,
-		  OPT_UINT("offset",         'O', &cfg.offset,         offset),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable));
-
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	if (cfg.stream)
+		return submit_io_stream(opcode, command, dev, &args, dfd, mfd,
+					stream_blocks, logical_block_size,
+					(cfg.metadata_size && !NVME_FLBAS_META_EXT(ns->flbas)) ? ms : 0,
+					cfg.host_pi ? &pi : NULL, cfg.latency, flags);
 
-	if (cfg.offset == -1) {
-		nvme_show_error("offset required param");
-		return -EINVAL;
+	if (cfg.repeat > 1) {
+		lat = malloc(sizeof(*lat));
+		if (!lat)
+			return -ENOMEM;
+		nvme_hist_init(lat);
 	}
 
-	err = nvme_get_single_property(dev_fd(dev), &cfg, &value);
-	if (!err)
-		nvme_show_single_property(cfg.offset, value, cfg.human_readable);
+	if (cfg.poll) {
+		err = submit_io_polled(dev, opcode, &args, dsmgmt, logical_block_size,
+				       cfg.repeat, cfg.cmb ? p2pmem : NULL, lat, &end_ns);
+	} else {
+		for (i = 0; i < cfg.repeat; i++) {
+			start_ns = monotonic_ns();
+			if (cmp_write)
+				err = io_compare_write(&args, wbuffer, wmbuffer);
+			else
+				err = nvme_io(&args, opcode);
+			end_ns = monotonic_ns();
+			if (lat)
+				nvme_hist_add(lat, end_ns - start_ns);
+			if (err)
+				break;
+		}
+	}
+	if (cfg.latency) {
+		if (lat)
+			nvme_show_latency_hist(command, lat, flags);
+		else
+			printf(" latency: %s: %llu us\n", command,
+			       (unsigned long long)((end_ns - start_ns) / NSEC_PER_USEC));
+	}
+	if (err < 0) {
+		nvme_show_error("submit-io: %s", nvme_strerror(errno));
+	} else if (err) {
+		nvme_show_status(err);
+	} else {
+		if (!(opcode & 1) && write(dfd, (void *)buffer, buffer_size) < 0) {
+			nvme_show_error("write: %s: failed to write buffer to output file",
+				strerror(errno));
+			err = -EINVAL;
+		} else if (!(opcode & 1) && cfg.metadata_size &&
+			   write(mfd, (void *)mbuffer, mbuffer_size) < 0) {
+			nvme_show_error(
+			    "write: %s: failed to write meta-data buffer to output file",
+			    strerror(errno));
+			err = -EINVAL;
+		} else if (!(opcode & 1) && cfg.host_pi) {
+			err = io_host_pi_verify(&pi, command, cfg.start_block, buffer,
+						mbuffer, 0, (__u64)nblocks + 1);
+			if (!err)
+				fprintf(stderr, "%s: Success\n", command);
+		} else {
+			fprintf(stderr, "%s: Success\n", command);
+		}
+	}
 
 	return err;
 }
 
-static int set_property(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int compare(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc =
-	    "Writes and shows the defined NVMe controller property for NVMe over Fabric";
-	const char *offset = "the offset of the property";
-	const char *value = "the value of the property to be set";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	const char *desc = "Compare specified logical blocks on\n"
+		"device with specified data buffer; return failure if buffer\n"
+		"and block(s) are dissimilar";
 
-	struct set_reg_config cfg = {
-		.offset	= -1,
-		.value	= -1,
-	};
+	return submit_io(nvme_cmd_compare, "compare", desc, argc, argv, false);
+}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("offset", 'O', &cfg.offset, offset),
-		  OPT_UINT("value",  'V', &cfg.value,  value));
+static int compare_write(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Compare specified logical blocks on device\n"
+		"with specified data buffer and, if they match, write them with\n"
+		"the write data in a second command, not atomically with the\n"
+		"Compare; return failure if buffer and block(s) are dissimilar";
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	return submit_io(nvme_cmd_compare, "compare-write", desc, argc, argv, true);
+}
 
-	if (cfg.offset == -1) {
-		nvme_show_error("offset required param");
-		return -EINVAL;
-	}
-	if (cfg.value == -1) {
-		nvme_show_error("value required param");
-		return -EINVAL;
-	}
+static int read_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Copy specified logical blocks on the given\n"
+		"device to specified data buffer (default buffer is stdout).";
 
-	return nvme_set_single_property(dev_fd(dev), cfg.offset, cfg.value);
+	return submit_io(nvme_cmd_read, "read", desc, argc, argv, false);
 }
 
-static int format_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int write_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	const char *desc = "Re-format a specified namespace on the\n"
-		"given device. Can erase all data in namespace (user\n"
-		"data erase) or delete data encryption key if specified.\n"
-		"Can also be used to change LBAF to change the namespaces reported physical block format.";
-	const char *lbaf = "LBA format to apply (required)";
-	const char *ses = "[0-2]: secure erase";
-	const char *pil = "[0-1]: protection info location last/first 8 bytes of metadata";
-	const char *pi = "[0-3]: protection info off/Type 1/Type 2/Type 3";
-	const char *ms = "[0-1]: extended format off/on";
-	const char *reset = "Automatically reset the controller after successful format";
-	const char *bs = "target block size";
-	const char *force = "The \"I know what I'm doing\" flag, skip confirmation before sending command";
+	const char *desc = "Copy from provided data buffer (default\n"
+		"buffer is stdin) to specified logical blocks on the given device.";
 
-	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	return submit_io(nvme_cmd_write, "write", desc, argc, argv, false);
+}
+
+static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	__u16 control = 0;
+	__u8 lba_index, sts = 0, pif = 0;
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
 	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u8 prev_lbaf = 0;
-	int block_size;
-	int err, i;
+	_cleanup_free_ struct nvme_hist *lat = NULL;
+	enum nvme_print_flags flags;
+	__u64 start_ns = 0, end_ns = 0;
+	__u32 i;
+	int err;
+
+	const char *desc = "Verify specified logical blocks on the given device.";
+	const char *force_unit_access_verify =
+	    "force device to commit cached data before performing the verify operation";
+	const char *storage_tag_check =
+	    "This bit specifies the Storage Tag field shall be checked as part of Verify operation";
+	const char *checkpoint =
+	    "record the progress of --range in this file and resume from it";
 
 	struct config {
 		__u32	namespace_id;
-		__u32	timeout;
-		__u8	lbaf;
-		__u8	ses;
-		__u8	pi;
-		__u8	pil;
-		__u8	ms;
-		bool	reset;
-		bool	force;
-		__u64	bs;
+		__u64	start_block;
+		__u16	block_count;
+		bool	limited_retry;
+		bool	force_unit_access;
+		__u8	prinfo;
+		__u32	ref_tag;
+		__u16	app_tag;
+		__u16	app_tag_mask;
+		__u64	storage_tag;
+		bool	storage_tag_check;
+		bool	latency;
+		__u32	repeat;
+		char	*range;
+		__u32	queue_depth;
+		__u32	threads;
+		struct io_rate_cfg	rate;
+		char	*checkpoint;
 	};
 
 	struct config cfg = {
-		.namespace_id	= 0,
-		.timeout	= 600000,
-		.lbaf		= 0xff,
-		.ses		= 0,
-		.pi		= 0,
-		.pil		= 0,
-		.ms		= 0,
-		.reset		= false,
-		.force		= false,
-		.bs		= 0,
+		.namespace_id		= 0,
+		.start_block		= 0,
+		.block_count		= 0,
+		.limited_retry		= false,
+		.force_unit_access	= false,
+		.prinfo			= 0,
+		.ref_tag		= 0,
+		.app_tag		= 0,
+		.app_tag_mask		= 0,
+		.storage_tag		= 0,
+		.storage_tag_check	= false,
+		.latency		= false,
+		.repeat			= 1,
+		.range			= NULL,
+		.queue_depth		= 32,
+		.threads		= 1,
+		.checkpoint		= NULL,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
-		  OPT_UINT("timeout",      't', &cfg.timeout,      timeout),
-		  OPT_BYTE("lbaf",         'l', &cfg.lbaf,         lbaf),
-		  OPT_BYTE("ses",          's', &cfg.ses,          ses),
-		  OPT_BYTE("pi",           'i', &cfg.pi,           pi),
-		  OPT_BYTE("pil",          'p', &cfg.pil,          pil),
-		  OPT_BYTE("ms",           'm', &cfg.ms,           ms),
-		  OPT_FLAG("reset",        'r', &cfg.reset,        reset),
-		  OPT_FLAG("force",          0, &cfg.force,        force),
-		  OPT_SUFFIX("block-size", 'b', &cfg.bs,           bs));
+		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_desired),
+		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block),
+		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
+		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry),
+		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access_verify),
+		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
+		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
+		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
+		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
+		  OPT_SUFFIX("storage-tag",     'S', &cfg.storage_tag,       storage_tag),
+		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check),
+		  OPT_FLAG("latency",           't', &cfg.latency,           latency),
+		  OPT_UINT("repeat",              0, &cfg.repeat,            repeat),
+		  OPT_STR("range",              'R', &cfg.range,             sweep_range),
+		  OPT_UINT("queue-depth",       'q', &cfg.queue_depth,       sweep_queue_depth),
+		  OPT_UINT("threads",           'j', &cfg.threads,           sweep_threads),
+		  OPT_IO_RATE(&cfg.rate),
+		  OPT_FILE("checkpoint",        'k', &cfg.checkpoint,        checkpoint));
 
-	err = parse_args(argc, argv, desc, opts);
+	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	err = open_exclusive(&dev, argc, argv, cfg.force);
-	if (err) {
-		if (errno == EBUSY) {
-			fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
-			fprintf(stderr, "Namespace is currently busy.\n");
-			if (!cfg.force)
-				fprintf(stderr, "Use the force [--force] option to ignore that.\n");
-		} else {
-			argconfig_print_help(desc, opts);
-		}
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
 		return err;
 	}
 
-	if (cfg.lbaf != 0xff && cfg.bs != 0) {
-		nvme_show_error(
-		    "Invalid specification of both LBAF and Block Size, please specify only one");
+	if (cfg.prinfo > 0xf)
 		return -EINVAL;
-	}
-	if (cfg.bs) {
-		if ((cfg.bs & (~cfg.bs + 1)) != cfg.bs) {
-			nvme_show_error(
-			    "Invalid value for block size (%"PRIu64"), must be a power of two",
-			    (uint64_t) cfg.bs);
-			return -EINVAL;
-		}
-	}
 
-	ctrl = nvme_alloc(sizeof(*ctrl));
-	if (!ctrl)
-		return -ENOMEM;
+	if (!cfg.repeat)
+		cfg.repeat = 1;
 
-	err = nvme_cli_identify_ctrl(dev, ctrl);
-	if (err) {
-		nvme_show_error("identify-ctrl: %s", nvme_strerror(errno));
-		return -errno;
-	}
+	control |= (cfg.prinfo << 10);
+	if (cfg.limited_retry)
+		control |= NVME_IO_LR;
+	if (cfg.force_unit_access)
+		control |= NVME_IO_FUA;
+	if (cfg.storage_tag_check)
+		control |= NVME_IO_STC;
 
-	if ((ctrl->fna & 1) == 1) {
-		/*
-		 * FNA bit 0 set to 1: all namespaces ... shall be configured with the same
-		 * attributes and a format (excluding secure erase) of any namespace results in a
-		 * format of all namespaces.
-		 */
-		cfg.namespace_id = NVME_NSID_ALL;
-	} else if (!cfg.namespace_id) {
+	if (!cfg.namespace_id) {
 		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return -errno;
-		}
-	}
-
-	if (cfg.namespace_id == 0) {
-		nvme_show_error(
-		    "Invalid namespace ID, specify a namespace to format or use\n"
-		    "'-n 0xffffffff' to format all namespaces on this controller.");
-		return -EINVAL;
-	}
-
-	if (cfg.namespace_id != NVME_NSID_ALL) {
-		ns = nvme_alloc(sizeof(*ns));
-		if (!ns)
-			return -ENOMEM;
-
-		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
-		if (err) {
-			if (err < 0) {
-				nvme_show_error("identify-namespace: %s", nvme_strerror(errno));
-			} else {
-				fprintf(stderr, "identify failed\n");
-				nvme_show_status(err);
-			}
-			return err;
-		}
-		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &prev_lbaf);
-
-		if (cfg.bs) {
-			for (i = 0; i <= ns->nlbaf; ++i) {
-				if ((1ULL << ns->lbaf[i].ds) == cfg.bs && ns->lbaf[i].ms == 0) {
-					cfg.lbaf = i;
-					break;
-				}
-			}
-			if (cfg.lbaf == 0xff) {
-				fprintf(stderr,
-				    "LBAF corresponding to given block size %"PRIu64" not found\n",
-				    (uint64_t)cfg.bs);
-				fprintf(stderr,
-					"Please correct block size, or specify LBAF directly\n");
-				return -EINVAL;
-			}
-		} else  if (cfg.lbaf == 0xff) {
-			cfg.lbaf = prev_lbaf;
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
 		}
-	} else {
-		if (cfg.lbaf == 0xff)
-			cfg.lbaf = 0;
 	}
 
-	/* ses & pi checks set to 7 for forward-compatibility */
-	if (cfg.ses > 7) {
-		nvme_show_error("invalid secure erase settings:%d", cfg.ses);
-		return -EINVAL;
-	}
-	if (cfg.lbaf > 63) {
-		nvme_show_error("invalid lbaf:%d", cfg.lbaf);
-		return -EINVAL;
-	}
-	if (cfg.pi > 7) {
-		nvme_show_error("invalid pi:%d", cfg.pi);
-		return -EINVAL;
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	} else if (err) {
+		nvme_show_status(err);
+		return err;
 	}
-	if (cfg.pil > 1) {
-		nvme_show_error("invalid pil:%d", cfg.pil);
-		return -EINVAL;
+
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id, 0,
+				   NVME_CSI_NVM, nvm_ns);
+	if (!err) {
+		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+		sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
+		pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
 	}
-	if (cfg.ms > 1) {
-		nvme_show_error("invalid ms:%d", cfg.ms);
+
+	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
 		return -EINVAL;
-	}
 
-	if (!cfg.force) {
-		fprintf(stderr, "You are about to format %s, namespace %#x%s.\n",
-			dev->name, cfg.namespace_id,
-			cfg.namespace_id == NVME_NSID_ALL ? "(ALL namespaces)" : "");
-		nvme_show_relatives(dev->name);
-		fprintf(stderr,
-			"WARNING: Format may irrevocably delete this device's data.\n"
-			"You have 10 seconds to press Ctrl-C to cancel this operation.\n\n"
-			"Use the force [--force] option to suppress this warning.\n");
-		sleep(10);
-		fprintf(stderr, "Sending format operation ...\n");
+	if (cfg.checkpoint && !cfg.range)
+		cfg.range = "all";
+
+	if (cfg.range) {
+		struct nvme_io_job job = {
+			.nsid		= cfg.namespace_id,
+			.opcode		= nvme_cmd_verify,
+			.control	= control,
+			.reftag		= cfg.ref_tag,
+			.apptag		= cfg.app_tag,
+			.appmask	= cfg.app_tag_mask,
+			.storage_tag	= cfg.storage_tag,
+			.sts		= sts,
+			.pif		= pif,
+			.queue_depth	= cfg.queue_depth,
+			.threads	= cfg.threads,
+		};
+
+		if (cfg.start_block || cfg.block_count) {
+			nvme_show_error("--range cannot be combined with --start-block or --block-count");
+			return -EINVAL;
+		}
+
+		return io_sweep(dev, "verify", &job, cfg.range, &cfg.rate, cfg.checkpoint,
+				flags);
 	}
 
-	struct nvme_format_nvm_args args = {
+	struct nvme_io_args args = {
 		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
 		.nsid		= cfg.namespace_id,
-		.lbafu		= (cfg.lbaf & NVME_NS_FLBAS_HIGHER_MASK) >> 4,
-		.lbaf		= cfg.lbaf & NVME_NS_FLBAS_LOWER_MASK,
-		.mset		= cfg.ms,
-		.pi		= cfg.pi,
-		.pil		= cfg.pil,
-		.ses		= cfg.ses,
-		.timeout	= cfg.timeout,
+		.slba		= cfg.start_block,
+		.nlb		= cfg.block_count,
+		.control	= control,
+		.reftag_u64	= cfg.ref_tag,
+		.apptag		= cfg.app_tag,
+		.appmask	= cfg.app_tag_mask,
+		.sts		= sts,
+		.pif		= pif,
+		.storage_tag	= cfg.storage_tag,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
 		.result		= NULL,
 	};
-	err = nvme_cli_format_nvm(dev, &args);
-	if (err < 0) {
-		nvme_show_error("format: %s", nvme_strerror(errno));
-	} else if (err != 0) {
-		nvme_show_status(err);
-	} else {
-		printf("Success formatting namespace:%x\n", cfg.namespace_id);
-		if (dev->type == NVME_DEV_DIRECT && cfg.lbaf != prev_lbaf) {
-			if (is_chardev(dev)) {
-				if (ioctl(dev_fd(dev), NVME_IOCTL_RESCAN) < 0) {
-					nvme_show_error("failed to rescan namespaces");
-					return -errno;
-				}
-			} else if (cfg.namespace_id != NVME_NSID_ALL) {
-				block_size = 1 << ns->lbaf[cfg.lbaf].ds;
 
-				/*
-				 * If block size has been changed by the format
-				 * command up there, we should notify it to
-				 * kernel blkdev to update its own block size
-				 * to the given one because blkdev will not
-				 * update by itself without re-opening fd.
-				 */
-				if (ioctl(dev_fd(dev), BLKBSZSET, &block_size) < 0) {
-					nvme_show_error("failed to set block size to %d",
-							block_size);
-					return -errno;
-				}
+	if (cfg.repeat > 1) {
+		lat = malloc(sizeof(*lat));
+		if (!lat)
+			return -ENOMEM;
+		nvme_hist_init(lat);
+	}
 
-				if (ioctl(dev_fd(dev), BLKRRPART) < 0) {
-					nvme_show_error("failed to re-read partition table");
-					return -errno;
-				}
-			}
-		}
-		if (dev->type == NVME_DEV_DIRECT && cfg.reset && is_chardev(dev))
-			nvme_ctrl_reset(dev_fd(dev));
+	for (i = 0; i < cfg.repeat; i++) {
+		start_ns = monotonic_ns();
+		err = nvme_verify(&args);
+		end_ns = monotonic_ns();
+		if (lat)
+			nvme_hist_add(lat, end_ns - start_ns);
+		if (err)
+			break;
+	}
+	if (cfg.latency) {
+		if (lat)
+			nvme_show_latency_hist("verify", lat, flags);
+		else
+			printf(" latency: verify: %llu us\n",
+			       (unsigned long long)((end_ns - start_ns) / NSEC_PER_USEC));
 	}
 
+	if (err < 0)
+		nvme_show_error("verify: %s", nvme_strerror(errno));
+	else if (err != 0)
+		nvme_show_status(err);
+	else
+		printf("NVME Verify Success\n");
+
 	return err;
 }
 
-#define STRTOUL_AUTO_BASE              (0)
-#define NVME_FEAT_TIMESTAMP_DATA_SIZE  (6)
-
-static int set_feature(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Modify the saveable or changeable "
-		"current operating parameters of the controller. "
-		"Operating parameters are grouped and identified by Feature"
-		"Identifiers. Feature settings can be applied to the entire"
-		"controller and all associated namespaces, or to only a few"
-		"namespace(s) associated with the controller. Default values"
-		"for each Feature are vendor-specific and may not be modified."
-		"Use get-feature to determine which Features are supported by"
-		"the controller and are saveable/changeable.";
-	const char *feature_id = "feature identifier (required)";
-	const char *data = "optional file for feature data (default stdin)";
-	const char *value = "new value of feature (required)";
-	const char *cdw12 = "feature cdw12, if used";
-	const char *save = "specifies that the controller shall save the attribute";
+/* trailer behind the data of a compare-hash read */
+struct hash_chunk {
+	__u64 slba;
+	__u32 nlb;
+	__u32 crc;		/* expected CRC-32C */
+};
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *buf = NULL;
-	_cleanup_file_ int ffd = STDIN_FILENO;
+struct hash_compare_job {
+	pthread_mutex_t lock;
+	FILE *f;		/* manifest being checked */
+	const char *name;
+	unsigned long line;
 	int err;
-	__u32 result;
 
-	struct config {
-		__u32	namespace_id;
-		__u8	feature_id;
-		__u64	value;
-		__u32	cdw12;
-		__u8	uuid_index;
-		__u32	data_len;
-		char	*file;
-		bool	save;
-	};
+	__u32 lba_size;		/* data bytes per LBA */
+	__u32 ms;		/* separate metadata bytes per LBA */
+	__u32 max_lbas;		/* LBAs per read command */
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.feature_id	= 0,
-		.value		= 0,
-		.uuid_index	= 0,
-		.data_len	= 0,
-		.file		= "",
-		.save		= false,
-	};
+	/* --create */
+	bool create;
+	__u64 slba;
+	__u64 nr_lbas;
+	__u32 *crcs;		/* CRC-32C per chunk */
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
-		  OPT_BYTE("feature-id",   'f', &cfg.feature_id,   feature_id),
-		  OPT_SUFFIX("value",      'V', &cfg.value,        value),
-		  OPT_UINT("cdw12",        'c', &cfg.cdw12,        cdw12),
-		  OPT_BYTE("uuid-index",   'U', &cfg.uuid_index,   uuid_index_specify),
-		  OPT_UINT("data-len",     'l', &cfg.data_len,     buf_len),
-		  OPT_FILE("data",         'd', &cfg.file,         data),
-		  OPT_FLAG("save",         's', &cfg.save,         save));
+	__u64 chunks;
+	struct nvme_crc_mismatch *bad;
+	int nr_bad;
+};
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+static struct hash_chunk *hash_chunk(struct hash_compare_job *hc, void *buf)
+{
+	return (struct hash_chunk *)((char *)buf + (size_t)hc->max_lbas * hc->lba_size);
+}
 
-	if (!argconfig_parse_seen(opts, "namespace-id")) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			if (errno != ENOTTY) {
-				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-				return -errno;
-			}
-			cfg.namespace_id = NVME_NSID_ALL;
+/* Read the next "<slba> <nlb> <crc32c>" line of the manifest */
+static int hash_manifest_read(struct hash_compare_job *hc, struct hash_chunk *c)
+{
+	_cleanup_free_ char *line = NULL;
+	unsigned long long slba;
+	unsigned int nlb, crc;
+	size_t size = 0;
+	char *p;
+
+	while (getline(&line, &size, hc->f) >= 0) {
+		hc->line++;
+		p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\n' || !*p)
+			continue;
+
+		if (sscanf(p, "%lli %u %x", &slba, &nlb, &crc) != 3 || !nlb) {
+			nvme_show_error("%s:%lu: expected <slba> <nlb> <crc32c>",
+					hc->name, hc->line);
+			return -EINVAL;
 		}
-	}
 
-	if (!cfg.feature_id) {
-		nvme_show_error("feature-id required param");
-		return -EINVAL;
+		if (nlb > hc->max_lbas) {
+			nvme_show_error("%s:%lu: %u blocks exceed the %u blocks of one read",
+					hc->name, hc->line, nlb, hc->max_lbas);
+			return -EINVAL;
+		}
+
+		c->slba = slba;
+		c->nlb = nlb;
+		c->crc = crc;
+		return 1;
 	}
 
-	if (cfg.uuid_index > 127) {
-		nvme_show_error("invalid uuid index param: %u", cfg.uuid_index);
-		return -1;
+	if (ferror(hc->f))
+		return -EIO;
+
+	return 0;
+}
+
+static int hash_compare_prep(struct nvme_io_job *job, unsigned int thread,
+			     __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct hash_compare_job *hc = job->priv;
+	struct hash_chunk *c = hash_chunk(hc, (void *)(uintptr_t)cmd->addr);
+	int err;
+
+	if (hc->create) {
+		c->slba = hc->slba + seq * hc->max_lbas;
+		c->nlb = min(hc->max_lbas, hc->nr_lbas - seq * hc->max_lbas);
+	} else {
+		pthread_mutex_lock(&hc->lock);
+		err = hc->err;
+		if (!err) {
+			err = hash_manifest_read(hc, c);
+			if (err < 0)
+				hc->err = err;
+		}
+		pthread_mutex_unlock(&hc->lock);
+		if (err <= 0)
+			return err ? err : 1;
 	}
 
-	if (!cfg.data_len)
-		nvme_cli_get_feature_length2(cfg.feature_id, cfg.value,
-					     NVME_DATA_TFR_HOST_TO_CTRL,
-					     &cfg.data_len);
+	nvme_io_job_init_cmd(job, c->slba, cmd);
+	cmd->cdw12 = (c->nlb - 1) | (job->control << 16);
+	cmd->data_len = c->nlb * hc->lba_size;
+	if (cmd->metadata)
+		cmd->metadata_len = c->nlb * hc->ms;
 
-	if (cfg.data_len) {
-		buf = nvme_alloc(cfg.data_len);
-		if (!buf)
-			return -ENOMEM;
+	return 0;
+}
+
+static void hash_compare_complete(struct nvme_io_job *job, unsigned int thread,
+				  __u64 seq, void *buf, int status, __u64 result,
+				  __u64 lat_ns)
+{
+	struct hash_compare_job *hc = job->priv;
+	struct hash_chunk *c = hash_chunk(hc, buf);
+	struct nvme_crc_mismatch *bad;
+	__u32 crc = 0;
+
+	/* hash outside of the lock, every worker checksums its own buffers */
+	if (!status)
+		crc = crc32c(0, buf, (size_t)c->nlb * hc->lba_size);
+
+	pthread_mutex_lock(&hc->lock);
+	hc->chunks++;
+	if (!status && hc->create)
+		hc->crcs[seq] = crc;
+
+	if (status || (!hc->create && crc != c->crc)) {
+		bad = realloc(hc->bad, (hc->nr_bad + 1) * sizeof(*bad));
+		if (bad) {
+			bad[hc->nr_bad] = (struct nvme_crc_mismatch) {
+				.slba		= c->slba,
+				.nlb		= c->nlb,
+				.expected	= c->crc,
+				.actual		= crc,
+				.status		= status,
+			};
+			hc->bad = bad;
+			hc->nr_bad++;
+		}
 	}
+	pthread_mutex_unlock(&hc->lock);
+}
 
-	if (buf) {
-		/*
-		 * Use the '-v' value for the timestamp feature if provided as
-		 * a convenience since it can often fit in 4-bytes. The user
-		 * should use the buffer method if the value exceeds this
-		 * length.
-		 */
-		if (cfg.feature_id == NVME_FEAT_FID_TIMESTAMP && cfg.value) {
-			memcpy(buf, &cfg.value, NVME_FEAT_TIMESTAMP_DATA_SIZE);
-		} else {
-			if (strlen(cfg.file))
-				ffd = open(cfg.file, O_RDONLY);
+static const struct nvme_io_job_ops hash_compare_ops = {
+	.prep		= hash_compare_prep,
+	.complete	= hash_compare_complete,
+};
 
-			if (ffd < 0) {
-				nvme_show_error("Failed to open file %s: %s",
-						cfg.file, strerror(errno));
-				return -EINVAL;
-			}
+static int hash_mismatch_cmp(const void *a, const void *b)
+{
+	const struct nvme_crc_mismatch *ma = a, *mb = b;
+
+	return ma->slba < mb->slba ? -1 : ma->slba > mb->slba;
+}
+
+static int hash_manifest_write(struct hash_compare_job *hc, const char *file,
+			       __u64 nr_chunks)
+{
+	_cleanup_free_ char *tmp = NULL;
+	FILE *f;
+	__u64 i, slba;
+	int err = 0;
+
+	if (asprintf(&tmp, "%s.tmp", file) < 0)
+		return -ENOMEM;
+
+	f = fopen(tmp, "w");
+	if (!f)
+		return -errno;
 
-			err = read(ffd, buf, cfg.data_len);
-			if (err < 0) {
-				nvme_show_error("failed to read data buffer from input file: %s",
-						strerror(errno));
-				return -errno;
-			}
-		}
+	fprintf(f, "# nvme compare-hash manifest: <slba> <nlb> <crc32c>, %u byte blocks\n",
+		hc->lba_size);
+	for (i = 0; i < nr_chunks; i++) {
+		slba = hc->slba + i * hc->max_lbas;
+		fprintf(f, "%"PRIu64" %u %08x\n", (uint64_t)slba,
+			(unsigned int)min((__u64)hc->max_lbas, hc->nr_lbas - i * hc->max_lbas),
+			hc->crcs[i]);
 	}
 
-	struct nvme_set_features_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.fid		= cfg.feature_id,
-		.nsid		= cfg.namespace_id,
-		.cdw11		= cfg.value,
-		.cdw12		= cfg.cdw12,
-		.save		= cfg.save,
-		.uuidx		= cfg.uuid_index,
-		.cdw15		= 0,
-		.data_len	= cfg.data_len,
-		.data		= buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= &result,
-	};
-	err = nvme_set_features(&args);
-	if (err < 0) {
-		nvme_show_error("set-feature: %s", nvme_strerror(errno));
-	} else if (!err) {
-		printf("set-feature:%#0*x (%s), value:%#0*"PRIx64", cdw12:%#0*x, save:%#x\n",
-		       cfg.feature_id ? 4 : 2, cfg.feature_id,
-		       nvme_feature_to_string(cfg.feature_id),
-		       cfg.value ? 10 : 8, (uint64_t)cfg.value,
-		       cfg.cdw12 ? 10 : 8, cfg.cdw12, cfg.save);
-		if (cfg.feature_id == NVME_FEAT_FID_LBA_STS_INTERVAL)
-			nvme_show_lba_status_info(result);
-		if (buf) {
-			if (cfg.feature_id == NVME_FEAT_FID_LBA_RANGE)
-				nvme_show_lba_range((struct nvme_lba_range_type *)buf, result, 0);
-			else
-				d(buf, cfg.data_len, 16, 1);
-		}
-	} else if (err > 0) {
-		nvme_show_status(err);
-	}
+	if (fflush(f) || fsync(fileno(f)))
+		err = -errno;
+	if (fclose(f) && !err)
+		err = -errno;
+	if (!err && rename(tmp, file))
+		err = -errno;
+	if (err)
+		unlink(tmp);
 
 	return err;
 }
 
-static int sec_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int compare_hash(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	struct stat sb;
-	const char *desc = "Transfer security protocol data to\n"
-		"a controller. Security Receives for the same protocol should be\n"
-		"performed after Security Sends. The security protocol field\n"
-		"associates Security Sends (security-send) and Security Receives (security-recv).";
-	const char *file = "transfer payload";
-	const char *tl = "transfer length (cf. SPC-4)";
+	const char *desc = "Read logical blocks in large chunks at queue depth and\n"
+		"compare their CRC-32C against a manifest instead of sending\n"
+		"the reference data to the device. Only mismatching chunks\n"
+		"are reported. With --create the manifest is written from the\n"
+		"device, e.g. a golden drive.";
+	const char *manifest = "manifest with one \"<slba> <nlb> <crc32c>\" chunk per line, '-' for stdin";
+	const char *create = "write the manifest from the device data instead of checking it";
+	const char *chunk_size = "blocks per chunk for --create, 0 for the largest read the controller allows";
 
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *sec_buf = NULL;
-	_cleanup_file_ int sec_fd = -1;
-	unsigned int sec_size;
+	struct hash_compare_job hc = { 0 };
+	_cleanup_file_ int gfd = -1;
+	struct nvme_io_stats stats;
+	enum nvme_print_flags flags;
+	__u8 lba_index;
+	__u32 ms;
 	int err;
 
 	struct config {
 		__u32	namespace_id;
-		char	*file;
-		__u8	nssf;
-		__u8	secp;
-		__u16	spsp;
-		__u32	tl;
+		char	*manifest;
+		bool	create;
+		char	*range;
+		__u32	chunk_size;
+		__u32	queue_depth;
+		__u32	threads;
+		struct io_rate_cfg	rate;
 	};
 
 	struct config cfg = {
 		.namespace_id	= 0,
-		.file		= "",
-		.nssf		= 0,
-		.secp		= 0,
-		.spsp		= 0,
-		.tl		= 0,
+		.manifest	= NULL,
+		.create		= false,
+		.range		= "all",
+		.chunk_size	= 0,
+		.queue_depth	= 32,
+		.threads	= 1,
 	};
 
 	NVME_ARGS(opts,
 		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
-		  OPT_FILE("file",         'f', &cfg.file,         file),
-		  OPT_BYTE("nssf",         'N', &cfg.nssf,         nssf),
-		  OPT_BYTE("secp",         'p', &cfg.secp,         secp),
-		  OPT_SHRT("spsp",         's', &cfg.spsp,         spsp),
-		  OPT_UINT("tl",           't', &cfg.tl,           tl));
+		  OPT_FILE("manifest",     'm', &cfg.manifest,     manifest),
+		  OPT_FLAG("create",       'c', &cfg.create,       create),
+		  OPT_STR("range",         'R', &cfg.range,        sweep_range),
+		  OPT_UINT("chunk-size",   'b', &cfg.chunk_size,   chunk_size),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  sweep_queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      sweep_threads),
+		  OPT_IO_RATE(&cfg.rate));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.tl == 0) {
-		nvme_show_error("--tl unspecified or zero");
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (!cfg.manifest) {
+		nvme_show_error("--manifest is required");
 		return -EINVAL;
 	}
-	if ((cfg.tl & 3) != 0)
-		nvme_show_error(
-		    "WARNING: --tl not dword aligned; unaligned bytes may be truncated");
 
-	if (strlen(cfg.file) == 0) {
-		sec_fd = STDIN_FILENO;
-		sec_size = cfg.tl;
-	} else {
-		sec_fd = open(cfg.file, O_RDONLY);
-		if (sec_fd < 0) {
-			nvme_show_error("Failed to open %s: %s", cfg.file, strerror(errno));
-			return -EINVAL;
-		}
+	if (cfg.create && !strcmp(cfg.manifest, "-")) {
+		nvme_show_error("--create needs a manifest file");
+		return -EINVAL;
+	}
 
-		err = fstat(sec_fd, &sb);
+	if (!cfg.queue_depth || !cfg.threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
 		if (err < 0) {
-			nvme_show_perror("fstat");
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
 			return err;
 		}
-
-		sec_size = cfg.tl > sb.st_size ? cfg.tl : sb.st_size;
 	}
 
-	sec_buf = nvme_alloc(cfg.tl);
-	if (!sec_buf)
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ctrl || !ns)
 		return -ENOMEM;
 
-	err = read(sec_fd, sec_buf, sec_size);
-	if (err < 0) {
-		nvme_show_error("Failed to read data from security file %s with %s", cfg.file,
-				strerror(errno));
-		return -errno;
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify: %s", nvme_strerror(errno));
+		return err;
 	}
 
-	struct nvme_security_send_args args = {
-		.args_size	= sizeof(args),
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	hc.lba_size = 1 << ns->lbaf[lba_index].ds;
+	ms = ns->lbaf[lba_index].ms;
+	if (ms) {
+		/* the checksum covers the data, extended LBAs carry it inline */
+		if (NVME_FLBAS_META_EXT(ns->flbas))
+			hc.lba_size += ms;
+		else
+			hc.ms = ms;
+	}
+
+	hc.max_lbas = min(ctrl_max_xfer_len(ctrl) / (hc.lba_size + hc.ms), 1U << 16);
+	if (cfg.chunk_size)
+		hc.max_lbas = min(hc.max_lbas, cfg.chunk_size);
+	if (!hc.max_lbas) {
+		nvme_show_error("MDTS is smaller than one logical block");
+		return -EINVAL;
+	}
+
+	struct nvme_io_job job = {
 		.nsid		= cfg.namespace_id,
-		.nssf		= cfg.nssf,
-		.spsp0		= cfg.spsp & 0xff,
-		.spsp1		= cfg.spsp >> 8,
-		.secp		= cfg.secp,
-		.tl		= cfg.tl,
-		.data_len	= cfg.tl,
-		.data		= sec_buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
+		.opcode		= nvme_cmd_read,
+		.nlb		= 0,
+		/* one maximal read followed by struct hash_chunk */
+		.lba_size	= hc.max_lbas * hc.lba_size + sizeof(struct hash_chunk),
+		.ms		= hc.max_lbas * hc.ms,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.ops		= &hash_compare_ops,
+		.priv		= &hc,
 	};
 
-	err = nvme_cli_security_send(dev, &args);
+	hc.create = cfg.create;
+	if (hc.create) {
+		err = parse_lba_range(cfg.range, le64_to_cpu(ns->nsze), &hc.slba, &hc.nr_lbas);
+		if (err) {
+			nvme_show_error("Invalid range %s (namespace size %"PRIu64")",
+					cfg.range, (uint64_t)le64_to_cpu(ns->nsze));
+			return err;
+		}
 
-	if (err < 0)
-		nvme_show_error("security-send: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVME Security Send Command Success\n");
+		job.slba = hc.slba;
+		job.nr_lbas = hc.nr_lbas;
+		job.nr_ios = (hc.nr_lbas + hc.max_lbas - 1) / hc.max_lbas;
+		hc.crcs = calloc(job.nr_ios, sizeof(*hc.crcs));
+		if (!hc.crcs)
+			return -ENOMEM;
+	} else {
+		if (!strcmp(cfg.manifest, "-")) {
+			hc.f = stdin;
+			hc.name = "stdin";
+		} else {
+			hc.f = fopen(cfg.manifest, "r");
+			if (!hc.f) {
+				err = -errno;
+				nvme_show_perror(cfg.manifest);
+				return err;
+			}
+			hc.name = cfg.manifest;
+		}
+
+		/* the end of the manifest stops the job */
+		job.nr_ios = UINT64_MAX;
+	}
+
+	err = io_rate_apply(&cfg.rate, &job, (__u64)hc.max_lbas * hc.lba_size);
+	if (err)
+		goto free;
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		nvme_show_error("compare-hash requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		goto free;
+	}
+	job.fd = gfd;
+
+	pthread_mutex_init(&hc.lock, NULL);
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	pthread_mutex_destroy(&hc.lock);
+	if (err < 0) {
+		nvme_show_error("compare-hash: %s", nvme_strerror(-err));
+		goto free;
+	}
+
+	if (hc.create) {
+		if (stats.errors || hc.chunks < job.nr_ios) {
+			nvme_show_error("not all chunks were read, %s not written",
+					cfg.manifest);
+			err = -EIO;
+		} else {
+			err = hash_manifest_write(&hc, cfg.manifest, job.nr_ios);
+			if (err)
+				nvme_show_error("%s: %s", cfg.manifest, nvme_strerror(-err));
+		}
+	}
+
+	qsort(hc.bad, hc.nr_bad, sizeof(*hc.bad), hash_mismatch_cmp);
+
+	struct nvme_hash_compare result = {
+		.manifest	= cfg.manifest,
+		.create		= hc.create && !err,
+		.chunks		= hc.chunks,
+		.stats		= &stats,
+		.bad		= hc.bad,
+		.nr_bad		= hc.nr_bad,
+	};
+	nvme_show_hash_compare(&result, flags);
+
+	if (!err && hc.nr_bad)
+		err = -EILSEQ;
+free:
+	if (hc.f && hc.f != stdin)
+		fclose(hc.f);
+	free(hc.crcs);
+	free(hc.bad);
 
 	return err;
 }
 
-static int dir_send(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "Set directive parameters of the specified directive type.";
-	const char *endir = "directive enable";
-	const char *ttype = "target directive type to be enabled/disabled";
-	const char *input = "write/send file (default stdin)";
+/* write @seq of io-bench --streams goes to the next of the streams 1..*priv */
+static int io_bench_stream_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+				struct nvme_passthru_cmd64 *cmd)
+{
+	__u16 nr_streams = *(__u16 *)job->priv;
+
+	cmd->cdw12 |= NVME_DIRECTIVE_DTYPE_STREAMS << 20;
+	cmd->cdw13 = (cmd->cdw13 & 0xffff) | (__u32)(seq % nr_streams + 1) << 16;
+
+	return 0;
+}
+
+static const struct nvme_io_job_ops io_bench_stream_ops = {
+	.prep		= io_bench_stream_prep,
+};
+
+/*
+ * io-bench --profile plays the phases of a workload profile one after the
+ * other, see util/workload.h. Whether a command reads or writes and goes
+ * to a random LBA is drawn from a hash of its sequence number, so that
+ * complete() tells the same without keeping a record per command.
+ */
+struct io_profile {
+	const struct nvme_workload_phase *p;
+	__u64 deadline_ns;
+	__u16 nlb[2];		/* zeroes based, of the reads and writes */
+	__u64 next[2];		/* the sequential reads and writes go on here */
+	__u64 bytes;
+};
+
+static __u64 io_profile_hash(__u64 seq)
+{
+	seq += 0x9e3779b97f4a7c15ULL;
+	seq = (seq ^ (seq >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	seq = (seq ^ (seq >> 27)) * 0x94d049bb133111ebULL;
+	return seq ^ (seq >> 31);
+}
+
+/* 0 for a read, 1 for a write */
+static int io_profile_dir(struct io_profile *pr, __u64 h)
+{
+	return h % 100 >= pr->p->read_pct;
+}
+
+static int io_profile_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+			   struct nvme_passthru_cmd64 *cmd)
+{
+	struct io_profile *pr = job->priv;
+	__u64 h = io_profile_hash(seq);
+	int d = io_profile_dir(pr, h);
+	__u64 blocks = pr->nlb[d] + 1;
+	__u64 nr = max(job->nr_lbas / blocks, 1ULL);
+	__u8 rand = d ? pr->p->rand_write_pct : pr->p->rand_read_pct;
+	__u64 idx;
+
+	if (monotonic_ns() >= pr->deadline_ns)
+		return 1;
+
+	if ((h >> 8) % 100 < rand)
+		idx = (h >> 16) % nr;
+	else
+		idx = __atomic_fetch_add(&pr->next[d], 1, __ATOMIC_RELAXED) % nr;
+
+	nvme_io_job_init_cmd(job, job->slba + idx * blocks, cmd);
+	cmd->opcode = d ? nvme_cmd_write : nvme_cmd_read;
+	cmd->cdw12 = pr->nlb[d] | (job->control << 16);
+	cmd->data_len = blocks * job->lba_size;
+	if (cmd->metadata_len)
+		cmd->metadata_len = blocks * job->ms;
+
+	return 0;
+}
+
+static void io_profile_complete(struct nvme_io_job *job, unsigned int thread,
+				__u64 seq, void *buf, int status, __u64 result,
+				__u64 lat_ns)
+{
+	struct io_profile *pr = job->priv;
+	int d = io_profile_dir(pr, io_profile_hash(seq));
+
+	if (!status)
+		__atomic_fetch_add(&pr->bytes, (pr->nlb[d] + 1) * job->lba_size,
+				   __ATOMIC_RELAXED);
+}
+
+static const struct nvme_io_job_ops io_profile_ops = {
+	.prep		= io_profile_prep,
+	.complete	= io_profile_complete,
+};
+
+#define _cleanup_workload_ __cleanup__(nvme_workload_free)
+
+/* zeroes based blocks of @bytes per command, @def if not given */
+static __u16 io_profile_nlb(__u32 bytes, __u32 lba_size, __u16 def)
+{
+	__u64 n;
+
+	if (!bytes)
+		return def;
+	n = (bytes + lba_size - 1) / lba_size;
+	return min(n, 0x10000ULL) - 1;
+}
+
+static void io_profile_merge(struct nvme_io_stats *dst, struct nvme_io_stats *src)
+{
+	if (!dst->errors && src->errors)
+		dst->first_err = src->first_err;
+	dst->ios += src->ios;
+	dst->errors += src->errors;
+	dst->elapsed_ns += src->elapsed_ns;
+	nvme_hist_merge(&dst->lat, &src->lat);
+	dst->queue_depth = max(dst->queue_depth, src->queue_depth);
+	dst->threads = src->threads;
+	dst->hw_queues = src->hw_queues;
+	dst->uring = src->uring;
+	dst->fixed_bufs = src->fixed_bufs;
+	dst->poll = src->poll;
+	dst->cmb = src->cmb;
+	dst->rate_limited |= src->rate_limited;
+	dst->rate_backoffs += src->rate_backoffs;
+	dst->rate_scale = src->rate_scale;
+}
+
+/*
+ * Run the phases of @w with @job, the queue depth and block count of
+ * io-bench for those the phases leave open. The stats of all phases
+ * together are returned in @stats, idle phases counted in the runtime.
+ */
+static int io_bench_profile(struct nvme_io_job *job, const struct nvme_workload *w,
+			    struct nvme_io_stats *stats)
+{
+	const struct nvme_workload_phase *p;
+	struct io_profile pr = { 0 };
+	__u32 qd = job->queue_depth;
+	__u16 nlb = job->nlb;
+	struct nvme_io_stats ps;
+	__u64 start, avg;
+	size_t i;
+	int err;
+
+	memset(stats, 0, sizeof(*stats));
+	nvme_hist_init(&stats->lat);
+	job->ops = &io_profile_ops;
+	job->priv = &pr;
+	job->nr_ios = 0;
+
+	for (i = 0; i < w->nr && !nvme_stopped(); i++) {
+		p = &w->phases[i];
+		start = monotonic_ns();
+		if (p->idle) {
+			while (!nvme_stopped() &&
+			       monotonic_ns() - start < p->duration_ms * 1000000ULL)
+				usleep(min(p->duration_ms * 1000ULL, 10000ULL));
+			stats->elapsed_ns += monotonic_ns() - start;
+			continue;
+		}
+
+		pr.p = p;
+		pr.nlb[0] = io_profile_nlb(p->read_bytes, job->lba_size, nlb);
+		pr.nlb[1] = io_profile_nlb(p->write_bytes, job->lba_size, nlb);
+		pr.deadline_ns = start + p->duration_ms * 1000000ULL;
+
+		/* the buffers are sized for the larger of the two */
+		job->nlb = max(pr.nlb[0], pr.nlb[1]);
+		job->queue_depth = p->queue_depth ? p->queue_depth : qd;
+		job->runtime = p->duration_ms / 1000 + 1;
+		job->rate_iops = p->iops;
+		job->rate_bps = p->bytes_per_sec;
+		avg = ((__u64)(pr.nlb[0] + 1) * p->read_pct +
+		       (__u64)(pr.nlb[1] + 1) * (100 - p->read_pct)) * job->lba_size / 100;
+		job->io_cost = max(avg, 1ULL);
+
+		err = nvme_io_engine_run(job, &ps);
+		if (err < 0)
+			return err;
+		io_profile_merge(stats, &ps);
+	}
+	stats->bytes = pr.bytes;
+
+	return 0;
+}
+
+/*
+ * Open the namespace of @dev for io-bench and fill in the namespace
+ * dependent fields of @job, its format, protection and data pattern.
+ * The generic device opened is returned in @gfd, the pattern read from
+ * @data in @pattern, both to be released by the caller.
+ */
+static int io_bench_ns_setup(struct nvme_dev *dev, struct nvme_io_job *job, __u8 prinfo,
+			     const char *data, void **pattern, int *gfd)
+{
+	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_file_ int dfd = -1;
+	__u64 nsze, max_xfer;
+	__u8 lba_index, ms;
+	ssize_t len;
+	int err;
+
+	if (!job->nsid) {
+		err = nvme_get_nsid(dev_fd(dev), &job->nsid);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ void *buf = NULL;
-	__u32 result;
-	__u32 dw12 = 0;
-	_cleanup_file_ int ffd = STDIN_FILENO;
-	int err;
+	err = nvme_cli_identify_ns(dev, job->nsid, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	}
 
-	struct config {
-		__u32	namespace_id;
-		__u32	data_len;
-		__u8	dtype;
-		__u8	ttype;
-		__u16	dspec;
-		__u8	doper;
-		__u16	endir;
-		bool	human_readable;
-		bool	raw_binary;
-		char	*file;
-	};
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job->lba_size = 1 << ns->lbaf[lba_index].ds;
+	ms = ns->lbaf[lba_index].ms;
+	/* No meta data is transferred for PRACT=1 and MD=8 */
+	if (ms && !((prinfo & 0x8) != 0 && ms == 8)) {
+		if (NVME_FLBAS_META_EXT(ns->flbas))
+			job->lba_size += ms;
+		else
+			job->ms = ms;
+	}
 
-	struct config cfg = {
-		.namespace_id	= 1,
-		.data_len	= 0,
-		.dtype		= 0,
-		.ttype		= 0,
-		.dspec		= 0,
-		.doper		= 0,
-		.endir		= 1,
-		.human_readable	= false,
-		.raw_binary	= false,
-		.file		= "",
-	};
+	nsze = le64_to_cpu(ns->nsze);
+	if (job->slba >= nsze) {
+		nvme_show_error("start block %"PRIu64" is past the namespace size %"PRIu64,
+				(uint64_t)job->slba, (uint64_t)nsze);
+		return -EINVAL;
+	}
+	if (!job->nr_lbas)
+		job->nr_lbas = nsze - job->slba;
+	if (job->nr_lbas > nsze - job->slba) {
+		nvme_show_error("range of %"PRIu64" blocks from %"PRIu64" is past the namespace size %"PRIu64,
+				(uint64_t)job->nr_lbas, (uint64_t)job->slba, (uint64_t)nsze);
+		return -EINVAL;
+	}
+	if (job->nlb >= job->nr_lbas) {
+		nvme_show_error("block count %u is larger than the range of %"PRIu64" blocks",
+				job->nlb + 1, (uint64_t)job->nr_lbas);
+		return -EINVAL;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",   'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_UINT("data-len",       'l', &cfg.data_len,       buf_len),
-		  OPT_BYTE("dir-type",       'D', &cfg.dtype,          dtype),
-		  OPT_BYTE("target-dir",     'T', &cfg.ttype,          ttype),
-		  OPT_SHRT("dir-spec",       'S', &cfg.dspec,          dspec_w_dtype),
-		  OPT_BYTE("dir-oper",       'O', &cfg.doper,          doper),
-		  OPT_SHRT("endir",          'e', &cfg.endir,          endir),
-		  OPT_FLAG("human-readable", 'H', &cfg.human_readable, human_readable_directive),
-		  OPT_FLAG("raw-binary",     'b', &cfg.raw_binary,     raw_directive),
-		  OPT_FILE("input-file",     'i', &cfg.file,           input));
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl)
+		return -ENOMEM;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify controller: %s", nvme_strerror(errno));
 		return err;
+	}
 
-	switch (cfg.dtype) {
-	case NVME_DIRECTIVE_DTYPE_IDENTIFY:
-		switch (cfg.doper) {
-		case NVME_DIRECTIVE_SEND_IDENTIFY_DOPER_ENDIR:
-			if (!cfg.ttype) {
-				nvme_show_error("target-dir required param\n");
-				return -EINVAL;
-			}
-			dw12 = cfg.ttype << 8 | cfg.endir;
-			break;
-		default:
-			nvme_show_error("invalid directive operations for Identify Directives");
-			return -EINVAL;
-		}
-		break;
-	case NVME_DIRECTIVE_DTYPE_STREAMS:
-		switch (cfg.doper) {
-		case NVME_DIRECTIVE_SEND_STREAMS_DOPER_RELEASE_IDENTIFIER:
-		case NVME_DIRECTIVE_SEND_STREAMS_DOPER_RELEASE_RESOURCE:
-			break;
-		default:
-			nvme_show_error("invalid directive operations for Streams Directives");
+	/* MDTS in units of the minimum memory page size, assumed to be 4k */
+	if (ctrl->mdts && ctrl->mdts < 32) {
+		max_xfer = (__u64)NVME_LOG_PAGE_PDU_SIZE << ctrl->mdts;
+		if (nvme_io_job_data_len(job) > max_xfer) {
+			nvme_show_error("block count %u transfers %u bytes, more than the MDTS of %"PRIu64,
+					job->nlb + 1, nvme_io_job_data_len(job),
+					(uint64_t)max_xfer);
 			return -EINVAL;
 		}
-		break;
-	default:
-		nvme_show_error("invalid directive type");
-		return -EINVAL;
 	}
 
-	if (cfg.data_len) {
-		buf = nvme_alloc(cfg.data_len);
-		if (!buf)
-			return -ENOMEM;
+	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
+	if (!nvm_ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns_csi(dev_fd(dev), job->nsid, 0,
+				   NVME_CSI_NVM, nvm_ns);
+	if (!err) {
+		job->sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
+		job->pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
 	}
 
-	if (buf) {
-		if (strlen(cfg.file)) {
-			ffd = open(cfg.file, O_RDONLY);
-			if (ffd <= 0) {
-				nvme_show_error("Failed to open file %s: %s",
-						cfg.file, strerror(errno));
-				return -EINVAL;
-			}
+	if (invalid_tags(job->storage_tag, job->reftag, job->sts, job->pif))
+		return -EINVAL;
+
+	if (strlen(data)) {
+		dfd = open(data, O_RDONLY);
+		if (dfd < 0) {
+			nvme_show_perror(data);
+			return -EINVAL;
 		}
-		err = read(ffd, (void *)buf, cfg.data_len);
-		if (err < 0) {
-			nvme_show_error("failed to read data buffer from input file %s",
-					strerror(errno));
-			return -errno;
+
+		*pattern = nvme_alloc(nvme_io_job_data_len(job));
+		if (!*pattern)
+			return -ENOMEM;
+
+		len = read(dfd, *pattern, nvme_io_job_data_len(job));
+		if (len < 0) {
+			err = -errno;
+			nvme_show_error("failed to read data pattern from %s: %s",
+					data, strerror(errno));
+			return err;
 		}
+		job->pattern = *pattern;
+		job->pattern_len = len;
 	}
 
-	struct nvme_directive_send_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.dspec		= cfg.dspec,
-		.doper		= cfg.doper,
-		.dtype		= cfg.dtype,
-		.cdw12		= dw12,
-		.data_len	= cfg.data_len,
-		.data		= buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= &result,
-	};
-	err = nvme_directive_send(&args);
-	if (err < 0) {
-		nvme_show_error("dir-send: %s", nvme_strerror(errno));
-		return err;
-	}
-	if (!err) {
-		printf("dir-send: type %#x, operation %#x, spec_val %#x, nsid %#x, result %#x\n",
-		       cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id, result);
-		if (buf) {
-			if (!cfg.raw_binary)
-				d(buf, cfg.data_len, 16, 1);
-			else
-				d_raw(buf, cfg.data_len);
-		}
-	} else if (err > 0) {
-		nvme_show_status(err);
+	*gfd = open_generic_dev(dev);
+	if (*gfd < 0) {
+		nvme_show_error("io-bench requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
 	}
+	job->fd = *gfd;
 
-	return err;
+	return 0;
 }
 
-static int write_uncor(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * The namespaces found in the topology, shared and private, for io-bench
+ * all. Free with ctrl_paths_free().
+ */
+static int ns_paths_scan(char ***paths, int *nr)
 {
-	const char *desc =
-	    "The Write Uncorrectable command is used to set a range of logical blocks to invalid.";
+	_cleanup_topology_ nvme_root_t r = NULL;
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_ctrl_t c;
+	nvme_ns_t n;
+	char **tmp;
+	int err;
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	*paths = NULL;
+	*nr = 0;
+
+	err = scan_topology(&r);
+	if (err < 0)
+		return -errno;
+
+#define NS_PATH_ADD(n)								\
+	do {									\
+		tmp = realloc(*paths, (*nr + 1) * sizeof(*tmp));		\
+		if (!tmp)							\
+			return -ENOMEM;						\
+		*paths = tmp;							\
+		if (asprintf(&tmp[*nr], "/dev/%s", nvme_ns_get_name(n)) < 0)	\
+			return -ENOMEM;						\
+		(*nr)++;							\
+	} while (0)
+
+	nvme_for_each_host(r, h)
+		nvme_for_each_subsystem(h, s) {
+			nvme_subsystem_for_each_ns(s, n)
+				NS_PATH_ADD(n);
+			nvme_subsystem_for_each_ctrl(s, c)
+				nvme_ctrl_for_each_ns(c, n)
+					NS_PATH_ADD(n);
+		}
+#undef NS_PATH_ADD
+
+	return 0;
+}
+
+/* One namespace of a multi-device io-bench, run by a thread of its own */
+struct io_bench_dev {
+	struct nvme_dev *dev;
+	int gfd;
+	void *pattern;
+	struct nvme_io_job job;
+	struct nvme_io_progress progress;
+	struct nvme_io_progress last;	/* at the previous interval */
+	struct nvme_io_stats stats;
+	pthread_t thread;
+	bool done;
 	int err;
+};
 
-	struct config {
-		__u32	namespace_id;
-		__u64	start_block;
-		__u16	block_count;
-		__u8	dtype;
-		__u16	dspec;
-	};
+static void *io_bench_dev_fn(void *arg)
+{
+	struct io_bench_dev *d = arg;
+	cpu_set_t cpus;
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.start_block	= 0,
-		.block_count	= 0,
-		.dtype			= 0,
-		.dspec			= 0,
-	};
+	/*
+	 * The engine places its threads on the CPUs this one may run on,
+	 * so they submit from the NUMA node of the device.
+	 */
+	if (!sysfs_local_cpus(d->dev->name, &cpus))
+		pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id, namespace_desired),
-		  OPT_SUFFIX("start-block", 's', &cfg.start_block,  start_block),
-		  OPT_SHRT("block-count",   'c', &cfg.block_count,  block_count),
-		  OPT_BYTE("dir-type",      'T', &cfg.dtype,        dtype),
-		  OPT_SHRT("dir-spec",      'S', &cfg.dspec,        dspec_w_dtype));
+	d->err = nvme_io_engine_run(&d->job, &d->stats);
+	__atomic_store_n(&d->done, true, __ATOMIC_RELEASE);
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	return NULL;
+}
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+static void io_bench_total(struct nvme_io_stats *dst, struct nvme_io_stats *src, bool first)
+{
+	if (first) {
+		*dst = *src;
+		return;
 	}
 
-	if (cfg.dtype > 0xf) {
-		nvme_show_error("Invalid directive type, %x",	cfg.dtype);
-		return -EINVAL;
+	if (!dst->errors && src->errors)
+		dst->first_err = src->first_err;
+	dst->ios += src->ios;
+	dst->bytes += src->bytes;
+	dst->errors += src->errors;
+	dst->elapsed_ns = max(dst->elapsed_ns, src->elapsed_ns);
+	nvme_hist_merge(&dst->lat, &src->lat);
+	dst->queue_depth = max(dst->queue_depth, src->queue_depth);
+	dst->threads += src->threads;
+	dst->hw_queues += src->hw_queues;
+	dst->uring &= src->uring;
+	dst->fixed_bufs &= src->fixed_bufs;
+	dst->rate_limited = false;
+}
+
+/* Print the interval samples of all devices and of them together */
+static void io_bench_interval(struct io_bench_dev *devs, int nr, char **paths,
+			      __u64 interval_ns, enum nvme_print_flags flags)
+{
+	struct nvme_io_bench_sample s, all = { .name = "all" };
+	struct nvme_io_progress cur;
+	double secs = interval_ns / 1e9;
+	struct timespec ts;
+	int i;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	all.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+	all.interval_ns = interval_ns;
+
+	for (i = 0; i < nr; i++) {
+		cur.ios = __atomic_load_n(&devs[i].progress.ios, __ATOMIC_RELAXED);
+		cur.bytes = __atomic_load_n(&devs[i].progress.bytes, __ATOMIC_RELAXED);
+		cur.errors = __atomic_load_n(&devs[i].progress.errors, __ATOMIC_RELAXED);
+
+		s = all;
+		s.name = basename(paths[i]);
+		s.iops = (cur.ios - devs[i].last.ios) / secs;
+		s.bytes_per_sec = (cur.bytes - devs[i].last.bytes) / secs;
+		s.errors = cur.errors - devs[i].last.errors;
+		devs[i].last = cur;
+		nvme_show_io_bench_sample(&s, flags);
+
+		all.iops += s.iops;
+		all.bytes_per_sec += s.bytes_per_sec;
+		all.errors += s.errors;
 	}
+	nvme_show_io_bench_sample(&all, flags);
+}
 
-	struct nvme_io_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.slba		= cfg.start_block,
-		.nlb		= cfg.block_count,
-		.control	= cfg.dtype << 4,
-		.dspec		= cfg.dspec,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
-	};
-	err = nvme_write_uncorrectable(&args);
-	if (err < 0)
-		nvme_show_error("write uncorrectable: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVME Write Uncorrectable Success\n");
+/*
+ * Run @tmpl on the namespaces @paths at the same time, one engine per
+ * namespace on the CPUs local to it, and report each of them and all
+ * of them together, with samples every @interval seconds if not 0.
+ */
+static int io_bench_multi(char **paths, int nr, struct nvme_io_job *tmpl, int oflags,
+			  __u8 prinfo, const char *data, bool poll, unsigned int interval,
+			  enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct io_bench_dev *devs = NULL;
+	_cleanup_free_ struct nvme_io_stats *stats = NULL;
+	_cleanup_free_ const char **names = NULL;
+	struct nvme_io_bench_multi m = { 0 };
+	struct nvme_io_stats total;
+	__u64 last, now, next;
+	int i, started = 0, err = 0;
+	bool running;
+
+	devs = calloc(nr, sizeof(*devs));
+	stats = calloc(nr, sizeof(*stats));
+	names = calloc(nr, sizeof(*names));
+	if (!devs || !stats || !names)
+		return -ENOMEM;
 
-	return err;
-}
+	for (i = 0; i < nr; i++) {
+		struct io_bench_dev *d = &devs[i];
 
-static int invalid_tags(__u64 storage_tag, __u64 ref_tag, __u8 sts, __u8 pif)
-{
-	int result = 0;
+		d->gfd = -1;
+		if (open_dev_direct(&d->dev, paths[i], oflags)) {
+			err = -errno;
+			if (errno == EBUSY)
+				fprintf(stderr, "%s: namespace is currently busy, see --force\n",
+					paths[i]);
+			goto out;
+		}
 
-	if (sts < 64 && storage_tag >= (1LL << sts)) {
-		nvme_show_error("Storage tag larger than storage tag size");
-		return 1;
+		d->job = *tmpl;
+		d->job.progress = &d->progress;
+		err = io_bench_ns_setup(d->dev, &d->job, prinfo, data, &d->pattern, &d->gfd);
+		if (err) {
+			nvme_show_error("%s: io-bench setup failed", paths[i]);
+			goto out;
+		}
+		if (poll)
+			io_poll_check(d->dev);
+		names[i] = basename(paths[i]);
 	}
 
-	switch (pif) {
-	case 0:
-		if (ref_tag >= (1LL << (32 - sts)))
-			result = 1;
-		break;
-	case 1:
-		if (sts > 16 && ref_tag >= (1LL << (80 - sts)))
-			result = 1;
-		break;
-	case 2:
-		if (sts > 0 && ref_tag >= (1LL << (48 - sts)))
-			result = 1;
-		break;
-	default:
-		nvme_show_error("Invalid PIF");
-		result = 1;
-		break;
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	for (i = 0; i < nr; i++) {
+		err = -pthread_create(&devs[i].thread, NULL, io_bench_dev_fn, &devs[i]);
+		if (err) {
+			nvme_io_engine_stop();
+			break;
+		}
+		started++;
+	}
+
+	last = monotonic_ns();
+	next = last + interval * NSEC_PER_SEC;
+	do {
+		running = false;
+		for (i = 0; i < started; i++)
+			running |= !__atomic_load_n(&devs[i].done, __ATOMIC_ACQUIRE);
+		now = monotonic_ns();
+		if (interval && started && (now >= next || !running) && now > last) {
+			io_bench_interval(devs, started, paths, now - last, flags);
+			last = now;
+			next += interval * NSEC_PER_SEC;
+		}
+		if (running)
+			usleep(10000);
+	} while (running);
+
+	for (i = 0; i < started; i++) {
+		pthread_join(devs[i].thread, NULL);
+		if (!err && devs[i].err) {
+			err = devs[i].err;
+			nvme_show_error("io-bench: %s: %s", paths[i], nvme_strerror(-err));
+		}
 	}
+	nvme_stop_release();
+	if (err)
+		goto out;
 
-	if (result)
-		nvme_show_error("Reference tag larger than allowed by PIF");
+	for (i = 0; i < nr; i++) {
+		stats[i] = devs[i].stats;
+		io_bench_total(&total, &stats[i], !i);
+	}
+	m.nr_devs = nr;
+	m.names = names;
+	m.stats = stats;
+	m.total = &total;
+	nvme_show_io_bench_multi(&m, flags);
 
-	return result;
+	err = total.errors ? -EIO : 0;
+out:
+	for (i = 0; i < nr; i++) {
+		close_file(&devs[i].gfd);
+		free(devs[i].pattern);
+		if (devs[i].dev)
+			dev_close(devs[i].dev);
+	}
+
+	return err;
 }
 
-static int write_zeroes(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int io_bench(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	const char *desc = "Keep multiple read, write or compare commands in flight\n"
+		"across several threads using io_uring passthrough on the NVMe\n"
+		"generic char device and report throughput and latency.\n"
+		"With several namespaces, or 'all' in the topology, they are run\n"
+		"at the same time and reported each and together.";
+	const char *io_mode = "I/O command: read|write|compare";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *io_count = "total number of commands to issue";
+	const char *runtime = "run time in seconds (overrides io-count if reached first)";
+	const char *io_range = "number of LBAs to spread the commands over";
+	const char *random_lba = "use random instead of sequential LBAs";
+	const char *data = "data pattern file for write or compare";
+	const char *dtype_for_write = "directive type (for write-only)";
+	const char *dspec = "directive specific (for write-only)";
+	const char *dsm = "dataset management attributes (lower 8 bits)";
+	const char *storage_tag_check = "This bit specifies the Storage Tag field shall be\n"
+		"checked as part of end-to-end data protection processing";
+	const char *force = "The \"I know what I'm doing\" flag, do not enforce exclusive access for write";
+	const char *poll = "poll for completions on the driver's poll queues instead of\n"
+		"waiting for the interrupt";
+	const char *cmb = "place the data buffers in the controller memory buffer";
+	const char *streams = "tag the writes with stream IDs 1 to NUM in turn, allocated\n"
+		"beforehand with dir-streams";
+	const char *profile = "replay the phases of a workload profile, e.g. of\n"
+		"solidigm workload-tracker-profile, instead of io-mode";
+	const char *interval = "with several namespaces, report the throughput\n"
+		"every interval seconds";
+
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u8 lba_index, sts = 0, pif = 0;
+	_cleanup_free_ void *pattern = NULL;
+	_cleanup_file_ int gfd = -1;
+	_cleanup_workload_ struct nvme_workload w = { 0 };
+	char p2pmem[PATH_MAX];
+	struct nvme_io_stats stats;
+	enum nvme_print_flags flags;
 	__u16 control = 0;
-	int err;
-
-	const char *desc =
-	    "The Write Zeroes command is used to set a range of logical blocks to zero.";
-	const char *deac =
-	    "Set DEAC bit, requesting controller to deallocate specified logical blocks";
-	const char *storage_tag_check =
-	    "This bit specifies the Storage Tag field shall be checked as\n"
-	    "part of end-to-end data protection processing";
+	__u32 dsmgmt = 0;
+	unsigned int line;
+	int err, opcode, nr;
+	char **paths;
+	FILE *f;
 
 	struct config {
+		char	*io_mode;
 		__u32	namespace_id;
 		__u64	start_block;
 		__u16	block_count;
-		__u8	dtype;
-		bool	deac;
-		bool	limited_retry;
-		bool	force_unit_access;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u64	io_count;
+		__u32	runtime;
+		bool	random;
+		char	*data;
 		__u8	prinfo;
 		__u64	ref_tag;
 		__u16	app_tag_mask;
 		__u16	app_tag;
 		__u64	storage_tag;
+		bool	limited_retry;
+		bool	force_unit_access;
 		bool	storage_tag_check;
+		__u8	dtype;
 		__u16	dspec;
+		__u8	dsmgmt;
+		bool	force;
+		bool	poll;
+		bool	cmb;
+		__u16	streams;
+		char	*profile;
+		__u32	interval;
 	};
 
 	struct config cfg = {
+		.io_mode		= "read",
 		.namespace_id		= 0,
 		.start_block		= 0,
 		.block_count		= 0,
-		.dtype				= 0,
-		.deac				= false,
-		.limited_retry		= false,
-		.force_unit_access	= false,
-		.prinfo				= 0,
-		.ref_tag			= 0,
+		.io_range		= 0,
+		.queue_depth		= 32,
+		.threads		= 1,
+		.io_count		= 0,
+		.runtime		= 0,
+		.random			= false,
+		.data			= "",
+		.prinfo			= 0,
+		.ref_tag		= 0,
 		.app_tag_mask		= 0,
-		.app_tag			= 0,
+		.app_tag		= 0,
 		.storage_tag		= 0,
+		.limited_retry		= false,
+		.force_unit_access	= false,
 		.storage_tag_check	= false,
-		.dspec				= 0,
+		.dtype			= 0,
+		.dspec			= 0,
+		.dsmgmt			= 0,
+		.force			= false,
+		.poll			= false,
+		.cmb			= false,
+		.streams		= 0,
+		.profile		= "",
+		.interval		= 0,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_desired),
+		  OPT_STR("io-mode",            'i', &cfg.io_mode,           io_mode),
+		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_id_desired),
 		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block),
 		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
-		  OPT_BYTE("dir-type",          'T', &cfg.dtype,             dtype),
-		  OPT_FLAG("deac",              'd', &cfg.deac,              deac),
-		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry),
-		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access),
+		  OPT_SUFFIX("io-range",        'L', &cfg.io_range,          io_range),
+		  OPT_UINT("queue-depth",       'q', &cfg.queue_depth,       queue_depth),
+		  OPT_UINT("threads",           'j', &cfg.threads,           threads),
+		  OPT_SUFFIX("io-count",        'N', &cfg.io_count,          io_count),
+		  OPT_UINT("runtime",           'R', &cfg.runtime,           runtime),
+		  OPT_FLAG("random",            'x', &cfg.random,            random_lba),
+		  OPT_FILE("data",              'd', &cfg.data,              data),
 		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
 		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
 		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
 		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
-		  OPT_SUFFIX("storage-tag",     'S', &cfg.storage_tag,       storage_tag),
+		  OPT_SUFFIX("storage-tag",     'g', &cfg.storage_tag,       storage_tag),
+		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry),
+		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access),
 		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check),
-		  OPT_SHRT("dir-spec",          'D', &cfg.dspec,             dspec_w_dtype));
+		  OPT_BYTE("dir-type",          'T', &cfg.dtype,             dtype_for_write),
+		  OPT_SHRT("dir-spec",          'S', &cfg.dspec,             dspec),
+		  OPT_BYTE("dsm",               'D', &cfg.dsmgmt,            dsm),
+		  OPT_FLAG("force",               0, &cfg.force,             force),
+		  OPT_FLAG("poll",                0, &cfg.poll,              poll),
+		  OPT_FLAG("cmb",                 0, &cfg.cmb,               cmb),
+		  OPT_SHRT("streams",             0, &cfg.streams,           streams),
+		  OPT_FILE("profile",           'P', &cfg.profile,           profile),
+		  OPT_UINT("interval",          'I', &cfg.interval,          interval));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.prinfo > 0xf)
-		return -EINVAL;
-
-	if (cfg.dtype > 0xf) {
-		nvme_show_error("Invalid directive type, %x", cfg.dtype);
+	if (!strcmp(cfg.io_mode, "read")) {
+		opcode = nvme_cmd_read;
+	} else if (!strcmp(cfg.io_mode, "write")) {
+		opcode = nvme_cmd_write;
+	} else if (!strcmp(cfg.io_mode, "compare")) {
+		opcode = nvme_cmd_compare;
+	} else {
+		nvme_show_error("Invalid io-mode: %s", cfg.io_mode);
 		return -EINVAL;
 	}
 
-	control |= (cfg.prinfo << 10);
-	if (cfg.limited_retry)
-		control |= NVME_IO_LR;
-	if (cfg.force_unit_access)
-		control |= NVME_IO_FUA;
-	if (cfg.deac)
-		control |= NVME_IO_DEAC;
-	if (cfg.storage_tag_check)
-		control |= NVME_IO_STC;
-	control |= (cfg.dtype << 4);
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+	if (strlen(cfg.profile)) {
+		if (cfg.streams || strlen(cfg.data)) {
+			nvme_show_error("--profile can't be combined with --streams or --data");
+			return -EINVAL;
+		}
+
+		f = fopen(cfg.profile, "r");
+		if (!f) {
+			nvme_show_perror(cfg.profile);
+			return -errno;
+		}
+		err = nvme_workload_load(f, &w, &line);
+		fclose(f);
+		if (err == -EINVAL) {
+			nvme_show_error("%s: line %u: invalid workload phase", cfg.profile, line);
+			return err;
+		} else if (err) {
+			nvme_show_error("%s: %s", cfg.profile, nvme_strerror(-err));
 			return err;
 		}
+		/* the profile writes whatever io-mode says */
+		opcode = nvme_cmd_write;
 	}
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
-		return -ENOMEM;
-
-	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	err = validate_output_format(output_format_val, &flags);
 	if (err < 0) {
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_status(err);
+		nvme_show_error("Invalid output format");
 		return err;
 	}
 
-	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
-	if (!nvm_ns)
-		return -ENOMEM;
-
-	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id, 0, NVME_CSI_NVM, nvm_ns);
-	if (!err) {
-		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
-		sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
-		pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
+	if (!cfg.queue_depth || !cfg.threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
 	}
 
-	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
+	if (cfg.prinfo > 0xf)
 		return -EINVAL;
 
-	struct nvme_io_args args = {
-		.args_size	= sizeof(args),
-		.fd			= dev_fd(dev),
+	if (cfg.streams && (opcode != nvme_cmd_write || cfg.dtype)) {
+		nvme_show_error("--streams tags writes and can't be combined with --dir-type");
+		return -EINVAL;
+	}
+
+	err = io_build_control(cfg.prinfo, cfg.limited_retry, cfg.force_unit_access,
+			       cfg.storage_tag_check, cfg.dtype, cfg.dspec, cfg.dsmgmt,
+			       &control, &dsmgmt);
+	if (err)
+		return err;
+
+	struct nvme_io_job job = {
 		.nsid		= cfg.namespace_id,
+		.opcode		= opcode,
 		.slba		= cfg.start_block,
+		.nr_lbas	= cfg.io_range,
 		.nlb		= cfg.block_count,
 		.control	= control,
-		.reftag_u64	= cfg.ref_tag,
+		.dsmgmt		= dsmgmt,
+		.reftag		= cfg.ref_tag,
 		.apptag		= cfg.app_tag,
 		.appmask	= cfg.app_tag_mask,
-		.sts		= sts,
-		.pif		= pif,
 		.storage_tag	= cfg.storage_tag,
-		.dspec		= cfg.dspec,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.nr_ios		= cfg.io_count,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
+		.poll		= cfg.poll,
+		.ops		= cfg.streams ? &io_bench_stream_ops : NULL,
+		.priv		= &cfg.streams,
 	};
-	err = nvme_write_zeros(&args);
-	if (err < 0)
-		nvme_show_error("write-zeroes: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVME Write Zeroes Success\n");
-
-	return err;
-}
 
-static int dsm(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc = "The Dataset Management command is used by the host to\n"
-		"indicate attributes for ranges of logical blocks. This includes attributes\n"
-		"for discarding unused blocks, data read and write frequency, access size, and other\n"
-		"information that may be used to optimize performance and reliability.";
-	const char *blocks = "Comma separated list of the number of blocks in each range";
-	const char *starting_blocks = "Comma separated list of the starting block in each range";
-	const char *context_attrs = "Comma separated list of the context attributes in each range";
-	const char *ad = "Attribute Deallocate";
-	const char *idw = "Attribute Integral Dataset for Write";
-	const char *idr = "Attribute Integral Dataset for Read";
-	const char *cdw11 = "All the command DWORD 11 attributes. Use instead of specifying individual attributes";
+	if (argc - optind > 1 || (optind < argc && !strcmp(argv[optind], "all"))) {
+		if (w.nr || cfg.cmb) {
+			nvme_show_error("--profile and --cmb take a single namespace");
+			return -EINVAL;
+		}
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_dsm_range *dsm = NULL;
-	uint16_t nr, nc, nb, ns;
-	__u32 ctx_attrs[256] = {0,};
-	__u32 nlbs[256] = {0,};
-	__u64 slbas[256] = {0,};
-	int err;
+		if (!strcmp(argv[optind], "all")) {
+			err = ns_paths_scan(&paths, &nr);
+			if (err) {
+				nvme_show_error("Failed to scan topology: %s", nvme_strerror(-err));
+				ctrl_paths_free(paths, nr);
+				return err;
+			}
+			if (!nr) {
+				nvme_show_error("no namespaces found");
+				return -ENODEV;
+			}
+		} else {
+			err = ctrl_paths_get(argc, argv, &paths, &nr);
+			if (err) {
+				ctrl_paths_free(paths, nr);
+				return err;
+			}
+		}
 
-	struct config {
-		__u32	namespace_id;
-		char	*ctx_attrs;
-		char	*blocks;
-		char	*slbas;
-		bool	ad;
-		bool	idw;
-		bool	idr;
-		__u32	cdw11;
-	};
+		err = io_bench_multi(paths, nr, &job,
+				     opcode == nvme_cmd_write && !cfg.force ? O_RDONLY | O_EXCL : O_RDONLY,
+				     cfg.prinfo, cfg.data, cfg.poll, cfg.interval, flags);
+		ctrl_paths_free(paths, nr);
+		return err;
+	}
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.ctx_attrs	= "",
-		.blocks		= "",
-		.slbas		= "",
-		.ad		= false,
-		.idw		= false,
-		.idr		= false,
-		.cdw11		= 0,
-	};
+	if (opcode == nvme_cmd_write) {
+		err = open_exclusive(&dev, argc, argv, cfg.force);
+		if (err) {
+			if (errno == EBUSY) {
+				fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
+				fprintf(stderr, "Namespace is currently busy.\n");
+				if (!cfg.force)
+					fprintf(stderr,
+						"Use the force [--force] option to ignore that.\n");
+			} else {
+				argconfig_print_help(desc, opts);
+			}
+			return err;
+		}
+	} else {
+		err = get_dev(&dev, argc, argv, O_RDONLY);
+		if (err) {
+			argconfig_print_help(desc, opts);
+			return err;
+		}
+	}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
-		  OPT_LIST("ctx-attrs",    'a', &cfg.ctx_attrs,    context_attrs),
-		  OPT_LIST("blocks",       'b', &cfg.blocks,       blocks),
-		  OPT_LIST("slbs",         's', &cfg.slbas,        starting_blocks),
-		  OPT_FLAG("ad",           'd', &cfg.ad,           ad),
-		  OPT_FLAG("idw",          'w', &cfg.idw,          idw),
-		  OPT_FLAG("idr",          'r', &cfg.idr,          idr),
-		  OPT_UINT("cdw11",        'c', &cfg.cdw11,        cdw11));
+	if (cfg.cmb) {
+		if (cmb_p2pmem(dev, p2pmem, sizeof(p2pmem)))
+			return -errno;
+		job.cmb = p2pmem;
+	}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = io_bench_ns_setup(dev, &job, cfg.prinfo, cfg.data, &pattern, &gfd);
 	if (err)
 		return err;
 
-	nc = argconfig_parse_comma_sep_array_u32(cfg.ctx_attrs, ctx_attrs, ARRAY_SIZE(ctx_attrs));
-	nb = argconfig_parse_comma_sep_array_u32(cfg.blocks, nlbs, ARRAY_SIZE(nlbs));
-	ns = argconfig_parse_comma_sep_array_u64(cfg.slbas, slbas, ARRAY_SIZE(slbas));
-	nr = max(nc, max(nb, ns));
-	if (!nr || nr > 256) {
-		nvme_show_error("No range definition provided");
-		return -EINVAL;
-	}
+	if (cfg.poll)
+		io_poll_check(dev);
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	if (w.nr)
+		err = io_bench_profile(&job, &w, &stats);
+	else
+		err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	if (err == -ENOTSUP && cfg.poll) {
+		nvme_show_error("io-bench: polled passthrough needs Linux 6.1 or later");
+		return err;
+	} else if (err < 0 && cfg.cmb) {
+		nvme_show_error("io-bench: controller memory buffer: %s",
+				nvme_strerror(-err));
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("io-bench: %s", nvme_strerror(-err));
+		return err;
 	}
-	if (!cfg.cdw11)
-		cfg.cdw11 = (cfg.ad << 2) | (cfg.idw << 1) | (cfg.idr << 0);
 
-	dsm = nvme_alloc(sizeof(*dsm) * 256);
-	if (!dsm)
-		return -ENOMEM;
+	if (!stats.uring && cfg.queue_depth > 1)
+		fprintf(stderr,
+			"io_uring passthrough not available, ran with queue depth 1\n");
 
-	nvme_init_dsm_range(dsm, ctx_attrs, nlbs, slbas, nr);
-	struct nvme_dsm_args args = {
+	nvme_show_io_stats("io-bench", &stats, flags);
+
+	return stats.errors ? -EIO : 0;
+}
+
+static int power_feature_get(struct nvme_dev *dev, __u8 fid, void *data, __u32 len,
+			     __u32 *result)
+{
+	struct nvme_get_features_args args = {
+		.args_size	= sizeof(args),
+		.fid		= fid,
+		.sel		= NVME_GET_FEATURES_SEL_CURRENT,
+		.data_len	= len,
+		.data		= data,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= result,
+	};
+
+	return nvme_cli_get_features(dev, &args);
+}
+
+static int power_feature_set(struct nvme_dev *dev, __u8 fid, __u32 cdw11, void *data,
+			     __u32 len)
+{
+	struct nvme_set_features_args args = {
 		.args_size	= sizeof(args),
 		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.attrs		= cfg.cdw11,
-		.nr_ranges	= nr,
-		.dsm		= dsm,
+		.fid		= fid,
+		.cdw11		= cdw11,
+		.data_len	= len,
+		.data		= data,
 		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
 		.result		= NULL,
 	};
-	err = nvme_dsm(&args);
-	if (err < 0)
-		nvme_show_error("data-set management: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVMe DSM: success\n");
 
-	return err;
+	return nvme_set_features(&args);
 }
 
-static int copy_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static void power_bench_run(struct nvme_io_job *job, struct nvme_power_bench_run *r)
 {
-	const char *desc = "The Copy command is used by the host to copy data\n"
-		"from one or more source logical block ranges to a\n"
-		"single consecutive destination logical block range.";
-	const char *d_sdlba = "64-bit addr of first destination logical block";
-	const char *d_slbas = "64-bit addr of first block per range (comma-separated list)";
-	const char *d_nlbs = "number of blocks per range (comma-separated list, zeroes-based values)";
-	const char *d_snsids = "source namespace identifier per range (comma-separated list)";
-	const char *d_sopts = "source options per range (comma-separated list)";
-	const char *d_lr = "limited retry";
-	const char *d_fua = "force unit access";
-	const char *d_prinfor = "protection information and check field (read part)";
-	const char *d_prinfow = "protection information and check field (write part)";
-	const char *d_ilbrt = "initial lba reference tag (write part)";
-	const char *d_eilbrts = "expected lba reference tags (read part, comma-separated list)";
-	const char *d_lbat = "lba application tag (write part)";
-	const char *d_elbats = "expected lba application tags (read part, comma-separated list)";
-	const char *d_lbatm = "lba application tag mask (write part)";
-	const char *d_elbatms = "expected lba application tag masks (read part, comma-separated list)";
-	const char *d_dtype = "directive type (write part)";
-	const char *d_dspec = "directive specific (write part)";
-	const char *d_format = "source range entry format";
-
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	__u16 nr, nb, ns, nrts, natms, nats, nids;
-	__u16 nlbs[256] = { 0 };
-	__u64 slbas[256] = { 0 };
-	__u32 snsids[256] = { 0 };
-	__u16 sopts[256] = { 0 };
+	struct nvme_io_stats stats;
 	int err;
 
-	union {
-		__u32 short_pi[256];
-		__u64 long_pi[256];
-	} eilbrts;
+	err = nvme_io_engine_run(job, &stats);
+	if (err < 0) {
+		r->err = err;
+		return;
+	}
+	if (stats.errors) {
+		r->err = stats.first_err;
+		return;
+	}
 
-	__u32 elbatms[256] = { 0 };
-	__u32 elbats[256] = { 0 };
+	if (stats.elapsed_ns) {
+		r->iops = stats.ios * NSEC_PER_SEC / stats.elapsed_ns;
+		r->bytes_per_sec = (double)stats.bytes * NSEC_PER_SEC / stats.elapsed_ns;
+	}
+	r->p50_ns = nvme_hist_percentile(&stats.lat, 50);
+	r->p99_ns = nvme_hist_percentile(&stats.lat, 99);
+}
 
-	union {
-		struct nvme_copy_range f0[256];
-		struct nvme_copy_range_f1 f1[256];
-		struct nvme_copy_range_f2 f2[256];
-		struct nvme_copy_range_f3 f3[256];
-	} *copy;
+/*
+ * power-bench: APST is disabled so that the controller stays in the power
+ * state set for each run, the power management and APST features are
+ * restored at the end. Non-operational states aren't measured, the
+ * controller leaves them as soon as I/O arrives.
+ */
+static int power_bench(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "For every power state of the controller, and with APST enabled,\n"
+		"run a read workload of io-bench and report the throughput and\n"
+		"latency next to the power and latencies the controller advertises.";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *runtime = "run time in seconds in every power state";
+	const char *io_range = "number of LBAs to spread the commands over";
+	const char *random_lba = "use random instead of sequential LBAs";
+
+	_cleanup_free_ struct nvme_feat_auto_pst *apst = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_power_bench *pb = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_file_ int gfd = -1;
+	struct nvme_power_bench_run *r;
+	struct nvme_id_psd *psd;
+	enum nvme_print_flags flags;
+	__u32 pm = 0, apst_res = 0;
+	bool apsta;
+	__u8 lba_index;
+	int i, err, rerr;
 
 	struct config {
 		__u32	namespace_id;
-		__u64	sdlba;
-		char	*slbas;
-		char	*nlbs;
-		char	*snsids;
-		char	*sopts;
-		bool	lr;
-		bool	fua;
-		__u8	prinfow;
-		__u8	prinfor;
-		__u64	ilbrt;
-		char	*eilbrts;
-		__u16	lbat;
-		char	*elbats;
-		__u16	lbatm;
-		char	*elbatms;
-		__u8	dtype;
-		__u16	dspec;
-		__u8	format;
+		__u16	block_count;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
+		bool	random;
 	};
 
 	struct config cfg = {
 		.namespace_id	= 0,
-		.sdlba		= 0,
-		.slbas		= "",
-		.nlbs		= "",
-		.snsids		= "",
-		.sopts		= "",
-		.lr		= false,
-		.fua		= false,
-		.prinfow	= 0,
-		.prinfor	= 0,
-		.ilbrt		= 0,
-		.eilbrts	= "",
-		.lbat		= 0,
-		.elbats		= "",
-		.lbatm		= 0,
-		.elbatms	= "",
-		.dtype		= 0,
-		.dspec		= 0,
-		.format		= 0,
+		.block_count	= 0,
+		.io_range	= 0,
+		.queue_depth	= 32,
+		.threads	= 1,
+		.runtime	= 5,
+		.random		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",           'n', &cfg.namespace_id,	namespace_id_desired),
-		  OPT_SUFFIX("sdlba",                'd', &cfg.sdlba,		d_sdlba),
-		  OPT_LIST("slbs",                   's', &cfg.slbas,		d_slbas),
-		  OPT_LIST("blocks",                 'b', &cfg.nlbs,		d_nlbs),
-		  OPT_LIST("snsids",                 'N', &cfg.snsids,		d_snsids),
-		  OPT_LIST("sopts",                  'O', &cfg.sopts,		d_sopts),
-		  OPT_FLAG("limited-retry",          'l', &cfg.lr,		d_lr),
-		  OPT_FLAG("force-unit-access",      'f', &cfg.fua,		d_fua),
-		  OPT_BYTE("prinfow",                'p', &cfg.prinfow,		d_prinfow),
-		  OPT_BYTE("prinfor",                'P', &cfg.prinfor,		d_prinfor),
-		  OPT_SUFFIX("ref-tag",              'r', &cfg.ilbrt,		d_ilbrt),
-		  OPT_LIST("expected-ref-tags",      'R', &cfg.eilbrts,		d_eilbrts),
-		  OPT_SHRT("app-tag",                'a', &cfg.lbat,		d_lbat),
-		  OPT_LIST("expected-app-tags",      'A', &cfg.elbats,		d_elbats),
-		  OPT_SHRT("app-tag-mask",           'm', &cfg.lbatm,		d_lbatm),
-		  OPT_LIST("expected-app-tag-masks", 'M', &cfg.elbatms,		d_elbatms),
-		  OPT_BYTE("dir-type",               'T', &cfg.dtype,		d_dtype),
-		  OPT_SHRT("dir-spec",               'S', &cfg.dspec,		d_dspec),
-		  OPT_BYTE("format",                 'F', &cfg.format,		d_format));
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_SHRT("block-count",  'c', &cfg.block_count,  block_count),
+		  OPT_SUFFIX("io-range",   'L', &cfg.io_range,     io_range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      threads),
+		  OPT_UINT("runtime",      'R', &cfg.runtime,      runtime),
+		  OPT_FLAG("random",       'x', &cfg.random,       random_lba));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	nb = argconfig_parse_comma_sep_array_u16(cfg.nlbs, nlbs, ARRAY_SIZE(nlbs));
-	ns = argconfig_parse_comma_sep_array_u64(cfg.slbas, slbas, ARRAY_SIZE(slbas));
-	nids = argconfig_parse_comma_sep_array_u32(cfg.snsids, snsids, ARRAY_SIZE(snsids));
-	argconfig_parse_comma_sep_array_u16(cfg.sopts, sopts, ARRAY_SIZE(sopts));
-
-	if (cfg.format == 0 || cfg.format == 2) {
-		nrts = argconfig_parse_comma_sep_array_u32(cfg.eilbrts, eilbrts.short_pi,
-							   ARRAY_SIZE(eilbrts.short_pi));
-	} else if (cfg.format == 1 || cfg.format == 3) {
-		nrts = argconfig_parse_comma_sep_array_u64(cfg.eilbrts, eilbrts.long_pi,
-							   ARRAY_SIZE(eilbrts.long_pi));
-	} else {
-		nvme_show_error("invalid format");
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
 		return -EINVAL;
 	}
 
-	natms = argconfig_parse_comma_sep_array_u32(cfg.elbatms, elbatms, ARRAY_SIZE(elbatms));
-	nats = argconfig_parse_comma_sep_array_u32(cfg.elbats, elbats, ARRAY_SIZE(elbats));
-
-	nr = max(nb, max(ns, max(nrts, max(natms, nats))));
-	if (cfg.format == 2 || cfg.format == 3) {
-		if (nr != nids) {
-			nvme_show_error("formats 2 and 3 require source namespace ids for each source range");
-			return -EINVAL;
-		}
-	} else if (nids) {
-		nvme_show_error("formats 0 and 1 do not support cross-namespace copy");
-		return -EINVAL;
-	}
-	if (!nr || nr > 256) {
-		nvme_show_error("invalid range");
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime) {
+		nvme_show_error("queue-depth, threads and runtime must be non-zero");
 		return -EINVAL;
 	}
 
@@ -7257,140 +19780,420 @@ static int copy_cmd(int argc, char **argv, struct command *cmd, struct plugin *p
 		}
 	}
 
-	copy = nvme_alloc(sizeof(*copy));
-	if (!copy)
-		return -ENOMEM;
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	ns = nvme_alloc(sizeof(*ns));
+	apst = nvme_alloc(sizeof(*apst));
+	pb = calloc(1, sizeof(*pb));
+	if (!ctrl || !ns || !apst || !pb)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	struct nvme_io_job job = {
+		.nsid		= cfg.namespace_id,
+		.opcode		= nvme_cmd_read,
+		.nr_lbas	= cfg.io_range,
+		.nlb		= cfg.block_count,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
+	};
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job.lba_size = 1 << ns->lbaf[lba_index].ds;
+	if (NVME_FLBAS_META_EXT(ns->flbas))
+		job.lba_size += ns->lbaf[lba_index].ms;
+	else
+		job.ms = ns->lbaf[lba_index].ms;
+	if (!job.nr_lbas)
+		job.nr_lbas = le64_to_cpu(ns->nsze);
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		nvme_show_error("power-bench requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
+	}
+	job.fd = gfd;
+
+	/* the settings the controller is put back to */
+	err = power_feature_get(dev, NVME_FEAT_FID_POWER_MGMT, NULL, 0, &pm);
+	if (err)
+		goto err;
+	apsta = ctrl->apsta & 0x1;
+	if (apsta) {
+		err = power_feature_get(dev, NVME_FEAT_FID_AUTO_PST, apst, sizeof(*apst),
+					&apst_res);
+		if (!err)
+			err = power_feature_set(dev, NVME_FEAT_FID_AUTO_PST, 0, apst,
+						sizeof(*apst));
+		if (err)
+			goto err;
+	}
+
+	pb->name = dev->name;
+	pb->runtime = cfg.runtime;
+	pb->queue_depth = cfg.queue_depth;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+
+	for (i = 0; i <= ctrl->npss && i < ARRAY_SIZE(ctrl->psd) && !nvme_stopped(); i++) {
+		psd = &ctrl->psd[i];
+		r = &pb->runs[pb->nr++];
+		r->ps = i;
+		r->nops = psd->flags & NVME_PSD_FLAGS_NOPS;
+		/* in 0.0001 W with MXPS, in 0.01 W otherwise */
+		r->max_power_uw = le16_to_cpu(psd->mp) *
+			(psd->flags & NVME_PSD_FLAGS_MXPS ? 100 : 10000);
+		r->enlat = le32_to_cpu(psd->enlat);
+		r->exlat = le32_to_cpu(psd->exlat);
+		if (r->nops)
+			continue;
+
+		err = power_feature_set(dev, NVME_FEAT_FID_POWER_MGMT, i, NULL, 0);
+		if (err) {
+			r->err = err > 0 ? err : -errno;
+			continue;
+		}
+		power_bench_run(&job, r);
+	}
+
+	if (apsta && !nvme_stopped()) {
+		r = &pb->runs[pb->nr++];
+		r->ps = -1;
+		err = power_feature_set(dev, NVME_FEAT_FID_POWER_MGMT, pm, NULL, 0);
+		if (!err)
+			err = power_feature_set(dev, NVME_FEAT_FID_AUTO_PST, 1, apst,
+						sizeof(*apst));
+		if (err)
+			r->err = err > 0 ? err : -errno;
+		else
+			power_bench_run(&job, r);
+	}
+
+	nvme_stop_release();
+
+	err = power_feature_set(dev, NVME_FEAT_FID_POWER_MGMT, pm, NULL, 0);
+	if (apsta) {
+		rerr = power_feature_set(dev, NVME_FEAT_FID_AUTO_PST, apst_res & 0x1, apst,
+					 sizeof(*apst));
+		if (!err)
+			err = rerr;
+	}
+	if (err) {
+		nvme_show_error("power-bench: failed to restore the power settings");
+		goto err;
+	}
+
+	nvme_show_power_bench(pb, flags);
+
+	for (i = 0; i < pb->nr; i++)
+		if (pb->runs[i].err)
+			return pb->runs[i].err;
+	return 0;
+err:
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("power-bench: %s", nvme_strerror(errno));
+	return err;
+}
 
-	if (cfg.format == 0)
-		nvme_init_copy_range(copy->f0, nlbs, slbas, eilbrts.short_pi, elbatms, elbats, nr);
-	else if (cfg.format == 1)
-		nvme_init_copy_range_f1(copy->f1, nlbs, slbas, eilbrts.long_pi, elbatms, elbats, nr);
-	else if (cfg.format == 2)
-		nvme_init_copy_range_f2(copy->f2, snsids, nlbs, slbas, sopts, eilbrts.short_pi, elbatms,
-					elbats, nr);
-	else if (cfg.format == 3)
-		nvme_init_copy_range_f3(copy->f3, snsids, nlbs, slbas, sopts, eilbrts.long_pi, elbatms,
-					elbats, nr);
+/* busy time of all CPUs from /proc/stat, interrupt handling included */
+static int cpu_busy_ns(__u64 *ns)
+{
+	unsigned long long v[8] = { 0 };
+	FILE *f = fopen("/proc/stat", "r");
+	int n;
 
-	struct nvme_copy_args args = {
+	if (!f)
+		return -errno;
+	n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1], &v[2],
+		   &v[3], &v[4], &v[5], &v[6], &v[7]);
+	fclose(f);
+	if (n < 4)
+		return -EIO;
+
+	/* all but idle and iowait, in clock ticks */
+	*ns = (v[0] + v[1] + v[2] + v[5] + v[6] + v[7]) * (NSEC_PER_SEC / sysconf(_SC_CLK_TCK));
+	return 0;
+}
+
+static int tune_feature_set(struct nvme_dev *dev, __u8 fid, __u32 cdw11, bool save)
+{
+	struct nvme_set_features_args args = {
 		.args_size	= sizeof(args),
 		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.copy		= copy->f0,
-		.sdlba		= cfg.sdlba,
-		.nr		= nr,
-		.prinfor	= cfg.prinfor,
-		.prinfow	= cfg.prinfow,
-		.dtype		= cfg.dtype,
-		.dspec		= cfg.dspec,
-		.format		= cfg.format,
-		.lr		= cfg.lr,
-		.fua		= cfg.fua,
-		.ilbrt_u64	= cfg.ilbrt,
-		.lbatm		= cfg.lbatm,
-		.lbat		= cfg.lbat,
+		.fid		= fid,
+		.cdw11		= cdw11,
+		.save		= save,
 		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
 		.result		= NULL,
 	};
-	err = nvme_copy(&args);
-	if (err < 0)
-		nvme_show_error("NVMe Copy: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVMe Copy: success\n");
 
-	return err;
+	return nvme_set_features(&args);
 }
 
-static int flush_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static __u32 tune_coalesce(const struct nvme_tune_point *p)
 {
-	const char *desc = "Commit data and metadata associated with\n"
-		"given namespaces to nonvolatile media. Applies to all commands\n"
-		"finished before the flush was submitted. Additional data may also be\n"
-		"flushed by the controller, from any namespace, depending on controller and\n"
-		"associated namespace status.";
+	return p->agg_time << 8 | p->agg_thr;
+}
 
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+static __u32 tune_arbitration(const struct nvme_tune_point *p)
+{
+	return (__u32)p->hpw << 24 | p->mpw << 16 | p->lpw << 8 | p->burst;
+}
+
+static void tune_run(struct nvme_dev *dev, struct nvme_io_job *job, struct nvme_tune_point *p)
+{
+	struct nvme_io_stats stats;
+	__u64 busy, busy_end;
 	int err;
 
-	struct config {
-		__u32	namespace_id;
-	};
+	err = tune_feature_set(dev, NVME_FEAT_FID_IRQ_COALESCE, tune_coalesce(p), false);
+	if (!err)
+		err = tune_feature_set(dev, NVME_FEAT_FID_ARBITRATION, tune_arbitration(p),
+				       false);
+	if (err) {
+		p->err = err > 0 ? err : -errno;
+		return;
+	}
 
-	struct config cfg = {
-		.namespace_id	= 0,
-	};
+	err = cpu_busy_ns(&busy);
+	if (!err)
+		err = nvme_io_engine_run(job, &stats);
+	if (!err)
+		err = cpu_busy_ns(&busy_end);
+	if (err < 0) {
+		p->err = err;
+		return;
+	}
+	if (stats.errors) {
+		p->err = stats.first_err;
+		return;
+	}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired));
+	if (stats.elapsed_ns)
+		p->iops = stats.ios * NSEC_PER_SEC / stats.elapsed_ns;
+	if (stats.ios)
+		p->cpu_ns = (busy_end - busy) / stats.ios;
+	p->p99_ns = nvme_hist_percentile(&stats.lat, 99);
+}
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+/* @a is at least as good as @b in every metric and better in one */
+static bool tune_dominates(const struct nvme_tune_point *a, const struct nvme_tune_point *b)
+{
+	if (a->iops < b->iops || a->cpu_ns > b->cpu_ns || a->p99_ns > b->p99_ns)
+		return false;
+	return a->iops > b->iops || a->cpu_ns < b->cpu_ns || a->p99_ns < b->p99_ns;
+}
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+static void tune_pareto(struct nvme_tune_point *p, int nr)
+{
+	int i, k;
+
+	for (i = 0; i < nr; i++) {
+		p[i].pareto = !p[i].err;
+		for (k = 0; k < nr && p[i].pareto; k++)
+			if (k != i && !p[k].err && tune_dominates(&p[k], &p[i]))
+				p[i].pareto = false;
 	}
+}
 
-	err = nvme_flush(dev_fd(dev), cfg.namespace_id);
-	if (err < 0)
-		nvme_show_error("flush: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVMe Flush: success\n");
+/* the best Pareto optimal point in @metric, -1 if there is none */
+static int tune_pick(struct nvme_tune_point *p, int nr, const char *metric)
+{
+	int i, best = -1;
 
-	return err;
+	for (i = 0; i < nr; i++) {
+		if (!p[i].pareto)
+			continue;
+		if (best < 0 ||
+		    (!strcmp(metric, "iops") && p[i].iops > p[best].iops) ||
+		    (!strcmp(metric, "cpu") && p[i].cpu_ns < p[best].cpu_ns) ||
+		    (!strcmp(metric, "p99") && p[i].p99_ns < p[best].p99_ns))
+			best = i;
+	}
+
+	return best;
 }
 
-static int resv_acquire(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* a comma separated list of byte values, @def alone if @list is empty */
+static int tune_list(const char *name, char *list, __u8 max, __u8 def, __u8 *v, int *nr)
 {
-	const char *desc = "Obtain a reservation on a given\n"
-		"namespace. Only one reservation is allowed at a time on a\n"
-		"given namespace, though multiple controllers may register\n"
-		"with that namespace. Namespace reservation will abort with\n"
-		"status Reservation Conflict if the given namespace is already reserved.";
-	const char *prkey = "pre-empt reservation key";
-	const char *racqa = "reservation acquire action";
+	__u32 vals[NVME_TUNE_LIST_MAX];
+	int i, n;
+
+	if (!list || !*list) {
+		v[0] = def;
+		*nr = 1;
+		return 0;
+	}
+
+	n = argconfig_parse_comma_sep_array_u32(list, vals, ARRAY_SIZE(vals));
+	for (i = 0; i < n; i++) {
+		if (vals[i] > max)
+			break;
+		v[i] = vals[i];
+	}
+	if (n <= 0 || i < n) {
+		nvme_show_error("invalid --%s, up to %d values of 0 to %u", name,
+				NVME_TUNE_LIST_MAX, max);
+		return -EINVAL;
+	}
+
+	*nr = n;
+	return 0;
+}
+
+/* <lpw>:<mpw>:<hpw> triples, the current weights if @list is empty */
+static int tune_weights(char *list, __u32 arb, __u8 (*w)[3], int *nr)
+{
+	unsigned int l, m, h;
+	char *tok, *save;
+	int n = 0;
+
+	if (!list || !*list) {
+		w[0][0] = arb >> 8;
+		w[0][1] = arb >> 16;
+		w[0][2] = arb >> 24;
+		*nr = 1;
+		return 0;
+	}
+
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (n == NVME_TUNE_LIST_MAX || sscanf(tok, "%u:%u:%u", &l, &m, &h) != 3 ||
+		    l > 0xff || m > 0xff || h > 0xff) {
+			nvme_show_error("invalid --weights, up to %d <lpw>:<mpw>:<hpw> of 0 to 255",
+					NVME_TUNE_LIST_MAX);
+			return -EINVAL;
+		}
+		w[n][0] = l;
+		w[n][1] = m;
+		w[n][2] = h;
+		n++;
+	}
+
+	*nr = n;
+	return n ? 0 : -EINVAL;
+}
 
+/*
+ * tune-sweep: every point of the grid of coalescing and arbitration
+ * settings gets an io-bench run. The CPU time is that of the whole system
+ * over the run, the completions' interrupts are not accounted to the
+ * process submitting. The features are restored at the end unless the
+ * chosen point is saved.
+ */
+static int tune_sweep(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Run an io-bench workload for every combination of interrupt\n"
+		"coalescing and arbitration settings given, report the IOPS, CPU time\n"
+		"per command and p99 latency of each and the Pareto optimal ones.";
+	const char *agg_time = "comma separated aggregation times, in 100 us";
+	const char *agg_thr = "comma separated aggregation thresholds, zeroes based";
+	const char *burst = "comma separated arbitration bursts, log2, 7 for no limit";
+	const char *weights = "comma separated <lpw>:<mpw>:<hpw> arbitration weights";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *runtime = "run time in seconds of every setting";
+	const char *io_range = "number of LBAs to spread the commands over";
+	const char *random_lba = "use random instead of sequential LBAs";
+	const char *pick = "metric the setting is chosen by: cpu, iops or p99";
+	const char *save = "keep the chosen setting, saved across power cycles";
+
+	/* the lists are parsed in place */
+	char def_times[] = "0,1,2,4,8", def_thrs[] = "0,3,7,15";
+	__u8 times[NVME_TUNE_LIST_MAX], thrs[NVME_TUNE_LIST_MAX], bursts[NVME_TUNE_LIST_MAX];
+	__u8 wts[NVME_TUNE_LIST_MAX][3];
+	_cleanup_free_ struct nvme_tune_point *points = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	_cleanup_file_ int gfd = -1;
+	int nr_times, nr_thrs, nr_bursts, nr_wts, a, b, c, d, i, err, rerr;
+	struct nvme_tune_sweep ts = { 0 };
+	struct nvme_tune_point *p;
+	enum nvme_print_flags flags;
+	__u32 coalesce, arb;
+	__u8 lba_index;
 
 	struct config {
 		__u32	namespace_id;
-		__u64	crkey;
-		__u64	prkey;
-		__u8	rtype;
-		__u8	racqa;
-		bool	iekey;
+		char	*agg_time;
+		char	*agg_thr;
+		char	*burst;
+		char	*weights;
+		__u16	block_count;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
+		bool	random;
+		char	*pick;
+		bool	save;
 	};
 
 	struct config cfg = {
 		.namespace_id	= 0,
-		.crkey		= 0,
-		.prkey		= 0,
-		.rtype		= 0,
-		.racqa		= 0,
-		.iekey		= false,
+		.agg_time	= def_times,
+		.agg_thr	= def_thrs,
+		.burst		= NULL,
+		.weights	= NULL,
+		.block_count	= 0,
+		.io_range	= 0,
+		.queue_depth	= 32,
+		.threads	= 1,
+		.runtime	= 5,
+		.random		= false,
+		.pick		= "cpu",
+		.save		= false,
 	};
 
 	NVME_ARGS(opts,
 		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
-		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
-		  OPT_SUFFIX("prkey",      'p', &cfg.prkey,        prkey),
-		  OPT_BYTE("rtype",        't', &cfg.rtype,        rtype),
-		  OPT_BYTE("racqa",        'a', &cfg.racqa,        racqa),
-		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+		  OPT_LIST("agg-time",     'T', &cfg.agg_time,     agg_time),
+		  OPT_LIST("agg-thr",      't', &cfg.agg_thr,      agg_thr),
+		  OPT_LIST("burst",        'b', &cfg.burst,        burst),
+		  OPT_LIST("weights",      'w', &cfg.weights,      weights),
+		  OPT_SHRT("block-count",  'c', &cfg.block_count,  block_count),
+		  OPT_SUFFIX("io-range",   'L', &cfg.io_range,     io_range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      threads),
+		  OPT_UINT("runtime",      'R', &cfg.runtime,      runtime),
+		  OPT_FLAG("random",       'x', &cfg.random,       random_lba),
+		  OPT_STR("pick",          'p', &cfg.pick,         pick),
+		  OPT_FLAG("save",         's', &cfg.save,         save));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime) {
+		nvme_show_error("queue-depth, threads and runtime must be non-zero");
+		return -EINVAL;
+	}
+	if (strcmp(cfg.pick, "cpu") && strcmp(cfg.pick, "iops") && strcmp(cfg.pick, "p99")) {
+		nvme_show_error("invalid --pick, cpu, iops or p99");
+		return -EINVAL;
+	}
+
 	if (!cfg.namespace_id) {
 		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
 		if (err < 0) {
@@ -7398,75 +20201,339 @@ static int resv_acquire(int argc, char **argv, struct command *cmd, struct plugi
 			return err;
 		}
 	}
-	if (cfg.racqa > 7) {
-		nvme_show_error("invalid racqa:%d", cfg.racqa);
-		return -EINVAL;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ctrl || !ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify: %s", nvme_strerror(errno));
+		return err;
+	}
+	if (cfg.save && !(le16_to_cpu(ctrl->oncs) & NVME_CTRL_ONCS_SAVE_FEATURES)) {
+		nvme_show_error("the controller can't save features");
+		return -ENOTSUP;
 	}
 
-	struct nvme_resv_acquire_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
+	/* the settings the controller is put back to */
+	err = power_feature_get(dev, NVME_FEAT_FID_IRQ_COALESCE, NULL, 0, &coalesce);
+	if (!err)
+		err = power_feature_get(dev, NVME_FEAT_FID_ARBITRATION, NULL, 0, &arb);
+	if (err)
+		goto err;
+
+	err = tune_list("agg-time", cfg.agg_time, 0xff, coalesce >> 8, times, &nr_times);
+	if (!err)
+		err = tune_list("agg-thr", cfg.agg_thr, 0xff, coalesce, thrs, &nr_thrs);
+	if (!err)
+		err = tune_list("burst", cfg.burst, 7, arb & 0x7, bursts, &nr_bursts);
+	if (!err)
+		err = tune_weights(cfg.weights, arb, wts, &nr_wts);
+	if (err)
+		return err;
+
+	ts.nr = nr_times * nr_thrs * nr_bursts * nr_wts;
+	points = calloc(ts.nr, sizeof(*points));
+	if (!points)
+		return -ENOMEM;
+	p = points;
+	for (a = 0; a < nr_times; a++)
+		for (b = 0; b < nr_thrs; b++)
+			for (c = 0; c < nr_bursts; c++)
+				for (d = 0; d < nr_wts; d++, p++) {
+					p->agg_time = times[a];
+					p->agg_thr = thrs[b];
+					p->burst = bursts[c];
+					p->lpw = wts[d][0];
+					p->mpw = wts[d][1];
+					p->hpw = wts[d][2];
+				}
+
+	struct nvme_io_job job = {
 		.nsid		= cfg.namespace_id,
-		.rtype		= cfg.rtype,
-		.racqa		= cfg.racqa,
-		.iekey		= !!cfg.iekey,
-		.crkey		= cfg.crkey,
-		.nrkey		= cfg.prkey,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
+		.opcode		= nvme_cmd_read,
+		.nr_lbas	= cfg.io_range,
+		.nlb		= cfg.block_count,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
 	};
-	err = nvme_resv_acquire(&args);
-	if (err < 0)
-		nvme_show_error("reservation acquire: %s", nvme_strerror(errno));
-	else if (err != 0)
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job.lba_size = 1 << ns->lbaf[lba_index].ds;
+	if (NVME_FLBAS_META_EXT(ns->flbas))
+		job.lba_size += ns->lbaf[lba_index].ms;
+	else
+		job.ms = ns->lbaf[lba_index].ms;
+	if (!job.nr_lbas)
+		job.nr_lbas = le64_to_cpu(ns->nsze);
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		nvme_show_error("tune-sweep requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
+	}
+	job.fd = gfd;
+
+	ts.name = dev->name;
+	ts.runtime = cfg.runtime;
+	ts.queue_depth = cfg.queue_depth;
+	ts.points = points;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	for (i = 0; i < ts.nr && !nvme_stopped(); i++)
+		tune_run(dev, &job, &points[i]);
+	nvme_stop_release();
+	/* the points not run are left out */
+	ts.nr = i;
+
+	tune_pareto(points, ts.nr);
+	ts.chosen = tune_pick(points, ts.nr, cfg.pick);
+
+	if (cfg.save && ts.chosen >= 0) {
+		p = &points[ts.chosen];
+		err = tune_feature_set(dev, NVME_FEAT_FID_IRQ_COALESCE, tune_coalesce(p), true);
+		if (!err)
+			err = tune_feature_set(dev, NVME_FEAT_FID_ARBITRATION,
+					       tune_arbitration(p), true);
+		ts.saved = !err;
+	} else {
+		err = tune_feature_set(dev, NVME_FEAT_FID_IRQ_COALESCE, coalesce, false);
+		rerr = tune_feature_set(dev, NVME_FEAT_FID_ARBITRATION, arb, false);
+		if (!err)
+			err = rerr;
+	}
+	if (err) {
+		nvme_show_error("tune-sweep: failed to %s the features",
+				cfg.save ? "save" : "restore");
+		goto err;
+	}
+
+	nvme_show_tune_sweep(&ts, flags);
+
+	return ts.chosen >= 0 ? 0 : points[0].err;
+err:
+	if (err > 0)
 		nvme_show_status(err);
 	else
-		printf("NVME Reservation Acquire success\n");
+		nvme_show_error("tune-sweep: %s", nvme_strerror(errno));
+	return err;
+}
+
+/* the writes and Flush commands of a flush-bench run */
+struct flush_bench_job {
+	pthread_mutex_t lock;
+	__u32 ratio;		/* writes per Flush, 0 for none */
+	__u64 writes;
+	__u64 bytes;
+	__u64 flushes;
+	struct nvme_hist write_lat;
+	struct nvme_hist flush_lat;
+};
+
+/* every ratio + 1st command is a Flush, whichever thread issues it */
+static bool flush_bench_is_flush(struct flush_bench_job *fb, __u64 seq)
+{
+	return fb->ratio && seq % (fb->ratio + 1) == fb->ratio;
+}
+
+static int flush_bench_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+			    struct nvme_passthru_cmd64 *cmd)
+{
+	struct flush_bench_job *fb = job->priv;
+
+	if (flush_bench_is_flush(fb, seq)) {
+		memset(cmd, 0, sizeof(*cmd));
+		cmd->opcode = nvme_cmd_flush;
+		cmd->nsid = job->nsid;
+	}
+
+	return 0;
+}
+
+static void flush_bench_complete(struct nvme_io_job *job, unsigned int thread,
+				 __u64 seq, void *buf, int status, __u64 result,
+				 __u64 lat_ns)
+{
+	struct flush_bench_job *fb = job->priv;
+
+	/* the failures are accounted by the engine and fail the run */
+	if (status)
+		return;
 
-	return err;
+	pthread_mutex_lock(&fb->lock);
+	if (flush_bench_is_flush(fb, seq)) {
+		fb->flushes++;
+		nvme_hist_add(&fb->flush_lat, lat_ns);
+	} else {
+		fb->writes++;
+		fb->bytes += nvme_io_job_data_len(job);
+		nvme_hist_add(&fb->write_lat, lat_ns);
+	}
+	pthread_mutex_unlock(&fb->lock);
 }
 
-static int resv_register(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static const struct nvme_io_job_ops flush_bench_ops = {
+	.prep		= flush_bench_prep,
+	.complete	= flush_bench_complete,
+};
+
+static void flush_bench_run(struct nvme_io_job *job, struct nvme_flush_bench_run *r)
 {
-	const char *desc = "Register, de-register, or\n"
-		"replace a controller's reservation on a given namespace.\n"
-		"Only one reservation at a time is allowed on any namespace.";
-	const char *nrkey = "new reservation key";
-	const char *rrega = "reservation registration action";
-	const char *cptpl = "change persistence through power loss setting";
+	struct flush_bench_job fb = { .ratio = r->ratio };
+	struct nvme_io_stats stats;
+	int err;
+
+	pthread_mutex_init(&fb.lock, NULL);
+	nvme_hist_init(&fb.write_lat);
+	nvme_hist_init(&fb.flush_lat);
+
+	job->control = r->fua ? NVME_IO_FUA : 0;
+	job->priv = &fb;
+	err = nvme_io_engine_run(job, &stats);
+	pthread_mutex_destroy(&fb.lock);
+	if (err < 0) {
+		r->err = err;
+		return;
+	}
+	if (stats.errors) {
+		r->err = stats.first_err;
+		return;
+	}
+
+	/* the engine counts the Flush commands as data transfers */
+	if (stats.elapsed_ns) {
+		r->iops = fb.writes * NSEC_PER_SEC / stats.elapsed_ns;
+		r->bytes_per_sec = (double)fb.bytes * NSEC_PER_SEC / stats.elapsed_ns;
+	}
+	r->p50_ns = nvme_hist_percentile(&fb.write_lat, 50);
+	r->p99_ns = nvme_hist_percentile(&fb.write_lat, 99);
+	r->flushes = fb.flushes;
+	r->flush_p50_ns = nvme_hist_percentile(&fb.flush_lat, 50);
+	r->flush_p99_ns = nvme_hist_percentile(&fb.flush_lat, 99);
+	r->flush_p999_ns = nvme_hist_percentile(&fb.flush_lat, 99.9);
+}
+
+/*
+ * flush-bench: in each state of the volatile write cache a run of plain
+ * writes, the baseline of the throughput cost, one with a Flush after
+ * every ratio writes for each ratio given and one with FUA writes. The
+ * cache is put back to its state at the start.
+ */
+static int flush_bench(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Interleave Flush commands with the writes of an io-bench\n"
+		"workload at the given ratios, or write with FUA instead, with the\n"
+		"volatile write cache enabled and disabled, and report the flush\n"
+		"latency and the throughput cost against plain writes.";
+	const char *ratios = "comma separated numbers of writes per Flush";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *runtime = "run time in seconds of every run";
+	const char *io_range = "number of LBAs to spread the commands over";
+	const char *random_lba = "use random instead of sequential LBAs";
+	const char *keep_vwc = "measure the current state of the volatile write cache only";
+	const char *force = "The \"I know what I'm doing\" flag, do not enforce exclusive access for write";
 
+	/* the list is parsed in place */
+	char def_ratios[] = "1,8,64";
+	__u32 ratio[NVME_FLUSH_RATIO_MAX];
+	_cleanup_free_ struct nvme_flush_bench *fb = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
+	_cleanup_file_ int gfd = -1;
+	struct nvme_flush_bench_run *r, *base;
+	enum nvme_print_flags flags;
+	__u32 vwc = 0, states[2];
+	int nr_ratios, nr_states, s, k, i, err, serr;
+	__u8 lba_index;
 
 	struct config {
 		__u32	namespace_id;
-		__u64	crkey;
-		__u64	nrkey;
-		__u8	rrega;
-		__u8	cptpl;
-		bool	iekey;
+		char	*ratios;
+		__u16	block_count;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
+		bool	random;
+		bool	keep_vwc;
+		bool	force;
 	};
 
 	struct config cfg = {
 		.namespace_id	= 0,
-		.crkey		= 0,
-		.nrkey		= 0,
-		.rrega		= 0,
-		.cptpl		= false,
+		.ratios		= def_ratios,
+		.block_count	= 0,
+		.io_range	= 0,
+		.queue_depth	= 8,
+		.threads	= 1,
+		.runtime	= 5,
+		.random		= false,
+		.keep_vwc	= false,
+		.force		= false,
 	};
 
 	NVME_ARGS(opts,
 		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
-		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
-		  OPT_SUFFIX("nrkey",      'k', &cfg.nrkey,        nrkey),
-		  OPT_BYTE("rrega",        'r', &cfg.rrega,        rrega),
-		  OPT_BYTE("cptpl",        'p', &cfg.cptpl,        cptpl),
-		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+		  OPT_LIST("ratios",       'r', &cfg.ratios,       ratios),
+		  OPT_SHRT("block-count",  'c', &cfg.block_count,  block_count),
+		  OPT_SUFFIX("io-range",   'L', &cfg.io_range,     io_range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      threads),
+		  OPT_UINT("runtime",      'R', &cfg.runtime,      runtime),
+		  OPT_FLAG("random",       'x', &cfg.random,       random_lba),
+		  OPT_FLAG("keep-vwc",     'k', &cfg.keep_vwc,     keep_vwc),
+		  OPT_FLAG("force",          0, &cfg.force,        force));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
+	err = open_exclusive(&dev, argc, argv, cfg.force);
+	if (err) {
+		if (errno == EBUSY) {
+			fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
+			fprintf(stderr, "Namespace is currently busy.\n");
+			if (!cfg.force)
+				fprintf(stderr,
+					"Use the force [--force] option to ignore that.\n");
+		} else {
+			argconfig_print_help(desc, opts);
+		}
+		return err;
+	}
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime) {
+		nvme_show_error("queue-depth, threads and runtime must be non-zero");
+		return -EINVAL;
+	}
+
+	nr_ratios = argconfig_parse_comma_sep_array_u32(cfg.ratios, ratio, ARRAY_SIZE(ratio));
+	for (i = 0; i < nr_ratios && ratio[i]; i++)
+		;
+	if (nr_ratios <= 0 || i < nr_ratios) {
+		nvme_show_error("invalid --ratios, up to %d non-zero values",
+				NVME_FLUSH_RATIO_MAX);
+		return -EINVAL;
+	}
+
 	if (!cfg.namespace_id) {
 		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
 		if (err < 0) {
@@ -7474,715 +20541,1360 @@ static int resv_register(int argc, char **argv, struct command *cmd, struct plug
 			return err;
 		}
 	}
-	if (cfg.cptpl > 3) {
-		nvme_show_error("invalid cptpl:%d", cfg.cptpl);
-		return -EINVAL;
-	}
 
-	if (cfg.rrega > 7) {
-		nvme_show_error("invalid rrega:%d", cfg.rrega);
-		return -EINVAL;
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	ns = nvme_alloc(sizeof(*ns));
+	fb = calloc(1, sizeof(*fb));
+	if (!ctrl || !ns || !fb)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return err;
+	} else if (err < 0) {
+		nvme_show_error("identify: %s", nvme_strerror(errno));
+		return err;
 	}
 
-	struct nvme_resv_register_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
+	struct nvme_io_job job = {
 		.nsid		= cfg.namespace_id,
-		.rrega		= cfg.rrega,
-		.cptpl		= cfg.cptpl,
-		.iekey		= !!cfg.iekey,
-		.crkey		= cfg.crkey,
-		.nrkey		= cfg.nrkey,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
+		.opcode		= nvme_cmd_write,
+		.nr_lbas	= cfg.io_range,
+		.nlb		= cfg.block_count,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
+		.ops		= &flush_bench_ops,
 	};
-	err = nvme_resv_register(&args);
-	if (err < 0)
-		nvme_show_error("reservation register: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job.lba_size = 1 << ns->lbaf[lba_index].ds;
+	if (NVME_FLBAS_META_EXT(ns->flbas))
+		job.lba_size += ns->lbaf[lba_index].ms;
 	else
-		printf("NVME Reservation  success\n");
+		job.ms = ns->lbaf[lba_index].ms;
+	if (!job.nr_lbas)
+		job.nr_lbas = le64_to_cpu(ns->nsze);
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		nvme_show_error("flush-bench requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
+	}
+	job.fd = gfd;
+
+	/* the state the cache is put back to */
+	fb->vwc_present = ctrl->vwc & NVME_CTRL_VWC_PRESENT;
+	if (fb->vwc_present) {
+		err = power_feature_get(dev, NVME_FEAT_FID_VOLATILE_WC, NULL, 0, &vwc);
+		if (err)
+			goto err;
+	}
+	fb->toggled = fb->vwc_present && !cfg.keep_vwc;
+	if (fb->toggled) {
+		states[0] = 1;
+		states[1] = 0;
+		nr_states = 2;
+	} else {
+		states[0] = vwc & 0x1;
+		nr_states = 1;
+	}
+
+	fb->name = dev->name;
+	fb->runtime = cfg.runtime;
+	fb->queue_depth = cfg.queue_depth;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+
+	for (s = 0; s < nr_states && !nvme_stopped(); s++) {
+		serr = 0;
+		if (fb->toggled) {
+			serr = power_feature_set(dev, NVME_FEAT_FID_VOLATILE_WC, states[s],
+						 NULL, 0);
+			if (serr < 0)
+				serr = -errno;
+		}
+
+		/* plain writes, a Flush every ratio writes and FUA writes */
+		base = &fb->runs[fb->nr];
+		for (k = -1; k <= nr_ratios && !nvme_stopped(); k++) {
+			r = &fb->runs[fb->nr++];
+			r->vwc = states[s];
+			r->fua = k == nr_ratios;
+			r->ratio = k >= 0 && k < nr_ratios ? ratio[k] : 0;
+			if (serr) {
+				r->err = serr;
+				continue;
+			}
+			flush_bench_run(&job, r);
+			if (!base->err && base->iops && r != base)
+				r->cost = 1 - (double)r->iops / base->iops;
+		}
+	}
+
+	nvme_stop_release();
+
+	if (fb->toggled) {
+		err = power_feature_set(dev, NVME_FEAT_FID_VOLATILE_WC, vwc & 0x1, NULL, 0);
+		if (err) {
+			nvme_show_error("flush-bench: failed to restore the volatile write cache");
+			goto err;
+		}
+	}
+
+	nvme_show_flush_bench(fb, flags);
 
+	for (i = 0; i < fb->nr; i++)
+		if (fb->runs[i].err)
+			return fb->runs[i].err;
+	return 0;
+err:
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		nvme_show_error("flush-bench: %s", nvme_strerror(errno));
 	return err;
 }
 
-static int resv_release(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* range benchmarked by default, of PMRs larger than this */
+#define PMR_BENCH_SIZE		(64ULL << 20)
+
+/* after enabling, the PMR accepts accesses once PMRSTS.NRDY clears, in PMRTO */
+static int pmr_enable(void *bar, __u32 pmrcap, bool enable)
 {
-	const char *desc = "Releases reservation held on a\n"
-		"namespace by the given controller. If rtype != current reservation\n"
-		"type, release will fails. If the given controller holds no\n"
-		"reservation on the namespace or is not the namespace's current\n"
-		"reservation holder, the release command completes with no\n"
-		"effect. If the reservation type is not Write Exclusive or\n"
-		"Exclusive Access, all registrants on the namespace except\n"
-		"the issuing controller are notified.";
-	const char *rrela = "reservation release action";
+	__u64 timeout_ms = NVME_PMRCAP_PMRTO(pmrcap) *
+		(NVME_PMRCAP_PMRTU(pmrcap) ? 60000ULL : 500ULL);
+	__u64 deadline = monotonic_ns() + timeout_ms * 1000000ULL;
+	__u32 sts;
+
+	mmio_write32(bar + NVME_REG_PMRCTL, enable);
+	while (enable) {
+		sts = mmio_read32(bar + NVME_REG_PMRSTS);
+		if (NVME_PMRSTS_ERR(sts))
+			return -EIO;
+		if (!NVME_PMRSTS_NRDY(sts))
+			break;
+		if (monotonic_ns() > deadline)
+			return -ETIMEDOUT;
+		usleep(1000);
+	}
+
+	return 0;
+}
+
+/* the read-back of PMRWBM making the stores before it persistent */
+static void pmr_barrier(void *bar, volatile void *pmr, bool pmrsts)
+{
+	nvme_pmr_fence();
+	if (pmrsts)
+		(void)mmio_read32(bar + NVME_REG_PMRSTS);
+	else
+		(void)*(volatile __u64 *)pmr;
+}
+
+static __u64 pmr_bps(__u64 bytes, __u64 ns)
+{
+	return ns ? (double)bytes * NSEC_PER_SEC / ns : 0;
+}
+
+/* map BAR @bir of the controller, write combining if the kernel offers it */
+static void *pmr_map(struct nvme_dev *dev, __u8 bir, bool wc, struct nvme_pmr_bench *pb)
+{
+	char path[PATH_MAX];
+	_cleanup_file_ int fd = -1;
+	struct stat st;
+	void *p;
 
+	snprintf(path, sizeof(path), "/sys/class/nvme/%s/device/resource%u_wc", dev->name, bir);
+	if (wc)
+		fd = open(path, O_RDWR);
+	pb->wc = fd >= 0;
+	if (fd < 0) {
+		path[strlen(path) - 3] = '\0';
+		fd = open(path, O_RDWR);
+	}
+	if (fd < 0 || fstat(fd, &st))
+		return NULL;
+
+	pb->bar_size = st.st_size;
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+/*
+ * pmr-bench: the contents of the range benchmarked are saved first and
+ * written back at the end, also when cut short by SIGINT, and a PMR
+ * enabled for the benchmark is disabled again.
+ */
+static int pmr_bench(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Enable the Persistent Memory Region of the controller if needed,\n"
+		"map it through the PCI BAR of PMRCAP.BIR and measure the load,\n"
+		"store and non-temporal store bandwidth and the latency of\n"
+		"persisting stores with the write barrier the controller advertises.";
+	const char *offset = "byte offset of the range in the PMR";
+	const char *size = "bytes of the range, up to 64M of the PMR by default";
+	const char *passes = "copies of the range per bandwidth measurement";
+	const char *persist_size = "bytes stored before every write barrier read-back";
+	const char *persist_count = "number of persisted stores";
+	const char *uncached = "map the PMR uncached instead of write combining";
+
+	_cleanup_free_ unsigned char *save = NULL, *buf = NULL;
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_pmr_bench pb = { 0 };
+	enum nvme_print_flags flags;
+	unsigned char *pmr = NULL;
+	__u32 pmrcap, wbm;
+	__u64 i, slots, start;
+	struct nvme_hist lat;
+	void *bar = NULL;
+	bool pmrsts;
 	int err;
 
 	struct config {
-		__u32	namespace_id;
-		__u64	crkey;
-		__u8	rtype;
-		__u8	rrela;
-		__u8	iekey;
+		__u64	offset;
+		__u64	size;
+		__u32	passes;
+		__u32	persist_size;
+		__u64	persist_count;
+		bool	uncached;
 	};
 
 	struct config cfg = {
-		.namespace_id	= 0,
-		.crkey		= 0,
-		.rtype		= 0,
-		.rrela		= 0,
-		.iekey		= 0,
+		.offset		= 0,
+		.size		= 0,
+		.passes		= 8,
+		.persist_size	= 64,
+		.persist_count	= 10000,
+		.uncached	= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_desired),
-		  OPT_SUFFIX("crkey",      'c', &cfg.crkey,        crkey),
-		  OPT_BYTE("rtype",        't', &cfg.rtype,        rtype),
-		  OPT_BYTE("rrela",        'a', &cfg.rrela,        rrela),
-		  OPT_FLAG("iekey",        'i', &cfg.iekey,        iekey));
+		  OPT_SUFFIX("offset",      's', &cfg.offset,        offset),
+		  OPT_SUFFIX("size",        'z', &cfg.size,          size),
+		  OPT_UINT("passes",        'p', &cfg.passes,        passes),
+		  OPT_UINT("persist-size",  'b', &cfg.persist_size,  persist_size),
+		  OPT_SUFFIX("persist-count", 'N', &cfg.persist_count, persist_count),
+		  OPT_FLAG("uncached",      'u', &cfg.uncached,      uncached));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
 	}
-	if (cfg.rrela > 7) {
-		nvme_show_error("invalid rrela:%d", cfg.rrela);
+
+	if (!cfg.passes || !cfg.persist_size || cfg.persist_size % 8 ||
+	    cfg.offset % 8 || cfg.size % 8) {
+		nvme_show_error("offset, size and persist-size must be multiples of 8, passes non-zero");
 		return -EINVAL;
 	}
 
-	struct nvme_resv_release_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.rtype		= cfg.rtype,
-		.rrela		= cfg.rrela,
-		.iekey		= !!cfg.iekey,
-		.crkey		= cfg.crkey,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
-	};
-	err = nvme_resv_release(&args);
-	if (err < 0)
-		nvme_show_error("reservation release: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
+	if (dev->type != NVME_DEV_DIRECT) {
+		nvme_show_error("pmr-bench requires a PCIe controller");
+		return -ENODEV;
+	}
+
+	bar = mmap_registers(dev, true);
+	if (!bar) {
+		nvme_show_error("%s: failed to map the controller registers", dev->name);
+		return -ENODEV;
+	}
+
+	if (!NVME_CAP_PMRS(mmio_read64(bar + NVME_REG_CAP))) {
+		nvme_show_error("%s: no Persistent Memory Region", dev->name);
+		err = -ENOTSUP;
+		goto out;
+	}
+
+	pmrcap = mmio_read32(bar + NVME_REG_PMRCAP);
+	pb.bir = NVME_PMRCAP_BIR(pmrcap);
+	wbm = NVME_PMRCAP_PMRWBM(pmrcap);
+	/* a read of the PMR itself is preferred, the registers may be slower */
+	pmrsts = !(wbm & 0x1) && (wbm & 0x2);
+	pb.barrier = wbm & 0x1 ? "pmr read" : wbm & 0x2 ? "pmrsts read" : NULL;
+
+	if (!NVME_PMRCTL_EN(mmio_read32(bar + NVME_REG_PMRCTL))) {
+		err = pmr_enable(bar, pmrcap, true);
+		if (err) {
+			nvme_show_error("%s: enabling the PMR: %s", dev->name,
+					nvme_strerror(-err));
+			pmr_enable(bar, pmrcap, false);
+			goto out;
+		}
+		pb.enabled = true;
+	}
+
+	pmr = pmr_map(dev, pb.bir, !cfg.uncached, &pb);
+	if (!pmr) {
+		err = -errno;
+		nvme_show_error("%s: failed to map BAR %u: %s", dev->name, pb.bir,
+				nvme_strerror(-err));
+		goto disable;
+	}
+
+	if (!cfg.size)
+		cfg.size = min(pb.bar_size - min(cfg.offset, pb.bar_size), PMR_BENCH_SIZE) & ~7ULL;
+	if (!cfg.size || cfg.offset + cfg.size > pb.bar_size || cfg.persist_size > cfg.size) {
+		nvme_show_error("the range and persist-size must fit the %"PRIu64" byte PMR",
+				(uint64_t)pb.bar_size);
+		err = -EINVAL;
+		goto unmap;
+	}
+
+	save = malloc(cfg.size);
+	buf = malloc(cfg.size);
+	if (!save || !buf) {
+		err = -ENOMEM;
+		goto unmap;
+	}
+	for (i = 0; i < cfg.size; i++)
+		buf[i] = i * 31 + 7;
+
+	pb.name = dev->name;
+	pb.offset = cfg.offset;
+	pb.size = cfg.size;
+	pb.passes = cfg.passes;
+	pb.persist_size = cfg.persist_size;
+
+	nvme_pmr_load(save, pmr + cfg.offset, cfg.size);
+
+	nvme_stop_catch(false, NULL);
+
+	start = monotonic_ns();
+	for (i = 0; i < cfg.passes && !nvme_stopped(); i++)
+		nvme_pmr_load(buf, pmr + cfg.offset, cfg.size);
+	pb.load_bps = pmr_bps(i * cfg.size, monotonic_ns() - start);
+
+	/* the stores count once they reached the controller */
+	start = monotonic_ns();
+	for (i = 0; i < cfg.passes && !nvme_stopped(); i++) {
+		nvme_pmr_store(pmr + cfg.offset, buf, cfg.size);
+		pmr_barrier(bar, pmr + cfg.offset, pmrsts);
+	}
+	pb.store_bps = pmr_bps(i * cfg.size, monotonic_ns() - start);
+
+	start = monotonic_ns();
+	for (i = 0; i < cfg.passes && !nvme_stopped(); i++) {
+		pb.nt_native = nvme_pmr_store_nt(pmr + cfg.offset, buf, cfg.size);
+		pmr_barrier(bar, pmr + cfg.offset, pmrsts);
+	}
+	pb.nt_bps = pmr_bps(i * cfg.size, monotonic_ns() - start);
+
+	if (pb.barrier) {
+		nvme_hist_init(&lat);
+		slots = cfg.size / cfg.persist_size;
+		for (i = 0; i < cfg.persist_count && !nvme_stopped(); i++) {
+			unsigned char *p = pmr + cfg.offset + (i % slots) * cfg.persist_size;
+
+			start = monotonic_ns();
+			nvme_pmr_store(p, buf, cfg.persist_size);
+			pmr_barrier(bar, p, pmrsts);
+			nvme_hist_add(&lat, monotonic_ns() - start);
+		}
+		pb.persists = lat.count;
+		pb.persist_p50_ns = nvme_hist_percentile(&lat, 50);
+		pb.persist_p99_ns = nvme_hist_percentile(&lat, 99);
+		pb.persist_p999_ns = nvme_hist_percentile(&lat, 99.9);
+		pb.persist_max_ns = lat.max;
+	}
+
+	nvme_pmr_store(pmr + cfg.offset, save, cfg.size);
+	if (pb.barrier)
+		pmr_barrier(bar, pmr + cfg.offset, pmrsts);
 	else
-		printf("NVME Reservation Release success\n");
+		nvme_pmr_fence();
+	nvme_stop_release();
+
+	if (NVME_PMRSTS_ERR(mmio_read32(bar + NVME_REG_PMRSTS))) {
+		nvme_show_error("%s: the PMR reported an error", dev->name);
+		err = -EIO;
+		goto unmap;
+	}
 
+	nvme_show_pmr_bench(&pb, flags);
+	err = 0;
+unmap:
+	munmap(pmr, pb.bar_size);
+disable:
+	if (pb.enabled)
+		pmr_enable(bar, pmrcap, false);
+out:
+	munmap(bar, getpagesize());
 	return err;
 }
 
-static int resv_report(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* the reads and writes of one region of a dsm-bench run */
+struct dsm_bench_job {
+	pthread_mutex_t lock;
+	__u8 write_pct;
+	__u8 random_pct;
+	__u64 next;		/* the sequential commands go on here */
+	__u64 reads;
+	__u64 writes;
+	__u64 write_bytes;
+	struct nvme_hist read_lat;
+	struct nvme_hist write_lat;
+};
+
+static bool dsm_bench_is_write(struct dsm_bench_job *db, __u64 h)
 {
-	const char *desc = "Returns Reservation Status data\n"
-		"structure describing any existing reservations on and the\n"
-		"status of a given namespace. Namespace Reservation Status\n"
-		"depends on the number of controllers registered for that namespace.";
-	const char *numd = "number of dwords to transfer";
-	const char *eds = "request extended data structure";
+	return h % 100 < db->write_pct;
+}
 
-	_cleanup_free_ struct nvme_resv_status *status = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	enum nvme_print_flags flags;
-	int err, size;
+static int dsm_bench_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+			  struct nvme_passthru_cmd64 *cmd)
+{
+	struct dsm_bench_job *db = job->priv;
+	__u64 h = io_profile_hash(seq);
+	__u64 blocks = job->nlb + 1;
+	__u64 nr = max(job->nr_lbas / blocks, 1ULL);
+	__u64 idx;
+
+	if ((h >> 8) % 100 < db->random_pct)
+		idx = (h >> 16) % nr;
+	else
+		idx = __atomic_fetch_add(&db->next, 1, __ATOMIC_RELAXED) % nr;
 
-	struct config {
-		__u32	namespace_id;
-		__u32	numd;
-		__u8	eds;
-		bool	raw_binary;
-	};
+	nvme_io_job_init_cmd(job, job->slba + idx * blocks, cmd);
+	cmd->opcode = dsm_bench_is_write(db, h) ? nvme_cmd_write : nvme_cmd_read;
 
-	struct config cfg = {
-		.namespace_id	= 0,
-		.numd		= 0,
-		.eds		= false,
-		.raw_binary	= false,
-	};
+	return 0;
+}
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",  'n', &cfg.namespace_id,   namespace_id_desired),
-		  OPT_UINT("numd",          'd', &cfg.numd,           numd),
-		  OPT_FLAG("eds",           'e', &cfg.eds,            eds),
-		  OPT_FLAG("raw-binary",    'b', &cfg.raw_binary,     raw_dump));
+static void dsm_bench_complete(struct nvme_io_job *job, unsigned int thread,
+			       __u64 seq, void *buf, int status, __u64 result,
+			       __u64 lat_ns)
+{
+	struct dsm_bench_job *db = job->priv;
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
+	/* the failures are accounted by the engine and fail the run */
+	if (status)
+		return;
 
-	err = validate_output_format(output_format_val, &flags);
-	if (err < 0) {
-		nvme_show_error("Invalid output format");
-		return err;
+	pthread_mutex_lock(&db->lock);
+	if (dsm_bench_is_write(db, io_profile_hash(seq))) {
+		db->writes++;
+		db->write_bytes += nvme_io_job_data_len(job);
+		nvme_hist_add(&db->write_lat, lat_ns);
+	} else {
+		db->reads++;
+		nvme_hist_add(&db->read_lat, lat_ns);
 	}
+	pthread_mutex_unlock(&db->lock);
+}
 
-	if (cfg.raw_binary)
-		flags = BINARY;
+static const struct nvme_io_job_ops dsm_bench_ops = {
+	.prep		= dsm_bench_prep,
+	.complete	= dsm_bench_complete,
+};
 
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
+/*
+ * Tag the LBAs of @r with its context attributes, in DSM commands of up
+ * to 256 ranges and none of the attribute bits of dword 11 set, so that
+ * nothing is deallocated.
+ */
+static int dsm_bench_tag(struct nvme_dev *dev, __u32 nsid, struct nvme_dsm_range *dsm,
+			 struct nvme_dsm_bench_region *r)
+{
+	__u64 slba = r->slba, left = r->nr_lbas;
+	__u32 nr, len;
+	int err;
+
+	while (left) {
+		for (nr = 0; left && nr < 256; nr++, left -= len, slba += len) {
+			len = min(left, (__u64)0xffffffff);
+			dsm[nr].cattr = cpu_to_le32(r->cattr);
+			dsm[nr].nlb = cpu_to_le32(len);
+			dsm[nr].slba = cpu_to_le64(slba);
 		}
+
+		struct nvme_dsm_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(dev),
+			.nsid		= nsid,
+			.attrs		= 0,
+			.nr_ranges	= nr,
+			.dsm		= dsm,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+		err = nvme_dsm(&args);
+		if (err)
+			return err < 0 ? -errno : err;
 	}
 
-	if (!cfg.numd || cfg.numd >= (0x1000 >> 2))
-		cfg.numd = (0x1000 >> 2) - 1;
-	if (cfg.numd < 3)
-		cfg.numd = 3;
+	return 0;
+}
 
-	size = (cfg.numd + 1) << 2;
+/* the low 64 bits of a 128 bit little endian log page counter */
+static __u64 dsm_bench_stat(__u8 *v)
+{
+	__le64 low;
 
-	status = nvme_alloc(size);
-	if (!status)
-		return -ENOMEM;
+	memcpy(&low, v, sizeof(low));
+	return le64_to_cpu(low);
+}
 
-	struct nvme_resv_report_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.eds		= cfg.eds,
-		.len		= size,
-		.report		= status,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
-	};
-	err = nvme_resv_report(&args);
-	if (!err)
-		nvme_show_resv_report(status, size, cfg.eds, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else
-		nvme_show_error("reservation report: %s", nvme_strerror(errno));
+/*
+ * The bytes written so far by the host and to the media, from the FDP
+ * statistics log of endurance group @egid or, with @fdp false, the media
+ * writes of the OCP SMART / Health Information Extended log, which has
+ * no host count.
+ */
+static int dsm_bench_media(struct nvme_dev *dev, bool fdp, __u16 egid,
+			   __u64 *host, __u64 *media)
+{
+	_cleanup_free_ __u8 *c0 = NULL;
+	struct nvme_fdp_stats_log stats;
+	int err;
 
-	return err;
+	if (fdp) {
+		err = nvme_get_log_fdp_stats(dev_fd(dev), egid, 0, sizeof(stats), &stats);
+		if (err)
+			return err < 0 ? -errno : err;
+		*host = dsm_bench_stat(stats.hbmw);
+		*media = dsm_bench_stat(stats.mbmw);
+		return 0;
+	}
+
+	c0 = nvme_alloc(C0_SMART_CLOUD_ATTR_LEN);
+	if (!c0)
+		return -ENOMEM;
+	err = nvme_get_log_simple(dev_fd(dev), C0_SMART_CLOUD_ATTR_OPCODE,
+				  C0_SMART_CLOUD_ATTR_LEN, c0);
+	if (err)
+		return err < 0 ? -errno : err;
+	if (!ocp_smart_c0_guid_valid(c0))
+		return -ENOTSUP;
+
+	/* Physical Media Units Written, in bytes, leads the log */
+	*host = 0;
+	*media = dsm_bench_stat(c0);
+	return 0;
 }
 
-unsigned long long elapsed_utime(struct timeval start_time,
-					struct timeval end_time)
+static void dsm_bench_run(struct nvme_dev *dev, struct nvme_io_job *job,
+			  struct nvme_dsm_bench *b, struct nvme_dsm_bench_region *r,
+			  unsigned int idle, __u16 egid)
 {
-	unsigned long long err = (end_time.tv_sec - start_time.tv_sec) * 1000000 +
-		(end_time.tv_usec - start_time.tv_usec);
-	return err;
+	struct dsm_bench_job db = {
+		.write_pct	= r->write_pct,
+		.random_pct	= r->random_pct,
+	};
+	__u64 host[2] = { 0 }, media[2] = { 0 };
+	struct nvme_io_stats stats;
+	int err;
+
+	if (b->media && dsm_bench_media(dev, b->fdp, egid, &host[0], &media[0]))
+		r->media_err = true;
+
+	pthread_mutex_init(&db.lock, NULL);
+	nvme_hist_init(&db.read_lat);
+	nvme_hist_init(&db.write_lat);
+
+	job->slba = r->slba;
+	job->nr_lbas = r->nr_lbas;
+	job->dsmgmt = b->per_command ? r->cattr & 0x3f : 0;
+	job->priv = &db;
+	err = nvme_io_engine_run(job, &stats);
+	pthread_mutex_destroy(&db.lock);
+	if (err < 0) {
+		r->err = err;
+		return;
+	}
+	if (stats.errors) {
+		r->err = stats.first_err;
+		return;
+	}
+
+	if (stats.elapsed_ns) {
+		r->iops = (db.reads + db.writes) * NSEC_PER_SEC / stats.elapsed_ns;
+		r->bytes_per_sec = (double)stats.bytes * NSEC_PER_SEC / stats.elapsed_ns;
+	}
+	r->reads = db.reads;
+	r->writes = db.writes;
+	r->read_p50_ns = nvme_hist_percentile(&db.read_lat, 50);
+	r->read_p99_ns = nvme_hist_percentile(&db.read_lat, 99);
+	r->read_p999_ns = nvme_hist_percentile(&db.read_lat, 99.9);
+	r->write_p50_ns = nvme_hist_percentile(&db.write_lat, 50);
+	r->write_p99_ns = nvme_hist_percentile(&db.write_lat, 99);
+	r->write_p999_ns = nvme_hist_percentile(&db.write_lat, 99.9);
+
+	if (!b->media || r->media_err)
+		return;
+
+	/* let the media writes the run caused catch up */
+	if (idle && !nvme_stopped())
+		sleep(idle);
+	if (dsm_bench_media(dev, b->fdp, egid, &host[1], &media[1])) {
+		r->media_err = true;
+		return;
+	}
+
+	r->host_bytes = b->fdp ? host[1] - host[0] : db.write_bytes;
+	r->media_bytes = media[1] - media[0];
+	if (r->host_bytes)
+		r->waf = (double)r->media_bytes / r->host_bytes;
 }
 
-static int submit_io(int opcode, char *command, const char *desc, int argc, char **argv)
+/*
+ * dsm-bench: the namespace range split into one region per context
+ * attributes value, each tagged with its attributes by DSM and then
+ * exercised on its own with the mix of reads and writes given for it,
+ * so that the latency and media writes of the regions can be compared.
+ */
+static int dsm_bench(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
-	struct timeval start_time, end_time;
-	void *buffer;
-	_cleanup_free_ void *mbuffer = NULL;
-	int err = 0;
-	_cleanup_file_ int dfd = -1, mfd = -1;
-	int flags;
-	int mode = 0644;
-	__u16 control = 0, nblocks = 0;
-	__u32 dsmgmt = 0;
-	unsigned int logical_block_size = 0;
-	unsigned long long buffer_size = 0, mbuffer_size = 0;
-	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
-	__u8 lba_index, ms = 0, sts = 0, pif = 0;
-
-	const char *start_block_addr = "64-bit addr of first block to access";
-	const char *data_size = "size of data in bytes";
-	const char *metadata_size = "size of metadata in bytes";
-	const char *data = "data file";
-	const char *metadata = "metadata file";
-	const char *limited_retry_num = "limit num. media access attempts";
-	const char *show = "show command before sending";
-	const char *dtype_for_write = "directive type (for write-only)";
-	const char *dspec = "directive specific (for write-only)";
-	const char *dsm = "dataset management attributes (lower 8 bits)";
-	const char *storage_tag_check = "This bit specifies the Storage Tag field shall be\n"
-		"checked as part of end-to-end data protection processing";
+	const char *desc = "Tag regions of a namespace with different Dataset Management\n"
+		"context attributes, run a read/write workload on each of them and\n"
+		"compare their latency and, where the FDP statistics or the OCP\n"
+		"SMART extended log report them, their media writes.";
+	const char *ctx_attrs = "comma separated context attributes, one region each";
+	const char *write_pct = "comma separated percentages of writes, one or one per region";
+	const char *random_pct = "comma separated percentages of random LBAs, one or one per region";
+	const char *per_command = "also set the DSM field of the reads and writes";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *runtime = "run time in seconds on every region";
+	const char *io_range = "number of LBAs to split into the regions";
+	const char *idle = "seconds to wait after every run before reading the media writes";
 	const char *force = "The \"I know what I'm doing\" flag, do not enforce exclusive access for write";
 
+	/* the lists are parsed in place */
+	char def_ctx_attrs[] = "0,0x12,0x35";
+	char def_write_pct[] = "50";
+	char def_random_pct[] = "100";
+	__u32 attrs[NVME_DSM_BENCH_REGIONS], wpct[NVME_DSM_BENCH_REGIONS];
+	__u32 rpct[NVME_DSM_BENCH_REGIONS];
+	_cleanup_free_ struct nvme_dsm_bench *b = NULL;
+	_cleanup_free_ struct nvme_dsm_range *dsm = NULL;
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_file_ int gfd = -1;
+	struct nvme_dsm_bench_region *r;
+	enum nvme_print_flags flags;
+	__u64 region_lbas, host, media;
+	int nr, nw, nx, i, err;
+	__u16 egid;
+	__u8 lba_index;
+
 	struct config {
 		__u32	namespace_id;
-		__u64	start_block;
+		char	*ctx_attrs;
+		char	*write_pct;
+		char	*random_pct;
+		bool	per_command;
 		__u16	block_count;
-		__u64	data_size;
-		__u64	metadata_size;
-		__u64	ref_tag;
-		char	*data;
-		char	*metadata;
-		__u8	prinfo;
-		__u16	app_tag_mask;
-		__u16	app_tag;
-		__u64	storage_tag;
-		bool	limited_retry;
-		bool	force_unit_access;
-		bool	storage_tag_check;
-		__u8	dtype;
-		__u16	dspec;
-		__u8	dsmgmt;
-		bool	show;
-		bool	dry_run;
-		bool	latency;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
+		__u32	idle;
 		bool	force;
 	};
 
 	struct config cfg = {
-		.namespace_id		= 0,
-		.start_block		= 0,
-		.block_count		= 0,
-		.data_size		= 0,
-		.metadata_size		= 0,
-		.ref_tag		= 0,
-		.data			= "",
-		.metadata		= "",
-		.prinfo			= 0,
-		.app_tag_mask		= 0,
-		.app_tag		= 0,
-		.storage_tag		= 0,
-		.limited_retry		= false,
-		.force_unit_access	= false,
-		.storage_tag_check	= false,
-		.dtype			= 0,
-		.dspec			= 0,
-		.dsmgmt			= 0,
-		.show			= false,
-		.dry_run		= false,
-		.latency		= false,
-		.force			= false,
+		.namespace_id	= 0,
+		.ctx_attrs	= def_ctx_attrs,
+		.write_pct	= def_write_pct,
+		.random_pct	= def_random_pct,
+		.per_command	= false,
+		.block_count	= 0,
+		.io_range	= 0,
+		.queue_depth	= 8,
+		.threads	= 1,
+		.runtime	= 10,
+		.idle		= 0,
+		.force		= false,
 	};
 
-	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_id_desired),
-		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block_addr),
-		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
-		  OPT_SUFFIX("data-size",       'z', &cfg.data_size,         data_size),
-		  OPT_SUFFIX("metadata-size",   'y', &cfg.metadata_size,     metadata_size),
-		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
-		  OPT_FILE("data",              'd', &cfg.data,              data),
-		  OPT_FILE("metadata",          'M', &cfg.metadata,          metadata),
-		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
-		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
-		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
-		  OPT_SUFFIX("storage-tag",     'g', &cfg.storage_tag,       storage_tag),
-		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry_num),
-		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access),
-		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check),
-		  OPT_BYTE("dir-type",          'T', &cfg.dtype,             dtype_for_write),
-		  OPT_SHRT("dir-spec",          'S', &cfg.dspec,             dspec),
-		  OPT_BYTE("dsm",               'D', &cfg.dsmgmt,            dsm),
-		  OPT_FLAG("show-command",      'V', &cfg.show,              show),
-		  OPT_FLAG("dry-run",           'w', &cfg.dry_run,           dry),
-		  OPT_FLAG("latency",           't', &cfg.latency,           latency),
-		  OPT_FLAG("force",               0, &cfg.force,             force));
-
-	if (opcode != nvme_cmd_write) {
-		err = parse_and_open(&dev, argc, argv, desc, opts);
-		if (err)
-			return err;
-	} else {
-		err = parse_args(argc, argv, desc, opts);
-		if (err)
-			return err;
-		err = open_exclusive(&dev, argc, argv, cfg.force);
-		if (err) {
-			if (errno == EBUSY) {
-				fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
-				fprintf(stderr, "Namespace is currently busy.\n");
-				if (!cfg.force)
-					fprintf(stderr,
-						"Use the force [--force] option to ignore that.\n");
-			} else {
-				argconfig_print_help(desc, opts);
-			}
-			return err;
-		}
-	}
-
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
-	}
-
-	if (cfg.prinfo > 0xf)
+	NVME_ARGS(opts,
+		  OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id_desired),
+		  OPT_LIST("ctx-attrs",    'a', &cfg.ctx_attrs,    ctx_attrs),
+		  OPT_LIST("write-pct",    'w', &cfg.write_pct,    write_pct),
+		  OPT_LIST("random-pct",   'r', &cfg.random_pct,   random_pct),
+		  OPT_FLAG("per-command",  'C', &cfg.per_command,  per_command),
+		  OPT_SHRT("block-count",  'c', &cfg.block_count,  block_count),
+		  OPT_SUFFIX("io-range",   'L', &cfg.io_range,     io_range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      threads),
+		  OPT_UINT("runtime",      'R', &cfg.runtime,      runtime),
+		  OPT_UINT("idle",         'i', &cfg.idle,         idle),
+		  OPT_FLAG("force",          0, &cfg.force,        force));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
 		return err;
 
-	dsmgmt = cfg.dsmgmt;
-	control |= (cfg.prinfo << 10);
-	if (cfg.limited_retry)
-		control |= NVME_IO_LR;
-	if (cfg.force_unit_access)
-		control |= NVME_IO_FUA;
-	if (cfg.storage_tag_check)
-		control |= NVME_IO_STC;
-	if (cfg.dtype) {
-		if (cfg.dtype > 0xf) {
-			nvme_show_error("Invalid directive type, %x", cfg.dtype);
-			return -EINVAL;
+	err = open_exclusive(&dev, argc, argv, cfg.force);
+	if (err) {
+		if (errno == EBUSY) {
+			fprintf(stderr, "Failed to open %s.\n", basename(argv[optind]));
+			fprintf(stderr, "Namespace is currently busy.\n");
+			if (!cfg.force)
+				fprintf(stderr,
+					"Use the force [--force] option to ignore that.\n");
+		} else {
+			argconfig_print_help(desc, opts);
 		}
-		control |= cfg.dtype << 4;
-		dsmgmt |= ((__u32)cfg.dspec) << 16;
+		return err;
 	}
 
-	if (opcode & 1) {
-		dfd = mfd = STDIN_FILENO;
-		flags = O_RDONLY;
-	} else {
-		dfd = mfd = STDOUT_FILENO;
-		flags = O_WRONLY | O_CREAT;
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
 	}
 
-	if (strlen(cfg.data)) {
-		dfd = open(cfg.data, flags, mode);
-		if (dfd < 0) {
-			nvme_show_perror(cfg.data);
-			return -EINVAL;
-		}
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime) {
+		nvme_show_error("queue-depth, threads and runtime must be non-zero");
+		return -EINVAL;
 	}
 
-	if (strlen(cfg.metadata)) {
-		mfd = open(cfg.metadata, flags, mode);
-		if (mfd < 0) {
-			nvme_show_perror(cfg.metadata);
+	nr = argconfig_parse_comma_sep_array_u32(cfg.ctx_attrs, attrs, ARRAY_SIZE(attrs));
+	if (nr <= 0) {
+		nvme_show_error("invalid --ctx-attrs, up to %d values",
+				NVME_DSM_BENCH_REGIONS);
+		return -EINVAL;
+	}
+	nw = argconfig_parse_comma_sep_array_u32(cfg.write_pct, wpct, ARRAY_SIZE(wpct));
+	nx = argconfig_parse_comma_sep_array_u32(cfg.random_pct, rpct, ARRAY_SIZE(rpct));
+	if ((nw != 1 && nw != nr) || (nx != 1 && nx != nr)) {
+		nvme_show_error("--write-pct and --random-pct take one value or one per region");
+		return -EINVAL;
+	}
+	for (i = 0; i < nr; i++) {
+		if (wpct[nw == 1 ? 0 : i] > 100 || rpct[nx == 1 ? 0 : i] > 100) {
+			nvme_show_error("percentages must not exceed 100");
 			return -EINVAL;
 		}
 	}
 
-	if (!cfg.data_size) {
-		nvme_show_error("data size not provided");
-		return -EINVAL;
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
 	}
 
+	ctrl = nvme_alloc(sizeof(*ctrl));
 	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
+	dsm = nvme_alloc(sizeof(*dsm) * 256);
+	b = calloc(1, sizeof(*b));
+	if (!ctrl || !ns || !dsm || !b)
 		return -ENOMEM;
 
-	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
+	err = nvme_cli_identify_ctrl(dev, ctrl);
+	if (!err)
+		err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
 	if (err > 0) {
 		nvme_show_status(err);
 		return err;
 	} else if (err < 0) {
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		nvme_show_error("identify: %s", nvme_strerror(errno));
 		return err;
 	}
 
-	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
-	logical_block_size = 1 << ns->lbaf[lba_index].ds;
-	ms = ns->lbaf[lba_index].ms;
-	if (NVME_FLBAS_META_EXT(ns->flbas)) {
-		/*
-		 * No meta data is transferred for PRACT=1 and MD=8:
-		 *   5.2.2.1 Protection Information and Write Commands
-		 *   5.2.2.2 Protection Information and Read Commands
-		 */
-		if (!((cfg.prinfo & 0x8) != 0 && ms == 8))
-			logical_block_size += ms;
+	if (!(le16_to_cpu(ctrl->oncs) & NVME_CTRL_ONCS_DSM)) {
+		nvme_show_error("dsm-bench: the controller does not support Dataset Management");
+		return -ENOTSUP;
 	}
 
-	buffer_size = ((long long)cfg.block_count + 1) * logical_block_size;
-	if (cfg.data_size < buffer_size)
-		nvme_show_error("Rounding data size to fit block count (%lld bytes)", buffer_size);
-	else
-		buffer_size = cfg.data_size;
+	struct nvme_io_job job = {
+		.nsid		= cfg.namespace_id,
+		.opcode		= nvme_cmd_write,
+		.nlb		= cfg.block_count,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.ops		= &dsm_bench_ops,
+	};
 
-	if (argconfig_parse_seen(opts, "block-count")) {
-		/* Use the value provided */
-		nblocks = cfg.block_count;
-	} else {
-		/* Get the required block count. Note this is a zeroes based value. */
-		nblocks = ((buffer_size + (logical_block_size - 1)) / logical_block_size) - 1;
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	job.lba_size = 1 << ns->lbaf[lba_index].ds;
+	if (NVME_FLBAS_META_EXT(ns->flbas))
+		job.lba_size += ns->lbaf[lba_index].ms;
+	else
+		job.ms = ns->lbaf[lba_index].ms;
+	if (!cfg.io_range)
+		cfg.io_range = le64_to_cpu(ns->nsze);
+
+	region_lbas = cfg.io_range / nr;
+	if (region_lbas < job.nlb + 1) {
+		nvme_show_error("io-range too small for %d regions of %u block writes", nr,
+				job.nlb + 1);
+		return -EINVAL;
+	}
 
-		/* Update the data size based on the required block count */
-		buffer_size = ((unsigned long long)nblocks + 1) * logical_block_size;
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		nvme_show_error("dsm-bench requires an NVMe namespace: %s",
+				nvme_strerror(errno));
+		return -errno;
 	}
+	job.fd = gfd;
 
-	buffer = nvme_alloc_huge(buffer_size, &mh);
-	if (!buffer)
-		return -ENOMEM;
+	/* the FDP statistics if the endurance group has them, else OCP's */
+	egid = le16_to_cpu(ns->endgid);
+	b->fdp = (le32_to_cpu(ctrl->ctratt) & NVME_CTRL_CTRATT_FDPS) &&
+		 !dsm_bench_media(dev, true, egid, &host, &media);
+	if (b->fdp)
+		b->media = "fdp";
+	else if (!dsm_bench_media(dev, false, egid, &host, &media))
+		b->media = "ocp";
 
-	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
-	if (!nvm_ns)
-		return -ENOMEM;
+	b->name = dev->name;
+	b->nsid = cfg.namespace_id;
+	b->runtime = cfg.runtime;
+	b->queue_depth = cfg.queue_depth;
+	b->per_command = cfg.per_command;
+	b->nr = nr;
+	for (i = 0; i < nr; i++) {
+		r = &b->regions[i];
+		r->cattr = attrs[i];
+		r->write_pct = wpct[nw == 1 ? 0 : i];
+		r->random_pct = rpct[nx == 1 ? 0 : i];
+		r->slba = i * region_lbas;
+		r->nr_lbas = region_lbas;
+	}
 
-	if (cfg.metadata_size) {
-		err = nvme_identify_ns_csi(dev_fd(dev), 1, 0, NVME_CSI_NVM, nvm_ns);
-		if (!err) {
-			sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
-			pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
-		}
+	/* all regions are tagged before any of them is written */
+	for (i = 0; i < nr; i++) {
+		r = &b->regions[i];
+		r->tag_err = dsm_bench_tag(dev, cfg.namespace_id, dsm, r);
+	}
 
-		mbuffer_size = ((unsigned long long)cfg.block_count + 1) * ms;
-		if (ms && cfg.metadata_size < mbuffer_size)
-			nvme_show_error("Rounding metadata size to fit block count (%lld bytes)",
-					mbuffer_size);
-		else
-			mbuffer_size = cfg.metadata_size;
+	nvme_stop_catch(false, nvme_io_engine_stop);
 
-		mbuffer = malloc(mbuffer_size);
-		if (!mbuffer)
-			return -ENOMEM;
-		memset(mbuffer, 0, mbuffer_size);
+	for (i = 0; i < nr && !nvme_stopped(); i++) {
+		r = &b->regions[i];
+		dsm_bench_run(dev, &job, b, r, cfg.idle, egid);
+		r->done = true;
 	}
 
-	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
-		return -EINVAL;
+	nvme_stop_release();
 
-	if (opcode & 1) {
-		err = read(dfd, (void *)buffer, cfg.data_size);
-		if (err < 0) {
-			err = -errno;
-			nvme_show_error("failed to read data buffer from input file %s", strerror(errno));
-			return err;
-		}
-	}
+	nvme_show_dsm_bench(b, flags);
 
-	if ((opcode & 1) && cfg.metadata_size) {
-		err = read(mfd, (void *)mbuffer, mbuffer_size);
-		if (err < 0) {
-			err = -errno;
-			nvme_show_error("failed to read meta-data buffer from input file %s", strerror(errno));
-			return err;
+	for (i = 0; i < nr; i++)
+		if (b->regions[i].err)
+			return b->regions[i].err;
+	return 0;
+}
+
+/* Compare Failure, the status of a Compare whose blocks did not match */
+#define CW_BENCH_MISCOMPARE	(NVME_SCT_MEDIA << NVME_SCT_SHIFT | NVME_SC_COMPARE_FAILED)
+
+/*
+ * A lock operation of compare-write-bench: its Compare in flight, found
+ * by the seq of the command, or its Write queued or in flight once the
+ * Compare matched.
+ */
+struct cw_bench_pair {
+	__u64 seq;
+	__u64 lock;
+	__u64 start_ns;		/* of the Compare */
+	bool release;
+	bool write;
+	bool used;
+};
+
+/*
+ * The locks of one thread of a compare-write-bench namespace. prep() and
+ * complete() of a thread both run on its worker, so none of this is
+ * shared.
+ */
+struct cw_bench_thread {
+	__u64 owner;			/* written to the blocks of the locks taken */
+	__u64 *held;			/* the locks taken, oldest first */
+	unsigned int head;
+	unsigned int nr;
+	struct cw_bench_pair *pairs;	/* queue depth of them in flight */
+	unsigned int inflight;
+	struct cw_bench_pair *writes;	/* queue depth of them matched, to write */
+	unsigned int whead;
+	unsigned int wnr;
+	struct nvme_hist lat;		/* from the Compare to the end of the pair */
+	__u64 acquired;
+	__u64 contended;
+	__u64 released;
+	__u64 lost;
+	__u64 errors;
+};
+
+struct cw_bench_job {
+	__u64 locks;
+	unsigned int cap;		/* of held, twice the queue depth */
+	bool drain;			/* only release, and stop once none are held */
+	struct cw_bench_thread *t;
+};
+
+/* @len bytes of the little endian @owner over and over, 0 for a free lock */
+static void cw_bench_fill(void *buf, __u32 len, __u64 owner)
+{
+	__le64 v = cpu_to_le64(owner);
+	__u32 off;
+
+	for (off = 0; off + sizeof(v) <= len; off += sizeof(v))
+		memcpy((char *)buf + off, &v, sizeof(v));
+}
+
+static struct cw_bench_pair *cw_bench_find(struct nvme_io_job *job,
+					   struct cw_bench_thread *t, __u64 seq)
+{
+	unsigned int i;
+
+	for (i = 0; i < job->queue_depth; i++)
+		if (t->pairs[i].used && t->pairs[i].seq == seq)
+			return &t->pairs[i];
+	return NULL;
+}
+
+/* the pair of @t ends, after @start_ns */
+static void cw_bench_done(struct cw_bench_thread *t, __u64 start_ns)
+{
+	nvme_hist_add(&t->lat, monotonic_ns() - start_ns);
+}
+
+/*
+ * Issue the Write of the oldest pair whose Compare matched first. Else
+ * release the oldest lock of the thread once it holds a queue depth of
+ * them, or at random half of the time it holds any, or try to take a
+ * random one, with a Compare of the blocks against what they hold when
+ * the lock is in the state expected.
+ */
+static int cw_bench_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+			 struct nvme_passthru_cmd64 *cmd)
+{
+	struct cw_bench_job *cw = job->priv;
+	struct cw_bench_thread *t = &cw->t[thread];
+	__u64 h = io_profile_hash(seq ^ t->owner);
+	struct cw_bench_pair *p;
+
+	if (!t->wnr && cw->drain && !t->nr)
+		return t->inflight ? NVME_IO_PREP_DEFER : 1;
+
+	for (p = t->pairs; p->used; p++)
+		;
+
+	if (t->wnr) {
+		*p = t->writes[t->whead];
+		t->whead = (t->whead + 1) % job->queue_depth;
+		t->wnr--;
+	} else {
+		p->write = false;
+		p->start_ns = monotonic_ns();
+		p->release = t->nr && (cw->drain || t->nr >= job->queue_depth || (h & 1));
+		if (p->release) {
+			p->lock = t->held[t->head];
+			t->head = (t->head + 1) % cw->cap;
+			t->nr--;
+		} else {
+			p->lock = (h >> 1) % cw->locks;
 		}
 	}
+	p->used = true;
+	p->seq = seq;
+	t->inflight++;
 
-	if (cfg.show || cfg.dry_run) {
-		printf("opcode       : %02x\n", opcode);
-		printf("nsid         : %02x\n", cfg.namespace_id);
-		printf("flags        : %02x\n", 0);
-		printf("control      : %04x\n", control);
-		printf("nblocks      : %04x\n", nblocks);
-		printf("metadata     : %"PRIx64"\n", (uint64_t)(uintptr_t)mbuffer);
-		printf("addr         : %"PRIx64"\n", (uint64_t)(uintptr_t)buffer);
-		printf("slba         : %"PRIx64"\n", (uint64_t)cfg.start_block);
-		printf("dsmgmt       : %08x\n", dsmgmt);
-		printf("reftag       : %"PRIx64"\n", (uint64_t)cfg.ref_tag);
-		printf("apptag       : %04x\n", cfg.app_tag);
-		printf("appmask      : %04x\n", cfg.app_tag_mask);
-		printf("storagetagcheck : %04x\n", cfg.storage_tag_check);
-		printf("storagetag      : %"PRIx64"\n", (uint64_t)cfg.storage_tag);
-		printf("pif             : %02x\n", pif);
-		printf("sts             : %02x\n", sts);
+	nvme_io_job_init_cmd(job, job->slba + p->lock * (job->nlb + 1), cmd);
+	if (p->write)
+		cmd->opcode = nvme_cmd_write;
+	/* a Compare expects the lock as it was, a Write leaves it as it will be */
+	cw_bench_fill((void *)(uintptr_t)cmd->addr, nvme_io_job_data_len(job),
+		      p->release == p->write ? 0 : t->owner);
+
+	return 0;
+}
+
+static void cw_bench_complete(struct nvme_io_job *job, unsigned int thread,
+			      __u64 seq, void *buf, int status, __u64 result,
+			      __u64 lat_ns)
+{
+	struct cw_bench_job *cw = job->priv;
+	struct cw_bench_thread *t = &cw->t[thread];
+	struct cw_bench_pair *p = cw_bench_find(job, t, seq);
+	bool miscompare = !p->write && status > 0 &&
+		(status & 0x7ff) == CW_BENCH_MISCOMPARE;
+
+	p->used = false;
+	t->inflight--;
+	if (!status && !p->write) {
+		p->write = true;
+		t->writes[(t->whead + t->wnr++) % job->queue_depth] = *p;
+		return;
 	}
-	if (cfg.dry_run)
-		return 0;
 
-	struct nvme_io_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.slba		= cfg.start_block,
-		.nlb		= nblocks,
-		.control	= control,
-		.dsm		= cfg.dsmgmt,
-		.sts		= sts,
-		.pif		= pif,
-		.dspec		= cfg.dspec,
-		.reftag_u64	= cfg.ref_tag,
-		.apptag		= cfg.app_tag,
-		.appmask	= cfg.app_tag_mask,
-		.storage_tag	= cfg.storage_tag,
-		.data_len	= buffer_size,
-		.data		= buffer,
-		.metadata_len	= mbuffer_size,
-		.metadata	= mbuffer,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
-	};
-	gettimeofday(&start_time, NULL);
-	err = nvme_io(&args, opcode);
-	gettimeofday(&end_time, NULL);
-	if (cfg.latency)
-		printf(" latency: %s: %llu us\n", command, elapsed_utime(start_time, end_time));
-	if (err < 0) {
-		nvme_show_error("submit-io: %s", nvme_strerror(errno));
-	} else if (err) {
-		nvme_show_status(err);
+	cw_bench_done(t, p->start_ns);
+	if (status && !miscompare) {
+		t->errors++;
+	} else if (p->release) {
+		if (miscompare)
+			t->lost++;
+		else
+			t->released++;
+	} else if (miscompare) {
+		t->contended++;
 	} else {
-		if (!(opcode & 1) && write(dfd, (void *)buffer, buffer_size) < 0) {
-			nvme_show_error("write: %s: failed to write buffer to output file",
-				strerror(errno));
-			err = -EINVAL;
-		} else if (!(opcode & 1) && cfg.metadata_size &&
-			   write(mfd, (void *)mbuffer, mbuffer_size) < 0) {
-			nvme_show_error(
-			    "write: %s: failed to write meta-data buffer to output file",
-			    strerror(errno));
-			err = -EINVAL;
-		} else {
-			fprintf(stderr, "%s: Success\n", command);
+		t->acquired++;
+		t->held[(t->head + t->nr++) % cw->cap] = p->lock;
+	}
+}
+
+static const struct nvme_io_job_ops cw_bench_ops = {
+	.prep		= cw_bench_prep,
+	.complete	= cw_bench_complete,
+};
+
+/*
+ * The Writes the run ended before issuing: the locks to release are
+ * still held, and the ones to take were never taken.
+ */
+static void cw_bench_unqueue(struct cw_bench_job *cw, struct nvme_io_job *job)
+{
+	struct cw_bench_thread *t;
+	struct cw_bench_pair *p;
+	unsigned int i;
+
+	for (i = 0; i < job->threads; i++) {
+		t = &cw->t[i];
+		for (; t->wnr; t->wnr--) {
+			p = &t->writes[t->whead];
+			t->whead = (t->whead + 1) % job->queue_depth;
+			if (p->release)
+				t->held[(t->head + t->nr++) % cw->cap] = p->lock;
 		}
 	}
+}
 
-	return err;
+static void cw_bench_free(struct cw_bench_job *cw, unsigned int threads)
+{
+	unsigned int i;
+
+	if (!cw->t)
+		return;
+	for (i = 0; i < threads; i++) {
+		free(cw->t[i].held);
+		free(cw->t[i].pairs);
+		free(cw->t[i].writes);
+	}
+	free(cw->t);
+	cw->t = NULL;
 }
 
-static int compare(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/* the lock state of the threads of namespace @dev of @job */
+static int cw_bench_init(struct cw_bench_job *cw, struct nvme_io_job *job, int dev)
 {
-	const char *desc = "Compare specified logical blocks on\n"
-		"device with specified data buffer; return failure if buffer\n"
-		"and block(s) are dissimilar";
+	__u64 host = (__u64)gethostid() << 32 | (__u64)getpid() << 8 | dev;
+	unsigned int i;
+
+	cw->cap = 2 * job->queue_depth;
+	cw->t = calloc(job->threads, sizeof(*cw->t));
+	if (!cw->t)
+		return -ENOMEM;
 
-	return submit_io(nvme_cmd_compare, "compare", desc, argc, argv);
+	for (i = 0; i < job->threads; i++) {
+		cw->t[i].owner = io_profile_hash(host ^ (__u64)i << 56) | 1;
+		cw->t[i].held = calloc(cw->cap, sizeof(*cw->t[i].held));
+		cw->t[i].pairs = calloc(job->queue_depth, sizeof(*cw->t[i].pairs));
+		cw->t[i].writes = calloc(job->queue_depth, sizeof(*cw->t[i].writes));
+		if (!cw->t[i].held || !cw->t[i].pairs || !cw->t[i].writes)
+			return -ENOMEM;
+		nvme_hist_init(&cw->t[i].lat);
+	}
+
+	return 0;
 }
 
-static int read_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * The results of a namespace's run, before its locks are released, and
+ * the pairs' latency into @lat.
+ */
+static void cw_bench_result(struct cw_bench_job *cw, struct io_bench_dev *d,
+			    struct nvme_cw_bench_dev *r, struct nvme_hist *lat)
 {
-	const char *desc = "Copy specified logical blocks on the given\n"
-		"device to specified data buffer (default buffer is stdout).";
+	struct cw_bench_thread *t;
+	struct nvme_hist h;
+	unsigned int i;
+
+	r->err = d->err;
+	if (r->err)
+		return;
 
-	return submit_io(nvme_cmd_read, "read", desc, argc, argv);
+	nvme_hist_init(&h);
+	for (i = 0; i < d->job.threads; i++) {
+		t = &cw->t[i];
+		r->acquired += t->acquired;
+		r->contended += t->contended;
+		r->released += t->released;
+		r->lost += t->lost;
+		r->errors += t->errors;
+		nvme_hist_merge(&h, &t->lat);
+	}
+	r->pairs = h.count;
+	if (d->stats.elapsed_ns)
+		r->pairs_per_sec = h.count * NSEC_PER_SEC / d->stats.elapsed_ns;
+	r->p50_ns = nvme_hist_percentile(&h, 50);
+	r->p99_ns = nvme_hist_percentile(&h, 99);
+	r->p999_ns = nvme_hist_percentile(&h, 99.9);
+	nvme_hist_merge(lat, &h);
 }
 
-static int write_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * Release the locks the threads of @d still hold, so that the next run
+ * and the other hosts find them free. Returns the number left held.
+ */
+static __u64 cw_bench_drain(struct cw_bench_job *cw, struct io_bench_dev *d)
 {
-	const char *desc = "Copy from provided data buffer (default\n"
-		"buffer is stdin) to specified logical blocks on the given device.";
+	struct nvme_io_stats stats;
+	__u64 held = 0;
+	unsigned int i;
 
-	return submit_io(nvme_cmd_write, "write", desc, argc, argv);
+	for (i = 0; i < d->job.threads; i++)
+		held += cw->t[i].nr;
+	if (!held)
+		return 0;
+
+	/* a Compare and a Write for each */
+	cw->drain = true;
+	d->job.runtime = 0;
+	d->job.nr_ios = 2 * held + d->job.threads;
+	d->job.progress = NULL;
+	if (nvme_io_engine_run(&d->job, &stats) < 0)
+		return held;
+	cw_bench_unqueue(cw, &d->job);
+
+	for (held = 0, i = 0; i < d->job.threads; i++)
+		held += cw->t[i].nr;
+	return held;
 }
 
-static int verify_cmd(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+/*
+ * compare-write-bench: every thread takes and releases locks, blocks of
+ * the namespace free when zeroed and held when holding the ID of their
+ * owner, with a Compare of the lock and a Write of it if it matched,
+ * the way hosts sharing a namespace serialize on them (without the
+ * atomicity of a fused pair), and the pairs' success, contention and
+ * latency are reported for each namespace and all of them together.
+ */
+static int compare_write_bench(int argc, char **argv, struct command *cmd,
+			       struct plugin *plugin)
 {
+	const char *desc = "Take and release locks on blocks of one or more namespaces with\n"
+		"a Compare and, if it matched, a Write at queue depth, as hosts\n"
+		"sharing the namespaces do, and report the pairs completed, how\n"
+		"many found their lock taken and their latency. The Write is a\n"
+		"separate command, so the locks don't exclude other hosts. Lock\n"
+		"blocks are free when zeroed. With 'all' every namespace in the topology is run.";
+	const char *locks = "number of lock blocks";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads per namespace";
+	const char *runtime = "run time in seconds";
+	const char *force = "The \"I know what I'm doing\" flag, do not enforce exclusive access for write";
+	_cleanup_free_ struct nvme_cw_bench_dev *res = NULL;
+	_cleanup_free_ struct cw_bench_job *cws = NULL;
+	_cleanup_free_ struct io_bench_dev *devs = NULL;
+	struct nvme_cw_bench_dev total = { .name = "all" };
+	struct nvme_cw_bench b = { 0 };
+	struct nvme_hist lat;
+	enum nvme_print_flags flags;
 	__u16 control = 0;
-	__u8 lba_index, sts = 0, pif = 0;
-	_cleanup_free_ struct nvme_nvm_id_ns *nvm_ns = NULL;
-	_cleanup_free_ struct nvme_id_ns *ns = NULL;
-	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
-	int err;
-
-	const char *desc = "Verify specified logical blocks on the given device.";
-	const char *force_unit_access_verify =
-	    "force device to commit cached data before performing the verify operation";
-	const char *storage_tag_check =
-	    "This bit specifies the Storage Tag field shall be checked as part of Verify operation";
+	__u32 dsmgmt = 0;
+	int i, nr = 0, started = 0, err;
+	char **paths = NULL;
 
 	struct config {
-		__u32	namespace_id;
 		__u64	start_block;
 		__u16	block_count;
-		bool	limited_retry;
-		bool	force_unit_access;
+		__u64	locks;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
 		__u8	prinfo;
-		__u32	ref_tag;
-		__u16	app_tag;
-		__u16	app_tag_mask;
-		__u64	storage_tag;
-		bool	storage_tag_check;
+		bool	force;
 	};
 
 	struct config cfg = {
-		.namespace_id		= 0,
-		.start_block		= 0,
-		.block_count		= 0,
-		.limited_retry		= false,
-		.force_unit_access	= false,
-		.prinfo			= 0,
-		.ref_tag		= 0,
-		.app_tag		= 0,
-		.app_tag_mask		= 0,
-		.storage_tag		= 0,
-		.storage_tag_check	= false,
+		.start_block	= 0,
+		.block_count	= 0,
+		.locks		= 1024,
+		.queue_depth	= 8,
+		.threads	= 1,
+		.runtime	= 10,
+		.prinfo		= 0,
+		.force		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      namespace_desired),
-		  OPT_SUFFIX("start-block",     's', &cfg.start_block,       start_block),
-		  OPT_SHRT("block-count",       'c', &cfg.block_count,       block_count),
-		  OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     limited_retry),
-		  OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, force_unit_access_verify),
-		  OPT_BYTE("prinfo",            'p', &cfg.prinfo,            prinfo),
-		  OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           ref_tag),
-		  OPT_SHRT("app-tag",           'a', &cfg.app_tag,           app_tag),
-		  OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      app_tag_mask),
-		  OPT_SUFFIX("storage-tag",     'S', &cfg.storage_tag,       storage_tag),
-		  OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, storage_tag_check));
+		  OPT_SUFFIX("start-block", 's', &cfg.start_block, start_block),
+		  OPT_SHRT("block-count",   'c', &cfg.block_count, block_count),
+		  OPT_SUFFIX("locks",       'l', &cfg.locks,       locks),
+		  OPT_UINT("queue-depth",   'q', &cfg.queue_depth, queue_depth),
+		  OPT_UINT("threads",       'j', &cfg.threads,     threads),
+		  OPT_UINT("runtime",       'R', &cfg.runtime,     runtime),
+		  OPT_BYTE("prinfo",        'p', &cfg.prinfo,      prinfo),
+		  OPT_FLAG("force",           0, &cfg.force,       force));
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
+	err = parse_args(argc, argv, desc, opts);
 	if (err)
 		return err;
 
-	if (cfg.prinfo > 0xf)
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
 		return -EINVAL;
+	}
 
-	control |= (cfg.prinfo << 10);
-	if (cfg.limited_retry)
-		control |= NVME_IO_LR;
-	if (cfg.force_unit_access)
-		control |= NVME_IO_FUA;
-	if (cfg.storage_tag_check)
-		control |= NVME_IO_STC;
-
-	if (!cfg.namespace_id) {
-		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
-		if (err < 0) {
-			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
-			return err;
-		}
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime || !cfg.locks) {
+		nvme_show_error("locks, queue-depth, threads and runtime must be non-zero");
+		return -EINVAL;
 	}
 
-	ns = nvme_alloc(sizeof(*ns));
-	if (!ns)
-		return -ENOMEM;
+	if (cfg.prinfo > 0xf)
+		return -EINVAL;
 
-	err = nvme_cli_identify_ns(dev, cfg.namespace_id, ns);
-	if (err < 0) {
-		nvme_show_error("identify namespace: %s", nvme_strerror(errno));
-		return err;
-	} else if (err) {
-		nvme_show_status(err);
-		return err;
+	if (optind >= argc) {
+		nvme_show_error("namespace or 'all' required");
+		argconfig_print_help(desc, opts);
+		return -EINVAL;
 	}
 
-	nvm_ns = nvme_alloc(sizeof(*nvm_ns));
-	if (!nvm_ns)
-		return -ENOMEM;
+	err = io_build_control(cfg.prinfo, false, false, false, 0, 0, 0, &control, &dsmgmt);
+	if (err)
+		return err;
 
-	err = nvme_identify_ns_csi(dev_fd(dev), cfg.namespace_id, 0,
-				   NVME_CSI_NVM, nvm_ns);
-	if (!err) {
-		nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
-		sts = nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_STS_MASK;
-		pif = (nvm_ns->elbaf[lba_index] & NVME_NVM_ELBAF_PIF_MASK) >> 7;
+	if (!strcmp(argv[optind], "all")) {
+		err = ns_paths_scan(&paths, &nr);
+		if (err) {
+			nvme_show_error("Failed to scan topology: %s", nvme_strerror(-err));
+			goto out;
+		}
+		if (!nr) {
+			nvme_show_error("no namespaces found");
+			err = -ENODEV;
+			goto out;
+		}
+	} else {
+		err = ctrl_paths_get(argc, argv, &paths, &nr);
+		if (err)
+			goto out;
 	}
 
-	if (invalid_tags(cfg.storage_tag, cfg.ref_tag, sts, pif))
-		return -EINVAL;
+	devs = calloc(nr, sizeof(*devs));
+	cws = calloc(nr, sizeof(*cws));
+	res = calloc(nr, sizeof(*res));
+	if (!devs || !cws || !res) {
+		err = -ENOMEM;
+		goto out;
+	}
 
-	struct nvme_io_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
+	struct nvme_io_job job = {
+		.opcode		= nvme_cmd_compare,
 		.slba		= cfg.start_block,
+		.nr_lbas	= cfg.locks * (cfg.block_count + 1),
 		.nlb		= cfg.block_count,
 		.control	= control,
-		.reftag_u64	= cfg.ref_tag,
-		.apptag		= cfg.app_tag,
-		.appmask	= cfg.app_tag_mask,
-		.sts		= sts,
-		.pif		= pif,
-		.storage_tag	= cfg.storage_tag,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= NULL,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.ops		= &cw_bench_ops,
 	};
-	err = nvme_verify(&args);
-	if (err < 0)
-		nvme_show_error("verify: %s", nvme_strerror(errno));
-	else if (err != 0)
-		nvme_show_status(err);
-	else
-		printf("NVME Verify Success\n");
+
+	for (i = 0; i < nr; i++) {
+		struct io_bench_dev *d = &devs[i];
+
+		d->gfd = -1;
+		if (open_dev_direct(&d->dev, paths[i], cfg.force ? O_RDONLY : O_RDONLY | O_EXCL)) {
+			err = -errno;
+			if (errno == EBUSY)
+				fprintf(stderr, "%s: namespace is currently busy, see --force\n",
+					paths[i]);
+			goto out;
+		}
+
+		d->job = job;
+		d->job.progress = &d->progress;
+		d->job.priv = &cws[i];
+		cws[i].locks = cfg.locks;
+		err = io_bench_ns_setup(d->dev, &d->job, cfg.prinfo, "", &d->pattern, &d->gfd);
+		if (!err)
+			err = cw_bench_init(&cws[i], &d->job, i);
+		if (err) {
+			nvme_show_error("%s: compare-write-bench setup failed", paths[i]);
+			goto out;
+		}
+		res[i].name = basename(paths[i]);
+	}
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	for (i = 0; i < nr; i++) {
+		err = -pthread_create(&devs[i].thread, NULL, io_bench_dev_fn, &devs[i]);
+		if (err) {
+			nvme_io_engine_stop();
+			break;
+		}
+		started++;
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(devs[i].thread, NULL);
+	nvme_stop_release();
+	if (err)
+		goto out;
+
+	/* the runs are over everywhere before any drain resets the engine */
+	nvme_hist_init(&lat);
+	for (i = 0; i < nr; i++) {
+		cw_bench_unqueue(&cws[i], &devs[i].job);
+		cw_bench_result(&cws[i], &devs[i], &res[i], &lat);
+		if (!res[i].err)
+			res[i].held = cw_bench_drain(&cws[i], &devs[i]);
+		if (!err && res[i].err)
+			err = res[i].err;
+
+		total.pairs += res[i].pairs;
+		total.acquired += res[i].acquired;
+		total.contended += res[i].contended;
+		total.released += res[i].released;
+		total.lost += res[i].lost;
+		total.errors += res[i].errors;
+		total.held += res[i].held;
+		total.pairs_per_sec += res[i].pairs_per_sec;
+	}
+	total.p50_ns = nvme_hist_percentile(&lat, 50);
+	total.p99_ns = nvme_hist_percentile(&lat, 99);
+	total.p999_ns = nvme_hist_percentile(&lat, 99.9);
+
+	b.runtime = cfg.runtime;
+	b.queue_depth = cfg.queue_depth;
+	b.threads = cfg.threads;
+	b.locks = cfg.locks;
+	b.nr_devs = nr;
+	b.devs = res;
+	b.total = &total;
+	nvme_show_cw_bench(&b, flags);
+
+	if (!err && (total.errors || total.held))
+		err = -EIO;
+out:
+	for (i = 0; devs && i < nr; i++) {
+		cw_bench_free(&cws[i], devs[i].job.threads);
+		close_file(&devs[i].gfd);
+		free(devs[i].pattern);
+		if (devs[i].dev)
+			dev_close(devs[i].dev);
+	}
+	ctrl_paths_free(paths, nr);
 
 	return err;
 }
@@ -8255,19 +21967,282 @@ static int sec_recv(int argc, char **argv, struct command *cmd, struct plugin *p
 		.result		= NULL,
 	};
 
-	err = nvme_cli_security_receive(dev, &args);
-	if (err < 0) {
-		nvme_show_error("security receive: %s", nvme_strerror(errno));
-	} else if (err != 0) {
+	err = nvme_cli_security_receive(dev, &args);
+	if (err < 0) {
+		nvme_show_error("security receive: %s", nvme_strerror(errno));
+	} else if (err != 0) {
+		nvme_show_status(err);
+	} else {
+		printf("NVME Security Receive Command Success\n");
+		if (!cfg.raw_binary)
+			d(sec_buf, cfg.size, 16, 1);
+		else if (cfg.size)
+			d_raw((unsigned char *)sec_buf, cfg.size);
+	}
+
+	return err;
+}
+
+/* LBAs of a command of a Get LBA Status scan, the most Range Length holds */
+#define LBA_SCAN_CHUNK		0xffff
+/* dwords a command of a scan returns without --max-dw, a page */
+#define LBA_SCAN_MNDW		(4096 / 4 - 1)
+
+struct lba_scan {
+	struct nvme_dev *dev;
+	__u32 nsid;
+	__u8 atype;
+	__u32 mndw;
+	__u64 slba;
+	__u64 end;
+	__u64 nr_chunks;
+
+	pthread_mutex_t lock;
+	__u64 next;		/* chunk claimed by the next command */
+	int err;		/* first failure, stops the scan */
+	int errnum;
+};
+
+struct lba_scan_worker {
+	struct lba_scan *scan;
+	struct nvme_lba_status_desc *descs;
+	size_t nr;
+	size_t size;
+};
+
+static int lba_scan_add(struct lba_scan_worker *w, const struct nvme_lba_status_desc *d)
+{
+	struct nvme_lba_status_desc *tmp;
+
+	if (w->nr == w->size) {
+		tmp = realloc(w->descs, (w->size ? 2 * w->size : 64) * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		w->descs = tmp;
+		w->size = w->size ? 2 * w->size : 64;
+	}
+	w->descs[w->nr++] = *d;
+
+	return 0;
+}
+
+/* the descriptors of [@slba, @end), paging on when a reply is cut short */
+static int lba_scan_chunk(struct lba_scan_worker *w, struct nvme_lba_status *list,
+			  __u64 slba, __u64 end)
+{
+	struct lba_scan *scan = w->scan;
+	size_t max = ((scan->mndw + 1) * 4 - sizeof(*list)) / sizeof(list->descs[0]);
+	struct nvme_lba_status_desc *last;
+	__u32 i, nr;
+	__u64 next;
+	int err;
+
+	while (slba < end) {
+		struct nvme_get_lba_status_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(scan->dev),
+			.nsid		= scan->nsid,
+			.slba		= slba,
+			.mndw		= scan->mndw,
+			.rl		= end - slba,
+			.atype		= scan->atype,
+			.lbas		= list,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= NULL,
+		};
+
+		err = nvme_get_lba_status(&args);
+		if (err)
+			return err;
+
+		nr = min(le32_to_cpu(list->nlsd), max);
+		for (i = 0; i < nr; i++) {
+			err = lba_scan_add(w, &list->descs[i]);
+			if (err)
+				return err;
+		}
+
+		/* only a reply cut short by MNDW leaves out some of the range */
+		if (list->cmpc != 1 || !nr)
+			break;
+		last = &list->descs[nr - 1];
+		next = le64_to_cpu(last->dslba) + le32_to_cpu(last->nlb);
+		if (next <= slba)
+			break;
+		slba = next;
+	}
+
+	return 0;
+}
+
+static void lba_scan_run(void *arg)
+{
+	struct lba_scan_worker *w = arg;
+	struct lba_scan *scan = w->scan;
+	_cleanup_free_ struct nvme_lba_status *list = NULL;
+	__u64 chunk, slba;
+	int err = 0;
+
+	list = nvme_alloc((scan->mndw + 1) * 4);
+	if (!list)
+		err = -ENOMEM;
+
+	while (!err) {
+		pthread_mutex_lock(&scan->lock);
+		chunk = scan->err ? scan->nr_chunks : scan->next++;
+		pthread_mutex_unlock(&scan->lock);
+		if (chunk >= scan->nr_chunks)
+			return;
+
+		slba = scan->slba + chunk * LBA_SCAN_CHUNK;
+		err = lba_scan_chunk(w, list, slba, min(slba + LBA_SCAN_CHUNK, scan->end));
+	}
+
+	pthread_mutex_lock(&scan->lock);
+	if (!scan->err) {
+		scan->err = err;
+		scan->errnum = errno;
+	}
+	pthread_mutex_unlock(&scan->lock);
+}
+
+static int lba_desc_cmp(const void *a, const void *b)
+{
+	__u64 x = le64_to_cpu(((const struct nvme_lba_status_desc *)a)->dslba);
+	__u64 y = le64_to_cpu(((const struct nvme_lba_status_desc *)b)->dslba);
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Sort the descriptors of all the workers into @list and merge the ones
+ * of the same status that overlap or touch, returns how many are left.
+ */
+static __u32 lba_scan_merge(struct lba_scan_worker *w, int nr_workers,
+			    struct nvme_lba_status *list)
+{
+	struct nvme_lba_status_desc *d = list->descs, *prev;
+	__u64 start, end, prev_end;
+	size_t i, j, n = 0;
+	int k;
+
+	for (k = 0; k < nr_workers; k++) {
+		if (!w[k].nr)
+			continue;
+		memcpy(&d[n], w[k].descs, w[k].nr * sizeof(*d));
+		n += w[k].nr;
+	}
+	qsort(d, n, sizeof(*d), lba_desc_cmp);
+
+	for (i = 0, j = 0; i < n; i++) {
+		start = le64_to_cpu(d[i].dslba);
+		end = start + le32_to_cpu(d[i].nlb);
+		if (j) {
+			prev = &d[j - 1];
+			prev_end = le64_to_cpu(prev->dslba) + le32_to_cpu(prev->nlb);
+			if (prev->status == d[i].status && start <= prev_end &&
+			    max(end, prev_end) - le64_to_cpu(prev->dslba) <= UINT32_MAX) {
+				if (end > prev_end)
+					prev->nlb = cpu_to_le32(end - le64_to_cpu(prev->dslba));
+				continue;
+			}
+		}
+		d[j++] = d[i];
+	}
+
+	return j;
+}
+
+/*
+ * Get LBA Status over [@slba, @end) in commands of LBA_SCAN_CHUNK LBAs,
+ * @qd of them in flight, and show the merged ranges as one list.
+ */
+static int lba_status_scan(struct nvme_dev *dev, __u32 nsid, __u8 atype, __u32 mndw,
+			   const char *range, unsigned int qd, enum nvme_print_flags flags)
+{
+	_cleanup_free_ struct lba_scan_worker *w = NULL;
+	_cleanup_free_ struct nvme_lba_status *list = NULL;
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	struct nvme_thread_pool *pool = NULL;
+	struct lba_scan scan = {
+		.dev	= dev,
+		.nsid	= nsid,
+		.atype	= atype,
+		.mndw	= mndw ? mndw : LBA_SCAN_MNDW,
+	};
+	__u64 nr_lbas;
+	size_t total = 0;
+	unsigned int i;
+	__u32 nr;
+	int err;
+
+	if (!qd) {
+		nvme_show_error("queue-depth must be non-zero");
+		return -EINVAL;
+	}
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_cli_identify_ns(dev, nsid, ns);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("identify namespace: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	err = parse_lba_range(range, le64_to_cpu(ns->nsze), &scan.slba, &nr_lbas);
+	if (err) {
+		nvme_show_error("invalid range '%s' of a namespace of %"PRIu64" LBAs",
+				range, (uint64_t)le64_to_cpu(ns->nsze));
+		return err;
+	}
+	scan.end = scan.slba + nr_lbas;
+	scan.nr_chunks = (nr_lbas + LBA_SCAN_CHUNK - 1) / LBA_SCAN_CHUNK;
+	qd = min(qd, scan.nr_chunks);
+
+	w = calloc(qd, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+
+	pthread_mutex_init(&scan.lock, NULL);
+	if (qd > 1 && cmd_concurrent(dev, true, nvme_admin_get_lba_status))
+		pool = nvme_thread_pool_create(qd);
+	for (i = 0; i < qd; i++) {
+		w[i].scan = &scan;
+		if (!pool || nvme_thread_pool_queue(pool, lba_scan_run, &w[i]))
+			lba_scan_run(&w[i]);
+	}
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+	pthread_mutex_destroy(&scan.lock);
+
+	err = scan.err;
+	for (i = 0; i < qd; i++)
+		total += w[i].nr;
+
+	if (!err) {
+		list = calloc(1, sizeof(*list) + total * sizeof(list->descs[0]));
+		if (!list)
+			err = -ENOMEM;
+	}
+	if (!err) {
+		nr = lba_scan_merge(w, qd, list);
+		list->nlsd = cpu_to_le32(nr);
+		nvme_show_lba_status(list, sizeof(*list) + nr * sizeof(list->descs[0]), flags);
+	} else if (err > 0) {
 		nvme_show_status(err);
 	} else {
-		printf("NVME Security Receive Command Success\n");
-		if (!cfg.raw_binary)
-			d(sec_buf, cfg.size, 16, 1);
-		else if (cfg.size)
-			d_raw((unsigned char *)sec_buf, cfg.size);
+		nvme_show_error("get lba status: %s",
+				nvme_strerror(err == -1 ? scan.errnum : -err));
 	}
 
+	for (i = 0; i < qd; i++)
+		free(w[i].descs);
+
 	return err;
 }
 
@@ -8283,6 +22258,9 @@ static int get_lba_status(int argc, char **argv, struct command *cmd,
 		"the controller uses in determining the LBA Status Descriptors to return.";
 	const char *rl =
 	    "Range Length(RL) specifies the length of the range of contiguous LBAs beginning at SLBA";
+	const char *range = "LBA extent <start>:<end> (end exclusive, empty or 'all' for the\n"
+		"end of the namespace) scanned in many commands, the ranges merged";
+	const char *qd = "commands in flight for --range";
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	_cleanup_free_ void *buf = NULL;
@@ -8297,6 +22275,8 @@ static int get_lba_status(int argc, char **argv, struct command *cmd,
 		__u8	atype;
 		__u16	rl;
 		__u32	timeout;
+		char	*range;
+		__u32	queue_depth;
 	};
 
 	struct config cfg = {
@@ -8306,6 +22286,8 @@ static int get_lba_status(int argc, char **argv, struct command *cmd,
 		.atype		= 0,
 		.rl		= 0,
 		.timeout	= 0,
+		.range		= NULL,
+		.queue_depth	= 8,
 	};
 
 	NVME_ARGS(opts,
@@ -8314,7 +22296,9 @@ static int get_lba_status(int argc, char **argv, struct command *cmd,
 		  OPT_UINT("max-dw",       'm', &cfg.mndw,          mndw),
 		  OPT_BYTE("action",       'a', &cfg.atype,         atype),
 		  OPT_SHRT("range-len",    'l', &cfg.rl,            rl),
-		  OPT_UINT("timeout",      't', &cfg.timeout,       timeout));
+		  OPT_UINT("timeout",      't', &cfg.timeout,       timeout),
+		  OPT_STR("range",         'R', &cfg.range,         range),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,   qd));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
@@ -8331,6 +22315,18 @@ static int get_lba_status(int argc, char **argv, struct command *cmd,
 		return -EINVAL;
 	}
 
+	if (cfg.range) {
+		if (!cfg.namespace_id) {
+			err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+			if (err < 0) {
+				nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+				return err;
+			}
+		}
+		return lba_status_scan(dev, cfg.namespace_id, cfg.atype, cfg.mndw,
+				       cfg.range, cfg.queue_depth, flags);
+	}
+
 	buf_len = (cfg.mndw + 1) * 4;
 	buf = nvme_alloc(buf_len);
 	if (!buf)
@@ -8431,6 +22427,245 @@ static int capacity_mgmt(int argc, char **argv, struct command *cmd, struct plug
 	return err;
 }
 
+static int cap_layout_append(struct nvme_cap_layout *l, __u8 op, __u16 id, __u64 cap)
+{
+	struct nvme_cap_layout_op *tmp;
+
+	tmp = realloc(l->ops, (l->nr_ops + 1) * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	l->ops = tmp;
+	l->ops[l->nr_ops++] = (struct nvme_cap_layout_op) {
+		.op		= op,
+		.element_id	= id,
+		.capacity	= cap,
+	};
+
+	return 0;
+}
+
+/*
+ * Queue an @op for every entry of the comma separated @list: identifiers
+ * to delete, capacities to create endurance groups of, or
+ * <endgid>:<capacity> pairs to create NVM sets of.
+ */
+static int cap_layout_add(struct nvme_cap_layout *l, __u8 op, const char *list)
+{
+	_cleanup_free_ char *copy = NULL;
+	char *tok, *save, *end;
+	unsigned long id = 0;
+	uint64_t cap = 0;
+	int err;
+
+	if (!strlen(list))
+		return 0;
+
+	copy = strdup(list);
+	if (!copy)
+		return -ENOMEM;
+
+	for (tok = strtok_r(copy, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (op != NVME_CAP_LAYOUT_CREATE_ENDGRP) {
+			errno = 0;
+			id = strtoul(tok, &end, 0);
+			if (errno || end == tok || id > 0xffff ||
+			    *end != (op == NVME_CAP_LAYOUT_CREATE_NVMSET ? ':' : '\0'))
+				goto invalid;
+			tok = end + 1;
+		}
+		if (op == NVME_CAP_LAYOUT_CREATE_ENDGRP || op == NVME_CAP_LAYOUT_CREATE_NVMSET) {
+			if (suffix_binary_parse(tok, &end, &cap) || !cap)
+				goto invalid;
+		}
+
+		err = cap_layout_append(l, op, id, cap);
+		if (err)
+			return err;
+	}
+
+	return 0;
+
+invalid:
+	nvme_show_error("invalid %s entry in '%s'", nvme_cap_layout_op_to_string(op), list);
+	return -EINVAL;
+}
+
+/* whether @id is one of the configurations of the Supported Capacity Configuration List */
+static bool cap_config_supported(struct nvme_supported_cap_config_list_log *log, __u16 id)
+{
+	int i;
+
+	for (i = 0; i < log->sccn; i++)
+		if (le16_to_cpu(log->cap_config_desc[i].cap_config_id) == id)
+			return true;
+
+	return false;
+}
+
+/* run the operations of @l that are of @op in order, stops at the first failure */
+static int cap_layout_phase(struct nvme_dev *dev, struct nvme_cap_layout *l, __u8 op)
+{
+	struct nvme_cap_layout_phase *ph = &l->phases[l->nr_phases++];
+	struct nvme_cap_layout_op *o;
+	__u64 start_ns = monotonic_ns();
+	int i, err = 0;
+
+	ph->name = nvme_cap_layout_op_to_string(op);
+	for (i = 0; i < l->nr_ops && !err; i++) {
+		o = &l->ops[i];
+		if (o->op != op)
+			continue;
+
+		struct nvme_capacity_mgmt_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(dev),
+			.op		= op,
+			.element_id	= o->element_id,
+			.cdw11		= o->capacity & 0xffffffff,
+			.cdw12		= o->capacity >> 32,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= &o->result,
+		};
+
+		o->elapsed_ns = monotonic_ns();
+		err = nvme_capacity_mgmt(&args);
+		o->elapsed_ns = monotonic_ns() - o->elapsed_ns;
+		o->err = err < 0 ? -errno : err;
+		o->run = true;
+		err = o->err;
+		ph->nr++;
+	}
+	ph->elapsed_ns = monotonic_ns() - start_ns;
+
+	return err;
+}
+
+/*
+ * capacity-layout: a whole endurance group and NVM set layout in one go,
+ * the NVM sets and endurance groups to drop deleted first, then the
+ * capacity configuration selected and the new ones created.
+ */
+static int capacity_layout(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Reconfigure the Endurance Groups and NVM Sets of the NVM\n"
+		"subsystem with a series of Capacity Management operations: delete\n"
+		"NVM Sets and Endurance Groups, select a supported capacity\n"
+		"configuration, create Endurance Groups and NVM Sets, and report the\n"
+		"time every phase took.";
+	const char *config = "capacity configuration to select, checked against the\n"
+		"Supported Capacity Configuration List log";
+	const char *delete_nvmsets = "comma separated NVM Set IDs to delete";
+	const char *delete_endgrps = "comma separated Endurance Group IDs to delete";
+	const char *create_endgrps = "comma separated capacities in bytes of the Endurance\n"
+		"Groups to create, suffixes like Gi allowed";
+	const char *create_nvmsets = "comma separated <endgid>:<capacity> of the NVM Sets to create";
+
+	_cleanup_free_ struct nvme_supported_cap_config_list_log *cap_log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	struct nvme_cap_layout l = { 0 };
+	enum nvme_print_flags flags;
+	__u64 start_ns;
+	int err;
+
+	struct config {
+		__u16	domainid;
+		__u16	config;
+		char	*delete_nvmsets;
+		char	*delete_endgrps;
+		char	*create_endgrps;
+		char	*create_nvmsets;
+	};
+
+	struct config cfg = {
+		.domainid	= 0,
+		.config		= NVME_CAP_LAYOUT_NO_CONFIG,
+		.delete_nvmsets	= "",
+		.delete_endgrps	= "",
+		.create_endgrps	= "",
+		.create_nvmsets	= "",
+	};
+
+	NVME_ARGS(opts,
+		  OPT_SHRT("domain-id",      'd', &cfg.domainid,       domainid),
+		  OPT_SHRT("config",         'c', &cfg.config,         config),
+		  OPT_LIST("delete-nvmsets", 'S', &cfg.delete_nvmsets, delete_nvmsets),
+		  OPT_LIST("delete-endgrps", 'G', &cfg.delete_endgrps, delete_endgrps),
+		  OPT_LIST("create-endgrps", 'E', &cfg.create_endgrps, create_endgrps),
+		  OPT_LIST("create-nvmsets", 'N', &cfg.create_nvmsets, create_nvmsets));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	err = cap_layout_add(&l, NVME_CAP_LAYOUT_DELETE_NVMSET, cfg.delete_nvmsets);
+	if (!err)
+		err = cap_layout_add(&l, NVME_CAP_LAYOUT_DELETE_ENDGRP, cfg.delete_endgrps);
+	if (!err && cfg.config != NVME_CAP_LAYOUT_NO_CONFIG)
+		err = cap_layout_append(&l, NVME_CAP_LAYOUT_SELECT, cfg.config, 0);
+	if (!err)
+		err = cap_layout_add(&l, NVME_CAP_LAYOUT_CREATE_ENDGRP, cfg.create_endgrps);
+	if (!err)
+		err = cap_layout_add(&l, NVME_CAP_LAYOUT_CREATE_NVMSET, cfg.create_nvmsets);
+	if (err)
+		goto free;
+
+	if (!l.nr_ops) {
+		nvme_show_error("nothing to do, give --config or a list to delete or create");
+		err = -EINVAL;
+		goto free;
+	}
+
+	start_ns = monotonic_ns();
+
+	/* the configuration is checked before anything is deleted */
+	if (cfg.config != NVME_CAP_LAYOUT_NO_CONFIG) {
+		l.list_ns = monotonic_ns();
+		cap_log = nvme_alloc(sizeof(*cap_log));
+		if (!cap_log) {
+			err = -ENOMEM;
+			goto free;
+		}
+		err = nvme_cli_get_log_support_cap_config_list(dev, cfg.domainid, cap_log);
+		l.list_ns = monotonic_ns() - l.list_ns;
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				nvme_show_perror("supported capacity configuration list log");
+			goto free;
+		}
+		if (!cap_config_supported(cap_log, cfg.config)) {
+			nvme_show_error("capacity configuration %u is not supported", cfg.config);
+			err = -EINVAL;
+			goto free;
+		}
+	}
+
+	err = cap_layout_phase(dev, &l, NVME_CAP_LAYOUT_DELETE_NVMSET);
+	if (!err)
+		err = cap_layout_phase(dev, &l, NVME_CAP_LAYOUT_DELETE_ENDGRP);
+	if (!err)
+		err = cap_layout_phase(dev, &l, NVME_CAP_LAYOUT_SELECT);
+	if (!err)
+		err = cap_layout_phase(dev, &l, NVME_CAP_LAYOUT_CREATE_ENDGRP);
+	if (!err)
+		err = cap_layout_phase(dev, &l, NVME_CAP_LAYOUT_CREATE_NVMSET);
+
+	l.name = dev->name;
+	l.elapsed_ns = monotonic_ns() - start_ns;
+	nvme_show_cap_layout(&l, flags);
+free:
+	free(l.ops);
+
+	return err;
+}
+
 static int dir_receive(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Read directive parameters of the specified directive type.";
@@ -8525,29 +22760,279 @@ static int dir_receive(int argc, char **argv, struct command *cmd, struct plugin
 			return -ENOMEM;
 	}
 
-	struct nvme_directive_recv_args args = {
-		.args_size	= sizeof(args),
-		.fd		= dev_fd(dev),
-		.nsid		= cfg.namespace_id,
-		.dspec		= cfg.dspec,
-		.doper		= cfg.doper,
-		.dtype		= cfg.dtype,
-		.cdw12		= dw12,
-		.data_len	= cfg.data_len,
-		.data		= buf,
-		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result		= &result,
-	};
-	err = nvme_directive_recv(&args);
-	if (!err)
-		nvme_directive_show(cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id,
-				    result, buf, cfg.data_len, flags);
-	else if (err > 0)
-		nvme_show_status(err);
-	else if (err < 0)
-		nvme_show_error("dir-receive: %s", nvme_strerror(errno));
+	struct nvme_directive_recv_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.dspec		= cfg.dspec,
+		.doper		= cfg.doper,
+		.dtype		= cfg.dtype,
+		.cdw12		= dw12,
+		.data_len	= cfg.data_len,
+		.data		= buf,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+	err = nvme_directive_recv(&args);
+	if (!err)
+		nvme_directive_show(cfg.dtype, cfg.doper, cfg.dspec, cfg.namespace_id,
+				    result, buf, cfg.data_len, flags);
+	else if (err > 0)
+		nvme_show_status(err);
+	else if (err < 0)
+		nvme_show_error("dir-receive: %s", nvme_strerror(errno));
+
+	return err;
+}
+
+/* a Directive Receive or Send of the Streams of @nsid, doper with @cdw12 */
+static int streams_directive(struct nvme_dev *dev, bool send, __u32 nsid, __u8 dtype,
+			     __u8 doper, __u32 cdw12, void *data, __u32 data_len,
+			     __u32 *result)
+{
+	if (send) {
+		struct nvme_directive_send_args args = {
+			.args_size	= sizeof(args),
+			.fd		= dev_fd(dev),
+			.nsid		= nsid,
+			.dspec		= 0,
+			.doper		= doper,
+			.dtype		= dtype,
+			.cdw12		= cdw12,
+			.data_len	= data_len,
+			.data		= data,
+			.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+			.result		= result,
+		};
+
+		return nvme_directive_send(&args);
+	}
+
+	struct nvme_directive_recv_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= nsid,
+		.dspec		= 0,
+		.doper		= doper,
+		.dtype		= dtype,
+		.cdw12		= cdw12,
+		.data_len	= data_len,
+		.data		= data,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= result,
+	};
+
+	return nvme_directive_recv(&args);
+}
+
+static int streams_params(struct nvme_dev *dev, __u32 nsid,
+			  struct nvme_streams_directive_params *p)
+{
+	return streams_directive(dev, false, nsid, NVME_DIRECTIVE_DTYPE_STREAMS,
+				 NVME_DIRECTIVE_RECEIVE_STREAMS_DOPER_PARAM, 0,
+				 p, sizeof(*p), NULL);
+}
+
+enum streams_action {
+	STREAMS_STATUS,
+	STREAMS_ALLOCATE,
+	STREAMS_RELEASE,
+};
+
+static const char *const streams_actions[] = {
+	[STREAMS_STATUS]	= "status",
+	[STREAMS_ALLOCATE]	= "allocate",
+	[STREAMS_RELEASE]	= "release",
+};
+
+static int streams_ns(struct nvme_dev *dev, enum streams_action action, bool enable,
+		      struct nvme_streams_ns *ns)
+{
+	struct nvme_streams_directive_params p;
+	__u32 result = 0;
+	int err;
+
+	if (enable) {
+		err = streams_directive(dev, true, ns->nsid, NVME_DIRECTIVE_DTYPE_IDENTIFY,
+					NVME_DIRECTIVE_SEND_IDENTIFY_DOPER_ENDIR,
+					NVME_DIRECTIVE_DTYPE_STREAMS << 8 | 1, NULL, 0, NULL);
+		if (err)
+			return err;
+	}
+
+	switch (action) {
+	case STREAMS_ALLOCATE:
+		err = streams_directive(dev, false, ns->nsid, NVME_DIRECTIVE_DTYPE_STREAMS,
+					NVME_DIRECTIVE_RECEIVE_STREAMS_DOPER_RESOURCE,
+					ns->requested, NULL, 0, &result);
+		ns->nsa = result & 0xffff;
+		return err;
+	case STREAMS_RELEASE:
+		return streams_directive(dev, true, ns->nsid, NVME_DIRECTIVE_DTYPE_STREAMS,
+					 NVME_DIRECTIVE_SEND_STREAMS_DOPER_RELEASE_RESOURCE,
+					 0, NULL, 0, NULL);
+	case STREAMS_STATUS:
+		break;
+	}
+
+	err = streams_params(dev, ns->nsid, &p);
+	if (!err) {
+		ns->nsa = le16_to_cpu(p.nsa);
+		ns->nso = le16_to_cpu(p.nso);
+	}
+	return err;
+}
+
+/*
+ * dir-streams: the Streams resources of many namespaces. The subsystem
+ * parameters are read once, then every namespace gets a single Allocate
+ * Resources, Release Resources or Return Parameters command.
+ */
+static int dir_streams(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Allocate, release or report the Streams directive\n"
+		"resources of many namespaces at once, for multi-stream writes.";
+	const char *action = "status, allocate or release";
+	const char *nsids = "comma separated list of namespace IDs";
+	const char *all = "every namespace attached to the controller";
+	const char *count = "streams to allocate per namespace (default: share the\n"
+		"available streams of the subsystem evenly, up to MSL)";
+	const char *enable = "enable the Streams directive of the namespaces first";
+
+	_cleanup_free_ struct nvme_streams_ns *list = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ __u32 *ids = NULL;
+	struct nvme_streams_directive_params p;
+	struct nvme_streams s = { 0 };
+	enum nvme_print_flags flags;
+	int i, nr = 0, err;
+	__u64 start_ns;
+	size_t a;
+
+	struct config {
+		char	*action;
+		char	*nsids;
+		bool	all;
+		__u16	count;
+		bool	enable;
+	};
+
+	struct config cfg = {
+		.action		= "status",
+		.nsids		= "",
+		.all		= false,
+		.count		= 0,
+		.enable		= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_STRING("action",       'A', "ACTION", &cfg.action, action),
+		  OPT_LIST("namespace-ids",  'n', &cfg.nsids,  nsids),
+		  OPT_FLAG("all-namespaces", 'N', &cfg.all,    all),
+		  OPT_SHRT("count",          'c', &cfg.count,  count),
+		  OPT_FLAG("enable",         'e', &cfg.enable, enable));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	for (a = 0; a < ARRAY_SIZE(streams_actions); a++)
+		if (!strcmp(cfg.action, streams_actions[a]))
+			break;
+	if (a == ARRAY_SIZE(streams_actions)) {
+		nvme_show_error("--action must be status, allocate or release");
+		return -EINVAL;
+	}
+
+	if (cfg.all && strlen(cfg.nsids)) {
+		nvme_show_error("give either --namespace-ids or --all-namespaces");
+		return -EINVAL;
+	}
+
+	if (cfg.all) {
+		err = active_nsids(dev, &ids, &nr);
+		if (err)
+			return err;
+	} else if (strlen(cfg.nsids)) {
+		ids = calloc(1024, sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+		nr = argconfig_parse_comma_sep_array_u32(cfg.nsids, ids, 1024);
+		if (nr <= 0) {
+			nvme_show_error("invalid namespace list: %s", cfg.nsids);
+			return -EINVAL;
+		}
+	} else {
+		ids = calloc(1, sizeof(*ids));
+		if (!ids)
+			return -ENOMEM;
+		err = nvme_get_nsid(dev_fd(dev), &ids[0]);
+		if (err < 0) {
+			nvme_show_error("get-namespace-id: %s", nvme_strerror(errno));
+			return err;
+		}
+		nr = 1;
+	}
+
+	if (!nr) {
+		nvme_show_error("no namespaces attached");
+		return -ENODEV;
+	}
+
+	list = calloc(nr, sizeof(*list));
+	if (!list)
+		return -ENOMEM;
+
+	start_ns = monotonic_ns();
+
+	/* MSL, NSSA and friends are the same through every namespace */
+	err = streams_params(dev, ids[0], &p);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			nvme_show_error("streams parameters: %s", nvme_strerror(errno));
+		return err;
+	}
+	s.msl = le16_to_cpu(p.msl);
+	s.nssa = le16_to_cpu(p.nssa);
+	s.nsso = le16_to_cpu(p.nsso);
+	s.sws = le32_to_cpu(p.sws);
+	s.sgs = le16_to_cpu(p.sgs);
+
+	if (a == STREAMS_ALLOCATE && !cfg.count) {
+		cfg.count = min(s.nssa / nr, s.msl);
+		if (!cfg.count) {
+			nvme_show_error("no streams available to allocate");
+			return -ENOSPC;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		list[i].nsid = ids[i];
+		list[i].requested = cfg.count;
+		err = streams_ns(dev, a, cfg.enable, &list[i]);
+		list[i].err = err < 0 ? -errno : err;
+	}
 
-	return err;
+	s.name = dev->name;
+	s.action = streams_actions[a];
+	s.ns = list;
+	s.nr_ns = nr;
+	s.elapsed_ns = monotonic_ns() - start_ns;
+	nvme_show_streams(&s, flags);
+
+	for (i = 0; i < nr; i++)
+		if (list[i].err)
+			return list[i].err;
+
+	return 0;
 }
 
 /* rpmb_cmd_option is defined in nvme-rpmb.c */
@@ -8673,6 +23158,145 @@ static void passthru_print_read_output(struct passthru_config cfg, void *data, i
 	}
 }
 
+struct passthru_loop {
+	struct passthru_config *cfg;
+	__u32 nsids[NVME_ID_NS_LIST_MAX];
+	int nr_nsids;
+};
+
+static int passthru_loop_prep(struct nvme_io_job *job, unsigned int thread,
+			      __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct passthru_loop *l = job->priv;
+	struct passthru_config *cfg = l->cfg;
+
+	/* keep the slot buffers the engine set up, all else is the user's */
+	cmd->opcode = cfg->opcode;
+	cmd->flags = cfg->flags;
+	cmd->rsvd1 = cfg->rsvd;
+	cmd->nsid = l->nr_nsids ? l->nsids[seq % l->nr_nsids] : cfg->namespace_id;
+	cmd->cdw2 = cfg->cdw2;
+	cmd->cdw3 = cfg->cdw3;
+	cmd->cdw10 = cfg->cdw10;
+	cmd->cdw11 = cfg->cdw11;
+	cmd->cdw12 = cfg->cdw12;
+	cmd->cdw13 = cfg->cdw13;
+	cmd->cdw14 = cfg->cdw14;
+	cmd->cdw15 = cfg->cdw15;
+	cmd->timeout_ms = cfg->timeout;
+	cmd->data_len = cfg->data_len;
+	if (!cfg->data_len)
+		cmd->addr = 0;
+
+	return 0;
+}
+
+static const struct nvme_io_job_ops passthru_loop_ops = {
+	.prep	= passthru_loop_prep,
+};
+
+/* admin commands only go through the controller char device (/dev/nvmeX) */
+static int open_ctrl_dev(struct nvme_dev *dev)
+{
+	unsigned int ctrl;
+	int n = 0;
+
+	if (!is_chardev(dev) || sscanf(dev->name, "nvme%u%n", &ctrl, &n) != 1 ||
+	    dev->name[n]) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	return dup(dev_fd(dev));
+}
+
+/*
+ * --repeat: send the command over and over through the I/O engine with
+ * queue_depth of them in flight on every thread. All commands share the
+ * data the single command would have sent, read data is dropped.
+ */
+static int passthru_loop(struct nvme_dev *dev, bool admin,
+			 struct passthru_config *cfg, void *data)
+{
+	const char *name = admin ? "admin-passthru" : "io-passthru";
+	_cleanup_free_ struct passthru_loop *l = NULL;
+	enum nvme_print_flags flags;
+	struct nvme_io_stats stats;
+	char p2pmem[PATH_MAX];
+	_cleanup_file_ int fd = -1;
+	int err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (!cfg->queue_depth || !cfg->threads) {
+		nvme_show_error("queue-depth and threads must be non-zero");
+		return -EINVAL;
+	}
+
+	l = calloc(1, sizeof(*l));
+	if (!l)
+		return -ENOMEM;
+	l->cfg = cfg;
+
+	if (strlen(cfg->namespaces)) {
+		l->nr_nsids = argconfig_parse_comma_sep_array_u32(cfg->namespaces,
+								  l->nsids,
+								  ARRAY_SIZE(l->nsids));
+		if (l->nr_nsids <= 0) {
+			nvme_show_error("Invalid namespace list %s", cfg->namespaces);
+			return -EINVAL;
+		}
+	}
+
+	if (cfg->cmb && cmb_p2pmem(dev, p2pmem, sizeof(p2pmem)))
+		return -errno;
+
+	struct nvme_io_job job = {
+		.admin		= admin,
+		.nsid		= l->nr_nsids ? l->nsids[0] : cfg->namespace_id,
+		.opcode		= cfg->opcode,
+		.nlb		= 0,
+		/* the slot buffers of data less commands are unused, keep them small */
+		.lba_size	= cfg->data_len ? cfg->data_len : (__u32)getpagesize(),
+		.ms		= cfg->metadata_len,
+		.queue_depth	= cfg->queue_depth,
+		.threads	= cfg->threads,
+		.nr_ios		= cfg->repeat,
+		.cmb		= cfg->cmb ? p2pmem : NULL,
+		.pattern	= data,
+		.pattern_len	= data ? cfg->data_len : 0,
+		.ops		= &passthru_loop_ops,
+		.priv		= l,
+	};
+
+	fd = admin ? open_ctrl_dev(dev) : open_generic_dev(dev);
+	if (fd < 0) {
+		err = -errno;
+		nvme_show_error("%s --repeat requires an NVMe %s: %s", name,
+				admin ? "controller character device" : "namespace",
+				nvme_strerror(-err));
+		return err;
+	}
+	job.fd = fd;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	if (err < 0) {
+		nvme_show_error("%s: %s", name, nvme_strerror(-err));
+		return err;
+	}
+
+	stats.bytes = (stats.ios - stats.errors) * cfg->data_len;
+	nvme_show_io_stats(name, &stats, flags);
+
+	return stats.errors ? -EIO : 0;
+}
+
 static int passthru(int argc, char **argv, bool admin,
 		const char *desc, struct command *cmd)
 {
@@ -8695,6 +23319,11 @@ static int passthru(int argc, char **argv, bool admin,
 	const char *re = "set dataflow direction to receive";
 	const char *wr = "set dataflow direction to send";
 	const char *prefill = "prefill buffers with known byte-value, default 0";
+	const char *cmb = "transfer the data through the controller memory buffer";
+	const char *repeat = "send the command NUM times through the I/O engine, report IOPS and latency";
+	const char *queue_depth = "commands in flight per thread for --repeat";
+	const char *threads = "number of submission threads for --repeat";
+	const char *namespaces = "comma separated namespace IDs the --repeat commands rotate through";
 
 	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
@@ -8733,6 +23362,11 @@ static int passthru(int argc, char **argv, bool admin,
 		.read		= false,
 		.write		= false,
 		.latency	= false,
+		.cmb		= false,
+		.repeat		= 0,
+		.queue_depth	= 1,
+		.threads	= 1,
+		.namespaces	= "",
 	};
 
 	NVME_ARGS(opts,
@@ -8759,12 +23393,22 @@ static int passthru(int argc, char **argv, bool admin,
 		  OPT_FLAG("dry-run",      'd', &cfg.dry_run,      dry),
 		  OPT_FLAG("read",         'r', &cfg.read,         re),
 		  OPT_FLAG("write",        'w', &cfg.write,        wr),
-		  OPT_FLAG("latency",      'T', &cfg.latency,      latency));
+		  OPT_FLAG("latency",      'T', &cfg.latency,      latency),
+		  OPT_FLAG("cmb",            0, &cfg.cmb,          cmb),
+		  OPT_UINT("repeat",       'N', &cfg.repeat,       repeat),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth,  queue_depth),
+		  OPT_UINT("threads",      'j', &cfg.threads,      threads),
+		  OPT_LIST("namespaces",   'L', &cfg.namespaces,   namespaces));
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
 
+	if (cfg.repeat && cfg.opcode & 0x02 && strlen(cfg.input_file)) {
+		nvme_show_error("--repeat drops the read data, --input-file can't be used");
+		return -EINVAL;
+	}
+
 	if (cfg.opcode & 0x01) {
 		cfg.write = true;
 		flags = O_RDONLY;
@@ -8809,10 +23453,22 @@ static int passthru(int argc, char **argv, bool admin,
 		}
 	}
 
-	if (cfg.data_len) {
+	if (cfg.cmb && admin) {
+		nvme_show_error("--cmb is only supported for I/O commands");
+		return -EINVAL;
+	}
+
+	if (cfg.data_len && cfg.cmb) {
+		data = cmb_alloc(dev, cfg.data_len, &mh);
+		if (!data)
+			return -errno;
+	} else if (cfg.data_len) {
 		data = nvme_alloc_huge(cfg.data_len, &mh);
 		if (!data)
 			return -ENOMEM;
+	}
+
+	if (cfg.data_len) {
 
 		memset(data, cfg.prefill, cfg.data_len);
 		if (!cfg.read && !cfg.write) {
@@ -8846,67 +23502,392 @@ static int passthru(int argc, char **argv, bool admin,
 		printf("cdw15        : %08x\n", cfg.cdw15);
 		printf("timeout_ms   : %08x\n", cfg.timeout);
 	}
-	if (cfg.dry_run)
-		return 0;
+	if (cfg.dry_run)
+		return 0;
+
+	batch_cmd_opcode = cfg.opcode;
+	batch_cmd_admin = admin;
+
+	if (cfg.repeat)
+		return passthru_loop(dev, admin, &cfg, data);
+
+	gettimeofday(&start_time, NULL);
+
+	if (admin)
+		err = nvme_cli_admin_passthru(dev, cfg.opcode, cfg.flags,
+					      cfg.rsvd,
+					      cfg.namespace_id, cfg.cdw2,
+					      cfg.cdw3, cfg.cdw10,
+					      cfg.cdw11, cfg.cdw12, cfg.cdw13,
+					      cfg.cdw14,
+					      cfg.cdw15, cfg.data_len, data,
+					      cfg.metadata_len,
+					      mdata, cfg.timeout, &result);
+	else
+		err = nvme_io_passthru(dev_fd(dev), cfg.opcode, cfg.flags,
+				       cfg.rsvd,
+				       cfg.namespace_id, cfg.cdw2, cfg.cdw3,
+				       cfg.cdw10,
+				       cfg.cdw11, cfg.cdw12, cfg.cdw13,
+				       cfg.cdw14,
+				       cfg.cdw15, cfg.data_len, data,
+				       cfg.metadata_len,
+				       mdata, cfg.timeout, &result);
+
+	gettimeofday(&end_time, NULL);
+	cmd_name = nvme_cmd_to_string(admin, cfg.opcode);
+	if (cfg.latency)
+		printf("%s Command %s latency: %llu us\n", admin ? "Admin" : "IO",
+		       strcmp(cmd_name, "Unknown") ? cmd_name : "Vendor Specific",
+		       elapsed_utime(start_time, end_time));
+
+	if (err < 0) {
+		nvme_show_error("%s: %s", __func__, nvme_strerror(errno));
+	} else if (err) {
+		nvme_show_status(err);
+	} else  {
+		fprintf(stderr, "%s Command %s is Success and result: 0x%08x\n", admin ? "Admin" : "IO",
+			strcmp(cmd_name, "Unknown") ? cmd_name : "Vendor Specific", result);
+		if (cfg.read)
+			passthru_print_read_output(cfg, data, dfd, mdata, mfd, err);
+	}
+
+	return err;
+}
+
+static int io_passthru(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "Send a user-defined IO command to the specified device via IOCTL passthrough, return results.";
+
+	return passthru(argc, argv, false, desc, cmd);
+}
+
+static int admin_passthru(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "Send a user-defined Admin command to the specified device via IOCTL passthrough, return results.";
+
+	return passthru(argc, argv, true, desc, cmd);
+}
+
+/* timed commands issued later than this after they were due count as late */
+#define REPLAY_LATE_NS	1000000ULL
+
+struct replay_job {
+	int fd;
+	struct nvme_replay_cmd *cmds;
+	size_t nr;
+	__u64 *due_ns;		/* since the start, with --timing only */
+	__u32 buf_len;		/* largest data transfer of the trace */
+	__u8 prefill;
+	__u64 start_ns;
+	__u64 next;		/* next command to claim */
+	__u64 done;
+	__u64 late;
+};
+
+struct replay_worker {
+	struct replay_job *job;
+	struct nvme_replay_op *ops[2][256];	/* admin, I/O; allocated on first use */
+	int err;
+};
+
+static struct nvme_replay_op *replay_op(struct replay_worker *w,
+					const struct nvme_replay_cmd *c)
+{
+	struct nvme_replay_op **op = &w->ops[c->admin ? 0 : 1][c->opcode];
+
+	if (!*op) {
+		*op = calloc(1, sizeof(**op));
+		if (!*op)
+			return NULL;
+		(*op)->admin = c->admin;
+		(*op)->opcode = c->opcode;
+		nvme_hist_init(&(*op)->lat);
+	}
+
+	return *op;
+}
+
+/*
+ * One command in flight per worker: the workers claim the commands of
+ * the trace in order and issue them with synchronous passthru ioctls.
+ * Data to the controller comes from a buffer the device never writes to.
+ */
+static void replay_worker(void *arg)
+{
+	struct replay_worker *w = arg;
+	struct replay_job *job = w->job;
+	struct nvme_mem_huge rmh = { 0, }, wmh = { 0, };
+	void *rbuf = NULL, *wbuf = NULL;
+	struct nvme_passthru_cmd cmd;
+	struct nvme_replay_cmd *c;
+	struct nvme_replay_op *op;
+	__u64 seq, due, start, lat;
+	int err;
+
+	if (job->buf_len) {
+		rbuf = nvme_alloc_huge(job->buf_len, &rmh);
+		wbuf = nvme_alloc_huge(job->buf_len, &wmh);
+		if (!rbuf || !wbuf) {
+			w->err = -ENOMEM;
+			goto out;
+		}
+		memset(wbuf, job->prefill, job->buf_len);
+	}
+
+	while (!nvme_stopped()) {
+		seq = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+		if (seq >= job->nr)
+			break;
+		c = &job->cmds[seq];
+
+		op = replay_op(w, c);
+		if (!op) {
+			w->err = -ENOMEM;
+			break;
+		}
+
+		if (job->due_ns) {
+			due = job->start_ns + job->due_ns[seq];
+			if (!nvme_interval_wait(due))
+				break;
+			if (monotonic_ns() - due > REPLAY_LATE_NS)
+				__atomic_add_fetch(&job->late, 1, __ATOMIC_RELAXED);
+		}
+
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.opcode = c->opcode;
+		cmd.flags = c->flags;
+		cmd.nsid = c->nsid;
+		cmd.cdw2 = c->cdw2;
+		cmd.cdw3 = c->cdw3;
+		cmd.cdw10 = c->cdw10;
+		cmd.cdw11 = c->cdw11;
+		cmd.cdw12 = c->cdw12;
+		cmd.cdw13 = c->cdw13;
+		cmd.cdw14 = c->cdw14;
+		cmd.cdw15 = c->cdw15;
+		cmd.timeout_ms = c->timeout_ms;
+		if (c->data_len) {
+			cmd.data_len = c->data_len;
+			cmd.addr = (__u64)(uintptr_t)(c->opcode & 1 ? wbuf : rbuf);
+		}
+
+		start = monotonic_ns();
+		if (c->admin)
+			err = nvme_submit_admin_passthru(job->fd, &cmd, NULL);
+		else
+			err = nvme_submit_io_passthru(job->fd, &cmd, NULL);
+		lat = monotonic_ns() - start;
+		if (err < 0)
+			err = -errno;
+
+		op->cmds++;
+		if (err) {
+			if (!op->errors++)
+				op->first_err = err;
+		} else {
+			op->bytes += c->data_len;
+		}
+		nvme_hist_add(&op->lat, lat);
+		__atomic_add_fetch(&job->done, 1, __ATOMIC_RELAXED);
+	}
+
+out:
+	nvme_free_huge(&rmh);
+	nvme_free_huge(&wmh);
+}
+
+/* Merge the per worker statistics of every opcode, admin before I/O */
+static int replay_merge(struct replay_worker *workers, unsigned int nr_workers,
+			struct nvme_replay *r)
+{
+	struct nvme_replay_op *op, *tmp;
+	unsigned int i, t, o;
+	int err = 0;
+
+	for (t = 0; t < 2; t++) {
+		for (o = 0; o < 256; o++) {
+			op = NULL;
+			for (i = 0; i < nr_workers; i++) {
+				tmp = workers[i].ops[t][o];
+				if (!tmp)
+					continue;
+				workers[i].ops[t][o] = NULL;
+				if (!op) {
+					op = tmp;
+					continue;
+				}
+				if (!op->errors && tmp->errors)
+					op->first_err = tmp->first_err;
+				op->cmds += tmp->cmds;
+				op->errors += tmp->errors;
+				op->bytes += tmp->bytes;
+				nvme_hist_merge(&op->lat, &tmp->lat);
+				free(tmp);
+			}
+			if (!op)
+				continue;
+
+			tmp = realloc(r->ops, (r->nr_ops + 1) * sizeof(*r->ops));
+			if (tmp) {
+				r->ops = tmp;
+				r->ops[r->nr_ops++] = *op;
+			} else {
+				err = -ENOMEM;
+			}
+			free(op);
+		}
+	}
+
+	return err;
+}
+
+static int passthru_replay(int argc, char **argv, struct command *command, struct plugin *plugin)
+{
+	const char *desc = "Replay a trace of admin and IO passthru commands, NDJSON or the binary\n"
+		"trace format, flat out or with the think times of the trace, and report\n"
+		"the latency per opcode.";
+	const char *trace = "trace file, - for stdin";
+	const char *queue_depth = "commands in flight";
+	const char *timing = "issue the commands with the think times of the trace";
+	const char *prefill = "byte the data sent to the controller is filled with, default 0";
+
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct replay_worker *workers = NULL;
+	_cleanup_free_ struct nvme_replay_cmd *cmds = NULL;
+	_cleanup_free_ __u64 *due_ns = NULL;
+	struct nvme_thread_pool *pool;
+	struct replay_job job = { 0 };
+	struct nvme_replay r = { 0 };
+	enum nvme_print_flags flags;
+	unsigned int line, i, qd;
+	__u64 think_ns = 0;
+	size_t nr, n;
+	FILE *f;
+	int err;
+
+	struct config {
+		char	*trace;
+		__u32	queue_depth;
+		bool	timing;
+		__u8	prefill;
+	};
+
+	struct config cfg = {
+		.trace		= "",
+		.queue_depth	= 1,
+		.timing		= false,
+		.prefill	= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FILE("trace",        'i', &cfg.trace,       trace),
+		  OPT_UINT("queue-depth",  'q', &cfg.queue_depth, queue_depth),
+		  OPT_FLAG("timing",       'T', &cfg.timing,      timing),
+		  OPT_BYTE("prefill",      'p', &cfg.prefill,     prefill));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		return err;
+	}
+
+	if (!strlen(cfg.trace) || !cfg.queue_depth) {
+		nvme_show_error("a trace and a non-zero queue-depth are required");
+		return -EINVAL;
+	}
+
+	if (dev->type != NVME_DEV_DIRECT) {
+		nvme_show_error("passthru-replay requires a direct NVMe device");
+		return -ENOTSUP;
+	}
+
+	f = strcmp(cfg.trace, "-") ? fopen(cfg.trace, "r") : stdin;
+	if (!f) {
+		nvme_show_perror(cfg.trace);
+		return -errno;
+	}
+	err = nvme_replay_load(f, &cmds, &nr, &line);
+	if (f != stdin)
+		fclose(f);
+	if (err == -EINVAL) {
+		nvme_show_error("%s:%u: malformed trace record", cfg.trace, line);
+		return err;
+	} else if (err) {
+		nvme_show_error("%s: %s", cfg.trace, nvme_strerror(-err));
+		return err;
+	}
+
+	if (cfg.timing) {
+		due_ns = malloc(max(nr, (size_t)1) * sizeof(*due_ns));
+		if (!due_ns)
+			return -ENOMEM;
+	}
+	for (n = 0; n < nr; n++) {
+		job.buf_len = max(job.buf_len, cmds[n].data_len);
+		think_ns += cmds[n].think_us * NSEC_PER_USEC;
+		if (due_ns)
+			due_ns[n] = think_ns;
+	}
 
-	gettimeofday(&start_time, NULL);
+	job.fd = dev_fd(dev);
+	job.cmds = cmds;
+	job.nr = nr;
+	job.due_ns = due_ns;
+	job.prefill = cfg.prefill;
 
-	if (admin)
-		err = nvme_cli_admin_passthru(dev, cfg.opcode, cfg.flags,
-					      cfg.rsvd,
-					      cfg.namespace_id, cfg.cdw2,
-					      cfg.cdw3, cfg.cdw10,
-					      cfg.cdw11, cfg.cdw12, cfg.cdw13,
-					      cfg.cdw14,
-					      cfg.cdw15, cfg.data_len, data,
-					      cfg.metadata_len,
-					      mdata, cfg.timeout, &result);
-	else
-		err = nvme_io_passthru(dev_fd(dev), cfg.opcode, cfg.flags,
-				       cfg.rsvd,
-				       cfg.namespace_id, cfg.cdw2, cfg.cdw3,
-				       cfg.cdw10,
-				       cfg.cdw11, cfg.cdw12, cfg.cdw13,
-				       cfg.cdw14,
-				       cfg.cdw15, cfg.data_len, data,
-				       cfg.metadata_len,
-				       mdata, cfg.timeout, &result);
+	qd = max(min(cfg.queue_depth, (__u32)nr), 1U);
+	workers = calloc(qd, sizeof(*workers));
+	if (!workers)
+		return -ENOMEM;
 
-	gettimeofday(&end_time, NULL);
-	cmd_name = nvme_cmd_to_string(admin, cfg.opcode);
-	if (cfg.latency)
-		printf("%s Command %s latency: %llu us\n", admin ? "Admin" : "IO",
-		       strcmp(cmd_name, "Unknown") ? cmd_name : "Vendor Specific",
-		       elapsed_utime(start_time, end_time));
+	pool = nvme_thread_pool_create(qd);
+	if (!pool) {
+		nvme_show_error("passthru-replay: %s", nvme_strerror(errno));
+		return -errno;
+	}
 
-	if (err < 0) {
-		nvme_show_error("%s: %s", __func__, nvme_strerror(errno));
-	} else if (err) {
-		nvme_show_status(err);
-	} else  {
-		fprintf(stderr, "%s Command %s is Success and result: 0x%08x\n", admin ? "Admin" : "IO",
-			strcmp(cmd_name, "Unknown") ? cmd_name : "Vendor Specific", result);
-		if (cfg.read)
-			passthru_print_read_output(cfg, data, dfd, mdata, mfd, err);
+	nvme_stop_catch(true, NULL);
+
+	job.start_ns = monotonic_ns();
+	for (i = 0; i < qd; i++) {
+		workers[i].job = &job;
+		if (nvme_thread_pool_queue(pool, replay_worker, &workers[i]))
+			replay_worker(&workers[i]);
 	}
+	nvme_thread_pool_destroy(pool);
+	r.elapsed_ns = monotonic_ns() - job.start_ns;
 
-	return err;
-}
+	nvme_stop_release();
 
-static int io_passthru(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc =
-	    "Send a user-defined IO command to the specified device via IOCTL passthrough, return results.";
+	err = replay_merge(workers, qd, &r);
+	for (i = 0; i < qd; i++)
+		if (workers[i].err)
+			err = workers[i].err;
 
-	return passthru(argc, argv, false, desc, cmd);
-}
+	r.trace = cfg.trace;
+	r.queue_depth = qd;
+	r.timed = cfg.timing;
+	r.cmds = job.done;
+	r.late = job.late;
+	nvme_show_replay(&r, flags);
 
-static int admin_passthru(int argc, char **argv, struct command *cmd, struct plugin *plugin)
-{
-	const char *desc =
-	    "Send a user-defined Admin command to the specified device via IOCTL passthrough, return results.";
+	if (err)
+		nvme_show_error("passthru-replay: %s", nvme_strerror(-err));
+	else
+		for (i = 0; i < (unsigned int)r.nr_ops; i++)
+			if (r.ops[i].errors)
+				err = -EIO;
+	free(r.ops);
 
-	return passthru(argc, argv, true, desc, cmd);
+	return err;
 }
 
 static int gen_hostnqn_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
@@ -8944,6 +23925,243 @@ static int show_hostnqn_cmd(int argc, char **argv, struct command *command, stru
 }
 
 
+/* Transform @secret for @nqn and encode it as a DHHC-1 key into @out */
+static int dhchap_key_encode(char *nqn, unsigned int hmac, unsigned int key_len,
+			     unsigned char *secret, char *out, size_t len)
+{
+	unsigned char key[68];
+	char encoded_key[128];
+	uint32_t crc;
+
+	if (nvme_gen_dhchap_key(nqn, hmac, key_len, secret, key) < 0)
+		return -errno;
+
+	crc = crc32(0, key, key_len);
+	key[key_len++] = crc & 0xff;
+	key[key_len++] = (crc >> 8) & 0xff;
+	key[key_len++] = (crc >> 16) & 0xff;
+	key[key_len++] = (crc >> 24) & 0xff;
+
+	memset(encoded_key, 0, sizeof(encoded_key));
+	base64_encode(key, key_len, encoded_key);
+	memset(key, 0, sizeof(key));
+
+	snprintf(out, len, "DHHC-1:%02x:%s:", hmac, encoded_key);
+	return 0;
+}
+
+#define KEYGEN_CHUNK	256	/* keys generated per work item */
+
+struct keygen_entry {
+	char *hostnqn;
+	char *subsysnqn;	/* TLS only */
+	unsigned char *secret;
+	char key[128];
+	long serial;		/* of the inserted TLS key */
+	int err;
+};
+
+/*
+ * Keys for a list of NQNs. The secrets of all keys are read with as few
+ * getrandom() calls as possible, then the keys are derived and encoded
+ * by a pool of threads in chunks, and printed in list order.
+ */
+struct keygen_batch {
+	bool tls;
+	unsigned int hmac;
+	unsigned int key_len;
+
+	bool insert;
+	char *keyring;
+	char *keytype;
+	unsigned int identity;
+
+	struct keygen_entry *e;
+	unsigned int nr;
+	unsigned char *secrets;
+};
+
+struct keygen_work {
+	struct keygen_batch *b;
+	unsigned int start, end;
+};
+
+static void keygen_entry_run(struct keygen_batch *b, struct keygen_entry *e)
+{
+	char *encoded;
+
+	if (!b->tls) {
+		e->err = dhchap_key_encode(e->hostnqn, b->hmac, b->key_len, e->secret,
+					   e->key, sizeof(e->key));
+		return;
+	}
+
+	encoded = nvme_export_tls_key(e->secret, b->key_len);
+	if (!encoded) {
+		e->err = -errno;
+		return;
+	}
+	snprintf(e->key, sizeof(e->key), "%s", encoded);
+	free(encoded);
+
+	if (b->insert) {
+		e->serial = nvme_insert_tls_key_versioned(b->keyring, b->keytype,
+							  e->hostnqn, e->subsysnqn,
+							  b->identity, b->hmac,
+							  e->secret, b->key_len);
+		if (e->serial < 0)
+			e->err = -errno;
+	}
+}
+
+static void keygen_work_fn(void *arg)
+{
+	struct keygen_work *w = arg;
+	unsigned int i;
+
+	for (i = w->start; i < w->end; i++)
+		keygen_entry_run(w->b, &w->b->e[i]);
+}
+
+/*
+ * Read "<hostnqn>" lines for DH-HMAC-CHAP, "<hostnqn> [<subsysnqn>]" lines
+ * for TLS. Blank lines and lines starting with '#' are skipped.
+ */
+static int keygen_read_list(struct keygen_batch *b, const char *file,
+			    const char *subsysnqn)
+{
+	_cleanup_free_ char *line = NULL;
+	struct keygen_entry *e;
+	char *host, *subsys, *save;
+	size_t size = 0;
+	FILE *f = stdin;
+	int err = 0;
+
+	if (strcmp(file, "-")) {
+		f = fopen(file, "r");
+		if (!f) {
+			nvme_show_perror(file);
+			return -errno;
+		}
+	}
+
+	while (getline(&line, &size, f) >= 0) {
+		host = strtok_r(line, " \t\r\n", &save);
+		if (!host || *host == '#')
+			continue;
+		subsys = strtok_r(NULL, " \t\r\n", &save);
+		if (!subsys)
+			subsys = (char *)subsysnqn;
+		if (b->tls && b->insert && !subsys) {
+			nvme_show_error("%s: no subsystem NQN", host);
+			err = -EINVAL;
+			break;
+		}
+
+		e = realloc(b->e, (b->nr + 1) * sizeof(*e));
+		if (!e) {
+			err = -ENOMEM;
+			break;
+		}
+		b->e = e;
+		e = &b->e[b->nr];
+		memset(e, 0, sizeof(*e));
+		b->nr++;
+
+		e->hostnqn = strdup(host);
+		e->subsysnqn = subsys ? strdup(subsys) : NULL;
+		if (!e->hostnqn || (subsys && !e->subsysnqn)) {
+			err = -ENOMEM;
+			break;
+		}
+	}
+
+	if (f != stdin)
+		fclose(f);
+
+	return err;
+}
+
+static void keygen_batch_free(struct keygen_batch *b)
+{
+	unsigned int i;
+
+	for (i = 0; i < b->nr; i++) {
+		free(b->e[i].hostnqn);
+		free(b->e[i].subsysnqn);
+	}
+	if (b->secrets)
+		memset(b->secrets, 0, (size_t)b->nr * b->key_len);
+	free(b->secrets);
+	free(b->e);
+}
+
+static int keygen_batch_run(struct keygen_batch *b, const char *file,
+			    const char *subsysnqn, unsigned int jobs)
+{
+	struct keygen_work *works = NULL;
+	struct nvme_thread_pool *pool;
+	size_t len, off;
+	unsigned int i, nr_works;
+	ssize_t n;
+	int err;
+
+	err = keygen_read_list(b, file, subsysnqn);
+	if (err)
+		return err;
+	if (!b->nr)
+		return 0;
+
+	len = (size_t)b->nr * b->key_len;
+	b->secrets = malloc(len);
+	if (!b->secrets)
+		return -ENOMEM;
+	for (off = 0; off < len; off += n) {
+		n = getrandom_bytes(b->secrets + off, len - off);
+		if (n <= 0)
+			return n < 0 ? -errno : -EIO;
+	}
+	for (i = 0; i < b->nr; i++)
+		b->e[i].secret = b->secrets + (size_t)i * b->key_len;
+
+	nr_works = (b->nr + KEYGEN_CHUNK - 1) / KEYGEN_CHUNK;
+	works = calloc(nr_works, sizeof(*works));
+	if (!works)
+		return -ENOMEM;
+
+	pool = nvme_thread_pool_create(nvme_thread_pool_jobs(jobs, nr_works));
+	for (i = 0; i < nr_works; i++) {
+		works[i].b = b;
+		works[i].start = i * KEYGEN_CHUNK;
+		works[i].end = min(works[i].start + KEYGEN_CHUNK, b->nr);
+		if (!pool || nvme_thread_pool_queue(pool, keygen_work_fn, &works[i]))
+			keygen_work_fn(&works[i]);
+	}
+	nvme_thread_pool_destroy(pool);
+	free(works);
+
+	for (i = 0; i < b->nr; i++) {
+		struct keygen_entry *e = &b->e[i];
+
+		if (e->err) {
+			nvme_show_error("%s: %s", e->hostnqn, nvme_strerror(-e->err));
+			if (!err)
+				err = e->err;
+			continue;
+		}
+		if (!b->tls)
+			printf("%s %s\n", e->hostnqn, e->key);
+		else if (b->insert)
+			printf("%s %s %s %08x\n", e->hostnqn, e->subsysnqn, e->key,
+			       (unsigned int)e->serial);
+		else
+			printf("%s %s %s\n", e->hostnqn, e->subsysnqn ? e->subsysnqn : "-",
+			       e->key);
+	}
+
+	return err;
+}
+
 static int gen_dhchap_key(int argc, char **argv, struct command *command, struct plugin *plugin)
 {
 	const char *desc =
@@ -8954,12 +24172,12 @@ static int gen_dhchap_key(int argc, char **argv, struct command *command, struct
 	const char *hmac =
 	    "HMAC function to use for key transformation (0 = none, 1 = SHA-256, 2 = SHA-384, 3 = SHA-512).";
 	const char *nqn = "Host NQN to use for key transformation.";
+	const char *nqn_file = "generate a key for each host NQN listed in this file ('-' for stdin)";
+	const char *jobs = "number of threads generating keys with --nqn-file (default: one per CPU)";
 
 	_cleanup_free_ unsigned char *raw_secret = NULL;
 	_cleanup_free_ char *hnqn = NULL;
-	unsigned char key[68];
-	char encoded_key[128];
-	unsigned long crc = crc32(0L, NULL, 0);
+	char encoded_key[160];
 	int err = 0;
 
 	struct config {
@@ -8967,6 +24185,8 @@ static int gen_dhchap_key(int argc, char **argv, struct command *command, struct
 		unsigned int	key_len;
 		char		*nqn;
 		unsigned int	hmac;
+		char		*nqn_file;
+		unsigned int	jobs;
 	};
 
 	struct config cfg = {
@@ -8974,13 +24194,17 @@ static int gen_dhchap_key(int argc, char **argv, struct command *command, struct
 		.key_len	= 0,
 		.nqn		= NULL,
 		.hmac		= 0,
+		.nqn_file	= NULL,
+		.jobs		= 0,
 	};
 
 	NVME_ARGS(opts,
 		  OPT_STR("secret",		's', &cfg.secret,	secret),
 		  OPT_UINT("key-length",	'l', &cfg.key_len,	key_len),
 		  OPT_STR("nqn",		'n', &cfg.nqn,		nqn),
-		  OPT_UINT("hmac",		'm', &cfg.hmac,		hmac));
+		  OPT_UINT("hmac",		'm', &cfg.hmac,		hmac),
+		  OPT_FILE("nqn-file",		'f', &cfg.nqn_file,	nqn_file),
+		  OPT_UINT("jobs",		'j', &cfg.jobs,		jobs));
 
 	err = parse_args(argc, argv, desc, opts);
 	if (err)
@@ -9027,6 +24251,22 @@ static int gen_dhchap_key(int argc, char **argv, struct command *command, struct
 		nvme_show_error("Invalid key length %u", cfg.key_len);
 		return -EINVAL;
 	}
+
+	if (cfg.nqn_file) {
+		struct keygen_batch b = {
+			.hmac		= cfg.hmac,
+			.key_len	= cfg.key_len,
+		};
+
+		if (cfg.secret || cfg.nqn) {
+			nvme_show_error("--nqn-file can't be combined with --secret or --nqn");
+			return -EINVAL;
+		}
+		err = keygen_batch_run(&b, cfg.nqn_file, NULL, cfg.jobs);
+		keygen_batch_free(&b);
+		return err;
+	}
+
 	raw_secret = malloc(cfg.key_len);
 	if (!raw_secret)
 		return -ENOMEM;
@@ -9058,19 +24298,12 @@ static int gen_dhchap_key(int argc, char **argv, struct command *command, struct
 		}
 	}
 
-	if (nvme_gen_dhchap_key(cfg.nqn, cfg.hmac, cfg.key_len, raw_secret, key) < 0)
-		return -errno;
-
-	crc = crc32(crc, key, cfg.key_len);
-	key[cfg.key_len++] = crc & 0xff;
-	key[cfg.key_len++] = (crc >> 8) & 0xff;
-	key[cfg.key_len++] = (crc >> 16) & 0xff;
-	key[cfg.key_len++] = (crc >> 24) & 0xff;
-
-	memset(encoded_key, 0, sizeof(encoded_key));
-	base64_encode(key, cfg.key_len, encoded_key);
+	err = dhchap_key_encode(cfg.nqn, cfg.hmac, cfg.key_len, raw_secret,
+				encoded_key, sizeof(encoded_key));
+	if (err)
+		return err;
 
-	printf("DHHC-1:%02x:%s:\n", cfg.hmac, encoded_key);
+	printf("%s\n", encoded_key);
 	return 0;
 }
 
@@ -9175,6 +24408,9 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 	const char *keyring = "Keyring for the retained key.";
 	const char *keytype = "Key type of the retained key.";
 	const char *insert = "Insert retained key into the keyring.";
+	const char *nqn_file = "generate a key for each '<hostnqn> [<subsysnqn>]' line of this file\n"
+		"('-' for stdin)";
+	const char *jobs = "number of threads generating keys with --nqn-file (default: one per CPU)";
 
 	_cleanup_free_ unsigned char *raw_secret = NULL;
 	_cleanup_free_ char *encoded_key = NULL;
@@ -9192,6 +24428,8 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 		unsigned int	hmac;
 		unsigned int	identity;
 		bool		insert;
+		char		*nqn_file;
+		unsigned int	jobs;
 	};
 
 	struct config cfg = {
@@ -9203,6 +24441,8 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 		.hmac		= 1,
 		.identity	= 0,
 		.insert		= false,
+		.nqn_file	= NULL,
+		.jobs		= 0,
 	};
 
 	NVME_ARGS(opts,
@@ -9213,7 +24453,9 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 		  OPT_STR("secret",	's', &cfg.secret,	secret),
 		  OPT_UINT("hmac",	'm', &cfg.hmac,		hmac),
 		  OPT_UINT("identity",	'I', &cfg.identity,	identity),
-		  OPT_FLAG("insert",	'i', &cfg.insert,	insert));
+		  OPT_FLAG("insert",	'i', &cfg.insert,	insert),
+		  OPT_FILE("nqn-file",	'f', &cfg.nqn_file,	nqn_file),
+		  OPT_UINT("jobs",	'j', &cfg.jobs,		jobs));
 
 	err = parse_args(argc, argv, desc, opts);
 	if (err)
@@ -9227,6 +24469,29 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 				cfg.identity);
 		return -EINVAL;
 	}
+	if (cfg.hmac == 2)
+		key_len = 48;
+
+	if (cfg.nqn_file) {
+		struct keygen_batch b = {
+			.tls		= true,
+			.hmac		= cfg.hmac,
+			.key_len	= key_len,
+			.insert		= cfg.insert,
+			.keyring	= cfg.keyring,
+			.keytype	= cfg.keytype,
+			.identity	= cfg.identity,
+		};
+
+		if (cfg.secret || cfg.hostnqn) {
+			nvme_show_error("--nqn-file can't be combined with --secret or --hostnqn");
+			return -EINVAL;
+		}
+		err = keygen_batch_run(&b, cfg.nqn_file, cfg.subsysnqn, cfg.jobs);
+		keygen_batch_free(&b);
+		return err;
+	}
+
 	if (cfg.insert) {
 		if (!cfg.subsysnqn) {
 			nvme_show_error("No subsystem NQN specified");
@@ -9240,9 +24505,6 @@ static int gen_tls_key(int argc, char **argv, struct command *command, struct pl
 			}
 		}
 	}
-	if (cfg.hmac == 2)
-		key_len = 48;
-
 	raw_secret = malloc(key_len + 4);
 	if (!raw_secret)
 		return -ENOMEM;
@@ -9514,21 +24776,28 @@ static int show_topology_cmd(int argc, char **argv, struct command *command, str
 {
 	const char *desc = "Show the topology\n";
 	const char *ranking = "Ranking order: namespace|ctrl";
+	const char *stats = "add the block layer I/O counters of every namespace and path";
 	enum nvme_print_flags flags;
-	_cleanup_nvme_root_ nvme_root_t r = NULL;
+	_cleanup_topology_ nvme_root_t r = NULL;
 	enum nvme_cli_topo_ranking rank;
 	int err;
 
 	struct config {
 		char	*ranking;
+		bool	watch;
+		bool	stats;
 	};
 
 	struct config cfg = {
 		.ranking	= "namespace",
+		.watch		= false,
+		.stats		= false,
 	};
 
 	NVME_ARGS(opts,
-		  OPT_FMT("ranking",       'r', &cfg.ranking,       ranking));
+		  OPT_FMT("ranking",       'r', &cfg.ranking,       ranking),
+		  OPT_FLAG("watch",        'w', &cfg.watch,         watch_desc),
+		  OPT_FLAG("stats",        's', &cfg.stats,         stats));
 
 	err = argconfig_parse(argc, argv, desc, opts);
 	if (err)
@@ -9539,9 +24808,13 @@ static int show_topology_cmd(int argc, char **argv, struct command *command, str
 		nvme_show_error("Invalid output format");
 		return err;
 	}
+	nvme_set_json_output_mode(output_format_val);
+	output_format_resolve();
 
 	if (argconfig_parse_seen(opts, "verbose"))
 		flags |= VERBOSE;
+	if (cfg.stats)
+		flags |= STATS;
 
 	if (!strcmp(cfg.ranking, "namespace")) {
 		rank = NVME_CLI_TOPO_NAMESPACE;
@@ -9552,23 +24825,236 @@ static int show_topology_cmd(int argc, char **argv, struct command *command, str
 		return -EINVAL;
 	}
 
-	r = nvme_create_root(stderr, log_level);
-	if (!r) {
-		nvme_show_error("Failed to create topology root: %s", nvme_strerror(errno));
-		return -errno;
+	err = scan_topology(&r);
+	if (err < 0) {
+		if (errno != ENOENT)
+			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
+		return err;
+	}
+
+	nvme_show_topology(r, rank, flags);
+
+	if (cfg.watch)
+		return watch_topology(flags);
+
+	return err;
+}
+
+/* Verify is probed without a data transfer */
+static int path_probe_prep(struct nvme_io_job *job, unsigned int thread,
+			   __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	cmd->addr = 0;
+	cmd->data_len = 0;
+	cmd->metadata = 0;
+	cmd->metadata_len = 0;
+
+	return 0;
+}
+
+static const struct nvme_io_job_ops path_probe_verify_ops = {
+	.prep		= path_probe_prep,
+};
+
+/*
+ * Probe one path through the generic char device of its controller,
+ * /dev/ngYnZ for the path nvmeXcYnZ, which the multipath head doesn't
+ * redirect to another path.
+ */
+static int path_probe_one(struct nvme_io_job *job, struct nvme_path_probe_path *pp)
+{
+	_cleanup_free_ struct nvme_id_ns *ns = NULL;
+	_cleanup_file_ int fd = -1;
+	unsigned int subsys, ctrl, head;
+	struct nvme_io_stats stats;
+	char path[32];
+	__u8 lba_index;
+	__u32 lba_size;
+	int err;
+
+	if (sscanf(pp->name, "nvme%uc%un%u", &subsys, &ctrl, &head) != 3)
+		return -ENODEV;
+	snprintf(path, sizeof(path), "/dev/ng%un%u", ctrl, head);
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	ns = nvme_alloc(sizeof(*ns));
+	if (!ns)
+		return -ENOMEM;
+
+	err = nvme_identify_ns(fd, pp->nsid, ns);
+	if (err)
+		return err < 0 ? -errno : -EIO;
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns->flbas, &lba_index);
+	lba_size = 1 << ns->lbaf[lba_index].ds;
+
+	job->fd = fd;
+	job->nsid = pp->nsid;
+	job->slba = 0;
+	job->nr_lbas = le64_to_cpu(ns->nsze);
+	/* 4 KiB, or a block of a larger format, per command */
+	job->nlb = lba_size < 4096 ? 4096 / lba_size - 1 : 0;
+	job->lba_size = lba_size;
+	job->ms = 0;
+	if (ns->lbaf[lba_index].ms) {
+		if (NVME_FLBAS_META_EXT(ns->flbas))
+			job->lba_size += ns->lbaf[lba_index].ms;
+		else
+			job->ms = ns->lbaf[lba_index].ms;
+	}
+
+	err = nvme_io_engine_run(job, &stats);
+	if (err < 0)
+		return err;
+
+	pp->ios = stats.ios;
+	pp->errors = stats.errors;
+	pp->first_err = stats.first_err;
+	pp->elapsed_ns = stats.elapsed_ns;
+	pp->lat = stats.lat;
+
+	return 0;
+}
+
+static int path_probe(int argc, char **argv, struct command *command, struct plugin *plugin)
+{
+	const char *desc = "Send small reads or verifies down every controller path of\n"
+		"the multipath namespaces, one path at a time, and report the\n"
+		"latency of each path alongside its ANA state.";
+	const char *mode = "read or verify";
+	const char *io_count = "commands per path";
+	const char *runtime = "seconds per path, instead of --io-count";
+	const char *queue_depth = "commands in flight per path";
+
+	_cleanup_free_ struct nvme_path_probe_path *paths = NULL;
+	_cleanup_topology_ nvme_root_t r = NULL;
+	struct nvme_path_probe_path *pp;
+	struct nvme_path_probe probe;
+	enum nvme_print_flags flags;
+	const char *name = NULL;
+	int i, nr = 0, err;
+	nvme_subsystem_t s;
+	nvme_host_t h;
+	nvme_path_t p;
+	nvme_ctrl_t c;
+	nvme_ns_t n;
+
+	struct config {
+		char		*mode;
+		__u64		io_count;
+		__u32		runtime;
+		__u32		queue_depth;
+	};
+
+	struct config cfg = {
+		.mode		= "read",
+		.io_count	= 1000,
+		.runtime	= 0,
+		.queue_depth	= 1,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_STRING("mode",      'm', "MODE", &cfg.mode,        mode),
+		  OPT_SUFFIX("io-count",  'N', &cfg.io_count,    io_count),
+		  OPT_UINT("runtime",     'R', &cfg.runtime,     runtime),
+		  OPT_UINT("queue-depth", 'q', &cfg.queue_depth, queue_depth));
+
+	err = argconfig_parse(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+	nvme_set_json_output_mode(output_format_val);
+	output_format_resolve();
+
+	struct nvme_io_job job = {
+		.queue_depth	= cfg.queue_depth,
+		.threads	= 1,
+		.nr_ios		= cfg.runtime ? 0 : cfg.io_count,
+		.runtime	= cfg.runtime,
+		.random		= true,
+	};
+
+	if (!strcmp(cfg.mode, "read")) {
+		job.opcode = nvme_cmd_read;
+	} else if (!strcmp(cfg.mode, "verify")) {
+		job.opcode = nvme_cmd_verify;
+		job.ops = &path_probe_verify_ops;
+	} else {
+		nvme_show_error("Invalid mode: %s", cfg.mode);
+		return -EINVAL;
+	}
+
+	if (!cfg.queue_depth || (!cfg.io_count && !cfg.runtime)) {
+		nvme_show_error("queue-depth and io-count must be non-zero");
+		return -EINVAL;
 	}
 
-	err = nvme_scan_topology(r, NULL, NULL);
+	/* the namespace head, /dev/nvmeXnY, to probe only its paths */
+	if (optind < argc)
+		name = basename(argv[optind]);
+
+	err = scan_topology(&r);
 	if (err < 0) {
-		if (errno != ENOENT)
-			nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
-		nvme_free_tree(r);
+		nvme_show_error("Failed to scan topology: %s", nvme_strerror(errno));
 		return err;
 	}
 
-	nvme_show_topology(r, rank, flags);
+	nvme_for_each_host(r, h)
+		nvme_for_each_subsystem(h, s)
+			nvme_subsystem_for_each_ns(s, n) {
+				if (name && strcmp(nvme_ns_get_name(n), name))
+					continue;
+				nvme_namespace_for_each_path(n, p) {
+					pp = realloc(paths, (nr + 1) * sizeof(*pp));
+					if (!pp)
+						return -ENOMEM;
+					paths = pp;
+					pp = &paths[nr++];
+					memset(pp, 0, sizeof(*pp));
+					c = nvme_path_get_ctrl(p);
+					pp->name = nvme_path_get_name(p);
+					pp->ctrl = nvme_ctrl_get_name(c);
+					pp->transport = nvme_ctrl_get_transport(c);
+					pp->address = nvme_ctrl_get_address(c);
+					pp->state = nvme_ctrl_get_state(c);
+					pp->ana_state = nvme_path_get_ana_state(p);
+					pp->nsid = nvme_ns_get_nsid(n);
+				}
+			}
 
-	return err;
+	if (!nr) {
+		if (name)
+			nvme_show_error("%s: no multipath paths", name);
+		else
+			nvme_show_error("no multipath namespaces");
+		return -ENODEV;
+	}
+
+	/* one path at a time, so the paths don't compete for the namespace */
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	for (i = 0; i < nr; i++)
+		paths[i].err = nvme_stopped() ? -EINTR : path_probe_one(&job, &paths[i]);
+	nvme_stop_release();
+
+	probe.mode = cfg.mode;
+	probe.queue_depth = cfg.queue_depth;
+	probe.paths = paths;
+	probe.nr_paths = nr;
+	nvme_show_path_probe(&probe, flags);
+
+	for (i = 0; i < nr; i++)
+		if (paths[i].err || paths[i].errors)
+			return -EIO;
+
+	return 0;
 }
 
 static int discover_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
@@ -9592,6 +25078,15 @@ static int connect_cmd(int argc, char **argv, struct command *command, struct pl
 	return nvmf_connect(desc, argc, argv);
 }
 
+static int connect_advise_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
+{
+	const char *desc = "Connect to an NVMeoF subsystem with several I/O queue\n"
+		"layouts in turn, probe each with random reads and recommend\n"
+		"the one reaching the most IOPS";
+
+	return nvmf_advise(desc, argc, argv);
+}
+
 static int disconnect_cmd(int argc, char **argv, struct command *command, struct plugin *plugin)
 {
 	const char *desc = "Disconnect from NVMeoF subsystem";
@@ -9745,6 +25240,401 @@ static int nmi_send(int argc, char **argv, struct command *cmd, struct plugin *p
 	return nvme_mi(argc, argv, nvme_admin_nvme_mi_send, desc);
 }
 
+/*
+ * nvme-mi-poll: one endpoint kept open for all the rounds, each one a
+ * Subsystem Health Status Poll and optionally a SMART log read tunneled
+ * to the controller, with the latency of every command. With --changes
+ * the poll clears the changed flags and a round is only reported, and the
+ * SMART log only read, when one of them was set.
+ */
+static int nmi_poll(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Poll the health of an NVMe-MI endpoint over a single MCTP session, "
+		"reporting the latency of every command.";
+	const char *interval = "milliseconds between the rounds";
+	const char *count = "number of rounds (default: until interrupted)";
+	const char *smart = "also read the SMART log of the controller in every round";
+	const char *clear = "clear the Composite Controller Status bits after reading them";
+	const char *changes = "only report the rounds in which a composite status bit changed";
+
+	_cleanup_free_ struct nvme_smart_log *smart_log = NULL;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	_cleanup_free_ struct nvme_hist *lat = NULL;
+	struct nvme_mi_nvm_ss_health_status hs;
+	struct nvme_mi_poll_sample s;
+	enum nvme_print_flags flags;
+	__u64 next, start_ns;
+	struct timespec ts;
+	__u32 n;
+	int err;
+
+	struct config {
+		__u32	interval;
+		__u32	count;
+		bool	smart;
+		bool	clear;
+		bool	changes;
+	};
+
+	struct config cfg = {
+		.interval	= 1000,
+		.count		= 0,
+		.smart		= false,
+		.clear		= false,
+		.changes	= false,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_UINT("interval",  'i', &cfg.interval, interval),
+		  OPT_UINT("count",     'c', &cfg.count,    count),
+		  OPT_FLAG("smart-log", 's', &cfg.smart,    smart),
+		  OPT_FLAG("clear",     'C', &cfg.clear,    clear),
+		  OPT_FLAG("changes",   'x', &cfg.changes,  changes));
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (dev->type != NVME_DEV_MI) {
+		nvme_show_error("%s is not an MI endpoint, use mctp:<net>,<eid>[:<ctrl-id>]",
+				dev->name);
+		return -EINVAL;
+	}
+
+	/* the changed flags are only meaningful when every poll clears them */
+	if (cfg.changes)
+		cfg.clear = true;
+
+	/* one histogram per command: health status poll, smart log */
+	lat = malloc(2 * sizeof(*lat));
+	if (!lat)
+		return -ENOMEM;
+	nvme_hist_init(&lat[0]);
+	nvme_hist_init(&lat[1]);
+
+	if (cfg.smart) {
+		smart_log = nvme_alloc(sizeof(*smart_log));
+		if (!smart_log)
+			return -ENOMEM;
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	for (n = 0; !cfg.count || n < cfg.count; n++) {
+		/* the first round runs right away */
+		if (n && !nvme_interval_wait(next))
+			break;
+		next += cfg.interval * 1000000ULL;
+
+		memset(&s, 0, sizeof(s));
+		s.name = dev->name;
+
+		start_ns = monotonic_ns();
+		err = nvme_mi_mi_subsystem_health_status_poll(dev->mi.ep, cfg.clear, &hs);
+		s.hsp_ns = monotonic_ns() - start_ns;
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				nvme_show_error("health status poll: %s", nvme_strerror(errno));
+			break;
+		}
+		nvme_hist_add(&lat[0], s.hsp_ns);
+		s.ccs = le16_to_cpu(hs.ccs);
+
+		/* the first round reports the state the changes apply to */
+		if (cfg.changes && n && !s.ccs)
+			continue;
+
+		if (cfg.smart) {
+			start_ns = monotonic_ns();
+			err = nvme_cli_get_log_smart(dev, NVME_NSID_ALL, false, smart_log);
+			s.smart_ns = monotonic_ns() - start_ns;
+			if (err) {
+				if (err > 0)
+					nvme_show_status(err);
+				else
+					nvme_show_error("smart log: %s", nvme_strerror(errno));
+				break;
+			}
+			nvme_hist_add(&lat[1], s.smart_ns);
+
+			s.smart = true;
+			s.critical_warning = smart_log->critical_warning;
+			s.temperature = smart_log->temperature[1] << 8 |
+				smart_log->temperature[0];
+			s.avail_spare = smart_log->avail_spare;
+			s.percent_used = smart_log->percent_used;
+		}
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		s.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+		s.nss = hs.nss;
+		s.sw = hs.sw;
+		s.ctemp = (__s8)hs.ctemp;
+		s.pdlu = hs.pdlu;
+		nvme_show_mi_poll_sample(&s, flags);
+	}
+
+	nvme_stop_release();
+
+	if (lat[0].count)
+		nvme_show_latency_hist("health-status-poll", &lat[0], flags);
+	if (lat[1].count)
+		nvme_show_latency_hist("smart-log", &lat[1], flags);
+
+	return err;
+}
+
+/* One endpoint of nvme-mi-sweep, with its own MCTP socket */
+struct mi_sweep_ep {
+	struct nvme_dev dev;
+	char *name;
+	unsigned int timeout;
+	bool smart;
+	struct nvme_mi_poll_sample s;
+	int err;		/* NVMe status or negative errno */
+};
+
+static void mi_sweep_ep(void *arg)
+{
+	struct mi_sweep_ep *e = arg;
+	struct nvme_mi_nvm_ss_health_status hs;
+	struct nvme_smart_log *smart_log;
+	nvme_mi_ep_t ep = e->dev.mi.ep;
+	struct timespec ts;
+	__u64 start_ns;
+	int err;
+
+	e->s.name = e->name;
+
+	/* every link is a request and response at a time, bound the slow ones */
+	if (e->timeout && nvme_mi_ep_set_timeout(ep, e->timeout)) {
+		e->err = -errno;
+		return;
+	}
+
+	start_ns = monotonic_ns();
+	err = nvme_mi_mi_subsystem_health_status_poll(ep, false, &hs);
+	e->s.hsp_ns = monotonic_ns() - start_ns;
+	if (err) {
+		e->err = err > 0 ? err : -errno;
+		return;
+	}
+
+	if (e->smart) {
+		/* a scanned endpoint reads the SMART log of its first controller */
+		if (!e->dev.mi.ctrl) {
+			if (nvme_mi_scan_ep(ep, false)) {
+				e->err = -errno;
+				return;
+			}
+			e->dev.mi.ctrl = nvme_mi_first_ctrl(ep);
+			if (!e->dev.mi.ctrl) {
+				e->err = -ENODEV;
+				return;
+			}
+		}
+
+		smart_log = nvme_alloc(sizeof(*smart_log));
+		if (!smart_log) {
+			e->err = -ENOMEM;
+			return;
+		}
+		start_ns = monotonic_ns();
+		err = nvme_cli_get_log_smart(&e->dev, NVME_NSID_ALL, false, smart_log);
+		e->s.smart_ns = monotonic_ns() - start_ns;
+		if (!err) {
+			e->s.smart = true;
+			e->s.critical_warning = smart_log->critical_warning;
+			e->s.temperature = smart_log->temperature[1] << 8 |
+				smart_log->temperature[0];
+			e->s.avail_spare = smart_log->avail_spare;
+			e->s.percent_used = smart_log->percent_used;
+		}
+		free(smart_log);
+		if (err) {
+			e->err = err > 0 ? err : -errno;
+			return;
+		}
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	e->s.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+	e->s.nss = hs.nss;
+	e->s.sw = hs.sw;
+	e->s.ctemp = (__s8)hs.ctemp;
+	e->s.pdlu = hs.pdlu;
+	e->s.ccs = le16_to_cpu(hs.ccs);
+}
+
+/*
+ * nvme-mi-sweep: the endpoints are independent MCTP links, opened up
+ * front from the thread of the command, which owns the root, and then
+ * polled concurrently, one endpoint per worker.
+ */
+static int nmi_sweep(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Poll the health of several NVMe-MI endpoints concurrently.\n"
+		"Endpoints are given as arguments, mctp:<net>,<eid>[:<ctrl-id>], by\n"
+		"default every endpoint found on the MCTP D-Bus service is used.";
+	const char *smart = "also read the SMART log of the controller of every endpoint";
+	const char *timeout = "timeout in milliseconds of every MI command, per endpoint";
+	const char *jobs = "number of endpoints polled in parallel, 0 for all at once";
+
+	_cleanup_free_ struct mi_sweep_ep *eps = NULL;
+	_cleanup_free_ struct nvme_hist *lat = NULL;
+	struct nvme_thread_pool *pool;
+	enum nvme_print_flags flags;
+	unsigned int net, ctrl_id;
+	nvme_root_t root;
+	nvme_mi_ep_t ep;
+	int nr = 0, i, err;
+	uint8_t eid;
+
+	struct config {
+		bool	smart;
+		__u32	timeout;
+		__u32	jobs;
+	};
+
+	struct config cfg = {
+		.smart		= false,
+		.timeout	= 0,
+		.jobs		= 0,
+	};
+
+	NVME_ARGS(opts,
+		  OPT_FLAG("smart-log", 's', &cfg.smart,   smart),
+		  OPT_UINT("timeout",   't', &cfg.timeout, timeout),
+		  OPT_UINT("jobs",      'j', &cfg.jobs,    jobs));
+
+	err = parse_args(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(output_format_val, &flags);
+	if (err < 0 || flags == BINARY) {
+		nvme_show_error("Invalid output format");
+		return -EINVAL;
+	}
+
+	if (optind < argc) {
+		root = nvme_mi_create_root(stderr, LOG_WARNING);
+		if (!root)
+			return -errno;
+		for (i = optind; i < argc; i++) {
+			if (parse_mi_dev(argv[i], &net, &eid, &ctrl_id)) {
+				nvme_show_error("invalid MI endpoint %s", argv[i]);
+				err = -EINVAL;
+				goto free_root;
+			}
+			if (!nvme_mi_open_mctp(root, net, eid)) {
+				err = -errno;
+				nvme_show_perror(argv[i]);
+				goto free_root;
+			}
+		}
+	} else {
+		root = nvme_mi_scan_mctp();
+		if (!root) {
+			nvme_show_error("MCTP endpoint scan: %s", nvme_strerror(errno));
+			return -errno;
+		}
+	}
+
+	nvme_mi_for_each_endpoint(root, ep)
+		nr++;
+	if (!nr) {
+		nvme_show_error("no MI endpoints found");
+		err = -ENODEV;
+		goto free_root;
+	}
+
+	eps = calloc(nr, sizeof(*eps));
+	lat = malloc(2 * sizeof(*lat));
+	if (!eps || !lat) {
+		err = -ENOMEM;
+		goto free_root;
+	}
+	nvme_hist_init(&lat[0]);
+	nvme_hist_init(&lat[1]);
+
+	i = 0;
+	nvme_mi_for_each_endpoint(root, ep) {
+		eps[i].dev.type = NVME_DEV_MI;
+		eps[i].dev.mi.root = root;
+		eps[i].dev.mi.ep = ep;
+		eps[i].timeout = cfg.timeout;
+		eps[i].smart = cfg.smart;
+		/* the endpoints were opened in the order of the arguments */
+		if (optind < argc) {
+			parse_mi_dev(argv[optind + i], &net, &eid, &ctrl_id);
+			eps[i].name = strdup(argv[optind + i]);
+			if (cfg.smart)
+				eps[i].dev.mi.ctrl = nvme_mi_init_ctrl(ep, ctrl_id);
+		} else {
+			eps[i].name = nvme_mi_endpoint_desc(ep);
+		}
+		if (!eps[i].name ||
+		    (optind < argc && cfg.smart && !eps[i].dev.mi.ctrl)) {
+			err = -ENOMEM;
+			goto free_names;
+		}
+		eps[i].dev.name = eps[i].name;
+		i++;
+	}
+
+	pool = nvme_thread_pool_create(cfg.jobs ? min(cfg.jobs, (__u32)nr) : nr);
+	if (!pool) {
+		err = -errno;
+		nvme_show_error("thread pool: %s", nvme_strerror(errno));
+		goto free_names;
+	}
+	for (i = 0; i < nr; i++) {
+		err = nvme_thread_pool_queue(pool, mi_sweep_ep, &eps[i]);
+		if (err)
+			eps[i].err = err;
+	}
+	nvme_thread_pool_destroy(pool);
+
+	err = 0;
+	for (i = 0; i < nr; i++) {
+		if (eps[i].err) {
+			err = eps[i].err;
+			if (err > 0)
+				nvme_show_error("%s: %s", eps[i].name,
+						nvme_status_to_string(err, false));
+			else
+				nvme_show_error("%s: %s", eps[i].name, nvme_strerror(-err));
+			continue;
+		}
+		nvme_hist_add(&lat[0], eps[i].s.hsp_ns);
+		if (eps[i].s.smart)
+			nvme_hist_add(&lat[1], eps[i].s.smart_ns);
+		nvme_show_mi_poll_sample(&eps[i].s, flags);
+	}
+
+	if (lat[0].count)
+		nvme_show_latency_hist("health-status-poll", &lat[0], flags);
+	if (lat[1].count)
+		nvme_show_latency_hist("smart-log", &lat[1], flags);
+
+free_names:
+	for (i = 0; i < nr; i++)
+		free(eps[i].name);
+free_root:
+	nvme_mi_free_root(root);
+	return err;
+}
+
 void register_extension(struct plugin *plugin)
 {
 	plugin->parent = &nvme;
@@ -9752,20 +25642,300 @@ void register_extension(struct plugin *plugin)
 	nvme.extensions->tail = plugin;
 }
 
-int main(int argc, char **argv)
+#if CONFIG_LAZY_PLUGINS
+/* bounds of the table of plugins, see PLUGIN() in cmd_handler.h */
+extern struct plugin *const __start_nvme_plugins[] __attribute__((weak));
+extern struct plugin *const __stop_nvme_plugins[] __attribute__((weak));
+
+static void register_extensions(struct program *prog)
+{
+	struct plugin *const *p;
+
+	prog->load_extensions = NULL;
+	for (p = __start_nvme_plugins; p < __stop_nvme_plugins; p++)
+		register_extension(*p);
+}
+#endif
+
+/*
+ * Commands after which the kept topology and namespaces may be stale, with
+ * the admin opcode they send when its effects can tell otherwise.
+ */
+static const struct {
+	const char *cmd;
+	int opcode;
+} batch_invalidating_cmds[] = {
+	{ "create-ns",		nvme_admin_ns_mgmt },
+	{ "delete-ns",		nvme_admin_ns_mgmt },
+	{ "attach-ns",		nvme_admin_ns_attach },
+	{ "detach-ns",		nvme_admin_ns_attach },
+	{ "provision-ns",	-1 },
+	{ "format",		nvme_admin_format_nvm },
+	{ "sanitize",		nvme_admin_sanitize_nvm },
+	{ "reset",		-1 },
+	{ "subsystem-reset",	-1 },
+	{ "ns-rescan",		-1 },
+	{ "connect",		-1 },
+	{ "connect-all",	-1 },
+	{ "disconnect",		-1 },
+	{ "disconnect-all",	-1 },
+};
+
+/*
+ * Whether the command @cmd just ran may have changed the namespaces or the
+ * controllers. A raw command is taken for one unless its Commands Supported
+ * and Effects entry says it changes neither the capacity (NCC), the
+ * namespace inventory (NIC) nor the controller capabilities (CCC).
+ */
+static bool batch_invalidates(const char *cmd)
+{
+	bool admin = batch_cmd_admin;
+	int opcode = batch_cmd_opcode;
+	__u32 effects;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(batch_invalidating_cmds); i++) {
+		if (!strcmp(cmd, batch_invalidating_cmds[i].cmd)) {
+			opcode = batch_invalidating_cmds[i].opcode;
+			admin = true;
+			if (opcode < 0)
+				return true;
+			break;
+		}
+	}
+	if (i == ARRAY_SIZE(batch_invalidating_cmds) && opcode < 0)
+		return false;
+
+	if (!batch_effects(batch_cmd_dev, admin, opcode, &effects))
+		return true;
+
+	return effects & (NVME_CMD_EFFECTS_NCC | NVME_CMD_EFFECTS_NIC |
+			  NVME_CMD_EFFECTS_CCC);
+}
+
+#ifdef CONFIG_JSONC
+#define BATCH_OUTPUT_FORMAT	"json"
+
+/*
+ * The record of one command: where it came from, its words, the status and
+ * the object its print op produced, as a single line.
+ */
+static struct json_object *batch_record(unsigned int line, int argc, char **argv)
+{
+	struct json_object *r = json_create_object();
+	struct json_object *cmd = json_create_array();
+	int i;
+
+	json_object_add_value_uint(r, "line", line);
+	for (i = 0; i < argc; i++)
+		json_array_add_value_string(cmd, argv[i]);
+	json_object_add_value_array(r, "command", cmd);
+
+	return r;
+}
+
+static void batch_print(struct json_object *r, int err, __u64 time_ns,
+			struct json_object *out)
+{
+	json_object_add_value_int(r, "status", err);
+	json_object_add_value_uint64(r, "time_us", time_ns / NSEC_PER_USEC);
+	if (err == -ENOTTY)
+		json_object_add_value_string(r, "error", "unknown command");
+	else if (err < 0)
+		json_object_add_value_string(r, "error", nvme_strerror(-err));
+	else if (err > 0)
+		json_object_add_value_string(r, "error",
+					     nvme_status_to_string(err, false));
+	if (out)
+		json_object_add_value_object(r, "output", out);
+
+	printf("%s\n", json_object_to_json_string_ext(r,
+		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+	fflush(stdout);
+	json_free_object(r);
+}
+#else
+#define BATCH_OUTPUT_FORMAT	"normal"
+#endif
+
+static int batch_cmd(unsigned int line, int argc, char **argv)
 {
+#ifdef CONFIG_JSONC
+	struct json_object *r, *out = NULL;
+	__u64 start_ns;
+#endif
+	const char *name = argv[0];
 	int err;
 
+	/* the global options of the previous command don't carry over */
+	verbose_level = 0;
+	output_format_val = BATCH_OUTPUT_FORMAT;
+	output_format_resolve();
+	batch_cmd_dev = NULL;
+	batch_cmd_opcode = -1;
+
+#ifdef CONFIG_JSONC
+	/* getopt permutes argv, record the command as it was written */
+	r = batch_record(line, argc, argv);
+	json_show_capture(&out);
+	start_ns = monotonic_ns();
+#endif
+	err = handle_plugin(argc, argv, nvme.extensions);
+#ifdef CONFIG_JSONC
+	json_show_capture(NULL);
+	batch_print(r, err, monotonic_ns() - start_ns, out);
+#else
+	if (err)
+		fprintf(stderr, "line %u: %s failed: %d\n", line, name, err);
+#endif
+
+	if (batch_invalidates(name))
+		batch_invalidate();
+
+	return err;
+}
+
+/*
+ * nvme -b: run the commands of @path, or of stdin for "-", one per line in
+ * this process, stopping at the first one that fails.
+ */
+static int batch_run(const char *path)
+{
+	struct nvme_batch b;
+	FILE *f = stdin;
+	char **argv;
+	int argc, err = 0;
+
+	if (strcmp(path, "-")) {
+		f = fopen(path, "r");
+		if (!f) {
+			nvme_show_perror(path);
+			return -errno;
+		}
+	}
+
+	nvme_batch_init(&b, f);
+	batch_mode = true;
+	while ((argc = nvme_batch_next(&b, &argv)) > 0) {
+		/* lines copied from a shell script may keep the program name */
+		if (!strcmp(argv[0], "nvme")) {
+			argv++;
+			if (!--argc)
+				continue;
+		}
+		err = batch_cmd(b.lineno, argc, argv);
+		if (err)
+			break;
+	}
+	if (argc < 0) {
+		nvme_show_error("%s:%u: %s", path, b.lineno,
+				argc == -EINVAL ? "unterminated quote" :
+				nvme_strerror(-argc));
+		err = argc;
+	}
+
+	batch_mode = false;
+	batch_invalidate();
+	batch_devs_close();
+	batch_parsers_free();
+	nvme_batch_free(&b);
+	if (f != stdin)
+		fclose(f);
+
+	return err;
+}
+
+static void huge_cache_report(void)
+{
+	struct nvme_mem_huge_stats s;
+
+	nvme_huge_cache_stats(&s);
+	if (log_level >= LOG_DEBUG && (s.hits || s.misses))
+		fprintf(stderr, "huge buffers: %lu hits, %lu misses (%lu hugetlb, %lu thp)\n",
+			s.hits, s.misses, s.hugetlb, s.thp);
+	nvme_huge_cache_drain();
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace_file = NULL;
+	int err, n;
+
+	/* global options, ahead of the command */
+	while (argc > 1) {
+		if (!strcmp(argv[1], "--timing")) {
+			nvme_timing_start();
+			n = 1;
+		} else if (!strcmp(argv[1], "--stats")) {
+			nvme_cmd_stats_enabled = true;
+			n = 1;
+		} else if (!strcmp(argv[1], "--numa-pin")) {
+			numa_pin = true;
+			n = 1;
+		} else if (!strcmp(argv[1], "--alloc-stats")) {
+			if (nvme_alloc_stats_start()) {
+				nvme_show_error("--alloc-stats: not supported by this build, see -Dalloc-stats");
+				return 1;
+			}
+			n = 1;
+		} else if (!strncmp(argv[1], "--trace-file=", strlen("--trace-file="))) {
+			trace_file = argv[1] + strlen("--trace-file=");
+			n = 1;
+		} else if (!strcmp(argv[1], "--trace-file") && argc > 2) {
+			trace_file = argv[2];
+			n = 2;
+		} else {
+			break;
+		}
+		argv[n] = argv[0];
+		argv += n;
+		argc -= n;
+	}
+
+	if (trace_file) {
+		err = nvme_trace_open(trace_file);
+		if (err) {
+			nvme_show_error("%s: %s", trace_file, nvme_strerror(-err));
+			return 1;
+		}
+	}
+
 	nvme.extensions->parent = &nvme;
+#if CONFIG_LAZY_PLUGINS
+	nvme.load_extensions = register_extensions;
+#endif
 	if (argc < 2) {
 		general_help(&builtin);
 		return 0;
 	}
 	setlocale(LC_ALL, "");
 
-	err = handle_plugin(argc - 1, &argv[1], nvme.extensions);
-	if (err == -ENOTTY)
-		general_help(&builtin);
+	if (!strcmp(argv[1], "-b") || !strcmp(argv[1], "--batch")) {
+		if (argc != 3) {
+			nvme_show_error("%s needs a script, '-' for stdin", argv[1]);
+			return 1;
+		}
+		err = batch_run(argv[2]);
+	} else if (!strncmp(argv[1], "--batch=", strlen("--batch="))) {
+		err = batch_run(argv[1] + strlen("--batch="));
+	} else {
+		err = handle_plugin(argc - 1, &argv[1], nvme.extensions);
+		if (err == -ENOTTY)
+			general_help(&builtin);
+	}
+
+	nvme_alloc_stats_report(stderr);
+	huge_cache_report();
+	nvme_timing_report(stderr);
+	nvme_cmd_stats_report(stderr, nvme_cmd_to_string);
+
+	if (trace_file) {
+		n = nvme_trace_close();
+		if (n) {
+			nvme_show_error("%s: %s", trace_file, nvme_strerror(-n));
+			err = n;
+		}
+	}
 
 	return err ? 1 : 0;
 }
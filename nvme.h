@@ -31,6 +31,8 @@
 #include "util/mem.h"
 #include "util/argconfig.h"
 #include "util/cleanup.h"
+#include "util/histogram.h"
+#include "util/lat-hist.h"
 
 enum nvme_print_flags {
 	NORMAL	= 0,
@@ -38,6 +40,7 @@ enum nvme_print_flags {
 	JSON	= 1 << 1,	/* display in json format */
 	VS	= 1 << 2,	/* hex dump vendor specific data areas */
 	BINARY	= 1 << 3,	/* binary dump raw bytes */
+	STATS	= 1 << 4,	/* I/O counters of the block devices in the topology */
 };
 
 enum nvme_cli_topo_ranking {
@@ -52,6 +55,8 @@ enum nvme_dev_type {
 	NVME_DEV_MI,
 };
 
+struct nvme_mock;
+
 struct nvme_dev {
 	enum nvme_dev_type type;
 	union {
@@ -67,6 +72,795 @@ struct nvme_dev {
 	};
 
 	const char *name;
+	struct nvme_mock *mock;		/* a direct device replayed from a bundle */
+};
+
+#define NVME_COLLECT_MAX_LOGS	16
+
+/* One log page retrieved by the collect command */
+struct nvme_collect_log {
+	const char *name;
+	int err;		/* NVMe status or negative errno */
+	size_t len;		/* bytes retrieved */
+	void *data;		/* decoded logs kept in memory */
+	char *file;		/* raw logs written to a file */
+};
+
+/* Per device results of the collect command */
+struct nvme_collect_dev {
+	char *path;
+	const char *name;
+	int err;		/* the device could not be opened */
+	__u64 elapsed_ns;
+	int nr_logs;
+	struct nvme_collect_log logs[NVME_COLLECT_MAX_LOGS];
+};
+
+enum nvme_fw_rollout_stage {
+	NVME_FW_ROLLOUT_OPEN,
+	NVME_FW_ROLLOUT_DOWNLOAD,
+	NVME_FW_ROLLOUT_COMMIT,
+	NVME_FW_ROLLOUT_VERIFY,
+	NVME_FW_ROLLOUT_DONE,
+};
+
+/* Per device results of the fw-rollout command */
+struct nvme_fw_rollout_dev {
+	char *path;
+	const char *name;
+	enum nvme_fw_rollout_stage stage;	/* failed or last reached stage */
+	int err;		/* NVMe status or negative errno of the stage */
+	bool skipped;		/* the expected revision is already active */
+	bool reset;		/* the new firmware needs a reset to activate */
+	bool mismatch;		/* the slot doesn't hold the expected revision */
+	int wave;		/* commit wave, 0 if not committed */
+	char old_rev[9];	/* active revision before the rollout */
+	char new_rev[9];	/* revision in the committed slot */
+	__u64 download_ns;
+	__u64 commit_ns;
+};
+
+/* Per device results of the self-test-run command */
+struct nvme_self_test_dev {
+	char *path;
+	const char *name;
+	int err;		/* NVMe status or negative errno */
+	bool running;
+	bool done;		/* @result and the fields below are valid */
+	__u8 progress;		/* percent complete */
+	__u8 result;		/* Device Self-test Status result code */
+	__u8 stc;		/* Self-test Code of the result */
+	__u8 segment;		/* first failed segment */
+	__u64 poh;		/* power on hours of the result */
+	__u64 elapsed_ns;
+};
+
+/* Per device results of the sanitize-run command */
+struct nvme_sanitize_dev {
+	char *path;
+	const char *name;
+	int err;		/* NVMe status or negative errno */
+	bool running;
+	bool done;		/* @sstat is valid */
+	bool passed;		/* completed successfully */
+	__u16 sstat;		/* Sanitize Status after the operation */
+	__u16 sprog;		/* Sanitize Progress, in 1/65536 */
+	__u32 estimate;		/* estimated seconds from the log, 0 if not reported */
+	__u32 eta;		/* estimated seconds left, 0 if unknown */
+	__u32 polls;
+	__u64 elapsed_ns;
+};
+
+/* One log of an endurance-log or pred-lat-log --all batch */
+struct nvme_log_batch_entry {
+	__u16 id;		/* endurance group or NVM set identifier */
+	int err;		/* NVMe status or negative errno */
+	void *log;
+};
+
+/* An ANA group state change reported by ana-log --watch */
+struct nvme_ana_transition {
+	__u32 grpid;
+	__u8 old_state;		/* 0 the first time the group is seen */
+	__u8 new_state;
+	__u64 chgcnt;		/* of the group */
+	__u32 nr_nsids;
+	const __u32 *nsids;	/* members as of the last full read of the log */
+};
+
+/* Per namespace results of the format-run command */
+struct nvme_format_dev {
+	char *path;
+	const char *name;
+	char *subsys;		/* namespaces of one subsystem are formatted in turn */
+	int err;		/* NVMe status or negative errno */
+	__u32 nsid;		/* NVME_NSID_ALL if the controller formats all namespaces */
+	__u8 lbaf;
+	__u8 prev_lbaf;
+	bool shared;		/* formatted by the NVME_NSID_ALL format of another device */
+	bool running;
+	bool done;
+	bool fpi;		/* Format Progress Indicator supported */
+	__u8 progress;		/* percent complete */
+	__u32 eta;		/* estimated seconds left, 0 if unknown */
+	__u64 wait_ns;		/* queued behind other namespaces of the subsystem */
+	__u64 elapsed_ns;	/* duration of the format */
+};
+
+/* One namespace of the provision-ns command */
+struct nvme_provision_ns {
+	__u64 nsze;		/* size and capacity in logical blocks */
+	__u32 nsid;		/* 0 if not created */
+	int err;		/* NVMe status or negative errno */
+	bool attached;
+};
+
+/* Results of the provision-ns command */
+struct nvme_provision {
+	const char *name;
+	__u8 flbas;
+	__u32 lba_size;		/* data bytes per logical block */
+	__u16 *ctrls;		/* controllers the namespaces are attached to */
+	int nr_ctrls;
+	struct nvme_provision_ns *ns;
+	int nr_ns;
+	bool dry_run;		/* nothing was sent */
+	int rescan_err;
+	__u64 elapsed_ns;
+};
+
+/* One secondary controller of the virt-provision command */
+struct nvme_virt_provision_ctrl {
+	__u16 scid;
+	__u16 vfn;
+	__u16 old_nvq;		/* flexible resources assigned before */
+	__u16 old_nvi;
+	__u16 nvq;		/* flexible resources to assign */
+	__u16 nvi;
+	bool online;
+	const char *step;	/* the command that failed */
+	int err;		/* NVMe status or negative errno */
+};
+
+/* Results of the virt-provision command */
+struct nvme_virt_provision {
+	const char *name;
+	__u32 vq_pool;		/* flexible resources left to the secondaries */
+	__u32 vi_pool;
+	struct nvme_virt_provision_ctrl *ctrls;
+	int nr_ctrls;
+	bool dry_run;		/* nothing was sent */
+	int nr_cmds;		/* Virtualization Management commands sent */
+	__u64 elapsed_ns;
+};
+
+/* A failed command of a --range sweep */
+struct nvme_lba_range_err {
+	__u64 slba;
+	__u64 nlb;		/* number of blocks, not zeroes based */
+	int status;		/* NVMe status or negative errno */
+};
+
+/* Results of a write-zeroes, write-uncor or verify --range sweep */
+struct nvme_io_sweep {
+	const char *name;
+	__u64 slba;		/* first LBA of this run */
+	__u64 end;		/* first LBA after the sweep */
+	__u64 next_lba;		/* all LBAs below were processed */
+	struct nvme_io_stats *stats;
+	struct nvme_lba_range_err *errs;	/* sorted by slba */
+	int nr_errs;
+};
+
+/* A chunk whose data did not match the manifest, or could not be read */
+struct nvme_crc_mismatch {
+	__u64 slba;
+	__u32 nlb;		/* number of blocks, not zeroes based */
+	__u32 expected;		/* CRC-32C from the manifest */
+	__u32 actual;		/* CRC-32C of the device data */
+	int status;		/* read failure: NVMe status or negative errno */
+};
+
+/* Results of compare-hash */
+struct nvme_hash_compare {
+	const char *manifest;
+	bool create;		/* the manifest was written, not checked */
+	__u64 chunks;		/* chunks read */
+	struct nvme_io_stats *stats;
+	struct nvme_crc_mismatch *bad;	/* sorted by slba */
+	int nr_bad;
+};
+
+/* Bytes written through one placement identifier by fdp write */
+struct nvme_fdp_write_ruh {
+	__u16 pid;
+	__u64 bytes;
+};
+
+/* Results of fdp write, the FDP statistics are differences over the run */
+struct nvme_fdp_write {
+	__u16 egid;
+	struct nvme_io_stats *stats;
+	__u64 hbmw;		/* host bytes with metadata written */
+	__u64 mbmw;		/* media bytes with metadata written */
+	__u64 mbe;		/* media bytes erased */
+	struct nvme_fdp_write_ruh *ruhs;
+	int nr_ruhs;
+};
+
+/* One interval of fdp monitor */
+struct nvme_fdp_sample {
+	__u16 egid;
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 interval_ns;	/* since the previous sample */
+	__u64 hbmw;		/* host bytes with metadata written */
+	__u64 mbmw;		/* media bytes with metadata written */
+	__u64 mbe;		/* media bytes erased */
+	double host_rate;	/* bytes per second over the interval */
+	double media_rate;
+	double erase_rate;
+	double waf;		/* media over host bytes since the first sample */
+	int ruh_unused;		/* reclaim unit handles per usage attribute */
+	int ruh_host;
+	int ruh_ctrl;
+};
+
+#define NVME_REG_SAMPLE_MAX_REGS	8
+#define NVME_REG_SAMPLE_MAX_VALUES	16
+
+/* A value a register held during get-reg --sample-interval */
+struct nvme_reg_sample_value {
+	__u32 value;
+	__u64 entered;		/* transitions to the value, the first counts */
+	__u64 dwell_ns;		/* time spent at the value */
+};
+
+struct nvme_reg_sample_reg {
+	int offset;
+	__u32 first;
+	__u32 last;
+	__u64 transitions;
+	__u64 first_change_ns;	/* since the start, 0 without a transition */
+	int nr_values;
+	bool overflow;		/* more distinct values than are tracked */
+	struct nvme_reg_sample_value values[NVME_REG_SAMPLE_MAX_VALUES];
+};
+
+/* Summary of get-reg --sample-interval */
+struct nvme_reg_sample {
+	const char *name;
+	__u64 samples;
+	__u64 elapsed_ns;
+	__u64 max_gap_ns;	/* longest time between two samples */
+	int nr_regs;
+	struct nvme_reg_sample_reg regs[NVME_REG_SAMPLE_MAX_REGS];
+};
+
+/* One interval of smart-log --interval */
+struct nvme_smart_sample {
+	__u32 nsid;
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 interval_ns;	/* since the previous sample */
+	double read_rate;	/* bytes per second from the data units */
+	double write_rate;
+	double read_cmds;	/* host commands per second */
+	double write_cmds;
+	double busy;		/* controller busy time over the interval */
+	__u64 media_errors;	/* new over the interval */
+	__u64 err_log_entries;
+	int temperature;	/* composite temperature in kelvin */
+	int temperature_delta;	/* change since the previous sample */
+	__u8 critical_warning;
+	__u8 avail_spare;
+	__u8 percent_used;
+};
+
+/* One sample of thermal-monitor, the counters are over the interval */
+struct nvme_thermal_sample {
+	const char *name;
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 interval_ns;	/* since the previous sample */
+	int temperature;	/* composite temperature in kelvin */
+	int sensors[8];		/* in kelvin, 0 if not implemented */
+	__u32 tmt1_trans;	/* transitions to thermal management 1 and 2 */
+	__u32 tmt2_trans;
+	__u32 tmt1_time;	/* seconds spent in thermal management 1 and 2 */
+	__u32 tmt2_time;
+	__u8 critical_warning;
+	bool throttled;
+};
+
+/*
+ * A throttling episode of thermal-monitor: consecutive samples with
+ * thermal management activity or the temperature critical warning
+ */
+struct nvme_thermal_episode {
+	const char *name;
+	__u64 start_ms;		/* wall clock time of the sample before the first */
+	__u64 duration_ns;	/* up to the first sample without activity */
+	int max_temperature;	/* in kelvin */
+	__u32 samples;
+	__u32 tmt1_trans;
+	__u32 tmt2_trans;
+	__u32 tmt1_time;
+	__u32 tmt2_time;
+	bool ongoing;		/* the monitor stopped during the episode */
+};
+
+/* Totals of thermal-monitor */
+struct nvme_thermal_summary {
+	const char *name;
+	__u64 samples;
+	__u64 elapsed_ns;
+	__u64 max_gap_ns;	/* longest time between two samples */
+	int min_temperature;	/* in kelvin */
+	int max_temperature;
+	__u32 episodes;
+	__u32 tmt1_trans;
+	__u32 tmt2_trans;
+	__u32 tmt1_time;
+	__u32 tmt2_time;
+};
+
+/* the power states of a controller and the run with APST enabled */
+#define NVME_POWER_BENCH_MAX	33
+
+/* One run of power-bench, in a power state or with APST */
+struct nvme_power_bench_run {
+	int ps;			/* -1 for the run with APST enabled */
+	bool nops;		/* non-operational state, not measured */
+	__u32 max_power_uw;	/* advertised maximum power in microwatts */
+	__u32 enlat;		/* advertised entry and exit latency in us */
+	__u32 exlat;
+	int err;		/* NVMe status or negative errno of the run */
+	__u64 iops;
+	__u64 bytes_per_sec;
+	__u64 p50_ns;
+	__u64 p99_ns;
+};
+
+/* Results of power-bench */
+struct nvme_power_bench {
+	const char *name;
+	unsigned int runtime;	/* seconds of each run */
+	unsigned int queue_depth;
+	int nr;
+	struct nvme_power_bench_run runs[NVME_POWER_BENCH_MAX];
+};
+
+/* values per setting of tune-sweep */
+#define NVME_TUNE_LIST_MAX	16
+
+/* One setting of tune-sweep, the Interrupt Coalescing and Arbitration fields */
+struct nvme_tune_point {
+	__u8 agg_time;		/* in 100 us */
+	__u8 agg_thr;		/* zeroes based completions */
+	__u8 burst;		/* log2 commands, 7 for no limit */
+	__u8 lpw;		/* zeroes based weights */
+	__u8 mpw;
+	__u8 hpw;
+	int err;		/* NVMe status or negative errno of the run */
+	__u64 iops;
+	__u64 cpu_ns;		/* busy time of all CPUs per command */
+	__u64 p99_ns;
+	bool pareto;		/* no other setting is as good in all metrics */
+};
+
+/* Results of tune-sweep */
+struct nvme_tune_sweep {
+	const char *name;
+	unsigned int runtime;	/* seconds of each run */
+	unsigned int queue_depth;
+	int nr;
+	int chosen;		/* of the points, -1 if none */
+	bool saved;		/* the chosen setting was saved */
+	struct nvme_tune_point *points;
+};
+
+/* writes per Flush of flush-bench */
+#define NVME_FLUSH_RATIO_MAX	8
+
+/* plain writes, each ratio and FUA writes in both states of the cache */
+#define NVME_FLUSH_BENCH_MAX	(2 * (NVME_FLUSH_RATIO_MAX + 2))
+
+/* One run of flush-bench */
+struct nvme_flush_bench_run {
+	bool vwc;		/* volatile write cache enabled */
+	bool fua;		/* FUA writes instead of Flush commands */
+	__u32 ratio;		/* writes per Flush, 0 for none */
+	int err;		/* NVMe status or negative errno of the run */
+	__u64 iops;		/* of the writes */
+	__u64 bytes_per_sec;
+	__u64 p50_ns;		/* write latency */
+	__u64 p99_ns;
+	__u64 flushes;
+	__u64 flush_p50_ns;
+	__u64 flush_p99_ns;
+	__u64 flush_p999_ns;
+	double cost;		/* write throughput lost against plain writes */
+};
+
+/* Results of flush-bench */
+struct nvme_flush_bench {
+	const char *name;
+	unsigned int runtime;	/* seconds of each run */
+	unsigned int queue_depth;
+	bool vwc_present;
+	bool toggled;		/* both states of the cache were measured */
+	int nr;
+	struct nvme_flush_bench_run runs[NVME_FLUSH_BENCH_MAX];
+};
+
+/* Results of pmr-bench */
+struct nvme_pmr_bench {
+	const char *name;
+	__u8 bir;		/* BAR of the PMR */
+	__u64 bar_size;
+	__u64 offset;		/* of the range benchmarked */
+	__u64 size;
+	unsigned int passes;	/* copies of the range per bandwidth */
+	bool wc;		/* write combining instead of uncached mapping */
+	bool enabled;		/* the PMR was enabled for the benchmark */
+	bool nt_native;		/* the CPU has non-temporal stores */
+	const char *barrier;	/* write barrier read-back, NULL for none */
+	__u64 load_bps;
+	__u64 store_bps;
+	__u64 nt_bps;
+	__u32 persist_size;	/* bytes stored before every read-back */
+	__u64 persists;
+	__u64 persist_p50_ns;
+	__u64 persist_p99_ns;
+	__u64 persist_p999_ns;
+	__u64 persist_max_ns;
+};
+
+/* One interval of a multi-device io-bench, of a namespace or "all" */
+struct nvme_io_bench_sample {
+	const char *name;
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 interval_ns;	/* since the previous sample */
+	double iops;
+	double bytes_per_sec;
+	__u64 errors;		/* new over the interval */
+};
+
+/* Results of a multi-device io-bench, per namespace and together */
+struct nvme_io_bench_multi {
+	int nr_devs;
+	const char **names;
+	struct nvme_io_stats *stats;
+	struct nvme_io_stats *total;
+};
+
+/* context attributes values, and so regions, of dsm-bench */
+#define NVME_DSM_BENCH_REGIONS	16
+
+/* One region of dsm-bench */
+struct nvme_dsm_bench_region {
+	__u32 cattr;		/* context attributes of the DSM ranges */
+	__u8 write_pct;
+	__u8 random_pct;
+	__u64 slba;
+	__u64 nr_lbas;
+	int tag_err;		/* NVMe status or negative errno of the DSM commands */
+	int err;		/* of the run */
+	bool done;		/* the run was not cut short before it started */
+	__u64 iops;
+	__u64 bytes_per_sec;
+	__u64 reads;
+	__u64 writes;
+	__u64 read_p50_ns;
+	__u64 read_p99_ns;
+	__u64 read_p999_ns;
+	__u64 write_p50_ns;
+	__u64 write_p99_ns;
+	__u64 write_p999_ns;
+	bool media_err;		/* the media writes could not be read */
+	__u64 host_bytes;	/* over the run */
+	__u64 media_bytes;
+	double waf;		/* media over host bytes, 0 if not known */
+};
+
+/* Results of dsm-bench */
+struct nvme_dsm_bench {
+	const char *name;
+	__u32 nsid;
+	unsigned int runtime;	/* seconds on each region */
+	unsigned int queue_depth;
+	bool per_command;	/* the reads and writes carried the attributes */
+	bool fdp;		/* media writes of the FDP statistics log */
+	const char *media;	/* "fdp", "ocp" or NULL without media writes */
+	int nr;
+	struct nvme_dsm_bench_region regions[NVME_DSM_BENCH_REGIONS];
+};
+
+/* One namespace of compare-write-bench */
+struct nvme_cw_bench_dev {
+	const char *name;
+	int err;		/* negative errno of the run */
+	__u64 pairs;		/* lock operations completed, Compare and any Write */
+	__u64 acquired;		/* locks taken */
+	__u64 contended;	/* acquires failing their Compare, held elsewhere */
+	__u64 released;
+	__u64 lost;		/* releases failing their Compare, taken over */
+	__u64 errors;		/* pairs failing otherwise */
+	__u64 held;		/* locks still held after the run */
+	__u64 pairs_per_sec;
+	__u64 p50_ns;
+	__u64 p99_ns;
+	__u64 p999_ns;
+};
+
+/* Results of compare-write-bench, per namespace and together */
+struct nvme_cw_bench {
+	unsigned int runtime;
+	unsigned int queue_depth;
+	unsigned int threads;
+	__u64 locks;		/* lock blocks per namespace */
+	int nr_devs;
+	struct nvme_cw_bench_dev *devs;
+	struct nvme_cw_bench_dev *total;
+};
+
+/* A window change of plm-scheduler on one NVM set */
+struct nvme_plm_event {
+	const char *name;
+	__u64 timestamp_ms;	/* wall clock time of the change */
+	__u32 replica;		/* index of the drive in the group */
+	__u16 nvmset_id;
+	__u8 window;		/* 1 DTWIN, 2 NDWIN */
+	__u16 event_type;	/* of the Predictable Latency log, if forced */
+	bool forced;		/* the controller entered NDWIN on its own */
+	bool overlap;		/* during another replica's NDWIN */
+	int err;		/* NVMe status or negative errno of the request */
+};
+
+/* Totals of plm-scheduler for one replica drive */
+struct nvme_plm_summary {
+	const char *name;
+	__u32 replica;
+	__u32 nvmsets;
+	__u64 elapsed_ns;
+	__u64 ndwin_ns;		/* spent in the scheduled NDWINs */
+	__u32 ndwins;
+	__u32 forced;		/* autonomous transitions to NDWIN */
+	__u32 overlaps;		/* of those, during another replica's NDWIN */
+	__u32 errors;
+};
+
+/* One sample of latency-histogram */
+struct nvme_lat_sample {
+	const char *source;
+	const char *type;	/* read, write, trim or all */
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 interval_ns;	/* since the previous sample, 0 for the log as read */
+	struct nvme_lat_hist *hist;
+};
+
+/* The commands of one opcode replayed by passthru-replay */
+struct nvme_replay_op {
+	bool admin;
+	__u8 opcode;
+	__u64 cmds;
+	__u64 errors;
+	int first_err;		/* NVMe status or negative errno */
+	__u64 bytes;		/* data transferred by successful commands */
+	struct nvme_hist lat;	/* per command latency in ns */
+};
+
+/* Results of passthru-replay */
+struct nvme_replay {
+	const char *trace;
+	unsigned int queue_depth;
+	bool timed;		/* issued with the think times of the trace */
+	__u64 cmds;		/* replayed, fewer than traced if interrupted */
+	__u64 late;		/* timed commands issued over 1 ms after they were due */
+	__u64 elapsed_ns;
+	struct nvme_replay_op *ops;	/* admin before I/O, by opcode */
+	int nr_ops;
+};
+
+/* One namespace of the resv-batch command */
+struct nvme_resv_batch_ns {
+	__u32 nsid;
+	int err;		/* NVMe status or negative errno */
+	__u64 elapsed_ns;
+};
+
+/* Results of the resv-batch command */
+struct nvme_resv_batch {
+	const char *name;
+	const char *action;	/* register, acquire or release */
+	unsigned int jobs;
+	struct nvme_resv_batch_ns *ns;
+	int nr_ns;
+	__u64 elapsed_ns;
+};
+
+/* The reservation status of one namespace, for resv-report --compact */
+struct nvme_resv_ns {
+	__u32 nsid;
+	int err;		/* NVMe status or negative errno of the report */
+	int bytes;		/* size of @status */
+	bool eds;
+	struct nvme_resv_status *status;
+};
+
+/* One namespace of smart-log --all-namespaces */
+struct nvme_smart_ns {
+	__u32 nsid;
+	int err;		/* NVMe status or negative errno of the log */
+	struct nvme_smart_log log;
+};
+
+/* One namespace of id-ns --all and ns-descs --all */
+struct nvme_id_ns_entry {
+	__u32 nsid;
+	int err;		/* NVMe status or negative errno of the identify */
+	void *data;		/* the Identify data, NVME_IDENTIFY_DATA_SIZE bytes */
+};
+
+/* One namespace of the dir-streams command */
+struct nvme_streams_ns {
+	__u32 nsid;
+	int err;		/* NVMe status or negative errno */
+	__u16 requested;	/* streams asked for by allocate */
+	__u16 nsa;		/* Namespace Streams Allocated */
+	__u16 nso;		/* Namespace Streams Open, status only */
+};
+
+/* Results of the dir-streams command */
+struct nvme_streams {
+	const char *name;
+	const char *action;	/* status, allocate or release */
+	__u16 msl;		/* the subsystem parameters, read once */
+	__u16 nssa;
+	__u16 nsso;
+	__u32 sws;
+	__u16 sgs;
+	struct nvme_streams_ns *ns;
+	int nr_ns;
+	__u64 elapsed_ns;
+};
+
+/* The Operation of a Capacity Management command */
+enum nvme_cap_layout_op_type {
+	NVME_CAP_LAYOUT_SELECT		= 0,
+	NVME_CAP_LAYOUT_CREATE_ENDGRP	= 1,
+	NVME_CAP_LAYOUT_DELETE_ENDGRP	= 2,
+	NVME_CAP_LAYOUT_CREATE_NVMSET	= 3,
+	NVME_CAP_LAYOUT_DELETE_NVMSET	= 4,
+};
+
+#define NVME_CAP_LAYOUT_NO_CONFIG	0xffff
+#define NVME_CAP_LAYOUT_PHASES		5
+
+/* One Capacity Management command of capacity-layout */
+struct nvme_cap_layout_op {
+	__u8 op;
+	__u16 element_id;	/* configuration, endurance group or NVM set */
+	__u64 capacity;		/* bytes, of the create operations */
+	bool run;		/* not sent once an earlier one failed */
+	__u32 result;		/* identifier of what was created */
+	int err;		/* NVMe status or negative errno */
+	__u64 elapsed_ns;
+};
+
+/* The operations of one type, run back-to-back */
+struct nvme_cap_layout_phase {
+	const char *name;
+	int nr;			/* operations sent */
+	__u64 elapsed_ns;
+};
+
+/* Results of the capacity-layout command */
+struct nvme_cap_layout {
+	const char *name;
+	__u64 list_ns;		/* reading the supported configurations, 0 if not read */
+	struct nvme_cap_layout_phase phases[NVME_CAP_LAYOUT_PHASES];
+	int nr_phases;
+	struct nvme_cap_layout_op *ops;
+	int nr_ops;
+	__u64 elapsed_ns;
+};
+
+/* One controller path of a namespace probed by path-probe */
+struct nvme_path_probe_path {
+	const char *name;	/* of the path, nvmeXcYnZ */
+	const char *ctrl;
+	const char *transport;
+	const char *address;
+	const char *state;	/* of the controller */
+	const char *ana_state;
+	__u32 nsid;
+	int err;		/* the path could not be probed, negative errno */
+	__u64 ios;
+	__u64 errors;
+	int first_err;		/* first failing status or negative errno */
+	__u64 elapsed_ns;
+	struct nvme_hist lat;	/* per command latency in ns */
+};
+
+/* Results of the path-probe command */
+struct nvme_path_probe {
+	const char *mode;	/* read or verify */
+	unsigned int queue_depth;
+	struct nvme_path_probe_path *paths;	/* in topology order */
+	int nr_paths;
+};
+
+/* One I/O queue layout connected and probed by connect-advise */
+struct nvme_queue_layout {
+	int nr_io_queues;
+	int nr_write_queues;
+	int nr_poll_queues;
+	int queue_size;
+	char ctrl[32];		/* the probe's controller, nvmeX */
+	int err;		/* not connected or probed, negative errno */
+	struct nvme_io_stats *read;
+	struct nvme_io_stats *write;	/* NULL without --write */
+};
+
+/* Results of connect-advise */
+struct nvme_queue_advice {
+	const char *subsysnqn;
+	const char *transport;
+	const char *traddr;
+	__u32 nsid;
+	unsigned int runtime;	/* seconds per probe */
+	struct nvme_queue_layout *layouts;	/* in the order tried */
+	int nr_layouts;
+	int best;		/* index of the recommended layout, -1 for none */
+	bool saved;		/* written to the JSON configuration */
+};
+
+/* One round of nvme-mi-poll over an MI endpoint */
+struct nvme_mi_poll_sample {
+	const char *name;
+	__u64 timestamp_ms;	/* wall clock time of the sample */
+	__u64 hsp_ns;		/* latency of the Health Status Poll */
+	__u64 smart_ns;		/* of the tunneled SMART log, 0 if not read */
+	__u8 nss;		/* NVM Subsystem Status */
+	__u8 sw;		/* SMART warnings */
+	int ctemp;		/* composite temperature in celsius */
+	__u8 pdlu;		/* percentage drive life used */
+	__u16 ccs;		/* composite controller status */
+	bool smart;
+	int temperature;	/* SMART composite temperature in kelvin */
+	__u8 critical_warning;
+	__u8 avail_spare;
+	__u8 percent_used;
+};
+
+/* Zones of one state, counted for zns zone-summary */
+struct nvme_zone_state_count {
+	__u8 state;		/* zone state, NVME_ZNS_ZS_* */
+	__u64 zones;
+};
+
+/* Results of zns zone-summary */
+struct nvme_zone_summary {
+	__u32 nsid;
+	__u64 nr_zones;		/* zones matching the reporting options */
+	__u64 zsze;		/* zone size in LBAs */
+	__u64 zcap;		/* summed capacity of those zones in LBAs */
+	struct nvme_zone_state_count states[7];
+	int nr_states;
+	__u64 written;		/* LBAs written, full zones count as zcap */
+};
+
+/* One namespace shown by list --fast, read from sysfs only */
+struct nvme_list_fast_ns {
+	char name[32];		/* block device, e.g. nvme0n1 */
+	char generic[32];	/* generic char device, empty if not found */
+	char serial[32];
+	char model[64];
+	char firmware[16];
+	__u32 nsid;
+	__u64 size;		/* bytes */
+	__u32 lba_size;
+	__u32 meta_size;
+	int err;		/* the namespace went away during the scan */
 };
 
 #define dev_fd(d) __dev_fd(d, __func__, __LINE__)
@@ -94,12 +888,76 @@ static inline nvme_mi_ep_t dev_mi_ep(struct nvme_dev *dev)
 
 void register_extension(struct plugin *plugin);
 
+enum nvme_lat_type {
+	NVME_LAT_READ,
+	NVME_LAT_WRITE,
+	NVME_LAT_TRIM,
+	NVME_LAT_ALL,
+};
+
+/*
+ * A vendor latency log latency-histogram can read, registered by the
+ * plugin decoding it with NVME_LAT_SOURCE().
+ */
+struct nvme_lat_source {
+	const char *name;
+	bool generic;		/* not vendor specific, tried last */
+	/*
+	 * fill @h with the latencies of the @type commands, returns -ENOTSUP
+	 * when the device or @type isn't covered by the log
+	 */
+	int (*read)(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+		    enum nvme_lat_type type, struct nvme_lat_hist *h);
+	struct nvme_lat_source *next;
+};
+
+void register_lat_source(struct nvme_lat_source *s);
+
+#if CONFIG_LAZY_PLUGINS
+/* collected by the linker like the plugins, see PLUGIN() in cmd_handler.h */
+#define NVME_LAT_SOURCE(s)						\
+static struct nvme_lat_source *const s##_entry				\
+	__attribute__((used, section("nvme_lat_sources"),		\
+		       aligned(sizeof(void *)))) = &s;
+#else
+#define NVME_LAT_SOURCE(s)						\
+static void s##_register(void) __attribute__((constructor));		\
+static void s##_register(void)						\
+{									\
+	register_lat_source(&s);					\
+}
+#endif
+
 /*
  * parse_and_open - parses arguments and opens the NVMe device, populating @dev
  */
 int parse_and_open(struct nvme_dev **dev, int argc, char **argv, const char *desc,
 	struct argconfig_commandline_options *clo);
 
+/*
+ * parse_and_open_input - as parse_and_open, but the device is only needed,
+ * and opened, when the option parsed into @input doesn't name any
+ * captures to decode instead
+ */
+int parse_and_open_input(struct nvme_dev **dev, int argc, char **argv, const char *desc,
+	struct argconfig_commandline_options *clo, char **input);
+
+typedef int (*nvme_capture_show_t)(void *data, size_t len, const char *file, void *arg);
+
+/*
+ * nvme_decode_captures - render the comma separated capture @files offline
+ * @size: of one record, a file may hold several of them back to back
+ * @whole: hand all the records of a file to @show at once, for the logs
+ *	   made of a variable number of entries
+ * @what: the record, for the messages about a file of the wrong size
+ *
+ * @show gets the file name to print in place of the device name, and stops
+ * at the first record of a file it fails. Bad files are reported and
+ * skipped, returns 0 or the first error.
+ */
+int nvme_decode_captures(char *files, size_t size, bool whole, const char *what,
+			 nvme_capture_show_t show, void *arg);
+
 void dev_close(struct nvme_dev *dev);
 
 static inline DEFINE_CLEANUP_FUNC(
@@ -109,12 +967,33 @@ static inline DEFINE_CLEANUP_FUNC(
 extern const char *output_format;
 
 int validate_output_format(const char *format, enum nvme_print_flags *flags);
+/*
+ * Sets the layout of the JSON output for @format. Called on the main thread
+ * once the options are parsed, a command may change the layout afterwards.
+ */
+void nvme_set_json_output_mode(const char *format);
 bool nvme_is_output_format_json(void);
 int __id_ctrl(int argc, char **argv, struct command *cmd,
 	struct plugin *plugin, void (*vs)(uint8_t *vs, struct json_object *root));
 
 const char *nvme_strerror(int errnum);
 
+/* largest data transfer of a single command, from MDTS */
+int get_max_xfer_len(struct nvme_dev *dev, __u32 *len);
+
+/*
+ * get_log_to_file - stream the log of @args into @output in @xfer_len chunks,
+ * a helper thread writing each chunk while the next one is fetched
+ * @progress: name of the progress bar shown on stdout, NULL for none
+ *
+ * Returns 0, a positive NVMe status or a negative errno.
+ */
+int get_log_to_file(struct nvme_dev *dev, struct nvme_get_log_args *args,
+		    __u32 xfer_len, int output, const char *progress);
+
+/* the generic char device of @dev for io_uring passthrough, to be closed */
+int open_generic_dev(struct nvme_dev *dev);
+
 unsigned long long elapsed_utime(struct timeval start_time,
 					struct timeval end_time);
 
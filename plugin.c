@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <errno.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "plugin.h"
@@ -9,6 +11,164 @@
 
 #include <libnvme.h>
 
+/*
+ * Command lookup index of a plugin: an open addressing hash table over the
+ * names and aliases for exact matches and the commands sorted by name, so
+ * a unique prefix is found with a binary search. Both are built once on
+ * the first lookup instead of comparing against every command.
+ */
+struct plugin_index {
+	unsigned int mask;
+	struct command **slots;		/* mask + 1 entries */
+	struct command **sorted;
+	unsigned int nr;
+};
+
+static uint32_t cmd_hash(const char *str)
+{
+	uint32_t h = 2166136261u;
+
+	while (*str) {
+		h ^= (unsigned char)*str++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static bool cmd_matches(struct command *cmd, const char *str)
+{
+	return !strcmp(str, cmd->name) || (cmd->alias && !strcmp(str, cmd->alias));
+}
+
+static void index_insert(struct plugin_index *idx, struct command *cmd,
+			 const char *key)
+{
+	unsigned int i = cmd_hash(key) & idx->mask;
+
+	/* the first command registered under a key wins, as with the scan */
+	while (idx->slots[i]) {
+		if (cmd_matches(idx->slots[i], key))
+			return;
+		i = (i + 1) & idx->mask;
+	}
+	idx->slots[i] = cmd;
+}
+
+static int cmd_name_cmp(const void *a, const void *b)
+{
+	struct command *const *ca = a, *const *cb = b;
+
+	return strcmp((*ca)->name, (*cb)->name);
+}
+
+static struct plugin_index *plugin_index(struct plugin *plugin)
+{
+	struct plugin_index *idx;
+	unsigned int nr = 0, size = 4, i;
+
+	if (plugin->index)
+		return plugin->index;
+
+	while (plugin->commands[nr])
+		nr++;
+	/* names and aliases stay below half the table */
+	while (size < nr * 4)
+		size <<= 1;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+	idx->slots = calloc(size, sizeof(*idx->slots));
+	idx->sorted = calloc(nr + 1, sizeof(*idx->sorted));
+	if (!idx->slots || !idx->sorted) {
+		free(idx->slots);
+		free(idx->sorted);
+		free(idx);
+		return NULL;
+	}
+
+	idx->mask = size - 1;
+	idx->nr = nr;
+	for (i = 0; i < nr; i++) {
+		struct command *cmd = plugin->commands[i];
+
+		index_insert(idx, cmd, cmd->name);
+		if (cmd->alias)
+			index_insert(idx, cmd, cmd->alias);
+		idx->sorted[i] = cmd;
+	}
+	qsort(idx->sorted, nr, sizeof(*idx->sorted), cmd_name_cmp);
+
+	plugin->index = idx;
+	return idx;
+}
+
+/* the scan of the command array, if the index can't be allocated */
+static struct command *find_command_scan(struct plugin *plugin, const char *str)
+{
+	struct command **cmd = plugin->commands;
+	struct command *cr = NULL;
+	bool cr_valid = false;
+
+	while (*cmd) {
+		if (cmd_matches(*cmd, str))
+			return *cmd;
+		if (!strncmp(str, (*cmd)->name, strlen(str))) {
+			if (cr) {
+				cr_valid = false;
+			} else {
+				cr = *cmd;
+				cr_valid = true;
+			}
+		}
+		cmd++;
+	}
+
+	return cr_valid ? cr : NULL;
+}
+
+struct command *plugin_find_command(struct plugin *plugin, const char *str)
+{
+	struct plugin_index *idx = plugin_index(plugin);
+	size_t len = strlen(str);
+	unsigned int i, lo, hi;
+
+	if (!idx)
+		return find_command_scan(plugin, str);
+
+	for (i = cmd_hash(str) & idx->mask; idx->slots[i];
+	     i = (i + 1) & idx->mask) {
+		if (cmd_matches(idx->slots[i], str))
+			return idx->slots[i];
+	}
+
+	/* the first name sorting at or after @str */
+	lo = 0;
+	hi = idx->nr;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(idx->sorted[mid]->name, str) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == idx->nr || strncmp(str, idx->sorted[lo]->name, len))
+		return NULL;
+	if (lo + 1 < idx->nr && !strncmp(str, idx->sorted[lo + 1]->name, len))
+		return NULL;
+
+	return idx->sorted[lo];
+}
+
+static void load_extensions(struct program *prog)
+{
+	if (prog->load_extensions)
+		prog->load_extensions(prog);
+}
+
 static int version_cmd(struct plugin *plugin)
 {
 	struct program *prog = plugin->parent;
@@ -31,27 +191,24 @@ static int help(int argc, char **argv, struct plugin *plugin)
 	char man[0x100];
 	struct program *prog = plugin->parent;
 	char *str = argv[1];
-	int i;
+	struct command *cmd;
 
 	if (argc == 1) {
 		general_help(plugin);
 		return 0;
 	}
 
-	for (i = 0; plugin->commands[i]; i++) {
-		struct command *cmd = plugin->commands[i];
+	cmd = plugin_find_command(plugin, str);
+	if (!cmd || !cmd_matches(cmd, str))
+		return 0;
 
-		if (strcmp(str, cmd->name))
-			if (!cmd->alias || (cmd->alias && strcmp(str, cmd->alias)))
-				continue;
+	if (plugin->name)
+		sprintf(man, "%s-%s-%s", prog->name, plugin->name, cmd->name);
+	else
+		sprintf(man, "%s-%s", prog->name, cmd->name);
+	if (execlp("man", "man", man, (char *)NULL))
+		perror(argv[1]);
 
-		if (plugin->name)
-			sprintf(man, "%s-%s-%s", prog->name, plugin->name, cmd->name);
-		else
-			sprintf(man, "%s-%s", prog->name, cmd->name);
-		if (execlp("man", "man", man, (char *)NULL))
-			perror(argv[1]);
-	}
 	return 0;
 }
 
@@ -122,6 +279,7 @@ void general_help(struct plugin *plugin)
 	if (plugin->name)
 		return;
 
+	load_extensions(prog);
 	extension = prog->extensions->next;
 	if (!extension)
 		return;
@@ -141,9 +299,7 @@ int handle_plugin(int argc, char **argv, struct plugin *plugin)
 	char use[0x100];
 	struct plugin *extension;
 	struct program *prog = plugin->parent;
-	struct command **cmd = plugin->commands;
-	struct command *cr = NULL;
-	bool cr_valid = false;
+	struct command *cmd;
 
 	if (!argc) {
 		general_help(plugin);
@@ -165,25 +321,14 @@ int handle_plugin(int argc, char **argv, struct plugin *plugin)
 	if (!strcmp(str, "version"))
 		return version_cmd(plugin);
 
-	while (*cmd) {
-		if (!strcmp(str, (*cmd)->name) ||
-		    ((*cmd)->alias && !strcmp(str, (*cmd)->alias)))
-			return (*cmd)->fn(argc, argv, *cmd, plugin);
-		if (!strncmp(str, (*cmd)->name, strlen(str))) {
-			if (cr) {
-				cr_valid = false;
-			} else {
-				cr = *cmd;
-				cr_valid = true;
-			}
-		}
-		cmd++;
-	}
+	cmd = plugin_find_command(plugin, str);
+	if (cmd && cmd_matches(cmd, str))
+		return cmd->fn(argc, argv, cmd, plugin);
 
-	if (cr && cr_valid) {
-		sprintf(use, "%s %s <device> [OPTIONS]", prog->name, cr->name);
+	if (cmd) {
+		sprintf(use, "%s %s <device> [OPTIONS]", prog->name, cmd->name);
 		argconfig_append_usage(use);
-		return cr->fn(argc, argv, cr, plugin);
+		return cmd->fn(argc, argv, cmd, plugin);
 	}
 
 	/* Check extensions only if this is running the built-in plugin */
@@ -192,6 +337,7 @@ int handle_plugin(int argc, char **argv, struct plugin *plugin)
 		return -ENOTTY;
 	}
 
+	load_extensions(prog);
 	extension = plugin->next;
 	while (extension) {
 		if (!strcmp(str, extension->name))
@@ -12,8 +12,12 @@ struct program {
 	const char *more;
 	struct command **commands;
 	struct plugin *extensions;
+	/* registers the extensions, called before they are first needed */
+	void (*load_extensions)(struct program *prog);
 };
 
+struct plugin_index;
+
 struct plugin {
 	const char *name;
 	const char *desc;
@@ -22,6 +26,7 @@ struct plugin {
 	struct program *parent;
 	struct plugin *next;
 	struct plugin *tail;
+	struct plugin_index *index;	/* built on the first lookup */
 };
 
 struct command {
@@ -34,4 +39,12 @@ struct command {
 void general_help(struct plugin *plugin);
 int handle_plugin(int argc, char **argv, struct plugin *plugin);
 
+/*
+ * plugin_find_command - look up a command of @plugin
+ *
+ * @str matches a command by its name or alias, or else by a prefix of
+ * exactly one command name. Returns the command or NULL.
+ */
+struct command *plugin_find_command(struct plugin *plugin, const char *str);
+
 #endif
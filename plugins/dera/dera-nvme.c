@@ -10,6 +10,7 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 
+#include "common.h"
 #include "nvme.h"
 #include "libnvme.h"
 #include "plugin.h"
@@ -18,18 +19,7 @@
 
 #define CREATE_CMD
 #include "dera-nvme.h"
-
-static int char4_to_int(__u8 *data)
-{
-	int i;
-	int result = 0;
-
-	for (i = 0; i < 4; i++) {
-		result = result << 8;
-		result += data[3 - i];
-	}
-	return result;
-}
+#include "plugins/smart-attr.h"
 
 struct nvme_dera_smart_info_log
 {
@@ -95,6 +85,79 @@ enum dera_device_status
 	DEVICE_STAUTS__OVER_TEMPRATURE = 0x09,
 };
 
+static const char * const dera_dev_status[] = {
+	"Normal",
+	"Quick Rebuilding",
+	"Full Rebuilding",
+	"Raw Rebuilding",
+	"Card Read Only",
+	"Fatal Error",
+	"Busy",
+	"Low Level Format",
+	"Firmware Committing",
+	"Over Temperature",
+	NULL,
+};
+
+static const char * const dera_bool[] = { "False", "True", NULL };
+static const char * const dera_cap_status[] = { "Normal", "Warning", "Critical", NULL };
+static const char * const dera_volt_status[] = {
+	"Normal",
+	"Initial Low",
+	"Runtime Low",
+	NULL,
+};
+
+#define DERA_ATTR(_member, _name, ...)						\
+	{ .name = _name,							\
+	  .offset = offsetof(struct nvme_dera_smart_info_log, _member),		\
+	  .width = sizeof(((struct nvme_dera_smart_info_log *)0)->_member),	\
+	  __VA_ARGS__ }
+
+static const struct smart_attr dera_smart_attrs[] = {
+	DERA_ATTR(dev_status_up, "dev_status_up", .type = SMART_ATTR_ENUM,
+		  .keys = dera_dev_status),
+	DERA_ATTR(cap_aged, "cap_aged", .type = SMART_ATTR_ENUM, .keys = dera_bool),
+	DERA_ATTR(cap_aged_ratio, "cap_aged_ratio", .flags = SMART_ATTR_MAX_100,
+		  .fmt = "%u%%"),
+	DERA_ATTR(cap_status, "cap_status", .type = SMART_ATTR_ENUM,
+		  .keys = dera_cap_status),
+	DERA_ATTR(cap_voltage, "cap_voltage", .fmt = "%u mV"),
+	DERA_ATTR(nand_erase_err_cnt, "nand_erase_err_cnt"),
+	DERA_ATTR(nand_program_err_cnt, "nand_program_err_cnt"),
+	DERA_ATTR(ddra_1bit_err, "ddra_1bit_err"),
+	DERA_ATTR(ddra_2bit_err, "ddra_2bit_err"),
+	DERA_ATTR(ddrb_1bit_err, "ddrb_1bit_err"),
+	DERA_ATTR(ddrb_2bit_err, "ddrb_2bit_err"),
+	DERA_ATTR(ddr_err_bit, "ddr_err_bit"),
+	DERA_ATTR(pcie_corr_err, "pcie_corr_err"),
+	DERA_ATTR(pcie_uncorr_err, "pcie_uncorr_err"),
+	DERA_ATTR(pcie_fatal_err, "pcie_fatal_err"),
+	DERA_ATTR(power_level, "power_level", .fmt = "%u W"),
+	DERA_ATTR(current_power, "current_power", .fmt = "%u mW"),
+	DERA_ATTR(nand_init_fail, "nand_init_fail"),
+	DERA_ATTR(fw_loader_version, "fw_loader_version", .type = SMART_ATTR_STRING),
+	DERA_ATTR(uefi_driver_version, "uefi_driver_version", .type = SMART_ATTR_STRING),
+	DERA_ATTR(pcie_volt_status, "pcie_volt_status", .type = SMART_ATTR_ENUM,
+		  .keys = dera_volt_status),
+	DERA_ATTR(current_pcie_volt, "current_pcie_volt", .fmt = "%u mV"),
+	DERA_ATTR(init_pcie_volt_low, "init_pcie_volt_low_cnt"),
+	DERA_ATTR(rt_pcie_volt_low, "rt_pcie_volt_low_cnt"),
+	DERA_ATTR(temp_sensor_abnormal, "temp_sensor_abnormal_cnt"),
+	DERA_ATTR(nand_read_retry_fail_cnt, "nand_read_retry_fail_cnt"),
+	DERA_ATTR(fw_slot_version, "fw_slot_version", .type = SMART_ATTR_STRING),
+};
+
+static const struct smart_attr_layout dera_smart_layout = {
+	.title		= "Dera Smart log",
+	.attrs		= dera_smart_attrs,
+	.nr_attrs	= ARRAY_SIZE(dera_smart_attrs),
+	.id_offset	= -1,
+	.norm_offset	= -1,
+	.label_width	= 36,
+	.len		= sizeof(struct nvme_dera_smart_info_log),
+};
+
 static int nvme_dera_get_device_status(int fd, enum dera_device_status *result)
 {
 	int err = 0;
@@ -114,15 +177,61 @@ static int nvme_dera_get_device_status(int fd, enum dera_device_status *result)
 	return err;
 }
 
+static void show_dera_status(struct nvme_dera_smart_info_log *log,
+			     enum dera_device_status state, const char *devname,
+			     enum nvme_print_flags fmt)
+{
+	const char *status = state < ARRAY_SIZE(dera_dev_status) - 1 ?
+		dera_dev_status[state] : "Unknown";
+	bool rebuilding = state > 0 && state < 4;
+	struct json_object *root;
+
+	if (fmt == BINARY) {
+		d_raw((unsigned char *)log, sizeof(*log));
+		return;
+	}
+
+	if (fmt != JSON) {
+		if (rebuilding)
+			printf("%-36s: %s %d%% completed\n", "device_status", status,
+			       log->rebuild_percent);
+		else
+			printf("%-36s: %s\n", "device_status", status);
+		smart_attr_print(&dera_smart_layout, log, devname, 0, fmt);
+		return;
+	}
+
+	root = json_create_object();
+	json_object_add_value_string(root, dera_smart_layout.title, devname);
+	json_object_add_value_string(root, "device_status", status);
+	if (rebuilding)
+		json_object_add_value_int(root, "rebuild_percent", log->rebuild_percent);
+	json_object_add_value_object(root, "Device stats",
+				     smart_attr_json(&dera_smart_layout, log));
+	json_print_object(root, NULL);
+	util_json_print_newline();
+	json_free_object(root);
+}
+
 static int get_status(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	struct nvme_dera_smart_info_log log;
 	enum dera_device_status state = DEVICE_STATUS_FATAL_ERROR;
 	char *desc = "Get the Dera device status";
+	enum nvme_print_flags fmt;
 	struct nvme_dev *dev;
 	int err;
 
+	struct config {
+		char *output_format;
+	};
+
+	struct config cfg = {
+		.output_format = "normal",
+	};
+
 	OPT_ARGS(opts) = {
+		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
 		OPT_END()
 	};
 
@@ -130,70 +239,19 @@ static int get_status(int argc, char **argv, struct command *cmd, struct plugin
 	if (err)
 		return err;
 
+	err = validate_output_format(cfg.output_format, &fmt);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		goto exit;
+	}
+
 	err = nvme_get_log_simple(dev_fd(dev), 0xc0, sizeof(log), &log);
 	if (err)
 		goto exit;
 
-	static const char *dev_status[] = {
-		"Normal",
-		"Quick Rebuilding",
-		"Full Rebuilding",
-		"Raw Rebuilding",
-		"Card Read Only",
-		"Fatal Error",
-		"Busy",
-		"Low Level Format",
-		"Firmware Committing",
-		"Over Temperature" };
-
-	static const char *volt_status[] = {
-		"Normal",
-		"Initial Low",
-		"Runtime Low",
-	};
-
 	err = nvme_dera_get_device_status(dev_fd(dev), &state);
-	if (!err) {
-		if (state > 0 && state < 4)
-			printf("device_status                       : %s %d%% completed\n", dev_status[state], log.rebuild_percent);
-		else
-			printf("device_status                       : %s\n", dev_status[state]);
-	} else {
-		goto exit;
-	}
-
-	printf("dev_status_up                       : %s\n", dev_status[log.dev_status_up]);
-	printf("cap_aged                            : %s\n", log.cap_aged == 1 ? "True" : "False");
-	printf("cap_aged_ratio                      : %d%%\n", log.cap_aged_ratio < 100 ? log.cap_aged_ratio : 100);
-	printf("cap_status                          : %s\n", log.cap_status == 0 ? "Normal" : (log.cap_status == 1 ? "Warning" : "Critical"));
-	printf("cap_voltage                         : %d mV\n", char4_to_int(log.cap_voltage));
-	printf("nand_erase_err_cnt                  : %d\n", char4_to_int(log.nand_erase_err_cnt));
-	printf("nand_program_err_cnt                : %d\n", char4_to_int(log.nand_program_err_cnt));
-	printf("ddra_1bit_err                       : %d\n", log.ddra_1bit_err[1] << 8 | log.ddra_1bit_err[0]);
-	printf("ddra_2bit_err                       : %d\n", log.ddra_2bit_err[1] << 8 | log.ddra_2bit_err[0]);
-	printf("ddrb_1bit_err                       : %d\n", log.ddrb_1bit_err[1] << 8 | log.ddrb_1bit_err[0]);
-	printf("ddrb_2bit_err                       : %d\n", log.ddrb_2bit_err[1] << 8 | log.ddrb_2bit_err[0]);
-	printf("ddr_err_bit                         : %d\n", log.ddr_err_bit);
-	printf("pcie_corr_err                       : %d\n", log.pcie_corr_err[1] << 8 | log.pcie_corr_err[0]);
-	printf("pcie_uncorr_err                     : %d\n", log.pcie_uncorr_err[1] << 8 | log.pcie_uncorr_err[0]);
-	printf("pcie_fatal_err                      : %d\n", log.pcie_fatal_err[1] << 8 | log.pcie_fatal_err[0]);
-	printf("power_level                         : %d W\n", log.power_level);
-	printf("current_power                       : %d mW\n", log.current_power[1] << 8 | log.current_power[0]);
-	printf("nand_init_fail                      : %d\n", log.nand_init_fail[1] << 8 | log.nand_init_fail[0]);
-	printf("fw_loader_version                   : %.*s\n", 8, log.fw_loader_version);
-	printf("uefi_driver_version                 : %.*s\n", 8, log.uefi_driver_version);
-
-	if (log.pcie_volt_status < sizeof(volt_status) / sizeof(const char *))
-		printf("pcie_volt_status                    : %s\n", volt_status[log.pcie_volt_status]);
-	else
-		printf("pcie_volt_status                    : Unknown\n");
-
-	printf("current_pcie_volt                   : %d mV\n", log.current_pcie_volt[1] << 8 | log.current_pcie_volt[0]);
-	printf("init_pcie_volt_low_cnt              : %d\n", log.init_pcie_volt_low[1] << 8 | log.init_pcie_volt_low[0]);
-	printf("rt_pcie_volt_low_cnt                : %d\n", log.rt_pcie_volt_low[1] << 8 | log.rt_pcie_volt_low[0]);
-	printf("temp_sensor_abnormal_cnt            : %d\n", log.temp_sensor_abnormal[1] << 8 | log.temp_sensor_abnormal[0]);
-	printf("nand_read_retry_fail_cnt            : %d\n", char4_to_int(log.nand_read_retry_fail_cnt));
-	printf("fw_slot_version                     : %.*s\n", 8, log.fw_slot_version);
+	if (!err)
+		show_dera_status(&log, state, dev->name, fmt);
 
 exit:
 	if (err > 0)
@@ -202,4 +260,3 @@ exit:
 	dev_close(dev);
 	return err;
 }
-
@@ -6,6 +6,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
 
@@ -13,10 +16,14 @@
 #include "nvme.h"
 #include "libnvme.h"
 #include "nvme-print.h"
+#include "nvme-io-engine.h"
+#include "util/interval.h"
 
 #define CREATE_CMD
 #include "fdp.h"
 
+#define FDP_MAX_EVENTS	63	/* entries of the FDP events log */
+
 static int fdp_configs(int argc, char **argv, struct command *cmd,
 		struct plugin *plugin)
 {
@@ -231,12 +238,95 @@ out:
 	return err;
 }
 
+static __u64 fdp_event_ts(struct nvme_fdp_event *event)
+{
+	return int48_to_long(event->ts.timestamp);
+}
+
+static int fdp_event_cmp(const void *a, const void *b)
+{
+	struct nvme_fdp_event *const *ea = a, *const *eb = b;
+	__u64 ta = fdp_event_ts(*ea), tb = fdp_event_ts(*eb);
+
+	if (ta != tb)
+		return ta < tb ? -1 : 1;
+	/* keep the log order of events with the same timestamp */
+	return *ea < *eb ? -1 : *ea > *eb;
+}
+
+/*
+ * Poll the events log and print the events that were not seen before, in
+ * timestamp order. The cursor is the newest timestamp seen so far and the
+ * number of events carrying it, as several events can share a millisecond
+ * and the log only holds the most recent ones.
+ */
+static int fdp_events_follow(int fd, __u16 egid, bool host, __u32 interval,
+			     enum nvme_print_flags flags)
+{
+	struct nvme_fdp_event *new[FDP_MAX_EVENTS];
+	struct nvme_fdp_events_log *events;
+	__u64 cursor = 0, next, ts, newest;
+	unsigned int at_cursor = 0, seen, nr_new, at_newest, i, n;
+	int err = 0;
+
+	events = nvme_alloc(sizeof(*events));
+	if (!events)
+		return -ENOMEM;
+
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	do {
+		err = nvme_get_log_fdp_events(fd, egid, host, 0, sizeof(*events),
+					      events);
+		if (err) {
+			nvme_show_status(err);
+			break;
+		}
+
+		n = min(le32_to_cpu(events->n), FDP_MAX_EVENTS);
+		newest = cursor;
+		nr_new = seen = at_newest = 0;
+		for (i = 0; i < n; i++) {
+			ts = fdp_event_ts(&events->events[i]);
+			if (ts < cursor || (ts == cursor && seen++ < at_cursor))
+				continue;
+			new[nr_new++] = &events->events[i];
+		}
+		qsort(new, nr_new, sizeof(*new), fdp_event_cmp);
+
+		for (i = 0; i < nr_new; i++)
+			nvme_show_fdp_event(new[i], host, flags);
+
+		for (i = 0; i < n; i++) {
+			ts = fdp_event_ts(&events->events[i]);
+			if (ts > newest) {
+				newest = ts;
+				at_newest = 0;
+			}
+			if (ts == newest)
+				at_newest++;
+		}
+		cursor = newest;
+		at_cursor = at_newest;
+
+		next += interval * NSEC_PER_SEC;
+	} while (nvme_interval_wait(next));
+
+	nvme_stop_release();
+	free(events);
+
+	return err;
+}
+
 static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Get Flexible Data Placement Events";
 	const char *egid = "Endurance group identifier";
 	const char *host_events = "Get host events";
 	const char *raw = "use binary output";
+	const char *follow = "keep polling the log and print only new events";
+	const char *interval = "seconds between polls in follow mode";
 
 	enum nvme_print_flags flags;
 	struct nvme_dev *dev;
@@ -248,6 +338,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		bool	host_events;
 		char	*output_format;
 		bool	raw_binary;
+		bool	follow;
+		__u32	interval;
 	};
 
 	struct config cfg = {
@@ -255,6 +347,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		.host_events =	false,
 		.output_format	= "normal",
 		.raw_binary	= false,
+		.follow		= false,
+		.interval	= 1,
 	};
 
 	OPT_ARGS(opts) = {
@@ -262,6 +356,8 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 		OPT_FLAG("host-events",  'E', &cfg.host_events,   host_events),
 		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
 		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,    raw),
+		OPT_FLAG("follow",       'f', &cfg.follow,        follow),
+		OPT_UINT("interval",     'i', &cfg.interval,      interval),
 		OPT_END()
 	};
 
@@ -276,6 +372,17 @@ static int fdp_events(int argc, char **argv, struct command *cmd, struct plugin
 	if (cfg.raw_binary)
 		flags = BINARY;
 
+	if (cfg.follow) {
+		if (flags == BINARY || !cfg.interval) {
+			fprintf(stderr, "follow mode needs an interval and a text or json format\n");
+			err = -EINVAL;
+			goto out;
+		}
+		err = fdp_events_follow(dev_fd(dev), cfg.egid, cfg.host_events,
+					cfg.interval, flags);
+		goto out;
+	}
+
 	memset(&events, 0x0, sizeof(events));
 
 	err = nvme_get_log_fdp_events(dev->direct.fd, cfg.egid,
@@ -539,3 +646,426 @@ out:
 
 	return err;
 }
+
+/* Directive Type of the write command selecting a placement identifier */
+#define FDP_DTYPE_DATA_PLACEMENT	2
+
+/* the low 64 bits of a 128 bit little endian log page counter */
+static __u64 fdp_stat(__u8 *v)
+{
+	__le64 low;
+
+	memcpy(&low, v, sizeof(low));
+	return le64_to_cpu(low);
+}
+
+static int fdp_write_prep(struct nvme_io_job *job, unsigned int thread,
+			  __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct nvme_fdp_write *fw = job->priv;
+
+	cmd->cdw13 |= (__u32)fw->ruhs[seq % fw->nr_ruhs].pid << 16;
+	return 0;
+}
+
+static void fdp_write_complete(struct nvme_io_job *job, unsigned int thread,
+			       __u64 seq, void *buf, int status, __u64 result,
+			       __u64 lat_ns)
+{
+	struct nvme_fdp_write *fw = job->priv;
+
+	if (!status)
+		__atomic_fetch_add(&fw->ruhs[seq % fw->nr_ruhs].bytes,
+				   nvme_io_job_data_len(job), __ATOMIC_RELAXED);
+}
+
+static const struct nvme_io_job_ops fdp_write_ops = {
+	.prep		= fdp_write_prep,
+	.complete	= fdp_write_complete,
+};
+
+static int fdp_write(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Keep writes in flight spread round robin over the\n"
+		"placement identifiers of a namespace and report the host and media\n"
+		"bytes written to the endurance group during the run";
+	const char *namespace_id = "Namespace identifier";
+	const char *egid = "Endurance group identifier (default: from identify namespace)";
+	const char *_pids = "Comma-separated list of placement identifiers (default: all)";
+	const char *start_block = "64-bit addr of first block to write";
+	const char *block_count = "number of blocks (zeroes based) per write";
+	const char *io_range = "number of LBAs to spread the writes over";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *io_count = "total number of writes to issue";
+	const char *runtime = "run time in seconds (overrides io-count if reached first)";
+	const char *random_lba = "use random instead of sequential LBAs";
+
+	struct nvme_fdp_stats_log before, after;
+	struct nvme_fdp_ruh_status hdr;
+	struct nvme_fdp_ruh_status *ruhs = NULL;
+	struct nvme_fdp_write fw = { 0 };
+	struct nvme_io_stats stats;
+	enum nvme_print_flags flags;
+	unsigned short pids[256];
+	struct nvme_id_ns ns;
+	struct nvme_dev *dev;
+	int err, npids, i, gfd = -1;
+	__u8 lba_index, ms;
+	size_t len;
+
+	struct config {
+		__u32	namespace_id;
+		__u16	egid;
+		char	*pids;
+		__u64	start_block;
+		__u16	block_count;
+		__u64	io_range;
+		__u32	queue_depth;
+		__u32	threads;
+		__u64	io_count;
+		__u32	runtime;
+		bool	random;
+		char	*output_format;
+	};
+
+	struct config cfg = {
+		.pids		= "",
+		.block_count	= 7,
+		.queue_depth	= 32,
+		.threads	= 1,
+		.output_format	= "normal",
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id),
+		OPT_UINT("endgrp-id",     'e', &cfg.egid,          egid),
+		OPT_LIST("pids",          'p', &cfg.pids,          _pids),
+		OPT_SUFFIX("start-block", 's', &cfg.start_block,   start_block),
+		OPT_SHRT("block-count",   'c', &cfg.block_count,   block_count),
+		OPT_SUFFIX("io-range",    'L', &cfg.io_range,      io_range),
+		OPT_UINT("queue-depth",   'q', &cfg.queue_depth,   queue_depth),
+		OPT_UINT("threads",       'j', &cfg.threads,       threads),
+		OPT_SUFFIX("io-count",    'N', &cfg.io_count,      io_count),
+		OPT_UINT("runtime",       'R', &cfg.runtime,       runtime),
+		OPT_FLAG("random",        'x', &cfg.random,        random_lba),
+		OPT_FMT("output-format",  'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto out;
+
+	if (!cfg.queue_depth || !cfg.threads) {
+		fprintf(stderr, "queue-depth and threads must be non-zero\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	npids = argconfig_parse_comma_sep_array_short(cfg.pids, pids, ARRAY_SIZE(pids));
+	if (npids < 0) {
+		perror("could not parse pids");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto out;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &ns);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+	if (!cfg.egid)
+		cfg.egid = le16_to_cpu(ns.endgid);
+
+	/* all placement identifiers of the namespace unless given */
+	if (!npids) {
+		err = nvme_fdp_reclaim_unit_handle_status(dev_fd(dev),
+				cfg.namespace_id, sizeof(hdr), &hdr);
+		if (err) {
+			nvme_show_status(err);
+			goto out;
+		}
+
+		len = sizeof(*ruhs) + le16_to_cpu(hdr.nruhsd) *
+			sizeof(struct nvme_fdp_ruh_status_desc);
+		ruhs = malloc(len);
+		if (!ruhs) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		err = nvme_fdp_reclaim_unit_handle_status(dev_fd(dev),
+				cfg.namespace_id, len, ruhs);
+		if (err) {
+			nvme_show_status(err);
+			goto out;
+		}
+
+		npids = min(le16_to_cpu(ruhs->nruhsd), (__u16)ARRAY_SIZE(pids));
+		for (i = 0; i < npids; i++)
+			pids[i] = le16_to_cpu(ruhs->ruhss[i].pid);
+	}
+
+	if (!npids) {
+		fprintf(stderr, "no placement identifiers\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	fw.egid = cfg.egid;
+	fw.nr_ruhs = npids;
+	fw.ruhs = calloc(npids, sizeof(*fw.ruhs));
+	if (!fw.ruhs) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < npids; i++)
+		fw.ruhs[i].pid = pids[i];
+
+	struct nvme_io_job job = {
+		.nsid		= cfg.namespace_id,
+		.opcode		= nvme_cmd_write,
+		.slba		= cfg.start_block,
+		.nr_lbas	= cfg.io_range,
+		.nlb		= cfg.block_count,
+		.control	= FDP_DTYPE_DATA_PLACEMENT << 4,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.nr_ios		= cfg.io_count,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
+		.ops		= &fdp_write_ops,
+		.priv		= &fw,
+	};
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns.flbas, &lba_index);
+	job.lba_size = 1 << ns.lbaf[lba_index].ds;
+	ms = ns.lbaf[lba_index].ms;
+	if (ms) {
+		if (NVME_FLBAS_META_EXT(ns.flbas))
+			job.lba_size += ms;
+		else
+			job.ms = ms;
+	}
+	if (!job.nr_lbas) {
+		job.nr_lbas = le64_to_cpu(ns.nsze);
+		if (job.nr_lbas > cfg.start_block)
+			job.nr_lbas -= cfg.start_block;
+	}
+
+	err = nvme_get_log_fdp_stats(dev_fd(dev), cfg.egid, 0, sizeof(before), &before);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		goto out;
+	}
+	job.fd = gfd;
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+	if (err < 0) {
+		fprintf(stderr, "fdp write: %s\n", nvme_strerror(-err));
+		goto out;
+	}
+
+	err = nvme_get_log_fdp_stats(dev_fd(dev), cfg.egid, 0, sizeof(after), &after);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	if (!stats.uring && cfg.queue_depth > 1)
+		fprintf(stderr,
+			"io_uring passthrough not available, ran with queue depth 1\n");
+
+	fw.stats = &stats;
+	fw.hbmw = fdp_stat(after.hbmw) - fdp_stat(before.hbmw);
+	fw.mbmw = fdp_stat(after.mbmw) - fdp_stat(before.mbmw);
+	fw.mbe = fdp_stat(after.mbe) - fdp_stat(before.mbe);
+	nvme_show_fdp_write(&fw, flags);
+	err = stats.errors ? -EIO : 0;
+
+out:
+	if (gfd >= 0)
+		close(gfd);
+	free(fw.ruhs);
+	free(ruhs);
+	dev_close(dev);
+
+	return err;
+}
+
+static int fdp_monitor_read(int fd, __u16 egid, struct nvme_fdp_stats_log *stats,
+			    struct nvme_fdp_ruhu_log *ruhu, size_t ruhu_len,
+			    struct nvme_fdp_sample *s)
+{
+	int err, i;
+
+	err = nvme_get_log_fdp_stats(fd, egid, 0, sizeof(*stats), stats);
+	if (!err)
+		err = nvme_get_log_reclaim_unit_handle_usage(fd, egid, 0,
+							     ruhu_len, ruhu);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("get-log");
+		return err;
+	}
+
+	s->hbmw = fdp_stat(stats->hbmw);
+	s->mbmw = fdp_stat(stats->mbmw);
+	s->mbe = fdp_stat(stats->mbe);
+
+	s->ruh_unused = s->ruh_host = s->ruh_ctrl = 0;
+	for (i = 0; i < le16_to_cpu(ruhu->nruh); i++) {
+		switch (ruhu->ruhus[i].ruha) {
+		case 0x0:
+			s->ruh_unused++;
+			break;
+		case 0x1:
+			s->ruh_host++;
+			break;
+		case 0x2:
+			s->ruh_ctrl++;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int fdp_monitor(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Sample the FDP statistics and reclaim unit handle usage\n"
+		"logs of an endurance group periodically and report the write rates\n"
+		"and the write amplification, one line per sample";
+	const char *egid = "Endurance group identifier";
+	const char *interval = "seconds between samples";
+	const char *count = "number of samples (default: until interrupted)";
+
+	struct nvme_fdp_stats_log stats;
+	struct nvme_fdp_ruhu_log hdr, *ruhu = NULL;
+	struct nvme_fdp_sample first, prev, cur;
+	enum nvme_print_flags flags;
+	struct nvme_dev *dev;
+	__u64 next, now, last, n;
+	struct timespec ts;
+	size_t ruhu_len;
+	double secs;
+	int err;
+
+	struct config {
+		__u16	egid;
+		__u32	interval;
+		__u64	count;
+		char	*output_format;
+	};
+
+	struct config cfg = {
+		.interval	= 1,
+		.output_format	= "normal",
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("endgrp-id",     'e', &cfg.egid,          egid),
+		OPT_UINT("interval",      'i', &cfg.interval,      interval),
+		OPT_SUFFIX("count",       'c', &cfg.count,         count),
+		OPT_FMT("output-format",  'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto out;
+
+	if (!cfg.egid || !cfg.interval) {
+		fprintf(stderr, "endurance group identifier and interval required\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = nvme_get_log_reclaim_unit_handle_usage(dev_fd(dev), cfg.egid, 0,
+						     sizeof(hdr), &hdr);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	ruhu_len = sizeof(hdr) + le16_to_cpu(hdr.nruh) *
+		sizeof(struct nvme_fdp_ruhu_desc);
+	ruhu = malloc(ruhu_len);
+	if (!ruhu) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	memset(&first, 0, sizeof(first));
+	err = fdp_monitor_read(dev_fd(dev), cfg.egid, &stats, ruhu, ruhu_len, &first);
+	if (err)
+		goto out;
+	prev = first;
+
+	nvme_stop_catch(true, NULL);
+
+	/* sample on a fixed schedule so slow log reads don't add up */
+	next = last = monotonic_ns();
+	for (n = 0; !cfg.count || n < cfg.count; n++) {
+		next += cfg.interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
+
+		cur = prev;
+		err = fdp_monitor_read(dev_fd(dev), cfg.egid, &stats, ruhu,
+				       ruhu_len, &cur);
+		if (err)
+			break;
+
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		cur.egid = cfg.egid;
+		cur.timestamp_ms = ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+		cur.interval_ns = now - last;
+		secs = cur.interval_ns / 1e9;
+		cur.host_rate = (cur.hbmw - prev.hbmw) / secs;
+		cur.media_rate = (cur.mbmw - prev.mbmw) / secs;
+		cur.erase_rate = (cur.mbe - prev.mbe) / secs;
+		cur.waf = cur.hbmw > first.hbmw ?
+			(double)(cur.mbmw - first.mbmw) / (cur.hbmw - first.hbmw) : 0;
+		nvme_show_fdp_sample(&cur, flags);
+
+		prev = cur;
+		last = now;
+	}
+
+	nvme_stop_release();
+
+out:
+	free(ruhu);
+	dev_close(dev);
+
+	return err;
+}
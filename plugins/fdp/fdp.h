@@ -16,6 +16,8 @@ PLUGIN(NAME("fdp", "Manage Flexible Data Placement enabled devices", NVME_VERSIO
 		ENTRY("status", "Show reclaim unit handle status", fdp_status)
 		ENTRY("update", "Update a reclaim unit handle", fdp_update)
 		ENTRY("set-events", "Enabled or disable events", fdp_set_events)
+		ENTRY("write", "Write across placement identifiers and report write amplification", fdp_write)
+		ENTRY("monitor", "Sample the FDP statistics and report write rates", fdp_monitor)
 	)
 );
 
@@ -33,6 +33,8 @@
 #include "plugin.h"
 
 #include "util/suffix.h"
+#include "util/table.h"
+#include "util/thread-pool.h"
 
 #define CREATE_CMD
 #include "huawei-nvme.h"
@@ -44,6 +46,8 @@
 #define MIN_ARRAY_NAME_LEN 16
 #define MIN_NS_NAME_LEN 16
 
+#define HW_SCAN_JOBS 16
+
 struct huawei_list_item {
 	char                node[1024];
 	struct nvme_id_ctrl ctrl;
@@ -55,26 +59,15 @@ struct huawei_list_item {
 	bool                huawei_device;
 };
 
-struct huawei_list_element_len {
-	unsigned int node;
-	unsigned int ns_name;
-	unsigned int nguid;
-	unsigned int ns_id;
-	unsigned int usage;
-	unsigned int array_name;
-};
-
-static int huawei_get_nvme_info(int fd, struct huawei_list_item *item, const char *node)
+static int huawei_get_nvme_info(int fd, struct huawei_list_item *item,
+				const struct nvme_id_ctrl *ctrl, const char *node)
 {
 	int err;
 	int len;
 	struct stat nvme_stat_info;
 
 	memset(item, 0, sizeof(*item));
-
-	err = nvme_identify_ctrl(fd, &item->ctrl);
-	if (err)
-		return err;
+	item->ctrl = *ctrl;
 
 	/*identify huawei device*/
 	if (strstr(item->ctrl.mn, "Huawei") == NULL &&
@@ -117,6 +110,131 @@ static int huawei_get_nvme_info(int fd, struct huawei_list_item *item, const cha
 	return 0;
 }
 
+/* identify controller data, read once and shared by all its namespaces */
+struct huawei_ctrl {
+	int                 instance;
+	const char          *node;	/* first namespace of the controller */
+	struct nvme_id_ctrl ctrl;
+	bool                opened;
+	int                 err;
+};
+
+struct huawei_ns {
+	char                    node[264];
+	struct huawei_ctrl      *ctrl;
+	struct huawei_list_item *item;
+	int                     err;
+};
+
+static void huawei_ctrl_work(void *arg)
+{
+	struct huawei_ctrl *c = arg;
+	int fd;
+
+	fd = open(c->node, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open device %s: %s\n",
+			c->node, strerror(errno));
+		return;
+	}
+	c->opened = true;
+	c->err = nvme_identify_ctrl(fd, &c->ctrl);
+	close(fd);
+}
+
+static void huawei_ns_work(void *arg)
+{
+	struct huawei_ns *ns = arg;
+	int fd;
+
+	if (!ns->ctrl->opened)
+		return;
+	if (ns->ctrl->err) {
+		ns->err = ns->ctrl->err;
+		return;
+	}
+
+	fd = open(ns->node, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot open device %s: %s\n",
+			ns->node, strerror(errno));
+		return;
+	}
+	ns->err = huawei_get_nvme_info(fd, ns->item, &ns->ctrl->ctrl, ns->node);
+	close(fd);
+}
+
+static void huawei_run(nvme_work_fn fn, void *args, size_t size, unsigned int nr)
+{
+	struct nvme_thread_pool *pool;
+	unsigned int i;
+
+	pool = nvme_thread_pool_create(min(nr, HW_SCAN_JOBS));
+	for (i = 0; i < nr; i++) {
+		if (!pool || nvme_thread_pool_queue(pool, fn, (char *)args + i * size))
+			fn((char *)args + i * size);
+	}
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+}
+
+/*
+ * Fill in @list_items for the namespaces in @devices. Identify Controller
+ * is sent once per controller, then the namespaces are queried in
+ * parallel. The Huawei devices are moved to the front of @list_items in
+ * the order of @devices and counted in @huawei_num.
+ *
+ * Returns 0 or the error of the first device that failed.
+ */
+static int huawei_get_list_items(struct dirent **devices, unsigned int n,
+				 struct huawei_list_item *list_items,
+				 unsigned int *huawei_num)
+{
+	_cleanup_free_ struct huawei_ctrl *ctrls = NULL;
+	_cleanup_free_ struct huawei_ns *nss = NULL;
+	unsigned int i, j, nr_ctrls = 0;
+	int instance;
+
+	ctrls = calloc(n, sizeof(*ctrls));
+	nss = calloc(n, sizeof(*nss));
+	if (!ctrls || !nss)
+		return -ENOMEM;
+
+	for (i = 0; i < n; i++) {
+		snprintf(nss[i].node, sizeof(nss[i].node), "/dev/%s", devices[i]->d_name);
+		nss[i].item = &list_items[i];
+
+		/* namespaces of the same controller share its instance */
+		if (sscanf(devices[i]->d_name, "nvme%dn", &instance) != 1)
+			instance = -1 - (int)i;
+		for (j = 0; j < nr_ctrls; j++)
+			if (ctrls[j].instance == instance)
+				break;
+		if (j == nr_ctrls) {
+			ctrls[j].instance = instance;
+			ctrls[j].node = nss[i].node;
+			nr_ctrls++;
+		}
+		nss[i].ctrl = &ctrls[j];
+	}
+
+	huawei_run(huawei_ctrl_work, ctrls, sizeof(*ctrls), nr_ctrls);
+	huawei_run(huawei_ns_work, nss, sizeof(*nss), n);
+
+	*huawei_num = 0;
+	for (i = 0; i < n; i++) {
+		if (nss[i].err)
+			return nss[i].err;
+		if (!list_items[i].huawei_device)
+			continue;
+		if (i != *huawei_num)
+			list_items[*huawei_num] = list_items[i];
+		(*huawei_num)++;
+	}
+
+	return 0;
+}
+
 static void format(char *formatter, size_t fmt_sz, char *tofmt, size_t tofmtsz)
 {
 	fmt_sz = snprintf(formatter, fmt_sz, "%-*.*s", (int)tofmtsz, (int)tofmtsz, tofmt);
@@ -178,31 +296,17 @@ static void huawei_json_print_list_items(struct huawei_list_item *list_items,
 	json_free_object(root);
 }
 
-static void huawei_print_list_head(struct huawei_list_element_len element_len)
-{
-	char dash[128];
-	int i;
-
-	for (i = 0; i < 128; i++)
-		dash[i] = '-';
-	dash[127] = '\0';
-
-	printf("%-*.*s %-*.*s %-*.*s %-*.*s %-*.*s %-*.*s\n",
-		element_len.node, element_len.node, "Node",
-		element_len.ns_name, element_len.ns_name, "NS Name",
-		element_len.nguid, element_len.nguid, "Nguid",
-		element_len.ns_id, element_len.ns_id, "NS ID",
-		element_len.usage, element_len.usage, "Usage",
-		element_len.array_name, element_len.array_name, "Array Name");
-
-	printf("%-.*s %-.*s %-.*s %-.*s %-.*s %-.*s\n",
-		element_len.node, dash, element_len.ns_name, dash,
-		element_len.nguid, dash, element_len.ns_id, dash,
-		element_len.usage, dash, element_len.array_name, dash);
-}
+static const struct nvme_table_column huawei_list_cols[] = {
+	{ "Node", 16 },
+	{ "NS Name", MIN_NS_NAME_LEN },
+	{ "Nguid", 33 },
+	{ "NS ID", 9 },
+	{ "Usage", 26 },
+	{ "Array Name", MIN_ARRAY_NAME_LEN },
+};
 
-static void huawei_print_list_item(struct huawei_list_item *list_item,
-				   struct huawei_list_element_len element_len)
+static void huawei_print_list_item(struct nvme_table *t,
+				   struct huawei_list_item *list_item)
 {
 	__u8 lba_index;
 
@@ -214,84 +318,44 @@ static void huawei_print_list_item(struct huawei_list_item *list_item,
 	const char *s_suffix = suffix_si_get(&nsze);
 	const char *u_suffix = suffix_si_get(&nuse);
 
-	char usage[128];
 	char nguid_buf[2 * sizeof(list_item->ns.nguid) + 1];
 	char *nguid = nguid_buf;
 	int i;
 
-	sprintf(usage, "%6.2f %2sB / %6.2f %2sB", nuse, u_suffix, nsze, s_suffix);
-
 	memset(nguid, 0, sizeof(nguid_buf));
 	for (i = 0; i < sizeof(list_item->ns.nguid); i++)
 		nguid += sprintf(nguid, "%02x", list_item->ns.nguid[i]);
 
-	printf("%-*.*s %-*.*s %-*.*s %-*d %-*.*s %-*.*s\n",
-		element_len.node, element_len.node, list_item->node,
-		element_len.ns_name, element_len.ns_name, list_item->ns_name,
-		element_len.nguid, element_len.nguid, nguid_buf,
-		element_len.ns_id, list_item->nsid,
-		element_len.usage, element_len.usage, usage,
-		element_len.array_name, element_len.array_name,
-		list_item->array_name);
-
-}
-
-static unsigned int choose_len(unsigned int old_len, unsigned int cur_len, unsigned int default_len)
-{
-	unsigned int temp_len;
-
-	temp_len = (cur_len > default_len) ? cur_len : default_len;
-	if (temp_len > old_len)
-		return temp_len;
-	return old_len;
+	nvme_table_add(t, list_item->node);
+	nvme_table_add(t, list_item->ns_name);
+	nvme_table_add(t, nguid_buf);
+	nvme_table_addf(t, "%d", list_item->nsid);
+	nvme_table_addf(t, "%6.2f %2sB / %6.2f %2sB", nuse, u_suffix, nsze, s_suffix);
+	nvme_table_add(t, list_item->array_name);
 }
 
-static unsigned int huawei_get_ns_len(struct huawei_list_item *list_items, unsigned int len,
-				      unsigned int default_len)
+static int huawei_print_list_items(struct huawei_list_item *list_items, unsigned int len)
 {
-	int i;
-	unsigned int min_len = default_len;
-
-	for (i = 0 ; i < len ; i++)
-		min_len = choose_len(min_len, strlen(list_items->ns_name), default_len);
-
-	return min_len;
-}
+	struct nvme_table t;
+	unsigned int i;
+	int err;
 
-static int huawei_get_array_len(struct huawei_list_item *list_items, unsigned int len,
-				unsigned int default_len)
-{
-	int i;
-	int min_len = default_len;
+	err = nvme_table_init(&t, huawei_list_cols, ARRAY_SIZE(huawei_list_cols));
+	if (err)
+		return err;
 
 	for (i = 0 ; i < len ; i++)
-		min_len = choose_len(min_len, strlen(list_items->array_name), default_len);
-
-	return min_len;
-}
-
-static void huawei_print_list_items(struct huawei_list_item *list_items, unsigned int len)
-{
-	unsigned int i;
-	struct huawei_list_element_len element_len;
-
-	element_len.node = 16;
-	element_len.nguid = 2 * sizeof(list_items->ns.nguid) + 1;
-	element_len.ns_id = 9;
-	element_len.usage = 26;
-	element_len.ns_name = huawei_get_ns_len(list_items, len, MIN_NS_NAME_LEN);
-	element_len.array_name = huawei_get_array_len(list_items, len, MIN_ARRAY_NAME_LEN);
+		huawei_print_list_item(&t, &list_items[i]);
 
-	huawei_print_list_head(element_len);
+	err = nvme_table_print(&t, stdout);
+	nvme_table_free(&t);
 
-	for (i = 0 ; i < len ; i++)
-		huawei_print_list_item(&list_items[i], element_len);
+	return err;
 }
 
 static int huawei_list(int argc, char **argv, struct command *command,
 		struct plugin *plugin)
 {
-	char path[264];
 	struct dirent **devices;
 	struct huawei_list_item *list_items;
 	unsigned int i, n, ret;
@@ -330,31 +394,15 @@ static int huawei_list(int argc, char **argv, struct command *command,
 		goto out_free_devices;
 	}
 
-	for (i = 0; i < n; i++) {
-		int fd;
-
-		snprintf(path, sizeof(path), "/dev/%s", devices[i]->d_name);
-		fd = open(path, O_RDONLY);
-		if (fd < 0) {
-			fprintf(stderr, "Cannot open device %s: %s\n",
-				path, strerror(errno));
-			continue;
-		}
-		ret = huawei_get_nvme_info(fd, &list_items[huawei_num], path);
-		if (ret) {
-			close(fd);
-			goto out_free_list_items;
-		}
-		if (list_items[huawei_num].huawei_device == true)
-			huawei_num++;
-		close(fd);
-	}
+	ret = huawei_get_list_items(devices, n, list_items, &huawei_num);
+	if (ret)
+		goto out_free_list_items;
 
 	if (huawei_num > 0) {
 		if (fmt == JSON)
 			huawei_json_print_list_items(list_items, huawei_num);
 		else
-			huawei_print_list_items(list_items, huawei_num);
+			ret = huawei_print_list_items(list_items, huawei_num);
 	}
 out_free_list_items:
 	free(list_items);
@@ -86,40 +86,147 @@ static int innogrit_smart_log_additional(int argc, char **argv,
 	return 0;
 }
 
-static int sort_eventlog_fn(const void *a, const void *b)
+#define EVLOG_MAX_EVENTS	(SIZE_16K / sizeof(struct eventlog))
+
+/* runs are ordered by their oldest pending event, earlier runs first on ties */
+static bool evlog_run_before(struct eventlog *ev, unsigned int *pos,
+			     unsigned int a, unsigned int b)
 {
-	const struct eventlog_addindex *l = a;
-	const struct eventlog_addindex *r = b;
-	int rc;
+	if (ev[pos[a]].ms != ev[pos[b]].ms)
+		return ev[pos[a]].ms < ev[pos[b]].ms;
+	return a < b;
+}
 
-	if (l->ms > r->ms) {
-		rc = 1;
-	} else if (l->ms < r->ms) {
-		rc = -1;
-	} else {
-		if (l->iindex < r->iindex)
-			rc = -1;
-		else
-			rc = 1;
+static void evlog_heap_down(struct eventlog *ev, unsigned int *pos,
+			    unsigned int *heap, unsigned int nr, unsigned int i)
+{
+	unsigned int c, tmp;
+
+	while ((c = 2 * i + 1) < nr) {
+		if (c + 1 < nr && evlog_run_before(ev, pos, heap[c + 1], heap[c]))
+			c++;
+		if (!evlog_run_before(ev, pos, heap[c], heap[i]))
+			break;
+		tmp = heap[i];
+		heap[i] = heap[c];
+		heap[c] = tmp;
+		i = c;
 	}
-
-	return rc;
 }
 
+/*
+ * The pages of a flush each come in time order, so sort the events by
+ * merging the runs already in time order. Events of the same time stamp
+ * keep the order of the log.
+ */
 static void sort_eventlog(struct eventlog *data16ksrc, unsigned int icount)
 {
-	struct eventlog_addindex peventlogadd[512];
-	unsigned int i;
+	struct eventlog out[EVLOG_MAX_EVENTS];
+	unsigned int end[EVLOG_MAX_EVENTS], pos[EVLOG_MAX_EVENTS];
+	unsigned int heap[EVLOG_MAX_EVENTS];
+	unsigned int nr = 0, i, r;
+
+	for (i = 0; i < icount; i++) {
+		if (!i || data16ksrc[i].ms < data16ksrc[i - 1].ms)
+			pos[nr++] = i;
+		end[nr - 1] = i + 1;
+	}
+	if (nr < 2)
+		return;
+
+	for (r = 0; r < nr; r++)
+		heap[r] = r;
+	for (r = nr / 2; r-- > 0;)
+		evlog_heap_down(data16ksrc, pos, heap, nr, r);
 
 	for (i = 0; i < icount; i++) {
-		memcpy(&peventlogadd[i], &data16ksrc[i], sizeof(struct eventlog));
-		peventlogadd[i].iindex = i;
+		r = heap[0];
+		out[i] = data16ksrc[pos[r]++];
+		if (pos[r] == end[r])
+			heap[0] = heap[--nr];
+		evlog_heap_down(data16ksrc, pos, heap, nr, 0);
 	}
 
-	qsort(peventlogadd, icount, sizeof(struct eventlog_addindex), sort_eventlog_fn);
+	memcpy(data16ksrc, out, icount * sizeof(*out));
+}
+
+/*
+ * Position of an incremental dump: the newest event written and how many
+ * events of the log carry its time stamp, as they need not all be new.
+ */
+struct evlog_cursor {
+	unsigned int ms;
+	unsigned int nr_ms;
+};
+
+struct evlog_incr {
+	struct evlog_cursor since;	/* of the previous dump */
+	struct evlog_cursor seen;	/* newest event in the log */
+	unsigned int nr_since_ms;	/* events at since.ms met so far */
+};
+
+static int evlog_cursor_load(const char *file, struct evlog_cursor *c)
+{
+	FILE *fp;
+	int n;
+
+	memset(c, 0, sizeof(*c));
+	fp = fopen(file, "r");
+	if (!fp)
+		return errno == ENOENT ? 0 : -errno;
+
+	n = fscanf(fp, "%u %u", &c->ms, &c->nr_ms);
+	fclose(fp);
+
+	return n == 2 ? 0 : -EINVAL;
+}
+
+static int evlog_cursor_save(const char *file, const struct evlog_cursor *c)
+{
+	FILE *fp;
+	int err = 0;
+
+	fp = fopen(file, "w");
+	if (!fp)
+		return -errno;
+
+	if (fprintf(fp, "%u %u\n", c->ms, c->nr_ms) < 0)
+		err = -EIO;
+	if (fclose(fp) && !err)
+		err = -errno;
+
+	return err;
+}
+
+/* drop the events of the previous dump, returns the events left */
+static unsigned int evlog_filter(struct evlog_incr *incr, struct eventlog *ev,
+				 unsigned int icount)
+{
+	unsigned int i, n = 0, max = 0;
 
 	for (i = 0; i < icount; i++)
-		memcpy(&data16ksrc[i], &peventlogadd[i], sizeof(struct eventlog));
+		max = max(max, ev[i].ms);
+	/* most of the flushes of a periodic dump are old ones */
+	if (max < incr->since.ms)
+		return 0;
+
+	for (i = 0; i < icount; i++) {
+		if (ev[i].ms > incr->seen.ms) {
+			incr->seen.ms = ev[i].ms;
+			incr->seen.nr_ms = 1;
+		} else if (ev[i].ms == incr->seen.ms) {
+			incr->seen.nr_ms++;
+		}
+
+		if (ev[i].ms < incr->since.ms)
+			continue;
+		if (ev[i].ms == incr->since.ms &&
+		    incr->nr_since_ms++ < incr->since.nr_ms)
+			continue;
+		ev[n++] = ev[i];
+	}
+
+	return n;
 }
 
 static unsigned char setfilecontent(char *filenamea, unsigned char *buffer,
@@ -138,6 +245,23 @@ static unsigned char setfilecontent(char *filenamea, unsigned char *buffer,
 	return true;
 }
 
+/* sort a flush of events, header first, and append it to the dump */
+static void evlog_write_flush(char *filename, unsigned char *data16k,
+			      unsigned int len, struct evlog_incr *incr)
+{
+	struct eventlog *ev = (struct eventlog *)(data16k + sizeof(struct evlg_flush_hdr));
+	unsigned int icount = (len - sizeof(struct evlg_flush_hdr)) / sizeof(*ev);
+
+	if (incr) {
+		icount = evlog_filter(incr, ev, icount);
+		if (!icount)
+			return;
+	}
+
+	sort_eventlog(ev, icount);
+	setfilecontent(filename, data16k, sizeof(struct evlg_flush_hdr) + icount * sizeof(*ev));
+}
+
 static int nvme_vucmd(int fd, unsigned char opcode, unsigned int cdw12,
 		      unsigned int cdw13, unsigned int cdw14,
 		      unsigned int cdw15, char *data, int data_len)
@@ -173,19 +297,24 @@ static int innogrit_vsc_geteventlog(int argc, char **argv,
 	struct evlg_flush_hdr *pevlog = (struct evlg_flush_hdr *)data;
 	const char *desc = "Recrieve event log for the given device ";
 	const char *clean_opt = "(optional) 1 for clean event log";
+	const char *since_opt = "(optional) file keeping the newest event dumped, only newer events are dumped";
+	struct evlog_incr incr = { 0 }, *pincr = NULL;
 	struct nvme_dev *dev;
 	int ret = -1;
 
 	struct config {
 		__u32 clean_flg;
+		char *since_file;
 	};
 
 	struct config cfg = {
 		.clean_flg = 0,
+		.since_file = NULL,
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("clean_flg",   'c', &cfg.clean_flg,   clean_opt),
+		OPT_FILE("since",       's', &cfg.since_file,  since_opt),
 		OPT_END()
 	};
 
@@ -193,6 +322,15 @@ static int innogrit_vsc_geteventlog(int argc, char **argv,
 	if (ret)
 		return ret;
 
+	if (cfg.since_file) {
+		ret = evlog_cursor_load(cfg.since_file, &incr.since);
+		if (ret) {
+			nvme_show_error("%s: %s", cfg.since_file, nvme_strerror(-ret));
+			dev_close(dev);
+			return ret;
+		}
+		pincr = &incr;
+	}
 
 	if (getcwd(currentdir, 128) == NULL)
 		return -1;
@@ -274,9 +412,7 @@ static int innogrit_vsc_geteventlog(int argc, char **argv,
 
 				iblock++;
 				if (iblock == 4) {
-					sort_eventlog((struct eventlog *)(data16k + sizeof(struct evlg_flush_hdr)),
-						(ioffset16k - sizeof(struct evlg_flush_hdr))/sizeof(struct eventlog));
-					setfilecontent(filename, data16k, ioffset16k);
+					evlog_write_flush(filename, data16k, ioffset16k, pincr);
 					ioffset16k = 0;
 					iblock = 0;
 					memset(data16k, 0, SIZE_16K);
@@ -289,13 +425,13 @@ static int innogrit_vsc_geteventlog(int argc, char **argv,
 	}
 
 	if (bSortLog) {
-		if (ioffset16k > 0) {
-			sort_eventlog((struct eventlog *)(data16k + sizeof(struct evlg_flush_hdr)),
-				(ioffset16k - sizeof(struct evlg_flush_hdr))/sizeof(struct eventlog));
-			setfilecontent(filename, data16k, ioffset16k);
-		}
+		if (ioffset16k > 0)
+			evlog_write_flush(filename, data16k, ioffset16k, pincr);
 	}
 
+	if (pincr && !bSortLog)
+		printf("\r" XCLEAN_LINE "Event log isn't sorted, --since dumped all of it\n");
+
 	printf("\r" XCLEAN_LINE "Dump eventLog finish to %s\n", filename);
 	chmod(filename, 0666);
 
@@ -306,6 +442,18 @@ static int innogrit_vsc_geteventlog(int argc, char **argv,
 			   (SRB_SIGNATURE & 0xFFFFFFFF), (char *)NULL, 0);
 	}
 
+	if (pincr && bSortLog) {
+		/* nothing newer than the previous dump keeps its cursor */
+		if (incr.seen.ms > incr.since.ms ||
+		    (incr.seen.ms == incr.since.ms && incr.seen.nr_ms > incr.since.nr_ms))
+			incr.since = incr.seen;
+		if (cfg.clean_flg == 1)
+			memset(&incr.since, 0, sizeof(incr.since));
+		ret = evlog_cursor_save(cfg.since_file, &incr.since);
+		if (ret)
+			nvme_show_error("%s: %s", cfg.since_file, nvme_strerror(-ret));
+	}
+
 	dev_close(dev);
 
 	return ret;
@@ -27,12 +27,6 @@ struct eventlog {
 	unsigned int param[7];
 };
 
-struct eventlog_addindex {
-	unsigned int ms;
-	unsigned int param[7];
-	unsigned int iindex;
-};
-
 #pragma pack(push)
 #pragma pack(1)
 struct vsc_smart_log {
@@ -12,6 +12,8 @@
 #include "plugin.h"
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "util/stream.h"
+#include "util/thread-pool.h"
 
 #define CREATE_CMD
 #include "intel-nvme.h"
@@ -1129,6 +1131,120 @@ close_dev:
 	return err;
 }
 
+#define INTEL_VID		0x8086
+
+/* the 3.0 linear ranges, without the trailing nonzero-only groups */
+static void lat_stats_hist_3_0(const struct intel_lat_stats *stats, struct nvme_lat_hist *h)
+{
+	static const struct {
+		int first, last;
+		__u32 us_step;
+	} ranges[] = {
+		{ 0, 31, 32 },
+		{ 32, 62, 1024 },
+		{ 63, 93, 32768 },
+	};
+	unsigned int r;
+	int i;
+
+	for (r = 0; r < ARRAY_SIZE(ranges); r++)
+		for (i = ranges[r].first; i <= ranges[r].last; i++)
+			nvme_lat_hist_add_bucket(h, ranges[r].us_step * i,
+						 ranges[r].us_step * (i + 1),
+						 le32_to_cpu(stats->data[i]));
+}
+
+static void lat_stats_hist_4_0(const struct intel_lat_stats *stats, struct nvme_lat_hist *h)
+{
+	int i, max = ARRAY_SIZE(stats->data);
+
+	for (i = 0; i < max; i++)
+		nvme_lat_hist_add_bucket(h, lat_stats_log_scale(i),
+					 i < max - 1 ? lat_stats_log_scale(i + 1) :
+					 NVME_LAT_HIST_INF,
+					 le32_to_cpu(stats->data[i]));
+}
+
+/* the Optane counters are cleared on each read, the thresholds are a feature */
+static int lat_stats_hist_v1000_0(struct nvme_dev *dev, const struct optane_lat_stats *stats,
+				  bool write, struct nvme_lat_hist *h)
+{
+	__u32 thresholds[OPTANE_V1000_BUCKET_LEN] = { 0 };
+	__u32 result;
+	int i, err;
+
+	struct nvme_get_features_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.fid		= 0xf7,
+		.cdw11		= write ? 0x1 : 0x0,
+		.data_len	= sizeof(thresholds),
+		.data		= thresholds,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result		= &result,
+	};
+
+	err = nvme_get_features(&args);
+	if (err)
+		return err < 0 ? -errno : err;
+
+	nvme_lat_hist_init(h, NVME_LAT_HIST_CLEAR_ON_READ);
+	for (i = 0; i < OPTANE_V1000_BUCKET_LEN; i++)
+		nvme_lat_hist_add_bucket(h, thresholds[i],
+					 i < OPTANE_V1000_BUCKET_LEN - 1 ? thresholds[i + 1] :
+					 NVME_LAT_HIST_INF,
+					 le64_to_cpu(stats->data[i]));
+
+	return 0;
+}
+
+static int intel_lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+				 enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	_cleanup_free_ __u8 *data = NULL;
+	struct intel_lat_stats *lat;
+	__u16 maj, min;
+	int err;
+
+	if (le16_to_cpu(ctrl->vid) != INTEL_VID ||
+	    (type != NVME_LAT_READ && type != NVME_LAT_WRITE))
+		return -ENOTSUP;
+
+	data = nvme_alloc(NAND_LAT_STATS_LEN);
+	if (!data)
+		return -ENOMEM;
+
+	err = nvme_get_log_simple(dev_fd(dev), type == NVME_LAT_WRITE ? 0xc2 : 0xc1,
+				  NAND_LAT_STATS_LEN, data);
+	if (err)
+		return err < 0 ? -errno : err;
+
+	lat = (struct intel_lat_stats *)data;
+	maj = le16_to_cpu(lat->maj);
+	min = le16_to_cpu(lat->min);
+
+	if (maj == 1000 && !min)
+		return lat_stats_hist_v1000_0(dev, (struct optane_lat_stats *)data,
+					      type == NVME_LAT_WRITE, h);
+
+	nvme_lat_hist_init(h, 0);
+	if (maj == 3)
+		lat_stats_hist_3_0(lat, h);
+	else if (maj == 4 && min <= 6)
+		lat_stats_hist_4_0(lat, h);
+	else
+		return -ENOTSUP;
+
+	return 0;
+}
+
+static struct nvme_lat_source intel_lat_source = {
+	.name = "intel",
+	.read = intel_lat_source_read,
+};
+
+NVME_LAT_SOURCE(intel_lat_source)
+
 struct intel_assert_dump {
 	__u32 coreoffset;
 	__u32 assertsize;
@@ -1226,39 +1342,125 @@ static void print_intel_nlog(struct intel_vu_nlog *intel_nlog)
 	       intel_nlog->nlogbufnummax, intel_nlog->coreselected);
 }
 
+/* where the log goes: a file, or memory while capturing concurrently */
+struct intel_log_out {
+	int fd;
+	__u8 *data;
+	size_t len;
+	size_t size;
+};
+
+static void *intel_log_reserve(struct intel_log_out *out, size_t len)
+{
+	size_t size = out->size ? out->size : 0x10000;
+	__u8 *data;
+
+	while (size < out->len + len)
+		size *= 2;
+	if (size != out->size) {
+		data = realloc(out->data, size);
+		if (!data)
+			return NULL;
+		out->data = data;
+		out->size = size;
+	}
+
+	return out->data + out->len;
+}
+
+static int intel_log_write(struct intel_log_out *out, const void *buf, size_t len)
+{
+	void *p;
+
+	if (out->fd >= 0)
+		return write(out->fd, buf, len) < 0 ? -errno : 0;
+
+	p = intel_log_reserve(out, len);
+	if (!p)
+		return -ENOMEM;
+	memcpy(p, buf, len);
+	out->len += len;
+
+	return 0;
+}
+
+static int intel_log_submit(struct nvme_passthru_cmd *cmd, int ioctl_fd, int total_size)
+{
+	int err;
+
+	err = nvme_submit_admin_passthru(ioctl_fd, cmd, NULL);
+	if (err)
+		fprintf(stderr,
+			"failed on cmd.data_len %u cmd.cdw13 %u cmd.cdw12 %x cmd.cdw10 %u err %x remaining size %d\n",
+			cmd->data_len, cmd->cdw13, cmd->cdw12,
+			cmd->cdw10, err, total_size);
+
+	return err;
+}
+
+/*
+ * Read @total_size dwords from the offset in cdw13 in commands of at most
+ * @max_tfer dwords. Into a file, the chunks go through a ring of buffers
+ * that a helper thread writes while the next command is in flight; in
+ * memory, each command reads into its place in the buffer; without @out,
+ * into @buf.
+ */
 static int read_entire_cmd(struct nvme_passthru_cmd *cmd, int total_size,
-			   const size_t max_tfer, int out_fd, int ioctl_fd,
+			   const size_t max_tfer, struct intel_log_out *out, int ioctl_fd,
 			   __u8 *buf)
 {
-	int err = 0;
-	size_t dword_tfer = 0;
+	__u64 addr = cmd->addr;
+	struct nvme_stream s;
+	int err = 0, serr;
+	size_t len;
+	void *data;
+
+	if (out && out->fd >= 0 && total_size > 0) {
+		err = nvme_stream_init(&s, out->fd, NVME_STREAM_TO_FILE,
+				       (__u64)total_size * 4, max_tfer * 4, 4);
+		if (err)
+			return err;
 
-	dword_tfer = min(max_tfer, total_size);
-	while (total_size > 0) {
-		err = nvme_submit_admin_passthru(ioctl_fd, cmd, NULL);
-		if (err) {
-			fprintf(stderr,
-				"failed on cmd.data_len %u cmd.cdw13 %u cmd.cdw12 %x cmd.cdw10 %u err %x remaining size %d\n",
-				cmd->data_len, cmd->cdw13, cmd->cdw12,
-				cmd->cdw10, err, total_size);
-			goto out;
+		while ((data = nvme_stream_get(&s, &len))) {
+			cmd->cdw10 = len / 4;
+			cmd->data_len = len;
+			cmd->addr = (unsigned long)data;
+			err = intel_log_submit(cmd, ioctl_fd, total_size);
+			if (err)
+				break;
+			nvme_stream_put(&s, len);
+			cmd->cdw13 += len / 4;
+			total_size -= len / 4;
 		}
 
-		if (out_fd > 0) {
-			err = write(out_fd, buf, cmd->data_len);
-			if (err < 0) {
-				perror("write failure");
-				goto out;
-			}
-			err = 0;
+		serr = nvme_stream_finish(&s, err != 0);
+		if (!err && serr) {
+			fprintf(stderr, "write failure: %s\n", strerror(-serr));
+			err = serr;
 		}
-		total_size -= dword_tfer;
-		cmd->cdw13 += dword_tfer;
-		cmd->cdw10 = dword_tfer = min(max_tfer, total_size);
-		cmd->data_len = (min(max_tfer, total_size)) * 4;
+		cmd->addr = addr;
+		return err;
 	}
 
- out:
+	while (total_size > 0) {
+		len = min(max_tfer, (size_t)total_size) * 4;
+		data = out ? intel_log_reserve(out, len) : buf;
+		if (!data)
+			return -ENOMEM;
+
+		cmd->cdw10 = len / 4;
+		cmd->data_len = len;
+		cmd->addr = (unsigned long)data;
+		err = intel_log_submit(cmd, ioctl_fd, total_size);
+		if (err)
+			break;
+		if (out)
+			out->len += len;
+		cmd->cdw13 += len / 4;
+		total_size -= len / 4;
+	}
+
+	cmd->addr = addr;
 	return err;
 }
 
@@ -1280,7 +1482,7 @@ static int read_header(struct nvme_passthru_cmd *cmd, __u8 *buf, int ioctl_fd,
 	cmd->cdw12 = dw12;
 	cmd->data_len = 0x1000;
 	cmd->addr = (unsigned long)(void *)buf;
-	return read_entire_cmd(cmd, 0x400, 0x400, -1, ioctl_fd, buf);
+	return read_entire_cmd(cmd, 0x400, 0x400, NULL, ioctl_fd, buf);
 }
 
 static int setup_file(char *f, char *file, int fd, int type)
@@ -1307,10 +1509,10 @@ static int setup_file(char *f, char *file, int fd, int type)
 static int get_internal_log_old(__u8 *buf, int output, int fd,
 				struct nvme_passthru_cmd *cmd)
 {
+	struct intel_log_out out = { .fd = output };
 	struct intel_vu_log *intel;
 	int err = 0;
 	const int dwmax = 0x400;
-	const int dmamax = 0x1000;
 
 	intel = (struct intel_vu_log *)buf;
 
@@ -1324,9 +1526,7 @@ static int get_internal_log_old(__u8 *buf, int output, int fd,
 	}
 	intel->size -= 0x400;
 	cmd->opcode = 0xd2;
-	cmd->cdw10 = min(dwmax, intel->size);
-	cmd->data_len = min(dmamax, intel->size);
-	err = read_entire_cmd(cmd, intel->size, dwmax, output, fd, buf);
+	err = read_entire_cmd(cmd, intel->size, dwmax, &out, fd, buf);
 	if (err)
 		goto out;
 
@@ -1335,19 +1535,105 @@ static int get_internal_log_old(__u8 *buf, int output, int fd,
 	return err;
 }
 
+#define INTEL_LOG_JOBS		4
+
+/* the data of one nlog, event dump or assert dump of a core */
+struct intel_log_item {
+	int fd;
+	__u32 nsid;
+	__u32 log;
+	__u32 cdw12;
+	__u32 offset;
+	__u32 size;
+	struct intel_vu_nlog nlog;
+	struct intel_log_out out;
+	int err;
+};
+
+static int intel_log_item_read(struct intel_log_item *it)
+{
+	struct nvme_passthru_cmd cmd;
+	__u8 buf[0x1000];
+	int err;
+
+	if (it->log != 0) {
+		memset(&cmd, 0, sizeof(cmd));
+		cmd.opcode = 0xd2;
+		cmd.nsid = it->nsid;
+		cmd.cdw12 = it->cdw12;
+		cmd.cdw13 = it->offset;
+		return read_entire_cmd(&cmd, it->size, 0x400, &it->out, it->fd, buf);
+	}
+
+	/* each nlog comes with its own header */
+	err = read_header(&cmd, buf, it->fd, it->cdw12, it->nsid);
+	if (err)
+		return err;
+	memcpy(&it->nlog, buf, sizeof(it->nlog));
+	err = intel_log_write(&it->out, buf, sizeof(it->nlog));
+	if (err)
+		return err;
+
+	cmd.cdw13 = 0x400;
+	return read_entire_cmd(&cmd, it->nlog.nlogbytesize / 4, 0x400, &it->out, it->fd, buf);
+}
+
+static void intel_log_item_work(void *arg)
+{
+	struct intel_log_item *it = arg;
+
+	it->err = intel_log_item_read(it);
+}
+
+/*
+ * --all: read the items concurrently into memory, then write them in the
+ * order of a sequential capture.
+ */
+static int intel_log_items_concurrent(struct intel_log_item *items, int nr, int output,
+				      bool verbose)
+{
+	struct nvme_thread_pool *pool;
+	int i, err = 0;
+
+	pool = nvme_thread_pool_create(min(nr, INTEL_LOG_JOBS));
+	for (i = 0; i < nr; i++) {
+		items[i].out.fd = -1;
+		if (!pool || nvme_thread_pool_queue(pool, intel_log_item_work, &items[i]))
+			intel_log_item_work(&items[i]);
+	}
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+
+	for (i = 0; i < nr; i++) {
+		if (!err)
+			err = items[i].err;
+		if (!err && verbose && items[i].log == 0)
+			print_intel_nlog(&items[i].nlog);
+		if (!err && write(output, items[i].out.data, items[i].out.len) < 0) {
+			perror("write failure");
+			err = -errno;
+		}
+		free(items[i].out.data);
+	}
+
+	return err;
+}
+
 static int get_internal_log(int argc, char **argv, struct command *command,
 				struct plugin *plugin)
 {
 	__u8 buf[0x2000];
 	char f[0x100];
-	int err, output, i, j, count = 0, core_num = 1;
+	int err, output, i, j, nr = 0, count = 0, core_num = 1;
 	struct nvme_passthru_cmd cmd;
 	struct intel_cd_log cdlog;
 	struct intel_vu_log *intel = malloc(sizeof(struct intel_vu_log));
 	struct intel_vu_nlog *intel_nlog = (struct intel_vu_nlog *)buf;
 	struct intel_assert_dump *ad = (struct intel_assert_dump *) intel->reserved;
 	struct intel_event_header *ehdr = (struct intel_event_header *)intel->reserved;
+	_cleanup_free_ struct intel_log_item *items = NULL;
 	struct nvme_dev *dev;
+	__u32 cdw12;
 
 	const char *desc = "Get Intel Firmware Log and save it.";
 	const char *log = "Log type: 0, 1, or 2 for nlog, event log, and assert log, respectively.";
@@ -1356,6 +1642,7 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 	const char *file = "Output file; defaults to device name provided";
 	const char *verbose = "To print out verbose nlog info";
 	const char *namespace_id = "Namespace to get logs from";
+	const char *all = "Capture all the regions, reading them concurrently";
 
 	struct config {
 		__u32 namespace_id;
@@ -1364,6 +1651,7 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 		int lnum;
 		char *file;
 		bool verbose;
+		bool all;
 	};
 
 	struct config cfg = {
@@ -1380,6 +1668,7 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
 		OPT_FILE("output-file",  'o', &cfg.file,         file),
 		OPT_FLAG("verbose-nlog", 'v', &cfg.verbose,      verbose),
+		OPT_FLAG("all",          'a', &cfg.all,          all),
 		OPT_END()
 	};
 
@@ -1389,7 +1678,7 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 		return err;
 	}
 
-	if (cfg.log > 2 || cfg.core > 4 || cfg.lnum > 255) {
+	if (cfg.log > 2 || cfg.core > 4 || cfg.lnum > 255 || (cfg.all && cfg.core >= 0)) {
 		err = -EINVAL;
 		goto out_free;
 	}
@@ -1418,6 +1707,8 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 	if (err)
 		goto out;
 	memcpy(intel, buf, sizeof(*intel));
+	/* the event and assert dumps are read with the selection of the header */
+	cdw12 = cdlog.u.entireDword;
 
 	/* for 1.1 Fultondales will use old nlog, but current assert/event */
 	if ((intel->ver.major < 1 && intel->ver.minor < 1) ||
@@ -1455,61 +1746,54 @@ static int get_internal_log(int argc, char **argv, struct command *command,
 			goto out;
 	}
 
+	items = calloc((size_t)max(core_num, 1) * max(count, 1), sizeof(*items));
+	if (!items) {
+		err = -ENOMEM;
+		goto out;
+	}
+
 	for (j = (cfg.core < 0 ? 0 : cfg.core);
 			j < (cfg.core < 0 ? core_num : cfg.core + 1);
 			j++) {
 		cdlog.u.fields.selectCore = j;
 		for (i = 0; i < count; i++) {
+			struct intel_log_item *it = &items[nr];
+
+			it->fd = dev_fd(dev);
+			it->nsid = cfg.namespace_id;
+			it->log = cfg.log;
+			it->cdw12 = cdw12;
+			it->out.fd = output;
 			if (cfg.log == 2) {
 				if (!ad[i].assertvalid)
 					continue;
-				cmd.cdw13 = ad[i].coreoffset;
-				cmd.cdw10 = 0x400;
-				cmd.data_len = min(0x400, ad[i].assertsize) * 4;
-				err = read_entire_cmd(&cmd, ad[i].assertsize,
-						      0x400, output,
-						      dev_fd(dev),
-						      buf);
-				if (err)
-					goto out;
-
+				it->offset = ad[i].coreoffset;
+				it->size = ad[i].assertsize;
 			} else if (cfg.log == 0) {
 				/* If the user selected to read the entire nlog */
 				if (count > 1)
 					cdlog.u.fields.selectNlog = i;
-
-				err = read_header(&cmd, buf, dev_fd(dev),
-						  cdlog.u.entireDword,
-						  cfg.namespace_id);
-				if (err)
-					goto out;
-				err = write_header(buf, output, sizeof(*intel_nlog));
-				if (err)
-					goto out;
-				if (cfg.verbose)
-					print_intel_nlog(intel_nlog);
-				cmd.cdw13 = 0x400;
-				cmd.cdw10 = 0x400;
-				cmd.data_len = min(0x1000, intel_nlog->nlogbytesize);
-				err = read_entire_cmd(&cmd, intel_nlog->nlogbytesize / 4,
-						      0x400, output,
-						      dev_fd(dev),
-						      buf);
-				if (err)
-					goto out;
+				it->cdw12 = cdlog.u.entireDword;
 			} else if (cfg.log == 1) {
-				cmd.cdw13 = ehdr->edumps[j].coreoffset;
-				cmd.cdw10 = 0x400;
-				cmd.data_len = 0x400;
-				err = read_entire_cmd(&cmd, ehdr->edumps[j].coresize,
-						      0x400, output,
-						      dev_fd(dev),
-						      buf);
-				if (err)
-					goto out;
+				it->offset = ehdr->edumps[j].coreoffset;
+				it->size = ehdr->edumps[j].coresize;
 			}
+			nr++;
 		}
 	}
+
+	if (cfg.all) {
+		err = intel_log_items_concurrent(items, nr, output, cfg.verbose);
+		goto out;
+	}
+
+	for (i = 0; i < nr; i++) {
+		err = intel_log_item_read(&items[i]);
+		if (err)
+			goto out;
+		if (cfg.verbose && cfg.log == 0)
+			print_intel_nlog(&items[i].nlog);
+	}
 	err = 0;
 out:
 	if (err > 0) {
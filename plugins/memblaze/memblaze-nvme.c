@@ -6,6 +6,8 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
+#include <signal.h>
+#include <stddef.h>
 
 #include "nvme.h"
 #include "common.h"
@@ -13,6 +15,7 @@
 #include "plugin.h"
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "util/interval.h"
 
 #define CREATE_CMD
 #include "memblaze-nvme.h"
@@ -1954,6 +1957,55 @@ static void latency_stats_print(struct latency_stats *log, const char *devname)
 	}
 }
 
+#define MEMBLAZE_VID	0x1c5f
+
+/* the bucket edges of the 2.0 revision, as printed above */
+static const __u32 latency_stats_v2_0_us[33] = {
+	0, 50, 100, 150, 200, 300, 400, 500, 600, 700, 800, 900,
+	1000, 5000, 10000, 20000, 50000, 100000, 200000, 300000, 400000,
+	500000, 600000, 700000, 800000, 900000, 1000000, 2000000, 3000000,
+	4000000, 5000000, 8000000, NVME_LAT_HIST_INF,
+};
+
+static int memblaze_lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+				    enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	struct latency_stats log = { 0 };
+	__u64 count;
+	int i, err;
+
+	if (le16_to_cpu(ctrl->vid) != MEMBLAZE_VID)
+		return -ENOTSUP;
+
+	err = nvme_get_log_simple(dev_fd(dev), LID_LATENCY_STATISTICS, sizeof(log), &log);
+	if (err)
+		return err < 0 ? -errno : err;
+	if (log.v2_0.major_version != 2 || log.v2_0.minor_version)
+		return -ENOTSUP;
+
+	nvme_lat_hist_init(h, 0);
+	for (i = 0; i < ARRAY_SIZE(log.v2_0.bucket_read_data); i++) {
+		count = 0;
+		if (type == NVME_LAT_READ || type == NVME_LAT_ALL)
+			count += log.v2_0.bucket_read_data[i];
+		if (type == NVME_LAT_WRITE || type == NVME_LAT_ALL)
+			count += log.v2_0.bucket_write_data[i];
+		if (type == NVME_LAT_TRIM || type == NVME_LAT_ALL)
+			count += log.v2_0.bucket_trim_data[i];
+		nvme_lat_hist_add_bucket(h, latency_stats_v2_0_us[i],
+					 latency_stats_v2_0_us[i + 1], count);
+	}
+
+	return 0;
+}
+
+static struct nvme_lat_source memblaze_lat_source = {
+	.name = "memblaze",
+	.read = memblaze_lat_source_read,
+};
+
+NVME_LAT_SOURCE(memblaze_lat_source)
+
 static int mb_get_latency_stats(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	// Get the configuration
@@ -2059,6 +2111,120 @@ static void high_latency_log_print(struct high_latency_log *log, const char *dev
 	}
 }
 
+/* entries read per command while tailing, 4 KiB */
+#define HIGH_LATENCY_TAIL_ENTRIES	64
+
+static int high_latency_log_read(int fd, __u32 first, __u32 nr,
+				 struct high_latency_log_entry *entries)
+{
+	struct nvme_get_log_args args = {
+		.args_size	= sizeof(args),
+		.fd		= fd,
+		.lid		= LID_HIGH_LATENCY_LOG,
+		.nsid		= NVME_NSID_ALL,
+		.lpo		= offsetof(struct high_latency_log, v1.entries[first]),
+		.csi		= NVME_CSI_NVM,
+		.len		= nr * sizeof(*entries),
+		.log		= entries,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	};
+
+	return nvme_get_log(&args);
+}
+
+static void high_latency_entry_json(const struct high_latency_log_entry *e)
+{
+	struct json_object *r = json_create_object();
+
+	json_object_add_value_uint64(r, "timestamp_ms", e->timestamp);
+	json_object_add_value_uint(r, "latency_us", e->latency);
+	json_object_add_value_uint(r, "qid", e->qid);
+	json_object_add_value_uint(r, "opcode", e->opcode);
+	json_object_add_value_uint(r, "cid", e->cid);
+	json_object_add_value_uint(r, "nsid", e->nsid);
+	json_object_add_value_uint64(r, "slba", e->slba);
+	json_object_add_value_uint(r, "nlb", e->nlb);
+	json_object_add_value_uint(r, "fua", e->fua);
+	util_json_write_record(stdout, r, true);
+}
+
+#define HIGH_LATENCY_LOG_ENTRIES	1024
+
+/*
+ * Print the entries added after the @nr ones seen so far, reading from the
+ * last one seen to check it is still there; if it is not, the log was
+ * cleared and is read again from the start.
+ */
+static int high_latency_tail_scan(int fd, __u32 *nr, __u64 *last_ts,
+				  struct high_latency_log_entry *chunk)
+{
+	__u32 first, i, n;
+	bool check;
+	int err;
+
+restart:
+	check = *nr > 0;
+	first = check ? *nr - 1 : 0;
+	while (first < HIGH_LATENCY_LOG_ENTRIES) {
+		n = min(HIGH_LATENCY_LOG_ENTRIES - first, HIGH_LATENCY_TAIL_ENTRIES);
+		err = high_latency_log_read(fd, first, n, chunk);
+		if (err)
+			return err < 0 ? -errno : err;
+
+		for (i = 0; i < n; i++, first++) {
+			if (check) {
+				check = false;
+				if (chunk[i].timestamp != *last_ts) {
+					*nr = 0;
+					goto restart;
+				}
+				continue;
+			}
+			if (!chunk[i].timestamp)
+				return 0;
+			high_latency_entry_json(&chunk[i]);
+			*last_ts = chunk[i].timestamp;
+			*nr = first + 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * --interval: keep the device open and print the entries added to the log
+ * between two reads as JSON lines, only reading the entries after the last
+ * one seen.
+ */
+static int high_latency_log_tail(int fd, const struct high_latency_log *log, __u32 interval,
+				 __u32 count)
+{
+	struct high_latency_log_entry chunk[HIGH_LATENCY_TAIL_ENTRIES];
+	__u64 next, now, last_ts = 0;
+	__u32 n, nr = 0;
+	int err = 0;
+
+	while (nr < HIGH_LATENCY_LOG_ENTRIES && log->v1.entries[nr].timestamp)
+		last_ts = log->v1.entries[nr++].timestamp;
+
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
+
+		err = high_latency_tail_scan(fd, &nr, &last_ts, chunk);
+		fflush(stdout);
+		if (err)
+			break;
+	}
+
+	nvme_stop_release();
+	return err;
+}
+
 static int mb_get_high_latency_log(int argc, char **argv, struct command *cmd,
 				   struct plugin *plugin)
 {
@@ -2066,6 +2232,8 @@ static int mb_get_high_latency_log(int argc, char **argv, struct command *cmd,
 
 	struct config {
 		bool raw_binary;
+		__u32 interval;
+		__u32 count;
 	};
 
 	struct config cfg = {0};
@@ -2075,6 +2243,14 @@ static int mb_get_high_latency_log(int argc, char **argv, struct command *cmd,
 			'b',
 			&cfg.raw_binary,
 			"dump the whole log buffer in binary format"),
+		OPT_UINT("interval",
+			'i',
+			&cfg.interval,
+			"keep reading the log every <interval> seconds, print the new entries as JSON lines"),
+		OPT_UINT("count",
+			'c',
+			&cfg.count,
+			"number of reads with --interval, default until interrupted"),
 		OPT_END()};
 
 	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
@@ -2084,13 +2260,28 @@ static int mb_get_high_latency_log(int argc, char **argv, struct command *cmd,
 	if (err)
 		return err;
 
+	if (cfg.interval && cfg.raw_binary) {
+		nvme_show_error("--interval doesn't support binary output");
+		return -EINVAL;
+	}
+
 	// Get log
 
 	struct high_latency_log log = {0};
 
 	err = nvme_get_log_simple(dev_fd(dev), LID_HIGH_LATENCY_LOG,
 				  sizeof(struct high_latency_log), &log);
-	if (!err) {
+	if (!err && cfg.interval) {
+		if (log.v1.version != 1) {
+			nvme_show_error("Version %u: Not supported yet", log.v1.version);
+			return -EINVAL;
+		}
+		err = high_latency_log_tail(dev_fd(dev), &log, cfg.interval, cfg.count);
+		if (err > 0)
+			nvme_show_status(err);
+		else if (err < 0)
+			nvme_show_error("%s: %s", cmd->name, nvme_strerror(-err));
+	} else if (!err) {
 		if (!cfg.raw_binary)
 			high_latency_log_print(&log, dev->name);
 		else
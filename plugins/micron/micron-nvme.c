@@ -9,6 +9,7 @@
 #include <time.h>
 #include <string.h>
 #include <libgen.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include "common.h"
 #include "nvme.h"
@@ -16,7 +17,10 @@
 #include <limits.h>
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "util/interval.h"
 #include "util/cleanup.h"
+#include "util/tar.h"
+#include "util/thread-pool.h"
 
 #define CREATE_CMD
 #include "micron-nvme.h"
@@ -77,12 +81,20 @@ struct LogPageHeader_t {
 	unsigned int numDwordsInEntireLogPage;
 };
 
+/* while set, WriteData() adds the files to this archive instead */
+static struct nvme_tar *debug_tar;
+
 static void WriteData(__u8 *data, __u32 len, const char *dir, const char *file, const char *msg)
 {
 	char tempFolder[8192] = { 0 };
 	FILE *fpOutFile = NULL;
 
 	sprintf(tempFolder, "%s/%s", dir, file);
+	if (debug_tar) {
+		if (nvme_tar_add(debug_tar, tempFolder, data, len))
+			printf("Failed to write %s data to %s\n", msg, tempFolder);
+		return;
+	}
 	fpOutFile = fopen(tempFolder, "ab+");
 	if (fpOutFile) {
 		if (fwrite(data, 1, len,  fpOutFile) != len)
@@ -204,9 +216,10 @@ static int ZipAndRemoveDir(char *strDirName, char *strFileName)
 	return err;
 }
 
+/* with bCreate false only the names are set up, for an in-process archive */
 static int SetupDebugDataDirectories(char *strSN, char *strFilePath,
 				     char *strMainDirName, char *strOSDirName,
-				     char *strCtrlDirName)
+				     char *strCtrlDirName, bool bCreate)
 {
 	int err = 0;
 	char strAppend[250];
@@ -293,7 +306,7 @@ static int SetupDebugDataDirectories(char *strSN, char *strFilePath,
 	strMainDirName[nIndex] = '\0';
 
 	j = 1;
-	while (mkdir(strMainDirName, 0777) < 0) {
+	while (bCreate && mkdir(strMainDirName, 0777) < 0) {
 		if (errno != EEXIST) {
 			err = -1;
 			goto exit_status;
@@ -306,7 +319,7 @@ static int SetupDebugDataDirectories(char *strSN, char *strFilePath,
 
 	if (strOSDirName) {
 		sprintf(strOSDirName, "%s/%s", strMainDirName, "OS");
-		if (mkdir(strOSDirName, 0777) < 0) {
+		if (bCreate && mkdir(strOSDirName, 0777) < 0) {
 			rmdir(strMainDirName);
 			err = -1;
 			goto exit_status;
@@ -314,7 +327,7 @@ static int SetupDebugDataDirectories(char *strSN, char *strFilePath,
 	}
 	if (strCtrlDirName) {
 		sprintf(strCtrlDirName, "%s/%s", strMainDirName, "Controller");
-		if (mkdir(strCtrlDirName, 0777) < 0) {
+		if (bCreate && mkdir(strCtrlDirName, 0777) < 0) {
 			if (strOSDirName)
 				rmdir(strOSDirName);
 			rmdir(strMainDirName);
@@ -482,7 +495,7 @@ static int micron_fw_commit(int fd, int select)
 		.cdw10 = 8,
 		.cdw12 = select,
 	};
-	return ioctl(fd, NVME_IOCTL_ADMIN_CMD, &cmd);
+	return nvme_submit_admin_passthru(fd, &cmd, NULL);
 }
 
 static int micron_selective_download(int argc, char **argv,
@@ -1648,49 +1661,29 @@ out:
 static void GetDriveInfo(const char *strOSDirName, int nFD,
 						 struct nvme_id_ctrl *ctrlp)
 {
-	FILE *fpOutFile = NULL;
-	char tempFile[256] = { 0 };
 	char strBuffer[1024] = { 0 };
 	char model[41] = { 0 };
 	char serial[21] = { 0 };
 	char fwrev[9] = { 0 };
 	char *strPDir = strdup(strOSDirName);
 	char *strDest = dirname(strPDir);
-
-	sprintf(tempFile, "%s/%s", strDest, "drive-info.txt");
-	fpOutFile = fopen(tempFile, "w+");
-	if (!fpOutFile) {
-		printf("Failed to create %s\n", tempFile);
-		free(strPDir);
-		return;
-	}
+	int len;
 
 	strncpy(model, ctrlp->mn, 40);
 	strncpy(serial, ctrlp->sn, 20);
 	strncpy(fwrev, ctrlp->fr, 8);
 
-	sprintf(strBuffer,
-			"********************\nDrive Info\n********************\n");
-
-	fprintf(fpOutFile, "%s", strBuffer);
-	sprintf(strBuffer,
-			"%-20s : /dev/nvme%d\n%-20s : %s\n%-20s : %-20s\n%-20s : %-20s\n",
+	len = snprintf(strBuffer, sizeof(strBuffer),
+			"********************\nDrive Info\n********************\n"
+			"%-20s : /dev/nvme%d\n%-20s : %s\n%-20s : %-20s\n%-20s : %-20s\n"
+			"\n********************\nPCI Info\n********************\n"
+			"%-22s : %04X\n%-22s : %04X\n",
 			"Device Name", nFD,
 			"Model No", (char *)model,
-			"Serial No", (char *)serial, "FW-Rev", (char *)fwrev);
-
-	fprintf(fpOutFile, "%s", strBuffer);
-
-	sprintf(strBuffer,
-			"\n********************\nPCI Info\n********************\n");
-
-	fprintf(fpOutFile, "%s", strBuffer);
-
-	sprintf(strBuffer,
-			"%-22s : %04X\n%-22s : %04X\n",
+			"Serial No", (char *)serial, "FW-Rev", (char *)fwrev,
 			"VendorId", vendor_id, "DeviceId", device_id);
-	fprintf(fpOutFile, "%s", strBuffer);
-	fclose(fpOutFile);
+
+	WriteData((__u8 *)strBuffer, len, strDest, "drive-info.txt", "drive info");
 	free(strPDir);
 }
 
@@ -1814,42 +1807,57 @@ static void GetNSIDDInfo(int fd, const char *dir, int nsid)
 
 static void GetOSConfig(const char *strOSDirName)
 {
-	FILE *fpOSConfig = NULL;
-	char strBuffer[1024];
-	char strFileName[PATH_MAX];
+	FILE *fpCmd = NULL;
+	char *strOut = NULL;
+	size_t outLen = 0, outSize = 0, n;
+	char strBuffer[4096];
 	int i;
 
 	struct {
 		char *strcmdHeader;
 		char *strCommand;
 	} cmdArray[] = {
-		{ (char *)"SYSTEM INFORMATION", (char *)"uname -a >> %s" },
-		{ (char *)"LINUX KERNEL MODULE INFORMATION", (char *)"lsmod >> %s" },
-		{ (char *)"LINUX SYSTEM MEMORY INFORMATION", (char *)"cat /proc/meminfo >> %s" },
-		{ (char *)"SYSTEM INTERRUPT INFORMATION", (char *)"cat /proc/interrupts >> %s" },
-		{ (char *)"CPU INFORMATION", (char *)"cat /proc/cpuinfo >> %s" },
-		{ (char *)"IO MEMORY MAP INFORMATION", (char *)"cat /proc/iomem >> %s" },
-		{ (char *)"MAJOR NUMBER AND DEVICE GROUP", (char *)"cat /proc/devices >> %s" },
-		{ (char *)"KERNEL DMESG", (char *)"dmesg >> %s" },
-		{ (char *)"/VAR/LOG/MESSAGES", (char *)"cat /var/log/messages >> %s" }
+		{ (char *)"SYSTEM INFORMATION", (char *)"uname -a" },
+		{ (char *)"LINUX KERNEL MODULE INFORMATION", (char *)"lsmod" },
+		{ (char *)"LINUX SYSTEM MEMORY INFORMATION", (char *)"cat /proc/meminfo" },
+		{ (char *)"SYSTEM INTERRUPT INFORMATION", (char *)"cat /proc/interrupts" },
+		{ (char *)"CPU INFORMATION", (char *)"cat /proc/cpuinfo" },
+		{ (char *)"IO MEMORY MAP INFORMATION", (char *)"cat /proc/iomem" },
+		{ (char *)"MAJOR NUMBER AND DEVICE GROUP", (char *)"cat /proc/devices" },
+		{ (char *)"KERNEL DMESG", (char *)"dmesg" },
+		{ (char *)"/VAR/LOG/MESSAGES", (char *)"cat /var/log/messages" }
 	};
 
-	sprintf(strFileName, "%s/%s", strOSDirName, "os_config.txt");
-
+	/* the whole file is collected first so it is written in one piece */
 	for (i = 0; i < 7; i++) {
-		fpOSConfig = fopen(strFileName, "a+");
-		if (fpOSConfig) {
-			fprintf(fpOSConfig,
-				"\n\n\n\n%s\n-----------------------------------------------\n",
-				cmdArray[i].strcmdHeader);
-			fclose(fpOSConfig);
-			fpOSConfig = NULL;
-		}
-		snprintf(strBuffer, sizeof(strBuffer) - 1,
-				 cmdArray[i].strCommand, strFileName);
-		if (system(strBuffer))
-			fprintf(stderr, "Failed to send \"%s\"\n", strBuffer);
+		n = snprintf(strBuffer, sizeof(strBuffer),
+			     "\n\n\n\n%s\n-----------------------------------------------\n",
+			     cmdArray[i].strcmdHeader);
+		fpCmd = popen(cmdArray[i].strCommand, "r");
+		if (!fpCmd)
+			fprintf(stderr, "Failed to send \"%s\"\n", cmdArray[i].strCommand);
+		do {
+			if (outLen + n > outSize) {
+				char *p = realloc(strOut, outSize + n + sizeof(strBuffer));
+
+				if (!p) {
+					fprintf(stderr, "Failed to collect \"%s\"\n",
+						cmdArray[i].strCommand);
+					break;
+				}
+				strOut = p;
+				outSize += n + sizeof(strBuffer);
+			}
+			memcpy(strOut + outLen, strBuffer, n);
+			outLen += n;
+		} while (fpCmd && (n = fread(strBuffer, 1, sizeof(strBuffer), fpCmd)) > 0);
+		if (fpCmd && pclose(fpCmd))
+			fprintf(stderr, "Failed to send \"%s\"\n", cmdArray[i].strCommand);
 	}
+
+	if (strOut)
+		WriteData((__u8 *)strOut, outLen, strOSDirName, "os_config.txt", "os config");
+	free(strOut);
 }
 
 static int micron_telemetry_log(int fd, __u8 type, __u8 **data,
@@ -1946,6 +1954,7 @@ static int GetTelemetryData(int fd, const char *dir)
 static int GetFeatureSettings(int fd, const char *dir)
 {
 	unsigned char *bufp, buf[4096] = { 0 };
+	__u8 out[sizeof(__u32) + sizeof(buf)];
 	int i, err, len, errcnt = 0;
 	__u32 attrVal = 0;
 	char msg[256] = { 0 };
@@ -1993,9 +2002,11 @@ static int GetFeatureSettings(int fd, const char *dir)
 		err = nvme_get_features(&args);
 		if (!err) {
 			sprintf(msg, "feature: 0x%X", fmap[i].id);
-			WriteData((__u8 *)&attrVal, sizeof(attrVal), dir, fmap[i].file, msg);
+			/* the value and the data of the feature go in one file */
+			memcpy(out, &attrVal, sizeof(attrVal));
 			if (bufp)
-				WriteData(bufp, len, dir, fmap[i].file, msg);
+				memcpy(out + sizeof(attrVal), bufp, len);
+			WriteData(out, sizeof(attrVal) + len, dir, fmap[i].file, msg);
 		} else {
 			fprintf(stderr, "Feature 0x%x data not retrieved, error %d (ignored)!\n",
 					fmap[i].id, err);
@@ -2533,52 +2544,243 @@ static int micron_latency_stats_logs(int argc, char **argv, struct command *cmd,
 	return err;
 }
 
+#define LATENCY_BUCKET_COUNT 32
+#define LATENCY_BUCKET_RSVD  32
+
+struct micron_latency_stats {
+	uint64_t version; /* major << 32 | minior */
+	uint64_t all_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
+	uint64_t read_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
+	uint64_t write_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
+	uint64_t trim_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
+	uint32_t reserved[255]; /* round up to 4K */
+};
+
+static const struct latency_thresholds {
+	uint32_t start;
+	uint32_t end;
+	char *unit;
+} latency_thresholds[LATENCY_BUCKET_COUNT] = {
+	{0, 50, "us"}, {50, 100, "us"}, {100, 150, "us"}, {150, 200, "us"},
+	{200, 300, "us"}, {300, 400, "us"}, {400, 500, "us"}, {500, 600, "us"},
+	{600, 700, "us"}, {700, 800, "us"}, {800, 900, "us"}, {900, 1000, "us"},
+	{1, 5, "ms"}, {5, 10, "ms"}, {10, 20, "ms"}, {20, 50, "ms"}, {50, 100, "ms"},
+	{100, 200, "ms"}, {200, 300, "ms"}, {300, 400, "ms"}, {400, 500, "ms"},
+	{500, 600, "ms"}, {600, 700, "ms"}, {700, 800, "ms"}, {800, 900, "ms"},
+	{900, 1000, "ms"}, {1, 2, "s"}, {2, 3, "s"}, {3, 4, "s"}, {4, 5, "s"},
+	{5, 8, "s"},
+	{8, INT_MAX, "s"},
+};
+
+static const double latency_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+static uint32_t latency_threshold_us(const struct latency_thresholds *t, uint32_t v)
+{
+	if (v == INT_MAX)
+		return NVME_LAT_HIST_INF;
+	if (!strcmp(t->unit, "s"))
+		return v * 1000000;
+	if (!strcmp(t->unit, "ms"))
+		return v * 1000;
+	return v;
+}
+
+/* read the latency statistics log into @h, the buckets of the @type commands */
+static int micron_latency_hist_read(int fd, enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	_cleanup_free_ struct micron_latency_stats *log = NULL;
+	uint64_t *stats;
+	int err, b;
+
+	log = malloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_get_log_simple(fd, 0xD0, sizeof(*log), log);
+	if (err)
+		return err < 0 ? -errno : err;
+
+	switch (type) {
+	case NVME_LAT_READ:
+		stats = log->read_cmds;
+		break;
+	case NVME_LAT_WRITE:
+		stats = log->write_cmds;
+		break;
+	case NVME_LAT_TRIM:
+		stats = log->trim_cmds;
+		break;
+	default:
+		stats = log->all_cmds;
+		break;
+	}
+
+	nvme_lat_hist_init(h, 0);
+	for (b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+		const struct latency_thresholds *t = &latency_thresholds[b];
+
+		nvme_lat_hist_add_bucket(h, latency_threshold_us(t, t->start),
+					 latency_threshold_us(t, t->end), stats[b]);
+	}
+
+	return 0;
+}
+
+static int micron_lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+				  enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	if (le16_to_cpu(ctrl->vid) != MICRON_VENDOR_ID)
+		return -ENOTSUP;
+
+	return micron_latency_hist_read(dev_fd(dev), type, h);
+}
+
+static struct nvme_lat_source micron_lat_source = {
+	.name = "micron",
+	.read = micron_lat_source_read,
+};
+
+NVME_LAT_SOURCE(micron_lat_source)
+
+/*
+ * One sample of --interval: the commands completed in the interval and the
+ * latency percentiles estimated from the buckets they fell in, as the upper
+ * edge of the bucket reaching each percentile. The JSON lines carry the
+ * same keys as the OCP and Solidigm latency samplers.
+ */
+static void latency_stats_sample_print(const char *type, const struct nvme_lat_hist *delta,
+				       uint64_t timestamp_ms, uint64_t interval_ns,
+				       bool json)
+{
+	unsigned int p, b;
+
+	if (json) {
+		struct json_object *r = json_create_object();
+		struct json_object *buckets = json_create_array();
+		char key[16];
+
+		json_object_add_value_uint64(r, "timestamp_ms", timestamp_ms);
+		json_object_add_value_uint64(r, "interval_ms", interval_ns / 1000000);
+		json_object_add_value_string(r, "type", type);
+		json_object_add_value_uint64(r, "ios", nvme_lat_hist_count(delta));
+		for (p = 0; p < ARRAY_SIZE(latency_percentiles); p++) {
+			snprintf(key, sizeof(key), "p%g_us", latency_percentiles[p]);
+			json_object_add_value_uint(r, key,
+				nvme_lat_hist_percentile(delta, latency_percentiles[p]));
+		}
+		json_object_add_value_uint(r, "max_us", nvme_lat_hist_max(delta));
+		for (b = 0; b < delta->nr_buckets; b++) {
+			struct json_object *bucket;
+
+			if (!delta->buckets[b].count)
+				continue;
+			bucket = json_create_array();
+			json_object_array_add(bucket, json_object_new_int(b));
+			json_object_array_add(bucket,
+					      json_object_new_int64(delta->buckets[b].count));
+			json_object_array_add(buckets, bucket);
+		}
+		json_object_add_value_array(r, "buckets", buckets);
+		util_json_write_record(stdout, r, true);
+	} else {
+		printf("%" PRIu64 " %s ios %" PRIu64, timestamp_ms, type,
+		       nvme_lat_hist_count(delta));
+		for (p = 0; p < ARRAY_SIZE(latency_percentiles); p++)
+			printf(" p%g %uus", latency_percentiles[p],
+			       nvme_lat_hist_percentile(delta, latency_percentiles[p]));
+		printf(" max %uus\n", nvme_lat_hist_max(delta));
+	}
+	fflush(stdout);
+}
+
+/*
+ * latency-stats --interval: keep reading the latency statistics log and
+ * report the buckets of @type filled between two consecutive samples.
+ */
+static int latency_stats_sampler(struct nvme_dev *dev, const char *name,
+				 enum nvme_lat_type type, uint32_t interval,
+				 uint32_t count, bool json)
+{
+	_cleanup_free_ struct nvme_lat_hist *hists = NULL;
+	struct nvme_lat_hist *cur, *prev, *delta, *tmp;
+	uint64_t next, now, last;
+	struct timespec ts;
+	uint32_t n;
+	int err;
+
+	hists = malloc(3 * sizeof(*hists));
+	if (!hists)
+		return -ENOMEM;
+	prev = &hists[0];
+	cur = &hists[1];
+	delta = &hists[2];
+
+	err = micron_latency_hist_read(dev_fd(dev), type, prev);
+	if (err)
+		return err;
+
+	nvme_stop_catch(true, NULL);
+
+	next = last = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += (uint64_t)interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
+
+		err = micron_latency_hist_read(dev_fd(dev), type, cur);
+		if (err)
+			break;
+		nvme_lat_hist_delta(delta, cur, prev);
+
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		latency_stats_sample_print(name, delta,
+					   ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000,
+					   now - last, json);
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
+	}
+
+	nvme_stop_release();
+	return err;
+}
+
 static int micron_latency_stats_info(int argc, char **argv, struct command *cmd,
 				     struct plugin *plugin)
 {
 	const char *desc = "display command latency statistics";
 	const char *command = "command to display stats - all|read|write|trimdefault is all";
+	const char *interval = "keep sampling the log every <interval> seconds";
+	const char *count = "number of samples of --interval, 0 for no limit";
+	const char *fmt = "output format normal|json, for --interval";
 	int err = 0;
 	struct nvme_dev *dev;
 	enum eDriveModel model = UNKNOWN_MODEL;
-	#define LATENCY_BUCKET_COUNT 32
-	#define LATENCY_BUCKET_RSVD  32
-	struct micron_latency_stats {
-		uint64_t version; /* major << 32 | minior */
-		uint64_t all_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
-		uint64_t read_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
-		uint64_t write_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
-		uint64_t trim_cmds[LATENCY_BUCKET_COUNT + LATENCY_BUCKET_RSVD];
-		uint32_t reserved[255]; /* round up to 4K */
-	} log;
-
-	struct latency_thresholds {
-		uint32_t start;
-		uint32_t end;
-		char *unit;
-	} thresholds[LATENCY_BUCKET_COUNT] = {
-		{0, 50, "us"}, {50, 100, "us"}, {100, 150, "us"}, {150, 200, "us"},
-		{200, 300, "us"}, {300, 400, "us"}, {400, 500, "us"}, {500, 600, "us"},
-		{600, 700, "us"}, {700, 800, "us"}, {800, 900, "us"}, {900, 1000, "us"},
-		{1, 5, "ms"}, {5, 10, "ms"}, {10, 20, "ms"}, {20, 50, "ms"}, {50, 100, "ms"},
-		{100, 200, "ms"}, {200, 300, "ms"}, {300, 400, "ms"}, {400, 500, "ms"},
-		{500, 600, "ms"}, {600, 700, "ms"}, {700, 800, "ms"}, {800, 900, "ms"},
-		{900, 1000, "ms"}, {1, 2, "s"}, {2, 3, "s"}, {3, 4, "s"}, {4, 5, "s"},
-		{5, 8, "s"},
-		{8, INT_MAX, "s"},
-	};
+	struct micron_latency_stats log;
 
 	struct {
 		char *command;
+		uint32_t interval;
+		uint32_t count;
+		char *fmt;
 	} opt = {
-		.command = "all"
+		.command = "all",
+		.interval = 0,
+		.count = 0,
+		.fmt = "normal",
 	};
 
 	uint64_t *cmd_stats = &log.all_cmds[0];
 	char *cmd_str = "All";
+	enum nvme_lat_type type = NVME_LAT_ALL;
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("command", 'c', "command", &opt.command, command),
+		OPT_UINT("interval", 'i', &opt.interval, interval),
+		OPT_UINT("count", 'n', &opt.count, count),
+		OPT_FMT("format", 'f', &opt.fmt, fmt),
 		OPT_END()
 	};
 
@@ -2588,18 +2790,36 @@ static int micron_latency_stats_info(int argc, char **argv, struct command *cmd,
 	if (!strcmp(opt.command, "read")) {
 		cmd_stats = &log.read_cmds[0];
 	cmd_str = "Read";
+		type = NVME_LAT_READ;
 	} else if (!strcmp(opt.command, "write")) {
 		cmd_stats = &log.write_cmds[0];
 	cmd_str = "Write";
+		type = NVME_LAT_WRITE;
 	} else if (!strcmp(opt.command, "trim")) {
 		cmd_stats = &log.trim_cmds[0];
 	cmd_str = "Trim";
+		type = NVME_LAT_TRIM;
 	} else if (strcmp(opt.command, "all")) {
 		printf("Invalid command option %s to display latency stats\n", opt.command);
 		dev_close(dev);
 	return -1;
 	}
 
+	if (strcmp(opt.fmt, "normal") && strcmp(opt.fmt, "json")) {
+		printf("Invalid output format %s, normal or json are supported\n", opt.fmt);
+		dev_close(dev);
+		return -1;
+	}
+
+	if (opt.interval) {
+		err = latency_stats_sampler(dev, opt.command, type, opt.interval, opt.count,
+					    !strcmp(opt.fmt, "json"));
+		if (err < 0)
+			printf("Unable to retrieve latency stats log the drive\n");
+		dev_close(dev);
+		return err;
+	}
+
 	memset(&log, 0, sizeof(log));
 	err = nvme_get_log_simple(dev_fd(dev), 0xD0, sizeof(log), &log);
 	if (err) {
@@ -2616,15 +2836,16 @@ static int micron_latency_stats_info(int argc, char **argv, struct command *cmd,
 	printf("=============================================\n");
 
 	for (int b = 0; b < LATENCY_BUCKET_COUNT; b++) {
+		const struct latency_thresholds *t = &latency_thresholds[b];
 		int bucket = b + 1;
 		char start[32] = { 0 };
 		char end[32] = { 0 };
 
-		sprintf(start, "%u%s", thresholds[b].start, thresholds[b].unit);
-		if (thresholds[b].end == INT_MAX)
+		sprintf(start, "%u%s", t->start, t->unit);
+		if (t->end == INT_MAX)
 			sprintf(end, "INF");
 		else
-			sprintf(end, "%u%s", thresholds[b].end, thresholds[b].unit);
+			sprintf(end, "%u%s", t->end, t->unit);
 		printf("%2d   %8s    %8s    %8"PRIu64"\n", bucket, start, end, cmd_stats[b]);
 	}
 	dev_close(dev);
@@ -2998,6 +3219,264 @@ static int get_common_log(int fd, uint8_t id, uint8_t **buf, int *size)
 	return ret;
 }
 
+struct micron_vs_log {
+	unsigned char ucLogPage;
+	const char *strFileName;
+	int nLogSize;
+	int nMaxSize;
+};
+
+/* what the collection steps of the debug log package share */
+struct micron_debug {
+	int fd;
+	int ctrlIdx;
+	enum eDriveModel eModel;
+	struct nvme_id_ctrl *ctrl;
+	const char *strOSDirName;
+	const char *strCtrlDirName;
+	const struct micron_vs_log *logs;
+	int nr_logs;
+};
+
+static int AppendData(__u8 **buf, int *len, const __u8 *data, int n)
+{
+	__u8 *p = realloc(*buf, *len + n);
+
+	if (!p) {
+		printf("Failed to allocate %d bytes of log data\n", *len + n);
+		return -ENOMEM;
+	}
+	memcpy(p + *len, data, n);
+	*buf = p;
+	*len += n;
+	return 0;
+}
+
+/*
+ * The logs read in several chunks are collected in memory first, so each
+ * file is written in one piece.
+ */
+static void GetVendorLogs(struct micron_debug *d)
+{
+	unsigned char *dataBuffer = NULL;
+	__u8 *logData = NULL;
+	unsigned int *puiIDDBuf;
+	unsigned int uiMask;
+	char msg[256] = { 0 };
+	int bSize = 0, logLen = 0;
+	int maxSize = 0;
+	int err, i;
+
+	for (i = 0; i < d->nr_logs && d->logs[i].ucLogPage; i++) {
+		err = -1;
+		switch (d->logs[i].ucLogPage) {
+		case 0xE1:
+		case 0xE5:
+		case 0xE9:
+			err = 1;
+			break;
+		case 0xE2:
+		case 0xE3:
+		case 0xE4:
+		case 0xE8:
+		case 0xEA:
+			err = get_common_log(d->fd, d->logs[i].ucLogPage,
+				 &dataBuffer, &bSize);
+			break;
+		case 0xC1:
+		case 0xC2:
+		case 0xC4:
+			err = GetLogPageSize(d->fd, d->logs[i].ucLogPage,
+					     &bSize);
+			if (!err && bSize > 0)
+				err = GetCommonLogPage(d->fd, d->logs[i].ucLogPage,
+						       &dataBuffer, bSize);
+			break;
+		case 0xE6:
+		case 0xE7:
+			puiIDDBuf = (unsigned int *)d->ctrl;
+			uiMask = puiIDDBuf[1015];
+			if (!uiMask || (d->logs[i].ucLogPage == 0xE6 && uiMask == 2) ||
+			    (d->logs[i].ucLogPage == 0xE7 && uiMask == 1)) {
+				bSize = 0;
+			} else {
+				bSize = (int)puiIDDBuf[1023];
+				if (bSize % (16 * 1024))
+					bSize += (16 * 1024) - (bSize % (16 * 1024));
+			}
+			dataBuffer = (unsigned char *)malloc(bSize);
+			if (bSize && dataBuffer) {
+				memset(dataBuffer, 0, bSize);
+				if (d->eModel == M5410 || d->eModel == M5407)
+					err = NVMEGetLogPage(d->fd,
+							     d->logs[i].ucLogPage, dataBuffer,
+							     bSize);
+				else
+					err = nvme_get_log_simple(d->fd,
+								  d->logs[i].ucLogPage,
+								  bSize, dataBuffer);
+			}
+			break;
+		case 0xF7:
+		case 0xF9:
+		case 0xFC:
+		case 0xFD:
+			if (d->eModel == M51BX)
+				(void)NVMEResetLog(d->fd, d->logs[i].ucLogPage,
+						   d->logs[i].nLogSize, d->logs[i].nMaxSize);
+			fallthrough;
+		default:
+			bSize = d->logs[i].nLogSize;
+			dataBuffer = (unsigned char *)malloc(bSize);
+			if (!dataBuffer)
+				break;
+			memset(dataBuffer, 0, bSize);
+			err = nvme_get_log_simple(d->fd, d->logs[i].ucLogPage,
+					  bSize, dataBuffer);
+			maxSize = d->logs[i].nMaxSize - bSize;
+			while (!err && maxSize > 0 && ((unsigned int *)dataBuffer)[0] != 0xdeadbeef) {
+				if (AppendData(&logData, &logLen, dataBuffer, bSize))
+					break;
+				err = nvme_get_log_simple(d->fd,
+					  d->logs[i].ucLogPage,
+					  bSize, dataBuffer);
+				if (err || (((unsigned int *)dataBuffer)[0] == 0xdeadbeef))
+					break;
+				maxSize -= bSize;
+			}
+			break;
+		}
+
+		sprintf(msg, "log 0x%x", d->logs[i].ucLogPage);
+		if (!err && dataBuffer && ((unsigned int *)dataBuffer)[0] != 0xdeadbeef) {
+			if (!logLen)
+				WriteData(dataBuffer, bSize, d->strCtrlDirName,
+					  d->logs[i].strFileName, msg);
+			else if (!AppendData(&logData, &logLen, dataBuffer, bSize))
+				WriteData(logData, logLen, d->strCtrlDirName,
+					  d->logs[i].strFileName, msg);
+		} else if (logLen) {
+			WriteData(logData, logLen, d->strCtrlDirName, d->logs[i].strFileName, msg);
+		}
+
+		free(logData);
+		logData = NULL;
+		logLen = 0;
+		if (dataBuffer) {
+			free(dataBuffer);
+			dataBuffer = NULL;
+		}
+	}
+}
+
+static void micron_debug_os(void *arg)
+{
+	struct micron_debug *d = arg;
+
+	GetTimestampInfo(d->strOSDirName);
+	GetOSConfig(d->strOSDirName);
+	GetDriveInfo(d->strOSDirName, d->ctrlIdx, d->ctrl);
+}
+
+static void micron_debug_ctrl(void *arg)
+{
+	struct micron_debug *d = arg;
+
+	GetCtrlIDDInfo(d->strCtrlDirName, d->ctrl);
+	for (int i = 1; i <= d->ctrl->nn; i++)
+		GetNSIDDInfo(d->fd, d->strCtrlDirName, i);
+
+	GetSmartlogData(d->fd, d->strCtrlDirName);
+	GetErrorlogData(d->fd, d->ctrl->elpe, d->strCtrlDirName);
+}
+
+static void micron_debug_generic(void *arg)
+{
+	struct micron_debug *d = arg;
+
+	GetGenericLogs(d->fd, d->strCtrlDirName);
+}
+
+static void micron_debug_telemetry(void *arg)
+{
+	struct micron_debug *d = arg;
+
+	/* pull if telemetry log data is supported */
+	if ((d->ctrl->lpa & 0x8) == 0x8)
+		GetTelemetryData(d->fd, d->strCtrlDirName);
+}
+
+static void micron_debug_features(void *arg)
+{
+	struct micron_debug *d = arg;
+
+	GetFeatureSettings(d->fd, d->strCtrlDirName);
+}
+
+static void micron_debug_vendor(void *arg)
+{
+	GetVendorLogs(arg);
+}
+
+/* in the order the package was always collected in */
+static const nvme_work_fn micron_debug_steps[] = {
+	micron_debug_os,
+	micron_debug_ctrl,
+	micron_debug_generic,
+	micron_debug_telemetry,
+	micron_debug_features,
+	micron_debug_vendor,
+};
+
+#define MICRON_DEBUG_JOBS	4
+#define MICRON_DEBUG_ZSTD_LEVEL	3
+
+/*
+ * Run the collection steps concurrently and stream their files into the
+ * archive @strFileName, a .tar or, when built with zstd, a .tar.zst. The
+ * vendor logs go first as the longest step, their order within the step is
+ * kept.
+ */
+static int StreamDebugData(struct micron_debug *d, const char *strFileName, bool zstd)
+{
+	struct nvme_thread_pool *pool;
+	int fd, err, cerr, i;
+
+	fd = open(strFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to create %s: %s\n", strFileName, strerror(errno));
+		return -errno;
+	}
+
+	debug_tar = nvme_tar_open(fd, zstd ? MICRON_DEBUG_ZSTD_LEVEL : 0);
+	if (!debug_tar) {
+		err = -errno;
+		fprintf(stderr, "Failed to create log data package: %s\n", strerror(errno));
+		close(fd);
+		unlink(strFileName);
+		return err;
+	}
+
+	pool = nvme_thread_pool_create(MICRON_DEBUG_JOBS);
+	for (i = ARRAY_SIZE(micron_debug_steps) - 1; i >= 0; i--)
+		if (!pool || nvme_thread_pool_queue(pool, micron_debug_steps[i], d))
+			micron_debug_steps[i](d);
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+
+	err = nvme_tar_close(debug_tar);
+	debug_tar = NULL;
+	cerr = close(fd);
+	if (err || cerr) {
+		err = err ? err : -errno;
+		fprintf(stderr, "Failed to write log data package %s: %s\n", strFileName,
+			strerror(-err));
+		unlink(strFileName);
+	}
+
+	return err;
+}
+
 static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 				struct plugin *plugin)
 {
@@ -3006,19 +3485,14 @@ static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 	char strOSDirName[1024];
 	char strCtrlDirName[1024];
 	char strMainDirName[256];
-	unsigned int *puiIDDBuf;
-	unsigned int uiMask;
 	struct nvme_id_ctrl ctrl;
+	struct micron_debug d;
+	bool bStream = false, bZstd = false;
 	char sn[20] = { 0 };
 	char msg[256] = { 0 };
 	int  c_logs_index = 8; /* should be current size of aVendorLogs */
 	struct nvme_dev *dev;
-	struct {
-		unsigned char ucLogPage;
-		const char *strFileName;
-		int nLogSize;
-		int nMaxSize;
-	} aVendorLogs[32] = {
+	struct micron_vs_log aVendorLogs[32] = {
 		{ 0x03, "firmware_slot_info_log.bin", 512, 0 },
 		{ 0xC1, "nvmelog_C1.bin", 0, 0 },
 		{ 0xC2, "nvmelog_C2.bin", 0, 0 },
@@ -3071,9 +3545,6 @@ static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 	const char *package = "Log output data file name (required)";
 	const char *type = "telemetry log type - host or controller";
 	const char *data_area = "telemetry log data area 1, 2 or 3";
-	unsigned char *dataBuffer = NULL;
-	int bSize = 0;
-	int maxSize = 0;
 
 	struct config {
 		char *type;
@@ -3158,6 +3629,16 @@ static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 		goto out;
 	}
 
+	/* a tar package is written in-process, as the data is collected */
+	bZstd = strlen(cfg.package) > 8 &&
+		!strcmp(cfg.package + strlen(cfg.package) - 8, ".tar.zst");
+	bStream = bZstd || (strlen(cfg.package) > 4 &&
+			    !strcmp(cfg.package + strlen(cfg.package) - 4, ".tar"));
+	if (bZstd && !nvme_tar_zstd_supported()) {
+		printf("zstd compression is not supported by this build, use a .tar package\n");
+		goto out;
+	}
+
 	printf("Preparing log package. This will take a few seconds...\n");
 
 	/* trim spaces out of serial number string */
@@ -3171,24 +3652,8 @@ static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 	sn[j] = '\0';
 	strcpy(ctrl.sn, sn);
 
-	SetupDebugDataDirectories(ctrl.sn, cfg.package, strMainDirName, strOSDirName, strCtrlDirName);
-
-	GetTimestampInfo(strOSDirName);
-	GetCtrlIDDInfo(strCtrlDirName, &ctrl);
-	GetOSConfig(strOSDirName);
-	GetDriveInfo(strOSDirName, ctrlIdx, &ctrl);
-
-	for (int i = 1; i <= ctrl.nn; i++)
-		GetNSIDDInfo(dev_fd(dev), strCtrlDirName, i);
-
-	GetSmartlogData(dev_fd(dev), strCtrlDirName);
-	GetErrorlogData(dev_fd(dev), ctrl.elpe, strCtrlDirName);
-	GetGenericLogs(dev_fd(dev), strCtrlDirName);
-	/* pull if telemetry log data is supported */
-	if ((ctrl.lpa & 0x8) == 0x8)
-		GetTelemetryData(dev_fd(dev), strCtrlDirName);
-
-	GetFeatureSettings(dev_fd(dev), strCtrlDirName);
+	SetupDebugDataDirectories(ctrl.sn, cfg.package, strMainDirName, strOSDirName,
+				  strCtrlDirName, !bStream);
 
 	if (eModel != M5410 && eModel != M5407) {
 		memcpy(&aVendorLogs[c_logs_index], aM51XXLogs, sizeof(aM51XXLogs));
@@ -3201,97 +3666,25 @@ static int micron_internal_logs(int argc, char **argv, struct command *cmd,
 			memcpy((char *)&aVendorLogs[c_logs_index], aM51CXLogs, sizeof(aM51CXLogs));
 	}
 
-	for (int i = 0; i < (int)(ARRAY_SIZE(aVendorLogs)) && aVendorLogs[i].ucLogPage; i++) {
-		err = -1;
-		switch (aVendorLogs[i].ucLogPage) {
-		case 0xE1:
-		case 0xE5:
-		case 0xE9:
-			err = 1;
-			break;
-		case 0xE2:
-		case 0xE3:
-		case 0xE4:
-		case 0xE8:
-		case 0xEA:
-			err = get_common_log(dev_fd(dev), aVendorLogs[i].ucLogPage,
-				 &dataBuffer, &bSize);
-			break;
-		case 0xC1:
-		case 0xC2:
-		case 0xC4:
-			err = GetLogPageSize(dev_fd(dev), aVendorLogs[i].ucLogPage,
-					     &bSize);
-			if (!err && bSize > 0)
-				err = GetCommonLogPage(dev_fd(dev), aVendorLogs[i].ucLogPage,
-						       &dataBuffer, bSize);
-			break;
-		case 0xE6:
-		case 0xE7:
-			puiIDDBuf = (unsigned int *)&ctrl;
-			uiMask = puiIDDBuf[1015];
-			if (!uiMask || (aVendorLogs[i].ucLogPage == 0xE6 && uiMask == 2) ||
-			    (aVendorLogs[i].ucLogPage == 0xE7 && uiMask == 1)) {
-				bSize = 0;
-			} else {
-				bSize = (int)puiIDDBuf[1023];
-				if (bSize % (16 * 1024))
-					bSize += (16 * 1024) - (bSize % (16 * 1024));
-			}
-			dataBuffer = (unsigned char *)malloc(bSize);
-			if (bSize && dataBuffer) {
-				memset(dataBuffer, 0, bSize);
-				if (eModel == M5410 || eModel == M5407)
-					err = NVMEGetLogPage(dev_fd(dev),
-							     aVendorLogs[i].ucLogPage, dataBuffer,
-							     bSize);
-				else
-					err = nvme_get_log_simple(dev_fd(dev),
-								  aVendorLogs[i].ucLogPage,
-								  bSize, dataBuffer);
-			}
-			break;
-		case 0xF7:
-		case 0xF9:
-		case 0xFC:
-		case 0xFD:
-			if (eModel == M51BX)
-				(void)NVMEResetLog(dev_fd(dev), aVendorLogs[i].ucLogPage,
-						   aVendorLogs[i].nLogSize, aVendorLogs[i].nMaxSize);
-			fallthrough;
-		default:
-			bSize = aVendorLogs[i].nLogSize;
-			dataBuffer = (unsigned char *)malloc(bSize);
-			if (!dataBuffer)
-				break;
-			memset(dataBuffer, 0, bSize);
-			err = nvme_get_log_simple(dev_fd(dev), aVendorLogs[i].ucLogPage,
-					  bSize, dataBuffer);
-			maxSize = aVendorLogs[i].nMaxSize - bSize;
-			while (!err && maxSize > 0 && ((unsigned int *)dataBuffer)[0] != 0xdeadbeef) {
-				sprintf(msg, "log 0x%x", aVendorLogs[i].ucLogPage);
-				WriteData(dataBuffer, bSize, strCtrlDirName, aVendorLogs[i].strFileName, msg);
-				err = nvme_get_log_simple(dev_fd(dev),
-					  aVendorLogs[i].ucLogPage,
-					  bSize, dataBuffer);
-				if (err || (((unsigned int *)dataBuffer)[0] == 0xdeadbeef))
-					break;
-				maxSize -= bSize;
-			}
-			break;
-		}
-
-		if (!err && dataBuffer && ((unsigned int *)dataBuffer)[0] != 0xdeadbeef) {
-			sprintf(msg, "log 0x%x", aVendorLogs[i].ucLogPage);
-			WriteData(dataBuffer, bSize, strCtrlDirName, aVendorLogs[i].strFileName, msg);
-		}
+	d = (struct micron_debug) {
+		.fd = dev_fd(dev),
+		.ctrlIdx = ctrlIdx,
+		.eModel = eModel,
+		.ctrl = &ctrl,
+		.strOSDirName = strOSDirName,
+		.strCtrlDirName = strCtrlDirName,
+		.logs = aVendorLogs,
+		.nr_logs = ARRAY_SIZE(aVendorLogs),
+	};
 
-		if (dataBuffer) {
-			free(dataBuffer);
-			dataBuffer = NULL;
-		}
+	if (bStream) {
+		err = StreamDebugData(&d, cfg.package, bZstd);
+		goto out;
 	}
 
+	for (i = 0; i < (int)ARRAY_SIZE(micron_debug_steps); i++)
+		micron_debug_steps[i](&d);
+
 	err = ZipAndRemoveDir(strMainDirName, cfg.package);
 out:
 	dev_close(dev);
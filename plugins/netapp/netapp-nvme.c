@@ -28,6 +28,8 @@
 #include "libnvme.h"
 
 #include "util/suffix.h"
+#include "util/table.h"
+#include "util/thread-pool.h"
 
 #define CREATE_CMD
 #include "netapp-nvme.h"
@@ -37,6 +39,8 @@
 #define ONTAP_LABEL_LEN		260
 #define ONTAP_NS_PATHLEN	525
 
+#define NETAPP_SCAN_JOBS	16
+
 enum {
 	NNORMAL,
 	NJSON,
@@ -251,6 +255,26 @@ static void netapp_ontapdevice_json(struct json_object *devices, char *devname,
 	json_array_add_value_object(devices, device_attrs);
 }
 
+static const struct nvme_table_column netapp_smdevice_cols[] = {
+	{ "Device", 16 },
+	{ "Array Name", 30 },
+	{ "Volume Name", 30 },
+	{ "NSID", 4, NVME_TABLE_RIGHT },
+	{ "Volume ID", 32, NVME_TABLE_RIGHT },
+	{ "Ctrl", 4 },
+	{ "Access State", 12 },
+	{ "Size", 9, NVME_TABLE_RIGHT },
+};
+
+static const struct nvme_table_column netapp_ontapdevice_cols[] = {
+	{ "Device", 16 },
+	{ "Vserver", 25 },
+	{ "Namespace Path", 50 },
+	{ "NSID", 4 },
+	{ "UUID", 38 },
+	{ "Size", 9 },
+};
+
 static void netapp_smdevices_print(struct smdevice_info *devices, int count, int format)
 {
 	struct json_object *root = NULL;
@@ -261,21 +285,15 @@ static void netapp_smdevices_print(struct smdevice_info *devices, int count, int
 	char nguid_str[33];
 	char basestr[] =
 	    "%s, Array Name %s, Volume Name %s, NSID %d, Volume ID %s, Controller %c, Access State %s, %s\n";
-	char columnstr[] = "%-16s %-30s %-30s %4d %32s  %c   %-12s %9s\n";
-	char *formatstr = basestr; /* default to "normal" output format */
+	struct nvme_table t = { 0 };
 	__u8 lba_index;
 
 	if (format == NCOLUMN) {
-		/* for column output, change output string and print column headers */
-		formatstr = columnstr;
-		printf("%-16s %-30s %-30s %-4s %-32s %-4s %-12s %-9s\n",
-			"Device", "Array Name", "Volume Name", "NSID",
-			"Volume ID", "Ctrl", "Access State", " Size");
-		printf("%-16s %-30s %-30s %-4s %-32s %-4s %-12s %-9s\n",
-			"----------------", "------------------------------",
-			"------------------------------", "----",
-			"--------------------------------", "----",
-			"------------", "---------");
+		if (nvme_table_init(&t, netapp_smdevice_cols,
+				    ARRAY_SIZE(netapp_smdevice_cols))) {
+			fprintf(stderr, "Unable to allocate memory for the table.\n");
+			return;
+		}
 	} else if (format == NJSON) {
 		/* prepare for json output */
 		root = json_create_object();
@@ -301,13 +319,25 @@ static void netapp_smdevices_print(struct smdevice_info *devices, int count, int
 				array_label, volume_label, devices[i].nsid,
 				nguid_str, slta ? "A" : "B", "unknown", size,
 				lba, le64_to_cpu(devices[i].ns.nsze));
-		else
-			printf(formatstr, devices[i].dev, array_label,
+		else if (format == NCOLUMN) {
+			nvme_table_add(&t, devices[i].dev);
+			nvme_table_add(&t, array_label);
+			nvme_table_add(&t, volume_label);
+			nvme_table_addf(&t, "%d", devices[i].nsid);
+			nvme_table_add(&t, nguid_str);
+			nvme_table_add(&t, slta ? "A" : "B");
+			nvme_table_add(&t, "unknown");
+			nvme_table_add(&t, size);
+		} else
+			printf(basestr, devices[i].dev, array_label,
 				volume_label, devices[i].nsid, nguid_str,
 				slta ? 'A' : 'B', "unknown", size);
 	}
 
-	if (format == NJSON) {
+	if (format == NCOLUMN) {
+		nvme_table_print(&t, stdout);
+		nvme_table_free(&t);
+	} else if (format == NJSON) {
 		/* complete the json output */
 		json_object_add_value_array(root, "SMdevices", json_devices);
 		json_print_object(root, NULL);
@@ -329,22 +359,14 @@ static void netapp_ontapdevices_print(struct ontapdevice_info *devices,
 	int i;
 
 	char basestr[] = "%s, Vserver %s, Namespace Path %s, NSID %d, UUID %s, %s\n";
-	char columnstr[] = "%-16s %-25s %-50s %-4d %-38s %-9s\n";
-
-	/* default to 'normal' output format */
-	char *formatstr = basestr;
+	struct nvme_table t = { 0 };
 
 	if (format == NCOLUMN) {
-		/* change output string and print column headers */
-		formatstr = columnstr;
-		printf("%-16s %-25s %-50s %-4s %-38s %-9s\n",
-				"Device", "Vserver", "Namespace Path",
-				"NSID", "UUID", "Size");
-		printf("%-16s %-25s %-50s %-4s %-38s %-9s\n",
-				"----------------", "-------------------------",
-				"--------------------------------------------------",
-				"----", "--------------------------------------",
-				"---------");
+		if (nvme_table_init(&t, netapp_ontapdevice_cols,
+				    ARRAY_SIZE(netapp_ontapdevice_cols))) {
+			fprintf(stderr, "Unable to allocate memory for the table.\n");
+			return;
+		}
 	} else if (format == NJSON) {
 		/* prepare for json output */
 		root = json_create_object();
@@ -362,12 +384,22 @@ static void netapp_ontapdevices_print(struct ontapdevice_info *devices,
 					vsname, nspath, devices[i].nsid,
 					uuid_str, size, lba,
 					le64_to_cpu(devices[i].ns.nsze));
+		} else if (format == NCOLUMN) {
+			nvme_table_add(&t, devices[i].dev);
+			nvme_table_add(&t, vsname);
+			nvme_table_add(&t, nspath);
+			nvme_table_addf(&t, "%d", devices[i].nsid);
+			nvme_table_add(&t, uuid_str);
+			nvme_table_add(&t, size);
 		} else
-			printf(formatstr, devices[i].dev, vsname, nspath,
+			printf(basestr, devices[i].dev, vsname, nspath,
 					devices[i].nsid, uuid_str, size);
 	}
 
-	if (format == NJSON) {
+	if (format == NCOLUMN) {
+		nvme_table_print(&t, stdout);
+		nvme_table_free(&t);
+	} else if (format == NJSON) {
 		/* complete the json output */
 		json_object_add_value_array(root, "ONTAPdevices", json_devices);
 		json_print_object(root, NULL);
@@ -407,21 +439,13 @@ static int nvme_get_ontap_c2_log(int fd, __u32 nsid, void *buf, __u32 buflen)
 }
 
 static int netapp_smdevices_get_info(int fd, struct smdevice_info *item,
-				     const char *dev)
+				     const struct nvme_id_ctrl *ctrl, const char *dev)
 {
 	int err;
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
-	if (err) {
-		fprintf(stderr,
-			"Identify Controller failed to %s (%s)\n", dev,
-			err < 0 ? strerror(-err) :
-			nvme_status_to_string(err, false));
-		return 0;
-	}
-
-	if (strncmp("NetApp E-Series", item->ctrl.mn, 15) != 0)
+	if (strncmp("NetApp E-Series", ctrl->mn, 15) != 0)
 		return 0; /* not the right model of controller */
+	item->ctrl = *ctrl;
 
 	err = nvme_get_nsid(fd, &item->nsid);
 	err = nvme_identify_ns(fd, item->nsid, &item->ns);
@@ -438,22 +462,15 @@ static int netapp_smdevices_get_info(int fd, struct smdevice_info *item,
 }
 
 static int netapp_ontapdevices_get_info(int fd, struct ontapdevice_info *item,
-		const char *dev)
+		const struct nvme_id_ctrl *ctrl, const char *dev)
 {
 	int err;
 	void *nsdescs;
 
-	err = nvme_identify_ctrl(fd, &item->ctrl);
-	if (err) {
-		fprintf(stderr, "Identify Controller failed to %s (%s)\n",
-			dev, err < 0 ? strerror(-err) :
-			nvme_status_to_string(err, false));
-		return 0;
-	}
-
-	if (strncmp("NetApp ONTAP Controller", item->ctrl.mn, 23) != 0)
+	if (strncmp("NetApp ONTAP Controller", ctrl->mn, 23) != 0)
 		/* not the right controller model */
 		return 0;
+	item->ctrl = *ctrl;
 
 	err = nvme_get_nsid(fd, &item->nsid);
 
@@ -517,6 +534,137 @@ static int netapp_nvme_filter(const struct dirent *d)
 	return 0;
 }
 
+/* identify controller data, read once and shared by all its namespaces */
+struct netapp_ctrl {
+	int			instance;
+	const char		*path;	/* first namespace of the controller */
+	struct nvme_id_ctrl	ctrl;
+	bool			valid;
+};
+
+struct netapp_dev {
+	char			path[264];
+	struct netapp_ctrl	*ctrl;
+	bool			ontap;
+	void			*item;
+	int			found;
+};
+
+static void netapp_ctrl_work(void *arg)
+{
+	struct netapp_ctrl *c = arg;
+	int fd, err;
+
+	fd = open(c->path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", c->path,
+			strerror(errno));
+		return;
+	}
+
+	err = nvme_identify_ctrl(fd, &c->ctrl);
+	close(fd);
+	if (err) {
+		fprintf(stderr, "Identify Controller failed to %s (%s)\n",
+			c->path, err < 0 ? strerror(-err) :
+			nvme_status_to_string(err, false));
+		return;
+	}
+
+	c->valid = true;
+}
+
+static void netapp_dev_work(void *arg)
+{
+	struct netapp_dev *d = arg;
+	int fd;
+
+	if (!d->ctrl->valid)
+		return;
+
+	fd = open(d->path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open %s: %s\n", d->path,
+			strerror(errno));
+		return;
+	}
+
+	if (d->ontap)
+		d->found = netapp_ontapdevices_get_info(fd, d->item,
+							&d->ctrl->ctrl, d->path);
+	else
+		d->found = netapp_smdevices_get_info(fd, d->item,
+						     &d->ctrl->ctrl, d->path);
+	close(fd);
+}
+
+static void netapp_run(nvme_work_fn fn, void *args, size_t size, int nr)
+{
+	struct nvme_thread_pool *pool;
+	int i;
+
+	pool = nvme_thread_pool_create(min(nr, NETAPP_SCAN_JOBS));
+	for (i = 0; i < nr; i++) {
+		if (!pool || nvme_thread_pool_queue(pool, fn, (char *)args + i * size))
+			fn((char *)args + i * size);
+	}
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+}
+
+/*
+ * Fill in @items, an array of @num smdevice_info or ontapdevice_info, for
+ * the namespaces in @devices. The controller data is read once per
+ * controller, then the namespaces are looked at in parallel. The devices
+ * found are moved to the front of @items in the order of @devices.
+ *
+ * Returns the number of devices found or a negative errno.
+ */
+static int netapp_get_devices_info(struct dirent **devices, int num, bool ontap,
+				   void *items, size_t item_size)
+{
+	_cleanup_free_ struct netapp_ctrl *ctrls = NULL;
+	_cleanup_free_ struct netapp_dev *devs = NULL;
+	int i, j, n, nr_ctrls = 0, instance;
+
+	ctrls = calloc(num, sizeof(*ctrls));
+	devs = calloc(num, sizeof(*devs));
+	if (!ctrls || !devs)
+		return -ENOMEM;
+
+	for (i = 0; i < num; i++) {
+		snprintf(devs[i].path, sizeof(devs[i].path), "%s%s", dev_path,
+			 devices[i]->d_name);
+		devs[i].ontap = ontap;
+		devs[i].item = (char *)items + i * item_size;
+
+		/* the filter only lets nvme<ctrl>n<ns> through */
+		sscanf(devices[i]->d_name, "nvme%dn", &instance);
+		for (j = 0; j < nr_ctrls; j++)
+			if (ctrls[j].instance == instance)
+				break;
+		if (j == nr_ctrls) {
+			ctrls[j].instance = instance;
+			ctrls[j].path = devs[i].path;
+			nr_ctrls++;
+		}
+		devs[i].ctrl = &ctrls[j];
+	}
+
+	netapp_run(netapp_ctrl_work, ctrls, sizeof(*ctrls), nr_ctrls);
+	netapp_run(netapp_dev_work, devs, sizeof(*devs), num);
+
+	for (i = 0, n = 0; i < num; i++) {
+		if (!devs[i].found)
+			continue;
+		if (i != n)
+			memcpy((char *)items + n * item_size, devs[i].item, item_size);
+		n++;
+	}
+
+	return n;
+}
+
 static int netapp_output_format(char *format)
 {
 	if (!format)
@@ -537,10 +685,9 @@ static int netapp_smdevices(int argc, char **argv, struct command *command,
 	const char *desc = "Display information about E-Series volumes.";
 
 	struct dirent **devices;
-	int num, i, fd, ret, fmt;
+	int num, i, ret, fmt;
 	struct smdevice_info *smdevices;
-	char path[264];
-	int num_smdevices = 0;
+	int num_smdevices;
 
 	struct config {
 		char *output_format;
@@ -577,29 +724,18 @@ static int netapp_smdevices(int argc, char **argv, struct command *command,
 		return -ENOMEM;
 	}
 
-	for (i = 0; i < num; i++) {
-		snprintf(path, sizeof(path), "%s%s", dev_path,
-			devices[i]->d_name);
-		fd = open(path, O_RDONLY);
-		if (fd < 0) {
-			fprintf(stderr, "Unable to open %s: %s\n", path,
-				strerror(errno));
-			continue;
-		}
-
-		num_smdevices += netapp_smdevices_get_info(fd,
-						&smdevices[num_smdevices], path);
-		close(fd);
-	}
-
-	if (num_smdevices)
+	num_smdevices = netapp_get_devices_info(devices, num, false, smdevices,
+						sizeof(*smdevices));
+	if (num_smdevices < 0)
+		fprintf(stderr, "Unable to allocate memory for devices.\n");
+	else if (num_smdevices)
 		netapp_smdevices_print(smdevices, num_smdevices, fmt);
 
 	for (i = 0; i < num; i++)
 		free(devices[i]);
 	free(devices);
 	free(smdevices);
-	return 0;
+	return num_smdevices < 0 ? num_smdevices : 0;
 }
 
 /* handler for 'nvme netapp ontapdevices' */
@@ -608,10 +744,9 @@ static int netapp_ontapdevices(int argc, char **argv, struct command *command,
 {
 	const char *desc = "Display information about ONTAP devices.";
 	struct dirent **devices;
-	int num, i, fd, ret, fmt;
+	int num, i, ret, fmt;
 	struct ontapdevice_info *ontapdevices;
-	char path[264];
-	int num_ontapdevices = 0;
+	int num_ontapdevices;
 
 	struct config {
 		char *output_format;
@@ -648,28 +783,16 @@ static int netapp_ontapdevices(int argc, char **argv, struct command *command,
 		return -ENOMEM;
 	}
 
-	for (i = 0; i < num; i++) {
-		snprintf(path, sizeof(path), "%s%s", dev_path,
-				devices[i]->d_name);
-		fd = open(path, O_RDONLY);
-		if (fd < 0) {
-			fprintf(stderr, "Unable to open %s: %s\n", path,
-					strerror(errno));
-			continue;
-		}
-
-		num_ontapdevices += netapp_ontapdevices_get_info(fd,
-				&ontapdevices[num_ontapdevices], path);
-
-		close(fd);
-	}
-
-	if (num_ontapdevices)
+	num_ontapdevices = netapp_get_devices_info(devices, num, true, ontapdevices,
+						   sizeof(*ontapdevices));
+	if (num_ontapdevices < 0)
+		fprintf(stderr, "Unable to allocate memory for devices.\n");
+	else if (num_ontapdevices)
 		netapp_ontapdevices_print(ontapdevices, num_ontapdevices, fmt);
 
 	for (i = 0; i < num; i++)
 		free(devices[i]);
 	free(devices);
 	free(ontapdevices);
-	return 0;
+	return num_ontapdevices < 0 ? num_ontapdevices : 0;
 }
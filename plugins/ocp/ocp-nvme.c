@@ -15,18 +15,23 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include <signal.h>
 
 #include "common.h"
 #include "nvme.h"
+#include "nvme-archive.h"
 #include "libnvme.h"
 #include "plugin.h"
 #include "linux/types.h"
 #include "util/types.h"
+#include "util/interval.h"
+#include "util/stream.h"
 #include "nvme-print.h"
 
 #include "ocp-smart-extended-log.h"
 #include "ocp-clear-features.h"
 #include "ocp-fw-activation-history.h"
+#include "ocp-telemetry-strings.h"
 
 #define CREATE_CMD
 #include "ocp-nvme.h"
@@ -112,14 +117,14 @@ struct __packed feature_latency_monitor {
 	__u8  reserved[4083];
 };
 
-static int ocp_print_C3_log_normal(struct nvme_dev *dev,
+static int ocp_print_C3_log_normal(const char *devname,
 				   struct ssd_latency_monitor_log *log_data)
 {
 	char ts_buf[128];
 	int i, j;
 
 	printf("-Latency Monitor/C3 Log Page Data-\n");
-	printf("  Controller   :  %s\n", dev->name);
+	printf("  Controller   :  %s\n", devname);
 	printf("  Feature Status                     0x%x\n",
 	       log_data->feature_status);
 	printf("  Active Bucket Timer                %d min\n",
@@ -240,7 +245,7 @@ static int ocp_print_C3_log_normal(struct nvme_dev *dev,
 	return 0;
 }
 
-static void ocp_print_C3_log_json(struct ssd_latency_monitor_log *log_data)
+static struct json_object *ocp_C3_json_obj(struct ssd_latency_monitor_log *log_data)
 {
 	struct json_object *root;
 	char ts_buf[128];
@@ -388,19 +393,85 @@ static void ocp_print_C3_log_json(struct ssd_latency_monitor_log *log_data)
 
 	json_object_add_value_string(root, "Log Page GUID", guid);
 
+	return root;
+}
+
+static void ocp_print_C3_log_json(struct ssd_latency_monitor_log *log_data)
+{
+	struct json_object *root = ocp_C3_json_obj(log_data);
+
 	json_print_object(root, NULL);
 	printf("\n");
 
 	json_free_object(root);
 }
 
+/* checks the version and the GUID of a C3 log page read */
+static int c3_log_page_check(struct ssd_latency_monitor_log *log_data)
+{
+	int i;
+
+	/* check log page version */
+	if (log_data->log_page_version != C3_LATENCY_MON_VERSION) {
+		fprintf(stderr,
+			"ERROR : OCP : invalid latency monitor version\n");
+		return -1;
+	}
+
+	/*
+	 * check log page guid
+	 * Verify GUID matches
+	 */
+	for (i = 0; i < 16; i++) {
+		if (lat_mon_guid[i] != log_data->log_page_guid[i]) {
+			int j;
+
+			fprintf(stderr, "ERROR : OCP : Unknown GUID in C3 Log Page data\n");
+			fprintf(stderr, "ERROR : OCP : Expected GUID: 0x");
+			for (j = 0; j < 16; j++)
+				fprintf(stderr, "%x", lat_mon_guid[j]);
+
+			fprintf(stderr, "\nERROR : OCP : Actual GUID: 0x");
+			for (j = 0; j < 16; j++)
+				fprintf(stderr, "%x", log_data->log_page_guid[j]);
+			fprintf(stderr, "\n");
+
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* check the C3 log at @data and print it, @devname being where it came from */
+static int ocp_show_C3_log(__u8 *data, const char *devname, enum nvme_print_flags fmt)
+{
+	struct ssd_latency_monitor_log *log_data = (struct ssd_latency_monitor_log *)data;
+	int ret;
+
+	ret = c3_log_page_check(log_data);
+	if (ret)
+		return ret;
+
+	switch (fmt) {
+	case NORMAL:
+		ocp_print_C3_log_normal(devname, log_data);
+		break;
+	case JSON:
+		ocp_print_C3_log_json(log_data);
+		break;
+	default:
+		fprintf(stderr, "unhandled output format\n");
+
+	}
+
+	return 0;
+}
+
 static int get_c3_log_page(struct nvme_dev *dev, char *format)
 {
-	struct ssd_latency_monitor_log *log_data;
 	enum nvme_print_flags fmt;
 	int ret;
 	__u8 *data;
-	int i;
 
 	ret = validate_output_format(format, &fmt);
 	if (ret < 0) {
@@ -421,71 +492,297 @@ static int get_c3_log_page(struct nvme_dev *dev, char *format)
 	if (strcmp(format, "json"))
 		fprintf(stderr, "NVMe Status:%s(%x)\n", nvme_status_to_string(ret, false), ret);
 
-	if (!ret) {
-		log_data = (struct ssd_latency_monitor_log *)data;
+	if (!ret)
+		ret = ocp_show_C3_log(data, dev->name, fmt);
+	else
+		fprintf(stderr,
+			"ERROR : OCP : Unable to read C3 data from buffer\n");
 
-		/* check log page version */
-		if (log_data->log_page_version != C3_LATENCY_MON_VERSION) {
-			fprintf(stderr,
-				"ERROR : OCP : invalid latency monitor version\n");
-			ret = -1;
-			goto out;
-		}
+	free(data);
+	return ret;
+}
 
-		/*
-		 * check log page guid
-		 * Verify GUID matches
-		 */
-		for (i = 0; i < 16; i++) {
-			if (lat_mon_guid[i] != log_data->log_page_guid[i]) {
-				int j;
+static int ocp_C3_show_capture(void *data, size_t len, const char *file, void *arg)
+{
+	return ocp_show_C3_log(data, file, *(enum nvme_print_flags *)arg);
+}
 
-				fprintf(stderr, "ERROR : OCP : Unknown GUID in C3 Log Page data\n");
-				fprintf(stderr, "ERROR : OCP : Expected GUID: 0x");
-				for (j = 0; j < 16; j++)
-					fprintf(stderr, "%x", lat_mon_guid[j]);
+static struct json_object *ocp_C3_capture_json(void *data, size_t len)
+{
+	return c3_log_page_check(data) ? NULL : ocp_C3_json_obj(data);
+}
 
-				fprintf(stderr, "\nERROR : OCP : Actual GUID: 0x");
-				for (j = 0; j < 16; j++)
-					fprintf(stderr, "%x", log_data->log_page_guid[j]);
-				fprintf(stderr, "\n");
+static struct nvme_capture_decoder ocp_C3_decoder = {
+	.name	= "ocp-latency-monitor-log",
+	.keys	= NVME_CAPTURE_KEYS("latency-monitor-log", "log-0xc3", "c3"),
+	.size	= C3_LATENCY_MON_LOG_BUF_LEN,
+	.json	= ocp_C3_capture_json,
+};
+NVME_CAPTURE_DECODER(ocp_C3_decoder)
+
+/* the configuration set-latency-monitor-feature and --arm default to */
+static const struct feature_latency_monitor lat_mon_default = {
+	.active_bucket_timer_threshold = 0x7E0,
+	.active_threshold_a = 0x5,
+	.active_threshold_b = 0x13,
+	.active_threshold_c = 0x1E,
+	.active_threshold_d = 0x2E,
+	.active_latency_config = 0xFFF,
+	.active_latency_minimum_window = 0xA,
+	.debug_log_trigger_enable = 0,
+	.discard_debug_log = 0,
+	.latency_monitor_feature_enable = 0x7,
+};
 
-				ret = -1;
-				goto out;
+static int ocp_latency_monitor_arm(struct nvme_dev *dev, struct feature_latency_monitor *buf,
+				   __u32 *result)
+{
+	struct nvme_set_features_args args = {
+		.args_size = sizeof(args),
+		.fd = dev_fd(dev),
+		.fid = NVME_FEAT_OCP_LATENCY_MONITOR,
+		.nsid = 0,
+		.cdw12 = 0,
+		.save = 1,
+		.data_len = sizeof(struct feature_latency_monitor),
+		.data = (void *)buf,
+		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
+		.result = result,
+	};
+
+	return nvme_set_features(&args);
+}
+
+/* a counter lower than in the previous sample restarted with a new bucket timer */
+static __u32 lat_mon_delta(__le32 cur, __le32 prev)
+{
+	return le32_to_cpu(cur) >= le32_to_cpu(prev) ?
+		le32_to_cpu(cur) - le32_to_cpu(prev) : le32_to_cpu(cur);
+}
+
+static void lat_mon_sample_print(const struct ssd_latency_monitor_log *cur,
+				 const struct ssd_latency_monitor_log *prev,
+				 __u64 timestamp_ms, __u64 interval_ns,
+				 enum nvme_print_flags fmt)
+{
+	static const struct {
+		const char *name;
+		int op;
+	} classes[] = {
+		{ "read", READ },
+		{ "write", WRITE },
+		{ "deallocate", TRIM },
+	};
+	struct json_object *r = NULL;
+	char ts_buf[128];
+	unsigned int c;
+	int i;
+
+	if (fmt == JSON) {
+		struct json_object *thresholds = json_create_array();
+
+		r = json_create_object();
+		json_object_add_value_uint64(r, "timestamp_ms", timestamp_ms);
+		json_object_add_value_uint64(r, "interval_ms", interval_ns / 1000000);
+		json_object_array_add(thresholds, json_object_new_int(
+			C3_ACTIVE_THRESHOLD_INCREMENT * (cur->active_threshold_a + 1)));
+		json_object_array_add(thresholds, json_object_new_int(
+			C3_ACTIVE_THRESHOLD_INCREMENT * (cur->active_threshold_b + 1)));
+		json_object_array_add(thresholds, json_object_new_int(
+			C3_ACTIVE_THRESHOLD_INCREMENT * (cur->active_threshold_c + 1)));
+		json_object_array_add(thresholds, json_object_new_int(
+			C3_ACTIVE_THRESHOLD_INCREMENT * (cur->active_threshold_d + 1)));
+		json_object_add_value_array(r, "thresholds_ms", thresholds);
+	} else {
+		printf("%" PRIu64, timestamp_ms);
+	}
+
+	for (c = 0; c < ARRAY_SIZE(classes); c++) {
+		int op = classes[c].op;
+		struct json_object *o = NULL, *buckets = NULL, *events = NULL;
+
+		if (r) {
+			o = json_create_object();
+			buckets = json_create_array();
+			events = json_create_array();
+			json_object_add_value_array(o, "buckets", buckets);
+			json_object_add_value_array(o, "max_latency", events);
+			json_object_add_value_object(r, classes[c].name, o);
+		} else {
+			printf(" %s", classes[c].name);
+		}
+
+		for (i = 0; i < C3_BUCKET_NUM; i++) {
+			__u32 d = lat_mon_delta(cur->active_bucket_counter[i][op],
+						prev->active_bucket_counter[i][op]);
+
+			if (buckets)
+				json_object_array_add(buckets, json_object_new_int64(d));
+			else
+				printf("%c%u", i ? '/' : ' ', d);
+		}
+
+		/* the highest latencies measured since the previous sample */
+		for (i = 0; i < C3_BUCKET_NUM; i++) {
+			__u64 ts = le64_to_cpu(cur->active_latency_timestamp[3 - i][op - 1]);
+			__u16 lat = le16_to_cpu(cur->active_measured_latency[3 - i][op - 1]);
+			struct json_object *e;
+
+			if (ts == -1 ||
+			    ts == le64_to_cpu(prev->active_latency_timestamp[3 - i][op - 1]))
+				continue;
+			convert_ts(ts, ts_buf);
+			if (!events) {
+				printf(" [bucket %d %u ms at %s]", i, lat, ts_buf);
+				continue;
 			}
+			e = json_create_object();
+			json_object_add_value_int(e, "bucket", i);
+			json_object_add_value_uint(e, "latency_ms", lat);
+			json_object_add_value_string(e, "timestamp", ts_buf);
+			json_object_array_add(events, e);
 		}
+	}
 
-		switch (fmt) {
-		case NORMAL:
-			ocp_print_C3_log_normal(dev, log_data);
+	if (r) {
+		util_json_write_record(stdout, r, true);
+	} else {
+		printf("\n");
+	}
+	fflush(stdout);
+}
+
+/*
+ * latency-monitor-log --interval: read the C3 log on a fixed schedule and
+ * report the active bucket counters filled between two samples.
+ */
+static int lat_mon_sampler(struct nvme_dev *dev, __u32 interval, __u32 count,
+			   enum nvme_print_flags fmt)
+{
+	_cleanup_free_ struct ssd_latency_monitor_log *logs = NULL;
+	struct ssd_latency_monitor_log *cur, *prev, *tmp;
+	__u64 next, now, last;
+	struct timespec ts;
+	__u32 n;
+	int err;
+
+	logs = nvme_alloc(2 * sizeof(*logs));
+	if (!logs)
+		return -ENOMEM;
+	prev = &logs[0];
+	cur = &logs[1];
+
+	err = nvme_get_log_simple(dev_fd(dev), C3_LATENCY_MON_OPCODE, sizeof(*prev), prev);
+	if (err)
+		return err;
+	err = c3_log_page_check(prev);
+	if (err)
+		return err;
+
+	nvme_stop_catch(true, NULL);
+
+	next = last = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
 			break;
-		case JSON:
-			ocp_print_C3_log_json(log_data);
+
+		err = nvme_get_log_simple(dev_fd(dev), C3_LATENCY_MON_OPCODE,
+					  sizeof(*cur), cur);
+		if (err)
 			break;
-		default:
-			fprintf(stderr, "unhandled output format\n");
 
-		}
-	} else {
-		fprintf(stderr,
-			"ERROR : OCP : Unable to read C3 data from buffer\n");
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		lat_mon_sample_print(cur, prev, ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000,
+				     now - last, fmt);
+
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
 	}
 
-out:
-	free(data);
-	return ret;
+	nvme_stop_release();
+	return err;
+}
+
+static __u32 lat_mon_threshold_us(__u8 t)
+{
+	return C3_ACTIVE_THRESHOLD_INCREMENT * (t + 1) * 1000;
+}
+
+/*
+ * The active buckets of the C3 log as a latency histogram: bucket i counts
+ * the commands between the thresholds i and i + 1, the last one is open,
+ * the commands completing below threshold A are not counted.
+ */
+static int ocp_lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+			       enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	static const int ops[] = {
+		[NVME_LAT_READ] = READ,
+		[NVME_LAT_WRITE] = WRITE,
+		[NVME_LAT_TRIM] = TRIM,
+	};
+	_cleanup_free_ struct ssd_latency_monitor_log *log = NULL;
+	__u32 thresholds[C3_BUCKET_NUM + 1];
+	__u64 count;
+	int i, op, err;
+
+	log = nvme_alloc(sizeof(*log));
+	if (!log)
+		return -ENOMEM;
+
+	err = nvme_get_log_simple(dev_fd(dev), C3_LATENCY_MON_OPCODE, sizeof(*log), log);
+	if (err < 0)
+		return -errno;
+	/* not an OCP device */
+	if (err || log->log_page_version != C3_LATENCY_MON_VERSION ||
+	    memcmp(log->log_page_guid, lat_mon_guid, sizeof(lat_mon_guid)))
+		return -ENOTSUP;
+
+	thresholds[0] = lat_mon_threshold_us(log->active_threshold_a);
+	thresholds[1] = lat_mon_threshold_us(log->active_threshold_b);
+	thresholds[2] = lat_mon_threshold_us(log->active_threshold_c);
+	thresholds[3] = lat_mon_threshold_us(log->active_threshold_d);
+	thresholds[4] = NVME_LAT_HIST_INF;
+
+	nvme_lat_hist_init(h, 0);
+	for (i = 0; i < C3_BUCKET_NUM; i++) {
+		count = 0;
+		for (op = TRIM; op <= READ; op++)
+			if (type == NVME_LAT_ALL || ops[type] == op)
+				count += le32_to_cpu(log->active_bucket_counter[i][op]);
+		nvme_lat_hist_add_bucket(h, thresholds[i], thresholds[i + 1], count);
+	}
+
+	return 0;
 }
 
+static struct nvme_lat_source ocp_lat_source = {
+	.name = "ocp",
+	.generic = true,
+	.read = ocp_lat_source_read,
+};
+
+NVME_LAT_SOURCE(ocp_lat_source)
+
 static int ocp_latency_monitor_log(int argc, char **argv,
 				   struct command *command,
 				   struct plugin *plugin)
 {
 	const char *desc = "Retrieve latency monitor log data.";
 	struct nvme_dev *dev;
+	enum nvme_print_flags fmt;
 	int ret = 0;
 
 	struct config {
 		char *output_format;
+		__u32 interval;
+		__u32 count;
+		bool arm;
+		char *input_file;
 	};
 
 	struct config cfg = {
@@ -495,13 +792,62 @@ static int ocp_latency_monitor_log(int argc, char **argv,
 	OPT_ARGS(opts) = {
 		OPT_FMT("output-format", 'o', &cfg.output_format,
 			"output Format: normal|json"),
+		OPT_UINT("interval", 'i', &cfg.interval,
+			 "Sample the log every <interval> seconds and report the bucket deltas"),
+		OPT_UINT("count", 'c', &cfg.count,
+			 "Number of samples with --interval, default until interrupted"),
+		OPT_FLAG("arm", 'a', &cfg.arm,
+			 "Enable the latency monitor with its default configuration first"),
+		OPT_LIST("input-file", 0, &cfg.input_file,
+			 "Comma separated C3 log captures to decode"),
 		OPT_END()
 	};
 
-	ret = parse_and_open(&dev, argc, argv, desc, opts);
+	ret = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
 	if (ret)
 		return ret;
 
+	if (cfg.input_file) {
+		ret = validate_output_format(cfg.output_format, &fmt);
+		if (ret < 0) {
+			fprintf(stderr, "ERROR : OCP : invalid output format\n");
+			return ret;
+		}
+		return nvme_decode_captures(cfg.input_file, C3_LATENCY_MON_LOG_BUF_LEN, false,
+					    "a C3 log page", ocp_C3_show_capture, &fmt);
+	}
+
+	if (cfg.arm) {
+		struct feature_latency_monitor buf = lat_mon_default;
+		__u32 result;
+
+		ret = ocp_latency_monitor_arm(dev, &buf, &result);
+		if (ret) {
+			if (ret > 0)
+				fprintf(stderr, "NVMe Status:%s(%x)\n",
+					nvme_status_to_string(ret, false), ret);
+			else
+				perror("set-feature");
+			dev_close(dev);
+			return ret;
+		}
+	}
+
+	if (cfg.interval) {
+		ret = validate_output_format(cfg.output_format, &fmt);
+		if (ret < 0 || (fmt != NORMAL && fmt != JSON)) {
+			fprintf(stderr, "ERROR : OCP : invalid output format\n");
+			dev_close(dev);
+			return -EINVAL;
+		}
+		ret = lat_mon_sampler(dev, cfg.interval, cfg.count, fmt);
+		if (ret > 0)
+			fprintf(stderr, "NVMe Status:%s(%x)\n",
+				nvme_status_to_string(ret, false), ret);
+		dev_close(dev);
+		return ret;
+	}
+
 	ret = get_c3_log_page(dev, cfg.output_format);
 	if (ret)
 		fprintf(stderr,
@@ -548,16 +894,16 @@ int ocp_set_latency_monitor_feature(int argc, char **argv, struct command *cmd,
 	};
 
 	struct config cfg = {
-		.active_bucket_timer_threshold = 0x7E0,
-		.active_threshold_a = 0x5,
-		.active_threshold_b = 0x13,
-		.active_threshold_c = 0x1E,
-		.active_threshold_d = 0x2E,
-		.active_latency_config = 0xFFF,
-		.active_latency_minimum_window = 0xA,
-		.debug_log_trigger_enable = 0,
-		.discard_debug_log = 0,
-		.latency_monitor_feature_enable = 0x7,
+		.active_bucket_timer_threshold = lat_mon_default.active_bucket_timer_threshold,
+		.active_threshold_a = lat_mon_default.active_threshold_a,
+		.active_threshold_b = lat_mon_default.active_threshold_b,
+		.active_threshold_c = lat_mon_default.active_threshold_c,
+		.active_threshold_d = lat_mon_default.active_threshold_d,
+		.active_latency_config = lat_mon_default.active_latency_config,
+		.active_latency_minimum_window = lat_mon_default.active_latency_minimum_window,
+		.debug_log_trigger_enable = lat_mon_default.debug_log_trigger_enable,
+		.discard_debug_log = lat_mon_default.discard_debug_log,
+		.latency_monitor_feature_enable = lat_mon_default.latency_monitor_feature_enable,
 	};
 
 	OPT_ARGS(opts) = {
@@ -607,20 +953,7 @@ int ocp_set_latency_monitor_feature(int argc, char **argv, struct command *cmd,
 	buf.discard_debug_log = cfg.discard_debug_log;
 	buf.latency_monitor_feature_enable = cfg.latency_monitor_feature_enable;
 
-	struct nvme_set_features_args args = {
-		.args_size = sizeof(args),
-		.fd = dev_fd(dev),
-		.fid = NVME_FEAT_OCP_LATENCY_MONITOR,
-		.nsid = 0,
-		.cdw12 = 0,
-		.save = 1,
-		.data_len = sizeof(struct feature_latency_monitor),
-		.data = (void *)&buf,
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
-		.result = &result,
-	};
-
-	err = nvme_set_features(&args);
+	err = ocp_latency_monitor_arm(dev, &buf, &result);
 	if (err < 0) {
 		perror("set-feature");
 	} else if (!err) {
@@ -808,6 +1141,7 @@ static int eol_plp_failure_mode(int argc, char **argv, struct command *cmd,
 #define TELEMETRY_HEADER_SIZE 512
 #define TELEMETRY_BYTE_PER_BLOCK 512
 #define TELEMETRY_TRANSFER_SIZE 1024
+#define TELEMETRY_MAX_TRANSFER_SIZE (1024 * 1024)
 #define FILE_NAME_SIZE 2048
 
 enum TELEMETRY_TYPE {
@@ -956,8 +1290,8 @@ static void print_telemetry_data_area_1(struct telemetry_data_area_1 *da1,
 		for (i = 0; i < 4; i++)
 			printf("reserved1         : 0x%x\n", da1->reserved1[i]);
 		printf("Timestamp         : %"PRIu64"\n", le64_to_cpu(da1->timestamp));
-		for (i = 15; i >= 0; i--)
-			printf("%x", da1->log_page_guid[i]);
+		for (i = sizeof(da1->log_page_guid); i > 0; i--)
+			printf("%x", da1->log_page_guid[i - 1]);
 		printf("Number Telemetry Profiles Supported         : 0x%x\n", da1->no_of_tps_supp);
 		printf("Telemetry Profile Selected (TPS)         : 0x%x\n", da1->tps);
 		for (i = 0; i < 6; i++)
@@ -974,7 +1308,7 @@ static void print_telemetry_data_area_1(struct telemetry_data_area_1 *da1,
 		printf("Data Area 2 Statistic Size         : 0x%x\n", le16_to_cpu(da1->da2_stat_size));
 		for (i = 0; i < 32; i++)
 			printf("reserved5         : 0x%x\n", da1->reserved5[i]);
-		for (i = 0; i < 17; i++){
+		for (i = 0; i < ARRAY_SIZE(da1->event_fifo_da); i++){
 			printf("Event FIFO %d Data Area         : 0x%x\n", i, da1->event_fifo_da[i]);
 			printf("Event FIFO %d Start         : %"PRIu64"\n", i, le64_to_cpu(da1->event_fifo_start[i]));
 			printf("Event FIFO %d Size         : %"PRIu64"\n", i, le64_to_cpu(da1->event_fifo_size[i]));
@@ -988,112 +1322,170 @@ static void print_telemetry_data_area_1(struct telemetry_data_area_1 *da1,
 		printf("===============================================\n\n");
 	}
 }
-static void print_telemetry_da1_stat(__u8 *da1_stat, int tele_type, __u16 buf_size)
+/*
+ * The statistics and the event FIFOs of the data areas are walked record
+ * by record as they are read, chunk by chunk, so only a chunk and the
+ * header of the record crossing it are ever held in memory.
+ */
+struct telemetry_record_walker {
+	unsigned int hdr_size;
+	__u8 hdr[8];
+	unsigned int have;
+	__u64 skip;		/* data bytes left in the current record */
+	__u64 left;		/* bytes left in the area */
+	const struct ocp_c9_strings *strings;	/* names from the C9 log */
+	/* prints a record header, returns the bytes of its data */
+	__u64 (*record)(struct telemetry_record_walker *w, const __u8 *hdr);
+};
+
+static __u64 print_telemetry_stat_record(struct telemetry_record_walker *w,
+					 const __u8 *stat)
 {
-	if (da1_stat) {
-		unsigned int i = 0;
-		if (tele_type == TELEMETRY_TYPE_HOST)
-			printf("============ Telemetry Host Data area 1 Statistics ============\n");
-		else
-			printf("========= Telemetry Controller Data area 1 Statistics =========\n");
-		while((i + 8) < buf_size) {
-			printf("Statistics Identifier         : 0x%x\n", (da1_stat[i] | da1_stat[i+1] << 8));
-			printf("Statistics info         : 0x%x\n", da1_stat[i+2]);
-			printf("NS info         : 0x%x\n", da1_stat[i+3]);
-			printf("Statistic Data Size         : 0x%x\n", (da1_stat[i+4] | da1_stat[i+5] << 8));
-			printf("Reserved         : 0x%x\n", (da1_stat[i+6] | da1_stat[i+7] << 8));
-			i = 8 + ((da1_stat[i+4] | da1_stat[i+5] << 8) * 4);
-		}
-		printf("===============================================\n\n");
-	}
+	const char *str;
+	int len;
+
+	printf("Statistics Identifier         : 0x%x\n", (stat[0] | stat[1] << 8));
+	str = ocp_c9_stat_str(w->strings, stat[0] | stat[1] << 8, &len);
+	if (str)
+		printf("Statistics Identifier String         : %.*s\n", len, str);
+	printf("Statistics info         : 0x%x\n", stat[2]);
+	printf("NS info         : 0x%x\n", stat[3]);
+	printf("Statistic Data Size         : 0x%x\n", (stat[4] | stat[5] << 8));
+	printf("Reserved         : 0x%x\n", (stat[6] | stat[7] << 8));
+	return (stat[4] | stat[5] << 8) * 4;
 }
-static void print_telemetry_da1_fifo(__u8 *da1_fifo, int tele_type, __u16 buf_size)
+
+static __u64 print_telemetry_fifo_record(struct telemetry_record_walker *w,
+					 const __u8 *fifo)
 {
-	if (da1_fifo) {
-		unsigned int i = 0;
-		if (tele_type == TELEMETRY_TYPE_HOST)
-			printf("============ Telemetry Host Data area 1 FIFO ============\n");
-		else
-			printf("========= Telemetry Controller Data area 1 FIFO =========\n");
-		while((i + 4) < buf_size) {
-			printf("Debug Event Class Type         : 0x%x\n", da1_fifo[i]);
-			printf("Event ID         : 0x%x\n", (da1_fifo[i+1] | da1_fifo[i+2] << 8));
-			printf("Event Data Size         : 0x%x\n", da1_fifo[3]);
-			i = 4 + ((da1_fifo[3]) * 4);
-		}
-		printf("===============================================\n\n");
-	}
+	const char *str;
+	int len;
+
+	printf("Debug Event Class Type         : 0x%x\n", fifo[0]);
+	printf("Event ID         : 0x%x\n", (fifo[1] | fifo[2] << 8));
+	str = ocp_c9_event_str(w->strings, fifo[0], fifo[1] | fifo[2] << 8, &len);
+	if (str)
+		printf("Event String         : %.*s\n", len, str);
+	printf("Event Data Size         : 0x%x\n", fifo[3]);
+	return fifo[3] * 4;
 }
-static void print_telemetry_da2_stat(__u8 *da1_stat, int tele_type, __u16 buf_size)
+
+static void telemetry_record_walk(struct telemetry_record_walker *w, const __u8 *data,
+				  size_t len)
 {
-	if (da1_stat) {
-		unsigned int i = 0;
-		if (tele_type == TELEMETRY_TYPE_HOST)
-			printf("============ Telemetry Host Data area 1 Statistics ============\n");
-		else
-			printf("========= Telemetry Controller Data area 1 Statistics =========\n");
-		while((i + 8) < buf_size) {
-			printf("Statistics Identifier         : 0x%x\n", (da1_stat[i] | da1_stat[i+1] << 8));
-			printf("Statistics info         : 0x%x\n", da1_stat[i+2]);
-			printf("NS info         : 0x%x\n", da1_stat[i+3]);
-			printf("Statistic Data Size         : 0x%x\n", (da1_stat[i+4] | da1_stat[i+5] << 8));
-			printf("Reserved         : 0x%x\n", (da1_stat[i+6] | da1_stat[i+7] << 8));
-			i = 8 + ((da1_stat[i+4] | da1_stat[i+5] << 8) * 4);
+	while (len) {
+		size_t n;
+
+		if (w->skip) {
+			n = min(w->skip, (__u64)len);
+			w->skip -= n;
+		} else {
+			/* a record is decoded only if its whole header is in the area */
+			if (!w->have && w->left < w->hdr_size) {
+				w->left = 0;
+				return;
+			}
+			n = min((size_t)(w->hdr_size - w->have), len);
+			memcpy(&w->hdr[w->have], data, n);
+			w->have += n;
+			if (w->have == w->hdr_size) {
+				w->skip = w->record(w, w->hdr);
+				w->have = 0;
+			}
 		}
-		printf("===============================================\n\n");
+		data += n;
+		len -= n;
+		w->left -= n;
 	}
 }
-static void print_telemetry_da2_fifo(__u8 *da1_fifo, int tele_type, __u16 buf_size)
+
+static int telemetry_decode_area(struct nvme_dev *dev, __u32 nsid, __u8 tele_type,
+				 __u8 lsp, __u8 rae, __u64 offset, __u64 size,
+				 void *buf, size_t chunk, int da, bool fifo,
+				 const struct ocp_c9_strings *strings)
 {
-	if (da1_fifo) {
-		unsigned int i = 0;
-		if (tele_type == TELEMETRY_TYPE_HOST)
-			printf("============ Telemetry Host Data area 1 Statistics ============\n");
-		else
-			printf("========= Telemetry Controller Data area 1 Statistics =========\n");
-		while((i + 4) < buf_size) {
-			printf("Debug Event Class Type         : 0x%x\n", da1_fifo[i]);
-			printf("Event ID         : 0x%x\n", (da1_fifo[i+1] | da1_fifo[i+2] << 8));
-			printf("Event Data Size         : 0x%x\n", da1_fifo[3]);
-			i = 4 + ((da1_fifo[3]) * 4);
-		}
-		printf("===============================================\n\n");
+	struct telemetry_record_walker w = {
+		.hdr_size = fifo ? 4 : 8,
+		.left = size,
+		.strings = strings,
+		.record = fifo ? print_telemetry_fifo_record : print_telemetry_stat_record,
+	};
+	int err = 0;
+
+	if (tele_type == TELEMETRY_TYPE_HOST)
+		printf("============ Telemetry Host Data area %d %s ============\n",
+		       da, fifo ? "FIFO" : "Statistics");
+	else
+		printf("========= Telemetry Controller Data area %d %s =========\n",
+		       da, fifo ? "FIFO" : "Statistics");
+
+	while (size && w.left) {
+		size_t len = min(size, (__u64)chunk);
+
+		err = get_telemetry_data(dev, nsid, tele_type, len, buf, lsp, rae, offset);
+		if (err)
+			break;
+		telemetry_record_walk(&w, buf, len);
+		offset += len;
+		size -= len;
 	}
+	printf("===============================================\n\n");
+	return err;
+}
+
+/* the largest telemetry transfer of the controller, in blocks */
+static size_t telemetry_transfer_size(struct nvme_dev *dev)
+{
+	size_t max_data_tx;
+
+	if (nvme_get_telemetry_max(dev_fd(dev), NULL, &max_data_tx) || !max_data_tx)
+		return TELEMETRY_TRANSFER_SIZE;
+	if (max_data_tx > TELEMETRY_MAX_TRANSFER_SIZE)
+		max_data_tx = TELEMETRY_MAX_TRANSFER_SIZE;
+	max_data_tx -= max_data_tx % TELEMETRY_BYTE_PER_BLOCK;
+	return max(max_data_tx, (size_t)TELEMETRY_TRANSFER_SIZE);
 }
 
+/*
+ * The dump is read in transfersize chunks into a ring of buffers that a
+ * helper thread writes to the file while the next chunks are read.
+ */
 static int extract_dump_get_log(struct nvme_dev *dev, char *featurename, char *filename, char *sn,
-				int dumpsize, int transfersize, __u32 nsid, __u8 log_id,
+				__u64 dumpsize, size_t transfersize, __u32 nsid, __u8 log_id,
 				__u8 lsp, __u64 offset, bool rae)
 {
-	int i = 0, err = 0;
-
-	char *data = calloc(transfersize, sizeof(char));
 	char filepath[FILE_NAME_SIZE] = {0,};
-	int output = 0;
-	int total_loop_cnt = dumpsize / transfersize;
-	int last_xfer_size = dumpsize % transfersize;
-
-	if (last_xfer_size)
-		total_loop_cnt++;
-	else
-		last_xfer_size = transfersize;
+	__u64 done = 0;
+	struct nvme_stream s;
+	int output, err = 0, serr;
+	size_t len;
+	void *data;
 
 	if (filename == 0)
 		snprintf(filepath, FILE_NAME_SIZE, "%s_%s.bin", featurename, sn);
 	else
 		snprintf(filepath, FILE_NAME_SIZE, "%s%s_%s.bin", filename, featurename, sn);
 
-	for (i = 0; i < total_loop_cnt; i++) {
-		memset(data, 0, transfersize);
+	output = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (output < 0)
+		return -13;
 
+	err = nvme_stream_init(&s, output, NVME_STREAM_TO_FILE, dumpsize, transfersize, 4);
+	if (err) {
+		close(output);
+		unlink(filepath);
+		return err;
+	}
+
+	while ((data = nvme_stream_get(&s, &len))) {
 		struct nvme_get_log_args args = {
 			.lpo = offset,
 			.result = NULL,
-			.log = (void *)data,
+			.log = data,
 			.args_size = sizeof(args),
 			.fd = dev_fd(dev),
 			.lid = log_id,
-			.len = transfersize,
+			.len = len,
 			.nsid = nsid,
 			.lsp = lsp,
 			.uuidx = 0,
@@ -1104,46 +1496,32 @@ static int extract_dump_get_log(struct nvme_dev *dev, char *featurename, char *f
 		};
 
 		err = nvme_get_log(&args);
-		if (err) {
-			if (i > 0)
-				goto close_output;
-			else
-				goto end;
-		}
-
-		if (i != total_loop_cnt - 1) {
-			if (!i) {
-				output = open(filepath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-				if (output < 0) {
-					err = -13;
-					goto end;
-				}
-			}
-			if (write(output, data, transfersize) < 0) {
-				err = -10;
-				goto close_output;
-			}
-		} else {
-			if (write(output, data, last_xfer_size) < 0) {
-				err = -10;
-				goto close_output;
-			}
-		}
-		offset += transfersize;
-		printf("%d%%\r", (i + 1) * 100 / total_loop_cnt);
+		if (err)
+			break;
+		nvme_stream_put(&s, len);
+		offset += len;
+		done += len;
+		printf("%d%%\r", (int)(done * 100 / dumpsize));
 	}
-	printf("100%%\nThe log file was saved at \"%s\"\n", filepath);
 
-close_output:
+	serr = nvme_stream_finish(&s, err);
 	close(output);
+	if (err) {
+		/* nothing was saved */
+		if (!done)
+			unlink(filepath);
+		return err;
+	}
+	if (serr)
+		return -10;
 
-end:
-	free(data);
-	return err;
+	printf("100%%\nThe log file was saved at \"%s\"\n", filepath);
+	return 0;
 }
 
 static int get_telemetry_dump(struct nvme_dev *dev, char *filename, char *sn,
-			      enum TELEMETRY_TYPE tele_type, int data_area, bool header_print)
+			      enum TELEMETRY_TYPE tele_type, int data_area, bool header_print,
+			      const struct ocp_c9_strings *strings)
 {
 	__u32 err = 0, nsid = 0;
 	__u8 lsp = 0, rae = 0;
@@ -1155,6 +1533,9 @@ static int get_telemetry_dump(struct nvme_dev *dev, char *filename, char *sn,
 	struct telemetry_data_area_1 *da1 = (struct telemetry_data_area_1 *)data1;
 	__u64 offset = 0, size = 0;
 	char dumpname[FILE_NAME_SIZE] = { 0 };
+	_cleanup_free_ void *buf = NULL;
+	size_t chunk;
+	int da;
 
 	if (tele_type == TELEMETRY_TYPE_HOST_0) {
 		featurename = "Host(0)";
@@ -1184,36 +1565,29 @@ static int get_telemetry_dump(struct nvme_dev *dev, char *filename, char *sn,
 	if (err)
 		return err;
 	print_telemetry_data_area_1(da1, tele_type);
-	char *da1_stat = calloc((da1->da1_stat_size * 4), sizeof(char));
-	err = get_telemetry_data(dev, nsid, tele_type, (da1->da1_stat_size) * 4,
-				(void *)da1_stat, lsp, rae, (da1->da1_stat_start) * 4);
-	if (err)
-		return err;
-	print_telemetry_da1_stat((void *)da1_stat, tele_type, (da1->da1_stat_size) * 4);
-	for (i = 0; i < 17 ; i++){
-		if (da1->event_fifo_da[i] == 1){
-			char *da1_fifo = calloc((da1->event_fifo_size[i]) * 4, sizeof(char));
-			err = get_telemetry_data(dev, nsid, tele_type, (da1->event_fifo_size[i]) * 4,
-				(void *)da1_stat, lsp, rae, (da1->event_fifo_start[i]) * 4);
-			if (err)
-				return err;
-			print_telemetry_da1_fifo((void *)da1_fifo, tele_type, (da1->event_fifo_size[i]) * 4);
-		}
-	}
-	char *da2_stat = calloc((da1->da2_stat_size * 4), sizeof(char));
-	err = get_telemetry_data(dev, nsid, tele_type, (da1->da2_stat_size) * 4,
-				(void *)da2_stat, lsp, rae, (da1->da2_stat_start) * 4);
-	if (err)
-		return err;
-	print_telemetry_da2_stat((void *)da2_stat, tele_type, (da1->da2_stat_size) * 4);
-	for (i = 0; i < 17 ; i++){
-		if (da1->event_fifo_da[i] == 2){
-			char *da1_fifo = calloc((da1->event_fifo_size[i]) * 4, sizeof(char));
-			err = get_telemetry_data(dev, nsid, tele_type, (da1->event_fifo_size[i]) * 4,
-				(void *)da1_stat, lsp, rae, (da1->event_fifo_start[i]) * 4);
+
+	chunk = telemetry_transfer_size(dev);
+	buf = nvme_alloc(chunk);
+	if (!buf)
+		return -ENOMEM;
+
+	for (da = 1; da <= 2; da++) {
+		__u16 stat_start = le16_to_cpu(da == 1 ? da1->da1_stat_start : da1->da2_stat_start);
+		__u16 stat_size = le16_to_cpu(da == 1 ? da1->da1_stat_size : da1->da2_stat_size);
+
+		err = telemetry_decode_area(dev, nsid, tele_type, lsp, rae, stat_start * 4,
+					    stat_size * 4, buf, chunk, da, false, strings);
+		if (err)
+			return err;
+		for (i = 0; i < ARRAY_SIZE(da1->event_fifo_da); i++) {
+			if (da1->event_fifo_da[i] != da)
+				continue;
+			err = telemetry_decode_area(dev, nsid, tele_type, lsp, rae,
+						    le64_to_cpu(da1->event_fifo_start[i]) * 4,
+						    le64_to_cpu(da1->event_fifo_size[i]) * 4,
+						    buf, chunk, da, true, strings);
 			if (err)
 				return err;
-			print_telemetry_da2_fifo((void *)da1_fifo, tele_type, (da1->event_fifo_size[i]) * 4);
 		}
 	}
 
@@ -1246,7 +1620,7 @@ static int get_telemetry_dump(struct nvme_dev *dev, char *filename, char *sn,
 	snprintf(dumpname, FILE_NAME_SIZE,
 					"Telemetry_%s_Area_%d", featurename, data_area);
 	err = extract_dump_get_log(dev, dumpname, filename, sn, size * TELEMETRY_BYTE_PER_BLOCK,
-			TELEMETRY_TRANSFER_SIZE, nsid, tele_type,
+			chunk, nsid, tele_type,
 			0, offset, rae);
 
 	return err;
@@ -1269,6 +1643,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 	char sn[21] = {0,};
 	struct nvme_id_ctrl ctrl;
 	bool is_support_telemetry_controller;
+	struct ocp_c9_strings *strings;
 
 	int tele_type = 0;
 	int tele_area = 0;
@@ -1338,13 +1713,16 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		return err;
 	}
 
+	/* the statistics and events are named after the C9 log, if any */
+	strings = ocp_c9_strings_get(dev);
+
 	if (tele_type == TELEMETRY_TYPE_NONE) {
 		printf("\n-------------------------------------------------------------\n");
 		/* Host 0 (lsp == 0) must be executed before Host 1 (lsp == 1). */
 		printf("\nExtracting Telemetry Host 0 Dump (Data Area 1)...\n");
 
 		err = get_telemetry_dump(dev, cfg.file, sn,
-				TELEMETRY_TYPE_HOST_0, 1, true);
+				TELEMETRY_TYPE_HOST_0, 1, true, strings);
 		if (err)
 			fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 
@@ -1353,7 +1731,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		printf("\nExtracting Telemetry Host 0 Dump (Data Area 3)...\n");
 
 		err = get_telemetry_dump(dev, cfg.file, sn,
-				TELEMETRY_TYPE_HOST_0, 3, false);
+				TELEMETRY_TYPE_HOST_0, 3, false, strings);
 		if (err)
 			fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 
@@ -1362,7 +1740,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		printf("\nExtracting Telemetry Host 1 Dump (Data Area 1)...\n");
 
 		err = get_telemetry_dump(dev, cfg.file, sn,
-				TELEMETRY_TYPE_HOST_1, 1, true);
+				TELEMETRY_TYPE_HOST_1, 1, true, strings);
 		if (err)
 			fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 
@@ -1371,7 +1749,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		printf("\nExtracting Telemetry Host 1 Dump (Data Area 3)...\n");
 
 		err = get_telemetry_dump(dev, cfg.file, sn,
-				TELEMETRY_TYPE_HOST_1, 3, false);
+				TELEMETRY_TYPE_HOST_1, 3, false, strings);
 		if (err)
 			fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 
@@ -1381,7 +1759,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 
 		if (is_support_telemetry_controller == true) {
 			err = get_telemetry_dump(dev, cfg.file, sn,
-					TELEMETRY_TYPE_CONTROLLER, 3, true);
+					TELEMETRY_TYPE_CONTROLLER, 3, true, strings);
 			if (err)
 				fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 		}
@@ -1391,7 +1769,7 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		printf("Extracting Telemetry Controller Dump (Data Area %d)...\n", tele_area);
 
 		if (is_support_telemetry_controller == true) {
-			err = get_telemetry_dump(dev, cfg.file, sn, tele_type, tele_area, true);
+			err = get_telemetry_dump(dev, cfg.file, sn, tele_type, tele_area, true, strings);
 			if (err)
 				fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 		}
@@ -1399,11 +1777,12 @@ static int ocp_telemetry_log(int argc, char **argv, struct command *cmd,
 		printf("Extracting Telemetry Host(%d) Dump (Data Area %d)...\n",
 				(tele_type == TELEMETRY_TYPE_HOST_0) ? 0 : 1, tele_area);
 
-		err = get_telemetry_dump(dev, cfg.file, sn, tele_type, tele_area, true);
+		err = get_telemetry_dump(dev, cfg.file, sn, tele_type, tele_area, true, strings);
 		if (err)
 			fprintf(stderr, "NVMe Status: %s(%x)\n", nvme_status_to_string(err, false), err);
 	}
 
+	ocp_c9_strings_free(strings);
 	printf("telemetry-log done.\n");
 
 return err;
@@ -2617,133 +2996,6 @@ static int get_dssd_async_event_config(int argc, char **argv, struct command *cm
 ///////////////////////////////////////////////////////////////////////////////
 /// Telemetry String Log Format Log Page (LID : C9h)
 
-/* C9 Telemetry String Log Format Log Page */
-#define C9_GUID_LENGTH                           16
-#define C9_TELEMETRY_STRING_LOG_ENABLE_OPCODE    0xC9
-#define C9_TELEMETRY_STR_LOG_LEN                 432
-#define C9_TELEMETRY_STR_LOG_SIST_OFST           431
-
-/**
- * struct telemetry_str_log_format - Telemetry String Log Format
- * @log_page_version:          indicates the version of the mapping this log page uses 
- *                             Shall be set to 01h.
- * @reserved1:                 Reserved.
- * @log_page_guid:             Shall be set to B13A83691A8F408B9EA495940057AA44h.
- * @sls:                       Shall be set to the number of DWORDS in the String Log.
- * @reserved2:                 reserved.
- * @sits:                      shall be set to the number of DWORDS in the Statistics 
- *                             Identifier String Table
- * @ests:                      Shall be set to the number of DWORDS from byte 0 of this 
- *                             log page to the start of the Event String Table
- * @estsz:                     shall be set to the number of DWORDS in the Event String Table
- * @vu_eve_sts:                Shall be set to the number of DWORDS from byte 0 of this 
- *                             log page to the start of the VU Event String Table
- * @vu_eve_st_sz:              shall be set to the number of DWORDS in the VU Event String Table
- * @ascts:                     the number of DWORDS from byte 0 of this log page until the ASCII Table Starts.
- * @asctsz:                    the number of DWORDS in the ASCII Table
- * @fifo1:                     FIFO 0 ASCII String
- * @fifo2:                     FIFO 1 ASCII String
- * @fifo3:                     FIFO 2 ASCII String 
- * @fifo4:                     FIFO 3 ASCII String
- * @fif05:                     FIFO 4 ASCII String
- * @fifo6:                     FIFO 5 ASCII String
- * @fifo7:                     FIFO 6 ASCII String
- * @fifo8:                     FIFO 7 ASCII String
- * @fifo9:                     FIFO 8 ASCII String 
- * @fifo10:                    FIFO 9 ASCII String
- * @fif011:                    FIFO 10 ASCII String
- * @fif012:                    FIFO 11 ASCII String
- * @fifo13:                    FIFO 12 ASCII String
- * @fif014:                    FIFO 13 ASCII String
- * @fif015:                    FIFO 14 ASCII String
- * @fif016:                    FIFO 15 ASCII String
- * @reserved3:                 reserved
- */
-struct __attribute__((__packed__)) telemetry_str_log_format {
-	__u8    log_page_version;
-	__u8    reserved1[15];
-	__u8    log_page_guid[C9_GUID_LENGTH];
-	__le64  sls;
-	__u8    reserved2[24];
-	__le64  sits;
-	__le64  sitsz;
-	__le64  ests;
-	__le64  estsz;
-	__le64  vu_eve_sts;
-	__le64  vu_eve_st_sz;
-	__le64  ascts;
-	__le64  asctsz;
-	__u8    fifo1[16];
-	__u8    fifo2[16];
-	__u8    fifo3[16];
-	__u8    fifo4[16];
-	__u8    fifo5[16];
-	__u8    fifo6[16];
-	__u8    fifo7[16];
-	__u8    fifo8[16];
-	__u8    fifo9[16];
-	__u8    fifo10[16];
-	__u8    fifo11[16];
-	__u8    fifo12[16];
-	__u8    fifo13[16];
-	__u8    fifo14[16];
-	__u8    fifo15[16];
-	__u8    fifo16[16];
-	__u8    reserved3[48];
-};
-
-/*
- * struct statistics_id_str_table_entry - Statistics Identifier String Table Entry
- * @vs_si:                    Shall be set the Vendor Unique Statistic Identifier number.
- * @reserved1:                Reserved
- * @ascii_id_len:             Shall be set the number of ASCII Characters that are valid.
- * @ascii_id_ofst:            Shall be set to the offset from DWORD 0/Byte 0 of the Start 
- *                            of the ASCII Table to the first character of the string for 
- *                            this Statistic Identifier string..
- * @reserved2                 reserved
- */
-struct __attribute__((__packed__)) statistics_id_str_table_entry {
-	__le16  vs_si;
-	__u8    reserved1;
-	__u8    ascii_id_len;
-	__le64  ascii_id_ofst;
-	__le32  reserved2;
-};
-
-/*
- * struct event_id_str_table_entry - Event Identifier String Table Entry
- * @deb_eve_class:            Shall be set the Debug Class.
- * @ei:                       Shall be set to the Event Identifier
- * @ascii_id_len:             Shall be set the number of ASCII Characters that are valid.
- * @ascii_id_ofst:            This is the offset from DWORD 0/ Byte 0 of the start of the
- *                            ASCII table to the ASCII data for this identifier
- * @reserved2                 reserved
- */
-struct __attribute__((__packed__)) event_id_str_table_entry {
-	__u8      deb_eve_class;
-	__le16    ei;
-	__u8      ascii_id_len;
-	__le64    ascii_id_ofst;
-	__le32    reserved2;
-};
-
-/*
- * struct vu_event_id_str_table_entry - VU Event Identifier String Table Entry
- * @deb_eve_class:            Shall be set the Debug Class.
- * @vu_ei:                    Shall be set to the VU Event Identifier
- * @ascii_id_len:             Shall be set the number of ASCII Characters that are valid.
- * @ascii_id_ofst:            This is the offset from DWORD 0/ Byte 0 of the start of the 
- *                            ASCII table to the ASCII data for this identifier
- * @reserved                  reserved
- */
-struct __attribute__((__packed__)) vu_event_id_str_table_entry {
-	__u8      deb_eve_class;
-	__le16    vu_ei;
-	__u8      ascii_id_len;
-	__le64    ascii_id_ofst;
-	__le32    reserved;
-};
-
 /* Function declaration for Telemetry String Log Format (LID:C9h) */
 static int ocp_telemetry_str_log_format(int argc, char **argv, struct command *cmd,
 					struct plugin *plugin);
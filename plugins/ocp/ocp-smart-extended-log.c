@@ -9,14 +9,20 @@
 #include "ocp-smart-extended-log.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "common.h"
+#include "nvme.h"
+#include "nvme-archive.h"
 #include "nvme-print.h"
+#include "util/interval.h"
+#include "util/types.h"
 
 /* C0 SCAO Log Page */
-#define C0_SMART_CLOUD_ATTR_LEN			0x200
-#define C0_SMART_CLOUD_ATTR_OPCODE		0xC0
 #define C0_GUID_LENGTH				16
 
 static __u8 scao_guid[C0_GUID_LENGTH] = {
@@ -149,7 +155,7 @@ static void ocp_print_C0_log_normal(void *data)
 	printf("\n");
 }
 
-static void ocp_print_C0_log_json(void *data)
+struct json_object *ocp_smart_c0_json_obj(void *data)
 {
 	struct json_object *root;
 	struct json_object *pmuw;
@@ -245,16 +251,64 @@ static void ocp_print_C0_log_json(void *data)
 		json_object_add_value_uint(root, "Power State Change Count",
 					   le64_to_cpu(*(uint64_t *)&log_data[SCAO_PSCC]));
 	}
+
+	return root;
+}
+
+static void ocp_print_C0_log_json(void *data)
+{
+	struct json_object *root = ocp_smart_c0_json_obj(data);
+
 	json_print_object(root, NULL);
 	printf("\n");
 	json_free_object(root);
 }
 
+bool ocp_smart_c0_guid_valid(void *data)
+{
+	__u8 *log_data = data;
+
+	return !memcmp(&log_data[SCAO_LPG], scao_guid, C0_GUID_LENGTH);
+}
+
+/* check the GUID of the C0 log at @data and print it */
+static int ocp_show_C0_log(__u8 *data, enum nvme_print_flags fmt)
+{
+	int j;
+
+	if (!ocp_smart_c0_guid_valid(data)) {
+		fprintf(stderr, "ERROR : OCP : Unknown GUID in C0 Log Page data\n");
+		fprintf(stderr, "ERROR : OCP : Expected GUID:  0x");
+		for (j = 0; j < 16; j++)
+			fprintf(stderr, "%x", scao_guid[j]);
+
+		fprintf(stderr, "\nERROR : OCP : Actual GUID:    0x");
+		for (j = 0; j < 16; j++)
+			fprintf(stderr, "%x", data[SCAO_LPG + j]);
+		fprintf(stderr, "\n");
+
+		return -1;
+	}
+
+	/* print the data */
+	switch (fmt) {
+	case NORMAL:
+		ocp_print_C0_log_normal(data);
+		break;
+	case JSON:
+		ocp_print_C0_log_json(data);
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
 static int get_c0_log_page(int fd, char *format)
 {
 	enum nvme_print_flags fmt;
 	__u8 *data;
-	int i;
 	int ret;
 
 	ret = validate_output_format(format, &fmt);
@@ -277,46 +331,255 @@ static int get_c0_log_page(int fd, char *format)
 		fprintf(stderr, "NVMe Status:%s(%x)\n",
 			nvme_status_to_string(ret, false), ret);
 
-	if (ret == 0) {
-		/* check log page guid */
-		/* Verify GUID matches */
-		for (i = 0; i < 16; i++) {
-			if (scao_guid[i] != data[SCAO_LPG + i])	{
-				int j;
-
-				fprintf(stderr, "ERROR : OCP : Unknown GUID in C0 Log Page data\n");
-				fprintf(stderr, "ERROR : OCP : Expected GUID:  0x");
-				for (j = 0; j < 16; j++)
-					fprintf(stderr, "%x", scao_guid[j]);
-
-				fprintf(stderr, "\nERROR : OCP : Actual GUID:    0x");
-				for (j = 0; j < 16; j++)
-					fprintf(stderr, "%x", data[SCAO_LPG + j]);
-				fprintf(stderr, "\n");
-
-				ret = -1;
-				goto out;
-			}
-		}
+	if (ret == 0)
+		ret = ocp_show_C0_log(data, fmt);
+	else
+		fprintf(stderr, "ERROR : OCP : Unable to read C0 data from buffer\n");
+
+	free(data);
+	return ret;
+}
+
+static int ocp_C0_show_capture(void *data, size_t len, const char *file, void *arg)
+{
+	return ocp_show_C0_log(data, *(enum nvme_print_flags *)arg);
+}
+
+static struct json_object *ocp_C0_capture_json(void *data, size_t len)
+{
+	return ocp_smart_c0_guid_valid(data) ? ocp_smart_c0_json_obj(data) : NULL;
+}
+
+static struct nvme_capture_decoder ocp_C0_decoder = {
+	.name	= "ocp-smart-add-log",
+	.keys	= NVME_CAPTURE_KEYS("smart-add-log", "log-0xc0", "c0"),
+	.size	= C0_SMART_CLOUD_ATTR_LEN,
+	.json	= ocp_C0_capture_json,
+};
+NVME_CAPTURE_DECODER(ocp_C0_decoder)
+
+/*
+ * smart-add-log --interval: sample the C0 and SMART logs on a fixed
+ * schedule, optionally appending a compact binary snapshot of the wear
+ * counters of every sample to a file, and report the NAND and host write
+ * rates, the write amplification and the projected end of life.
+ *
+ * The snapshot file starts with a struct c0_snapshot_file_hdr followed by
+ * struct c0_snapshot records, all fields little endian, the 128-bit
+ * counters as in the logs.
+ */
+#define C0_SNAPSHOT_MAGIC	"OCPC0SN1"
+
+struct __packed c0_snapshot_file_hdr {
+	char magic[8];
+	char sn[20];
+	char fr[8];
+	__le32 record_size;
+};
+
+struct __packed c0_snapshot {
+	__le64 timestamp_ms;
+	__u8 pmuw[16];		/* physical media bytes written */
+	__u8 pmur[16];		/* physical media bytes read */
+	__u8 duw[16];		/* SMART data units written */
+	__u8 eest[16];		/* endurance estimate, bytes */
+	__le32 max_erase;
+	__le32 min_erase;
+	__u8 percent_used;	/* SMART */
+	__u8 sys_percent_used;
+	__u8 percent_free_blocks;
+	__u8 rsvd[13];
+};
+
+/* the logs read every sample, allocated once */
+struct c0_sample_buf {
+	__u8 c0[C0_SMART_CLOUD_ATTR_LEN];
+	struct nvme_smart_log smart;
+	struct c0_snapshot first, prev, cur;
+};
+
+static int c0_snapshot_read(struct nvme_dev *dev, struct c0_sample_buf *b,
+			    struct c0_snapshot *snap)
+{
+	struct timespec ts;
+	int err;
+
+	err = nvme_get_log_simple(dev_fd(dev), C0_SMART_CLOUD_ATTR_OPCODE,
+				  C0_SMART_CLOUD_ATTR_LEN, b->c0);
+	if (err)
+		return err;
+	if (!ocp_smart_c0_guid_valid(b->c0)) {
+		fprintf(stderr, "ERROR : OCP : Unknown GUID in C0 Log Page data\n");
+		return -EINVAL;
+	}
+	err = nvme_get_log_smart(dev_fd(dev), NVME_NSID_ALL, false, &b->smart);
+	if (err)
+		return err;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(snap, 0, sizeof(*snap));
+	snap->timestamp_ms = cpu_to_le64(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+	memcpy(snap->pmuw, &b->c0[SCAO_PMUW], 16);
+	memcpy(snap->pmur, &b->c0[SCAO_PMUR], 16);
+	memcpy(snap->duw, b->smart.data_units_written, 16);
+	memcpy(snap->eest, &b->c0[SCAO_EEST], 16);
+	memcpy(&snap->max_erase, &b->c0[SCAO_MXUDEC], 4);
+	memcpy(&snap->min_erase, &b->c0[SCAO_MNUDEC], 4);
+	snap->percent_used = b->smart.percent_used;
+	snap->sys_percent_used = b->c0[SCAO_SDPU];
+	snap->percent_free_blocks = b->c0[SCAO_PFB];
+
+	return 0;
+}
+
+/* appends to an existing file of the same controller and record layout */
+static int c0_snapshot_open(const char *path, struct nvme_dev *dev)
+{
+	struct c0_snapshot_file_hdr hdr = { 0 }, old;
+	struct nvme_id_ctrl ctrl;
+	ssize_t n;
+	int fd, err;
+
+	err = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	if (err)
+		return err;
+
+	memcpy(hdr.magic, C0_SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	memcpy(hdr.sn, ctrl.sn, sizeof(hdr.sn));
+	memcpy(hdr.fr, ctrl.fr, sizeof(hdr.fr));
+	hdr.record_size = cpu_to_le32(sizeof(struct c0_snapshot));
+
+	fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR : OCP : %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+
+	n = read(fd, &old, sizeof(old));
+	if (!n && write(fd, &hdr, sizeof(hdr)) == sizeof(hdr))
+		return fd;
+	if (n == sizeof(old) && !memcmp(old.magic, hdr.magic, sizeof(hdr.magic)) &&
+	    !memcmp(old.sn, hdr.sn, sizeof(hdr.sn)) &&
+	    old.record_size == hdr.record_size)
+		return fd;
+
+	fprintf(stderr, "ERROR : OCP : %s is not a C0 snapshot file of this device\n", path);
+	close(fd);
+	return -EINVAL;
+}
+
+static long double c0_rate(const __u8 *cur, const __u8 *prev, long double secs)
+{
+	long double d = int128_to_double((__u8 *)cur) - int128_to_double((__u8 *)prev);
 
-		/* print the data */
-		switch (fmt) {
-		case NORMAL:
-			ocp_print_C0_log_normal(data);
+	return secs > 0 && d > 0 ? d / secs : 0;
+}
+
+static void c0_sample_print(const struct c0_sample_buf *b, enum nvme_print_flags fmt)
+{
+	long double secs = (le64_to_cpu(b->cur.timestamp_ms) -
+			    le64_to_cpu(b->prev.timestamp_ms)) / 1000.0L;
+	long double total = (le64_to_cpu(b->cur.timestamp_ms) -
+			     le64_to_cpu(b->first.timestamp_ms)) / 1000.0L;
+	/* data units are thousands of 512 byte blocks */
+	long double nand = c0_rate(b->cur.pmuw, b->prev.pmuw, secs);
+	long double host = c0_rate(b->cur.duw, b->prev.duw, secs) * 512000;
+	long double host_total = int128_to_double((__u8 *)b->cur.duw) * 512000;
+	long double pmuw = int128_to_double((__u8 *)b->cur.pmuw);
+	long double eest = int128_to_double((__u8 *)b->cur.eest);
+	/* the end of life is projected at the NAND write rate of the whole run */
+	long double avg = c0_rate(b->cur.pmuw, b->first.pmuw, total);
+	long double waf = host > 0 ? nand / host : 0;
+	long double waf_life = host_total > 0 ? pmuw / host_total : 0;
+	long double eol_days = avg > 0 && eest > pmuw ? (eest - pmuw) / avg / 86400 : -1;
+	char eol[32] = "";
+	struct json_object *r;
+
+	if (eol_days >= 0 && eol_days < 365.0L * 1000) {
+		time_t t = le64_to_cpu(b->cur.timestamp_ms) / 1000 + (time_t)(eol_days * 86400);
+		struct tm tm;
+
+		strftime(eol, sizeof(eol), "%Y-%m-%d", localtime_r(&t, &tm));
+	}
+
+	if (fmt != JSON) {
+		printf("%" PRIu64 " nand %.0Lf B/s host %.0Lf B/s waf %.3Lf lifetime waf %.3Lf used %u%% eol %s\n",
+		       (uint64_t)le64_to_cpu(b->cur.timestamp_ms), nand, host, waf, waf_life,
+		       b->cur.percent_used, *eol ? eol : "-");
+		fflush(stdout);
+		return;
+	}
+
+	r = json_create_object();
+	json_object_add_value_uint64(r, "timestamp_ms", le64_to_cpu(b->cur.timestamp_ms));
+	json_object_add_value_uint64(r, "interval_ms", (uint64_t)(secs * 1000));
+	json_object_add_value_double(r, "nand_bytes_written_per_sec", nand);
+	json_object_add_value_double(r, "host_bytes_written_per_sec", host);
+	json_object_add_value_double(r, "waf", waf);
+	json_object_add_value_double(r, "lifetime_waf", waf_life);
+	json_object_add_value_uint(r, "percent_used", b->cur.percent_used);
+	json_object_add_value_uint(r, "system_data_percent_used", b->cur.sys_percent_used);
+	if (eest > 0)
+		json_object_add_value_double(r, "endurance_used_percent", pmuw * 100 / eest);
+	if (*eol) {
+		json_object_add_value_double(r, "eol_days", eol_days);
+		json_object_add_value_string(r, "eol_date", eol);
+	}
+	util_json_write_record(stdout, r, true);
+	fflush(stdout);
+}
+
+static int c0_sampler(struct nvme_dev *dev, __u32 interval, __u32 count,
+		      const char *snapshot_file, enum nvme_print_flags fmt)
+{
+	_cleanup_free_ struct c0_sample_buf *b = NULL;
+	__u64 next;
+	int fd = -1, err;
+	__u32 n;
+
+	b = nvme_alloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+
+	if (snapshot_file) {
+		fd = c0_snapshot_open(snapshot_file, dev);
+		if (fd < 0)
+			return fd;
+	}
+
+	err = c0_snapshot_read(dev, b, &b->first);
+	if (err)
+		goto out;
+	b->prev = b->first;
+	if (fd >= 0 && write(fd, &b->first, sizeof(b->first)) != sizeof(b->first)) {
+		err = -errno;
+		goto out;
+	}
+
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		next += interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
 			break;
-		case JSON:
-			ocp_print_C0_log_json(data);
+
+		err = c0_snapshot_read(dev, b, &b->cur);
+		if (err)
 			break;
-		default:
+		if (fd >= 0 && write(fd, &b->cur, sizeof(b->cur)) != sizeof(b->cur)) {
+			err = -errno;
 			break;
 		}
-	} else {
-		fprintf(stderr, "ERROR : OCP : Unable to read C0 data from buffer\n");
+		c0_sample_print(b, fmt);
+		b->prev = b->cur;
 	}
 
+	nvme_stop_release();
 out:
-	free(data);
-	return ret;
+	if (fd >= 0)
+		close(fd);
+	return err;
 }
 
 int ocp_smart_add_log(int argc, char **argv, struct command *cmd,
@@ -326,23 +589,66 @@ int ocp_smart_add_log(int argc, char **argv, struct command *cmd,
 	struct nvme_dev *dev;
 	int ret = 0;
 
+	const char *interval = "Seconds between two samples, enables sampling";
+	const char *count = "Number of samples, 0 to sample until interrupted";
+	const char *snapshot_file = "Append a binary snapshot of every sample to this file";
+	const char *input = "Comma separated C0 log captures to decode";
+	enum nvme_print_flags fmt;
+
 	struct config {
 		char *output_format;
+		__u32 interval;
+		__u32 count;
+		char *snapshot_file;
+		char *input_file;
 	};
 
 	struct config cfg = {
 		.output_format = "normal",
+		.interval = 0,
+		.count = 0,
+		.snapshot_file = NULL,
+		.input_file = NULL,
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_FMT("output-format", 'o', &cfg.output_format, "output Format: normal|json"),
+		OPT_UINT("interval", 'i', &cfg.interval, interval),
+		OPT_UINT("count", 'c', &cfg.count, count),
+		OPT_FILE("snapshot-file", 's', &cfg.snapshot_file, snapshot_file),
+		OPT_LIST("input-file", 0, &cfg.input_file, input),
 		OPT_END()
 	};
 
-	ret = parse_and_open(&dev, argc, argv, desc, opts);
+	ret = parse_and_open_input(&dev, argc, argv, desc, opts, &cfg.input_file);
 	if (ret)
 		return ret;
 
+	if (cfg.input_file) {
+		ret = validate_output_format(cfg.output_format, &fmt);
+		if (ret < 0) {
+			fprintf(stderr, "ERROR : OCP : invalid output format\n");
+			return ret;
+		}
+		return nvme_decode_captures(cfg.input_file, C0_SMART_CLOUD_ATTR_LEN, false,
+					    "a C0 log page", ocp_C0_show_capture, &fmt);
+	}
+
+	if (cfg.interval) {
+		ret = validate_output_format(cfg.output_format, &fmt);
+		if (ret < 0) {
+			fprintf(stderr, "ERROR : OCP : invalid output format\n");
+			dev_close(dev);
+			return ret;
+		}
+		ret = c0_sampler(dev, cfg.interval, cfg.count, cfg.snapshot_file, fmt);
+		if (ret)
+			fprintf(stderr, "ERROR : OCP : Failure sampling the C0 Log Page, ret = %d\n",
+				ret);
+		dev_close(dev);
+		return ret;
+	}
+
 	ret = get_c0_log_page(dev_fd(dev), cfg.output_format);
 	if (ret)
 		fprintf(stderr, "ERROR : OCP : Failure reading the C0 Log Page, ret = %d\n",
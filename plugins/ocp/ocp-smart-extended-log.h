@@ -9,10 +9,21 @@
 #ifndef OCP_SMART_EXTENDED_LOG_H
 #define OCP_SMART_EXTENDED_LOG_H
 
+#include <stdbool.h>
+
+/* C0 SCAO Log Page */
+#define C0_SMART_CLOUD_ATTR_LEN			0x200
+#define C0_SMART_CLOUD_ATTR_OPCODE		0xC0
+
 struct command;
 struct plugin;
+struct json_object;
 
 int ocp_smart_add_log(int argc, char **argv, struct command *cmd,
 	struct plugin *plugin);
 
+/* decoded C0 log fields, as printed by smart-add-log -o json */
+struct json_object *ocp_smart_c0_json_obj(void *data);
+bool ocp_smart_c0_guid_valid(void *data);
+
 #endif
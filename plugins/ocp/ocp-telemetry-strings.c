@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "nvme.h"
+#include "libnvme.h"
+#include "util/cache.h"
+#include "util/cleanup.h"
+
+#include "ocp-telemetry-strings.h"
+
+/*
+ * The index is an open addressing hash table of the identifiers, followed
+ * by a copy of the ASCII table of the log the strings point into. It is
+ * stored as is in the cache, so a cache hit is a single read and no
+ * parsing. Keys carry the table the identifier comes from, they are never
+ * 0, which marks a free slot.
+ */
+#define C9_KEY_STAT		1
+#define C9_KEY_EVENT		2
+#define C9_KEY_VU_EVENT		3
+
+/* larger String Logs are not indexed */
+#define C9_MAX_LOG_LEN		(16 << 20)
+
+#define OCP_STRING_CACHE_DIR	RUNDIR "/nvme-cli/ocp-strings"
+#define OCP_STRING_CACHE_KEY_LEN	64
+
+struct c9_slot {
+	__u32 key;
+	__u32 ofst;		/* in the ASCII table */
+	__u32 len;
+};
+
+struct c9_index_hdr {
+	__u32 nr_slots;		/* a power of 2 */
+	__u32 ascii_len;
+};
+
+struct ocp_c9_strings {
+	struct c9_index_hdr *hdr;
+	struct c9_slot *slots;
+	const char *ascii;
+};
+
+static __u32 c9_key(int table, __u8 class, __u16 id)
+{
+	return table << 24 | class << 16 | id;
+}
+
+static __u32 c9_hash(__u32 key, __u32 nr_slots)
+{
+	return (key * 0x9e3779b1U) & (nr_slots - 1);
+}
+
+static const char *c9_lookup(const struct ocp_c9_strings *s, __u32 key, int *len)
+{
+	__u32 mask, i;
+
+	if (!s)
+		return NULL;
+
+	mask = s->hdr->nr_slots - 1;
+	for (i = c9_hash(key, s->hdr->nr_slots); s->slots[i].key; i = (i + 1) & mask) {
+		if (s->slots[i].key == key) {
+			*len = s->slots[i].len;
+			return s->ascii + s->slots[i].ofst;
+		}
+	}
+
+	return NULL;
+}
+
+const char *ocp_c9_stat_str(const struct ocp_c9_strings *s, __u16 id, int *len)
+{
+	return c9_lookup(s, c9_key(C9_KEY_STAT, 0, id), len);
+}
+
+const char *ocp_c9_event_str(const struct ocp_c9_strings *s, __u8 class, __u16 id,
+			     int *len)
+{
+	return c9_lookup(s, c9_key(C9_KEY_EVENT, class, id), len) ?:
+	       c9_lookup(s, c9_key(C9_KEY_VU_EVENT, class, id), len);
+}
+
+static struct ocp_c9_strings *c9_index_open(void *buf, size_t len)
+{
+	struct c9_index_hdr *hdr = buf;
+	struct ocp_c9_strings *s;
+	__u32 i, nr_free = 0;
+	size_t slots_len;
+
+	if (len < sizeof(*hdr) || !hdr->nr_slots ||
+	    hdr->nr_slots & (hdr->nr_slots - 1) ||
+	    hdr->nr_slots > (len - sizeof(*hdr)) / sizeof(struct c9_slot))
+		return NULL;
+	slots_len = hdr->nr_slots * sizeof(struct c9_slot);
+	if (len != sizeof(*hdr) + slots_len + hdr->ascii_len)
+		return NULL;
+
+	s = malloc(sizeof(*s));
+	if (!s)
+		return NULL;
+	s->hdr = hdr;
+	s->slots = (struct c9_slot *)(hdr + 1);
+	s->ascii = (const char *)s->slots + slots_len;
+
+	/* a full table would never end a lookup */
+	for (i = 0; i < hdr->nr_slots; i++) {
+		if (!s->slots[i].key)
+			nr_free++;
+		else if (s->slots[i].ofst > hdr->ascii_len ||
+			 s->slots[i].len > hdr->ascii_len - s->slots[i].ofst)
+			goto bad;
+	}
+	if (!nr_free)
+		goto bad;
+
+	return s;
+bad:
+	free(s);
+	return NULL;
+}
+
+static size_t c9_index_len(const struct ocp_c9_strings *s)
+{
+	return sizeof(*s->hdr) + s->hdr->nr_slots * sizeof(struct c9_slot) +
+	       s->hdr->ascii_len;
+}
+
+void ocp_c9_strings_free(struct ocp_c9_strings *s)
+{
+	if (!s)
+		return;
+	free(s->hdr);
+	free(s);
+}
+
+/* a table of 16 byte entries at @start of @size dwords inside the log */
+static const __u8 *c9_table(const __u8 *log, size_t len, __le64 start, __le64 size,
+			    size_t *nr)
+{
+	__u64 ofst = le64_to_cpu(start) * 4, bytes = le64_to_cpu(size) * 4;
+
+	*nr = 0;
+	if (!bytes || ofst > len || bytes > len - ofst)
+		return NULL;
+	*nr = bytes / sizeof(struct statistics_id_str_table_entry);
+	return log + ofst;
+}
+
+static void c9_insert(struct ocp_c9_strings *s, __u32 key, __u64 ofst, __u8 len)
+{
+	__u32 mask = s->hdr->nr_slots - 1, i;
+
+	/* identifiers without a valid string are left out */
+	if (!len || ofst > s->hdr->ascii_len || len > s->hdr->ascii_len - ofst)
+		return;
+
+	for (i = c9_hash(key, s->hdr->nr_slots); s->slots[i].key; i = (i + 1) & mask)
+		if (s->slots[i].key == key)
+			return;
+
+	s->slots[i].key = key;
+	s->slots[i].ofst = ofst;
+	s->slots[i].len = len;
+}
+
+struct ocp_c9_strings *ocp_c9_strings_build(const void *log, size_t len)
+{
+	const struct telemetry_str_log_format *hdr = log;
+	const __u8 *stats, *events, *vu_events, *ascii;
+	size_t nr_stats, nr_events, nr_vu_events, nr_ascii, nr, i;
+	struct ocp_c9_strings *s;
+	__u32 nr_slots = 1;
+	void *buf;
+
+	if (len < sizeof(*hdr))
+		return NULL;
+
+	stats = c9_table(log, len, hdr->sits, hdr->sitsz, &nr_stats);
+	events = c9_table(log, len, hdr->ests, hdr->estsz, &nr_events);
+	vu_events = c9_table(log, len, hdr->vu_eve_sts, hdr->vu_eve_st_sz, &nr_vu_events);
+	ascii = c9_table(log, len, hdr->ascts, hdr->asctsz, &nr_ascii);
+	if (!ascii)
+		return NULL;
+
+	/* at most half full, so the probes stay short */
+	nr = nr_stats + nr_events + nr_vu_events;
+	while (nr_slots < 2 * nr + 1)
+		nr_slots <<= 1;
+
+	buf = calloc(1, sizeof(struct c9_index_hdr) + nr_slots * sizeof(struct c9_slot) +
+		     le64_to_cpu(hdr->asctsz) * 4);
+	if (!buf)
+		return NULL;
+	((struct c9_index_hdr *)buf)->nr_slots = nr_slots;
+	((struct c9_index_hdr *)buf)->ascii_len = le64_to_cpu(hdr->asctsz) * 4;
+
+	s = malloc(sizeof(*s));
+	if (!s) {
+		free(buf);
+		return NULL;
+	}
+	s->hdr = buf;
+	s->slots = (struct c9_slot *)(s->hdr + 1);
+	s->ascii = (const char *)(s->slots + nr_slots);
+	memcpy((char *)s->ascii, ascii, s->hdr->ascii_len);
+
+	for (i = 0; i < nr_stats; i++) {
+		const struct statistics_id_str_table_entry *e = (const void *)(stats + i * 16);
+
+		c9_insert(s, c9_key(C9_KEY_STAT, 0, le16_to_cpu(e->vs_si)),
+			  le64_to_cpu(e->ascii_id_ofst), e->ascii_id_len);
+	}
+	for (i = 0; i < nr_events; i++) {
+		const struct event_id_str_table_entry *e = (const void *)(events + i * 16);
+
+		c9_insert(s, c9_key(C9_KEY_EVENT, e->deb_eve_class, le16_to_cpu(e->ei)),
+			  le64_to_cpu(e->ascii_id_ofst), e->ascii_id_len);
+	}
+	for (i = 0; i < nr_vu_events; i++) {
+		const struct vu_event_id_str_table_entry *e = (const void *)(vu_events + i * 16);
+
+		c9_insert(s, c9_key(C9_KEY_VU_EVENT, e->deb_eve_class, le16_to_cpu(e->vu_ei)),
+			  le64_to_cpu(e->ascii_id_ofst), e->ascii_id_len);
+	}
+
+	return s;
+}
+
+static struct ocp_c9_strings *c9_strings_read(struct nvme_dev *dev)
+{
+	struct telemetry_str_log_format hdr;
+	_cleanup_free_ void *log = NULL;
+	__u64 len;
+
+	if (nvme_get_log_simple(dev_fd(dev), C9_TELEMETRY_STRING_LOG_ENABLE_OPCODE,
+				sizeof(hdr), &hdr))
+		return NULL;
+
+	len = le64_to_cpu(hdr.sls) * 4;
+	if (len < sizeof(hdr) || len > C9_MAX_LOG_LEN)
+		return NULL;
+
+	log = nvme_alloc(len);
+	if (!log ||
+	    nvme_get_log_simple(dev_fd(dev), C9_TELEMETRY_STRING_LOG_ENABLE_OPCODE, len, log))
+		return NULL;
+
+	return ocp_c9_strings_build(log, len);
+}
+
+/* the identify fields are space padded, the path uses them trimmed */
+static int c9_cache_field(char *dst, size_t size, const char *src, size_t len)
+{
+	size_t i;
+
+	while (len && (src[len - 1] == ' ' || !src[len - 1]))
+		len--;
+	if (!len || len >= size)
+		return -1;
+	for (i = 0; i < len; i++)
+		dst[i] = src[i] == '/' || (src[i] == '.' && !i) ? '_' : src[i];
+	dst[len] = '\0';
+	return 0;
+}
+
+struct ocp_c9_strings *ocp_c9_strings_get(struct nvme_dev *dev)
+{
+	const char *base = getenv("NVME_OCP_STRING_CACHE");
+	char key[OCP_STRING_CACHE_KEY_LEN];
+	char path[PATH_MAX], dir[PATH_MAX];
+	char sn[sizeof(((struct nvme_id_ctrl *)0)->sn) + 1];
+	char fr[sizeof(((struct nvme_id_ctrl *)0)->fr) + 1];
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	struct ocp_c9_strings *s;
+	void *buf;
+	size_t len;
+
+	if (!base)
+		return c9_strings_read(dev);
+	if (!*base)
+		base = OCP_STRING_CACHE_DIR;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl || nvme_identify_ctrl(dev_fd(dev), ctrl) ||
+	    c9_cache_field(sn, sizeof(sn), ctrl->sn, sizeof(ctrl->sn)) ||
+	    c9_cache_field(fr, sizeof(fr), ctrl->fr, sizeof(ctrl->fr)))
+		return c9_strings_read(dev);
+
+	snprintf(dir, sizeof(dir), "%s", base);
+	if (cache_dir_init(dir) ||
+	    snprintf(path, sizeof(path), "%s/%s-%s", dir, sn, fr) >= (int)sizeof(path))
+		return c9_strings_read(dev);
+
+	memset(key, 0, sizeof(key));
+	snprintf(key, sizeof(key), "ocp-c9-strings 1\n%s\n%s\n", sn, fr);
+
+	buf = cache_read_alloc(path, key, sizeof(key), &len);
+	if (buf) {
+		s = c9_index_open(buf, len);
+		if (s)
+			return s;
+		free(buf);
+	}
+
+	s = c9_strings_read(dev);
+	if (s)
+		cache_write(path, key, sizeof(key), s->hdr, c9_index_len(s));
+
+	return s;
+}
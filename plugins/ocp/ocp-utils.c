@@ -7,6 +7,7 @@
 
 #include <unistd.h>
 #include <errno.h>
+#include "nvme-wrap.h"
 #include "ocp-utils.h"
 
 const unsigned char ocp_uuid[NVME_UUID_LEN] = {
@@ -29,7 +30,7 @@ int ocp_find_uuid_index(struct nvme_id_uuid_list *uuid_list, __u8 *index)
 int ocp_get_uuid_index(struct nvme_dev *dev, __u8 *index)
 {
 	struct nvme_id_uuid_list uuid_list;
-	int err = nvme_identify_uuid(dev_fd(dev), &uuid_list);
+	int err = nvme_cli_identify_uuid(dev, &uuid_list);
 
 	*index = 0;
 	if (err)
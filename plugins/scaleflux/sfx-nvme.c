@@ -13,6 +13,7 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <time.h>
+#include <signal.h>
 
 #include "common.h"
 #include "nvme.h"
@@ -21,6 +22,7 @@
 #include "linux/types.h"
 #include "nvme-wrap.h"
 #include "nvme-print.h"
+#include "util/interval.h"
 #include "util/cleanup.h"
 
 #define CREATE_CMD
@@ -826,20 +828,115 @@ static void show_cap_info(struct sfx_freespace_ctx *ctx)
 	printf("map_unit                 :0x%"PRIx64"K\n", (uint64_t)(ctx->map_unit * 4));
 }
 
+/* compressed data: the app data written for each 4K of flash written */
+static double cap_comp_ratio(const struct sfx_freespace_ctx *ctx)
+{
+	return ctx->hw_used ? (double)ctx->app_written / ctx->hw_used : 0;
+}
+
+static void show_cap_sample(const struct sfx_freespace_ctx *ctx, __u8 usage_pct,
+			    __u64 timestamp_ms, double min_ratio, bool json)
+{
+	double ratio = cap_comp_ratio(ctx);
+	bool alert = min_ratio && ctx->hw_used && ratio < min_ratio;
+
+	if (json) {
+		struct json_object *r = json_create_object();
+
+		json_object_add_value_uint64(r, "timestamp_ms", timestamp_ms);
+		json_object_add_value_double(r, "compression_ratio", ratio);
+		json_object_add_value_uint64(r, "app_written_bytes", ctx->app_written << SFX_PAGE_SHIFT);
+		json_object_add_value_uint64(r, "hw_used_bytes", ctx->hw_used << SFX_PAGE_SHIFT);
+		json_object_add_value_uint64(r, "free_space_bytes", ctx->free_space << SECTOR_SHIFT);
+		json_object_add_value_uint64(r, "phy_space_bytes", ctx->phy_space << SECTOR_SHIFT);
+		json_object_add_value_uint(r, "physical_usage_pct", usage_pct);
+		json_object_add_value_int(r, "alert", alert);
+		util_json_write_record(stdout, r, true);
+	} else {
+		printf("%" PRIu64 " ratio %.2f free %lluGB used %u%%%s\n", (uint64_t)timestamp_ms,
+		       ratio, IDEMA_CAP2GB(ctx->free_space), usage_pct,
+		       alert ? " ALERT" : "");
+	}
+	fflush(stdout);
+}
+
+/*
+ * query-cap --interval: sample the capacity info and the physical usage of
+ * the SMART log through the same fd and buffers, and warn on stderr when
+ * the compression ratio falls below @min_ratio and when it recovers.
+ */
+static int cap_monitor(struct nvme_dev *dev, __u32 interval, __u32 count, double min_ratio,
+		       bool json)
+{
+	struct nvme_additional_smart_log smart_log;
+	struct sfx_freespace_ctx ctx;
+	bool below = false, alert;
+	__u64 next;
+	struct timespec ts;
+	__u32 n;
+	int err = 0;
+
+	nvme_stop_catch(true, NULL);
+
+	next = monotonic_ns();
+	for (n = 0; !count || n < count; n++) {
+		if (n) {
+			next += interval * NSEC_PER_SEC;
+			if (!nvme_interval_wait(next))
+				break;
+		}
+
+		memset(&ctx, 0, sizeof(ctx));
+		if (nvme_query_cap(dev_fd(dev), 0xffffffff, sizeof(ctx), &ctx)) {
+			perror("sfx-query-cap");
+			err = -1;
+			break;
+		}
+		if (nvme_get_nsid_log(dev_fd(dev), false, 0xca, 0xffffffff,
+				      sizeof(smart_log), &smart_log))
+			smart_log.physical_usage_ratio.norm = 0;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		show_cap_sample(&ctx, smart_log.physical_usage_ratio.norm,
+				ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000, min_ratio, json);
+
+		alert = min_ratio && ctx.hw_used && cap_comp_ratio(&ctx) < min_ratio;
+		if (alert != below)
+			fprintf(stderr, "%s: compression ratio %.2f %s %.2f\n", dev->name,
+				cap_comp_ratio(&ctx), alert ? "below" : "back above", min_ratio);
+		below = alert;
+	}
+
+	nvme_stop_release();
+	return err;
+}
+
 static int query_cap_info(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	struct sfx_freespace_ctx ctx = { 0 };
 	char *desc = "query current capacity info";
 	const char *raw = "dump output in binary format";
+	const char *json = "Dump output in json format";
+	const char *interval = "sample the capacity every <interval> seconds";
+	const char *count = "number of samples with --interval, default until interrupted";
+	const char *min_ratio = "with --interval, warn when the compression ratio falls below this";
 	struct nvme_dev *dev;
 	struct config {
 		bool  raw_binary;
+		bool  json;
+		__u32 interval;
+		__u32 count;
+		double min_ratio;
 	};
-	struct config cfg;
+	struct config cfg = { 0 };
 	int err = 0;
 
 	OPT_ARGS(opts) = {
 		OPT_FLAG("raw-binary", 'b', &cfg.raw_binary, raw),
+		OPT_FLAG("json",       'j', &cfg.json,       json),
+		OPT_UINT("interval",   'i', &cfg.interval,   interval),
+		OPT_UINT("count",      'c', &cfg.count,      count),
+		OPT_DOUBLE("min-ratio", 'r', &cfg.min_ratio, min_ratio),
 		OPT_END()
 	};
 
@@ -847,6 +944,18 @@ static int query_cap_info(int argc, char **argv, struct command *cmd, struct plu
 	if (err)
 		return err;
 
+	if (cfg.interval || cfg.json) {
+		if (cfg.raw_binary) {
+			fprintf(stderr, "binary output can't be sampled or printed as json\n");
+			err = -EINVAL;
+		} else {
+			err = cap_monitor(dev, cfg.interval, cfg.interval ? cfg.count : 1,
+					  cfg.min_ratio, cfg.json);
+		}
+		dev_close(dev);
+		return err;
+	}
+
 	if (nvme_query_cap(dev_fd(dev), 0xffffffff, sizeof(ctx), &ctx)) {
 		perror("sfx-query-cap");
 		err = -1;
@@ -1571,159 +1571,174 @@ static int vs_clr_pcie_correctable_errs(int argc, char **argv, struct command *c
 	return err;
 }
 
-static int get_host_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+#define TELEMETRY_BLOCK_SIZE	512
+
+/* the log chunks follow MDTS, in whole telemetry blocks */
+static __u32 stx_tele_chunk_size(struct nvme_dev *dev)
 {
-	const char *desc =
-	    "Capture the Telemetry Host-Initiated Data in either hex-dump (default) or binary format";
-	const char *namespace_id = "desired namespace";
-	const char *log_specific = "1 - controller shall capture Data representing the internal\n"
-		"state of the controller at the time the command is processed.\n"
-		"0 - controller shall not update the Telemetry Host Initiated Data.";
-	const char *raw = "output in raw format";
-	struct nvme_temetry_log_hdr tele_log;
-	int blkCnt, maxBlk = 0, blksToGet;
-	struct nvme_dev *dev;
-	unsigned char  *log;
-	__le64  offset = 0;
-	int err, dump_fd;
+	__u32 xfer_len;
 
-	struct config {
-		__u32 namespace_id;
-		__u32 log_id;
-		bool  raw_binary;
-	};
+	if (get_max_xfer_len(dev, &xfer_len) || xfer_len < TELEMETRY_BLOCK_SIZE)
+		return TELEMETRY_BLOCKS_TO_READ * TELEMETRY_BLOCK_SIZE;
 
-	struct config cfg = {
-		.namespace_id = 0xffffffff,
-		.log_id       = 0,
-	};
+	return xfer_len - xfer_len % TELEMETRY_BLOCK_SIZE;
+}
 
-	OPT_ARGS(opts) = {
-		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
-		OPT_UINT("log_specific", 'i', &cfg.log_id,       log_specific),
-		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
-		OPT_END()
+static int stx_tele_hdr(struct nvme_dev *dev, __u8 log_id, __u8 lsp, __u32 nsid,
+			struct nvme_temetry_log_hdr *hdr)
+{
+	struct nvme_get_log_args args = {
+		.args_size  = sizeof(args),
+		.fd         = dev_fd(dev),
+		.lid        = log_id,
+		.nsid       = nsid,
+		.lsp        = lsp,
+		.rae        = true,
+		.csi        = NVME_CSI_NVM,
+		.len        = sizeof(*hdr),
+		.log        = hdr,
+		.timeout    = NVME_DEFAULT_IOCTL_TIMEOUT,
 	};
 
-	err = parse_and_open(&dev, argc, argv, desc, opts);
-	if (err)
-		return err;
-
-	dump_fd = STDOUT_FILENO;
-	cfg.log_id = (cfg.log_id << 8) | 0x07;
-	err = nvme_get_nsid_log(dev_fd(dev), false, cfg.log_id,
-				cfg.namespace_id,
-				sizeof(tele_log), (void *)(&tele_log));
-	if (!err) {
-		maxBlk = tele_log.tele_data_area3;
-		offset += 512;
-
-		if (!cfg.raw_binary) {
-			printf("Device:%s log-id:%d namespace-id:%#x\n",
-				   dev->name, cfg.log_id,
-				   cfg.namespace_id);
-			printf("Data Block 1 Last Block:%d Data Block 2 Last Block:%d Data Block 3 Last Block:%d\n",
-				   tele_log.tele_data_area1, tele_log.tele_data_area2, tele_log.tele_data_area3);
-
-			d((unsigned char *)(&tele_log), sizeof(tele_log), 16, 1);
-		} else
-			seaget_d_raw((unsigned char *)(&tele_log), sizeof(tele_log), dump_fd);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		perror("log page");
-	}
-
-	blkCnt = 0;
+	return nvme_get_log(&args);
+}
 
-	while (blkCnt < maxBlk) {
-		unsigned long long bytesToGet;
+/* the header block and the data areas up to the last block of area 3 */
+static __u64 stx_tele_size(const struct nvme_temetry_log_hdr *hdr)
+{
+	return (le16_to_cpu(hdr->tele_data_area3) + 1ULL) * TELEMETRY_BLOCK_SIZE;
+}
 
-		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
+/*
+ * Fetch the blocks from @offset to @size into @fd through the pipelined
+ * get-log retriever, a helper thread writes each chunk while the next one is
+ * read.
+ */
+static int stx_tele_to_fd(struct nvme_dev *dev, __u8 log_id, __u32 nsid,
+			  __u64 offset, __u64 size, int fd)
+{
+	struct nvme_get_log_args args = {
+		.args_size  = sizeof(args),
+		.lid        = log_id,
+		.nsid       = nsid,
+		.lpo        = offset,
+		.rae        = true,
+		.csi        = NVME_CSI_NVM,
+		.len        = size - offset,
+	};
 
-		if (!blksToGet) {
-			dev_close(dev);
-			return err;
-		}
+	if (offset >= size)
+		return 0;
 
-		bytesToGet = (unsigned long long)blksToGet * 512;
-		log = malloc(bytesToGet);
+	return get_log_to_file(dev, &args, stx_tele_chunk_size(dev), fd, NULL);
+}
 
-		if (!log) {
-			fprintf(stderr, "could not alloc buffer for log\n");
-			dev_close(dev);
-			return -EINVAL;
-		}
+/* hex dump the blocks after the header, a chunk at a time */
+static int stx_tele_dump(struct nvme_dev *dev, __u8 log_id, __u32 nsid, __u64 size)
+{
+	__u32 chunk = stx_tele_chunk_size(dev);
+	_cleanup_free_ unsigned char *log = NULL;
+	__u64 offset = TELEMETRY_BLOCK_SIZE;
+	int err = 0;
 
-		memset(log, 0, bytesToGet);
+	log = nvme_alloc(chunk);
+	if (!log)
+		return -ENOMEM;
 
+	while (offset < size) {
+		__u32 len = min(size - offset, (__u64)chunk);
 		struct nvme_get_log_args args = {
 			.args_size  = sizeof(args),
-			.fd     = dev_fd(dev),
-			.lid        = cfg.log_id,
-			.nsid       = cfg.namespace_id,
+			.fd         = dev_fd(dev),
+			.lid        = log_id,
+			.nsid       = nsid,
 			.lpo        = offset,
-			.lsp        = 0,
-			.lsi        = 0,
 			.rae        = true,
-			.uuidx      = 0,
 			.csi        = NVME_CSI_NVM,
-			.ot     = false,
-			.len        = bytesToGet,
-			.log        = (void *)log,
+			.len        = len,
+			.log        = log,
 			.timeout    = NVME_DEFAULT_IOCTL_TIMEOUT,
-			.result     = NULL,
 		};
+
 		err = nvme_get_log(&args);
-		if (!err) {
-			offset += (__le64)bytesToGet;
+		if (err)
+			return err < 0 ? -errno : err;
 
-			if (!cfg.raw_binary) {
-				printf("\nBlock # :%d to %d\n", blkCnt + 1, blkCnt + blksToGet);
+		printf("\nBlock # :%llu to %llu\n",
+		       (unsigned long long)offset / TELEMETRY_BLOCK_SIZE,
+		       (unsigned long long)(offset + len) / TELEMETRY_BLOCK_SIZE - 1);
+		d(log, len, 16, 1);
+		offset += len;
+	}
 
-				d((unsigned char *)log, bytesToGet, 16, 1);
-			} else
-				seaget_d_raw((unsigned char *)log, bytesToGet, dump_fd);
-		} else if (err > 0) {
-			nvme_show_status(err);
-		} else {
-			perror("log page");
-		}
+	return err;
+}
+
+static void stx_tele_show_err(int err)
+{
+	if (err > 0)
+		nvme_show_status(err);
+	else if (err < 0)
+		nvme_show_error("log page: %s", nvme_strerror(-err));
+}
+
+/* get-host-tele and get-ctrl-tele */
+static int stx_get_tele(struct nvme_dev *dev, __u8 log_id, __u8 lsp, __u32 nsid,
+			bool raw_binary)
+{
+	struct nvme_temetry_log_hdr tele_log;
+	int err;
+
+	err = stx_tele_hdr(dev, log_id, lsp, nsid, &tele_log);
+	if (err) {
+		stx_tele_show_err(err < 0 ? -errno : err);
+		return err;
+	}
 
-		blkCnt += blksToGet;
+	if (raw_binary) {
+		seaget_d_raw((unsigned char *)(&tele_log), sizeof(tele_log), STDOUT_FILENO);
+		err = stx_tele_to_fd(dev, log_id, nsid, TELEMETRY_BLOCK_SIZE,
+				     stx_tele_size(&tele_log), STDOUT_FILENO);
+	} else {
+		printf("Device:%s log-id:%d namespace-id:%#x\n", dev->name, log_id, nsid);
+		printf("Data Block 1 Last Block:%d Data Block 2 Last Block:%d Data Block 3 Last Block:%d\n",
+		       le16_to_cpu(tele_log.tele_data_area1), le16_to_cpu(tele_log.tele_data_area2),
+		       le16_to_cpu(tele_log.tele_data_area3));
 
-		free(log);
+		d((unsigned char *)(&tele_log), sizeof(tele_log), 16, 1);
+		err = stx_tele_dump(dev, log_id, nsid, stx_tele_size(&tele_log));
 	}
 
-	dev_close(dev);
+	stx_tele_show_err(err);
 	return err;
 }
 
-static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+static int get_host_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc =
-	    "Capture the Telemetry Controller-Initiated Data in either hex-dump (default) or binary format";
+	    "Capture the Telemetry Host-Initiated Data in either hex-dump (default) or binary format";
 	const char *namespace_id = "desired namespace";
+	const char *log_specific = "1 - controller shall capture Data representing the internal\n"
+		"state of the controller at the time the command is processed.\n"
+		"0 - controller shall not update the Telemetry Host Initiated Data.";
 	const char *raw = "output in raw format";
-	struct nvme_dev *dev;
-	int err, dump_fd;
-	struct nvme_temetry_log_hdr tele_log;
-	__le64  offset = 0;
-	__u16 log_id;
-	int blkCnt, maxBlk = 0, blksToGet;
-	unsigned char  *log;
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
 
 	struct config {
 		__u32 namespace_id;
+		__u32 log_id;
 		bool  raw_binary;
 	};
 
 	struct config cfg = {
 		.namespace_id = 0xffffffff,
+		.log_id       = 0,
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
+		OPT_UINT("log_specific", 'i', &cfg.log_id,       log_specific),
 		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
 		OPT_END()
 	};
@@ -1732,90 +1747,41 @@ static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plug
 	if (err)
 		return err;
 
-	dump_fd = STDOUT_FILENO;
-
-	log_id = 0x08;
-	err = nvme_get_nsid_log(dev_fd(dev), false, log_id, cfg.namespace_id,
-				sizeof(tele_log), (void *)(&tele_log));
-	if (!err) {
-		maxBlk = tele_log.tele_data_area3;
-		offset += 512;
-
-		if (!cfg.raw_binary) {
-			printf("Device:%s namespace-id:%#x\n",
-				   dev->name, cfg.namespace_id);
-			printf("Data Block 1 Last Block:%d Data Block 2 Last Block:%d Data Block 3 Last Block:%d\n",
-				   tele_log.tele_data_area1, tele_log.tele_data_area2, tele_log.tele_data_area3);
-
-			d((unsigned char *)(&tele_log), sizeof(tele_log), 16, 1);
-		} else
-			seaget_d_raw((unsigned char *)(&tele_log), sizeof(tele_log), dump_fd);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		perror("log page");
-	}
-
-	blkCnt = 0;
-
-	while (blkCnt < maxBlk) {
-		unsigned long long bytesToGet;
-
-		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
-
-		if (!blksToGet)
-			return err;
-
-		bytesToGet = (unsigned long long)blksToGet * 512;
-		log = malloc(bytesToGet);
-
-		if (!log) {
-			fprintf(stderr, "could not alloc buffer for log\n");
-			return -EINVAL;
-		}
-
-		memset(log, 0, bytesToGet);
+	/* the data is only created by the header read, the rest retains it */
+	return stx_get_tele(dev, NVME_LOG_LID_TELEMETRY_HOST, cfg.log_id, cfg.namespace_id,
+			    cfg.raw_binary);
+}
 
-		struct nvme_get_log_args args = {
-			.args_size  = sizeof(args),
-			.fd     = dev_fd(dev),
-			.lid        = log_id,
-			.nsid       = cfg.namespace_id,
-			.lpo        = offset,
-			.lsp        = 0,
-			.lsi        = 0,
-			.rae        = true,
-			.uuidx      = 0,
-			.csi        = NVME_CSI_NVM,
-			.ot     = false,
-			.len        = bytesToGet,
-			.log        = (void *)log,
-			.timeout    = NVME_DEFAULT_IOCTL_TIMEOUT,
-			.result     = NULL,
-		};
-		err = nvme_get_log(&args);
-		if (!err) {
-			offset += (__le64)bytesToGet;
+static int get_ctrl_tele(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc =
+	    "Capture the Telemetry Controller-Initiated Data in either hex-dump (default) or binary format";
+	const char *namespace_id = "desired namespace";
+	const char *raw = "output in raw format";
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
+	int err;
 
-			if (!cfg.raw_binary) {
-				printf("\nBlock # :%d to %d\n", blkCnt + 1, blkCnt + blksToGet);
+	struct config {
+		__u32 namespace_id;
+		bool  raw_binary;
+	};
 
-				d((unsigned char *)log, bytesToGet, 16, 1);
-			} else
-				seaget_d_raw((unsigned char *)log, bytesToGet, dump_fd);
-		} else if (err > 0) {
-			nvme_show_status(err);
-		} else {
-			perror("log page");
-		}
+	struct config cfg = {
+		.namespace_id = 0xffffffff,
+	};
 
-		blkCnt += blksToGet;
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
+		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
+		OPT_END()
+	};
 
-		free(log);
-	}
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
 
-	dev_close(dev);
-	return err;
+	return stx_get_tele(dev, NVME_LOG_LID_TELEMETRY_CTRL, 0, cfg.namespace_id,
+			    cfg.raw_binary);
 }
 
 void seaget_d_raw(unsigned char *buf, int len, int fd)
@@ -1824,26 +1790,41 @@ void seaget_d_raw(unsigned char *buf, int len, int fd)
 		printf("%s: Write Failed\n", __func__);
 }
 
+/*
+ * The whole blocks of a previous capture in @fd, or 0 if its header doesn't
+ * match the data the controller holds now.
+ */
+static __u64 stx_tele_resume_offset(int fd, const struct nvme_temetry_log_hdr *hdr)
+{
+	struct nvme_temetry_log_hdr old;
+	struct stat st;
+
+	if (fstat(fd, &st) || st.st_size < TELEMETRY_BLOCK_SIZE ||
+	    pread(fd, &old, sizeof(old), 0) != sizeof(old) ||
+	    old.tele_data_gen_num != hdr->tele_data_gen_num ||
+	    old.tele_data_area3 != hdr->tele_data_area3)
+		return 0;
+
+	return min((__u64)st.st_size - st.st_size % TELEMETRY_BLOCK_SIZE, stx_tele_size(hdr));
+}
 
 static int vs_internal_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Capture the Telemetry Controller-Initiated Data in binary format";
 	const char *namespace_id = "desired namespace";
-
 	const char *file = "dump file";
-	struct nvme_dev *dev;
-	int err, dump_fd;
-	int flags = O_WRONLY | O_CREAT;
-	int mode = 0664;
+	const char *resume = "continue an interrupted capture into the dump file";
+	_cleanup_nvme_dev_ struct nvme_dev *dev = NULL;
 	struct nvme_temetry_log_hdr tele_log;
-	__le64  offset = 0;
-	__u16 log_id;
-	int blkCnt, maxBlk = 0, blksToGet;
-	unsigned char  *log;
+	int flags = O_CREAT;
+	int mode = 0664;
+	__u64 offset = 0, size;
+	int err, dump_fd;
 
 	struct config {
 		__u32 namespace_id;
 		char  *file;
+		bool  resume;
 	};
 
 	struct config cfg = {
@@ -1854,6 +1835,7 @@ static int vs_internal_log(int argc, char **argv, struct command *cmd, struct pl
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace_id),
 		OPT_FILE("dump-file",    'f', &cfg.file,         file),
+		OPT_FLAG("resume",       'r', &cfg.resume,       resume),
 		OPT_END()
 	};
 
@@ -1861,89 +1843,52 @@ static int vs_internal_log(int argc, char **argv, struct command *cmd, struct pl
 	if (err)
 		return err;
 
+	if (cfg.resume && !strlen(cfg.file)) {
+		nvme_show_error("--resume needs a dump file");
+		return -EINVAL;
+	}
+
+	err = stx_tele_hdr(dev, NVME_LOG_LID_TELEMETRY_CTRL, 0, cfg.namespace_id, &tele_log);
+	if (err) {
+		stx_tele_show_err(err < 0 ? -errno : err);
+		return err;
+	}
+	size = stx_tele_size(&tele_log);
+
 	dump_fd = STDOUT_FILENO;
 	if (strlen(cfg.file)) {
-		dump_fd = open(cfg.file, flags, mode);
+		dump_fd = open(cfg.file, flags | (cfg.resume ? O_RDWR : O_WRONLY | O_TRUNC), mode);
 		if (dump_fd < 0) {
 			perror(cfg.file);
-			dev_close(dev);
 			return -EINVAL;
 		}
 	}
 
-	log_id = 0x08;
-	err = nvme_get_nsid_log(dev_fd(dev), false, log_id, cfg.namespace_id,
-				sizeof(tele_log), (void *)(&tele_log));
-	if (!err) {
-		maxBlk = tele_log.tele_data_area3;
-		offset += 512;
-
-		seaget_d_raw((unsigned char *)(&tele_log), sizeof(tele_log), dump_fd);
-	} else if (err > 0) {
-		nvme_show_status(err);
-	} else {
-		perror("log page");
-	}
-
-	blkCnt = 0;
-
-	while (blkCnt < maxBlk) {
-		unsigned long long bytesToGet;
-
-		blksToGet = ((maxBlk - blkCnt) >= TELEMETRY_BLOCKS_TO_READ) ? TELEMETRY_BLOCKS_TO_READ : (maxBlk - blkCnt);
-
-		if (!blksToGet)
-			goto out;
-
-		bytesToGet = (unsigned long long)blksToGet * 512;
-		log = malloc(bytesToGet);
-
-		if (!log) {
-			fprintf(stderr, "could not alloc buffer for log\n");
-			err = EINVAL;
+	if (cfg.resume) {
+		offset = stx_tele_resume_offset(dump_fd, &tele_log);
+		if (!offset)
+			fprintf(stderr, "%s: new telemetry data, starting over\n", cfg.file);
+		if (ftruncate(dump_fd, offset) || lseek(dump_fd, offset, SEEK_SET) < 0) {
+			err = -errno;
+			perror(cfg.file);
 			goto out;
 		}
+	}
 
-		memset(log, 0, bytesToGet);
-
-		struct nvme_get_log_args args = {
-			.args_size  = sizeof(args),
-			.fd     = dev_fd(dev),
-			.lid        = log_id,
-			.nsid       = cfg.namespace_id,
-			.lpo        = offset,
-			.lsp        = 0,
-			.lsi        = 0,
-			.rae        = true,
-			.uuidx      = 0,
-			.csi        = NVME_CSI_NVM,
-			.ot     = false,
-			.len        = bytesToGet,
-			.log        = (void *)log,
-			.timeout    = NVME_DEFAULT_IOCTL_TIMEOUT,
-			.result     = NULL,
-		};
-		err = nvme_get_log(&args);
-		if (!err) {
-			offset += (__le64)bytesToGet;
-
-			seaget_d_raw((unsigned char *)log, bytesToGet, dump_fd);
-
-		} else if (err > 0) {
-			nvme_show_status(err);
-		} else {
-			perror("log page");
-		}
-
-		blkCnt += blksToGet;
-
-		free(log);
+	if (!offset) {
+		seaget_d_raw((unsigned char *)(&tele_log), sizeof(tele_log), dump_fd);
+		offset = TELEMETRY_BLOCK_SIZE;
 	}
+
+	err = stx_tele_to_fd(dev, NVME_LOG_LID_TELEMETRY_CTRL, cfg.namespace_id, offset, size,
+			     dump_fd);
+	stx_tele_show_err(err);
+	if (err && strlen(cfg.file))
+		fprintf(stderr, "%s: interrupted, continue with --resume\n", cfg.file);
 out:
 	if (strlen(cfg.file))
 		close(dump_fd);
 
-	dev_close(dev);
 	return err;
 }
 
@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <inttypes.h>
+#include <string.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
 
@@ -14,6 +15,7 @@
 #include "libnvme.h"
 #include "nvme-print.h"
 #include "sedopal_cmd.h"
+#include "util/thread-pool.h"
 #include <linux/sed-opal.h>
 
 #define CREATE_CMD
@@ -157,6 +159,113 @@ static int sed_opal_unlock(int argc, char **argv, struct command *cmd,
 	return err;
 }
 
+struct sed_unlock_work {
+	const char *path;
+	struct opal_key *key;
+	int fd;
+	int err;
+};
+
+static void sed_unlock_work_fn(void *arg)
+{
+	struct sed_unlock_work *w = arg;
+
+	w->err = sedopal_cmd_unlock_key(w->fd, w->key);
+}
+
+/*
+ * Unlock every device named on the command line with one key, the
+ * unlock ioctls of the devices running in parallel.
+ */
+static int sed_opal_unlock_all(int argc, char **argv, struct command *cmd,
+		struct plugin *plugin)
+{
+	const char *desc = "Unlock several SED devices in parallel with one key";
+	struct nvme_thread_pool *pool;
+	struct sed_unlock_work *works;
+	struct opal_key key = {};
+	unsigned int jobs = 0;
+	struct stat st;
+	int i, nr, err;
+
+	OPT_ARGS(opts) = {
+		OPT_FLAG("ask-key", 'k', &sedopal_ask_key,
+				"prompt for SED authentication key"),
+		OPT_UINT("jobs", 'j', &jobs,
+				"devices unlocked at once (default: all)"),
+		OPT_END()
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	nr = argc - optind;
+	if (nr <= 0) {
+		fprintf(stderr,
+			"ERROR : The NVMe block devices must be specified\n");
+		return -EINVAL;
+	}
+
+	works = calloc(nr, sizeof(*works));
+	if (!works)
+		return -ENOMEM;
+
+	/* a device that can't be opened doesn't keep the others locked */
+	for (i = 0; i < nr; i++) {
+		works[i].path = argv[optind + i];
+		works[i].key = &key;
+		works[i].fd = open(works[i].path, O_RDONLY);
+		if (works[i].fd < 0) {
+			works[i].err = -errno;
+			fprintf(stderr, "unlock: %s: %s\n", works[i].path,
+				strerror(errno));
+			continue;
+		}
+		if (fstat(works[i].fd, &st) || !S_ISBLK(st.st_mode)) {
+			fprintf(stderr,
+				"unlock: %s: not an NVMe block device\n",
+				works[i].path);
+			close(works[i].fd);
+			works[i].fd = -1;
+			works[i].err = -EINVAL;
+		}
+	}
+
+	/* prompted for or looked up once for all the devices */
+	err = sedopal_set_key(&key);
+	if (err)
+		goto out;
+
+	if (!jobs || jobs > nr)
+		jobs = nr;
+	pool = nvme_thread_pool_create(jobs);
+	for (i = 0; i < nr; i++) {
+		if (works[i].fd < 0)
+			continue;
+		if (!pool || nvme_thread_pool_queue(pool, sed_unlock_work_fn, &works[i]))
+			sed_unlock_work_fn(&works[i]);
+	}
+	nvme_thread_pool_destroy(pool);
+
+	for (i = 0; i < nr; i++) {
+		if (!works[i].err)
+			continue;
+		if (works[i].fd >= 0)
+			fprintf(stderr, "unlock: %s: SED error -  %s\n",
+				works[i].path,
+				sedopal_error_to_text(works[i].err));
+		err = works[i].err;
+	}
+out:
+	for (i = 0; i < nr; i++)
+		if (works[i].fd >= 0)
+			close(works[i].fd);
+	memset(&key, 0, sizeof(key));
+	free(works);
+	return err;
+}
+
 static int sed_opal_password(int argc, char **argv, struct command *cmd,
 		struct plugin *plugin)
 {
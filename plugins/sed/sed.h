@@ -12,6 +12,7 @@ PLUGIN(NAME("sed", "SED Opal Command Set", NVME_VERSION),
 		ENTRY("revert", "Revert a SED Opal Device from locking", sed_opal_revert)
 		ENTRY("lock", "Lock a SED Opal Device", sed_opal_lock)
 		ENTRY("unlock", "Unlock a SED Opal Device", sed_opal_unlock)
+		ENTRY("unlock-all", "Unlock several SED Opal Devices in parallel", sed_opal_unlock_all)
 		ENTRY("password", "Change the SED Opal Device password", sed_opal_password)
 	)
 );
@@ -251,9 +251,25 @@ int sedopal_cmd_lock(int fd)
  */
 int sedopal_cmd_unlock(int fd)
 {
+	struct opal_key key;
 	int rc;
 
-	rc = sedopal_lock_unlock(fd, OPAL_RW);
+	rc = sedopal_set_key(&key);
+	if (rc != 0)
+		return rc;
+
+	return sedopal_cmd_unlock_key(fd, &key);
+}
+
+/*
+ * Unlock a SED Opal drive with a key from sedopal_set_key(), so that
+ * several drives can share one prompt.
+ */
+int sedopal_cmd_unlock_key(int fd, struct opal_key *key)
+{
+	int rc;
+
+	rc = sedopal_lock_unlock_key(fd, OPAL_RW, key);
 
 	/*
 	 * If the unlock was successful, force a re-read of the
@@ -273,13 +289,22 @@ int sedopal_cmd_unlock(int fd)
  */
 int sedopal_lock_unlock(int fd, int lock_state)
 {
+	struct opal_key key;
 	int rc;
-	struct opal_lock_unlock opal_lu = {};
 
-	rc = sedopal_set_key(&opal_lu.session.opal_key);
+	rc = sedopal_set_key(&key);
 	if (rc != 0)
 		return rc;
 
+	return sedopal_lock_unlock_key(fd, lock_state, &key);
+}
+
+int sedopal_lock_unlock_key(int fd, int lock_state, struct opal_key *key)
+{
+	int rc;
+	struct opal_lock_unlock opal_lu = {};
+
+	opal_lu.session.opal_key = *key;
 	opal_lu.session.sum = 0;
 	opal_lu.session.who = OPAL_ADMIN1;
 	opal_lu.l_state = lock_state;
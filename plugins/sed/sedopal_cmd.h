@@ -13,6 +13,8 @@
 
 #define NVME_DEV_PATH			"/dev/nvme"
 
+struct opal_key;
+
 extern bool sedopal_ask_key;
 extern bool sedopal_ask_new_key;
 extern bool sedopal_destructive_revert;
@@ -41,6 +43,7 @@ struct cmd_table {
 int sedopal_cmd_initialize(int fd);
 int sedopal_cmd_lock(int fd);
 int sedopal_cmd_unlock(int fd);
+int sedopal_cmd_unlock_key(int fd, struct opal_key *key);
 int sedopal_cmd_revert(int fd);
 int sedopal_cmd_password(int fd);
 int sedopal_cmd_discover(int fd);
@@ -49,7 +52,9 @@ int sedopal_cmd_discover(int fd);
  * utility functions
  */
 int sedopal_open_nvme_device(char *device);
+int sedopal_set_key(struct opal_key *key);
 int sedopal_lock_unlock(int fd, int lock_state);
+int sedopal_lock_unlock_key(int fd, int lock_state, struct opal_key *key);
 const char *sedopal_error_to_text(int code);
 
 #endif /* _SED_OPAL_CMD_H */
@@ -15,6 +15,7 @@
 
 #define CREATE_CMD
 #include "shannon-nvme.h"
+#include "plugins/smart-attr.h"
 
 enum {
 	PROGRAM_FAIL_CNT,
@@ -60,58 +61,44 @@ struct nvme_shannon_smart_log {
 	__u8  vend_spec_resv;
 };
 
-static void show_shannon_smart_log(struct nvme_shannon_smart_log *smart, unsigned int nsid,
-				   const char *devname)
-{
-	printf("Additional Smart Log for NVME device:%s namespace-id:%x\n",
-	       devname, nsid);
-	printf("key                               normalized value\n");
-	printf("program_fail_count              : %3d%%       %"PRIu64"\n",
-	       smart->items[PROGRAM_FAIL_CNT].norm,
-	       int48_to_long(smart->items[PROGRAM_FAIL_CNT].item_val));
-	printf("erase_fail_count                : %3d%%       %"PRIu64"\n",
-	       smart->items[ERASE_FAIL_CNT].norm,
-	       int48_to_long(smart->items[ERASE_FAIL_CNT].item_val));
-	printf("wear_leveling                   : %3d%%       min: %u, max: %u, avg: %u\n",
-	       smart->items[WEARLEVELING_COUNT].norm,
-	       le16_to_cpu(smart->items[WEARLEVELING_COUNT].wear_level.min),
-	       le16_to_cpu(smart->items[WEARLEVELING_COUNT].wear_level.max),
-	       le16_to_cpu(smart->items[WEARLEVELING_COUNT].wear_level.avg));
-	printf("end_to_end_error_detection_count: %3d%%       %"PRIu64"\n",
-	       smart->items[E2E_ERR_CNT].norm,
-	       int48_to_long(smart->items[E2E_ERR_CNT].item_val));
-	printf("crc_error_count                 : %3d%%       %"PRIu64"\n",
-	       smart->items[CRC_ERR_CNT].norm,
-	       int48_to_long(smart->items[CRC_ERR_CNT].item_val));
-	printf("timed_workload_media_wear       : %3d%%       %.3f%%\n",
-	       smart->items[TIME_WORKLOAD_MEDIA_WEAR].norm,
-	       ((float)int48_to_long(smart->items[TIME_WORKLOAD_MEDIA_WEAR].item_val)) / 1024);
-	printf("timed_workload_host_reads       : %3d%%       %"PRIu64"%%\n",
-	       smart->items[TIME_WORKLOAD_HOST_READS].norm,
-	       int48_to_long(smart->items[TIME_WORKLOAD_HOST_READS].item_val));
-	printf("timed_workload_timer            : %3d%%       %"PRIu64" min\n",
-	       smart->items[TIME_WORKLOAD_TIMER].norm,
-	       int48_to_long(smart->items[TIME_WORKLOAD_TIMER].item_val));
-	printf("thermal_throttle_status         : %3d%%       CurTTSta: %u%%, TTCnt: %u\n",
-	       smart->items[THERMAL_THROTTLE].norm,
-	       smart->items[THERMAL_THROTTLE].thermal_throttle.st,
-	       smart->items[THERMAL_THROTTLE].thermal_throttle.count);
-	printf("retry_buffer_overflow_count     : %3d%%       %"PRIu64"\n",
-	       smart->items[RETRY_BUFFER_OVERFLOW].norm,
-	       int48_to_long(smart->items[RETRY_BUFFER_OVERFLOW].item_val));
-	printf("pll_lock_loss_count             : %3d%%       %"PRIu64"\n",
-	       smart->items[PLL_LOCK_LOSS].norm,
-	       int48_to_long(smart->items[PLL_LOCK_LOSS].item_val));
-	printf("nand_bytes_written              : %3d%%       sectors: %"PRIu64"\n",
-	       smart->items[NAND_WRITE].norm,
-	       int48_to_long(smart->items[NAND_WRITE].item_val));
-	printf("host_bytes_written              : %3d%%       sectors: %"PRIu64"\n",
-	       smart->items[HOST_WRITE].norm,
-	       int48_to_long(smart->items[HOST_WRITE].item_val));
-	printf("sram_error_count        : %3d%%       %"PRIu64"\n",
-	       smart->items[RETRY_BUFFER_OVERFLOW].norm,
-	       int48_to_long(smart->items[SRAM_ERROR_CNT].item_val));
-}
+static const char * const shannon_wear_level[] = { "min", "max", "avg" };
+static const char * const shannon_throttle[] = { "CurTTSta", "TTCnt" };
+
+static const struct smart_attr shannon_smart_attrs[] = {
+	{ .name = "program_fail_count", .offset = PROGRAM_FAIL_CNT },
+	{ .name = "erase_fail_count", .offset = ERASE_FAIL_CNT },
+	{ .name = "wear_leveling", .offset = WEARLEVELING_COUNT,
+	  .type = SMART_ATTR_LE16X3, .fmt = "min: %u, max: %u, avg: %u",
+	  .keys = shannon_wear_level },
+	{ .name = "end_to_end_error_detection_count", .offset = E2E_ERR_CNT },
+	{ .name = "crc_error_count", .offset = CRC_ERR_CNT },
+	{ .name = "timed_workload_media_wear", .offset = TIME_WORKLOAD_MEDIA_WEAR,
+	  .fmt = "%f%%", .div = 1024 },
+	{ .name = "timed_workload_host_reads", .offset = TIME_WORKLOAD_HOST_READS,
+	  .fmt = "%u%%" },
+	{ .name = "timed_workload_timer", .offset = TIME_WORKLOAD_TIMER, .fmt = "%u min" },
+	{ .name = "thermal_throttle_status", .offset = THERMAL_THROTTLE,
+	  .type = SMART_ATTR_U8_LE32, .fmt = "CurTTSta: %u%%, TTCnt: %u",
+	  .keys = shannon_throttle },
+	{ .name = "retry_buffer_overflow_count", .offset = RETRY_BUFFER_OVERFLOW },
+	{ .name = "pll_lock_loss_count", .offset = PLL_LOCK_LOSS },
+	{ .name = "nand_bytes_written", .offset = NAND_WRITE, .fmt = "sectors: %u" },
+	{ .name = "host_bytes_written", .offset = HOST_WRITE, .fmt = "sectors: %u" },
+	{ .name = "sram_error_count", .offset = SRAM_ERROR_CNT },
+};
+
+static const struct smart_attr_layout shannon_smart_layout = {
+	.title		= "Shannon Smart log",
+	.attrs		= shannon_smart_attrs,
+	.nr_attrs	= ARRAY_SIZE(shannon_smart_attrs),
+	.item_size	= sizeof(struct nvme_shannon_smart_log_item),
+	.id_offset	= -1,
+	.norm_offset	= offsetof(struct nvme_shannon_smart_log_item, norm),
+	.raw_offset	= offsetof(struct nvme_shannon_smart_log_item, item_val),
+	.label_width	= 32,
+	.columns	= "key                               normalized value",
+	.len		= sizeof(struct nvme_shannon_smart_log),
+};
 
 static int get_additional_smart_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
@@ -120,33 +107,45 @@ static int get_additional_smart_log(int argc, char **argv, struct command *cmd,
 	    "Get Shannon vendor specific additional smart log (optionally, for the specified namespace), and show it.";
 	const char *namespace = "(optional) desired namespace";
 	const char *raw = "dump output in binary format";
+	enum nvme_print_flags fmt;
 	struct nvme_dev *dev;
 	struct config {
 		__u32 namespace_id;
 		bool  raw_binary;
+		char  *output_format;
 	};
 	int err;
 
 	struct config cfg = {
 		.namespace_id = NVME_NSID_ALL,
+		.output_format = "normal",
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace),
 		OPT_FLAG("raw-binary",	 'b', &cfg.raw_binary,	  raw),
+		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
 		OPT_END()
 	};
 
 	err = parse_and_open(&dev, argc, argv, desc, opts);
 	if (err)
 		return err;
+
+	err = validate_output_format(cfg.output_format, &fmt);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		dev_close(dev);
+		return err;
+	}
+	if (cfg.raw_binary)
+		fmt = BINARY;
+
 	err = nvme_get_nsid_log(dev_fd(dev), false, 0xca, cfg.namespace_id,
 				sizeof(smart_log), &smart_log);
 	if (!err) {
-		if (!cfg.raw_binary)
-			show_shannon_smart_log(&smart_log, cfg.namespace_id, dev->name);
-		else
-			d_raw((unsigned char *)&smart_log, sizeof(smart_log));
+		smart_attr_print(&shannon_smart_layout, &smart_log, dev->name,
+				 cfg.namespace_id, fmt);
 	} else if (err > 0) {
 		nvme_show_status(err);
 	}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvme.h"
+#include "nvme-print.h"
+#include "util/json.h"
+#include "util/types.h"
+
+#include "smart-attr.h"
+
+#define SMART_ATTR_MAX_VALS	3
+
+static __u64 attr_uint(const __u8 *p, int width)
+{
+	__u64 v = 0;
+
+	while (width--)
+		v = v << 8 | p[width];
+	return v;
+}
+
+static const __u8 *attr_item(const struct smart_attr_layout *l,
+			     const struct smart_attr *a, const __u8 *log)
+{
+	return l->item_size ? log + a->offset * l->item_size : log + a->offset;
+}
+
+static const __u8 *attr_raw(const struct smart_attr_layout *l,
+			    const struct smart_attr *a, const __u8 *log)
+{
+	return l->item_size ? attr_item(l, a, log) + l->raw_offset : log + a->offset;
+}
+
+static int attr_norm(const struct smart_attr_layout *l, const struct smart_attr *a,
+		     const __u8 *log)
+{
+	if (a->flags & SMART_ATTR_NORM_100)
+		return 100;
+	return attr_item(l, a, log)[l->norm_offset];
+}
+
+/* the counters of the raw value, returns how many */
+static int attr_values(const struct smart_attr *a, const __u8 *raw, int64_t *v)
+{
+	int i;
+
+	switch (a->type) {
+	case SMART_ATTR_LE16X3:
+		for (i = 0; i < 3; i++) {
+			v[i] = attr_uint(raw + 2 * i, 2);
+			if (a->flags & SMART_ATTR_KELVIN)
+				v[i] = kelvin_to_celsius(v[i]);
+		}
+		return 3;
+	case SMART_ATTR_U8_LE32:
+		v[0] = raw[0];
+		v[1] = attr_uint(raw + 1, 4);
+		return 2;
+	default:
+		v[0] = attr_uint(raw, a->width ?: 6);
+		if (a->flags & SMART_ATTR_MAX_100)
+			v[0] = min(v[0], 100);
+		return 1;
+	}
+}
+
+static const char *attr_enum(const struct smart_attr *a, __u64 v)
+{
+	__u64 i;
+
+	for (i = 0; a->keys[i]; i++)
+		if (i == v)
+			return a->keys[i];
+	return "Unknown";
+}
+
+static void print_attr_value(const struct smart_attr *a, const __u8 *raw)
+{
+	const char *fmt = a->fmt ?: "%u", *p;
+	int64_t v[SMART_ATTR_MAX_VALS];
+	int nr, i = 0;
+
+	if (a->type == SMART_ATTR_STRING) {
+		printf("%.*s\n", a->width, (const char *)raw);
+		return;
+	}
+	if (a->type == SMART_ATTR_ENUM) {
+		printf("%s\n", attr_enum(a, attr_uint(raw, a->width ?: 1)));
+		return;
+	}
+
+	nr = attr_values(a, raw, v);
+	for (p = fmt; *p; p++) {
+		if (*p != '%') {
+			putchar(*p);
+			continue;
+		}
+		p++;
+		if (*p == '%') {
+			putchar('%');
+			continue;
+		}
+		/* the counters without a JSON name aren't shown either */
+		while (a->keys && i < nr && !a->keys[i])
+			i++;
+		if (i >= nr)
+			break;
+		if (*p == 'f')
+			printf("%.3f", (double)v[i++] / a->div);
+		else if (*p == 'd')
+			printf("%"PRId64, v[i++]);
+		else
+			printf("%"PRIu64, (uint64_t)v[i++]);
+	}
+	putchar('\n');
+}
+
+static void print_attrs_normal(const struct smart_attr_layout *l, const __u8 *log,
+			       const char *devname, unsigned int nsid)
+{
+	const struct smart_attr *a;
+	int i;
+
+	if (l->columns) {
+		printf("Additional Smart Log for NVME device:%s namespace-id:%x\n",
+		       devname, nsid);
+		printf("%s\n", l->columns);
+	}
+
+	for (i = 0; i < l->nr_attrs; i++) {
+		a = &l->attrs[i];
+		printf("%-*s: ", l->label_width, a->name);
+		if (l->item_size && l->id_offset >= 0)
+			printf("%03d  ", attr_item(l, a, log)[l->id_offset]);
+		if (l->item_size && l->norm_offset >= 0)
+			printf("%3d%%       ", attr_norm(l, a, log));
+		print_attr_value(a, attr_raw(l, a, log));
+	}
+}
+
+static struct json_object *attr_value_json(const struct smart_attr *a, const __u8 *raw)
+{
+	int64_t v[SMART_ATTR_MAX_VALS];
+	struct json_object *multi;
+	char s[256];
+	int nr, i;
+
+	switch (a->type) {
+	case SMART_ATTR_STRING:
+		snprintf(s, sizeof(s), "%.*s", a->width, (const char *)raw);
+		return json_object_new_string(s);
+	case SMART_ATTR_ENUM:
+		return json_object_new_string(attr_enum(a, attr_uint(raw, a->width ?: 1)));
+	default:
+		break;
+	}
+
+	nr = attr_values(a, raw, v);
+	if (nr == 1) {
+		if (a->div)
+			return json_object_new_double((double)v[0] / a->div);
+		return json_object_new_uint64(v[0]);
+	}
+
+	multi = json_create_object();
+	for (i = 0; i < nr; i++)
+		if (a->keys[i])
+			json_object_add_value_int(multi, a->keys[i], v[i]);
+	return multi;
+}
+
+struct json_object *smart_attr_json(const struct smart_attr_layout *l, const void *log)
+{
+	struct json_object *stats = json_create_object(), *entry;
+	const struct smart_attr *a;
+	int i;
+
+	for (i = 0; i < l->nr_attrs; i++) {
+		a = &l->attrs[i];
+		if (!l->item_size) {
+			json_object_add_value_object(stats, a->json ?: a->name,
+						     attr_value_json(a, attr_raw(l, a, log)));
+			continue;
+		}
+
+		entry = json_create_object();
+		if (l->id_offset >= 0)
+			json_object_add_value_int(entry, "#id",
+						  attr_item(l, a, log)[l->id_offset]);
+		if (l->norm_offset >= 0)
+			json_object_add_value_int(entry, "normalized", attr_norm(l, a, log));
+		json_object_add_value_object(entry, "raw", attr_value_json(a, attr_raw(l, a, log)));
+		json_object_add_value_object(stats, a->json ?: a->name, entry);
+	}
+
+	return stats;
+}
+
+void smart_attr_print(const struct smart_attr_layout *l, const void *log,
+		      const char *devname, unsigned int nsid,
+		      enum nvme_print_flags fmt)
+{
+	struct json_object *root;
+
+	if (fmt == BINARY) {
+		d_raw((unsigned char *)log, l->len);
+		return;
+	}
+
+	if (fmt != JSON) {
+		print_attrs_normal(l, log, devname, nsid);
+		return;
+	}
+
+	root = json_create_object();
+	json_object_add_value_string(root, l->title, devname);
+	json_object_add_value_object(root, "Device stats", smart_attr_json(l, log));
+	json_print_object(root, NULL);
+	util_json_print_newline();
+	json_free_object(root);
+}
@@ -0,0 +1,73 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __SMART_ATTR_H__
+#define __SMART_ATTR_H__
+
+#include <stddef.h>
+#include "linux/types.h"
+#include "nvme-print.h"
+
+/*
+ * Table driven decoding of the vendor "additional SMART" logs. Most are an
+ * array of items, each an attribute ID, a normalized value and a raw
+ * value, some are a flat structure of fields. A vendor describes its log
+ * with a constant layout and attribute table, and the same table renders
+ * the normal and the JSON output.
+ */
+enum smart_attr_type {
+	SMART_ATTR_UINT,	/* little endian integer of 1 to 8 bytes */
+	SMART_ATTR_LE16X3,	/* three le16 counters */
+	SMART_ATTR_U8_LE32,	/* a byte followed by a le32 */
+	SMART_ATTR_STRING,	/* fixed width ASCII */
+	SMART_ATTR_ENUM,	/* integer indexing the names in .keys */
+};
+
+#define SMART_ATTR_KELVIN	(1 << 0)	/* the counters are in Kelvin */
+#define SMART_ATTR_MAX_100	(1 << 1)	/* a percentage, capped to 100 */
+#define SMART_ATTR_NORM_100	(1 << 2)	/* no normalized value, show 100 */
+
+struct smart_attr {
+	const char *name;	/* label of the normal output */
+	const char *json;	/* JSON member, the label if NULL */
+	__u16 offset;		/* index of the item, byte offset of a flat log */
+	__u8 type;
+	__u8 width;		/* of SMART_ATTR_UINT, _STRING and _ENUM */
+	__u8 flags;
+	/*
+	 * Normal output of the value: "%u" and "%d" take the next counter
+	 * with a key, "%f" the value divided by .div, "%u" if NULL.
+	 */
+	const char *fmt;
+	/* JSON names of the counters, NULL skips one; names of an enum */
+	const char * const *keys;
+	__u32 div;
+};
+
+struct smart_attr_layout {
+	const char *title;	/* JSON member of the device name */
+	const struct smart_attr *attrs;
+	int nr_attrs;
+	__u16 item_size;	/* 0 for a flat log */
+	__s8 id_offset;		/* of the attribute ID in an item, -1 if none */
+	__s8 norm_offset;	/* of the normalized value, -1 if none */
+	__u8 raw_offset;	/* of the raw value */
+	__u8 label_width;
+	const char *columns;	/* heading of the normal output, NULL if none */
+	__u32 len;		/* of the log, for the binary output */
+};
+
+/*
+ * smart_attr_json - decode @log into a new object, one member for each
+ * attribute, which a caller collecting several devices adds to its own
+ * document
+ */
+struct json_object *smart_attr_json(const struct smart_attr_layout *l, const void *log);
+
+/*
+ * smart_attr_print - render @log as described by @l
+ * @fmt: NORMAL, JSON or BINARY, the raw log
+ */
+void smart_attr_print(const struct smart_attr_layout *l, const void *log,
+		      const char *devname, unsigned int nsid,
+		      enum nvme_print_flags fmt);
+
+#endif /* __SMART_ATTR_H__ */
@@ -11,6 +11,10 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
 
 #include "common.h"
 #include "nvme.h"
@@ -18,6 +22,8 @@
 #include "plugin.h"
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "nvme-io-engine.h"
+#include "util/interval.h"
 #include "solidigm-garbage-collection.h"
 #include "solidigm-util.h"
 
@@ -34,6 +40,30 @@ struct garbage_control_collection_log {
 	__u8 reserved[2892];
 };
 
+static int gc_log_read(int fd, __u8 uuid_index, struct garbage_control_collection_log *gc_log)
+{
+	const int solidigm_vu_gc_log_id = 0xfd;
+	struct nvme_get_log_args args = {
+		.lpo = 0,
+		.result = NULL,
+		.log = gc_log,
+		.args_size = sizeof(args),
+		.fd = fd,
+		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
+		.lid = solidigm_vu_gc_log_id,
+		.len = sizeof(*gc_log),
+		.nsid = NVME_NSID_ALL,
+		.csi = NVME_CSI_NVM,
+		.lsi = NVME_LOG_LSI_NONE,
+		.lsp = NVME_LOG_LSP_NONE,
+		.uuidx = uuid_index,
+		.rae = false,
+		.ot = false,
+	};
+
+	return nvme_get_log(&args);
+}
+
 static void vu_gc_log_show_json(struct garbage_control_collection_log *payload, const char *devname)
 {
 	struct json_object *gc_entries = json_create_array();
@@ -100,26 +130,8 @@ int solidigm_get_garbage_collection_log(int argc, char **argv, struct command *c
 	sldgm_get_uuid_index(dev, &uuid_index);
 
 	struct garbage_control_collection_log gc_log;
-	const int solidigm_vu_gc_log_id = 0xfd;
-	struct nvme_get_log_args args = {
-		.lpo = 0,
-		.result = NULL,
-		.log = &gc_log,
-		.args_size = sizeof(args),
-		.fd = dev_fd(dev),
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
-		.lid = solidigm_vu_gc_log_id,
-		.len = sizeof(gc_log),
-		.nsid = NVME_NSID_ALL,
-		.csi = NVME_CSI_NVM,
-		.lsi = NVME_LOG_LSI_NONE,
-		.lsp = NVME_LOG_LSP_NONE,
-		.uuidx = uuid_index,
-		.rae = false,
-		.ot = false,
-	};
 
-	err =  nvme_get_log(&args);
+	err = gc_log_read(dev_fd(dev), uuid_index, &gc_log);
 	if (!err) {
 		if (flags & BINARY)
 			d_raw((unsigned char *)&gc_log, sizeof(gc_log));
@@ -136,3 +148,392 @@ int solidigm_get_garbage_collection_log(int argc, char **argv, struct command *c
 	dev_close(dev);
 	return err;
 }
+
+/*
+ * GC latency capture: an I/O job runs while the GC log is read every
+ * interval. The GC timestamps are in controller units, so the log only
+ * tells which intervals had new events, and each completion is classed
+ * with the interval it completed in.
+ */
+struct gc_latency_thread {
+	pthread_mutex_t lock;
+	struct nvme_hist win[2];	/* of the open and the closing interval */
+};
+
+struct gc_latency {
+	int fd;
+	__u8 uuid_index;
+	unsigned int interval_ms;
+
+	struct gc_latency_thread *thr;
+	unsigned int threads;
+	unsigned int win;		/* intervals started */
+	volatile bool done;
+
+	__u64 last_ts;			/* newest GC event seen */
+	__u64 events;
+	__u64 windows;
+	__u64 gc_windows;
+	int err;
+	struct nvme_hist gc;
+	struct nvme_hist idle;
+};
+
+static void gc_latency_complete(struct nvme_io_job *job, unsigned int thread,
+				__u64 seq, void *buf, int status, __u64 result,
+				__u64 lat_ns)
+{
+	struct gc_latency *gl = job->priv;
+	struct gc_latency_thread *t = &gl->thr[thread];
+
+	if (status)
+		return;
+
+	pthread_mutex_lock(&t->lock);
+	nvme_hist_add(&t->win[__atomic_load_n(&gl->win, __ATOMIC_ACQUIRE) & 1], lat_ns);
+	pthread_mutex_unlock(&t->lock);
+}
+
+static const struct nvme_io_job_ops gc_latency_ops = {
+	.complete	= gc_latency_complete,
+};
+
+/* number of GC events newer than the newest one seen so far */
+static int gc_latency_events(struct gc_latency *gl, __u64 *events)
+{
+	struct garbage_control_collection_log log;
+	__u64 ts, newest = gl->last_ts;
+	int err, i;
+
+	err = gc_log_read(gl->fd, gl->uuid_index, &log);
+	if (err)
+		return err;
+
+	*events = 0;
+	for (i = 0; i < VU_GC_MAX_ITEMS; i++) {
+		ts = le64_to_cpu(log.item[i].timestamp);
+		if (ts > gl->last_ts)
+			(*events)++;
+		if (ts > newest)
+			newest = ts;
+	}
+	gl->last_ts = newest;
+
+	return 0;
+}
+
+/* close the current interval and class its latencies by the GC log */
+static void gc_latency_close(struct gc_latency *gl)
+{
+	unsigned int w = __atomic_fetch_add(&gl->win, 1, __ATOMIC_ACQ_REL) & 1;
+	struct nvme_hist *dst;
+	__u64 events = 0;
+	unsigned int i;
+	int err;
+
+	/* an interval the log couldn't be read for is left out */
+	err = gc_latency_events(gl, &events);
+	if (err) {
+		if (!gl->err)
+			gl->err = err;
+	} else {
+		gl->windows++;
+		gl->events += events;
+		if (events)
+			gl->gc_windows++;
+	}
+	dst = events ? &gl->gc : &gl->idle;
+
+	for (i = 0; i < gl->threads; i++) {
+		struct gc_latency_thread *t = &gl->thr[i];
+
+		pthread_mutex_lock(&t->lock);
+		if (!err)
+			nvme_hist_merge(dst, &t->win[w]);
+		nvme_hist_init(&t->win[w]);
+		pthread_mutex_unlock(&t->lock);
+	}
+}
+
+static void *gc_latency_poll(void *arg)
+{
+	struct gc_latency *gl = arg;
+	struct timespec ts = {
+		.tv_sec = gl->interval_ms / 1000,
+		.tv_nsec = (gl->interval_ms % 1000) * 1000000L,
+	};
+
+	while (!gl->done) {
+		nanosleep(&ts, NULL);
+		if (!gl->done)
+			gc_latency_close(gl);
+	}
+
+	return NULL;
+}
+
+static void gc_latency_hist_show(const char *name, struct nvme_hist *h)
+{
+	printf("%-8s %12" PRIu64 " %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+	       " %10" PRIu64 " %10" PRIu64 "\n", name, h->count,
+	       nvme_hist_mean(h) / 1000, nvme_hist_percentile(h, 50) / 1000,
+	       nvme_hist_percentile(h, 99) / 1000,
+	       nvme_hist_percentile(h, 99.9) / 1000, h->max / 1000);
+}
+
+static void gc_latency_show(struct gc_latency *gl, struct nvme_io_stats *stats,
+			    const char *devname)
+{
+	printf("Solidigm GC latency for NVME device:%s UUID-idx:%d\n", devname,
+	       gl->uuid_index);
+	printf("I/Os: %" PRIu64 ", errors: %" PRIu64 ", %.1f s\n", stats->ios,
+	       stats->errors, stats->elapsed_ns / 1e9);
+	printf("GC events: %" PRIu64 ", intervals with GC: %" PRIu64 " of %" PRIu64
+	       " (%u ms)\n\n", gl->events, gl->gc_windows, gl->windows,
+	       gl->interval_ms);
+	printf("Class            I/Os   mean(us)    p50(us)    p99(us)  p99.9(us)    max(us)\n");
+	gc_latency_hist_show("gc", &gl->gc);
+	gc_latency_hist_show("no-gc", &gl->idle);
+}
+
+static struct json_object *gc_latency_hist_json(struct nvme_hist *h)
+{
+	struct json_object *o = json_create_object();
+
+	json_object_add_value_uint64(o, "ios", h->count);
+	json_object_add_value_uint64(o, "mean_ns", nvme_hist_mean(h));
+	json_object_add_value_uint64(o, "p50_ns", nvme_hist_percentile(h, 50));
+	json_object_add_value_uint64(o, "p99_ns", nvme_hist_percentile(h, 99));
+	json_object_add_value_uint64(o, "p99_9_ns", nvme_hist_percentile(h, 99.9));
+	json_object_add_value_uint64(o, "max_ns", h->max);
+
+	return o;
+}
+
+static void gc_latency_show_json(struct gc_latency *gl, struct nvme_io_stats *stats)
+{
+	struct json_object *root = json_create_object();
+
+	json_object_add_value_uint64(root, "ios", stats->ios);
+	json_object_add_value_uint64(root, "errors", stats->errors);
+	json_object_add_value_uint64(root, "elapsed_ns", stats->elapsed_ns);
+	json_object_add_value_uint(root, "interval_ms", gl->interval_ms);
+	json_object_add_value_uint64(root, "gc_events", gl->events);
+	json_object_add_value_uint64(root, "intervals", gl->windows);
+	json_object_add_value_uint64(root, "gc_intervals", gl->gc_windows);
+	json_object_add_value_object(root, "gc", gc_latency_hist_json(&gl->gc));
+	json_object_add_value_object(root, "no_gc", gc_latency_hist_json(&gl->idle));
+
+	json_print_object(root, NULL);
+	printf("\n");
+	json_free_object(root);
+}
+
+int solidigm_gc_latency(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Run reads or writes while polling the Solidigm garbage collection "
+		"log and report the latency distribution of the I/O completed in intervals "
+		"with and without garbage collection events.";
+	const char *namespace_id = "Namespace identifier";
+	const char *io_mode = "I/O command: read|write";
+	const char *block_count = "number of blocks (zeroes based) per command";
+	const char *queue_depth = "commands in flight per thread";
+	const char *threads = "number of submitting threads";
+	const char *runtime = "seconds to run";
+	const char *random_lba = "random instead of sequential LBAs";
+	const char *interval = "milliseconds between reads of the garbage collection log";
+
+	struct nvme_io_stats stats = { 0 };
+	struct gc_latency gl = { 0 };
+	enum nvme_print_flags flags;
+	struct nvme_id_ns ns;
+	struct nvme_dev *dev;
+	pthread_t poller;
+	__u8 lba_index, ms;
+	unsigned int i;
+	int err, gfd = -1;
+	__u64 events;
+
+	struct config {
+		__u32	namespace_id;
+		char	*io_mode;
+		__u16	block_count;
+		__u32	queue_depth;
+		__u32	threads;
+		__u32	runtime;
+		bool	random;
+		__u32	interval;
+		char	*output_format;
+	};
+
+	struct config cfg = {
+		.io_mode	= "write",
+		.block_count	= 7,
+		.queue_depth	= 32,
+		.threads	= 1,
+		.runtime	= 10,
+		.interval	= 100,
+		.output_format	= "normal",
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id",  'n', &cfg.namespace_id,  namespace_id),
+		OPT_STR("io-mode",        'i', &cfg.io_mode,       io_mode),
+		OPT_SHRT("block-count",   'c', &cfg.block_count,   block_count),
+		OPT_UINT("queue-depth",   'q', &cfg.queue_depth,   queue_depth),
+		OPT_UINT("threads",       'j', &cfg.threads,       threads),
+		OPT_UINT("runtime",       'R', &cfg.runtime,       runtime),
+		OPT_FLAG("random",        'x', &cfg.random,        random_lba),
+		OPT_UINT("interval",      'I', &cfg.interval,      interval),
+		OPT_FMT("output-format",  'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err || flags & BINARY) {
+		fprintf(stderr, "Invalid output format '%s'\n", cfg.output_format);
+		dev_close(dev);
+		return -EINVAL;
+	}
+
+	struct nvme_io_job job = {
+		.nlb		= cfg.block_count,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= cfg.threads,
+		.runtime	= cfg.runtime,
+		.random		= cfg.random,
+		.ops		= &gc_latency_ops,
+		.priv		= &gl,
+	};
+
+	if (!strcmp(cfg.io_mode, "read")) {
+		job.opcode = nvme_cmd_read;
+	} else if (!strcmp(cfg.io_mode, "write")) {
+		job.opcode = nvme_cmd_write;
+	} else {
+		fprintf(stderr, "Invalid io-mode: %s\n", cfg.io_mode);
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.queue_depth || !cfg.threads || !cfg.runtime || !cfg.interval) {
+		fprintf(stderr, "queue-depth, threads, runtime and interval must be non-zero\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto out;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &ns);
+	if (err) {
+		nvme_show_status(err);
+		goto out;
+	}
+
+	job.nsid = cfg.namespace_id;
+	nvme_id_ns_flbas_to_lbaf_inuse(ns.flbas, &lba_index);
+	job.lba_size = 1 << ns.lbaf[lba_index].ds;
+	ms = ns.lbaf[lba_index].ms;
+	if (ms) {
+		if (NVME_FLBAS_META_EXT(ns.flbas))
+			job.lba_size += ms;
+		else
+			job.ms = ms;
+	}
+	job.nr_lbas = le64_to_cpu(ns.nsze);
+
+	sldgm_get_uuid_index(dev, &gl.uuid_index);
+	gl.fd = dev_fd(dev);
+	gl.interval_ms = cfg.interval;
+	gl.threads = cfg.threads;
+	nvme_hist_init(&gl.gc);
+	nvme_hist_init(&gl.idle);
+
+	gl.thr = calloc(cfg.threads, sizeof(*gl.thr));
+	if (!gl.thr) {
+		err = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < cfg.threads; i++) {
+		pthread_mutex_init(&gl.thr[i].lock, NULL);
+		nvme_hist_init(&gl.thr[i].win[0]);
+		nvme_hist_init(&gl.thr[i].win[1]);
+	}
+
+	/* the events logged before the run */
+	err = gc_latency_events(&gl, &events);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("get-log");
+		goto out;
+	}
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		goto out;
+	}
+	job.fd = gfd;
+
+	err = pthread_create(&poller, NULL, gc_latency_poll, &gl);
+	if (err) {
+		err = -err;
+		goto out;
+	}
+
+	nvme_stop_catch(false, nvme_io_engine_stop);
+	err = nvme_io_engine_run(&job, &stats);
+	nvme_stop_release();
+
+	gl.done = true;
+	pthread_join(poller, NULL);
+	/* the interval the run ended in */
+	gc_latency_close(&gl);
+
+	if (err < 0) {
+		fprintf(stderr, "gc latency: %s\n", nvme_strerror(-err));
+		goto out;
+	}
+
+	if (gl.err) {
+		if (gl.err > 0)
+			nvme_show_status(gl.err);
+		else
+			perror("get-log");
+		fprintf(stderr, "garbage collection log read failed, intervals skipped\n");
+	}
+
+	if (!stats.uring && cfg.queue_depth > 1)
+		fprintf(stderr,
+			"io_uring passthrough not available, ran with queue depth 1\n");
+
+	if (flags & JSON)
+		gc_latency_show_json(&gl, &stats);
+	else
+		gc_latency_show(&gl, &stats, dev->name);
+	err = stats.errors ? -EIO : 0;
+
+out:
+	if (gfd >= 0)
+		close(gfd);
+	if (gl.thr) {
+		for (i = 0; i < cfg.threads; i++)
+			pthread_mutex_destroy(&gl.thr[i].lock);
+		free(gl.thr);
+	}
+	dev_close(dev);
+
+	return err;
+}
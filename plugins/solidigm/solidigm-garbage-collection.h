@@ -6,3 +6,4 @@
  */
 
 int solidigm_get_garbage_collection_log(int argc, char **argv, struct command *cmd, struct plugin *plugin);
+int solidigm_gc_latency(int argc, char **argv, struct command *cmd, struct plugin *plugin);
@@ -19,7 +19,10 @@
 #include "libnvme.h"
 #include "plugin.h"
 #include "nvme-print.h"
+#include "nvme-wrap.h"
 #include "solidigm-util.h"
+#include "util/stream.h"
+#include "util/thread-pool.h"
 
 #define DWORD_SIZE 4
 #define LOG_FILE_PERMISSION 0644
@@ -128,6 +131,7 @@ struct config {
 	char *out_dir;
 	char *type;
 	bool verbose;
+	__u32 jobs;
 };
 
 struct ilog {
@@ -172,11 +176,53 @@ static void print_nlog_header(__u8 *buffer)
 #define INTERNAL_LOG_MAX_BYTE_TRANSFER 4096
 #define INTERNAL_LOG_MAX_DWORD_TRANSFER (INTERNAL_LOG_MAX_BYTE_TRANSFER / 4)
 
+/*
+ * A dump of more than one transfer is written out by a helper thread, the
+ * next transfer is already running while the previous one is written.
+ */
+static int cmd_dump_stream(struct nvme_passthru_cmd *cmd, __u32 total_dw_size,
+			   int out_fd, int ioctl_fd, bool force_max_transfer)
+{
+	__u64 addr = cmd->addr;
+	struct nvme_stream s;
+	size_t len;
+	void *buf;
+	int err, serr;
+
+	err = nvme_stream_init(&s, out_fd, NVME_STREAM_TO_FILE, (__u64)total_dw_size * 4,
+			       INTERNAL_LOG_MAX_BYTE_TRANSFER, 4);
+	if (err)
+		return err;
+
+	while ((buf = nvme_stream_get(&s, &len))) {
+		cmd->cdw10 = force_max_transfer ? INTERNAL_LOG_MAX_DWORD_TRANSFER : len / 4;
+		cmd->addr = (unsigned long)buf;
+		cmd->data_len = len;
+		err = nvme_submit_admin_passthru(ioctl_fd, cmd, NULL);
+		if (err)
+			break;
+		nvme_stream_put(&s, len);
+		cmd->cdw13 += len / 4;
+	}
+	cmd->addr = addr;
+
+	serr = nvme_stream_finish(&s, err);
+	if (serr && !err) {
+		fprintf(stderr, "write failure: %s\n", strerror(-serr));
+		err = serr;
+	}
+	return err;
+}
+
 static int cmd_dump_repeat(struct nvme_passthru_cmd *cmd, __u32 total_dw_size,
 			   int out_fd, int ioctl_fd, bool force_max_transfer)
 {
 	int err = 0;
 
+	if (out_fd > 0 && total_dw_size > INTERNAL_LOG_MAX_DWORD_TRANSFER)
+		return cmd_dump_stream(cmd, total_dw_size, out_fd, ioctl_fd,
+				       force_max_transfer);
+
 	while (total_dw_size > 0) {
 		size_t dword_tfer = min(INTERNAL_LOG_MAX_DWORD_TRANSFER, total_dw_size);
 
@@ -437,7 +483,8 @@ int ensure_dir(const char *parent_dir_name, const char *name)
 
 	snprintf(file_path, sizeof(file_path) - 1, "%s/%s", parent_dir_name, name);
 	if (!(stat(file_path, &sb) == 0 && S_ISDIR(sb.st_mode))) {
-		if (mkdir(file_path, 777) != 0) {
+		/* another collection thread may have just created it */
+		if (mkdir(file_path, 777) != 0 && errno != EEXIST) {
 			perror(file_path);
 			return -errno;
 		}
@@ -648,6 +695,9 @@ static int ilog_dump_log_page(struct ilog *ilog, struct log *lp, __u32 nsid)
 
 	if (!lp->buffer_size)
 		return -EINVAL;
+	/* skip the pages the drive is known not to have */
+	if (!nvme_cli_log_supported(ilog->dev, lp->id, 0))
+		return -ENOTSUP;
 	if (!buff) {
 		buff = nvme_alloc(lp->buffer_size);
 		if (!buff)
@@ -798,6 +848,126 @@ static int ilog_dump_pel(struct ilog *ilog)
 	return err;
 }
 
+static int ilog_dump_hit(struct ilog *ilog)
+{
+	return ilog_dump_telemetry(ilog, HIT);
+}
+
+static int ilog_dump_cit(struct ilog *ilog)
+{
+	return ilog_dump_telemetry(ilog, CIT);
+}
+
+static int ilog_dump_all_nlogs(struct ilog *ilog)
+{
+	return ilog_dump_nlogs(ilog, -1);
+}
+
+/* in collection order, the first one records the actions of the others */
+static const struct ilog_category {
+	const char *name;
+	enum log_type type;	/* ALL: only part of a full collection */
+	int (*dump)(struct ilog *ilog);
+	bool counted;		/* a success is one more log file */
+} ilog_categories[] = {
+	{ "Host Initiated Telemetry", HIT, ilog_dump_hit, true },
+	{ "Nlog", NLOG, ilog_dump_all_nlogs, true },
+	{ "Controller Initiated Telemetry", CIT, ilog_dump_cit, true },
+	{ "Assert log", ASSERTLOG, ilog_dump_assert_logs, true },
+	{ "Event log", EVENTLOG, ilog_dump_event_logs, true },
+	{ "Identify pages", ALL, ilog_dump_identify_pages, false },
+	{ "Persistent Event Log page", ALL, ilog_dump_pel, false },
+	{ "no LSP Log pages", ALL, ilog_dump_no_lsp_log_pages, false },
+};
+
+#define NR_ILOG_CATEGORIES ARRAY_SIZE(ilog_categories)
+
+struct ilog_task {
+	const struct ilog_category *c;
+	struct ilog *ilog;
+	struct ilog own;	/* copy of a parallel task, counts its files */
+	int err;
+	int errnum;
+	__u64 elapsed_ns;
+};
+
+static void ilog_task_run(void *arg)
+{
+	struct ilog_task *t = arg;
+	__u64 start_ns = monotonic_ns();
+
+	t->err = t->c->dump(t->ilog);
+	t->errnum = errno;
+	t->elapsed_ns = monotonic_ns() - start_ns;
+	if (!t->err && t->c->counted)
+		t->ilog->count++;
+}
+
+/*
+ * Collect the selected categories, with --jobs in parallel after Host
+ * Initiated Telemetry, which is still taken first on its own. Returns
+ * the status of the last category, as collected one after the other.
+ */
+static int ilog_collect(struct ilog *ilog, enum log_type log_type)
+{
+	struct ilog_task tasks[NR_ILOG_CATEGORIES] = {};
+	struct nvme_thread_pool *pool = NULL;
+	__u64 start_ns = monotonic_ns();
+	int i, nr = 0, first = 0, err = 0;
+	__u32 jobs = 1;
+
+	for (i = 0; i < NR_ILOG_CATEGORIES; i++)
+		if (log_type == ALL || ilog_categories[i].type == log_type)
+			tasks[nr++].c = &ilog_categories[i];
+
+	if (ilog->cfg->jobs > 1 && nr > 1) {
+		if (tasks[0].c->type == HIT) {
+			tasks[0].ilog = ilog;
+			ilog_task_run(&tasks[0]);
+			first = 1;
+		}
+		/* loaded once here, the dumps only read it */
+		ilog_ensure_dump_id_ctrl(ilog);
+		jobs = min(ilog->cfg->jobs, (__u32)(nr - first));
+		pool = nvme_thread_pool_create(jobs);
+	}
+
+	for (i = first; i < nr; i++) {
+		if (!pool) {
+			tasks[i].ilog = ilog;
+			ilog_task_run(&tasks[i]);
+			continue;
+		}
+		tasks[i].own = *ilog;
+		tasks[i].own.count = 0;
+		tasks[i].ilog = &tasks[i].own;
+		if (nvme_thread_pool_queue(pool, ilog_task_run, &tasks[i]))
+			ilog_task_run(&tasks[i]);
+	}
+	if (pool) {
+		nvme_thread_pool_destroy(pool);
+		for (i = first; i < nr; i++)
+			ilog->count += tasks[i].own.count;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (tasks[i].err < 0)
+			fprintf(stderr, "Error retrieving %s: %s\n", tasks[i].c->name,
+				strerror(tasks[i].errnum));
+		err = tasks[i].err;
+	}
+
+	if (ilog->cfg->jobs > 1 || ilog->cfg->verbose) {
+		for (i = 0; i < nr; i++)
+			printf("%-32s: %9.1f ms%s\n", tasks[i].c->name,
+			       tasks[i].elapsed_ns / 1e6, tasks[i].err ? " (failed)" : "");
+		printf("%-32s: %9.1f ms, %u job(s)\n", "Total",
+		       (monotonic_ns() - start_ns) / 1e6, pool ? jobs : 1);
+	}
+
+	return err;
+}
+
 int solidigm_get_internal_log(int argc, char **argv, struct command *command,
 				struct plugin *plugin)
 {
@@ -820,16 +990,19 @@ int solidigm_get_internal_log(int argc, char **argv, struct command *command,
 	const char *type = "Log type; Defaults to ALL.";
 	const char *out_dir = "Output directory; defaults to current working directory.";
 	const char *verbose = "To print out verbose info.";
+	const char *jobs = "Collect up to this many log categories in parallel.";
 
 	struct config cfg = {
 		.out_dir = ".",
 		.type = type_ALL,
+		.jobs = 1,
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("type",     't', "ALL|CIT|HIT|NLOG|ASSERT|EVENT", &cfg.type, type),
 		OPT_STRING("dir-name", 'd', "DIRECTORY", &cfg.out_dir, out_dir),
 		OPT_FLAG("verbose",    'v', &cfg.verbose,      verbose),
+		OPT_UINT("jobs",       'j', &cfg.jobs,         jobs),
 		OPT_END()
 	};
 
@@ -884,55 +1057,7 @@ int solidigm_get_internal_log(int argc, char **argv, struct command *command,
 	cfg.out_dir = full_folder;
 	output_path = full_folder;
 
-	/* Retrieve first logs that records actions to retrieve other logs */
-	if (log_type == ALL || log_type == HIT) {
-		err = ilog_dump_telemetry(&ilog, HIT);
-		if (err == 0)
-			ilog.count++;
-		else if (err < 0)
-			perror("Error retrieving Host Initiated Telemetry");
-	}
-	if (log_type == ALL || log_type == NLOG) {
-		err = ilog_dump_nlogs(&ilog, -1);
-		if (err == 0)
-			ilog.count++;
-		else if (err < 0)
-			perror("Error retrieving Nlog");
-	}
-	if (log_type == ALL || log_type == CIT) {
-		err = ilog_dump_telemetry(&ilog, CIT);
-		if (err == 0)
-			ilog.count++;
-		else if (err < 0)
-			perror("Error retrieving Controller Initiated Telemetry");
-	}
-	if (log_type == ALL || log_type == ASSERTLOG) {
-		err = ilog_dump_assert_logs(&ilog);
-		if (err == 0)
-			ilog.count++;
-		else if (err < 0)
-			perror("Error retrieving Assert log");
-	}
-	if (log_type == ALL || log_type == EVENTLOG) {
-		err = ilog_dump_event_logs(&ilog);
-		if (err == 0)
-			ilog.count++;
-		else if (err < 0)
-			perror("Error retrieving Event log");
-	}
-	if (log_type == ALL) {
-		err = ilog_dump_identify_pages(&ilog);
-		if (err < 0)
-			perror("Error retrieving Identify pages");
-
-		err = ilog_dump_pel(&ilog);
-		if (err < 0)
-			perror("Error retrieving Persistent Event Log page");
-
-		err = ilog_dump_no_lsp_log_pages(&ilog);
-		if (err < 0)
-			perror("Error retrieving no LSP Log pages");
-	}
+	err = ilog_collect(&ilog, log_type);
 
 	if (ilog.count > 0) {
 		int ret_cmd;
@@ -6,8 +6,11 @@
  */
 
 #include <errno.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <inttypes.h>
 
@@ -17,6 +20,7 @@
 #include "plugin.h"
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "util/interval.h"
 #include "solidigm-util.h"
 
 #define BUCKET_LIST_SIZE_4_0 152
@@ -39,6 +43,8 @@ struct config {
 	bool write;
 	unsigned char type;
 	char *output_format;
+	__u32 interval;
+	__u32 count;
 };
 
 struct latency_tracker {
@@ -237,6 +243,18 @@ static void latency_tracker_post_parse(struct latency_tracker *lt)
 	}
 }
 
+static void latency_tracker_set_layout_4(struct latency_tracker *lt)
+{
+	__u16 version_minor = le16_to_cpu(lt->stats.version_minor);
+
+	if (version_minor >= 8)
+		lt->has_average_latency_field = true;
+	if (!version_minor) {
+		lt->base_range_bits = BASE_RANGE_BITS_4_0;
+		lt->bucket_list_size = BUCKET_LIST_SIZE_4_0;
+	}
+}
+
 static void latency_tracker_parse(struct latency_tracker *lt)
 {
 	__u16 version_major = le16_to_cpu(lt->stats.version_major);
@@ -248,13 +266,8 @@ static void latency_tracker_parse(struct latency_tracker *lt)
 		latency_tracker_parse_3_0(lt);
 		break;
 	case 4:
-		if (version_minor >= 8)
-			lt->has_average_latency_field = true;
+		latency_tracker_set_layout_4(lt);
 		latency_tracker_pre_parse(lt);
-		if (!version_minor) {
-			lt->base_range_bits = BASE_RANGE_BITS_4_0;
-			lt->bucket_list_size = BUCKET_LIST_SIZE_4_0;
-		}
 		latency_tracker_parse_4_0(lt);
 		break;
 	default:
@@ -334,18 +347,8 @@ static int latency_tracking_enable(struct latency_tracker *lt)
 #define READ_LOG_ID 0xc1
 #define WRITE_LOG_ID 0xc2
 
-static int latency_tracker_get_log(struct latency_tracker *lt)
+static int latency_tracker_read_log(struct latency_tracker *lt)
 {
-	int err;
-
-	if (lt->cfg.read && lt->cfg.write) {
-		fprintf(stderr, "Cannot capture read and write logs simultaneously.\n");
-		return -EINVAL;
-	}
-
-	if (!(lt->cfg.read || lt->cfg.write))
-		return 0;
-
 	struct nvme_get_log_args args = {
 		.lpo	= 0,
 		.result = NULL,
@@ -364,7 +367,195 @@ static int latency_tracker_get_log(struct latency_tracker *lt)
 		.ot	= false,
 	};
 
-	err = nvme_get_log(&args);
+	return nvme_get_log(&args);
+}
+
+static const double latency_percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+/* the buckets of a 4.x revision log as read, with their boundaries */
+static void latency_tracker_hist(const struct latency_tracker *lt, struct nvme_lat_hist *h)
+{
+	unsigned int i;
+
+	nvme_lat_hist_init(h, 0);
+	for (i = 0; i < lt->bucket_list_size; i++)
+		nvme_lat_hist_add_bucket(h, latency_tracker_bucket_pos2us(lt, i),
+					 i < lt->bucket_list_size - 1 ?
+					 latency_tracker_bucket_pos2us(lt, i + 1) :
+					 NVME_LAT_HIST_INF,
+					 le32_to_cpu(lt->stats.data[i]));
+}
+
+static int latency_tracker_read_hist(struct latency_tracker *lt, struct nvme_lat_hist *h)
+{
+	int err;
+
+	err = latency_tracker_read_log(lt);
+	if (err)
+		return err < 0 ? -errno : err;
+	if (le16_to_cpu(lt->stats.version_major) != 4)
+		return -ENOTSUP;
+
+	latency_tracker_set_layout_4(lt);
+	latency_tracker_hist(lt, h);
+	return 0;
+}
+
+static int solidigm_lat_source_read(struct nvme_dev *dev, const struct nvme_id_ctrl *ctrl,
+				    enum nvme_lat_type type, struct nvme_lat_hist *h)
+{
+	struct latency_tracker lt = {
+		.fd = dev_fd(dev),
+		.cfg = {
+			.write = type == NVME_LAT_WRITE,
+		},
+		.base_range_bits = BASE_RANGE_BITS_4_1,
+		.bucket_list_size = BUCKET_LIST_SIZE_4_1,
+	};
+
+	if (le16_to_cpu(ctrl->vid) != SOLIDIGM_VID ||
+	    (type != NVME_LAT_READ && type != NVME_LAT_WRITE))
+		return -ENOTSUP;
+
+	sldgm_get_uuid_index(dev, &lt.uuid_index);
+	return latency_tracker_read_hist(&lt, h);
+}
+
+static struct nvme_lat_source solidigm_lat_source = {
+	.name = "solidigm",
+	.read = solidigm_lat_source_read,
+};
+
+NVME_LAT_SOURCE(solidigm_lat_source)
+
+/*
+ * One sample of the continuous mode: the IOs completed in the interval
+ * and the latency percentiles estimated from the buckets they fell in,
+ * as the upper edge of the bucket reaching each percentile.
+ */
+static void latency_tracker_sample_print(const struct latency_tracker *lt,
+					 const struct nvme_lat_hist *delta,
+					 __u64 timestamp_ms, __u64 interval_ns)
+{
+	unsigned int i, p;
+
+	if (lt->print_flags == JSON) {
+		struct json_object *r = json_create_object();
+		struct json_object *buckets = json_create_array();
+		char key[16];
+
+		json_object_add_value_uint64(r, "timestamp_ms", timestamp_ms);
+		json_object_add_value_uint64(r, "interval_ms", interval_ns / 1000000);
+		json_object_add_value_string(r, "type", lt->cfg.write ? "write" : "read");
+		json_object_add_value_uint64(r, "ios", nvme_lat_hist_count(delta));
+		for (p = 0; p < ARRAY_SIZE(latency_percentiles); p++) {
+			snprintf(key, sizeof(key), "p%g_us", latency_percentiles[p]);
+			json_object_add_value_uint(r, key,
+				nvme_lat_hist_percentile(delta, latency_percentiles[p]));
+		}
+		json_object_add_value_uint(r, "max_us", nvme_lat_hist_max(delta));
+		if (lt->has_average_latency_field)
+			json_object_add_value_uint64(r, "average_latency",
+						     le64_to_cpu(lt->stats.average_latency));
+		for (i = 0; i < delta->nr_buckets; i++) {
+			struct json_object *bucket;
+
+			if (!delta->buckets[i].count)
+				continue;
+			bucket = json_create_array();
+			json_object_array_add(bucket, json_object_new_int(i));
+			json_object_array_add(bucket,
+					      json_object_new_int64(delta->buckets[i].count));
+			json_object_array_add(buckets, bucket);
+		}
+		json_object_add_value_array(r, "buckets", buckets);
+		util_json_write_record(stdout, r, true);
+	} else {
+		printf("%" PRIu64 " %s ios %" PRIu64, timestamp_ms,
+		       lt->cfg.write ? "write" : "read", nvme_lat_hist_count(delta));
+		for (p = 0; p < ARRAY_SIZE(latency_percentiles); p++)
+			printf(" p%g %uus", latency_percentiles[p],
+			       nvme_lat_hist_percentile(delta, latency_percentiles[p]));
+		printf(" max %uus\n", nvme_lat_hist_max(delta));
+	}
+	fflush(stdout);
+}
+
+/*
+ * --interval: keep sampling the log and report the buckets filled between
+ * two consecutive samples.
+ */
+static int latency_tracker_sampler(struct latency_tracker *lt)
+{
+	_cleanup_free_ struct nvme_lat_hist *hists = NULL;
+	struct nvme_lat_hist *cur, *prev, *delta, *tmp;
+	__u64 next, now, last;
+	struct timespec ts;
+	__u32 n;
+	int err;
+
+	hists = malloc(3 * sizeof(*hists));
+	if (!hists)
+		return -ENOMEM;
+	prev = &hists[0];
+	cur = &hists[1];
+	delta = &hists[2];
+
+	err = latency_tracker_read_hist(lt, prev);
+	if (err == -ENOTSUP) {
+		fprintf(stderr, "Continuous mode unsupported on revision (%u.%u)\n",
+			le16_to_cpu(lt->stats.version_major),
+			le16_to_cpu(lt->stats.version_minor));
+		return -EINVAL;
+	}
+	if (err)
+		return err;
+
+	nvme_stop_catch(true, NULL);
+
+	next = last = monotonic_ns();
+	for (n = 0; !lt->cfg.count || n < lt->cfg.count; n++) {
+		next += (__u64)lt->cfg.interval * NSEC_PER_SEC;
+		if (!nvme_interval_wait(next))
+			break;
+
+		err = latency_tracker_read_hist(lt, cur);
+		if (!err)
+			err = nvme_lat_hist_delta(delta, cur, prev);
+		if (err)
+			break;
+
+		now = monotonic_ns();
+		clock_gettime(CLOCK_REALTIME, &ts);
+		latency_tracker_sample_print(lt, delta,
+					     ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000,
+					     now - last);
+		tmp = prev;
+		prev = cur;
+		cur = tmp;
+		last = now;
+	}
+
+	nvme_stop_release();
+	return err;
+}
+
+static int latency_tracker_get_log(struct latency_tracker *lt)
+{
+	int err;
+
+	if (lt->cfg.read && lt->cfg.write) {
+		fprintf(stderr, "Cannot capture read and write logs simultaneously.\n");
+		return -EINVAL;
+	}
+
+	if (!(lt->cfg.read || lt->cfg.write))
+		return 0;
+
+	if (lt->cfg.interval)
+		return latency_tracker_sampler(lt);
+
+	err = latency_tracker_read_log(lt);
 	if (err)
 		return err;
 
@@ -402,6 +593,10 @@ int solidigm_get_latency_tracking_log(int argc, char **argv, struct command *cmd
 		OPT_FLAG("write", 'w', &lt.cfg.write, "Get write statistics"),
 		OPT_BYTE("type", 't', &lt.cfg.type, "Log type to get"),
 		OPT_FMT("output-format", 'o', &lt.cfg.output_format, output_format),
+		OPT_UINT("interval", 'i', &lt.cfg.interval,
+			 "Sample the statistics every <interval> seconds and report the latency of each interval"),
+		OPT_UINT("count", 'c', &lt.cfg.count,
+			 "Number of samples with --interval, default until interrupted"),
 		OPT_END()
 	};
 
@@ -424,6 +619,18 @@ int solidigm_get_latency_tracking_log(int argc, char **argv, struct command *cmd
 		return -EINVAL;
 	}
 
+	if ((lt.cfg.interval || lt.cfg.count) && !(lt.cfg.read || lt.cfg.write)) {
+		fprintf(stderr, "Interval option valid only when retrieving statistics\n");
+		dev_close(dev);
+		return -EINVAL;
+	}
+
+	if (lt.cfg.interval && lt.print_flags == BINARY) {
+		fprintf(stderr, "Interval option doesn't support binary output\n");
+		dev_close(dev);
+		return -EINVAL;
+	}
+
 	if (lt.cfg.type && !(lt.cfg.read || lt.cfg.write)) {
 		fprintf(stderr, "Log type option valid only when retrieving statistics\n");
 		dev_close(dev);
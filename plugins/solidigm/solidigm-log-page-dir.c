@@ -13,6 +13,7 @@
 
 #include "common.h"
 #include "nvme-print.h"
+#include "nvme-wrap.h"
 
 #include "plugins/ocp/ocp-utils.h"
 #include "solidigm-util.h"
@@ -43,25 +44,8 @@ static int get_supported_log_pages_log(struct nvme_dev *dev, int uuid_index,
 				       struct nvme_supported_log_pages *supported)
 {
 	memset(supported, 0, sizeof(*supported));
-	struct nvme_get_log_args args = {
-		.lpo = 0,
-		.result = NULL,
-		.log = supported,
-		.args_size = sizeof(args),
-		.fd = dev_fd(dev),
-		.timeout = NVME_DEFAULT_IOCTL_TIMEOUT,
-		.lid = NVME_LOG_LID_SUPPORTED_LOG_PAGES,
-		.len = sizeof(*supported),
-		.nsid = NVME_NSID_ALL,
-		.csi = NVME_CSI_NVM,
-		.lsi = NVME_LOG_LSI_NONE,
-		.lsp = 0,
-		.uuidx = uuid_index,
-		.rae = false,
-		.ot = false,
-	};
 
-	return nvme_get_log(&args);
+	return nvme_cli_get_log_supported_uuid(dev, uuid_index, supported);
 }
 
 static struct lid_dir *get_standard_lids(struct nvme_supported_log_pages *supported)
@@ -210,7 +194,7 @@ int solidigm_get_log_page_directory_log(int argc, char **argv, struct command *c
 		lid_dirs[NO_UUID_INDEX] = get_standard_lids(&supported);
 
 		// Assume VU logs are the Solidigm log pages if UUID not supported.
-		if (nvme_identify_uuid(dev_fd(dev), &uuid_list)) {
+		if (nvme_cli_identify_uuid(dev, &uuid_list)) {
 			struct lid_dir *solidigm_lid_dir = get_solidigm_lids(&supported);
 
 			// Transfer supported Solidigm lids to lid directory at UUID index 0
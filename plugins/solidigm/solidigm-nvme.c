@@ -47,6 +47,11 @@ static int get_garbage_collection_log(int argc, char **argv, struct command *cmd
 	return solidigm_get_garbage_collection_log(argc, argv, cmd, plugin);
 }
 
+static int get_gc_latency(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	return solidigm_gc_latency(argc, argv, cmd, plugin);
+}
+
 static int get_latency_tracking_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	return solidigm_get_latency_tracking_log(argc, argv, cmd, plugin);
@@ -114,3 +119,15 @@ static int get_workload_tracker(int argc, char **argv, struct command *cmd,
 {
 	return sldgm_get_workload_tracker(argc, argv, cmd, plugin);
 }
+
+static int decode_workload_tracker(int argc, char **argv, struct command *cmd,
+				   struct plugin *plugin)
+{
+	return sldgm_decode_workload_tracker(argc, argv, cmd, plugin);
+}
+
+static int workload_tracker_profile(int argc, char **argv, struct command *cmd,
+				    struct plugin *plugin)
+{
+	return sldgm_workload_tracker_profile(argc, argv, cmd, plugin);
+}
@@ -22,6 +22,8 @@ PLUGIN(NAME("solidigm", "Solidigm vendor specific extensions", SOLIDIGM_PLUGIN_V
 		ENTRY("vs-smart-add-log", "Get SMART / health extended log (redirects to ocp plug-in)", smart_cloud)
 		ENTRY("vs-internal-log", "Retrieve Debug log binaries", get_internal_log)
 		ENTRY("garbage-collect-log", "Retrieve Garbage Collection Log", get_garbage_collection_log)
+		ENTRY("gc-latency", "Correlate I/O latency with Garbage Collection events",
+		      get_gc_latency)
 		ENTRY("market-log", "Retrieve Market Log", get_market_log)
 		ENTRY("latency-tracking-log", "Enable/Retrieve Latency tracking Log", get_latency_tracking_log)
 		ENTRY("parse-telemetry-log", "Parse Telemetry Log binary", get_telemetry_log)
@@ -34,6 +36,10 @@ PLUGIN(NAME("solidigm", "Solidigm vendor specific extensions", SOLIDIGM_PLUGIN_V
 		ENTRY("cloud-SSDplugin-version", "Prints plug-in OCP version", get_cloud_SSDplugin_version)
 		ENTRY("workload-tracker", "Real Time capture Workload Tracker samples",
 		      get_workload_tracker)
+		ENTRY("workload-tracker-decode", "Print a Workload Tracker ring file",
+		      decode_workload_tracker)
+		ENTRY("workload-tracker-profile", "Convert a Workload Tracker ring file into an io-bench profile",
+		      workload_tracker_profile)
 	)
 );
 
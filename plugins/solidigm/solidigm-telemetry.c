@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "common.h"
 #include "nvme.h"
@@ -46,12 +48,41 @@ static int read_file2buffer(char *file_name, char **buffer, size_t *length)
 	return 0;
 }
 
+/*
+ * Map a log dump instead of reading it, the decoder only touches the
+ * pages of the objects it parses and the page cache backs the rest.
+ */
+static int map_file2buffer(char *file_name, void **buffer, size_t *length)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(file_name, O_RDONLY);
+	if (fd < 0)
+		return errno;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size) {
+		close(fd);
+		return EINVAL;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return errno;
+	madvise(map, st.st_size, MADV_WILLNEED);
+
+	*buffer = map;
+	*length = st.st_size;
+	return 0;
+}
+
 struct config {
 	__u32 host_gen;
 	bool ctrl_init;
 	int  data_area;
 	char *cfg_file;
 	bool is_input_file;
+	char *nlog_events;
 };
 
 int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
@@ -62,7 +93,9 @@ int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struc
 	const char *dgen = "Pick which telemetry data area to report. Default is 3 to fetch areas 1-3. Valid options are 1, 2, 3, 4.";
 	const char *cfile = "JSON configuration file";
 	const char *sfile = "data source <device> is binary file containing log dump instead of block or character device";
+	const char *efile = "Write the decoded NLOG events to this file, one JSON line per event, instead of into the report";
 	struct nvme_dev *dev;
+	bool mapped = false;
 
 	struct telemetry_log tl = {
 		.root = json_create_object(),
@@ -75,6 +108,7 @@ int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struc
 		.data_area  = -1,
 		.cfg_file   = NULL,
 		.is_input_file = false,
+		.nlog_events = NULL,
 	};
 
 	OPT_ARGS(opts) = {
@@ -83,6 +117,7 @@ int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struc
 		OPT_UINT("data-area",       'd', &cfg.data_area, dgen),
 		OPT_FILE("config-file",     'j', &cfg.cfg_file, cfile),
 		OPT_FLAG("source-file",     's', &cfg.is_input_file, sfile),
+		OPT_FILE("nlog-events",     'e', &cfg.nlog_events, efile),
 		OPT_END()
 	};
 
@@ -103,7 +138,12 @@ int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struc
 		}
 		char *binary_file_name = argv[optind];
 
-		err = read_file2buffer(binary_file_name, (char **)&tl.log, &tl.log_size);
+		err = map_file2buffer(binary_file_name, (void **)&tl.log, &tl.log_size);
+		if (!err)
+			mapped = true;
+		else
+			err = read_file2buffer(binary_file_name, (char **)&tl.log,
+					       &tl.log_size);
 	} else {
 		err = parse_and_open(&dev, argc, argv, desc, opts);
 	}
@@ -142,6 +182,17 @@ int solidigm_get_telemetry_log(int argc, char **argv, struct command *cmd, struc
 		json_tokener_free(jstok);
 	}
 
+	if (cfg.nlog_events) {
+		tl.nlog_events = fopen(cfg.nlog_events, "w");
+		if (!tl.nlog_events) {
+			err = errno;
+			SOLIDIGM_LOG_WARNING("Failed to open NLOG events file %s: %s!",
+					     cfg.nlog_events, strerror(err));
+			goto close_fd;
+		}
+		setvbuf(tl.nlog_events, NULL, _IOFBF, 1 << 20);
+	}
+
 	if (!cfg.is_input_file) {
 		size_t max_data_tx;
 
@@ -183,7 +234,16 @@ close_fd:
 		dev_close(dev);
 	}
 ret:
+	if (tl.nlog_events && fclose(tl.nlog_events) && !err) {
+		err = errno;
+		SOLIDIGM_LOG_WARNING("Failed to write NLOG events file %s: %s!",
+				     cfg.nlog_events, strerror(err));
+	}
+	solidigm_config_free_layouts(tl.layouts);
 	json_free_object(tl.configuration);
-	free(tl.log);
+	if (mapped)
+		munmap(tl.log, tl.log_size);
+	else
+		free(tl.log);
 	return err;
 }
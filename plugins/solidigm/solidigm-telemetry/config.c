@@ -6,8 +6,10 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "config.h"
+#include "telemetry-log.h"
 
 // max 16 bit unsigned integer number 65535
 #define MAX_16BIT_NUM_AS_STRING_SIZE  6
@@ -15,6 +17,21 @@
 #define OBJ_NAME_PREFIX "UID_"
 #define NLOG_OBJ_PREFIX OBJ_NAME_PREFIX "NLOG_"
 
+#define SIGNED_INT_PREFIX "int"
+#define LAYOUT_CACHE_MIN_SIZE 64
+
+struct solidigm_layout_entry {
+	uint64_t key;
+	bool used;
+	struct solidigm_layout *layout;	/* NULL when not in the configuration */
+};
+
+struct solidigm_layout_cache {
+	size_t size;			/* a power of two */
+	size_t nr;
+	struct solidigm_layout_entry *entries;
+};
+
 static bool config_get_by_version(const struct json_object *obj, int version_major,
 				  int version_minor, struct json_object **value)
 {
@@ -47,6 +64,197 @@ bool solidigm_config_get_struct_by_token_version(const struct json_object *confi
 	return value != NULL;
 }
 
+static void layout_compile(struct solidigm_layout *l, struct json_object *def)
+{
+	struct json_object *obj = NULL;
+	struct json_object *obj_arraySizeArray = NULL;
+	struct json_object *obj_memberList = NULL;
+	bool is_enumeration = false;
+	bool has_member_list;
+	const char *type = "";
+
+	l->def = def;
+	if (json_object_object_get_ex(def, "hasTelemObjHdr", &obj))
+		l->has_telem_obj_hdr = json_object_get_boolean(obj);
+
+	if (!json_object_object_get_ex(def, "name", &obj)) {
+		SOLIDIGM_LOG_WARNING("Warning: Structure definition missing property 'name': %s",
+				     json_object_to_json_string(def));
+		return;
+	}
+	l->name_obj = obj;
+	l->name = json_object_get_string(obj);
+
+	if (json_object_object_get_ex(def, "type", &obj))
+		type = json_object_get_string(obj);
+	l->is_signed = !strncmp(type, SIGNED_INT_PREFIX, sizeof(SIGNED_INT_PREFIX) - 1);
+
+	if (!json_object_object_get_ex(def, "offsetBit", &obj)) {
+		SOLIDIGM_LOG_WARNING(
+		    "Warning: Structure definition missing property 'offsetBit': %s",
+		    json_object_to_json_string(def));
+		return;
+	}
+	l->offset_bit = json_object_get_uint64(obj);
+
+	if (!json_object_object_get_ex(def, "sizeBit", &obj)) {
+		SOLIDIGM_LOG_WARNING(
+		    "Warning: Structure definition missing property 'sizeBit': %s",
+		    json_object_to_json_string(def));
+		return;
+	}
+	l->size_bit = (uint32_t)json_object_get_uint64(obj);
+
+	if (json_object_object_get_ex(def, "enum", &obj))
+		is_enumeration = json_object_get_boolean(obj);
+
+	has_member_list = json_object_object_get_ex(def, "memberList", &obj_memberList);
+
+	if (!json_object_object_get_ex(def, "arraySize", &obj_arraySizeArray)) {
+		SOLIDIGM_LOG_WARNING(
+		    "Warning: Structure definition missing property 'arraySize': %s",
+		    json_object_to_json_string(def));
+		return;
+	}
+
+	l->array_rank = json_object_array_length(obj_arraySizeArray);
+	if (!l->array_rank) {
+		SOLIDIGM_LOG_WARNING(
+		    "Warning: Structure property 'arraySize' don't support flexible array: %s",
+		    json_object_to_json_string(def));
+		return;
+	}
+	if (l->array_rank > SOLIDIGM_MAX_ARRAY_RANK) {
+		SOLIDIGM_LOG_WARNING(
+		    "Warning: Structure property 'arraySize' don't support more than %d dimensions: %s",
+		    SOLIDIGM_MAX_ARRAY_RANK, json_object_to_json_string(def));
+		return;
+	}
+	for (size_t i = 0; i < l->array_rank; i++) {
+		struct json_object *dimension = json_object_array_get_idx(obj_arraySizeArray, i);
+
+		l->array_size[i] = json_object_get_int(dimension);
+	}
+
+	l->is_value = is_enumeration || !has_member_list;
+	if (!l->is_value) {
+		int num_members = json_object_array_length(obj_memberList);
+
+		if (num_members) {
+			l->members = calloc(num_members, sizeof(*l->members));
+			if (!l->members)
+				return;
+		}
+		l->nr_members = num_members;
+		for (int k = 0; k < num_members; k++)
+			layout_compile(&l->members[k],
+				       json_object_array_get_idx(obj_memberList, k));
+	}
+	l->valid = true;
+}
+
+static void layout_free(struct solidigm_layout *l)
+{
+	for (int k = 0; k < l->nr_members; k++)
+		layout_free(&l->members[k]);
+	free(l->members);
+}
+
+static size_t layout_cache_index(const struct solidigm_layout_cache *c, uint64_t key)
+{
+	return ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (c->size - 1);
+}
+
+static struct solidigm_layout_entry *layout_cache_find(struct solidigm_layout_cache *c,
+						       uint64_t key)
+{
+	size_t i = layout_cache_index(c, key);
+
+	while (c->entries[i].used && c->entries[i].key != key)
+		i = (i + 1) & (c->size - 1);
+	return &c->entries[i];
+}
+
+static int layout_cache_grow(struct solidigm_layout_cache *c)
+{
+	struct solidigm_layout_entry *old = c->entries;
+	size_t old_size = c->size;
+
+	c->size = old_size ? old_size * 2 : LAYOUT_CACHE_MIN_SIZE;
+	c->entries = calloc(c->size, sizeof(*c->entries));
+	if (!c->entries) {
+		c->entries = old;
+		c->size = old_size;
+		return -1;
+	}
+	for (size_t i = 0; i < old_size; i++)
+		if (old[i].used)
+			*layout_cache_find(c, old[i].key) = old[i];
+	free(old);
+	return 0;
+}
+
+const struct solidigm_layout *solidigm_config_get_layout(const struct json_object *config,
+							 struct solidigm_layout_cache **cache,
+							 uint32_t token_id, int version_major,
+							 int version_minor)
+{
+	uint64_t key = ((uint64_t)token_id << 32) |
+		       ((uint64_t)(version_major & 0xffff) << 16) |
+		       (version_minor & 0xffff);
+	struct solidigm_layout_cache *c = *cache;
+	struct solidigm_layout_entry *e;
+	struct json_object *def = NULL;
+	struct solidigm_layout *l = NULL;
+
+	if (!c) {
+		c = calloc(1, sizeof(*c));
+		if (!c || layout_cache_grow(c)) {
+			free(c);
+			return NULL;
+		}
+		*cache = c;
+	}
+
+	e = layout_cache_find(c, key);
+	if (e->used)
+		return e->layout;
+
+	/* keep the load under a half for short probes */
+	if ((c->nr + 1) * 2 > c->size) {
+		if (layout_cache_grow(c))
+			return NULL;
+		e = layout_cache_find(c, key);
+	}
+
+	if (solidigm_config_get_struct_by_token_version(config, token_id, version_major,
+							version_minor, &def)) {
+		l = calloc(1, sizeof(*l));
+		if (!l)
+			return NULL;
+		layout_compile(l, def);
+	}
+	e->key = key;
+	e->used = true;
+	e->layout = l;
+	c->nr++;
+	return l;
+}
+
+void solidigm_config_free_layouts(struct solidigm_layout_cache *cache)
+{
+	if (!cache)
+		return;
+	for (size_t i = 0; i < cache->size; i++) {
+		if (cache->entries[i].layout) {
+			layout_free(cache->entries[i].layout);
+			free(cache->entries[i].layout);
+		}
+	}
+	free(cache->entries);
+	free(cache);
+}
+
 const char *solidigm_config_get_nlog_obj_name(const struct json_object *config, uint32_t token)
 {
 	struct json_object *nlog_names = NULL;
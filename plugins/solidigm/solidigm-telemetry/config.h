@@ -5,15 +5,51 @@
  * Author: leonardo.da.cunha@solidigm.com
  */
 #include <stdbool.h>
+#include <stdint.h>
 #include "util/json.h"
 
 #define STR_HEX32_SIZE sizeof("0x00000000")
+#define SOLIDIGM_MAX_ARRAY_RANK 16
+
+/*
+ * A structure definition of the configuration compiled once, so decoding
+ * the objects of a log doesn't look up the properties of the definition
+ * at every field and every array element.
+ */
+struct solidigm_layout {
+	struct json_object *def;	/* the definition, for the warnings */
+	struct json_object *name_obj;
+	const char *name;
+	uint64_t offset_bit;
+	uint32_t size_bit;
+	bool valid;			/* all the properties needed are there */
+	bool is_signed;
+	bool is_value;			/* an enumeration or without members */
+	bool has_telem_obj_hdr;
+	size_t array_rank;
+	uint32_t array_size[SOLIDIGM_MAX_ARRAY_RANK];
+	int nr_members;
+	struct solidigm_layout *members;
+};
+
+struct solidigm_layout_cache;
 
 bool solidigm_config_get_struct_by_token_version(const struct json_object *obj,
 					  int key, int subkey,
 					  int subsubkey,
 					  struct json_object **value);
 
+/*
+ * The compiled definition of a token version, NULL when the configuration
+ * doesn't have it. Each version is compiled on its first lookup and kept
+ * in *cache, a hash table created on demand.
+ */
+const struct solidigm_layout *solidigm_config_get_layout(const struct json_object *config,
+							 struct solidigm_layout_cache **cache,
+							 uint32_t token_id, int version_major,
+							 int version_minor);
+void solidigm_config_free_layouts(struct solidigm_layout_cache *cache);
+
 const char *solidigm_config_get_nlog_obj_name(const struct json_object *config, uint32_t token);
 struct json_object *solidigm_config_get_nlog_formats(const struct json_object *config);
 
@@ -13,11 +13,9 @@
 #include "nlog.h"
 #include <ctype.h>
 
-#define SIGNED_INT_PREFIX "int"
 #define BITS_IN_BYTE 8
 
 #define MAX_WARNING_SIZE 1024
-#define MAX_ARRAY_RANK 16
 
 static bool telemetry_log_get_value(const struct telemetry_log *tl,
 				    uint64_t offset_bit, uint32_t size_bit,
@@ -64,7 +62,15 @@ static bool telemetry_log_get_value(const struct telemetry_log *tl,
 		return false;
 	}
 
-	val = *(uint64_t *)(((char *)tl->log) + offset_byte);
+	/* a mapped log isn't followed by readable bytes past its end */
+	if (offset_byte + sizeof(val) <= tl->log_size) {
+		memcpy(&val, ((char *)tl->log) + offset_byte, sizeof(val));
+	} else {
+		val = 0;
+		if (offset_byte < tl->log_size)
+			memcpy(&val, ((char *)tl->log) + offset_byte,
+			       tl->log_size - offset_byte);
+	}
 	val >>= offset_bit_from_byte;
 	if (size_bit < 64)
 		val &= (1ULL << size_bit) - 1;
@@ -80,184 +86,106 @@ static bool telemetry_log_get_value(const struct telemetry_log *tl,
 }
 
 static int telemetry_log_structure_parse(const struct telemetry_log *tl,
-					 struct json_object *struct_def,
+					 const struct solidigm_layout *l,
+					 size_t array_rank,
 					 uint64_t parent_offset_bit,
 					 struct json_object *output,
 					 struct json_object *metadata)
 {
-	struct json_object *obj_arraySizeArray = NULL;
-	struct json_object *obj = NULL;
-	struct json_object *obj_memberList;
-	struct json_object *major_dimension = NULL;
 	struct json_object *sub_output;
-	bool is_enumeration = false;
-	bool has_member_list;
-	const char *type = "";
-	const char *name;
-	size_t array_rank;
-	uint64_t offset_bit;
-	uint32_t size_bit;
 	uint64_t linear_array_pos_bit;
-	uint32_t array_size_dimension[MAX_ARRAY_RANK];
-
-	if (!json_object_object_get_ex(struct_def, "name", &obj)) {
-		SOLIDIGM_LOG_WARNING("Warning: Structure definition missing property 'name': %s",
-				     json_object_to_json_string(struct_def));
-		return  -1;
-	}
 
-	name = json_object_get_string(obj);
+	if (!l->name_obj)
+		return -1;
 
 	if (metadata) {
-		json_object_get(obj);
-		json_object_object_add(metadata, "objName", obj);
-	}
-
-	if (json_object_object_get_ex(struct_def, "type", &obj))
-		type = json_object_get_string(obj);
-
-	if (!json_object_object_get_ex(struct_def, "offsetBit", &obj)) {
-		SOLIDIGM_LOG_WARNING(
-		    "Warning: Structure definition missing property 'offsetBit': %s",
-		    json_object_to_json_string(struct_def));
-		return  -1;
-	}
-
-	offset_bit = json_object_get_uint64(obj);
-
-	if (!json_object_object_get_ex(struct_def, "sizeBit", &obj)) {
-		SOLIDIGM_LOG_WARNING(
-		    "Warning: Structure definition missing property 'sizeBit': %s",
-		    json_object_to_json_string(struct_def));
-		return  -1;
-	}
-
-	size_bit = (uint32_t)json_object_get_uint64(obj);
-
-	if (json_object_object_get_ex(struct_def, "enum", &obj))
-		is_enumeration = json_object_get_boolean(obj);
-
-	has_member_list = json_object_object_get_ex(struct_def,
-						    "memberList",
-						    &obj_memberList);
-
-	if (!json_object_object_get_ex(struct_def, "arraySize",
-				       &obj_arraySizeArray)) {
-		SOLIDIGM_LOG_WARNING(
-		    "Warning: Structure definition missing property 'arraySize': %s",
-		    json_object_to_json_string(struct_def));
-		return  -1;
+		json_object_get(l->name_obj);
+		json_object_object_add(metadata, "objName", l->name_obj);
 	}
 
-	array_rank = json_object_array_length(obj_arraySizeArray);
-	if (!array_rank) {
-		SOLIDIGM_LOG_WARNING(
-		    "Warning: Structure property 'arraySize' don't support flexible array: %s",
-		    json_object_to_json_string(struct_def));
+	if (!l->valid)
 		return -1;
-	}
-	if (array_rank > MAX_ARRAY_RANK) {
-		SOLIDIGM_LOG_WARNING(
-		    "Warning: Structure property 'arraySize' don't support more than %d dimensions: %s",
-		    MAX_ARRAY_RANK, json_object_to_json_string(struct_def));
-		return -1;
-	}
-
-	for (size_t i = 0; i < array_rank; i++) {
-		struct json_object *dimension = json_object_array_get_idx(obj_arraySizeArray, i);
 
-		array_size_dimension[i] = json_object_get_int(dimension);
-		major_dimension = dimension;
-	}
+	/*
+	 * Each index of the major dimension is parsed as an array of the
+	 * definition without its last dimension.
+	 */
 	if (array_rank > 1) {
-		uint32_t linear_pos_per_index = array_size_dimension[0];
+		uint32_t linear_pos_per_index = l->array_size[0];
 		uint32_t prev_index_offset_bit = 0;
 		struct json_object *dimension_output;
 
 		for (unsigned int i = 1; i < (array_rank - 1); i++)
-			linear_pos_per_index *= array_size_dimension[i];
+			linear_pos_per_index *= l->array_size[i];
 
 		dimension_output = json_create_array();
 		if (json_object_get_type(output) == json_type_array)
 			json_object_array_add(output, dimension_output);
 		else
-			json_object_add_value_array(output, name, dimension_output);
-
-		/*
-		 * Make sure major_dimension object will not be
-		 * deleted from memory when deleted from array
-		 */
-		json_object_get(major_dimension);
-		json_object_array_del_idx(obj_arraySizeArray, array_rank - 1, 1);
+			json_object_add_value_array(output, l->name, dimension_output);
 
-		for (unsigned int i = 0 ; i < array_size_dimension[0]; i++) {
+		for (unsigned int i = 0 ; i < l->array_size[0]; i++) {
 			struct json_object *sub_array = json_create_array();
 			uint64_t offset;
 
 			offset = parent_offset_bit + prev_index_offset_bit;
 
 			json_object_array_add(dimension_output, sub_array);
-			telemetry_log_structure_parse(tl, struct_def,
+			telemetry_log_structure_parse(tl, l, array_rank - 1,
 						      offset, sub_array, NULL);
-			prev_index_offset_bit += linear_pos_per_index * size_bit;
+			prev_index_offset_bit += linear_pos_per_index * l->size_bit;
 		}
 
-		json_object_array_put_idx(obj_arraySizeArray, array_rank - 1,
-					  major_dimension);
-
 		return 0;
 	}
 
 	linear_array_pos_bit = 0;
 	sub_output = output;
 
-	if (array_size_dimension[0] > 1) {
+	if (l->array_size[0] > 1) {
 		sub_output = json_create_array();
 		if (json_object_get_type(output) == json_type_array)
 			json_object_array_add(output, sub_output);
 		else
-			json_object_add_value_array(output, name, sub_output);
+			json_object_add_value_array(output, l->name, sub_output);
 	}
 
-	for (uint32_t j = 0; j < array_size_dimension[0]; j++) {
-		if (is_enumeration || !has_member_list) {
-			bool is_signed = !strncmp(type, SIGNED_INT_PREFIX, sizeof(SIGNED_INT_PREFIX)-1);
+	for (uint32_t j = 0; j < l->array_size[0]; j++) {
+		if (l->is_value) {
 			struct json_object *val_obj;
 			uint64_t offset;
 
-			offset = parent_offset_bit + offset_bit + linear_array_pos_bit;
-			if (telemetry_log_get_value(tl, offset, size_bit, is_signed, &val_obj)) {
-				if (array_size_dimension[0] > 1)
+			offset = parent_offset_bit + l->offset_bit + linear_array_pos_bit;
+			if (telemetry_log_get_value(tl, offset, l->size_bit, l->is_signed, &val_obj)) {
+				if (l->array_size[0] > 1)
 					json_object_array_put_idx(sub_output, j, val_obj);
 				else
-					json_object_object_add(sub_output, name, val_obj);
+					json_object_object_add(sub_output, l->name, val_obj);
 			} else {
 				SOLIDIGM_LOG_WARNING(
 				    "Warning: %s From property '%s', array index %u, structure definition: %s",
-				    json_object_get_string(val_obj), name, j,
-				    json_object_to_json_string(struct_def));
+				    json_object_get_string(val_obj), l->name, j,
+				    json_object_to_json_string(l->def));
 				json_free_object(val_obj);
 			}
 		} else {
 			struct json_object *sub_sub_output = json_create_object();
-			int num_members;
 
-			if (array_size_dimension[0] > 1)
+			if (l->array_size[0] > 1)
 				json_object_array_put_idx(sub_output, j, sub_sub_output);
 			else
-				json_object_add_value_object(sub_output, name, sub_sub_output);
+				json_object_add_value_object(sub_output, l->name, sub_sub_output);
 
-			num_members = json_object_array_length(obj_memberList);
-			for (int k = 0; k < num_members; k++) {
-				struct json_object *member = json_object_array_get_idx(obj_memberList, k);
+			for (int k = 0; k < l->nr_members; k++) {
+				const struct solidigm_layout *member = &l->members[k];
 				uint64_t offset;
 
-				offset = parent_offset_bit + offset_bit + linear_array_pos_bit;
-				telemetry_log_structure_parse(tl, member, offset,
-							      sub_sub_output, NULL);
+				offset = parent_offset_bit + l->offset_bit + linear_array_pos_bit;
+				telemetry_log_structure_parse(tl, member, member->array_rank,
+							      offset, sub_sub_output, NULL);
 			}
 		}
-		linear_array_pos_bit += size_bit;
+		linear_array_pos_bit += l->size_bit;
 	}
 	return 0;
 }
@@ -302,7 +230,8 @@ static int telemetry_log_data_area_get_offset(const struct telemetry_log *tl,
 	return 0;
 }
 
-static int telemetry_log_nlog_parse(const struct telemetry_log *tl, struct json_object *formats,
+static int telemetry_log_nlog_parse(const struct telemetry_log *tl,
+				    const struct nlog_formats *formats,
 				    uint64_t nlog_file_offset,	uint64_t nlog_size,
 				    struct json_object *output, struct json_object *metadata)
 {
@@ -320,7 +249,7 @@ static int telemetry_log_nlog_parse(const struct telemetry_log *tl, struct json_
 		return -1;
 	}
 	return solidigm_nlog_parse(((char *) tl->log) + nlog_file_offset,
-				   nlog_size, formats, metadata, output);
+				   nlog_size, formats, metadata, output, tl->nlog_events);
 }
 
 struct toc_item {
@@ -349,10 +278,11 @@ struct telemetry_object_header {
 	uint8_t Reserved[3];
 };
 
-static void telemetry_log_data_area_toc_parse(const struct telemetry_log *tl,
+static void telemetry_log_data_area_toc_parse(struct telemetry_log *tl,
 					      enum nvme_telemetry_da da,
 					      struct json_object *toc_array,
-					      struct json_object *tele_obj_array)
+					      struct json_object *tele_obj_array,
+					      const struct nlog_formats *nlog_formats)
 {
 
 	const struct telemetry_object_header *header;
@@ -360,17 +290,15 @@ static void telemetry_log_data_area_toc_parse(const struct telemetry_log *tl,
 	char *payload;
 	uint32_t da_offset;
 	uint32_t da_size;
-	struct json_object *nlog_formats;
 
 	if (telemetry_log_data_area_get_offset(tl, da, &da_offset, &da_size))
 		return;
 
 	toc = (struct table_of_contents *)(((char *)tl->log) + da_offset);
 	payload = (char *) tl->log;
-	nlog_formats = solidigm_config_get_nlog_formats(tl->configuration);
 
 	for (int i = 0; i < toc->header.TableOfContentsCount; i++) {
-		struct json_object *structure_definition = NULL;
+		const struct solidigm_layout *layout;
 		struct json_object *toc_item;
 		uint32_t obj_offset;
 		bool has_struct;
@@ -406,11 +334,10 @@ static void telemetry_log_data_area_toc_parse(const struct telemetry_log *tl,
 		json_object_add_value_uint(toc_item, "objectId", header->Token);
 		json_object_add_value_uint(toc_item, "mediaBankId", header->CoreId);
 
-		has_struct = solidigm_config_get_struct_by_token_version(tl->configuration,
-									 header->Token,
-									 header->versionMajor,
-									 header->versionMinor,
-									 &structure_definition);
+		layout = solidigm_config_get_layout(tl->configuration, &tl->layouts,
+						    header->Token, header->versionMajor,
+						    header->versionMinor);
+		has_struct = layout != NULL;
 		if (!has_struct) {
 			if (!nlog_formats)
 				continue;
@@ -427,20 +354,13 @@ static void telemetry_log_data_area_toc_parse(const struct telemetry_log *tl,
 		struct json_object *parsed_struct = json_create_object();
 
 		json_object_add_value_object(tele_obj_item, "objectData", parsed_struct);
-		struct json_object *obj_hasTelemObjHdr = NULL;
 		uint64_t object_file_offset;
 
-		if (json_object_object_get_ex(structure_definition,
-						"hasTelemObjHdr",
-						&obj_hasTelemObjHdr)) {
-			bool hasHeader = json_object_get_boolean(obj_hasTelemObjHdr);
-
-			if (hasHeader)
-				header_offset = 0;
-		}
+		if (has_struct && layout->has_telem_obj_hdr)
+			header_offset = 0;
 		object_file_offset = ((uint64_t)da_offset) + obj_offset + header_offset;
 		if (has_struct) {
-			telemetry_log_structure_parse(tl, structure_definition,
+			telemetry_log_structure_parse(tl, layout, layout->array_rank,
 						BITS_IN_BYTE * object_file_offset,
 						parsed_struct, toc_item);
 		} else if (nlog_formats) {
@@ -462,11 +382,17 @@ int solidigm_telemetry_log_data_areas_parse(struct telemetry_log *tl,
 	solidigm_telemetry_log_header_parse(tl);
 	solidigm_telemetry_log_cod_parse(tl);
 	if (tl->configuration) {
+		struct nlog_formats *nlog_formats;
+
 		json_object_add_value_array(tl->root, "tableOfContents", toc_array);
 		json_object_add_value_array(tl->root, "telemetryObjects", tele_obj_array);
 
+		nlog_formats = solidigm_nlog_formats_index(
+			solidigm_config_get_nlog_formats(tl->configuration));
 		for (enum nvme_telemetry_da da = NVME_TELEMETRY_DA_1; da <= last_da; da++)
-			telemetry_log_data_area_toc_parse(tl, da, toc_array, tele_obj_array);
+			telemetry_log_data_area_toc_parse(tl, da, toc_array, tele_obj_array,
+							  nlog_formats);
+		solidigm_nlog_formats_free(nlog_formats);
 	}
 	return 0;
 }
@@ -9,8 +9,11 @@
 #include "config.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
 
 #include "ccan/ilog/ilog.h"
+#include "ccan/htable/htable_type.h"
 
 #define LOG_ENTRY_HEADER_SIZE 1
 #define LOG_ENTRY_TIMESTAMP_SIZE 2
@@ -20,32 +23,135 @@
 #define NUM_ARGS_MASK ((1 << ((int)STATIC_ILOG_32(LOG_ENTRY_NUM_ARGS_MAX))) - 1)
 #define MAX_HEADER_MISMATCH_TRACK 10
 
-static int formats_find(struct json_object *formats, uint32_t val, struct json_object **format)
+static uint32_t nlog_get_pos(const uint32_t *nlog, const uint32_t nlog_size, int pos)
 {
-	char hex_header[STR_HEX32_SIZE];
+	return nlog[pos % nlog_size];
+}
 
-	snprintf(hex_header, STR_HEX32_SIZE, "0x%08X", val);
-	return json_object_object_get_ex(formats, hex_header, format);
+struct nlog_format {
+	uint32_t id;
+	struct json_object *format;
+	char *json;			/* the format serialized, once streamed */
+};
+
+static const uint32_t *nlog_format_key(const struct nlog_format *f)
+{
+	return &f->id;
 }
 
-static uint32_t nlog_get_pos(const uint32_t *nlog, const uint32_t nlog_size, int pos)
+static size_t nlog_format_hash(const uint32_t *id)
 {
-	return nlog[pos % nlog_size];
+	return (*id * 0x9e3779b97f4a7c15ULL) >> 32;
+}
+
+static bool nlog_format_cmp(const struct nlog_format *f, const uint32_t *id)
+{
+	return f->id == *id;
+}
+
+HTABLE_DEFINE_TYPE(struct nlog_format, nlog_format_key, nlog_format_hash,
+		   nlog_format_cmp, htable_nlog_format);
+
+struct nlog_formats {
+	struct htable_nlog_format ht;
+	size_t nr;
+	struct nlog_format formats[];
+};
+
+/* the configuration keys are "0x%08X" of the format IDs */
+static bool format_key_to_id(const char *key, uint32_t *id)
+{
+	if (strlen(key) != STR_HEX32_SIZE - 1 || strncmp(key, "0x", 2))
+		return false;
+	for (size_t i = 2; i < STR_HEX32_SIZE - 1; i++)
+		if (!isxdigit((unsigned char)key[i]) || islower((unsigned char)key[i]))
+			return false;
+	*id = strtoul(key, NULL, 16);
+	return true;
+}
+
+struct nlog_formats *solidigm_nlog_formats_index(struct json_object *formats)
+{
+	struct nlog_formats *f;
+	size_t nr = 0;
+
+	if (!formats)
+		return NULL;
+
+	f = calloc(1, sizeof(*f) + json_object_object_length(formats) * sizeof(f->formats[0]));
+	if (!f)
+		return NULL;
+	if (!htable_nlog_format_init_sized(&f->ht, json_object_object_length(formats))) {
+		free(f);
+		return NULL;
+	}
+
+	json_object_object_foreach(formats, key, format) {
+		struct nlog_format *e = &f->formats[nr];
+
+		if (!format_key_to_id(key, &e->id) || htable_nlog_format_get(&f->ht, &e->id))
+			continue;
+		e->format = format;
+		if (!htable_nlog_format_add(&f->ht, e)) {
+			solidigm_nlog_formats_free(f);
+			return NULL;
+		}
+		f->nr = ++nr;
+	}
+	return f;
+}
+
+void solidigm_nlog_formats_free(struct nlog_formats *f)
+{
+	if (!f)
+		return;
+	for (size_t i = 0; i < f->nr; i++)
+		free(f->formats[i].json);
+	htable_nlog_format_clear(&f->ht);
+	free(f);
+}
+
+static struct nlog_format *formats_find(const struct nlog_formats *formats, uint32_t val)
+{
+	return htable_nlog_format_get(&formats->ht, &val);
 }
 
+static const char *nlog_format_json(struct nlog_format *f)
+{
+	if (!f->json)
+		f->json = strdup(json_object_to_json_string_ext(f->format,
+								JSON_C_TO_STRING_PLAIN));
+	return f->json ? f->json : "null";
+}
+
+/* one line per event: the stream is parsed back event by event */
+static void nlog_stream_event(FILE *out, const char *prefix, const uint32_t *nlog,
+			      const uint32_t nlog_size, int pos, uint32_t num_data,
+			      struct nlog_format *format)
+{
+	fprintf(out, "%s%u,%u,%u,[", prefix, nlog_get_pos(nlog, nlog_size, pos - 1),
+		nlog_get_pos(nlog, nlog_size, pos - 2), nlog_get_pos(nlog, nlog_size, pos));
+	for (uint32_t j = 0; j < num_data; j++)
+		fprintf(out, j ? ",%u" : "%u", nlog_get_pos(nlog, nlog_size, pos - 3 - j));
+	fprintf(out, "],%s]}\n", nlog_format_json(format));
+}
+
+
 static uint32_t nlog_get_events(const uint32_t *nlog, const uint32_t nlog_size, int start_offset,
-	       struct json_object *formats, struct json_object *events, uint32_t *tail_mismatches)
+	       const struct nlog_formats *formats, struct json_object *events,
+	       FILE *events_out, const char *prefix, uint32_t *tail_mismatches,
+	       uint32_t *count)
 {
 	uint32_t event_count = 0;
 	int last_bad_header_pos = nlog_size + 1; // invalid nlog offset
 	uint32_t tail_count = 0;
 
 	for (int i = nlog_size - start_offset - 1; i >= -start_offset; i--) {
-		struct json_object *format;
+		struct nlog_format *format;
 		uint32_t header = nlog_get_pos(nlog, nlog_size, i);
 		uint32_t num_data;
 
-		if (header == 0 || !formats_find(formats, header, &format)) {
+		if (header == 0 || !(format = formats_find(formats, header))) {
 			if (event_count > 0) {
 				//check if fould circular buffer tail
 				if (i != (last_bad_header_pos - 1)) {
@@ -59,7 +165,10 @@ static uint32_t nlog_get_events(const uint32_t *nlog, const uint32_t nlog_size,
 			continue;
 		}
 		num_data = header & NUM_ARGS_MASK;
-		if (events) {
+		if (events_out) {
+			nlog_stream_event(events_out, prefix, nlog, nlog_size, i, num_data,
+					  format);
+		} else if (events) {
 			struct json_object *event = json_object_new_array();
 			struct json_object *param = json_object_new_array();
 			uint32_t val = nlog_get_pos(nlog, nlog_size, i - 1);
@@ -74,28 +183,37 @@ static uint32_t nlog_get_events(const uint32_t *nlog, const uint32_t nlog_size,
 				val = nlog_get_pos(nlog, nlog_size, i - 3 - j);
 				json_object_array_add(param, json_object_new_int64(val));
 			}
-			json_object_get(format);
-			json_object_array_add(event, format);
+			json_object_get(format->format);
+			json_object_array_add(event, format->format);
 		}
 		i -= 2 + num_data;
 		event_count++;
 	}
+	if (count)
+		*count = event_count;
 	return tail_count;
 }
 
-int solidigm_nlog_parse(const char *buffer, uint64_t buff_size,	struct json_object *formats,
-			struct json_object *metadata, struct json_object *output)
+int solidigm_nlog_parse(const char *buffer, uint64_t buff_size,
+			const struct nlog_formats *formats, struct json_object *metadata,
+			struct json_object *output, FILE *events_out)
 {
 	uint32_t smaller_tail_count = UINT32_MAX;
 	int best_offset = 0;
 	uint32_t offset_tail_mismatches[LOG_ENTRY_MAX_SIZE][MAX_HEADER_MISMATCH_TRACK];
-	struct json_object *events = json_object_new_array();
+	struct json_object *events = NULL;
 	const uint32_t *nlog = (uint32_t *)buffer;
 	const uint32_t nlog_size = buff_size / sizeof(uint32_t);
+	char *prefix = NULL;
+	uint32_t event_count;
+
+	if (!events_out)
+		events = json_object_new_array();
 
 	for (int i = 0; i < LOG_ENTRY_MAX_SIZE; i++) {
 		uint32_t tail_count = nlog_get_events(nlog, nlog_size, i, formats, NULL,
-						      offset_tail_mismatches[i]);
+						      NULL, NULL, offset_tail_mismatches[i],
+						      NULL);
 		if (tail_count < smaller_tail_count) {
 			best_offset = i;
 			smaller_tail_count = tail_count;
@@ -124,8 +242,23 @@ int solidigm_nlog_parse(const char *buffer, uint64_t buff_size,	struct json_obje
 		SOLIDIGM_LOG_WARNING("%s:%d with %d header mismatches ( %s). Configuration file may be missing format headers.",
 				      name, media_bank, smaller_tail_count, str_mismatches);
 	}
-	nlog_get_events(nlog, nlog_size, best_offset, formats, events, NULL);
+	if (events_out) {
+		struct json_object *name = NULL, *media_bank = NULL;
+
+		json_object_object_get_ex(metadata, "objName", &name);
+		json_object_object_get_ex(metadata, "mediaBankId", &media_bank);
+		if (asprintf(&prefix, "{\"objName\":%s,\"mediaBankId\":%d,\"event\":[",
+			     json_object_to_json_string(name),
+			     media_bank ? json_object_get_int(media_bank) : -1) < 0)
+			return -1;
+	}
+	nlog_get_events(nlog, nlog_size, best_offset, formats, events, events_out, prefix,
+			NULL, &event_count);
+	free(prefix);
 
-	json_object_object_add(output, "events", events);
+	if (events)
+		json_object_object_add(output, "events", events);
+	else
+		json_object_add_value_uint(output, "eventCount", event_count);
 	return 0;
 }
@@ -6,6 +6,16 @@
  */
 #include "telemetry-log.h"
 
+/* the NLOG_FORMATS of the configuration indexed by format ID */
+struct nlog_formats;
+
+struct nlog_formats *solidigm_nlog_formats_index(struct json_object *formats);
+void solidigm_nlog_formats_free(struct nlog_formats *formats);
+
+/*
+ * Decodes the events into an "events" array of output, or, with events_out,
+ * writes them there as JSON lines and only adds their "eventCount".
+ */
 int solidigm_nlog_parse(const char *buffer, uint64_t bufer_size,
-			struct json_object *formats, struct json_object *metadata,
-			struct json_object *output);
+			const struct nlog_formats *formats, struct json_object *metadata,
+			struct json_object *output, FILE *events_out);
@@ -11,6 +11,7 @@
 #include "libnvme.h"
 #include "util/json.h"
 #include <assert.h>
+#include <stdio.h>
 
 #if !defined __cplusplus
 #define static_assert _Static_assert
@@ -21,11 +22,15 @@
 
 #define MEMBER_SIZE(type, member) sizeof(((type *)0)->member)
 
+struct solidigm_layout_cache;
+
 struct telemetry_log {
 	struct nvme_telemetry_log *log;
 	size_t log_size;
 	struct json_object *root;
 	struct json_object *configuration;
+	struct solidigm_layout_cache *layouts;	/* compiled configuration */
+	FILE *nlog_events;			/* NLOG events as JSON lines, or NULL */
 };
 
 #endif /* _SOLIDIGM_TELEMETRY_LOG_H */
@@ -6,6 +6,7 @@
  */
 
 #include <errno.h>
+#include "nvme-wrap.h"
 #include "solidigm-util.h"
 
 const unsigned char solidigm_uuid[NVME_UUID_LEN] = {
@@ -29,7 +30,7 @@ int sldgm_find_uuid_index(struct nvme_id_uuid_list *uuid_list, __u8 *index)
 int sldgm_get_uuid_index(struct nvme_dev *dev, __u8 *index)
 {
 	struct nvme_id_uuid_list uuid_list;
-	int err = nvme_identify_uuid(dev_fd(dev), &uuid_list);
+	int err = nvme_cli_identify_uuid(dev, &uuid_list);
 
 	*index = 0;
 	if (err)
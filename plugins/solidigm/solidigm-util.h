@@ -9,5 +9,7 @@
 
 #define DRIVER_MAX_TX_256K (256 * 1024)
 
+#define SOLIDIGM_VID 0x025e
+
 int sldgm_find_uuid_index(struct nvme_id_uuid_list *uuid_list, __u8 *index);
 int sldgm_get_uuid_index(struct nvme_dev *dev, __u8 *index);
@@ -7,8 +7,12 @@
 
 #include "common.h"
 #include "nvme-print.h"
+#include "util/workload.h"
 #include <errno.h>
+#include <fcntl.h>
 #include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define LID 0xf9
 #define FID 0xf1
@@ -199,23 +203,132 @@ struct workloadLog { // Full WL Log Structure
 };
 #pragma pack(pop)
 
+/*
+ * A ring file keeps the last entries captured, raw, behind this header:
+ * the capture runs at the highest sample rate for as long as needed in a
+ * fixed amount of memory and disk, workload-tracker-decode prints it.
+ */
+#define WLT_RING_MAGIC "SLDGWLT1"
+#define WLT_RING_DEFAULT_ENTRIES (1 << 20)
+
+struct wlt_ring_header {
+	char magic[8];
+	__le32 entry_size;
+	__le32 content_group;
+	__le64 capacity;		/* entries */
+	__le64 head;			/* entries written since the start */
+	__le32 sample_period_ms;
+	__u8 reserved[28];
+};
+
+struct wlt_ring_entry {
+	__le64 timestamp_ms;
+	__u8 data[MAX_WORKLOAD_LOG_ENTRY_SIZE];
+};
+
+struct wlt_ring {
+	struct wlt_ring_header *hdr;
+	struct wlt_ring_entry *entries;
+	size_t size;
+};
+
 struct wltracker {
 	int fd;
 	struct workloadLog workload_log;
 	size_t entry_count;
 	unsigned int verbose;
+	struct wlt_ring *ring;
 };
 
-static void wltracker_print_field_names(struct wltracker *wlt)
+static int wlt_ring_create(struct wlt_ring *ring, const char *file, __u64 capacity)
 {
-	struct workloadLog *log = &wlt->workload_log;
-	__u8 cnt = log->header.workloadLogCount;
-	union WorkloadLogEnable workloadEnable = (union WorkloadLogEnable)log->header.trackerEnable;
-	__u8 content_group = workloadEnable.field.contentGroup;
+	int fd, err = 0;
+
+	fd = open(file, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	ring->size = sizeof(*ring->hdr) + capacity * sizeof(*ring->entries);
+	if (ftruncate(fd, ring->size) < 0) {
+		err = -errno;
+		goto close_fd;
+	}
+	ring->hdr = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring->hdr == MAP_FAILED) {
+		err = -errno;
+		goto close_fd;
+	}
+	ring->entries = (struct wlt_ring_entry *)(ring->hdr + 1);
+	memcpy(ring->hdr->magic, WLT_RING_MAGIC, sizeof(ring->hdr->magic));
+	ring->hdr->entry_size = cpu_to_le32(sizeof(*ring->entries));
+	ring->hdr->capacity = cpu_to_le64(capacity);
+close_fd:
+	close(fd);
+	return err;
+}
+
+static void wlt_ring_close(struct wlt_ring *ring)
+{
+	msync(ring->hdr, ring->size, MS_ASYNC);
+	munmap(ring->hdr, ring->size);
+}
+
+static void wlt_ring_append(struct wlt_ring *ring, __u64 timestamp_ms, const __u8 *entry)
+{
+	__u64 head = le64_to_cpu(ring->hdr->head);
+	struct wlt_ring_entry *e = &ring->entries[head % le64_to_cpu(ring->hdr->capacity)];
+
+	e->timestamp_ms = cpu_to_le64(timestamp_ms);
+	memcpy(e->data, entry, sizeof(e->data));
+	/* a reader of a live capture never sees the head before its entry */
+	__atomic_store_n(&ring->hdr->head, cpu_to_le64(head + 1), __ATOMIC_RELEASE);
+}
+
+/* map the ring @file read-only, as it may still be captured to */
+static int wlt_ring_open(struct wlt_ring *ring, const char *file)
+{
+	struct stat st;
+	__u64 capacity;
+	int fd, err;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		err = -errno;
+		nvme_show_error("%s: %s", file, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return err;
+	}
+	if ((size_t)st.st_size < sizeof(*ring->hdr)) {
+		close(fd);
+		nvme_show_error("%s: not a workload tracker ring file", file);
+		return -EINVAL;
+	}
+	ring->hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring->hdr == MAP_FAILED) {
+		err = -errno;
+		nvme_show_error("%s: %s", file, strerror(-err));
+		return err;
+	}
+	ring->size = st.st_size;
+	ring->entries = (struct wlt_ring_entry *)(ring->hdr + 1);
+
+	capacity = le64_to_cpu(ring->hdr->capacity);
+	if (memcmp(ring->hdr->magic, WLT_RING_MAGIC, sizeof(ring->hdr->magic)) ||
+	    le32_to_cpu(ring->hdr->entry_size) != sizeof(*ring->entries) || !capacity ||
+	    le32_to_cpu(ring->hdr->content_group) >= ARRAY_SIZE(trk_types) ||
+	    capacity > (st.st_size - sizeof(*ring->hdr)) / sizeof(*ring->entries)) {
+		nvme_show_error("%s: not a workload tracker ring file", file);
+		munmap(ring->hdr, ring->size);
+		return -EINVAL;
+	}
 
-	if (cnt == 0)
-		return;
+	return 0;
+}
 
+static void wltracker_print_field_names(__u8 content_group, unsigned int verbose)
+{
 	printf("%-16s", "timestamp");
 
 	for (int i = 0 ; i < MAX_FIELDS; i++) {
@@ -228,12 +341,50 @@ static void wltracker_print_field_names(struct wltracker *wlt)
 		printf("%s ", f.name);
 	}
 
-	if (wlt->verbose > 1)
+	if (verbose > 1)
 		printf("%s", "entry#");
 
 	printf("\n");
 }
 
+static void wltracker_print_entry(__u8 content_group, __u64 timestamp, const __u8 *entry,
+				  int index, unsigned int verbose)
+{
+	int offset = 0;
+
+	printf("%-16llu", timestamp);
+	for (int j = 0; j < MAX_FIELDS; j++) {
+		__u32 val = 0;
+		struct field f = group_fields[content_group][j];
+
+		if (f.size == 0) {
+			if (verbose > 1)
+				printf("%-*i", (int)sizeof("entry#"), index);
+			printf("\n");
+			break;
+		}
+		if (f.name == NULL)
+			continue;
+
+		switch (f.size) {
+		case 1:
+			val = *(entry+offset);
+			break;
+		case 2:
+			val = *(__u16 *)(entry + offset);
+			break;
+		case 4:
+			val = *(__u32 *)(entry + offset);
+			break;
+		default:
+			nvme_show_error("Bad field size");
+		}
+		offset += f.size;
+
+		printf("%-*u ", (int)strlen(f.name), val);
+	}
+}
+
 static void wltracker_print_header(struct wltracker *wlt)
 {
 	struct workloadLog *log = &wlt->workload_log;
@@ -256,8 +407,8 @@ static void wltracker_print_header(struct wltracker *wlt)
 	printf("%-20s %s\n", "Tracker Type:", trk_types[content_group]);
 	printf("%-30s %u\n", "Total workload log entries:", le16_to_cpu(cnt));
 	printf("%-20s %ld\n\n", "Sample count:", wlt->entry_count);
-	if (wlt->entry_count != 0)
-		wltracker_print_field_names(wlt);
+	if (wlt->entry_count != 0 && cnt != 0 && !wlt->ring)
+		wltracker_print_field_names(content_group, wlt->verbose);
 }
 
 static int wltracker_show_newer_entries(struct wltracker *wlt)
@@ -294,11 +445,14 @@ static int wltracker_show_newer_entries(struct wltracker *wlt)
 		(log->header.samplePeriodInMilliseconds * (cnt - 1));
 
 
-	if (wlt->entry_count == 0)
-		wltracker_print_field_names(wlt);
+	if (wlt->ring) {
+		wlt->ring->hdr->content_group = cpu_to_le32(content_group);
+		wlt->ring->hdr->sample_period_ms = log->header.samplePeriodInMilliseconds;
+	} else if (wlt->entry_count == 0) {
+		wltracker_print_field_names(content_group, wlt->verbose);
+	}
 
 	for (int i = cnt - 1; i >= 0; i--) {
-		int offset = 0;
 		__u8 *entry = (__u8 *) &log->entry[i];
 		bool is_old = timestamp <= last_timestamp_ms;
 
@@ -306,37 +460,10 @@ static int wltracker_show_newer_entries(struct wltracker *wlt)
 			timestamp += log->header.samplePeriodInMilliseconds;
 			continue;
 		}
-		printf("%-16llu", timestamp);
-		for (int j = 0; j < MAX_FIELDS; j++) {
-			__u32 val = 0;
-			struct field f = group_fields[content_group][j];
-
-			if (f.size == 0) {
-				if (wlt->verbose > 1)
-					printf("%-*i", (int)sizeof("entry#"), i);
-				printf("\n");
-				break;
-			}
-			if (f.name == NULL)
-				continue;
-
-			switch (f.size) {
-			case 1:
-				val = *(entry+offset);
-				break;
-			case 2:
-				val = *(__u16 *)(entry + offset);
-				break;
-			case 4:
-				val = *(__u32 *)(entry + offset);
-				break;
-			default:
-				nvme_show_error("Bad field size");
-			}
-			offset += f.size;
-
-			printf("%-*u ", (int)strlen(f.name), val);
-		}
+		if (wlt->ring)
+			wlt_ring_append(wlt->ring, timestamp, entry);
+		else
+			wltracker_print_entry(content_group, timestamp, entry, i, wlt->verbose);
 		wlt->entry_count++;
 		timestamp += log->header.samplePeriodInMilliseconds;
 	}
@@ -404,6 +531,10 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 	const char *run_time = "Limit runtime capture time in seconds";
 	const char *flush_frequency =
 		"Samples (1 to 126) to wait for extracting data. Default 100 samples";
+	const char *ring_file =
+		"Append the raw samples to this ring file instead of printing them";
+	const char *ring_size = "Samples kept in the ring file, default 1048576";
+	struct wlt_ring ring;
 	char type_options[80] = {0};
 	char sample_options[80] = {0};
 	__u64 us_start;
@@ -420,12 +551,15 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 		const char *sample_time;
 		int run_time_s;
 		int flush_frequency;
+		char *ring_file;
+		__u64 ring_size;
 	};
 
 	struct config cfg = {
 		.sample_time = samplet[0],
 		.flush_frequency = 100,
 		.tracker_type = trk_types[0],
+		.ring_size = WLT_RING_DEFAULT_ENTRIES,
 	};
 
 	join(type_options, trk_types, ARRAY_SIZE(trk_types));
@@ -439,6 +573,8 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 		OPT_INT("run-time", 'r', &cfg.run_time_s, run_time),
 		OPT_INT("flush-freq", 'f', &cfg.flush_frequency, flush_frequency),
 		OPT_INCR("verbose",      'v', &wlt.verbose, "Increase logging verbosity"),
+		OPT_FILE("ring-file", 'w', &cfg.ring_file, ring_file),
+		OPT_SUFFIX("ring-size", 'n', &cfg.ring_size, ring_size),
 		OPT_END()
 	};
 
@@ -492,6 +628,19 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 		return 0;
 	}
 
+	if (cfg.ring_file) {
+		if (!cfg.ring_size) {
+			nvme_show_error("Invalid ring size: 0");
+			return -EINVAL;
+		}
+		err = wlt_ring_create(&ring, cfg.ring_file, cfg.ring_size);
+		if (err) {
+			nvme_show_error("ring file %s: %s", cfg.ring_file, strerror(-err));
+			return err;
+		}
+		wlt.ring = &ring;
+	}
+
 	us_start = micros();
 	run_time_us = cfg.run_time_s * 1000000;
 	while (elapsed_run_time_us < run_time_us) {
@@ -501,10 +650,8 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 
 		err = wltracker_show_newer_entries(&wlt);
 
-		if (err > 0) {
-			nvme_show_status(err);
-			return err;
-		}
+		if (err > 0)
+			break;
 		interval = ((__u64)wlt.workload_log.header.samplePeriodInMilliseconds) * 1000 *
 			   cfg.flush_frequency;
 		next_sample_us += interval;
@@ -522,15 +669,232 @@ int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struc
 		elapsed_run_time_us = micros() - us_start;
 	}
 
-	err = wltracker_show_newer_entries(&wlt);
+	if (err <= 0)
+		err = wltracker_show_newer_entries(&wlt);
 
 	elapsed_run_time_us = micros() - us_start;
 	if (wlt.verbose > 0)
 		printf("elapsed_run_time: %lluus\n", elapsed_run_time_us);
 
+	if (wlt.ring) {
+		if (wlt.verbose > 0)
+			printf("%zu samples written to %s\n", wlt.entry_count, cfg.ring_file);
+		wlt_ring_close(wlt.ring);
+	}
+
 	if (err > 0) {
 		nvme_show_status(err);
 		return err;
 	}
 	return err;
 }
+
+int sldgm_decode_workload_tracker(int argc, char **argv, struct command *cmd,
+				  struct plugin *plugin)
+{
+	const char *desc = "Print the samples of a Workload Tracker ring file";
+	struct wlt_ring_header *hdr;
+	struct wlt_ring_entry *entries;
+	__u64 capacity, head, first;
+	unsigned int verbose = 0;
+	struct wlt_ring ring;
+	int err;
+
+	OPT_ARGS(opts) = {
+		OPT_INCR("verbose", 'v', &verbose, "Increase logging verbosity"),
+		OPT_END()
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts);
+	if (err)
+		return err;
+	if (optind >= argc) {
+		nvme_show_error("%s: ring file required", argv[0]);
+		return -EINVAL;
+	}
+
+	err = wlt_ring_open(&ring, argv[optind]);
+	if (err)
+		return err;
+	hdr = ring.hdr;
+	entries = ring.entries;
+	capacity = le64_to_cpu(hdr->capacity);
+	head = le64_to_cpu(__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE));
+	first = head > capacity ? head - capacity : 0;
+
+	if (verbose) {
+		printf("%-20s %s\n", "Tracker Type:", trk_types[le32_to_cpu(hdr->content_group)]);
+		printf("%-20s %u\n", "Sample period(ms):", le32_to_cpu(hdr->sample_period_ms));
+		printf("%-20s %llu\n", "Samples captured:", head);
+		printf("%-20s %llu\n\n", "Samples kept:", head - first);
+	}
+	if (head == first)
+		goto unmap;
+
+	wltracker_print_field_names(le32_to_cpu(hdr->content_group), verbose);
+	for (__u64 i = first; i < head; i++) {
+		struct wlt_ring_entry *e = &entries[i % capacity];
+
+		wltracker_print_entry(le32_to_cpu(hdr->content_group),
+				      le64_to_cpu(e->timestamp_ms), e->data, i % capacity,
+				      verbose);
+	}
+unmap:
+	munmap(ring.hdr, ring.size);
+	return err;
+}
+
+#define WLT_SECTOR_SIZE 512
+
+static __u32 wlt_entry_u32(const __u8 *data, int offset)
+{
+	__le32 v;
+
+	memcpy(&v, data + offset, sizeof(v));
+	return le32_to_cpu(v);
+}
+
+static __u8 wlt_pct(__u64 part, __u64 total)
+{
+	return total ? min(part * 100 / total, 100ULL) : 0;
+}
+
+/*
+ * What an entry of @content_group says about the host I/O of its sample,
+ * taking the counters as those of the sample. Returns false for the
+ * groups that don't track host I/O.
+ */
+static bool wlt_entry_sample(__u32 content_group, const __u8 *data,
+			    struct nvme_workload_sample *s)
+{
+	__u32 reads, writes;
+
+	switch (content_group) {
+	case 0: /* Base */
+	case 6: /* Defrag */
+		s->rate = true;
+		s->read_bytes = (__u64)wlt_entry_u32(data, 0) * WLT_SECTOR_SIZE;
+		s->write_bytes = (__u64)wlt_entry_u32(data, 4) * WLT_SECTOR_SIZE;
+		if (content_group == 0) {
+			s->rand_write_pct = min(data[14], 100);
+			s->rand_read_pct = min(data[15], 100);
+		}
+		break;
+	case 1: /* CmdQ, snapshots of the commands outstanding */
+		reads = wlt_entry_u32(data, 20);
+		writes = wlt_entry_u32(data, 24);
+		s->read_cmds = reads;
+		s->write_cmds = writes;
+		s->queue_depth = reads + writes;
+		s->rand_write_pct = min(data[14], 100);
+		s->rand_read_pct = min(data[15], 100);
+		break;
+	case 3: /* RandSeq */
+		s->rate = true;
+		s->read_bytes = (__u64)wlt_entry_u32(data, 0) * WLT_SECTOR_SIZE;
+		s->write_bytes = (__u64)wlt_entry_u32(data, 4) * WLT_SECTOR_SIZE;
+		s->read_cmds = wlt_entry_u32(data, 20);
+		s->write_cmds = wlt_entry_u32(data, 24);
+		s->rand_read_pct = wlt_pct(wlt_entry_u32(data, 12), s->read_cmds);
+		s->rand_write_pct = wlt_pct(wlt_entry_u32(data, 16), s->write_cmds);
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+int sldgm_workload_tracker_profile(int argc, char **argv, struct command *cmd,
+				   struct plugin *plugin)
+{
+	const char *desc = "Convert a Workload Tracker ring file into a workload\n"
+		"profile for io-bench --profile";
+	struct nvme_workload w = { 0 };
+	struct nvme_workload_sample s;
+	struct wlt_ring ring;
+	__u64 capacity, head, first;
+	__u32 group, period;
+	FILE *f = stdout;
+	int err;
+
+	struct config {
+		char *profile;
+		__u32 min_phase;
+	};
+
+	struct config cfg = {
+		.profile = NULL,
+		.min_phase = 1000,
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_FILE("profile", 'p', &cfg.profile, "profile file to write, stdout if not given"),
+		OPT_UINT("min-phase", 'm', &cfg.min_phase,
+			 "shortest phase in ms the samples are merged into"),
+		OPT_END()
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts);
+	if (err)
+		return err;
+	if (optind >= argc) {
+		nvme_show_error("%s: ring file required", argv[0]);
+		return -EINVAL;
+	}
+
+	err = wlt_ring_open(&ring, argv[optind]);
+	if (err)
+		return err;
+
+	group = le32_to_cpu(ring.hdr->content_group);
+	period = le32_to_cpu(ring.hdr->sample_period_ms);
+	memset(&s, 0, sizeof(s));
+	if (!wlt_entry_sample(group, ring.entries[0].data, &s)) {
+		nvme_show_error("%s: %s samples don't track the host I/O, capture Base, CmdQ, RandSeq or Defrag",
+				argv[optind], trk_types[group]);
+		err = -EINVAL;
+		goto unmap;
+	}
+	if (!period) {
+		nvme_show_error("%s: no sample period recorded", argv[optind]);
+		err = -EINVAL;
+		goto unmap;
+	}
+
+	capacity = le64_to_cpu(ring.hdr->capacity);
+	head = le64_to_cpu(__atomic_load_n(&ring.hdr->head, __ATOMIC_ACQUIRE));
+	first = head > capacity ? head - capacity : 0;
+
+	for (__u64 i = first; i < head && !err; i++) {
+		memset(&s, 0, sizeof(s));
+		s.duration_ms = period;
+		wlt_entry_sample(group, ring.entries[i % capacity].data, &s);
+		err = nvme_workload_add(&w, &s, cfg.min_phase);
+	}
+	if (!err)
+		err = nvme_workload_finish(&w);
+	if (err) {
+		nvme_show_error("%s", strerror(-err));
+		goto free_workload;
+	}
+
+	if (cfg.profile) {
+		f = fopen(cfg.profile, "w");
+		if (!f) {
+			err = -errno;
+			nvme_show_error("%s: %s", cfg.profile, strerror(errno));
+			goto free_workload;
+		}
+	}
+	err = nvme_workload_write(f, &w);
+	if (f != stdout && fclose(f) && !err)
+		err = -errno;
+	if (err)
+		nvme_show_error("%s: %s", cfg.profile ? cfg.profile : "stdout", strerror(-err));
+free_workload:
+	nvme_workload_free(&w);
+unmap:
+	munmap(ring.hdr, ring.size);
+	return err;
+}
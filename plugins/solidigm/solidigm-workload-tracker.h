@@ -6,3 +6,7 @@
  */
 
 int sldgm_get_workload_tracker(int argc, char **argv, struct command *cmd, struct plugin *plugin);
+int sldgm_decode_workload_tracker(int argc, char **argv, struct command *cmd,
+				  struct plugin *plugin);
+int sldgm_workload_tracker_profile(int argc, char **argv, struct command *cmd,
+				   struct plugin *plugin);
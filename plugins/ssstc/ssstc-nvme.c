@@ -15,6 +15,7 @@
 
 #define CREATE_CMD
 #include "ssstc-nvme.h"
+#include "plugins/smart-attr.h"
 
 struct  __packed nvme_additional_smart_log_item
 {
@@ -59,320 +60,72 @@ struct nvme_additional_smart_log {
 };
 
 
-static
-void show_ssstc_add_smart_log_jsn(struct nvme_additional_smart_log *smart,
-		unsigned int nsid, const char *devname)
-{
-	struct json_object *root, *entry_stats, *dev_stats, *multi;
-	uint16_t wear_level_min = 0;
-	uint16_t wear_level_max = 0;
-	uint16_t wear_level_avg = 0;
-	uint64_t raw_val = 0;
-
-	root = json_create_object();
-	json_object_add_value_string(root, "SSSTC Smart log", devname);
-
-	dev_stats = json_create_object();
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->program_fail_cnt.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->program_fail_cnt.norm);
-	raw_val = int48_to_long(smart->program_fail_cnt.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "program_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->erase_fail_cnt.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->erase_fail_cnt.norm);
-	raw_val = int48_to_long(smart->erase_fail_cnt.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "erase_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->wear_leveling_cnt.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->wear_leveling_cnt.norm);
-	multi = json_create_object();
-	wear_level_min = le16_to_cpu(smart->wear_leveling_cnt.wear_level.min);
-	wear_level_max = le16_to_cpu(smart->wear_leveling_cnt.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->wear_leveling_cnt.wear_level.avg);
-	json_object_add_value_int(multi, "min", wear_level_min);
-	json_object_add_value_int(multi, "max", wear_level_max);
-	json_object_add_value_int(multi, "avg", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "wear_leveling", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->e2e_err_cnt.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->e2e_err_cnt.norm);
-	multi = json_create_object();
-	wear_level_min = le16_to_cpu(smart->e2e_err_cnt.wear_level.min);
-	wear_level_max = le16_to_cpu(smart->e2e_err_cnt.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->e2e_err_cnt.wear_level.avg);
-	json_object_add_value_int(multi, "guard check error", wear_level_min);
-	json_object_add_value_int(multi, "application tag check error", wear_level_max);
-	json_object_add_value_int(multi, "reference tag check error", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "end_to_end_error_dect_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->crc_err_cnt.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->crc_err_cnt.norm);
-	raw_val = int48_to_long(smart->crc_err_cnt.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "crc_error_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->nand_bytes_written.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->nand_bytes_written.norm);
-	raw_val = int48_to_long(smart->nand_bytes_written.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "nand_bytes_written", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->host_bytes_written.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->host_bytes_written.norm);
-	raw_val = int48_to_long(smart->host_bytes_written.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "host_bytes_written", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->reallocated_sector_count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->reallocated_sector_count.norm);
-	raw_val = int48_to_long(smart->reallocated_sector_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "reallocated_sector_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->uncorrectable_sector_count.key);
-	json_object_add_value_int(entry_stats, "normalized",
-		smart->uncorrectable_sector_count.norm);
-	raw_val = int48_to_long(smart->uncorrectable_sector_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "uncorrectable_sector_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->NAND_ECC_Detection_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->NAND_ECC_Detection_Count.norm);
-	raw_val = int48_to_long(smart->NAND_ECC_Detection_Count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "NAND_ECC_detection_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->NAND_ECC_Correction_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->NAND_ECC_Correction_Count.norm);
-	raw_val = int48_to_long(smart->NAND_ECC_Correction_Count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "NAND_ECC_correction_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->GC_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->GC_Count.norm);
-	raw_val = int48_to_long(smart->GC_Count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "GC_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->DRAM_UECC_Detection_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->DRAM_UECC_Detection_Count.norm);
-	multi = json_create_object();
-	wear_level_max = le16_to_cpu(smart->DRAM_UECC_Detection_Count.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->DRAM_UECC_Detection_Count.wear_level.avg);
-	json_object_add_value_int(multi, "1-Bit Err", wear_level_max);
-	json_object_add_value_int(multi, "2-Bit Err", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "DRAM_UECC_detection_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->SRAM_UECC_Detection_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->SRAM_UECC_Detection_Count.norm);
-	multi = json_create_object();
-	wear_level_min = le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.min);
-	wear_level_max = le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.avg);
-	json_object_add_value_int(multi, "parity error detected", wear_level_min);
-	json_object_add_value_int(multi, "ecc error detection", wear_level_max);
-	json_object_add_value_int(multi, "axi data parity errors", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "SRAM_UECC_Detection_Count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->Raid_Recovery_Fail_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->Raid_Recovery_Fail_Count.norm);
-	raw_val = int48_to_long(smart->Raid_Recovery_Fail_Count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "raid_Recovery_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->Inflight_Command.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->Inflight_Command.norm);
-	multi = json_create_object();
-	wear_level_min = le16_to_cpu(smart->Inflight_Command.wear_level.min);
-	wear_level_max = le16_to_cpu(smart->Inflight_Command.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->Inflight_Command.wear_level.avg);
-	json_object_add_value_int(multi, "Read Cmd", wear_level_min);
-	json_object_add_value_int(multi, "Write Cmd", wear_level_max);
-	json_object_add_value_int(multi, "Admin Cmd", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "Inflight_Command", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->Internal_End_to_End_Dect_Count.key);
-	json_object_add_value_int(entry_stats, "normalized", 100);
-	multi = json_create_object();
-	wear_level_min = le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.min);
-	wear_level_max = le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.max);
-	wear_level_avg = le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.avg);
-	json_object_add_value_int(multi, "read hcrc", wear_level_min);
-	json_object_add_value_int(multi, "write hcrc", wear_level_max);
-	json_object_add_value_int(multi, "reserved", wear_level_avg);
-	json_object_add_value_object(entry_stats, "raw", multi);
-	json_object_add_value_object(dev_stats, "internal_end_to_end_dect_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->die_fail_count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->die_fail_count.norm);
-	raw_val = int48_to_long(smart->die_fail_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "die_fail_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->wear_leveling_exec_count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->wear_leveling_exec_count.norm);
-	raw_val = int48_to_long(smart->wear_leveling_exec_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "wear_leveling_exec_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->read_disturb_count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->read_disturb_count.norm);
-	raw_val = int48_to_long(smart->read_disturb_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "read_disturb_count", entry_stats);
-
-	entry_stats = json_create_object();
-	json_object_add_value_int(entry_stats, "#id", smart->data_retention_count.key);
-	json_object_add_value_int(entry_stats, "normalized", smart->data_retention_count.norm);
-	raw_val = int48_to_long(smart->data_retention_count.raw);
-	json_object_add_value_int(entry_stats, "raw", raw_val);
-	json_object_add_value_object(dev_stats, "data_retention_count", entry_stats);
-
-	json_object_add_value_object(root, "Device stats", dev_stats);
-
-	json_print_object(root, NULL);
-	json_free_object(root);
-}
+static const char * const ssstc_wear_level[] = { "min", "max", "avg" };
+static const char * const ssstc_e2e[] = {
+	"guard check error", "application tag check error", "reference tag check error",
+};
+static const char * const ssstc_dram_uecc[] = { NULL, "1-Bit Err", "2-Bit Err" };
+static const char * const ssstc_sram_uecc[] = {
+	"parity error detected", "ecc error detection", "axi data parity errors",
+};
+static const char * const ssstc_inflight[] = { "Read Cmd", "Write Cmd", "Admin Cmd" };
+static const char * const ssstc_internal_e2e[] = { "read hcrc", "write hcrc", "reserved" };
+
+#define SSSTC_ATTR(_member, _name, ...)						\
+	{ .name = _name,							\
+	  .offset = offsetof(struct nvme_additional_smart_log, _member) /	\
+		    sizeof(struct nvme_additional_smart_log_item), __VA_ARGS__ }
+
+static const struct smart_attr ssstc_smart_attrs[] = {
+	SSSTC_ATTR(program_fail_cnt, "program_fail_count"),
+	SSSTC_ATTR(erase_fail_cnt, "erase_fail_count"),
+	SSSTC_ATTR(wear_leveling_cnt, "wear_leveling", .type = SMART_ATTR_LE16X3,
+		   .fmt = "min: %u, max: %u, avg: %u", .keys = ssstc_wear_level),
+	SSSTC_ATTR(e2e_err_cnt, "end_to_end_error_dect_count", .type = SMART_ATTR_LE16X3,
+		   .fmt = "guard check error: %u, application tag check error: %u, "
+			  "reference tag check error: %u", .keys = ssstc_e2e),
+	SSSTC_ATTR(crc_err_cnt, "crc_error_count"),
+	SSSTC_ATTR(nand_bytes_written, "nand_bytes_written", .fmt = "sectors: %u"),
+	SSSTC_ATTR(host_bytes_written, "host_bytes_written", .fmt = "sectors: %u"),
+	SSSTC_ATTR(reallocated_sector_count, "reallocated_sector_count"),
+	SSSTC_ATTR(uncorrectable_sector_count, "uncorrectable_sector_count"),
+	SSSTC_ATTR(NAND_ECC_Detection_Count, "NAND_ECC_detection_count"),
+	SSSTC_ATTR(NAND_ECC_Correction_Count, "NAND_ECC_correction_count"),
+	SSSTC_ATTR(GC_Count, "GC_count"),
+	SSSTC_ATTR(DRAM_UECC_Detection_Count, "DRAM_UECC_detection_count",
+		   .type = SMART_ATTR_LE16X3, .fmt = "1-Bit Err: %u, 2-Bit Err: %u",
+		   .keys = ssstc_dram_uecc),
+	SSSTC_ATTR(SRAM_UECC_Detection_Count, "SRAM_UECC_Detection_Count",
+		   .type = SMART_ATTR_LE16X3,
+		   .fmt = "parity error detected: %u, ecc error detection: %u, "
+			  "axi data parity errors: %u", .keys = ssstc_sram_uecc),
+	SSSTC_ATTR(Raid_Recovery_Fail_Count, "raid_recovery_fail_count",
+		   .json = "raid_Recovery_fail_count"),
+	SSSTC_ATTR(Inflight_Command, "Inflight_Command", .type = SMART_ATTR_LE16X3,
+		   .fmt = "Read Cmd: %u, Write Cmd: %u, Admin Cmd: %u",
+		   .keys = ssstc_inflight),
+	SSSTC_ATTR(Internal_End_to_End_Dect_Count, "internal_end_to_end_dect_count",
+		   .type = SMART_ATTR_LE16X3, .flags = SMART_ATTR_NORM_100,
+		   .fmt = "read hcrc: %u, write hcrc: %u, reserved: %u",
+		   .keys = ssstc_internal_e2e),
+	SSSTC_ATTR(die_fail_count, "die_fail_count"),
+	SSSTC_ATTR(wear_leveling_exec_count, "wear_leveling_exec_count"),
+	SSSTC_ATTR(read_disturb_count, "read_disturb_count"),
+	SSSTC_ATTR(data_retention_count, "data_retention_count"),
+};
 
-static
-void show_ssstc_add_smart_log(struct nvme_additional_smart_log *smart,
-		unsigned int nsid, const char *devname)
-{
-	printf("Additional Smart Log for NVME device:%s namespace-id:%x\n",
-		devname, nsid);
-	printf("key                               #id  normalized raw\n");
-	printf("program_fail_count              : %03d  %3d%%       %"PRIu64"\n",
-		smart->program_fail_cnt.key,
-		smart->program_fail_cnt.norm,
-		int48_to_long(smart->program_fail_cnt.raw));
-	printf("erase_fail_count                : %03d  %3d%%       %"PRIu64"\n",
-		smart->erase_fail_cnt.key,
-		smart->erase_fail_cnt.norm,
-		int48_to_long(smart->erase_fail_cnt.raw));
-	printf("wear_leveling                   : %03d  %3d%%       min: %u, max: %u, avg: %u\n",
-		smart->wear_leveling_cnt.key,
-		smart->wear_leveling_cnt.norm,
-		le16_to_cpu(smart->wear_leveling_cnt.wear_level.min),
-		le16_to_cpu(smart->wear_leveling_cnt.wear_level.max),
-		le16_to_cpu(smart->wear_leveling_cnt.wear_level.avg));
-	printf("end_to_end_error_dect_count     : %03d  %3d%%       "
-		"guard check error: %u, "
-		"application tag check error: %u, "
-		"reference tag check error: %u\n",
-		smart->e2e_err_cnt.key,
-		smart->e2e_err_cnt.norm,
-		le16_to_cpu(smart->e2e_err_cnt.wear_level.min),
-		le16_to_cpu(smart->e2e_err_cnt.wear_level.max),
-		le16_to_cpu(smart->e2e_err_cnt.wear_level.avg));
-	printf("crc_error_count                 : %03d  %3d%%       %"PRIu64"\n",
-		smart->crc_err_cnt.key,
-		smart->crc_err_cnt.norm,
-		int48_to_long(smart->crc_err_cnt.raw));
-	printf("nand_bytes_written              : %03d  %3d%%       sectors: %"PRIu64"\n",
-		smart->nand_bytes_written.key,
-		smart->nand_bytes_written.norm,
-		int48_to_long(smart->nand_bytes_written.raw));
-	printf("host_bytes_written              : %3d  %3d%%       sectors: %"PRIu64"\n",
-		smart->host_bytes_written.key,
-		smart->host_bytes_written.norm,
-		int48_to_long(smart->host_bytes_written.raw));
-	printf("reallocated_sector_count        : %03d  %3d%%       %"PRIu64"\n",
-		smart->reallocated_sector_count.key,
-		smart->reallocated_sector_count.norm,
-		int48_to_long(smart->reallocated_sector_count.raw));
-	printf("uncorrectable_sector_count      : %03d  %3d%%       %"PRIu64"\n",
-		smart->uncorrectable_sector_count.key,
-		smart->uncorrectable_sector_count.norm,
-		int48_to_long(smart->uncorrectable_sector_count.raw));
-	printf("NAND_ECC_detection_count        : %03d  %3d%%       %"PRIu64"\n",
-		smart->NAND_ECC_Detection_Count.key,
-		smart->NAND_ECC_Detection_Count.norm,
-		int48_to_long(smart->NAND_ECC_Detection_Count.raw));
-	printf("NAND_ECC_correction_count       : %03d  %3d%%       %"PRIu64"\n",
-		smart->NAND_ECC_Correction_Count.key,
-		smart->NAND_ECC_Correction_Count.norm,
-		int48_to_long(smart->NAND_ECC_Correction_Count.raw));
-	printf("GC_count                        : %03d  %3d%%       %"PRIu64"\n",
-		smart->GC_Count.key,
-		smart->GC_Count.norm,
-		int48_to_long(smart->GC_Count.raw));
-	printf("DRAM_UECC_detection_count       : %03d  %3d%%       1-Bit Err: %u, 2-Bit Err: %u\n",
-		smart->DRAM_UECC_Detection_Count.key,
-		smart->DRAM_UECC_Detection_Count.norm,
-		le16_to_cpu(smart->DRAM_UECC_Detection_Count.wear_level.max),
-		le16_to_cpu(smart->DRAM_UECC_Detection_Count.wear_level.avg));
-	printf("SRAM_UECC_Detection_Count       : %03d  %3d%%       "
-		"parity error detected: %u, "
-		"ecc error detection: %u, "
-		"axi data parity errors: %u\n",
-		smart->SRAM_UECC_Detection_Count.key,
-		smart->SRAM_UECC_Detection_Count.norm,
-		le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.min),
-		le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.max),
-		le16_to_cpu(smart->SRAM_UECC_Detection_Count.wear_level.avg));
-	printf("raid_recovery_fail_count        : %03d  %3d%%       %"PRIu64"\n",
-		smart->Raid_Recovery_Fail_Count.key,
-		smart->Raid_Recovery_Fail_Count.norm,
-		int48_to_long(smart->Raid_Recovery_Fail_Count.raw));
-	printf("Inflight_Command                : %03d  %3d%%       "
-		"Read Cmd: %u, Write Cmd: %u, Admin Cmd: %u\n",
-		smart->Inflight_Command.key,
-		smart->Inflight_Command.norm,
-		le16_to_cpu(smart->Inflight_Command.wear_level.min),
-		le16_to_cpu(smart->Inflight_Command.wear_level.max),
-		le16_to_cpu(smart->Inflight_Command.wear_level.avg));
-	printf("internal_end_to_end_dect_count  : %03d  %3d%%       "
-		"read hcrc: %u, write hcrc: %u, reserved: %u\n",
-		smart->Internal_End_to_End_Dect_Count.key,
-		100,
-		le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.min),
-		le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.max),
-		le16_to_cpu(smart->Internal_End_to_End_Dect_Count.wear_level.avg));
-	printf("die_fail_count                  : %03d  %3d%%       %"PRIu64"\n",
-		smart->die_fail_count.key,
-		smart->die_fail_count.norm,
-		int48_to_long(smart->die_fail_count.raw));
-	printf("wear_leveling_exec_count        : %03d  %3d%%       %"PRIu64"\n",
-		smart->wear_leveling_exec_count.key,
-		smart->wear_leveling_exec_count.norm,
-		int48_to_long(smart->wear_leveling_exec_count.raw));
-	printf("read_disturb_count              : %03d  %3d%%       %"PRIu64"\n",
-		smart->read_disturb_count.key,
-		smart->read_disturb_count.norm,
-		int48_to_long(smart->read_disturb_count.raw));
-	printf("data_retention_count            : %03d  %3d%%       %"PRIu64"\n",
-		smart->data_retention_count.key,
-		smart->data_retention_count.norm,
-		int48_to_long(smart->data_retention_count.raw));
-}
+static const struct smart_attr_layout ssstc_smart_layout = {
+	.title		= "SSSTC Smart log",
+	.attrs		= ssstc_smart_attrs,
+	.nr_attrs	= ARRAY_SIZE(ssstc_smart_attrs),
+	.item_size	= sizeof(struct nvme_additional_smart_log_item),
+	.id_offset	= offsetof(struct nvme_additional_smart_log_item, key),
+	.norm_offset	= offsetof(struct nvme_additional_smart_log_item, norm),
+	.raw_offset	= offsetof(struct nvme_additional_smart_log_item, raw),
+	.label_width	= 32,
+	.columns	= "key                               #id  normalized raw",
+	.len		= sizeof(struct nvme_additional_smart_log),
+};
 
 static
 int ssstc_get_add_smart_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
@@ -386,6 +139,7 @@ int ssstc_get_add_smart_log(int argc, char **argv, struct command *cmd, struct p
 	const char *json = "Dump output in json format";
 
 	struct nvme_additional_smart_log smart_log_add;
+	enum nvme_print_flags fmt;
 	struct nvme_dev *dev;
 	int err;
 
@@ -393,16 +147,19 @@ int ssstc_get_add_smart_log(int argc, char **argv, struct command *cmd, struct p
 		__u32 namespace_id;
 		bool  raw_binary;
 		bool  json;
+		char  *output_format;
 	};
 
 	struct config cfg = {
 		.namespace_id = NVME_NSID_ALL,
+		.output_format = "normal",
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id, namespace),
 		OPT_FLAG("raw-binary",   'b', &cfg.raw_binary,   raw),
 		OPT_FLAG("json",         'j', &cfg.json,         json),
+		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
 		OPT_END()
 	};
 
@@ -410,17 +167,22 @@ int ssstc_get_add_smart_log(int argc, char **argv, struct command *cmd, struct p
 	if (err)
 		return err;
 
+	err = validate_output_format(cfg.output_format, &fmt);
+	if (err < 0) {
+		nvme_show_error("Invalid output format");
+		dev_close(dev);
+		return err;
+	}
+	if (cfg.json)
+		fmt = JSON;
+	else if (cfg.raw_binary)
+		fmt = BINARY;
+
 	err = nvme_get_log_simple(dev_fd(dev), 0xca, sizeof(smart_log_add),
 				  &smart_log_add);
 	if (!err) {
-		if (cfg.json)
-			show_ssstc_add_smart_log_jsn(&smart_log_add, cfg.namespace_id,
-						 dev->name);
-		else if (!cfg.raw_binary)
-			show_ssstc_add_smart_log(&smart_log_add, cfg.namespace_id,
-					     dev->name);
-		else
-			d_raw((unsigned char *)&smart_log_add, sizeof(smart_log_add));
+		smart_attr_print(&ssstc_smart_layout, &smart_log_add, dev->name,
+				 cfg.namespace_id, fmt);
 	} else if (err > 0) {
 		nvme_show_status(err);
 	}
@@ -7,12 +7,15 @@
 #include <stddef.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 
+#include "common.h"
 #include "nvme.h"
 #include "libnvme.h"
 #include "plugin.h"
 #include "linux/types.h"
 #include "nvme-print.h"
+#include "util/stream.h"
 
 #define CREATE_CMD
 #include "toshiba-nvme.h"
@@ -186,10 +189,11 @@ static int d_raw_to_fd(const unsigned char *buf, unsigned int len, int fd)
 	return remaining;
 }
 
-/* Display progress (incoming 0->1.0) */
-static void progress_runner(float progress)
+/* Display progress (incoming 0->1.0) and the transfer rate since @start_ns */
+static void progress_runner(float progress, __u64 bytes, __u64 start_ns)
 {
 	const size_t barWidth = 70;
+	__u64 elapsed = monotonic_ns() - start_ns;
 	size_t i, pos;
 
 	fprintf(stdout, "[");
@@ -201,31 +205,112 @@ static void progress_runner(float progress)
 			fprintf(stdout, " ");
 	}
 
-	fprintf(stdout, "] %d %%\r", (int)(progress * 100.0));
+	fprintf(stdout, "] %d %% %.1f MB/s\r", (int)(progress * 100.0),
+		elapsed ? (double)bytes * NSEC_PER_SEC / elapsed / 1000000 : 0.0);
 	fflush(stdout);
 }
 
+static const size_t SCT_PAGE_SECTORS = 32;
+static const size_t SCT_PAGE_LEN = 32 * 512;	/* 32 sectors per page */
+/*
+ * By trial and error it seems that the largest transfer chunk size
+ * is 128 * 32 = 4k sectors = 2MB
+ */
+static const __u32 SCT_MAX_PAGES = 128;
+
+/* pages per SCT data transfer within MDTS, assuming a 4k minimum page size */
+static __u32 nvme_sct_max_xfer_pages(int fd)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	__u32 pages = SCT_MAX_PAGES;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (ctrl && !nvme_identify_ctrl(fd, ctrl) && ctrl->mdts && ctrl->mdts < 20)
+		pages = min(pages, max((__u32)((4096ULL << ctrl->mdts) / SCT_PAGE_LEN), 1U));
+
+	return pages;
+}
+
+/*
+ * Read @nr pages starting at @page into @buf, *@xfer pages per SCT data
+ * transfer. A transfer the device rejects is retried with half the size,
+ * which is then kept for the rest of the log.
+ */
+static int nvme_sct_read_pages(int fd, void *buf, size_t page, size_t nr, __u32 *xfer)
+{
+	size_t done = 0, n;
+	int err;
+
+	while (done < nr) {
+		n = min(nr - done, (size_t)*xfer);
+		err = nvme_sct_data_transfer(fd, buf + done * SCT_PAGE_LEN,
+					     n * SCT_PAGE_LEN,
+					     (page + done) * SCT_PAGE_SECTORS);
+		if (err && n > 1) {
+			*xfer = n / 2;
+			continue;
+		}
+		if (err)
+			return err;
+		done += n;
+	}
+
+	return 0;
+}
+
+/*
+ * Stream pages 1 to @pages - 1 of the log into @o_fd. The SCT data
+ * transfer of a chunk overlaps with the write of the previous one.
+ */
+static int nvme_sct_log_to_file(int fd, int o_fd, size_t pages, __u32 xfer,
+				__u64 start_ns)
+{
+	struct nvme_stream s;
+	size_t i = 1, len;
+	int err, serr;
+	void *data;
+
+	err = nvme_stream_init(&s, o_fd, NVME_STREAM_TO_FILE,
+			       (__u64)(pages - 1) * SCT_PAGE_LEN,
+			       xfer * SCT_PAGE_LEN, 4);
+	if (err)
+		return err;
+
+	while ((data = nvme_stream_get(&s, &len))) {
+		err = nvme_sct_read_pages(fd, data, i, len / SCT_PAGE_LEN, &xfer);
+		if (err) {
+			fprintf(stderr, "%s: SCT data transfer command failed\n", __func__);
+			break;
+		}
+		nvme_stream_put(&s, len);
+		i += len / SCT_PAGE_LEN;
+		progress_runner((float)i / pages, (__u64)i * SCT_PAGE_LEN, start_ns);
+	}
+
+	serr = nvme_stream_finish(&s, err != 0);
+	if (!err && serr) {
+		fprintf(stderr, "%s: couldn't write all data to output file: %s\n",
+			__func__, strerror(-serr));
+		err = serr;
+	}
+
+	return err;
+}
+
 static int nvme_get_internal_log(int fd, const char *const filename, bool current)
 {
 	int err;
 	int o_fd = -1;
 	void *page_data = NULL;
-	const size_t page_sector_len = 32;
-	const size_t page_data_len = page_sector_len * 512; /* 32 sectors per page */
 	uint32_t *area1_last_page;
 	uint32_t *area2_last_page;
 	uint32_t *area3_last_page;
 	uint32_t log_sectors = 0;
 	size_t pages;
-	__u32 pages_chunk;
-	/*
-	 * By trial and error it seems that the largest transfer chunk size
-	 * is 128 * 32 = 4k sectors = 2MB
-	 */
-	const __u32 max_pages = 128;
+	__u32 pages_chunk, xfer;
 	size_t i;
 	unsigned int j;
-	float progress = 0.0;
+	__u64 start_ns;
 
 	err = nvme_sct_command_transfer_log(fd, current);
 	if (err) {
@@ -233,14 +318,17 @@ static int nvme_get_internal_log(int fd, const char *const filename, bool curren
 		goto end;
 	}
 
-	if (posix_memalign(&page_data, getpagesize(), max_pages * page_data_len)) {
+	xfer = nvme_sct_max_xfer_pages(fd);
+	if (posix_memalign(&page_data, getpagesize(), xfer * SCT_PAGE_LEN)) {
 		err = ENOMEM;
 		goto end;
 	}
-	memset(page_data, 0, max_pages * page_data_len);
+	memset(page_data, 0, xfer * SCT_PAGE_LEN);
+
+	start_ns = monotonic_ns();
 
 	/* Read the header to get the last log page - offsets 8->11, 12->15, 16->19 */
-	err = nvme_sct_data_transfer(fd, page_data, page_data_len, 0);
+	err = nvme_sct_data_transfer(fd, page_data, SCT_PAGE_LEN, 0);
 	if (err) {
 		fprintf(stderr, "%s: SCT data transfer failed, page 0\n", __func__);
 		goto end;
@@ -259,59 +347,50 @@ static int nvme_get_internal_log(int fd, const char *const filename, bool curren
 		log_sectors = *area3_last_page;
 
 	++log_sectors;
-	pages = log_sectors / page_sector_len;
+	pages = log_sectors / SCT_PAGE_SECTORS;
 	if (filename == NULL) {
 		fprintf(stdout, "Page: %u of %zu\n", 0u, pages);
-		d(page_data, page_data_len, 16, 1);
+		d(page_data, SCT_PAGE_LEN, 16, 1);
 	} else {
-		progress_runner(progress);
+		progress_runner(0.0f, 0, start_ns);
 		o_fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 		if (o_fd < 0) {
 			fprintf(stderr, "%s: couldn't output file %s\n", __func__, filename);
 			err = -EINVAL;
 			goto end;
 		}
-		err = d_raw_to_fd(page_data, page_data_len, o_fd);
+		err = d_raw_to_fd(page_data, SCT_PAGE_LEN, o_fd);
 		if (err) {
 			fprintf(stderr, "%s: couldn't write all data to output file\n", __func__);
 			goto end;
 		}
+
+		/* Now stream the rest */
+		if (pages > 1) {
+			err = nvme_sct_log_to_file(fd, o_fd, pages, xfer, start_ns);
+			if (err)
+				goto end;
+		}
 	}
 
-	/* Now read the rest */
-	for (i = 1; i < pages;) {
-		pages_chunk = max_pages;
-		if (pages_chunk + i >= pages)
-			pages_chunk = pages - i;
+	/* Or dump it */
+	for (i = 1; filename == NULL && i < pages;) {
+		pages_chunk = min((size_t)xfer, pages - i);
 
-		err = nvme_sct_data_transfer(fd, page_data,
-					     pages_chunk * page_data_len,
-					     i * page_sector_len);
+		err = nvme_sct_read_pages(fd, page_data, i, pages_chunk, &xfer);
 		if (err) {
 			fprintf(stderr, "%s: SCT data transfer command failed\n", __func__);
 			goto end;
 		}
 
-		progress = (float) (i) / (float) (pages);
-		progress_runner(progress);
-		if (filename == NULL) {
-			for (j = 0; j < pages_chunk; ++j) {
-				fprintf(stdout, "Page: %zu of %zu\n", i + j, pages);
-				d(page_data + (j * page_data_len), page_data_len, 16, 1);
-			}
-		} else {
-			progress_runner(progress);
-			err = d_raw_to_fd(page_data, pages_chunk * page_data_len, o_fd);
-			if (err) {
-				fprintf(stderr, "%s: couldn't write all data to output file\n",
-					__func__);
-				goto end;
-			}
+		progress_runner((float)i / pages, (__u64)i * SCT_PAGE_LEN, start_ns);
+		for (j = 0; j < pages_chunk; ++j) {
+			fprintf(stdout, "Page: %zu of %zu\n", i + j, pages);
+			d(page_data + (j * SCT_PAGE_LEN), SCT_PAGE_LEN, 16, 1);
 		}
 		i += pages_chunk;
 	}
-	progress = 1.0f;
-	progress_runner(progress);
+	progress_runner(1.0f, (__u64)max(pages, (size_t)1) * SCT_PAGE_LEN, start_ns);
 	fprintf(stdout, "\n");
 	err = nvme_get_sct_status(fd, MASK_IGNORE);
 	if (err) {
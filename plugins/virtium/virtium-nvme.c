@@ -9,11 +9,13 @@
 #include <stdbool.h>
 #include <time.h>
 #include <locale.h>
+#include <signal.h>
 
 #include "common.h"
 #include "nvme.h"
 #include "libnvme.h"
 #include "plugin.h"
+#include "util/interval.h"
 #include "util/types.h"
 
 #define CREATE_CMD
@@ -26,6 +28,7 @@
 #define MAX_HEADER_BUFF     (20 * 1024)
 #define MAX_LOG_BUFF        4096
 #define DEFAULT_TEST_NAME   "Put the name of your test here"
+#define DEFAULT_BATCH       16
 
 static char vt_default_log_file_name[256];
 
@@ -50,6 +53,40 @@ struct vtview_save_log_settings {
 	double		log_record_frequency_hrs;
 	const char	*output_file;
 	const char	*test_name;
+	bool		binary;
+	unsigned int	batch;
+};
+
+/*
+ * Binary log of --binary: a session header followed by one record per
+ * sample, all little endian. Appending to a log starts a new session, a
+ * header is told from a record by its magic. Identify data only goes in
+ * the header, a sample is just the SMART log.
+ */
+#define VT_BIN_MAGIC        "VTVIEWB1"
+
+struct vtview_bin_header {
+	char			magic[8];
+	char			path[256];
+	char			test_name[256];
+	__le64			time_stamp;
+	struct nvme_id_ctrl	raw_ctrl;
+	struct nvme_firmware_slot raw_fw;
+	struct nvme_id_ns	raw_ns;
+};
+
+struct vtview_bin_record {
+	__le64			time_stamp;
+	struct nvme_smart_log	raw_smart;
+};
+
+/* the open log file, records of a binary log are written in batches */
+struct vtview_log_out {
+	FILE			*text;
+	int			fd;
+	struct vtview_bin_record *recs;
+	unsigned int		nr_recs;
+	unsigned int		batch;
 };
 
 static void vt_initialize_header_buffer(struct vtview_log_header *pbuff)
@@ -84,9 +121,10 @@ static void vt_convert_data_buffer_to_hex_string(const unsigned char *bufPtr,
 /*
  * Generate log file name.
  * Log file name will be generated automatically if user leave log file option blank.
- * Log file name will be generated as vtView-Smart-log-date-time.txt
+ * Log file name will be generated as vtView-Smart-log-date-time.txt, or .bin
+ * for a binary log.
  */
-static void vt_generate_vtview_log_file_name(char *fname)
+static void vt_generate_vtview_log_file_name(char *fname, const char *ext)
 {
 	time_t     current;
 	struct tm  tstamp;
@@ -99,8 +137,7 @@ static void vt_generate_vtview_log_file_name(char *fname)
 	strcat(fname, temp);
 	strftime(temp, sizeof(temp), "%Y-%m-%d", &tstamp);
 	strcat(fname, temp);
-	snprintf(temp, sizeof(temp), ".txt");
-	strcat(fname, temp);
+	strcat(fname, ext);
 }
 
 static void vt_convert_smart_data_to_human_readable_format(struct vtview_smart_log_entry *smart, char *text)
@@ -215,35 +252,109 @@ static void vt_header_to_string(const struct vtview_log_header *header, char *te
 	strcat(text, tempbuff);
 }
 
-static int vt_append_text_file(const char *text, const char *filename)
+static int vt_append_text_file(const char *text, FILE *f)
 {
-	FILE *f;
-
-	f = fopen(filename, "a");
-	if (!f) {
-		printf("Cannot open %s\n", filename);
+	if (fputs(text, f) < 0 || fflush(f)) {
+		printf("Cannot write log file: %s\n", strerror(errno));
 		return -1;
 	}
 
-	fprintf(f, "%s", text);
-	fclose(f);
 	return 0;
 }
 
-static int vt_append_log(struct vtview_smart_log_entry *smart, const char *filename)
+static int vt_append_log(struct vtview_smart_log_entry *smart, FILE *f)
 {
 	char sm_log_text[MAX_LOG_BUFF] = "";
 
 	vt_convert_smart_data_to_human_readable_format(smart, sm_log_text);
-	return vt_append_text_file(sm_log_text, filename);
+	return vt_append_text_file(sm_log_text, f);
 }
 
-static int vt_append_header(const struct vtview_log_header *header, const char *filename)
+static int vt_append_header(const struct vtview_log_header *header, FILE *f)
 {
 	char header_text[MAX_HEADER_BUFF] = "";
 
 	vt_header_to_string(header, header_text);
-	return vt_append_text_file(header_text, filename);
+	return vt_append_text_file(header_text, f);
+}
+
+static int vt_write_all(int fd, const void *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			printf("Cannot write log file: %s\n", strerror(errno));
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int vt_flush_bin_log(struct vtview_log_out *out)
+{
+	int ret;
+
+	ret = vt_write_all(out->fd, out->recs, out->nr_recs * sizeof(*out->recs));
+	out->nr_recs = 0;
+	return ret;
+}
+
+static int vt_add_bin_entry_to_log(const int fd, struct vtview_log_out *out)
+{
+	struct vtview_bin_record *rec = &out->recs[out->nr_recs];
+	int ret;
+
+	ret = nvme_get_log_smart(fd, NVME_NSID_ALL, false, &rec->raw_smart);
+	if (ret) {
+		printf("Cannot read device SMART log\n");
+		return -1;
+	}
+	rec->time_stamp = cpu_to_le64(time(NULL));
+
+	if (++out->nr_recs < out->batch)
+		return 0;
+
+	return vt_flush_bin_log(out);
+}
+
+static int vt_write_bin_header(const int fd, const struct vtview_log_header *header,
+			       struct vtview_log_out *out)
+{
+	_cleanup_free_ struct vtview_bin_header *bin = NULL;
+	unsigned int nsid = 0;
+	int ret;
+
+	bin = calloc(1, sizeof(*bin));
+	if (!bin)
+		return -1;
+
+	ret = nvme_get_nsid(fd, &nsid);
+	if (ret < 0) {
+		printf("Cannot read namespace-id\n");
+		return -1;
+	}
+
+	ret = nvme_identify_ns(fd, nsid, &bin->raw_ns);
+	if (ret) {
+		printf("Cannot read namespace identify\n");
+		return -1;
+	}
+
+	memcpy(bin->magic, VT_BIN_MAGIC, sizeof(bin->magic));
+	memcpy(bin->path, header->path, sizeof(bin->path));
+	memcpy(bin->test_name, header->test_name, sizeof(bin->test_name));
+	bin->time_stamp = cpu_to_le64(header->time_stamp);
+	bin->raw_ctrl = header->raw_ctrl;
+	bin->raw_fw = header->raw_fw;
+
+	return vt_write_all(out->fd, bin, sizeof(*bin));
 }
 
 static void vt_process_string(char *str, const size_t size)
@@ -260,19 +371,17 @@ static void vt_process_string(char *str, const size_t size)
 	}
 }
 
-static int vt_add_entry_to_log(const int fd, const char *path, const struct vtview_save_log_settings *cfg)
+static int vt_add_entry_to_log(const int fd, const char *path, struct vtview_log_out *out)
 {
 	struct vtview_smart_log_entry smart;
-	const char *filename;
 	int ret = 0;
 	unsigned int nsid = 0;
 
+	if (!out->text)
+		return vt_add_bin_entry_to_log(fd, out);
+
 	memset(smart.path, 0, sizeof(smart.path));
 	strncpy(smart.path, path, sizeof(smart.path) - 1);
-	if (!cfg->output_file)
-		filename = vt_default_log_file_name;
-	else
-		filename = cfg->output_file;
 
 	smart.time_stamp = time(NULL);
 	ret = nvme_get_nsid(fd, &nsid);
@@ -303,14 +412,14 @@ static int vt_add_entry_to_log(const int fd, const char *path, const struct vtvi
 	vt_process_string(smart.raw_ctrl.sn, sizeof(smart.raw_ctrl.sn));
 	vt_process_string(smart.raw_ctrl.mn, sizeof(smart.raw_ctrl.mn));
 
-	ret = vt_append_log(&smart, filename);
+	ret = vt_append_log(&smart, out->text);
 	return ret;
 }
 
-static int vt_update_vtview_log_header(const int fd, const char *path, const struct vtview_save_log_settings *cfg)
+static int vt_update_vtview_log_header(const int fd, const char *path, const struct vtview_save_log_settings *cfg,
+				       struct vtview_log_out *out)
 {
 	struct vtview_log_header header;
-	const char *filename;
 	int ret = 0;
 
 	vt_initialize_header_buffer(&header);
@@ -332,12 +441,6 @@ static int vt_update_vtview_log_header(const int fd, const char *path, const str
 		strcpy(header.test_name, cfg->test_name);
 	}
 
-	if (!cfg->output_file)
-		filename = vt_default_log_file_name;
-	else
-		filename = cfg->output_file;
-
-	printf("Log file: %s\n", filename);
 	header.time_stamp = time(NULL);
 
 	ret = nvme_identify_ctrl(fd, &header.raw_ctrl);
@@ -355,10 +458,93 @@ static int vt_update_vtview_log_header(const int fd, const char *path, const str
 	vt_process_string(header.raw_ctrl.sn, sizeof(header.raw_ctrl.sn));
 	vt_process_string(header.raw_ctrl.mn, sizeof(header.raw_ctrl.mn));
 
-	ret = vt_append_header(&header, filename);
+	if (!out->text)
+		return vt_write_bin_header(fd, &header, out);
+
+	ret = vt_append_header(&header, out->text);
 	return ret;
 }
 
+/*
+ * Convert a binary log to the text format, header lines and log lines
+ * exactly as save-smart-to-vtview-log writes them without --binary.
+ */
+static int vt_convert_bin_log(FILE *in, FILE *out)
+{
+	_cleanup_free_ struct vtview_log_header *header = NULL;
+	_cleanup_free_ struct vtview_bin_header *bin = NULL;
+	_cleanup_free_ struct vtview_smart_log_entry *smart = NULL;
+	struct vtview_bin_record rec;
+	bool have_header = false;
+	char magic[8];
+	size_t n;
+
+	header = calloc(1, sizeof(*header));
+	bin = calloc(1, sizeof(*bin));
+	smart = calloc(1, sizeof(*smart));
+	if (!header || !bin || !smart)
+		return -ENOMEM;
+
+	while ((n = fread(magic, 1, sizeof(magic), in))) {
+		if (n != sizeof(magic))
+			goto truncated;
+
+		if (!memcmp(magic, VT_BIN_MAGIC, sizeof(magic))) {
+			if (fread(bin->path, sizeof(*bin) - sizeof(magic), 1, in) != 1)
+				goto truncated;
+			bin->path[sizeof(bin->path) - 1] = '\0';
+			bin->test_name[sizeof(bin->test_name) - 1] = '\0';
+
+			vt_initialize_header_buffer(header);
+			strcpy(header->path, bin->path);
+			strcpy(header->test_name, bin->test_name);
+			header->time_stamp = le64_to_cpu(bin->time_stamp);
+			header->raw_ctrl = bin->raw_ctrl;
+			header->raw_fw = bin->raw_fw;
+			if (vt_append_header(header, out))
+				return -EIO;
+
+			strcpy(smart->path, bin->path);
+			smart->raw_ns = bin->raw_ns;
+			smart->raw_ctrl = bin->raw_ctrl;
+			have_header = true;
+			continue;
+		}
+
+		if (!have_header) {
+			printf("Not a binary vtView log\n");
+			return -EINVAL;
+		}
+
+		memcpy(&rec, magic, sizeof(magic));
+		if (fread((char *)&rec + sizeof(magic), sizeof(rec) - sizeof(magic), 1, in) != 1)
+			goto truncated;
+
+		smart->time_stamp = le64_to_cpu(rec.time_stamp);
+		smart->raw_smart = rec.raw_smart;
+		if (vt_append_log(smart, out))
+			return -EIO;
+	}
+
+	if (ferror(in))
+		goto read_err;
+	if (!have_header) {
+		printf("Not a binary vtView log\n");
+		return -EINVAL;
+	}
+
+	return 0;
+
+truncated:
+	if (ferror(in))
+		goto read_err;
+	printf("Truncated binary vtView log\n");
+	return -EINVAL;
+read_err:
+	printf("Cannot read log file: %s\n", strerror(errno));
+	return -EIO;
+}
+
 static void vt_build_identify_lv2(unsigned int data, unsigned int start,
 				  unsigned int count, const char **table,
 				  bool isEnd)
@@ -916,6 +1102,56 @@ static void vt_parse_detail_identify(const struct nvme_id_ctrl *ctrl)
 	printf("\"}\n");
 }
 
+static int vt_open_log(const char *filename, const struct vtview_save_log_settings *cfg,
+		       struct vtview_log_out *out)
+{
+	memset(out, 0, sizeof(*out));
+	out->fd = -1;
+
+	if (!cfg->binary) {
+		out->text = fopen(filename, "a");
+		if (!out->text) {
+			printf("Cannot open %s\n", filename);
+			return -1;
+		}
+		return 0;
+	}
+
+	out->batch = cfg->batch ? cfg->batch : 1;
+	out->recs = calloc(out->batch, sizeof(*out->recs));
+	if (!out->recs)
+		return -1;
+
+	out->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (out->fd < 0) {
+		printf("Cannot open %s\n", filename);
+		free(out->recs);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* write out the pending records and close, returns -1 if any got lost */
+static int vt_close_log(struct vtview_log_out *out)
+{
+	int ret = 0;
+
+	if (out->text) {
+		if (fclose(out->text))
+			ret = -1;
+		return ret;
+	}
+
+	if (out->nr_recs)
+		ret = vt_flush_bin_log(out);
+	if (close(out->fd))
+		ret = -1;
+	free(out->recs);
+
+	return ret;
+}
+
 static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	int ret, err = 0;
@@ -939,6 +1175,10 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 	const char *freq = "(optional) How often you want to log SMART data (0.25 = 15' , 0.5 = 30' , 1 = 1 hour, 2 = 2 hours, etc.). Default = 10 hours.";
 	const char *output_file = "(optional) Name of the log file (give it a name that easy for you to remember what the test is). You can leave it blank too, we will take care it for you.";
 	const char *test_name = "(optional) Name of the test you are doing. We use this as part of the name of the log file.";
+	const char *binary = "(optional) Save compact binary records, convert them with convert-vtview-log.";
+	const char *batch = "(optional) Binary records to collect before writing them out (default = 16).";
+	struct vtview_log_out out;
+	const char *filename;
 	struct nvme_dev *dev;
 
 	struct vtview_save_log_settings cfg = {
@@ -946,6 +1186,8 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 		.log_record_frequency_hrs = 10,
 		.output_file = NULL,
 		.test_name = NULL,
+		.binary = false,
+		.batch = DEFAULT_BATCH,
 	};
 
 	OPT_ARGS(opts) = {
@@ -953,11 +1195,11 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 		OPT_DOUBLE("freq",      'f', &cfg.log_record_frequency_hrs, freq),
 		OPT_FILE("output-file", 'o', &cfg.output_file,              output_file),
 		OPT_STRING("test-name", 'n', "NAME", &cfg.test_name,        test_name),
+		OPT_FLAG("binary",      'b', &cfg.binary,                   binary),
+		OPT_UINT("batch",       'B', &cfg.batch,                    batch),
 		OPT_END()
 	};
 
-	vt_generate_vtview_log_file_name(vt_default_log_file_name);
-
 	if (argc >= 2) {
 		if (strlen(argv[1]) > sizeof(path) - 1) {
 			printf("Filename too long\n");
@@ -977,9 +1219,24 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 	printf("Running for %lf hour(s)\n", cfg.run_time_hrs);
 	printf("Logging SMART data for every %lf hour(s)\n", cfg.log_record_frequency_hrs);
 
-	ret = vt_update_vtview_log_header(dev_fd(dev), path, &cfg);
+	if (!cfg.output_file) {
+		vt_generate_vtview_log_file_name(vt_default_log_file_name,
+						 cfg.binary ? ".bin" : ".txt");
+		filename = vt_default_log_file_name;
+	} else {
+		filename = cfg.output_file;
+	}
+
+	printf("Log file: %s\n", filename);
+	if (vt_open_log(filename, &cfg, &out)) {
+		dev_close(dev);
+		return EINVAL;
+	}
+
+	ret = vt_update_vtview_log_header(dev_fd(dev), path, &cfg, &out);
 	if (ret) {
 		err = EINVAL;
+		vt_close_log(&out);
 		dev_close(dev);
 		return err;
 	}
@@ -995,12 +1252,15 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 
 	fflush(stdout);
 
-	while (1) {
+	/* an interrupted run still writes out the binary records it holds */
+	nvme_stop_catch(true, NULL);
+
+	while (!nvme_stopped()) {
 		cur_time = time(NULL);
 		if (cur_time >= end_time)
 			break;
 
-		ret = vt_add_entry_to_log(dev_fd(dev), path, &cfg);
+		ret = vt_add_entry_to_log(dev_fd(dev), path, &out);
 		if (ret) {
 			printf("Cannot update driver log\n");
 			break;
@@ -1012,10 +1272,77 @@ static int vt_save_smart_to_vtview_log(int argc, char **argv, struct command *cm
 		fflush(stdout);
 	}
 
+	nvme_stop_release();
+
+	if (vt_close_log(&out)) {
+		printf("Cannot write log file %s\n", filename);
+		err = EIO;
+	}
+
 	dev_close(dev);
 	return err;
 }
 
+static int vt_convert_vtview_log(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Convert a binary log of save-smart-to-vtview-log --binary to the vtView text format.";
+	const char *input_file = "Binary log file to convert.";
+	const char *output_file = "(optional) Text log file to append to. Defaults to stdout.";
+	FILE *in, *out = stdout;
+	int err;
+
+	struct config {
+		const char *input_file;
+		const char *output_file;
+	};
+
+	struct config cfg = {
+		.input_file = NULL,
+		.output_file = NULL,
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_FILE("input-file",  'i', &cfg.input_file,  input_file),
+		OPT_FILE("output-file", 'o', &cfg.output_file, output_file),
+		OPT_END()
+	};
+
+	err = argconfig_parse(argc, argv, desc, opts);
+	if (err)
+		return err;
+
+	if (!cfg.input_file) {
+		printf("An input file is required\n");
+		return -EINVAL;
+	}
+
+	in = fopen(cfg.input_file, "r");
+	if (!in) {
+		printf("Cannot open %s\n", cfg.input_file);
+		return -errno;
+	}
+
+	if (cfg.output_file) {
+		out = fopen(cfg.output_file, "a");
+		if (!out) {
+			err = -errno;
+			printf("Cannot open %s\n", cfg.output_file);
+			fclose(in);
+			return err;
+		}
+	}
+
+	err = vt_convert_bin_log(in, out);
+
+	if (out != stdout && fclose(out) && !err) {
+		printf("Cannot write log file %s\n", cfg.output_file);
+		err = -EIO;
+	}
+	fclose(in);
+
+	return err;
+}
+
 static int vt_show_identify(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	int ret, err = 0;
@@ -13,6 +13,7 @@ PLUGIN(NAME("virtium", "Virtium vendor specific extensions", NVME_VERSION),
             ENTRY("save-smart-to-vtview-log", "Periodically save smart attributes into a log file.\n\
                              The data in this log file can be analyzed using excel or using Virtium’s vtView.\n\
                              Visit vtView.virtium.com to see full potential uses of the data", vt_save_smart_to_vtview_log)
+            ENTRY("convert-vtview-log", "Convert a binary vtView SMART log into the text format", vt_convert_vtview_log)
             ENTRY("show-identify", "Shows detail features and current settings", vt_show_identify)
 	)
 );
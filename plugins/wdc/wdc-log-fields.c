@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "nvme.h"
+#include "nvme-print.h"
+#include "util/json.h"
+#include "util/types.h"
+
+#include "wdc-log-fields.h"
+
+static __u64 field_uint(const __u8 *p, int width)
+{
+	__u64 v = 0;
+
+	while (width--)
+		v = v << 8 | p[width];
+	return v;
+}
+
+static __u64 field_value(const struct wdc_log_field *f, const __u8 *data)
+{
+	__u64 v = field_uint(data + f->offset, f->width);
+
+	return f->mask ? v & f->mask : v;
+}
+
+static void field_key(char *key, size_t size, const struct wdc_log_field *f,
+		      const char *suffix)
+{
+	snprintf(key, size, "%s%s", f->json ?: f->name, suffix);
+}
+
+static void print_row(const struct wdc_log_layout *l, const char *label,
+		      const char *suffix, const char *value)
+{
+	char name[128];
+
+	snprintf(name, sizeof(name), "%s%s", label, suffix);
+	printf("  %-*s%s%*s\n", l->label_width, name, l->sep, l->value_width, value);
+}
+
+static void print_field_normal(const struct wdc_log_layout *l,
+			       const struct wdc_log_field *f, const __u8 *data)
+{
+	const __u8 *p = data + f->offset;
+	char value[64];
+	__u64 v;
+
+	switch (f->type) {
+	case WDC_FIELD_UINT128:
+		print_row(l, f->name, "", uint128_t_to_string(le128_to_cpu((__u8 *)p)));
+		break;
+	case WDC_FIELD_HI_LO:
+		snprintf(value, sizeof(value), "%*"PRIu64"%*"PRIu64, l->value_width,
+			 (uint64_t)field_uint(p + 8, 8), l->value_width,
+			 (uint64_t)field_uint(p, 8));
+		printf("  %-*s%s%s\n", l->label_width, f->name, l->sep, value);
+		break;
+	case WDC_FIELD_NORM_RAW:
+		v = field_value(f, data);
+		snprintf(value, sizeof(value), "%"PRIu64, (uint64_t)(v & 0xFFFF));
+		print_row(l, f->name, " (Normalized)", value);
+		snprintf(value, sizeof(value), "%"PRIu64, (uint64_t)(v >> 16));
+		print_row(l, f->name, " (Raw)", value);
+		break;
+	case WDC_FIELD_GUID:
+		snprintf(value, sizeof(value), "0x%"PRIx64"%"PRIx64,
+			 (uint64_t)field_uint(p + 8, 8), (uint64_t)field_uint(p, 8));
+		print_row(l, f->name, "", value);
+		break;
+	default:
+		v = field_value(f, data);
+		snprintf(value, sizeof(value), f->flags & WDC_FIELD_HEX ?
+			 "0x%"PRIx64 : "%"PRIu64, (uint64_t)v);
+		if (f->flags & WDC_FIELD_PERCENT) {
+			/* the sign goes past the value column */
+			printf("  %-*s%s%*s%%\n", l->label_width, f->name, l->sep,
+			       l->value_width, value);
+			break;
+		}
+		print_row(l, f->name, "", value);
+	}
+}
+
+static void add_field_json(struct json_object *root, const struct wdc_log_field *f,
+			   const __u8 *data)
+{
+	const __u8 *p = data + f->offset;
+	char key[128], guid[40];
+	__u64 v;
+
+	switch (f->type) {
+	case WDC_FIELD_UINT128:
+		field_key(key, sizeof(key), f, "");
+		json_object_add_value_uint128(root, key, le128_to_cpu((__u8 *)p));
+		break;
+	case WDC_FIELD_HI_LO:
+		field_key(key, sizeof(key), f, " Hi");
+		json_object_add_value_uint64(root, key, field_uint(p + 8, 8));
+		field_key(key, sizeof(key), f, " Lo");
+		json_object_add_value_uint64(root, key, field_uint(p, 8));
+		break;
+	case WDC_FIELD_NORM_RAW:
+		v = field_value(f, data);
+		field_key(key, sizeof(key), f, " (Normalized)");
+		json_object_add_value_uint64(root, key, v & 0xFFFF);
+		field_key(key, sizeof(key), f, " (Raw)");
+		json_object_add_value_uint64(root, key, v >> 16);
+		break;
+	case WDC_FIELD_GUID:
+		snprintf(guid, sizeof(guid), "0x%"PRIx64"%"PRIx64,
+			 (uint64_t)field_uint(p + 8, 8), (uint64_t)field_uint(p, 8));
+		field_key(key, sizeof(key), f, "");
+		json_object_add_value_string(root, key, guid);
+		break;
+	default:
+		field_key(key, sizeof(key), f, "");
+		json_object_add_value_uint64(root, key, field_value(f, data));
+	}
+}
+
+void wdc_print_log_fields(const struct wdc_log_layout *l, const void *data, int fmt)
+{
+	struct json_object *root = NULL;
+	int version = -1, i;
+
+	if (fmt == BINARY) {
+		d_raw((unsigned char *)data, l->len);
+		return;
+	}
+
+	if (l->version_offset >= 0)
+		version = field_uint((const __u8 *)data + l->version_offset, 2);
+
+	if (fmt == JSON)
+		root = json_create_object();
+	else if (l->title)
+		printf("  %s :-\n", l->title);
+
+	for (i = 0; i < l->nr_fields; i++) {
+		const struct wdc_log_field *f = &l->fields[i];
+
+		if (f->min_version && version < f->min_version)
+			continue;
+		if (root)
+			add_field_json(root, f, data);
+		else
+			print_field_normal(l, f, data);
+	}
+
+	if (root) {
+		json_print_object(root, NULL);
+		printf("\n");
+		json_free_object(root);
+	}
+}
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __WDC_LOG_FIELDS_H__
+#define __WDC_LOG_FIELDS_H__
+
+#include <stddef.h>
+#include "linux/types.h"
+
+/*
+ * Table driven decoding of the flat vendor log pages. A page is a constant
+ * array of field descriptors, the same table renders the normal and the
+ * JSON output, so a page variant is a new table instead of new printers.
+ */
+enum wdc_field_type {
+	WDC_FIELD_UINT,		/* little endian integer of 1 to 8 bytes */
+	WDC_FIELD_UINT128,	/* little endian 16 bytes integer */
+	WDC_FIELD_HI_LO,	/* 128 bits as a low and a high 8 bytes half */
+	WDC_FIELD_NORM_RAW,	/* normalized value in bits 0-15, raw value above */
+	WDC_FIELD_GUID,		/* 16 bytes printed as a hex number */
+};
+
+/* only changes the normal output */
+#define WDC_FIELD_PERCENT	(1 << 0)
+#define WDC_FIELD_HEX		(1 << 1)
+
+struct wdc_log_field {
+	const char *name;	/* label of the normal output */
+	const char *json;	/* JSON member, the label if NULL */
+	__u16 offset;
+	__u8 width;
+	__u8 type;
+	__u8 flags;
+	__u8 min_version;	/* lowest page version having the field */
+	__u64 mask;		/* of the value, all bits if 0 */
+};
+
+#define WDC_FIELD(_type, _member, _kind, _name, _json)				\
+	{ .name = _name, .json = _json, .offset = offsetof(_type, _member),	\
+	  .width = sizeof(((_type *)0)->_member), .type = _kind }
+
+#define WDC_FIELD_AT(_offset, _width, _kind, _name, _json)			\
+	{ .name = _name, .json = _json, .offset = _offset, .width = _width,	\
+	  .type = _kind }
+
+struct wdc_log_layout {
+	const char *title;	/* heading of the normal output */
+	const struct wdc_log_field *fields;
+	int nr_fields;
+	int label_width;
+	int value_width;
+	const char *sep;	/* between the label and the value */
+	__u32 len;		/* of the page, for the binary output */
+	int version_offset;	/* of the le16 page version, -1 if none */
+};
+
+/*
+ * wdc_print_log_fields - render @data as described by @l
+ * @fmt: NORMAL, JSON or BINARY, the raw page
+ */
+void wdc_print_log_fields(const struct wdc_log_layout *l, const void *data, int fmt);
+
+#endif /* __WDC_LOG_FIELDS_H__ */
@@ -33,16 +33,21 @@
 
 #include "common.h"
 #include "nvme.h"
+#include "nvme-wrap.h"
 #include "libnvme.h"
 #include "plugin.h"
 #include "linux/types.h"
 #include "util/cleanup.h"
+#include "util/stream.h"
+#include "util/tar.h"
+#include "util/thread-pool.h"
 #include "util/types.h"
 #include "nvme-print.h"
 
 #define CREATE_CMD
 #include "wdc-nvme.h"
 #include "wdc-utils.h"
+#include "wdc-log-fields.h"
 
 #define WRITE_SIZE	(sizeof(__u8) * 4096)
 
@@ -264,6 +269,8 @@
 #define WDC_NVME_DUI_MAX_SECTION_V3			0x23
 #define WDC_NVME_DUI_MAX_DATA_AREA			0x05
 #define WDC_NVME_SN730_SECTOR_SIZE			512
+#define WDC_NVME_DUI_DEF_XFER_SIZE			0x10000
+#define WDC_NVME_DUI_MAX_XFER_SIZE			0x100000
 
 /* Telemtery types for vs-internal-log command */
 #define WDC_TELEMETRY_TYPE_NONE				0x0
@@ -974,7 +981,8 @@ static int wdc_purge_monitor(int argc, char **argv, struct command *command, str
 static bool wdc_nvme_check_supported_log_page(nvme_root_t r, struct nvme_dev *dev, __u8 log_id);
 static int wdc_clear_pcie_correctable_errors(int argc, char **argv, struct command *command,
 					     struct plugin *plugin);
-static int wdc_do_drive_essentials(nvme_root_t r, struct nvme_dev *dev, char *dir, char *key);
+static int wdc_do_drive_essentials(nvme_root_t r, struct nvme_dev *dev, char *dir, char *key,
+				   bool stream, unsigned int jobs);
 static int wdc_drive_essentials(int argc, char **argv, struct command *command,
 				struct plugin *plugin);
 static int wdc_drive_status(int argc, char **argv, struct command *command, struct plugin *plugin);
@@ -1464,8 +1472,85 @@ static double calc_percent(uint64_t numerator, uint64_t denominator)
 		(uint64_t)(((double)numerator / (double)denominator) * 100) : 0;
 }
 
-static int wdc_get_pci_ids(nvme_root_t r, struct nvme_dev *dev,
-			   uint32_t *device_id, uint32_t *vendor_id)
+/*
+ * Identification of the device a command runs on, read once per run, or
+ * again once a command changed the identify data, see
+ * nvme_cli_id_cache_gen(), and shared by the device checks of all
+ * commands. The PCI IDs and the drive
+ * capabilities are also kept in the identify cache, see NVME_ID_CACHE in
+ * nvme(1), the identify data goes through it anyway.
+ */
+#define WDC_DEV_CACHE_NAME	"wdc-dev"
+
+struct wdc_dev_cache {
+	__u32 version;
+	__s32 pci_ret;
+	__u32 device_id;
+	__u32 vendor_id;
+	__u64 capabilities;
+};
+
+struct wdc_dev_ctx {
+	char name[256];
+	unsigned int gen;	/* of the identify data it was read with */
+	bool pci_read;
+	int pci_ret;
+	uint32_t device_id;
+	uint32_t vendor_id;
+	bool id_read;
+	int id_ret;
+	struct nvme_id_ctrl ctrl;
+	bool caps_read;
+	__u64 capabilities;
+};
+
+static struct wdc_dev_ctx wdc_dev_ctx;
+
+static struct wdc_dev_ctx *wdc_get_dev_ctx(struct nvme_dev *dev)
+{
+	struct wdc_dev_ctx *ctx = &wdc_dev_ctx;
+	struct wdc_dev_cache cache;
+
+	if (!strcmp(ctx->name, dev->name) && ctx->gen == nvme_cli_id_cache_gen())
+		return ctx;
+
+	memset(ctx, 0, sizeof(*ctx));
+	snprintf(ctx->name, sizeof(ctx->name), "%s", dev->name);
+	ctx->gen = nvme_cli_id_cache_gen();
+
+	if (nvme_cli_id_cache_lookup(dev, WDC_DEV_CACHE_NAME, &cache, sizeof(cache)) &&
+	    cache.version == 1) {
+		ctx->pci_read = true;
+		ctx->pci_ret = cache.pci_ret;
+		ctx->device_id = cache.device_id;
+		ctx->vendor_id = cache.vendor_id;
+		ctx->caps_read = true;
+		ctx->capabilities = cache.capabilities;
+	}
+
+	return ctx;
+}
+
+/*
+ * Identify Controller data of @dev, only the first call of a run issues
+ * the command.
+ */
+static int wdc_identify_ctrl(struct nvme_dev *dev, struct nvme_id_ctrl *ctrl)
+{
+	struct wdc_dev_ctx *ctx = wdc_get_dev_ctx(dev);
+
+	if (!ctx->id_read) {
+		ctx->id_ret = nvme_cli_identify_ctrl(dev, &ctx->ctrl);
+		ctx->id_read = true;
+	}
+	if (!ctx->id_ret)
+		memcpy(ctrl, &ctx->ctrl, sizeof(*ctrl));
+
+	return ctx->id_ret;
+}
+
+static int wdc_read_pci_ids(nvme_root_t r, struct nvme_dev *dev,
+			    uint32_t *device_id, uint32_t *vendor_id)
 {
 	char vid[256], did[256], id[32];
 	nvme_ctrl_t c = NULL;
@@ -1534,13 +1619,29 @@ static int wdc_get_pci_ids(nvme_root_t r, struct nvme_dev *dev,
 	return 0;
 }
 
+static int wdc_get_pci_ids(nvme_root_t r, struct nvme_dev *dev,
+			   uint32_t *device_id, uint32_t *vendor_id)
+{
+	struct wdc_dev_ctx *ctx = wdc_get_dev_ctx(dev);
+
+	if (!ctx->pci_read) {
+		ctx->device_id = *device_id;
+		ctx->vendor_id = *vendor_id;
+		ctx->pci_ret = wdc_read_pci_ids(r, dev, &ctx->device_id, &ctx->vendor_id);
+		ctx->pci_read = true;
+	}
+	*device_id = ctx->device_id;
+	*vendor_id = ctx->vendor_id;
+	return ctx->pci_ret;
+}
+
 static int wdc_get_vendor_id(struct nvme_dev *dev, uint32_t *vendor_id)
 {
 	int ret;
 	struct nvme_id_ctrl ctrl;
 
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -1616,7 +1717,7 @@ static int wdc_get_model_number(struct nvme_dev *dev, char *model)
 	struct nvme_id_ctrl ctrl;
 
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -1679,7 +1780,7 @@ static bool wdc_enc_check_model(struct nvme_dev *dev)
 	return supported;
 }
 
-static __u64 wdc_get_drive_capabilities(nvme_root_t r, struct nvme_dev *dev)
+static __u64 wdc_read_drive_capabilities(nvme_root_t r, struct nvme_dev *dev)
 {
 	int ret;
 	uint32_t read_device_id = -1, read_vendor_id = -1;
@@ -2022,6 +2123,31 @@ static __u64 wdc_get_drive_capabilities(nvme_root_t r, struct nvme_dev *dev)
 	return capabilities;
 }
 
+static __u64 wdc_get_drive_capabilities(nvme_root_t r, struct nvme_dev *dev)
+{
+	struct wdc_dev_ctx *ctx = wdc_get_dev_ctx(dev);
+	struct wdc_dev_cache cache;
+
+	if (ctx->caps_read)
+		return ctx->capabilities;
+
+	ctx->capabilities = wdc_read_drive_capabilities(r, dev);
+	ctx->caps_read = true;
+
+	/* failures to read the customer ID return all bits set */
+	if (ctx->pci_read && ctx->capabilities != (__u64)-1) {
+		memset(&cache, 0, sizeof(cache));
+		cache.version = 1;
+		cache.pci_ret = ctx->pci_ret;
+		cache.device_id = ctx->device_id;
+		cache.vendor_id = ctx->vendor_id;
+		cache.capabilities = ctx->capabilities;
+		nvme_cli_id_cache_store(dev, WDC_DEV_CACHE_NAME, &cache, sizeof(cache));
+	}
+
+	return ctx->capabilities;
+}
+
 static __u64 wdc_get_enc_drive_capabilities(nvme_root_t r,
 					    struct nvme_dev *dev)
 {
@@ -2105,7 +2231,7 @@ static int wdc_get_serial_name(struct nvme_dev *dev, char *file, size_t len,
 	strncpy(orig, file, PATH_MAX - 1);
 	memset(file, 0, len);
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -2461,14 +2587,28 @@ static bool get_dev_mgment_cbs_data(nvme_root_t r, struct nvme_dev *dev,
 	return found;
 }
 
+#define WDC_C2_LIDS_CACHE_NAME "wdc-c2-lids"
+
 static bool wdc_nvme_check_supported_log_page(nvme_root_t r, struct nvme_dev *dev, __u8 log_id)
 {
 	int i;
 	bool found = false;
 	struct wdc_c2_cbs_data *cbs_data = NULL;
+	__u8 *lids;
+	size_t len;
+
+	/* the supported pages of the C2 log as read for the model before */
+	lids = nvme_cli_log_cache_lookup(dev, WDC_C2_LIDS_CACHE_NAME, &len);
+	if (lids) {
+		found = memchr(lids, log_id, len);
+		free(lids);
+		return found;
+	}
 
 	if (get_dev_mgment_cbs_data(r, dev, WDC_C2_LOG_PAGES_SUPPORTED_ID, (void *)&cbs_data)) {
 		if (cbs_data) {
+			nvme_cli_log_cache_store(dev, WDC_C2_LIDS_CACHE_NAME, cbs_data->data,
+						 le32_to_cpu(cbs_data->length));
 			for (i = 0; i < le32_to_cpu(cbs_data->length); i++) {
 				if (log_id == cbs_data->data[i]) {
 					found = true;
@@ -2790,7 +2930,7 @@ static int wdc_do_cap_telemetry_log(struct nvme_dev *dev, char *file,
 	nvme_root_t r;
 
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	err = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	err = wdc_identify_ctrl(dev, &ctrl);
 	if (err) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", err);
 		return err;
@@ -2957,17 +3097,105 @@ out:
 	return ret;
 }
 
+/*
+ * Without a requested size the DUI data is fetched in chunks of MDTS,
+ * bounded so the pair of buffers stays small.
+ */
+static __u32 wdc_dui_xfer_size(struct nvme_dev *dev)
+{
+	_cleanup_free_ struct nvme_id_ctrl *ctrl = NULL;
+	__u32 xfer_size = WDC_NVME_DUI_MAX_XFER_SIZE;
+
+	ctrl = nvme_alloc(sizeof(*ctrl));
+	if (!ctrl || wdc_identify_ctrl(dev, ctrl))
+		return WDC_NVME_DUI_DEF_XFER_SIZE;
+
+	if (ctrl->mdts && ctrl->mdts < 31 &&
+	    (1ULL << ctrl->mdts) * getpagesize() < xfer_size)
+		xfer_size = (1 << ctrl->mdts) * getpagesize();
+
+	return xfer_size;
+}
+
+/*
+ * Fetch @log_size bytes of DUI data starting at @offset in @xfer_size
+ * chunks into a pair of buffers, a helper thread writes each chunk to
+ * @output while the next one is in flight.
+ */
+static int wdc_dui_transfer(int fd, int output, __u64 offset, __u64 log_size,
+			    __u32 xfer_size, bool v2)
+{
+	bool progress = isatty(STDERR_FILENO);
+	struct nvme_stream s;
+	__u64 done = 0, start_ns, us;
+	size_t len;
+	void *buf;
+	int ret = 0, err, i = 0;
+
+	err = nvme_stream_init(&s, output, NVME_STREAM_TO_FILE, log_size, xfer_size, 2);
+	if (err) {
+		fprintf(stderr, "%s: ERROR: WDC: DUI buffers allocation failed : %s, size = 0x%x\n",
+			__func__, strerror(-err), xfer_size);
+		return -1;
+	}
+
+	start_ns = monotonic_ns();
+	while ((buf = nvme_stream_get(&s, &len))) {
+		/* the last chunk re-enables the host I/O */
+		bool last_xfer = done + len >= log_size;
+
+		if (v2)
+			ret = wdc_dump_dui_data_v2(fd, len, offset + done, buf, last_xfer);
+		else
+			ret = wdc_dump_dui_data(fd, len, offset + done, buf, last_xfer);
+		if (ret) {
+			fprintf(stderr,
+				"%s: ERROR: WDC: Get chunk %d, size = 0x%zx, offset = 0x%"PRIx64"\n",
+				__func__, i, len, (uint64_t)(offset + done));
+			fprintf(stderr, "%s: ERROR: WDC: ", __func__);
+			nvme_show_status(ret);
+			break;
+		}
+
+		nvme_stream_put(&s, len);
+		done += len;
+		i++;
+
+		if (progress) {
+			us = (monotonic_ns() - start_ns) / NSEC_PER_USEC;
+			fprintf(stderr, "\rINFO: WDC: DUI data 0x%"PRIx64" of 0x%"PRIx64" bytes (%3u%%), %.1f MiB/s",
+				(uint64_t)done, (uint64_t)log_size,
+				(unsigned int)(done * 100 / log_size),
+				us ? (double)done / us * 1000000 / (1024 * 1024) : 0.0);
+		}
+	}
+
+	err = nvme_stream_finish(&s, ret != 0);
+	if (progress && i)
+		fprintf(stderr, "\n");
+	if (!ret && err) {
+		fprintf(stderr, "%s: ERROR: WDC: Failed to flush DUI data to file! chunk %d: %s\n",
+			__func__, i, strerror(-err));
+		ret = -1;
+	}
+
+	if (!ret) {
+		us = (monotonic_ns() - start_ns) / NSEC_PER_USEC;
+		fprintf(stderr, "INFO: WDC: DUI data 0x%"PRIx64" bytes in %llu.%03llu s (%.1f MiB/s)\n",
+			(uint64_t)log_size, (unsigned long long)(us / 1000000),
+			(unsigned long long)(us / 1000 % 1000),
+			us ? (double)log_size / us * 1000000 / (1024 * 1024) : 0.0);
+	}
+
+	return ret;
+}
+
 static int wdc_do_cap_dui_v1(int fd, char *file, __u32 xfer_size, int data_area, int verbose,
 			     struct wdc_dui_log_hdr *log_hdr, __s64 *total_size)
 {
 	__s32 log_size = 0;
 	__u32 cap_dui_length = le32_to_cpu(log_hdr->log_size);
-	__u32 curr_data_offset = 0;
-	__u8 *buffer_addr;
-	__u8 *dump_data = NULL;
-	bool last_xfer = false;
 	int err;
-	int i;
 	int j;
 	int output;
 	int ret = 0;
@@ -3003,19 +3231,10 @@ static int wdc_do_cap_dui_v1(int fd, char *file, __u32 xfer_size, int data_area,
 
 	*total_size = log_size;
 
-	dump_data = (__u8 *)malloc(sizeof(__u8) * xfer_size);
-	if (!dump_data) {
-		fprintf(stderr, "%s: ERROR: dump data V1 malloc failed : status %s, size = 0x%x\n",
-			__func__, strerror(errno), (unsigned int)xfer_size);
-		return -1;
-	}
-	memset(dump_data, 0, sizeof(__u8) * xfer_size);
-
 	output = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 	if (output < 0) {
 		fprintf(stderr, "%s: Failed to open output file %s: %s!\n", __func__, file,
 			strerror(errno));
-		free(dump_data);
 		return output;
 	}
 
@@ -3023,47 +3242,17 @@ static int wdc_do_cap_dui_v1(int fd, char *file, __u32 xfer_size, int data_area,
 	err = write(output, (void *)log_hdr, WDC_NVME_CAP_DUI_HEADER_SIZE);
 	if (err != WDC_NVME_CAP_DUI_HEADER_SIZE) {
 		fprintf(stderr, "%s: Failed to flush header data to file!\n", __func__);
+		ret = -1;
 		goto free_mem;
 	}
 
 	log_size -= WDC_NVME_CAP_DUI_HEADER_SIZE;
-	curr_data_offset = WDC_NVME_CAP_DUI_HEADER_SIZE;
-	i = 0;
-	buffer_addr = dump_data;
-
-	for (; log_size > 0; log_size -= xfer_size) {
-		xfer_size = min(xfer_size, log_size);
-
-		if (log_size <= xfer_size)
-			last_xfer = true;
-
-		ret = wdc_dump_dui_data(fd, xfer_size, curr_data_offset, buffer_addr, last_xfer);
-		if (ret) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Get chunk %d, size = 0x%"PRIx64", offset = 0x%x, addr = %p\n",
-				__func__, i, (uint64_t)log_size, curr_data_offset, buffer_addr);
-			fprintf(stderr, "%s: ERROR: WDC: ", __func__);
-			nvme_show_status(ret);
-			break;
-		}
-
-		/* write the dump data into the file */
-		err = write(output, (void *)buffer_addr, xfer_size);
-		if (err != xfer_size) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Failed to flush DUI data to file! chunk %d, err = 0x%x, xfer_size = 0x%x\n",
-				__func__, i, err, xfer_size);
-			ret = -1;
-			goto free_mem;
-		}
-
-		curr_data_offset += xfer_size;
-		i++;
-	}
+	if (log_size > 0)
+		ret = wdc_dui_transfer(fd, output, WDC_NVME_CAP_DUI_HEADER_SIZE, log_size,
+				       xfer_size, false);
 
 free_mem:
 	close(output);
-	free(dump_data);
 	return ret;
 }
 
@@ -3074,12 +3263,6 @@ static int wdc_do_cap_dui_v2_v3(int fd, char *file, __u32 xfer_size, int data_ar
 	__u64 cap_dui_length_v3;
 	__u64 curr_data_offset = 0;
 	__s64 log_size = 0;
-	__u64 xfer_size_long = (__u64)xfer_size;
-	__u8 *buffer_addr;
-	__u8 *dump_data = NULL;
-	bool last_xfer = false;
-	int err;
-	int i;
 	int j;
 	int output;
 	int ret = 0;
@@ -3136,20 +3319,10 @@ static int wdc_do_cap_dui_v2_v3(int fd, char *file, __u32 xfer_size, int data_ar
 		return -1;
 	}
 
-	dump_data = (__u8 *)malloc(sizeof(__u8) * xfer_size_long);
-	if (!dump_data) {
-		fprintf(stderr,
-			"%s: ERROR: dump data v3 malloc failed : status %s, size = 0x%"PRIx64"\n",
-			__func__, strerror(errno), (uint64_t)xfer_size_long);
-		return -1;
-	}
-	memset(dump_data, 0, sizeof(__u8) * xfer_size_long);
-
 	output = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 	if (output < 0) {
 		fprintf(stderr, "%s: Failed to open output file %s: %s!\n",
 				__func__, file, strerror(errno));
-		free(dump_data);
 		return output;
 	}
 
@@ -3171,44 +3344,9 @@ static int wdc_do_cap_dui_v2_v3(int fd, char *file, __u32 xfer_size, int data_ar
 		curr_data_offset = offset;
 	}
 
-	i = 0;
-	buffer_addr = dump_data;
-
-	for (; log_size > 0; log_size -= xfer_size_long) {
-		xfer_size_long = min(xfer_size_long, log_size);
-
-		if (log_size <= xfer_size_long)
-			last_xfer = true;
-
-		ret = wdc_dump_dui_data_v2(fd, (__u32)xfer_size_long, curr_data_offset, buffer_addr,
-					   last_xfer);
-		if (ret) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Get chunk %d, size = 0x%"PRIx64", offset = 0x%"PRIx64", addr = %p\n",
-				__func__, i, (uint64_t)*total_size, (uint64_t)curr_data_offset,
-				buffer_addr);
-			fprintf(stderr, "%s: ERROR: WDC: ", __func__);
-			nvme_show_status(ret);
-			break;
-		}
-
-		/* write the dump data into the file */
-		err = write(output, (void *)buffer_addr, xfer_size_long);
-		if (err != xfer_size_long) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Failed to flush DUI data to file! chunk %d, err = 0x%x, xfer_size = 0x%"PRIx64"\n",
-				__func__, i, err, (uint64_t)xfer_size_long);
-			ret = -1;
-			goto free_mem;
-		}
-
-		curr_data_offset += xfer_size_long;
-		i++;
-	}
+	ret = wdc_dui_transfer(fd, output, curr_data_offset, log_size, xfer_size, true);
 
-free_mem:
 	close(output);
-	free(dump_data);
 	return ret;
 }
 
@@ -3218,17 +3356,11 @@ static int wdc_do_cap_dui_v4(int fd, char *file, __u32 xfer_size, int data_area,
 {
 	__s64 log_size = 0;
 	__s64 section_size_bytes = 0;
-	__s64 xfer_size_long = (__s64)xfer_size;
 	__u64 cap_dui_length_v4;
 	__u64 curr_data_offset = 0;
-	__u8 *buffer_addr;
-	__u8 *dump_data = NULL;
-	int err;
-	int i;
 	int j;
 	int output;
 	int ret = 0;
-	bool last_xfer = false;
 	struct wdc_dui_log_hdr_v4 *log_hdr_v4 = (struct wdc_dui_log_hdr_v4 *)log_hdr;
 
 	cap_dui_length_v4 = le64_to_cpu(log_hdr_v4->log_size_sectors) * WDC_NVME_SN730_SECTOR_SIZE;
@@ -3278,19 +3410,10 @@ static int wdc_do_cap_dui_v4(int fd, char *file, __u32 xfer_size, int data_area,
 		return -1;
 	}
 
-	dump_data = (__u8 *)malloc(sizeof(__u8) * xfer_size_long);
-	if (!dump_data) {
-		fprintf(stderr, "%s: ERROR: dump data V4 malloc failed : status %s, size = 0x%x\n",
-			__func__, strerror(errno), (unsigned int)xfer_size_long);
-		return -1;
-	}
-	memset(dump_data, 0, sizeof(__u8) * xfer_size_long);
-
 	output = open(file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 	if (output < 0) {
 		fprintf(stderr, "%s: Failed to open output file %s: %s!\n", __func__, file,
 			strerror(errno));
-		free(dump_data);
 		return output;
 	}
 
@@ -3312,43 +3435,9 @@ static int wdc_do_cap_dui_v4(int fd, char *file, __u32 xfer_size, int data_area,
 		curr_data_offset = offset;
 	}
 
-	i = 0;
-	buffer_addr = dump_data;
-
-	for (; log_size > 0; log_size -= xfer_size_long) {
-		xfer_size_long = min(xfer_size_long, log_size);
-
-		if (log_size <= xfer_size_long)
-			last_xfer = true;
-
-		ret = wdc_dump_dui_data_v2(fd, (__u32)xfer_size_long, curr_data_offset, buffer_addr, last_xfer);
-		if (ret) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Get chunk %d, size = 0x%"PRIx64", offset = 0x%"PRIx64", addr = %p\n",
-				__func__, i, (uint64_t)log_size, (uint64_t)curr_data_offset,
-				buffer_addr);
-			fprintf(stderr, "%s: ERROR: WDC:", __func__);
-			nvme_show_status(ret);
-			break;
-		}
-
-		/* write the dump data into the file */
-		err = write(output, (void *)buffer_addr, xfer_size_long);
-		if (err != xfer_size_long) {
-			fprintf(stderr,
-				"%s: ERROR: WDC: Failed to flush DUI data to file! chunk %d, err = 0x%x, xfer_size_long = 0x%"PRIx64"\n",
-				__func__, i, err, (uint64_t)xfer_size_long);
-			ret = -1;
-			goto free_mem;
-		}
-
-		curr_data_offset += xfer_size_long;
-		i++;
-	}
+	ret = wdc_dui_transfer(fd, output, curr_data_offset, log_size, xfer_size, true);
 
-free_mem:
 	close(output);
-	free(dump_data);
 	return ret;
 }
 
@@ -3810,7 +3899,7 @@ static int wdc_vs_internal_fw_log(int argc, char **argv, struct command *command
 {
 	char *desc = "Internal Firmware Log.";
 	char *file = "Output file pathname.";
-	char *size = "Data retrieval transfer size.";
+	char *size = "Data retrieval transfer size, 0 for MDTS on DUI devices and 64k otherwise.";
 	char *data_area = "Data area to retrieve up to. Currently only supported on the SN340, SN640, SN730, and SN840 devices.";
 	char *file_size = "Output file size.  Currently only supported on the SN340 device.";
 	char *offset = "Output file data offset. Currently only supported on the SN340 device.";
@@ -3843,7 +3932,7 @@ static int wdc_vs_internal_fw_log(int argc, char **argv, struct command *command
 
 	struct config cfg = {
 		.file = NULL,
-		.xfer_size = 0x10000,
+		.xfer_size = 0,
 		.data_area = 0,
 		.file_size = 0,
 		.offset = 0,
@@ -3870,12 +3959,8 @@ static int wdc_vs_internal_fw_log(int argc, char **argv, struct command *command
 	if (!wdc_check_device(r, dev))
 		goto out;
 
-	if (cfg.xfer_size) {
-		xfer_size = cfg.xfer_size;
-	} else {
-		fprintf(stderr, "ERROR: WDC: Invalid length\n");
-		goto out;
-	}
+	/* 0 sizes the DUI transfers from MDTS, the other logs keep 64k */
+	xfer_size = cfg.xfer_size ?: WDC_NVME_DUI_DEF_XFER_SIZE;
 
 	ret = wdc_get_pci_ids(r, dev, &device_id, &read_vendor_id);
 
@@ -4035,6 +4120,8 @@ static int wdc_vs_internal_fw_log(int argc, char **argv, struct command *command
 			if (!cfg.data_area)
 				cfg.data_area = 1;
 
+			if (!cfg.xfer_size)
+				xfer_size = wdc_dui_xfer_size(dev);
 			/* FW requirement - xfer size must be 256k for data area 4 */
 			if (cfg.data_area >= 4)
 				xfer_size = 0x40000;
@@ -4055,6 +4142,8 @@ static int wdc_vs_internal_fw_log(int argc, char **argv, struct command *command
 					telemetry_type, telemetry_data_area);
 			goto out;
 		} else {
+			if (!cfg.xfer_size)
+				xfer_size = wdc_dui_xfer_size(dev);
 			ret = wdc_do_cap_dui(dev_fd(dev), f, xfer_size,
 					     WDC_NVME_DUI_MAX_DATA_AREA,
 					     cfg.verbose, 0, 0);
@@ -4662,7 +4751,7 @@ static int wdc_print_latency_monitor_log_normal(struct nvme_dev *dev,
 	struct nvme_id_ctrl ctrl;
 	char ts_buf[128];
 
-	err = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	err = wdc_identify_ctrl(dev, &ctrl);
 	if (!err) {
 		printf("  Serial Number:  %-.*s\n", (int)sizeof(ctrl.sn), ctrl.sn);
 	} else {
@@ -4972,128 +5061,47 @@ static void wdc_print_unsupported_reqs_log_json(struct wdc_ocp_C5_unsupported_re
 	json_free_object(root);
 }
 
-static void wdc_print_fb_ca_log_normal(struct wdc_ssd_ca_perf_stats *perf)
-{
-	uint64_t converted = 0;
-
-	printf("  CA Log Page Performance Statistics :-\n");
-	printf("  NAND Bytes Written                             %20"PRIu64 "%20"PRIu64"\n",
-			le64_to_cpu(perf->nand_bytes_wr_hi), le64_to_cpu(perf->nand_bytes_wr_lo));
-	printf("  NAND Bytes Read                                %20"PRIu64 "%20"PRIu64"\n",
-			le64_to_cpu(perf->nand_bytes_rd_hi), le64_to_cpu(perf->nand_bytes_rd_lo));
-
-	converted = le64_to_cpu(perf->nand_bad_block);
-	printf("  NAND Bad Block Count (Normalized)              %20"PRIu64"\n",
-			converted & 0xFFFF);
-	printf("  NAND Bad Block Count (Raw)                     %20"PRIu64"\n",
-			converted >> 16);
-
-	printf("  Uncorrectable Read Count                       %20"PRIu64"\n",
-			le64_to_cpu(perf->uncorr_read_count));
-	printf("  Soft ECC Error Count                           %20"PRIu64"\n",
-			le64_to_cpu(perf->ecc_error_count));
-	printf("  SSD End to End Detected Correction Count       %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->ssd_detect_count));
-	printf("  SSD End to End Corrected Correction Count      %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->ssd_correct_count));
-	printf("  System Data Percent Used                       %20"PRIu32"%%\n",
-			perf->data_percent_used);
-	printf("  User Data Erase Counts Max                     %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->data_erase_max));
-	printf("  User Data Erase Counts Min                     %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->data_erase_min));
-	printf("  Refresh Count                                  %20"PRIu64"\n",
-			le64_to_cpu(perf->refresh_count));
-
-	converted = le64_to_cpu(perf->program_fail);
-	printf("  Program Fail Count (Normalized)                %20"PRIu64"\n",
-			converted & 0xFFFF);
-	printf("  Program Fail Count (Raw)                       %20"PRIu64"\n",
-			converted >> 16);
-
-	converted = le64_to_cpu(perf->user_erase_fail);
-	printf("  User Data Erase Fail Count (Normalized)        %20"PRIu64"\n",
-			converted & 0xFFFF);
-	printf("  User Data Erase Fail Count (Raw)               %20"PRIu64"\n",
-			converted >> 16);
-
-	converted = le64_to_cpu(perf->system_erase_fail);
-	printf("  System Area Erase Fail Count (Normalized)      %20"PRIu64"\n",
-			converted & 0xFFFF);
-	printf("  System Area Erase Fail Count (Raw)             %20"PRIu64"\n",
-			converted >> 16);
-
-	printf("  Thermal Throttling Status                      %20"PRIu8"\n",
-			perf->thermal_throttle_status);
-	printf("  Thermal Throttling Count                       %20"PRIu8"\n",
-			perf->thermal_throttle_count);
-	printf("  PCIe Correctable Error Count                   %20"PRIu64"\n",
-			le64_to_cpu(perf->pcie_corr_error));
-	printf("  Incomplete Shutdown Count                      %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->incomplete_shutdown_count));
-	printf("  Percent Free Blocks                            %20"PRIu32"%%\n",
-			perf->percent_free_blocks);
-}
-
-static void wdc_print_fb_ca_log_json(struct wdc_ssd_ca_perf_stats *perf)
-{
-	struct json_object *root = json_create_object();
-	uint64_t converted = 0;
-
-	json_object_add_value_int(root, "NAND Bytes Written Hi", le64_to_cpu(perf->nand_bytes_wr_hi));
-	json_object_add_value_int(root, "NAND Bytes Written Lo", le64_to_cpu(perf->nand_bytes_wr_lo));
-	json_object_add_value_int(root, "NAND Bytes Read Hi", le64_to_cpu(perf->nand_bytes_rd_hi));
-	json_object_add_value_int(root, "NAND Bytes Read Lo", le64_to_cpu(perf->nand_bytes_rd_lo));
-
-	converted = le64_to_cpu(perf->nand_bad_block);
-	json_object_add_value_int(root, "NAND Bad Block Count (Normalized)",
-			converted & 0xFFFF);
-	json_object_add_value_int(root, "NAND Bad Block Count (Raw)",
-			converted >> 16);
-
-	json_object_add_value_int(root, "Uncorrectable Read Count", le64_to_cpu(perf->uncorr_read_count));
-	json_object_add_value_int(root, "Soft ECC Error Count",	le64_to_cpu(perf->ecc_error_count));
-	json_object_add_value_int(root, "SSD End to End Detected Correction Count",
-			le32_to_cpu(perf->ssd_detect_count));
-	json_object_add_value_int(root, "SSD End to End Corrected Correction Count",
-			le32_to_cpu(perf->ssd_correct_count));
-	json_object_add_value_int(root, "System Data Percent Used",
-			perf->data_percent_used);
-	json_object_add_value_int(root, "User Data Erase Counts Max",
-			le32_to_cpu(perf->data_erase_max));
-	json_object_add_value_int(root, "User Data Erase Counts Min",
-			le32_to_cpu(perf->data_erase_min));
-	json_object_add_value_int(root, "Refresh Count", le64_to_cpu(perf->refresh_count));
-
-	converted = le64_to_cpu(perf->program_fail);
-	json_object_add_value_int(root, "Program Fail Count (Normalized)",
-			converted & 0xFFFF);
-	json_object_add_value_int(root, "Program Fail Count (Raw)",
-			converted >> 16);
-
-	converted = le64_to_cpu(perf->user_erase_fail);
-	json_object_add_value_int(root, "User Data Erase Fail Count (Normalized)",
-			converted & 0xFFFF);
-	json_object_add_value_int(root, "User Data Erase Fail Count (Raw)",
-			converted >> 16);
-
-	converted = le64_to_cpu(perf->system_erase_fail);
-	json_object_add_value_int(root, "System Area Erase Fail Count (Normalized)",
-			converted & 0xFFFF);
-	json_object_add_value_int(root, "System Area Erase Fail Count (Raw)",
-			converted >> 16);
-
-	json_object_add_value_int(root, "Thermal Throttling Status",
-			perf->thermal_throttle_status);
-	json_object_add_value_int(root, "Thermal Throttling Count",
-			perf->thermal_throttle_count);
-	json_object_add_value_int(root, "PCIe Correctable Error", le64_to_cpu(perf->pcie_corr_error));
-	json_object_add_value_int(root, "Incomplete Shutdown Counte", le32_to_cpu(perf->incomplete_shutdown_count));
-	json_object_add_value_int(root, "Percent Free Blocks", perf->percent_free_blocks);
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
-}
+#define CA_FIELD(member, type, name, json) \
+	WDC_FIELD(struct wdc_ssd_ca_perf_stats, member, type, name, json)
+
+static const struct wdc_log_field wdc_fb_ca_fields[] = {
+	CA_FIELD(nand_bytes_wr_lo, WDC_FIELD_HI_LO, "NAND Bytes Written", NULL),
+	CA_FIELD(nand_bytes_rd_lo, WDC_FIELD_HI_LO, "NAND Bytes Read", NULL),
+	CA_FIELD(nand_bad_block, WDC_FIELD_NORM_RAW, "NAND Bad Block Count", NULL),
+	CA_FIELD(uncorr_read_count, WDC_FIELD_UINT, "Uncorrectable Read Count", NULL),
+	CA_FIELD(ecc_error_count, WDC_FIELD_UINT, "Soft ECC Error Count", NULL),
+	CA_FIELD(ssd_detect_count, WDC_FIELD_UINT, "SSD End to End Detected Correction Count", NULL),
+	CA_FIELD(ssd_correct_count, WDC_FIELD_UINT, "SSD End to End Corrected Correction Count", NULL),
+	{ .name = "System Data Percent Used", .type = WDC_FIELD_UINT, .width = 1,
+	  .offset = offsetof(struct wdc_ssd_ca_perf_stats, data_percent_used),
+	  .flags = WDC_FIELD_PERCENT },
+	CA_FIELD(data_erase_max, WDC_FIELD_UINT, "User Data Erase Counts Max", NULL),
+	CA_FIELD(data_erase_min, WDC_FIELD_UINT, "User Data Erase Counts Min", NULL),
+	CA_FIELD(refresh_count, WDC_FIELD_UINT, "Refresh Count", NULL),
+	CA_FIELD(program_fail, WDC_FIELD_NORM_RAW, "Program Fail Count", NULL),
+	CA_FIELD(user_erase_fail, WDC_FIELD_NORM_RAW, "User Data Erase Fail Count", NULL),
+	CA_FIELD(system_erase_fail, WDC_FIELD_NORM_RAW, "System Area Erase Fail Count", NULL),
+	CA_FIELD(thermal_throttle_status, WDC_FIELD_UINT, "Thermal Throttling Status", NULL),
+	CA_FIELD(thermal_throttle_count, WDC_FIELD_UINT, "Thermal Throttling Count", NULL),
+	CA_FIELD(pcie_corr_error, WDC_FIELD_UINT, "PCIe Correctable Error Count",
+		 "PCIe Correctable Error"),
+	CA_FIELD(incomplete_shutdown_count, WDC_FIELD_UINT, "Incomplete Shutdown Count",
+		 "Incomplete Shutdown Counte"),
+	{ .name = "Percent Free Blocks", .type = WDC_FIELD_UINT, .width = 1,
+	  .offset = offsetof(struct wdc_ssd_ca_perf_stats, percent_free_blocks),
+	  .flags = WDC_FIELD_PERCENT },
+};
+
+static const struct wdc_log_layout wdc_fb_ca_layout = {
+	.title = "CA Log Page Performance Statistics",
+	.fields = wdc_fb_ca_fields,
+	.nr_fields = ARRAY_SIZE(wdc_fb_ca_fields),
+	.label_width = 47,
+	.value_width = 20,
+	.sep = "",
+	.len = WDC_FB_CA_LOG_BUF_LEN,
+	.version_offset = -1,
+};
 
 static void wdc_print_bd_ca_log_normal(struct nvme_dev *dev, void *data)
 {
@@ -5382,108 +5390,48 @@ done:
 
 }
 
-static void wdc_print_d0_log_normal(struct wdc_ssd_d0_smart_log *perf)
-{
-	printf("  D0 Smart Log Page Statistics :-\n");
-	printf("  Lifetime Reallocated Erase Block Count	 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_realloc_erase_block_count));
-	printf("  Lifetime Power on Hours			 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_power_on_hours));
-	printf("  Lifetime UECC Count	                         %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_uecc_count));
-	printf("  Lifetime Write Amplification Factor	         %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_wrt_amp_factor));
-	printf("  Trailing Hour Write Amplification Factor       %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->trailing_hr_wrt_amp_factor));
-	printf("  Reserve Erase Block Count	                 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->reserve_erase_block_count));
-	printf("  Lifetime Program Fail Count	                 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_program_fail_count));
-	printf("  Lifetime Block Erase Fail Count		 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_block_erase_fail_count));
-	printf("  Lifetime Die Failure Count	                 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_die_failure_count));
-	printf("  Lifetime Link Rate Downgrade Count	         %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_link_rate_downgrade_count));
-	printf("  Lifetime Clean Shutdown Count on Power Loss	 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_clean_shutdown_count));
-	printf("  Lifetime Unclean Shutdowns on Power Loss	 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_unclean_shutdown_count));
-	printf("  Current Temperature                            %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->current_temp));
-	printf("  Max Recorded Temperature			 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->max_recorded_temp));
-	printf("  Lifetime Retired Block Count	                 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_retired_block_count));
-	printf("  Lifetime Read Disturb Reallocation Events	 %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_read_disturb_realloc_events));
-	printf("  Lifetime NAND Writes	                         %20"PRIu64"\n",
-			le64_to_cpu(perf->lifetime_nand_writes));
-	printf("  Capacitor Health			         %20"PRIu32"%%\n",
-			(uint32_t)le32_to_cpu(perf->capacitor_health));
-	printf("  Lifetime User Writes	                         %20"PRIu64"\n",
-			le64_to_cpu(perf->lifetime_user_writes));
-	printf("  Lifetime User Reads	                         %20"PRIu64"\n",
-			le64_to_cpu(perf->lifetime_user_reads));
-	printf("  Lifetime Thermal Throttle Activations	         %20"PRIu32"\n",
-			(uint32_t)le32_to_cpu(perf->lifetime_thermal_throttle_act));
-	printf("  Percentage of P/E Cycles Remaining             %20"PRIu32"%%\n",
-			(uint32_t)le32_to_cpu(perf->percentage_pe_cycles_remaining));
-}
-
-static void wdc_print_d0_log_json(struct wdc_ssd_d0_smart_log *perf)
-{
-	struct json_object *root = json_create_object();
-
-	json_object_add_value_int(root, "Lifetime Reallocated Erase Block Count",
-			le32_to_cpu(perf->lifetime_realloc_erase_block_count));
-	json_object_add_value_int(root, "Lifetime Power on Hours",
-			le32_to_cpu(perf->lifetime_power_on_hours));
-	json_object_add_value_int(root, "Lifetime UECC Count",
-			le32_to_cpu(perf->lifetime_uecc_count));
-	json_object_add_value_int(root, "Lifetime Write Amplification Factor",
-			le32_to_cpu(perf->lifetime_wrt_amp_factor));
-	json_object_add_value_int(root, "Trailing Hour Write Amplification Factor",
-			le32_to_cpu(perf->trailing_hr_wrt_amp_factor));
-	json_object_add_value_int(root, "Reserve Erase Block Count",
-			le32_to_cpu(perf->reserve_erase_block_count));
-	json_object_add_value_int(root, "Lifetime Program Fail Count",
-			le32_to_cpu(perf->lifetime_program_fail_count));
-	json_object_add_value_int(root, "Lifetime Block Erase Fail Count",
-			le32_to_cpu(perf->lifetime_block_erase_fail_count));
-	json_object_add_value_int(root, "Lifetime Die Failure Count",
-			le32_to_cpu(perf->lifetime_die_failure_count));
-	json_object_add_value_int(root, "Lifetime Link Rate Downgrade Count",
-			le32_to_cpu(perf->lifetime_link_rate_downgrade_count));
-	json_object_add_value_int(root, "Lifetime Clean Shutdown Count on Power Loss",
-			le32_to_cpu(perf->lifetime_clean_shutdown_count));
-	json_object_add_value_int(root, "Lifetime Unclean Shutdowns on Power Loss",
-			le32_to_cpu(perf->lifetime_unclean_shutdown_count));
-	json_object_add_value_int(root, "Current Temperature",
-			le32_to_cpu(perf->current_temp));
-	json_object_add_value_int(root, "Max Recorded Temperature",
-			le32_to_cpu(perf->max_recorded_temp));
-	json_object_add_value_int(root, "Lifetime Retired Block Count",
-			le32_to_cpu(perf->lifetime_retired_block_count));
-	json_object_add_value_int(root, "Lifetime Read Disturb Reallocation Events",
-			le32_to_cpu(perf->lifetime_read_disturb_realloc_events));
-	json_object_add_value_int(root, "Lifetime NAND Writes",
-			le64_to_cpu(perf->lifetime_nand_writes));
-	json_object_add_value_int(root, "Capacitor Health",
-			le32_to_cpu(perf->capacitor_health));
-	json_object_add_value_int(root, "Lifetime User Writes",
-			le64_to_cpu(perf->lifetime_user_writes));
-	json_object_add_value_int(root, "Lifetime User Reads",
-			le64_to_cpu(perf->lifetime_user_reads));
-	json_object_add_value_int(root, "Lifetime Thermal Throttle Activations",
-			le32_to_cpu(perf->lifetime_thermal_throttle_act));
-	json_object_add_value_int(root, "Percentage of P/E Cycles Remaining",
-			le32_to_cpu(perf->percentage_pe_cycles_remaining));
+#define D0_FIELD(member, name) \
+	WDC_FIELD(struct wdc_ssd_d0_smart_log, member, WDC_FIELD_UINT, name, NULL)
+
+static const struct wdc_log_field wdc_d0_fields[] = {
+	D0_FIELD(lifetime_realloc_erase_block_count, "Lifetime Reallocated Erase Block Count"),
+	D0_FIELD(lifetime_power_on_hours, "Lifetime Power on Hours"),
+	D0_FIELD(lifetime_uecc_count, "Lifetime UECC Count"),
+	D0_FIELD(lifetime_wrt_amp_factor, "Lifetime Write Amplification Factor"),
+	D0_FIELD(trailing_hr_wrt_amp_factor, "Trailing Hour Write Amplification Factor"),
+	D0_FIELD(reserve_erase_block_count, "Reserve Erase Block Count"),
+	D0_FIELD(lifetime_program_fail_count, "Lifetime Program Fail Count"),
+	D0_FIELD(lifetime_block_erase_fail_count, "Lifetime Block Erase Fail Count"),
+	D0_FIELD(lifetime_die_failure_count, "Lifetime Die Failure Count"),
+	D0_FIELD(lifetime_link_rate_downgrade_count, "Lifetime Link Rate Downgrade Count"),
+	D0_FIELD(lifetime_clean_shutdown_count, "Lifetime Clean Shutdown Count on Power Loss"),
+	D0_FIELD(lifetime_unclean_shutdown_count, "Lifetime Unclean Shutdowns on Power Loss"),
+	D0_FIELD(current_temp, "Current Temperature"),
+	D0_FIELD(max_recorded_temp, "Max Recorded Temperature"),
+	D0_FIELD(lifetime_retired_block_count, "Lifetime Retired Block Count"),
+	D0_FIELD(lifetime_read_disturb_realloc_events, "Lifetime Read Disturb Reallocation Events"),
+	D0_FIELD(lifetime_nand_writes, "Lifetime NAND Writes"),
+	{ .name = "Capacitor Health", .type = WDC_FIELD_UINT, .width = 4,
+	  .offset = offsetof(struct wdc_ssd_d0_smart_log, capacitor_health),
+	  .flags = WDC_FIELD_PERCENT },
+	D0_FIELD(lifetime_user_writes, "Lifetime User Writes"),
+	D0_FIELD(lifetime_user_reads, "Lifetime User Reads"),
+	D0_FIELD(lifetime_thermal_throttle_act, "Lifetime Thermal Throttle Activations"),
+	{ .name = "Percentage of P/E Cycles Remaining", .type = WDC_FIELD_UINT, .width = 4,
+	  .offset = offsetof(struct wdc_ssd_d0_smart_log, percentage_pe_cycles_remaining),
+	  .flags = WDC_FIELD_PERCENT },
+};
 
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
-}
+static const struct wdc_log_layout wdc_d0_layout = {
+	.title = "D0 Smart Log Page Statistics",
+	.fields = wdc_d0_fields,
+	.nr_fields = ARRAY_SIZE(wdc_d0_fields),
+	.label_width = 47,
+	.value_width = 20,
+	.sep = "",
+	.len = WDC_NVME_VU_SMART_LOG_LEN,
+	.version_offset = -1,
+};
 
 static void wdc_get_commit_action_bin(__u8 commit_action_type, char *action_bin)
 {
@@ -6556,177 +6504,66 @@ static void wdc_print_ext_smart_cloud_log_json(void *data, int mask)
 	json_free_object(root);
 }
 
-static void wdc_print_smart_cloud_attr_C0_normal(void *data)
-{
-	__u8 *log_data = (__u8 *)data;
-	uint16_t smart_log_ver = 0;
-
-	printf("  SMART Cloud Attributes :-\n");
-
-	printf("  Physical media units written			: %s\n",
-	       uint128_t_to_string(le128_to_cpu(&log_data[SCAO_PMUW])));
-	printf("  Physical media units read			: %s\n",
-	       uint128_t_to_string(le128_to_cpu(&log_data[SCAO_PMUR])));
-	printf("  Bad user nand blocks Raw			: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_BUNBR] & 0x0000FFFFFFFFFFFF));
-	printf("  Bad user nand blocks Normalized		: %d\n",
-	       (uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_BUNBN]));
-	printf("  Bad system nand blocks Raw			: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_BSNBR] & 0x0000FFFFFFFFFFFF));
-	printf("  Bad system nand blocks Normalized		: %d\n",
-	       (uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_BSNBN]));
-	printf("  XOR recovery count				: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_XRC]));
-	printf("  Uncorrectable read error count		: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_UREC]));
-	printf("  Soft ecc error count				: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_SEEC]));
-	printf("  End to end corrected errors			: %"PRIu32"\n",
-	       (uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_EECE]));
-	printf("  End to end detected errors			: %"PRIu32"\n",
-	       (uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_EEDC]));
-	printf("  System data percent used			: %d\n", (__u8)log_data[SCAO_SDPU]);
-	printf("  Refresh counts				: %"PRIu64"\n",
-	       (uint64_t)(le64_to_cpu(*(uint64_t *)&log_data[SCAO_RFSC]) & 0x00FFFFFFFFFFFFFF));
-	printf("  Max User data erase counts			: %"PRIu32"\n",
-	       (uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_MXUDEC]));
-	printf("  Min User data erase counts			: %"PRIu32"\n",
-	       (uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_MNUDEC]));
-	printf("  Number of Thermal throttling events		: %d\n", (__u8)log_data[SCAO_NTTE]);
-	printf("  Current throttling status			: 0x%x\n", (__u8)log_data[SCAO_CTS]);
-	printf("  PCIe correctable error count			: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PCEC]));
-	printf("  Incomplete shutdowns				: %"PRIu32"\n",
-	       (uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_ICS]));
-	printf("  Percent free blocks				: %d\n", (__u8)log_data[SCAO_PFB]);
-	printf("  Capacitor health				: %"PRIu16"\n",
-	       (uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_CPH]));
-	printf("  Unaligned I/O					: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_UIO]));
-	printf("  Security Version Number			: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_SVN]));
-	printf("  NUSE Namespace utilization			: %"PRIu64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_NUSE]));
-	printf("  PLP start count				: %s\n",
-	       uint128_t_to_string(le128_to_cpu(&log_data[SCAO_PSC])));
-	printf("  Endurance estimate				: %s\n",
-	       uint128_t_to_string(le128_to_cpu(&log_data[SCAO_EEST])));
-	smart_log_ver = (uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_LPV]);
-	printf("  Log page version				: %"PRIu16"\n", smart_log_ver);
-	printf("  Log page GUID					: 0x");
-	printf("%"PRIx64"%"PRIx64"\n",
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_LPG + 8]),
-	       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_LPG]));
-	if (smart_log_ver > 2) {
-		printf("  Errata Version Field				: %d\n",
-		       (__u8)log_data[SCAO_EVF]);
-		printf("  Point Version Field				: %"PRIu16"\n",
-		       (uint16_t)log_data[SCAO_PVF]);
-		printf("  Minor Version Field				: %"PRIu16"\n",
-		       (uint16_t)log_data[SCAO_MIVF]);
-		printf("  Major Version Field				: %d\n",
-		       (__u8)log_data[SCAO_MAVF]);
-		printf("  NVMe Errata Version				: %d\n",
-		       (__u8)log_data[SCAO_NEV]);
-		printf("  PCIe Link Retraining Count			: %"PRIu64"\n",
-		       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PLRC]));
-	}
-	if (smart_log_ver > 3) {
-		printf("  Power State Change Count				: %"PRIu64"\n",
-		       (uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PSCC]));
-	}
-	printf("\n");
-}
-
-static void wdc_print_smart_cloud_attr_C0_json(void *data)
-{
-	__u8 *log_data = (__u8 *)data;
-	struct json_object *root = json_create_object();
-	uint16_t smart_log_ver = 0;
-
-	json_object_add_value_uint128(root, "Physical media units written",
-			le128_to_cpu(&log_data[SCAO_PMUW]));
-	json_object_add_value_uint128(root, "Physical media units read",
-			le128_to_cpu(&log_data[SCAO_PMUR]));
-	json_object_add_value_uint64(root, "Bad user nand blocks - Raw",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_BUNBR] & 0x0000FFFFFFFFFFFF));
-	json_object_add_value_uint(root, "Bad user nand blocks - Normalized",
-			(uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_BUNBN]));
-	json_object_add_value_uint64(root, "Bad system nand blocks - Raw",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_BSNBR] & 0x0000FFFFFFFFFFFF));
-	json_object_add_value_uint(root, "Bad system nand blocks - Normalized",
-			(uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_BSNBN]));
-	json_object_add_value_uint64(root, "XOR recovery count",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_XRC]));
-	json_object_add_value_uint64(root, "Uncorrectable read error count",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_UREC]));
-	json_object_add_value_uint64(root, "Soft ecc error count",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_SEEC]));
-	json_object_add_value_uint(root, "End to end corrected errors",
-			(uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_EECE]));
-	json_object_add_value_uint(root, "End to end detected errors",
-			(uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_EEDC]));
-	json_object_add_value_uint(root, "System data percent used",
-			(__u8)log_data[SCAO_SDPU]);
-	json_object_add_value_uint64(root, "Refresh counts",
-	    (uint64_t)(le64_to_cpu(*(uint64_t *)&log_data[SCAO_RFSC]) & 0x00FFFFFFFFFFFFFF));
-	json_object_add_value_uint(root, "Max User data erase counts",
-			(uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_MXUDEC]));
-	json_object_add_value_uint(root, "Min User data erase counts",
-			(uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_MNUDEC]));
-	json_object_add_value_uint(root, "Number of Thermal throttling events",
-			(__u8)log_data[SCAO_NTTE]);
-	json_object_add_value_uint(root, "Current throttling status",
-			(__u8)log_data[SCAO_CTS]);
-	json_object_add_value_uint64(root, "PCIe correctable error count",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PCEC]));
-	json_object_add_value_uint(root, "Incomplete shutdowns",
-			(uint32_t)le32_to_cpu(*(uint32_t *)&log_data[SCAO_ICS]));
-	json_object_add_value_uint(root, "Percent free blocks",
-			(__u8)log_data[SCAO_PFB]);
-	json_object_add_value_uint(root, "Capacitor health",
-			(uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_CPH]));
-	json_object_add_value_uint64(root, "Unaligned I/O",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_UIO]));
-	json_object_add_value_uint64(root, "Security Version Number",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_SVN]));
-	json_object_add_value_uint64(root, "NUSE - Namespace utilization",
-			(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_NUSE]));
-	json_object_add_value_uint128(root, "PLP start count",
-			le128_to_cpu(&log_data[SCAO_PSC]));
-	json_object_add_value_uint128(root, "Endurance estimate",
-			le128_to_cpu(&log_data[SCAO_EEST]));
-	smart_log_ver = (uint16_t)le16_to_cpu(*(uint16_t *)&log_data[SCAO_LPV]);
-	json_object_add_value_uint(root, "Log page version", smart_log_ver);
-	char guid[40];
+#define C0_FIELD(offset, width, type, name, json) \
+	WDC_FIELD_AT(offset, width, type, name, json)
+
+static const struct wdc_log_field wdc_c0_cloud_attr_fields[] = {
+	C0_FIELD(SCAO_PMUW, 16, WDC_FIELD_UINT128, "Physical media units written", NULL),
+	C0_FIELD(SCAO_PMUR, 16, WDC_FIELD_UINT128, "Physical media units read", NULL),
+	{ .name = "Bad user nand blocks Raw", .json = "Bad user nand blocks - Raw",
+	  .offset = SCAO_BUNBR, .width = 8, .mask = 0x0000FFFFFFFFFFFF },
+	C0_FIELD(SCAO_BUNBN, 2, WDC_FIELD_UINT, "Bad user nand blocks Normalized",
+		 "Bad user nand blocks - Normalized"),
+	{ .name = "Bad system nand blocks Raw", .json = "Bad system nand blocks - Raw",
+	  .offset = SCAO_BSNBR, .width = 8, .mask = 0x0000FFFFFFFFFFFF },
+	C0_FIELD(SCAO_BSNBN, 2, WDC_FIELD_UINT, "Bad system nand blocks Normalized",
+		 "Bad system nand blocks - Normalized"),
+	C0_FIELD(SCAO_XRC, 8, WDC_FIELD_UINT, "XOR recovery count", NULL),
+	C0_FIELD(SCAO_UREC, 8, WDC_FIELD_UINT, "Uncorrectable read error count", NULL),
+	C0_FIELD(SCAO_SEEC, 8, WDC_FIELD_UINT, "Soft ecc error count", NULL),
+	C0_FIELD(SCAO_EECE, 4, WDC_FIELD_UINT, "End to end corrected errors", NULL),
+	C0_FIELD(SCAO_EEDC, 4, WDC_FIELD_UINT, "End to end detected errors", NULL),
+	C0_FIELD(SCAO_SDPU, 1, WDC_FIELD_UINT, "System data percent used", NULL),
+	{ .name = "Refresh counts", .offset = SCAO_RFSC, .width = 8,
+	  .mask = 0x00FFFFFFFFFFFFFF },
+	C0_FIELD(SCAO_MXUDEC, 4, WDC_FIELD_UINT, "Max User data erase counts", NULL),
+	C0_FIELD(SCAO_MNUDEC, 4, WDC_FIELD_UINT, "Min User data erase counts", NULL),
+	C0_FIELD(SCAO_NTTE, 1, WDC_FIELD_UINT, "Number of Thermal throttling events", NULL),
+	{ .name = "Current throttling status", .offset = SCAO_CTS, .width = 1,
+	  .flags = WDC_FIELD_HEX },
+	C0_FIELD(SCAO_PCEC, 8, WDC_FIELD_UINT, "PCIe correctable error count", NULL),
+	C0_FIELD(SCAO_ICS, 4, WDC_FIELD_UINT, "Incomplete shutdowns", NULL),
+	C0_FIELD(SCAO_PFB, 1, WDC_FIELD_UINT, "Percent free blocks", NULL),
+	C0_FIELD(SCAO_CPH, 2, WDC_FIELD_UINT, "Capacitor health", NULL),
+	C0_FIELD(SCAO_UIO, 8, WDC_FIELD_UINT, "Unaligned I/O", NULL),
+	C0_FIELD(SCAO_SVN, 8, WDC_FIELD_UINT, "Security Version Number", NULL),
+	C0_FIELD(SCAO_NUSE, 8, WDC_FIELD_UINT, "NUSE Namespace utilization",
+		 "NUSE - Namespace utilization"),
+	C0_FIELD(SCAO_PSC, 16, WDC_FIELD_UINT128, "PLP start count", NULL),
+	C0_FIELD(SCAO_EEST, 16, WDC_FIELD_UINT128, "Endurance estimate", NULL),
+	C0_FIELD(SCAO_LPV, 2, WDC_FIELD_UINT, "Log page version", NULL),
+	C0_FIELD(SCAO_LPG, 16, WDC_FIELD_GUID, "Log page GUID", NULL),
+	{ .name = "Errata Version Field", .offset = SCAO_EVF, .width = 1, .min_version = 3 },
+	{ .name = "Point Version Field", .offset = SCAO_PVF, .width = 1, .min_version = 3 },
+	{ .name = "Minor Version Field", .offset = SCAO_MIVF, .width = 1, .min_version = 3 },
+	{ .name = "Major Version Field", .offset = SCAO_MAVF, .width = 1, .min_version = 3 },
+	{ .name = "NVMe Errata Version", .offset = SCAO_NEV, .width = 1, .min_version = 3 },
+	{ .name = "PCIe Link Retraining Count", .offset = SCAO_PLRC, .width = 8,
+	  .min_version = 3 },
+	{ .name = "Power State Change Count", .offset = SCAO_PSCC, .width = 8,
+	  .min_version = 4 },
+};
 
-	memset((void *)guid, 0, 40);
-	sprintf((char *)guid, "0x%"PRIx64"%"PRIx64"",
-		(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_LPG + 8]),
-		(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_LPG]));
-	json_object_add_value_string(root, "Log page GUID", guid);
-	if (smart_log_ver > 2) {
-		json_object_add_value_uint(root, "Errata Version Field",
-				(__u8)log_data[SCAO_EVF]);
-		json_object_add_value_uint(root, "Point Version Field",
-				(uint16_t)log_data[SCAO_PVF]);
-		json_object_add_value_uint(root, "Minor Version Field",
-				(uint16_t)log_data[SCAO_MIVF]);
-		json_object_add_value_uint(root, "Major Version Field",
-				(__u8)log_data[SCAO_MAVF]);
-		json_object_add_value_uint(root, "NVMe Errata Version",
-				(__u8)log_data[SCAO_NEV]);
-		json_object_add_value_uint64(root, "PCIe Link Retraining Count",
-				(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PLRC]));
-	}
-	if (smart_log_ver > 3) {
-		json_object_add_value_uint64(root, "Power State Change Count",
-				(uint64_t)le64_to_cpu(*(uint64_t *)&log_data[SCAO_PSCC]));
-	}
-	json_print_object(root, NULL);
-	printf("\n");
-	json_free_object(root);
-}
+static const struct wdc_log_layout wdc_c0_cloud_attr_layout = {
+	.title = "SMART Cloud Attributes",
+	.fields = wdc_c0_cloud_attr_fields,
+	.nr_fields = ARRAY_SIZE(wdc_c0_cloud_attr_fields),
+	.label_width = 40,
+	.value_width = 0,
+	.sep = ": ",
+	.len = WDC_NVME_SMART_CLOUD_ATTR_LEN,
+	.version_offset = SCAO_LPV,
+};
 
 static void wdc_print_eol_c0_normal(void *data)
 {
@@ -6800,14 +6637,7 @@ static int wdc_print_c0_cloud_attr_log(void *data, int fmt)
 		fprintf(stderr, "ERROR: WDC: Invalid buffer to read 0xC0 log\n");
 		return -1;
 	}
-	switch (fmt) {
-	case NORMAL:
-		wdc_print_smart_cloud_attr_C0_normal(data);
-		break;
-	case JSON:
-		wdc_print_smart_cloud_attr_C0_json(data);
-		break;
-	}
+	wdc_print_log_fields(&wdc_c0_cloud_attr_layout, data, fmt);
 	return 0;
 }
 
@@ -7222,14 +7052,7 @@ static int wdc_print_fb_ca_log(struct wdc_ssd_ca_perf_stats *perf, int fmt)
 		fprintf(stderr, "ERROR: WDC: Invalid buffer to read perf stats\n");
 		return -1;
 	}
-	switch (fmt) {
-	case NORMAL:
-		wdc_print_fb_ca_log_normal(perf);
-		break;
-	case JSON:
-		wdc_print_fb_ca_log_json(perf);
-		break;
-	}
+	wdc_print_log_fields(&wdc_fb_ca_layout, perf, fmt);
 	return 0;
 }
 
@@ -7259,14 +7082,7 @@ static int wdc_print_d0_log(struct wdc_ssd_d0_smart_log *perf, int fmt)
 		fprintf(stderr, "ERROR: WDC: Invalid buffer to read perf stats\n");
 		return -1;
 	}
-	switch (fmt) {
-	case NORMAL:
-		wdc_print_d0_log_normal(perf);
-		break;
-	case JSON:
-		wdc_print_d0_log_json(perf);
-		break;
-	}
+	wdc_print_log_fields(&wdc_d0_layout, perf, fmt);
 	return 0;
 }
 
@@ -9322,7 +9138,7 @@ static int wdc_get_serial_and_fw_rev(struct nvme_dev *dev, char *sn, char *fw_re
 	memset(sn, 0, WDC_SERIAL_NO_LEN);
 	memset(fw_rev, 0, WDC_NVME_FIRMWARE_REV_LEN);
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -9346,7 +9162,7 @@ static int wdc_get_max_transfer_len(struct nvme_dev *dev, __u32 *maxTransferLen)
 	__u32 maxTransferLenDevice = 0;
 
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -9616,7 +9432,8 @@ end:
 	return ret;
 }
 
-static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 binFileNameLen, char *binFileName)
+/* reads the whole dump trace into a buffer returned in @data, freed by the caller */
+static int wdc_de_read_dump_trace(struct nvme_dev *dev, __u8 **data, __u32 *size)
 {
 	int ret = WDC_STATUS_FAILURE;
 	__u8 *readBuffer = NULL;
@@ -9630,7 +9447,7 @@ static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 bin
 	__u32 i;
 	__u32 maximumTransferLength = 0;
 
-	if (!dev || !binFileName || !filePath) {
+	if (!dev || !data || !size) {
 		ret = WDC_STATUS_INVALID_PARAMETER;
 		return ret;
 	}
@@ -9684,7 +9501,7 @@ static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 bin
 				readBufferLen = lastPktReadBufferLen;
 
 			ret = wdc_de_VU_read_buffer(dev, 0, WDC_DE_DUMPTRACE_DESTINATION, 0,
-						    readBuffer + offset, &readBufferLen);
+						    readBuffer + i * chunkSize, &readBufferLen);
 			if (ret != WDC_STATUS_SUCCESS) {
 				fprintf(stderr,
 					"ERROR: WDC: %s: wdc_de_VU_read_buffer failed, ret = %d on offset 0x%x\n",
@@ -9694,6 +9511,28 @@ static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 bin
 		}
 	} while (0);
 
+	if (ret == WDC_STATUS_SUCCESS) {
+		*data = readBuffer;
+		*size = dumptraceSize;
+	} else {
+		free(readBuffer);
+	}
+
+	return ret;
+}
+
+static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 binFileNameLen, char *binFileName)
+{
+	__u8 *readBuffer = NULL;
+	__u32 dumptraceSize = 0;
+	int ret;
+
+	if (!dev || !binFileName || !filePath) {
+		ret = WDC_STATUS_INVALID_PARAMETER;
+		return ret;
+	}
+
+	ret = wdc_de_read_dump_trace(dev, &readBuffer, &dumptraceSize);
 	if (ret == WDC_STATUS_SUCCESS) {
 		ret = wdc_WriteToFile(binFileName, (char *)readBuffer, dumptraceSize);
 		if (ret != WDC_STATUS_SUCCESS)
@@ -9704,8 +9543,7 @@ static int wdc_de_get_dump_trace(struct nvme_dev *dev, char *filePath, __u16 bin
 			ret);
 	}
 
-	if (readBuffer)
-		free(readBuffer);
+	free(readBuffer);
 
 	return ret;
 }
@@ -9787,8 +9625,287 @@ int wdc_read_debug_directory(struct nvme_dev *dev, __s8 *bufferFolderPath, __u8
 	return ret;
 }
 
+/*
+ * drive-essentials --stream: the identify pages, logs and features are
+ * fetched concurrently by a pool of workers and each one is added to the
+ * archive as soon as it was read, so nothing is written to a temporary
+ * file and no external tar is run. The debug directory files and the dump
+ * trace are read with the multi-command VU read buffer protocol and are
+ * fetched one after the other by a single work item.
+ */
+#define WDC_DE_STREAM_JOBS		4
+#define WDC_DE_STREAM_ZSTD_LEVEL	3
+
+struct wdc_de_stream {
+	struct nvme_dev *dev;
+	struct nvme_tar *tar;
+	const char *folder;
+	const char *serialNo;
+	const char *timeString;
+};
+
+struct wdc_de_stream_item {
+	struct wdc_de_stream *s;
+	void (*fn)(struct wdc_de_stream *s, unsigned int idx);
+	unsigned int idx;
+};
+
+static void wdc_de_stream_add(struct wdc_de_stream *s, const char *name, const void *data,
+			      size_t len)
+{
+	char fileName[MAX_PATH_LEN];
+	int ret;
+
+	wdc_UtilsSnprintf(fileName, MAX_PATH_LEN, "%s%s%s_%s_%s.bin", s->folder,
+			  WDC_DE_PATH_SEPARATOR, name, s->serialNo, s->timeString);
+	ret = nvme_tar_add(s->tar, fileName, data, len);
+	if (ret)
+		fprintf(stderr, "ERROR: WDC: adding %s to the archive failed: %s\n", fileName,
+			nvme_strerror(-ret));
+}
+
+static void wdc_de_stream_identify(struct wdc_de_stream *s, unsigned int idx)
+{
+	_cleanup_free_ void *data = nvme_alloc(NVME_IDENTIFY_DATA_SIZE);
+	int ret;
+
+	if (!data)
+		return;
+
+	if (!idx) {
+		ret = nvme_identify_ctrl(dev_fd(s->dev), data);
+		if (ret)
+			fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed, ret = %d\n", ret);
+		else
+			wdc_de_stream_add(s, "IdentifyController", data, sizeof(struct nvme_id_ctrl));
+	} else {
+		ret = nvme_identify_ns(dev_fd(s->dev), 1, data);
+		if (ret)
+			fprintf(stderr, "ERROR: WDC: nvme_identify_ns() failed, ret = %d\n", ret);
+		else
+			wdc_de_stream_add(s, "IdentifyNamespace", data, sizeof(struct nvme_id_ns));
+	}
+}
+
+static void wdc_de_stream_log(struct wdc_de_stream *s, unsigned int idx)
+{
+	__u32 elogBufferSize = WDC_DE_DEFAULT_NUMBER_OF_ERROR_ENTRIES *
+			       sizeof(struct nvme_error_log_page);
+	_cleanup_free_ void *data = NULL;
+	int ret;
+
+	switch (idx) {
+	case 0:
+		data = nvme_alloc(elogBufferSize);
+		if (!data)
+			return;
+		ret = nvme_get_log_error(dev_fd(s->dev), WDC_DE_DEFAULT_NUMBER_OF_ERROR_ENTRIES,
+					 false, data);
+		if (ret)
+			fprintf(stderr, "ERROR: WDC: nvme_error_log() failed, ret = %d\n", ret);
+		else
+			wdc_de_stream_add(s, "ErrorLog", data, elogBufferSize);
+		break;
+	case 1:
+		data = nvme_alloc(sizeof(struct nvme_smart_log));
+		if (!data)
+			return;
+		ret = nvme_get_log_smart(dev_fd(s->dev), NVME_NSID_ALL, false, data);
+		if (ret)
+			fprintf(stderr, "ERROR: WDC: nvme_smart_log() failed, ret = %d\n", ret);
+		else
+			wdc_de_stream_add(s, "SmartLog", data, sizeof(struct nvme_smart_log));
+		break;
+	default:
+		data = nvme_alloc(sizeof(struct nvme_firmware_slot));
+		if (!data)
+			return;
+		ret = nvme_get_log_fw_slot(dev_fd(s->dev), false, data);
+		if (ret)
+			fprintf(stderr, "ERROR: WDC: nvme_fw_log() failed, ret = %d\n", ret);
+		else
+			wdc_de_stream_add(s, "FwSLotLog", data, sizeof(struct nvme_firmware_slot));
+		break;
+	}
+}
+
+static void wdc_de_stream_vu_log(struct wdc_de_stream *s, unsigned int idx)
+{
+	struct NVME_VU_DE_LOGPAGE_LIST *page = &deVULogPagesList[idx];
+	_cleanup_free_ void *data = nvme_alloc(page->logPageLen);
+	char name[MAX_PATH_LEN];
+	char idStr[sizeof(page->logPageIdStr)];
+	int ret;
+
+	if (!data)
+		return;
+
+	ret = nvme_get_log_simple(dev_fd(s->dev), page->logPageId, page->logPageLen, data);
+	if (ret) {
+		fprintf(stderr, "ERROR: WDC: nvme_get_log() for log page 0x%x failed, ret = %d\n",
+			page->logPageId, ret);
+		return;
+	}
+
+	/* the shared table is not modified, other workers read it */
+	memcpy(idStr, page->logPageIdStr, sizeof(idStr));
+	wdc_UtilsDeleteCharFromString(idStr, sizeof(idStr) - 1, ' ');
+	wdc_UtilsSnprintf(name, MAX_PATH_LEN, "LogPage_%s", idStr);
+	wdc_de_stream_add(s, name, data, page->logPageLen);
+}
+
+static void wdc_de_stream_feature(struct wdc_de_stream *s, unsigned int idx)
+{
+	struct WDC_DE_CSA_FEATURE_ID_LIST *feat = &deFeatureIdList[idx];
+	__u8 featureIdBuff[4] = { 0 };
+	char name[MAX_PATH_LEN];
+	__u32 result;
+	int ret;
+
+	ret = nvme_get_features_data(dev_fd(s->dev), (enum nvme_features_id)feat->featureId,
+				     WDC_DE_GLOBAL_NSID, sizeof(featureIdBuff), &featureIdBuff,
+				     &result);
+	if (ret) {
+		fprintf(stderr, "ERROR: WDC: nvme_get_feature id 0x%x failed, ret = %d\n",
+			feat->featureId, ret);
+		return;
+	}
+
+	wdc_UtilsSnprintf(name, MAX_PATH_LEN, "FEATURE_ID_0x%x_%s", feat->featureId,
+			  (char *)feat->featureName);
+	wdc_de_stream_add(s, name, featureIdBuff, sizeof(featureIdBuff));
+}
+
+static void wdc_de_stream_vu_files(struct wdc_de_stream *s, unsigned int idx)
+{
+	struct WDC_DE_VU_LOG_DIRECTORY dir = { 0 };
+	__u32 maxNumOfVUFiles = 0, i;
+	__u8 *data = NULL;
+	__u32 size = 0;
+	int ret;
+
+	ret = wdc_get_log_dir_max_entries(s->dev, &maxNumOfVUFiles);
+	if (ret == WDC_STATUS_SUCCESS && maxNumOfVUFiles) {
+		dir.logEntry = calloc(maxNumOfVUFiles, sizeof(*dir.logEntry));
+		dir.maxNumLogEntries = maxNumOfVUFiles;
+		ret = dir.logEntry ? wdc_fetch_log_directory(s->dev, &dir) :
+				     WDC_STATUS_INSUFFICIENT_MEMORY;
+	}
+	if (ret != WDC_STATUS_SUCCESS)
+		fprintf(stderr, "WDC: fetching the log directory failed, ret = %d\n", ret);
+
+	for (i = 0; i < dir.numOfValidLogEntries; i++) {
+		struct WDC_DE_VU_FILE_META_DATA *meta = &dir.logEntry[i].metaData;
+		__u64 fileSize = meta->fileSize;
+
+		if (!fileSize) {
+			fprintf(stderr, "ERROR: WDC: File Size for %s is 0\n", meta->fileName);
+			continue;
+		}
+		data = calloc(1, fileSize);
+		if (!data) {
+			fprintf(stderr, "ERROR: WDC: calloc: %s\n", strerror(errno));
+			continue;
+		}
+		ret = wdc_fetch_log_file_from_device(s->dev, meta->fileID, WDC_DE_DESTN_SPI,
+						     fileSize, data);
+		if (ret == WDC_STATUS_SUCCESS)
+			wdc_de_stream_add(s, (char *)meta->fileName, data, fileSize);
+		else
+			fprintf(stderr, "ERROR: WDC: wdc_fetch_log_file_from_device: %s failed, ret = %d\n",
+				meta->fileName, ret);
+		free(data);
+	}
+	free(dir.logEntry);
+
+	data = NULL;
+	ret = wdc_de_read_dump_trace(s->dev, &data, &size);
+	if (ret == WDC_STATUS_SUCCESS)
+		wdc_de_stream_add(s, "dumptrace", data, size);
+	else
+		fprintf(stderr, "ERROR: WDC: wdc_de_get_dump_trace failed, ret = %d\n", ret);
+	free(data);
+}
+
+static void wdc_de_stream_work(void *arg)
+{
+	struct wdc_de_stream_item *item = arg;
+
+	item->fn(item->s, item->idx);
+}
+
+static int wdc_de_stream(struct nvme_dev *dev, const char *folderPath, const char *folderName,
+			 const char *serialNo, const char *timeString, unsigned int jobs)
+{
+	struct wdc_de_stream s = {
+		.dev = dev,
+		.folder = folderName,
+		.serialNo = serialNo,
+		.timeString = timeString,
+	};
+	struct wdc_de_stream_item items[2 + 3 + ARRAY_SIZE(deVULogPagesList) +
+				       ARRAY_SIZE(deFeatureIdList) + 1];
+	struct nvme_thread_pool *pool;
+	struct nvme_id_ctrl ctrl;
+	char tarFileName[MAX_PATH_LEN];
+	unsigned int nr = 0, i;
+	int fd, ret, err;
+
+	/* the long VU transfers go first so the other items fill the other workers */
+	items[nr++] = (struct wdc_de_stream_item){ &s, wdc_de_stream_vu_files, 0 };
+	for (i = 0; i < 2; i++)
+		items[nr++] = (struct wdc_de_stream_item){ &s, wdc_de_stream_identify, i };
+	for (i = 0; i < 3; i++)
+		items[nr++] = (struct wdc_de_stream_item){ &s, wdc_de_stream_log, i };
+	for (i = 0; i < ARRAY_SIZE(deVULogPagesList); i++)
+		items[nr++] = (struct wdc_de_stream_item){ &s, wdc_de_stream_vu_log, i };
+	/* skipping LbaRangeType as it is an optional nvme command and not supported */
+	for (i = 1; i < ARRAY_SIZE(deFeatureIdList); i++)
+		if (deFeatureIdList[i].featureId != FID_LBA_RANGE_TYPE)
+			items[nr++] = (struct wdc_de_stream_item){ &s, wdc_de_stream_feature, i };
+
+	wdc_UtilsSnprintf(tarFileName, sizeof(tarFileName), "%s%s", folderPath,
+			  nvme_tar_zstd_supported() ? ".tar.zst" : ".tar");
+	fd = open(tarFileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERROR: WDC: open %s: %s\n", tarFileName, strerror(errno));
+		return -1;
+	}
+
+	s.tar = nvme_tar_open(fd, nvme_tar_zstd_supported() ? WDC_DE_STREAM_ZSTD_LEVEL : 0);
+	if (!s.tar) {
+		fprintf(stderr, "ERROR: WDC: creating the archive failed: %s\n", strerror(errno));
+		close(fd);
+		unlink(tarFileName);
+		return -1;
+	}
+
+	fprintf(stderr, "Stream Drive Essentials data to: %s\n", tarFileName);
+
+	/* the workers only read the identify data of the device context */
+	wdc_identify_ctrl(dev, &ctrl);
+
+	pool = nvme_thread_pool_create(jobs ? jobs : WDC_DE_STREAM_JOBS);
+	for (i = 0; i < nr; i++)
+		if (!pool || nvme_thread_pool_queue(pool, wdc_de_stream_work, &items[i]))
+			wdc_de_stream_work(&items[i]);
+	if (pool)
+		nvme_thread_pool_destroy(pool);
+
+	ret = nvme_tar_close(s.tar);
+	err = close(fd);
+	if (ret || err) {
+		fprintf(stderr, "ERROR: WDC: writing %s failed: %s\n", tarFileName,
+			nvme_strerror(ret ? -ret : errno));
+		return -1;
+	}
+
+	fprintf(stderr, "Get of Drive Essentials data successful\n");
+	return 0;
+}
+
 static int wdc_do_drive_essentials(nvme_root_t r, struct nvme_dev *dev,
-				   char *dir, char *key)
+				   char *dir, char *key, bool stream, unsigned int jobs)
 {
 	int ret = 0;
 	void *retPtr;
@@ -9867,6 +9984,10 @@ static int wdc_do_drive_essentials(nvme_root_t r, struct nvme_dev *dev,
 		}
 	}
 
+	if (stream)
+		return wdc_de_stream(dev, (char *)bufferFolderPath, bufferFolderName,
+				     (char *)serialNo, (char *)timeString, jobs);
+
 	ret = wdc_UtilsCreateDir((char *)bufferFolderPath);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: create directory failed, ret = %d, dir = %s\n", ret, bufferFolderPath);
@@ -9877,7 +9998,7 @@ static int wdc_do_drive_essentials(nvme_root_t r, struct nvme_dev *dev,
 
 	/* Get Identify Controller Data */
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed, ret = %d\n", ret);
 		return -1;
@@ -10035,16 +10156,26 @@ static int wdc_drive_essentials(int argc, char **argv, struct command *command,
 	char *d_ptr;
 	int ret;
 
+	char *stream = "Fetch the data concurrently into a single archive, "
+		"zstd compressed when available, without temporary files.";
+	char *jobs = "Number of concurrent commands with --stream.";
+
 	struct config {
 		char *dirName;
+		bool stream;
+		__u32 jobs;
 	};
 
 	struct config cfg = {
 			.dirName = NULL,
+			.stream = false,
+			.jobs = WDC_DE_STREAM_JOBS,
 	};
 
 	OPT_ARGS(opts) = {
 		OPT_STRING("dir-name", 'd', "DIRECTORY", &cfg.dirName, dirName),
+		OPT_FLAG("stream", 's', &cfg.stream, stream),
+		OPT_UINT("jobs", 'j', &cfg.jobs, jobs),
 		OPT_END()
 	};
 
@@ -10068,7 +10199,7 @@ static int wdc_drive_essentials(int argc, char **argv, struct command *command,
 		d_ptr = NULL;
 	}
 
-	ret = wdc_do_drive_essentials(r, dev, d_ptr, k);
+	ret = wdc_do_drive_essentials(r, dev, d_ptr, k, cfg.stream, cfg.jobs);
 out:
 	nvme_free_tree(r);
 	dev_close(dev);
@@ -10665,7 +10796,7 @@ static int wdc_get_drive_reason_id(struct nvme_dev *dev, char *drive_reason_id,
 	j = sizeof(ctrl.mn) - 1;
 	memset(drive_reason_id, 0, len);
 	memset(&ctrl, 0, sizeof(struct nvme_id_ctrl));
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC: nvme_identify_ctrl() failed 0x%x\n", ret);
 		return -1;
@@ -11444,7 +11575,7 @@ static int wdc_vs_drive_info(int argc, char **argv,
 	}
 
 	/* get the id ctrl data used to fill in drive info below */
-	ret = nvme_identify_ctrl(dev_fd(dev), &ctrl);
+	ret = wdc_identify_ctrl(dev, &ctrl);
 
 	if (ret) {
 		fprintf(stderr, "ERROR: WDC %s: Identify Controller failed\n", __func__);
@@ -11705,7 +11836,7 @@ static int wdc_vs_temperature_stats(int argc, char **argv,
 	}
 
 	/* get the temperature stats or report errors */
-	ret = nvme_identify_ctrl(dev_fd(dev), &id_ctrl);
+	ret = wdc_identify_ctrl(dev, &id_ctrl);
 	if (ret)
 		goto out;
 	ret = nvme_get_log_smart(dev_fd(dev), NVME_NSID_ALL, false,
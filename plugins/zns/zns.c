@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
 #include <linux/fs.h>
 #include <sys/stat.h>
 
@@ -12,13 +14,25 @@
 #include "nvme.h"
 #include "libnvme.h"
 #include "nvme-print.h"
+#include "nvme-io-engine.h"
 #include "util/cleanup.h"
+#include "util/suffix.h"
+#include "util/table.h"
+#include "util/thread-pool.h"
+#include "zone-cache.h"
 
 #define CREATE_CMD
 #include "zns.h"
 
 static const char *namespace_id = "Namespace identifier to use";
-static const char dash[100] = { [0 ... 99] = '-' };
+static const char *zone_list = "comma separated zone start LBAs or first-last ranges";
+static const char *zone_file = "file with zone start LBAs or ranges, one or more per line";
+static const char *zone_jobs = "number of commands sent concurrently for a zone list";
+
+static void intr_zns_io(int signum)
+{
+	nvme_io_engine_stop();
+}
 
 static int detect_zns(nvme_ns_t ns, int *out_supported)
 {
@@ -39,10 +53,25 @@ static int detect_zns(nvme_ns_t ns, int *out_supported)
 	return err;
 }
 
-static int print_zns_list_ns(nvme_ns_t ns)
+static const struct nvme_table_column zns_list_cols[] = {
+	{ "Node", 21 },
+	{ "SN", 20 },
+	{ "Model", 40 },
+	{ "Namespace", 9 },
+	{ "Usage", 26 },
+	{ "Format", 16 },
+	{ "FW Rev", 8 },
+};
+
+static int print_zns_list_ns(struct nvme_table *t, nvme_ns_t ns)
 {
+	long long lba = nvme_ns_get_lba_size(ns);
+	double nsze = nvme_ns_get_lba_count(ns) * lba;
+	double nuse = nvme_ns_get_lba_util(ns) * lba;
+	const char *s_suffix, *u_suffix;
+	char path[128];
 	int supported;
-	int err = 0;
+	int err;
 
 	err = detect_zns(ns, &supported);
 	if (err) {
@@ -50,13 +79,26 @@ static int print_zns_list_ns(nvme_ns_t ns)
 		return err;
 	}
 
-	if (supported)
-		nvme_show_list_item(ns);
+	if (!supported)
+		return 0;
 
-	return err;
+	s_suffix = suffix_si_get(&nsze);
+	u_suffix = suffix_si_get(&nuse);
+
+	nvme_dev_full_path(ns, path, sizeof(path));
+	nvme_table_add(t, path);
+	nvme_table_add(t, nvme_ns_get_serial(ns));
+	nvme_table_add(t, nvme_ns_get_model(ns));
+	nvme_table_addf(t, "%#x", nvme_ns_get_nsid(ns));
+	nvme_table_addf(t, "%6.2f %2sB / %6.2f %2sB", nuse, u_suffix, nsze, s_suffix);
+	nvme_table_addf(t, "%3.0f %2sB + %2d B", (double)lba,
+			suffix_binary_get(&lba), nvme_ns_get_meta_size(ns));
+	nvme_table_add(t, nvme_ns_get_firmware(ns));
+
+	return 0;
 }
 
-static int print_zns_list(nvme_root_t nvme_root)
+static int print_zns_list(struct nvme_table *t, nvme_root_t nvme_root)
 {
 	int err = 0;
 	nvme_host_t h;
@@ -67,14 +109,14 @@ static int print_zns_list(nvme_root_t nvme_root)
 	nvme_for_each_host(nvme_root, h) {
 		nvme_for_each_subsystem(h, s) {
 			nvme_subsystem_for_each_ns(s, n) {
-				err = print_zns_list_ns(n);
+				err = print_zns_list_ns(t, n);
 				if (err)
 					return err;
 			}
 
 			nvme_subsystem_for_each_ctrl(s, c) {
 				nvme_ctrl_for_each_ns(c, n) {
-					err = print_zns_list_ns(n);
+					err = print_zns_list_ns(t, n);
 					if (err)
 						return err;
 				}
@@ -88,23 +130,28 @@ static int print_zns_list(nvme_root_t nvme_root)
 static int list(int argc, char **argv, struct command *cmd,
 		struct plugin *plugin)
 {
-	int err = 0;
+	struct nvme_table t;
 	nvme_root_t nvme_root;
+	int err;
 
-	printf("%-21s %-20s %-40s %-9s %-26s %-16s %-8s\n", "Node", "SN",
-	       "Model", "Namespace", "Usage", "Format", "FW Rev");
-	printf("%-.21s %-.20s %-.40s %-.9s %-.26s %-.16s %-.8s\n", dash, dash,
-	       dash, dash, dash, dash, dash);
+	err = nvme_table_init(&t, zns_list_cols, ARRAY_SIZE(zns_list_cols));
+	if (err) {
+		nvme_show_error("table: %s", nvme_strerror(-err));
+		return err;
+	}
 
 	nvme_root = nvme_scan(NULL);
 	if (nvme_root) {
-		err = print_zns_list(nvme_root);
+		err = print_zns_list(&t, nvme_root);
+		if (!err)
+			err = nvme_table_print(&t, stdout);
 		nvme_free_tree(nvme_root);
 	} else {
 		fprintf(stderr, "Failed to scan nvme subsystems\n");
 		err = -errno;
 	}
 
+	nvme_table_free(&t);
 	return err;
 }
 
@@ -223,6 +270,202 @@ close_dev:
 	return err;
 }
 
+static int get_zone_size(int fd, __u32 nsid, __u64 *zsze)
+{
+	struct nvme_zns_id_ns ns;
+	struct nvme_id_ns id_ns;
+	__u8 lbaf;
+	int err;
+
+	err = nvme_identify_ns(fd, nsid, &id_ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return -1;
+	} else if (err < 0) {
+		perror("identify namespace");
+		return -1;
+	}
+
+	err = nvme_zns_identify_ns(fd, nsid, &ns);
+	if (err > 0) {
+		nvme_show_status(err);
+		return -1;
+	} else if (err < 0) {
+		perror("zns identify namespace");
+		return -1;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(id_ns.flbas, &lbaf);
+	*zsze = le64_to_cpu(ns.lbafe[lbaf].zsze);
+	return 0;
+}
+
+struct zone_mgmt_op {
+	struct nvme_zns_mgmt_send_args args;
+	__u32 result;
+	int err;
+};
+
+struct zone_mgmt_list {
+	struct zone_mgmt_op *ops;
+	__u32 nr;
+	__u32 size;
+};
+
+static int zone_list_add(struct zone_mgmt_list *l, __u64 slba)
+{
+	struct zone_mgmt_op *ops;
+
+	if (l->nr == l->size) {
+		l->size = l->size ? 2 * l->size : 64;
+		ops = realloc(l->ops, l->size * sizeof(*ops));
+		if (!ops)
+			return -ENOMEM;
+		l->ops = ops;
+	}
+
+	memset(&l->ops[l->nr], 0, sizeof(*l->ops));
+	l->ops[l->nr++].args.slba = slba;
+	return 0;
+}
+
+/*
+ * Zones are given by their start LBA or as a first-last range of start LBAs,
+ * separated by commas or white space.
+ */
+static int zone_list_parse(struct zone_mgmt_list *l, char *str, __u64 zsze)
+{
+	char *tok, *end, *save = NULL;
+	__u64 first, last, slba;
+	int err;
+
+	for (tok = strtok_r(str, ", \t\n", &save); tok;
+	     tok = strtok_r(NULL, ", \t\n", &save)) {
+		errno = 0;
+		first = strtoull(tok, &end, 0);
+		last = first;
+		if (*end == '-')
+			last = strtoull(end + 1, &end, 0);
+		if (errno || *end || end == tok || last < first) {
+			fprintf(stderr, "invalid zone or zone range: %s\n", tok);
+			return -EINVAL;
+		}
+
+		for (slba = first; ; slba += zsze) {
+			err = zone_list_add(l, slba);
+			if (err)
+				return err;
+			if (last - slba < zsze)
+				break;
+		}
+	}
+
+	return 0;
+}
+
+static int zone_list_parse_file(struct zone_mgmt_list *l, const char *file,
+				__u64 zsze)
+{
+	_cleanup_free_ char *line = NULL;
+	size_t n = 0;
+	FILE *f;
+	int err = 0;
+
+	f = fopen(file, "r");
+	if (!f) {
+		perror(file);
+		return -errno;
+	}
+
+	while (getline(&line, &n, f) > 0) {
+		if (line[0] == '#')
+			continue;
+		err = zone_list_parse(l, line, zsze);
+		if (err)
+			break;
+	}
+
+	fclose(f);
+	return err;
+}
+
+static void zone_mgmt_send_one(void *arg)
+{
+	struct zone_mgmt_op *op = arg;
+
+	op->err = nvme_zns_mgmt_send(&op->args);
+	if (op->err < 0)
+		op->err = -errno;
+}
+
+/*
+ * Send the action in @tmpl to every zone in @zones and @zone_file, with
+ * @jobs commands outstanding. Failed zones are reported one per line once
+ * all commands completed; the first failure is returned.
+ */
+static int zone_mgmt_batch(struct nvme_dev *dev, const char *command,
+			   struct nvme_zns_mgmt_send_args *tmpl, char *zones,
+			   const char *zone_file, __u32 jobs)
+{
+	struct zone_mgmt_list l = { 0 };
+	struct nvme_thread_pool *pool;
+	struct zone_mgmt_op *op;
+	__u32 i, failed = 0;
+	__u64 zsze, slba;
+	int err;
+
+	if (tmpl->select_all) {
+		fprintf(stderr, "--select-all can't be combined with a zone list\n");
+		return -EINVAL;
+	}
+
+	err = get_zone_size(dev_fd(dev), tmpl->nsid, &zsze);
+	if (err)
+		return err;
+	if (!zsze) {
+		fprintf(stderr, "zone size is not reported\n");
+		return -EINVAL;
+	}
+
+	if (zones)
+		err = zone_list_parse(&l, zones, zsze);
+	if (!err && zone_file)
+		err = zone_list_parse_file(&l, zone_file, zsze);
+	if (err)
+		goto free;
+
+	pool = l.nr ? nvme_thread_pool_create(max(min(jobs, l.nr), 1U)) : NULL;
+	for (i = 0; i < l.nr; i++) {
+		op = &l.ops[i];
+		slba = op->args.slba;
+		op->args = *tmpl;
+		op->args.slba = slba;
+		op->args.result = &op->result;
+		if (!pool || nvme_thread_pool_queue(pool, zone_mgmt_send_one, op))
+			zone_mgmt_send_one(op);
+	}
+	nvme_thread_pool_destroy(pool);
+
+	for (i = 0; i < l.nr; i++) {
+		op = &l.ops[i];
+		if (!op->err)
+			continue;
+
+		fprintf(stderr, "%s: zone:%"PRIx64" %s\n", command,
+			(uint64_t)op->args.slba, op->err > 0 ?
+			nvme_status_to_string(op->err, false) :
+			nvme_strerror(-op->err));
+		if (!failed++)
+			err = op->err;
+	}
+
+	printf("%s: %s, action:%d zones:%u failed:%u nsid:%d\n", command,
+	       failed ? "Failed" : "Success", tmpl->zsa, l.nr, failed, tmpl->nsid);
+free:
+	free(l.ops);
+	return err;
+}
+
 static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plugin *plugin,
 	const char *desc, enum nvme_zns_send_action zsa)
 {
@@ -239,15 +482,23 @@ static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plug
 		__u32	namespace_id;
 		bool	select_all;
 		__u32	timeout;
+		char	*zones;
+		char	*zone_file;
+		__u32	jobs;
 	};
 
-	struct config cfg = {};
+	struct config cfg = {
+		.jobs = 1,
+	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
 		OPT_SUFFIX("start-lba",  's', &cfg.zslba,         zslba),
 		OPT_FLAG("select-all",   'a', &cfg.select_all,    select_all),
 		OPT_UINT("timeout",      't', &cfg.timeout,       timeout),
+		OPT_LIST("zones",        'z', &cfg.zones,         zone_list),
+		OPT_FILE("zone-file",    'f', &cfg.zone_file,     zone_file),
+		OPT_UINT("jobs",         'j', &cfg.jobs,          zone_jobs),
 		OPT_END()
 	};
 
@@ -280,6 +531,13 @@ static int zns_mgmt_send(int argc, char **argv, struct command *cmd, struct plug
 		.timeout	= cfg.timeout,
 		.result		= &result,
 	};
+
+	if (cfg.zones || cfg.zone_file) {
+		err = zone_mgmt_batch(dev, command, &args, cfg.zones,
+				      cfg.zone_file, cfg.jobs);
+		goto free;
+	}
+
 	err = nvme_zns_mgmt_send(&args);
 	if (!err) {
 		if (zsa == NVME_ZNS_ZSA_RESET)
@@ -492,9 +750,13 @@ static int open_zone(int argc, char **argv, struct command *cmd, struct plugin *
 		bool	zrwaa;
 		bool	select_all;
 		__u32	timeout;
+		char	*zones;
+		char	*zone_file;
+		__u32	jobs;
 	};
 
 	struct config cfg = {
+		.jobs = 1,
 	};
 
 	OPT_ARGS(opts) = {
@@ -503,6 +765,9 @@ static int open_zone(int argc, char **argv, struct command *cmd, struct plugin *
 		OPT_FLAG("zrwaa",         'r', &cfg.zrwaa,          zrwaa),
 		OPT_FLAG("select-all",   'a', &cfg.select_all,    select_all),
 		OPT_UINT("timeout",      't', &cfg.timeout,       timeout),
+		OPT_LIST("zones",        'z', &cfg.zones,         zone_list),
+		OPT_FILE("zone-file",    'f', &cfg.zone_file,     zone_file),
+		OPT_UINT("jobs",         'j', &cfg.jobs,          zone_jobs),
 		OPT_END()
 	};
 
@@ -531,6 +796,13 @@ static int open_zone(int argc, char **argv, struct command *cmd, struct plugin *
 		.timeout	= cfg.timeout,
 		.result		= NULL,
 	};
+
+	if (cfg.zones || cfg.zone_file) {
+		err = zone_mgmt_batch(dev, "zns-open-zone", &args, cfg.zones,
+				      cfg.zone_file, cfg.jobs);
+		goto close_dev;
+	}
+
 	err = nvme_zns_mgmt_send(&args);
 	if (!err)
 		printf("zns-open-zone: Success zone slba:%"PRIx64" nsid:%d\n",
@@ -723,6 +995,403 @@ close_dev:
 	return err;
 }
 
+struct zrwa_slot {
+	void *buf;
+	__u64 slba;		/* first LBA written, or flushed up to */
+	__u32 nlb;
+	bool flush;
+};
+
+/*
+ * State of a ZRWA write pipeline. Writes go anywhere inside the window of
+ * zrwasz LBAs above the last flush, flushes commit the completed prefix in
+ * multiples of the flush granularity while further writes are in flight.
+ * The engine runs a single thread, so no locking is needed.
+ */
+struct zrwa_pipeline {
+	__u64 zslba;
+	__u64 end;		/* first LBA not written */
+	__u32 nlb;		/* LBAs per write */
+	__u32 zrwasz;
+	__u32 fg;		/* LBAs per flush */
+
+	__u64 write_next;
+	__u64 done_lba;		/* all LBAs below are written */
+	__u64 flushed;		/* all LBAs below are committed */
+	bool flushing;
+	bool failed;
+
+	bool *done;		/* per write of nlb LBAs from zslba */
+	__u64 nr_done;
+
+	struct zrwa_slot *slots;
+	unsigned int nr_slots;
+
+	__u64 written;
+	struct nvme_hist write_lat;
+	struct nvme_hist flush_lat;
+};
+
+/* the engine hands back the slot buffer, which identifies the command */
+static struct zrwa_slot *zrwa_slot(struct zrwa_pipeline *p, void *buf)
+{
+	unsigned int i;
+
+	for (i = 0; i < p->nr_slots; i++) {
+		if (p->slots[i].buf == buf || !p->slots[i].buf) {
+			p->slots[i].buf = buf;
+			return &p->slots[i];
+		}
+	}
+
+	return NULL;
+}
+
+static int zrwa_prep(struct nvme_io_job *job, unsigned int thread, __u64 seq,
+		     struct nvme_passthru_cmd64 *cmd)
+{
+	struct zrwa_pipeline *p = job->priv;
+	struct zrwa_slot *sl = zrwa_slot(p, (void *)(uintptr_t)cmd->addr);
+	__u64 avail = p->done_lba - p->flushed, target = 0;
+	__u32 nlb;
+
+	if (p->failed || !sl)
+		return 1;
+
+	if (!p->flushing && avail) {
+		if (avail >= p->fg)
+			target = p->flushed + avail / p->fg * p->fg;
+		else if (p->done_lba == p->end)
+			target = p->done_lba;
+	}
+
+	if (target) {
+		memset(cmd, 0, sizeof(*cmd));
+		cmd->opcode = nvme_zns_cmd_mgmt_send;
+		cmd->nsid = job->nsid;
+		cmd->cdw10 = (target - 1) & 0xffffffff;
+		cmd->cdw11 = (target - 1) >> 32;
+		cmd->cdw13 = NVME_ZNS_ZSA_ZRWA_FLUSH;
+		sl->flush = true;
+		sl->slba = target;
+		p->flushing = true;
+		return 0;
+	}
+
+	if (p->write_next >= p->end)
+		return p->flushed == p->end ? 1 : NVME_IO_PREP_DEFER;
+
+	nlb = min((__u64)p->nlb, p->end - p->write_next);
+	if (p->write_next + nlb > p->flushed + p->zrwasz)
+		return NVME_IO_PREP_DEFER;
+
+	nvme_io_job_init_cmd(job, p->write_next, cmd);
+	cmd->cdw12 = (nlb - 1) | (job->control << 16);
+	cmd->data_len = nlb * job->lba_size;
+	if (cmd->metadata)
+		cmd->metadata_len = nlb * job->ms;
+	sl->flush = false;
+	sl->slba = p->write_next;
+	sl->nlb = nlb;
+	p->write_next += nlb;
+
+	return 0;
+}
+
+static void zrwa_complete(struct nvme_io_job *job, unsigned int thread,
+			  __u64 seq, void *buf, int status, __u64 result,
+			  __u64 lat_ns)
+{
+	struct zrwa_pipeline *p = job->priv;
+	struct zrwa_slot *sl = zrwa_slot(p, buf);
+
+	if (status) {
+		p->failed = true;
+		return;
+	}
+
+	if (sl->flush) {
+		p->flushed = sl->slba;
+		p->flushing = false;
+		nvme_hist_add(&p->flush_lat, lat_ns);
+		return;
+	}
+
+	p->done[(sl->slba - p->zslba) / p->nlb] = true;
+	while (p->nr_done * p->nlb < p->end - p->zslba && p->done[p->nr_done])
+		p->nr_done++;
+	p->done_lba = min(p->zslba + p->nr_done * p->nlb, p->end);
+	p->written += sl->nlb;
+	nvme_hist_add(&p->write_lat, lat_ns);
+}
+
+static const struct nvme_io_job_ops zrwa_ops = {
+	.prep		= zrwa_prep,
+	.complete	= zrwa_complete,
+};
+
+static int zrwa_write(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Write an empty zone through its Zone Random Write Area,\n"
+		"flushing the ZRWA at the given granularity while further writes\n"
+		"are in flight, and report throughput and latency";
+	const char *zslba = "starting LBA of the zone";
+	const char *data_size = "bytes to write (default: the zone capacity)";
+	const char *block_count = "LBAs per write (default: the flush granularity)";
+	const char *flush_lbas = "LBAs per ZRWA flush, a multiple of zrwafg (default: zrwafg)";
+	const char *queue_depth = "commands in flight";
+	const char *data = "data pattern file";
+
+	_cleanup_free_ struct zrwa_pipeline *p = NULL;
+	_cleanup_free_ void *pattern = NULL;
+	struct nvme_zone_report *report = NULL;
+	struct nvme_zns_id_ns id_zns;
+	enum nvme_print_flags flags;
+	struct nvme_io_stats stats;
+	struct nvme_id_ns ns;
+	struct nvme_dev *dev;
+	__u64 zcap, nr_lbas;
+	int err, dfd, gfd = -1;
+	__u8 lba_index, ms;
+	__u16 zrwafg;
+	ssize_t len;
+
+	struct config {
+		char	*output_format;
+		__u32	namespace_id;
+		__u64	zslba;
+		__u64	data_size;
+		__u32	block_count;
+		__u32	flush_lbas;
+		__u32	queue_depth;
+		char	*data;
+	};
+
+	struct config cfg = {
+		.output_format	= "normal",
+		.queue_depth	= 8,
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id",      'n', &cfg.namespace_id,  namespace_id),
+		OPT_SUFFIX("zslba",           's', &cfg.zslba,         zslba),
+		OPT_SUFFIX("data-size",       'z', &cfg.data_size,     data_size),
+		OPT_UINT("block-count",       'c', &cfg.block_count,   block_count),
+		OPT_UINT("flush-granularity", 'g', &cfg.flush_lbas,    flush_lbas),
+		OPT_UINT("queue-depth",       'q', &cfg.queue_depth,   queue_depth),
+		OPT_FILE("data",              'd', &cfg.data,          data),
+		OPT_FMT("output-format",      'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return errno;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto close_dev;
+
+	if (!cfg.queue_depth) {
+		fprintf(stderr, "queue-depth must be non-zero\n");
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto close_dev;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &ns);
+	if (!err)
+		err = nvme_zns_identify_ns(dev_fd(dev), cfg.namespace_id, &id_zns);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("identify namespace");
+		goto close_dev;
+	}
+
+	if (!(le16_to_cpu(id_zns.ozcs) & 0x2) || !(id_zns.zrwacap & 0x1)) {
+		fprintf(stderr, "the namespace has no ZRWA with explicit flushes\n");
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	p = calloc(1, sizeof(*p));
+	if (!p) {
+		err = -ENOMEM;
+		goto close_dev;
+	}
+
+	zrwafg = le16_to_cpu(id_zns.zrwafg);
+	p->zrwasz = le16_to_cpu(id_zns.zrwasz);
+	p->fg = cfg.flush_lbas ? cfg.flush_lbas : zrwafg;
+	p->nlb = cfg.block_count ? cfg.block_count : p->fg;
+	if (!zrwafg || !p->nlb || p->fg % zrwafg || p->fg % p->nlb ||
+	    p->fg > p->zrwasz || p->nlb > 0x10000) {
+		fprintf(stderr,
+			"flush granularity %u must be a multiple of zrwafg %u and of the %u LBAs per write, and fit the ZRWA of %u LBAs\n",
+			p->fg, zrwafg, p->nlb, p->zrwasz);
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	nvme_id_ns_flbas_to_lbaf_inuse(ns.flbas, &lba_index);
+	struct nvme_io_job job = {
+		.nsid		= cfg.namespace_id,
+		.opcode		= nvme_cmd_write,
+		.slba		= cfg.zslba,
+		.nlb		= p->nlb - 1,
+		.lba_size	= 1 << ns.lbaf[lba_index].ds,
+		.queue_depth	= cfg.queue_depth,
+		.threads	= 1,
+		.nr_ios		= ~0ULL,
+		.ops		= &zrwa_ops,
+		.priv		= p,
+	};
+
+	ms = ns.lbaf[lba_index].ms;
+	if (ms) {
+		if (NVME_FLBAS_META_EXT(ns.flbas))
+			job.lba_size += ms;
+		else
+			job.ms = ms;
+	}
+
+	report = nvme_alloc(sizeof(*report) + sizeof(struct nvme_zns_desc));
+	if (!report) {
+		err = -ENOMEM;
+		goto close_dev;
+	}
+
+	err = nvme_zns_report_zones(dev_fd(dev), cfg.namespace_id, cfg.zslba,
+				    NVME_ZNS_ZRAS_REPORT_ALL, false, true,
+				    sizeof(*report) + sizeof(struct nvme_zns_desc),
+				    report, NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("zns report-zones");
+		goto free_report;
+	}
+
+	if (!le64_to_cpu(report->nr_zones) ||
+	    le64_to_cpu(report->entries[0].zslba) != cfg.zslba ||
+	    report->entries[0].zs >> 4 != NVME_ZNS_ZS_EMPTY) {
+		fprintf(stderr, "LBA %#"PRIx64" is not the start of an empty zone\n",
+			(uint64_t)cfg.zslba);
+		err = -EINVAL;
+		goto free_report;
+	}
+
+	/* the flushes only commit whole granules, so stop at one */
+	zcap = le64_to_cpu(report->entries[0].zcap);
+	nr_lbas = cfg.data_size ? cfg.data_size / (1 << ns.lbaf[lba_index].ds) : zcap;
+	nr_lbas = min(nr_lbas, zcap) / zrwafg * zrwafg;
+	if (!nr_lbas) {
+		fprintf(stderr, "nothing to write\n");
+		err = -EINVAL;
+		goto free_report;
+	}
+
+	p->zslba = cfg.zslba;
+	p->end = cfg.zslba + nr_lbas;
+	p->write_next = p->done_lba = p->flushed = cfg.zslba;
+	p->nr_slots = cfg.queue_depth;
+	nvme_hist_init(&p->write_lat);
+	nvme_hist_init(&p->flush_lat);
+	p->done = calloc((nr_lbas + p->nlb - 1) / p->nlb, sizeof(*p->done));
+	p->slots = calloc(p->nr_slots, sizeof(*p->slots));
+	if (!p->done || !p->slots) {
+		err = -ENOMEM;
+		goto free_pipeline;
+	}
+
+	if (cfg.data) {
+		dfd = open(cfg.data, O_RDONLY);
+		if (dfd < 0) {
+			perror(cfg.data);
+			err = -errno;
+			goto free_pipeline;
+		}
+
+		pattern = nvme_alloc(nvme_io_job_data_len(&job));
+		len = pattern ? read(dfd, pattern, nvme_io_job_data_len(&job)) : -1;
+		close(dfd);
+		if (len < 0) {
+			perror("read");
+			err = -EINVAL;
+			goto free_pipeline;
+		}
+		job.pattern = pattern;
+		job.pattern_len = len;
+	}
+
+	struct nvme_zns_mgmt_send_args args = {
+		.args_size	= sizeof(args),
+		.fd		= dev_fd(dev),
+		.nsid		= cfg.namespace_id,
+		.slba		= cfg.zslba,
+		.zsa		= NVME_ZNS_ZSA_OPEN,
+		.zsaso		= 1,
+		.timeout	= NVME_DEFAULT_IOCTL_TIMEOUT,
+	};
+	err = nvme_zns_mgmt_send(&args);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("zns open-zone");
+		goto free_pipeline;
+	}
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		goto free_pipeline;
+	}
+	job.fd = gfd;
+
+	signal(SIGINT, intr_zns_io);
+	err = nvme_io_engine_run(&job, &stats);
+	signal(SIGINT, SIG_DFL);
+	close(gfd);
+	if (err < 0) {
+		fprintf(stderr, "zns zrwa-write: %s\n", nvme_strerror(-err));
+		goto free_pipeline;
+	}
+
+	if (!stats.uring && cfg.queue_depth > 1)
+		fprintf(stderr,
+			"io_uring passthrough not available, ran with queue depth 1\n");
+
+	/* report the writes, the flushes get their own latency histogram */
+	stats.bytes = p->written * (1 << ns.lbaf[lba_index].ds);
+	stats.lat = p->write_lat;
+	nvme_show_io_stats("zrwa-write", &stats, flags);
+	nvme_show_latency_hist("zrwa-flush", &p->flush_lat, flags);
+	if (p->flushed != p->end)
+		fprintf(stderr, "flushed up to LBA %#"PRIx64" of %#"PRIx64"\n",
+			(uint64_t)p->flushed, (uint64_t)p->end);
+	err = stats.errors ? -EIO : 0;
+
+free_pipeline:
+	free(p->done);
+	free(p->slots);
+free_report:
+	free(report);
+close_dev:
+	dev_close(dev);
+	return err;
+}
+
 static int zone_mgmt_recv(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "Zone Management Receive";
@@ -820,15 +1489,410 @@ close_dev:
 	return err;
 }
 
-static int report_zones(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+struct zone_report_job {
+	int fd;
+	__u32 nsid;
+	int state;
+	bool extended;
+	bool partial;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct zone_report_chunk {
+	struct zone_report_job *job;
+	__u64 slba;
+	__u32 nr;
+	__u32 len;
+	struct nvme_zone_report *report;
+	int err;
+	bool done;
+};
+
+static void zone_report_fetch(void *arg)
 {
-	const char *desc = "Retrieve the Report Zones data structure";
-	const char *zslba = "starting LBA of the zone";
+	struct zone_report_chunk *c = arg;
+	struct zone_report_job *job = c->job;
+	int err;
+
+	err = nvme_zns_report_zones(job->fd, job->nsid, c->slba, job->state,
+				    job->extended, job->partial, c->len,
+				    c->report, NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+
+	pthread_mutex_lock(&job->lock);
+	c->err = err < 0 ? -errno : err;
+	c->done = true;
+	pthread_cond_broadcast(&job->cond);
+	pthread_mutex_unlock(&job->lock);
+}
+
+static void zone_report_queue(struct nvme_thread_pool *pool,
+			      struct zone_report_chunk *c, __u64 slba, __u32 nr,
+			      int zdes)
+{
+	c->slba = slba;
+	c->nr = nr;
+	c->len = sizeof(struct nvme_zone_report) +
+		nr * (sizeof(struct nvme_zns_desc) + zdes);
+	c->err = 0;
+	c->done = false;
+
+	if (nvme_thread_pool_queue(pool, zone_report_fetch, c))
+		zone_report_fetch(c);
+}
+
+/*
+ * Zones are evenly sized, so the start LBA of every chunk of a full report
+ * is known up front. Up to two chunks per job are fetched concurrently and
+ * printed in order as they complete.
+ */
+static int report_zones_parallel(struct zone_report_job *job, __u64 slba,
+				 __u64 zsze, __u32 nr_zones, __u32 chunk,
+				 int zdes, unsigned int jobs,
+				 struct json_object *zone_list,
+				 enum nvme_print_flags flags)
+{
+	__u32 nr_chunks = (nr_zones + chunk - 1) / chunk;
+	__u32 nr_slots = min(2 * jobs, nr_chunks);
+	struct zone_report_chunk *slots, *c;
+	struct nvme_thread_pool *pool;
+	__u32 i, k;
+	int err = 0;
+
+	if (!nr_chunks)
+		return 0;
+
+	slots = calloc(nr_slots, sizeof(*slots));
+	if (!slots)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_slots; i++) {
+		slots[i].job = job;
+		slots[i].report = nvme_alloc(sizeof(struct nvme_zone_report) +
+					     chunk * (sizeof(struct nvme_zns_desc) + zdes));
+		if (!slots[i].report) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
+	pool = nvme_thread_pool_create(min(jobs, nr_slots));
+	if (!pool) {
+		err = -errno;
+		perror("thread pool");
+		goto free;
+	}
+
+	pthread_mutex_init(&job->lock, NULL);
+	pthread_cond_init(&job->cond, NULL);
+
+	for (i = 0; i < nr_slots; i++)
+		zone_report_queue(pool, &slots[i], slba + (__u64)i * chunk * zsze,
+				  min(chunk, nr_zones - i * chunk), zdes);
+
+	for (k = 0; k < nr_chunks; k++) {
+		c = &slots[k % nr_slots];
+
+		pthread_mutex_lock(&job->lock);
+		while (!c->done)
+			pthread_cond_wait(&job->cond, &job->lock);
+		pthread_mutex_unlock(&job->lock);
+
+		if (c->err) {
+			err = c->err;
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				fprintf(stderr, "zns report-zones: %s\n", nvme_strerror(-err));
+			break;
+		}
+
+		nvme_show_zns_report_zones(c->report, c->nr, zdes, c->len,
+					   zone_list, flags);
+		fflush(stdout);
+
+		i = k + nr_slots;
+		if (i < nr_chunks)
+			zone_report_queue(pool, c, slba + (__u64)i * chunk * zsze,
+					  min(chunk, nr_zones - i * chunk), zdes);
+	}
+
+	nvme_thread_pool_destroy(pool);
+	pthread_cond_destroy(&job->cond);
+	pthread_mutex_destroy(&job->lock);
+free:
+	for (i = 0; i < nr_slots; i++)
+		free(slots[i].report);
+	free(slots);
+
+	return err;
+}
+
+#define ZONE_CACHE_CHUNK	1024	/* descriptors printed per call */
+
+/* zone state matching each Zone Receive Action Specific Field filter */
+static const __u8 zone_cache_zrasf_zs[] = {
+	[NVME_ZNS_ZRAS_REPORT_ALL]		= 0,
+	[NVME_ZNS_ZRAS_REPORT_EMPTY]		= NVME_ZNS_ZS_EMPTY,
+	[NVME_ZNS_ZRAS_REPORT_IMPL_OPENED]	= NVME_ZNS_ZS_IMPL_OPEN,
+	[NVME_ZNS_ZRAS_REPORT_EXPL_OPENED]	= NVME_ZNS_ZS_EXPL_OPEN,
+	[NVME_ZNS_ZRAS_REPORT_CLOSED]		= NVME_ZNS_ZS_CLOSED,
+	[NVME_ZNS_ZRAS_REPORT_FULL]		= NVME_ZNS_ZS_FULL,
+	[NVME_ZNS_ZRAS_REPORT_READ_ONLY]	= NVME_ZNS_ZS_READ_ONLY,
+	[NVME_ZNS_ZRAS_REPORT_OFFLINE]		= NVME_ZNS_ZS_OFFLINE,
+};
+
+/* store up to @max descriptors matching @zrasf from @slba in the cache */
+static int zone_cache_fetch(int fd, __u32 nsid, struct zone_cache *c,
+			    __u64 slba, int zrasf, __u64 max,
+			    struct nvme_zone_report *buf, __u32 max_xfer)
+{
+	__u64 zsze = le64_to_cpu(c->hdr->zsze), seen = 0;
+	__u32 nr, i, len;
+	int err;
+
+	while (seen < max) {
+		len = min(max_xfer, sizeof(*buf) +
+			  (max - seen) * sizeof(struct nvme_zns_desc));
+		err = nvme_zns_report_zones(fd, nsid, slba, zrasf, false, true,
+					    len, buf, NVME_DEFAULT_IOCTL_TIMEOUT,
+					    NULL);
+		if (err)
+			return err < 0 ? -errno : err;
+
+		nr = le64_to_cpu(buf->nr_zones);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++) {
+			err = zone_cache_update(c, &buf->entries[i]);
+			if (err)
+				return err;
+		}
+		seen += nr;
+		slba = le64_to_cpu(buf->entries[nr - 1].zslba) + zsze;
+	}
+
+	return 0;
+}
+
+/*
+ * Bring the cache up to date without a full report:
+ *
+ * - zones in the Changed Zone List log were changed by the controller
+ *   (offline, read only, zone descriptor extension, recommended actions)
+ * - zones open or closed in the cache may have been written, finished or
+ *   reset, so each of them is read again
+ * - zones open or closed on the device now are read with a filtered report
+ *
+ * Resets and finishes of zones that were not active are only visible in
+ * the number of zones per state, so those are compared with the cache and
+ * @stale is set if they differ or the log overflowed.
+ */
+static int zone_cache_refresh(int fd, __u32 nsid, struct zone_cache *c,
+			      struct nvme_zone_report *buf, __u32 max_xfer,
+			      bool *stale)
+{
+	static const int active[] = {
+		NVME_ZNS_ZRAS_REPORT_IMPL_OPENED,
+		NVME_ZNS_ZRAS_REPORT_EXPL_OPENED,
+		NVME_ZNS_ZRAS_REPORT_CLOSED,
+	};
+	struct nvme_zns_changed_zone_log log;
+	__u64 nr = zone_cache_nr_zones(c), counts[16], i;
+	__u16 nrzid;
+	__u8 zs;
+	int err;
+
+	*stale = false;
+
+	err = nvme_get_log_zns_changed_zones(fd, nsid, false, &log);
+	if (err)
+		return err < 0 ? -errno : err;
+
+	nrzid = le16_to_cpu(log.nrzid);
+	if (nrzid == 0xffff) {
+		*stale = true;
+		return 0;
+	}
+
+	for (i = 0; i < nrzid; i++) {
+		err = zone_cache_fetch(fd, nsid, c, le64_to_cpu(log.zid[i]),
+				       NVME_ZNS_ZRAS_REPORT_ALL, 1, buf, max_xfer);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < nr; i++) {
+		zs = c->report->entries[i].zs >> 4;
+		if (zs != NVME_ZNS_ZS_IMPL_OPEN && zs != NVME_ZNS_ZS_EXPL_OPEN &&
+		    zs != NVME_ZNS_ZS_CLOSED)
+			continue;
+
+		err = zone_cache_fetch(fd, nsid, c,
+				       le64_to_cpu(c->report->entries[i].zslba),
+				       NVME_ZNS_ZRAS_REPORT_ALL, 1, buf, max_xfer);
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(active); i++) {
+		err = zone_cache_fetch(fd, nsid, c, 0, active[i], nr, buf,
+				       max_xfer);
+		if (err)
+			return err;
+	}
+
+	zone_cache_count(c, counts);
+	for (i = NVME_ZNS_ZRAS_REPORT_EMPTY; i < ARRAY_SIZE(zone_cache_zrasf_zs); i++) {
+		/* a header only report gives the number of matching zones */
+		err = nvme_zns_report_zones(fd, nsid, 0, i, false, false,
+					    sizeof(*buf), buf,
+					    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+		if (err)
+			return err < 0 ? -errno : err;
+
+		if (le64_to_cpu(buf->nr_zones) != counts[zone_cache_zrasf_zs[i]]) {
+			*stale = true;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static int zone_cache_show(struct zone_cache *c, __u64 slba, int num_descs,
+			   int state, enum nvme_print_flags flags)
+{
+	__u64 zsze = le64_to_cpu(c->hdr->zsze), nr = zone_cache_nr_zones(c);
+	__u64 counts[16], total, max, i;
+	struct json_object *zone_list = NULL;
+	struct nvme_zone_report *r;
+	struct nvme_zns_desc *d;
+	__u32 n = 0;
+	__u8 zs;
+
+	if (state < 0 || state >= ARRAY_SIZE(zone_cache_zrasf_zs)) {
+		fprintf(stderr, "invalid zone state filter %d\n", state);
+		return -EINVAL;
+	}
+	zs = zone_cache_zrasf_zs[state];
+
+	zone_cache_count(c, counts);
+	total = zs ? counts[zs] : nr;
+	max = num_descs < 0 ? nr : num_descs;
+
+	r = malloc(sizeof(*r) + ZONE_CACHE_CHUNK * sizeof(*d));
+	if (!r)
+		return -ENOMEM;
+
+	nvme_zns_start_zone_list(total, &zone_list, flags);
+	for (i = slba / zsze; i < nr && max; i++) {
+		d = &c->report->entries[i];
+		if (zs && d->zs >> 4 != zs)
+			continue;
+
+		r->entries[n++] = *d;
+		max--;
+		if (n < ZONE_CACHE_CHUNK && max && i + 1 < nr)
+			continue;
+
+		r->nr_zones = cpu_to_le64(n);
+		nvme_show_zns_report_zones(r, n, 0, sizeof(*r) + n * sizeof(*d),
+					   zone_list, flags);
+		n = 0;
+	}
+	if (n) {
+		r->nr_zones = cpu_to_le64(n);
+		nvme_show_zns_report_zones(r, n, 0, sizeof(*r) + n * sizeof(*d),
+					   zone_list, flags);
+	}
+	nvme_zns_finish_zone_list(total, zone_list, flags);
+	fflush(stdout);
+	free(r);
+
+	return 0;
+}
+
+/*
+ * report-zones --cache: fill the cache file with one full report the first
+ * time, refresh only the zones that changed afterwards, and print from it.
+ */
+static int report_zones_cached(int fd, __u32 nsid, struct nvme_id_ns *id_ns,
+			       __u64 zsze, __u32 max_xfer, const char *path,
+			       bool rebuild, __u64 slba, int num_descs,
+			       int state, enum nvme_print_flags flags)
+{
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	struct nvme_zone_report *buf;
+	struct zone_cache cache;
+	bool stale = rebuild;
+	__u64 nr_zones;
+	int err;
+
+	buf = nvme_alloc_huge(max_xfer, &mh);
+	if (!buf) {
+		perror("alloc");
+		return -ENOMEM;
+	}
+
+	err = nvme_zns_report_zones(fd, nsid, 0, NVME_ZNS_ZRAS_REPORT_ALL,
+				    false, false, sizeof(*buf), buf,
+				    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err) {
+		err = err < 0 ? -errno : err;
+		goto report_err;
+	}
+	nr_zones = le64_to_cpu(buf->nr_zones);
+
+	err = zone_cache_open(&cache, path, nsid, id_ns->nguid, zsze, nr_zones);
+	if (err < 0) {
+		fprintf(stderr, "zone cache %s: %s\n", path, nvme_strerror(-err));
+		return err;
+	}
+	if (err)
+		stale = true;
+
+	err = 0;
+	if (!stale)
+		err = zone_cache_refresh(fd, nsid, &cache, buf, max_xfer, &stale);
+	if (!err && stale)
+		err = zone_cache_fetch(fd, nsid, &cache, 0, NVME_ZNS_ZRAS_REPORT_ALL,
+				       nr_zones, buf, max_xfer);
+	if (err) {
+		zone_cache_close(&cache);
+		goto report_err;
+	}
+
+	err = zone_cache_sync(&cache);
+	if (err)
+		fprintf(stderr, "zone cache %s: %s\n", path, nvme_strerror(-err));
+	else
+		err = zone_cache_show(&cache, slba, num_descs, state, flags);
+
+	zone_cache_close(&cache);
+	return err;
+
+report_err:
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		fprintf(stderr, "zns report-zones: %s\n", nvme_strerror(-err));
+	return err;
+}
+
+static int report_zones(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Retrieve the Report Zones data structure";
+	const char *zslba = "starting LBA of the zone";
 	const char *num_descs = "number of descriptors to retrieve (default: all of them)";
 	const char *state = "state of zones to list";
 	const char *ext = "set to use the extended report zones";
 	const char *part = "set to use the partial report";
 	const char *verbose = "show report zones verbosity";
+	const char *jobs = "number of concurrent report commands for a full report";
+	const char *cache = "zone cache file, refreshed incrementally and reported from";
+	const char *rebuild = "rebuild the zone cache from a full report";
 
 	enum nvme_print_flags flags;
 	int zdes = 0, err = -1;
@@ -837,7 +1901,7 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 	struct nvme_zone_report *report, *buff;
 	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
 
-	unsigned int nr_zones_chunks = 1024,   /* 1024 entries * 64 bytes per entry = 64k byte transfer */
+	unsigned int nr_zones_chunks,
 			nr_zones_retrieved = 0,
 			nr_zones,
 			log_len;
@@ -847,6 +1911,7 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 	struct nvme_id_ns id_ns;
 	uint8_t lbaf;
 	__le64	zsze;
+	__u32 max_xfer;
 	struct json_object *zone_list = NULL;
 
 	struct config {
@@ -858,11 +1923,16 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 		bool  verbose;
 		bool  extended;
 		bool  partial;
+		__u32 jobs;
+		char  *cache;
+		bool  rebuild;
 	};
 
 	struct config cfg = {
 		.output_format = "normal",
 		.num_descs = -1,
+		.jobs = 1,
+		.cache = NULL,
 	};
 
 	OPT_ARGS(opts) = {
@@ -874,6 +1944,9 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 		OPT_FLAG("verbose",       'v', &cfg.verbose,        verbose),
 		OPT_FLAG("extended",      'e', &cfg.extended,       ext),
 		OPT_FLAG("partial",       'p', &cfg.partial,        part),
+		OPT_UINT("jobs",          'j', &cfg.jobs,           jobs),
+		OPT_FILE("cache",         'c', &cfg.cache,          cache),
+		OPT_FLAG("rebuild",       'r', &cfg.rebuild,        rebuild),
 		OPT_END()
 	};
 
@@ -887,6 +1960,18 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 	if (cfg.verbose)
 		flags |= VERBOSE;
 
+	if (cfg.cache && (cfg.extended || cfg.jobs > 1)) {
+		fprintf(stderr, "--cache can't be used with --extended or --jobs\n");
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	if (cfg.jobs > 1 && cfg.state) {
+		fprintf(stderr, "--jobs requires a report of all zones (--state=0)\n");
+		err = -EINVAL;
+		goto close_dev;
+	}
+
 	if (!cfg.namespace_id) {
 		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
 		if (err < 0) {
@@ -919,6 +2004,38 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 		goto close_dev;
 	}
 
+	/*
+	 * Fetch as many descriptors per command as MDTS allows; each chunk is
+	 * printed before the next one is fetched, so memory use doesn't grow
+	 * with the number of zones.
+	 */
+	err = get_max_xfer_len(dev, &max_xfer);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("identify controller");
+		goto close_dev;
+	}
+	nr_zones_chunks = (max_xfer - sizeof(struct nvme_zone_report)) /
+		(sizeof(struct nvme_zns_desc) + zdes);
+
+	if (cfg.cache) {
+		err = report_zones_cached(dev_fd(dev), cfg.namespace_id, &id_ns,
+					  zsze, max_xfer, cfg.cache, cfg.rebuild,
+					  cfg.zslba, cfg.num_descs, cfg.state,
+					  flags);
+		goto close_dev;
+	}
+
+	if (!nr_zones_chunks) {
+		fprintf(stderr,
+			"a zone descriptor with %d bytes of extension exceeds the maximum transfer size %u\n",
+			zdes, max_xfer);
+		err = -EINVAL;
+		goto close_dev;
+	}
+
 	log_len = sizeof(struct nvme_zone_report);
 	buff = calloc(1, log_len);
 	if (!buff) {
@@ -961,6 +2078,21 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 
 	nvme_zns_start_zone_list(total_nr_zones, &zone_list, flags);
 
+	if (cfg.jobs > 1) {
+		struct zone_report_job job = {
+			.fd		= dev_fd(dev),
+			.nsid		= cfg.namespace_id,
+			.state		= cfg.state,
+			.extended	= cfg.extended,
+			.partial	= cfg.partial,
+		};
+
+		err = report_zones_parallel(&job, offset, zsze, nr_zones,
+					    nr_zones_chunks, zdes, cfg.jobs,
+					    zone_list, flags);
+		nr_zones_retrieved = nr_zones;
+	}
+
 	while (nr_zones_retrieved < nr_zones) {
 		if (nr_zones_retrieved >= nr_zones)
 			break;
@@ -980,9 +2112,11 @@ static int report_zones(int argc, char **argv, struct command *cmd, struct plugi
 			break;
 		}
 
-		if (!err)
+		if (!err) {
 			nvme_show_zns_report_zones(report, nr_zones_chunks,
 						   zdes, log_len, zone_list, flags);
+			fflush(stdout);
+		}
 
 		nr_zones_retrieved += nr_zones_chunks;
 		offset = le64_to_cpu(report->entries[nr_zones_chunks-1].zslba) + zsze;
@@ -997,6 +2131,447 @@ close_dev:
 	return err;
 }
 
+static void zone_summary_add(struct nvme_zone_summary *s, struct nvme_zns_desc *d)
+{
+	__u8 zs = d->zs >> 4;
+	__u64 zcap = le64_to_cpu(d->zcap);
+	int i;
+
+	s->zcap += zcap;
+	switch (zs) {
+	case NVME_ZNS_ZS_IMPL_OPEN:
+	case NVME_ZNS_ZS_EXPL_OPEN:
+	case NVME_ZNS_ZS_CLOSED:
+		s->written += le64_to_cpu(d->wp) - le64_to_cpu(d->zslba);
+		break;
+	case NVME_ZNS_ZS_FULL:
+	case NVME_ZNS_ZS_READ_ONLY:
+		/* the write pointer is not valid in these states */
+		s->written += zcap;
+		break;
+	}
+
+	for (i = 0; i < s->nr_states; i++) {
+		if (s->states[i].state == zs) {
+			s->states[i].zones++;
+			return;
+		}
+	}
+}
+
+static int zone_summary(int argc, char **argv, struct command *cmd, struct plugin *plugin)
+{
+	const char *desc = "Count the zones in each zone state and the LBAs written,\n"
+		"without printing the zone descriptors";
+	const char *state = "reporting options filter (zrasf), 0 for all zones";
+
+	static const __u8 zone_states[] = {
+		NVME_ZNS_ZS_EMPTY, NVME_ZNS_ZS_IMPL_OPEN, NVME_ZNS_ZS_EXPL_OPEN,
+		NVME_ZNS_ZS_CLOSED, NVME_ZNS_ZS_FULL, NVME_ZNS_ZS_READ_ONLY,
+		NVME_ZNS_ZS_OFFLINE,
+	};
+
+	_cleanup_huge_ struct nvme_mem_huge mh = { 0, };
+	struct nvme_zone_summary summary = { 0 };
+	struct nvme_zone_report *report;
+	struct nvme_zns_id_ns id_zns;
+	enum nvme_print_flags flags;
+	struct nvme_id_ns id_ns;
+	struct nvme_dev *dev;
+	__u64 slba = 0, seen = 0;
+	__u32 max_xfer, nr, i;
+	uint8_t lbaf;
+	int err = -1;
+
+	struct config {
+		char *output_format;
+		__u32 namespace_id;
+		int   state;
+	};
+
+	struct config cfg = {
+		.output_format = "normal",
+	};
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
+		OPT_UINT("state",        'S', &cfg.state,         state),
+		OPT_FMT("output-format", 'o', &cfg.output_format, output_format),
+		OPT_END()
+	};
+
+	err = parse_and_open(&dev, argc, argv, desc, opts);
+	if (err)
+		return errno;
+
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto close_dev;
+
+	if (!cfg.namespace_id) {
+		err = nvme_get_nsid(dev_fd(dev), &cfg.namespace_id);
+		if (err < 0) {
+			perror("get-namespace-id");
+			goto close_dev;
+		}
+	}
+
+	err = nvme_identify_ns(dev_fd(dev), cfg.namespace_id, &id_ns);
+	if (err) {
+		nvme_show_status(err);
+		goto close_dev;
+	}
+
+	err = nvme_zns_identify_ns(dev_fd(dev), cfg.namespace_id, &id_zns);
+	if (err) {
+		nvme_show_status(err);
+		goto close_dev;
+	}
+	nvme_id_ns_flbas_to_lbaf_inuse(id_ns.flbas, &lbaf);
+
+	summary.nsid = cfg.namespace_id;
+	summary.zsze = le64_to_cpu(id_zns.lbafe[lbaf].zsze);
+	for (i = 0; i < ARRAY_SIZE(zone_states); i++)
+		summary.states[summary.nr_states++].state = zone_states[i];
+
+	err = get_max_xfer_len(dev, &max_xfer);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("identify controller");
+		goto close_dev;
+	}
+
+	report = nvme_alloc_huge(max_xfer, &mh);
+	if (!report) {
+		perror("alloc");
+		err = -ENOMEM;
+		goto close_dev;
+	}
+
+	/* a header only report gives the number of zones matching the filter */
+	err = nvme_zns_report_zones(dev_fd(dev), cfg.namespace_id, 0, cfg.state,
+				    false, false, sizeof(*report), report,
+				    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+	if (err)
+		goto report_err;
+	summary.nr_zones = le64_to_cpu(report->nr_zones);
+
+	/*
+	 * With the partial report bit set nr_zones is the number of descriptors
+	 * returned, so every chunk is aggregated and dropped in one pass.
+	 */
+	while (seen < summary.nr_zones) {
+		err = nvme_zns_report_zones(dev_fd(dev), cfg.namespace_id, slba,
+					    cfg.state, false, true, max_xfer, report,
+					    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+		if (err)
+			goto report_err;
+
+		nr = le64_to_cpu(report->nr_zones);
+		if (!nr)
+			break;
+
+		for (i = 0; i < nr; i++)
+			zone_summary_add(&summary, &report->entries[i]);
+		seen += nr;
+		slba = le64_to_cpu(report->entries[nr - 1].zslba) + summary.zsze;
+	}
+
+	nvme_show_zns_zone_summary(&summary, flags);
+	goto close_dev;
+
+report_err:
+	if (err > 0)
+		nvme_show_status(err);
+	else
+		perror("zns report-zones");
+close_dev:
+	dev_close(dev);
+	return err;
+}
+
+struct zone_append_zone {
+	__u64 slba;
+	__u64 room;		/* LBAs left below the zone capacity */
+};
+
+/*
+ * State of a streaming zone append. The engine runs a single thread, so
+ * prep and complete never run concurrently and need no locking.
+ */
+struct zone_append_stream {
+	int dfd;
+	__u64 zsze;
+	__u32 max_nlb;		/* LBAs per append */
+	struct zone_append_zone *zones;
+	unsigned int nr_zones;
+	unsigned int next;
+	__u64 tail_seq;		/* the only append shorter than max_nlb */
+	__u32 tail_nlb;
+	bool full;		/* input left when all zones were full */
+	__u64 appended;		/* LBAs appended successfully */
+	FILE *lba_log;
+};
+
+static int zone_append_prep(struct nvme_io_job *job, unsigned int thread,
+			    __u64 seq, struct nvme_passthru_cmd64 *cmd)
+{
+	struct zone_append_stream *s = job->priv;
+	char *buf = (char *)(uintptr_t)cmd->addr;
+	__u32 len = s->max_nlb * job->lba_size, n = 0, nlb;
+	struct zone_append_zone *z = NULL;
+	unsigned int i, idx;
+	ssize_t ret;
+
+	while (n < len) {
+		ret = read(s->dfd, buf + n, len - n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!ret)
+			break;
+		n += ret;
+	}
+	if (!n)
+		return 1;
+
+	nlb = (n + job->lba_size - 1) / job->lba_size;
+	if (n < len) {
+		memset(buf + n, 0, nlb * job->lba_size - n);
+		s->tail_seq = seq;
+		s->tail_nlb = nlb;
+	}
+
+	/* round robin over the zones that still have room for this append */
+	for (i = 0; i < s->nr_zones; i++) {
+		idx = (s->next + i) % s->nr_zones;
+		if (s->zones[idx].room >= nlb) {
+			z = &s->zones[idx];
+			s->next = idx + 1;
+			break;
+		}
+	}
+	if (!z) {
+		s->full = true;
+		return 1;
+	}
+	z->room -= nlb;
+
+	nvme_io_job_init_cmd(job, z->slba, cmd);
+	cmd->cdw12 = (nlb - 1) | (job->control << 16);
+	cmd->data_len = nlb * job->lba_size;
+	if (cmd->metadata)
+		cmd->metadata_len = nlb * job->ms;
+
+	return 0;
+}
+
+static void zone_append_complete(struct nvme_io_job *job, unsigned int thread,
+				 __u64 seq, void *buf, int status, __u64 result,
+				 __u64 lat_ns)
+{
+	struct zone_append_stream *s = job->priv;
+	__u32 nlb = seq == s->tail_seq ? s->tail_nlb : s->max_nlb;
+	__u64 first = s->zones[0].slba;
+
+	if (status)
+		return;
+
+	s->appended += nlb;
+	if (s->lba_log)
+		fprintf(s->lba_log, "%#"PRIx64" %#"PRIx64" %u\n",
+			(uint64_t)(first + (result - first) / s->zsze * s->zsze),
+			(uint64_t)result, nlb);
+}
+
+static const struct nvme_io_job_ops zone_append_ops = {
+	.prep		= zone_append_prep,
+	.complete	= zone_append_complete,
+};
+
+/* the room below the zone capacity of the zones appended to */
+static int zone_append_zones(int fd, __u32 nsid, struct zone_append_stream *s,
+			     __u64 zslba, __u32 max_xfer)
+{
+	struct nvme_zone_report *report;
+	struct zone_append_zone *z;
+	struct nvme_zns_desc *d;
+	__u32 i, nr, done = 0;
+	int err = 0;
+
+	report = nvme_alloc(max_xfer);
+	if (!report)
+		return -ENOMEM;
+
+	while (done < s->nr_zones) {
+		err = nvme_zns_report_zones(fd, nsid, zslba, NVME_ZNS_ZRAS_REPORT_ALL,
+					    false, true, max_xfer, report,
+					    NVME_DEFAULT_IOCTL_TIMEOUT, NULL);
+		if (err) {
+			if (err > 0)
+				nvme_show_status(err);
+			else
+				perror("zns report-zones");
+			break;
+		}
+
+		nr = min(le64_to_cpu(report->nr_zones), (__u64)(s->nr_zones - done));
+		if (!nr) {
+			fprintf(stderr, "only %u zones from the start LBA\n", done);
+			err = -EINVAL;
+			break;
+		}
+
+		for (i = 0; i < nr; i++) {
+			d = &report->entries[i];
+			z = &s->zones[done + i];
+			z->slba = le64_to_cpu(d->zslba);
+			switch (d->zs >> 4) {
+			case NVME_ZNS_ZS_EMPTY:
+			case NVME_ZNS_ZS_IMPL_OPEN:
+			case NVME_ZNS_ZS_EXPL_OPEN:
+			case NVME_ZNS_ZS_CLOSED:
+				z->room = z->slba + le64_to_cpu(d->zcap) -
+					le64_to_cpu(d->wp);
+				break;
+			default:
+				z->room = 0;
+				break;
+			}
+		}
+		done += nr;
+		zslba = s->zones[done - 1].slba + s->zsze;
+	}
+
+	free(report);
+	return err;
+}
+
+/*
+ * Stream the input in ZASL sized appends spread round robin over
+ * s->nr_zones zones, with job->queue_depth appends in flight.
+ */
+static int zone_append_run_stream(struct nvme_dev *dev, struct nvme_io_job *job,
+				  struct zone_append_stream *s, __u64 zslba,
+				  __u64 data_size, const char *lba_log,
+				  enum nvme_print_flags flags)
+{
+	struct nvme_zns_id_ctrl ctrl;
+	struct nvme_io_stats stats;
+	__u32 max_xfer, zasl;
+	int err, gfd = -1;
+
+	err = nvme_zns_identify_ctrl(dev_fd(dev), &ctrl);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("zns identify controller");
+		return err;
+	}
+
+	err = get_max_xfer_len(dev, &max_xfer);
+	if (err) {
+		if (err > 0)
+			nvme_show_status(err);
+		else
+			perror("identify controller");
+		return err;
+	}
+
+	err = get_zone_size(dev_fd(dev), job->nsid, &s->zsze);
+	if (err)
+		return err;
+	if (!s->zsze) {
+		fprintf(stderr, "zone size is not reported\n");
+		return -EINVAL;
+	}
+
+	/* ZASL is in units of the minimum memory page size, 0 means MDTS */
+	zasl = max_xfer;
+	if (ctrl.zasl && ctrl.zasl < 20)
+		zasl = min(NVME_LOG_PAGE_PDU_SIZE << ctrl.zasl, max_xfer);
+	if (data_size) {
+		if (data_size > zasl) {
+			fprintf(stderr, "Data size:%#"PRIx64" exceeds the zone append size limit:%#x\n",
+				(uint64_t)data_size, zasl);
+			return -EINVAL;
+		}
+		zasl = data_size;
+	}
+
+	s->max_nlb = min(zasl / job->lba_size, 0x10000U);
+	if (!s->max_nlb) {
+		fprintf(stderr, "zone append size limit below the LBA size\n");
+		return -EINVAL;
+	}
+	s->tail_seq = ~0ULL;
+
+	s->zones = calloc(s->nr_zones, sizeof(*s->zones));
+	if (!s->zones)
+		return -ENOMEM;
+
+	err = zone_append_zones(dev_fd(dev), job->nsid, s, zslba, max_xfer);
+	if (err)
+		goto free;
+
+	if (lba_log) {
+		s->lba_log = fopen(lba_log, "w");
+		if (!s->lba_log) {
+			perror(lba_log);
+			err = -errno;
+			goto free;
+		}
+	}
+
+	gfd = open_generic_dev(dev);
+	if (gfd < 0) {
+		err = -errno;
+		goto close_log;
+	}
+
+	job->fd = gfd;
+	job->opcode = nvme_zns_cmd_append;
+	job->slba = s->zones[0].slba;
+	job->nr_lbas = s->nr_zones * s->zsze;
+	job->nlb = s->max_nlb - 1;
+	job->threads = 1;
+	job->nr_ios = ~0ULL;
+	job->ops = &zone_append_ops;
+	job->priv = s;
+
+	signal(SIGINT, intr_zns_io);
+	err = nvme_io_engine_run(job, &stats);
+	signal(SIGINT, SIG_DFL);
+	if (err < 0) {
+		fprintf(stderr, "zns zone-append: %s\n", nvme_strerror(-err));
+		goto close_gfd;
+	}
+
+	if (!stats.uring && job->queue_depth > 1)
+		fprintf(stderr,
+			"io_uring passthrough not available, ran with queue depth 1\n");
+	if (s->full)
+		fprintf(stderr, "zones are full, the rest of the input was not appended\n");
+
+	stats.bytes = s->appended * job->lba_size;
+	nvme_show_io_stats("zone-append", &stats, flags);
+	err = stats.errors ? -EIO : 0;
+
+close_gfd:
+	close(gfd);
+close_log:
+	if (s->lba_log)
+		fclose(s->lba_log);
+free:
+	free(s->zones);
+	return err;
+}
+
 static int zone_append(int argc, char **argv, struct command *cmd, struct plugin *plugin)
 {
 	const char *desc = "The zone append command is used to write to a zone\n"
@@ -1015,8 +2590,13 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	const char *metadata_size = "size of metadata in bytes";
 	const char *data_size = "size of data in bytes";
 	const char *latency = "output latency statistics";
+	const char *stream = "stream the data in zone append size limit chunks";
+	const char *nr_zones = "number of zones from zslba appended to with --stream";
+	const char *queue_depth = "appends in flight per zone with --stream";
+	const char *lba_log = "file recording the zone, LBA and length of every append";
 
 	int err = -1, dfd = STDIN_FILENO, mfd = STDIN_FILENO;
+	enum nvme_print_flags flags;
 	unsigned int lba_size, meta_size;
 	void *buf = NULL, *mbuf = NULL;
 	__u16 nblocks, control = 0;
@@ -1042,9 +2622,18 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		__u8   prinfo;
 		bool   piremap;
 		bool   latency;
+		bool   stream;
+		__u32  nr_zones;
+		__u32  queue_depth;
+		char  *lba_log;
+		char  *output_format;
 	};
 
-	struct config cfg = {};
+	struct config cfg = {
+		.nr_zones	= 1,
+		.queue_depth	= 4,
+		.output_format	= "normal",
+	};
 
 	OPT_ARGS(opts) = {
 		OPT_UINT("namespace-id", 'n', &cfg.namespace_id,  namespace_id),
@@ -1061,6 +2650,11 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		OPT_BYTE("prinfo",            'p', &cfg.prinfo,        prinfo),
 		OPT_FLAG("piremap",           'P', &cfg.piremap,       piremap),
 		OPT_FLAG("latency",           't', &cfg.latency,       latency),
+		OPT_FLAG("stream",            'S', &cfg.stream,        stream),
+		OPT_UINT("zones",             'Z', &cfg.nr_zones,      nr_zones),
+		OPT_UINT("queue-depth",       'q', &cfg.queue_depth,   queue_depth),
+		OPT_FILE("lba-log",           'L', &cfg.lba_log,       lba_log),
+		OPT_FMT("output-format",      'o', &cfg.output_format, output_format),
 		OPT_END()
 	};
 
@@ -1068,7 +2662,17 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	if (err)
 		return errno;
 
-	if (!cfg.data_size) {
+	err = validate_output_format(cfg.output_format, &flags);
+	if (err < 0)
+		goto close_dev;
+
+	if (cfg.stream && (cfg.metadata || !cfg.nr_zones || !cfg.queue_depth)) {
+		fprintf(stderr, "--stream needs --zones and --queue-depth and can't read --metadata\n");
+		err = -EINVAL;
+		goto close_dev;
+	}
+
+	if (!cfg.data_size && !cfg.stream) {
 		fprintf(stderr, "Append size not provided\n");
 		errno = EINVAL;
 		goto close_dev;
@@ -1099,7 +2703,7 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	}
 
 	meta_size = ns.lbaf[lba_index].ms;
-	if (meta_size && !(meta_size == 8 && (cfg.prinfo & 0x8)) &&
+	if (!cfg.stream && meta_size && !(meta_size == 8 && (cfg.prinfo & 0x8)) &&
 	    (!cfg.metadata_size || cfg.metadata_size % meta_size)) {
 		fprintf(stderr,
 			"Metadata size:%#"PRIx64" not aligned to metadata size:%#x\n",
@@ -1114,6 +2718,14 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		goto close_dev;
 	}
 
+	control |= (cfg.prinfo << 10);
+	if (cfg.limited_retry)
+		control |= NVME_IO_LR;
+	if (cfg.fua)
+		control |= NVME_IO_FUA;
+	if (cfg.piremap)
+		control |= NVME_IO_ZNS_APPEND_PIREMAP;
+
 	if (cfg.data) {
 		dfd = open(cfg.data, O_RDONLY);
 		if (dfd < 0) {
@@ -1122,6 +2734,34 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 		}
 	}
 
+	if (cfg.stream) {
+		struct zone_append_stream zas = {
+			.dfd		= dfd,
+			.nr_zones	= cfg.nr_zones,
+		};
+		struct nvme_io_job job = {
+			.nsid		= cfg.namespace_id,
+			.lba_size	= lba_size,
+			.control	= control,
+			.reftag		= cfg.ref_tag,
+			.apptag		= cfg.lbat,
+			.appmask	= cfg.lbatm,
+			.queue_depth	= cfg.queue_depth * cfg.nr_zones,
+		};
+
+		/* No meta data is transferred for PRACT=1 and MD=8 */
+		if (meta_size && !(meta_size == 8 && (cfg.prinfo & 0x8))) {
+			if (NVME_FLBAS_META_EXT(ns.flbas))
+				job.lba_size += meta_size;
+			else
+				job.ms = meta_size;
+		}
+
+		err = zone_append_run_stream(dev, &job, &zas, cfg.zslba,
+					 cfg.data_size, cfg.lba_log, flags);
+		goto close_dfd;
+	}
+
 	if (posix_memalign(&buf, getpagesize(), cfg.data_size)) {
 		fprintf(stderr, "No memory for data size:%"PRIx64"\n",
 			(uint64_t)cfg.data_size);
@@ -1161,13 +2801,6 @@ static int zone_append(int argc, char **argv, struct command *cmd, struct plugin
 	}
 
 	nblocks = (cfg.data_size / lba_size) - 1;
-	control |= (cfg.prinfo << 10);
-	if (cfg.limited_retry)
-		control |= NVME_IO_LR;
-	if (cfg.fua)
-		control |= NVME_IO_FUA;
-	if (cfg.piremap)
-		control |= NVME_IO_ZNS_APPEND_PIREMAP;
 
 	struct nvme_zns_append_args args = {
 		.args_size	= sizeof(args),
@@ -13,6 +13,7 @@ PLUGIN(NAME("zns", "Zoned Namespace Command Set", NVME_VERSION),
 		ENTRY("id-ctrl", "Send NVMe Identify Zoned Namespace Controller, display structure", id_ctrl)
 		ENTRY("id-ns", "Send NVMe Identify Zoned Namespace Namespace, display structure", id_ns)
 		ENTRY("report-zones", "Report zones associated to a Zoned Namespace", report_zones)
+		ENTRY("zone-summary", "Count zones per zone state without listing them", zone_summary)
 		ENTRY("reset-zone", "Reset one or more zones", reset_zone)
 		ENTRY("close-zone", "Close one or more zones", close_zone)
 		ENTRY("finish-zone", "Finish one or more zones", finish_zone)
@@ -20,6 +21,7 @@ PLUGIN(NAME("zns", "Zoned Namespace Command Set", NVME_VERSION),
 		ENTRY("offline-zone", "Offline one or more zones", offline_zone)
 		ENTRY("set-zone-desc", "Attach zone descriptor extension data to a zone", set_zone_desc)
 		ENTRY("zrwa-flush-zone", "Flush LBAs associated with a ZRWA to a zone.", zrwa_flush_zone)
+		ENTRY("zrwa-write", "Write a zone through its ZRWA with overlapping flushes", zrwa_write)
 		ENTRY("changed-zone-list", "Retrieve the changed zone list log", changed_zone_list)
 		ENTRY("zone-mgmt-recv", "Send the zone management receive command", zone_mgmt_recv)
 		ENTRY("zone-mgmt-send", "Send the zone management send command", zone_mgmt_send)
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common.h"
+#include "zone-cache.h"
+
+static size_t zone_cache_len(__u64 nr_zones)
+{
+	return sizeof(struct zone_cache_hdr) + sizeof(struct nvme_zone_report) +
+		nr_zones * sizeof(struct nvme_zns_desc);
+}
+
+static bool zone_cache_valid(struct zone_cache_hdr *hdr, __u32 nsid,
+			     const __u8 *nguid, __u64 zsze, __u64 nr_zones)
+{
+	return !memcmp(hdr->magic, ZONE_CACHE_MAGIC, sizeof(hdr->magic)) &&
+		le32_to_cpu(hdr->version) == ZONE_CACHE_VERSION &&
+		le32_to_cpu(hdr->nsid) == nsid &&
+		!memcmp(hdr->nguid, nguid, sizeof(hdr->nguid)) &&
+		le64_to_cpu(hdr->zsze) == zsze &&
+		le64_to_cpu(hdr->nr_zones) == nr_zones;
+}
+
+int zone_cache_open(struct zone_cache *c, const char *path, __u32 nsid,
+		    const __u8 *nguid, __u64 zsze, __u64 nr_zones)
+{
+	struct zone_cache_hdr *hdr;
+	struct stat st;
+	bool init;
+	int err;
+
+	if (!zsze)
+		return -EINVAL;
+
+	memset(c, 0, sizeof(*c));
+	c->len = zone_cache_len(nr_zones);
+	c->fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (c->fd < 0)
+		return -errno;
+
+	/* one refresh at a time, readers of a stale file would see torn zones */
+	if (flock(c->fd, LOCK_EX) || fstat(c->fd, &st))
+		goto err;
+
+	init = (size_t)st.st_size != c->len;
+	if (init && (ftruncate(c->fd, 0) || ftruncate(c->fd, c->len)))
+		goto err;
+
+	c->hdr = mmap(NULL, c->len, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+	if (c->hdr == MAP_FAILED) {
+		c->hdr = NULL;
+		goto err;
+	}
+	hdr = c->hdr;
+	c->report = (struct nvme_zone_report *)(hdr + 1);
+
+	/*
+	 * The magic is cleared until zone_cache_sync(), so a refresh that
+	 * fails or is interrupted half way forces a rebuild next time.
+	 */
+	if (!init && zone_cache_valid(hdr, nsid, nguid, zsze, nr_zones)) {
+		memset(hdr->magic, 0, sizeof(hdr->magic));
+		return 0;
+	}
+
+	memset(hdr, 0, c->len);
+	hdr->version = cpu_to_le32(ZONE_CACHE_VERSION);
+	hdr->nsid = cpu_to_le32(nsid);
+	memcpy(hdr->nguid, nguid, sizeof(hdr->nguid));
+	hdr->zsze = cpu_to_le64(zsze);
+	hdr->nr_zones = cpu_to_le64(nr_zones);
+	c->report->nr_zones = cpu_to_le64(nr_zones);
+
+	return 1;
+err:
+	err = -errno;
+	zone_cache_close(c);
+	return err;
+}
+
+void zone_cache_close(struct zone_cache *c)
+{
+	if (c->hdr)
+		munmap(c->hdr, c->len);
+	if (c->fd >= 0)
+		close(c->fd);
+	c->hdr = NULL;
+	c->report = NULL;
+	c->fd = -1;
+}
+
+__u64 zone_cache_nr_zones(struct zone_cache *c)
+{
+	return le64_to_cpu(c->hdr->nr_zones);
+}
+
+struct nvme_zns_desc *zone_cache_lookup(struct zone_cache *c, __u64 zslba)
+{
+	__u64 zsze = le64_to_cpu(c->hdr->zsze);
+	__u64 idx = zslba / zsze;
+
+	if (zslba % zsze || idx >= zone_cache_nr_zones(c))
+		return NULL;
+
+	return &c->report->entries[idx];
+}
+
+int zone_cache_update(struct zone_cache *c, const struct nvme_zns_desc *d)
+{
+	struct nvme_zns_desc *e = zone_cache_lookup(c, le64_to_cpu(d->zslba));
+
+	if (!e)
+		return -ERANGE;
+
+	*e = *d;
+	return 0;
+}
+
+void zone_cache_count(struct zone_cache *c, __u64 counts[16])
+{
+	__u64 i, nr = zone_cache_nr_zones(c);
+
+	memset(counts, 0, 16 * sizeof(*counts));
+	for (i = 0; i < nr; i++)
+		counts[c->report->entries[i].zs >> 4]++;
+}
+
+int zone_cache_sync(struct zone_cache *c)
+{
+	c->hdr->updated = cpu_to_le64(time(NULL));
+	memcpy(c->hdr->magic, ZONE_CACHE_MAGIC, sizeof(c->hdr->magic));
+	if (msync(c->hdr, c->len, MS_SYNC))
+		return -errno;
+
+	return 0;
+}
@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _ZNS_ZONE_CACHE_H
+#define _ZNS_ZONE_CACHE_H
+
+#include <stdbool.h>
+#include <libnvme.h>
+
+/*
+ * Host side copy of the zone descriptors of a namespace, kept in a file so
+ * report-zones can be answered by re-reading only the zones that changed.
+ *
+ * The file is a struct zone_cache_hdr followed by a Report Zones data
+ * structure holding one descriptor per zone, indexed by zslba / zsze, and
+ * is mapped shared so readers see updates in place. All fields are little
+ * endian like the data returned by the controller.
+ */
+#define ZONE_CACHE_MAGIC	"NVMEZONE"
+#define ZONE_CACHE_VERSION	1
+
+struct zone_cache_hdr {
+	char	magic[8];
+	__le32	version;
+	__le32	nsid;
+	__le64	zsze;
+	__le64	nr_zones;
+	__u8	nguid[16];
+	__le64	updated;	/* seconds since the epoch of the last refresh */
+	__u8	rsvd[8];
+};
+
+struct zone_cache {
+	int fd;
+	size_t len;
+	struct zone_cache_hdr *hdr;
+	struct nvme_zone_report *report;
+};
+
+/*
+ * zone_cache_open - map the cache file at @path, creating it if needed
+ *
+ * The namespace is identified by @nsid, @nguid, @zsze and @nr_zones. If the
+ * file describes a different namespace or layout it is reinitialized.
+ *
+ * Returns 0 if the existing zone descriptors are usable, 1 if the cache was
+ * (re)initialized and must be filled from a full report, or a negative
+ * errno.
+ */
+int zone_cache_open(struct zone_cache *c, const char *path, __u32 nsid,
+		    const __u8 *nguid, __u64 zsze, __u64 nr_zones);
+void zone_cache_close(struct zone_cache *c);
+
+/* zone_cache_nr_zones - number of zones covered by the cache */
+__u64 zone_cache_nr_zones(struct zone_cache *c);
+
+/*
+ * zone_cache_update - store a descriptor returned by the controller
+ *
+ * Returns 0, or -ERANGE if the zone start LBA is not covered by the cache.
+ */
+int zone_cache_update(struct zone_cache *c, const struct nvme_zns_desc *d);
+
+/* zone_cache_lookup - descriptor of the zone starting at @zslba or NULL */
+struct nvme_zns_desc *zone_cache_lookup(struct zone_cache *c, __u64 zslba);
+
+/* zone_cache_count - number of cached zones per zone state, indexed by zs */
+void zone_cache_count(struct zone_cache *c, __u64 counts[16]);
+
+/*
+ * zone_cache_sync - mark the cache valid and write the mapping back
+ *
+ * A cache closed without a sync is rebuilt by the next zone_cache_open().
+ */
+int zone_cache_sync(struct zone_cache *c);
+
+#endif /* _ZNS_ZONE_CACHE_H */
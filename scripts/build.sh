@@ -21,6 +21,8 @@ usage() {
     echo "  cross               use cross toolchain to build"
     echo "  coverage            build coverage report"
     echo "  appimage            build AppImage target"
+    echo "  static              static LTO binary with libnvme and"
+    echo "                      json-c from subprojects"
     echo ""
     echo "configs with muon:"
     echo "  [default]           minimal static build"
@@ -115,6 +117,24 @@ config_meson_appimage() {
         "${BUILDDIR}"
 }
 
+config_meson_static() {
+    CC="${CC}" "${MESON}" setup                 \
+        --werror                                \
+        --buildtype="${BUILDTYPE}"              \
+        --wrap-mode=forcefallback               \
+        --default-library=static                \
+        -Db_lto=true                            \
+        -Db_staticpic=false                     \
+        -Dc_link_args="-static"                 \
+        -Djson-c=enabled                        \
+        -Dlibnvme:werror=false                  \
+        -Dlibnvme:tests=false                   \
+        -Dlibnvme:python=disabled               \
+        -Dlibnvme:openssl=disabled              \
+        -Dlibnvme:keyutils=disabled             \
+        "${BUILDDIR}"
+}
+
 build_meson() {
     "${MESON}" compile                          \
         -C "${BUILDDIR}"
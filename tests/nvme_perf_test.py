@@ -0,0 +1,178 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# This file is part of nvme-cli
+#
+""" NVMe performance regression testcase :-
+
+    1. Run the io-bench, verify --range (scrub) and dsm --range (trim)
+       workloads against the namespace of the configuration file.
+    2. Record IOPS, bandwidth and p99 latency of each in perf_results.json
+       of the log directory.
+    3. Compare them with the baselines stored for the model number of the
+       controller and fail on regressions beyond the tolerance.
+
+    The baselines file, "perf_baselines" of config.json, defaults to
+    tests/perf_baselines.json and maps a model number to the metrics of
+    each workload. With NVME_PERF_UPDATE_BASELINE set the results are
+    written there instead of compared, e.g. for a qualified firmware.
+    "perf_tolerance" is the accepted relative regression, 0.1 by default,
+    "perf_runtime" the seconds of each io-bench workload and "perf_range"
+    the LBAs scrubbed and trimmed.
+
+    The write and trim workloads destroy the data of the namespace.
+"""
+
+import json
+import os
+import subprocess
+
+from nvme_test import TestNVMe
+
+
+class TestNVMePerf(TestNVMe):
+
+    """
+    Represents the performance regression testcase.
+
+        - Attributes:
+              - baselines_file : per model baselines.
+              - tolerance : accepted relative regression.
+              - runtime : seconds of each io-bench workload.
+              - lba_range : LBAs of the scrub and trim workloads.
+              - results : metrics of each workload.
+    """
+
+    def setUp(self):
+        """ Pre Section for TestNVMePerf """
+        super().setUp()
+        with open(self.config_file) as data_file:
+            config = json.load(data_file)
+        self.baselines_file = config.get('perf_baselines',
+                                         'tests/perf_baselines.json')
+        self.tolerance = float(config.get('perf_tolerance', 0.1))
+        self.runtime = int(config.get('perf_runtime', 10))
+        self.lba_range = int(config.get('perf_range', 262144))
+        self.results = {}
+        self.setup_log_dir(self.__class__.__name__)
+
+    def tearDown(self):
+        """ Post Section for TestNVMePerf """
+        super().tearDown()
+
+    def exec_json_cmd(self, cmd):
+        """ Wrapper for executing an nvme command printing JSON
+            - Args:
+                - cmd : command line, without the output format.
+            - Returns:
+                - the decoded output of the command.
+        """
+        proc = subprocess.Popen(cmd + " --output-format=json", shell=True,
+                                stdout=subprocess.PIPE, encoding='utf-8')
+        out, _ = proc.communicate()
+        self.assertEqual(proc.returncode, 0, "ERROR : " + cmd + " failed")
+        return json.loads(out)
+
+    def get_model(self):
+        """ Wrapper for extracting the model number and firmware revision.
+            - Args:
+                - None
+            - Returns:
+                - model number and firmware revision of the controller.
+        """
+        id_ctrl = self.exec_json_cmd("nvme id-ctrl " + self.ctrl)
+        return id_ctrl['mn'].strip(), id_ctrl['fr'].strip()
+
+    def run_workload(self, name, cmd):
+        """ Run a workload and record its metrics
+            - Args:
+                - name : workload name, key of the baselines.
+                - cmd : nvme command line of the workload.
+            - Returns:
+                - None
+        """
+        stats = self.exec_json_cmd(cmd)
+        self.assertEqual(stats.get('errors', 0), 0,
+                         "ERROR : " + name + " completed with errors")
+        self.results[name] = {
+            'iops': stats.get('iops', 0),
+            'bytes_per_sec': stats.get('bytes_per_sec', 0),
+            'p99_latency_ns': stats['latency_ns']['p99'],
+        }
+
+    def run_workloads(self):
+        """ Wrapper for the io-bench, scrub and trim workloads
+            - Args:
+                - None
+            - Returns:
+                - None
+        """
+        bench = "nvme io-bench " + self.ns1 + " --runtime=" + \
+            str(self.runtime) + " --io-range=" + str(self.lba_range)
+        self.run_workload("randread-qd32",
+                          bench + " --io-mode=read --random --queue-depth=32")
+        self.run_workload("randread-qd1",
+                          bench + " --io-mode=read --random --queue-depth=1")
+        self.run_workload("randwrite-qd32",
+                          bench + " --io-mode=write --random --queue-depth=32")
+        self.run_workload("scrub", "nvme verify " + self.ns1 +
+                          " --range=0:" + str(self.lba_range))
+        self.run_workload("trim", "nvme dsm " + self.ns1 + " --ad" +
+                          " --range=0:" + str(self.lba_range))
+
+    def load_baselines(self):
+        """ Load the baselines file, empty if there is none """
+        if not os.path.exists(self.baselines_file):
+            return {}
+        with open(self.baselines_file) as data_file:
+            return json.load(data_file)
+
+    def save(self, path, data):
+        """ Write data to path as JSON """
+        with open(path, "w") as data_file:
+            json.dump(data, data_file, indent=4, sort_keys=True)
+            data_file.write("\n")
+
+    def regressions(self, baseline):
+        """ Compare the results with the baseline of the model
+            - Args:
+                - baseline : metrics of each workload.
+            - Returns:
+                - descriptions of the metrics regressed beyond tolerance.
+        """
+        failed = []
+        for name, metrics in self.results.items():
+            if name not in baseline:
+                continue
+            for key, value in metrics.items():
+                ref = baseline[name].get(key)
+                if not ref:
+                    continue
+                # latency regresses upwards, throughput downwards
+                if key.endswith('latency_ns'):
+                    bad = value > ref * (1 + self.tolerance)
+                else:
+                    bad = value < ref * (1 - self.tolerance)
+                if bad:
+                    failed.append("%s %s: %d, baseline %d" %
+                                  (name, key, value, ref))
+        return failed
+
+    def test_perf(self):
+        """ Testcase main """
+        model, firmware = self.get_model()
+        self.run_workloads()
+        self.save(self.test_log_dir + "/perf_results.json",
+                  {'model': model, 'firmware': firmware,
+                   'tolerance': self.tolerance, 'results': self.results})
+
+        baselines = self.load_baselines()
+        if os.getenv('NVME_PERF_UPDATE_BASELINE'):
+            baselines[model] = self.results
+            self.save(self.baselines_file, baselines)
+            return
+
+        if model not in baselines:
+            self.skipTest("no baseline for " + model)
+        failed = self.regressions(baselines[model])
+        self.assertEqual(failed, [], "ERROR : performance regression: " +
+                         "; ".join(failed))
@@ -0,0 +1,113 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Cost of parsing a typical I/O command line: argconfig_parse(), building
+ * the getopt tables on every call, against one argconfig_parser reused
+ * for every argument vector.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../util/argconfig.h"
+#include "nvme/types.h"
+
+#define ROUNDS		200000
+
+static struct {
+	__u32 namespace_id;
+	__u64 start_block;
+	__u16 block_count;
+	__u64 data_size;
+	__u64 metadata_size;
+	__u64 ref_tag;
+	char *data;
+	char *metadata;
+	__u8 prinfo;
+	__u16 app_tag_mask;
+	__u16 app_tag;
+	__u64 storage_tag;
+	bool limited_retry;
+	bool force_unit_access;
+	bool storage_tag_check;
+	__u8 dtype;
+	__u16 dspec;
+	__u8 dsmgmt;
+	bool show;
+	bool dry_run;
+	bool latency;
+	bool force;
+	int verbose;
+	char *output_format;
+} cfg;
+
+static char *args[] = {
+	"read", "/dev/nvme0n1", "--namespace-id=1", "-s", "0x1000",
+	"--block-count=7", "-z", "4096", "--data=/dev/null", "-p", "1",
+	"--force-unit-access", "--latency", "-v",
+};
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	OPT_ARGS(opts) = {
+		OPT_INCR("verbose",           'v', &cfg.verbose,           "verbose"),
+		OPT_FMT("output-format",      'o', &cfg.output_format,     "format"),
+		OPT_UINT("namespace-id",      'n', &cfg.namespace_id,      "nsid"),
+		OPT_SUFFIX("start-block",     's', &cfg.start_block,       "slba"),
+		OPT_SHRT("block-count",       'c', &cfg.block_count,       "nlb"),
+		OPT_SUFFIX("data-size",       'z', &cfg.data_size,         "size"),
+		OPT_SUFFIX("metadata-size",   'y', &cfg.metadata_size,     "msize"),
+		OPT_SUFFIX("ref-tag",         'r', &cfg.ref_tag,           "reftag"),
+		OPT_FILE("data",              'd', &cfg.data,              "data"),
+		OPT_FILE("metadata",          'M', &cfg.metadata,          "meta"),
+		OPT_BYTE("prinfo",            'p', &cfg.prinfo,            "prinfo"),
+		OPT_SHRT("app-tag-mask",      'm', &cfg.app_tag_mask,      "mask"),
+		OPT_SHRT("app-tag",           'a', &cfg.app_tag,           "apptag"),
+		OPT_SUFFIX("storage-tag",     'g', &cfg.storage_tag,       "st"),
+		OPT_FLAG("limited-retry",     'l', &cfg.limited_retry,     "lr"),
+		OPT_FLAG("force-unit-access", 'f', &cfg.force_unit_access, "fua"),
+		OPT_FLAG("storage-tag-check", 'C', &cfg.storage_tag_check, "stc"),
+		OPT_BYTE("dir-type",          'T', &cfg.dtype,             "dtype"),
+		OPT_SHRT("dir-spec",          'S', &cfg.dspec,             "dspec"),
+		OPT_BYTE("dsm",               'D', &cfg.dsmgmt,            "dsm"),
+		OPT_FLAG("show-command",      'V', &cfg.show,              "show"),
+		OPT_FLAG("dry-run",           'w', &cfg.dry_run,           "dry"),
+		OPT_FLAG("latency",           't', &cfg.latency,           "latency"),
+		OPT_FLAG("force",               0, &cfg.force,             "force"),
+		OPT_END()
+	};
+	int argc = sizeof(args) / sizeof(args[0]);
+	struct argconfig_parser p;
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < ROUNDS; i++) {
+		if (argconfig_parse(argc, args, "", opts))
+			return EXIT_FAILURE;
+	}
+	t = now() - t;
+	printf("%-18s %8.0f ns/parse\n", "argconfig_parse", t / ROUNDS * 1e9);
+
+	if (argconfig_parser_init(&p, opts))
+		return EXIT_FAILURE;
+
+	t = now();
+	for (i = 0; i < ROUNDS; i++) {
+		if (argconfig_parser_parse(&p, argc, args, ""))
+			return EXIT_FAILURE;
+	}
+	t = now() - t;
+	printf("%-18s %8.0f ns/parse\n", "argconfig_parser", t / ROUNDS * 1e9);
+
+	argconfig_parser_free(&p);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../util/crc32.h"
+#include "../util/pi.h"
+
+#define BUF_SIZE	(1 << 20)
+#define ROUNDS		256
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, uint32_t (*fn)(uint32_t, const void *, size_t),
+		  const unsigned char *buf)
+{
+	uint32_t crc = 0;
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < ROUNDS; i++)
+		crc = fn(crc, buf, BUF_SIZE);
+	t = now() - t;
+
+	printf("%-10s %8.2f GB/s (%#010x)\n", name,
+	       (double)BUF_SIZE * ROUNDS / t / 1e9, crc);
+}
+
+/* the PI guards are computed per logical block */
+#define PI_WRAPPER(name, fn)						\
+static uint32_t name(uint32_t crc, const void *buf, size_t len)	\
+{									\
+	size_t off;							\
+									\
+	for (off = 0; off < len; off += 4096)				\
+		crc += fn(0, (const char *)buf + off, 4096);		\
+	return crc;							\
+}
+
+PI_WRAPPER(crc16, crc16_t10dif)
+PI_WRAPPER(crc16_sw, crc16_t10dif_sw)
+PI_WRAPPER(crc64, crc64_nvme)
+PI_WRAPPER(crc64_sw, crc64_nvme_sw)
+
+int main(void)
+{
+	unsigned char *buf = malloc(BUF_SIZE);
+	size_t i;
+
+	if (!buf)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = (i * 131 + 17) & 0xff;
+
+	bench("crc32", crc32, buf);
+	bench("crc32 sw", crc32_sw, buf);
+	bench("crc32c", crc32c, buf);
+	bench("crc32c sw", crc32c_sw, buf);
+
+	bench("crc16", crc16, buf);
+	bench("crc16 sw", crc16_sw, buf);
+	bench("crc64", crc64, buf);
+	bench("crc64 sw", crc64_sw, buf);
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,343 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CPU cost of the print_ops: recorded style log pages and identify data
+ * are decoded through the normal, verbose, json and binary printers with
+ * the output sent to /dev/null, reporting ns and allocated bytes per call.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nvme.h"
+#include "nvme-print.h"
+#include "common.h"
+
+#define MIN_RUNTIME_NS	(200 * 1000 * 1000ULL)
+#define NR_ERR_ENTRIES	64
+#define NR_PEL_EVENTS	32
+#define NR_ZONES	1024
+
+/* the print code calls back into nvme.c for these */
+const char *nvme_strerror(int errnum)
+{
+	return strerror(errnum);
+}
+
+bool nvme_is_output_format_json(void)
+{
+	return false;
+}
+
+int get_reg_size(int offset)
+{
+	return sizeof(uint32_t);
+}
+
+bool nvme_is_ctrl_reg(int offset)
+{
+	return false;
+}
+
+/*
+ * Count the bytes allocated by the printers and json-c by forwarding the
+ * allocator entry points to glibc's own implementation.
+ */
+static unsigned long long alloc_bytes, alloc_calls;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+	alloc_bytes += size;
+	alloc_calls++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	alloc_bytes += nmemb * size;
+	alloc_calls++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	alloc_bytes += size;
+	alloc_calls++;
+	return __libc_realloc(ptr, size);
+}
+#define HAVE_ALLOC_STATS	1
+#else
+#define HAVE_ALLOC_STATS	0
+#endif
+
+static struct nvme_smart_log smart;
+static struct nvme_id_ctrl id_ctrl;
+static struct nvme_error_log_page err_log[NR_ERR_ENTRIES];
+static unsigned char *pel;
+static __u32 pel_size;
+static unsigned char *zones;
+static __u32 zones_size;
+
+static __u32 seed = 0x2545f491;
+
+static __u32 next_rand(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+static void fill(void *buf, size_t len)
+{
+	unsigned char *p = buf;
+
+	while (len--)
+		*p++ = next_rand();
+}
+
+static void init_smart(struct nvme_smart_log *s)
+{
+	fill(s, sizeof(*s));
+	s->critical_warning &= 0x1f;
+	s->temperature[0] = 0x3c;
+	s->temperature[1] = 0x01;
+	s->avail_spare = 90;
+	s->spare_thresh = 10;
+	s->percent_used = 3;
+}
+
+static void init_id_ctrl(struct nvme_id_ctrl *c)
+{
+	int i;
+
+	fill(c, sizeof(*c));
+	memcpy(c->sn, "BENCH0123456789     ", sizeof(c->sn));
+	memcpy(c->mn, "nvme-cli bench", 14);
+	memset(c->mn + 14, ' ', sizeof(c->mn) - 14);
+	memcpy(c->fr, "1.0.0   ", sizeof(c->fr));
+	memset(c->subnqn, 0, sizeof(c->subnqn));
+	strcpy(c->subnqn, "nqn.2014-08.org.nvmexpress:bench");
+	c->npss = 4;
+	for (i = 0; i <= c->npss; i++)
+		c->psd[i].flags &= 0x3;
+}
+
+static void init_err_log(void)
+{
+	int i;
+
+	fill(err_log, sizeof(err_log));
+	for (i = 0; i < NR_ERR_ENTRIES; i++) {
+		err_log[i].error_count = cpu_to_le64(NR_ERR_ENTRIES - i);
+		err_log[i].trtype = NVME_TRTYPE_PCIE;
+	}
+}
+
+/* a header followed by alternating SMART and firmware commit events */
+static int init_pel(void)
+{
+	struct nvme_persistent_event_log *head;
+	struct nvme_persistent_event_entry *e;
+	struct nvme_fw_commit_event *fw;
+	__u32 offset = sizeof(*head);
+	__u16 el;
+	int i;
+
+	pel_size = sizeof(*head) + NR_PEL_EVENTS *
+		(sizeof(*e) + sizeof(struct nvme_smart_log)) + 1;
+	pel = calloc(1, pel_size);
+	if (!pel)
+		return -ENOMEM;
+
+	head = (struct nvme_persistent_event_log *)pel;
+	head->lid = NVME_LOG_LID_PERSISTENT_EVENT;
+	head->tnev = cpu_to_le32(NR_PEL_EVENTS);
+	head->rv = 1;
+	head->lhl = sizeof(*head);
+	head->vid = cpu_to_le16(0x1b36);
+	memcpy(head->sn, "BENCH0001", 9);
+	memcpy(head->mn, "nvme-cli bench", 14);
+	memset(head->seb, 0xff, sizeof(head->seb));
+
+	for (i = 0; i < NR_PEL_EVENTS; i++) {
+		e = (struct nvme_persistent_event_entry *)(pel + offset);
+		e->ehl = sizeof(*e) - 3;
+		e->cntlid = cpu_to_le16(1);
+		e->ets = cpu_to_le64(1000 * i);
+		offset += sizeof(*e);
+
+		if (i & 1) {
+			e->etype = NVME_PEL_FW_COMMIT_EVENT;
+			fw = (struct nvme_fw_commit_event *)(pel + offset);
+			memcpy(&fw->old_fw_rev, "1.0.0   ", 8);
+			memcpy(&fw->new_fw_rev, "1.0.1   ", 8);
+			fw->fw_slot = 1;
+			el = sizeof(*fw);
+		} else {
+			e->etype = NVME_PEL_SMART_HEALTH_EVENT;
+			init_smart((struct nvme_smart_log *)(pel + offset));
+			el = sizeof(struct nvme_smart_log);
+		}
+		e->el = cpu_to_le16(el);
+		offset += el;
+	}
+	head->tll = cpu_to_le64(offset);
+
+	return 0;
+}
+
+static int init_zones(void)
+{
+	struct nvme_zone_report *r;
+	struct nvme_zns_desc *d;
+	int i;
+
+	zones_size = sizeof(*r) + NR_ZONES * sizeof(*d);
+	zones = calloc(1, zones_size);
+	if (!zones)
+		return -ENOMEM;
+
+	r = (struct nvme_zone_report *)zones;
+	r->nr_zones = cpu_to_le64(NR_ZONES);
+	for (i = 0; i < NR_ZONES; i++) {
+		d = (struct nvme_zns_desc *)(zones + sizeof(*r)) + i;
+		d->zt = NVME_ZONE_TYPE_SEQWRITE_REQ;
+		d->zs = (i % 4 ? NVME_ZNS_ZS_IMPL_OPEN : NVME_ZNS_ZS_FULL) << 4;
+		d->zcap = cpu_to_le64(0x80000);
+		d->zslba = cpu_to_le64((__u64)i * 0x100000);
+		d->wp = cpu_to_le64((__u64)i * 0x100000 + (i % 4) * 0x1000);
+	}
+
+	return 0;
+}
+
+static void run_smart(enum nvme_print_flags flags)
+{
+	nvme_show_smart_log(&smart, NVME_NSID_ALL, "nvme0", flags);
+}
+
+static void run_id_ctrl(enum nvme_print_flags flags)
+{
+	nvme_show_id_ctrl(&id_ctrl, flags, NULL);
+}
+
+static void run_error(enum nvme_print_flags flags)
+{
+	nvme_show_error_log(err_log, NR_ERR_ENTRIES, "nvme0", flags);
+}
+
+static void run_pel(enum nvme_print_flags flags)
+{
+	nvme_show_persistent_event_log(pel, NVME_PEVENT_LOG_READ, pel_size,
+				       "nvme0", flags);
+}
+
+static void run_zones(enum nvme_print_flags flags)
+{
+	struct json_object *zone_list = NULL;
+
+	nvme_zns_start_zone_list(NR_ZONES, &zone_list, flags);
+	nvme_show_zns_report_zones(zones, NR_ZONES, 0, zones_size, zone_list, flags);
+	nvme_zns_finish_zone_list(NR_ZONES, zone_list, flags);
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(enum nvme_print_flags flags);
+} cases[] = {
+	{ "smart-log",		run_smart },
+	{ "id-ctrl",		run_id_ctrl },
+	{ "error-log",		run_error },
+	{ "persistent-event",	run_pel },
+	{ "zone-report",	run_zones },
+};
+
+static const struct {
+	const char *name;
+	enum nvme_print_flags flags;
+} formats[] = {
+	{ "normal",	NORMAL },
+	{ "verbose",	NORMAL | VERBOSE },
+#ifdef CONFIG_JSONC
+	{ "json",	JSON },
+#endif
+	{ "binary",	BINARY },
+};
+
+static void bench(const char *name, const char *format,
+		  void (*fn)(enum nvme_print_flags), enum nvme_print_flags flags,
+		  int out_fd, int null_fd)
+{
+	unsigned long long bytes, calls, n = 1, i;
+	__u64 start, elapsed;
+
+	/* warm up once, then double the iterations until it runs long enough */
+	dup2(null_fd, STDOUT_FILENO);
+	fn(flags);
+	while (true) {
+		fflush(stdout);
+		bytes = alloc_bytes;
+		calls = alloc_calls;
+		start = monotonic_ns();
+		for (i = 0; i < n; i++)
+			fn(flags);
+		fflush(stdout);
+		elapsed = monotonic_ns() - start;
+		if (elapsed >= MIN_RUNTIME_NS)
+			break;
+		n *= 2;
+	}
+	dup2(out_fd, STDOUT_FILENO);
+
+	printf("%-18s %-8s %12.0f ns/op", name, format, (double)elapsed / n);
+	if (HAVE_ALLOC_STATS)
+		printf(" %12.0f B/op %8.1f allocs/op",
+		       (double)(alloc_bytes - bytes) / n,
+		       (double)(alloc_calls - calls) / n);
+	printf("\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+	int out_fd, null_fd;
+	size_t c, f;
+
+	init_smart(&smart);
+	init_id_ctrl(&id_ctrl);
+	init_err_log();
+	if (init_pel() || init_zones()) {
+		perror("calloc");
+		return EXIT_FAILURE;
+	}
+
+	out_fd = dup(STDOUT_FILENO);
+	null_fd = open("/dev/null", O_WRONLY);
+	if (out_fd < 0 || null_fd < 0) {
+		perror("open");
+		return EXIT_FAILURE;
+	}
+
+	for (c = 0; c < ARRAY_SIZE(cases); c++) {
+		if (argc > 1 && strcmp(argv[1], cases[c].name))
+			continue;
+		for (f = 0; f < ARRAY_SIZE(formats); f++)
+			bench(cases[c].name, formats[f].name, cases[c].fn,
+			      formats[f].flags, out_fd, null_fd);
+	}
+
+	close(null_fd);
+	close(out_fd);
+	free(pel);
+	free(zones);
+
+	return EXIT_SUCCESS;
+}
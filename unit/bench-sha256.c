@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../util/sha256.h"
+
+#define BUF_SIZE	(1 << 20)
+#define ROUNDS		64
+#define MACS		100000
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name,
+		  void (*fn)(const void *, size_t, unsigned char *),
+		  const unsigned char *buf)
+{
+	unsigned char md[SHA256_DIGEST_SIZE];
+	double t;
+	int i;
+
+	t = now();
+	for (i = 0; i < ROUNDS; i++)
+		fn(buf, BUF_SIZE, md);
+	t = now() - t;
+
+	printf("%-16s %8.2f GB/s (%02x%02x%02x%02x)\n", name,
+	       (double)BUF_SIZE * ROUNDS / t / 1e9, md[0], md[1], md[2], md[3]);
+}
+
+/*
+ * An RPMB data frame is MACed from its target byte on, 289 bytes for one
+ * sector, and DH-HMAC-CHAP keys are derived from short secrets and NQNs.
+ */
+static void bench_mac(const char *name, const unsigned char *buf, size_t len)
+{
+	unsigned char md[SHA256_DIGEST_SIZE];
+	struct hmac_sha256_key k;
+	double t;
+	int i;
+
+	hmac_sha256_setkey(&k, "RPMB authentication key", 23);
+
+	t = now();
+	for (i = 0; i < MACS; i++)
+		hmac_sha256_mac(&k, buf, len, md);
+	t = now() - t;
+
+	printf("%-16s %8.0f MACs/s\n", name, MACS / t);
+}
+
+int main(void)
+{
+	unsigned char *buf = malloc(BUF_SIZE);
+	size_t i;
+
+	if (!buf)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = (i * 131 + 17) & 0xff;
+
+	printf("sha256 implementation: %s\n", sha256_impl_name());
+	bench("sha256", sha256, buf);
+	bench("sha256 sw", sha256_sw, buf);
+
+	bench_mac("hmac 64 bytes", buf, 64);
+	bench_mac("hmac rpmb frame", buf, 289);
+	bench_mac("hmac 4k", buf, 4096);
+
+	free(buf);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Exec to exit time of a short nvme invocation such as "nvme version": the
+ * binary given as the first argument is spawned with the remaining
+ * arguments and its output sent to /dev/null until enough runs are
+ * collected, reporting the mean and the fastest run.
+ */
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define MIN_RUNTIME_NS	(1000 * 1000 * 1000ULL)
+#define MIN_RUNS	100
+
+extern char **environ;
+
+static int run_once(char **argv, posix_spawn_file_actions_t *fa, uint64_t *ns)
+{
+	uint64_t start = monotonic_ns();
+	int status;
+	pid_t pid;
+	int err;
+
+	err = posix_spawn(&pid, argv[0], fa, NULL, argv, environ);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", argv[0], strerror(err));
+		return -err;
+	}
+
+	if (waitpid(pid, &status, 0) < 0) {
+		perror("waitpid");
+		return -1;
+	}
+	*ns = monotonic_ns() - start;
+
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "%s exited with %#x\n", argv[0], status);
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	posix_spawn_file_actions_t fa;
+	uint64_t ns, total = 0, fastest = ~0ULL;
+	unsigned long runs = 0;
+	int err = 0, i;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <nvme> [<args>]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	posix_spawn_file_actions_init(&fa);
+	posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null",
+					 O_WRONLY, 0);
+
+	/* the first run pulls the binary and its libraries into the page cache */
+	err = run_once(&argv[1], &fa, &ns);
+	while (!err && (runs < MIN_RUNS || total < MIN_RUNTIME_NS)) {
+		err = run_once(&argv[1], &fa, &ns);
+		if (err)
+			break;
+		total += ns;
+		fastest = min(fastest, ns);
+		runs++;
+	}
+	posix_spawn_file_actions_destroy(&fa);
+
+	if (err)
+		return EXIT_FAILURE;
+
+	for (i = 1; i < argc; i++)
+		printf("%s%s", i > 1 ? " " : "", argv[i]);
+	printf(": %lu runs, %.1f us/run, fastest %.1f us\n", runs,
+	       (double)total / runs / NSEC_PER_USEC,
+	       (double)fastest / NSEC_PER_USEC);
+
+	return EXIT_SUCCESS;
+}
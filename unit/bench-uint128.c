@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../util/types.h"
+
+#define VALS		1024
+#define ROUNDS		2048
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the former formatting, four 32 bit long divisions per digit */
+static char *per_digit(nvme_uint128_t val, char buf[NVME_UINT128_STR_LEN])
+{
+	int idx = NVME_UINT128_STR_LEN;
+	__u64 div, rem;
+	int i;
+
+	buf[--idx] = '\0';
+	do {
+		rem = 0;
+		for (i = 0; i < 4; i++) {
+			rem = rem << 32 | val.words[i];
+			div = rem / 10;
+			rem -= div * 10;
+			val.words[i] = div;
+		}
+		buf[--idx] = '0' + rem;
+	} while (val.words[0] || val.words[1] || val.words[2] || val.words[3]);
+
+	return buf + idx;
+}
+
+static void bench(const char *name,
+		  char *(*fn)(nvme_uint128_t, char [NVME_UINT128_STR_LEN]),
+		  const nvme_uint128_t *vals)
+{
+	char buf[NVME_UINT128_STR_LEN];
+	size_t len = 0;
+	double t;
+	int i, j;
+
+	t = now();
+	for (i = 0; i < ROUNDS; i++)
+		for (j = 0; j < VALS; j++)
+			len += strlen(fn(vals[j], buf));
+	t = now() - t;
+
+	printf("%-12s %8.2f M/s (%zu digits)\n", name,
+	       (double)VALS * ROUNDS / t / 1e6, len);
+}
+
+int main(void)
+{
+	nvme_uint128_t *vals = calloc(VALS, sizeof(*vals));
+	__u32 x = 2463534242;
+	int i, j;
+
+	if (!vals)
+		return EXIT_FAILURE;
+
+	/*
+	 * SMART and OCP counters from a few digits up to the full 128 bits,
+	 * the lower words filled first.
+	 */
+	for (i = 0; i < VALS; i++) {
+		for (j = 3; j >= 3 - i % 4; j--) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			vals[i].words[j] = x;
+		}
+	}
+
+	setlocale(LC_NUMERIC, "");
+
+	bench("per digit", per_digit, vals);
+	bench("str", uint128_t_to_str, vals);
+	bench("l10n str", uint128_t_to_l10n_str, vals);
+
+	free(vals);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _UNIT_CHECK_H
+#define _UNIT_CHECK_H
+
+#include <stdio.h>
+
+/* the exit status of a test, any failed check() sets it */
+static int test_rc;
+
+static inline void check(const char *what, long long res, long long exp)
+{
+	if (res == exp)
+		return;
+
+	printf("ERROR: %s: got %lld, expected %lld\n", what, res, exp);
+	test_rc = 1;
+}
+
+#endif /* _UNIT_CHECK_H */
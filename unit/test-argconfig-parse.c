@@ -143,6 +143,99 @@ void toval_test(struct toval_test *test)
 	check_val(test->arg, &test->exp, test->val, test->size);
 }
 
+/* one parser reused for several argument vectors */
+static void parser_test(void)
+{
+	char *argv1[] = { "test-argconfig", "-f", "-u", "5", "--shrt=3" };
+	char *argv2[] = { "test-argconfig", "--uint=7", "-S", "9" };
+	struct argconfig_parser p;
+	bool flag = false;
+	__u32 uint = 0;
+	__u16 shrt = 0;
+
+	OPT_ARGS(opts) = {
+		OPT_FLAG("flag", 'f', &flag, "flag"),
+		OPT_UINT("uint", 'u', &uint, "uint"),
+		OPT_SHRT("shrt", 'S', &shrt, "shrt"),
+		OPT_END()
+	};
+
+	if (argconfig_parser_init(&p, opts)) {
+		printf("ERROR: parser init failed\n");
+		test_rc = 1;
+		return;
+	}
+
+	if (argconfig_parser_parse(&p, ARRAY_SIZE(argv1), argv1, "") ||
+	    !flag || uint != 5 || shrt != 3) {
+		printf("ERROR: first parse got flag %d uint %u shrt %u\n",
+		       flag, uint, shrt);
+		test_rc = 1;
+	}
+
+	if (argconfig_parser_parse(&p, ARRAY_SIZE(argv2), argv2, "") ||
+	    uint != 7 || shrt != 9 || argconfig_parse_seen(opts, "flag")) {
+		printf("ERROR: second parse got uint %u shrt %u flag seen %d\n",
+		       uint, shrt, argconfig_parse_seen(opts, "flag"));
+		test_rc = 1;
+	}
+
+	argconfig_parser_free(&p);
+}
+
+/* the tables of one call of a command parse into the options of the next */
+static void parser_rebind_test(void)
+{
+	char *argv[] = { "test-argconfig", "-u", "5", "--shrt=3" };
+	struct argconfig_parser p;
+	__u32 uint = 0, uint2 = 0;
+	__u16 shrt = 0, shrt2 = 0;
+	bool flag = false;
+
+	OPT_ARGS(opts) = {
+		OPT_UINT("uint", 'u', &uint, "uint"),
+		OPT_SHRT("shrt", 'S', &shrt, "shrt"),
+		OPT_END()
+	};
+	OPT_ARGS(opts2) = {
+		OPT_UINT("uint", 'u', &uint2, "uint"),
+		OPT_SHRT("shrt", 'S', &shrt2, "shrt"),
+		OPT_END()
+	};
+	OPT_ARGS(other) = {
+		OPT_UINT("uint", 'u', &uint2, "uint"),
+		OPT_SHRT("shrt", 's', &shrt2, "shrt"),
+		OPT_END()
+	};
+	OPT_ARGS(longer) = {
+		OPT_UINT("uint", 'u', &uint2, "uint"),
+		OPT_SHRT("shrt", 'S', &shrt2, "shrt"),
+		OPT_FLAG("flag", 'f', &flag, "flag"),
+		OPT_END()
+	};
+
+	if (argconfig_parser_init(&p, opts)) {
+		printf("ERROR: parser init failed\n");
+		test_rc = 1;
+		return;
+	}
+
+	if (argconfig_parser_rebind(&p, other) || argconfig_parser_rebind(&p, longer)) {
+		printf("ERROR: parser rebound to different options\n");
+		test_rc = 1;
+	}
+
+	if (!argconfig_parser_rebind(&p, opts2) ||
+	    argconfig_parser_parse(&p, ARRAY_SIZE(argv), argv, "") ||
+	    uint2 != 5 || shrt2 != 3 || uint || shrt) {
+		printf("ERROR: rebound parse got uint %u/%u shrt %u/%u\n",
+		       uint, uint2, shrt, shrt2);
+		test_rc = 1;
+	}
+
+	argconfig_parser_free(&p);
+}
+
 int main(void)
 {
 	unsigned int i;
@@ -157,6 +250,9 @@ int main(void)
 	for (i = 0; i < ARRAY_SIZE(toval_tests); i++)
 		toval_test(&toval_tests[i]);
 
+	parser_test();
+	parser_rebind_test();
+
 	if (f)
 		fclose(f);
 
@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/batch.h"
+
+static int test_rc;
+
+/* the expected words of each command are separated by '|' */
+struct batch_test {
+	const char *script;
+	const char *commands[4];
+	unsigned int lines[4];
+	int err;
+};
+
+static const struct batch_test tests[] = {
+	{ "id-ctrl /dev/nvme0\n", { "id-ctrl|/dev/nvme0" }, { 1 } },
+	{ "id-ctrl /dev/nvme0", { "id-ctrl|/dev/nvme0" }, { 1 } },
+	{ "\n\n  # comment\nlist\n", { "list" }, { 4 } },
+	{ "a b\n\tc  d\t\n", { "a|b", "c|d" }, { 1, 2 } },
+	{ "a 'b c' \"d e\"\n", { "a|b c|d e" }, { 1 } },
+	{ "a x'b c'y \"\"\n", { "a|xb cy|" }, { 1 } },
+	{ "a \"\\\"q\\\\\" 'a\\b'\n", { "a|\"q\\|a\\b" }, { 1 } },
+	{ "a b\\ c\n", { "a|b c" }, { 1 } },
+	{ "a b#c # d\n", { "a|b#c" }, { 1 } },
+	{ "a \\\n  b\nc\n", { "a|b", "c" }, { 1, 3 } },
+	{ "a\\\nb\n", { "ab" }, { 1 } },
+	{ "a\r\nb\r\n", { "a", "b" }, { 1, 2 } },
+	{ "a 'b\n", { NULL }, { 0 }, -EINVAL },
+	{ "a \"b\n", { NULL }, { 0 }, -EINVAL },
+};
+
+static void check_command(const struct batch_test *t, char **argv, int argc,
+			  const char *expected)
+{
+	const char *w = expected;
+	size_t len;
+	int i;
+
+	for (i = 0; i < argc; i++) {
+		len = strcspn(w, "|");
+		if (strlen(argv[i]) != len || strncmp(argv[i], w, len)) {
+			printf("ERROR: %s: word %d: got \"%s\", expected \"%.*s\"\n",
+			       t->script, i, argv[i], (int)len, w);
+			test_rc = 1;
+		}
+		w += len + !!w[len];
+	}
+
+	if (argv[argc]) {
+		printf("ERROR: %s: argv not NULL terminated\n", t->script);
+		test_rc = 1;
+	}
+}
+
+static int count_words(const char *expected)
+{
+	int n = 1;
+
+	for (; *expected; expected++)
+		n += *expected == '|';
+
+	return n;
+}
+
+static void run_test(const struct batch_test *t)
+{
+	struct nvme_batch b;
+	char **argv;
+	int i, argc;
+	FILE *f;
+
+	f = fmemopen((void *)t->script, strlen(t->script), "r");
+	if (!f) {
+		perror("fmemopen");
+		test_rc = 1;
+		return;
+	}
+	nvme_batch_init(&b, f);
+
+	for (i = 0; t->commands[i]; i++) {
+		argc = nvme_batch_next(&b, &argv);
+		if (argc != count_words(t->commands[i])) {
+			printf("ERROR: %s: command %d: got %d words, expected %d\n",
+			       t->script, i, argc, count_words(t->commands[i]));
+			test_rc = 1;
+			goto out;
+		}
+		if (b.lineno != t->lines[i]) {
+			printf("ERROR: %s: command %d: line %u, expected %u\n",
+			       t->script, i, b.lineno, t->lines[i]);
+			test_rc = 1;
+		}
+		check_command(t, argv, argc, t->commands[i]);
+	}
+
+	argc = nvme_batch_next(&b, &argv);
+	if (argc != t->err) {
+		printf("ERROR: %s: got %d at the end, expected %d\n", t->script,
+		       argc, t->err);
+		test_rc = 1;
+	}
+out:
+	nvme_batch_free(&b);
+	fclose(f);
+}
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+		run_test(&tests[i]);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
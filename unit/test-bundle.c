@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../util/bundle.h"
+#include "check.h"
+
+struct walk {
+	int nr;
+	char names[4][80];
+	size_t lens[4];
+	unsigned char first[4];
+};
+
+static int walk_capture(const char *name, const void *data, size_t len, void *arg)
+{
+	struct walk *w = arg;
+
+	if (w->nr == 4)
+		return -1;
+	snprintf(w->names[w->nr], sizeof(w->names[0]), "%s", name);
+	w->lens[w->nr] = len;
+	w->first[w->nr] = len ? *(const unsigned char *)data : 0;
+	w->nr++;
+	return 0;
+}
+
+int main(void)
+{
+	char path[] = "/tmp/test-bundle-XXXXXX";
+	struct nvme_bundle_writer *w;
+	struct nvme_bundle_entry e;
+	struct nvme_bundle b;
+	static unsigned char big[3 * 4096 + 100];
+	unsigned char smart[512];
+	struct walk wk = { 0 };
+	const unsigned char *p;
+	struct stat st;
+	size_t len;
+	void *map;
+	int fd, i;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+
+	memset(smart, 0x5a, sizeof(smart));
+	for (i = 0; i < (int)sizeof(big); i++)
+		big[i] = i / 4096 + 1;
+
+	w = nvme_bundle_create(fd);
+	check("create", !!w, 1);
+	memset(&e, 0, sizeof(e));
+	snprintf(e.dev, sizeof(e.dev), "nvme0");
+	snprintf(e.sn, sizeof(e.sn), "S123");
+	snprintf(e.name, sizeof(e.name), "smart-log");
+	e.lid = 0x02;
+	check("add smart", nvme_bundle_add(w, &e, smart, sizeof(smart)), 0);
+	snprintf(e.name, sizeof(e.name), "telemetry-log");
+	e.lid = 0x07;
+	e.timestamp = 1234;
+	check("add telemetry", nvme_bundle_add(w, &e, big, sizeof(big)), 0);
+	snprintf(e.dev, sizeof(e.dev), "nvme1");
+	snprintf(e.name, sizeof(e.name), "smart-log");
+	check("add empty", nvme_bundle_add(w, &e, "", 0), 0);
+	check("close", nvme_bundle_close(w), 0);
+
+	fstat(fd, &st);
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	check("map", map != MAP_FAILED, 1);
+
+	check("is bundle", nvme_bundle_is_bundle(map, st.st_size), 1);
+	check("header only", nvme_bundle_open(&b, map, sizeof(struct nvme_bundle_hdr)),
+	      -EINVAL);
+	check("open", nvme_bundle_open(&b, map, st.st_size), 0);
+	check("nr", b.nr, 3);
+
+	check("find", nvme_bundle_find(&b, "nvme0", "telemetry-log"), 1);
+	check("find any dev", nvme_bundle_find(&b, NULL, "smart-log"), 0);
+	check("find dev", nvme_bundle_find(&b, "nvme1", "smart-log"), 2);
+	check("find prefix", nvme_bundle_find(&b, "nvme", "smart-log"), -ENOENT);
+
+	nvme_bundle_get(&b, 1, &e);
+	check("name", strcmp(e.name, "telemetry-log"), 0);
+	check("sn", strcmp(e.sn, "S123"), 0);
+	check("lid", e.lid, 0x07);
+	check("timestamp", e.timestamp, 1234);
+	check("len", e.len, sizeof(big));
+	check("aligned", ((const unsigned char *)e.data - b.data) % NVME_BUNDLE_ALIGN, 0);
+	check("verify", nvme_bundle_verify(&e), 1);
+
+	p = nvme_bundle_page(&b, 1, 2, &len);
+	check("page", p ? p[0] : 0, 3);
+	check("page len", len, 4096);
+	p = nvme_bundle_page(&b, 1, 3, &len);
+	check("last page", p ? p[0] : 0, 4);
+	check("last page len", len, 100);
+	check("past the end", !!nvme_bundle_page(&b, 1, 4, &len), 0);
+	check("empty page", !!nvme_bundle_page(&b, 2, 0, &len), 0);
+
+	check("walk", nvme_bundle_walk(map, st.st_size, walk_capture, &wk), 0);
+	check("walk nr", wk.nr, 3);
+	check("walk name", strcmp(wk.names[0], "nvme0-smart-log"), 0);
+	check("walk len", wk.lens[1], sizeof(big));
+	check("walk data", wk.first[0], 0x5a);
+	munmap(map, st.st_size);
+
+	/* a corrupt capture fails the walk, a corrupt table the open */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	nvme_bundle_open(&b, map, st.st_size);
+	nvme_bundle_get(&b, 0, &e);
+	((unsigned char *)map)[(const unsigned char *)e.data - b.data] ^= 1;
+	check("bad capture", nvme_bundle_walk(map, st.st_size, walk_capture, &wk), -EBADMSG);
+	((unsigned char *)map)[st.st_size - 1] ^= 1;
+	check("bad table", nvme_bundle_open(&b, map, st.st_size), -EINVAL);
+	munmap(map, st.st_size);
+
+	close(fd);
+	unlink(path);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
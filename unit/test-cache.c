@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "../util/cache.h"
+#include "check.h"
+
+int main(void)
+{
+	char dir[] = "/tmp/test-cache-XXXXXX";
+	char sub[64], path[128], data[32], *p;
+	const char key[] = "key-1", other[] = "key-2";
+	size_t len;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	snprintf(sub, sizeof(sub), "%s/a/b", dir);
+	check("mkdir -p", cache_dir_init(sub), 0);
+	check("existing dir", cache_dir_init(sub), 0);
+	snprintf(path, sizeof(path), "%s/entry", sub);
+
+	check("miss", cache_read(path, key, sizeof(key), data, 5), 0);
+	check("write", cache_write(path, key, sizeof(key), "hello", 5), 0);
+	check("hit", cache_read(path, key, sizeof(key), data, 5), 1);
+	check("data", memcmp(data, "hello", 5), 0);
+	check("other key", cache_read(path, other, sizeof(other), data, 5), 0);
+	check("short data", cache_read(path, key, sizeof(key), data, 4), 0);
+	check("long data", cache_read(path, key, sizeof(key), data, 6), 0);
+
+	check("replace", cache_write(path, key, sizeof(key), "hello world", 11), 0);
+	p = cache_read_alloc(path, key, sizeof(key), &len);
+	check("alloc hit", !!p, 1);
+	check("alloc len", len, 11);
+	check("alloc data", p ? memcmp(p, "hello world", 11) : -1, 0);
+	free(p);
+	check("alloc other key",
+	      !!cache_read_alloc(path, other, sizeof(other), &len), 0);
+
+	/* group writable directories are not trusted */
+	chmod(sub, 0775);
+	check("untrusted dir", cache_dir_init(sub), -1);
+
+	unlink(path);
+	rmdir(sub);
+	snprintf(sub, sizeof(sub), "%s/a", dir);
+	rmdir(sub);
+	rmdir(dir);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/cbor.h"
+
+static int test_rc;
+
+static FILE *f;
+static char *buf;
+static size_t len;
+
+static void start(void)
+{
+	f = open_memstream(&buf, &len);
+	if (!f) {
+		perror("open_memstream");
+		exit(1);
+	}
+}
+
+/* compare the encoding with the hex string @exp from RFC 8949 Appendix A */
+static void check(const char *what, const char *exp)
+{
+	char hex[64] = { 0 };
+	size_t i;
+
+	fclose(f);
+	for (i = 0; i < len && 2 * i + 2 < sizeof(hex); i++)
+		sprintf(hex + 2 * i, "%02x", (unsigned char)buf[i]);
+	free(buf);
+
+	if (strcmp(hex, exp)) {
+		printf("ERROR: %s: got %s, expected %s\n", what, hex, exp);
+		test_rc = 1;
+	}
+}
+
+#define CHECK(call, exp)		\
+	do {				\
+		start();		\
+		call;			\
+		check(#call, exp);	\
+	} while (0)
+
+/* decode the head of the hex string @hex, expecting @major and @val */
+static void check_head(const char *hex, enum cbor_major major, uint64_t val, bool indefinite)
+{
+	struct cbor_reader r;
+	struct cbor_head h;
+	uint8_t data[16];
+	size_t i, n = strlen(hex) / 2;
+
+	for (i = 0; i < n; i++)
+		sscanf(hex + 2 * i, "%2hhx", &data[i]);
+
+	cbor_reader_init(&r, data, n);
+	if (cbor_get_head(&r, &h) || h.major != major || h.val != val ||
+	    h.indefinite != indefinite || r.p != r.end) {
+		printf("ERROR: head of %s: got %d/%llu\n", hex, h.major,
+		       (unsigned long long)h.val);
+		test_rc = 1;
+	}
+}
+
+static void check_double(const char *hex, double exp)
+{
+	struct cbor_reader r;
+	struct cbor_head h;
+	uint8_t data[16];
+	size_t i, n = strlen(hex) / 2;
+
+	for (i = 0; i < n; i++)
+		sscanf(hex + 2 * i, "%2hhx", &data[i]);
+
+	cbor_reader_init(&r, data, n);
+	if (cbor_get_head(&r, &h) || h.major != CBOR_MAJOR_SIMPLE ||
+	    cbor_head_double(&h) != exp) {
+		printf("ERROR: float %s: got %g, expected %g\n", hex,
+		       cbor_head_double(&h), exp);
+		test_rc = 1;
+	}
+}
+
+static void test_reader(void)
+{
+	const uint8_t trunc[] = { 0x19, 0x03 }, reserved[] = { 0x1c };
+	const uint8_t str[] = { 0x64, 'I', 'E', 'T', 'F', 0xff };
+	struct cbor_reader r;
+	struct cbor_head h;
+	const char *p;
+
+	check_head("00", CBOR_MAJOR_UINT, 0, false);
+	check_head("17", CBOR_MAJOR_UINT, 23, false);
+	check_head("1818", CBOR_MAJOR_UINT, 24, false);
+	check_head("1903e8", CBOR_MAJOR_UINT, 1000, false);
+	check_head("1bffffffffffffffff", CBOR_MAJOR_UINT, UINT64_MAX, false);
+	check_head("3903e7", CBOR_MAJOR_NEGINT, 999, false);
+	check_head("a1", CBOR_MAJOR_MAP, 1, false);
+	check_head("9f", CBOR_MAJOR_ARRAY, 0, true);
+
+	check_double("f93c00", 1.0);
+	check_double("f9c400", -4.0);
+	check_double("f90001", 5.960464477539063e-8);
+	check_double("fa47c35000", 100000.0);
+	check_double("fb3ff199999999999a", 1.1);
+
+	cbor_reader_init(&r, trunc, sizeof(trunc));
+	if (!cbor_get_head(&r, &h)) {
+		printf("ERROR: truncated head decoded\n");
+		test_rc = 1;
+	}
+
+	cbor_reader_init(&r, reserved, sizeof(reserved));
+	if (!cbor_get_head(&r, &h)) {
+		printf("ERROR: reserved additional information decoded\n");
+		test_rc = 1;
+	}
+
+	cbor_reader_init(&r, str, sizeof(str));
+	if (cbor_get_head(&r, &h) || h.major != CBOR_MAJOR_TEXT ||
+	    !(p = cbor_get_data(&r, h.val)) || memcmp(p, "IETF", 4) ||
+	    !cbor_get_break(&r) || cbor_get_break(&r) || cbor_get_data(&r, 1)) {
+		printf("ERROR: text string payload\n");
+		test_rc = 1;
+	}
+}
+
+int main(void)
+{
+	CHECK(cbor_put_uint(f, 0), "00");
+	CHECK(cbor_put_uint(f, 23), "17");
+	CHECK(cbor_put_uint(f, 24), "1818");
+	CHECK(cbor_put_uint(f, 1000), "1903e8");
+	CHECK(cbor_put_uint(f, 1000000), "1a000f4240");
+	CHECK(cbor_put_uint(f, 1000000000000ULL), "1b000000e8d4a51000");
+	CHECK(cbor_put_uint(f, UINT64_MAX), "1bffffffffffffffff");
+	CHECK(cbor_put_int(f, -1), "20");
+	CHECK(cbor_put_int(f, -1000), "3903e7");
+	CHECK(cbor_put_int(f, INT64_MIN), "3b7fffffffffffffff");
+	CHECK(cbor_put_double(f, 1.1), "fb3ff199999999999a");
+	CHECK(cbor_put_bool(f, false), "f4");
+	CHECK(cbor_put_bool(f, true), "f5");
+	CHECK(cbor_put_null(f), "f6");
+	CHECK(cbor_put_str(f, ""), "60");
+	CHECK(cbor_put_str(f, "IETF"), "6449455446");
+	CHECK(cbor_put_bytes(f, "\x01\x02\x03\x04", 4), "4401020304");
+
+	/* [1, [2, 3]] */
+	CHECK({ cbor_put_array(f, 2); cbor_put_uint(f, 1);
+		cbor_put_array(f, 2); cbor_put_uint(f, 2); cbor_put_uint(f, 3); },
+	      "8201820203");
+	/* {"a": 1} */
+	CHECK({ cbor_put_map(f, 1); cbor_put_str(f, "a"); cbor_put_uint(f, 1); },
+	      "a1616101");
+	/* {_ "a": [_ 1]} */
+	CHECK({ cbor_open_map(f); cbor_put_str(f, "a"); cbor_open_array(f);
+		cbor_put_uint(f, 1); cbor_put_break(f); cbor_put_break(f); },
+	      "bf61619f01ffff");
+
+	test_reader();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/crc32.h"
+
+static int test_rc;
+
+static void check(const char *what, uint32_t res, uint32_t exp)
+{
+	if (res == exp)
+		return;
+
+	printf("ERROR: %s: got %#010x, expected %#010x\n", what, res, exp);
+	test_rc = 1;
+}
+
+static void check_impl(const char *name,
+		       uint32_t (*fn)(uint32_t, const void *, size_t),
+		       uint32_t (*sw)(uint32_t, const void *, size_t))
+{
+	static unsigned char buf[4096 + 7];
+	char what[64];
+	uint32_t crc;
+	size_t i, off, len;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (i * 131 + 17) & 0xff;
+
+	/* every alignment and tail length against the table version */
+	snprintf(what, sizeof(what), "%s sw/hw", name);
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < 300; len++)
+			check(what, fn(0, buf + off, len), sw(0, buf + off, len));
+		check(what, fn(0, buf + off, 4096), sw(0, buf + off, 4096));
+	}
+
+	/* a checksum may be computed piecewise */
+	snprintf(what, sizeof(what), "%s chained", name);
+	crc = fn(0, buf, 1000);
+	crc = fn(crc, buf + 1000, 3096);
+	check(what, crc, fn(0, buf, 4096));
+}
+
+int main(void)
+{
+	unsigned char zeroes[32] = { 0 };
+	unsigned char ones[32];
+
+	memset(ones, 0xff, sizeof(ones));
+
+	check("crc32 check value", crc32(0, "123456789", 9), 0xcbf43926);
+	check("crc32 sw check value", crc32_sw(0, "123456789", 9), 0xcbf43926);
+	check("crc32 empty", crc32(0, NULL, 0), 0);
+	check("crc32 32 zeroes", crc32(0, zeroes, sizeof(zeroes)), 0x190a55ad);
+
+	/* RFC 3720 B.4 test vectors */
+	check("crc32c check value", crc32c(0, "123456789", 9), 0xe3069283);
+	check("crc32c 32 zeroes", crc32c(0, zeroes, sizeof(zeroes)), 0x8a9136aa);
+	check("crc32c 32 ones", crc32c(0, ones, sizeof(ones)), 0x62a8ab43);
+	check("crc32c empty", crc32c(0, NULL, 0), 0);
+
+	check_impl("crc32", crc32, crc32_sw);
+	check_impl("crc32c", crc32c, crc32c_sw);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../util/histogram.h"
+
+static int test_rc;
+
+static void check(const char *what, uint64_t res, uint64_t lo, uint64_t hi)
+{
+	if (res >= lo && res <= hi)
+		return;
+
+	printf("ERROR: %s: got %llu, expected [%llu, %llu]\n", what,
+	       (unsigned long long)res, (unsigned long long)lo,
+	       (unsigned long long)hi);
+	test_rc = 1;
+}
+
+static void bucket_test(void)
+{
+	uint64_t v;
+	unsigned int idx, last = 0;
+
+	/* every value must land in a bucket whose bounds contain it */
+	for (v = 0; v < (1ULL << 62); v = v * 3 / 2 + 1) {
+		idx = nvme_hist_bucket(v);
+		check("bucket index", idx, last, NVME_HIST_BUCKETS - 1);
+		check("bucket bounds", v, nvme_hist_bucket_low(idx),
+		      nvme_hist_bucket_high(idx));
+		last = idx;
+	}
+
+	check("max bucket", nvme_hist_bucket(UINT64_MAX),
+	      NVME_HIST_BUCKETS - 1, NVME_HIST_BUCKETS - 1);
+}
+
+static void percentile_test(void)
+{
+	struct nvme_hist h, m;
+	uint64_t v;
+
+	nvme_hist_init(&h);
+	check("empty", nvme_hist_percentile(&h, 50), 0, 0);
+
+	/* 1..100000 uniformly, relative error bounded by 1/32 */
+	for (v = 1; v <= 100000; v++)
+		nvme_hist_add(&h, v);
+
+	check("count", h.count, 100000, 100000);
+	check("min", h.min, 1, 1);
+	check("max", h.max, 100000, 100000);
+	check("mean", nvme_hist_mean(&h), 50000, 50001);
+	check("p50", nvme_hist_percentile(&h, 50), 50000, 50000 + 50000 / 32);
+	check("p99", nvme_hist_percentile(&h, 99), 99000, 99000 + 99000 / 32);
+	check("p99.99", nvme_hist_percentile(&h, 99.99), 99990, 100000);
+	check("p100", nvme_hist_percentile(&h, 100), 100000, 100000);
+
+	nvme_hist_init(&m);
+	nvme_hist_add(&m, 1000000);
+	nvme_hist_merge(&m, &h);
+	check("merged count", m.count, 100001, 100001);
+	check("merged max", m.max, 1000000, 1000000);
+	check("merged min", m.min, 1, 1);
+}
+
+int main(void)
+{
+	test_rc = 0;
+
+	bucket_test();
+	percentile_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
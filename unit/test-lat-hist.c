@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../util/lat-hist.h"
+#include "check.h"
+
+/* 10 buckets of 100us, the last one open ended */
+static void fill(struct nvme_lat_hist *h, unsigned int flags, const uint64_t *counts)
+{
+	unsigned int i;
+
+	nvme_lat_hist_init(h, flags);
+	for (i = 0; i < 10; i++)
+		nvme_lat_hist_add_bucket(h, i * 100, i < 9 ? (i + 1) * 100 : NVME_LAT_HIST_INF,
+					 counts[i]);
+}
+
+int main(void)
+{
+	static const uint64_t prev_counts[10] = { 10, 0, 5, 0, 0, 0, 0, 0, 0, 0 };
+	static const uint64_t cur_counts[10] = { 100, 0, 5, 0, 0, 0, 0, 0, 1, 3 };
+	static struct nvme_lat_hist cur, prev, delta, other;
+	int i;
+
+	nvme_lat_hist_init(&cur, 0);
+	check("empty count", nvme_lat_hist_count(&cur), 0);
+	check("empty percentile", nvme_lat_hist_percentile(&cur, 50), 0);
+	check("empty max", nvme_lat_hist_max(&cur), 0);
+
+	for (i = 0; i < NVME_LAT_HIST_MAX_BUCKETS; i++)
+		nvme_lat_hist_add_bucket(&cur, i, i + 1, 0);
+	check("full", nvme_lat_hist_add_bucket(&cur, i, i + 1, 0), -E2BIG);
+
+	fill(&prev, 0, prev_counts);
+	fill(&cur, 0, cur_counts);
+	check("delta", nvme_lat_hist_delta(&delta, &cur, &prev), 0);
+	check("delta count", nvme_lat_hist_count(&delta), 94);
+	check("delta bucket 0", delta.buckets[0].count, 90);
+	check("delta bucket 2", delta.buckets[2].count, 0);
+	check("p50", nvme_lat_hist_percentile(&delta, 50), 100);
+	check("p99", nvme_lat_hist_percentile(&delta, 99), 900);
+	check("p100", nvme_lat_hist_percentile(&delta, 100), 900);
+	check("max", nvme_lat_hist_max(&delta), 900);
+
+	/* counters lower than before were reset */
+	check("reset", nvme_lat_hist_delta(&delta, &prev, &cur), 0);
+	check("reset bucket 0", delta.buckets[0].count, 10);
+	check("reset bucket 9", delta.buckets[9].count, 0);
+
+	fill(&delta, NVME_LAT_HIST_CLEAR_ON_READ, prev_counts);
+	check("clear on read", nvme_lat_hist_delta(&delta, &delta, &cur), 0);
+	check("clear on read count", nvme_lat_hist_count(&delta), 15);
+
+	check("merge", nvme_lat_hist_merge(&cur, &prev), 0);
+	check("merge count", nvme_lat_hist_count(&cur), 124);
+
+	nvme_lat_hist_init(&other, 0);
+	nvme_lat_hist_add_bucket(&other, 0, 50, 1);
+	check("merge layout", nvme_lat_hist_merge(&cur, &other), -EINVAL);
+	check("delta layout", nvme_lat_hist_delta(&delta, &cur, &other), -EINVAL);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
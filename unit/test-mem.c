@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../util/mem.h"
+#include "check.h"
+
+static bool zeroed(const void *p, size_t len)
+{
+	const unsigned char *c = p;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (c[i])
+			return false;
+	return true;
+}
+
+static void test_classes(void)
+{
+	static const size_t lens[] = { 1, 512, 4096, 4097, 65536, 1 << 20 };
+	static const size_t exp[] = { 4096, 4096, 4096, 8192, 65536, 1 << 20 };
+	struct nvme_buf b;
+	size_t i;
+
+	for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+		if (!nvme_buf_get(&b, lens[i])) {
+			check("get", 0, 1);
+			continue;
+		}
+		check("size class", b.len, exp[i]);
+		check("page aligned", (uintptr_t)b.p % getpagesize(), 0);
+		check("cleared", zeroed(b.p, lens[i]), true);
+		nvme_buf_put(&b);
+		check("put clears", b.p == NULL && b.len == 0, true);
+	}
+}
+
+/* a returned buffer is handed out again, cleared for the new length */
+static void test_reuse(void)
+{
+	struct nvme_buf a, b;
+	void *p;
+
+	nvme_buf_pool_drain();
+	p = nvme_buf_get(&a, 8192);
+	memset(p, 0xa5, a.len);
+	nvme_buf_put(&a);
+
+	nvme_buf_get(&b, 6000);
+	check("reused", b.p == p, true);
+	check("reuse cleared", zeroed(b.p, 6000), true);
+	nvme_buf_put(&b);
+	nvme_buf_pool_drain();
+}
+
+/* growing a reused buffer within its class clears what the last user left */
+static void test_resize_reused(void)
+{
+	struct nvme_buf a, b;
+	unsigned char *p;
+
+	nvme_buf_pool_drain();
+	p = nvme_buf_get(&a, 8192);
+	memset(p, 0xa5, a.len);
+	nvme_buf_put(&a);
+
+	p = nvme_buf_get(&b, 5000);
+	memset(p, 1, 5000);
+	p = nvme_buf_resize(&b, 8000);
+	check("resized in place", b.len, 8192);
+	check("reused contents kept", p[4999] == 1, true);
+	check("reused tail cleared", zeroed(p + 5000, 8000 - 5000), true);
+	nvme_buf_put(&b);
+	nvme_buf_pool_drain();
+}
+
+static void test_resize(size_t from, size_t to)
+{
+	struct nvme_buf b;
+	unsigned char *p;
+	size_t i;
+
+	p = nvme_buf_get(&b, from);
+	for (i = 0; i < from; i++)
+		p[i] = i;
+
+	p = nvme_buf_resize(&b, to);
+	if (!p) {
+		check("resize", 0, 1);
+		nvme_buf_put(&b);
+		return;
+	}
+	check("resized", b.len >= to, true);
+	for (i = 0; i < from && p[i] == (unsigned char)i; i++)
+		;
+	check("contents kept", i, from);
+	check("tail cleared", zeroed(p + from, to - from), true);
+	nvme_buf_put(&b);
+}
+
+static void test_realloc(void)
+{
+	unsigned char *p, *q;
+
+	p = nvme_alloc(100);
+	memset(p, 1, 100);
+	q = nvme_realloc(p, 2000);
+	check("realloc in place", p == q, true);
+	check("realloc tail", zeroed(q + 100, 4096 - 100), true);
+
+	p = nvme_realloc(q, 10000);
+	check("realloc grown", p[99] == 1 && zeroed(p + 100, 10000 - 100), true);
+
+	memset(p, 1, 10000);
+	q = nvme_realloc(p, 100);
+	p = nvme_realloc(q, 3000);
+	check("realloc shrunk in place", p == q, true);
+	check("realloc regrown tail", p[99] == 1 && zeroed(p + 100, 3000 - 100), true);
+	free(p);
+}
+
+/* freed huge buffers are reused by the next allocation of a similar size */
+static void test_huge_cache(void)
+{
+	struct nvme_mem_huge_stats s0, s;
+	struct nvme_mem_huge mh;
+	void *p;
+
+	nvme_huge_cache_drain();
+	nvme_huge_cache_stats(&s0);
+
+	p = nvme_alloc_huge(1 << 20, &mh);
+	if (!p) {
+		/* neither HugeTLB nor transparent hugepages available */
+		return;
+	}
+	memset(p, 0x5a, 1 << 20);
+	nvme_free_huge(&mh);
+
+	nvme_huge_cache_stats(&s);
+	check("cached", s.cached > 0, true);
+
+	p = nvme_alloc_huge(900 << 10, &mh);
+	nvme_huge_cache_stats(&s);
+	check("hit", s.hits - s0.hits, 1);
+	check("miss", s.misses - s0.misses, 1);
+	check("huge cleared", p && zeroed(p, 900 << 10), true);
+	nvme_free_huge(&mh);
+
+	/* too small to pin a large cached buffer */
+	nvme_huge_cache_drain();
+	if (nvme_alloc_huge(16 << 20, &mh))
+		nvme_free_huge(&mh);
+	nvme_huge_cache_stats(&s0);
+	p = nvme_alloc_huge(600 << 10, &mh);
+	nvme_huge_cache_stats(&s);
+	check("small miss", s.misses - s0.misses, 1);
+	nvme_free_huge(&mh);
+
+	nvme_huge_cache_drain();
+	nvme_huge_cache_stats(&s);
+	check("drained", s.cached, 0);
+}
+
+int main(void)
+{
+	test_classes();
+	test_reuse();
+	test_resize_reused();
+	test_resize(100, 3000);
+	test_resize(4096, 100000);
+	test_resize(100000, 3 << 20);
+	test_resize(2 << 20, 8 << 20);
+	test_realloc();
+	test_huge_cache();
+	nvme_buf_pool_drain();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../util/bundle.h"
+#include "../util/mock.h"
+#include "check.h"
+
+/* a response to @k with @len bytes of @fill */
+static void add_rsp(struct nvme_bundle_writer *w, const struct nvme_mock_key *k,
+		    int status, uint64_t result, unsigned char fill, uint32_t len)
+{
+	struct nvme_bundle_entry e = { .name = NVME_MOCK_ENTRY };
+	unsigned char buf[sizeof(struct nvme_mock_rec) + 64];
+	struct nvme_mock_rec *r = (void *)buf;
+	int i;
+
+	memset(r, 0, sizeof(*r));
+	r->admin = k->admin;
+	r->opcode = k->opcode;
+	r->nsid = htole32(k->nsid);
+	for (i = 0; i < 6; i++)
+		r->cdw[i] = htole32(k->cdw[i]);
+	r->status = htole32(status);
+	r->data_len = htole32(len);
+	r->result = htole64(result);
+	memset(r + 1, fill, len);
+
+	check("add", nvme_bundle_add(w, &e, buf, sizeof(*r) + len), 0);
+}
+
+int main(void)
+{
+	char path[] = "/tmp/test-mock-XXXXXX";
+	struct nvme_mock_key id = { .admin = true, .opcode = 0x06, .cdw = { 1 } };
+	struct nvme_mock_key feat = { .admin = true, .opcode = 0x0a, .cdw = { 7 } };
+	struct nvme_mock_key rd = { .opcode = 0x02, .nsid = 1, .cdw = { 8, 0, 0 } };
+	struct nvme_mock_key log = { .admin = true, .opcode = 0x02, .nsid = 0xffffffff };
+	struct nvme_bundle_entry e = { .name = "smart-log", .lid = 0x02 };
+	struct nvme_bundle_writer *w;
+	unsigned char smart[512], buf[64];
+	struct nvme_mock *m;
+	uint64_t result;
+	int fd, mfd, i;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < (int)sizeof(smart); i++)
+		smart[i] = i;
+
+	w = nvme_bundle_create(fd);
+	add_rsp(w, &id, 0, 0, 0xaa, 64);
+	add_rsp(w, &feat, 0, 3, 0, 0);
+	add_rsp(w, &feat, 0, 4, 0, 0);
+	add_rsp(w, &rd, 0x281, 0, 0, 0);
+	check("log add", nvme_bundle_add(w, &e, smart, sizeof(smart)), 0);
+	check("close", nvme_bundle_close(w), 0);
+	close(fd);
+
+	check("open", nvme_mock_open(path, 0, &m), 0);
+	check("responses", nvme_mock_nr(m), 4);
+	mfd = nvme_mock_fd(m);
+	check("find", nvme_mock_find(mfd) == m, 1);
+	check("find other", nvme_mock_find(mfd + 1) == NULL, 1);
+
+	/* data past the recorded length reads as zeroes */
+	memset(buf, 0xff, sizeof(buf));
+	check("identify", nvme_mock_submit(m, &id, buf, 32, &result), 0);
+	check("identify data", buf[31], 0xaa);
+	check("identify len", buf[32], 0xff);
+
+	/* the same command gets the recorded responses in turn */
+	check("feature 1", nvme_mock_submit(m, &feat, NULL, 0, &result), 0);
+	check("feature 1 result", result, 3);
+	check("feature 2", nvme_mock_submit(m, &feat, NULL, 0, &result), 0);
+	check("feature 2 result", result, 4);
+	check("feature 3", nvme_mock_submit(m, &feat, NULL, 0, &result), 0);
+	check("feature 3 result", result, 4);
+
+	check("read error", nvme_mock_submit(m, &rd, NULL, 0, &result), 0x281);
+
+	/* 8 bytes of the SMART log capture at offset 16 */
+	log.cdw[0] = 0x02 | ((8 / 4 - 1) << 16);
+	log.cdw[2] = 16;
+	check("log", nvme_mock_submit(m, &log, buf, 8, &result), 0);
+	check("log data", buf[0], 16);
+	check("log data end", buf[7], 23);
+	log.cdw[2] = 1024;
+	check("log offset", nvme_mock_submit(m, &log, buf, 8, &result),
+	      NVME_MOCK_SC_NO_MATCH);
+
+	id.cdw[0] = 2;
+	check("no match", nvme_mock_submit(m, &id, buf, 8, &result), NVME_MOCK_SC_NO_MATCH);
+
+	nvme_mock_close(m);
+	check("closed", nvme_mock_find(mfd) == NULL, 1);
+	check("not a bundle", nvme_mock_open("/dev/null", 0, &m), -EINVAL);
+
+	unlink(path);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
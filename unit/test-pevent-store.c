@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../util/pevent-store.h"
+#include "check.h"
+
+/* an entry of @type at @ts with @el bytes of event data filled with @fill */
+static size_t add_entry(uint8_t *buf, size_t off, uint8_t type, uint64_t ts,
+			uint16_t el, uint8_t fill)
+{
+	uint8_t *e = buf + off;
+	int i;
+
+	memset(e, 0, 24);
+	e[0] = type;
+	e[2] = 21;
+	for (i = 0; i < 8; i++)
+		e[6 + i] = ts >> (8 * i);
+	e[22] = el;
+	e[23] = el >> 8;
+	memset(e + 24, fill, el);
+
+	return off + 24 + el;
+}
+
+struct matches {
+	uint64_t nr[16];
+	uint8_t type[16];
+	int n;
+};
+
+static int collect(const void *entry, uint32_t len, uint64_t nr, void *data)
+{
+	struct matches *m = data;
+
+	if (m->n < 16) {
+		m->nr[m->n] = nr;
+		m->type[m->n] = ((const uint8_t *)entry)[0];
+	}
+	m->n++;
+
+	return 0;
+}
+
+static int query(struct nvme_pevent_store *s, uint64_t since, uint64_t until,
+		 int type, struct matches *m)
+{
+	struct nvme_pevent_query q = { .since = since, .until = until };
+
+	if (type >= 0)
+		q.types[type / 8] |= 1 << (type % 8);
+	memset(m, 0, sizeof(*m));
+
+	return nvme_pevent_store_query(s, &q, collect, m);
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/test-pevent-store-XXXXXX";
+	struct nvme_pevent_store s;
+	uint8_t buf[1024];
+	struct matches m;
+	char path[128];
+	size_t len, half;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	check("no store", nvme_pevent_store_open(&s, dir, false), -ENOENT);
+
+	len = add_entry(buf, 0, 0x1, 1000, 8, 0xa);
+	len = add_entry(buf, len, 0xd, 2000, 4, 0xb);
+	len = add_entry(buf, len, 0x2, 3000, 16, 0xc);
+	half = len;
+	len = add_entry(buf, len, 0xd, 4000, 4, 0xd);
+
+	check("open", nvme_pevent_store_open(&s, dir, true), 0);
+	check("append", nvme_pevent_store_append(&s, buf, half), 3);
+	check("append again", nvme_pevent_store_append(&s, buf, half), 0);
+	/* a truncated entry at the end is left for the next time */
+	check("append more", nvme_pevent_store_append(&s, buf, len - 1), 0);
+	check("append rest", nvme_pevent_store_append(&s, buf, len), 1);
+	nvme_pevent_store_close(&s);
+
+	check("reopen", nvme_pevent_store_open(&s, dir, false), 0);
+	check("all", query(&s, 0, 0, -1, &m), 4);
+	check("thermal", query(&s, 0, 0, 0xd, &m), 2);
+	check("thermal 1st", m.nr[0], 1);
+	check("thermal 2nd", m.nr[1], 3);
+	check("since", query(&s, 2500, 0, -1, &m), 2);
+	check("since 1st", m.nr[0], 2);
+	check("range", query(&s, 2000, 3000, -1, &m), 2);
+	check("range type", query(&s, 2000, 3000, 0x2, &m), 1);
+	check("range type 1st", m.type[0], 0x2);
+	check("append read only", nvme_pevent_store_append(&s, buf, len), -EBADF);
+	nvme_pevent_store_close(&s);
+
+	/*
+	 * The front of the log was dropped, and with it the last stored
+	 * entry, so only the entries with newer timestamps are added.
+	 */
+	len = add_entry(buf, 0, 0x2, 3000, 16, 0xc);
+	len = add_entry(buf, len, 0x1, 5000, 8, 0xe);
+	len = add_entry(buf, len, 0x3, 500, 16, 0xf);
+	check("open wrapped", nvme_pevent_store_open(&s, dir, true), 0);
+	check("append wrapped", nvme_pevent_store_append(&s, buf, len), 1);
+
+	/* a clock reset, the index is scanned for queries then */
+	len = add_entry(buf, 0, 0x1, 5000, 8, 0xe);
+	len = add_entry(buf, len, 0x3, 500, 16, 0xf);
+	check("append reset", nvme_pevent_store_append(&s, buf, len), 1);
+	check("unsorted", !!(s.flags & NVME_PEVENT_STORE_UNSORTED), 1);
+	check("unsorted since", query(&s, 600, 0, -1, &m), 5);
+	check("unsorted range", query(&s, 0, 1000, -1, &m), 2);
+	check("unsorted range 2nd", m.nr[1], 5);
+	nvme_pevent_store_close(&s);
+
+	snprintf(path, sizeof(path), "%s/index", dir);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s/events", dir);
+	unlink(path);
+	rmdir(dir);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
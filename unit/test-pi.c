@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/pi.h"
+
+static int test_rc;
+
+static void check(const char *what, unsigned long long res, unsigned long long exp)
+{
+	if (res == exp)
+		return;
+
+	printf("ERROR: %s: got %#llx, expected %#llx\n", what, res, exp);
+	test_rc = 1;
+}
+
+static void crc_test(void)
+{
+	static unsigned char buf[4096 + 7];
+	size_t i, off, len;
+
+	check("crc16 check value", crc16_t10dif(0, "123456789", 9), 0xd0db);
+	check("crc64 check value", crc64_nvme(0, "123456789", 9), 0xae8b14860a799888ULL);
+	check("crc16 sw check value", crc16_t10dif_sw(0, "123456789", 9), 0xd0db);
+	check("crc64 sw check value", crc64_nvme_sw(0, "123456789", 9),
+	      0xae8b14860a799888ULL);
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (i * 131 + 17) & 0xff;
+
+	/* every alignment and tail length against the table versions */
+	for (off = 0; off < 8; off++) {
+		for (len = 0; len < 300; len++) {
+			check("crc16 sw/hw", crc16_t10dif(0x1234, buf + off, len),
+			      crc16_t10dif_sw(0x1234, buf + off, len));
+			check("crc64 sw/hw", crc64_nvme(0x1234, buf + off, len),
+			      crc64_nvme_sw(0x1234, buf + off, len));
+		}
+		check("crc16 sw/hw 4k", crc16_t10dif(0, buf + off, 4096),
+		      crc16_t10dif_sw(0, buf + off, 4096));
+		check("crc64 sw/hw 4k", crc64_nvme(0, buf + off, 4096),
+		      crc64_nvme_sw(0, buf + off, 4096));
+	}
+
+	check("crc16 chained", crc16_t10dif(crc16_t10dif(0, buf, 1000), buf + 1000, 3096),
+	      crc16_t10dif(0, buf, 4096));
+	check("crc64 chained", crc64_nvme(crc64_nvme(0, buf, 1000), buf + 1000, 3096),
+	      crc64_nvme(0, buf, 4096));
+}
+
+#define NR_BLOCKS	8
+
+static void pi_test(enum nvme_pi_format pif, unsigned int sts, unsigned int ms,
+		    bool extended, bool pi_first)
+{
+	struct nvme_pi pi = {
+		.pif		= pif,
+		.type		= 1,
+		.sts		= sts,
+		.pi_first	= pi_first,
+		.extended	= extended,
+		.lba_size	= 512,
+		.ms		= ms,
+		.apptag		= 0x1234,
+		.appmask	= 0xffff,
+		.reftag		= 0xfffffffe,
+		.storage_tag	= 0x5a,
+		.check_guard	= true,
+		.check_reftag	= true,
+		.check_storage_tag = true,
+	};
+	size_t dlen = NR_BLOCKS * (pi.lba_size + (extended ? ms : 0));
+	unsigned char *data = malloc(dlen), *meta = calloc(NR_BLOCKS, ms);
+	unsigned int pi_off = pi_first ? 0 : ms - nvme_pi_size(pif);
+	unsigned char *blk_meta;
+	struct nvme_pi_err err;
+	size_t i;
+
+	if (!data || !meta) {
+		perror("malloc");
+		exit(1);
+	}
+	for (i = 0; i < dlen; i++)
+		data[i] = i * 7 + 3;
+
+	check("pi check", nvme_pi_check(&pi), 0);
+	nvme_pi_generate(&pi, data, meta, 0, NR_BLOCKS);
+	check("verify", nvme_pi_verify(&pi, data, meta, 0, NR_BLOCKS, &err), 0);
+
+	/* the remaining blocks had a different reference tag */
+	check("offset", nvme_pi_verify(&pi, data + (extended ? 3 * (512 + ms) : 3 * 512),
+				       meta + 3 * ms, 3, NR_BLOCKS - 3, NULL), 0);
+	check("wrong offset", nvme_pi_verify(&pi, data, meta, 1, NR_BLOCKS, &err), -EILSEQ);
+	check("wrong offset block", err.block, 0);
+	check("wrong offset field", !strcmp(err.field, "reference tag"), 1);
+
+	blk_meta = extended ? data + 5 * (512 + ms) + 512 : meta + 5 * ms;
+
+	/* metadata bytes ahead of the PI are covered by the guard */
+	if (!pi_first && pi_off) {
+		blk_meta[0] ^= 1;
+		check("meta corrupt", nvme_pi_verify(&pi, data, meta, 0, NR_BLOCKS, &err),
+		      -EILSEQ);
+		check("meta corrupt block", err.block, 5);
+		blk_meta[0] ^= 1;
+	}
+
+	data[5 * (512 + (extended ? ms : 0)) + 17] ^= 0x80;
+	check("corrupt", nvme_pi_verify(&pi, data, meta, 0, NR_BLOCKS, &err), -EILSEQ);
+	check("corrupt block", err.block, 5);
+	check("corrupt field", !strcmp(err.field, "guard"), 1);
+
+	/* an all ones application tag escapes checking */
+	memset(blk_meta + pi_off + (pif == NVME_PI_GUARD_16 ? 2 : pif == NVME_PI_GUARD_32 ? 4 : 8),
+	       0xff, 2);
+	check("escape", nvme_pi_verify(&pi, data, meta, 0, NR_BLOCKS, &err), 0);
+
+	pi.storage_tag = 0x5b;
+	check("storage tag", nvme_pi_verify(&pi, data, meta, 0, NR_BLOCKS, &err),
+	      sts ? -EILSEQ : 0);
+
+	free(data);
+	free(meta);
+}
+
+int main(void)
+{
+	struct nvme_pi bad = { .pif = NVME_PI_GUARD_64, .type = 1, .ms = 8 };
+
+	crc_test();
+
+	pi_test(NVME_PI_GUARD_16, 0, 8, false, false);
+	pi_test(NVME_PI_GUARD_16, 8, 16, true, false);
+	pi_test(NVME_PI_GUARD_16, 0, 16, false, true);
+	pi_test(NVME_PI_GUARD_32, 16, 16, true, false);
+	pi_test(NVME_PI_GUARD_32, 64, 64, false, false);
+	pi_test(NVME_PI_GUARD_64, 0, 16, false, false);
+	pi_test(NVME_PI_GUARD_64, 24, 64, true, false);
+	pi_test(NVME_PI_GUARD_64, 40, 32, true, true);
+
+	check("metadata too small", nvme_pi_check(&bad), -EINVAL);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
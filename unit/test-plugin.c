@@ -0,0 +1,115 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../plugin.h"
+#include "../common.h"
+
+static int test_rc;
+static struct command *called;
+
+static int cmd_fn(int argc, char **argv, struct command *command, struct plugin *plugin)
+{
+	called = command;
+	return 0;
+}
+
+static struct command id_ctrl_cmd = { "id-ctrl", "", cmd_fn, NULL };
+static struct command id_ns_cmd = { "id-ns", "", cmd_fn, NULL };
+static struct command list_cmd = { "list", "", cmd_fn, NULL };
+static struct command list_subsys_cmd = { "list-subsys", "", cmd_fn, NULL };
+static struct command smart_log_cmd = { "smart-log", "", cmd_fn, NULL };
+static struct command fw_download_cmd = { "fw-download", "", cmd_fn, "fw-dl" };
+static struct command fw_commit_cmd = { "fw-commit", "", cmd_fn, "fw-activate" };
+static struct command zeroes_cmd = { "write-zeroes", "", cmd_fn, NULL };
+
+static struct command *commands[] = {
+	&list_cmd, &id_ctrl_cmd, &id_ns_cmd, &list_subsys_cmd, &smart_log_cmd,
+	&fw_download_cmd, &fw_commit_cmd, &zeroes_cmd, NULL,
+};
+
+static struct program prog = { .name = "nvme", .version = "test" };
+
+static struct plugin plugin = {
+	.name = "test",
+	.commands = commands,
+	.parent = &prog,
+};
+
+static const struct {
+	const char *str;
+	struct command *cmd;
+} lookups[] = {
+	{ "list",		&list_cmd },		/* exact, also a prefix */
+	{ "list-subsys",	&list_subsys_cmd },
+	{ "list-s",		&list_subsys_cmd },
+	{ "id-ctrl",		&id_ctrl_cmd },
+	{ "id-c",		&id_ctrl_cmd },
+	{ "id-",		NULL },			/* ambiguous */
+	{ "smart",		&smart_log_cmd },
+	{ "s",			&smart_log_cmd },
+	{ "fw-dl",		&fw_download_cmd },	/* alias */
+	{ "fw-activate",	&fw_commit_cmd },
+	{ "fw-act",		NULL },			/* aliases aren't prefixes */
+	{ "fw-",		NULL },
+	{ "w",			&zeroes_cmd },
+	{ "write-zeroes-x",	NULL },
+	{ "a",			NULL },
+	{ "z",			NULL },
+	{ "",			NULL },
+};
+
+static void lookup_test(void)
+{
+	struct command *cmd;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(lookups); i++) {
+		cmd = plugin_find_command(&plugin, lookups[i].str);
+		if (cmd == lookups[i].cmd)
+			continue;
+
+		printf("ERROR: lookup of '%s' found %s, expected %s\n",
+		       lookups[i].str, cmd ? cmd->name : "nothing",
+		       lookups[i].cmd ? lookups[i].cmd->name : "nothing");
+		test_rc = 1;
+	}
+}
+
+static void dispatch_test(void)
+{
+	char arg0[32];
+	char *argv[] = { arg0, NULL };
+	int err;
+
+	strcpy(arg0, "--id-ns");
+	called = NULL;
+	err = handle_plugin(1, argv, &plugin);
+	if (err || called != &id_ns_cmd) {
+		printf("ERROR: '--id-ns' dispatched to %s (%d)\n",
+		       called ? called->name : "nothing", err);
+		test_rc = 1;
+	}
+
+	strcpy(arg0, "id-");
+	called = NULL;
+	err = handle_plugin(1, argv, &plugin);
+	if (err != -ENOTTY || called) {
+		printf("ERROR: ambiguous 'id-' dispatched to %s (%d)\n",
+		       called ? called->name : "nothing", err);
+		test_rc = 1;
+	}
+}
+
+int main(void)
+{
+	lookup_test();
+	/* the second round runs against the index built by the first */
+	lookup_test();
+	dispatch_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
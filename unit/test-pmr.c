@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/pmr.h"
+
+#define LEN	4096
+
+static int test_rc;
+
+static void check(const char *what, size_t off, size_t len, int res)
+{
+	if (!res)
+		return;
+
+	printf("ERROR: %s: offset %zu length %zu differs\n", what, off, len);
+	test_rc = 1;
+}
+
+/* every 8 byte aligned device offset and length, unaligned host buffers */
+static void copy_test(uint64_t *dev, unsigned char *src, unsigned char *dst)
+{
+	static const size_t lens[] = { 0, 8, 16, 24, 56, 64, 72, 1000, 4088 };
+	unsigned char *d = (unsigned char *)dev;
+	size_t i, off, len;
+
+	for (off = 0; off < 64; off += 8) {
+		for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+			len = lens[i];
+			if (off + len > LEN)
+				continue;
+
+			memset(d, 0, LEN);
+			nvme_pmr_store(d + off, src + 1, len);
+			check("store", off, len, memcmp(d + off, src + 1, len));
+			check("store past end", off, len, d[off + len] != 0);
+
+			memset(d, 0, LEN);
+			nvme_pmr_store_nt(d + off, src + 3, len);
+			nvme_pmr_fence();
+			check("store nt", off, len, memcmp(d + off, src + 3, len));
+			check("store nt past end", off, len, d[off + len] != 0);
+
+			memset(dst, 0, LEN + 8);
+			nvme_pmr_load(dst + 5, d + off, len);
+			check("load", off, len, memcmp(dst + 5, d + off, len));
+			check("load past end", off, len, dst[5 + len] != 0);
+		}
+	}
+}
+
+int main(void)
+{
+	unsigned char *src = malloc(LEN + 8), *dst = malloc(LEN + 8);
+	uint64_t *dev = calloc(LEN / 8 + 1, 8);
+	int i;
+
+	if (!src || !dst || !dev) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < LEN + 8; i++)
+		src[i] = i * 7 + 1;
+
+	copy_test(dev, src, dst);
+
+	free(dev);
+	free(dst);
+	free(src);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,135 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * The streamed json printers hand their objects to json_show_capture()
+ * like the others, instead of writing them to stdout.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "nvme.h"
+#include "nvme-print.h"
+#include "common.h"
+#include "check.h"
+
+#define NR_ERR_ENTRIES	8
+#define NR_ZONES	16
+
+/* the print code calls back into nvme.c for these */
+const char *nvme_strerror(int errnum)
+{
+	return strerror(errnum);
+}
+
+bool nvme_is_output_format_json(void)
+{
+	return true;
+}
+
+int get_reg_size(int offset)
+{
+	return sizeof(uint32_t);
+}
+
+bool nvme_is_ctrl_reg(int offset)
+{
+	return false;
+}
+
+/* length of the array member @key of @o, -1 without one */
+static long long array_len(struct json_object *o, const char *key)
+{
+	struct json_object *a;
+
+	if (!o || !json_object_object_get_ex(o, key, &a) ||
+	    !json_object_is_type(a, json_type_array))
+		return -1;
+
+	return json_object_array_length(a);
+}
+
+static void test_error_log(void)
+{
+	struct nvme_error_log_page err_log[NR_ERR_ENTRIES] = { 0 };
+	struct json_object *o = NULL;
+
+	json_show_capture(&o);
+	nvme_show_error_log(err_log, NR_ERR_ENTRIES, "nvme0", JSON);
+	json_show_capture(NULL);
+
+	check("error-log errors", array_len(o, "errors"), NR_ERR_ENTRIES);
+	json_free_object(o);
+}
+
+static void test_list_ns(void)
+{
+	struct nvme_ns_list ns_list = { 0 };
+	struct json_object *o = NULL;
+
+	ns_list.ns[0] = cpu_to_le32(1);
+	ns_list.ns[1] = cpu_to_le32(2);
+	ns_list.ns[2] = cpu_to_le32(7);
+
+	json_show_capture(&o);
+	nvme_show_list_ns(&ns_list, JSON);
+	json_show_capture(NULL);
+
+	check("list-ns nsid_list", array_len(o, "nsid_list"), 3);
+	json_free_object(o);
+}
+
+/* the zones are written with a json_stream, which builds the tree instead */
+static void test_zones(void)
+{
+	size_t size = sizeof(struct nvme_zone_report) + NR_ZONES * sizeof(struct nvme_zns_desc);
+	struct json_object *zone_list = NULL, *o = NULL, *nr;
+	struct nvme_zone_report *r;
+
+	r = calloc(1, size);
+	if (!r) {
+		check("calloc", 0, 1);
+		return;
+	}
+	r->nr_zones = cpu_to_le64(NR_ZONES);
+
+	json_show_capture(&o);
+	nvme_zns_start_zone_list(NR_ZONES, &zone_list, JSON);
+	nvme_show_zns_report_zones(r, NR_ZONES, 0, size, zone_list, JSON);
+	nvme_zns_finish_zone_list(NR_ZONES, zone_list, JSON);
+	json_show_capture(NULL);
+
+	check("zones zone_list", array_len(o, "zone_list"), NR_ZONES);
+	check("zones nr_zones", o && json_object_object_get_ex(o, "nr_zones", &nr) ?
+	      json_object_get_int64(nr) : -1, NR_ZONES);
+	json_free_object(o);
+	free(r);
+}
+
+int main(void)
+{
+	FILE *out = tmpfile();
+	int stdout_fd = dup(STDOUT_FILENO);
+
+	if (!out || stdout_fd < 0) {
+		perror("tmpfile");
+		return EXIT_FAILURE;
+	}
+
+	/* nothing captured may reach stdout */
+	fflush(stdout);
+	dup2(fileno(out), STDOUT_FILENO);
+
+	test_error_log();
+	test_list_ns();
+	test_zones();
+
+	fflush(stdout);
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdout_fd);
+	fseek(out, 0, SEEK_END);
+	check("bytes written to stdout", ftell(out), 0);
+	fclose(out);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../util/queue-map.h"
+#include "check.h"
+
+static void write_queue(const char *dir, int q, const char *cpus)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/mq/%d", dir, q);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/mq/%d/cpu_list", dir, q);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	fprintf(f, "%s\n", cpus);
+	fclose(f);
+}
+
+static void remove_queues(const char *dir, int nr)
+{
+	char path[256];
+	int q;
+
+	for (q = 0; q < nr; q++) {
+		snprintf(path, sizeof(path), "%s/mq/%d/cpu_list", dir, q);
+		unlink(path);
+		snprintf(path, sizeof(path), "%s/mq/%d", dir, q);
+		rmdir(path);
+	}
+	snprintf(path, sizeof(path), "%s/mq", dir);
+	rmdir(path);
+	rmdir(dir);
+}
+
+int main(void)
+{
+	char dir[] = "/tmp/test-queue-map-XXXXXX";
+	struct nvme_queue_map m;
+	cpu_set_t allowed;
+	char path[256];
+	int cpus[8];
+	int i;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	snprintf(path, sizeof(path), "%s/mq", dir);
+	mkdir(path, 0700);
+
+	check("no queues", nvme_queue_map_read(dir, &m), -ENODEV);
+
+	/* 4 default queues of 2 CPUs, then 2 poll queues mapping them again */
+	write_queue(dir, 0, "0-1");
+	write_queue(dir, 1, "2-3");
+	write_queue(dir, 2, "4-5");
+	write_queue(dir, 3, "6-7");
+	write_queue(dir, 4, "0-3");
+	write_queue(dir, 5, "4-7");
+
+	check("read", nvme_queue_map_read(dir, &m), 0);
+	check("queues", m.nr_queues, 6);
+	check("queue 1", CPU_ISSET(3, &m.cpus[1]), 1);
+
+	CPU_ZERO(&allowed);
+	for (i = 0; i < 8; i++)
+		CPU_SET(i, &allowed);
+
+	/* a queue per thread, then the second CPU of each queue */
+	check("place 6", nvme_queue_map_place(&m, &allowed, 6, cpus), 4);
+	check("thread 0", cpus[0], 0);
+	check("thread 1", cpus[1], 2);
+	check("thread 3", cpus[3], 6);
+	check("thread 4", cpus[4], 1);
+	check("thread 5", cpus[5], 3);
+
+	check("place 2", nvme_queue_map_place(&m, &allowed, 2, cpus), 2);
+	check("place 2 thread 1", cpus[1], 2);
+
+	/* only the queues with allowed CPUs are used */
+	CPU_ZERO(&allowed);
+	CPU_SET(5, &allowed);
+	CPU_SET(7, &allowed);
+	check("allowed", nvme_queue_map_place(&m, &allowed, 3, cpus), 2);
+	check("allowed thread 0", cpus[0], 5);
+	check("allowed thread 1", cpus[1], 7);
+	check("allowed thread 2", cpus[2], 5);
+
+	CPU_ZERO(&allowed);
+	CPU_SET(9, &allowed);
+	check("none allowed", nvme_queue_map_place(&m, &allowed, 1, cpus), -EINVAL);
+
+	nvme_queue_map_free(&m);
+	remove_queues(dir, 6);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
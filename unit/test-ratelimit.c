@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../util/ratelimit.h"
+
+#define MS	1000000ULL
+#define SEC	(1000 * MS)
+
+static int test_rc;
+
+static void check(const char *what, uint64_t res, uint64_t lo, uint64_t hi)
+{
+	if (res >= lo && res <= hi)
+		return;
+
+	printf("ERROR: %s: got %llu, expected [%llu, %llu]\n", what,
+	       (unsigned long long)res, (unsigned long long)lo,
+	       (unsigned long long)hi);
+	test_rc = 1;
+}
+
+/* commands admitted over @secs when asking every 10 us */
+static uint64_t run(struct nvme_ratelimit *rl, uint64_t bytes, uint64_t start,
+		    uint64_t secs)
+{
+	uint64_t now, n = 0;
+
+	for (now = start; now < start + secs * SEC; now += 10000)
+		while (!nvme_ratelimit_take(rl, bytes, now))
+			n++;
+
+	return n;
+}
+
+static void iops_test(void)
+{
+	struct nvme_ratelimit rl;
+
+	nvme_ratelimit_init(&rl, 1000, 0, 0, 0);
+	/* the burst, 10 ms worth, plus a second of refill */
+	check("iops", run(&rl, 4096, 0, 1), 1000, 1011);
+	nvme_ratelimit_destroy(&rl);
+}
+
+static void bps_test(void)
+{
+	struct nvme_ratelimit rl;
+	uint64_t wait;
+
+	nvme_ratelimit_init(&rl, 0, 1 << 20, 0, 0);
+	check("bps", run(&rl, 4096, 0, 2), 511, 515);
+	nvme_ratelimit_destroy(&rl);
+
+	/* a command larger than the burst goes and is paid off after */
+	nvme_ratelimit_init(&rl, 0, 1 << 20, 0, 0);
+	check("large", nvme_ratelimit_take(&rl, 4 << 20, 0), 0, 0);
+	wait = nvme_ratelimit_take(&rl, 4096, 0);
+	check("large wait", wait, 3 * SEC, 4 * SEC);
+	check("large paid", nvme_ratelimit_take(&rl, 4096, wait), 0, 0);
+	nvme_ratelimit_destroy(&rl);
+}
+
+static void both_test(void)
+{
+	struct nvme_ratelimit rl;
+
+	/* the tighter of the limits applies */
+	nvme_ratelimit_init(&rl, 100, 1 << 30, 0, 0);
+	check("both iops", run(&rl, 4096, 0, 1), 100, 102);
+	nvme_ratelimit_destroy(&rl);
+
+	nvme_ratelimit_init(&rl, 100000, 1 << 20, 0, 0);
+	check("both bps", run(&rl, 1 << 16, 0, 1), 16, 17);
+	nvme_ratelimit_destroy(&rl);
+}
+
+static void adapt_test(void)
+{
+	struct nvme_ratelimit rl;
+	uint64_t now = 200 * MS;
+	int i;
+
+	nvme_ratelimit_init(&rl, 1000, 0, 1 * MS, 0);
+
+	/* a fast completion keeps the rate */
+	nvme_ratelimit_complete(&rl, 100000, now);
+	check("fast", nvme_ratelimit_scale(&rl) * 1000, 1000, 1000);
+
+	/* one slow completion per interval halves it down to the floor */
+	for (i = 0; i < 10; i++) {
+		now += 200 * MS;
+		nvme_ratelimit_complete(&rl, 2 * MS, now);
+	}
+	check("floor", nvme_ratelimit_scale(&rl) * 1000 * 64, 1000, 1000);
+	check("backoffs", rl.backoffs, 10, 10);
+	check("throttled", run(&rl, 4096, now, 1), 15, 27);
+	now += SEC;
+
+	/* and it recovers a 64th per interval without one */
+	for (i = 0; i < 100; i++) {
+		now += 200 * MS;
+		nvme_ratelimit_complete(&rl, 100000, now);
+	}
+	check("recovered", nvme_ratelimit_scale(&rl) * 1000, 1000, 1000);
+	nvme_ratelimit_destroy(&rl);
+}
+
+int main(void)
+{
+	iops_test();
+	bps_test();
+	both_test();
+	adapt_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
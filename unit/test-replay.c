@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <endian.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/replay.h"
+#include "check.h"
+
+static int load(const void *trace, size_t len, struct nvme_replay_cmd **cmds,
+		size_t *nr, unsigned int *line)
+{
+	FILE *f = fmemopen((void *)trace, len, "r");
+	int err;
+
+	if (!f) {
+		perror("fmemopen");
+		exit(EXIT_FAILURE);
+	}
+	err = nvme_replay_load(f, cmds, nr, line);
+	fclose(f);
+
+	return err;
+}
+
+static void check_json(void)
+{
+	static const char trace[] =
+		"{\"admin\": true, \"opcode\": 6, \"cdw10\": 1, \"data_len\": 4096}\n"
+		"\n"
+		"{\"opcode\":\"0x02\",\"nsid\":1,\"cdw12\":7,\"think_us\":250,"
+		"\"latency_us\":12.5,\"status\":-1,\"name\":\"Read\",\"extra\":{\"a\":[1,\"}\"]}}\r\n"
+		"{}";
+	struct nvme_replay_cmd *c;
+	unsigned int line;
+	size_t nr;
+
+	check("json", load(trace, strlen(trace), &c, &nr, &line), 0);
+	check("json commands", nr, 3);
+	if (nr != 3)
+		return;
+
+	check("admin", c[0].admin, 1);
+	check("opcode", c[0].opcode, 6);
+	check("cdw10", c[0].cdw10, 1);
+	check("data_len", c[0].data_len, 4096);
+	check("io", c[1].admin, 0);
+	check("hex string", c[1].opcode, 2);
+	check("nsid", c[1].nsid, 1);
+	check("cdw12", c[1].cdw12, 7);
+	check("think_us", c[1].think_us, 250);
+	check("empty", c[2].opcode | c[2].nsid, 0);
+	free(c);
+}
+
+static void check_json_errors(void)
+{
+	static const char * const bad[] = {
+		"{\"opcode\": 256}\n",
+		"{\"opcode\": -1}\n",
+		"{\"opcode\": 1.5}\n",
+		"{\"opcode\": \"read\"}\n",
+		"{\"opcode\": 1\n",
+		"{\"opcode\" 1}\n",
+		"{\"opcode\": 1} x\n",
+		"[1]\n",
+	};
+	struct nvme_replay_cmd *c;
+	unsigned int line, i;
+	char trace[64];
+	size_t nr;
+
+	for (i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		snprintf(trace, sizeof(trace), "{\"opcode\": 1}\n%s", bad[i]);
+		check(bad[i], load(trace, strlen(trace), &c, &nr, &line), -EINVAL);
+		check("error line", line, 2);
+	}
+}
+
+static void check_bin(void)
+{
+	unsigned char trace[sizeof(NVME_REPLAY_MAGIC) - 1 + 2 * sizeof(struct nvme_replay_cmd)];
+	struct nvme_replay_cmd rec = { 0 }, *c;
+	size_t off = sizeof(NVME_REPLAY_MAGIC) - 1, nr;
+	unsigned int line;
+
+	memcpy(trace, NVME_REPLAY_MAGIC, off);
+	rec.opcode = 0x01;
+	rec.nsid = htole32(1);
+	rec.cdw10 = htole32(0x12345678);
+	rec.think_us = htole32(1000);
+	rec.status = htole32(-5);
+	memcpy(trace + off, &rec, sizeof(rec));
+	rec.admin = 1;
+	rec.opcode = 0x02;
+	rec.data_len = htole32(512);
+	memcpy(trace + off + sizeof(rec), &rec, sizeof(rec));
+
+	check("binary", load(trace, sizeof(trace), &c, &nr, &line), 0);
+	check("binary commands", nr, 2);
+	if (nr == 2) {
+		check("binary opcode", c[0].opcode, 1);
+		check("binary nsid", c[0].nsid, 1);
+		check("binary cdw10", c[0].cdw10, 0x12345678);
+		check("binary think_us", c[0].think_us, 1000);
+		check("binary status", c[0].status, -5);
+		check("binary admin", c[1].admin, 1);
+		check("binary data_len", c[1].data_len, 512);
+	}
+	free(c);
+
+	check("short record", load(trace, sizeof(trace) - 1, &c, &nr, &line), -EINVAL);
+	check("short record number", line, 2);
+}
+
+int main(void)
+{
+	check_json();
+	check_json_errors();
+	check_bin();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/sha256.h"
+
+static int test_rc;
+
+static void check(const char *what, const unsigned char *res, const char *exp)
+{
+	char hex[2 * SHA256_DIGEST_SIZE + 1];
+	int i;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		sprintf(hex + 2 * i, "%02x", res[i]);
+	if (!strcmp(hex, exp))
+		return;
+
+	printf("ERROR: %s: got %s, expected %s\n", what, hex, exp);
+	test_rc = 1;
+}
+
+static void check_same(const char *what, const unsigned char *res,
+		       const unsigned char *exp)
+{
+	if (!memcmp(res, exp, SHA256_DIGEST_SIZE))
+		return;
+
+	printf("ERROR: %s: digests differ\n", what);
+	test_rc = 1;
+}
+
+/* FIPS 180-2 appendix B */
+static void test_vectors(void)
+{
+	const char *two_blocks =
+		"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	unsigned char md[SHA256_DIGEST_SIZE];
+	struct sha256 s;
+	char a[1000];
+	int i;
+
+	sha256("", 0, md);
+	check("empty", md,
+	      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	sha256("abc", 3, md);
+	check("abc", md,
+	      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	sha256_sw("abc", 3, md);
+	check("abc sw", md,
+	      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	sha256(two_blocks, strlen(two_blocks), md);
+	check("448 bits", md,
+	      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+	memset(a, 'a', sizeof(a));
+	sha256_init(&s);
+	for (i = 0; i < 1000; i++)
+		sha256_update(&s, a, sizeof(a));
+	sha256_final(&s, md);
+	check("million a", md,
+	      "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+/* RFC 4231 test cases 1, 2 and 6 */
+static void test_hmac(void)
+{
+	const char *long_data = "Test Using Larger Than Block-Size Key - Hash Key First";
+	const char *jefe_data = "what do ya want for nothing?";
+	unsigned char md[SHA256_DIGEST_SIZE];
+	unsigned char key[131];
+	struct hmac_sha256_key k;
+
+	memset(key, 0x0b, 20);
+	hmac_sha256(key, 20, "Hi There", 8, md);
+	check("hmac 1", md,
+	      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+
+	hmac_sha256("Jefe", 4, jefe_data, strlen(jefe_data), md);
+	check("hmac 2", md,
+	      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+
+	memset(key, 0xaa, sizeof(key));
+	hmac_sha256(key, sizeof(key), long_data, strlen(long_data), md);
+	check("hmac 6", md,
+	      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+
+	/* a prepared key gives the same MAC every time */
+	hmac_sha256_setkey(&k, "Jefe", 4);
+	hmac_sha256_mac(&k, jefe_data, strlen(jefe_data), md);
+	hmac_sha256_mac(&k, jefe_data, strlen(jefe_data), md);
+	check("hmac 2 prepared key", md,
+	      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+}
+
+/* every length around the padding boundaries against the portable version */
+static void test_impl(void)
+{
+	static unsigned char buf[1024 + 3];
+	unsigned char md[SHA256_DIGEST_SIZE], ref[SHA256_DIGEST_SIZE];
+	struct sha256 s;
+	size_t i, len;
+
+	for (i = 0; i < sizeof(buf); i++)
+		buf[i] = (i * 131 + 17) & 0xff;
+
+	for (len = 0; len <= 1024; len++) {
+		sha256(buf + len % 4, len, md);
+		sha256_sw(buf + len % 4, len, ref);
+		check_same(sha256_impl_name(), md, ref);
+	}
+
+	/* a digest may be computed piecewise */
+	sha256_init(&s);
+	sha256_update(&s, buf, 1);
+	sha256_update(&s, buf + 1, 100);
+	sha256_update(&s, buf + 101, 923);
+	sha256_final(&s, md);
+	sha256_sw(buf, 1024, ref);
+	check_same("chained", md, ref);
+}
+
+int main(void)
+{
+	test_vectors();
+	test_hmac();
+	test_impl();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
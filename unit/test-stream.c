@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../util/stream.h"
+#include "check.h"
+
+#define CHUNK	4096
+#define TOTAL	(5 * CHUNK + 100)
+
+static unsigned char pattern(size_t off)
+{
+	return (off * 7 + 3) & 0xff;
+}
+
+static FILE *tmp_file(size_t len)
+{
+	FILE *f = tmpfile();
+	size_t i;
+
+	if (!f) {
+		perror("tmpfile");
+		exit(1);
+	}
+
+	for (i = 0; i < len; i++)
+		fputc(pattern(i), f);
+	fflush(f);
+	rewind(f);
+
+	return f;
+}
+
+/* the file is shorter than the stream, the tail must be zero padded */
+static void from_file_test(void)
+{
+	struct nvme_stream s;
+	FILE *f = tmp_file(TOTAL - 50);
+	size_t len, i, off = 0;
+	unsigned char *buf;
+	int chunks = 0;
+
+	check("init", nvme_stream_init(&s, fileno(f), NVME_STREAM_FROM_FILE,
+				       TOTAL, CHUNK, 2), 0);
+
+	while ((buf = nvme_stream_get(&s, &len))) {
+		for (i = 0; i < len; i++, off++) {
+			if (buf[i] != (off < TOTAL - 50 ? pattern(off) : 0)) {
+				check("data", buf[i], pattern(off));
+				break;
+			}
+		}
+		nvme_stream_put(&s, len);
+		chunks++;
+	}
+
+	check("chunks", chunks, 6);
+	check("bytes", off, TOTAL);
+	check("finish", nvme_stream_finish(&s, false), 0);
+	fclose(f);
+}
+
+static void to_file_test(void)
+{
+	struct nvme_stream s;
+	FILE *f = tmpfile();
+	size_t len, i, off = 0;
+	unsigned char *buf;
+
+	check("init", nvme_stream_init(&s, fileno(f), NVME_STREAM_TO_FILE,
+				       TOTAL, CHUNK, 3), 0);
+
+	while ((buf = nvme_stream_get(&s, &len))) {
+		for (i = 0; i < len; i++)
+			buf[i] = pattern(off + i);
+		off += len;
+		nvme_stream_put(&s, len);
+	}
+
+	check("finish", nvme_stream_finish(&s, false), 0);
+	check("size", lseek(fileno(f), 0, SEEK_END), TOTAL);
+
+	rewind(f);
+	for (i = 0; i < TOTAL; i++) {
+		int c = fgetc(f);
+
+		if (c != pattern(i)) {
+			check("file data", c, pattern(i));
+			break;
+		}
+	}
+	fclose(f);
+}
+
+/* stopping early must not hang on the helper thread */
+static void cancel_test(void)
+{
+	struct nvme_stream s;
+	FILE *f = tmp_file(TOTAL);
+	size_t len;
+
+	check("init", nvme_stream_init(&s, fileno(f), NVME_STREAM_FROM_FILE,
+				       TOTAL, CHUNK, 2), 0);
+	if (nvme_stream_get(&s, &len))
+		nvme_stream_put(&s, len);
+	check("finish", nvme_stream_finish(&s, true), 0);
+	fclose(f);
+
+	f = tmpfile();
+	check("init", nvme_stream_init(&s, fileno(f), NVME_STREAM_TO_FILE,
+				       TOTAL, CHUNK, 2), 0);
+	if (nvme_stream_get(&s, &len))
+		nvme_stream_put(&s, len);
+	check("finish", nvme_stream_finish(&s, false), 0);
+	check("partial size", lseek(fileno(f), 0, SEEK_END), CHUNK);
+	fclose(f);
+}
+
+int main(void)
+{
+	from_file_test();
+	to_file_test();
+	cancel_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../util/sysfs.h"
+#include "check.h"
+
+static void write_attr(const char *dir, const char *attr, const char *val)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", dir, attr);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	fputs(val, f);
+	fclose(f);
+}
+
+int main(void)
+{
+	static const char * const attrs[] = {
+		"serial", "size", "hex", "empty", "bad", "long", "stat",
+	};
+	char dir[] = "/tmp/test-sysfs-XXXXXX";
+	struct sysfs_blk_stat st;
+	cpu_set_t cpus;
+	unsigned long long v;
+	char buf[16];
+	size_t i;
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	write_attr(dir, "serial", "S123  \n");
+	write_attr(dir, "size", "7814037168\n");
+	write_attr(dir, "hex", "0x200\n");
+	write_attr(dir, "empty", "\n");
+	write_attr(dir, "bad", "12abc\n");
+	write_attr(dir, "long", "0123456789abcdefghij\n");
+
+	check("serial", sysfs_read_attr(dir, "serial", buf, sizeof(buf)), 0);
+	check("serial value", strcmp(buf, "S123"), 0);
+	check("truncated", sysfs_read_attr(dir, "long", buf, sizeof(buf)), 0);
+	check("truncated len", strlen(buf), sizeof(buf) - 1);
+	check("empty", sysfs_read_attr(dir, "empty", buf, sizeof(buf)), -1);
+	check("missing", sysfs_read_attr(dir, "missing", buf, sizeof(buf)), -1);
+	check("missing errno", errno, ENOENT);
+
+	check("size", sysfs_read_u64(dir, "size", &v), 0);
+	check("size value", v, 7814037168ULL);
+	check("hex", sysfs_read_u64(dir, "hex", &v), 0);
+	check("hex value", v, 0x200);
+	check("bad", sysfs_read_u64(dir, "bad", &v), -1);
+
+	write_attr(dir, "stat", "    1200       30    96000      410     5000        0   400000     2200"
+		   "        7     2600     2610        0        0        0        0\n");
+	check("stat", sysfs_read_blk_stat(dir, &st), 0);
+	check("stat read_ios", st.read_ios, 1200);
+	check("stat read_sectors", st.read_sectors, 96000);
+	check("stat write_ios", st.write_ios, 5000);
+	check("stat write_ticks", st.write_ticks, 2200);
+	check("stat in_flight", st.in_flight, 7);
+	check("stat time_in_queue", st.time_in_queue, 2610);
+	write_attr(dir, "stat", "1 2 3\n");
+	check("short stat", sysfs_read_blk_stat(dir, &st), -1);
+
+	check("cpulist", sysfs_parse_cpulist("0-3,8,10-11", &cpus), 0);
+	check("cpulist count", CPU_COUNT(&cpus), 7);
+	check("cpulist 8", CPU_ISSET(8, &cpus), 1);
+	check("cpulist 9", CPU_ISSET(9, &cpus), 0);
+	check("cpulist 11", CPU_ISSET(11, &cpus), 1);
+	check("cpulist range", sysfs_parse_cpulist("3-1", &cpus), -1);
+	check("cpulist junk", sysfs_parse_cpulist("1,x", &cpus), -1);
+	check("cpulist empty", sysfs_parse_cpulist("", &cpus), -1);
+
+	for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+		char path[256];
+
+		snprintf(path, sizeof(path), "%s/%s", dir, attrs[i]);
+		unlink(path);
+	}
+	rmdir(dir);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
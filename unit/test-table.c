@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/table.h"
+
+static int test_rc;
+
+static const struct nvme_table_column cols[] = {
+	{ "Node", 6 },
+	{ "NSID", 0, NVME_TABLE_RIGHT },
+	{ "Ctrls" },
+};
+
+static void check_output(const char *what, struct nvme_table *t, const char *exp)
+{
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *f;
+	int err;
+
+	f = open_memstream(&buf, &len);
+	if (!f) {
+		perror("open_memstream");
+		exit(1);
+	}
+
+	err = nvme_table_print(t, f);
+	fclose(f);
+
+	if (err || strcmp(buf, exp)) {
+		printf("ERROR: %s: got (err %d)\n%s\nexpected\n%s\n", what, err,
+		       buf, exp);
+		test_rc = 1;
+	}
+
+	free(buf);
+}
+
+static void empty_test(void)
+{
+	struct nvme_table t;
+
+	nvme_table_init(&t, cols, 3);
+	check_output("empty", &t,
+		"Node   NSID Ctrls\n"
+		"------ ---- -----\n");
+	nvme_table_free(&t);
+}
+
+/* the widest cell sets the width, a short last row is padded out */
+static void rows_test(void)
+{
+	struct nvme_table t;
+
+	nvme_table_init(&t, cols, 3);
+	nvme_table_add(&t, "nvme0n1");
+	nvme_table_addf(&t, "%#x", 1);
+	nvme_table_add(&t, NULL);
+	nvme_table_append(&t, ", ", "nvme0");
+	nvme_table_append(&t, ", ", "nvme1");
+	nvme_table_add(&t, "ng1n1");
+	nvme_table_addf(&t, "%#x", 0x12345);
+
+	if (nvme_table_rows(&t) != 1) {
+		printf("ERROR: rows: got %zu, expected 1\n", nvme_table_rows(&t));
+		test_rc = 1;
+	}
+
+	check_output("rows", &t,
+		"Node    NSID    Ctrls       \n"
+		"------- ------- ------------\n"
+		"nvme0n1     0x1 nvme0, nvme1\n"
+		"ng1n1   0x12345             \n");
+	nvme_table_free(&t);
+}
+
+/* a cell longer than the buffer left, and a table over several buffers */
+static void grow_test(void)
+{
+	char exp[64], *big, *out, *p;
+	struct nvme_table t;
+	size_t len;
+	int i;
+
+	big = malloc(10000);
+	memset(big, 'x', 9999);
+	big[9999] = '\0';
+
+	nvme_table_init(&t, cols, 3);
+	for (i = 0; i < 1000; i++) {
+		nvme_table_addf(&t, "nvme%dn1", i);
+		nvme_table_addf(&t, "%d", i);
+		nvme_table_add(&t, "");
+	}
+	nvme_table_addf(&t, "%s", big);
+
+	len = 2 * (10000 + 5 + 6) + 1001 * (10000 + 5 + 6) + 1;
+	out = malloc(len);
+	p = out;
+	p += sprintf(p, "%-9999s NSID Ctrls\n", "Node");
+	memset(p, '-', 9999);
+	p += 9999;
+	p += sprintf(p, " ---- -----\n");
+	for (i = 0; i < 1000; i++) {
+		snprintf(exp, sizeof(exp), "nvme%dn1", i);
+		p += sprintf(p, "%-9999s %4d      \n", exp, i);
+	}
+	p += sprintf(p, "%s           \n", big);
+
+	check_output("grow", &t, out);
+	nvme_table_free(&t);
+	free(out);
+	free(big);
+}
+
+int main(void)
+{
+	empty_test();
+	rows_test();
+	grow_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
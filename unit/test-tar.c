@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "../util/tar.h"
+#include "check.h"
+
+static unsigned int header_sum(const unsigned char *h)
+{
+	unsigned int sum = 0;
+	int i;
+
+	for (i = 0; i < 512; i++)
+		sum += i >= 148 && i < 156 ? ' ' : h[i];
+	return sum;
+}
+
+struct walk {
+	int nr;
+	char names[4][160];
+	size_t lens[4];
+	char first;
+};
+
+static int walk_file(const char *name, const void *data, size_t len, void *arg)
+{
+	struct walk *w = arg;
+
+	if (w->nr == 4)
+		return -1;
+	snprintf(w->names[w->nr], sizeof(w->names[0]), "%s", name);
+	w->lens[w->nr] = len;
+	if (!w->nr)
+		w->first = *(const char *)data;
+	w->nr++;
+	return 0;
+}
+
+int main(void)
+{
+	char path[] = "/tmp/test-tar-XXXXXX";
+	char long_name[160];
+	unsigned char buf[8192];
+	struct nvme_tar *t;
+	struct walk w;
+	ssize_t len;
+	int fd;
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+	unlink(path);
+
+	memset(long_name, 'a', sizeof(long_name));
+	memcpy(long_name + 40, "/", 1);
+	long_name[sizeof(long_name) - 40] = '\0';
+
+	t = nvme_tar_open(fd, 0);
+	check("open", !!t, 1);
+	check("add", nvme_tar_add(t, "dir/hello.bin", "hello", 5), 0);
+	check("add empty", nvme_tar_add(t, "empty.bin", "", 0), 0);
+	check("add long name", nvme_tar_add(t, long_name, "x", 1), 0);
+	memset(long_name, 'b', sizeof(long_name) - 1);
+	long_name[sizeof(long_name) - 1] = '\0';
+	check("name too long", nvme_tar_add(t, long_name, "x", 1) < 0, 1);
+	check("close", nvme_tar_close(t), 0);
+
+	len = pread(fd, buf, sizeof(buf), 0);
+	/* 3 headers, 2 data blocks and the 2 end blocks */
+	check("archive size", len, 7 * 512);
+
+	check("name", !strcmp((char *)buf, "dir/hello.bin"), 1);
+	check("magic", !memcmp(buf + 257, "ustar", 6), 1);
+	check("size", strtol((char *)buf + 124, NULL, 8), 5);
+	check("checksum", strtol((char *)buf + 148, NULL, 8), header_sum(buf));
+	check("data", !memcmp(buf + 512, "hello", 5), 1);
+	check("padding", buf[512 + 5] | buf[1023], 0);
+
+	check("empty size", strtol((char *)buf + 1024 + 124, NULL, 8), 0);
+	check("prefix", strlen((char *)buf + 1536 + 345), 40);
+	check("long name", strlen((char *)buf + 1536), 79);
+	check("long data", buf[2048], 'x');
+	check("end", buf[2560] | buf[3071] | buf[3072] | buf[3583], 0);
+
+	memset(&w, 0, sizeof(w));
+	check("is archive", nvme_tar_is_archive(buf, len), 1);
+	check("walk", nvme_tar_walk(buf, len, walk_file, &w), 0);
+	check("walk files", w.nr, 3);
+	check("walk name", !strcmp(w.names[0], "dir/hello.bin"), 1);
+	check("walk size", w.lens[0], 5);
+	check("walk data", w.first, 'h');
+	check("walk empty", w.lens[1], 0);
+	check("walk long name", strlen(w.names[2]), 40 + 1 + 79);
+	/* the linkname of the first header is covered by its checksum */
+	buf[200] ^= 1;
+	check("walk corrupt", nvme_tar_walk(buf, len, walk_file, &w), -EINVAL);
+	check("walk truncated", nvme_tar_walk(buf + 1024, 512 + 100, walk_file, &w),
+	      -EINVAL);
+	check("not an archive", nvme_tar_is_archive("hello", 5), 0);
+
+	close(fd);
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../util/thread-pool.h"
+#include "check.h"
+
+#define NR_WORK	1000
+
+static int done[NR_WORK];
+static unsigned int counter;
+
+static void work(void *arg)
+{
+	int *d = arg;
+
+	(*d)++;
+	__atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+}
+
+static void slow_work(void *arg)
+{
+	usleep(1000);
+	work(arg);
+}
+
+static void run_test(unsigned int threads, void (*fn)(void *), int nr)
+{
+	struct nvme_thread_pool *pool;
+	int i;
+
+	counter = 0;
+	for (i = 0; i < nr; i++)
+		done[i] = 0;
+
+	pool = nvme_thread_pool_create(threads);
+	if (!pool) {
+		perror("nvme_thread_pool_create");
+		exit(1);
+	}
+
+	for (i = 0; i < nr; i++)
+		check("queue", nvme_thread_pool_queue(pool, fn, &done[i]), 0);
+
+	nvme_thread_pool_wait(pool);
+	check("counter", counter, nr);
+	for (i = 0; i < nr; i++)
+		check("executed once", done[i], 1);
+
+	/* the pool is reusable after waiting */
+	check("queue", nvme_thread_pool_queue(pool, fn, &done[0]), 0);
+	nvme_thread_pool_destroy(pool);
+	check("counter after destroy", counter, nr + 1);
+}
+
+static int emitted[NR_WORK];
+static int nr_emitted, nr_cancelled;
+
+static void emit(void *arg, int err)
+{
+	emitted[nr_emitted++] = (int *)arg - done;
+	if (err == -ECANCELED)
+		nr_cancelled++;
+}
+
+/* the results come out in queue order, whichever worker ran them */
+static void ordered_test(void)
+{
+	struct nvme_thread_pool *pool;
+	int i;
+
+	nr_emitted = 0;
+	for (i = 0; i < NR_WORK; i++)
+		done[i] = 0;
+
+	pool = nvme_thread_pool_create(8);
+	for (i = 0; i < NR_WORK; i++)
+		check("queue ordered", nvme_thread_pool_queue_ordered(pool,
+			i % 7 ? work : slow_work, emit, &done[i]), 0);
+	check("wait", nvme_thread_pool_wait(pool), 0);
+
+	check("emitted", nr_emitted, NR_WORK);
+	for (i = 0; i < NR_WORK; i++) {
+		check("emit order", emitted[i], i);
+		check("executed once", done[i], 1);
+	}
+	nvme_thread_pool_destroy(pool);
+}
+
+static struct nvme_thread_pool *cancel_pool;
+
+static void fatal_work(void *arg)
+{
+	work(arg);
+	nvme_thread_pool_cancel(cancel_pool, -EIO);
+}
+
+static void cancel_test(void)
+{
+	int i, queued = 0;
+
+	counter = 0;
+	nr_emitted = 0;
+	nr_cancelled = 0;
+	for (i = 0; i < NR_WORK; i++)
+		done[i] = 0;
+
+	/* one thread, so nothing after the fatal item runs */
+	cancel_pool = nvme_thread_pool_create(1);
+	for (i = 0; i < NR_WORK; i++)
+		if (!nvme_thread_pool_queue_ordered(cancel_pool,
+				i == 10 ? fatal_work : work, emit, &done[i]))
+			queued++;
+	check("wait cancelled", nvme_thread_pool_wait(cancel_pool), -EIO);
+
+	check("ran", counter, 11);
+	check("emitted", nr_emitted, queued);
+	check("cancelled", nr_cancelled, queued - 11);
+	for (i = 0; i < nr_emitted; i++)
+		check("emit order", emitted[i], i);
+	check("queue after wait", nvme_thread_pool_queue(cancel_pool, work, &done[0]), 0);
+
+	/* the wait returned the error, the pool takes work again */
+	nvme_thread_pool_destroy(cancel_pool);
+	check("ran after wait", counter, 12);
+}
+
+static struct nvme_thread_pool *nested_pool;
+
+/* work queueing work must not deadlock on the full queues */
+static void spawn_work(void *arg)
+{
+	int i, *d = arg;
+
+	for (i = 1; i < 100; i++)
+		check("queue nested", nvme_thread_pool_queue(nested_pool, work, d + i), 0);
+	work(d);
+}
+
+static void nested_test(void)
+{
+	int i;
+
+	counter = 0;
+	for (i = 0; i < NR_WORK; i++)
+		done[i] = 0;
+
+	nested_pool = nvme_thread_pool_create(2);
+	for (i = 0; i < NR_WORK; i += 100)
+		check("queue", nvme_thread_pool_queue(nested_pool, spawn_work, &done[i]), 0);
+	nvme_thread_pool_destroy(nested_pool);
+
+	check("counter", counter, NR_WORK);
+	for (i = 0; i < NR_WORK; i++)
+		check("executed once", done[i], 1);
+}
+
+int main(void)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	run_test(1, work, NR_WORK);
+	run_test(8, work, NR_WORK);
+	run_test(4, slow_work, 64);
+	/* more than the queues hold at once */
+	run_test(2, slow_work, 4 * NVME_THREAD_POOL_DEPTH);
+	ordered_test();
+	cancel_test();
+	nested_test();
+
+	check("zero threads", nvme_thread_pool_create(0) == NULL, 1);
+	check("jobs", nvme_thread_pool_jobs(8, 3), 3);
+	check("jobs no work", nvme_thread_pool_jobs(8, 0), 1);
+	check("jobs per cpu", nvme_thread_pool_jobs(0, 100000), cpus > 0 ? cpus : 1);
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -43,11 +43,22 @@ static struct tostr_test tostr_tests[] = {
 		U128(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff),
 		"340282366920938463463374607431768211455"
 	},
+	/* across the 10^19 and 10^9 chunks of the digits */
+	{ NULL, U128(0, 0, 0x8ac72304, 0x89e7ffff), "9999999999999999999" },
+	{ NULL, U128(0, 0, 0x8ac72304, 0x89e80000), "10000000000000000000" },
+	{ NULL, U128(0, 0, 0, 1000000000), "1000000000" },
+	{ NULL, U128(0x4b3b4ca8, 0x5a86c47a, 0x098a2240, 0), "100000000000000000000000000000000000000" },
 	{ "fr_FR.utf-8", U128(0, 0, 0, 1000), "1\u202f000" },
+	{
+		"fr_FR.utf-8",
+		U128(0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff),
+		"340\u202f282\u202f366\u202f920\u202f938\u202f463\u202f463\u202f374\u202f607\u202f431\u202f768\u202f211\u202f455"
+	},
 };
 
 void tostr_test(struct tostr_test *test)
 {
+	char buf[NVME_UINT128_STR_LEN];
 	char *str;
 
 	if (!setlocale(LC_NUMERIC, test->locale))
@@ -59,6 +70,13 @@ void tostr_test(struct tostr_test *test)
 		str = uint128_t_to_string(test->val);
 
 	check_str(test->val, test->exp, str);
+
+	if (test->locale)
+		str = uint128_t_to_l10n_str(test->val, buf);
+	else
+		str = uint128_t_to_str(test->val, buf);
+
+	check_str(test->val, test->exp, str);
 }
 
 int main(void)
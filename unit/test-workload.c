@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../util/workload.h"
+#include "check.h"
+
+static int load(const char *text, struct nvme_workload *w, unsigned int *line)
+{
+	FILE *f = fmemopen((void *)text, strlen(text), "r");
+	int err;
+
+	memset(w, 0, sizeof(*w));
+	err = nvme_workload_load(f, w, line);
+	fclose(f);
+	return err;
+}
+
+static void load_test(void)
+{
+	struct nvme_workload w;
+	unsigned int line;
+	char buf[1024];
+	FILE *f;
+
+	check("load", load("# comment\n\n"
+			   "duration_ms=1000 read_pct=70 read_bytes=4096 queue_depth=0x10\n"
+			   "duration_ms=500 idle=1 # trailing\n", &w, &line), 0);
+	check("phases", w.nr, 2);
+	check("duration", w.phases[0].duration_ms, 1000);
+	check("read_pct", w.phases[0].read_pct, 70);
+	check("read_bytes", w.phases[0].read_bytes, 4096);
+	check("queue_depth", w.phases[0].queue_depth, 16);
+	check("missing", w.phases[0].write_bytes, 0);
+	check("idle", w.phases[1].idle, 1);
+
+	/* written back and loaded again */
+	f = fmemopen(buf, sizeof(buf), "w");
+	check("write", nvme_workload_write(f, &w), 0);
+	fclose(f);
+	nvme_workload_free(&w);
+	check("reload", load(buf, &w, &line), 0);
+	check("reload phases", w.nr, 2);
+	check("reload queue_depth", w.phases[0].queue_depth, 16);
+	check("reload idle", w.phases[1].idle, 1);
+	nvme_workload_free(&w);
+
+	check("unknown key", load("duration_ms=1\nfoo=1\n", &w, &line), -EINVAL);
+	check("unknown key line", line, 2);
+	nvme_workload_free(&w);
+	check("range", load("duration_ms=1 read_pct=101\n", &w, &line), -EINVAL);
+	nvme_workload_free(&w);
+	check("no value", load("duration_ms= read_pct=1\n", &w, &line), -EINVAL);
+	nvme_workload_free(&w);
+	check("no duration", load("read_pct=1\n", &w, &line), -EINVAL);
+	nvme_workload_free(&w);
+}
+
+static void add_test(void)
+{
+	struct nvme_workload_sample s = {
+		.duration_ms = 100, .rate = true,
+		.read_bytes = 4096 * 30, .read_cmds = 30,
+		.write_bytes = 16384 * 10, .write_cmds = 10,
+		.rand_read_pct = 50, .rand_write_pct = 0,
+		.queue_depth = 4,
+	};
+	struct nvme_workload_sample idle = { .duration_ms = 100, .rate = true };
+	struct nvme_workload w = { 0 };
+	int i;
+
+	/* ten samples make a phase of a second */
+	for (i = 0; i < 15; i++)
+		check("add", nvme_workload_add(&w, &s, 1000), 0);
+	check("merged", w.nr, 1);
+	check("duration", w.phases[0].duration_ms, 1000);
+	check("read_pct", w.phases[0].read_pct, 75);
+	check("read_bytes", w.phases[0].read_bytes, 4096);
+	check("write_bytes", w.phases[0].write_bytes, 16384);
+	check("rand_read_pct", w.phases[0].rand_read_pct, 50);
+	check("queue_depth", w.phases[0].queue_depth, 4);
+	check("iops", w.phases[0].iops, 400);
+	check("bytes_per_sec", w.phases[0].bytes_per_sec, (4096 * 30 + 16384 * 10) * 10);
+
+	/* idle samples end the busy phase and are kept together */
+	for (i = 0; i < 20; i++)
+		nvme_workload_add(&w, &idle, 1000);
+	check("busy cut short", w.nr, 2);
+	check("busy rest", w.phases[1].duration_ms, 500);
+	s.rate = false;
+	nvme_workload_add(&w, &s, 1000);
+	check("finish", nvme_workload_finish(&w), 0);
+	check("phases", w.nr, 4);
+	check("idle", w.phases[2].idle, 1);
+	check("idle duration", w.phases[2].duration_ms, 2000);
+	check("no rate", w.phases[3].iops, 0);
+	check("no rate mix", w.phases[3].read_pct, 75);
+	nvme_workload_free(&w);
+}
+
+int main(void)
+{
+	load_test();
+	add_test();
+
+	return test_rc ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include "alloc-stats.h"
+
+#if CONFIG_ALLOC_STATS
+#include <inttypes.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "mem.h"
+#include "timing.h"
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static bool enabled;
+
+static struct alloc_phase {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes;		/* asked for */
+	int64_t peak;		/* of the live heap while in the phase */
+} phases[NVME_TIMING_NR];
+
+/* usable sizes of the blocks allocated since the start, less the freed ones */
+static int64_t live, peak;
+
+/*
+ * The blocks allocated since the start by address, so that freeing one
+ * allocated before isn't taken off the live heap. Linear probing, grown
+ * at half load, with the table itself outside the accounting.
+ */
+struct alloc_block {
+	uintptr_t p;		/* 0 for a free slot */
+	size_t size;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct alloc_block *b;
+	size_t nr;
+	size_t size;		/* a power of 2 */
+} blocks = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static size_t block_slot(uintptr_t p, size_t size)
+{
+	uint64_t h = (uint64_t)p * 0x9e3779b97f4a7c15ULL;
+
+	return (h >> 32) & (size - 1);
+}
+
+static void block_put(struct alloc_block *b, size_t size, uintptr_t p, size_t len)
+{
+	size_t i = block_slot(p, size);
+
+	while (b[i].p)
+		i = (i + 1) & (size - 1);
+	b[i].p = p;
+	b[i].size = len;
+}
+
+/* called with the lock held, false if the table is full and can't grow */
+static bool blocks_reserve(void)
+{
+	size_t size = blocks.size ? 2 * blocks.size : 4096, i;
+	struct alloc_block *b;
+
+	if (2 * (blocks.nr + 1) <= blocks.size)
+		return true;
+
+	b = __libc_calloc(size, sizeof(*b));
+	if (!b)
+		return blocks.nr < blocks.size;
+	for (i = 0; i < blocks.size; i++)
+		if (blocks.b[i].p)
+			block_put(b, size, blocks.b[i].p, blocks.b[i].size);
+	__libc_free(blocks.b);
+	blocks.b = b;
+	blocks.size = size;
+
+	return true;
+}
+
+static bool block_add(void *p, size_t len)
+{
+	bool added;
+
+	pthread_mutex_lock(&blocks.lock);
+	added = blocks_reserve();
+	if (added) {
+		block_put(blocks.b, blocks.size, (uintptr_t)p, len);
+		blocks.nr++;
+	}
+	pthread_mutex_unlock(&blocks.lock);
+
+	return added;
+}
+
+/* the usable size of @p when it was allocated, 0 if it isn't tracked */
+static size_t block_del(void *p)
+{
+	size_t i, j, k, mask, len = 0;
+
+	pthread_mutex_lock(&blocks.lock);
+	if (!blocks.size)
+		goto out;
+	mask = blocks.size - 1;
+	for (i = block_slot((uintptr_t)p, blocks.size); blocks.b[i].p != (uintptr_t)p;
+	     i = (i + 1) & mask)
+		if (!blocks.b[i].p)
+			goto out;
+	len = blocks.b[i].size;
+	blocks.nr--;
+
+	/* move back the entries of the run after it that probed past the slot */
+	for (j = (i + 1) & mask; blocks.b[j].p; j = (j + 1) & mask) {
+		k = block_slot(blocks.b[j].p, blocks.size);
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			blocks.b[i] = blocks.b[j];
+			i = j;
+		}
+	}
+	blocks.b[i].p = 0;
+out:
+	pthread_mutex_unlock(&blocks.lock);
+
+	return len;
+}
+
+static void update_peak(int64_t *peak, int64_t cur)
+{
+	int64_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+	while (cur > old &&
+	       !__atomic_compare_exchange_n(peak, &old, cur, true,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static void *account(void *p, size_t size)
+{
+	struct alloc_phase *ph;
+	size_t len;
+	int64_t cur;
+
+	if (!enabled || !p)
+		return p;
+
+	ph = &phases[nvme_timing_phase()];
+	__atomic_fetch_add(&ph->allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&ph->bytes, size, __ATOMIC_RELAXED);
+	/* a block that can't be tracked is left out of the live heap */
+	len = malloc_usable_size(p);
+	if (!block_add(p, len))
+		return p;
+	cur = __atomic_add_fetch(&live, len, __ATOMIC_RELAXED);
+	update_peak(&ph->peak, cur);
+	update_peak(&peak, cur);
+
+	return p;
+}
+
+/* only the blocks allocated since the start count */
+static void unaccount(void *p)
+{
+	size_t len;
+
+	if (!enabled || !p)
+		return;
+
+	len = block_del(p);
+	if (!len)
+		return;
+	__atomic_fetch_add(&phases[nvme_timing_phase()].frees, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&live, len, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+	return account(__libc_malloc(size), size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	return account(__libc_calloc(nmemb, size), nmemb * size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	void *p = __libc_realloc(ptr, size);
+
+	if (!enabled || (!p && size))
+		return p;
+
+	/* a free and an allocation, growing in place charges the difference */
+	unaccount(ptr);
+
+	return account(p, size);
+}
+
+void free(void *ptr)
+{
+	unaccount(ptr);
+	__libc_free(ptr);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	if (!alignment || alignment & (alignment - 1) ||
+	    alignment % sizeof(void *))
+		return EINVAL;
+
+	p = __libc_memalign(alignment, size);
+	if (!p)
+		return ENOMEM;
+
+	*memptr = account(p, size);
+	return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	return account(__libc_memalign(alignment, size), size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+	return account(__libc_memalign(alignment, size), size);
+}
+
+int nvme_alloc_stats_start(void)
+{
+	/* the phases come from the timing accounting */
+	nvme_timing_track();
+	enabled = true;
+
+	return 0;
+}
+
+static uint64_t hugetlb_bytes(void)
+{
+	unsigned long long kib = 0;
+	char line[128];
+	FILE *f;
+
+	f = fopen("/proc/self/status", "r");
+	if (!f)
+		return 0;
+
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "HugetlbPages: %llu kB", &kib) == 1)
+			break;
+	fclose(f);
+
+	return kib * 1024;
+}
+
+void nvme_alloc_stats_report(FILE *f)
+{
+	struct nvme_mem_huge_stats hs;
+	struct rusage ru;
+	const char *sep = "";
+	int i;
+
+	if (!enabled)
+		return;
+
+	/* the report's own allocations don't count */
+	enabled = false;
+
+	if (getrusage(RUSAGE_SELF, &ru))
+		ru.ru_maxrss = 0;
+	nvme_huge_cache_stats(&hs);
+
+	fprintf(f, "{\"alloc_stats\":{\"phases\":{");
+	for (i = 0; i < NVME_TIMING_NR; i++) {
+		if (!phases[i].allocs && !phases[i].frees)
+			continue;
+		fprintf(f, "%s\"%s\":{\"allocs\":%" PRIu64 ",\"frees\":%" PRIu64
+			",\"bytes\":%" PRIu64 ",\"peak_heap\":%" PRId64 "}",
+			sep, nvme_timing_phase_name(i), phases[i].allocs,
+			phases[i].frees, phases[i].bytes, phases[i].peak);
+		sep = ",";
+	}
+	fprintf(f, "},\"peak_heap\":%" PRId64 ",\"peak_rss\":%llu,\"hugetlb\":%"
+		PRIu64 ",\"huge_buffers\":{\"hits\":%lu,\"misses\":%lu,"
+		"\"hugetlb\":%lu,\"thp\":%lu,\"cached\":%zu}}}\n",
+		peak, (unsigned long long)ru.ru_maxrss * 1024, hugetlb_bytes(),
+		hs.hits, hs.misses, hs.hugetlb, hs.thp, hs.cached);
+}
+#else /* !__GLIBC__ */
+int nvme_alloc_stats_start(void)
+{
+	return -ENOTSUP;
+}
+
+void nvme_alloc_stats_report(FILE *f)
+{
+}
+#endif /* __GLIBC__ */
+#endif /* CONFIG_ALLOC_STATS */
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_ALLOC_STATS_H
+#define __UTIL_ALLOC_STATS_H
+
+#include <errno.h>
+#include <stdio.h>
+
+/*
+ * Heap accounting for --alloc-stats, in builds configured with
+ * -Dalloc-stats=true. malloc() and friends are interposed for the whole
+ * process, so libnvme and json-c are counted along with nvme-cli. The
+ * calls, the bytes asked for and the peak of the live heap are charged to
+ * the timing phase current at the time, and the report adds the peak RSS
+ * and the HugeTLB and huge buffer use of the process.
+ */
+#if CONFIG_ALLOC_STATS
+/* nvme_alloc_stats_start - count from now on, returns 0 */
+int nvme_alloc_stats_start(void);
+
+/* nvme_alloc_stats_report - print the counters to @f as a JSON object */
+void nvme_alloc_stats_report(FILE *f);
+#else
+static inline int nvme_alloc_stats_start(void)
+{
+	return -ENOTSUP;
+}
+
+static inline void nvme_alloc_stats_report(FILE *f)
+{
+}
+#endif
+
+#endif /* __UTIL_ALLOC_STATS_H */
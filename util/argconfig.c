@@ -31,6 +31,7 @@
 
 #include "argconfig.h"
 #include "suffix.h"
+#include "timing.h"
 
 #include <errno.h>
 #include <inttypes.h>
@@ -317,64 +318,110 @@ static bool argconfig_check_human_readable(struct argconfig_commandline_options
 	return false;
 }
 
-int argconfig_parse(int argc, char *argv[], const char *program_desc,
-		    struct argconfig_commandline_options *options)
+int argconfig_parser_init(struct argconfig_parser *p,
+			  struct argconfig_commandline_options *options)
 {
-	char *short_opts;
-	struct option *long_opts;
 	struct argconfig_commandline_options *s;
-	int c, option_index = 0, short_index = 0, options_count = 0;
-	int ret = 0;
+	int option_index = 0, short_index = 0;
+
+	memset(p, 0, sizeof(*p));
+	memset(p->short_index, 0xff, sizeof(p->short_index));
+	p->options = options;
 
-	errno = 0;
 	for (s = options; s->option; s++)
-		options_count++;
+		p->count++;
 
-	long_opts = calloc(1, sizeof(struct option) * (options_count + 3));
-	short_opts = calloc(1, sizeof(*short_opts) * (options_count * 3 + 5));
+	p->long_opts = calloc(p->count + 3, sizeof(*p->long_opts));
+	p->short_opts = calloc(p->count * 3 + 5, sizeof(*p->short_opts));
+	if (!p->long_opts || !p->short_opts) {
+		int err = errno;
 
-	if (!long_opts || !short_opts) {
-		fprintf(stderr, "failed to allocate memory for opts: %s\n", strerror(errno));
-		ret = -errno;
-		goto out;
+		fprintf(stderr, "failed to allocate memory for opts: %s\n", strerror(err));
+		argconfig_parser_free(p);
+		return -err;
 	}
 
-	for (s = options; s->option && option_index < options_count; s++) {
+	for (s = options; s->option && option_index < p->count; s++) {
 		if (s->short_option) {
-			short_opts[short_index++] = s->short_option;
+			unsigned char c = s->short_option;
+
+			p->short_opts[short_index++] = s->short_option;
 			if (s->argument_type == required_argument ||
 			    s->argument_type == optional_argument)
-				short_opts[short_index++] = ':';
+				p->short_opts[short_index++] = ':';
 			if (s->argument_type == optional_argument)
-				short_opts[short_index++] = ':';
+				p->short_opts[short_index++] = ':';
+			/* the first option using a short option gets it */
+			if (p->short_index[c] < 0)
+				p->short_index[c] = option_index;
 		}
 		if (s->option && strlen(s->option)) {
-			long_opts[option_index].name = s->option;
-			long_opts[option_index].has_arg = s->argument_type;
+			p->long_opts[option_index].name = s->option;
+			p->long_opts[option_index].has_arg = s->argument_type;
 		}
-		s->seen = false;
 		option_index++;
 	}
 
-	long_opts[option_index].name = "help";
-	long_opts[option_index].val = 'h';
+	p->long_opts[option_index].name = "help";
+	p->long_opts[option_index].val = 'h';
+
+	p->short_opts[short_index++] = '?';
+	p->short_opts[short_index] = 'h';
+
+	return 0;
+}
+
+bool argconfig_parser_rebind(struct argconfig_parser *p,
+			     struct argconfig_commandline_options *options)
+{
+	struct argconfig_commandline_options *s, *o = p->options;
+	int i;
+
+	for (i = 0, s = options; i < p->count; i++, s++, o++) {
+		if (!s->option || s->short_option != o->short_option ||
+		    s->argument_type != o->argument_type ||
+		    (s->option != o->option && strcmp(s->option, o->option)))
+			return false;
+	}
+	if (s->option)
+		return false;
+
+	p->options = options;
+
+	return true;
+}
+
+void argconfig_parser_free(struct argconfig_parser *p)
+{
+	free(p->short_opts);
+	free(p->long_opts);
+	p->short_opts = NULL;
+	p->long_opts = NULL;
+}
 
-	short_opts[short_index++] = '?';
-	short_opts[short_index] = 'h';
+int argconfig_parser_parse(struct argconfig_parser *p, int argc, char *argv[],
+			   const char *program_desc)
+{
+	struct argconfig_commandline_options *options = p->options, *s;
+	enum nvme_timing_phase phase = nvme_timing_switch(NVME_TIMING_PARSE);
+	int c, i, option_index = 0;
+	int ret = 0;
+
+	errno = 0;
+	for (i = 0; i < p->count; i++)
+		options[i].seen = false;
 
 	optind = 0;
-	while ((c = getopt_long_only(argc, argv, short_opts, long_opts, &option_index)) != -1) {
+	while ((c = getopt_long_only(argc, argv, p->short_opts, p->long_opts,
+				     &option_index)) != -1) {
 		if (c) {
 			if (c == '?' || c == 'h') {
 				argconfig_print_help(program_desc, options);
 				ret = -EINVAL;
 				break;
 			}
-			for (option_index = 0; option_index < options_count; option_index++) {
-				if (c == options[option_index].short_option)
-					break;
-			}
-			if (option_index == options_count)
+			option_index = p->short_index[(unsigned char)c];
+			if (option_index < 0)
 				continue;
 		}
 
@@ -385,19 +432,36 @@ int argconfig_parse(int argc, char *argv[], const char *program_desc,
 			continue;
 
 		if (s->opt_val)
-			ret = argconfig_parse_val(s, long_opts, option_index);
+			ret = argconfig_parse_val(s, p->long_opts, option_index);
 		else
-			ret = argconfig_parse_type(s, long_opts, option_index);
+			ret = argconfig_parse_type(s, p->long_opts, option_index);
 		if (ret)
 			break;
 	}
 
-	if (!argconfig_check_human_readable(options))
+	/* nothing switches back, so once per parser is enough */
+	if (!p->c_locale && !argconfig_check_human_readable(options)) {
 		setlocale(LC_ALL, "C");
+		p->c_locale = true;
+	}
+
+	nvme_timing_switch(phase);
+	return ret;
+}
+
+int argconfig_parse(int argc, char *argv[], const char *program_desc,
+		    struct argconfig_commandline_options *options)
+{
+	struct argconfig_parser p;
+	int ret;
+
+	ret = argconfig_parser_init(&p, options);
+	if (ret)
+		return ret;
+
+	ret = argconfig_parser_parse(&p, argc, argv, program_desc);
+	argconfig_parser_free(&p);
 
-out:
-	free(short_opts);
-	free(long_opts);
 	return ret;
 }
 
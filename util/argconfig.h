@@ -170,6 +170,36 @@ void argconfig_print_help(const char *program_desc,
 			  struct argconfig_commandline_options *options);
 int argconfig_parse(int argc, char *argv[], const char *program_desc,
 		    struct argconfig_commandline_options *options);
+
+/*
+ * The getopt tables of an option array, built once so that many argument
+ * vectors can be parsed against the same options without rebuilding
+ * them. argconfig_parse() is init, parse and free in one. The options
+ * must stay valid as long as the parser is used.
+ */
+struct argconfig_parser {
+	struct argconfig_commandline_options *options;
+	int count;
+	struct option *long_opts;
+	char *short_opts;
+	short short_index[256];		/* option of a short option, or -1 */
+	bool c_locale;			/* switched to the C locale */
+};
+
+int argconfig_parser_init(struct argconfig_parser *p,
+			  struct argconfig_commandline_options *options);
+int argconfig_parser_parse(struct argconfig_parser *p, int argc, char *argv[],
+			   const char *program_desc);
+
+/*
+ * argconfig_parser_rebind - parse into @options with the tables of @p from
+ * now on, e.g. the options of another call of the same command, whose values
+ * live elsewhere. Returns false, leaving @p as it was, unless @options have
+ * the names, short options and argument types @p was built for.
+ */
+bool argconfig_parser_rebind(struct argconfig_parser *p,
+			     struct argconfig_commandline_options *options);
+void argconfig_parser_free(struct argconfig_parser *p);
 int argconfig_parse_comma_sep_array(char *string, int *ret, unsigned int max_length);
 int argconfig_parse_comma_sep_array_short(char *string, unsigned short *ret,
 					  unsigned int max_length);
@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <ctype.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+
+void nvme_batch_init(struct nvme_batch *b, FILE *f)
+{
+	memset(b, 0, sizeof(*b));
+	b->f = f;
+}
+
+static int batch_reserve(struct nvme_batch *b, size_t size)
+{
+	char *words;
+
+	if (size <= b->words_size)
+		return 0;
+
+	words = realloc(b->words, size);
+	if (!words)
+		return -ENOMEM;
+	b->words = words;
+	b->words_size = size;
+
+	return 0;
+}
+
+static int batch_argv(struct nvme_batch *b, int argc)
+{
+	char **argv, *w;
+	int i;
+
+	if (argc >= b->nr_argv) {
+		argv = realloc(b->argv, (argc + 1) * sizeof(*argv));
+		if (!argv)
+			return -ENOMEM;
+		b->argv = argv;
+		b->nr_argv = argc + 1;
+	}
+
+	/* the words are stored back to back, each with its terminator */
+	for (i = 0, w = b->words; i < argc; i++, w += strlen(w) + 1)
+		b->argv[i] = w;
+	b->argv[argc] = NULL;
+
+	return 0;
+}
+
+int nvme_batch_next(struct nvme_batch *b, char ***argv)
+{
+	bool word = false, cont = false;
+	size_t len = 0;
+	char quote = 0;
+	int argc = 0;
+	ssize_t n;
+	char *p;
+	int err;
+
+	do {
+		n = getline(&b->line, &b->size, b->f);
+		if (n < 0)
+			break;
+		if (!argc)
+			b->lineno = b->next + 1;
+		b->next++;
+
+		/* a line adds at most its own length and one terminator */
+		err = batch_reserve(b, len + n + 1);
+		if (err)
+			return err;
+
+		cont = false;
+		for (p = b->line; *p && *p != '\n'; p++) {
+			if (quote == '\'') {
+				if (*p == '\'')
+					quote = 0;
+				else
+					b->words[len++] = *p;
+				continue;
+			}
+			if (quote == '"') {
+				if (*p == '"') {
+					quote = 0;
+					continue;
+				}
+				if (*p == '\\' && p[1] && p[1] != '\n')
+					p++;
+				b->words[len++] = *p;
+				continue;
+			}
+
+			if (isspace((unsigned char)*p)) {
+				if (word)
+					b->words[len++] = '\0';
+				word = false;
+				continue;
+			}
+			if (*p == '#' && !word)
+				break;
+
+			if (*p == '\\' && (!p[1] || p[1] == '\n')) {
+				cont = true;
+				break;
+			}
+
+			if (!word) {
+				word = true;
+				argc++;
+			}
+			if (*p == '\'' || *p == '"') {
+				quote = *p;
+				continue;
+			}
+			if (*p == '\\')
+				p++;
+			b->words[len++] = *p;
+		}
+		if (quote)
+			return -EINVAL;
+
+		if (!cont && word) {
+			b->words[len++] = '\0';
+			word = false;
+		}
+	} while (cont || !argc);
+
+	if (word)
+		b->words[len++] = '\0';
+	if (!argc)
+		return 0;
+
+	err = batch_argv(b, argc);
+	if (err)
+		return err;
+	*argv = b->argv;
+
+	return argc;
+}
+
+void nvme_batch_free(struct nvme_batch *b)
+{
+	free(b->line);
+	free(b->words);
+	free(b->argv);
+	memset(b, 0, sizeof(*b));
+}
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_BATCH_H
+#define __UTIL_BATCH_H
+
+#include <stdio.h>
+
+/*
+ * Reader for nvme -b scripts: one command line per line, split into words
+ * like a shell would without any expansion. Words are separated by blanks,
+ * single quotes keep everything up to the next single quote, double quotes
+ * and a backslash outside of quotes escape the next character, a '#' at
+ * the start of a word comments out the rest of the line and a backslash at
+ * the end of a line continues it on the next one.
+ */
+struct nvme_batch {
+	FILE *f;
+	unsigned int lineno;	/* line the last command started on */
+	unsigned int next;	/* lines read so far */
+
+	char *line;
+	size_t size;
+	char *words;		/* the words of the command, NUL separated */
+	size_t words_size;
+	char **argv;
+	int nr_argv;
+};
+
+/* nvme_batch_init - read the commands from @f, which stays owned by the caller */
+void nvme_batch_init(struct nvme_batch *b, FILE *f);
+
+/*
+ * nvme_batch_next - read the next command
+ *
+ * Blank lines and comments are skipped. The words stay valid until the
+ * next call, @argv is NULL terminated.
+ *
+ * Returns the number of words, 0 at the end of the input, -EINVAL for an
+ * unterminated quote or -ENOMEM.
+ */
+int nvme_batch_next(struct nvme_batch *b, char ***argv);
+
+void nvme_batch_free(struct nvme_batch *b);
+
+#endif /* __UTIL_BATCH_H */
@@ -0,0 +1,306 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <endian.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bundle.h"
+#include "crc32.h"
+
+struct nvme_bundle_writer {
+	pthread_mutex_t lock;
+	int fd;
+	int err;
+	uint64_t off;			/* end of the data written */
+	struct nvme_bundle_toc *toc;
+	uint32_t nr;
+	uint32_t size;
+};
+
+static int pwrite_full(int fd, const void *buf, size_t len, uint64_t off)
+{
+	ssize_t n;
+
+	while (len) {
+		n = pwrite(fd, buf, len, off);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+		off += n;
+	}
+
+	return 0;
+}
+
+static uint64_t bundle_align(uint64_t off)
+{
+	return (off + NVME_BUNDLE_ALIGN - 1) & ~(uint64_t)(NVME_BUNDLE_ALIGN - 1);
+}
+
+struct nvme_bundle_writer *nvme_bundle_create(int fd)
+{
+	struct nvme_bundle_writer *w;
+	struct nvme_bundle_hdr hdr;
+	int err;
+
+	/* a header without a table until the bundle is closed */
+	memset(&hdr, 0, sizeof(hdr));
+	err = pwrite_full(fd, &hdr, sizeof(hdr), 0);
+	if (err) {
+		errno = -err;
+		return NULL;
+	}
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	pthread_mutex_init(&w->lock, NULL);
+	w->fd = fd;
+	w->off = sizeof(hdr);
+
+	return w;
+}
+
+static void copy_str(char *dst, size_t size, const char *src)
+{
+	memset(dst, 0, size);
+	if (src)
+		memcpy(dst, src, strnlen(src, size));
+}
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int nvme_bundle_add(struct nvme_bundle_writer *w, const struct nvme_bundle_entry *e,
+		    const void *data, size_t len)
+{
+	struct nvme_bundle_toc *toc, *r;
+	uint32_t crc = crc32(0, data, len);
+	uint64_t off;
+	int err;
+
+	pthread_mutex_lock(&w->lock);
+	err = w->err;
+	if (err)
+		goto out;
+
+	if (w->nr == w->size) {
+		uint32_t size = w->size ? 2 * w->size : 64;
+
+		toc = realloc(w->toc, size * sizeof(*toc));
+		if (!toc) {
+			err = -ENOMEM;
+			goto out;
+		}
+		w->toc = toc;
+		w->size = size;
+	}
+
+	/* the gap to the aligned start is a hole of the file */
+	off = bundle_align(w->off);
+	err = pwrite_full(w->fd, data, len, off);
+	if (err)
+		goto out;
+	w->off = off + len;
+
+	r = &w->toc[w->nr++];
+	memset(r, 0, sizeof(*r));
+	copy_str(r->name, sizeof(r->name), e->name);
+	copy_str(r->dev, sizeof(r->dev), e->dev);
+	copy_str(r->sn, sizeof(r->sn), e->sn);
+	r->lid = e->lid;
+	r->lsp = e->lsp;
+	r->lsi = htole16(e->lsi);
+	r->crc = htole32(crc);
+	r->off = htole64(off);
+	r->len = htole64(len);
+	r->timestamp = htole64(e->timestamp ? e->timestamp : now_ms());
+out:
+	if (err && err != -ENOMEM)
+		w->err = err;
+	pthread_mutex_unlock(&w->lock);
+
+	return err;
+}
+
+int nvme_bundle_close(struct nvme_bundle_writer *w)
+{
+	size_t toc_len = w->nr * sizeof(*w->toc);
+	uint64_t toc_off = (w->off + 7) & ~(uint64_t)7;
+	struct nvme_bundle_hdr hdr;
+	int err = w->err;
+
+	if (!err)
+		err = pwrite_full(w->fd, w->toc, toc_len, toc_off);
+
+	if (!err) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, NVME_BUNDLE_MAGIC, sizeof(hdr.magic));
+		hdr.version = htole32(NVME_BUNDLE_VERSION);
+		hdr.nr = htole32(w->nr);
+		hdr.toc_off = htole64(toc_off);
+		hdr.toc_crc = htole32(crc32(0, w->toc, toc_len));
+		err = pwrite_full(w->fd, &hdr, sizeof(hdr), 0);
+	}
+
+	/* the file may be longer, from an earlier bundle */
+	if (!err && ftruncate(w->fd, toc_off + toc_len))
+		err = -errno;
+
+	pthread_mutex_destroy(&w->lock);
+	free(w->toc);
+	free(w);
+
+	return err;
+}
+
+bool nvme_bundle_is_bundle(const void *data, size_t len)
+{
+	return len >= sizeof(struct nvme_bundle_hdr) &&
+		!memcmp(data, NVME_BUNDLE_MAGIC, sizeof(((struct nvme_bundle_hdr *)0)->magic));
+}
+
+int nvme_bundle_open(struct nvme_bundle *b, const void *data, size_t len)
+{
+	const struct nvme_bundle_hdr *hdr = data;
+	const struct nvme_bundle_toc *r;
+	uint64_t toc_off, off, elen;
+	uint32_t i, nr;
+
+	memset(b, 0, sizeof(*b));
+
+	if (!nvme_bundle_is_bundle(data, len) ||
+	    le32toh(hdr->version) != NVME_BUNDLE_VERSION)
+		return -EINVAL;
+
+	nr = le32toh(hdr->nr);
+	toc_off = le64toh(hdr->toc_off);
+	if (!toc_off || toc_off > len || (len - toc_off) / sizeof(*r) < nr ||
+	    toc_off % sizeof(uint64_t))
+		return -EINVAL;
+
+	r = (const void *)((const uint8_t *)data + toc_off);
+	if (crc32(0, r, nr * sizeof(*r)) != le32toh(hdr->toc_crc))
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		off = le64toh(r[i].off);
+		elen = le64toh(r[i].len);
+		if (off % NVME_BUNDLE_ALIGN || off > toc_off || elen > toc_off - off)
+			return -EINVAL;
+	}
+
+	b->data = data;
+	b->len = len;
+	b->toc = r;
+	b->nr = nr;
+
+	return 0;
+}
+
+static void copy_field(char *dst, const char *src, size_t size)
+{
+	memcpy(dst, src, size);
+	dst[size] = '\0';
+}
+
+void nvme_bundle_get(const struct nvme_bundle *b, uint32_t i,
+		     struct nvme_bundle_entry *e)
+{
+	const struct nvme_bundle_toc *r = &b->toc[i];
+
+	copy_field(e->name, r->name, sizeof(r->name));
+	copy_field(e->dev, r->dev, sizeof(r->dev));
+	copy_field(e->sn, r->sn, sizeof(r->sn));
+	e->lid = r->lid;
+	e->lsp = r->lsp;
+	e->lsi = le16toh(r->lsi);
+	e->timestamp = le64toh(r->timestamp);
+	e->crc = le32toh(r->crc);
+	e->data = b->data + le64toh(r->off);
+	e->len = le64toh(r->len);
+}
+
+static bool field_eq(const char *field, size_t size, const char *s)
+{
+	size_t len = strlen(s);
+
+	return len <= size && !memcmp(field, s, len) && (len == size || !field[len]);
+}
+
+int nvme_bundle_find(const struct nvme_bundle *b, const char *dev, const char *name)
+{
+	const struct nvme_bundle_toc *r;
+	uint32_t i;
+
+	for (i = 0; i < b->nr; i++) {
+		r = &b->toc[i];
+		if (field_eq(r->name, sizeof(r->name), name) &&
+		    (!dev || field_eq(r->dev, sizeof(r->dev), dev)))
+			return i;
+	}
+
+	return -ENOENT;
+}
+
+const void *nvme_bundle_page(const struct nvme_bundle *b, uint32_t i, uint64_t page,
+			     size_t *len)
+{
+	const struct nvme_bundle_toc *r = &b->toc[i];
+	uint64_t elen = le64toh(r->len);
+	uint64_t off = page * NVME_BUNDLE_ALIGN;
+
+	if (page >= elen / NVME_BUNDLE_ALIGN + !!(elen % NVME_BUNDLE_ALIGN))
+		return NULL;
+
+	*len = elen - off < NVME_BUNDLE_ALIGN ? elen - off : NVME_BUNDLE_ALIGN;
+	return b->data + le64toh(r->off) + off;
+}
+
+bool nvme_bundle_verify(const struct nvme_bundle_entry *e)
+{
+	return crc32(0, e->data, e->len) == e->crc;
+}
+
+int nvme_bundle_walk(const void *data, size_t len, nvme_bundle_walk_fn fn, void *arg)
+{
+	struct nvme_bundle_entry e;
+	struct nvme_bundle b;
+	char name[sizeof(e.dev) + sizeof(e.name)];
+	uint32_t i;
+	int err;
+
+	err = nvme_bundle_open(&b, data, len);
+	if (err)
+		return err;
+
+	for (i = 0; i < b.nr; i++) {
+		nvme_bundle_get(&b, i, &e);
+		if (!nvme_bundle_verify(&e))
+			return -EBADMSG;
+
+		if (e.dev[0])
+			snprintf(name, sizeof(name), "%s-%s", e.dev, e.name);
+		else
+			snprintf(name, sizeof(name), "%s", e.name);
+		err = fn(name, e.data, e.len, arg);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
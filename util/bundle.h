@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_BUNDLE_H
+#define __UTIL_BUNDLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Single file container of the captures of several logs and devices, as
+ * written by collect --bundle and read by decode-archive. Unlike a tar
+ * archive a bundle has a table of contents, one capture is found without
+ * reading the others, and the data of every capture starts on a 4k
+ * boundary, a page of it is at a fixed offset in the mapped file.
+ *
+ * The file is a struct nvme_bundle_hdr, the data of the captures and the
+ * table of contents, struct nvme_bundle_toc records pointed to by the
+ * header, all little endian. The table is written last, by
+ * nvme_bundle_close(); a bundle whose writer didn't finish has none and
+ * is rejected.
+ */
+#define NVME_BUNDLE_MAGIC	"NVMEBDL1"
+#define NVME_BUNDLE_VERSION	1
+#define NVME_BUNDLE_ALIGN	4096
+
+struct nvme_bundle_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t nr;		/* records of the table of contents */
+	uint64_t toc_off;
+	uint32_t toc_crc;	/* CRC-32 of the records */
+	uint8_t rsvd[36];
+};
+
+struct nvme_bundle_toc {
+	char name[40];		/* of the capture, e.g. "smart-log" */
+	char dev[32];		/* the device it was read from */
+	char sn[20];		/* serial number of the controller */
+	uint8_t lid;
+	uint8_t lsp;
+	uint16_t lsi;
+	uint32_t crc;		/* CRC-32 of the data */
+	uint32_t rsvd;
+	uint64_t off;		/* of the data, a multiple of NVME_BUNDLE_ALIGN */
+	uint64_t len;
+	uint64_t timestamp;	/* ms since the epoch */
+};
+
+/* A capture of a bundle, the strings are NUL terminated */
+struct nvme_bundle_entry {
+	char name[41];
+	char dev[33];
+	char sn[21];
+	uint8_t lid;
+	uint8_t lsp;
+	uint16_t lsi;
+	uint64_t timestamp;	/* 0 when added for the current time */
+	uint32_t crc;
+	const void *data;	/* in place, when read */
+	size_t len;
+};
+
+struct nvme_bundle_writer;
+
+/*
+ * nvme_bundle_create - start a bundle written to the seekable @fd
+ *
+ * Returns the writer or NULL with errno set.
+ */
+struct nvme_bundle_writer *nvme_bundle_create(int fd);
+
+/*
+ * nvme_bundle_add - add the @len bytes of @data described by @e, whose
+ * data and len are ignored
+ *
+ * Captures can be added from several threads. Returns 0 or a negative
+ * errno, the bundle is unusable after an error.
+ */
+int nvme_bundle_add(struct nvme_bundle_writer *w, const struct nvme_bundle_entry *e,
+		    const void *data, size_t len);
+
+/*
+ * nvme_bundle_close - write the table of contents and free the writer,
+ * @fd stays open
+ *
+ * Returns 0 or the first error of the bundle as a negative errno.
+ */
+int nvme_bundle_close(struct nvme_bundle_writer *w);
+
+/* A bundle in memory, e.g. mapped */
+struct nvme_bundle {
+	const uint8_t *data;
+	size_t len;
+	const struct nvme_bundle_toc *toc;
+	uint32_t nr;
+};
+
+/* whether the @len bytes at @data start with a bundle header */
+bool nvme_bundle_is_bundle(const void *data, size_t len);
+
+/*
+ * nvme_bundle_open - check the bundle at @data and its table of contents
+ *
+ * The captures themselves aren't read. Returns 0, or -EINVAL if the
+ * bundle is truncated or the table is corrupt.
+ */
+int nvme_bundle_open(struct nvme_bundle *b, const void *data, size_t len);
+
+/* nvme_bundle_get - the capture @i of the table of contents into @e */
+void nvme_bundle_get(const struct nvme_bundle *b, uint32_t i,
+		     struct nvme_bundle_entry *e);
+
+/*
+ * nvme_bundle_find - the first capture @name of the device @dev, any
+ * device if NULL
+ *
+ * Returns its index or -ENOENT.
+ */
+int nvme_bundle_find(const struct nvme_bundle *b, const char *dev, const char *name);
+
+/*
+ * nvme_bundle_page - the 4k page @page of the capture @i, and in @len its
+ * length, shorter for the last page
+ *
+ * Returns NULL past the end of the capture.
+ */
+const void *nvme_bundle_page(const struct nvme_bundle *b, uint32_t i, uint64_t page,
+			     size_t *len);
+
+/* whether the data of @e matches its checksum */
+bool nvme_bundle_verify(const struct nvme_bundle_entry *e);
+
+typedef int (*nvme_bundle_walk_fn)(const char *name, const void *data, size_t len,
+				   void *arg);
+
+/*
+ * nvme_bundle_walk - call @fn for each capture of the bundle at @data, in
+ * the order they were added
+ *
+ * @name is "<dev>-<name>" as collect names its files. Stops at the first
+ * non zero return of @fn, which is returned. Returns -EINVAL if the
+ * bundle is corrupt and -EBADMSG if a capture doesn't match its checksum.
+ */
+int nvme_bundle_walk(const void *data, size_t len, nvme_bundle_walk_fn fn, void *arg);
+
+#endif /* __UTIL_BUNDLE_H */
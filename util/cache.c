@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "cache.h"
+
+static int mkdir_p(char *path)
+{
+	char *p;
+
+	for (p = path + 1; *p; p++) {
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(path, 0755) && errno != EEXIST) {
+			*p = '/';
+			return -1;
+		}
+		*p = '/';
+	}
+
+	return mkdir(path, 0755) && errno != EEXIST ? -1 : 0;
+}
+
+int cache_dir_init(char *dir)
+{
+	struct stat st;
+
+	if (mkdir_p(dir) || stat(dir, &st))
+		return -1;
+
+	if (!S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+	    st.st_mode & (S_IWGRP | S_IWOTH)) {
+		errno = EPERM;
+		return -1;
+	}
+
+	return 0;
+}
+
+static int cache_open(const char *path, const void *key, size_t key_len,
+		      struct stat *st)
+{
+	char *buf;
+	bool hit;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	buf = malloc(key_len);
+	hit = buf && !fstat(fd, st) && st->st_size >= (off_t)key_len &&
+	      read(fd, buf, key_len) == (ssize_t)key_len &&
+	      !memcmp(buf, key, key_len);
+	free(buf);
+	if (!hit) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+bool cache_read(const char *path, const void *key, size_t key_len,
+		void *data, size_t len)
+{
+	struct stat st;
+	bool hit;
+	int fd;
+
+	fd = cache_open(path, key, key_len, &st);
+	if (fd < 0)
+		return false;
+
+	hit = st.st_size == (off_t)(key_len + len) &&
+	      read(fd, data, len) == (ssize_t)len;
+	close(fd);
+
+	return hit;
+}
+
+void *cache_read_alloc(const char *path, const void *key, size_t key_len,
+		       size_t *len)
+{
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = cache_open(path, key, key_len, &st);
+	if (fd < 0)
+		return NULL;
+
+	*len = st.st_size - key_len;
+	data = malloc(*len ? *len : 1);
+	if (data && read(fd, data, *len) != (ssize_t)*len) {
+		free(data);
+		data = NULL;
+	}
+	close(fd);
+
+	return data;
+}
+
+int cache_write(const char *path, const void *key, size_t key_len,
+		const void *data, size_t len)
+{
+	char tmp[PATH_MAX];
+	bool ok;
+	int fd;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		return -1;
+
+	ok = write(fd, key, key_len) == (ssize_t)key_len &&
+	     write(fd, data, len) == (ssize_t)len;
+	ok = !fchmod(fd, 0644) && ok;
+	close(fd);
+
+	if (!ok || rename(tmp, path)) {
+		unlink(tmp);
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_CACHE_H
+#define __UTIL_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Small file based caches. Each entry starts with a key block describing
+ * what the data was read from, a lookup only hits if the stored key
+ * matches. Entries are replaced atomically, so concurrent readers see
+ * either the old or the complete new entry.
+ */
+
+/*
+ * cache_dir_init - create @dir including its parents
+ *
+ * The cache is trusted, so this fails unless @dir is a directory owned by
+ * the effective user and not writable by group or others.
+ */
+int cache_dir_init(char *dir);
+
+/*
+ * cache_read - read the entry @path into @data
+ *
+ * Returns true if the entry starts with @key and holds exactly @len bytes
+ * of data after it.
+ */
+bool cache_read(const char *path, const void *key, size_t key_len,
+		void *data, size_t len);
+
+/*
+ * cache_read_alloc - read the variable sized entry @path
+ *
+ * Returns the malloc'ed data following @key and stores its size in @len,
+ * or NULL if the entry doesn't exist or was stored with a different key.
+ */
+void *cache_read_alloc(const char *path, const void *key, size_t key_len,
+		       size_t *len);
+
+/*
+ * cache_write - store @key followed by @len bytes of @data as @path
+ */
+int cache_write(const char *path, const void *key, size_t key_len,
+		const void *data, size_t len);
+
+#endif /* __UTIL_CACHE_H */
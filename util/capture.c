@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capture.h"
+
+int nvme_capture_map(const char *file, struct nvme_capture *c)
+{
+	struct stat st;
+	void *p;
+	int fd, err = 0;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st)) {
+		err = -errno;
+		goto out;
+	}
+	if (!S_ISREG(st.st_mode) || !st.st_size) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (p == MAP_FAILED) {
+		err = -errno;
+		goto out;
+	}
+	/* the captures are decoded front to back, once */
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	c->data = p;
+	c->len = st.st_size;
+out:
+	close(fd);
+	return err;
+}
+
+void nvme_capture_unmap(struct nvme_capture *c)
+{
+	if (c->data)
+		munmap(c->data, c->len);
+	c->data = NULL;
+	c->len = 0;
+}
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_CAPTURE_H
+#define __UTIL_CAPTURE_H
+
+#include <stddef.h>
+
+/*
+ * Read only access to a capture of a log page or identify data structure,
+ * as written by -o binary or --raw-binary. The file is mapped privately,
+ * so a decoder fixing up fields in place doesn't touch the file, and
+ * nothing is copied into a buffer first.
+ */
+struct nvme_capture {
+	void *data;
+	size_t len;
+};
+
+/*
+ * nvme_capture_map - map all of @file into @c
+ *
+ * Returns 0 or a negative errno, -EINVAL for an empty file.
+ */
+int nvme_capture_map(const char *file, struct nvme_capture *c);
+
+void nvme_capture_unmap(struct nvme_capture *c);
+
+#endif /* __UTIL_CAPTURE_H */
@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <string.h>
+
+#include "cbor.h"
+
+#define CBOR_AI_INDEFINITE	31
+#define CBOR_BREAK		0xff
+
+static void cbor_put_be(FILE *f, uint64_t val, int bytes)
+{
+	while (bytes--)
+		fputc((val >> (8 * bytes)) & 0xff, f);
+}
+
+void cbor_put_head(FILE *f, enum cbor_major major, uint64_t val)
+{
+	int ib = major << 5;
+
+	if (val < 24) {
+		fputc(ib | val, f);
+	} else if (val <= UINT8_MAX) {
+		fputc(ib | 24, f);
+		cbor_put_be(f, val, 1);
+	} else if (val <= UINT16_MAX) {
+		fputc(ib | 25, f);
+		cbor_put_be(f, val, 2);
+	} else if (val <= UINT32_MAX) {
+		fputc(ib | 26, f);
+		cbor_put_be(f, val, 4);
+	} else {
+		fputc(ib | 27, f);
+		cbor_put_be(f, val, 8);
+	}
+}
+
+void cbor_put_uint(FILE *f, uint64_t val)
+{
+	cbor_put_head(f, CBOR_MAJOR_UINT, val);
+}
+
+void cbor_put_int(FILE *f, int64_t val)
+{
+	if (val >= 0)
+		cbor_put_head(f, CBOR_MAJOR_UINT, val);
+	else
+		/* -1 - val without overflowing for INT64_MIN */
+		cbor_put_head(f, CBOR_MAJOR_NEGINT, ~(uint64_t)val);
+}
+
+void cbor_put_double(FILE *f, double val)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &val, sizeof(bits));
+	fputc(CBOR_MAJOR_SIMPLE << 5 | CBOR_FLOAT64, f);
+	cbor_put_be(f, bits, 8);
+}
+
+void cbor_put_bool(FILE *f, bool val)
+{
+	fputc(CBOR_MAJOR_SIMPLE << 5 | (val ? CBOR_TRUE : CBOR_FALSE), f);
+}
+
+void cbor_put_null(FILE *f)
+{
+	fputc(CBOR_MAJOR_SIMPLE << 5 | CBOR_NULL, f);
+}
+
+void cbor_put_bytes(FILE *f, const void *data, size_t len)
+{
+	cbor_put_head(f, CBOR_MAJOR_BYTES, len);
+	fwrite(data, 1, len, f);
+}
+
+void cbor_put_text(FILE *f, const char *str, size_t len)
+{
+	cbor_put_head(f, CBOR_MAJOR_TEXT, len);
+	fwrite(str, 1, len, f);
+}
+
+void cbor_put_str(FILE *f, const char *str)
+{
+	cbor_put_text(f, str, strlen(str));
+}
+
+void cbor_put_array(FILE *f, uint64_t nr)
+{
+	cbor_put_head(f, CBOR_MAJOR_ARRAY, nr);
+}
+
+void cbor_put_map(FILE *f, uint64_t nr)
+{
+	cbor_put_head(f, CBOR_MAJOR_MAP, nr);
+}
+
+void cbor_open_array(FILE *f)
+{
+	fputc(CBOR_MAJOR_ARRAY << 5 | CBOR_AI_INDEFINITE, f);
+}
+
+void cbor_open_map(FILE *f)
+{
+	fputc(CBOR_MAJOR_MAP << 5 | CBOR_AI_INDEFINITE, f);
+}
+
+void cbor_put_break(FILE *f)
+{
+	fputc(CBOR_BREAK, f);
+}
+
+void cbor_reader_init(struct cbor_reader *r, const void *data, size_t len)
+{
+	r->p = data;
+	r->end = r->p + len;
+}
+
+int cbor_get_head(struct cbor_reader *r, struct cbor_head *h)
+{
+	int bytes;
+	uint8_t ib;
+
+	if (r->p >= r->end)
+		return -EINVAL;
+
+	ib = *r->p++;
+	h->major = ib >> 5;
+	h->ai = ib & 0x1f;
+	h->val = h->ai;
+	h->indefinite = false;
+
+	if (h->ai < 24)
+		return 0;
+
+	if (h->ai == CBOR_AI_INDEFINITE) {
+		/* only the containers and strings may be indefinite */
+		if (h->major < CBOR_MAJOR_BYTES || h->major == CBOR_MAJOR_TAG)
+			return -EINVAL;
+		h->indefinite = true;
+		h->val = 0;
+		return 0;
+	}
+
+	if (h->ai > 27)
+		return -EINVAL;
+
+	bytes = 1 << (h->ai - 24);
+	if (r->end - r->p < bytes)
+		return -EINVAL;
+
+	h->val = 0;
+	while (bytes--)
+		h->val = h->val << 8 | *r->p++;
+
+	return 0;
+}
+
+const void *cbor_get_data(struct cbor_reader *r, uint64_t len)
+{
+	const void *data = r->p;
+
+	if ((uint64_t)(r->end - r->p) < len)
+		return NULL;
+
+	r->p += len;
+	return data;
+}
+
+bool cbor_get_break(struct cbor_reader *r)
+{
+	if (r->p >= r->end || *r->p != CBOR_BREAK)
+		return false;
+
+	r->p++;
+	return true;
+}
+
+double cbor_head_double(const struct cbor_head *h)
+{
+	uint64_t bits = h->val, exp, mant;
+	uint32_t bits32;
+	float f;
+	double d;
+
+	switch (h->ai) {
+	case CBOR_FLOAT16:
+		exp = (bits >> 10) & 0x1f;
+		mant = bits & 0x3ff;
+		if (!exp) {
+			d = mant / 16777216.0;	/* subnormal, mant * 2^-24 */
+			return bits & 0x8000 ? -d : d;
+		}
+		/* rebias the exponent of a double, 0x7ff for infinity and NaN */
+		exp = exp == 0x1f ? 0x7ff : exp - 15 + 1023;
+		bits = (bits & 0x8000) << 48 | exp << 52 | mant << 42;
+		break;
+	case CBOR_FLOAT32:
+		bits32 = bits;
+		memcpy(&f, &bits32, sizeof(f));
+		return f;
+	default:
+		break;
+	}
+
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
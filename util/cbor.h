@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_CBOR_H
+#define __UTIL_CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Minimal CBOR (RFC 8949) encoder writing straight to a stream. Integers
+ * and lengths use the shortest encoding, floating point values are always
+ * written as double precision. Containers are either definite, with the
+ * number of items known up front, or indefinite and terminated with
+ * cbor_put_break(). The reader below walks an encoded buffer item by item.
+ */
+
+enum cbor_major {
+	CBOR_MAJOR_UINT		= 0,
+	CBOR_MAJOR_NEGINT	= 1,
+	CBOR_MAJOR_BYTES	= 2,
+	CBOR_MAJOR_TEXT		= 3,
+	CBOR_MAJOR_ARRAY	= 4,
+	CBOR_MAJOR_MAP		= 5,
+	CBOR_MAJOR_TAG		= 6,
+	CBOR_MAJOR_SIMPLE	= 7,
+};
+
+/* additional information of the simple values and floats */
+#define CBOR_FALSE		20
+#define CBOR_TRUE		21
+#define CBOR_NULL		22
+#define CBOR_FLOAT16		25
+#define CBOR_FLOAT32		26
+#define CBOR_FLOAT64		27
+
+/* initial byte plus argument of a data item */
+void cbor_put_head(FILE *f, enum cbor_major major, uint64_t val);
+
+void cbor_put_uint(FILE *f, uint64_t val);
+void cbor_put_int(FILE *f, int64_t val);
+void cbor_put_double(FILE *f, double val);
+void cbor_put_bool(FILE *f, bool val);
+void cbor_put_null(FILE *f);
+void cbor_put_bytes(FILE *f, const void *data, size_t len);
+void cbor_put_text(FILE *f, const char *str, size_t len);
+
+/* a NUL terminated string */
+void cbor_put_str(FILE *f, const char *str);
+
+/* @nr items, map items are key/value pairs */
+void cbor_put_array(FILE *f, uint64_t nr);
+void cbor_put_map(FILE *f, uint64_t nr);
+
+/* containers of unknown size, terminated with cbor_put_break() */
+void cbor_open_array(FILE *f);
+void cbor_open_map(FILE *f);
+void cbor_put_break(FILE *f);
+
+struct cbor_reader {
+	const uint8_t *p;
+	const uint8_t *end;
+};
+
+struct cbor_head {
+	enum cbor_major major;
+	uint8_t ai;		/* additional information of the initial byte */
+	uint64_t val;		/* value, length, count, tag or the float bits */
+	bool indefinite;	/* a container terminated by a break */
+};
+
+void cbor_reader_init(struct cbor_reader *r, const void *data, size_t len);
+
+/*
+ * cbor_get_head - decode the initial byte and argument of the next item
+ *
+ * Returns 0, or -EINVAL if the buffer ends within the head or the head is
+ * malformed. The payload of a string follows, see cbor_get_data().
+ */
+int cbor_get_head(struct cbor_reader *r, struct cbor_head *h);
+
+/* the @len bytes of a string payload, NULL if the buffer is shorter */
+const void *cbor_get_data(struct cbor_reader *r, uint64_t len);
+
+/* skip the break ending an indefinite container, false if there is none */
+bool cbor_get_break(struct cbor_reader *r);
+
+/* the value of a half, single or double precision float head */
+double cbor_head_double(const struct cbor_head *h);
+
+#endif /* __UTIL_CBOR_H */
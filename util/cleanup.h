@@ -29,6 +29,8 @@ static inline void freep(void *p)
 
 #define _cleanup_huge_ __cleanup__(nvme_free_huge)
 
+#define _cleanup_buf_ __cleanup__(nvme_buf_put)
+
 static inline void close_file(int *f)
 {
 	if (*f > STDERR_FILENO)
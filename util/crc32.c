@@ -31,10 +31,22 @@
 
 /* https://sourceware.org/git/?p=elfutils.git;a=blob;f=lib/crc32.c;hb=575198c29a427392823cc8f2400579a23d06a875 */
 
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+
 #include "crc32.h"
 
+#define CRC32C_POLY	0x82f63b78	/* reflected 0x1edc6f41 */
+
 /* Table computed with Mark Adler's makecrc.c utility.  */
-static const uint32_t crc32_table[256] = {
+static const uint32_t crc32_table0[256] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419,
 	0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4,
 	0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07,
@@ -89,12 +101,272 @@ static const uint32_t crc32_table[256] = {
 	0x2d02ef8d
 };
 
-uint32_t crc32(uint32_t crc, unsigned char *buf, size_t len)
+/* slice-by-8 tables, [0] is the byte-at-a-time table */
+static uint32_t crc32_table[8][256];
+static uint32_t crc32c_table[8][256];
+
+typedef uint32_t (*crc_fn)(uint32_t crc, const unsigned char *p, size_t len);
+
+static crc_fn crc32_impl;
+static crc_fn crc32c_impl;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_slice8_tables(uint32_t t[8][256])
+{
+	uint32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = t[0][i];
+		for (j = 1; j < 8; j++) {
+			crc = t[0][crc & 0xff] ^ (crc >> 8);
+			t[j][i] = crc;
+		}
+	}
+}
+
+static uint32_t crc_slice8(uint32_t t[8][256], uint32_t crc,
+			   const unsigned char *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v = __builtin_bswap64(v);
+#endif
+		v ^= crc;
+		crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^
+		      t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+		      t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^
+		      t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+	}
+
+	while (len--)
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+static uint32_t crc32_sw_impl(uint32_t crc, const unsigned char *p, size_t len)
+{
+	return crc_slice8(crc32_table, crc, p, len);
+}
+
+static uint32_t crc32c_sw_impl(uint32_t crc, const unsigned char *p, size_t len)
+{
+	return crc_slice8(crc32c_table, crc, p, len);
+}
+
+#if defined(__x86_64__)
+/*
+ * CRC-32 has no instruction of its own on x86, fold 64 byte blocks with
+ * carry-less multiplication instead ("Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction", Intel 2009). The constants
+ * are x^n mod P for the reflected polynomial.
+ */
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t crc32_pclmul(uint32_t crc, const unsigned char *p, size_t len)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	if (len < 64)
+		return crc32_sw_impl(crc, p, len);
+
+	x1 = _mm_loadu_si128((const __m128i *)(p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	p += 64;
+	len -= 64;
+
+	for (; len >= 64; p += 64, len -= 64) {
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+				   _mm_loadu_si128((const __m128i *)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+				   _mm_loadu_si128((const __m128i *)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+				   _mm_loadu_si128((const __m128i *)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+				   _mm_loadu_si128((const __m128i *)(p + 0x30)));
+	}
+
+	/* fold the four lanes into one */
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	for (; len >= 16; p += 16, len -= 16) {
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+				   _mm_loadu_si128((const __m128i *)p));
+	}
+
+	/* 128 to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	crc = _mm_extract_epi32(x1, 1);
+
+	return crc32_sw_impl(crc, p, len);
+}
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t c = crc, v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		c = _mm_crc32_u8(c, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+
+	while (len--)
+		c = _mm_crc32_u8(c, *p++);
+
+	return c;
+}
+
+static void crc_select(void)
+{
+	if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+		crc32_impl = crc32_pclmul;
+	if (__builtin_cpu_supports("sse4.2"))
+		crc32c_impl = crc32c_hw;
+}
+#elif defined(__aarch64__) && defined(HWCAP_CRC32)
+__attribute__((target("+crc")))
+static uint32_t crc32_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = __crc32b(crc, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32d(crc, v);
+	}
+
+	while (len--)
+		crc = __crc32b(crc, *p++);
+
+	return crc;
+}
+
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = __crc32cb(crc, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+
+static void crc_select(void)
+{
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+		crc32_impl = crc32_hw;
+		crc32c_impl = crc32c_hw;
+	}
+}
+#else
+static void crc_select(void)
+{
+}
+#endif
+
+static void crc_init(void)
+{
+	uint32_t crc;
+	int i, j;
+
+	memcpy(crc32_table[0], crc32_table0, sizeof(crc32_table0));
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++)
+			crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLY : 0);
+		crc32c_table[0][i] = crc;
+	}
+	crc_slice8_tables(crc32_table);
+	crc_slice8_tables(crc32c_table);
+
+	crc32_impl = crc32_sw_impl;
+	crc32c_impl = crc32c_sw_impl;
+	crc_select();
+}
+
+uint32_t crc32(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&crc_once, crc_init);
+
+	return ~crc32_impl(~crc, buf, len);
+}
+
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&crc_once, crc_init);
+
+	return ~crc32c_impl(~crc, buf, len);
+}
+
+uint32_t crc32_sw(uint32_t crc, const void *buf, size_t len)
+{
+	pthread_once(&crc_once, crc_init);
+
+	return ~crc32_sw_impl(~crc, buf, len);
+}
+
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len)
 {
-	unsigned char *end;
+	pthread_once(&crc_once, crc_init);
 
-	crc = ~crc;
-	for (end = buf + len; buf < end; ++buf)
-		crc = crc32_table[(crc ^ *buf) & 0xff] ^ (crc >> 8);
-	return ~crc;
+	return ~crc32c_sw_impl(~crc, buf, len);
 }
@@ -6,6 +6,20 @@
 #include <stdint.h>
 #include <stddef.h>
 
-uint32_t crc32(uint32_t crc, unsigned char *buf, size_t len);
+/*
+ * CRC-32 (IEEE 802.3, as used by zlib) and CRC-32C (Castagnoli, as used
+ * by iSCSI and NVMe/TCP). Both use CPU instructions when available: the
+ * ARMv8 CRC extension, PCLMULQDQ folding for CRC-32 and the SSE4.2
+ * crc32 instruction for CRC-32C on x86-64. Otherwise a slice-by-8 table
+ * is used.
+ *
+ * @crc is the result of the previous call, 0 to start a new checksum.
+ */
+uint32_t crc32(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+
+/* the table versions, for testing */
+uint32_t crc32_sw(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
 
 #endif
@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <string.h>
+
+#include "histogram.h"
+
+void nvme_hist_init(struct nvme_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+unsigned int nvme_hist_bucket(uint64_t v)
+{
+	unsigned int shift;
+
+	if (v < NVME_HIST_SUB_BUCKETS)
+		return v;
+
+	shift = 63 - __builtin_clzll(v) - NVME_HIST_SUB_BITS;
+
+	return ((shift + 1) << NVME_HIST_SUB_BITS) +
+		(unsigned int)((v >> shift) - NVME_HIST_SUB_BUCKETS);
+}
+
+uint64_t nvme_hist_bucket_low(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < NVME_HIST_SUB_BUCKETS)
+		return idx;
+
+	shift = (idx >> NVME_HIST_SUB_BITS) - 1;
+
+	return (uint64_t)(NVME_HIST_SUB_BUCKETS +
+			  (idx & (NVME_HIST_SUB_BUCKETS - 1))) << shift;
+}
+
+uint64_t nvme_hist_bucket_high(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < NVME_HIST_SUB_BUCKETS)
+		return idx;
+
+	shift = (idx >> NVME_HIST_SUB_BITS) - 1;
+
+	return nvme_hist_bucket_low(idx) + ((1ULL << shift) - 1);
+}
+
+void nvme_hist_add(struct nvme_hist *h, uint64_t v)
+{
+	if (!h->count || v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+	h->count++;
+	h->sum += v;
+	h->buckets[nvme_hist_bucket(v)]++;
+}
+
+void nvme_hist_merge(struct nvme_hist *dst, const struct nvme_hist *src)
+{
+	unsigned int i;
+
+	if (!src->count)
+		return;
+
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+
+	for (i = 0; i < NVME_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+uint64_t nvme_hist_percentile(const struct nvme_hist *h, double pct)
+{
+	uint64_t rank, seen = 0, v;
+	unsigned int i;
+
+	if (!h->count)
+		return 0;
+
+	if (pct >= 100.0)
+		return h->max;
+
+	rank = (uint64_t)(pct / 100.0 * h->count + 0.5);
+	if (!rank)
+		rank = 1;
+
+	for (i = 0; i < NVME_HIST_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	v = nvme_hist_bucket_high(i);
+	if (v > h->max)
+		v = h->max;
+	if (v < h->min)
+		v = h->min;
+
+	return v;
+}
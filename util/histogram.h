@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_HISTOGRAM_H
+#define __UTIL_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*
+ * Log-linear (HDR style) histogram. Every power of two range is split into
+ * 2^NVME_HIST_SUB_BITS equally sized buckets which bounds the relative error
+ * of a recorded value to 1 / 2^NVME_HIST_SUB_BITS across the whole 64 bit
+ * range while keeping a fixed, allocation free footprint.
+ */
+#define NVME_HIST_SUB_BITS	5
+#define NVME_HIST_SUB_BUCKETS	(1U << NVME_HIST_SUB_BITS)
+#define NVME_HIST_BUCKETS	((65 - NVME_HIST_SUB_BITS) << NVME_HIST_SUB_BITS)
+
+struct nvme_hist {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t sum;
+	uint64_t buckets[NVME_HIST_BUCKETS];
+};
+
+void nvme_hist_init(struct nvme_hist *h);
+void nvme_hist_add(struct nvme_hist *h, uint64_t v);
+void nvme_hist_merge(struct nvme_hist *dst, const struct nvme_hist *src);
+
+unsigned int nvme_hist_bucket(uint64_t v);
+uint64_t nvme_hist_bucket_low(unsigned int idx);
+uint64_t nvme_hist_bucket_high(unsigned int idx);
+
+/*
+ * nvme_hist_percentile - value below which @pct percent of the samples are
+ *
+ * Returns the highest value equivalent to the bucket holding the requested
+ * rank, clamped to the recorded maximum, or 0 for an empty histogram.
+ */
+uint64_t nvme_hist_percentile(const struct nvme_hist *h, double pct);
+
+static inline uint64_t nvme_hist_mean(const struct nvme_hist *h)
+{
+	return h->count ? h->sum / h->count : 0;
+}
+
+#endif /* __UTIL_HISTOGRAM_H */
@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <time.h>
+
+#include "common.h"
+#include "interval.h"
+
+volatile sig_atomic_t nvme_stop_flag;
+
+static void (*volatile stop_hook)(void);
+
+static void stop_signal(int signum)
+{
+	void (*hook)(void) = stop_hook;
+
+	nvme_stop_flag = 1;
+	if (hook)
+		hook();
+}
+
+void nvme_stop_catch(bool term, void (*hook)(void))
+{
+	nvme_stop_flag = 0;
+	stop_hook = hook;
+	signal(SIGINT, stop_signal);
+	if (term)
+		signal(SIGTERM, stop_signal);
+}
+
+void nvme_stop_release(void)
+{
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	stop_hook = NULL;
+}
+
+bool nvme_interval_wait(uint64_t deadline_ns)
+{
+	struct timespec ts;
+	uint64_t now;
+
+	while (!nvme_stop_flag && (now = monotonic_ns()) < deadline_ns) {
+		ts.tv_sec = (deadline_ns - now) / NSEC_PER_SEC;
+		ts.tv_nsec = (deadline_ns - now) % NSEC_PER_SEC;
+		nanosleep(&ts, NULL);
+	}
+
+	return !nvme_stop_flag;
+}
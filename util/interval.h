@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_INTERVAL_H
+#define __UTIL_INTERVAL_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The commands sampling on an interval or running until interrupted share
+ * one stop flag. nvme_stop_catch() clears it and sets it on SIGINT, and on
+ * SIGTERM with @term, until nvme_stop_release(). The @hook, when given, is
+ * called from the signal handler too and must be async signal safe, e.g.
+ * nvme_io_engine_stop() or nvme_watch_stop().
+ */
+extern volatile sig_atomic_t nvme_stop_flag;
+
+void nvme_stop_catch(bool term, void (*hook)(void));
+void nvme_stop_release(void);
+
+static inline bool nvme_stopped(void)
+{
+	return nvme_stop_flag;
+}
+
+/*
+ * nvme_interval_wait - sleep until @deadline_ns of monotonic_ns()
+ *
+ * Returns false as soon as the stop flag is set, also if it already was.
+ */
+bool nvme_interval_wait(uint64_t deadline_ns);
+
+#endif /* __UTIL_INTERVAL_H */
@@ -1,7 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#include "cbor.h"
 #include "json.h"
 #include "types.h"
 
@@ -48,9 +51,10 @@ static int util_json_object_string_to_number(struct json_object *jso,
 
 struct json_object *util_json_object_new_uint128(nvme_uint128_t  val)
 {
+	char str[NVME_UINT128_STR_LEN];
 	struct json_object *obj;
 
-	obj = json_object_new_string(uint128_t_to_string(val));
+	obj = json_object_new_string(uint128_t_to_str(val, str));
 	json_object_set_serializer(obj, util_json_object_string_to_number, NULL, NULL);
 
 	return obj;
@@ -72,3 +76,605 @@ uint64_t util_json_object_get_uint64(struct json_object *obj)
 
 	return val;
 }
+
+#define JSON_ARENA_CHUNK	(16 * 1024)
+
+struct json_arena_chunk {
+	struct json_arena_chunk *next;
+	size_t used;
+	char data[JSON_ARENA_CHUNK];
+};
+
+static __thread struct {
+	int depth;
+	struct json_arena_chunk *chunks;	/* the current one first */
+} json_arena;
+
+void json_arena_begin(void)
+{
+	json_arena.depth++;
+}
+
+void json_arena_end(void)
+{
+	struct json_arena_chunk *c, *next;
+
+	if (--json_arena.depth || !json_arena.chunks)
+		return;
+
+	/* keep the current chunk for the next pass */
+	for (c = json_arena.chunks->next; c; c = next) {
+		next = c->next;
+		free(c);
+	}
+	json_arena.chunks->next = NULL;
+	json_arena.chunks->used = 0;
+}
+
+static char *json_arena_strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	struct json_arena_chunk *c = json_arena.chunks;
+	char *p;
+
+	if (len > JSON_ARENA_CHUNK / 4)
+		return NULL;
+
+	if (!c || c->used + len > JSON_ARENA_CHUNK) {
+		c = malloc(sizeof(*c));
+		if (!c)
+			return NULL;
+		c->used = 0;
+		c->next = json_arena.chunks;
+		json_arena.chunks = c;
+	}
+
+	p = c->data + c->used;
+	memcpy(p, s, len);
+	c->used += len;
+
+	return p;
+}
+
+int json_object_add_arena(struct json_object *o, const char *k,
+			  struct json_object *v)
+{
+	char *key;
+
+	if (!json_arena.depth || !(key = json_arena_strdup(k)))
+		return json_object_object_add(o, k, v);
+
+	return json_object_object_add_ex(o, key, v, JSON_C_OBJECT_KEY_IS_CONSTANT);
+}
+
+static enum json_output_mode output_mode;
+
+void json_set_output_mode(enum json_output_mode mode)
+{
+	output_mode = mode;
+}
+
+enum json_output_mode json_get_output_mode(void)
+{
+	return output_mode;
+}
+
+int util_json_to_string_flags(void)
+{
+	if (output_mode == JSON_OUTPUT_PRETTY)
+		return JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE;
+
+	return JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE;
+}
+
+void util_json_write_cbor(FILE *f, struct json_object *o)
+{
+	size_t i;
+
+	switch (json_object_get_type(o)) {
+	case json_type_null:
+		cbor_put_null(f);
+		break;
+	case json_type_boolean:
+		cbor_put_bool(f, json_object_get_boolean(o));
+		break;
+	case json_type_double:
+		cbor_put_double(f, json_object_get_double(o));
+		break;
+	case json_type_int:
+#ifdef CONFIG_JSONC_14
+		/* values above INT64_MAX are kept as unsigned by json-c */
+		if (json_object_get_int64(o) == INT64_MAX)
+			cbor_put_uint(f, json_object_get_uint64(o));
+		else
+#endif
+			cbor_put_int(f, json_object_get_int64(o));
+		break;
+	case json_type_string:
+		cbor_put_text(f, json_object_get_string(o),
+			      json_object_get_string_len(o));
+		break;
+	case json_type_array:
+		cbor_put_array(f, json_object_array_length(o));
+		for (i = 0; i < json_object_array_length(o); i++)
+			util_json_write_cbor(f, json_object_array_get_idx(o, i));
+		break;
+	case json_type_object: {
+		cbor_put_map(f, json_object_object_length(o));
+		json_object_object_foreach(o, key, val) {
+			cbor_put_str(f, key);
+			util_json_write_cbor(f, val);
+		}
+		break;
+	}
+	}
+}
+
+/* nesting of the containers read, deeper items are rejected */
+#define CBOR_READ_DEPTH	64
+
+static int cbor_read_item(struct cbor_reader *r, int depth, struct json_object **o);
+
+static int cbor_read_string(struct cbor_reader *r, const struct cbor_head *h,
+			    struct json_object **o)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *data;
+	char *str;
+	uint64_t i;
+
+	/* util_json_write_cbor() writes definite strings only */
+	if (h->indefinite)
+		return -EINVAL;
+
+	data = cbor_get_data(r, h->val);
+	if (!data)
+		return -EINVAL;
+
+	if (h->major == CBOR_MAJOR_TEXT) {
+		*o = json_object_new_string_len((const char *)data, h->val);
+		return 0;
+	}
+
+	str = malloc(2 * h->val + 1);
+	if (!str)
+		return -ENOMEM;
+	for (i = 0; i < h->val; i++) {
+		str[2 * i] = hex[data[i] >> 4];
+		str[2 * i + 1] = hex[data[i] & 0xf];
+	}
+	str[2 * h->val] = '\0';
+	*o = json_object_new_string(str);
+	free(str);
+
+	return 0;
+}
+
+static int cbor_read_array(struct cbor_reader *r, const struct cbor_head *h,
+			   int depth, struct json_object **o)
+{
+	struct json_object *item;
+	uint64_t i;
+	int err;
+
+	*o = json_create_array();
+	for (i = 0; h->indefinite || i < h->val; i++) {
+		if (h->indefinite && cbor_get_break(r))
+			break;
+		/* a partially read item is freed along with the array */
+		err = cbor_read_item(r, depth, &item);
+		json_object_array_add(*o, item);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int cbor_read_map(struct cbor_reader *r, const struct cbor_head *h,
+			 int depth, struct json_object **o)
+{
+	struct json_object *key, *val;
+	uint64_t i;
+	int err;
+
+	*o = json_create_object();
+	for (i = 0; h->indefinite || i < h->val; i++) {
+		if (h->indefinite && cbor_get_break(r))
+			break;
+		err = cbor_read_item(r, depth, &key);
+		if (err || !json_object_is_type(key, json_type_string)) {
+			json_free_object(key);
+			return err ?: -EINVAL;
+		}
+		err = cbor_read_item(r, depth, &val);
+		json_object_object_add(*o, json_object_get_string(key), val);
+		json_free_object(key);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* decode the next item into @o, a null is a NULL object to json-c */
+static int cbor_read_item(struct cbor_reader *r, int depth, struct json_object **o)
+{
+	struct cbor_head h;
+
+	*o = NULL;
+	if (depth >= CBOR_READ_DEPTH || cbor_get_head(r, &h))
+		return -EINVAL;
+
+	switch (h.major) {
+	case CBOR_MAJOR_UINT:
+		if (h.val > INT64_MAX)
+			*o = json_object_new_uint64(h.val);
+		else
+			*o = json_object_new_int64(h.val);
+		return 0;
+	case CBOR_MAJOR_NEGINT:
+		if (h.val > INT64_MAX)
+			return -EINVAL;
+		*o = json_object_new_int64(-1 - (int64_t)h.val);
+		return 0;
+	case CBOR_MAJOR_BYTES:
+	case CBOR_MAJOR_TEXT:
+		return cbor_read_string(r, &h, o);
+	case CBOR_MAJOR_ARRAY:
+		return cbor_read_array(r, &h, depth + 1, o);
+	case CBOR_MAJOR_MAP:
+		return cbor_read_map(r, &h, depth + 1, o);
+	case CBOR_MAJOR_TAG:
+		/* the tags carry no meaning in JSON, keep the tagged item */
+		return cbor_read_item(r, depth + 1, o);
+	case CBOR_MAJOR_SIMPLE:
+		break;
+	}
+
+	switch (h.ai) {
+	case CBOR_FALSE:
+	case CBOR_TRUE:
+		*o = json_object_new_boolean(h.ai == CBOR_TRUE);
+		return 0;
+	case CBOR_FLOAT16:
+	case CBOR_FLOAT32:
+	case CBOR_FLOAT64:
+		*o = json_object_new_double(cbor_head_double(&h));
+		return 0;
+	case CBOR_NULL:
+		return 0;
+	default:
+		/* undefined and the unassigned simple values */
+		return -EINVAL;
+	}
+}
+
+struct json_object *util_json_read_cbor(const void *data, size_t len)
+{
+	struct json_object *o;
+	struct cbor_reader r;
+
+	cbor_reader_init(&r, data, len);
+	if (cbor_read_item(&r, 0, &o) || r.p != r.end) {
+		json_free_object(o);
+		return NULL;
+	}
+
+	return o;
+}
+
+void util_json_write_record(FILE *f, struct json_object *o, bool line)
+{
+	if (output_mode == JSON_OUTPUT_CBOR)
+		util_json_write_cbor(f, o);
+	else
+		fprintf(f, "%s\n", json_object_to_json_string_ext(o,
+			line ? JSON_C_TO_STRING_PLAIN : util_json_to_string_flags()));
+	json_free_object(o);
+}
+
+void util_json_print_object(struct json_object *o)
+{
+	if (output_mode == JSON_OUTPUT_CBOR) {
+		util_json_write_cbor(stdout, o);
+		return;
+	}
+
+	printf("%s", json_object_to_json_string_ext(o,
+						    util_json_to_string_flags()));
+}
+
+void util_json_print_newline(void)
+{
+	if (output_mode != JSON_OUTPUT_CBOR)
+		printf("\n");
+}
+
+/*
+ * In NDJSON mode the root and its arrays are "line" containers: they print
+ * no brackets and every child is written as a line of its own.
+ */
+static bool json_stream_line_level(struct json_stream *s)
+{
+	return s->mode == JSON_OUTPUT_NDJSON && s->depth &&
+		!*s->close[s->depth - 1];
+}
+
+static int json_stream_flags(struct json_stream *s)
+{
+	if (s->mode == JSON_OUTPUT_PRETTY)
+		return JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE;
+
+	return JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE;
+}
+
+static void json_stream_indent(struct json_stream *s)
+{
+	fprintf(s->f, "%*s", 2 * s->depth, "");
+}
+
+static void json_stream_newline(struct json_stream *s)
+{
+	if (s->mode != JSON_OUTPUT_PRETTY)
+		return;
+
+	fputc('\n', s->f);
+	json_stream_indent(s);
+}
+
+static void json_stream_flush_hdr(struct json_stream *s)
+{
+	if (!s->hdr)
+		return;
+
+	if (json_object_object_length(s->hdr))
+		fprintf(s->f, "%s\n", json_object_to_json_string_ext(s->hdr,
+			json_stream_flags(s)));
+	json_free_object(s->hdr);
+	s->hdr = NULL;
+}
+
+static void json_stream_print_key(struct json_stream *s, const char *key)
+{
+	struct json_object *k;
+
+	/* let json-c escape the key like it escapes values */
+	k = json_object_new_string(key);
+	fprintf(s->f, "%s:",
+		json_object_to_json_string_ext(k, JSON_C_TO_STRING_NOSLASHESCAPE));
+	json_free_object(k);
+}
+
+static void json_stream_key(struct json_stream *s, const char *key)
+{
+	if (!s->depth)
+		return;
+
+	if (s->mode == JSON_OUTPUT_CBOR) {
+		if (key)
+			cbor_put_str(s->f, key);
+		return;
+	}
+
+	if (json_stream_line_level(s)) {
+		json_stream_flush_hdr(s);
+		key = NULL;
+	} else {
+		if (s->children[s->depth - 1])
+			fputc(',', s->f);
+		json_stream_newline(s);
+	}
+	s->children[s->depth - 1] = true;
+
+	if (key)
+		json_stream_print_key(s, key);
+}
+
+void json_stream_init(struct json_stream *s, FILE *f)
+{
+	memset(s, 0, sizeof(*s));
+	s->f = f;
+	s->mode = output_mode;
+}
+
+/* add @v to the innermost open container of a tree stream, or make it the root */
+static void json_stream_tree_add(struct json_stream *s, const char *key,
+				 struct json_object *v)
+{
+	struct json_object *parent;
+
+	if (!s->depth) {
+		json_free_object(s->root);
+		s->root = v;
+		return;
+	}
+
+	parent = s->tree[s->depth - 1];
+	if (json_object_is_type(parent, json_type_array))
+		json_object_array_add(parent, v);
+	else
+		json_object_object_add(parent, key ? key : "", v);
+}
+
+static void json_stream_tree_open(struct json_stream *s, const char *key, bool object)
+{
+	struct json_object *o = object ? json_create_object() : json_create_array();
+
+	json_stream_tree_add(s, key, o);
+	if (s->depth == JSON_STREAM_MAX_DEPTH)
+		return;
+	s->tree[s->depth++] = o;
+}
+
+static void json_stream_open(struct json_stream *s, const char *key,
+			     const char *open, const char *close)
+{
+	if (!s->f) {
+		json_stream_tree_open(s, key, *open == '{');
+		return;
+	}
+
+	if (s->mode == JSON_OUTPUT_CBOR) {
+		/* CBOR containers of unknown size end with a break byte */
+		open = *open == '{' ? "\xbf" : "\x9f";
+		close = "\xff";
+	} else if (s->mode == JSON_OUTPUT_NDJSON && !s->depth) {
+		open = close = "";
+	} else if (json_stream_line_level(s) && key) {
+		if (*open == '[') {
+			/* the arrays of the root object become lines */
+			open = close = "";
+		} else {
+			/* other root members are written as records */
+			json_stream_key(s, NULL);
+			fputc('{', s->f);
+			json_stream_print_key(s, key);
+			key = NULL;
+			close = "}}";
+		}
+	}
+
+	json_stream_key(s, key);
+	fputs(open, s->f);
+
+	if (s->depth == JSON_STREAM_MAX_DEPTH)
+		return;
+	s->close[s->depth] = close;
+	s->children[s->depth] = false;
+	s->depth++;
+}
+
+void json_stream_open_object(struct json_stream *s, const char *key)
+{
+	json_stream_open(s, key, "{", "}");
+}
+
+void json_stream_open_array(struct json_stream *s, const char *key)
+{
+	json_stream_open(s, key, "[", "]");
+}
+
+void json_stream_close(struct json_stream *s)
+{
+	const char *close;
+
+	if (!s->depth)
+		return;
+
+	if (!s->f) {
+		s->depth--;
+		return;
+	}
+
+	s->depth--;
+	close = s->close[s->depth];
+	if (s->children[s->depth] && *close)
+		json_stream_newline(s);
+	fputs(close, s->f);
+
+	if (!s->depth) {
+		json_stream_flush_hdr(s);
+		if (*close && s->mode != JSON_OUTPUT_CBOR)
+			fputc('\n', s->f);
+	} else if (*close && json_stream_line_level(s)) {
+		fputc('\n', s->f);
+	}
+}
+
+void json_stream_add(struct json_stream *s, const char *key,
+		     struct json_object *v)
+{
+	const char *str = "null";
+
+	if (!s->f) {
+		json_stream_tree_add(s, key, v);
+		return;
+	}
+
+	if (key && json_stream_line_level(s)) {
+		/* scalar members of the root are collected into one line */
+		if (!s->hdr)
+			s->hdr = json_create_object();
+		json_object_object_add(s->hdr, key, v);
+		return;
+	}
+
+	json_stream_key(s, key);
+
+	if (s->mode == JSON_OUTPUT_CBOR) {
+		util_json_write_cbor(s->f, v);
+		json_free_object(v);
+		return;
+	}
+
+	if (v)
+		str = json_object_to_json_string_ext(v, json_stream_flags(s));
+
+	/* nested lines are indented relative to the current depth */
+	for (; *str; str++) {
+		fputc(*str, s->f);
+		if (*str == '\n')
+			json_stream_indent(s);
+	}
+
+	if (json_stream_line_level(s))
+		fputc('\n', s->f);
+
+	json_free_object(v);
+}
+
+void json_stream_add_members(struct json_stream *s, struct json_object *o)
+{
+	json_object_object_foreach(o, key, val)
+		json_stream_add(s, key, json_object_get(val));
+
+	json_free_object(o);
+}
+
+static void json_stream_add_array(struct json_stream *s, const char *key,
+				  struct json_object *a)
+{
+	size_t i;
+
+	json_stream_open_array(s, key);
+	for (i = 0; i < json_object_array_length(a); i++)
+		json_stream_add(s, NULL,
+				json_object_get(json_object_array_get_idx(a, i)));
+	json_stream_close(s);
+}
+
+void json_stream_print(struct json_object *o)
+{
+	struct json_stream s;
+
+	json_stream_init(&s, stdout);
+
+	if (s.mode != JSON_OUTPUT_NDJSON) {
+		json_stream_add(&s, NULL, o);
+		util_json_print_newline();
+		return;
+	}
+
+	if (json_object_is_type(o, json_type_array)) {
+		json_stream_add_array(&s, NULL, o);
+		json_free_object(o);
+		return;
+	}
+
+	if (!json_object_is_type(o, json_type_object)) {
+		json_stream_add(&s, NULL, o);
+		fputc('\n', stdout);
+		return;
+	}
+
+	json_stream_open_object(&s, NULL);
+	json_object_object_foreach(o, key, val) {
+		if (json_object_is_type(val, json_type_array))
+			json_stream_add_array(&s, key, val);
+		else
+			json_stream_add(&s, key, json_object_get(val));
+	}
+	json_stream_close(&s);
+	json_free_object(o);
+}
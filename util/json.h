@@ -3,6 +3,8 @@
 #define __JSON__H
 
 #ifdef CONFIG_JSONC
+#include <stdbool.h>
+#include <stdio.h>
 #include <json.h>
 #include "util/types.h"
 
@@ -40,10 +42,50 @@ static inline int json_object_add_value_string(struct json_object *o, const char
 static inline int json_array_add_value_string(struct json_object *o, const char *v) {
 	return json_object_array_add(o, v ? json_object_new_string(v) : NULL);
 }
-#define json_print_object(o, u)						\
-	printf("%s", json_object_to_json_string_ext(o,			\
-		JSON_C_TO_STRING_PRETTY |				\
-		JSON_C_TO_STRING_NOSLASHESCAPE))
+#define json_print_object(o, u) util_json_print_object(o)
+
+/*
+ * Layout of the printed JSON, selected with -o json, -o json-compact,
+ * -o ndjson or -o cbor. NDJSON writes one compact line per element of the
+ * list-type members of the root (error log entries, zones, self-test
+ * results, ...), the remaining root members are written as a line of their
+ * own. CBOR encodes the same tree with the same member names in binary.
+ */
+enum json_output_mode {
+	JSON_OUTPUT_PRETTY,
+	JSON_OUTPUT_COMPACT,
+	JSON_OUTPUT_NDJSON,
+	JSON_OUTPUT_CBOR,
+};
+
+void json_set_output_mode(enum json_output_mode mode);
+enum json_output_mode json_get_output_mode(void);
+
+/* json-c serialization flags for the selected output mode */
+int util_json_to_string_flags(void);
+
+/* print @o to stdout in the selected output mode, without a newline */
+void util_json_print_object(struct json_object *o);
+
+/* terminate a printed object, CBOR data items need no separator */
+void util_json_print_newline(void);
+
+/* encode @o as a single CBOR data item */
+void util_json_write_cbor(FILE *f, struct json_object *o);
+
+/*
+ * Write @o to @f as one record of a stream and free it: a CBOR data item
+ * of a CBOR sequence, or the object and a newline. With @line the object
+ * is kept on one line also when pretty printing.
+ */
+void util_json_write_record(FILE *f, struct json_object *o, bool line);
+
+/*
+ * Decode the CBOR data item at @data, e.g. written by util_json_write_cbor().
+ * Byte strings become hex strings. Returns NULL if it is malformed or
+ * followed by trailing data.
+ */
+struct json_object *util_json_read_cbor(const void *data, size_t len);
 
 struct json_object *util_json_object_new_double(long double d);
 struct json_object *util_json_object_new_uint64(uint64_t i);
@@ -52,10 +94,74 @@ struct json_object *util_json_object_new_uint128(nvme_uint128_t val);
 
 uint64_t util_json_object_get_uint64(struct json_object *obj);
 
+/*
+ * Arena for the member names of the trees built during a print pass.
+ * json-c has no allocator hook and strdup()s every member name; in a
+ * pass the names are copied into large chunks instead, json-c is told
+ * they are constant, and the chunks are released at once by the end of
+ * the outermost pass. The trees must be freed before that. Passes nest
+ * and are per thread.
+ */
+void json_arena_begin(void);
+void json_arena_end(void);
+
+/* add @v as member @k of @o, naming it with an arena copy of @k in a pass */
+int json_object_add_arena(struct json_object *o, const char *k,
+			  struct json_object *v);
+
+/*
+ * Streaming writer producing the same text as json_print_object() in the
+ * output mode that was selected at json_stream_init() time. Only the
+ * containers that are open are tracked, members are built as small json-c
+ * objects and written and freed right away, so large outputs don't keep
+ * the whole tree in memory.
+ *
+ * With a NULL file the stream builds the tree instead, for the callers
+ * capturing the objects of a print op; it is in root once the root is
+ * closed.
+ */
+#define JSON_STREAM_MAX_DEPTH	16
+
+struct json_stream {
+	FILE *f;
+	int depth;
+	enum json_output_mode mode;
+	bool children[JSON_STREAM_MAX_DEPTH];
+	const char *close[JSON_STREAM_MAX_DEPTH];
+	struct json_object *hdr;	/* NDJSON: pending root members */
+	struct json_object *tree[JSON_STREAM_MAX_DEPTH];	/* open containers, NULL file */
+	struct json_object *root;
+};
+
+void json_stream_init(struct json_stream *s, FILE *f);
+
+/* @key is NULL for the root and for array elements */
+void json_stream_open_object(struct json_stream *s, const char *key);
+void json_stream_open_array(struct json_stream *s, const char *key);
+
+/* closes the innermost container, a newline follows the root */
+void json_stream_close(struct json_stream *s);
+
+/* write and free @v, NULL is written as null */
+void json_stream_add(struct json_stream *s, const char *key,
+		     struct json_object *v);
+
+/* write the members of the object @o as members of the open object, free @o */
+void json_stream_add_members(struct json_stream *s, struct json_object *o);
+
+/*
+ * print and free @o followed by a newline, for NDJSON root arrays and the
+ * arrays of a root object get written one element per line
+ */
+void json_stream_print(struct json_object *o);
+
 #else /* !CONFIG_JSONC */
 
 struct json_object;
 
+static inline void json_arena_begin(void) {}
+static inline void json_arena_end(void) {}
+
 #endif
 
 #endif
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <string.h>
+
+#include "lat-hist.h"
+
+void nvme_lat_hist_init(struct nvme_lat_hist *h, unsigned int flags)
+{
+	h->nr_buckets = 0;
+	h->flags = flags;
+}
+
+int nvme_lat_hist_add_bucket(struct nvme_lat_hist *h, uint32_t low_us,
+			     uint32_t high_us, uint64_t count)
+{
+	struct nvme_lat_bucket *b;
+
+	if (h->nr_buckets >= NVME_LAT_HIST_MAX_BUCKETS)
+		return -E2BIG;
+
+	b = &h->buckets[h->nr_buckets++];
+	b->low_us = low_us;
+	b->high_us = high_us;
+	b->count = count;
+
+	return 0;
+}
+
+static bool lat_hist_same_layout(const struct nvme_lat_hist *a,
+				 const struct nvme_lat_hist *b)
+{
+	unsigned int i;
+
+	if (a->nr_buckets != b->nr_buckets)
+		return false;
+
+	for (i = 0; i < a->nr_buckets; i++)
+		if (a->buckets[i].low_us != b->buckets[i].low_us ||
+		    a->buckets[i].high_us != b->buckets[i].high_us)
+			return false;
+
+	return true;
+}
+
+int nvme_lat_hist_delta(struct nvme_lat_hist *delta, const struct nvme_lat_hist *cur,
+			const struct nvme_lat_hist *prev)
+{
+	unsigned int i;
+
+	if (!lat_hist_same_layout(cur, prev))
+		return -EINVAL;
+
+	if (delta != cur)
+		memcpy(delta, cur, sizeof(*delta) - sizeof(delta->buckets) +
+		       cur->nr_buckets * sizeof(cur->buckets[0]));
+	if (cur->flags & NVME_LAT_HIST_CLEAR_ON_READ)
+		return 0;
+
+	for (i = 0; i < cur->nr_buckets; i++)
+		if (cur->buckets[i].count >= prev->buckets[i].count)
+			delta->buckets[i].count = cur->buckets[i].count -
+						  prev->buckets[i].count;
+
+	return 0;
+}
+
+int nvme_lat_hist_merge(struct nvme_lat_hist *dst, const struct nvme_lat_hist *src)
+{
+	unsigned int i;
+
+	if (!lat_hist_same_layout(dst, src))
+		return -EINVAL;
+
+	for (i = 0; i < dst->nr_buckets; i++)
+		dst->buckets[i].count += src->buckets[i].count;
+
+	return 0;
+}
+
+uint64_t nvme_lat_hist_count(const struct nvme_lat_hist *h)
+{
+	uint64_t count = 0;
+	unsigned int i;
+
+	for (i = 0; i < h->nr_buckets; i++)
+		count += h->buckets[i].count;
+
+	return count;
+}
+
+static uint32_t lat_bucket_edge(const struct nvme_lat_bucket *b)
+{
+	return b->high_us == NVME_LAT_HIST_INF ? b->low_us : b->high_us;
+}
+
+uint32_t nvme_lat_hist_percentile(const struct nvme_lat_hist *h, double pct)
+{
+	uint64_t count = nvme_lat_hist_count(h), sum = 0;
+	unsigned int i;
+
+	if (!count)
+		return 0;
+
+	for (i = 0; i < h->nr_buckets; i++) {
+		if (!h->buckets[i].count)
+			continue;
+		sum += h->buckets[i].count;
+		if (sum * 100.0 >= pct * count)
+			return lat_bucket_edge(&h->buckets[i]);
+	}
+
+	return nvme_lat_hist_max(h);
+}
+
+uint32_t nvme_lat_hist_max(const struct nvme_lat_hist *h)
+{
+	unsigned int i;
+
+	for (i = h->nr_buckets; i > 0; i--)
+		if (h->buckets[i - 1].count)
+			return lat_bucket_edge(&h->buckets[i - 1]);
+
+	return 0;
+}
@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_LAT_HIST_H
+#define __UTIL_LAT_HIST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Latency histogram as reported by the devices, with the bucket boundaries
+ * of the log it was decoded from, in increasing order. The vendor latency
+ * logs fill one so the deltas between two reads, the merges and the
+ * percentiles are computed the same way whatever the device.
+ */
+#define NVME_LAT_HIST_MAX_BUCKETS	1280
+
+/* the upper edge of the last bucket of some logs is open */
+#define NVME_LAT_HIST_INF		UINT32_MAX
+
+/* reading the log clears its counters, every read is a delta */
+#define NVME_LAT_HIST_CLEAR_ON_READ	(1 << 0)
+
+struct nvme_lat_bucket {
+	uint32_t low_us;
+	uint32_t high_us;
+	uint64_t count;
+};
+
+struct nvme_lat_hist {
+	unsigned int nr_buckets;
+	unsigned int flags;
+	struct nvme_lat_bucket buckets[NVME_LAT_HIST_MAX_BUCKETS];
+};
+
+void nvme_lat_hist_init(struct nvme_lat_hist *h, unsigned int flags);
+
+/* Returns 0 or -E2BIG when the histogram is full */
+int nvme_lat_hist_add_bucket(struct nvme_lat_hist *h, uint32_t low_us,
+			     uint32_t high_us, uint64_t count);
+
+/*
+ * nvme_lat_hist_delta - the commands counted between @prev and @cur
+ *
+ * A counter lower than in @prev was reset in between, its value in @cur is
+ * taken as is. Returns 0 or -EINVAL when the bucket layouts differ.
+ */
+int nvme_lat_hist_delta(struct nvme_lat_hist *delta, const struct nvme_lat_hist *cur,
+			const struct nvme_lat_hist *prev);
+
+/* add the counters of @src to @dst, returns 0 or -EINVAL as above */
+int nvme_lat_hist_merge(struct nvme_lat_hist *dst, const struct nvme_lat_hist *src);
+
+uint64_t nvme_lat_hist_count(const struct nvme_lat_hist *h);
+
+/*
+ * nvme_lat_hist_percentile - latency below which @pct percent of the
+ * commands completed
+ *
+ * Returns the upper edge in us of the bucket holding the requested rank,
+ * the lower edge for an open ended bucket, or 0 for an empty histogram.
+ */
+uint32_t nvme_lat_hist_percentile(const struct nvme_lat_hist *h, double pct);
+
+/* upper edge of the highest non-empty bucket, as above */
+uint32_t nvme_lat_hist_max(const struct nvme_lat_hist *h);
+
+#endif /* __UTIL_LAT_HIST_H */
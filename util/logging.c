@@ -2,18 +2,33 @@
 
 #include <inttypes.h>
 
+#include <pthread.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/syslog.h>
-#include <sys/time.h>
+#include <time.h>
 #include <linux/types.h>
 
 #include <libnvme.h>
 
+#include "common.h"
+#include "histogram.h"
 #include "logging.h"
+#include "mock.h"
+#include "nvme-trace.h"
 
 int log_level;
 
+bool nvme_cmd_stats_enabled;
+
+/* the admin opcodes, then the I/O ones */
+static struct nvme_hist *cmd_stats[2 * 256];
+static uint64_t cmd_errors[2 * 256];
+static pthread_mutex_t cmd_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
 int map_log_level(int verbose, bool quiet)
 {
 	int log_level;
@@ -79,29 +94,161 @@ static void nvme_show_command64(struct nvme_passthru_cmd64 *cmd, int err)
 	printf("err          : %d\n", err);
 }
 
-static void nvme_show_latency(struct timeval start, struct timeval end)
+uint64_t nvme_cmd_clock_ns(void)
 {
-	printf("latency      : %lu us\n",
-	       (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec));
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void __nvme_cmd_stats_add(bool admin, __u8 opcode, int err, uint64_t lat_ns)
+{
+	unsigned int idx = (admin ? 0 : 256) + opcode;
+	struct nvme_hist *h;
+
+	pthread_mutex_lock(&cmd_stats_lock);
+	h = cmd_stats[idx];
+	if (!h) {
+		h = malloc(sizeof(*h));
+		if (!h)
+			goto unlock;
+		nvme_hist_init(h);
+		cmd_stats[idx] = h;
+	}
+	nvme_hist_add(h, lat_ns);
+	if (err)
+		cmd_errors[idx]++;
+unlock:
+	pthread_mutex_unlock(&cmd_stats_lock);
+}
+
+void nvme_cmd_stats_report(FILE *f, const char *(*name)(int admin, __u8 opcode))
+{
+	struct nvme_hist *h;
+	unsigned int i;
+	int admin;
+
+	if (!nvme_cmd_stats_enabled)
+		return;
+
+	pthread_mutex_lock(&cmd_stats_lock);
+	for (i = 0; i < 2 * 256; i++) {
+		h = cmd_stats[i];
+		if (!h)
+			continue;
+		admin = i < 256;
+		fprintf(f, "stats: %s %02x %-28s %8"PRIu64" cmds %6"PRIu64" errors, latency (us) min %.1f avg %.1f p50 %.1f p99 %.1f max %.1f\n",
+			admin ? "admin" : "io", i % 256, name ? name(admin, i % 256) : "",
+			h->count, cmd_errors[i], h->min / 1e3, nvme_hist_mean(h) / 1e3,
+			nvme_hist_percentile(h, 50) / 1e3, nvme_hist_percentile(h, 99) / 1e3,
+			h->max / 1e3);
+	}
+	pthread_mutex_unlock(&cmd_stats_lock);
+}
+
+static void nvme_show_latency(uint64_t start, uint64_t end)
+{
+	printf("latency      : %"PRIu64" us\n", (end - start) / 1000);
+}
+
+static bool cmd_timed(void)
+{
+	return nvme_cmd_stats_enabled || log_level >= LOG_INFO;
+}
+
+/*
+ * The ioctl of a passthru command, answered by the mock device if @fd is
+ * one and recorded for NVME_MOCK_RECORD otherwise. Both command layouts
+ * start alike, @cmd is either.
+ */
+static int passthru_ioctl(int fd, unsigned long ioctl_cmd, bool admin, bool is64,
+			  struct nvme_passthru_cmd *cmd)
+{
+	struct nvme_passthru_cmd64 *cmd64 = (struct nvme_passthru_cmd64 *)cmd;
+	void *data = (void *)(uintptr_t)cmd->addr;
+	struct nvme_mock_key k = {
+		.admin	= admin,
+		.opcode	= cmd->opcode,
+		.nsid	= cmd->nsid,
+		.cdw	= { cmd->cdw10, cmd->cdw11, cmd->cdw12,
+			    cmd->cdw13, cmd->cdw14, cmd->cdw15 },
+	};
+	struct nvme_mock *m = nvme_mock_find(fd);
+	uint64_t res;
+	int err, errno_save;
+
+	if (m) {
+		err = nvme_mock_submit(m, &k, data, cmd->data_len, &res);
+		if (is64)
+			cmd64->result = res;
+		else
+			cmd->result = res;
+		if (err < 0) {
+			errno = -err;
+			return -1;
+		}
+		return err;
+	}
+
+	err = ioctl(fd, ioctl_cmd, cmd);
+	errno_save = errno;
+	nvme_mock_record(&k, err < 0 ? -errno : err, is64 ? cmd64->result : cmd->result,
+			 data, cmd->data_len);
+	errno = errno_save;
+
+	return err;
+}
+
+/* passthru_ioctl() recorded for --trace-file */
+static int passthru_traced(int fd, unsigned long ioctl_cmd, bool admin, bool is64,
+			   struct nvme_passthru_cmd *cmd)
+{
+	struct nvme_passthru_cmd64 cmd64;
+	uint64_t start, lat;
+	int err, errno_save;
+
+	if (!nvme_trace_enabled)
+		return passthru_ioctl(fd, ioctl_cmd, admin, is64, cmd);
+
+	start = monotonic_ns();
+	err = passthru_ioctl(fd, ioctl_cmd, admin, is64, cmd);
+	lat = monotonic_ns() - start;
+	errno_save = errno;
+
+	if (is64) {
+		nvme_trace_cmd(admin, (struct nvme_passthru_cmd64 *)cmd,
+			       err < 0 ? -errno_save : err, start, lat);
+	} else {
+		/* the fields recorded sit at the same place in both layouts */
+		memset(&cmd64, 0, sizeof(cmd64));
+		memcpy(&cmd64, cmd, offsetof(struct nvme_passthru_cmd, result));
+		nvme_trace_cmd(admin, &cmd64, err < 0 ? -errno_save : err, start, lat);
+	}
+	errno = errno_save;
+
+	return err;
 }
 
 int nvme_submit_passthru(int fd, unsigned long ioctl_cmd,
 			 struct nvme_passthru_cmd *cmd, __u32 *result)
 {
-	struct timeval start;
-	struct timeval end;
+	uint64_t start = 0, end;
 	int err;
 
-	if (log_level >= LOG_INFO)
-		gettimeofday(&start, NULL);
+	if (cmd_timed())
+		start = nvme_cmd_clock_ns();
 
-	err = ioctl(fd, ioctl_cmd, cmd);
+	err = passthru_traced(fd, ioctl_cmd, ioctl_cmd == NVME_IOCTL_ADMIN_CMD, false, cmd);
 
-	if (log_level >= LOG_INFO) {
-		gettimeofday(&end, NULL);
+	if (start) {
+		end = nvme_cmd_clock_ns();
+		nvme_cmd_stats_add(ioctl_cmd == NVME_IOCTL_ADMIN_CMD, cmd->opcode, err,
+				   end - start);
 		if (log_level >= LOG_DEBUG)
 			nvme_show_command(cmd, err);
-		nvme_show_latency(start, end);
+		if (log_level >= LOG_INFO)
+			nvme_show_latency(start, end);
 	}
 
 	if (err >= 0 && result)
@@ -114,21 +261,23 @@ int nvme_submit_passthru64(int fd, unsigned long ioctl_cmd,
 			   struct nvme_passthru_cmd64 *cmd,
 			   __u64 *result)
 {
-	struct timeval start;
-	struct timeval end;
+	uint64_t start = 0, end;
 	int err;
 
-	if (log_level >= LOG_INFO)
-		gettimeofday(&start, NULL);
+	if (cmd_timed())
+		start = nvme_cmd_clock_ns();
 
+	err = passthru_traced(fd, ioctl_cmd, ioctl_cmd == NVME_IOCTL_ADMIN64_CMD, true,
+			      (struct nvme_passthru_cmd *)cmd);
 
-	err = ioctl(fd, ioctl_cmd, cmd);
-
-	if (log_level >= LOG_INFO) {
-		gettimeofday(&end, NULL);
+	if (start) {
+		end = nvme_cmd_clock_ns();
+		nvme_cmd_stats_add(ioctl_cmd == NVME_IOCTL_ADMIN64_CMD, cmd->opcode, err,
+				   end - start);
 		if (log_level >= LOG_DEBUG)
 			nvme_show_command64(cmd, err);
-		nvme_show_latency(start, end);
+		if (log_level >= LOG_INFO)
+			nvme_show_latency(start, end);
 	}
 
 	if (err >= 0 && result)
@@ -4,9 +4,39 @@
 #define DEBUG_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <linux/types.h>
 
 extern int log_level;
 
 int map_log_level(int verbose, bool quiet);
 
+/*
+ * Per opcode latency of the passthru commands of the whole process, for
+ * the global --stats option: the commands of libnvme and the plugins going
+ * through nvme_submit_passthru(), and the ones of the I/O engine. Timed
+ * with CLOCK_MONOTONIC_RAW, which is a vDSO call reading the TSC, and
+ * only sampled while enabled or at log level info.
+ */
+extern bool nvme_cmd_stats_enabled;
+
+uint64_t nvme_cmd_clock_ns(void);
+
+void __nvme_cmd_stats_add(bool admin, __u8 opcode, int err, uint64_t lat_ns);
+
+/* nvme_cmd_stats_add - account a command which completed with @err */
+static inline void nvme_cmd_stats_add(bool admin, __u8 opcode, int err, uint64_t lat_ns)
+{
+	if (nvme_cmd_stats_enabled)
+		__nvme_cmd_stats_add(admin, opcode, err, lat_ns);
+}
+
+/*
+ * nvme_cmd_stats_report - print a line per opcode sent to @f, named by
+ * @name if given
+ */
+void nvme_cmd_stats_report(FILE *f, const char *(*name)(int admin, __u8 opcode));
+
 #endif // DEBUG_H_
@@ -1,17 +1,125 @@
 /* SPDX-License-Identifier: GPL-2.0-or-later */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <malloc.h>
+#include <pthread.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 
 #include "mem.h"
+#include "sysfs.h"
 
 #include "common.h"
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 #define HUGE_MIN 0x80000
 
+#define HUGE_CACHE_ENTRIES	4
+#define HUGE_CACHE_MAX		(256UL << 20)	/* bytes kept */
+
+/* from <numaif.h>, which comes with libnuma */
+#define NUMA_MPOL_PREFERRED	1
+#define NUMA_MPOL_MF_MOVE	(1 << 1)
+
+static int huge_node = -1;
+
+static struct {
+	pthread_mutex_t lock;
+	struct nvme_mem_huge e[HUGE_CACHE_ENTRIES];
+	struct nvme_mem_huge_stats stats;
+} huge_cache = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void huge_release(struct nvme_mem_huge *mh)
+{
+	if (mh->posix_memalign)
+		free(mh->p);
+	else
+		munmap(mh->p, mh->len);
+}
+
+/*
+ * Best fit from the cache. A buffer more than twice the size plus a huge
+ * page isn't used, that would pin a large mapping for a small command.
+ */
+static bool huge_cache_get(size_t len, struct nvme_mem_huge *mh)
+{
+	struct nvme_mem_huge *e, *best = NULL;
+	int i;
+
+	pthread_mutex_lock(&huge_cache.lock);
+	for (i = 0; i < HUGE_CACHE_ENTRIES; i++) {
+		e = &huge_cache.e[i];
+		if (e->len < len || e->len > 2 * len + 0x200000 ||
+		    e->node != huge_node)
+			continue;
+		if (!best || e->len < best->len)
+			best = e;
+	}
+	if (best) {
+		*mh = *best;
+		memset(best, 0, sizeof(*best));
+		huge_cache.stats.hits++;
+		huge_cache.stats.cached -= mh->len;
+	} else {
+		huge_cache.stats.misses++;
+	}
+	pthread_mutex_unlock(&huge_cache.lock);
+
+	return best;
+}
+
+static bool huge_cache_put(struct nvme_mem_huge *mh)
+{
+	bool kept = false;
+	int i;
+
+	pthread_mutex_lock(&huge_cache.lock);
+	for (i = 0; i < HUGE_CACHE_ENTRIES; i++) {
+		if (huge_cache.e[i].len ||
+		    huge_cache.stats.cached + mh->len > HUGE_CACHE_MAX)
+			continue;
+		huge_cache.e[i] = *mh;
+		huge_cache.stats.cached += mh->len;
+		kept = true;
+		break;
+	}
+	pthread_mutex_unlock(&huge_cache.lock);
+
+	return kept;
+}
+
+void nvme_mem_set_node(int node)
+{
+	huge_node = node;
+}
+
+/*
+ * Prefer @node for the pages of the mapping, before they are first
+ * touched. Failing that, e.g. without CONFIG_NUMA, the pages land where
+ * the kernel puts them anyway.
+ */
+static void huge_bind(struct nvme_mem_huge *mh)
+{
+	unsigned long mask[4] = { 0 };
+	int node = huge_node;
+
+	mh->node = -1;
+	if (node < 0 || node >= (int)(sizeof(mask) * 8))
+		return;
+
+	mask[node / (sizeof(mask[0]) * 8)] = 1UL << (node % (sizeof(mask[0]) * 8));
+	if (!syscall(SYS_mbind, mh->p, mh->len, NUMA_MPOL_PREFERRED, mask,
+		     sizeof(mask) * 8, NUMA_MPOL_MF_MOVE))
+		mh->node = node;
+}
+
 void *nvme_alloc(size_t len)
 {
 	void *p;
@@ -20,17 +128,27 @@ void *nvme_alloc(size_t len)
 	if (posix_memalign((void *)&p, getpagesize(), len))
 		return NULL;
 
-	memset(p, 0, len);
+	/* the slack too, nvme_realloc() grows into it */
+	memset(p, 0, malloc_usable_size(p));
 	return p;
 }
 
 void *nvme_realloc(void *p, size_t len)
 {
 	size_t old_len = malloc_usable_size(p);
+	void *result;
 
-	void *result = nvme_alloc(len);
+	/*
+	 * In place, what lies past @len is cleared, a shrink followed by a
+	 * grow hands out a zeroed tail like a move does.
+	 */
+	if (p && ROUND_UP(len, 0x1000) <= old_len) {
+		memset((char *)p + len, 0, old_len - len);
+		return p;
+	}
 
-	if (p) {
+	result = nvme_alloc(len);
+	if (result && p) {
 		memcpy(result, p, min(old_len, len));
 		free(p);
 	}
@@ -41,6 +159,7 @@ void *nvme_realloc(void *p, size_t len)
 void *nvme_alloc_huge(size_t len, struct nvme_mem_huge *mh)
 {
 	memset(mh, 0, sizeof(*mh));
+	mh->node = -1;
 
 	len = ROUND_UP(len, 0x1000);
 
@@ -57,6 +176,12 @@ void *nvme_alloc_huge(size_t len, struct nvme_mem_huge *mh)
 		return mh->p;
 	}
 
+	/* the cached buffers may have been written, only clear what's asked for */
+	if (huge_cache_get(len, mh)) {
+		memset(mh->p, 0, len);
+		return mh->p;
+	}
+
 	/*
 	 * Larger allocation will almost certainly fail with the small
 	 * allocation approach. Instead try pre-allocating memory from the
@@ -68,6 +193,8 @@ void *nvme_alloc_huge(size_t len, struct nvme_mem_huge *mh)
 		     MAP_ANONYMOUS | MAP_PRIVATE | MAP_HUGETLB, -1, 0);
 	if (mh->p != MAP_FAILED) {
 		mh->len = len;
+		huge_bind(mh);
+		__atomic_fetch_add(&huge_cache.stats.hugetlb, 1, __ATOMIC_RELAXED);
 		return mh->p;
 	}
 
@@ -82,13 +209,16 @@ void *nvme_alloc_huge(size_t len, struct nvme_mem_huge *mh)
 		return NULL;
 	mh->posix_memalign = true;
 	mh->len = len;
+	huge_bind(mh);
 
 	memset(mh->p, 0, mh->len);
 
 	if (madvise(mh->p, mh->len, MADV_HUGEPAGE) < 0) {
-		nvme_free_huge(mh);
+		huge_release(mh);
+		memset(mh, 0, sizeof(*mh));
 		return NULL;
 	}
+	__atomic_fetch_add(&huge_cache.stats.thp, 1, __ATOMIC_RELAXED);
 
 	return mh->p;
 }
@@ -99,11 +229,232 @@ void nvme_free_huge(struct nvme_mem_huge *mh)
 	if (!mh || mh->len == 0)
 		return;
 
-	if (mh->posix_memalign)
-		free(mh->p);
-	else
-		munmap(mh->p, mh->len);
+	if (mh->cmb || mh->len < HUGE_MIN || !huge_cache_put(mh))
+		huge_release(mh);
 
 	mh->len = 0;
 	mh->p = NULL;
 }
+
+void *nvme_alloc_cmb(const char *p2pmem, size_t len, struct nvme_mem_huge *mh)
+{
+	unsigned long long published, available;
+	char path[PATH_MAX];
+	int fd;
+
+	memset(mh, 0, sizeof(*mh));
+
+	len = ROUND_UP(len, getpagesize());
+
+	if (sysfs_read_u64(p2pmem, "published", &published) || !published) {
+		errno = ENODEV;
+		return NULL;
+	}
+	if (!sysfs_read_u64(p2pmem, "available", &available) &&
+	    available < len) {
+		errno = ENOSPC;
+		return NULL;
+	}
+
+	snprintf(path, sizeof(path), "%s/allocate", p2pmem);
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return NULL;
+
+	/* every mapping of the file is a new allocation from the CMB */
+	mh->p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mh->p == MAP_FAILED) {
+		mh->p = NULL;
+		return NULL;
+	}
+	mh->cmb = true;
+	mh->len = len;
+
+	/* a previous user's data may still be in there */
+	memset(mh->p, 0, len);
+
+	return mh->p;
+}
+
+void nvme_huge_cache_stats(struct nvme_mem_huge_stats *stats)
+{
+	pthread_mutex_lock(&huge_cache.lock);
+	*stats = huge_cache.stats;
+	pthread_mutex_unlock(&huge_cache.lock);
+}
+
+void nvme_huge_cache_drain(void)
+{
+	int i;
+
+	pthread_mutex_lock(&huge_cache.lock);
+	for (i = 0; i < HUGE_CACHE_ENTRIES; i++) {
+		if (huge_cache.e[i].len)
+			huge_release(&huge_cache.e[i]);
+		memset(&huge_cache.e[i], 0, sizeof(huge_cache.e[i]));
+	}
+	huge_cache.stats.cached = 0;
+	pthread_mutex_unlock(&huge_cache.lock);
+}
+
+#define BUF_MIN_SHIFT	12
+#define BUF_MAX_SHIFT	20
+#define BUF_CLASSES	(BUF_MAX_SHIFT - BUF_MIN_SHIFT + 1)
+#define BUF_MAX		(1UL << BUF_MAX_SHIFT)
+#define BUF_DEPTH	8	/* free buffers kept per size class */
+
+/* a free buffer links to the next one of its class */
+struct buf_free {
+	struct buf_free *next;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct buf_free *free[BUF_CLASSES];
+	unsigned int nr[BUF_CLASSES];
+} buf_pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static int buf_class(size_t len)
+{
+	int shift = BUF_MIN_SHIFT;
+
+	while ((1UL << shift) < len)
+		shift++;
+
+	return shift - BUF_MIN_SHIFT;
+}
+
+/* anonymous mappings are page aligned and read as zero until written */
+static void *buf_map(size_t len)
+{
+	void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+	return p == MAP_FAILED ? NULL : p;
+}
+
+void *nvme_buf_get(struct nvme_buf *b, size_t len)
+{
+	struct buf_free *f = NULL;
+	size_t size;
+	int c;
+
+	b->p = NULL;
+	b->len = 0;
+	b->used = 0;
+
+	if (len > BUF_MAX) {
+		size = ROUND_UP(len, getpagesize());
+	} else {
+		c = buf_class(len);
+		size = 1UL << (c + BUF_MIN_SHIFT);
+
+		pthread_mutex_lock(&buf_pool.lock);
+		f = buf_pool.free[c];
+		if (f) {
+			buf_pool.free[c] = f->next;
+			buf_pool.nr[c]--;
+		}
+		pthread_mutex_unlock(&buf_pool.lock);
+
+		if (f) {
+			memset(f, 0, max(len, sizeof(*f)));
+			b->p = f;
+			b->len = size;
+			b->used = max(len, sizeof(*f));
+			return b->p;
+		}
+	}
+
+	b->p = buf_map(size);
+	if (!b->p)
+		return NULL;
+	b->len = size;
+	b->used = size;
+
+	return b->p;
+}
+
+void *nvme_buf_resize(struct nvme_buf *b, size_t len)
+{
+	struct nvme_buf n;
+	void *p;
+
+	/* a reused class buffer is only cleared up to what was asked for */
+	if (len <= b->len) {
+		if (len > b->used) {
+			memset((char *)b->p + b->used, 0, len - b->used);
+			b->used = len;
+		}
+		return b->p;
+	}
+
+	/* large buffers are remapped, the kernel moves the pages if needed */
+	if (b->len > BUF_MAX) {
+		len = ROUND_UP(len, getpagesize());
+		p = mremap(b->p, b->len, len, MREMAP_MAYMOVE);
+		if (p == MAP_FAILED)
+			return NULL;
+		b->p = p;
+		b->len = len;
+		b->used = len;
+		return b->p;
+	}
+
+	if (!nvme_buf_get(&n, len))
+		return NULL;
+	if (b->p)
+		memcpy(n.p, b->p, b->used);
+	nvme_buf_put(b);
+	*b = n;
+
+	return b->p;
+}
+
+void nvme_buf_put(struct nvme_buf *b)
+{
+	struct buf_free *f = b->p;
+	int c;
+
+	if (!b->p)
+		return;
+
+	if (b->len <= BUF_MAX) {
+		c = buf_class(b->len);
+
+		pthread_mutex_lock(&buf_pool.lock);
+		if (buf_pool.nr[c] < BUF_DEPTH) {
+			f->next = buf_pool.free[c];
+			buf_pool.free[c] = f;
+			buf_pool.nr[c]++;
+			f = NULL;
+		}
+		pthread_mutex_unlock(&buf_pool.lock);
+	}
+
+	if (f)
+		munmap(b->p, b->len);
+
+	b->p = NULL;
+	b->len = 0;
+	b->used = 0;
+}
+
+void nvme_buf_pool_drain(void)
+{
+	struct buf_free *f;
+	int c;
+
+	pthread_mutex_lock(&buf_pool.lock);
+	for (c = 0; c < BUF_CLASSES; c++) {
+		while ((f = buf_pool.free[c])) {
+			buf_pool.free[c] = f->next;
+			munmap(f, 1UL << (c + BUF_MIN_SHIFT));
+		}
+		buf_pool.nr[c] = 0;
+	}
+	pthread_mutex_unlock(&buf_pool.lock);
+}
@@ -11,10 +11,85 @@ void *nvme_realloc(void *p, size_t len);
 struct nvme_mem_huge {
 	size_t len;
 	bool posix_memalign; /* p has been allocated using posix_memalign */
+	bool cmb; /* p maps controller memory, see nvme_alloc_cmb() */
+	int node; /* NUMA node p was placed on, -1 for none */
 	void *p;
 };
 
 void *nvme_alloc_huge(size_t len, struct nvme_mem_huge *mh);
+
+/*
+ * nvme_mem_set_node - place the buffers of nvme_alloc_huge() from now on
+ * on NUMA node @node, the one of the device they're for, or where the
+ * kernel chooses for -1. Only buffers of that node are reused from the
+ * cache.
+ */
+void nvme_mem_set_node(int node);
 void nvme_free_huge(struct nvme_mem_huge *mh);
 
+/*
+ * nvme_alloc_cmb - map @len bytes of a Controller Memory Buffer
+ * @p2pmem:	the p2pmem directory of the controller's PCI device in sysfs
+ *
+ * The kernel publishes the CMB of a controller that supports both data
+ * directions in it (CMBSZ.WDS and RDS) as peer-to-peer memory, and these
+ * mappings can be the data buffers of passthrough and O_DIRECT I/O. The
+ * buffer is uncached device memory, cleared like the host memory ones. It
+ * is released by nvme_free_huge() and never cached.
+ *
+ * Returns the buffer or NULL with errno set, ENODEV if the CMB isn't
+ * published and ENOSPC if not enough of it is left.
+ */
+void *nvme_alloc_cmb(const char *p2pmem, size_t len, struct nvme_mem_huge *mh);
+
+/*
+ * The large buffers freed by nvme_free_huge() are kept in a process wide
+ * cache and reused by nvme_alloc_huge(), which saves the mapping and the
+ * hugepage faults of commands run in a loop.
+ */
+struct nvme_mem_huge_stats {
+	unsigned long hits;	/* served from the cache */
+	unsigned long misses;	/* newly allocated */
+	unsigned long hugetlb;	/* misses served from the HugeTLB pool */
+	unsigned long thp;	/* misses served by the madvise fallback */
+	size_t cached;		/* bytes kept in the cache */
+};
+
+void nvme_huge_cache_stats(struct nvme_mem_huge_stats *stats);
+void nvme_huge_cache_drain(void);
+
+/*
+ * Pool of page aligned buffers for commands repeated on a schedule. Freed
+ * buffers up to 1M are kept by power of two size class and handed out
+ * again; larger ones are mapped on their own and grown with mremap. The
+ * pool is thread safe.
+ */
+struct nvme_buf {
+	void *p;
+	size_t len;	/* usable size, the size class for pooled buffers */
+	size_t used;	/* cleared or kept, past it a previous user's data */
+};
+
+/*
+ * nvme_buf_get - take a buffer of at least @len bytes from the pool
+ *
+ * Only the first @len bytes are cleared. Returns the buffer, also stored
+ * in @b->p, or NULL with errno set.
+ */
+void *nvme_buf_get(struct nvme_buf *b, size_t len);
+
+/*
+ * nvme_buf_resize - grow @b to at least @len bytes, keeping the contents
+ *
+ * The contents are the bytes asked for so far, the ones added are cleared. Returns the buffer, which may have moved,
+ * or NULL with errno set and @b unchanged.
+ */
+void *nvme_buf_resize(struct nvme_buf *b, size_t len);
+
+/* nvme_buf_put - return @b to the pool */
+void nvme_buf_put(struct nvme_buf *b);
+
+/* nvme_buf_pool_drain - unmap all buffers kept in the pool */
+void nvme_buf_pool_drain(void);
+
 #endif /* MEM_H_ */
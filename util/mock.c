@@ -0,0 +1,409 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bundle.h"
+#include "mock.h"
+
+#define MOCK_GET_LOG_PAGE	0x02
+
+struct mock_rsp {
+	struct nvme_mock_key key;
+	size_t seq;			/* in the bundle, orders equal keys */
+	int status;
+	uint64_t result;
+	const uint8_t *data;
+	uint32_t len;
+};
+
+struct mock_log {
+	uint8_t lid;
+	uint16_t lsi;
+	const uint8_t *data;
+	size_t len;
+};
+
+struct nvme_mock {
+	int fd;
+	uint32_t latency_us;
+	void *map;
+	size_t map_len;
+
+	struct mock_rsp *rsps;		/* sorted by key */
+	size_t nr;
+	size_t *turn;			/* of the responses to a key, at its first */
+	struct mock_log *logs;
+	size_t nr_logs;
+	pthread_mutex_t lock;
+
+	struct nvme_mock *next;
+};
+
+static struct nvme_mock *mocks;
+static pthread_mutex_t mocks_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int key_cmp(const struct nvme_mock_key *a, const struct nvme_mock_key *b)
+{
+	int i;
+
+	if (a->admin != b->admin)
+		return a->admin ? 1 : -1;
+	if (a->opcode != b->opcode)
+		return a->opcode < b->opcode ? -1 : 1;
+	if (a->nsid != b->nsid)
+		return a->nsid < b->nsid ? -1 : 1;
+	for (i = 0; i < 6; i++)
+		if (a->cdw[i] != b->cdw[i])
+			return a->cdw[i] < b->cdw[i] ? -1 : 1;
+
+	return 0;
+}
+
+static int rsp_cmp(const void *a, const void *b)
+{
+	const struct mock_rsp *ra = a, *rb = b;
+	int c = key_cmp(&ra->key, &rb->key);
+
+	if (c)
+		return c;
+	return ra->seq < rb->seq ? -1 : ra->seq > rb->seq;
+}
+
+static int mock_load(struct nvme_mock *m)
+{
+	struct nvme_bundle_entry e;
+	struct nvme_mock_rec rec;
+	struct mock_rsp *r;
+	struct mock_log *l;
+	struct nvme_bundle b;
+	uint32_t i;
+	int err, j;
+
+	err = nvme_bundle_open(&b, m->map, m->map_len);
+	if (err)
+		return err;
+
+	m->rsps = calloc(b.nr ? b.nr : 1, sizeof(*m->rsps));
+	m->logs = calloc(b.nr ? b.nr : 1, sizeof(*m->logs));
+	if (!m->rsps || !m->logs)
+		return -ENOMEM;
+
+	for (i = 0; i < b.nr; i++) {
+		nvme_bundle_get(&b, i, &e);
+
+		if (strcmp(e.name, NVME_MOCK_ENTRY)) {
+			l = &m->logs[m->nr_logs++];
+			l->lid = e.lid;
+			l->lsi = e.lsi;
+			l->data = e.data;
+			l->len = e.len;
+			continue;
+		}
+
+		if (e.len < sizeof(rec) || !nvme_bundle_verify(&e))
+			return -EINVAL;
+		memcpy(&rec, e.data, sizeof(rec));
+		if (le32toh(rec.data_len) > e.len - sizeof(rec))
+			return -EINVAL;
+
+		r = &m->rsps[m->nr++];
+		r->key.admin = rec.admin;
+		r->key.opcode = rec.opcode;
+		r->key.nsid = le32toh(rec.nsid);
+		for (j = 0; j < 6; j++)
+			r->key.cdw[j] = le32toh(rec.cdw[j]);
+		r->seq = i;
+		r->status = (int32_t)le32toh(rec.status);
+		r->result = le64toh(rec.result);
+		r->data = (const uint8_t *)e.data + sizeof(rec);
+		r->len = le32toh(rec.data_len);
+	}
+
+	qsort(m->rsps, m->nr, sizeof(*m->rsps), rsp_cmp);
+
+	m->turn = calloc(m->nr ? m->nr : 1, sizeof(*m->turn));
+	if (!m->turn)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static void mock_free(struct nvme_mock *m)
+{
+	free(m->turn);
+	free(m->logs);
+	free(m->rsps);
+	if (m->map)
+		munmap(m->map, m->map_len);
+	if (m->fd >= 0)
+		close(m->fd);
+	pthread_mutex_destroy(&m->lock);
+	free(m);
+}
+
+int nvme_mock_open(const char *file, uint32_t latency_us, struct nvme_mock **mp)
+{
+	struct nvme_mock *m;
+	struct stat st;
+	int err;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return -ENOMEM;
+	pthread_mutex_init(&m->lock, NULL);
+	m->latency_us = latency_us;
+
+	m->fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (m->fd < 0 || fstat(m->fd, &st)) {
+		err = -errno;
+		goto err;
+	}
+	if (!S_ISREG(st.st_mode) || !st.st_size) {
+		err = -EINVAL;
+		goto err;
+	}
+
+	m->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+	if (m->map == MAP_FAILED) {
+		m->map = NULL;
+		err = -errno;
+		goto err;
+	}
+	m->map_len = st.st_size;
+
+	err = mock_load(m);
+	if (err)
+		goto err;
+
+	pthread_mutex_lock(&mocks_lock);
+	m->next = mocks;
+	__atomic_store_n(&mocks, m, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&mocks_lock);
+
+	*mp = m;
+	return 0;
+
+err:
+	mock_free(m);
+	return err;
+}
+
+void nvme_mock_close(struct nvme_mock *m)
+{
+	struct nvme_mock **p;
+
+	pthread_mutex_lock(&mocks_lock);
+	for (p = &mocks; *p; p = &(*p)->next) {
+		if (*p == m) {
+			__atomic_store_n(p, m->next, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mocks_lock);
+
+	mock_free(m);
+}
+
+int nvme_mock_fd(const struct nvme_mock *m)
+{
+	return m->fd;
+}
+
+size_t nvme_mock_nr(const struct nvme_mock *m)
+{
+	return m->nr;
+}
+
+struct nvme_mock *nvme_mock_find(int fd)
+{
+	struct nvme_mock *m;
+
+	/* every command of a real device asks, without any mock open */
+	if (!__atomic_load_n(&mocks, __ATOMIC_ACQUIRE))
+		return NULL;
+
+	pthread_mutex_lock(&mocks_lock);
+	for (m = mocks; m && m->fd != fd; m = m->next)
+		;
+	pthread_mutex_unlock(&mocks_lock);
+
+	return m;
+}
+
+/* the opcode transfers data from the controller to the host */
+static bool to_host(uint8_t opcode)
+{
+	return opcode & 0x2;
+}
+
+static void copy_data(void *data, uint32_t len, const uint8_t *src, size_t src_len)
+{
+	size_t n = src_len < len ? src_len : len;
+
+	memcpy(data, src, n);
+	memset((uint8_t *)data + n, 0, len - n);
+}
+
+static const struct mock_rsp *mock_lookup(struct nvme_mock *m,
+					  const struct nvme_mock_key *k)
+{
+	size_t lo = 0, hi = m->nr, mid, end, i;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (key_cmp(&m->rsps[mid].key, k) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == m->nr || key_cmp(&m->rsps[lo].key, k))
+		return NULL;
+
+	for (end = lo + 1; end < m->nr && !key_cmp(&m->rsps[end].key, k); end++)
+		;
+
+	pthread_mutex_lock(&m->lock);
+	i = lo + m->turn[lo];
+	if (i + 1 < end)
+		m->turn[lo]++;
+	pthread_mutex_unlock(&m->lock);
+
+	return &m->rsps[i];
+}
+
+static int mock_get_log(struct nvme_mock *m, const struct nvme_mock_key *k,
+			void *data, uint32_t len)
+{
+	uint8_t lid = k->cdw[0] & 0xff;
+	uint16_t lsi = k->cdw[1] >> 16;
+	uint64_t lpo = k->cdw[2] | (uint64_t)k->cdw[3] << 32;
+	const struct mock_log *l;
+	size_t i;
+
+	for (i = 0; i < m->nr_logs; i++) {
+		l = &m->logs[i];
+		if (l->lid != lid || l->lsi != lsi)
+			continue;
+		if (lpo > l->len)
+			break;
+		if (data)
+			copy_data(data, len, l->data + lpo, l->len - lpo);
+		return 0;
+	}
+
+	return NVME_MOCK_SC_NO_MATCH;
+}
+
+int nvme_mock_submit(struct nvme_mock *m, const struct nvme_mock_key *k,
+		     void *data, uint32_t len, uint64_t *result)
+{
+	const struct mock_rsp *r;
+	struct timespec ts;
+
+	if (m->latency_us) {
+		ts.tv_sec = m->latency_us / 1000000;
+		ts.tv_nsec = (m->latency_us % 1000000) * 1000L;
+		while (nanosleep(&ts, &ts) && errno == EINTR)
+			;
+	}
+
+	*result = 0;
+	r = mock_lookup(m, k);
+	if (r) {
+		if (to_host(k->opcode) && data)
+			copy_data(data, len, r->data, r->len);
+		*result = r->result;
+		return r->status;
+	}
+
+	if (k->admin && k->opcode == MOCK_GET_LOG_PAGE)
+		return mock_get_log(m, k, data, len);
+
+	return NVME_MOCK_SC_NO_MATCH;
+}
+
+static struct {
+	pthread_once_t once;
+	struct nvme_bundle_writer *w;
+	int fd;
+} rec = {
+	.once	= PTHREAD_ONCE_INIT,
+	.fd	= -1,
+};
+
+static void record_close(void)
+{
+	int err = nvme_bundle_close(rec.w);
+
+	if (err)
+		fprintf(stderr, "NVME_MOCK_RECORD: %s\n", strerror(-err));
+	close(rec.fd);
+	rec.w = NULL;
+}
+
+static void record_open(void)
+{
+	const char *file = getenv("NVME_MOCK_RECORD");
+
+	if (!file || !*file)
+		return;
+
+	rec.fd = open(file, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (rec.fd < 0) {
+		perror(file);
+		return;
+	}
+
+	rec.w = nvme_bundle_create(rec.fd);
+	if (!rec.w) {
+		perror(file);
+		close(rec.fd);
+		return;
+	}
+
+	atexit(record_close);
+}
+
+void nvme_mock_record(const struct nvme_mock_key *k, int status, uint64_t result,
+		      const void *data, uint32_t len)
+{
+	struct nvme_bundle_entry e = { .name = NVME_MOCK_ENTRY };
+	struct nvme_mock_rec *r;
+	int i;
+
+	pthread_once(&rec.once, record_open);
+	if (!rec.w)
+		return;
+
+	if (!to_host(k->opcode) || !data || status < 0)
+		len = 0;
+
+	r = malloc(sizeof(*r) + len);
+	if (!r)
+		return;
+
+	memset(r, 0, sizeof(*r));
+	r->admin = k->admin;
+	r->opcode = k->opcode;
+	r->nsid = htole32(k->nsid);
+	for (i = 0; i < 6; i++)
+		r->cdw[i] = htole32(k->cdw[i]);
+	r->status = htole32((uint32_t)status);
+	r->data_len = htole32(len);
+	r->result = htole64(result);
+	if (len)
+		memcpy(r + 1, data, len);
+
+	nvme_bundle_add(rec.w, &e, r, sizeof(*r) + len);
+	free(r);
+}
@@ -0,0 +1,90 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_MOCK_H
+#define __UTIL_MOCK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Mock devices, "mock:<bundle>" on the command line, answering the
+ * passthru commands sent to their fd from a capture bundle instead of a
+ * controller, for benchmarks and tests of the decoding, printing and
+ * plugin paths without hardware.
+ *
+ * A response is a bundle entry named NVME_MOCK_ENTRY holding a struct
+ * nvme_mock_rec, little endian, and the data the controller returned.
+ * Commands are matched by admin or I/O queue, opcode, NSID and CDW10 to
+ * CDW15. A command recorded several times is answered with the recorded
+ * responses in turn, the last one over and over. A Get Log Page without
+ * a response of its own is served from a log capture of the bundle with
+ * its LID and LSI, e.g. one of collect --bundle, at the offset asked for.
+ * Any other command fails with Invalid Field in Command.
+ *
+ * With NVME_MOCK_RECORD set to a file, the commands sent to real devices
+ * are recorded there as such a bundle.
+ */
+#define NVME_MOCK_ENTRY		"mock-cmd"
+
+/* DNR and Invalid Field in Command, for the commands nothing matches */
+#define NVME_MOCK_SC_NO_MATCH	0x4002
+
+struct nvme_mock_rec {
+	uint8_t admin;
+	uint8_t opcode;
+	uint8_t rsvd[2];
+	uint32_t nsid;
+	uint32_t cdw[6];	/* CDW10 to CDW15 */
+	int32_t status;		/* NVMe status or negative errno */
+	uint32_t data_len;	/* of the data following */
+	uint64_t result;
+};
+
+/* a command as asked for, host endian */
+struct nvme_mock_key {
+	bool admin;
+	uint8_t opcode;
+	uint32_t nsid;
+	uint32_t cdw[6];
+};
+
+struct nvme_mock;
+
+/*
+ * nvme_mock_open - map the bundle @file for a mock device
+ * @latency_us: added to every command
+ *
+ * The mock is registered under its fd, see nvme_mock_find(). Returns 0 or
+ * a negative errno, -EINVAL if @file isn't a bundle.
+ */
+int nvme_mock_open(const char *file, uint32_t latency_us, struct nvme_mock **m);
+
+void nvme_mock_close(struct nvme_mock *m);
+
+/* the fd standing for the device, of the bundle file */
+int nvme_mock_fd(const struct nvme_mock *m);
+
+/* number of responses recorded in the bundle */
+size_t nvme_mock_nr(const struct nvme_mock *m);
+
+/* the mock of @fd, NULL for the fds of real devices */
+struct nvme_mock *nvme_mock_find(int fd);
+
+/*
+ * nvme_mock_submit - answer @k, copying the data returned into the
+ * @len bytes of @data if the opcode transfers data to the host
+ *
+ * Returns 0, an NVMe status or a negative errno, and the completion's
+ * dword 0 and 1 in @result. Can be called from several threads.
+ */
+int nvme_mock_submit(struct nvme_mock *m, const struct nvme_mock_key *k,
+		     void *data, uint32_t len, uint64_t *result);
+
+/*
+ * nvme_mock_record - add a command to the bundle of NVME_MOCK_RECORD, if
+ * set, which is written out at exit
+ */
+void nvme_mock_record(const struct nvme_mock_key *k, int status, uint64_t result,
+		      const void *data, uint32_t len);
+
+#endif /* __UTIL_MOCK_H */
@@ -0,0 +1,382 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <endian.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pevent-store.h"
+#include "cache.h"
+
+#define STORE_MAGIC_LEN		(sizeof(NVME_PEVENT_STORE_MAGIC) - 1)
+#define STORE_HDR_LEN		(STORE_MAGIC_LEN + 8)
+
+/* the entry header up to and including the event length */
+#define ENTRY_HDR_LEN		24
+#define ENTRY_MAX_LEN		(ENTRY_HDR_LEN + 0xff + 0xffff)
+
+static uint16_t get_le16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static uint64_t get_le64(const uint8_t *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return le64toh(v);
+}
+
+/* length of the entry at @off of @buf, 0 if it isn't complete */
+static size_t entry_len(const uint8_t *buf, size_t off, size_t len)
+{
+	size_t elen;
+
+	if (off + ENTRY_HDR_LEN > len)
+		return 0;
+	elen = buf[off + 2] + 3 + get_le16(buf + off + 22);
+	if (elen < ENTRY_HDR_LEN || off + elen > len)
+		return 0;
+
+	return elen;
+}
+
+static void store_unmap(struct nvme_pevent_store *s)
+{
+	if (s->map)
+		munmap(s->map, s->map_len);
+	s->map = NULL;
+	s->map_len = 0;
+	s->recs = NULL;
+	s->nr = 0;
+}
+
+/*
+ * Map the index and set the number of entries to the complete records
+ * whose entries are in "events", a writable store drops the rest.
+ */
+static int store_load(struct nvme_pevent_store *s)
+{
+	const struct nvme_pevent_rec *r;
+	struct stat ist, est;
+	size_t nr;
+
+	store_unmap(s);
+
+	if (fstat(s->index_fd, &ist) || fstat(s->events_fd, &est))
+		return -errno;
+
+	nr = (ist.st_size - STORE_HDR_LEN) / sizeof(*r);
+	if (nr) {
+		s->map_len = STORE_HDR_LEN + nr * sizeof(*r);
+		s->map = mmap(NULL, s->map_len, PROT_READ, MAP_SHARED,
+			      s->index_fd, 0);
+		if (s->map == MAP_FAILED) {
+			s->map = NULL;
+			s->map_len = 0;
+			return -errno;
+		}
+		s->recs = (const void *)((uint8_t *)s->map + STORE_HDR_LEN);
+	}
+
+	while (nr) {
+		r = &s->recs[nr - 1];
+		if (le64toh(r->off) + le32toh(r->len) <= (uint64_t)est.st_size)
+			break;
+		nr--;
+	}
+	s->nr = nr;
+	s->events_len = nr ? le64toh(s->recs[nr - 1].off) +
+		le32toh(s->recs[nr - 1].len) : 0;
+
+	if (!s->writable)
+		return 0;
+
+	if ((ist.st_size > (off_t)(STORE_HDR_LEN + nr * sizeof(*r)) &&
+	     ftruncate(s->index_fd, STORE_HDR_LEN + nr * sizeof(*r))) ||
+	    (est.st_size > (off_t)s->events_len &&
+	     ftruncate(s->events_fd, s->events_len)))
+		return -errno;
+
+	return 0;
+}
+
+static int store_open_file(const char *dir, const char *name, bool writable)
+{
+	char path[PATH_MAX];
+
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= (int)sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	return open(path, (writable ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC,
+		    0644);
+}
+
+int nvme_pevent_store_open(struct nvme_pevent_store *s, const char *dir,
+			   bool writable)
+{
+	uint8_t hdr[STORE_HDR_LEN];
+	char path[PATH_MAX];
+	uint32_t flags;
+	struct stat st;
+	int err;
+
+	memset(s, 0, sizeof(*s));
+	s->events_fd = s->index_fd = -1;
+	s->writable = writable;
+
+	if (writable) {
+		snprintf(path, sizeof(path), "%s", dir);
+		if (cache_dir_init(path))
+			return -errno;
+	}
+
+	/* the lock on the index covers both files */
+	s->index_fd = store_open_file(dir, "index", writable);
+	if (s->index_fd < 0 ||
+	    flock(s->index_fd, writable ? LOCK_EX : LOCK_SH) ||
+	    fstat(s->index_fd, &st))
+		goto err_errno;
+
+	s->events_fd = store_open_file(dir, "events", writable);
+	if (s->events_fd < 0)
+		goto err_errno;
+
+	if (!st.st_size && writable) {
+		memset(hdr, 0, sizeof(hdr));
+		memcpy(hdr, NVME_PEVENT_STORE_MAGIC, STORE_MAGIC_LEN);
+		if (pwrite(s->index_fd, hdr, sizeof(hdr), 0) != sizeof(hdr))
+			goto err_errno;
+	} else if (pread(s->index_fd, hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+		   memcmp(hdr, NVME_PEVENT_STORE_MAGIC, STORE_MAGIC_LEN)) {
+		err = -EINVAL;
+		goto err;
+	}
+	memcpy(&flags, hdr + STORE_MAGIC_LEN, sizeof(flags));
+	s->flags = le32toh(flags);
+
+	err = store_load(s);
+	if (err)
+		goto err;
+
+	return 0;
+
+err_errno:
+	err = -errno;
+err:
+	nvme_pevent_store_close(s);
+	return err;
+}
+
+void nvme_pevent_store_close(struct nvme_pevent_store *s)
+{
+	store_unmap(s);
+	if (s->events_fd >= 0)
+		close(s->events_fd);
+	if (s->index_fd >= 0)
+		close(s->index_fd);
+	s->events_fd = s->index_fd = -1;
+}
+
+/* where the entries not stored yet start in @buf */
+static int store_resume(struct nvme_pevent_store *s, const uint8_t *buf,
+			size_t len, size_t *start, bool *found)
+{
+	const struct nvme_pevent_rec *last = &s->recs[s->nr - 1];
+	uint32_t tail_len = le32toh(last->len);
+	size_t off, elen;
+	uint8_t *tail;
+
+	tail = malloc(tail_len);
+	if (!tail)
+		return -ENOMEM;
+	if (pread(s->events_fd, tail, tail_len, le64toh(last->off)) != (ssize_t)tail_len) {
+		free(tail);
+		return -EIO;
+	}
+
+	/* the last copy of it, a log may hold the same entry twice */
+	*start = 0;
+	*found = false;
+	for (off = 0; (elen = entry_len(buf, off, len)); off += elen) {
+		if (elen == tail_len && !memcmp(buf + off, tail, elen)) {
+			*start = off + elen;
+			*found = true;
+		}
+	}
+	free(tail);
+
+	return 0;
+}
+
+int nvme_pevent_store_append(struct nvme_pevent_store *s, const void *log,
+			     size_t len)
+{
+	const uint8_t *buf = log;
+	struct nvme_pevent_rec *recs = NULL;
+	uint64_t ets, prev_ts = 0, last_ts = 0, pos;
+	size_t off, elen, start = 0, n = 0, nr = 0;
+	bool found = true, unsorted = false;
+	uint32_t flags;
+	int err;
+
+	if (!s->writable)
+		return -EBADF;
+
+	if (s->nr) {
+		err = store_resume(s, buf, len, &start, &found);
+		if (err)
+			return err;
+		last_ts = prev_ts = NVME_PEVENT_TS(le64toh(s->recs[s->nr - 1].ets));
+	}
+
+	for (off = start; (elen = entry_len(buf, off, len)); off += elen)
+		n++;
+	if (!n)
+		return 0;
+
+	recs = calloc(n, sizeof(*recs));
+	if (!recs)
+		return -ENOMEM;
+
+	pos = s->events_len;
+	for (off = start; (elen = entry_len(buf, off, len)); off += elen) {
+		ets = get_le64(buf + off + 6);
+		if (!found && NVME_PEVENT_TS(ets) <= last_ts)
+			continue;
+
+		if (pwrite(s->events_fd, buf + off, elen, pos) != (ssize_t)elen) {
+			err = -EIO;
+			goto out;
+		}
+		recs[nr].ets = htole64(ets);
+		recs[nr].off = htole64(pos);
+		recs[nr].len = htole32(elen);
+		recs[nr].etype = buf[off];
+		nr++;
+
+		if (NVME_PEVENT_TS(ets) < prev_ts)
+			unsorted = true;
+		prev_ts = NVME_PEVENT_TS(ets);
+		pos += elen;
+	}
+	if (!nr) {
+		err = 0;
+		goto out;
+	}
+
+	/* the index never points past the entries written */
+	if (fdatasync(s->events_fd)) {
+		err = -errno;
+		goto out;
+	}
+	if (pwrite(s->index_fd, recs, nr * sizeof(*recs),
+		   STORE_HDR_LEN + s->nr * sizeof(*recs)) !=
+	    (ssize_t)(nr * sizeof(*recs))) {
+		err = -EIO;
+		goto out;
+	}
+
+	if (unsorted && !(s->flags & NVME_PEVENT_STORE_UNSORTED)) {
+		s->flags |= NVME_PEVENT_STORE_UNSORTED;
+		flags = htole32(s->flags);
+		if (pwrite(s->index_fd, &flags, sizeof(flags), STORE_MAGIC_LEN) !=
+		    sizeof(flags)) {
+			err = -EIO;
+			goto out;
+		}
+	}
+
+	err = fdatasync(s->index_fd) ? -errno : store_load(s);
+	if (!err)
+		err = nr;
+out:
+	free(recs);
+	return err;
+}
+
+static bool query_type(const struct nvme_pevent_query *q, uint8_t etype)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(q->types); i++)
+		if (q->types[i])
+			return q->types[etype / 8] & (1 << (etype % 8));
+
+	return true;
+}
+
+/* the first record with a timestamp of at least @ts in a sorted index */
+static size_t query_lower_bound(struct nvme_pevent_store *s, uint64_t ts)
+{
+	size_t lo = 0, hi = s->nr, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (NVME_PEVENT_TS(le64toh(s->recs[mid].ets)) < ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int nvme_pevent_store_query(struct nvme_pevent_store *s,
+			    const struct nvme_pevent_query *q,
+			    nvme_pevent_fn fn, void *data)
+{
+	bool sorted = !(s->flags & NVME_PEVENT_STORE_UNSORTED);
+	const struct nvme_pevent_rec *r;
+	size_t i = 0, matches = 0;
+	uint32_t len;
+	uint64_t ts;
+	void *buf;
+	int err = 0;
+
+	buf = malloc(ENTRY_MAX_LEN);
+	if (!buf)
+		return -ENOMEM;
+
+	if (sorted && q->since)
+		i = query_lower_bound(s, q->since);
+
+	for (; i < s->nr; i++) {
+		r = &s->recs[i];
+		ts = NVME_PEVENT_TS(le64toh(r->ets));
+		if (q->since && ts < q->since)
+			continue;
+		if (q->until && ts > q->until) {
+			if (sorted)
+				break;
+			continue;
+		}
+		if (!query_type(q, r->etype))
+			continue;
+
+		len = le32toh(r->len);
+		if (len > ENTRY_MAX_LEN ||
+		    pread(s->events_fd, buf, len, le64toh(r->off)) != (ssize_t)len) {
+			err = -EIO;
+			break;
+		}
+		err = fn(buf, len, i, data);
+		if (err < 0)
+			break;
+		err = 0;
+		matches++;
+	}
+
+	free(buf);
+	return err ? err : (int)matches;
+}
@@ -0,0 +1,100 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_PEVENT_STORE_H
+#define __UTIL_PEVENT_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only local store of persistent event log entries for
+ * persistent-event-log --store and --query. A store is a directory with
+ * two files: "events" holds the entries back to back as read from the
+ * log, "index" is NVME_PEVENT_STORE_MAGIC, a little endian flags word and
+ * a padding word, followed by one little endian struct nvme_pevent_rec per
+ * entry. Queries only look at the index and read the matching entries.
+ *
+ * The entries are appended in log order. Their timestamps normally only
+ * grow, a lookup by time is a binary search then; once an older timestamp
+ * was appended, after the controller clock was reset, the index is marked
+ * unsorted and queries scan all of it.
+ */
+#define NVME_PEVENT_STORE_MAGIC	"NVMEPES1"
+
+/* the index holds a timestamp smaller than one before it */
+#define NVME_PEVENT_STORE_UNSORTED	0x1
+
+/* milliseconds of an event timestamp, without the origin and sync bits */
+#define NVME_PEVENT_TS(ets)	((ets) & 0xffffffffffffULL)
+
+struct nvme_pevent_rec {
+	uint64_t ets;		/* event timestamp as in the entry */
+	uint64_t off;		/* of the entry in "events" */
+	uint32_t len;		/* of the entry, header included */
+	uint8_t etype;
+	uint8_t rsvd[3];
+};
+
+struct nvme_pevent_store {
+	int events_fd;
+	int index_fd;
+	bool writable;
+	uint32_t flags;
+	void *map;				/* of the index */
+	size_t map_len;
+	const struct nvme_pevent_rec *recs;	/* in the map */
+	size_t nr;
+	uint64_t events_len;
+};
+
+struct nvme_pevent_query {
+	uint64_t since;		/* ms timestamp, inclusive, 0 for none */
+	uint64_t until;		/* ms timestamp, inclusive, 0 for none */
+	uint8_t types[32];	/* bitmap of event types, all 0 for any */
+};
+
+/*
+ * Called for each match with the entry, its length and its number in the
+ * store counted from 0. A negative errno returned ends the query.
+ */
+typedef int (*nvme_pevent_fn)(const void *entry, uint32_t len, uint64_t nr,
+			      void *data);
+
+/*
+ * nvme_pevent_store_open - open the store in @dir
+ * @writable: lock it for appending, creating @dir and its files if needed
+ *
+ * Entries or index records an interrupted append left half written are
+ * dropped. Returns 0, or a negative errno; -ENOENT if a read only store
+ * doesn't exist, -EINVAL if the files aren't a store.
+ */
+int nvme_pevent_store_open(struct nvme_pevent_store *s, const char *dir,
+			   bool writable);
+
+/*
+ * nvme_pevent_store_append - add the entries in the @len bytes of @log
+ * following the log header
+ *
+ * Only the entries past the last one stored are added, the same log can
+ * be appended over and over. If the last stored entry is no longer found,
+ * as it was dropped from the log since, the entries with a newer
+ * timestamp are added. A truncated entry at the end is ignored. Returns
+ * the number of entries added or a negative errno.
+ */
+int nvme_pevent_store_append(struct nvme_pevent_store *s, const void *log,
+			     size_t len);
+
+/*
+ * nvme_pevent_store_query - call @fn for the entries matching @q in the
+ * order they were stored
+ *
+ * Returns the number of matches or a negative errno, the one of @fn if it
+ * ended the query.
+ */
+int nvme_pevent_store_query(struct nvme_pevent_store *s,
+			    const struct nvme_pevent_query *q,
+			    nvme_pevent_fn fn, void *data);
+
+void nvme_pevent_store_close(struct nvme_pevent_store *s);
+
+#endif /* __UTIL_PEVENT_STORE_H */
@@ -0,0 +1,458 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "crc32.h"
+#include "pi.h"
+
+#define CRC16_T10DIF_POLY	0x8bb7
+#define CRC64_NVME_POLY		0xad93d23594c93659ULL
+
+static uint16_t crc16_table[8][256];
+static uint64_t crc64_table[8][256];
+
+typedef uint16_t (*crc16_fn)(uint16_t crc, const unsigned char *p, size_t len);
+typedef uint64_t (*crc64_fn)(uint64_t crc, const unsigned char *p, size_t len);
+
+static crc16_fn crc16_impl;
+static crc64_fn crc64_impl;
+static pthread_once_t pi_once = PTHREAD_ONCE_INIT;
+
+static uint64_t bitrev64(uint64_t v)
+{
+	uint64_t r = 0;
+	int i;
+
+	for (i = 0; i < 64; i++, v >>= 1)
+		r = (r << 1) | (v & 1);
+
+	return r;
+}
+
+/* x^n mod P for a polynomial of degree @deg given without its x^deg term */
+static uint64_t xpow_mod(unsigned int n, uint64_t poly, unsigned int deg)
+{
+	uint64_t top = 1ULL << (deg - 1);
+	uint64_t mask = deg == 64 ? ~0ULL : (1ULL << deg) - 1;
+	uint64_t r = 1;
+
+	while (n--) {
+		bool carry = r & top;
+
+		r = (r << 1) & mask;
+		if (carry)
+			r ^= poly;
+	}
+
+	return r;
+}
+
+/* MSB first, the state is shifted towards the top 16 bits */
+static uint16_t crc16_sw_impl(uint16_t crc, const unsigned char *p, size_t len)
+{
+	uint16_t (*t)[256] = crc16_table;
+
+	for (; len >= 8; len -= 8, p += 8)
+		crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xff)] ^
+		      t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^ t[2][p[5]] ^
+		      t[1][p[6]] ^ t[0][p[7]];
+
+	while (len--)
+		crc = (crc << 8) ^ t[0][(crc >> 8) ^ *p++];
+
+	return crc;
+}
+
+/* reflected, LSB first */
+static uint64_t crc64_sw_impl(uint64_t crc, const unsigned char *p, size_t len)
+{
+	uint64_t (*t)[256] = crc64_table;
+	uint64_t v;
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		v = __builtin_bswap64(v);
+#endif
+		v ^= crc;
+		crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^
+		      t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+		      t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^
+		      t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+	}
+
+	while (len--)
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+/*
+ * Both CRCs fold the running remainder, a 128 bit polynomial, over the
+ * next 16 bytes: A * x^128 + B is congruent to hi(A) * (x^192 mod P) +
+ * lo(A) * (x^128 mod P) + B. The last remainder is run through the
+ * table code, so no Barrett reduction is needed.
+ */
+static __m128i crc16_k;		/* x^192 mod P : x^128 mod P */
+static __m128i crc64_k;		/* reflected x^191 mod P : x^127 mod P */
+
+__attribute__((target("ssse3,pclmul")))
+static uint16_t crc16_pclmul(uint16_t crc, const unsigned char *p, size_t len)
+{
+	const __m128i bswap = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+					    7, 6, 5, 4, 3, 2, 1, 0);
+	unsigned char rem[16];
+	__m128i x, y;
+
+	if (len < 32)
+		return crc16_sw_impl(crc, p, len);
+
+	/* the initial value goes into the first two message bytes */
+	x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap);
+	x = _mm_xor_si128(x, _mm_set_epi64x((uint64_t)crc << 48, 0));
+	p += 16;
+	len -= 16;
+
+	for (; len >= 16; p += 16, len -= 16) {
+		y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap);
+		y = _mm_xor_si128(y, _mm_clmulepi64_si128(x, crc16_k, 0x00));
+		x = _mm_xor_si128(y, _mm_clmulepi64_si128(x, crc16_k, 0x11));
+	}
+
+	_mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(x, bswap));
+	crc = crc16_sw_impl(0, rem, sizeof(rem));
+
+	return crc16_sw_impl(crc, p, len);
+}
+
+__attribute__((target("pclmul")))
+static uint64_t crc64_pclmul(uint64_t crc, const unsigned char *p, size_t len)
+{
+	unsigned char rem[16];
+	__m128i x, y;
+
+	if (len < 32)
+		return crc64_sw_impl(crc, p, len);
+
+	x = _mm_loadu_si128((const __m128i *)p);
+	x = _mm_xor_si128(x, _mm_set_epi64x(0, crc));
+	p += 16;
+	len -= 16;
+
+	for (; len >= 16; p += 16, len -= 16) {
+		y = _mm_loadu_si128((const __m128i *)p);
+		y = _mm_xor_si128(y, _mm_clmulepi64_si128(x, crc64_k, 0x00));
+		x = _mm_xor_si128(y, _mm_clmulepi64_si128(x, crc64_k, 0x11));
+	}
+
+	_mm_storeu_si128((__m128i *)rem, x);
+	crc = crc64_sw_impl(0, rem, sizeof(rem));
+
+	return crc64_sw_impl(crc, p, len);
+}
+
+static void pi_select(void)
+{
+	if (!__builtin_cpu_supports("pclmul") || !__builtin_cpu_supports("ssse3"))
+		return;
+
+	crc16_k = _mm_set_epi64x(xpow_mod(192, CRC16_T10DIF_POLY, 16),
+				 xpow_mod(128, CRC16_T10DIF_POLY, 16));
+	/* the low half holds the higher order coefficients when reflected */
+	crc64_k = _mm_set_epi64x(bitrev64(xpow_mod(127, CRC64_NVME_POLY, 64)),
+				 bitrev64(xpow_mod(191, CRC64_NVME_POLY, 64)));
+	crc16_impl = crc16_pclmul;
+	crc64_impl = crc64_pclmul;
+}
+#else
+static void pi_select(void)
+{
+}
+#endif
+
+static void pi_init(void)
+{
+	uint64_t rpoly = bitrev64(CRC64_NVME_POLY);
+	uint16_t c16;
+	uint64_t c64;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c16 = i << 8;
+		c64 = i;
+		for (j = 0; j < 8; j++) {
+			c16 = (c16 << 1) ^ (c16 & 0x8000 ? CRC16_T10DIF_POLY : 0);
+			c64 = (c64 >> 1) ^ (c64 & 1 ? rpoly : 0);
+		}
+		crc16_table[0][i] = c16;
+		crc64_table[0][i] = c64;
+	}
+
+	for (i = 0; i < 256; i++) {
+		c16 = crc16_table[0][i];
+		c64 = crc64_table[0][i];
+		for (j = 1; j < 8; j++) {
+			c16 = (c16 << 8) ^ crc16_table[0][c16 >> 8];
+			c64 = crc64_table[0][c64 & 0xff] ^ (c64 >> 8);
+			crc16_table[j][i] = c16;
+			crc64_table[j][i] = c64;
+		}
+	}
+
+	crc16_impl = crc16_sw_impl;
+	crc64_impl = crc64_sw_impl;
+	pi_select();
+}
+
+uint16_t crc16_t10dif(uint16_t crc, const void *buf, size_t len)
+{
+	pthread_once(&pi_once, pi_init);
+
+	return crc16_impl(crc, buf, len);
+}
+
+uint64_t crc64_nvme(uint64_t crc, const void *buf, size_t len)
+{
+	pthread_once(&pi_once, pi_init);
+
+	return ~crc64_impl(~crc, buf, len);
+}
+
+uint16_t crc16_t10dif_sw(uint16_t crc, const void *buf, size_t len)
+{
+	pthread_once(&pi_once, pi_init);
+
+	return crc16_sw_impl(crc, buf, len);
+}
+
+uint64_t crc64_nvme_sw(uint64_t crc, const void *buf, size_t len)
+{
+	pthread_once(&pi_once, pi_init);
+
+	return ~crc64_sw_impl(~crc, buf, len);
+}
+
+/* guard, application tag and storage/reference tag field sizes */
+static void pi_layout(enum nvme_pi_format pif, unsigned int *guard,
+		      unsigned int *tags)
+{
+	switch (pif) {
+	case NVME_PI_GUARD_32:
+		*guard = 4;
+		*tags = 10;
+		break;
+	case NVME_PI_GUARD_64:
+		*guard = 8;
+		*tags = 6;
+		break;
+	default:
+		*guard = 2;
+		*tags = 4;
+		break;
+	}
+}
+
+unsigned int nvme_pi_size(enum nvme_pi_format pif)
+{
+	return pif == NVME_PI_GUARD_16 ? 8 : 16;
+}
+
+static uint64_t low_mask(unsigned int bits)
+{
+	return bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+}
+
+uint64_t nvme_pi_ref_mask(const struct nvme_pi *pi)
+{
+	unsigned int guard, tags;
+
+	pi_layout(pi->pif, &guard, &tags);
+
+	return low_mask(tags * 8 - pi->sts);
+}
+
+int nvme_pi_check(const struct nvme_pi *pi)
+{
+	unsigned int guard, tags;
+
+	if (pi->pif > NVME_PI_GUARD_64 || pi->type < 1 || pi->type > 3)
+		return -EINVAL;
+
+	pi_layout(pi->pif, &guard, &tags);
+	if (pi->ms < nvme_pi_size(pi->pif) || pi->sts > 64 || pi->sts > tags * 8)
+		return -EINVAL;
+
+	return 0;
+}
+
+static void put_be(unsigned char *p, unsigned int bytes, uint64_t v)
+{
+	while (bytes--) {
+		p[bytes] = v;
+		v >>= 8;
+	}
+}
+
+static uint64_t get_be(const unsigned char *p, unsigned int bytes)
+{
+	uint64_t v = 0;
+
+	while (bytes--)
+		v = (v << 8) | *p++;
+
+	return v;
+}
+
+/*
+ * The storage tag occupies the upper @sts bits of the combined field and
+ * the reference tag the rest, which may be wider than 64 bits.
+ */
+static void put_tags(unsigned char *p, unsigned int bytes, unsigned int shift,
+		     uint64_t st, uint64_t ref)
+{
+	unsigned int i, bit;
+	unsigned char b;
+
+	for (i = 0; i < bytes; i++) {
+		bit = (bytes - 1 - i) * 8;
+		b = bit < 64 ? ref >> bit : 0;
+		if (bit + 8 > shift && bit < shift + 64)
+			b |= bit >= shift ? st >> (bit - shift) : st << (shift - bit);
+		p[i] = b;
+	}
+}
+
+static void get_tags(const unsigned char *p, unsigned int bytes,
+		     unsigned int shift, uint64_t *st, uint64_t *ref)
+{
+	unsigned int i, bit;
+
+	*st = *ref = 0;
+	for (i = 0; i < bytes; i++) {
+		bit = (bytes - 1 - i) * 8;
+		if (bit < 64)
+			*ref |= (uint64_t)p[i] << bit;
+		if (bit + 8 > shift && bit < shift + 64)
+			*st |= bit >= shift ? (uint64_t)p[i] << (bit - shift) :
+					      (uint64_t)p[i] >> (shift - bit);
+	}
+	*ref &= low_mask(shift);
+}
+
+struct pi_block {
+	unsigned char *data;
+	unsigned char *meta;
+	unsigned char *pi;
+};
+
+static void pi_block(const struct nvme_pi *pi, void *data, void *meta,
+		     uint64_t i, struct pi_block *b)
+{
+	unsigned int pi_off = pi->pi_first ? 0 : pi->ms - nvme_pi_size(pi->pif);
+
+	if (pi->extended) {
+		b->data = (unsigned char *)data + i * (pi->lba_size + pi->ms);
+		b->meta = b->data + pi->lba_size;
+	} else {
+		b->data = (unsigned char *)data + i * pi->lba_size;
+		b->meta = (unsigned char *)meta + i * pi->ms;
+	}
+	b->pi = b->meta + pi_off;
+}
+
+/* the guard covers the data and the metadata bytes ahead of the PI */
+static uint64_t pi_guard(const struct nvme_pi *pi, const struct pi_block *b)
+{
+	size_t mlen = b->pi - b->meta;
+
+	switch (pi->pif) {
+	case NVME_PI_GUARD_32:
+		return crc32c(crc32c(0, b->data, pi->lba_size), b->meta, mlen);
+	case NVME_PI_GUARD_64:
+		return crc64_nvme(crc64_nvme(0, b->data, pi->lba_size), b->meta, mlen);
+	default:
+		return crc16_t10dif(crc16_t10dif(0, b->data, pi->lba_size), b->meta, mlen);
+	}
+}
+
+void nvme_pi_generate(const struct nvme_pi *pi, void *data, void *meta,
+		      uint64_t first, uint64_t nr)
+{
+	unsigned int guard, tags, shift;
+	struct pi_block b;
+	uint64_t i, ref;
+
+	pi_layout(pi->pif, &guard, &tags);
+	shift = tags * 8 - pi->sts;
+
+	for (i = 0; i < nr; i++) {
+		pi_block(pi, data, meta, i, &b);
+		ref = (pi->reftag + first + i) & low_mask(shift);
+		put_be(b.pi, guard, pi_guard(pi, &b));
+		put_be(b.pi + guard, 2, pi->apptag);
+		put_tags(b.pi + guard + 2, tags, shift, pi->storage_tag, ref);
+	}
+}
+
+static int pi_mismatch(struct nvme_pi_err *err, uint64_t block,
+		       const char *field, uint64_t expected, uint64_t actual)
+{
+	if (err) {
+		err->block = block;
+		err->field = field;
+		err->expected = expected;
+		err->actual = actual;
+	}
+
+	return -EILSEQ;
+}
+
+int nvme_pi_verify(const struct nvme_pi *pi, const void *data, const void *meta,
+		   uint64_t first, uint64_t nr, struct nvme_pi_err *err)
+{
+	unsigned int guard, tags, shift;
+	uint64_t i, v, ref, st;
+	struct pi_block b;
+	uint16_t app;
+
+	pi_layout(pi->pif, &guard, &tags);
+	shift = tags * 8 - pi->sts;
+
+	for (i = 0; i < nr; i++) {
+		pi_block(pi, (void *)data, (void *)meta, i, &b);
+		app = get_be(b.pi + guard, 2);
+		get_tags(b.pi + guard + 2, tags, shift, &st, &ref);
+
+		/* escape values disable checking of the block */
+		if (app == 0xffff &&
+		    (pi->type != 3 || ref == low_mask(shift)))
+			continue;
+
+		if (pi->check_guard) {
+			v = pi_guard(pi, &b);
+			if (get_be(b.pi, guard) != v)
+				return pi_mismatch(err, i, "guard", v,
+						   get_be(b.pi, guard));
+		}
+
+		if ((app & pi->appmask) != (pi->apptag & pi->appmask))
+			return pi_mismatch(err, i, "application tag",
+					   pi->apptag & pi->appmask, app & pi->appmask);
+
+		v = (pi->reftag + first + i) & low_mask(shift);
+		if (pi->check_reftag && pi->type != 3 && ref != v)
+			return pi_mismatch(err, i, "reference tag", v, ref);
+
+		v = pi->storage_tag & low_mask(pi->sts);
+		if (pi->check_storage_tag && st != v)
+			return pi_mismatch(err, i, "storage tag", v, st);
+	}
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_PI_H
+#define __UTIL_PI_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Host side end-to-end protection information, NVM Command Set 5.2.1.
+ *
+ * The guard is a CRC-16 T10-DIF for the 16b guard format, a CRC-32C for
+ * the 32b guard format and the CRC-64 NVMe polynomial for the 64b guard
+ * format. On x86-64 CPUs with PCLMULQDQ the 16 and 64 bit CRCs fold 16
+ * bytes per step with carry-less multiplication, otherwise slice-by-8
+ * tables are used.
+ */
+
+/* Protection Information Format, the PIF field of the extended LBA format */
+enum nvme_pi_format {
+	NVME_PI_GUARD_16	= 0,
+	NVME_PI_GUARD_32	= 1,
+	NVME_PI_GUARD_64	= 2,
+};
+
+/*
+ * crc16_t10dif - CRC-16 T10-DIF (0x8bb7), no inversion, @crc is 0 to start
+ * crc64_nvme - CRC-64 NVMe (0xad93d23594c93659), @crc is 0 to start
+ */
+uint16_t crc16_t10dif(uint16_t crc, const void *buf, size_t len);
+uint64_t crc64_nvme(uint64_t crc, const void *buf, size_t len);
+
+/* the table versions, for testing */
+uint16_t crc16_t10dif_sw(uint16_t crc, const void *buf, size_t len);
+uint64_t crc64_nvme_sw(uint64_t crc, const void *buf, size_t len);
+
+struct nvme_pi {
+	enum nvme_pi_format pif;
+	unsigned int type;	/* 1, 2 or 3 */
+	unsigned int sts;	/* storage tag size in bits */
+	bool pi_first;		/* PI in the first bytes of the metadata */
+	bool extended;		/* metadata interleaved with the data */
+	unsigned int lba_size;	/* data bytes per logical block */
+	unsigned int ms;	/* metadata bytes per logical block */
+
+	uint16_t apptag;
+	uint16_t appmask;	/* application tag bits to check */
+	uint64_t reftag;	/* reference tag of block 0 */
+	uint64_t storage_tag;
+
+	bool check_guard;
+	bool check_reftag;
+	bool check_storage_tag;
+};
+
+struct nvme_pi_err {
+	uint64_t block;		/* block index relative to the buffer start */
+	const char *field;	/* "guard", "application tag", ... */
+	uint64_t expected;
+	uint64_t actual;
+};
+
+/* nvme_pi_size - bytes of protection information per block */
+unsigned int nvme_pi_size(enum nvme_pi_format pif);
+
+/* nvme_pi_ref_mask - reference tag bits left next to the storage tag */
+uint64_t nvme_pi_ref_mask(const struct nvme_pi *pi);
+
+/*
+ * nvme_pi_check - validate the format description
+ *
+ * Returns 0 or -EINVAL if the metadata can't hold the protection
+ * information or a field is out of range.
+ */
+int nvme_pi_check(const struct nvme_pi *pi);
+
+/*
+ * nvme_pi_generate - fill in the protection information of @nr blocks
+ * @data:	logical block data, including the metadata if @pi->extended
+ * @meta:	separate metadata buffer, ignored if @pi->extended
+ * @first:	index of the first block, added to the reference tag
+ */
+void nvme_pi_generate(const struct nvme_pi *pi, void *data, void *meta,
+		      uint64_t first, uint64_t nr);
+
+/*
+ * nvme_pi_verify - check the protection information of @nr blocks
+ *
+ * Blocks with the application tag (and for type 3 also the reference
+ * tag) set to all ones are not checked.
+ *
+ * Returns 0 or -EILSEQ with @err describing the first mismatch.
+ */
+int nvme_pi_verify(const struct nvme_pi *pi, const void *data, const void *meta,
+		   uint64_t first, uint64_t nr, struct nvme_pi_err *err);
+
+#endif /* __UTIL_PI_H */
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "pmr.h"
+
+void nvme_pmr_load(void *dst, const volatile void *src, size_t len)
+{
+	const volatile uint64_t *s = src;
+	unsigned char *d = dst;
+	uint64_t v;
+
+	for (; len >= 8; len -= 8, d += 8) {
+		v = *s++;
+		memcpy(d, &v, sizeof(v));
+	}
+}
+
+void nvme_pmr_store(volatile void *dst, const void *src, size_t len)
+{
+	const unsigned char *s = src;
+	volatile uint64_t *d = dst;
+	uint64_t v;
+
+	for (; len >= 8; len -= 8, s += 8) {
+		memcpy(&v, s, sizeof(v));
+		*d++ = v;
+	}
+}
+
+bool nvme_pmr_store_nt(volatile void *dst, const void *src, size_t len)
+{
+#if defined(__x86_64__)
+	const unsigned char *s = src;
+	unsigned char *d = (unsigned char *)dst;
+	uint64_t v;
+
+	for (; len >= 8 && ((uintptr_t)d & 15); len -= 8, s += 8, d += 8) {
+		memcpy(&v, s, sizeof(v));
+		_mm_stream_si64((long long *)d, v);
+	}
+	for (; len >= 16; len -= 16, s += 16, d += 16)
+		_mm_stream_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+	if (len >= 8) {
+		memcpy(&v, s, sizeof(v));
+		_mm_stream_si64((long long *)d, v);
+	}
+	return true;
+#elif defined(__aarch64__)
+	const unsigned char *s = src;
+	unsigned char *d = (unsigned char *)dst;
+	uint64_t v[2];
+
+	for (; len >= 16; len -= 16, s += 16, d += 16) {
+		memcpy(v, s, sizeof(v));
+		__asm__ volatile("stnp %x0, %x1, [%2]"
+				 : : "r" (v[0]), "r" (v[1]), "r" (d) : "memory");
+	}
+	if (len >= 8)
+		nvme_pmr_store(d, s, 8);
+	return true;
+#else
+	nvme_pmr_store(dst, src, len);
+	return false;
+#endif
+}
+
+void nvme_pmr_fence(void)
+{
+#if defined(__x86_64__)
+	_mm_sfence();
+#elif defined(__aarch64__)
+	__asm__ volatile("dsb st" : : : "memory");
+#else
+	__sync_synchronize();
+#endif
+}
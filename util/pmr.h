@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_PMR_H
+#define __UTIL_PMR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Copies between host memory and a mapping of device memory, such as the
+ * Persistent Memory Region of a controller mapped through its PCI BAR.
+ * The device side is accessed in aligned 8 byte loads and stores through
+ * volatile pointers, which uncached and write combining mappings both
+ * accept, so the device address and @len must be multiples of 8. The
+ * host buffer needs no alignment.
+ */
+void nvme_pmr_load(void *dst, const volatile void *src, size_t len);
+void nvme_pmr_store(volatile void *dst, const void *src, size_t len);
+
+/*
+ * nvme_pmr_store_nt - store with non-temporal hints, which bypass the CPU
+ * cache and fill whole write combining buffers, where the CPU has them
+ * (SSE2 on x86-64, STNP on arm64). Returns false if it fell back to
+ * nvme_pmr_store().
+ */
+bool nvme_pmr_store_nt(volatile void *dst, const void *src, size_t len);
+
+/*
+ * nvme_pmr_fence - order all stores before it ahead of the ones after it,
+ * flushing the write combining buffers. The device may still hold the
+ * data, a read-back the controller advertises as a write barrier (PMRWBM)
+ * makes it persistent.
+ */
+void nvme_pmr_fence(void);
+
+#endif /* __UTIL_PMR_H */
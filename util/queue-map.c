@@ -0,0 +1,161 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "queue-map.h"
+#include "sysfs.h"
+
+int nvme_queue_map_read(const char *dir, struct nvme_queue_map *m)
+{
+	char path[PATH_MAX], buf[4096];
+	cpu_set_t *cpus;
+	unsigned int n;
+
+	memset(m, 0, sizeof(*m));
+
+	/* the hardware contexts are numbered from 0 */
+	for (n = 0; ; n++) {
+		snprintf(path, sizeof(path), "%s/mq/%u", dir, n);
+		if (sysfs_read_attr(path, "cpu_list", buf, sizeof(buf)))
+			break;
+
+		cpus = realloc(m->cpus, (n + 1) * sizeof(*cpus));
+		if (!cpus) {
+			nvme_queue_map_free(m);
+			return -ENOMEM;
+		}
+		m->cpus = cpus;
+
+		/* queues without CPUs, after a CPU went offline, stay empty */
+		if (sysfs_parse_cpulist(buf, &m->cpus[n]))
+			CPU_ZERO(&m->cpus[n]);
+	}
+
+	m->nr_queues = n;
+	return n ? 0 : -ENODEV;
+}
+
+/* the generic device ng<ctrl>n<head> goes with the block device of the path */
+static int queue_map_read_generic(const char *name, struct nvme_queue_map *m)
+{
+	unsigned int ctrl, head, n;
+	char dir[64], path[PATH_MAX];
+	struct dirent *d;
+	int len, err = -ENODEV;
+	DIR *ctrl_dir;
+
+	if (sscanf(name, "ng%un%u%n", &ctrl, &head, &len) != 2 || name[len])
+		return -ENODEV;
+
+	snprintf(dir, sizeof(dir), "/sys/class/nvme/nvme%u", ctrl);
+	ctrl_dir = opendir(dir);
+	if (!ctrl_dir)
+		return -errno;
+
+	/* nvme<ctrl>n<head>, or nvme<subsys>c<ctrl>n<head> with multipath */
+	while (err && (d = readdir(ctrl_dir))) {
+		if ((sscanf(d->d_name, "nvme%*uc%*un%u%n", &n, &len) != 1 &&
+		     sscanf(d->d_name, "nvme%*un%u%n", &n, &len) != 1) ||
+		    d->d_name[len] || n != head)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+		err = nvme_queue_map_read(path, m);
+	}
+	closedir(ctrl_dir);
+
+	return err;
+}
+
+int nvme_queue_map_read_fd(int fd, struct nvme_queue_map *m)
+{
+	char path[PATH_MAX], target[PATH_MAX], *name;
+	struct stat st;
+	ssize_t len;
+
+	memset(m, 0, sizeof(*m));
+
+	if (fstat(fd, &st))
+		return -errno;
+
+	if (S_ISBLK(st.st_mode)) {
+		snprintf(path, sizeof(path), "/sys/dev/block/%u:%u",
+			 major(st.st_rdev), minor(st.st_rdev));
+		return nvme_queue_map_read(path, m);
+	}
+	if (!S_ISCHR(st.st_mode))
+		return -ENODEV;
+
+	snprintf(path, sizeof(path), "/sys/dev/char/%u:%u",
+		 major(st.st_rdev), minor(st.st_rdev));
+	len = readlink(path, target, sizeof(target) - 1);
+	if (len < 0)
+		return -errno;
+	target[len] = '\0';
+
+	name = strrchr(target, '/');
+	return queue_map_read_generic(name ? name + 1 : target, m);
+}
+
+/* the @k-th CPU of @set, counting modulo its size */
+static int nth_cpu(const cpu_set_t *set, unsigned int k)
+{
+	int cpu;
+
+	k %= CPU_COUNT(set);
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		if (CPU_ISSET(cpu, set) && !k--)
+			return cpu;
+
+	return -1;
+}
+
+int nvme_queue_map_place(const struct nvme_queue_map *m, const cpu_set_t *allowed,
+			 unsigned int nr, int *cpus)
+{
+	cpu_set_t *usable, seen, rest;
+	unsigned int i, nq = 0;
+
+	usable = calloc(m->nr_queues ? m->nr_queues : 1, sizeof(*usable));
+	if (!usable)
+		return -ENOMEM;
+
+	/*
+	 * The read and poll queues of the other queue types come after the
+	 * default ones and map the same CPUs again, those are skipped.
+	 */
+	CPU_ZERO(&seen);
+	for (i = 0; i < m->nr_queues; i++) {
+		CPU_AND(&usable[nq], &m->cpus[i], allowed);
+		CPU_XOR(&rest, &usable[nq], &seen);
+		CPU_AND(&rest, &rest, &usable[nq]);
+		if (!CPU_COUNT(&rest))
+			continue;
+		CPU_OR(&seen, &seen, &usable[nq]);
+		nq++;
+	}
+
+	if (!nq) {
+		free(usable);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < nr; i++)
+		cpus[i] = nth_cpu(&usable[i % nq], i / nq);
+
+	free(usable);
+	return nr < nq ? nr : nq;
+}
+
+void nvme_queue_map_free(struct nvme_queue_map *m)
+{
+	free(m->cpus);
+	memset(m, 0, sizeof(*m));
+}
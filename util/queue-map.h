@@ -0,0 +1,49 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_QUEUE_MAP_H
+#define __UTIL_QUEUE_MAP_H
+
+#include <sched.h>
+
+/*
+ * The blk-mq mapping of CPUs to the hardware queues of a namespace. The
+ * nvme driver submits a command on the queue of the CPU issuing it,
+ * passthrough and io_uring commands included, so threads pinned to CPUs
+ * of different queues don't contend for a submission queue lock.
+ */
+struct nvme_queue_map {
+	unsigned int nr_queues;
+	cpu_set_t *cpus;	/* the CPUs mapped to each queue */
+};
+
+/*
+ * nvme_queue_map_read - read the mq/<n>/cpu_list attributes under @dir,
+ * the sysfs directory of a block device
+ *
+ * Returns 0 or a negative errno.
+ */
+int nvme_queue_map_read(const char *dir, struct nvme_queue_map *m);
+
+/*
+ * nvme_queue_map_read_fd - the queue map of the namespace @fd is open on,
+ * a block device or the generic char device of a namespace
+ *
+ * For a generic device the queues are those of the controller path the
+ * device belongs to. Returns 0 or a negative errno, -ENODEV for devices
+ * without blk-mq queues such as the controller char devices.
+ */
+int nvme_queue_map_read_fd(int fd, struct nvme_queue_map *m);
+
+/*
+ * nvme_queue_map_place - pick a CPU out of @allowed for each of @nr threads
+ *
+ * The threads go to distinct queues first, round robin over the queues
+ * having an allowed CPU, and threads sharing a queue to distinct CPUs of
+ * it where there are enough. Returns the number of queues used, or
+ * -EINVAL if no queue has an allowed CPU.
+ */
+int nvme_queue_map_place(const struct nvme_queue_map *m, const cpu_set_t *allowed,
+			 unsigned int nr, int *cpus);
+
+void nvme_queue_map_free(struct nvme_queue_map *m);
+
+#endif /* __UTIL_QUEUE_MAP_H */
@@ -0,0 +1,141 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <time.h>
+
+#include "common.h"
+#include "ratelimit.h"
+
+static double burst(uint64_t rate)
+{
+	double b = (double)rate * NVME_RATELIMIT_BURST_MS / 1000;
+
+	return b < 1 ? 1 : b;
+}
+
+void nvme_ratelimit_init(struct nvme_ratelimit *rl, uint64_t iops, uint64_t bps,
+			 uint64_t target_ns, uint64_t now_ns)
+{
+	pthread_mutex_init(&rl->lock, NULL);
+	rl->iops = iops;
+	rl->bps = bps;
+	rl->target_ns = target_ns;
+	rl->io_tokens = iops ? burst(iops) : 0;
+	rl->byte_tokens = bps ? burst(bps) : 0;
+	rl->fill_ns = now_ns;
+	rl->scale = 1;
+	rl->adapt_ns = now_ns;
+	rl->slow = false;
+	rl->backoffs = 0;
+}
+
+void nvme_ratelimit_destroy(struct nvme_ratelimit *rl)
+{
+	pthread_mutex_destroy(&rl->lock);
+}
+
+static void fill(double *tokens, uint64_t rate, double scale, uint64_t ns)
+{
+	double max = burst(rate);
+
+	*tokens += (double)rate * scale * ns / NSEC_PER_SEC;
+	if (*tokens > max)
+		*tokens = max;
+}
+
+/* until @tokens are positive again */
+static uint64_t deficit_ns(double tokens, uint64_t rate, double scale)
+{
+	if (tokens > 0)
+		return 0;
+
+	return (uint64_t)(-tokens * NSEC_PER_SEC / (rate * scale)) + 1;
+}
+
+uint64_t nvme_ratelimit_take(struct nvme_ratelimit *rl, uint64_t bytes,
+			     uint64_t now_ns)
+{
+	uint64_t wait = 0, w;
+
+	pthread_mutex_lock(&rl->lock);
+	if (now_ns > rl->fill_ns) {
+		if (rl->iops)
+			fill(&rl->io_tokens, rl->iops, rl->scale, now_ns - rl->fill_ns);
+		if (rl->bps)
+			fill(&rl->byte_tokens, rl->bps, rl->scale, now_ns - rl->fill_ns);
+		rl->fill_ns = now_ns;
+	}
+
+	if (rl->iops)
+		wait = deficit_ns(rl->io_tokens, rl->iops, rl->scale);
+	if (rl->bps) {
+		w = deficit_ns(rl->byte_tokens, rl->bps, rl->scale);
+		if (w > wait)
+			wait = w;
+	}
+
+	if (!wait) {
+		if (rl->iops)
+			rl->io_tokens -= 1;
+		if (rl->bps)
+			rl->byte_tokens -= bytes;
+	}
+	pthread_mutex_unlock(&rl->lock);
+
+	return wait;
+}
+
+bool nvme_ratelimit_wait(struct nvme_ratelimit *rl, uint64_t bytes,
+			 const volatile sig_atomic_t *stop)
+{
+	struct timespec ts;
+	uint64_t wait;
+
+	while ((wait = nvme_ratelimit_take(rl, bytes, monotonic_ns()))) {
+		if (stop && *stop)
+			return false;
+		ts.tv_sec = wait / NSEC_PER_SEC;
+		ts.tv_nsec = wait % NSEC_PER_SEC;
+		nanosleep(&ts, NULL);
+	}
+
+	return !stop || !*stop;
+}
+
+void nvme_ratelimit_complete(struct nvme_ratelimit *rl, uint64_t lat_ns,
+			     uint64_t now_ns)
+{
+	const double min = 1.0 / NVME_RATELIMIT_MIN_DIV;
+
+	if (!rl->target_ns)
+		return;
+
+	pthread_mutex_lock(&rl->lock);
+	if (lat_ns > rl->target_ns)
+		rl->slow = true;
+
+	if (now_ns - rl->adapt_ns >= NVME_RATELIMIT_ADAPT_MS * NSEC_PER_MSEC) {
+		if (rl->slow) {
+			rl->scale /= 2;
+			rl->backoffs++;
+		} else {
+			rl->scale += min;
+		}
+		if (rl->scale < min)
+			rl->scale = min;
+		if (rl->scale > 1)
+			rl->scale = 1;
+		rl->slow = false;
+		rl->adapt_ns = now_ns;
+	}
+	pthread_mutex_unlock(&rl->lock);
+}
+
+double nvme_ratelimit_scale(struct nvme_ratelimit *rl)
+{
+	double scale;
+
+	pthread_mutex_lock(&rl->lock);
+	scale = rl->scale;
+	pthread_mutex_unlock(&rl->lock);
+
+	return scale;
+}
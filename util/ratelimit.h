@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_RATELIMIT_H
+#define __UTIL_RATELIMIT_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Token bucket rate limiter for the maintenance I/O of bulk modes, shared
+ * by all threads of a job. One bucket holds commands and one bytes, filled
+ * at their rates up to NVME_RATELIMIT_BURST_MS worth. A command may start
+ * while both buckets are positive and takes its cost out of them, so that
+ * commands larger than the burst go ahead and just pay it off later.
+ *
+ * With a latency target the limiter adapts: a completion slower than the
+ * target halves the rates, at most once per NVME_RATELIMIT_ADAPT_MS, and
+ * every such interval without one gives back 1/NVME_RATELIMIT_MIN_DIV of
+ * the configured rates, never going below 1/NVME_RATELIMIT_MIN_DIV of them.
+ */
+#define NVME_RATELIMIT_BURST_MS		10
+#define NVME_RATELIMIT_ADAPT_MS		100
+#define NVME_RATELIMIT_MIN_DIV		64
+
+struct nvme_ratelimit {
+	pthread_mutex_t lock;
+	uint64_t iops;		/* commands per second, 0 is unlimited */
+	uint64_t bps;		/* bytes per second, 0 is unlimited */
+	uint64_t target_ns;	/* latency target, 0 doesn't adapt */
+
+	double io_tokens;
+	double byte_tokens;
+	uint64_t fill_ns;	/* the buckets were last filled */
+	double scale;		/* of the rates, adapted to the latency */
+	uint64_t adapt_ns;	/* the scale last changed */
+	bool slow;		/* a completion exceeded the target since */
+	uint64_t backoffs;
+};
+
+void nvme_ratelimit_init(struct nvme_ratelimit *rl, uint64_t iops, uint64_t bps,
+			 uint64_t target_ns, uint64_t now_ns);
+void nvme_ratelimit_destroy(struct nvme_ratelimit *rl);
+
+static inline bool nvme_ratelimit_enabled(const struct nvme_ratelimit *rl)
+{
+	return rl->iops || rl->bps;
+}
+
+/*
+ * nvme_ratelimit_take - admit a command moving @bytes at @now_ns
+ *
+ * Returns 0 if it may start, its cost is taken then, or the nanoseconds to
+ * wait before asking again.
+ */
+uint64_t nvme_ratelimit_take(struct nvme_ratelimit *rl, uint64_t bytes,
+			     uint64_t now_ns);
+
+/*
+ * nvme_ratelimit_wait - sleep until a command moving @bytes may start
+ *
+ * Returns false without admitting it if @stop, when given, got set.
+ */
+bool nvme_ratelimit_wait(struct nvme_ratelimit *rl, uint64_t bytes,
+			 const volatile sig_atomic_t *stop);
+
+/* nvme_ratelimit_complete - feed a command's latency to the adaptive mode */
+void nvme_ratelimit_complete(struct nvme_ratelimit *rl, uint64_t lat_ns,
+			     uint64_t now_ns);
+
+/* the fraction of the configured rates currently allowed */
+double nvme_ratelimit_scale(struct nvme_ratelimit *rl);
+
+#endif /* __UTIL_RATELIMIT_H */
@@ -0,0 +1,326 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <ctype.h>
+#include <endian.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+#define REPLAY_MAGIC_LEN	(sizeof(NVME_REPLAY_MAGIC) - 1)
+
+struct replay_field {
+	const char *key;
+	size_t offset;
+	size_t size;
+};
+
+#define REPLAY_FIELD(f)							\
+	{ #f, offsetof(struct nvme_replay_cmd, f),			\
+	  sizeof(((struct nvme_replay_cmd *)NULL)->f) }
+
+static const struct replay_field replay_fields[] = {
+	REPLAY_FIELD(opcode),
+	REPLAY_FIELD(flags),
+	REPLAY_FIELD(admin),
+	REPLAY_FIELD(nsid),
+	REPLAY_FIELD(cdw2),
+	REPLAY_FIELD(cdw3),
+	REPLAY_FIELD(cdw10),
+	REPLAY_FIELD(cdw11),
+	REPLAY_FIELD(cdw12),
+	REPLAY_FIELD(cdw13),
+	REPLAY_FIELD(cdw14),
+	REPLAY_FIELD(cdw15),
+	REPLAY_FIELD(data_len),
+	REPLAY_FIELD(timeout_ms),
+	REPLAY_FIELD(think_us),
+};
+
+#define REPLAY_NR_FIELDS	(sizeof(replay_fields) / sizeof(replay_fields[0]))
+
+static const struct replay_field *replay_field(const char *key, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < REPLAY_NR_FIELDS; i++)
+		if (strlen(replay_fields[i].key) == len &&
+		    !memcmp(replay_fields[i].key, key, len))
+			return &replay_fields[i];
+
+	return NULL;
+}
+
+static int replay_set(struct nvme_replay_cmd *c, const struct replay_field *f,
+		      uint64_t v)
+{
+	char *p = (char *)c + f->offset;
+
+	if (v >> (f->size * 8))
+		return -EINVAL;
+
+	if (f->size == sizeof(uint8_t))
+		*(uint8_t *)p = v;
+	else
+		*(uint32_t *)p = v;
+
+	return 0;
+}
+
+static const char *skip_ws(const char *p)
+{
+	while (isspace((unsigned char)*p))
+		p++;
+	return p;
+}
+
+/* strings without escapes, which is all the keys and numbers need */
+static const char *replay_string(const char *p, const char **s, size_t *len)
+{
+	const char *end;
+
+	if (*p != '"')
+		return NULL;
+
+	for (end = p + 1; *end != '"'; end++)
+		if (!*end || *end == '\\')
+			return NULL;
+
+	*s = p + 1;
+	*len = end - p - 1;
+
+	return end + 1;
+}
+
+/* skip a nested object or array of a key that isn't ours */
+static const char *replay_skip_nested(const char *p)
+{
+	int depth = 0;
+
+	do {
+		if (*p == '"') {
+			for (p++; *p != '"'; p++) {
+				if (!*p)
+					return NULL;
+				if (*p == '\\' && !*++p)
+					return NULL;
+			}
+		} else if (*p == '{' || *p == '[') {
+			depth++;
+		} else if (*p == '}' || *p == ']') {
+			depth--;
+		} else if (!*p) {
+			return NULL;
+		}
+		p++;
+	} while (depth);
+
+	return p;
+}
+
+/*
+ * Parse the value at @p. @v is set and @num is true for an unsigned
+ * integer, a boolean or a string holding an integer, anything else is
+ * only skipped. Returns the end of the value or NULL.
+ */
+static const char *replay_value(const char *p, uint64_t *v, bool *num)
+{
+	const char *s;
+	char buf[24];
+	size_t len;
+	char *e;
+
+	*num = false;
+
+	if (*p == '{' || *p == '[')
+		return replay_skip_nested(p);
+
+	if (*p == '"') {
+		p = replay_string(p, &s, &len);
+		if (p && len && len < sizeof(buf) && isdigit((unsigned char)*s)) {
+			memcpy(buf, s, len);
+			buf[len] = '\0';
+			errno = 0;
+			*v = strtoull(buf, &e, 0);
+			*num = !errno && !*e;
+		}
+		return p;
+	}
+
+	if (!strncmp(p, "true", 4) || !strncmp(p, "false", 5)) {
+		*v = *p == 't';
+		*num = true;
+		return p + (*v ? 4 : 5);
+	}
+	if (!strncmp(p, "null", 4))
+		return p + 4;
+
+	if (isdigit((unsigned char)*p)) {
+		errno = 0;
+		*v = strtoull(p, &e, 10);
+		if (*e != '.' && *e != 'e' && *e != 'E') {
+			*num = !errno;
+			return e;
+		}
+	} else if (*p != '-') {
+		return NULL;
+	}
+
+	/* negative and fractional numbers */
+	strtod(p, &e);
+	return e != p ? e : NULL;
+}
+
+static int replay_parse_line(const char *p, struct nvme_replay_cmd *c)
+{
+	const struct replay_field *f;
+	const char *key;
+	size_t len;
+	uint64_t v;
+	bool num;
+
+	memset(c, 0, sizeof(*c));
+
+	p = skip_ws(p);
+	if (*p++ != '{')
+		return -EINVAL;
+
+	p = skip_ws(p);
+	while (*p != '}') {
+		p = replay_string(p, &key, &len);
+		if (!p)
+			return -EINVAL;
+		p = skip_ws(p);
+		if (*p++ != ':')
+			return -EINVAL;
+		p = replay_value(skip_ws(p), &v, &num);
+		if (!p)
+			return -EINVAL;
+
+		f = replay_field(key, len);
+		if (f && (!num || replay_set(c, f, v)))
+			return -EINVAL;
+
+		p = skip_ws(p);
+		if (*p == ',')
+			p = skip_ws(p + 1);
+		else if (*p != '}')
+			return -EINVAL;
+	}
+
+	return *skip_ws(p + 1) ? -EINVAL : 0;
+}
+
+static int replay_load_json(char *buf, struct nvme_replay_cmd **cmds, size_t *nr,
+			    unsigned int *line)
+{
+	struct nvme_replay_cmd *c = NULL, *tmp;
+	size_t n = 0, alloc = 0;
+	char *p, *eol;
+	int err;
+
+	for (p = buf, *line = 1; *p; p = eol, (*line)++) {
+		eol = strchr(p, '\n');
+		if (eol)
+			*eol++ = '\0';
+		else
+			eol = p + strlen(p);
+
+		if (!*skip_ws(p))
+			continue;
+
+		if (n == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			tmp = realloc(c, alloc * sizeof(*c));
+			if (!tmp) {
+				free(c);
+				return -ENOMEM;
+			}
+			c = tmp;
+		}
+
+		err = replay_parse_line(p, &c[n]);
+		if (err) {
+			free(c);
+			return err;
+		}
+		n++;
+	}
+
+	*cmds = c;
+	*nr = n;
+
+	return 0;
+}
+
+static int replay_load_bin(const char *buf, size_t len, struct nvme_replay_cmd **cmds,
+			   size_t *nr, unsigned int *line)
+{
+	struct nvme_replay_cmd *c;
+	size_t n, i, j;
+	uint32_t *v;
+
+	n = len / sizeof(*c);
+	if (len % sizeof(*c)) {
+		*line = n + 1;
+		return -EINVAL;
+	}
+
+	c = malloc(n ? n * sizeof(*c) : 1);
+	if (!c)
+		return -ENOMEM;
+
+	/* all fields but the first four bytes are 32 bit words */
+	memcpy(c, buf, n * sizeof(*c));
+	for (i = 0; i < n; i++) {
+		v = (uint32_t *)&c[i];
+		for (j = 1; j < sizeof(*c) / sizeof(*v); j++)
+			v[j] = le32toh(v[j]);
+	}
+
+	*cmds = c;
+	*nr = n;
+
+	return 0;
+}
+
+int nvme_replay_load(FILE *f, struct nvme_replay_cmd **cmds, size_t *nr,
+		     unsigned int *line)
+{
+	size_t len = 0, size = 0;
+	char *buf = NULL, *tmp;
+	int err;
+
+	*line = 0;
+
+	/* traces may come from a pipe, read it all before looking at it */
+	do {
+		if (size - len < 2) {
+			size = size ? size * 2 : 64 * 1024;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				free(buf);
+				return -ENOMEM;
+			}
+			buf = tmp;
+		}
+		len += fread(buf + len, 1, size - len - 1, f);
+	} while (!feof(f) && !ferror(f));
+
+	if (ferror(f)) {
+		free(buf);
+		return -EIO;
+	}
+	buf[len] = '\0';
+
+	if (len >= REPLAY_MAGIC_LEN && !memcmp(buf, NVME_REPLAY_MAGIC, REPLAY_MAGIC_LEN))
+		err = replay_load_bin(buf + REPLAY_MAGIC_LEN, len - REPLAY_MAGIC_LEN,
+				      cmds, nr, line);
+	else
+		err = replay_load_json(buf, cmds, nr, line);
+
+	free(buf);
+	return err;
+}
@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_REPLAY_H
+#define __UTIL_REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Traces of passthru commands for passthru-replay. A trace is either
+ * NDJSON, one object per command with the field names below as keys, or
+ * the binary form: NVME_REPLAY_MAGIC followed by the records back to back
+ * as little endian struct nvme_replay_cmd. Missing keys are 0, unknown
+ * keys are ignored, and the numbers of a JSON trace may also be given as
+ * "0x.." strings. The status and latency a trace was recorded with, see
+ * nvme-trace.h, are only kept from a binary trace.
+ */
+#define NVME_REPLAY_MAGIC	"NVMETRC1"
+
+struct nvme_replay_cmd {
+	uint8_t opcode;
+	uint8_t flags;
+	uint8_t admin;		/* admin command, otherwise I/O */
+	uint8_t rsvd;
+	uint32_t nsid;
+	uint32_t cdw2;
+	uint32_t cdw3;
+	uint32_t cdw10;
+	uint32_t cdw11;
+	uint32_t cdw12;
+	uint32_t cdw13;
+	uint32_t cdw14;
+	uint32_t cdw15;
+	uint32_t data_len;
+	uint32_t timeout_ms;
+	uint32_t think_us;	/* since the previous command was issued */
+	int32_t status;		/* as recorded: NVMe status or negative errno */
+	uint32_t latency_us;	/* as recorded */
+};
+
+/*
+ * nvme_replay_load - read all commands of the trace in @f
+ *
+ * The commands are returned in one allocation the caller frees. For a
+ * malformed trace @line is set to the line of the NDJSON object, or the
+ * number of the binary record, counted from 1.
+ *
+ * Returns 0, -EINVAL for a malformed trace, -ENOMEM or -EIO.
+ */
+int nvme_replay_load(FILE *f, struct nvme_replay_cmd **cmds, size_t *nr,
+		     unsigned int *line);
+
+#endif /* __UTIL_REPLAY_H */
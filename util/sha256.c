@@ -0,0 +1,404 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
+
+#include "sha256.h"
+
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha256_iv[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+typedef void (*sha256_blocks_fn)(uint32_t h[8], const unsigned char *p, size_t blocks);
+
+static pthread_once_t sha256_once = PTHREAD_ONCE_INIT;
+static sha256_blocks_fn sha256_blocks;
+static const char *sha256_name = "generic";
+
+static inline uint32_t ror32(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t load_be32(const unsigned char *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+		(uint32_t)p[2] << 8 | p[3];
+}
+
+static inline void store_be32(unsigned char *p, uint32_t v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void sha256_blocks_sw(uint32_t h[8], const unsigned char *p, size_t blocks)
+{
+	uint32_t w[64], a, b, c, d, e, f, g, hh, t1, t2;
+	int i;
+
+	for (; blocks; blocks--, p += SHA256_BLOCK_SIZE) {
+		for (i = 0; i < 16; i++)
+			w[i] = load_be32(p + 4 * i);
+		for (; i < 64; i++) {
+			uint32_t s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^
+				(w[i - 15] >> 3);
+			uint32_t s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^
+				(w[i - 2] >> 10);
+
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		a = h[0]; b = h[1]; c = h[2]; d = h[3];
+		e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+		for (i = 0; i < 64; i++) {
+			t1 = hh + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) +
+				((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+			t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) +
+				((a & b) ^ (a & c) ^ (b & c));
+			hh = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+	}
+}
+
+#if defined(__x86_64__)
+/*
+ * Four rounds per step with the SHA extensions. sha256rnds2 keeps the
+ * state as ABEF and CDGH and takes two rounds of K + W in the low half of
+ * its message operand; msg1 and msg2 compute the next four schedule words
+ * once the message registers have rotated far enough.
+ */
+#define SHANI_QUAD(n, cur, prev, next, m2, m1)					\
+	do {									\
+		msg = _mm_add_epi32(cur,					\
+			_mm_loadu_si128((const __m128i *)&sha256_k[4 * (n)]));	\
+		st1 = _mm_sha256rnds2_epu32(st1, st0, msg);			\
+		if (m2) {							\
+			next = _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4)); \
+			next = _mm_sha256msg2_epu32(next, cur);			\
+		}								\
+		msg = _mm_shuffle_epi32(msg, 0x0e);				\
+		st0 = _mm_sha256rnds2_epu32(st0, st1, msg);			\
+		if (m1)								\
+			prev = _mm_sha256msg1_epu32(prev, cur);			\
+	} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_blocks_shani(uint32_t h[8], const unsigned char *p, size_t blocks)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					     0x0405060700010203ULL);
+	__m128i st0, st1, msg, tmp, abef, cdgh;
+	__m128i w0, w1, w2, w3;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[0]), 0xb1);
+	st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&h[4]), 0x1b);
+	st0 = _mm_alignr_epi8(tmp, st1, 8);		/* ABEF */
+	st1 = _mm_blend_epi16(st1, tmp, 0xf0);		/* CDGH */
+
+	for (; blocks; blocks--, p += SHA256_BLOCK_SIZE) {
+		abef = st0;
+		cdgh = st1;
+
+		w0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 0)), bswap);
+		w1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), bswap);
+		w2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 32)), bswap);
+		w3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 48)), bswap);
+
+		SHANI_QUAD(0, w0, w3, w1, 0, 0);
+		SHANI_QUAD(1, w1, w0, w2, 0, 1);
+		SHANI_QUAD(2, w2, w1, w3, 0, 1);
+		SHANI_QUAD(3, w3, w2, w0, 1, 1);
+		SHANI_QUAD(4, w0, w3, w1, 1, 1);
+		SHANI_QUAD(5, w1, w0, w2, 1, 1);
+		SHANI_QUAD(6, w2, w1, w3, 1, 1);
+		SHANI_QUAD(7, w3, w2, w0, 1, 1);
+		SHANI_QUAD(8, w0, w3, w1, 1, 1);
+		SHANI_QUAD(9, w1, w0, w2, 1, 1);
+		SHANI_QUAD(10, w2, w1, w3, 1, 1);
+		SHANI_QUAD(11, w3, w2, w0, 1, 1);
+		SHANI_QUAD(12, w0, w3, w1, 1, 1);
+		SHANI_QUAD(13, w1, w0, w2, 1, 0);
+		SHANI_QUAD(14, w2, w1, w3, 1, 0);
+		SHANI_QUAD(15, w3, w2, w0, 0, 0);
+
+		st0 = _mm_add_epi32(st0, abef);
+		st1 = _mm_add_epi32(st1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(st0, 0x1b);		/* FEBA */
+	st1 = _mm_shuffle_epi32(st1, 0xb1);		/* DCHG */
+	_mm_storeu_si128((__m128i *)&h[0], _mm_blend_epi16(tmp, st1, 0xf0));
+	_mm_storeu_si128((__m128i *)&h[4], _mm_alignr_epi8(st1, tmp, 8));
+}
+
+static void sha256_select(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) ||
+	    !(ebx & bit_SHA) || !__builtin_cpu_supports("sse4.1"))
+		return;
+
+	sha256_blocks = sha256_blocks_shani;
+	sha256_name = "sha-ni";
+}
+#elif defined(__aarch64__) && defined(HWCAP_SHA2)
+/*
+ * Four rounds per step with the ARMv8 cryptography extension, the
+ * schedule for the rounds twelve steps later is computed alongside.
+ */
+#define CE_QUAD(n, a, b, c, d, sched)						\
+	do {									\
+		tmp = vaddq_u32(a, vld1q_u32(&sha256_k[4 * (n)]));		\
+		if (sched)							\
+			a = vsha256su1q_u32(vsha256su0q_u32(a, b), c, d);	\
+		save = st0;							\
+		st0 = vsha256hq_u32(st0, st1, tmp);				\
+		st1 = vsha256h2q_u32(st1, save, tmp);				\
+	} while (0)
+
+__attribute__((target("+crypto")))
+static void sha256_blocks_ce(uint32_t h[8], const unsigned char *p, size_t blocks)
+{
+	uint32x4_t st0 = vld1q_u32(&h[0]), st1 = vld1q_u32(&h[4]);
+	uint32x4_t abcd, efgh, save, tmp;
+	uint32x4_t w0, w1, w2, w3;
+
+	for (; blocks; blocks--, p += SHA256_BLOCK_SIZE) {
+		abcd = st0;
+		efgh = st1;
+
+		w0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 0)));
+		w1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 16)));
+		w2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 32)));
+		w3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 48)));
+
+		CE_QUAD(0, w0, w1, w2, w3, 1);
+		CE_QUAD(1, w1, w2, w3, w0, 1);
+		CE_QUAD(2, w2, w3, w0, w1, 1);
+		CE_QUAD(3, w3, w0, w1, w2, 1);
+		CE_QUAD(4, w0, w1, w2, w3, 1);
+		CE_QUAD(5, w1, w2, w3, w0, 1);
+		CE_QUAD(6, w2, w3, w0, w1, 1);
+		CE_QUAD(7, w3, w0, w1, w2, 1);
+		CE_QUAD(8, w0, w1, w2, w3, 1);
+		CE_QUAD(9, w1, w2, w3, w0, 1);
+		CE_QUAD(10, w2, w3, w0, w1, 1);
+		CE_QUAD(11, w3, w0, w1, w2, 1);
+		CE_QUAD(12, w0, w1, w2, w3, 0);
+		CE_QUAD(13, w1, w2, w3, w0, 0);
+		CE_QUAD(14, w2, w3, w0, w1, 0);
+		CE_QUAD(15, w3, w0, w1, w2, 0);
+
+		st0 = vaddq_u32(st0, abcd);
+		st1 = vaddq_u32(st1, efgh);
+	}
+
+	vst1q_u32(&h[0], st0);
+	vst1q_u32(&h[4], st1);
+}
+
+static void sha256_select(void)
+{
+	if (getauxval(AT_HWCAP) & HWCAP_SHA2) {
+		sha256_blocks = sha256_blocks_ce;
+		sha256_name = "armv8-ce";
+	}
+}
+#else
+static void sha256_select(void)
+{
+}
+#endif
+
+static void sha256_setup(void)
+{
+	sha256_blocks = sha256_blocks_sw;
+	sha256_select();
+}
+
+const char *sha256_impl_name(void)
+{
+	pthread_once(&sha256_once, sha256_setup);
+
+	return sha256_name;
+}
+
+void sha256_init(struct sha256 *s)
+{
+	pthread_once(&sha256_once, sha256_setup);
+
+	memcpy(s->h, sha256_iv, sizeof(s->h));
+	s->len = 0;
+}
+
+static void sha256_update_fn(struct sha256 *s, const void *data, size_t len,
+			     sha256_blocks_fn blocks)
+{
+	const unsigned char *p = data;
+	size_t used = s->len % SHA256_BLOCK_SIZE;
+	size_t n;
+
+	s->len += len;
+
+	if (used) {
+		n = SHA256_BLOCK_SIZE - used;
+		if (len < n) {
+			memcpy(s->buf + used, p, len);
+			return;
+		}
+		memcpy(s->buf + used, p, n);
+		blocks(s->h, s->buf, 1);
+		p += n;
+		len -= n;
+	}
+
+	/* whole blocks are hashed in place */
+	if (len >= SHA256_BLOCK_SIZE) {
+		n = len / SHA256_BLOCK_SIZE;
+		blocks(s->h, p, n);
+		p += n * SHA256_BLOCK_SIZE;
+		len -= n * SHA256_BLOCK_SIZE;
+	}
+
+	memcpy(s->buf, p, len);
+}
+
+static void sha256_final_fn(struct sha256 *s, unsigned char digest[SHA256_DIGEST_SIZE],
+			    sha256_blocks_fn blocks)
+{
+	size_t used = s->len % SHA256_BLOCK_SIZE;
+	uint64_t bits = s->len * 8;
+	int i;
+
+	s->buf[used++] = 0x80;
+	if (used > SHA256_BLOCK_SIZE - 8) {
+		memset(s->buf + used, 0, SHA256_BLOCK_SIZE - used);
+		blocks(s->h, s->buf, 1);
+		used = 0;
+	}
+	memset(s->buf + used, 0, SHA256_BLOCK_SIZE - 8 - used);
+	for (i = 0; i < 8; i++)
+		s->buf[SHA256_BLOCK_SIZE - 1 - i] = bits >> (8 * i);
+	blocks(s->h, s->buf, 1);
+
+	for (i = 0; i < 8; i++)
+		store_be32(digest + 4 * i, s->h[i]);
+}
+
+void sha256_update(struct sha256 *s, const void *data, size_t len)
+{
+	sha256_update_fn(s, data, len, sha256_blocks);
+}
+
+void sha256_final(struct sha256 *s, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+	sha256_final_fn(s, digest, sha256_blocks);
+}
+
+void sha256(const void *data, size_t len, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+	struct sha256 s;
+
+	sha256_init(&s);
+	sha256_update(&s, data, len);
+	sha256_final(&s, digest);
+}
+
+void sha256_sw(const void *data, size_t len, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+	struct sha256 s;
+
+	sha256_init(&s);
+	sha256_update_fn(&s, data, len, sha256_blocks_sw);
+	sha256_final_fn(&s, digest, sha256_blocks_sw);
+}
+
+void hmac_sha256_setkey(struct hmac_sha256_key *k, const void *key, size_t keylen)
+{
+	unsigned char pad[SHA256_BLOCK_SIZE] = { 0 };
+	int i;
+
+	/* keys longer than a block are replaced by their digest */
+	if (keylen > SHA256_BLOCK_SIZE)
+		sha256(key, keylen, pad);
+	else
+		memcpy(pad, key, keylen);
+
+	for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+		pad[i] ^= 0x36;
+	sha256_init(&k->inner);
+	sha256_update(&k->inner, pad, sizeof(pad));
+
+	for (i = 0; i < SHA256_BLOCK_SIZE; i++)
+		pad[i] ^= 0x36 ^ 0x5c;
+	sha256_init(&k->outer);
+	sha256_update(&k->outer, pad, sizeof(pad));
+
+	memset(pad, 0, sizeof(pad));
+}
+
+void hmac_sha256_mac(const struct hmac_sha256_key *k, const void *data, size_t len,
+		     unsigned char mac[SHA256_DIGEST_SIZE])
+{
+	unsigned char digest[SHA256_DIGEST_SIZE];
+	struct sha256 s = k->inner;
+
+	sha256_update(&s, data, len);
+	sha256_final(&s, digest);
+
+	s = k->outer;
+	sha256_update(&s, digest, sizeof(digest));
+	sha256_final(&s, mac);
+}
+
+void hmac_sha256(const void *key, size_t keylen, const void *data, size_t len,
+		 unsigned char mac[SHA256_DIGEST_SIZE])
+{
+	struct hmac_sha256_key k;
+
+	hmac_sha256_setkey(&k, key, keylen);
+	hmac_sha256_mac(&k, data, len, mac);
+	memset(&k, 0, sizeof(k));
+}
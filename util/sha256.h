@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_SHA256_H
+#define __UTIL_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_BLOCK_SIZE	64
+
+/*
+ * SHA-256 and HMAC-SHA256 (FIPS 180-4, RFC 2104). The compression uses the
+ * SHA extensions on x86-64 and the ARMv8 cryptography extension when the
+ * CPU has them, a portable implementation otherwise.
+ */
+struct sha256 {
+	uint32_t h[8];
+	uint64_t len;			/* bytes hashed so far */
+	unsigned char buf[SHA256_BLOCK_SIZE];
+};
+
+void sha256_init(struct sha256 *s);
+void sha256_update(struct sha256 *s, const void *data, size_t len);
+void sha256_final(struct sha256 *s, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+void sha256(const void *data, size_t len, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/* the portable version, for testing */
+void sha256_sw(const void *data, size_t len, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+/*
+ * A key hashed into the inner and outer states once, so every MAC costs
+ * only the blocks of its own data.
+ */
+struct hmac_sha256_key {
+	struct sha256 inner;
+	struct sha256 outer;
+};
+
+void hmac_sha256_setkey(struct hmac_sha256_key *k, const void *key, size_t keylen);
+void hmac_sha256_mac(const struct hmac_sha256_key *k, const void *data, size_t len,
+		     unsigned char mac[SHA256_DIGEST_SIZE]);
+
+void hmac_sha256(const void *key, size_t keylen, const void *data, size_t len,
+		 unsigned char mac[SHA256_DIGEST_SIZE]);
+
+/* the name of the compression in use: "sha-ni", "armv8-ce" or "generic" */
+const char *sha256_impl_name(void);
+
+#endif /* __UTIL_SHA256_H */
@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream.h"
+#include "mem.h"
+
+static ssize_t read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len) {
+		n = read(fd, (char *)buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!n)
+			break;
+		done += n;
+	}
+
+	return done;
+}
+
+static bool clear_o_direct(int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags < 0 || !(flags & O_DIRECT))
+		return false;
+
+	return !fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+}
+
+static ssize_t write_full(int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < len) {
+		n = write(fd, (const char *)buf + done, len - done);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/* a tail not aligned for O_DIRECT goes through the page cache */
+			if (errno == EINVAL && clear_o_direct(fd))
+				continue;
+			return -errno;
+		}
+		done += n;
+	}
+
+	return done;
+}
+
+static size_t stream_chunk_len(struct nvme_stream *s, uint64_t chunk)
+{
+	uint64_t off = chunk * s->chunk_size;
+
+	if (s->total - off < s->chunk_size)
+		return s->total - off;
+	return s->chunk_size;
+}
+
+/*
+ * Wait until @b reaches the @full state. Returns false if the stream was
+ * cancelled, the helper failed (caller side) or the caller finished the
+ * stream (helper side).
+ */
+static bool stream_wait(struct nvme_stream *s, struct nvme_stream_buf *b,
+			bool full, bool helper)
+{
+	while (b->full != full) {
+		if (s->cancel)
+			return false;
+		if (helper && !s->running)
+			return false;
+		if (!helper && s->err)
+			return false;
+		pthread_cond_wait(&s->cond, &s->lock);
+	}
+
+	return true;
+}
+
+static void stream_fail(struct nvme_stream *s, int err)
+{
+	pthread_mutex_lock(&s->lock);
+	if (!s->err)
+		s->err = err;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+}
+
+static void *stream_helper(void *arg)
+{
+	struct nvme_stream *s = arg;
+	bool from_file = s->dir == NVME_STREAM_FROM_FILE;
+	struct nvme_stream_buf *b;
+	uint64_t i;
+	ssize_t n;
+	size_t len;
+
+	for (i = 0; i < s->nr_chunks; i++) {
+		b = &s->bufs[i % s->nr_bufs];
+
+		pthread_mutex_lock(&s->lock);
+		if (!stream_wait(s, b, !from_file, true)) {
+			pthread_mutex_unlock(&s->lock);
+			break;
+		}
+		pthread_mutex_unlock(&s->lock);
+
+		if (from_file) {
+			len = stream_chunk_len(s, i);
+			n = read_full(s->fd, b->data, len);
+			if (n < 0) {
+				stream_fail(s, n);
+				break;
+			}
+			if ((size_t)n < len)
+				memset((char *)b->data + n, 0, len - n);
+			b->len = len;
+		} else {
+			n = write_full(s->fd, b->data, b->len);
+			if (n < 0) {
+				stream_fail(s, n);
+				break;
+			}
+		}
+
+		pthread_mutex_lock(&s->lock);
+		s->file_bytes += n;
+		b->full = from_file;
+		pthread_cond_broadcast(&s->cond);
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	return NULL;
+}
+
+int nvme_stream_init(struct nvme_stream *s, int fd, enum nvme_stream_dir dir,
+		     uint64_t total, size_t chunk_size, unsigned int nr_bufs)
+{
+	unsigned int i;
+	int err;
+
+	memset(s, 0, sizeof(*s));
+	if (!chunk_size)
+		return -EINVAL;
+
+	s->fd = fd;
+	s->dir = dir;
+	s->total = total;
+	s->chunk_size = chunk_size;
+	s->nr_chunks = (total + chunk_size - 1) / chunk_size;
+	s->nr_bufs = nr_bufs < 2 ? 2 : nr_bufs;
+
+	s->bufs = calloc(s->nr_bufs, sizeof(*s->bufs));
+	if (!s->bufs)
+		return -ENOMEM;
+
+	for (i = 0; i < s->nr_bufs; i++) {
+		s->bufs[i].data = nvme_alloc(chunk_size);
+		if (!s->bufs[i].data) {
+			err = -ENOMEM;
+			goto free;
+		}
+	}
+
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->cond, NULL);
+
+	s->running = true;
+	err = pthread_create(&s->thread, NULL, stream_helper, s);
+	if (err) {
+		err = -err;
+		s->running = false;
+		pthread_cond_destroy(&s->cond);
+		pthread_mutex_destroy(&s->lock);
+		goto free;
+	}
+
+	return 0;
+
+free:
+	for (i = 0; i < s->nr_bufs; i++)
+		free(s->bufs[i].data);
+	free(s->bufs);
+	s->bufs = NULL;
+	return err;
+}
+
+void *nvme_stream_get(struct nvme_stream *s, size_t *len)
+{
+	bool from_file = s->dir == NVME_STREAM_FROM_FILE;
+	struct nvme_stream_buf *b;
+
+	if (s->next >= s->nr_chunks)
+		return NULL;
+
+	b = &s->bufs[s->next % s->nr_bufs];
+
+	pthread_mutex_lock(&s->lock);
+	if (!stream_wait(s, b, from_file, false)) {
+		pthread_mutex_unlock(&s->lock);
+		return NULL;
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	*len = from_file ? b->len : stream_chunk_len(s, s->next);
+	return b->data;
+}
+
+void nvme_stream_put(struct nvme_stream *s, size_t len)
+{
+	struct nvme_stream_buf *b = &s->bufs[s->next % s->nr_bufs];
+
+	pthread_mutex_lock(&s->lock);
+	if (s->dir == NVME_STREAM_TO_FILE) {
+		b->len = len;
+		b->full = true;
+	} else {
+		b->full = false;
+	}
+	s->next++;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+}
+
+int nvme_stream_finish(struct nvme_stream *s, bool cancel)
+{
+	unsigned int i;
+	int err;
+
+	if (!s->bufs)
+		return s->err;
+
+	pthread_mutex_lock(&s->lock);
+	/*
+	 * Reading ahead is pointless once the caller is done, writing stops
+	 * after the last buffer that was handed back.
+	 */
+	if (cancel || s->dir == NVME_STREAM_FROM_FILE)
+		s->cancel = true;
+	s->running = false;
+	pthread_cond_broadcast(&s->cond);
+	pthread_mutex_unlock(&s->lock);
+
+	pthread_join(s->thread, NULL);
+
+	err = s->err;
+	if (!err && !cancel && s->fsync && fsync(s->fd) < 0 &&
+	    errno != EINVAL && errno != EROFS)
+		err = -errno;
+
+	pthread_cond_destroy(&s->cond);
+	pthread_mutex_destroy(&s->lock);
+	for (i = 0; i < s->nr_bufs; i++)
+		free(s->bufs[i].data);
+	free(s->bufs);
+	s->bufs = NULL;
+
+	return err;
+}
@@ -0,0 +1,98 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_STREAM_H
+#define __UTIL_STREAM_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Bounded memory file streaming. A helper thread moves data between a file
+ * descriptor and a small ring of page aligned buffers, so file I/O overlaps
+ * with whatever the caller does with the previous buffer (usually an NVMe
+ * command).
+ *
+ * For NVME_STREAM_FROM_FILE the helper fills buffers and the caller
+ * consumes them with nvme_stream_get()/nvme_stream_put(). For
+ * NVME_STREAM_TO_FILE the caller fills buffers obtained with
+ * nvme_stream_get() and the helper writes them out after nvme_stream_put().
+ *
+ * The stream is split into chunks of at most chunk_size bytes; the last
+ * chunk carries the remainder of total bytes. Files opened with O_DIRECT
+ * fall back to buffered writes for a misaligned tail.
+ */
+
+enum nvme_stream_dir {
+	NVME_STREAM_FROM_FILE,
+	NVME_STREAM_TO_FILE,
+};
+
+struct nvme_stream_buf {
+	void *data;
+	size_t len;
+	bool full;
+};
+
+struct nvme_stream {
+	int fd;
+	enum nvme_stream_dir dir;
+	size_t chunk_size;
+	uint64_t total;
+	uint64_t nr_chunks;
+	bool fsync;		/* fsync() the file in nvme_stream_finish() */
+
+	unsigned int nr_bufs;
+	struct nvme_stream_buf *bufs;
+	uint64_t next;		/* next chunk handed out to the caller */
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool running;
+	bool cancel;
+	int err;		/* first error of the helper thread */
+	uint64_t file_bytes;	/* bytes transferred from/to the file */
+};
+
+/*
+ * nvme_stream_init - allocate @nr_bufs buffers and start the helper thread
+ * @s:		stream to set up
+ * @fd:		file to read from or write to
+ * @dir:	direction of the file data
+ * @total:	number of bytes to stream
+ * @chunk_size:	maximum bytes per buffer
+ * @nr_bufs:	depth of the buffer ring, at least 2 for double buffering
+ *
+ * Returns 0 or a negative errno.
+ */
+int nvme_stream_init(struct nvme_stream *s, int fd, enum nvme_stream_dir dir,
+		     uint64_t total, size_t chunk_size, unsigned int nr_bufs);
+
+/*
+ * nvme_stream_get - wait for the next buffer
+ *
+ * For NVME_STREAM_FROM_FILE the buffer holds the next chunk of the file,
+ * zero padded if the file ended early. For NVME_STREAM_TO_FILE the buffer
+ * is free to be filled. @len is set to the size of the chunk.
+ *
+ * Returns NULL once all chunks were handed out or if the helper failed,
+ * see nvme_stream_finish().
+ */
+void *nvme_stream_get(struct nvme_stream *s, size_t *len);
+
+/*
+ * nvme_stream_put - hand the buffer returned by nvme_stream_get() back.
+ * For NVME_STREAM_TO_FILE @len bytes get written to the file.
+ */
+void nvme_stream_put(struct nvme_stream *s, size_t len);
+
+/*
+ * nvme_stream_finish - wait for outstanding file I/O and release the stream
+ * @cancel: drop buffers that were not written yet
+ *
+ * Returns 0 or the first error of the helper thread as a negative errno.
+ */
+int nvme_stream_finish(struct nvme_stream *s, bool cancel);
+
+#endif /* __UTIL_STREAM_H */
@@ -0,0 +1,174 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sysfs.h"
+
+int sysfs_read_attr(const char *dir, const char *attr, char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	ssize_t n;
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s", dir, attr) >= (int)sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	n = read(fd, buf, len - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+
+	while (n && (buf[n - 1] == '\n' || buf[n - 1] == ' '))
+		n--;
+	buf[n] = '\0';
+
+	if (!n) {
+		errno = ENODATA;
+		return -1;
+	}
+
+	return 0;
+}
+
+int sysfs_read_u64(const char *dir, const char *attr, unsigned long long *val)
+{
+	char buf[32], *end;
+
+	if (sysfs_read_attr(dir, attr, buf, sizeof(buf)))
+		return -1;
+
+	errno = 0;
+	*val = strtoull(buf, &end, 0);
+	if (errno)
+		return -1;
+	if (*end) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+int sysfs_read_blk_stat(const char *dir, struct sysfs_blk_stat *st)
+{
+	unsigned long long merges;
+	char buf[512];
+
+	if (sysfs_read_attr(dir, "stat", buf, sizeof(buf)))
+		return -1;
+
+	/* the discard and flush counters of newer kernels follow */
+	if (sscanf(buf, "%llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &st->read_ios, &merges, &st->read_sectors, &st->read_ticks,
+		   &st->write_ios, &merges, &st->write_sectors, &st->write_ticks,
+		   &st->in_flight, &st->io_ticks, &st->time_in_queue) != 11) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* find @attr of the PCI device behind the controller of @name */
+static int sysfs_pci_attr(const char *name, const char *attr, char *buf, size_t len)
+{
+	/* the device link of a namespace points to its controller */
+	static const char * const fmts[] = {
+		"/sys/class/nvme/%s/device/%s",
+		"/sys/class/block/%s/device/device/%s",
+		"/sys/class/nvme-generic/%s/device/device/%s",
+	};
+	size_t i;
+
+	for (i = 0; i < sizeof(fmts) / sizeof(fmts[0]); i++) {
+		if (snprintf(buf, len, fmts[i], name, attr) >= (int)len) {
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		if (!access(buf, F_OK))
+			return 0;
+	}
+
+	errno = ENODEV;
+	return -1;
+}
+
+int sysfs_p2pmem_dir(const char *name, char *buf, size_t len)
+{
+	return sysfs_pci_attr(name, "p2pmem", buf, len);
+}
+
+int sysfs_numa_node(const char *name)
+{
+	char path[PATH_MAX], buf[16], *end;
+	long node;
+
+	if (sysfs_pci_attr(name, "", path, sizeof(path)) ||
+	    sysfs_read_attr(path, "numa_node", buf, sizeof(buf)))
+		return -1;
+
+	node = strtol(buf, &end, 10);
+	if (*end || node < 0 || node > INT_MAX) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	return node;
+}
+
+int sysfs_parse_cpulist(const char *s, cpu_set_t *set)
+{
+	const char *p = s;
+	unsigned long first, last;
+	char *end;
+
+	/* "0-15,32-47" */
+	CPU_ZERO(set);
+	while (*p) {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			goto einval;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if (end == p || last < first)
+				goto einval;
+		}
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+		p = end;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			goto einval;
+	}
+
+	if (CPU_COUNT(set))
+		return 0;
+
+einval:
+	errno = EINVAL;
+	return -1;
+}
+
+int sysfs_local_cpus(const char *name, cpu_set_t *set)
+{
+	char path[PATH_MAX], buf[4096];
+
+	if (sysfs_pci_attr(name, "", path, sizeof(path)) ||
+	    sysfs_read_attr(path, "local_cpulist", buf, sizeof(buf)))
+		return -1;
+
+	return sysfs_parse_cpulist(buf, set);
+}
@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_SYSFS_H
+#define __UTIL_SYSFS_H
+
+#include <sched.h>
+#include <stddef.h>
+
+/*
+ * sysfs_read_attr - read the sysfs attribute @dir/@attr into @buf
+ *
+ * Trailing newlines and blanks are stripped. Returns 0, or -1 with errno
+ * set if the attribute can't be read or is empty.
+ */
+int sysfs_read_attr(const char *dir, const char *attr, char *buf, size_t len);
+
+/*
+ * sysfs_read_u64 - read the sysfs attribute @dir/@attr as a number
+ */
+int sysfs_read_u64(const char *dir, const char *attr, unsigned long long *val);
+
+/* The I/O counters of a block device, from its "stat" attribute */
+struct sysfs_blk_stat {
+	unsigned long long read_ios;
+	unsigned long long read_sectors;
+	unsigned long long read_ticks;		/* ms */
+	unsigned long long write_ios;
+	unsigned long long write_sectors;
+	unsigned long long write_ticks;		/* ms */
+	unsigned long long in_flight;
+	unsigned long long io_ticks;		/* ms */
+	unsigned long long time_in_queue;	/* ms */
+};
+
+/*
+ * sysfs_read_blk_stat - read the "stat" attribute of the block device @dir
+ *
+ * Returns 0, or -1 with errno set if it can't be read or is too short.
+ */
+int sysfs_read_blk_stat(const char *dir, struct sysfs_blk_stat *st);
+
+/*
+ * sysfs_p2pmem_dir - find the p2pmem directory of the PCI device behind
+ * the nvme controller, namespace or generic device @name into @buf
+ *
+ * Returns 0, or -1 with errno set to ENODEV if the device exports no
+ * peer-to-peer memory.
+ */
+int sysfs_p2pmem_dir(const char *name, char *buf, size_t len);
+
+/*
+ * sysfs_numa_node - the NUMA node of the PCI device behind the nvme
+ * controller, namespace or generic device @name
+ *
+ * Returns the node, or -1 with errno set if it isn't known, as on single
+ * node systems and for fabrics controllers.
+ */
+int sysfs_numa_node(const char *name);
+
+/*
+ * sysfs_parse_cpulist - parse a CPU list attribute such as "0-3,8,10-11"
+ *
+ * Returns 0 with the CPUs in @set, or -1 with errno set to EINVAL if @s
+ * is malformed or names no CPU.
+ */
+int sysfs_parse_cpulist(const char *s, cpu_set_t *set);
+
+/*
+ * sysfs_local_cpus - the CPUs local to the PCI device behind @name
+ *
+ * Returns 0 with them in @set, or -1 with errno set.
+ */
+int sysfs_local_cpus(const char *name, cpu_set_t *set);
+
+#endif /* __UTIL_SYSFS_H */
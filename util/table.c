@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "table.h"
+
+#define TABLE_BUF_MIN	4096
+#define TABLE_CELLS_MIN	256
+
+int nvme_table_init(struct nvme_table *t, const struct nvme_table_column *cols,
+		    unsigned int nr_cols)
+{
+	unsigned int i;
+
+	memset(t, 0, sizeof(*t));
+	t->cols = cols;
+	t->nr_cols = nr_cols;
+
+	t->widths = calloc(nr_cols, sizeof(*t->widths));
+	if (!t->widths)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_cols; i++) {
+		t->widths[i] = strlen(cols[i].name);
+		if (t->widths[i] < cols[i].width)
+			t->widths[i] = cols[i].width;
+	}
+
+	return 0;
+}
+
+static bool table_grow(struct nvme_table *t, size_t len)
+{
+	struct nvme_table_cell *cells;
+	size_t size;
+	char *buf;
+
+	if (t->err)
+		return false;
+
+	if (t->nr_cells == t->max_cells) {
+		size = t->max_cells ? 2 * t->max_cells : TABLE_CELLS_MIN;
+		cells = realloc(t->cells, size * sizeof(*cells));
+		if (!cells)
+			goto enomem;
+		t->cells = cells;
+		t->max_cells = size;
+	}
+
+	if (t->len + len > t->size) {
+		size = t->size ? t->size : TABLE_BUF_MIN;
+		while (size < t->len + len)
+			size *= 2;
+		buf = realloc(t->buf, size);
+		if (!buf)
+			goto enomem;
+		t->buf = buf;
+		t->size = size;
+	}
+
+	return true;
+
+enomem:
+	t->err = -ENOMEM;
+	return false;
+}
+
+/* account the cell just copied to the end of the buffer */
+static void table_commit(struct nvme_table *t, size_t len)
+{
+	unsigned int col = t->nr_cells % t->nr_cols;
+
+	t->cells[t->nr_cells].off = t->len;
+	t->cells[t->nr_cells].len = len;
+	t->nr_cells++;
+	t->len += len;
+
+	if (t->widths[col] < len)
+		t->widths[col] = len;
+}
+
+void nvme_table_add(struct nvme_table *t, const char *s)
+{
+	size_t len = s ? strlen(s) : 0;
+
+	if (!table_grow(t, len))
+		return;
+
+	if (len)
+		memcpy(t->buf + t->len, s, len);
+	table_commit(t, len);
+}
+
+void nvme_table_addf(struct nvme_table *t, const char *fmt, ...)
+{
+	size_t avail;
+	va_list ap;
+	int len;
+
+	if (!table_grow(t, 1))
+		return;
+
+	/* format in place, growing the buffer for the rare long cell */
+	avail = t->size - t->len;
+	va_start(ap, fmt);
+	len = vsnprintf(t->buf + t->len, avail, fmt, ap);
+	va_end(ap);
+	if (len < 0) {
+		t->err = -EINVAL;
+		return;
+	}
+
+	if ((size_t)len >= avail) {
+		/* the terminating NUL needs a byte the cell doesn't keep */
+		if (!table_grow(t, len + 1))
+			return;
+		va_start(ap, fmt);
+		vsnprintf(t->buf + t->len, len + 1, fmt, ap);
+		va_end(ap);
+	}
+
+	table_commit(t, len);
+}
+
+void nvme_table_append(struct nvme_table *t, const char *sep, const char *s)
+{
+	size_t sep_len = strlen(sep), len = s ? strlen(s) : 0;
+	struct nvme_table_cell *c;
+	unsigned int col;
+
+	if (!t->nr_cells) {
+		nvme_table_add(t, s);
+		return;
+	}
+
+	/* the last cell ends the buffer, so it grows in place */
+	c = &t->cells[t->nr_cells - 1];
+	if (!c->len)
+		sep_len = 0;
+	if (!table_grow(t, sep_len + len))
+		return;
+
+	memcpy(t->buf + t->len, sep, sep_len);
+	if (len)
+		memcpy(t->buf + t->len + sep_len, s, len);
+	t->len += sep_len + len;
+	c->len += sep_len + len;
+
+	col = (t->nr_cells - 1) % t->nr_cols;
+	if (t->widths[col] < c->len)
+		t->widths[col] = c->len;
+}
+
+static char *table_put(char *p, const char *s, unsigned int len,
+		       unsigned int width, enum nvme_table_align align)
+{
+	unsigned int pad = width - len;
+
+	if (align == NVME_TABLE_RIGHT) {
+		memset(p, ' ', pad);
+		p += pad;
+	}
+	memcpy(p, s, len);
+	p += len;
+	if (align == NVME_TABLE_LEFT) {
+		memset(p, ' ', pad);
+		p += pad;
+	}
+
+	return p;
+}
+
+int nvme_table_print(struct nvme_table *t, FILE *f)
+{
+	size_t rows = (t->nr_cells + t->nr_cols - 1) / t->nr_cols;
+	size_t line = 0, i;
+	unsigned int col;
+	char *out, *p;
+	int err = 0;
+
+	if (t->err)
+		return t->err;
+
+	for (col = 0; col < t->nr_cols; col++)
+		line += t->widths[col] + 1;
+
+	out = malloc((rows + 2) * line);
+	if (!out)
+		return -ENOMEM;
+	p = out;
+
+	for (col = 0; col < t->nr_cols; col++) {
+		p = table_put(p, t->cols[col].name, strlen(t->cols[col].name),
+			      t->widths[col], NVME_TABLE_LEFT);
+		*p++ = col + 1 < t->nr_cols ? ' ' : '\n';
+	}
+
+	for (col = 0; col < t->nr_cols; col++) {
+		memset(p, '-', t->widths[col]);
+		p += t->widths[col];
+		*p++ = col + 1 < t->nr_cols ? ' ' : '\n';
+	}
+
+	for (i = 0; i < rows * t->nr_cols; i++) {
+		col = i % t->nr_cols;
+		if (i < t->nr_cells)
+			p = table_put(p, t->buf + t->cells[i].off, t->cells[i].len,
+				      t->widths[col], t->cols[col].align);
+		else
+			p = table_put(p, "", 0, t->widths[col], NVME_TABLE_LEFT);
+		*p++ = col + 1 < t->nr_cols ? ' ' : '\n';
+	}
+
+	if (fwrite(out, 1, p - out, f) != (size_t)(p - out))
+		err = -EIO;
+
+	free(out);
+	return err;
+}
+
+void nvme_table_free(struct nvme_table *t)
+{
+	free(t->widths);
+	free(t->buf);
+	free(t->cells);
+	memset(t, 0, sizeof(*t));
+}
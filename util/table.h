@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_TABLE_H
+#define __UTIL_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Column table for the list style outputs. The cells are appended row by
+ * row into one string buffer while the column widths are tracked, and
+ * nvme_table_print() lays the whole table out in a single buffer written
+ * with one call: a header line, a dash line and the rows, the columns
+ * separated by a space and padded to the widest cell.
+ *
+ * A column is at least as wide as its name and its minimum width, so the
+ * tables keep their layout as long as the values fit and grow instead of
+ * shifting a row out of line when they don't.
+ */
+
+enum nvme_table_align {
+	NVME_TABLE_LEFT,
+	NVME_TABLE_RIGHT,
+};
+
+struct nvme_table_column {
+	const char *name;
+	unsigned int width;		/* minimum width */
+	enum nvme_table_align align;
+};
+
+struct nvme_table_cell {
+	size_t off;
+	unsigned int len;
+};
+
+struct nvme_table {
+	const struct nvme_table_column *cols;
+	unsigned int nr_cols;
+	unsigned int *widths;
+
+	char *buf;			/* the cell strings, not terminated */
+	size_t len, size;
+
+	struct nvme_table_cell *cells;
+	size_t nr_cells, max_cells;
+
+	int err;			/* first allocation failure */
+};
+
+/*
+ * nvme_table_init - set up an empty table
+ * @t:		table to set up
+ * @cols:	the columns, must stay valid until nvme_table_free()
+ * @nr_cols:	number of columns
+ *
+ * Returns 0 or -ENOMEM.
+ */
+int nvme_table_init(struct nvme_table *t, const struct nvme_table_column *cols,
+		    unsigned int nr_cols);
+
+/*
+ * nvme_table_add - append the next cell
+ *
+ * The cells fill the rows from left to right; the first cell after a full
+ * row starts a new one. A NULL string is an empty cell. A failure is remembered and reported by
+ * nvme_table_print().
+ */
+void nvme_table_add(struct nvme_table *t, const char *s);
+void nvme_table_addf(struct nvme_table *t, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+/* append @s to the last cell, after @sep unless the cell is still empty */
+void nvme_table_append(struct nvme_table *t, const char *sep, const char *s);
+
+static inline size_t nvme_table_rows(struct nvme_table *t)
+{
+	return t->nr_cells / t->nr_cols;
+}
+
+/*
+ * nvme_table_print - write the table to @f
+ *
+ * A short last row is completed with empty cells. Returns 0 or a negative
+ * errno.
+ */
+int nvme_table_print(struct nvme_table *t, FILE *f);
+
+void nvme_table_free(struct nvme_table *t);
+
+#endif /* __UTIL_TABLE_H */
@@ -0,0 +1,359 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef CONFIG_ZSTD
+#include <zstd.h>
+#endif
+
+#include "tar.h"
+
+#define TAR_BLOCK_SIZE	512
+
+struct ustar_header {
+	char name[100];
+	char mode[8];
+	char uid[8];
+	char gid[8];
+	char size[12];
+	char mtime[12];
+	char chksum[8];
+	char typeflag;
+	char linkname[100];
+	char magic[6];
+	char version[2];
+	char uname[32];
+	char gname[32];
+	char devmajor[8];
+	char devminor[8];
+	char prefix[155];
+	char pad[12];
+};
+
+struct nvme_tar {
+	pthread_mutex_t lock;
+	int fd;
+	int err;
+	time_t mtime;
+#ifdef CONFIG_ZSTD
+	ZSTD_CCtx *cctx;
+	void *out;
+	size_t out_size;
+#endif
+};
+
+static int write_full(int fd, const void *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		n = write(fd, buf, len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		buf = (const char *)buf + n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_ZSTD
+bool nvme_tar_zstd_supported(void)
+{
+	return true;
+}
+
+static int tar_compress(struct nvme_tar *t, const void *data, size_t len,
+			ZSTD_EndDirective mode)
+{
+	ZSTD_inBuffer in = { data, len, 0 };
+	size_t left;
+	int err;
+
+	do {
+		ZSTD_outBuffer out = { t->out, t->out_size, 0 };
+
+		left = ZSTD_compressStream2(t->cctx, &out, &in, mode);
+		if (ZSTD_isError(left))
+			return -EIO;
+		err = write_full(t->fd, t->out, out.pos);
+		if (err)
+			return err;
+	} while (mode == ZSTD_e_end ? left : in.pos < in.size);
+
+	return 0;
+}
+
+static int tar_write(struct nvme_tar *t, const void *data, size_t len)
+{
+	if (t->cctx)
+		return tar_compress(t, data, len, ZSTD_e_continue);
+	return write_full(t->fd, data, len);
+}
+
+static int tar_compress_init(struct nvme_tar *t, int level)
+{
+	t->cctx = ZSTD_createCCtx();
+	t->out_size = ZSTD_CStreamOutSize();
+	t->out = malloc(t->out_size);
+	if (!t->cctx || !t->out)
+		return -ENOMEM;
+	if (ZSTD_isError(ZSTD_CCtx_setParameter(t->cctx, ZSTD_c_compressionLevel, level)))
+		return -EINVAL;
+	return 0;
+}
+
+static int tar_compress_end(struct nvme_tar *t)
+{
+	return t->cctx ? tar_compress(t, NULL, 0, ZSTD_e_end) : 0;
+}
+
+static void tar_compress_free(struct nvme_tar *t)
+{
+	ZSTD_freeCCtx(t->cctx);
+	free(t->out);
+}
+#else
+bool nvme_tar_zstd_supported(void)
+{
+	return false;
+}
+
+static int tar_write(struct nvme_tar *t, const void *data, size_t len)
+{
+	return write_full(t->fd, data, len);
+}
+
+static int tar_compress_init(struct nvme_tar *t, int level)
+{
+	return -EOPNOTSUPP;
+}
+
+static int tar_compress_end(struct nvme_tar *t)
+{
+	return 0;
+}
+
+static void tar_compress_free(struct nvme_tar *t)
+{
+}
+#endif
+
+struct nvme_tar *nvme_tar_open(int fd, int zstd_level)
+{
+	struct nvme_tar *t;
+	int err;
+
+	t = calloc(1, sizeof(*t));
+	if (!t)
+		return NULL;
+
+	pthread_mutex_init(&t->lock, NULL);
+	t->fd = fd;
+	t->mtime = time(NULL);
+
+	if (zstd_level) {
+		err = tar_compress_init(t, zstd_level);
+		if (err) {
+			tar_compress_free(t);
+			pthread_mutex_destroy(&t->lock);
+			free(t);
+			errno = -err;
+			return NULL;
+		}
+	}
+
+	return t;
+}
+
+/* names longer than the name field are split at a '/' into the prefix */
+static int tar_set_name(struct ustar_header *h, const char *name)
+{
+	size_t len = strlen(name);
+	const char *p;
+
+	if (len <= sizeof(h->name)) {
+		memcpy(h->name, name, len);
+		return 0;
+	}
+
+	for (p = name + len - sizeof(h->name) - 1; p < name + len; p++) {
+		if (*p != '/')
+			continue;
+		if (p - name > (ptrdiff_t)sizeof(h->prefix))
+			break;
+		memcpy(h->prefix, name, p - name);
+		memcpy(h->name, p + 1, name + len - p - 1);
+		return 0;
+	}
+
+	return -ENAMETOOLONG;
+}
+
+static int tar_header(struct nvme_tar *t, struct ustar_header *h,
+		      const char *name, size_t len)
+{
+	unsigned int sum = 0;
+	size_t i;
+	int err;
+
+	memset(h, 0, sizeof(*h));
+	err = tar_set_name(h, name);
+	if (err)
+		return err;
+
+	/* the octal size field holds up to 8 GiB - 1 */
+	if ((unsigned long long)len >= 1ULL << 33)
+		return -EFBIG;
+
+	snprintf(h->mode, sizeof(h->mode), "%07o", 0644);
+	snprintf(h->uid, sizeof(h->uid), "%07o", 0);
+	snprintf(h->gid, sizeof(h->gid), "%07o", 0);
+	snprintf(h->size, sizeof(h->size), "%011llo", (unsigned long long)len);
+	snprintf(h->mtime, sizeof(h->mtime), "%011llo", (unsigned long long)t->mtime);
+	h->typeflag = '0';
+	memcpy(h->magic, "ustar", 6);
+	memcpy(h->version, "00", 2);
+
+	/* the checksum is computed with its own field set to spaces */
+	memset(h->chksum, ' ', sizeof(h->chksum));
+	for (i = 0; i < sizeof(*h); i++)
+		sum += ((unsigned char *)h)[i];
+	snprintf(h->chksum, sizeof(h->chksum), "%06o", sum);
+	h->chksum[7] = ' ';
+
+	return 0;
+}
+
+int nvme_tar_add(struct nvme_tar *t, const char *name, const void *data,
+		 size_t len)
+{
+	static const char zero[TAR_BLOCK_SIZE];
+	struct ustar_header h;
+	int err;
+
+	err = tar_header(t, &h, name, len);
+	if (err)
+		return err;
+
+	pthread_mutex_lock(&t->lock);
+	err = t->err;
+	if (!err)
+		err = tar_write(t, &h, sizeof(h));
+	if (!err)
+		err = tar_write(t, data, len);
+	if (!err && len % TAR_BLOCK_SIZE)
+		err = tar_write(t, zero, TAR_BLOCK_SIZE - len % TAR_BLOCK_SIZE);
+	if (err && !t->err)
+		t->err = err;
+	pthread_mutex_unlock(&t->lock);
+
+	return err;
+}
+
+int nvme_tar_close(struct nvme_tar *t)
+{
+	static const char zero[2 * TAR_BLOCK_SIZE];
+	int err = t->err;
+
+	/* the end of the archive is two zero blocks */
+	if (!err)
+		err = tar_write(t, zero, sizeof(zero));
+	if (!err)
+		err = tar_compress_end(t);
+
+	tar_compress_free(t);
+	pthread_mutex_destroy(&t->lock);
+	free(t);
+
+	return err;
+}
+
+bool nvme_tar_is_archive(const void *data, size_t len)
+{
+	const struct ustar_header *h = data;
+
+	/* "ustar\0" of POSIX and "ustar " of GNU tar */
+	return len >= TAR_BLOCK_SIZE && !memcmp(h->magic, "ustar", 5);
+}
+
+static int tar_octal(const char *p, size_t n, unsigned long long *v)
+{
+	size_t i = 0;
+
+	*v = 0;
+	while (i < n && p[i] == ' ')
+		i++;
+	for (; i < n && p[i] >= '0' && p[i] <= '7'; i++)
+		*v = *v << 3 | (p[i] - '0');
+
+	return i < n && p[i] && p[i] != ' ' ? -EINVAL : 0;
+}
+
+static bool tar_checksum_ok(const struct ustar_header *h)
+{
+	unsigned long long sum;
+	unsigned int calc = 0;
+	size_t i;
+
+	if (tar_octal(h->chksum, sizeof(h->chksum), &sum))
+		return false;
+
+	for (i = 0; i < sizeof(*h); i++)
+		calc += i >= offsetof(struct ustar_header, chksum) &&
+			i < offsetof(struct ustar_header, typeflag) ?
+			' ' : ((const unsigned char *)h)[i];
+
+	return calc == sum;
+}
+
+int nvme_tar_walk(const void *data, size_t len, nvme_tar_walk_fn fn, void *arg)
+{
+	/* name and prefix aren't NUL terminated when full */
+	char name[sizeof(((struct ustar_header *)NULL)->prefix) + 1 +
+		  sizeof(((struct ustar_header *)NULL)->name) + 1];
+	const struct ustar_header *h;
+	const char *p = data;
+	unsigned long long size;
+	size_t off = 0;
+	int ret;
+
+	while (off + TAR_BLOCK_SIZE <= len) {
+		h = (const struct ustar_header *)(p + off);
+		/* the end of the archive is a zero block */
+		if (!h->name[0])
+			return 0;
+		if (!tar_checksum_ok(h) || tar_octal(h->size, sizeof(h->size), &size))
+			return -EINVAL;
+
+		off += TAR_BLOCK_SIZE;
+		if (size > len - off)
+			return -EINVAL;
+
+		if (h->typeflag == '0' || !h->typeflag) {
+			if (h->prefix[0])
+				snprintf(name, sizeof(name), "%.*s/%.*s",
+					 (int)sizeof(h->prefix), h->prefix,
+					 (int)sizeof(h->name), h->name);
+			else
+				snprintf(name, sizeof(name), "%.*s",
+					 (int)sizeof(h->name), h->name);
+			ret = fn(name, p + off, size, arg);
+			if (ret)
+				return ret;
+		}
+
+		off += (size + TAR_BLOCK_SIZE - 1) / TAR_BLOCK_SIZE * TAR_BLOCK_SIZE;
+	}
+
+	return off == len ? 0 : -EINVAL;
+}
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_TAR_H
+#define __UTIL_TAR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Streaming ustar archive writer, the entries are written from memory as
+ * they are added, optionally through zstd when built with it. Entries can
+ * be added from several threads, each one is written as a whole. Archives
+ * in memory, e.g. mapped, are read with nvme_tar_walk().
+ */
+struct nvme_tar;
+
+/* whether nvme_tar_open() can compress */
+bool nvme_tar_zstd_supported(void);
+
+/*
+ * nvme_tar_open - start an archive written to @fd
+ *
+ * @zstd_level: 0 for an uncompressed archive, a zstd level otherwise.
+ * Returns the writer or NULL with errno set.
+ */
+struct nvme_tar *nvme_tar_open(int fd, int zstd_level);
+
+/*
+ * nvme_tar_add - add the regular file @name holding @len bytes of @data
+ *
+ * Returns 0 or a negative errno, the archive is unusable after an error.
+ */
+int nvme_tar_add(struct nvme_tar *t, const char *name, const void *data,
+		 size_t len);
+
+/*
+ * nvme_tar_close - end the archive and free the writer, @fd stays open
+ *
+ * Returns 0 or the first error of the archive as a negative errno.
+ */
+int nvme_tar_close(struct nvme_tar *t);
+
+/* whether the @len bytes at @data start with a ustar header */
+bool nvme_tar_is_archive(const void *data, size_t len);
+
+typedef int (*nvme_tar_walk_fn)(const char *name, const void *data, size_t len,
+				void *arg);
+
+/*
+ * nvme_tar_walk - call @fn for each regular file of the archive at @data
+ *
+ * The data of a file is handed out in place. Stops at the end of the
+ * archive or at the first non zero return of @fn, which is returned.
+ * Returns -EINVAL if the archive is truncated or a header is corrupt.
+ */
+int nvme_tar_walk(const void *data, size_t len, nvme_tar_walk_fn fn, void *arg);
+
+#endif /* __UTIL_TAR_H */
@@ -0,0 +1,432 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "thread-pool.h"
+
+struct work {
+	nvme_work_fn fn;
+	nvme_emit_fn emit;
+	void *arg;
+	int err;
+	bool done;			/* ordered, waiting for the earlier ones */
+	struct work *next_ordered;
+};
+
+/* a worker's queue, a ring the other workers steal from */
+struct pool_queue {
+	pthread_mutex_t lock;
+	unsigned int head;
+	unsigned int len;
+	struct work *slots[NVME_THREAD_POOL_DEPTH];
+};
+
+struct pool_worker {
+	struct nvme_thread_pool *pool;
+	unsigned int id;
+	pthread_t thread;
+	struct pool_queue q;
+};
+
+/*
+ * The counters are atomics so queueing and taking work only lock a
+ * worker's queue; the pool lock is for the sleeping and the waiting.
+ */
+struct nvme_thread_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;	/* work queued or shutdown */
+	pthread_cond_t idle_cond;	/* pending dropped to zero */
+	pthread_cond_t space_cond;	/* a queue slot freed or cancel */
+	int queued;			/* reserved or in the queues */
+	unsigned int pending;		/* queued, running or not yet emitted */
+	unsigned int sleepers;		/* workers waiting for work */
+	unsigned int space_waiters;	/* callers waiting for a queue slot */
+	unsigned int next;		/* queue for the next work item */
+	int cancel;
+	bool shutdown;
+
+	pthread_mutex_t order_lock;
+	struct work *order_head;	/* ordered items not yet emitted */
+	struct work *order_tail;
+	bool emitting;
+
+	unsigned int nr_threads;
+	struct pool_worker *workers;
+};
+
+static __thread struct pool_worker *current_worker;
+
+unsigned int nvme_thread_pool_jobs(unsigned int jobs, unsigned int nr)
+{
+	long cpus;
+
+	if (!jobs) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		jobs = cpus > 0 ? cpus : 1;
+	}
+	if (jobs > nr)
+		jobs = nr;
+
+	return jobs ? jobs : 1;
+}
+
+static bool queue_push(struct pool_queue *q, struct work *w)
+{
+	bool ok = false;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->len < NVME_THREAD_POOL_DEPTH) {
+		q->slots[(q->head + q->len) % NVME_THREAD_POOL_DEPTH] = w;
+		__atomic_store_n(&q->len, q->len + 1, __ATOMIC_RELAXED);
+		ok = true;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return ok;
+}
+
+static struct work *queue_pop(struct pool_queue *q)
+{
+	struct work *w = NULL;
+
+	/* no need to lock the queues found empty while stealing */
+	if (!__atomic_load_n(&q->len, __ATOMIC_RELAXED))
+		return NULL;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->len) {
+		w = q->slots[q->head];
+		q->head = (q->head + 1) % NVME_THREAD_POOL_DEPTH;
+		__atomic_store_n(&q->len, q->len - 1, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return w;
+}
+
+static void pool_put_pending(struct nvme_thread_pool *pool)
+{
+	if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST))
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_broadcast(&pool->idle_cond);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* emit the finished ordered items at the head, one caller at a time */
+static void pool_emit(struct nvme_thread_pool *pool, struct work *w)
+{
+	pthread_mutex_lock(&pool->order_lock);
+	w->done = true;
+	if (pool->emitting) {
+		pthread_mutex_unlock(&pool->order_lock);
+		return;
+	}
+
+	pool->emitting = true;
+	while (pool->order_head && pool->order_head->done) {
+		w = pool->order_head;
+		pool->order_head = w->next_ordered;
+		if (!pool->order_head)
+			pool->order_tail = NULL;
+		pthread_mutex_unlock(&pool->order_lock);
+
+		w->emit(w->arg, w->err);
+		free(w);
+		pool_put_pending(pool);
+
+		pthread_mutex_lock(&pool->order_lock);
+	}
+	pool->emitting = false;
+	pthread_mutex_unlock(&pool->order_lock);
+}
+
+static void pool_run(struct nvme_thread_pool *pool, struct work *w)
+{
+	if (__atomic_load_n(&pool->cancel, __ATOMIC_RELAXED))
+		w->err = -ECANCELED;
+	else
+		w->fn(w->arg);
+
+	if (w->emit) {
+		pool_emit(pool, w);
+		return;
+	}
+
+	free(w);
+	pool_put_pending(pool);
+}
+
+static struct work *pool_take(struct nvme_thread_pool *pool, unsigned int id)
+{
+	struct work *w = NULL;
+	unsigned int i;
+
+	/* the own queue first, then steal */
+	for (i = 0; i < pool->nr_threads && !w; i++)
+		w = queue_pop(&pool->workers[(id + i) % pool->nr_threads].q);
+	if (!w)
+		return NULL;
+
+	__atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&pool->space_waiters, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->space_cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return w;
+}
+
+static void *pool_worker(void *arg)
+{
+	struct pool_worker *self = arg;
+	struct nvme_thread_pool *pool = self->pool;
+	struct work *w;
+	bool stop;
+
+	current_worker = self;
+
+	while (true) {
+		w = pool_take(pool, self->id);
+		if (w) {
+			pool_run(pool, w);
+			continue;
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		__atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+		while (!__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) &&
+		       !pool->shutdown)
+			pthread_cond_wait(&pool->work_cond, &pool->lock);
+		__atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+		stop = pool->shutdown && !__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&pool->lock);
+
+		if (stop)
+			break;
+	}
+
+	return NULL;
+}
+
+static bool pool_push(struct nvme_thread_pool *pool, unsigned int first,
+		      unsigned int rounds, struct work *w)
+{
+	unsigned int i;
+
+	for (i = 0; !rounds || i < rounds * pool->nr_threads; i++)
+		if (queue_push(&pool->workers[(first + i) % pool->nr_threads].q, w))
+			return true;
+
+	return false;
+}
+
+/* reserve a queue slot, waiting for one while all are taken */
+static int pool_reserve(struct nvme_thread_pool *pool)
+{
+	int cap = pool->nr_threads * NVME_THREAD_POOL_DEPTH;
+
+	while (__atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST) > cap) {
+		__atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+
+		pthread_mutex_lock(&pool->lock);
+		__atomic_add_fetch(&pool->space_waiters, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&pool->queued, __ATOMIC_SEQ_CST) >= cap &&
+		       !__atomic_load_n(&pool->cancel, __ATOMIC_SEQ_CST))
+			pthread_cond_wait(&pool->space_cond, &pool->lock);
+		__atomic_sub_fetch(&pool->space_waiters, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&pool->lock);
+
+		if (__atomic_load_n(&pool->cancel, __ATOMIC_SEQ_CST))
+			return -ECANCELED;
+	}
+
+	return 0;
+}
+
+static int pool_submit(struct nvme_thread_pool *pool, struct work *w)
+{
+	struct pool_worker *self = current_worker;
+
+	if (self && self->pool == pool) {
+		/*
+		 * A work item queueing more must not wait for a slot, the
+		 * workers that could free one may all be doing the same.
+		 */
+		__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+		__atomic_add_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+		if (!pool_push(pool, self->id, 1, w)) {
+			__atomic_sub_fetch(&pool->queued, 1, __ATOMIC_SEQ_CST);
+			pool_run(pool, w);
+			return 0;
+		}
+	} else if (pool_reserve(pool)) {
+		/* cancelled while waiting, an ordered item still gets emitted */
+		if (!w->emit)
+			return -ECANCELED;
+		__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+		pool_run(pool, w);
+		return 0;
+	} else {
+		/* a slot is reserved, so a queue has room */
+		__atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+		pool_push(pool, __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED),
+			  0, w);
+	}
+
+	if (__atomic_load_n(&pool->sleepers, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_signal(&pool->work_cond);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	return 0;
+}
+
+static void pool_stop(struct nvme_thread_pool *pool, unsigned int started)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->work_cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < started; i++)
+		pthread_join(pool->workers[i].thread, NULL);
+
+	for (i = 0; i < pool->nr_threads; i++)
+		pthread_mutex_destroy(&pool->workers[i].q.lock);
+	pthread_mutex_destroy(&pool->order_lock);
+	pthread_cond_destroy(&pool->space_cond);
+	pthread_cond_destroy(&pool->idle_cond);
+	pthread_cond_destroy(&pool->work_cond);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->workers);
+	free(pool);
+}
+
+struct nvme_thread_pool *nvme_thread_pool_create(unsigned int nr_threads)
+{
+	struct nvme_thread_pool *pool;
+	unsigned int i;
+	int err;
+
+	if (!nr_threads) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+
+	pool->workers = calloc(nr_threads, sizeof(*pool->workers));
+	if (!pool->workers) {
+		free(pool);
+		return NULL;
+	}
+
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->work_cond, NULL);
+	pthread_cond_init(&pool->idle_cond, NULL);
+	pthread_cond_init(&pool->space_cond, NULL);
+	pthread_mutex_init(&pool->order_lock, NULL);
+	pool->nr_threads = nr_threads;
+
+	for (i = 0; i < nr_threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].id = i;
+		pthread_mutex_init(&pool->workers[i].q.lock, NULL);
+	}
+
+	for (i = 0; i < nr_threads; i++) {
+		err = pthread_create(&pool->workers[i].thread, NULL, pool_worker,
+				     &pool->workers[i]);
+		if (err) {
+			pool_stop(pool, i);
+			errno = err;
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+int nvme_thread_pool_queue(struct nvme_thread_pool *pool, nvme_work_fn fn,
+			   void *arg)
+{
+	return nvme_thread_pool_queue_ordered(pool, fn, NULL, arg);
+}
+
+int nvme_thread_pool_queue_ordered(struct nvme_thread_pool *pool, nvme_work_fn fn,
+				   nvme_emit_fn emit, void *arg)
+{
+	struct work *w;
+	int err;
+
+	if (__atomic_load_n(&pool->cancel, __ATOMIC_SEQ_CST))
+		return -ECANCELED;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -ENOMEM;
+
+	w->fn = fn;
+	w->emit = emit;
+	w->arg = arg;
+
+	/* from here on the item is emitted, run or not */
+	if (emit) {
+		pthread_mutex_lock(&pool->order_lock);
+		if (pool->order_tail)
+			pool->order_tail->next_ordered = w;
+		else
+			pool->order_head = w;
+		pool->order_tail = w;
+		pthread_mutex_unlock(&pool->order_lock);
+	}
+
+	err = pool_submit(pool, w);
+	if (err)
+		free(w);
+
+	return err;
+}
+
+void nvme_thread_pool_cancel(struct nvme_thread_pool *pool, int err)
+{
+	int none = 0;
+
+	if (!__atomic_compare_exchange_n(&pool->cancel, &none, err ? err : -ECANCELED,
+					 false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pthread_cond_broadcast(&pool->space_cond);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+int nvme_thread_pool_wait(struct nvme_thread_pool *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	while (__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST))
+		pthread_cond_wait(&pool->idle_cond, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+
+	return __atomic_exchange_n(&pool->cancel, 0, __ATOMIC_SEQ_CST);
+}
+
+void nvme_thread_pool_destroy(struct nvme_thread_pool *pool)
+{
+	if (!pool)
+		return;
+
+	nvme_thread_pool_wait(pool);
+	pool_stop(pool, pool->nr_threads);
+}
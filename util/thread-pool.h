@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_THREAD_POOL_H
+#define __UTIL_THREAD_POOL_H
+
+/*
+ * Fixed size pool of worker threads executing queued work items. Each
+ * worker has a bounded queue it takes work from in FIFO order, and steals
+ * from the queues of the other workers when its own runs empty. Work items
+ * must not block on each other.
+ */
+
+struct nvme_thread_pool;
+
+typedef void (*nvme_work_fn)(void *arg);
+
+/* called with -ECANCELED instead of the work item's result if it was dropped */
+typedef void (*nvme_emit_fn)(void *arg, int err);
+
+/* work items queued per worker before nvme_thread_pool_queue() blocks */
+#define NVME_THREAD_POOL_DEPTH	64
+
+/*
+ * nvme_thread_pool_jobs - the number of threads for a --jobs option
+ *
+ * @jobs of 0 is one thread per online CPU. The result is at most @nr, the
+ * number of work items, and at least 1.
+ */
+unsigned int nvme_thread_pool_jobs(unsigned int jobs, unsigned int nr);
+
+/*
+ * nvme_thread_pool_create - start @nr_threads workers
+ *
+ * Returns the pool or NULL with errno set.
+ */
+struct nvme_thread_pool *nvme_thread_pool_create(unsigned int nr_threads);
+
+/*
+ * nvme_thread_pool_queue - run @fn(@arg) on one of the workers
+ *
+ * Blocks while the queues of all workers are full, except when called from
+ * a work item of the pool, which runs @fn itself then. Returns 0 or a
+ * negative errno, -ECANCELED after nvme_thread_pool_cancel().
+ */
+int nvme_thread_pool_queue(struct nvme_thread_pool *pool, nvme_work_fn fn,
+			   void *arg);
+
+/*
+ * nvme_thread_pool_queue_ordered - run @fn(@arg) on one of the workers and
+ * then @emit(@arg, 0) in the order the ordered work items were queued
+ *
+ * The @emit calls don't run concurrently and each follows all @emit calls
+ * of the items queued before, so results can be written out as they come
+ * in while keeping the order of a serial run. Items dropped by a cancel
+ * are emitted too, with -ECANCELED.
+ */
+int nvme_thread_pool_queue_ordered(struct nvme_thread_pool *pool, nvme_work_fn fn,
+				   nvme_emit_fn emit, void *arg);
+
+/*
+ * nvme_thread_pool_cancel - drop the queued work items that haven't started
+ *
+ * For a fatal error of a work item, the pool stops doing further work. The
+ * first @err, a negative errno, is kept and returned by the next wait.
+ */
+void nvme_thread_pool_cancel(struct nvme_thread_pool *pool, int err);
+
+/*
+ * nvme_thread_pool_wait - wait until all queued work items have finished
+ *
+ * Returns the error of a cancel since the last wait, or 0. The pool takes
+ * work again afterwards.
+ */
+int nvme_thread_pool_wait(struct nvme_thread_pool *pool);
+
+/*
+ * nvme_thread_pool_destroy - finish queued work, stop and free the workers
+ */
+void nvme_thread_pool_destroy(struct nvme_thread_pool *pool);
+
+#endif /* __UTIL_THREAD_POOL_H */
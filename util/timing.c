@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "common.h"
+#include "timing.h"
+
+bool nvme_timing_enabled;
+
+static struct {
+	bool report;
+	enum nvme_timing_phase current;
+	uint64_t last;
+	uint64_t start;
+	uint64_t ns[NVME_TIMING_NR];
+} timing;
+
+static const char * const phase_names[NVME_TIMING_NR] = {
+	[NVME_TIMING_STARTUP]	= "startup",
+	[NVME_TIMING_PARSE]	= "parse",
+	[NVME_TIMING_OPEN]	= "open",
+	[NVME_TIMING_COMMAND]	= "command",
+	[NVME_TIMING_PRINT]	= "print",
+};
+
+static uint64_t tv_ns(struct timeval *tv)
+{
+	return tv->tv_sec * 1000000000ULL + tv->tv_usec * 1000ULL;
+}
+
+void nvme_timing_track(void)
+{
+	struct rusage ru;
+
+	if (nvme_timing_enabled)
+		return;
+
+	if (!getrusage(RUSAGE_SELF, &ru))
+		timing.ns[NVME_TIMING_STARTUP] = tv_ns(&ru.ru_utime) +
+			tv_ns(&ru.ru_stime);
+
+	timing.start = timing.last = monotonic_ns();
+	timing.current = NVME_TIMING_COMMAND;
+	nvme_timing_enabled = true;
+}
+
+void nvme_timing_start(void)
+{
+	nvme_timing_track();
+	timing.report = true;
+}
+
+enum nvme_timing_phase nvme_timing_phase(void)
+{
+	return timing.current;
+}
+
+const char *nvme_timing_phase_name(enum nvme_timing_phase phase)
+{
+	return phase_names[phase];
+}
+
+enum nvme_timing_phase __nvme_timing_switch(enum nvme_timing_phase phase)
+{
+	enum nvme_timing_phase prev = timing.current;
+	uint64_t now = monotonic_ns();
+
+	timing.ns[prev] += now - timing.last;
+	timing.last = now;
+	timing.current = phase;
+
+	return prev;
+}
+
+void nvme_timing_report(FILE *f)
+{
+	uint64_t total;
+	int i;
+
+	if (!timing.report)
+		return;
+
+	__nvme_timing_switch(timing.current);
+	total = timing.ns[NVME_TIMING_STARTUP] + timing.last - timing.start;
+
+	fprintf(f, "timing:");
+	for (i = 0; i < NVME_TIMING_NR; i++)
+		fprintf(f, " %s %.0f us%s", phase_names[i], timing.ns[i] / 1e3,
+			i == NVME_TIMING_STARTUP ? " (cpu)," : ",");
+	fprintf(f, " total %.0f us\n", total / 1e3);
+}
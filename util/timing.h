@@ -0,0 +1,51 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_TIMING_H
+#define __UTIL_TIMING_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Where the wall clock time of an invocation goes, for --timing. The time
+ * between two switches is charged to the phase that was current; code
+ * entering a phase restores the previous one when done, so the phases
+ * nest. Startup is the CPU time spent before main(), which is mostly the
+ * dynamic loader resolving symbols.
+ */
+enum nvme_timing_phase {
+	NVME_TIMING_STARTUP,
+	NVME_TIMING_PARSE,	/* argument parsing */
+	NVME_TIMING_OPEN,	/* opening the device */
+	NVME_TIMING_COMMAND,	/* everything else, the commands themselves */
+	NVME_TIMING_PRINT,	/* the print_ops */
+	NVME_TIMING_NR,
+};
+
+extern bool nvme_timing_enabled;
+
+/* nvme_timing_start - enable the accounting, call first thing in main() */
+void nvme_timing_start(void);
+
+/* nvme_timing_track - follow the phases for nvme_timing_phase() without a report */
+void nvme_timing_track(void);
+
+/* nvme_timing_phase - the current phase, NVME_TIMING_STARTUP before tracking */
+enum nvme_timing_phase nvme_timing_phase(void);
+
+/* nvme_timing_phase_name - "startup", "parse", ... */
+const char *nvme_timing_phase_name(enum nvme_timing_phase phase);
+
+enum nvme_timing_phase __nvme_timing_switch(enum nvme_timing_phase phase);
+
+/* nvme_timing_switch - make @phase current, returns the previous phase */
+static inline enum nvme_timing_phase nvme_timing_switch(enum nvme_timing_phase phase)
+{
+	if (!nvme_timing_enabled)
+		return phase;
+	return __nvme_timing_switch(phase);
+}
+
+/* nvme_timing_report - print the time per phase to @f */
+void nvme_timing_report(FILE *f);
+
+#endif /* __UTIL_TIMING_H */
@@ -61,61 +61,114 @@ static long double uint128_t_to_double(nvme_uint128_t data)
 	return result;
 }
 
-static char *__uint128_t_to_string(nvme_uint128_t val, bool l10n)
+#define UINT128_DIGITS	39
+
+static char *uint128_put_digits(char *p, __u64 chunk, int width)
 {
-	static char str[60];
-	int idx = 60;
-	__u64 div, rem;
-	char *sep = NULL;
-	int i, len = 0, cl = 0;
-
-	if (l10n) {
-		sep = localeconv()->thousands_sep;
-		len = strlen(sep);
-		cl = 1;
+	do {
+		*--p = '0' + chunk % 10;
+		chunk /= 10;
+	} while (--width > 0 || chunk);
+
+	return p;
+}
+
+/*
+ * Write the decimal digits of @val right aligned, ending at @end, and
+ * return where they start. The digits are taken off in chunks of 19
+ * decimal places, or 9 without a 128 bit integer type, leaving one
+ * 64 bit division per digit instead of four.
+ */
+static char *uint128_digits(nvme_uint128_t val, char *end)
+{
+	char *p = end;
+#ifdef __SIZEOF_INT128__
+	const __u64 base = 10000000000000000000ULL;
+	unsigned __int128 v = (unsigned __int128)val.words[0] << 96 |
+		(unsigned __int128)val.words[1] << 64 |
+		(__u64)val.words[2] << 32 | val.words[3];
+
+	while (v >= base) {
+		p = uint128_put_digits(p, v % base, 19);
+		v /= base;
 	}
 
-	/* terminate at the end, and build up from the ones */
-	str[--idx] = '\0';
+	return uint128_put_digits(p, v, 1);
+#else
+	const __u64 base = 1000000000;
+	__u64 rem;
+	int i;
 
-	do {
-		if (len && !((sizeof(str) - idx) % (3 + cl))) {
-			for (i = 0; i < len; i++)
-				str[--idx] = sep[len - i - 1];
+	for (;;) {
+		rem = 0;
+		for (i = 0; i < 4; i++) {
+			rem = rem << 32 | val.words[i];
+			val.words[i] = rem / base;
+			rem %= base;
 		}
+		if (!(val.words[0] | val.words[1] | val.words[2] | val.words[3]))
+			break;
+		p = uint128_put_digits(p, rem, 9);
+	}
 
-		rem = val.words[0];
-
-		div = rem / 10;
-		rem = ((rem - div * 10) << 32) + val.words[1];
-		val.words[0] = div;
+	return uint128_put_digits(p, rem, 1);
+#endif
+}
 
-		div = rem / 10;
-		rem = ((rem - div * 10) << 32) + val.words[2];
-		val.words[1] = div;
+char *uint128_t_to_str(nvme_uint128_t val, char buf[NVME_UINT128_STR_LEN])
+{
+	char digits[UINT128_DIGITS], *p;
+	size_t n;
 
-		div = rem / 10;
-		rem = ((rem - div * 10) << 32) + val.words[3];
-		val.words[2] = div;
+	p = uint128_digits(val, digits + UINT128_DIGITS);
+	n = digits + UINT128_DIGITS - p;
+	memcpy(buf, p, n);
+	buf[n] = '\0';
 
-		div = rem / 10;
-		rem = rem - div * 10;
-		val.words[3] = div;
+	return buf;
+}
 
-		str[--idx] = '0' + rem;
-	} while (val.words[0] || val.words[1] || val.words[2] || val.words[3]);
+char *uint128_t_to_l10n_str(nvme_uint128_t val, char buf[NVME_UINT128_STR_LEN])
+{
+	const char *sep = localeconv()->thousands_sep;
+	char digits[UINT128_DIGITS], *p, *out = buf;
+	size_t n, len = strlen(sep), group;
+
+	/* 12 separators of up to three bytes, e.g. U+202F, fit the buffer */
+	if (!len || len > 3)
+		return uint128_t_to_str(val, buf);
+
+	p = uint128_digits(val, digits + UINT128_DIGITS);
+	n = digits + UINT128_DIGITS - p;
+	group = n % 3 ?: 3;
+	while (n) {
+		memcpy(out, p, group);
+		out += group;
+		p += group;
+		n -= group;
+		if (n) {
+			memcpy(out, sep, len);
+			out += len;
+		}
+		group = 3;
+	}
+	*out = '\0';
 
-	return str + idx;
+	return buf;
 }
 
 char *uint128_t_to_string(nvme_uint128_t val)
 {
-	return __uint128_t_to_string(val, false);
+	static __thread char str[NVME_UINT128_STR_LEN];
+
+	return uint128_t_to_str(val, str);
 }
 
 char *uint128_t_to_l10n_string(nvme_uint128_t val)
 {
-	return __uint128_t_to_string(val, true);
+	static __thread char str[NVME_UINT128_STR_LEN];
+
+	return uint128_t_to_l10n_str(val, str);
 }
 
 char *uint128_t_to_si_string(nvme_uint128_t val, __u32 bytes_per_unit)
@@ -28,6 +28,18 @@ nvme_uint128_t le128_to_cpu(__u8 *data);
 long double int128_to_double(__u8 *data);
 uint64_t int48_to_long(__u8 *data);
 
+/* 39 digits and 12 thousands separators of up to three bytes each */
+#define NVME_UINT128_STR_LEN	80
+
+/*
+ * Format @val in decimal, with the thousands separator of the locale for
+ * the l10n variant, into @buf and return it. Reentrant and allocation
+ * free, unlike the _string() variants below which return a per-thread
+ * buffer overwritten by the next call.
+ */
+char *uint128_t_to_str(nvme_uint128_t val, char buf[NVME_UINT128_STR_LEN]);
+char *uint128_t_to_l10n_str(nvme_uint128_t val, char buf[NVME_UINT128_STR_LEN]);
+
 char *uint128_t_to_string(nvme_uint128_t val);
 char *uint128_t_to_l10n_string(nvme_uint128_t val);
 char *uint128_t_to_si_string(nvme_uint128_t val, __u32 bytes_per_unit);
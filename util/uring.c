@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <assert.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+#if HAVE_LINUX_IO_URING
+#include <linux/io_uring.h>
+
+#define SQE_SIZE 128
+
+static_assert(NVME_URING_SETUP_IOPOLL == IORING_SETUP_IOPOLL,
+	      "NVME_URING_SETUP_IOPOLL out of sync");
+
+/*
+ * struct nvme_uring_cmd from linux/nvme_ioctl.h can't be included next to
+ * the libnvme definitions, so encode the ioctl numbers by hand.
+ */
+#define NVME_URING_CMD_LEN	offsetof(struct nvme_passthru_cmd64, result)
+#define NVME_URING_IO		_IOC(_IOC_READ | _IOC_WRITE, 'N', 0x80, NVME_URING_CMD_LEN)
+#define NVME_URING_ADMIN	_IOC(_IOC_READ | _IOC_WRITE, 'N', 0x82, NVME_URING_CMD_LEN)
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, const void *arg,
+			     unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit,
+			  unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		       flags, NULL, 0);
+}
+
+bool nvme_uring_supported(void)
+{
+	struct io_uring_params p;
+	int fd;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+	fd = io_uring_setup(1, &p);
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+int nvme_uring_init(struct nvme_uring *ring, unsigned int entries,
+		    unsigned int flags)
+{
+	struct io_uring_params p;
+	void *sq, *cq;
+	int err;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	p.flags = flags | IORING_SETUP_SQE128 | IORING_SETUP_CQE32;
+
+	ring->fd = io_uring_setup(entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+
+	ring->entries = p.sq_entries;
+	ring->setup_flags = p.flags;
+	ring->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(__u32);
+	ring->cq_ring_sz = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct nvme_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_sz > ring->sq_ring_sz)
+			ring->sq_ring_sz = ring->cq_ring_sz;
+		ring->cq_ring_sz = ring->sq_ring_sz;
+	}
+
+	sq = mmap(NULL, ring->sq_ring_sz, PROT_READ | PROT_WRITE,
+		  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (sq == MAP_FAILED)
+		goto err_close;
+	ring->sq_ring = sq;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cq = sq;
+	} else {
+		cq = mmap(NULL, ring->cq_ring_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd,
+			  IORING_OFF_CQ_RING);
+		if (cq == MAP_FAILED)
+			goto err_unmap_sq;
+	}
+	ring->cq_ring = cq;
+
+	ring->sqes_sz = p.sq_entries * SQE_SIZE;
+	ring->sqes = mmap(NULL, ring->sqes_sz, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		goto err_unmap_cq;
+
+	ring->sq_head = sq + p.sq_off.head;
+	ring->sq_tail = sq + p.sq_off.tail;
+	ring->sq_mask = sq + p.sq_off.ring_mask;
+	ring->sq_array = sq + p.sq_off.array;
+	ring->sq_local_tail = *ring->sq_tail;
+
+	ring->cq_head = cq + p.cq_off.head;
+	ring->cq_tail = cq + p.cq_off.tail;
+	ring->cq_mask = cq + p.cq_off.ring_mask;
+	ring->cqes = cq + p.cq_off.cqes;
+
+	return 0;
+
+err_unmap_cq:
+	if (cq != sq)
+		munmap(cq, ring->cq_ring_sz);
+err_unmap_sq:
+	munmap(sq, ring->sq_ring_sz);
+err_close:
+	err = -errno;
+	close(ring->fd);
+	ring->fd = -1;
+	return err;
+}
+
+void nvme_uring_exit(struct nvme_uring *ring)
+{
+	if (ring->fd < 0)
+		return;
+
+	munmap(ring->sqes, ring->sqes_sz);
+	if (ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_sz);
+	munmap(ring->sq_ring, ring->sq_ring_sz);
+	close(ring->fd);
+	ring->fd = -1;
+}
+
+int nvme_uring_register_buffers(struct nvme_uring *ring,
+				const struct iovec *iov, unsigned int nr)
+{
+	if (io_uring_register(ring->fd, IORING_REGISTER_BUFFERS, iov, nr) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static struct io_uring_sqe *uring_queue(struct nvme_uring *ring, int fd,
+					bool admin,
+					const struct nvme_passthru_cmd64 *cmd,
+					__u64 user_data)
+{
+	unsigned int head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+	unsigned int idx;
+	struct io_uring_sqe *sqe;
+
+	if (ring->sq_local_tail - head >= ring->entries)
+		return NULL;
+
+	idx = ring->sq_local_tail & *ring->sq_mask;
+	sqe = (struct io_uring_sqe *)((char *)ring->sqes + idx * SQE_SIZE);
+	memset(sqe, 0, SQE_SIZE);
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->fd = fd;
+	sqe->cmd_op = admin ? NVME_URING_ADMIN : NVME_URING_IO;
+	sqe->user_data = user_data;
+	memcpy(sqe->cmd, cmd, NVME_URING_CMD_LEN);
+
+	ring->sq_array[idx] = idx;
+	ring->sq_local_tail++;
+
+	return sqe;
+}
+
+int nvme_uring_queue_cmd(struct nvme_uring *ring, int fd, bool admin,
+			 const struct nvme_passthru_cmd64 *cmd, __u64 user_data)
+{
+	return uring_queue(ring, fd, admin, cmd, user_data) ? 0 : -EBUSY;
+}
+
+int nvme_uring_queue_cmd_fixed(struct nvme_uring *ring, int fd, bool admin,
+			       const struct nvme_passthru_cmd64 *cmd,
+			       unsigned int buf_index, __u64 user_data)
+{
+#ifdef IORING_URING_CMD_FIXED
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_queue(ring, fd, admin, cmd, user_data);
+	if (!sqe)
+		return -EBUSY;
+
+	sqe->uring_cmd_flags = IORING_URING_CMD_FIXED;
+	sqe->buf_index = buf_index;
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr)
+{
+	unsigned int tail = *ring->sq_tail;
+	unsigned int to_submit = ring->sq_local_tail - tail;
+	unsigned int flags = 0;
+	int ret;
+
+	__atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+	if (wait_nr || ring->setup_flags & IORING_SETUP_IOPOLL)
+		flags |= IORING_ENTER_GETEVENTS;
+	if (!to_submit && !flags)
+		return 0;
+
+	do {
+		ret = io_uring_enter(ring->fd, to_submit, wait_nr, flags);
+	} while (ret < 0 && errno == EINTR);
+
+	return ret < 0 ? -errno : ret;
+}
+
+unsigned int nvme_uring_reap(struct nvme_uring *ring,
+			     struct nvme_uring_cqe *cqes, unsigned int nr)
+{
+	unsigned int head = *ring->cq_head;
+	unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	unsigned int n = 0;
+
+	while (head != tail && n < nr) {
+		cqes[n++] = ring->cqes[head & *ring->cq_mask];
+		head++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	return n;
+}
+
+#else /* !HAVE_LINUX_IO_URING */
+
+bool nvme_uring_supported(void)
+{
+	return false;
+}
+
+int nvme_uring_init(struct nvme_uring *ring, unsigned int entries,
+		    unsigned int flags)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->fd = -1;
+	return -ENOTSUP;
+}
+
+void nvme_uring_exit(struct nvme_uring *ring)
+{
+}
+
+int nvme_uring_queue_cmd(struct nvme_uring *ring, int fd, bool admin,
+			 const struct nvme_passthru_cmd64 *cmd, __u64 user_data)
+{
+	return -ENOTSUP;
+}
+
+int nvme_uring_register_buffers(struct nvme_uring *ring,
+				const struct iovec *iov, unsigned int nr)
+{
+	return -ENOTSUP;
+}
+
+int nvme_uring_queue_cmd_fixed(struct nvme_uring *ring, int fd, bool admin,
+			       const struct nvme_passthru_cmd64 *cmd,
+			       unsigned int buf_index, __u64 user_data)
+{
+	return -ENOTSUP;
+}
+
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr)
+{
+	return -ENOTSUP;
+}
+
+unsigned int nvme_uring_reap(struct nvme_uring *ring,
+			     struct nvme_uring_cqe *cqes, unsigned int nr)
+{
+	return 0;
+}
+
+#endif /* HAVE_LINUX_IO_URING */
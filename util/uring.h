@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_URING_H
+#define __UTIL_URING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include <libnvme.h>
+
+/*
+ * Minimal io_uring ring for NVMe generic char device passthrough
+ * (IORING_OP_URING_CMD). The ring is always created with 128 byte SQEs
+ * and 32 byte CQEs as required for struct nvme_uring_cmd.
+ *
+ * Commands are described with struct nvme_passthru_cmd64 which shares its
+ * layout with struct nvme_uring_cmd up to the result field.
+ */
+
+struct nvme_uring_cqe {
+	__u64 user_data;
+	__s32 res;
+	__u32 flags;
+	__u64 result;	/* big CQE: command specific dword 0/1 */
+	__u64 rsvd;
+};
+
+struct nvme_uring {
+	int fd;
+	unsigned int entries;
+	unsigned int setup_flags;
+
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int sq_local_tail;
+	void *sqes;
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct nvme_uring_cqe *cqes;
+
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	size_t sqes_sz;
+};
+
+bool nvme_uring_supported(void);
+
+/* IORING_SETUP_IOPOLL for nvme_uring_init(), without the kernel header */
+#define NVME_URING_SETUP_IOPOLL	(1U << 0)
+
+int nvme_uring_init(struct nvme_uring *ring, unsigned int entries,
+		    unsigned int flags);
+void nvme_uring_exit(struct nvme_uring *ring);
+
+/*
+ * nvme_uring_queue_cmd - queue a passthrough command without submitting it
+ * @ring:	ring to queue on
+ * @fd:		NVMe generic char device
+ * @admin:	admin instead of I/O command
+ * @cmd:	command to copy into the SQE, the result field is ignored
+ * @user_data:	opaque value returned with the completion
+ *
+ * Returns 0 on success or -EBUSY if the submission queue is full.
+ */
+int nvme_uring_queue_cmd(struct nvme_uring *ring, int fd, bool admin,
+			 const struct nvme_passthru_cmd64 *cmd, __u64 user_data);
+
+/*
+ * nvme_uring_register_buffers - register @nr buffers for fixed buffer commands
+ * @ring:	ring to register with
+ * @iov:	the buffers, page aligned
+ * @nr:		number of buffers
+ *
+ * The pages stay pinned until the ring is torn down, so commands queued
+ * with nvme_uring_queue_cmd_fixed() are mapped without pinning them again.
+ *
+ * Returns 0 or a negative errno, -ENOMEM if RLIMIT_MEMLOCK is too low.
+ */
+int nvme_uring_register_buffers(struct nvme_uring *ring,
+				const struct iovec *iov, unsigned int nr);
+
+/*
+ * nvme_uring_queue_cmd_fixed - queue a passthrough command on a registered buffer
+ * @buf_index:	index of the registered buffer containing cmd->addr
+ *
+ * Like nvme_uring_queue_cmd(). Kernels before 6.1 fail the command with
+ * -EINVAL on completion.
+ */
+int nvme_uring_queue_cmd_fixed(struct nvme_uring *ring, int fd, bool admin,
+			       const struct nvme_passthru_cmd64 *cmd,
+			       unsigned int buf_index, __u64 user_data);
+
+/*
+ * nvme_uring_submit - submit queued commands and optionally wait
+ * @ring:	ring to submit
+ * @wait_nr:	minimum number of completions to wait for
+ *
+ * Returns the number of submitted SQEs or a negative errno.
+ */
+int nvme_uring_submit(struct nvme_uring *ring, unsigned int wait_nr);
+
+/*
+ * nvme_uring_reap - retrieve available completions
+ * @ring:	ring to reap from
+ * @cqes:	array receiving the completions
+ * @nr:		size of @cqes
+ *
+ * Returns the number of completions copied out and marked as seen.
+ */
+unsigned int nvme_uring_reap(struct nvme_uring *ring,
+			     struct nvme_uring_cqe *cqes, unsigned int nr);
+
+#endif /* __UTIL_URING_H */
@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+struct workload_field {
+	const char *key;
+	size_t offset;
+	size_t size;
+	uint64_t max;
+};
+
+#define WORKLOAD_FIELD(f, m)						\
+	{ #f, offsetof(struct nvme_workload_phase, f),			\
+	  sizeof(((struct nvme_workload_phase *)NULL)->f), m }
+
+static const struct workload_field workload_fields[] = {
+	WORKLOAD_FIELD(duration_ms,	UINT32_MAX),
+	WORKLOAD_FIELD(idle,		1),
+	WORKLOAD_FIELD(read_pct,	100),
+	WORKLOAD_FIELD(rand_read_pct,	100),
+	WORKLOAD_FIELD(rand_write_pct,	100),
+	WORKLOAD_FIELD(read_bytes,	UINT32_MAX),
+	WORKLOAD_FIELD(write_bytes,	UINT32_MAX),
+	WORKLOAD_FIELD(queue_depth,	UINT32_MAX),
+	WORKLOAD_FIELD(iops,		UINT64_MAX),
+	WORKLOAD_FIELD(bytes_per_sec,	UINT64_MAX),
+};
+
+#define WORKLOAD_NR_FIELDS	(sizeof(workload_fields) / sizeof(workload_fields[0]))
+
+static uint64_t workload_get(const struct nvme_workload_phase *p,
+			     const struct workload_field *f)
+{
+	const char *v = (const char *)p + f->offset;
+
+	switch (f->size) {
+	case sizeof(uint8_t):
+		return *(const uint8_t *)v;
+	case sizeof(uint32_t):
+		return *(const uint32_t *)v;
+	default:
+		return *(const uint64_t *)v;
+	}
+}
+
+static void workload_set(struct nvme_workload_phase *p, const struct workload_field *f,
+			 uint64_t val)
+{
+	char *v = (char *)p + f->offset;
+
+	switch (f->size) {
+	case sizeof(uint8_t):
+		*(uint8_t *)v = val;
+		break;
+	case sizeof(uint32_t):
+		*(uint32_t *)v = val;
+		break;
+	default:
+		*(uint64_t *)v = val;
+	}
+}
+
+static int workload_parse_pair(struct nvme_workload_phase *p, const char *tok)
+{
+	const char *eq = strchr(tok, '=');
+	uint64_t val;
+	size_t i;
+	char *e;
+
+	if (!eq || !isdigit((unsigned char)eq[1]))
+		return -EINVAL;
+
+	for (i = 0; i < WORKLOAD_NR_FIELDS; i++)
+		if (strlen(workload_fields[i].key) == (size_t)(eq - tok) &&
+		    !memcmp(workload_fields[i].key, tok, eq - tok))
+			break;
+	if (i == WORKLOAD_NR_FIELDS)
+		return -EINVAL;
+
+	errno = 0;
+	val = strtoull(eq + 1, &e, 0);
+	if (errno || *e || val > workload_fields[i].max)
+		return -EINVAL;
+
+	workload_set(p, &workload_fields[i], val);
+	return 0;
+}
+
+static struct nvme_workload_phase *workload_new_phase(struct nvme_workload *w)
+{
+	struct nvme_workload_phase *p;
+	size_t alloc;
+
+	if (w->nr == w->alloc) {
+		alloc = w->alloc ? w->alloc * 2 : 64;
+		p = realloc(w->phases, alloc * sizeof(*p));
+		if (!p)
+			return NULL;
+		w->phases = p;
+		w->alloc = alloc;
+	}
+
+	p = &w->phases[w->nr++];
+	memset(p, 0, sizeof(*p));
+	return p;
+}
+
+int nvme_workload_load(FILE *f, struct nvme_workload *w, unsigned int *line)
+{
+	struct nvme_workload_phase *p;
+	char *buf = NULL, *tok, *save;
+	size_t len = 0;
+	int err = 0;
+
+	for (*line = 1; getline(&buf, &len, f) >= 0; (*line)++) {
+		buf[strcspn(buf, "#")] = '\0';
+		tok = strtok_r(buf, " \t\r\n", &save);
+		if (!tok)
+			continue;
+
+		p = workload_new_phase(w);
+		if (!p) {
+			err = -ENOMEM;
+			break;
+		}
+		for (; tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+			err = workload_parse_pair(p, tok);
+			if (err)
+				goto out;
+		}
+		if (!p->duration_ms) {
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	if (ferror(f))
+		err = -EIO;
+out:
+	free(buf);
+	return err;
+}
+
+int nvme_workload_write(FILE *f, const struct nvme_workload *w)
+{
+	const struct nvme_workload_phase *p;
+	const char *sep;
+	uint64_t val;
+	size_t i, j;
+
+	fprintf(f, "# nvme io-bench workload profile, %zu phases\n", w->nr);
+	for (i = 0; i < w->nr; i++) {
+		p = &w->phases[i];
+		sep = "";
+		for (j = 0; j < WORKLOAD_NR_FIELDS; j++) {
+			val = workload_get(p, &workload_fields[j]);
+			if (!val)
+				continue;
+			fprintf(f, "%s%s=%"PRIu64, sep, workload_fields[j].key, val);
+			sep = " ";
+		}
+		fputc('\n', f);
+	}
+
+	return fflush(f) || ferror(f) ? -EIO : 0;
+}
+
+static bool workload_acc_idle(struct nvme_workload *w)
+{
+	return !w->acc.weight[0] && !w->acc.weight[1] && !w->acc.qd_ms;
+}
+
+static bool workload_sample_idle(const struct nvme_workload_sample *s)
+{
+	return !s->read_bytes && !s->write_bytes && !s->read_cmds && !s->write_cmds &&
+		!s->queue_depth;
+}
+
+static uint64_t div_round(uint64_t a, uint64_t b)
+{
+	return b ? (a + b / 2) / b : 0;
+}
+
+/* turn the samples added since the last phase into one */
+static int workload_flush(struct nvme_workload *w)
+{
+	struct nvme_workload_phase *p;
+	uint64_t weight, cmds, bytes;
+
+	if (!w->acc.ms)
+		return 0;
+
+	p = workload_new_phase(w);
+	if (!p)
+		return -ENOMEM;
+
+	p->duration_ms = w->acc.ms > UINT32_MAX ? UINT32_MAX : w->acc.ms;
+	p->idle = workload_acc_idle(w);
+	if (!p->idle) {
+		weight = w->acc.weight[0] + w->acc.weight[1];
+		p->read_pct = div_round(100 * w->acc.weight[0], weight);
+		p->rand_read_pct = div_round(w->acc.rand[0], w->acc.weight[0]);
+		p->rand_write_pct = div_round(w->acc.rand[1], w->acc.weight[1]);
+		if (w->acc.bytes[0] && w->acc.cmds[0])
+			p->read_bytes = w->acc.bytes[0] / w->acc.cmds[0];
+		if (w->acc.bytes[1] && w->acc.cmds[1])
+			p->write_bytes = w->acc.bytes[1] / w->acc.cmds[1];
+		p->queue_depth = div_round(w->acc.qd_ms, w->acc.qd_known_ms);
+
+		cmds = w->acc.cmds[0] + w->acc.cmds[1];
+		bytes = w->acc.bytes[0] + w->acc.bytes[1];
+		if (!w->acc.no_rate) {
+			p->iops = cmds * 1000 / w->acc.ms;
+			p->bytes_per_sec = bytes * 1000 / w->acc.ms;
+		}
+	}
+
+	memset(&w->acc, 0, sizeof(w->acc));
+	return 0;
+}
+
+int nvme_workload_add(struct nvme_workload *w, const struct nvme_workload_sample *s,
+		      uint32_t min_ms)
+{
+	uint64_t bytes[2] = { s->read_bytes, s->write_bytes };
+	uint64_t cmds[2] = { s->read_cmds, s->write_cmds };
+	uint8_t rand[2] = { s->rand_read_pct, s->rand_write_pct };
+	bool idle = workload_sample_idle(s);
+	int d, err;
+
+	if (w->acc.ms && idle != workload_acc_idle(w)) {
+		err = workload_flush(w);
+		if (err)
+			return err;
+	}
+
+	w->acc.ms += s->duration_ms;
+	w->acc.no_rate |= !s->rate;
+	for (d = 0; d < 2; d++) {
+		/* the commands weigh the mix where they were counted */
+		uint64_t weight = s->read_cmds || s->write_cmds ? cmds[d] : bytes[d];
+
+		w->acc.bytes[d] += bytes[d];
+		w->acc.cmds[d] += cmds[d];
+		w->acc.rand[d] += rand[d] * weight;
+		w->acc.weight[d] += weight;
+	}
+	if (s->queue_depth) {
+		w->acc.qd_ms += (uint64_t)s->queue_depth * s->duration_ms;
+		w->acc.qd_known_ms += s->duration_ms;
+	}
+
+	if (!idle && w->acc.ms >= min_ms)
+		return workload_flush(w);
+	return 0;
+}
+
+int nvme_workload_finish(struct nvme_workload *w)
+{
+	return workload_flush(w);
+}
+
+void nvme_workload_free(struct nvme_workload *w)
+{
+	free(w->phases);
+	memset(w, 0, sizeof(*w));
+}
@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __UTIL_WORKLOAD_H
+#define __UTIL_WORKLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Workload profiles for io-bench --profile: phases played one after the
+ * other, each with its own read/write mix, transfer sizes, queue depth,
+ * share of random LBAs and rate. A profile is text, one phase per line of
+ * whitespace separated <key>=<value> pairs with the field names below,
+ * '#' starts a comment. Missing keys are 0, which leaves the transfer
+ * sizes and queue depth to the options of io-bench and the rates
+ * unlimited. An idle phase issues no commands for its duration.
+ */
+struct nvme_workload_phase {
+	uint32_t duration_ms;
+	uint8_t idle;
+	uint8_t read_pct;		/* of the commands */
+	uint8_t rand_read_pct;		/* of the reads at random LBAs */
+	uint8_t rand_write_pct;
+	uint32_t read_bytes;		/* per command */
+	uint32_t write_bytes;
+	uint32_t queue_depth;
+	uint64_t iops;			/* commands per second */
+	uint64_t bytes_per_sec;
+};
+
+/*
+ * A sample of what a device saw over @duration_ms, from a workload
+ * tracker or performance log. With @rate the counts are those of the
+ * sample and give the rate of the phase, otherwise they only weigh the
+ * read/write mix, e.g. snapshots of the outstanding commands. The
+ * commands are 0 where only bytes were counted, and the other way round.
+ */
+struct nvme_workload_sample {
+	uint32_t duration_ms;
+	bool rate;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint64_t read_cmds;
+	uint64_t write_cmds;
+	uint8_t rand_read_pct;
+	uint8_t rand_write_pct;
+	uint32_t queue_depth;		/* 0 if unknown */
+};
+
+struct nvme_workload {
+	struct nvme_workload_phase *phases;
+	size_t nr;
+	size_t alloc;
+
+	/* the samples added since the last phase */
+	struct {
+		uint64_t ms;
+		bool no_rate;
+		uint64_t bytes[2];	/* read, write */
+		uint64_t cmds[2];
+		uint64_t rand[2];	/* percent times the weight */
+		uint64_t weight[2];
+		uint64_t qd_ms;		/* queue depth times duration */
+		uint64_t qd_known_ms;
+	} acc;
+};
+
+/*
+ * nvme_workload_load - read the profile in @f into the zeroed @w
+ *
+ * For a malformed profile @line is set to the line, counted from 1.
+ * Returns 0, -EINVAL for a malformed profile, -ENOMEM or -EIO.
+ */
+int nvme_workload_load(FILE *f, struct nvme_workload *w, unsigned int *line);
+
+/* nvme_workload_write - write @w as a profile, returns 0 or -EIO */
+int nvme_workload_write(FILE *f, const struct nvme_workload *w);
+
+/*
+ * nvme_workload_add - add the samples of a capture to the zeroed @w in
+ * time order, merged into phases of at least @min_ms. A sample without
+ * any I/O ends a busy phase early, so that idle periods are kept. Call
+ * nvme_workload_finish() after the last sample.
+ *
+ * Returns 0 or -ENOMEM.
+ */
+int nvme_workload_add(struct nvme_workload *w, const struct nvme_workload_sample *s,
+		      uint32_t min_ms);
+int nvme_workload_finish(struct nvme_workload *w);
+
+void nvme_workload_free(struct nvme_workload *w);
+
+#endif /* __UTIL_WORKLOAD_H */